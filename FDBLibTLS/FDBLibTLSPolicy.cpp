@@ -26,6 +26,7 @@
 #include <openssl/objects.h>
 #include <openssl/obj_mac.h>
 #include <openssl/pem.h>
+#include <openssl/sha.h>
 #include <openssl/x509.h>
 
 #include <algorithm>
@@ -34,10 +35,12 @@
 #include <string>
 #include <vector>
 
+#include <string.h>
+
 
 FDBLibTLSPolicy::FDBLibTLSPolicy(Reference<FDBLibTLSPlugin> plugin, ITLSLogFunc logf):
 	plugin(plugin), logf(logf), tls_cfg(NULL), session_created(false), cert_data_set(false),
-	key_data_set(false), verify_peers_set(false), verify_cert(true), verify_time(true) {
+	key_data_set(false), verify_peers_set(false), verify_cert(true), verify_time(true), session_file(NULL) {
 
 	if ((tls_cfg = tls_config_new()) == NULL) {
 		logf("FDBLibTLSConfigError", NULL, true, NULL);
@@ -53,9 +56,46 @@ FDBLibTLSPolicy::FDBLibTLSPolicy(Reference<FDBLibTLSPlugin> plugin, ITLSLogFunc
 
 FDBLibTLSPolicy::~FDBLibTLSPolicy() {
 	tls_config_free(tls_cfg);
+	if (session_file != NULL)
+		fclose(session_file);
+}
+
+#define FDB_LIBTLS_SESSION_ID "FDBLibTLS"
+#define FDB_LIBTLS_SESSION_LIFETIME (2 * 60 * 60)
+
+void FDBLibTLSPolicy::configure_session_resumption(void) {
+	// A resumed session doesn't carry the peer's certificate chain, which
+	// check_criteria() needs, so sessions are only resumed when there are
+	// no criteria to check.
+	if (subject_criteria.size() != 0 || issuer_criteria.size() != 0 || ticket_key.empty())
+		return;
+
+	// Servers issue session tickets, encrypted with a key derived from their
+	// private key. Every process sharing a private key can then resume a
+	// session established with any of the others, and the tickets are no
+	// more exposed than the key itself.
+	if (tls_config_set_session_id(tls_cfg, (const unsigned char *)FDB_LIBTLS_SESSION_ID, strlen(FDB_LIBTLS_SESSION_ID)) == -1 ||
+	    tls_config_set_session_lifetime(tls_cfg, FDB_LIBTLS_SESSION_LIFETIME) == -1 ||
+	    tls_config_add_ticket_key(tls_cfg, 1, (unsigned char *)&ticket_key[0], ticket_key.size()) == -1) {
+		logf("FDBLibTLSSessionResumptionError", NULL, false, "LibTLSErrorMessage", tls_config_error(tls_cfg), NULL);
+		return;
+	}
+
+	// Clients keep the last session they established in a private
+	// temporary file, and offer it when they next connect.
+	if ((session_file = tmpfile()) == NULL) {
+		logf("FDBLibTLSSessionFileError", NULL, false, NULL);
+		return;
+	}
+	if (tls_config_set_session_fd(tls_cfg, fileno(session_file)) == -1) {
+		logf("FDBLibTLSSessionFileError", NULL, false, "LibTLSErrorMessage", tls_config_error(tls_cfg), NULL);
+		return;
+	}
 }
 
 ITLSSession* FDBLibTLSPolicy::create_session(bool is_client, TLSSendCallbackFunc send_func, void* send_ctx, TLSRecvCallbackFunc recv_func, void* recv_ctx, void* uid) {
+	if (!session_created)
+		configure_session_resumption();
 	session_created = true;
 	try {
 		return new FDBLibTLSSession(Reference<FDBLibTLSPolicy>::addRef(this), is_client, send_func, send_ctx, recv_func, recv_ctx, uid);
@@ -385,6 +425,16 @@ bool FDBLibTLSPolicy::set_key_data(const uint8_t* key_data, int key_len) {
 		return false;
 	}
 
+	// Derive the session ticket key (see configure_session_resumption).
+	static const char ticket_key_label[] = "FDBLibTLS session ticket key";
+	unsigned char digest[SHA512_DIGEST_LENGTH];
+	SHA512_CTX sha;
+	SHA512_Init(&sha);
+	SHA512_Update(&sha, ticket_key_label, sizeof(ticket_key_label));
+	SHA512_Update(&sha, key_data, key_len);
+	SHA512_Final(digest, &sha);
+	ticket_key.assign((const char *)digest, TLS_TICKET_KEY_SIZE);
+
 	key_data_set = true;
 
 	return true;
@@ -30,6 +30,8 @@
 #include <map>
 #include <string>
 
+#include <stdio.h>
+
 struct FDBLibTLSPolicy: ITLSPolicy, ReferenceCounted<FDBLibTLSPolicy> {
 	FDBLibTLSPolicy(Reference<FDBLibTLSPlugin> plugin, ITLSLogFunc logf);
 	virtual ~FDBLibTLSPolicy();
@@ -44,6 +46,7 @@ struct FDBLibTLSPolicy: ITLSPolicy, ReferenceCounted<FDBLibTLSPolicy> {
 
 	void parse_verify(std::string input);
 	void reset_verify(void);
+	void configure_session_resumption(void);
 
 	virtual bool set_cert_data(const uint8_t* cert_data, int cert_len);
 	virtual bool set_key_data(const uint8_t* key_data, int key_len);
@@ -62,6 +65,9 @@ struct FDBLibTLSPolicy: ITLSPolicy, ReferenceCounted<FDBLibTLSPolicy> {
 
 	std::map<int, std::string> subject_criteria;
 	std::map<int, std::string> issuer_criteria;
+
+	std::string ticket_key;
+	FILE *session_file;
 };
 
 #endif /* FDB_LIBTLS_POLICY_H */
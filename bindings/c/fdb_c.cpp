@@ -407,14 +407,26 @@ FDBFuture* fdb_transaction_get_addresses_for_key( FDBTransaction* tr, uint8_t co
 
 }
 
-extern "C"
-FDBFuture* fdb_transaction_get_range_impl(
+extern "C" DLLEXPORT
+FDBFuture* fdb_transaction_get_multi( FDBTransaction* tr, uint8_t const* keys,
+									  int const* key_lengths, int key_count,
+									  fdb_bool_t snapshot ) {
+	Standalone<VectorRef<KeyRef>> k;
+	k.reserve( k.arena(), key_count );
+	for( int i = 0; i < key_count; i++ ) {
+		k.push_back( k.arena(), KeyRef( keys, key_lengths[i] ) );
+		keys += key_lengths[i];
+	}
+	return (FDBFuture*)( TXN(tr)->getMulti( k, snapshot ).extractPtr() );
+}
+
+static FDBFuture* get_range(
 		FDBTransaction* tr, uint8_t const* begin_key_name,
 		int begin_key_name_length, fdb_bool_t begin_or_equal, int begin_offset,
 		uint8_t const* end_key_name, int end_key_name_length,
 		fdb_bool_t end_or_equal, int end_offset, int limit, int target_bytes,
 		FDBStreamingMode mode, int iteration, fdb_bool_t snapshot,
-		fdb_bool_t reverse )
+		fdb_bool_t reverse, int value_prefix_length )
 {
 	/* This method may be called with a runtime API version of 13, in
 	   which negative row limits are a reverse range read */
@@ -444,11 +456,12 @@ FDBFuture* fdb_transaction_get_range_impl(
 	/* length(iteration_progression) */
 	static const int max_iteration = sizeof(iteration_progression) / sizeof(int);
 
-	if(mode == FDB_STREAMING_MODE_WANT_ALL)
-		mode = FDB_STREAMING_MODE_SERIAL;
-
+	/* _WANT_ALL gets a byte budget large enough for the client to read
+	   several shards concurrently */
 	int mode_bytes;
-	if (mode == FDB_STREAMING_MODE_ITERATOR) {
+	if (mode == FDB_STREAMING_MODE_WANT_ALL)
+		mode_bytes = std::max(mode_bytes_array[FDB_STREAMING_MODE_SERIAL], CLIENT_KNOBS->RANGE_PREFETCH_BYTES);
+	else if (mode == FDB_STREAMING_MODE_ITERATOR) {
 		if (iteration <= 0)
 			return TSAV_ERROR(Standalone<RangeResultRef>, client_invalid_operation);
 
@@ -465,6 +478,9 @@ FDBFuture* fdb_transaction_get_range_impl(
 	else if(mode_bytes != CLIENT_KNOBS->BYTE_LIMIT_UNLIMITED)
 		target_bytes = std::min(target_bytes, mode_bytes);
 
+	GetRangeLimits limits(limit, target_bytes);
+	limits.valueBytes = value_prefix_length;
+
 	return (FDBFuture*)( TXN(tr)->getRange(
 							 KeySelectorRef(
 								 KeyRef( begin_key_name,
@@ -474,10 +490,45 @@ FDBFuture* fdb_transaction_get_range_impl(
 								 KeyRef( end_key_name,
 										 end_key_name_length ),
 								 end_or_equal, end_offset ),
-							 GetRangeLimits(limit, target_bytes),
+							 limits,
 							 snapshot, reverse ).extractPtr() );
 }
 
+extern "C"
+FDBFuture* fdb_transaction_get_range_impl(
+		FDBTransaction* tr, uint8_t const* begin_key_name,
+		int begin_key_name_length, fdb_bool_t begin_or_equal, int begin_offset,
+		uint8_t const* end_key_name, int end_key_name_length,
+		fdb_bool_t end_or_equal, int end_offset, int limit, int target_bytes,
+		FDBStreamingMode mode, int iteration, fdb_bool_t snapshot,
+		fdb_bool_t reverse )
+{
+	return get_range(
+		tr, begin_key_name, begin_key_name_length, begin_or_equal, begin_offset,
+		end_key_name, end_key_name_length, end_or_equal, end_offset,
+		limit, target_bytes, mode, iteration, snapshot, reverse,
+		GetRangeLimits::VALUE_BYTES_UNLIMITED );
+}
+
+extern "C" DLLEXPORT
+FDBFuture* fdb_transaction_get_range_value_prefix(
+		FDBTransaction* tr, uint8_t const* begin_key_name,
+		int begin_key_name_length, fdb_bool_t begin_or_equal, int begin_offset,
+		uint8_t const* end_key_name, int end_key_name_length,
+		fdb_bool_t end_or_equal, int end_offset, int limit, int target_bytes,
+		FDBStreamingMode mode, int iteration, fdb_bool_t snapshot,
+		fdb_bool_t reverse, int value_prefix_length )
+{
+	if (value_prefix_length < 0)
+		return TSAV_ERROR(Standalone<RangeResultRef>, client_invalid_operation);
+
+	return get_range(
+		tr, begin_key_name, begin_key_name_length, begin_or_equal, begin_offset,
+		end_key_name, end_key_name_length, end_or_equal, end_offset,
+		limit, target_bytes, mode, iteration, snapshot, reverse,
+		value_prefix_length );
+}
+
 extern "C"
 FDBFuture* fdb_transaction_get_range_selector_v13(
 	FDBTransaction* tr, uint8_t const* begin_key_name, int begin_key_name_length,
@@ -513,6 +564,21 @@ void fdb_transaction_set( FDBTransaction* tr, uint8_t const* key_name,
 					  ValueRef( value, value_length ) ); );
 }
 
+extern "C" DLLEXPORT
+void fdb_transaction_set_multi( FDBTransaction* tr, uint8_t const* keys,
+								int const* key_lengths, uint8_t const* values,
+								int const* value_lengths, int count ) {
+	CATCH_AND_DIE(
+		Standalone<VectorRef<KeyValueRef>> kvs;
+		kvs.reserve( kvs.arena(), count );
+		for( int i = 0; i < count; i++ ) {
+			kvs.push_back( kvs.arena(), KeyValueRef( KeyRef( keys, key_lengths[i] ), ValueRef( values, value_lengths[i] ) ) );
+			keys += key_lengths[i];
+			values += value_lengths[i];
+		}
+		TXN(tr)->setMulti( kvs ); );
+}
+
 extern "C" DLLEXPORT
 void fdb_transaction_atomic_op( FDBTransaction* tr, uint8_t const* key_name,
 								int key_name_length, uint8_t const* param,
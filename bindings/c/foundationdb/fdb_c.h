@@ -202,6 +202,15 @@ extern "C" {
     fdb_transaction_get_addresses_for_key(FDBTransaction* tr, uint8_t const* key_name,
                             int key_name_length);
 
+    /* Reads key_count keys, which are packed back to back in keys with the
+       length of each in key_lengths, as one future.  Use
+       fdb_future_get_keyvalue_array() to get the keys that are present with
+       their values, in the order they were requested. */
+    DLLEXPORT WARN_UNUSED_RESULT FDBFuture*
+    fdb_transaction_get_multi( FDBTransaction* tr, uint8_t const* keys,
+                               int const* key_lengths, int key_count,
+                               fdb_bool_t snapshot );
+
 #if FDB_API_VERSION >= 14
     DLLEXPORT WARN_UNUSED_RESULT FDBFuture* fdb_transaction_get_range(
         FDBTransaction* tr, uint8_t const* begin_key_name,
@@ -212,11 +221,31 @@ extern "C" {
         fdb_bool_t reverse );
 #endif
 
+    /* Like fdb_transaction_get_range(), but returns only the first
+       value_prefix_length bytes of each value, so that 0 returns only keys.
+       The rest of the values is neither sent nor read from disk where the
+       storage engine can avoid it. */
+    DLLEXPORT WARN_UNUSED_RESULT FDBFuture*
+    fdb_transaction_get_range_value_prefix(
+        FDBTransaction* tr, uint8_t const* begin_key_name,
+        int begin_key_name_length, fdb_bool_t begin_or_equal, int begin_offset,
+        uint8_t const* end_key_name, int end_key_name_length,
+        fdb_bool_t end_or_equal, int end_offset, int limit, int target_bytes,
+        FDBStreamingMode mode, int iteration, fdb_bool_t snapshot,
+        fdb_bool_t reverse, int value_prefix_length );
+
     DLLEXPORT void
     fdb_transaction_set( FDBTransaction* tr, uint8_t const* key_name,
                          int key_name_length, uint8_t const* value,
                          int value_length );
 
+    /* Sets count keys, packed the same way as for fdb_transaction_get_multi(),
+       to the values packed back to back in values. */
+    DLLEXPORT void
+    fdb_transaction_set_multi( FDBTransaction* tr, uint8_t const* keys,
+                               int const* key_lengths, uint8_t const* values,
+                               int const* value_lengths, int count );
+
     DLLEXPORT void
     fdb_transaction_atomic_op( FDBTransaction* tr, uint8_t const* key_name,
                                int key_name_length, uint8_t const* param,
@@ -556,6 +556,71 @@ struct RunResult writeTransaction(struct ResultSet *rs, FDBDatabase *db) {
 	return RES(WRITE_TRANSACTION_COUNT/(end - start), 0);
 }
 
+uint32_t THREADED_GET_THREADS = 8;
+uint32_t THREADED_GET_COUNT = 20000;
+const char *THREADED_GET_KPI = "C get throughput per application thread (local client)";
+
+struct ThreadedGetArgs {
+	struct ResultSet *rs;
+	FDBDatabase *db;
+	fdb_error_t e;
+};
+
+// Reads back a key that the transaction has written, so that each get is answered from the transaction's own writes
+// and what is measured is the cost of handing calls from the application thread to the network thread and back.
+void* threadedGetThread(void *arg) {
+	struct ThreadedGetArgs *args = (struct ThreadedGetArgs*)arg;
+	FDBTransaction *tr = NULL;
+	args->e = maybeLogError(fdb_database_create_transaction(args->db, &tr), "create transaction", args->rs);
+	if(args->e) return NULL;
+
+	fdb_transaction_set(tr, keys[0], keySize, valueStr, valueSize);
+
+	fdb_bool_t present;
+	uint8_t const *outValue;
+	int outValueLength;
+
+	int i;
+	for(i = 0; i < THREADED_GET_COUNT && !args->e; i++) {
+		FDBFuture *f = fdb_transaction_get(tr, keys[0], keySize, 0);
+		args->e = maybeLogError(fdb_future_block_until_ready(f), "getting key from threads", args->rs);
+		if(!args->e) {
+			args->e = maybeLogError(fdb_future_get_value(f, &present, &outValue, &outValueLength), "getting future value", args->rs);
+		}
+		fdb_future_destroy(f);
+	}
+
+	fdb_transaction_destroy(tr);
+	return NULL;
+}
+
+struct RunResult threadedGet(struct ResultSet *rs, FDBDatabase *db) {
+	pthread_t *threads = (pthread_t*)malloc(sizeof(pthread_t) * THREADED_GET_THREADS);
+	struct ThreadedGetArgs *args = (struct ThreadedGetArgs*)malloc(sizeof(struct ThreadedGetArgs) * THREADED_GET_THREADS);
+
+	double start = getTime();
+
+	int i;
+	for(i = 0; i < THREADED_GET_THREADS; i++) {
+		args[i].rs = rs;
+		args[i].db = db;
+		args[i].e = 0;
+		pthread_create(&threads[i], NULL, &threadedGetThread, &args[i]);
+	}
+
+	fdb_error_t e = 0;
+	for(i = 0; i < THREADED_GET_THREADS; i++) {
+		pthread_join(threads[i], NULL);
+		if(args[i].e) e = args[i].e;
+	}
+
+	double end = getTime();
+
+	free(threads);
+	free(args);
+	return RES(THREADED_GET_COUNT/(end - start), e);
+}
+
 void runTests(struct ResultSet *rs) {
 	FDBDatabase *db = openDatabase(rs, &netThread);
 
@@ -595,6 +660,9 @@ void runTests(struct ResultSet *rs) {
 	printf("write_transaction\n");
 	runTestDb(&writeTransaction, db, rs, WRITE_TRANSACTION_KPI);
 
+	printf("threaded_get\n");
+	runTestDb(&threadedGet, db, rs, THREADED_GET_KPI);
+
 	fdb_database_destroy(db);
 	fdb_stop_network();
 }
@@ -0,0 +1,270 @@
+/*
+ * CompressedColumn.actor.cpp
+ *
+ * This source file is part of the FoundationDB open source project
+ *
+ * Copyright 2013-2018 Apple Inc. and the FoundationDB project authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "CompressedColumn.h"
+
+namespace FDB {
+	// Packed blocks begin with their encoding and the number of rows, followed by the offsets of the rows from the
+	// beginning of the block, each as the difference from the previous one.  A delta block then has the difference of
+	// each value from the previous one, and a dictionary block the distinct values in order, as differences, followed
+	// by one byte per row indexing them.  Numbers are varints, and signed ones are zigzag encoded.  A tail is a sequence
+	// of (offset, value) varint pairs.
+	enum BlockEncoding : uint8_t { DELTA_ENCODING = 0, DICTIONARY_ENCODING = 1 };
+	static const int MAX_DICTIONARY_SIZE = 256;
+
+	static void writeVarint(std::string& out, uint64_t v) {
+		while(v >= 0x80) {
+			out.push_back(char(v | 0x80));
+			v >>= 7;
+		}
+		out.push_back(char(v));
+	}
+
+	static void writeSigned(std::string& out, int64_t v) {
+		writeVarint(out, (uint64_t(v) << 1) ^ uint64_t(v >> 63));
+	}
+
+	struct BlockReader {
+		const uint8_t* p;
+		const uint8_t* end;
+
+		explicit BlockReader(StringRef s) : p(s.begin()), end(s.end()) {}
+
+		bool done() const { return p == end; }
+
+		uint64_t readVarint() {
+			uint64_t v = 0;
+			for(int shift = 0; shift < 64; shift += 7) {
+				if(p == end)
+					throw invalid_column_block();
+				uint8_t b = *p++;
+				v |= uint64_t(b & 0x7f) << shift;
+				if(!(b & 0x80))
+					return v;
+			}
+			throw invalid_column_block();
+		}
+
+		int64_t readSigned() {
+			uint64_t v = readVarint();
+			return int64_t(v >> 1) ^ -int64_t(v & 1);
+		}
+
+		const uint8_t* readBytes(size_t n) {
+			if(size_t(end - p) < n)
+				throw invalid_column_block();
+			const uint8_t* b = p;
+			p += n;
+			return b;
+		}
+	};
+
+	CompressedColumn::CompressedColumn(Subspace subspace, int blockSpan) : packed(subspace.get(0)), tails(subspace.get(1)), blockSpan(blockSpan) {
+		if(blockSpan < 1 || blockSpan > MAX_BLOCK_SPAN)
+			throw invalid_option_value();
+	}
+
+	int64_t CompressedColumn::blockOf(int64_t position) const {
+		int64_t block = position / blockSpan;
+		return position % blockSpan < 0 ? block - 1 : block;
+	}
+
+	Standalone<StringRef> CompressedColumn::encodeTailRow(int64_t offset, int64_t value) {
+		std::string row;
+		writeVarint(row, offset);
+		writeSigned(row, value);
+		return Standalone<StringRef>(StringRef(row));
+	}
+
+	void CompressedColumn::append(Reference<Transaction> const& tr, int64_t position, int64_t value) const {
+		int64_t block = blockOf(position);
+		tr->atomicOp(tails.pack(block), encodeTailRow(position - blockBegin(block), value), FDB_MUTATION_TYPE_APPEND_IF_FITS);
+	}
+
+	Standalone<StringRef> CompressedColumn::encodeBlock(Rows const& rows, int64_t base) {
+		std::string header;
+		writeVarint(header, rows.size());
+		int64_t last = 0;
+		for(auto& r : rows) {
+			writeVarint(header, r.first - base - last);
+			last = r.first - base;
+		}
+
+		std::string delta;
+		delta.push_back(char(DELTA_ENCODING));
+		delta += header;
+		int64_t previous = 0;
+		for(auto& r : rows) {
+			writeSigned(delta, int64_t(uint64_t(r.second) - uint64_t(previous)));
+			previous = r.second;
+		}
+
+		std::vector<int64_t> dictionary;
+		for(auto& r : rows)
+			dictionary.push_back(r.second);
+		std::sort(dictionary.begin(), dictionary.end());
+		dictionary.resize(std::unique(dictionary.begin(), dictionary.end()) - dictionary.begin());
+		if(dictionary.size() > MAX_DICTIONARY_SIZE || dictionary.size() + rows.size() >= delta.size())
+			return Standalone<StringRef>(StringRef(delta));
+
+		std::string dict;
+		dict.push_back(char(DICTIONARY_ENCODING));
+		dict += header;
+		writeVarint(dict, dictionary.size());
+		previous = 0;
+		for(int64_t v : dictionary) {
+			writeSigned(dict, int64_t(uint64_t(v) - uint64_t(previous)));
+			previous = v;
+		}
+		for(auto& r : rows)
+			dict.push_back(char(std::lower_bound(dictionary.begin(), dictionary.end(), r.second) - dictionary.begin()));
+		return Standalone<StringRef>(StringRef(dict.size() < delta.size() ? dict : delta));
+	}
+
+	void CompressedColumn::decodeBlock(StringRef block, int64_t base, std::map<int64_t, int64_t>& rows) {
+		BlockReader reader(block);
+		uint8_t encoding = *reader.readBytes(1);
+		uint64_t count = reader.readVarint();
+		if(count > MAX_BLOCK_SPAN)
+			throw invalid_column_block();
+
+		std::vector<int64_t> offsets(count);
+		std::vector<int64_t> values(count);
+		int64_t last = 0;
+		for(int i = 0; i < count; i++)
+			offsets[i] = last += reader.readVarint();
+
+		if(encoding == DELTA_ENCODING) {
+			uint64_t previous = 0;
+			for(int i = 0; i < count; i++)
+				values[i] = int64_t(previous += uint64_t(reader.readSigned()));
+		} else if(encoding == DICTIONARY_ENCODING) {
+			uint64_t size = reader.readVarint();
+			if(size > MAX_DICTIONARY_SIZE)
+				throw invalid_column_block();
+			int64_t dictionary[MAX_DICTIONARY_SIZE] = {};
+			uint64_t previous = 0;
+			for(int d = 0; d < size; d++)
+				dictionary[d] = int64_t(previous += uint64_t(reader.readSigned()));
+			// Indices past the dictionary read zero rather than being checked one by one, which keeps this loop a plain
+			// gather that the compiler can vectorize
+			const uint8_t* indices = reader.readBytes(count);
+			for(int i = 0; i < count; i++)
+				values[i] = dictionary[indices[i]];
+		} else {
+			throw invalid_column_block();
+		}
+		if(!reader.done())
+			throw invalid_column_block();
+
+		for(int i = 0; i < count; i++)
+			rows[base + offsets[i]] = values[i];
+	}
+
+	void CompressedColumn::decodeTail(StringRef tail, int64_t base, std::map<int64_t, int64_t>& rows) {
+		BlockReader reader(tail);
+		while(!reader.done()) {
+			int64_t offset = reader.readVarint();
+			rows[base + offset] = reader.readSigned();
+		}
+	}
+
+	// Adds the values of the keys of subspace for blocks [beginBlock, endBlock) to blocks
+	ACTOR static Future<Void> readBlocks(Reference<Transaction> tr, Subspace subspace, int64_t beginBlock, int64_t endBlock, bool snapshot, std::map<int64_t, Standalone<StringRef>>* blocks) {
+		state Key begin = subspace.pack(beginBlock);
+		state Key end = subspace.pack(endBlock);
+		loop {
+			FDBStandalone<RangeResultRef> result = wait(tr->getRange(KeyRangeRef(begin, end), GetRangeLimits(), snapshot, false, FDB_STREAMING_MODE_WANT_ALL));
+			for(auto& kv : result)
+				(*blocks)[subspace.unpack(kv.key).getInt(0)] = Standalone<StringRef>(kv.value);
+			if(!result.more || !result.size())
+				return Void();
+			begin = keyAfter(result.back().key);
+		}
+	}
+
+	ACTOR static Future<CompressedColumn::Rows> _read(Reference<Transaction> tr, CompressedColumn self, int64_t begin, int64_t end, bool snapshot) {
+		state CompressedColumn::Rows rows;
+		if(begin >= end)
+			return rows;
+
+		state int64_t beginBlock = self.blockOf(begin);
+		state int64_t endBlock = self.blockOf(end - 1) + 1;
+		state std::map<int64_t, Standalone<StringRef>> packedBlocks;
+		state std::map<int64_t, Standalone<StringRef>> tailBlocks;
+		Void _ = wait(readBlocks(tr, self.packed, beginBlock, endBlock, snapshot, &packedBlocks) &&
+		              readBlocks(tr, self.tails, beginBlock, endBlock, snapshot, &tailBlocks));
+
+		std::set<int64_t> blocks;
+		for(auto& b : packedBlocks)
+			blocks.insert(b.first);
+		for(auto& b : tailBlocks)
+			blocks.insert(b.first);
+		for(int64_t block : blocks) {
+			std::map<int64_t, int64_t> blockRows;
+			auto p = packedBlocks.find(block);
+			if(p != packedBlocks.end())
+				CompressedColumn::decodeBlock(p->second, self.blockBegin(block), blockRows);
+			auto t = tailBlocks.find(block);
+			if(t != tailBlocks.end())
+				CompressedColumn::decodeTail(t->second, self.blockBegin(block), blockRows);
+			for(auto r = blockRows.lower_bound(begin); r != blockRows.end() && r->first < end; ++r)
+				rows.push_back(*r);
+		}
+		return rows;
+	}
+
+	Future<CompressedColumn::Rows> CompressedColumn::read(Reference<Transaction> const& tr, int64_t begin, int64_t end, bool snapshot) const {
+		return _read(tr, *this, begin, end, snapshot);
+	}
+
+	// Reads the tail non-snapshot, so that an append committed concurrently conflicts with the pack rather than being
+	// cleared with the tail
+	ACTOR static Future<Void> _pack(Reference<Transaction> tr, CompressedColumn self, int64_t block) {
+		state Key packedKey = self.packed.pack(block);
+		state Key tailKey = self.tails.pack(block);
+		state Future<Optional<FDBStandalone<ValueRef>>> packedValue = tr->get(packedKey);
+		state Optional<FDBStandalone<ValueRef>> tail = wait(tr->get(tailKey));
+		if(!tail.present())
+			return Void();
+		Optional<FDBStandalone<ValueRef>> current = wait(packedValue);
+
+		std::map<int64_t, int64_t> blockRows;
+		if(current.present())
+			CompressedColumn::decodeBlock(current.get(), self.blockBegin(block), blockRows);
+		CompressedColumn::decodeTail(tail.get(), self.blockBegin(block), blockRows);
+
+		CompressedColumn::Rows rows(blockRows.begin(), blockRows.end());
+		tr->set(packedKey, CompressedColumn::encodeBlock(rows, self.blockBegin(block)));
+		tr->clear(tailKey);
+		return Void();
+	}
+
+	Future<Void> CompressedColumn::pack(Reference<Transaction> const& tr, int64_t block) const {
+		return _pack(tr, *this, block);
+	}
+
+	void CompressedColumn::clearBlocks(Reference<Transaction> const& tr, int64_t beginBlock, int64_t endBlock) const {
+		if(beginBlock >= endBlock)
+			return;
+		tr->clear(KeyRangeRef(packed.pack(beginBlock), packed.pack(endBlock)));
+		tr->clear(KeyRangeRef(tails.pack(beginBlock), tails.pack(endBlock)));
+	}
+}
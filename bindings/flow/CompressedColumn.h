@@ -0,0 +1,69 @@
+/*
+ * CompressedColumn.h
+ *
+ * This source file is part of the FoundationDB open source project
+ *
+ * Copyright 2013-2018 Apple Inc. and the FoundationDB project authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FDB_FLOW_COMPRESSED_COLUMN_H
+#define FDB_FLOW_COMPRESSED_COLUMN_H
+
+#pragma once
+
+#include "Subspace.h"
+
+namespace FDB {
+	// A column of integer values at integer positions (e.g. timestamps), stored in blocks of blockSpan consecutive
+	// positions.  Each block has a packed value, delta or dictionary encoded, and a tail of rows appended since it was
+	// last packed.  append() adds to the tail with APPEND_IF_FITS, so ingestion neither reads nor conflicts; read()
+	// merges the tail over the packed rows, the last append to a position winning; pack() folds the tail of a block into
+	// its packed value.
+	//
+	// A tail row takes at most MAX_ROW_BYTES, so a tail holds at least VALUE_SIZE_LIMIT / MAX_ROW_BYTES rows.  Appends
+	// that do not fit are dropped by the database, so a writer that rewrites positions should pack() blocks before their
+	// tails hold that many rows.
+	class CompressedColumn {
+	public:
+		typedef std::vector<std::pair<int64_t, int64_t>> Rows;  // (position, value) in order of position
+
+		enum { MAX_BLOCK_SPAN = 4096, MAX_ROW_BYTES = 12 };
+
+		explicit CompressedColumn(Subspace subspace, int blockSpan = 1024);
+
+		void append(Reference<Transaction> const& tr, int64_t position, int64_t value) const;
+		// The rows at positions in [begin, end)
+		Future<Rows> read(Reference<Transaction> const& tr, int64_t begin, int64_t end, bool snapshot = false) const;
+		Future<Void> pack(Reference<Transaction> const& tr, int64_t block) const;
+		// Clears the blocks [beginBlock, endBlock), e.g. to expire old rows
+		void clearBlocks(Reference<Transaction> const& tr, int64_t beginBlock, int64_t endBlock) const;
+
+		int64_t blockOf(int64_t position) const;
+		int64_t blockBegin(int64_t block) const { return block * blockSpan; }
+
+		// The packed value of rows, all in the block beginning at base, with whichever encoding is smaller
+		static Standalone<StringRef> encodeBlock(Rows const& rows, int64_t base);
+		// Adds the rows of a packed value or of a tail to rows, replacing those at the same positions
+		static void decodeBlock(StringRef block, int64_t base, std::map<int64_t, int64_t>& rows);
+		static void decodeTail(StringRef tail, int64_t base, std::map<int64_t, int64_t>& rows);
+		static Standalone<StringRef> encodeTailRow(int64_t offset, int64_t value);
+
+		Subspace packed;
+		Subspace tails;
+		int blockSpan;
+	};
+}
+
+#endif
@@ -26,6 +26,7 @@ namespace FDB {
 	const StringRef DirectoryLayer::HIGH_CONTENTION_KEY = LiteralStringRef("hca");
 	const StringRef DirectoryLayer::LAYER_KEY = LiteralStringRef("layer");
 	const StringRef DirectoryLayer::VERSION_KEY = LiteralStringRef("version");
+	const StringRef DirectoryLayer::METADATA_VERSION_KEY = LiteralStringRef("metadataVersion");
 	const int64_t DirectoryLayer::SUB_DIR_KEY = 0;
 
 	const uint32_t DirectoryLayer::VERSION[3] = {1, 0, 0};
@@ -35,11 +36,18 @@ namespace FDB {
 	const Subspace DirectoryLayer::DEFAULT_CONTENT_SUBSPACE = Subspace();
 	const StringRef DirectoryLayer::PARTITION_LAYER = LiteralStringRef("partition");
 
-	DirectoryLayer::DirectoryLayer(Subspace nodeSubspace, Subspace contentSubspace, bool allowManualPrefixes) :
+	DirectoryLayer::DirectoryLayer(Subspace nodeSubspace, Subspace contentSubspace, bool allowManualPrefixes, int prefixBatchSize, bool cachePaths) :
 		nodeSubspace(nodeSubspace), contentSubspace(contentSubspace), allowManualPrefixes(allowManualPrefixes),
-		rootNode(nodeSubspace.get(nodeSubspace.key())), allocator(rootNode.get(HIGH_CONTENTION_KEY))
+		rootNode(nodeSubspace.get(nodeSubspace.key())), allocator(rootNode.get(HIGH_CONTENTION_KEY), prefixBatchSize),
+		pathCache(cachePaths ? new PathCache() : NULL)
 	{ }
 
+	void DirectoryLayer::setMetadataVersion(Reference<Transaction> const& tr) const {
+		// A random value rather than a counter, so that a value read by a transaction that changed the tree and then
+		// failed to commit is never seen again
+		tr->set(rootNode.pack(METADATA_VERSION_KEY), BinaryWriter::toValue(g_random->randomUniqueID(), Unversioned()));
+	}
+
 	Subspace DirectoryLayer::nodeWithPrefix(StringRef const& prefix) const {
 		return nodeSubspace.get(prefix);
 	}
@@ -53,9 +61,54 @@ namespace FDB {
 		return nodeWithPrefix(prefix.get());
 	}
 
+	// Returns the node of path if it was cached at the given metadata version.  The keys that finding it would have read
+	// are added as read conflicts, so that the transaction still conflicts with a concurrent change to the path.
+	Optional<DirectoryLayer::Node> findCached(Reference<DirectoryLayer> dirLayer, Reference<Transaction> tr, IDirectory::Path const& path, Standalone<StringRef> const& metadataVersion) {
+		Reference<DirectoryLayer::PathCache> cache = dirLayer->pathCache;
+		if(cache->db.getPtr() != tr->getDatabase().getPtr() || !cache->metadataVersion.present() || cache->metadataVersion.get() != metadataVersion) {
+			cache->db = tr->getDatabase();
+			cache->metadataVersion = metadataVersion;
+			cache->paths.clear();
+			return Optional<DirectoryLayer::Node>();
+		}
+
+		auto cached = cache->paths.find(path);
+		if(cached == cache->paths.end()) {
+			return Optional<DirectoryLayer::Node>();
+		}
+
+		Subspace parent = dirLayer->rootNode;
+		for(int i = 0; i < path.size(); ++i) {
+			tr->addReadConflictKey(parent.get(DirectoryLayer::SUB_DIR_KEY).get(path[i], true).key());
+			tr->addReadConflictKey(cached->second.nodes[i].pack(DirectoryLayer::LAYER_KEY));
+			parent = cached->second.nodes[i];
+		}
+
+		DirectoryLayer::Node node(dirLayer, parent, path, path);
+		node.layer = cached->second.layer;
+		node.loadedMetadata = true;
+		return node;
+	}
+
 	ACTOR Future<DirectoryLayer::Node> find(Reference<DirectoryLayer> dirLayer, Reference<Transaction> tr, IDirectory::Path path) {
 		state int pathIndex = 0;
 		state DirectoryLayer::Node node = DirectoryLayer::Node(dirLayer, dirLayer->rootNode, IDirectory::Path(), path);
+		state bool cachePath = dirLayer->pathCache && path.size();
+		state Standalone<StringRef> metadataVersion;
+		state DirectoryLayer::CachedPath found;
+
+		if(cachePath) {
+			// A snapshot read, because findCached() adds conflicts on just the keys of the path
+			Optional<FDBStandalone<ValueRef>> version = wait(tr->get(dirLayer->rootNode.pack(DirectoryLayer::METADATA_VERSION_KEY), true));
+			if(version.present()) {
+				metadataVersion = Standalone<StringRef>(version.get());
+			}
+
+			Optional<DirectoryLayer::Node> cached = findCached(dirLayer, tr, path, metadataVersion);
+			if(cached.present()) {
+				return cached.get();
+			}
+		}
 
 		for(; pathIndex != path.size(); ++pathIndex) {
 			ASSERT(node.subspace.present());
@@ -68,7 +121,10 @@ namespace FDB {
 			node = _node;
 
 			if(!node.exists() || node.layer == DirectoryLayer::PARTITION_LAYER) {
-				return node;
+				break;
+			}
+			if(cachePath) {
+				found.nodes.push_back(node.subspace.get());
 			}
 		}
 
@@ -77,6 +133,20 @@ namespace FDB {
 			node = _node;
 		}
 
+		// Only paths that exist and are wholly in this directory layer are cached.  The cache may have been refilled at
+		// another metadata version while this walk was waiting.
+		Reference<DirectoryLayer::PathCache> cache = dirLayer->pathCache;
+		if(cachePath && node.exists() && node.path.size() == path.size() && cache->metadataVersion.present() && cache->metadataVersion.get() == metadataVersion && cache->db.getPtr() == tr->getDatabase().getPtr()) {
+			if(node.layer == DirectoryLayer::PARTITION_LAYER) {
+				found.nodes.push_back(node.subspace.get());
+			}
+			if(cache->paths.size() >= DirectoryLayer::PathCache::MAX_PATHS) {
+				cache->paths.clear();
+			}
+			found.layer = node.layer;
+			cache->paths[path] = found;
+		}
+
 		return node;
 	}
 
@@ -230,6 +300,7 @@ namespace FDB {
 
 		tr->set(parentNode.get(DirectoryLayer::SUB_DIR_KEY).get(path.back(), true).key(), newPrefix);
 		tr->set(node.get(DirectoryLayer::LAYER_KEY).key(), layer);
+		dirLayer->setMetadataVersion(tr);
 		return dirLayer->contentsOfNode(node, path, layer);
 	}
 
@@ -340,6 +411,7 @@ namespace FDB {
 		DirectoryLayer::Node parentNode = wait(find(dirLayer, tr, IDirectory::Path(path.begin(), path.end() - 1)));
 		if(parentNode.subspace.present()) {
 			tr->clear(parentNode.subspace.get().get(DirectoryLayer::SUB_DIR_KEY).get(path.back(), true).key());
+			dirLayer->setMetadataVersion(tr);
 		}
 
 		return Void();
@@ -386,6 +458,7 @@ namespace FDB {
 		}
 
 		tr->set(parentNode.subspace.get().get(DirectoryLayer::SUB_DIR_KEY).get(newPath.back(), true).key(), dirLayer->nodeSubspace.unpack(oldNode.subspace.get().key()).getString(0));
+		dirLayer->setMetadataVersion(tr);
 		Void _ = wait(removeFromParent(dirLayer, tr, oldPath));
 
 		return dirLayer->contentsOfNode(oldNode.subspace.get(), newPath, oldNode.layer);
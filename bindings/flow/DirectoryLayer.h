@@ -30,7 +30,13 @@
 namespace FDB {
 	class DirectoryLayer : public IDirectory {
 	public:
-		DirectoryLayer(Subspace nodeSubspace = DEFAULT_NODE_SUBSPACE, Subspace contentSubspace = DEFAULT_CONTENT_SUBSPACE, bool allowManualPrefixes = false);
+		// A prefixBatchSize above 1 makes the directory layer lease prefixes for new directories that many at a time (see
+		// HighContentionAllocator), so that concurrent creations through it do not conflict on the allocator.
+		//
+		// With cachePaths, the nodes of the paths it finds are cached, and a path found again costs a single read of the
+		// metadata version key instead of two reads per path element.  Every change to the tree of directories sets that
+		// key, so the cache may only be used if every client changing the directories does (see METADATA_VERSION_KEY).
+		DirectoryLayer(Subspace nodeSubspace = DEFAULT_NODE_SUBSPACE, Subspace contentSubspace = DEFAULT_CONTENT_SUBSPACE, bool allowManualPrefixes = false, int prefixBatchSize = 1, bool cachePaths = false);
 
 		Future<Reference<DirectorySubspace>> create(Reference<Transaction> const& tr, Path const& path, Standalone<StringRef> const& layer = Standalone<StringRef>(), Optional<Standalone<StringRef>> const& prefix = Optional<Standalone<StringRef>>());
 		Future<Reference<DirectorySubspace>> open(Reference<Transaction> const& tr, Path const& path, Standalone<StringRef> const& layer = Standalone<StringRef>());
@@ -58,6 +64,7 @@ namespace FDB {
 		static const StringRef HIGH_CONTENTION_KEY;
 		static const StringRef LAYER_KEY;
 		static const StringRef VERSION_KEY;
+		static const StringRef METADATA_VERSION_KEY;  // Set to a new random value by every change to the tree of directories
 		static const int64_t SUB_DIR_KEY;
 		static const uint32_t VERSION[3];
 		static const StringRef DEFAULT_NODE_SUBSPACE_PREFIX;
@@ -84,6 +91,21 @@ namespace FDB {
 			bool loadedMetadata;
 		};
 
+		// The paths found by find() while the metadata version key had the value metadataVersion
+		struct CachedPath {
+			std::vector<Subspace> nodes;  // The node of each element of the path
+			Standalone<StringRef> layer;
+		};
+		struct PathCache : ReferenceCounted<PathCache> {
+			enum { MAX_PATHS = 10000 };
+
+			Reference<DatabaseContext> db;
+			Optional<Standalone<StringRef>> metadataVersion;
+			std::map<Path, CachedPath> paths;
+		};
+
+		void setMetadataVersion(Reference<Transaction> const& tr) const;
+
 		Reference<DirectorySubspace> openInternal(Standalone<StringRef> const& layer, Node const& existingNode, bool allowOpen);
 		Future<Reference<DirectorySubspace>> createOrOpenInternal(Reference<Transaction> const& tr, Path const& path, Standalone<StringRef> const& layer, Optional<Standalone<StringRef>> const& prefix, bool allowCreate, bool allowOpen);
 
@@ -103,6 +125,7 @@ namespace FDB {
 		Subspace contentSubspace;
 		HighContentionAllocator allocator;
 		bool allowManualPrefixes;
+		Reference<PathCache> pathCache;
 
 		Path path;
 	};
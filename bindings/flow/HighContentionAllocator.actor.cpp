@@ -93,7 +93,66 @@ namespace FDB {
 		}
 	}
 
+	ACTOR Future<Void> leasePrefixes(Reference<DatabaseContext> db, Subspace counters, Subspace recent, Reference<HighContentionAllocator::PrefixLease> lease) {
+		state Reference<Transaction> tr(new Transaction(db));
+		loop {
+			try {
+				// Not a snapshot read, so that leases and window advances by other clients are serialized with this one
+				FDBStandalone<RangeResultRef> range = wait(tr->getRange(counters.range(), 1, false, true));
+				int64_t start = 0;
+				if(range.size() > 0) {
+					start = counters.unpack(range[0].key).getInt(0);
+				}
+
+				// The lease begins past the current window, so candidates being tried in it cannot fall in the lease, and
+				// the next window of _allocate() begins where it ends.  Clearing the recent candidates below that with a
+				// conflict range makes an allocation that picked a candidate in the lease from a stale window conflict.
+				state int64_t leaseStart = start + HighContentionAllocator::windowSize(start);
+				state int64_t leaseEnd = leaseStart + lease->size;
+				tr->clear(KeyRangeRef(counters.key(), counters.get(leaseEnd).key()));
+				tr->clear(KeyRangeRef(recent.key(), recent.get(leaseEnd).key()));
+
+				int64_t zero = 0;
+				tr->atomicOp(counters.get(leaseEnd).key(), StringRef((uint8_t*)&zero, 8), FDB_MUTATION_TYPE_ADD);
+
+				Void _ = wait(tr->commit());
+				if(lease->db.getPtr() == db.getPtr()) {
+					lease->next = leaseStart;
+					lease->end = leaseEnd;
+				}
+				return Void();
+			}
+			catch(Error& e) {
+				Void _ = wait(tr->onError(e));
+			}
+		}
+	}
+
+	ACTOR Future<Standalone<StringRef>> allocateLeased(Reference<Transaction> tr, Subspace counters, Subspace recent, Reference<HighContentionAllocator::PrefixLease> lease) {
+		loop {
+			// Prefixes leased from one database are of no use in another
+			if(lease->db.getPtr() != tr->getDatabase().getPtr()) {
+				lease->db = tr->getDatabase();
+				lease->next = lease->end = 0;
+				lease->renewing = Future<Void>();
+			}
+
+			if(lease->next < lease->end) {
+				return Tuple().append(lease->next++).pack();
+			}
+
+			// Concurrent allocations share a single renewal of the lease
+			if(!lease->renewing.isValid() || lease->renewing.isReady()) {
+				lease->renewing = leasePrefixes(tr->getDatabase(), counters, recent, lease);
+			}
+			Void _ = wait(lease->renewing);
+		}
+	}
+
 	Future<Standalone<StringRef>> HighContentionAllocator::allocate(Reference<Transaction> const& tr) const {
+		if(lease) {
+			return allocateLeased(tr, counters, recent, lease);
+		}
 		return _allocate(tr, counters, recent);
 	}
 
@@ -28,13 +28,29 @@
 namespace FDB {
 	class HighContentionAllocator {
 	public:
-		HighContentionAllocator(Subspace subspace) : counters(subspace.get(0)), recent(subspace.get(1)) {}
+		// With a batchSize above 1, prefixes are leased batchSize at a time in a transaction of their own and then handed
+		// out by this allocator (and its copies) without touching the database, so that these allocations do not conflict
+		// with each other.  Leased prefixes that are never handed out are not reused.
+		HighContentionAllocator(Subspace subspace, int batchSize = 1) : counters(subspace.get(0)), recent(subspace.get(1)),
+			lease(batchSize > 1 ? new PrefixLease(batchSize) : NULL) {}
 		Future<Standalone<StringRef>> allocate(Reference<Transaction> const& tr) const;
 
 		static int64_t windowSize(int64_t start);
+
+		// The prefixes [next, end) leased to this allocator from db and not yet handed out
+		struct PrefixLease : ReferenceCounted<PrefixLease> {
+			Reference<DatabaseContext> db;
+			int64_t next;
+			int64_t end;
+			int size;
+			Future<Void> renewing;
+
+			explicit PrefixLease(int size) : next(0), end(0), size(size) {}
+		};
 	private:
 		Subspace counters;
 		Subspace recent;
+		Reference<PrefixLease> lease;
 	};
 }
 
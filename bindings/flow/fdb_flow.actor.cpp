@@ -220,7 +220,7 @@ namespace FDB {
 			throw_on_error(fdb_database_set_option(db, option, NULL, 0));
 	}
 
-	Transaction::Transaction( Reference<DatabaseContext> const& db ) {
+	Transaction::Transaction( Reference<DatabaseContext> const& db ) : db(db) {
 		throw_on_error( fdb_database_create_transaction( db->db, &tr ) );
 	}
 
@@ -160,24 +160,29 @@ namespace FDB {
 
 		Future<Void> onError( Error const& e );
 
+		// The database on which the transaction was created
+		Reference<DatabaseContext> getDatabase() const { return db; }
+
 		void cancel();
 		void reset();
 		// double getBackoff() { return tr.getBackoff(); }
 		// void debugTransaction(UID dID) { tr.debugTransaction(dID); }
 
 		Transaction() : tr(NULL) {}
-		Transaction( Transaction&& r ) noexcept(true) {
+		Transaction( Transaction&& r ) noexcept(true) : db(std::move(r.db)) {
 			tr = r.tr;
 			r.tr = NULL;
 		}
 		Transaction& operator=( Transaction&& r ) noexcept(true) {
 			tr = r.tr;
 			r.tr = NULL;
+			db = std::move(r.db);
 			return *this;
 		}
 
 	private:
 		FDBTransaction* tr;
+		Reference<DatabaseContext> db;
 	};
 
 }
@@ -37,15 +37,6 @@ import (
 	"unsafe"
 )
 
-/* Would put this in futures.go but for the documented issue with
-/* exports and functions in preamble
-/* (https://code.google.com/p/go-wiki/wiki/cgo#Global_functions) */
-//export unlockMutex
-func unlockMutex(p unsafe.Pointer) {
-	m := (*sync.Mutex)(p)
-	m.Unlock()
-}
-
 // A Transactor can execute a function that requires a Transaction. Functions
 // written to accept a Transactor are called transactional functions, and may be
 // called with either a Database or a Transaction.
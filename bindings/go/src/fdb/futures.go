@@ -26,16 +26,53 @@ package fdb
  #cgo LDFLAGS: -lfdb_c -lm
  #define FDB_API_VERSION 520
  #include <foundationdb/fdb_c.h>
+ #include <pthread.h>
+ #include <stdint.h>
+ #include <stdlib.h>
  #include <string.h>
 
- extern void unlockMutex(void*);
+ // Futures that have become ready are identified by the token they were
+ // registered with and queued here by the network thread, which never has to
+ // call into Go. A single goroutine drains the queue (see
+ // processCompletions).
+ static pthread_mutex_t completionLock = PTHREAD_MUTEX_INITIALIZER;
+ static pthread_cond_t completionReady = PTHREAD_COND_INITIALIZER;
+ static uintptr_t* completions = NULL;
+ static int completionCount = 0;
+ static int completionCapacity = 0;
+
+ static void go_completion_callback(FDBFuture* f, void* token) {
+     pthread_mutex_lock(&completionLock);
+     if (completionCount == completionCapacity) {
+         completionCapacity = completionCapacity ? completionCapacity * 2 : 256;
+         completions = (uintptr_t*)realloc(completions, completionCapacity * sizeof(uintptr_t));
+         if (!completions) {
+             abort();
+         }
+     }
+     completions[completionCount++] = (uintptr_t)token;
+     pthread_cond_signal(&completionReady);
+     pthread_mutex_unlock(&completionLock);
+ }
 
- void go_callback(FDBFuture* f, void* m) {
-     unlockMutex(m);
+ static void go_set_callback(FDBFuture* f, uintptr_t token) {
+     fdb_future_set_callback(f, (FDBCallback)&go_completion_callback, (void*)token);
  }
 
- void go_set_callback(void* f, void* m) {
-     fdb_future_set_callback(f, (FDBCallback)&go_callback, m);
+ // Blocks until at least one future is ready, then moves up to max tokens
+ // into out and returns how many were moved.
+ static int go_wait_for_completions(uintptr_t* out, int max) {
+     int n;
+     pthread_mutex_lock(&completionLock);
+     while (completionCount == 0) {
+         pthread_cond_wait(&completionReady, &completionLock);
+     }
+     n = completionCount < max ? completionCount : max;
+     memcpy(out, completions, n * sizeof(uintptr_t));
+     memmove(completions, completions + n, (completionCount - n) * sizeof(uintptr_t));
+     completionCount -= n;
+     pthread_mutex_unlock(&completionLock);
+     return n;
  }
 */
 import "C"
@@ -82,15 +119,52 @@ func newFuture(ptr *C.FDBFuture) *future {
 	return f
 }
 
+// Goroutines waiting for futures block on channels rather than on OS
+// threads. Each waiting goroutine registers a channel under a token that is
+// passed to the future's callback, and one goroutine, the only one that waits
+// in C, closes the channels of the futures that have become ready.
+var completionQueue struct {
+	sync.Mutex
+	once      sync.Once
+	nextToken uintptr
+	waiters   map[uintptr]chan struct{}
+}
+
+func processCompletions() {
+	tokens := make([]C.uintptr_t, 256)
+	for {
+		n := int(C.go_wait_for_completions(&tokens[0], C.int(len(tokens))))
+
+		completionQueue.Lock()
+		for _, token := range tokens[:n] {
+			if ch, ok := completionQueue.waiters[uintptr(token)]; ok {
+				delete(completionQueue.waiters, uintptr(token))
+				close(ch)
+			}
+		}
+		completionQueue.Unlock()
+	}
+}
+
 func fdb_future_block_until_ready(f *C.FDBFuture) {
 	if C.fdb_future_is_ready(f) != 0 {
 		return
 	}
 
-	m := &sync.Mutex{}
-	m.Lock()
-	C.go_set_callback(unsafe.Pointer(f), unsafe.Pointer(m))
-	m.Lock()
+	completionQueue.once.Do(func() {
+		completionQueue.waiters = make(map[uintptr]chan struct{})
+		go processCompletions()
+	})
+
+	ch := make(chan struct{})
+	completionQueue.Lock()
+	completionQueue.nextToken++
+	token := completionQueue.nextToken
+	completionQueue.waiters[token] = ch
+	completionQueue.Unlock()
+
+	C.go_set_callback(f, C.uintptr_t(token))
+	<-ch
 }
 
 func (f future) BlockUntilReady() {
@@ -287,6 +361,41 @@ func (f futureKeyValueArray) Get() ([]KeyValue, bool, error) {
 	return ret, (more != 0), nil
 }
 
+// FutureKeyValueSlice represents the asynchronous result of a function that
+// returns a slice of key-value pairs. FutureKeyValueSlice is a lightweight
+// object that may be efficiently copied, and is safe for concurrent use by
+// multiple goroutines.
+type FutureKeyValueSlice interface {
+	// Get returns a slice of key-value pairs or an error if the asynchronous
+	// operation associated with this future did not successfully complete. The
+	// current goroutine will be blocked until the future is ready.
+	Get() ([]KeyValue, error)
+
+	// MustGet returns a slice of key-value pairs or panics if the asynchronous
+	// operation associated with this future did not successfully complete. The
+	// current goroutine will be blocked until the future is ready.
+	MustGet() []KeyValue
+
+	Future
+}
+
+type futureKeyValueSlice struct {
+	futureKeyValueArray
+}
+
+func (f futureKeyValueSlice) Get() ([]KeyValue, error) {
+	kvs, _, err := f.futureKeyValueArray.Get()
+	return kvs, err
+}
+
+func (f futureKeyValueSlice) MustGet() []KeyValue {
+	val, err := f.Get()
+	if err != nil {
+		panic(err)
+	}
+	return val
+}
+
 // FutureInt64 represents the asynchronous result of a function that returns a
 // database version. FutureInt64 is a lightweight object that may be efficiently
 // copied, and is safe for concurrent use by multiple goroutines.
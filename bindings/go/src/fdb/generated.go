@@ -188,6 +188,17 @@ func (o NetworkOptions) SetDisableLocalClient() error {
 	return o.setOpt(64, nil)
 }
 
+// Loads each external client library this many times, each copy with its own network thread and connections to the cluster, and assigns transactions to the copies in turn. The copies are loaded from files written to the temporary directory. The local client always uses a single network thread. Must be set before setting up the network.
+//
+// Parameter: Number of network threads for each external client library
+func (o NetworkOptions) SetClientThreadsPerVersion(param int64) error {
+	b, e := int64ToBytes(param)
+	if e != nil {
+		return e
+	}
+	return o.setOpt(65, b)
+}
+
 // Disables logging of client statistics, such as sampled transaction activity.
 func (o NetworkOptions) SetDisableClientStatisticsLogging() error {
 	return o.setOpt(70, nil)
@@ -209,6 +220,13 @@ func (o DatabaseOptions) SetLocationCacheSize(param int64) error {
 	return o.setOpt(10, b)
 }
 
+// Load the locations of the keys with the given prefix into the client location cache in the background, so that the first transactions to read them do not wait to look up their locations. An empty prefix loads the locations of all keys outside the system keyspace. The locations are loaded again whenever the proxies change. May be set more than once to load several prefixes, and loads no more locations than the location cache holds.
+//
+// Parameter: Key prefix
+func (o DatabaseOptions) SetLocationCachePrefetch(param []byte) error {
+	return o.setOpt(11, param)
+}
+
 // Set the maximum number of watches allowed to be outstanding on a database connection. Increasing this number could result in increased resource usage. Reducing this number will not cancel any outstanding watches. Defaults to 10000 and cannot be larger than 1000000.
 //
 // Parameter: Max outstanding watches
@@ -249,6 +267,11 @@ func (o TransactionOptions) SetCausalReadDisable() error {
 	return o.setOpt(21, nil)
 }
 
+// The read version will be committed, and will include every transaction committed more than a few milliseconds before it was requested, but not necessarily those committed more recently, even by this client. Like with causal_read_risky, it might also not be the latest committed in the event of a fault or partition. Read versions requested this way are served from each proxy's periodically refreshed view of the other proxies' committed versions, which lowers read version latency and proxy load in clusters with many proxies.
+func (o TransactionOptions) SetCausalReadGossiped() error {
+	return o.setOpt(22, nil)
+}
+
 // The next write performed on this transaction will not generate a write conflict range. As a result, other transactions which read the key(s) being modified by the next write will not conflict with this transaction. Care needs to be taken when using this option on a transaction that is shared between multiple threads. When setting this option, write conflict ranges will be disabled on the next write operation, regardless of what thread it is on.
 func (o TransactionOptions) SetNextWriteNoWriteConflictRange() error {
 	return o.setOpt(30, nil)
@@ -389,6 +412,24 @@ func (o TransactionOptions) SetReadLockAware() error {
 	return o.setOpt(702, nil)
 }
 
+// Allows the transaction to use a read version this client received from the cluster up to the given number of milliseconds ago, instead of requesting a new one. The transaction may then not see the results of transactions committed in that time, including this client's own. Valid parameter values are ``[0, 5000]``. If set to 0, a new read version is always requested.
+//
+// Parameter: value in milliseconds of the oldest acceptable read version
+func (o TransactionOptions) SetMaxReadVersionStaleness(param int64) error {
+	b, e := int64ToBytes(param)
+	if e != nil {
+		return e
+	}
+	return o.setOpt(720, b)
+}
+
+// Tags the transaction. When the cluster has to limit the rate at which transactions start, a tag that starts more than its share of transactions is limited on its own, so that it does not delay transactions with other tags or with no tag. The tag is kept when the transaction is reset.
+//
+// Parameter: String identifying the tenant or workload that the transaction belongs to, of at most 16 bytes
+func (o TransactionOptions) SetTag(param string) error {
+	return o.setOpt(800, []byte(param))
+}
+
 type StreamingMode int
 
 const (
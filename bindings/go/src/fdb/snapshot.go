@@ -64,6 +64,12 @@ func (s Snapshot) Get(key KeyConvertible) FutureByteSlice {
 	return s.get(key.FDBKey(), 1)
 }
 
+// GetMulti is equivalent to (Transaction).GetMulti, performed as a snapshot
+// read.
+func (s Snapshot) GetMulti(keys []KeyConvertible) FutureKeyValueSlice {
+	return s.getMulti(keys, 1)
+}
+
 // GetKey is equivalent to (Transaction).GetKey, performed as a snapshot read.
 func (s Snapshot) GetKey(sel Selectable) FutureKey {
 	return s.getKey(sel.FDBKeySelector(), 1)
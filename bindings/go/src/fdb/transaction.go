@@ -36,6 +36,7 @@ import "C"
 // with read-only transactional functions.
 type ReadTransaction interface {
 	Get(key KeyConvertible) FutureByteSlice
+	GetMulti(keys []KeyConvertible) FutureKeyValueSlice
 	GetKey(sel Selectable) FutureKey
 	GetRange(r Range, options RangeOptions) RangeResult
 	GetReadVersion() FutureInt64
@@ -246,6 +247,31 @@ func (t Transaction) Get(key KeyConvertible) FutureByteSlice {
 	return t.get(key.FDBKey(), 0)
 }
 
+func (t *transaction) getMulti(keys []KeyConvertible, snapshot int) FutureKeyValueSlice {
+	var packed []byte
+	lengths := make([]C.int, len(keys))
+	for i, k := range keys {
+		kb := k.FDBKey()
+		packed = append(packed, kb...)
+		lengths[i] = C.int(len(kb))
+	}
+
+	var lengthsPtr *C.int
+	if len(lengths) > 0 {
+		lengthsPtr = &lengths[0]
+	}
+
+	return futureKeyValueSlice{futureKeyValueArray{newFuture(C.fdb_transaction_get_multi(t.ptr, byteSliceToPtr(packed), lengthsPtr, C.int(len(keys)), C.fdb_bool_t(snapshot)))}}
+}
+
+// GetMulti returns the (future) keys and values of those of the specified
+// keys that are present in the database, in the order they were given. It has
+// the same result as calling Get for each key, but issues all of the reads
+// with a single call into the C library.
+func (t Transaction) GetMulti(keys []KeyConvertible) FutureKeyValueSlice {
+	return t.getMulti(keys, 0)
+}
+
 func (t *transaction) doGetRange(r Range, options RangeOptions, snapshot bool, iteration int) futureKeyValueArray {
 	begin, end := r.FDBRangeKeySelectors()
 	bsel := begin.FDBKeySelector()
@@ -296,6 +322,27 @@ func (t Transaction) Set(key KeyConvertible, value []byte) {
 	C.fdb_transaction_set(t.ptr, byteSliceToPtr(kb), C.int(len(kb)), byteSliceToPtr(value), C.int(len(value)))
 }
 
+// SetMulti is equivalent to calling Set for each of the specified key-value
+// pairs, but passes all of them to the C library with a single call.
+func (t Transaction) SetMulti(kvs []KeyValue) {
+	var keys, values []byte
+	keyLengths := make([]C.int, len(kvs))
+	valueLengths := make([]C.int, len(kvs))
+	for i, kv := range kvs {
+		kb := kv.Key.FDBKey()
+		keys = append(keys, kb...)
+		keyLengths[i] = C.int(len(kb))
+		values = append(values, kv.Value...)
+		valueLengths[i] = C.int(len(kv.Value))
+	}
+
+	if len(kvs) == 0 {
+		return
+	}
+
+	C.fdb_transaction_set_multi(t.ptr, byteSliceToPtr(keys), &keyLengths[0], byteSliceToPtr(values), &valueLengths[0], C.int(len(kvs)))
+}
+
 // Clear removes the specified key (and any associated value), if it
 // exists. Clear returns immediately, having modified the snapshot of the
 // database represented by the transaction.
@@ -346,6 +346,73 @@ JNIEXPORT jobject JNICALL Java_com_apple_foundationdb_FutureResults_FutureResult
 	return result;
 }
 
+// Lays out the results of a range read as a count, a flag for whether there are more results, and then the key and
+// value lengths and the key and value bytes of each pair.  The layout uses native byte order and is decoded by RangeResult.
+static int directRangeResultSize( const FDBKeyValue *kvs, int count ) {
+	int size = 2 * sizeof(jint);
+	for(int i = 0; i < count; i++) {
+		size += 2 * sizeof(jint) + kvs[i].key_length + kvs[i].value_length;
+	}
+	return size;
+}
+
+JNIEXPORT jint JNICALL Java_com_apple_foundationdb_FutureResults_FutureResults_1getDirectSize(JNIEnv *jenv, jobject, jlong future) {
+	if( !future ) {
+		throwParamNotNull(jenv);
+		return 0;
+	}
+	FDBFuture *f = (FDBFuture *)future;
+
+	const FDBKeyValue *kvs;
+	int count;
+	fdb_bool_t more;
+	fdb_error_t err = fdb_future_get_keyvalue_array( f, &kvs, &count, &more );
+	if( err ) {
+		safeThrow( jenv, getThrowable( jenv, err ) );
+		return 0;
+	}
+
+	return directRangeResultSize( kvs, count );
+}
+
+JNIEXPORT void JNICALL Java_com_apple_foundationdb_FutureResults_FutureResults_1getDirect(JNIEnv *jenv, jobject, jlong future, jobject buffer) {
+	if( !future || !buffer ) {
+		throwParamNotNull(jenv);
+		return;
+	}
+	FDBFuture *f = (FDBFuture *)future;
+
+	const FDBKeyValue *kvs;
+	int count;
+	fdb_bool_t more;
+	fdb_error_t err = fdb_future_get_keyvalue_array( f, &kvs, &count, &more );
+	if( err ) {
+		safeThrow( jenv, getThrowable( jenv, err ) );
+		return;
+	}
+
+	uint8_t *out = (uint8_t *)jenv->GetDirectBufferAddress( buffer );
+	if( !out || jenv->GetDirectBufferCapacity( buffer ) < directRangeResultSize( kvs, count ) ) {
+		throwRuntimeEx( jenv, "Error getting handle to native resources" );
+		return;
+	}
+
+	jint header[2] = { count, more ? 1 : 0 };
+	memcpy(out, header, sizeof(header));
+	out += sizeof(header);
+
+	for(int i = 0; i < count; i++) {
+		jint lengths[2] = { kvs[i].key_length, kvs[i].value_length };
+		memcpy(out, lengths, sizeof(lengths));
+		out += sizeof(lengths);
+
+		memcpy(out, kvs[i].key, kvs[i].key_length);
+		out += kvs[i].key_length;
+		memcpy(out, kvs[i].value, kvs[i].value_length);
+		out += kvs[i].value_length;
+	}
+}
+
 // SOMEDAY: explore doing this more efficiently with Direct ByteBuffers
 JNIEXPORT jobject JNICALL Java_com_apple_foundationdb_FutureResults_FutureResults_1get(JNIEnv *jenv, jobject, jlong future) {
 	if( !future ) {
@@ -667,6 +734,34 @@ JNIEXPORT jlong JNICALL Java_com_apple_foundationdb_FDBTransaction_Transaction_1
 	return (jlong)f;
 }
 
+JNIEXPORT jlong JNICALL Java_com_apple_foundationdb_FDBTransaction_Transaction_1getMulti(JNIEnv *jenv, jobject, jlong tPtr, jbyteArray keyBytes, jintArray keyLengths, jboolean snapshot) {
+	if( !tPtr || !keyBytes || !keyLengths ) {
+		throwParamNotNull(jenv);
+		return 0;
+	}
+	FDBTransaction *tr = (FDBTransaction *)tPtr;
+
+	uint8_t *barr = (uint8_t *)jenv->GetByteArrayElements( keyBytes, NULL );
+	if(!barr) {
+		if( !jenv->ExceptionOccurred() )
+			throwRuntimeEx( jenv, "Error getting handle to native resources" );
+		return 0;
+	}
+
+	jint *lengths = jenv->GetIntArrayElements( keyLengths, NULL );
+	if(!lengths) {
+		jenv->ReleaseByteArrayElements( keyBytes, (jbyte *)barr, JNI_ABORT );
+		if( !jenv->ExceptionOccurred() )
+			throwRuntimeEx( jenv, "Error getting handle to native resources" );
+		return 0;
+	}
+
+	FDBFuture *f = fdb_transaction_get_multi( tr, barr, (int *)lengths, jenv->GetArrayLength( keyLengths ), (fdb_bool_t)snapshot );
+	jenv->ReleaseIntArrayElements( keyLengths, lengths, JNI_ABORT );
+	jenv->ReleaseByteArrayElements( keyBytes, (jbyte *)barr, JNI_ABORT );
+	return (jlong)f;
+}
+
 JNIEXPORT jlong JNICALL Java_com_apple_foundationdb_FDBTransaction_Transaction_1getKey(JNIEnv *jenv, jobject, jlong tPtr, 
 		jbyteArray keyBytes, jboolean orEqual, jint offset, jboolean snapshot) {
 	if( !tPtr || !keyBytes ) {
@@ -750,6 +845,36 @@ JNIEXPORT void JNICALL Java_com_apple_foundationdb_FDBTransaction_Transaction_1s
 	jenv->ReleaseByteArrayElements( valueBytes, (jbyte *)barrValue, JNI_ABORT );
 }
 
+JNIEXPORT void JNICALL Java_com_apple_foundationdb_FDBTransaction_Transaction_1setMulti(JNIEnv *jenv, jobject, jlong tPtr, jbyteArray keyBytes, jintArray keyLengths, jbyteArray valueBytes, jintArray valueLengths) {
+	if( !tPtr || !keyBytes || !keyLengths || !valueBytes || !valueLengths ) {
+		throwParamNotNull(jenv);
+		return;
+	}
+	FDBTransaction *tr = (FDBTransaction *)tPtr;
+
+	uint8_t *barrKey = (uint8_t *)jenv->GetByteArrayElements( keyBytes, NULL );
+	jint *keyLens = barrKey ? jenv->GetIntArrayElements( keyLengths, NULL ) : NULL;
+	uint8_t *barrValue = keyLens ? (uint8_t *)jenv->GetByteArrayElements( valueBytes, NULL ) : NULL;
+	jint *valueLens = barrValue ? jenv->GetIntArrayElements( valueLengths, NULL ) : NULL;
+
+	if( valueLens ) {
+		fdb_transaction_set_multi( tr,
+				barrKey, (int *)keyLens,
+				barrValue, (int *)valueLens,
+				jenv->GetArrayLength( keyLengths ) );
+		jenv->ReleaseIntArrayElements( valueLengths, valueLens, JNI_ABORT );
+	}
+	if( barrValue )
+		jenv->ReleaseByteArrayElements( valueBytes, (jbyte *)barrValue, JNI_ABORT );
+	if( keyLens )
+		jenv->ReleaseIntArrayElements( keyLengths, keyLens, JNI_ABORT );
+	if( barrKey )
+		jenv->ReleaseByteArrayElements( keyBytes, (jbyte *)barrKey, JNI_ABORT );
+
+	if( !valueLens && !jenv->ExceptionOccurred() )
+		throwRuntimeEx( jenv, "Error getting handle to native resources" );
+}
+
 JNIEXPORT void JNICALL Java_com_apple_foundationdb_FDBTransaction_Transaction_1clear__J_3B(JNIEnv *jenv, jobject, jlong tPtr, jbyteArray keyBytes) {
 	if( !tPtr || !keyBytes ) {
 		throwParamNotNull(jenv);
@@ -85,6 +85,7 @@ public class FDB {
 	private volatile boolean netStarted = false;
 	private volatile boolean netStopped = false;
 	volatile boolean warnOnUnclosed = true;
+	volatile boolean useDirectBuffers = false;
 	private final Semaphore netRunning = new Semaphore(1);
 	private final NetworkOptions options;
 
@@ -200,6 +201,18 @@ public class FDB {
 		this.warnOnUnclosed = warnOnUnclosed;
 	}
 
+	/**
+	 * Enables or disables returning range read results through a direct {@code ByteBuffer}. When enabled,
+	 *  the results of each range read are copied out of the native client once, into memory outside of the
+	 *  Java heap, and each {@link KeyValue} is only created when it is first read. This reduces the time spent
+	 *  copying and the garbage created by scans that read large numbers of keys. By default, this feature is disabled.
+	 *
+	 * @param useDirectBuffers Whether range read results should be returned through direct buffers
+	 */
+	public void setUseDirectBufferRangeResults(boolean useDirectBuffers) {
+		this.useDirectBuffers = useDirectBuffers;
+	}
+
 	/**
 	 * Returns the API version that was selected by the {@link #selectAPIVersion(int) selectAPIVersion()}
 	 *  call. This can be used to guard different parts of client code against different versions
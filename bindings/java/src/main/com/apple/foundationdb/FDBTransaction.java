@@ -20,6 +20,8 @@
 
 package com.apple.foundationdb;
 
+import java.util.ArrayList;
+import java.util.List;
 import java.util.concurrent.CompletableFuture;
 import java.util.concurrent.CompletionException;
 import java.util.concurrent.ExecutionException;
@@ -50,6 +52,11 @@ class FDBTransaction extends NativeObjectWrapper implements Transaction, OptionC
 			return get_internal(key, true);
 		}
 
+		@Override
+		public CompletableFuture<List<KeyValue>> getMulti(List<byte[]> keys) {
+			return getMulti_internal(keys, true);
+		}
+
 		@Override
 		public CompletableFuture<byte[]> getKey(KeySelector selector) {
 			return getKey_internal(selector, true);
@@ -207,6 +214,49 @@ class FDBTransaction extends NativeObjectWrapper implements Transaction, OptionC
 		}
 	}
 
+	/**
+	 * {@inheritDoc}
+	 */
+	@Override
+	public CompletableFuture<List<KeyValue>> getMulti(List<byte[]> keys) {
+		return getMulti_internal(keys, false);
+	}
+
+	private CompletableFuture<List<KeyValue>> getMulti_internal(List<byte[]> keys, boolean isSnapshot) {
+		int[] keyLengths = new int[keys.size()];
+		byte[] packedKeys = pack(keys, keyLengths);
+
+		FutureResults range;
+		pointerReadLock.lock();
+		try {
+			range = new FutureResults(Transaction_getMulti(getPtr(), packedKeys, keyLengths, isSnapshot), executor);
+		} finally {
+			pointerReadLock.unlock();
+		}
+		return range.thenApply(result -> result.get().values)
+				.whenComplete((result, e) -> range.close());
+	}
+
+	// Concatenates the given byte arrays, storing the length of each in lengths
+	private static byte[] pack(List<byte[]> arrays, int[] lengths) {
+		int total = 0;
+		for(int i = 0; i < lengths.length; i++) {
+			byte[] a = arrays.get(i);
+			if(a == null)
+				throw new IllegalArgumentException("Keys/Values must be non-null");
+			lengths[i] = a.length;
+			total += a.length;
+		}
+
+		byte[] packed = new byte[total];
+		int offset = 0;
+		for(int i = 0; i < lengths.length; i++) {
+			System.arraycopy(arrays.get(i), 0, packed, offset, lengths[i]);
+			offset += lengths[i];
+		}
+		return packed;
+	}
+
 	/**
 	 * {@inheritDoc}
 	 */
@@ -385,6 +435,28 @@ class FDBTransaction extends NativeObjectWrapper implements Transaction, OptionC
 		}
 	}
 
+	@Override
+	public void setMulti(List<KeyValue> keyValues) {
+		List<byte[]> keys = new ArrayList<>(keyValues.size());
+		List<byte[]> values = new ArrayList<>(keyValues.size());
+		for(KeyValue kv : keyValues) {
+			keys.add(kv.getKey());
+			values.add(kv.getValue());
+		}
+
+		int[] keyLengths = new int[keys.size()];
+		int[] valueLengths = new int[values.size()];
+		byte[] packedKeys = pack(keys, keyLengths);
+		byte[] packedValues = pack(values, valueLengths);
+
+		pointerReadLock.lock();
+		try {
+			Transaction_setMulti(getPtr(), packedKeys, keyLengths, packedValues, valueLengths);
+		} finally {
+			pointerReadLock.unlock();
+		}
+	}
+
 	@Override
 	public void clear(byte[] key) {
 		if(key == null)
@@ -581,6 +653,7 @@ class FDBTransaction extends NativeObjectWrapper implements Transaction, OptionC
 	private native long Transaction_getReadVersion(long cPtr);
 	private native  void Transaction_setVersion(long cPtr, long version);
 	private native long Transaction_get(long cPtr, byte[] key, boolean isSnapshot);
+	private native long Transaction_getMulti(long cPtr, byte[] keys, int[] keyLengths, boolean isSnapshot);
 	private native  long Transaction_getKey(long cPtr, byte[] key, boolean orEqual,
 			int offset, boolean isSnapshot);
 	private native long Transaction_getRange(long cPtr,
@@ -591,6 +664,7 @@ class FDBTransaction extends NativeObjectWrapper implements Transaction, OptionC
 	private native void Transaction_addConflictRange(long cPtr,
 			byte[] keyBegin, byte[] keyEnd, int conflictRangeType);
 	private native void Transaction_set(long cPtr, byte[] key, byte[] value);
+	private native void Transaction_setMulti(long cPtr, byte[] keys, int[] keyLengths, byte[] values, int[] valueLengths);
 	private native void Transaction_clear(long cPtr, byte[] key);
 	private native void Transaction_clear(long cPtr, byte[] beginKey, byte[] endKey);
 	private native void Transaction_mutate(long ptr, int code, byte[] key, byte[] value);
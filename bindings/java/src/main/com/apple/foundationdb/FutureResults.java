@@ -20,6 +20,7 @@
 
 package com.apple.foundationdb;
 
+import java.nio.ByteBuffer;
 import java.util.concurrent.Executor;
 
 class FutureResults extends NativeFuture<RangeResultInfo> {
@@ -57,6 +58,11 @@ class FutureResults extends NativeFuture<RangeResultInfo> {
 	public RangeResult getResults() {
 		try {
 			pointerReadLock.lock();
+			if(FDB.instance().useDirectBuffers) {
+				ByteBuffer buffer = ByteBuffer.allocateDirect(FutureResults_getDirectSize(getPtr()));
+				FutureResults_getDirect(getPtr(), buffer);
+				return new RangeResult(buffer);
+			}
 			return FutureResults_get(getPtr());
 		}
 		finally {
@@ -66,4 +72,6 @@ class FutureResults extends NativeFuture<RangeResultInfo> {
 
 	private native RangeResultSummary FutureResults_getSummary(long ptr) throws FDBException;
 	private native RangeResult FutureResults_get(long cPtr) throws FDBException;
+	private native int FutureResults_getDirectSize(long cPtr) throws FDBException;
+	private native void FutureResults_getDirect(long cPtr, ByteBuffer buffer) throws FDBException;
 }
@@ -20,6 +20,9 @@
 
 package com.apple.foundationdb;
 
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.util.AbstractList;
 import java.util.ArrayList;
 import java.util.List;
 
@@ -51,4 +54,58 @@ class RangeResult {
 		}
 		this.more = more;
 	}
+
+	// Wraps results laid out in a direct buffer by FutureResults_getDirect.  Each KeyValue is copied out of the
+	//  buffer only when it is first requested, so results that are never looked at cost nothing beyond one copy
+	//  out of the native client.
+	RangeResult(ByteBuffer buffer) {
+		buffer.order(ByteOrder.nativeOrder());
+		int count = buffer.getInt(0);
+		this.more = buffer.getInt(4) != 0;
+
+		int[] offsets = new int[count];
+		int offset = 8;
+		for(int i = 0; i < count; i++) {
+			offsets[i] = offset;
+			offset += 8 + buffer.getInt(offset) + buffer.getInt(offset + 4);
+		}
+		this.values = new DirectKeyValueList(buffer, offsets);
+	}
+
+	private static class DirectKeyValueList extends AbstractList<KeyValue> {
+		private final ByteBuffer buffer;
+		private final int[] offsets;
+		private final KeyValue[] decoded;
+
+		DirectKeyValueList(ByteBuffer buffer, int[] offsets) {
+			this.buffer = buffer;
+			this.offsets = offsets;
+			this.decoded = new KeyValue[offsets.length];
+		}
+
+		@Override
+		public synchronized KeyValue get(int index) {
+			if(decoded[index] == null) {
+				int offset = offsets[index];
+				int keyLength = buffer.getInt(offset);
+				int valueLength = buffer.getInt(offset + 4);
+
+				ByteBuffer source = buffer.duplicate();
+				source.position(offset + 8);
+
+				byte[] k = new byte[keyLength];
+				source.get(k);
+				byte[] v = new byte[valueLength];
+				source.get(v);
+
+				decoded[index] = new KeyValue(k, v);
+			}
+			return decoded[index];
+		}
+
+		@Override
+		public int size() {
+			return offsets.length;
+		}
+	}
 }
@@ -20,6 +20,7 @@
 
 package com.apple.foundationdb;
 
+import java.util.List;
 import java.util.concurrent.CompletableFuture;
 
 import com.apple.foundationdb.async.AsyncIterable;
@@ -60,6 +61,18 @@ public interface ReadTransaction extends ReadTransactionContext {
 	 */
 	CompletableFuture<byte[]> get(byte[] key);
 
+	/**
+	 * Gets the values of several keys from the database with a single request. This
+	 *  has the same result as calling {@link #get(byte[])} for each key, but crosses
+	 *  into the native client once for the whole batch.
+	 *
+	 * @param keys the keys whose values to fetch from the database
+	 *
+	 * @return a {@code CompletableFuture} which will be set to the keys that are present
+	 *  in the database and their values, in the order they were requested.
+	 */
+	CompletableFuture<List<KeyValue>> getMulti(List<byte[]> keys);
+
 	/**
 	 * Returns the key referenced by the specified {@code KeySelector}.
 	 *  By default, the key is cached for the duration of the transaction, providing
@@ -20,6 +20,7 @@
 
 package com.apple.foundationdb;
 
+import java.util.List;
 import java.util.concurrent.CompletableFuture;
 import java.util.function.Function;
 
@@ -151,6 +152,18 @@ public interface Transaction extends AutoCloseable, ReadTransaction, Transaction
 	 */
 	void set(byte[] key, byte[] value);
 
+	/**
+	 * Sets the values for several keys. This has the same effect as calling
+	 *  {@link #set(byte[], byte[])} for each key, but crosses into the native
+	 *  client once for the whole batch.
+	 *
+	 * @param keyValues the keys whose values are to be set and the values to set them to
+	 *
+	 * @throws IllegalArgumentException if {@code keyValues} or any key or value is {@code null}
+	 * @throws FDBException if the set operation otherwise fails
+	 */
+	void setMulti(List<KeyValue> keyValues);
+
 	/**
 	 * Clears a given key from the database. This will not affect the
 	 * database until {@link #commit} is called.
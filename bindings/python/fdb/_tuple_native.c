@@ -0,0 +1,555 @@
+/*
+ * _tuple_native.c
+ *
+ * This source file is part of the FoundationDB open source project
+ *
+ * Copyright 2013-2018 Apple Inc. and the FoundationDB project authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Optional accelerator for fdb.tuple.  pack() and unpack() here produce exactly the same results as the pure Python
+ * implementation in tuple.py, which passes in its own _encode and _decode functions.  Those are called for every
+ * element this module does not handle itself (UUIDs, single floats, versionstamps, integers that do not fit in 64
+ * bits, subclasses of the built in types, and malformed input), so the two implementations cannot disagree about
+ * anything but speed.
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if PY_MAJOR_VERSION < 3
+#include <bytesobject.h>
+#endif
+
+#define NULL_CODE 0x00
+#define BYTES_CODE 0x01
+#define STRING_CODE 0x02
+#define NESTED_CODE 0x05
+#define NEG_INT_START 0x0b
+#define INT_ZERO_CODE 0x14
+#define POS_INT_END 0x1d
+#define DOUBLE_CODE 0x21
+#define FALSE_CODE 0x26
+#define TRUE_CODE 0x27
+
+/* A growable output buffer */
+typedef struct {
+	char* data;
+	Py_ssize_t size;
+	Py_ssize_t capacity;
+} Buffer;
+
+static int buffer_reserve(Buffer* b, Py_ssize_t extra) {
+	Py_ssize_t capacity;
+	char* data;
+
+	if(b->size + extra <= b->capacity)
+		return 0;
+
+	capacity = b->capacity ? b->capacity : 64;
+	while(capacity < b->size + extra)
+		capacity *= 2;
+
+	data = (char*)PyMem_Realloc(b->data, capacity);
+	if(!data) {
+		PyErr_NoMemory();
+		return -1;
+	}
+	b->data = data;
+	b->capacity = capacity;
+	return 0;
+}
+
+static int buffer_append(Buffer* b, const char* data, Py_ssize_t length) {
+	if(buffer_reserve(b, length) < 0)
+		return -1;
+	memcpy(b->data + b->size, data, length);
+	b->size += length;
+	return 0;
+}
+
+static int buffer_append_byte(Buffer* b, unsigned char c) {
+	if(buffer_reserve(b, 1) < 0)
+		return -1;
+	b->data[b->size++] = (char)c;
+	return 0;
+}
+
+/* Appends data with every \x00 escaped as \x00\xff, followed by the \x00 terminator */
+static int buffer_append_escaped(Buffer* b, const char* data, Py_ssize_t length) {
+	const char* end = data + length;
+	const char* zero;
+
+	while((zero = (const char*)memchr(data, 0, end - data)) != NULL) {
+		if(buffer_append(b, data, zero - data + 1) < 0 || buffer_append_byte(b, 0xff) < 0)
+			return -1;
+		data = zero + 1;
+	}
+	if(buffer_append(b, data, end - data) < 0)
+		return -1;
+	return buffer_append_byte(b, 0x00);
+}
+
+static int buffer_append_uint(Buffer* b, unsigned char code, unsigned PY_LONG_LONG value, int n) {
+	int i;
+	if(buffer_reserve(b, n + 1) < 0)
+		return -1;
+	b->data[b->size++] = (char)code;
+	for(i = n - 1; i >= 0; i--)
+		b->data[b->size++] = (char)((value >> (8 * i)) & 0xff);
+	return 0;
+}
+
+typedef struct {
+	PyObject* encode;  /* tuple._encode */
+	int bools_as_ints;
+	Py_ssize_t version_pos;
+} PackState;
+
+/* Records the position of an incomplete versionstamp the same way tuple._reduce_children does */
+static int record_version_pos(PackState* s, Py_ssize_t pos) {
+	if(s->version_pos >= 0) {
+		PyErr_SetString(PyExc_ValueError, "Multiple incomplete versionstamps included in tuple");
+		return -1;
+	}
+	s->version_pos = pos;
+	return 0;
+}
+
+static int encode_fallback(PackState* s, Buffer* b, PyObject* value, int nested) {
+	PyObject* result;
+	PyObject* bytes;
+	Py_ssize_t pos;
+	Py_ssize_t start = b->size;
+	int ret = -1;
+
+	result = PyObject_CallFunction(s->encode, "OO", value, nested ? Py_True : Py_False);
+	if(!result)
+		return -1;
+
+	if(!PyTuple_Check(result) || PyTuple_GET_SIZE(result) != 2 || !PyBytes_Check(PyTuple_GET_ITEM(result, 0))) {
+		PyErr_SetString(PyExc_TypeError, "tuple encoder returned an unexpected result");
+		goto done;
+	}
+
+	bytes = PyTuple_GET_ITEM(result, 0);
+	pos = PyNumber_AsSsize_t(PyTuple_GET_ITEM(result, 1), NULL);
+	if(pos == -1 && PyErr_Occurred())
+		goto done;
+
+	if(buffer_append(b, PyBytes_AS_STRING(bytes), PyBytes_GET_SIZE(bytes)) < 0)
+		goto done;
+	if(pos >= 0 && record_version_pos(s, start + pos) < 0)
+		goto done;
+	ret = 0;
+
+done:
+	Py_DECREF(result);
+	return ret;
+}
+
+static int encode_int(PackState* s, Buffer* b, PyObject* value, int nested) {
+	static const unsigned PY_LONG_LONG max_uint64 = ~(unsigned PY_LONG_LONG)0;
+	int overflow;
+	int n;
+	PY_LONG_LONG v = PyLong_AsLongLongAndOverflow(value, &overflow);
+	unsigned PY_LONG_LONG magnitude;
+
+	if(v == -1 && PyErr_Occurred())
+		return -1;
+	if(overflow)
+		return encode_fallback(s, b, value, nested);
+
+	if(v == 0)
+		return buffer_append_byte(b, INT_ZERO_CODE);
+
+	magnitude = v > 0 ? (unsigned PY_LONG_LONG)v : (unsigned PY_LONG_LONG)(-(v + 1)) + 1;
+	for(n = 1; n < 8 && (magnitude >> (8 * n)) != 0; n++) {}
+
+	if(v > 0)
+		return buffer_append_uint(b, INT_ZERO_CODE + n, magnitude, n);
+
+	/* Negative integers are stored as the one's complement of their magnitude in n bytes */
+	return buffer_append_uint(b, INT_ZERO_CODE - n, (max_uint64 >> (8 * (8 - n))) - magnitude, n);
+}
+
+static int encode_double(Buffer* b, double d) {
+	unsigned PY_LONG_LONG bits;
+	memcpy(&bits, &d, sizeof(bits));
+
+	/* Flip all of the bits of negative numbers and just the sign bit of the rest, so that the bytes sort like the values */
+	if(bits >> 63)
+		bits = ~bits;
+	else
+		bits ^= (unsigned PY_LONG_LONG)1 << 63;
+
+	return buffer_append_uint(b, DOUBLE_CODE, bits, 8);
+}
+
+static int encode_value(PackState* s, Buffer* b, PyObject* value, int nested);
+
+static int encode_sequence(PackState* s, Buffer* b, PyObject* seq, int nested) {
+	Py_ssize_t i;
+	Py_ssize_t length = PySequence_Fast_GET_SIZE(seq);
+	PyObject** items = PySequence_Fast_ITEMS(seq);
+
+	for(i = 0; i < length; i++) {
+		if(encode_value(s, b, items[i], nested) < 0)
+			return -1;
+	}
+	return 0;
+}
+
+static int encode_value(PackState* s, Buffer* b, PyObject* value, int nested) {
+	if(value == Py_None) {
+		if(buffer_append_byte(b, NULL_CODE) < 0)
+			return -1;
+		return nested ? buffer_append_byte(b, 0xff) : 0;
+	}
+	else if(PyBytes_CheckExact(value)) {
+		if(buffer_append_byte(b, BYTES_CODE) < 0)
+			return -1;
+		return buffer_append_escaped(b, PyBytes_AS_STRING(value), PyBytes_GET_SIZE(value));
+	}
+	else if(PyUnicode_CheckExact(value)) {
+		PyObject* utf8 = PyUnicode_AsUTF8String(value);
+		int ret;
+		if(!utf8)
+			return -1;
+		ret = buffer_append_byte(b, STRING_CODE);
+		if(ret == 0)
+			ret = buffer_append_escaped(b, PyBytes_AS_STRING(utf8), PyBytes_GET_SIZE(utf8));
+		Py_DECREF(utf8);
+		return ret;
+	}
+	else if(PyBool_Check(value)) {
+		/* Before API version 500, booleans were encoded as the integers 0 and 1 */
+		if(s->bools_as_ints)
+			return value == Py_True ? buffer_append_uint(b, INT_ZERO_CODE + 1, 1, 1) : buffer_append_byte(b, INT_ZERO_CODE);
+		return buffer_append_byte(b, value == Py_True ? TRUE_CODE : FALSE_CODE);
+	}
+	else if(PyLong_CheckExact(value)) {
+		return encode_int(s, b, value, nested);
+	}
+	else if(PyFloat_CheckExact(value)) {
+		return encode_double(b, PyFloat_AS_DOUBLE(value));
+	}
+	else if(PyTuple_CheckExact(value) || PyList_CheckExact(value)) {
+		/* tuple._encode reports the versionstamp position of a nested tuple without counting its type code, so this
+		   does the same */
+		Py_ssize_t outer_pos = s->version_pos;
+		int ret;
+
+		if(buffer_append_byte(b, NESTED_CODE) < 0)
+			return -1;
+
+		s->version_pos = -1;
+		ret = encode_sequence(s, b, value, 1);
+		if(ret == 0 && s->version_pos >= 0) {
+			Py_ssize_t inner_pos = s->version_pos - 1;
+			s->version_pos = outer_pos;
+			ret = record_version_pos(s, inner_pos);
+		}
+		else if(ret == 0) {
+			s->version_pos = outer_pos;
+		}
+
+		if(ret < 0)
+			return -1;
+		return buffer_append_byte(b, 0x00);
+	}
+
+	return encode_fallback(s, b, value, nested);
+}
+
+/* pack(t, prefix, encode, bools_as_ints) -> (bytes, version_pos).  This is tuple._pack_maybe_with_versionstamp except that
+   the position of an incomplete versionstamp is returned without being appended to the bytes. */
+static PyObject* tuple_pack(PyObject* self, PyObject* args) {
+	PyObject* t;
+	PyObject* prefix;
+	PackState s;
+	Buffer b = { NULL, 0, 0 };
+	PyObject* result = NULL;
+	Py_ssize_t prefix_length = 0;
+
+	if(!PyArg_ParseTuple(args, "O!OOi", &PyTuple_Type, &t, &prefix, &s.encode, &s.bools_as_ints))
+		return NULL;
+	s.version_pos = -1;
+
+	if(prefix != Py_None) {
+		if(!PyBytes_Check(prefix)) {
+			PyErr_SetString(PyExc_TypeError, "tuple prefix must be a byte string");
+			return NULL;
+		}
+		prefix_length = PyBytes_GET_SIZE(prefix);
+		if(buffer_append(&b, PyBytes_AS_STRING(prefix), prefix_length) < 0)
+			goto done;
+	}
+
+	if(encode_sequence(&s, &b, t, 0) < 0)
+		goto done;
+
+	result = PyBytes_FromStringAndSize(b.data ? b.data : "", b.size);
+	if(result)
+		result = Py_BuildValue("(Nn)", result, s.version_pos);
+
+done:
+	PyMem_Free(b.data);
+	return result;
+}
+
+typedef struct {
+	PyObject* key;  /* The whole byte string being decoded */
+	PyObject* decode;  /* tuple._decode */
+	const unsigned char* data;
+	Py_ssize_t length;
+	int allow_bools;
+} UnpackState;
+
+static PyObject* decode_fallback(UnpackState* s, Py_ssize_t* pos) {
+	PyObject* result = PyObject_CallFunction(s->decode, "On", s->key, *pos);
+	PyObject* value;
+	Py_ssize_t new_pos;
+
+	if(!result)
+		return NULL;
+	if(!PyTuple_Check(result) || PyTuple_GET_SIZE(result) != 2) {
+		Py_DECREF(result);
+		PyErr_SetString(PyExc_TypeError, "tuple decoder returned an unexpected result");
+		return NULL;
+	}
+
+	new_pos = PyNumber_AsSsize_t(PyTuple_GET_ITEM(result, 1), NULL);
+	if(new_pos == -1 && PyErr_Occurred()) {
+		Py_DECREF(result);
+		return NULL;
+	}
+
+	value = PyTuple_GET_ITEM(result, 0);
+	Py_INCREF(value);
+	Py_DECREF(result);
+	*pos = new_pos;
+	return value;
+}
+
+/* Returns the position of the \x00 that ends the escaped string starting at pos, or the end of the data */
+static Py_ssize_t find_terminator(UnpackState* s, Py_ssize_t pos) {
+	while(1) {
+		const unsigned char* zero = (const unsigned char*)memchr(s->data + pos, 0, s->length - pos);
+		if(!zero)
+			return s->length;
+		pos = zero - s->data;
+		if(pos + 1 == s->length || s->data[pos + 1] != 0xff)
+			return pos;
+		pos += 2;
+	}
+}
+
+static PyObject* decode_escaped(UnpackState* s, Py_ssize_t* pos) {
+	Py_ssize_t start = *pos + 1;
+	Py_ssize_t end = find_terminator(s, start);
+	Py_ssize_t i, out = 0;
+	PyObject* bytes = PyBytes_FromStringAndSize(NULL, end - start);
+	char* dest;
+
+	if(!bytes)
+		return NULL;
+
+	dest = PyBytes_AS_STRING(bytes);
+	for(i = start; i < end; i++) {
+		dest[out++] = (char)s->data[i];
+		if(s->data[i] == 0x00)
+			i++;  /* Skip the \xff that escapes it */
+	}
+	if(out != end - start && _PyBytes_Resize(&bytes, out) < 0)
+		return NULL;
+
+	*pos = end + 1;
+	return bytes;
+}
+
+static PyObject* decode_value(UnpackState* s, Py_ssize_t* pos);
+
+static PyObject* decode_nested(UnpackState* s, Py_ssize_t* pos) {
+	PyObject* list = PyList_New(0);
+	PyObject* result;
+	Py_ssize_t end_pos = *pos + 1;
+
+	if(!list)
+		return NULL;
+
+	while(end_pos < s->length) {
+		PyObject* value;
+		if(s->data[end_pos] == 0x00) {
+			if(end_pos + 1 < s->length && s->data[end_pos + 1] == 0xff) {
+				Py_INCREF(Py_None);
+				value = Py_None;
+				end_pos += 2;
+			}
+			else {
+				break;
+			}
+		}
+		else {
+			value = decode_value(s, &end_pos);
+			if(!value) {
+				Py_DECREF(list);
+				return NULL;
+			}
+		}
+
+		if(PyList_Append(list, value) < 0) {
+			Py_DECREF(value);
+			Py_DECREF(list);
+			return NULL;
+		}
+		Py_DECREF(value);
+	}
+
+	result = PyList_AsTuple(list);
+	Py_DECREF(list);
+	*pos = end_pos + 1;
+	return result;
+}
+
+static PyObject* decode_value(UnpackState* s, Py_ssize_t* pos) {
+	unsigned char code = s->data[*pos];
+
+	if(code == NULL_CODE) {
+		*pos += 1;
+		Py_INCREF(Py_None);
+		return Py_None;
+	}
+	else if(code == BYTES_CODE) {
+		return decode_escaped(s, pos);
+	}
+	else if(code == STRING_CODE) {
+		PyObject* bytes = decode_escaped(s, pos);
+		PyObject* text;
+		if(!bytes)
+			return NULL;
+		text = PyUnicode_DecodeUTF8(PyBytes_AS_STRING(bytes), PyBytes_GET_SIZE(bytes), "strict");
+		Py_DECREF(bytes);
+		return text;
+	}
+	else if(code > NEG_INT_START && code < POS_INT_END && *pos + 1 + abs((int)code - INT_ZERO_CODE) <= s->length) {
+		int n = abs((int)code - INT_ZERO_CODE);
+		unsigned PY_LONG_LONG v = 0;
+		int i;
+
+		for(i = 0; i < n; i++)
+			v = (v << 8) | s->data[*pos + 1 + i];
+		*pos += 1 + n;
+
+		if(code >= INT_ZERO_CODE)
+			return PyLong_FromUnsignedLongLong(v);
+
+		/* The stored bytes are the one's complement of the magnitude */
+		v = (n == 8 ? ~(unsigned PY_LONG_LONG)0 : (((unsigned PY_LONG_LONG)1 << (8 * n)) - 1)) - v;
+		if(v <= (unsigned PY_LONG_LONG)PY_LLONG_MAX)
+			return PyLong_FromLongLong(-(PY_LONG_LONG)v);
+		else {
+			PyObject* magnitude = PyLong_FromUnsignedLongLong(v);
+			PyObject* negated;
+			if(!magnitude)
+				return NULL;
+			negated = PyNumber_Negative(magnitude);
+			Py_DECREF(magnitude);
+			return negated;
+		}
+	}
+	else if(code == DOUBLE_CODE && *pos + 9 <= s->length) {
+		unsigned PY_LONG_LONG bits = 0;
+		double d;
+		int i;
+
+		for(i = 0; i < 8; i++)
+			bits = (bits << 8) | s->data[*pos + 1 + i];
+		if(bits >> 63)
+			bits ^= (unsigned PY_LONG_LONG)1 << 63;
+		else
+			bits = ~bits;
+		memcpy(&d, &bits, sizeof(d));
+
+		*pos += 9;
+		return PyFloat_FromDouble(d);
+	}
+	else if((code == FALSE_CODE || code == TRUE_CODE) && s->allow_bools) {
+		*pos += 1;
+		return PyBool_FromLong(code == TRUE_CODE);
+	}
+	else if(code == NESTED_CODE) {
+		return decode_nested(s, pos);
+	}
+
+	return decode_fallback(s, pos);
+}
+
+/* unpack(key, prefix_len, decode, allow_bools) -> tuple, as tuple.unpack */
+static PyObject* tuple_unpack(PyObject* self, PyObject* args) {
+	UnpackState s;
+	Py_ssize_t pos;
+	PyObject* list;
+	PyObject* result;
+
+	if(!PyArg_ParseTuple(args, "SnOi", &s.key, &pos, &s.decode, &s.allow_bools))
+		return NULL;
+	if(pos < 0) {
+		PyErr_SetString(PyExc_ValueError, "prefix length must not be negative");
+		return NULL;
+	}
+	s.data = (const unsigned char*)PyBytes_AS_STRING(s.key);
+	s.length = PyBytes_GET_SIZE(s.key);
+
+	list = PyList_New(0);
+	if(!list)
+		return NULL;
+
+	while(pos < s.length) {
+		PyObject* value = decode_value(&s, &pos);
+		if(!value || PyList_Append(list, value) < 0) {
+			Py_XDECREF(value);
+			Py_DECREF(list);
+			return NULL;
+		}
+		Py_DECREF(value);
+	}
+
+	result = PyList_AsTuple(list);
+	Py_DECREF(list);
+	return result;
+}
+
+static PyMethodDef tuple_native_methods[] = {
+	{ "pack", tuple_pack, METH_VARARGS, "Packs a tuple, returning the bytes and the position of an incomplete versionstamp or -1." },
+	{ "unpack", tuple_unpack, METH_VARARGS, "Unpacks a byte string into a tuple." },
+	{ NULL, NULL, 0, NULL }
+};
+
+#if PY_MAJOR_VERSION >= 3
+static struct PyModuleDef tuple_native_module = {
+	PyModuleDef_HEAD_INIT, "_tuple_native", NULL, -1, tuple_native_methods, NULL, NULL, NULL, NULL
+};
+
+PyMODINIT_FUNC PyInit__tuple_native(void) {
+	return PyModule_Create(&tuple_native_module);
+}
+#else
+PyMODINIT_FUNC init_tuple_native(void) {
+	Py_InitModule("_tuple_native", tuple_native_methods);
+}
+#endif
@@ -20,6 +20,7 @@
 
 # FoundationDB Python API
 
+import os
 import random
 import struct
 import threading
@@ -37,11 +38,22 @@ class AllocatorTransactionState:
 
 class HighContentionAllocator (object):
 
-    def __init__(self, subspace):
+    def __init__(self, subspace, batch_size=1):
         self.counters = subspace[0]
         self.recent = subspace[1]
         self.lock = threading.Lock()
 
+        # With a batch_size above 1, prefixes are leased batch_size at a time
+        # in a transaction of their own and then handed out from
+        # [_lease_next, _lease_end) without touching the database, so that
+        # these allocations do not conflict with each other.  Leased prefixes
+        # that are never handed out are not reused.
+        self.batch_size = batch_size
+        self._lease_lock = threading.Lock()
+        self._lease_db = None
+        self._lease_next = 0
+        self._lease_end = 0
+
     @_impl.transactional
     def allocate(self, tr):
         """Returns a byte string that
@@ -50,6 +62,18 @@ class HighContentionAllocator (object):
             2) is nearly as short as possible given the above
         """
 
+        if self.batch_size > 1:
+            with self._lease_lock:
+                # Prefixes leased from one database are of no use in another
+                if self._lease_db is not tr.db:
+                    self._lease_db = tr.db
+                    self._lease_next = self._lease_end = 0
+                if self._lease_next == self._lease_end:
+                    self._lease_next, self._lease_end = self._lease(tr.db)
+                candidate = self._lease_next
+                self._lease_next += 1
+            return fdb.tuple.pack((candidate,))
+
         # Get transaction-local state
         if not hasattr(tr, "__fdb_directory_layer_hca_state__"):
             with self.lock:
@@ -107,6 +131,26 @@ class HighContentionAllocator (object):
                     tr.add_write_conflict_key(self.recent[candidate])
                     return fdb.tuple.pack((candidate,))
 
+    @_impl.transactional
+    def _lease(self, tr):
+        # Not a snapshot read, so that leases and window advances by other
+        # clients are serialized with this one
+        [start] = [self.counters.unpack(k)[0] for k, _ in tr.get_range(
+            self.counters.range().start, self.counters.range().stop, limit=1, reverse=True)] or [0]
+
+        # The lease begins past the current window, so candidates being tried
+        # in it cannot fall in the lease, and the next window of allocate()
+        # begins where it ends.  Clearing the recent candidates below that
+        # with a conflict range makes an allocation that picked a candidate in
+        # the lease from a stale window conflict.
+        lease_start = start + self._window_size(start)
+        lease_end = lease_start + self.batch_size
+        del tr[self.counters: self.counters[lease_end]]
+        del tr[self.recent: self.recent[lease_end]]
+        tr.add(self.counters[lease_end], struct.pack("<q", 0))
+
+        return lease_start, lease_end
+
     def _window_size(self, start):
         # Larger window sizes are better for high contention, smaller sizes for
         # keeping the keys small.  But if there are many allocations, the keys
@@ -204,7 +248,7 @@ class Directory(object):
 
 class DirectoryLayer(Directory):
 
-    def __init__(self, node_subspace=Subspace(rawPrefix=b'\xfe'), content_subspace=Subspace(), allow_manual_prefixes=False):
+    def __init__(self, node_subspace=Subspace(rawPrefix=b'\xfe'), content_subspace=Subspace(), allow_manual_prefixes=False, prefix_batch_size=1):
         Directory.__init__(self, self)
 
         # If specified, new automatically allocated prefixes will all fall within content_subspace
@@ -215,7 +259,10 @@ class DirectoryLayer(Directory):
 
         # The root node is the one whose contents are the node subspace
         self._root_node = self._node_subspace[self._node_subspace.key()]
-        self._allocator = HighContentionAllocator(self._root_node[b'hca'])
+        # A prefix_batch_size above 1 leases prefixes for new directories that
+        # many at a time, so that concurrent creations do not conflict on the
+        # allocator
+        self._allocator = HighContentionAllocator(self._root_node[b'hca'], prefix_batch_size)
 
     @_impl.transactional
     def create_or_open(self, tr, path, layer=None):
@@ -291,6 +338,7 @@ class DirectoryLayer(Directory):
             layer = b''
 
         tr[node[b'layer']] = layer
+        self._set_metadata_version(tr)
 
         return self._contents_of_node(node, path, layer)
 
@@ -361,6 +409,7 @@ class DirectoryLayer(Directory):
         if not parent_node.exists():
             raise ValueError("The parent of the destination directory does not exist. Create it first.")
         tr[parent_node.subspace[self.SUBDIRS][new_path[-1]]] = self._node_subspace.unpack(old_node.subspace.key())[0]
+        self._set_metadata_version(tr)
         self._remove_from_parent(tr, old_path)
         return self._contents_of_node(old_node.subspace, new_path, old_node.layer())
 
@@ -466,6 +515,12 @@ class DirectoryLayer(Directory):
     def _initialize_directory(self, tr):
         tr[self._root_node[b'version']] = struct.pack('<III', *self.VERSION)
 
+    def _set_metadata_version(self, tr):
+        # Every change to the tree of directories sets this key to a new
+        # random value, so that clients caching the paths they have found can
+        # tell whether their cache is still valid
+        tr[self._root_node[b'metadataVersion']] = os.urandom(16)
+
     def _node_containing_key(self, tr, key):
         # Right now this is only used for _is_prefix_free(), but if we add
         # parent pointers to directory nodes, it could also be used to find a
@@ -510,6 +565,7 @@ class DirectoryLayer(Directory):
     def _remove_from_parent(self, tr, path):
         parent = self._find(tr, path[:-1])
         del tr[parent.subspace[self.SUBDIRS][path[-1]]]
+        self._set_metadata_version(tr)
 
     def _remove_recursive(self, tr, node):
         for name, sn in self._subdir_names_and_nodes(tr, node):
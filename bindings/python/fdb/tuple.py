@@ -29,6 +29,13 @@ from bisect import bisect_left
 from fdb import six
 import fdb
 
+# The C extension, when it was built, packs and unpacks the common types itself and calls
+# _encode and _decode below for everything else.
+try:
+    from fdb import _tuple_native
+except ImportError:
+    _tuple_native = None
+
 _size_limits = tuple((1 << (i * 8)) - 1 for i in range(9))
 
 # Define type codes:
@@ -378,6 +385,12 @@ def _pack_maybe_with_versionstamp(t, prefix=None):
     if not isinstance(t, tuple):
         raise Exception("fdbtuple pack() expects a tuple, got a " + str(type(t)))
 
+    if _tuple_native is not None:
+        res, version_pos = _tuple_native.pack(t, prefix, _encode, hasattr(fdb, '_version') and fdb._version < 500)
+        if version_pos >= 0:
+            res += struct.pack('<H', version_pos)
+        return res, version_pos
+
     bytes_list = [prefix] if prefix is not None else []
 
     child_bytes, version_pos = _reduce_children(map(_encode, t))
@@ -409,6 +422,9 @@ def pack_with_versionstamp(t, prefix=None):
 
 # unpacks the specified key into a tuple
 def unpack(key, prefix_len=0):
+    if _tuple_native is not None and isinstance(key, bytes) and prefix_len >= 0:
+        return _tuple_native.unpack(key, prefix_len, _decode, not (fdb.is_api_version_selected() and fdb.get_api_version() < 500))
+
     pos = prefix_len
     res = []
     while pos < len(key):
@@ -30,6 +30,7 @@ import uuid
 
 _range = range
 
+import fdb.tuple
 from fdb.tuple import pack, unpack, range, compare, SingleFloat
 from fdb import six
 
@@ -176,6 +177,33 @@ def tupleTest(N=10000):
     print ("Tuple check %d OK" % N)
     return True
 
+def nativeTest(N=10000):
+    native = fdb.tuple._tuple_native
+    if native is None:
+        print("Native tuple module not built; skipping")
+        return True
+
+    def with_native(enabled, f, *args):
+        fdb.tuple._tuple_native = native if enabled else None
+        try:
+            return f(*args)
+        finally:
+            fdb.tuple._tuple_native = native
+
+    for i in _range(N):
+        t = randomTuple()
+        p = with_native(False, pack, t)
+        if with_native(True, pack, t) != p:
+            print("native pack differs:\n    Tuple:  %s\n    Bytes:  %s\n    Native: %s" % (t, repr(p), repr(with_native(True, pack, t))))
+            return False
+        if repr(with_native(True, unpack, p)) != repr(with_native(False, unpack, p)):
+            print("native unpack differs:\n    Bytes:  %s\n    Tuple:  %s\n    Native: %s" %
+                  (repr(p), with_native(False, unpack, p), with_native(True, unpack, p)))
+            return False
+
+    print("Native check %d OK" % N)
+    return True
+
 # test:
 # a = ('\x00a', -2, 'b\x01', 12345, '')
 # assert(a==fdbtuple.unpack(fdbtuple.pack(a)))
@@ -183,3 +211,4 @@ def tupleTest(N=10000):
 
 if __name__ == '__main__':
     assert tupleTest(10000)
+    assert nativeTest(10000)
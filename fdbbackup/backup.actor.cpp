@@ -34,6 +34,7 @@
 #include "fdbclient/RunTransaction.actor.h"
 #include "fdbrpc/Platform.h"
 #include "fdbrpc/BlobStore.h"
+#include "fdbrpc/TraceBlockCodec.h"
 #include "fdbclient/json_spirit/json_spirit_writer_template.h"
 
 #include <stdarg.h>
@@ -750,7 +751,8 @@ static void printBackupUsage(bool devhelp) {
 		printf("  --parentpid PID\n");
 		printf("                 Specify a process after whose termination to exit.\n");
 #endif
-		printf("  --deep         For describe operations, do not use cached metadata.  Warning: Very slow\n");
+		printf("  --deep         For describe operations, do not use cached metadata, and check that every range file of each\n"
+		       "                 snapshot is present with its recorded size.  Warning: Slow on large backups\n");
 		
 	}
 	printf("\n"
@@ -2712,8 +2714,10 @@ int main(int argc, char* argv[]) {
 		// For most modes, initCluster() will open a trace file, but some fdbbackup operations do not require
 		// a cluster so they should use this instead.
 		auto initTraceFile = [&]() {
-			if(trace)
+			if(trace) {
+				setTraceBlockCodec( zlibTraceBlockCodec() );
 				openTraceFile(NetworkAddress(), traceRollSize, traceMaxLogsSize, traceDir, "trace", traceLogGroup);
+			}
 		};
 
 		auto initCluster = [&](bool quiet = false) {
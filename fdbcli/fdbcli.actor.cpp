@@ -34,6 +34,8 @@
 #include "flow/SignalSafeUnwind.h"
 #include "fdbrpc/TLSConnection.h"
 #include "fdbrpc/Platform.h"
+#include "fdbrpc/IAsyncFile.h"
+#include "flow/ActorCollection.h"
 
 #include "flow/SimpleOpt.h"
 
@@ -438,9 +440,9 @@ void initHelp() {
 		"clear a range of keys from the database",
 		"All keys between BEGINKEY (inclusive) and ENDKEY (exclusive) are cleared from the database. This command will succeed even if the specified range is empty, but may fail because of conflicts." ESCAPINGK);
 	helpMap["configure"] = CommandHelp(
-		"configure [new] <single|double|triple|three_data_hall|three_datacenter|ssd|memory|proxies=<PROXIES>|logs=<LOGS>|resolvers=<RESOLVERS>>*",
+		"configure [new] <single|double|triple|three_data_hall|three_datacenter|ssd|ssd-lsm|memory|proxies=<PROXIES>|grv_proxies=<GRV_PROXIES>|logs=<LOGS>|resolvers=<RESOLVERS>>*",
 		"change database configuration",
-		"The `new' option, if present, initializes a new database with the given configuration rather than changing the configuration of an existing one. When used, both a redundancy mode and a storage engine must be specified.\n\nRedundancy mode:\n  single - one copy of the data.  Not fault tolerant.\n  double - two copies of data (survive one failure).\n  triple - three copies of data (survive two failures).\n  three_data_hall - See the Admin Guide.\n  three_datacenter - See the Admin Guide.\n\nStorage engine:\n  ssd - B-Tree storage engine optimized for solid state disks.\n  memory - Durable in-memory storage engine for small datasets.\n\nproxies=<PROXIES>: Sets the desired number of proxies in the cluster. Must be at least 1, or set to -1 which restores the number of proxies to the default value.\n\nlogs=<LOGS>: Sets the desired number of log servers in the cluster. Must be at least 1, or set to -1 which restores the number of logs to the default value.\n\nresolvers=<RESOLVERS>: Sets the desired number of resolvers in the cluster. Must be at least 1, or set to -1 which restores the number of resolvers to the default value.\n\nSee the FoundationDB Administration Guide for more information.");
+		"The `new' option, if present, initializes a new database with the given configuration rather than changing the configuration of an existing one. When used, both a redundancy mode and a storage engine must be specified.\n\nRedundancy mode:\n  single - one copy of the data.  Not fault tolerant.\n  double - two copies of data (survive one failure).\n  triple - three copies of data (survive two failures).\n  three_data_hall - See the Admin Guide.\n  three_datacenter - See the Admin Guide.\n\nStorage engine:\n  ssd - B-Tree storage engine optimized for solid state disks.\n  ssd-lsm - Log-structured merge tree storage engine optimized for write-heavy workloads.\n  memory - Durable in-memory storage engine for small datasets.\n\nproxies=<PROXIES>: Sets the desired number of proxies in the cluster. Must be at least 1, or set to -1 which restores the number of proxies to the default value.\n\ngrv_proxies=<GRV_PROXIES>: Sets the desired number of GRV proxies, which hand out read versions in place of the proxies. Set to -1 to restore the default of 0, where the proxies hand out read versions.\n\nlogs=<LOGS>: Sets the desired number of log servers in the cluster. Must be at least 1, or set to -1 which restores the number of logs to the default value.\n\nresolvers=<RESOLVERS>: Sets the desired number of resolvers in the cluster. Must be at least 1, or set to -1 which restores the number of resolvers to the default value.\n\nSee the FoundationDB Administration Guide for more information.");
 	helpMap["coordinators"] = CommandHelp(
 		"coordinators auto|<ADDRESS>+ [description=new_cluster_description]",
 		"change cluster coordinators or description",
@@ -477,6 +479,18 @@ void initHelp() {
 		"getrangekeys <BEGINKEY> [ENDKEY] [LIMIT]",
 		"fetch keys in a range of keys",
 		"Displays up to LIMIT keys for keys between BEGINKEY (inclusive) and ENDKEY (exclusive). If ENDKEY is omitted, then the range will include all keys starting with BEGINKEY. LIMIT defaults to 25 if omitted." ESCAPINGK);
+	helpMap["export"] = CommandHelp(
+		"export <BEGINKEY> <ENDKEY> <FILE> [PARALLELISM]",
+		"write the key-value pairs in a range to a file",
+		"Writes the key-value pairs with keys between BEGINKEY (inclusive) and ENDKEY (exclusive) to FILE, one pair per line as two quoted and escaped strings that `import' can read. The shards of the range are read concurrently by up to PARALLELISM transactions, 16 if omitted, so the lines are not in key order, and a range that takes longer than a transaction can last to read is not read at a single version." ESCAPINGK);
+	helpMap["import"] = CommandHelp(
+		"import <FILE> [PARALLELISM]",
+		"set the key-value pairs in a file",
+		"Sets the key-value pairs in FILE, which has one pair per line like the files written by `export', using up to PARALLELISM transactions at a time, 16 if omitted. The pairs are set in batches which each fit in a transaction and do not cross shard boundaries, so the import is not atomic, but it can be repeated if it fails. If a key appears more than once, the last value in the file is the one that is set. Requires writemode to be enabled." ESCAPINGK);
+	helpMap["hotkeys"] = CommandHelp(
+		"hotkeys [LIMIT]",
+		"display the most read and written key ranges",
+		"Displays up to LIMIT of the key ranges with the highest sampled read and write bandwidth across all storage servers, over roughly the last HOT_RANGE_WINDOW seconds. A point read or write is shown as its key. Each rate may be more than the true rate by up to the error shown. LIMIT defaults to 10 if omitted.");
 	helpMap["reset"] = CommandHelp(
 		"reset",
 		"reset the current transaction",
@@ -879,6 +893,9 @@ void printStatus(StatusObjectReader statusObj, StatusClient::StatusLevel level,
 				if (statusObjConfig.get("proxies", intVal))
 					outputString += format("\n  Desired Proxies        - %d", intVal);
 
+				if (statusObjConfig.get("grv_proxies", intVal))
+					outputString += format("\n  Desired GRV Proxies    - %d", intVal);
+
 				if (statusObjConfig.get("resolvers", intVal))
 					outputString += format("\n  Desired Resolvers      - %d", intVal);
 
@@ -1908,6 +1925,229 @@ ACTOR Future<bool> setClass( Database db, std::vector<StringRef> tokens ) {
 };
 
 
+// A bulk data file has a line for each key value pair: the key and the value as quoted tokens of the command line (see
+// `help escaping'), so that parseLine() reads them back.
+static std::string formatBulkDataLine(KeyValueRef kv) {
+	return "\"" + formatStringRef(kv.key, true) + "\" \"" + formatStringRef(kv.value, true) + "\"\n";
+}
+
+// Set in a batch, a key value pair takes about this much of a transaction's TRANSACTION_SIZE_LIMIT
+static int bulkDataBytes(KeyValueRef kv) {
+	return 2 * kv.key.size() + kv.value.size() + sizeof(MutationRef) + sizeof(KeyRangeRef);
+}
+
+ACTOR Future<Void> exportShard( Database db, KeyRange keys, Reference<IAsyncFile> file, int64_t* offset, int64_t* exported, Reference<FlowLock> lock ) {
+	state FlowLock::Releaser releaser( *lock );
+	state Transaction tr(db);
+	state Key begin = keys.begin;
+	state std::string lines;
+	state bool done = false;
+	loop {
+		try {
+			Standalone<RangeResultRef> kvs = wait( tr.getRange( KeyRangeRef(begin, keys.end), GetRangeLimits(GetRangeLimits::ROW_LIMIT_UNLIMITED, CLIENT_KNOBS->REPLY_BYTE_LIMIT), true ) );
+			lines.clear();
+			for(auto& kv : kvs)
+				lines += formatBulkDataLine(kv);
+			*exported += kvs.size();
+			if( kvs.more )
+				begin = keyAfter( kvs.end()[-1].key );
+			else
+				done = true;
+
+			// The lines of each batch are kept together, but the batches of different shards are written in the order
+			// they were read
+			int64_t at = *offset;
+			*offset += lines.size();
+			Void _ = wait( file->write( lines.data(), lines.size(), at ) );
+			if( done )
+				return Void();
+		} catch( Error& e ) {
+			// A shard that takes longer than a transaction can last to read is read at more than one version
+			Void _ = wait( tr.onError(e) );
+		}
+	}
+}
+
+// Writes the key value pairs in keys to filename, reading its shards with up to parallelism transactions at a time.
+// The export is not of a single version, since a range too big for one transaction is read in several.
+ACTOR Future<bool> exportData( Database db, KeyRange keys, std::string filename, int parallelism ) {
+	state Reference<IAsyncFile> file;
+	state Standalone<VectorRef<KeyRef>> boundaries;
+	state Transaction tr(db);
+	state Reference<FlowLock> lock( new FlowLock( parallelism ) );
+	state ActorCollection shards( false );
+	state Future<Void> shardErrors = shards.getResult();
+	state int64_t offset = 0;
+	state int64_t exported = 0;
+	state int i = 0;
+
+	Reference<IAsyncFile> f = wait( makeInterruptable( IAsyncFileSystem::filesystem()->open( filename, IAsyncFile::OPEN_NO_AIO | IAsyncFile::OPEN_CREATE | IAsyncFile::OPEN_READWRITE, 0644 ) ) );
+	file = f;
+	Void _ = wait( makeInterruptable( file->truncate( 0 ) ) );
+
+	loop {
+		try {
+			Standalone<VectorRef<KeyRef>> b = wait( makeInterruptable( tr.getShardBoundaries( keys ) ) );
+			boundaries = b;
+			break;
+		} catch( Error& e ) {
+			Void _ = wait( tr.onError(e) );
+		}
+	}
+
+	for(; i < boundaries.size() - 1; i++) {
+		Void _ = wait( makeInterruptable( lock->take() || shardErrors ) );
+		shards.add( exportShard( db, KeyRangeRef( boundaries[i], boundaries[i+1] ), file, &offset, &exported, lock ) );
+	}
+	Void _ = wait( makeInterruptable( lock->take( TaskDefaultYield, parallelism ) || shardErrors ) );
+	Void _ = wait( makeInterruptable( file->sync() ) );
+
+	printf("Exported %" PRId64 " key-value pairs from %d shards to `%s'\n", exported, boundaries.size() - 1, filename.c_str());
+	return false;
+}
+
+// Sets the key value pairs of a batch in one transaction if they fit, and otherwise in halves
+Future<Void> importBatch( Database const& db, Standalone<VectorRef<KeyValueRef>> const& kvs, int64_t* const& imported );
+ACTOR Future<Void> importBatch( Database db, Standalone<VectorRef<KeyValueRef>> kvs, int64_t* imported ) {
+	state Transaction tr(db);
+	state bool tooLarge = false;
+	loop {
+		try {
+			for(auto& kv : kvs)
+				tr.set( kv.key, kv.value );
+			Void _ = wait( tr.commit() );
+			*imported += kvs.size();
+			return Void();
+		} catch( Error& e ) {
+			if( e.code() == error_code_transaction_too_large && kvs.size() > 1 )
+				tooLarge = true;
+			else
+				Void _ = wait( tr.onError(e) );
+		}
+		if( tooLarge )
+			break;
+	}
+
+	// The halves are set one after the other, so that a key in both has the value of the second
+	state int half = kvs.size() / 2;
+	Void _ = wait( importBatch( db, Standalone<VectorRef<KeyValueRef>>( VectorRef<KeyValueRef>( kvs.begin(), half ), kvs.arena() ), imported ) );
+	Void _ = wait( importBatch( db, Standalone<VectorRef<KeyValueRef>>( VectorRef<KeyValueRef>( kvs.begin() + half, kvs.size() - half ), kvs.arena() ), imported ) );
+	return Void();
+}
+
+ACTOR Future<Void> importBatchLocked( Database db, Standalone<VectorRef<KeyValueRef>> kvs, int64_t* imported, Reference<FlowLock> lock ) {
+	state FlowLock::Releaser releaser( *lock );
+	Void _ = wait( importBatch( db, kvs, imported ) );
+	return Void();
+}
+
+// Sets the sorted key value pairs of a block of a bulk data file, in batches which do not cross shard boundaries, with up
+// to parallelism transactions at a time
+ACTOR Future<Void> importBlock( Database db, Standalone<VectorRef<KeyValueRef>> kvs, int parallelism, int64_t* imported ) {
+	state Transaction tr(db);
+	state Standalone<VectorRef<KeyRef>> boundaries;
+	state Reference<FlowLock> lock( new FlowLock( parallelism ) );
+	state ActorCollection batches( false );
+	state Future<Void> batchErrors = batches.getResult();
+	state int batchBegin = 0;
+	state int shard = 1;
+
+	loop {
+		try {
+			Standalone<VectorRef<KeyRef>> b = wait( tr.getShardBoundaries( KeyRangeRef( kvs[0].key, keyAfter( kvs.end()[-1].key ) ) ) );
+			boundaries = b;
+			break;
+		} catch( Error& e ) {
+			Void _ = wait( tr.onError(e) );
+		}
+	}
+
+	while( batchBegin < kvs.size() ) {
+		Void _ = wait( lock->take() || batchErrors );
+		int batchEnd = batchBegin;
+		int batchBytes = 0;
+		while( shard < boundaries.size() - 1 && kvs[batchBegin].key >= boundaries[shard] )
+			shard++;
+		// A key which appears more than once is set in one batch, so that the last value is the one set
+		while( batchEnd < kvs.size() && kvs[batchEnd].key < boundaries[shard] && ( batchEnd == batchBegin || batchBytes + bulkDataBytes( kvs[batchEnd] ) <= CLIENT_KNOBS->TRANSACTION_SIZE_LIMIT / 10 || kvs[batchEnd].key == kvs[batchEnd-1].key ) ) {
+			batchBytes += bulkDataBytes( kvs[batchEnd] );
+			batchEnd++;
+		}
+
+		batches.add( importBatchLocked( db, Standalone<VectorRef<KeyValueRef>>( VectorRef<KeyValueRef>( kvs.begin() + batchBegin, batchEnd - batchBegin ), kvs.arena() ), imported, lock ) );
+		batchBegin = batchEnd;
+	}
+	Void _ = wait( lock->take( TaskDefaultYield, parallelism ) || batchErrors );
+	return Void();
+}
+
+// Sets the key value pairs of a bulk data file, like one written by exportData(), a block of the file at a time.  The
+// import is not atomic, but the file can be imported again if it fails.  If a key appears more than once, the last value
+// is the one that is set.
+ACTOR Future<bool> importData( Database db, std::string filename, int parallelism ) {
+	state Reference<IAsyncFile> file;
+	state int64_t size;
+	state int64_t offset = 0;
+	state int64_t lineNumber = 0;
+	state int64_t imported = 0;
+	state std::string block;
+	state std::string partial;
+
+	Reference<IAsyncFile> f = wait( makeInterruptable( IAsyncFileSystem::filesystem()->open( filename, IAsyncFile::OPEN_NO_AIO | IAsyncFile::OPEN_READONLY, 0 ) ) );
+	file = f;
+	int64_t s = wait( makeInterruptable( file->size() ) );
+	size = s;
+
+	while( offset < size || partial.size() ) {
+		block.resize( std::min<int64_t>( 10e6, size - offset ) );
+		int read = wait( makeInterruptable( file->read( &block[0], block.size(), offset ) ) );
+		block.resize( read );
+		offset += read;
+		block = partial + block;
+		partial.clear();
+
+		// A line cut by the end of the block is read with the next one
+		size_t end = block.size();
+		if( offset < size ) {
+			end = block.rfind('\n');
+			if( end == std::string::npos ) {
+				partial = block;
+				continue;
+			}
+			partial = block.substr( end + 1 );
+			end++;
+		}
+
+		state Standalone<VectorRef<KeyValueRef>> kvs;
+		kvs = Standalone<VectorRef<KeyValueRef>>();
+		size_t lineBegin = 0;
+		while( lineBegin < end ) {
+			size_t lineEnd = std::min( block.find('\n', lineBegin), end );
+			std::string line = block.substr( lineBegin, lineEnd - lineBegin );
+			lineBegin = lineEnd + 1;
+			lineNumber++;
+			if( line.find_first_not_of(' ') == std::string::npos )
+				continue;
+
+			bool err, partialLine;
+			auto parsed = parseLine( line, err, partialLine );
+			if( err || partialLine || parsed.size() != 1 || parsed[0].size() != 2 ) {
+				printf("ERROR: line %" PRId64 " of `%s' is not a quoted key and value\n", lineNumber, filename.c_str());
+				return true;
+			}
+			kvs.push_back_deep( kvs.arena(), KeyValueRef( parsed[0][0], parsed[0][1] ) );
+		}
+		if( !kvs.size() )
+			continue;
+
+		std::stable_sort( kvs.begin(), kvs.end(), KeyValueRef::OrderByKey() );
+		Void _ = wait( makeInterruptable( importBlock( db, kvs, parallelism, &imported ) ) );
+	}
+
+	printf("Imported %" PRId64 " key-value pairs from `%s'\n", imported, filename.c_str());
+	return false;
+}
+
 Reference<ReadYourWritesTransaction> getTransaction(Database db, Reference<ReadYourWritesTransaction> &tr, FdbOptions *options, bool intrans) {
 	if(!tr || !intrans) {
 		tr = Reference<ReadYourWritesTransaction>(new ReadYourWritesTransaction(db));
@@ -1984,7 +2224,7 @@ void onoff_generator(const char* text, const char *line, std::vector<std::string
 }
 
 void configure_generator(const char* text, const char *line, std::vector<std::string>& lc) {
-	const char* opts[] = {"new", "single", "double", "triple", "three_data_hall", "three_datacenter", "ssd", "ssd-1", "ssd-2", "memory", "proxies=", "logs=", "resolvers=", NULL};
+	const char* opts[] = {"new", "single", "double", "triple", "three_data_hall", "three_datacenter", "ssd", "ssd-1", "ssd-2", "ssd-lsm", "memory", "proxies=", "grv_proxies=", "logs=", "resolvers=", NULL};
 	array_generator(text, line, opts, lc);
 }
 
@@ -2716,7 +2956,7 @@ ACTOR Future<int> cli(CLIOptions opt, LineNoise* plinenoise) {
 					}
 					if (tokencmp(tokens[1], "flow")) {
 						if (tokens.size() == 2) {
-							printf("ERROR: Usage: profile flow <run>\n");
+							printf("ERROR: Usage: profile flow <run|sample>\n");
 							is_error = true;
 							continue;
 						}
@@ -2787,6 +3027,73 @@ ACTOR Future<int> cli(CLIOptions opt, LineNoise* plinenoise) {
 							all_profiler_responses.clear();
 							continue;
 						}
+						if (tokencmp(tokens[2], "sample")) {
+							if (tokens.size() < 5) {
+								printf("ERROR: Usage: profile flow sample <duration in seconds> <hosts>\n");
+								is_error = true;
+								continue;
+							}
+							getTransaction(db, tr, options, intrans);
+							Standalone<RangeResultRef> kvs = wait(makeInterruptable(
+							    tr->getRange(KeyRangeRef(LiteralStringRef("\xff\xff/worker_interfaces"),
+							                             LiteralStringRef("\xff\xff\xff")),
+							                 1)));
+							std::string durationStr = tokens[3].toString();
+							char *duration_end;
+							double duration = std::strtod(durationStr.c_str(), &duration_end);
+							if (*duration_end != '\0' || duration < 0) {
+								printf("ERROR: Failed to parse %s as a duration.\n", printable(tokens[3]).c_str());
+								is_error = true;
+								continue;
+							}
+							std::map<Key, ClientWorkerInterface> interfaces;
+							state std::vector<Key> sample_addresses;
+							state std::vector<Future<ErrorOr<ProfileSamplesReply>>> sample_responses;
+							for (const auto& pair : kvs) {
+								interfaces.emplace(pair.key, BinaryReader::fromStringRef<ClientWorkerInterface>(pair.value, IncludeVersion()));
+							}
+							for (int tokenidx = 4; tokenidx < tokens.size(); tokenidx++) {
+								if (tokens.size() == 5 && tokencmp(tokens[4], "all")) {
+									for (const auto& pair : interfaces)
+										sample_addresses.push_back(pair.first);
+								} else if (interfaces.count(tokens[tokenidx])) {
+									sample_addresses.push_back(tokens[tokenidx]);
+								} else {
+									printf("ERROR: process '%s' not recognized.\n", printable(tokens[tokenidx]).c_str());
+									is_error = true;
+								}
+							}
+							if (!is_error) {
+								for (auto const& address : sample_addresses)
+									sample_responses.push_back(interfaces[address].profileSamples.tryGetReply(ProfileSamplesRequest(duration)));
+								Void _ = wait(makeInterruptable(waitForAll(sample_responses)));
+								for (int i = 0; i < sample_responses.size(); i++) {
+									const ErrorOr<ProfileSamplesReply>& rep = sample_responses[i].get();
+									if (rep.isError()) {
+										printf("ERROR: %s: %s: %s\n", printable(sample_addresses[i]).c_str(), rep.getError().name(), rep.getError().what());
+										continue;
+									}
+									if (!rep.get().periodMicroseconds) {
+										printf("%s: the sampling profiler is not running\n", printable(sample_addresses[i]).c_str());
+										continue;
+									}
+									int64_t total = rep.get().dropped;
+									for (auto const& e : rep.get().entries)
+										total += e.samples;
+									printf("%s: %lld samples, one every %d us of network thread CPU time", printable(sample_addresses[i]).c_str(), (long long)total, rep.get().periodMicroseconds);
+									if (rep.get().dropped)
+										printf(", %lld of them not attributed", (long long)rep.get().dropped);
+									printf("\n  Samples  Percent  Priority  Actor\n");
+									for (int e = 0; e < std::min<int>(rep.get().entries.size(), 20); e++) {
+										auto const& entry = rep.get().entries[e];
+										printf("  %7lld  %6.2f%%  %8d  %s\n", (long long)entry.samples, 100.0 * entry.samples / total, entry.taskID, entry.actor.size() ? entry.actor.c_str() : "(no actor)");
+									}
+								}
+							}
+							sample_addresses.clear();
+							sample_responses.clear();
+							continue;
+						}
 					}
 					printf("ERROR: Unknown type: %s\n", printable(tokens[1]).c_str());
 					is_error = true;
@@ -2912,6 +3219,61 @@ ACTOR Future<int> cli(CLIOptions opt, LineNoise* plinenoise) {
 					continue;
 				}
 
+				if (tokencmp(tokens[0], "hotkeys")) {
+					int limit = 10;
+					if (tokens.size() > 2 || (tokens.size() == 2 && (sscanf(tokens[1].toString().c_str(), "%d", &limit) != 1 || limit <= 0))) {
+						printUsage(tokens[0]);
+						is_error = true;
+					} else {
+						GetHotRangesReply hot = wait( makeInterruptable( getClusterHotRanges(db, limit) ) );
+						printf("\nSampled over the last %.1f seconds\n", hot.seconds);
+						for (int w = 0; w < 2; w++) {
+							VectorRef<HotRangeRef> const& ranges = w ? hot.writes : hot.reads;
+							printf("\n%s:\n", w ? "Writes" : "Reads");
+							if (!ranges.size())
+								printf("  None\n");
+							for (auto& r : ranges) {
+								if (r.range.singleKeyRange())
+									printf("  %12.0f +/- %-10.0f bytes/s  `%s'\n", r.bytesPerSecond, r.errorBytesPerSecond, printable(r.range.begin).c_str());
+								else
+									printf("  %12.0f +/- %-10.0f bytes/s  `%s' - `%s'\n", r.bytesPerSecond, r.errorBytesPerSecond, printable(r.range.begin).c_str(), printable(r.range.end).c_str());
+							}
+						}
+						printf("\n");
+					}
+					continue;
+				}
+
+				if (tokencmp(tokens[0], "export")) {
+					int parallelism = 16;
+					if (tokens.size() < 4 || tokens.size() > 5 || (tokens.size() == 5 && (sscanf(tokens[4].toString().c_str(), "%d", &parallelism) != 1 || parallelism <= 0)) || tokens[1] >= tokens[2] || tokens[2] > allKeys.end) {
+						printUsage(tokens[0]);
+						is_error = true;
+					} else {
+						bool err = wait( exportData(db, KeyRangeRef(tokens[1], tokens[2]), tokens[3].toString(), parallelism) );
+						if (err) is_error = true;
+					}
+					continue;
+				}
+
+				if (tokencmp(tokens[0], "import")) {
+					if(!writeMode) {
+						printf("ERROR: writemode must be enabled to set or clear keys in the database.\n");
+						is_error = true;
+						continue;
+					}
+
+					int parallelism = 16;
+					if (tokens.size() < 2 || tokens.size() > 3 || (tokens.size() == 3 && (sscanf(tokens[2].toString().c_str(), "%d", &parallelism) != 1 || parallelism <= 0))) {
+						printUsage(tokens[0]);
+						is_error = true;
+					} else {
+						bool err = wait( importData(db, tokens[1].toString(), parallelism) );
+						if (err) is_error = true;
+					}
+					continue;
+				}
+
 				if (tokencmp(tokens[0], "writemode")) {
 					if (tokens.size() != 2) {
 						printUsage(tokens[0]);
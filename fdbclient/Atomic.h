@@ -30,6 +30,16 @@ static ValueRef doLittleEndianAdd(const Optional<ValueRef>& existingValueOptiona
 	if(!otherOperand.size()) return otherOperand;
 	
 	uint8_t* buf = new (ar) uint8_t [otherOperand.size()];
+	if(existingValue.size() == 8 && otherOperand.size() == 8) {
+		// The common case of 64 bit counters, as one machine add (all supported platforms are little endian)
+		uint64_t a, b;
+		memcpy(&a, existingValue.begin(), 8);
+		memcpy(&b, otherOperand.begin(), 8);
+		a += b;
+		memcpy(buf, &a, 8);
+		return StringRef(buf, 8);
+	}
+
 	int i = 0;
 	int carry = 0;
 		
@@ -220,6 +230,49 @@ static ValueRef doByteMin(const Optional<ValueRef>& existingValueOptional, const
 	return otherOperand;
 }
 
+// The conditional operations leave the existing value alone, absent or not, unless their condition holds, so they return
+// an Optional.  They never clear a key.
+static Optional<ValueRef> doSetIfAbsent(const Optional<ValueRef>& existingValueOptional, const ValueRef& otherOperand, Arena& ar) {
+	if (existingValueOptional.present()) return existingValueOptional;
+
+	return otherOperand;
+}
+
+// The operand of a compare_and_set is the value to compare with, then the value to set, then the size of the first as a 4
+// byte little endian integer.  Returns false if operand is not of that form.
+static bool decodeCompareAndSetOperand(const ValueRef& operand, ValueRef& compareValue, ValueRef& setValue) {
+	if (operand.size() < 4) return false;
+
+	int32_t compareSize;
+	memcpy(&compareSize, operand.end() - 4, 4);
+	compareSize = littleEndian32(compareSize);
+	if (compareSize < 0 || compareSize > operand.size() - 4) return false;
+
+	compareValue = operand.substr(0, compareSize);
+	setValue = operand.substr(compareSize, operand.size() - 4 - compareSize);
+	return true;
+}
+
+static Value encodeCompareAndSetOperand(const ValueRef& compareValue, const ValueRef& setValue) {
+	int32_t compareSize = littleEndian32(compareValue.size());
+	Value operand = makeString(compareValue.size() + setValue.size() + 4);
+	uint8_t* buf = mutateString(operand);
+	memcpy(buf, compareValue.begin(), compareValue.size());
+	memcpy(buf + compareValue.size(), setValue.begin(), setValue.size());
+	memcpy(buf + compareValue.size() + setValue.size(), &compareSize, 4);
+	return operand;
+}
+
+static Optional<ValueRef> doCompareAndSet(const Optional<ValueRef>& existingValueOptional, const ValueRef& otherOperand, Arena& ar) {
+	ValueRef compareValue, setValue;
+	if (!decodeCompareAndSetOperand(otherOperand, compareValue, setValue)) return existingValueOptional;
+
+	if (existingValueOptional.present() && existingValueOptional.get() == compareValue)
+		return setValue;
+
+	return existingValueOptional;
+}
+
 /*
 * Returns the range corresponding to the specified versionstamp key.
 */
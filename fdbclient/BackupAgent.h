@@ -431,6 +431,8 @@ Future<Void> logError(Reference<ReadYourWritesTransaction> tr, Key keyErrors, co
 Future<Void> checkVersion(Reference<ReadYourWritesTransaction> const& tr);
 Future<Void> readCommitted(Database const& cx, PromiseStream<RangeResultWithVersion> const& results, Reference<FlowLock> const& lock, KeyRangeRef const& range, bool const& terminator = true, bool const& systemAccess = false, bool const& lockAware = false);
 Future<Void> readCommitted(Database const& cx, PromiseStream<RCGroup> const& results, Future<Void> const& active, Reference<FlowLock> const& lock, KeyRangeRef const& range, std::function< std::pair<uint64_t, uint32_t>(Key key) > const& groupBy, bool const& terminator = true, bool const& systemAccess = false, bool const& lockAware = false);
+// Writes data, which must be all of the key values in keys as of version, to bc as a finished range file
+Future<Reference<IBackupFile>> writeBackupRangeFile(Reference<IBackupContainer> const& bc, Version const& version, int const& blockSize, KeyRange const& keys, Standalone<VectorRef<KeyValueRef>> const& data);
 Future<Void> applyMutations(Database const& cx, Key const& uid, Key const& addPrefix, Key const& removePrefix, Version const& beginVersion, Version* const& endVersion, RequestStream<CommitTransactionRequest> const& commit, NotifiedVersion* const& committedVersion, Reference<KeyRangeMap<Version>> const& keyVersion);
 
 typedef BackupAgentBase::enumState EBackupState;
@@ -262,15 +262,11 @@ public:
 		return false;
 	}
 
-	// TODO:  Do this more efficiently, as the range file list for a snapshot could potentially be hundreds of megabytes.
-	ACTOR static Future<std::vector<RangeFile>> readKeyspaceSnapshot_impl(Reference<BackupContainerFileSystem> bc, KeyspaceSnapshotFile snapshot) {
-		// Read the range file list for the specified version range, and then index them by fileName.
-		std::vector<RangeFile> files = wait(bc->listRangeFiles(snapshot.beginVersion, snapshot.endVersion));
-		state std::map<std::string, RangeFile> rangeIndex;
-		for(auto &f : files)
-			rangeIndex[f.fileName] = std::move(f);
-
-		// Read the snapshot file, verify the version range, then find each of the range files by name in the index and return them.
+	// Read the list of range file names, and their sizes if the snapshot recorded them, from a snapshot file.  Snapshot files
+	// written before sizes were recorded give a size of -1 for every file.
+	typedef std::vector<std::pair<std::string, int64_t>> SnapshotManifestT;
+	ACTOR static Future<SnapshotManifestT> readKeyspaceSnapshotManifest_impl(Reference<BackupContainerFileSystem> bc, KeyspaceSnapshotFile snapshot) {
+		// Read the snapshot file and verify the version range
 		state Reference<IAsyncFile> f = wait(bc->readFile(snapshot.fileName));
 		int64_t size = wait(f->size());
 		state Standalone<StringRef> buf = makeString(size);
@@ -289,12 +285,57 @@ public:
 		if(filesArray.type() != json_spirit::array_type)
 			throw restore_corrupted_data();
 
-		std::vector<RangeFile> results;
+		SnapshotManifestT manifest;
 		for(auto const &fileValue : filesArray.get_array()) {
 			if(fileValue.type() != json_spirit::str_type)
 				throw restore_corrupted_data();
-			auto i = rangeIndex.find(fileValue.get_str());
-			if(i == rangeIndex.end())
+			manifest.push_back({fileValue.get_str(), -1});
+		}
+
+		if(doc.has("fileSizes")) {
+			json_spirit::mValue &sizesArray = doc.create("fileSizes");
+			if(sizesArray.type() != json_spirit::array_type || sizesArray.get_array().size() != manifest.size())
+				throw restore_corrupted_data();
+			for(int i = 0; i < manifest.size(); ++i) {
+				auto const &sizeValue = sizesArray.get_array()[i];
+				if(sizeValue.type() != json_spirit::int_type)
+					throw restore_corrupted_data();
+				manifest[i].second = sizeValue.get_int64();
+			}
+		}
+
+		return manifest;
+	}
+
+	ACTOR static Future<std::vector<RangeFile>> readKeyspaceSnapshot_impl(Reference<BackupContainerFileSystem> bc, KeyspaceSnapshotFile snapshot) {
+		state SnapshotManifestT manifest = wait(readKeyspaceSnapshotManifest_impl(bc, snapshot));
+		state std::vector<RangeFile> results;
+		state RangeFile rf;
+
+		// If the snapshot recorded the size of each file then it alone describes the range files, which saves listing
+		// the range files of the snapshot's whole version range.
+		bool haveSizes = true;
+		for(auto const &f : manifest) {
+			if(f.second < 0 || !pathToRangeFile(rf, f.first, f.second)) {
+				haveSizes = false;
+				break;
+			}
+			results.push_back(rf);
+		}
+		if(haveSizes)
+			return results;
+
+		// Otherwise read the range file list for the specified version range, index it by fileName, and find each
+		// of the snapshot's files in the index.
+		results.clear();
+		std::vector<RangeFile> files = wait(bc->listRangeFiles(snapshot.beginVersion, snapshot.endVersion));
+		std::map<std::string, RangeFile> rangeIndex;
+		for(auto &f : files)
+			rangeIndex[f.fileName] = std::move(f);
+
+		for(auto const &f : manifest) {
+			auto i = rangeIndex.find(f.first);
+			if(i == rangeIndex.end() || (f.second >= 0 && f.second != i->second.fileSize))
 				throw restore_corrupted_data();
 
 			results.push_back(i->second);
@@ -307,14 +348,16 @@ public:
 		return readKeyspaceSnapshot_impl(Reference<BackupContainerFileSystem>::addRef(this), snapshot);
 	}
 
-	ACTOR static Future<Void> writeKeyspaceSnapshotFile_impl(Reference<BackupContainerFileSystem> bc, std::vector<std::string> fileNames, int64_t totalBytes) {
+	ACTOR static Future<Void> writeKeyspaceSnapshotFile_impl(Reference<BackupContainerFileSystem> bc, std::vector<std::string> fileNames, int64_t totalBytes, std::vector<int64_t> fileSizes) {
 		ASSERT(!fileNames.empty());
+		ASSERT(fileSizes.empty() || fileSizes.size() == fileNames.size());
 
 
 		state Version minVer = std::numeric_limits<Version>::max();
 		state Version maxVer = 0;
 		state RangeFile rf;
 		state json_spirit::mArray fileArray;
+		state json_spirit::mArray sizeArray;
 		state int i;
 
 		// Validate each filename, update version range
@@ -322,6 +365,8 @@ public:
 			auto const &f = fileNames[i];
 			if(pathToRangeFile(rf, f, 0)) {
 				fileArray.push_back(f);
+				if(!fileSizes.empty())
+					sizeArray.push_back(fileSizes[i]);
 				if(rf.version < minVer)
 					minVer = rf.version;
 				if(rf.version > maxVer)
@@ -336,6 +381,8 @@ public:
 		state JSONDoc doc(json);
 
 		doc.create("files") = std::move(fileArray);
+		if(!fileSizes.empty())
+			doc.create("fileSizes") = std::move(sizeArray);
 		doc.create("totalBytes") = totalBytes;
 		doc.create("beginVersion") = minVer;
 		doc.create("endVersion") = maxVer;
@@ -350,8 +397,8 @@ public:
 		return Void();
 	}
 
-	Future<Void> writeKeyspaceSnapshotFile(std::vector<std::string> fileNames, int64_t totalBytes) {
-		return writeKeyspaceSnapshotFile_impl(Reference<BackupContainerFileSystem>::addRef(this), fileNames, totalBytes);
+	Future<Void> writeKeyspaceSnapshotFile(std::vector<std::string> fileNames, int64_t totalBytes, std::vector<int64_t> fileSizes) {
+		return writeKeyspaceSnapshotFile_impl(Reference<BackupContainerFileSystem>::addRef(this), fileNames, totalBytes, fileSizes);
 	};
 
 	// List log files which contain data at any version >= beginVersion and < endVersion
@@ -450,6 +497,9 @@ public:
 		state Optional<Version> begin;
 		state Optional<Version> end;
 
+		// Listing the snapshots does not depend on the known log range, so start it now
+		state Future<std::vector<KeyspaceSnapshotFile>> fSnapshots = bc->listKeyspaceSnapshots();
+
 		if(!deepScan) {
 			Void _ = wait(store(bc->logBeginVersion().get(), begin) && store(bc->logEndVersion().get(), end));
 		}
@@ -466,10 +516,48 @@ public:
 			scanBegin = desc.contiguousLogEnd.get();
 		}
 
-		std::vector<KeyspaceSnapshotFile> snapshots = wait(bc->listKeyspaceSnapshots());
-		desc.snapshots = snapshots;
+		// The listings are independent so do them at the same time.  A deep scan also lists every range file so that
+		// the files of each snapshot can be checked below.
+		state Future<std::vector<LogFile>> fLogs = bc->listLogFiles(scanBegin, scanEnd);
+		state Future<std::vector<RangeFile>> fRanges = deepScan ? bc->listRangeFiles() : Future<std::vector<RangeFile>>(std::vector<RangeFile>());
+		Void _ = wait(success(fSnapshots) && success(fLogs) && success(fRanges));
+		desc.snapshots = fSnapshots.get();
+
+		// A deep scan reads every snapshot file at once and checks that each range file it names was listed, with
+		// the size recorded in it if there is one.  A snapshot with a missing or truncated file is not restorable.
+		state std::set<std::string> incompleteSnapshots;
+		state std::vector<Future<ErrorOr<SnapshotManifestT>>> manifests;
+		if(deepScan) {
+			for(auto const &s : desc.snapshots)
+				manifests.push_back(errorOr(readKeyspaceSnapshotManifest_impl(bc, s)));
+			Void _ = wait(waitForAll(manifests));
+
+			std::map<std::string, int64_t> rangeSizes;
+			for(auto const &r : fRanges.get())
+				rangeSizes[r.fileName] = r.fileSize;
+
+			for(int i = 0; i < desc.snapshots.size(); ++i) {
+				int badFiles = 0;
+				if(manifests[i].get().isError()) {
+					TraceEvent(SevWarnAlways, "BackupContainerSnapshotUnreadable").error(manifests[i].get().getError())
+						.detail("URL", bc->getURL()).detail("Snapshot", desc.snapshots[i].fileName);
+					incompleteSnapshots.insert(desc.snapshots[i].fileName);
+					continue;
+				}
+				for(auto const &f : manifests[i].get().get()) {
+					auto r = rangeSizes.find(f.first);
+					if(r == rangeSizes.end() || (f.second >= 0 && f.second != r->second))
+						++badFiles;
+				}
+				if(badFiles > 0) {
+					TraceEvent(SevWarnAlways, "BackupContainerSnapshotIncomplete").detail("URL", bc->getURL())
+						.detail("Snapshot", desc.snapshots[i].fileName).detail("BadFiles", badFiles);
+					incompleteSnapshots.insert(desc.snapshots[i].fileName);
+				}
+			}
+		}
 
-		std::vector<LogFile> logs = wait(bc->listLogFiles(scanBegin, scanEnd));
+		std::vector<LogFile> const &logs = fLogs.get();
 
 		if(!logs.empty()) {
 			desc.maxLogEnd = logs.rbegin()->endVersion;
@@ -523,6 +611,12 @@ public:
 
 			desc.snapshotBytes += s.totalSize;
 
+			// A snapshot missing any of its files cannot be restored from at all
+			if(incompleteSnapshots.count(s.fileName)) {
+				s.restorable = false;
+				continue;
+			}
+
 			// If the snapshot is at a single version then it requires no logs.  Update min and max restorable.
 			// TODO:  Somehow check / report if the restorable range is not or may not be contiguous.
 			if(s.beginVersion == s.endVersion) {
@@ -1036,7 +1130,9 @@ public:
 					m_bstore->knobs.read_block_size,
 					m_bstore->knobs.read_ahead_blocks,
 					m_bstore->knobs.concurrent_reads_per_file,
-					m_bstore->knobs.read_cache_blocks_per_file
+					m_bstore->knobs.read_cache_blocks_per_file,
+					m_bstore->knobs.initial_concurrency_per_file,
+					CLIENT_KNOBS->BLOBSTORE_CONCURRENCY_MIN_GAIN
 				)
 			);
 	}
@@ -1383,7 +1479,7 @@ ACTOR Future<Void> testBackupContainer(std::string url) {
 
 	Void _ = wait(
 		   c->writeKeyspaceSnapshotFile({range1->getFileName(), range2->getFileName()}, range1->size() + range2->size())
-		&& c->writeKeyspaceSnapshotFile({range3->getFileName()}, range3->size())
+		&& c->writeKeyspaceSnapshotFile({range3->getFileName()}, range3->size(), {range3->size()})
 	);
 
 	printf("Checking file list dump\n");
@@ -1395,6 +1491,12 @@ ACTOR Future<Void> testBackupContainer(std::string url) {
 	state BackupDescription desc = wait(c->describeBackup());
 	printf("Backup Description 1\n%s", desc.toString().c_str());
 
+	// A deep scan finds every file named by both snapshots and so agrees on which of them are restorable
+	BackupDescription deepDesc = wait(c->describeBackup(true));
+	ASSERT(deepDesc.snapshots.size() == desc.snapshots.size());
+	for(int i = 0; i < desc.snapshots.size(); ++i)
+		ASSERT(deepDesc.snapshots[i].restorable == desc.snapshots[i].restorable);
+
 	ASSERT(desc.maxRestorableVersion.present());
 	Optional<RestorableFileSet> rest = wait(c->getRestoreSet(desc.maxRestorableVersion.get()));
 	ASSERT(rest.present());
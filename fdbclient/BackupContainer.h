@@ -159,8 +159,9 @@ public:
 	virtual Future<Reference<IBackupFile>> writeRangeFile(Version version, int blockSize) = 0;
 
 	// Write a KeyspaceSnapshotFile of range file names representing a full non overlapping
-	// snapshot of the key ranges this backup is targeting.
-	virtual Future<Void> writeKeyspaceSnapshotFile(std::vector<std::string> fileNames, int64_t totalBytes) = 0;
+	// snapshot of the key ranges this backup is targeting.  If fileSizes is given, the size of each file is recorded
+	// with it so that the snapshot can be read back without listing its range files.
+	virtual Future<Void> writeKeyspaceSnapshotFile(std::vector<std::string> fileNames, int64_t totalBytes, std::vector<int64_t> fileSizes = std::vector<int64_t>()) = 0;
 
 	// Open a file for read by name
 	virtual Future<Reference<IAsyncFile>> readFile(std::string name) = 0;
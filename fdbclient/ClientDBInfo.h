@@ -29,6 +29,7 @@
 struct ClientDBInfo {
 	UID id;  // Changes each time anything else changes
 	vector< MasterProxyInterface > proxies;
+	vector< MasterProxyInterface > grvProxies;  // If not empty, these answer GetReadVersionRequests instead of proxies
 	double clientTxnInfoSampleRate;
 	int64_t clientTxnInfoSizeLimit;
 	ClientDBInfo() : clientTxnInfoSampleRate(std::numeric_limits<double>::infinity()), clientTxnInfoSizeLimit(-1) {}
@@ -40,6 +41,9 @@ struct ClientDBInfo {
 	void serialize(Archive& ar) {
 		ASSERT( ar.protocolVersion() >= 0x0FDB00A200040001LL );
 		ar & proxies & id & clientTxnInfoSampleRate & clientTxnInfoSizeLimit;
+		if( ar.protocolVersion() >= 0x0FDB00A560060001LL ) {
+			ar & grvProxies;
+		}
 	}
 };
 
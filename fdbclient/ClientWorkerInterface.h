@@ -32,6 +32,7 @@
 struct ClientWorkerInterface {
 	RequestStream< struct RebootRequest > reboot;
 	RequestStream< struct ProfilerRequest > profiler;
+	RequestStream< struct ProfileSamplesRequest > profileSamples;
 
 	bool operator == (ClientWorkerInterface const& r) const { return id() == r.id(); }
 	bool operator != (ClientWorkerInterface const& r) const { return id() != r.id(); }
@@ -41,6 +42,11 @@ struct ClientWorkerInterface {
 	template <class Ar>
 	void serialize( Ar& ar ) {
 		ar & reboot & profiler;
+		if( ar.protocolVersion() >= 0x0FDB00A560060001LL ) {
+			ar & profileSamples;
+		} else if( ar.isDeserializing ) {
+			profileSamples = RequestStream<struct ProfileSamplesRequest>( Endpoint() );
+		}
 	}
 };
 
@@ -83,4 +89,44 @@ struct ProfilerRequest {
 BINARY_SERIALIZABLE( ProfilerRequest::Type );
 BINARY_SERIALIZABLE( ProfilerRequest::Action );
 
+// The samples of the always on sampling profiler (see flow/Profiler.h) of a process, by actor and task priority
+struct ProfileSampleEntry {
+	std::string actor;  // Empty for samples taken outside of any actor callback
+	int taskID;
+	int64_t samples;
+
+	ProfileSampleEntry() : taskID(0), samples(0) {}
+	ProfileSampleEntry( std::string const& actor, int taskID, int64_t samples ) : actor(actor), taskID(taskID), samples(samples) {}
+
+	template <class Ar>
+	void serialize( Ar& ar ) {
+		ar & actor & taskID & samples;
+	}
+};
+
+struct ProfileSamplesReply {
+	std::vector<ProfileSampleEntry> entries;  // In descending order of samples
+	int64_t dropped;
+	int periodMicroseconds;  // 0 if the process isn't running the sampling profiler
+
+	ProfileSamplesReply() : dropped(0), periodMicroseconds(0) {}
+
+	template <class Ar>
+	void serialize( Ar& ar ) {
+		ar & entries & dropped & periodMicroseconds;
+	}
+};
+
+struct ProfileSamplesRequest {
+	double duration;  // If positive, the reply has the samples taken over the next duration seconds, else all of them
+	ReplyPromise<ProfileSamplesReply> reply;
+
+	explicit ProfileSamplesRequest( double duration = 0 ) : duration(duration) {}
+
+	template <class Ar>
+	void serialize( Ar& ar ) {
+		ar & duration & reply;
+	}
+};
+
 #endif
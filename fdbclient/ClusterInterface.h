@@ -176,11 +176,15 @@ struct FailureMonitoringReply {
 };
 
 struct StatusRequest {
+	std::vector<std::string> statusFields;  // If not empty, the paths of the parts of the cluster status to reply with
 	ReplyPromise< struct StatusReply > reply;
 
 	template <class Ar>
 	void serialize(Ar& ar) {
 		ar & reply;
+		if( ar.protocolVersion() >= 0x0FDB00A560060001LL ) {
+			ar & statusFields;
+		}
 	}
 };
 
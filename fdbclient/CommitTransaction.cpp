@@ -0,0 +1,441 @@
+/*
+ * CommitTransaction.cpp
+ *
+ * This source file is part of the FoundationDB open source project
+ *
+ * Copyright 2013-2018 Apple Inc. and the FoundationDB project authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "CommitTransaction.h"
+#include "Knobs.h"
+#include "fdbrpc/zlib/zlib.h"
+#include "flow/UnitTest.h"
+
+// A packed transaction is:
+//   format version (one byte, currently 0)
+//   the number of keys, followed by each distinct key in ascending order as the length of the prefix it shares with the
+//     key before it, the length of the rest of the key, and the rest of the key
+//   the number of read conflict ranges, followed by each range as the index of its begin key and an end code
+//   the same for the write conflict ranges
+//   the number of mutations, followed by each mutation as its type (one byte), the index of param1, and then either an
+//     end code (for ClearRange and DebugKeyRange) or the length of param2 and param2
+//   read_snapshot (eight bytes)
+// An end code is (index << 1) | 1 for the key after the begin key, which is not itself in the table, and (index << 1) for
+// any other end key.  Lengths, counts, indices and end codes are all variable length integers.
+
+namespace {
+
+static bool hasKeyParam2( uint8_t type ) {
+	return type == MutationRef::ClearRange || type == MutationRef::DebugKeyRange;
+}
+
+struct PackWriter {
+	std::vector<uint8_t> out;
+
+	void writeVarint( uint64_t v ) {
+		while( v >= 0x80 ) {
+			out.push_back( uint8_t(v) | 0x80 );
+			v >>= 7;
+		}
+		out.push_back( uint8_t(v) );
+	}
+	void writeBytes( const uint8_t* b, int len ) { out.insert( out.end(), b, b + len ); }
+	void writeBytes( StringRef s ) { writeBytes( s.begin(), s.size() ); }
+};
+
+struct PackReader {
+	const uint8_t *p, *end;
+
+	explicit PackReader( StringRef s ) : p(s.begin()), end(s.end()) {}
+
+	uint64_t readVarint() {
+		uint64_t v = 0;
+		for(int shift = 0; shift < 64; shift += 7) {
+			if( p == end )
+				throw internal_error();
+			uint8_t b = *p++;
+			v |= uint64_t(b & 0x7f) << shift;
+			if( !(b & 0x80) )
+				return v;
+		}
+		throw internal_error();
+	}
+	int readLength() {
+		uint64_t v = readVarint();
+		if( v > uint64_t(end - p) )
+			throw internal_error();
+		return v;
+	}
+	StringRef readBytes( int len ) {
+		if( len > end - p )
+			throw internal_error();
+		StringRef s( p, len );
+		p += len;
+		return s;
+	}
+};
+
+struct KeyTable {
+	std::vector<StringRef> keys;
+
+	void add( StringRef key ) { keys.push_back( key ); }
+	void addEnd( StringRef begin, StringRef end ) {
+		if( !equalsKeyAfter( begin, end ) )
+			keys.push_back( end );
+	}
+	void finish() {
+		std::sort( keys.begin(), keys.end() );
+		keys.resize( std::unique( keys.begin(), keys.end() ) - keys.begin() );
+	}
+	uint64_t indexOf( StringRef key ) const {
+		return std::lower_bound( keys.begin(), keys.end(), key ) - keys.begin();
+	}
+	uint64_t endCode( StringRef begin, StringRef end ) const {
+		if( equalsKeyAfter( begin, end ) )
+			return (indexOf(begin) << 1) | 1;
+		return indexOf(end) << 1;
+	}
+};
+
+static void writeRanges( PackWriter& w, KeyTable const& table, VectorRef<KeyRangeRef> const& ranges ) {
+	w.writeVarint( ranges.size() );
+	for(auto& r : ranges) {
+		w.writeVarint( table.indexOf( r.begin ) );
+		w.writeVarint( table.endCode( r.begin, r.end ) );
+	}
+}
+
+static KeyRef readKey( PackReader& r, std::vector<KeyRef> const& keys ) {
+	uint64_t i = r.readVarint();
+	if( i >= keys.size() )
+		throw internal_error();
+	return keys[i];
+}
+
+static KeyRef readEnd( Arena& arena, PackReader& r, std::vector<KeyRef> const& keys ) {
+	uint64_t code = r.readVarint();
+	if( (code >> 1) >= keys.size() )
+		throw internal_error();
+	if( code & 1 )
+		return keyAfter( keys[code >> 1], arena );
+	return keys[code >> 1];
+}
+
+static void readRanges( Arena& arena, PackReader& r, std::vector<KeyRef> const& keys, VectorRef<KeyRangeRef>& ranges ) {
+	int count = r.readLength();  // Every range takes at least two bytes, so this bounds the allocation
+	ranges.reserve( arena, count );
+	for(int i = 0; i < count; i++) {
+		KeyRef begin = readKey( r, keys );
+		ranges.push_back( arena, KeyRangeRef( begin, readEnd( arena, r, keys ) ) );
+	}
+}
+
+static StringRef deflateIntoArena( Arena& arena, std::vector<uint8_t> const& in, int level ) {
+	z_stream stream;
+	memset( &stream, 0, sizeof(stream) );
+	if (deflateInit( &stream, level ) != Z_OK)
+		throw internal_error();
+	int bound = deflateBound( &stream, in.size() );
+	uint8_t* out = new (arena) uint8_t[ bound ];
+	stream.next_in = (Bytef*)&in[0];
+	stream.avail_in = in.size();
+	stream.next_out = out;
+	stream.avail_out = bound;
+	int r = deflate( &stream, Z_FINISH );
+	deflateEnd( &stream );
+	if (r != Z_STREAM_END)
+		throw internal_error();
+	return StringRef( out, stream.total_out );
+}
+
+static StringRef inflateIntoArena( Arena& arena, StringRef in, int32_t uncompressedSize ) {
+	if( uncompressedSize < 0 || uncompressedSize > CLIENT_KNOBS->TRANSACTION_SIZE_LIMIT * 2 )
+		throw internal_error();
+	uint8_t* out = new (arena) uint8_t[ uncompressedSize ];
+	z_stream stream;
+	memset( &stream, 0, sizeof(stream) );
+	if (inflateInit( &stream ) != Z_OK)
+		throw internal_error();
+	stream.next_in = (Bytef*)in.begin();
+	stream.avail_in = in.size();
+	stream.next_out = out;
+	stream.avail_out = uncompressedSize;
+	int r = inflate( &stream, Z_FINISH );
+	bool complete = r == Z_STREAM_END && stream.total_out == uncompressedSize;
+	inflateEnd( &stream );
+	if (!complete)
+		throw internal_error();
+	return StringRef( out, uncompressedSize );
+}
+
+static int commonPrefixLength( KeyRef a, KeyRef b ) {
+	int n = std::min( a.size(), b.size() ), i = 0;
+	while( i < n && a[i] == b[i] )
+		i++;
+	return i;
+}
+
+static void compactRanges( Arena& arena, VectorRef<KeyRangeRef>& ranges, int maxRanges ) {
+	std::sort( ranges.begin(), ranges.end(), KeyRangeRef::ArbitraryOrder() );
+	int count = 0;
+	for(int i = 0; i < ranges.size(); i++) {
+		if( ranges[i].empty() )
+			continue;
+		if( count && ranges[i].begin <= ranges[count-1].end ) {
+			if( ranges[i].end > ranges[count-1].end )
+				ranges[count-1] = KeyRangeRef( ranges[count-1].begin, ranges[i].end );
+		} else {
+			ranges[count++] = ranges[i];
+		}
+	}
+
+	if( maxRanges > 0 && count > maxRanges ) {
+		// Gap i lies between ranges i and i+1; the count - maxRanges gaps between the keys sharing the longest prefixes
+		// are bridged
+		std::vector<std::pair<int,int>> gaps;
+		gaps.reserve( count - 1 );
+		for(int i = 0; i + 1 < count; i++)
+			gaps.push_back( std::make_pair( -commonPrefixLength( ranges[i].end, ranges[i+1].begin ), i ) );
+		std::nth_element( gaps.begin(), gaps.begin() + (count - maxRanges), gaps.end() );
+
+		std::vector<bool> bridged( count - 1, false );
+		for(int i = 0; i < count - maxRanges; i++)
+			bridged[ gaps[i].second ] = true;
+
+		int widened = 0;
+		for(int i = 0; i < count; i++) {
+			if( i && bridged[i-1] )
+				ranges[widened-1] = KeyRangeRef( ranges[widened-1].begin, ranges[i].end );
+			else
+				ranges[widened++] = ranges[i];
+		}
+		count = widened;
+	}
+
+	ranges.resize( arena, count );
+}
+
+} // namespace
+
+void CommitTransactionRef::compactConflictRanges( Arena& arena, int maxRanges ) {
+	compactRanges( arena, read_conflict_ranges, maxRanges );
+	compactRanges( arena, write_conflict_ranges, maxRanges );
+}
+
+StringRef CommitTransactionRef::pack( Arena& arena, int compressMinBytes, int compressionLevel, int32_t& uncompressedSize ) const {
+	KeyTable table;
+	for(auto& r : read_conflict_ranges) {
+		table.add( r.begin );
+		table.addEnd( r.begin, r.end );
+	}
+	for(auto& r : write_conflict_ranges) {
+		table.add( r.begin );
+		table.addEnd( r.begin, r.end );
+	}
+	for(auto& m : mutations) {
+		table.add( m.param1 );
+		if( hasKeyParam2( m.type ) )
+			table.addEnd( m.param1, m.param2 );
+	}
+	table.finish();
+
+	PackWriter w;
+	w.out.reserve( expectedSize() / 2 + 64 );
+	w.out.push_back( 0 );
+
+	w.writeVarint( table.keys.size() );
+	StringRef last;
+	for(auto& k : table.keys) {
+		int shared = 0;
+		while( shared < last.size() && shared < k.size() && last[shared] == k[shared] )
+			shared++;
+		w.writeVarint( shared );
+		w.writeVarint( k.size() - shared );
+		w.writeBytes( k.begin() + shared, k.size() - shared );
+		last = k;
+	}
+
+	writeRanges( w, table, read_conflict_ranges );
+	writeRanges( w, table, write_conflict_ranges );
+
+	w.writeVarint( mutations.size() );
+	for(auto& m : mutations) {
+		w.out.push_back( m.type );
+		w.writeVarint( table.indexOf( m.param1 ) );
+		if( hasKeyParam2( m.type ) ) {
+			w.writeVarint( table.endCode( m.param1, m.param2 ) );
+		} else {
+			w.writeVarint( m.param2.size() );
+			w.writeBytes( m.param2 );
+		}
+	}
+
+	w.writeBytes( (const uint8_t*)&read_snapshot, sizeof(read_snapshot) );
+
+	if( w.out.size() >= compressMinBytes ) {
+		StringRef compressed = deflateIntoArena( arena, w.out, compressionLevel );
+		TEST( compressed.size() < w.out.size() ); // Commit request compressed
+		if( compressed.size() < w.out.size() ) {
+			uncompressedSize = w.out.size();
+			return compressed;
+		}
+	}
+	uncompressedSize = 0;
+	return StringRef( arena, StringRef( &w.out[0], w.out.size() ) );
+}
+
+CommitTransactionRef CommitTransactionRef::unpack( Arena& arena, StringRef packed, int32_t uncompressedSize ) {
+	if( uncompressedSize )
+		packed = inflateIntoArena( arena, packed, uncompressedSize );
+
+	PackReader r( packed );
+	if( r.readBytes(1)[0] != 0 )
+		throw internal_error();
+
+	// Every key takes at least two bytes, so the count cannot exceed the bytes left
+	std::vector<KeyRef> keys( r.readLength() );
+	KeyRef last;
+	for(auto& k : keys) {
+		int shared = r.readVarint();
+		int suffix = r.readLength();
+		if( shared > last.size() )
+			throw internal_error();
+		uint8_t* s = new (arena) uint8_t[ shared + suffix ];
+		memcpy( s, last.begin(), shared );
+		memcpy( s + shared, r.readBytes( suffix ).begin(), suffix );
+		k = last = KeyRef( s, shared + suffix );
+	}
+
+	CommitTransactionRef tr;
+	readRanges( arena, r, keys, tr.read_conflict_ranges );
+	readRanges( arena, r, keys, tr.write_conflict_ranges );
+
+	int count = r.readLength();
+	tr.mutations.reserve( arena, count );
+	for(int i = 0; i < count; i++) {
+		uint8_t type = r.readBytes(1)[0];
+		KeyRef param1 = readKey( r, keys );
+		StringRef param2 = hasKeyParam2( type ) ? readEnd( arena, r, keys ) : r.readBytes( r.readLength() );
+		tr.mutations.push_back( arena, MutationRef( (MutationRef::Type)type, param1, param2 ) );
+	}
+
+	memcpy( &tr.read_snapshot, r.readBytes( sizeof(tr.read_snapshot) ).begin(), sizeof(tr.read_snapshot) );
+	if( r.p != r.end )
+		throw internal_error();
+	return tr;
+}
+
+static KeyRef randomPackKey( Arena& arena ) {
+	static const char* prefixes[] = { "", "a", "apple/", "apple/pie/", "\xff" };
+	std::string s = prefixes[ g_random->randomInt(0, 5) ];
+	int len = g_random->randomInt(0, 6);
+	for(int i = 0; i < len; i++)
+		s += (char)( g_random->randomInt( 0, 4 ) + ( g_random->random01() < 0.1 ? 0 : 'a' ) );
+	return StringRef( arena, s );
+}
+
+static KeyRangeRef randomPackRange( Arena& arena ) {
+	KeyRef a = randomPackKey( arena );
+	if( g_random->coinflip() )
+		return singleKeyRange( a, arena );
+	KeyRef b = randomPackKey( arena );
+	return a < b ? KeyRangeRef( a, b ) : KeyRangeRef( b, a );
+}
+
+static bool sameTransaction( CommitTransactionRef const& a, CommitTransactionRef const& b ) {
+	if( a.read_snapshot != b.read_snapshot || a.read_conflict_ranges.size() != b.read_conflict_ranges.size() ||
+		a.write_conflict_ranges.size() != b.write_conflict_ranges.size() || a.mutations.size() != b.mutations.size() )
+		return false;
+	for(int i = 0; i < a.read_conflict_ranges.size(); i++)
+		if( a.read_conflict_ranges[i] != b.read_conflict_ranges[i] )
+			return false;
+	for(int i = 0; i < a.write_conflict_ranges.size(); i++)
+		if( a.write_conflict_ranges[i] != b.write_conflict_ranges[i] )
+			return false;
+	for(int i = 0; i < a.mutations.size(); i++)
+		if( a.mutations[i].type != b.mutations[i].type || a.mutations[i].param1 != b.mutations[i].param1 || a.mutations[i].param2 != b.mutations[i].param2 )
+			return false;
+	return true;
+}
+
+TEST_CASE("fdbclient/CommitTransaction/pack") {
+	for(int test = 0; test < 1000; test++) {
+		Arena arena;
+		CommitTransactionRef tr;
+		tr.read_snapshot = g_random->randomInt64( 0, 1e12 );
+		int reads = g_random->randomInt(0, 10), writes = g_random->randomInt(0, 10), mutations = g_random->randomInt(0, 10);
+		for(int i = 0; i < reads; i++)
+			tr.read_conflict_ranges.push_back( arena, randomPackRange( arena ) );
+		for(int i = 0; i < writes; i++)
+			tr.write_conflict_ranges.push_back( arena, randomPackRange( arena ) );
+		for(int i = 0; i < mutations; i++) {
+			int r = g_random->randomInt(0, 3);
+			if( r == 0 ) {
+				KeyRangeRef range = randomPackRange( arena );
+				tr.mutations.push_back( arena, MutationRef( MutationRef::ClearRange, range.begin, range.end ) );
+			} else {
+				MutationRef::Type type = r == 1 ? MutationRef::SetValue : MutationRef::AddValue;
+				std::string value( g_random->randomInt(0, 100), 'v' );
+				tr.mutations.push_back( arena, MutationRef( type, randomPackKey( arena ), StringRef( arena, value ) ) );
+			}
+		}
+
+		int32_t uncompressedSize;
+		Arena packedArena;
+		StringRef packed = tr.pack( packedArena, g_random->coinflip() ? 1 : 1e9, 1, uncompressedSize );
+
+		Arena unpackedArena;
+		CommitTransactionRef unpacked = CommitTransactionRef::unpack( unpackedArena, packed, uncompressedSize );
+		ASSERT( sameTransaction( tr, unpacked ) );
+	}
+	return Void();
+}
+
+static bool covers( VectorRef<KeyRangeRef> const& ranges, KeyRangeRef const& r ) {
+	for(auto& c : ranges)
+		if( c.contains( r ) )
+			return true;
+	return r.empty();
+}
+
+TEST_CASE("fdbclient/CommitTransaction/compactConflictRanges") {
+	for(int test = 0; test < 1000; test++) {
+		Arena arena;
+		CommitTransactionRef tr;
+		int reads = g_random->randomInt(0, 30), writes = g_random->randomInt(0, 30);
+		for(int i = 0; i < reads; i++)
+			tr.read_conflict_ranges.push_back( arena, randomPackRange( arena ) );
+		for(int i = 0; i < writes; i++)
+			tr.write_conflict_ranges.push_back( arena, randomPackRange( arena ) );
+
+		CommitTransactionRef compacted( arena, tr );
+		int maxRanges = g_random->randomInt(0, 10);
+		compacted.compactConflictRanges( arena, maxRanges );
+
+		for(auto* lists : { &compacted.read_conflict_ranges, &compacted.write_conflict_ranges }) {
+			auto& ranges = *lists;
+			ASSERT( !maxRanges || ranges.size() <= maxRanges );
+			for(int i = 0; i < ranges.size(); i++) {
+				ASSERT( !ranges[i].empty() );
+				ASSERT( !i || ranges[i-1].end < ranges[i].begin );
+			}
+		}
+		for(auto& r : tr.read_conflict_ranges)
+			ASSERT( covers( compacted.read_conflict_ranges, r ) );
+		for(auto& r : tr.write_conflict_ranges)
+			ASSERT( covers( compacted.write_conflict_ranges, r ) );
+	}
+	return Void();
+}
@@ -24,11 +24,11 @@
 
 #include "FDBTypes.h"
 
-static const char * typeString[] = { "SetValue", "ClearRange", "AddValue", "DebugKeyRange", "DebugKey", "NoOp", "And", "Or", "Xor", "AppendIfFits", "AvailableForReuse", "Reserved_For_LogProtocolMessage", "Max", "Min", "SetVersionstampedKey", "SetVersionstampedValue", "ByteMin", "ByteMax", "MinV2", "AndV2" };
+static const char * typeString[] = { "SetValue", "ClearRange", "AddValue", "DebugKeyRange", "DebugKey", "NoOp", "And", "Or", "Xor", "AppendIfFits", "AvailableForReuse", "Reserved_For_LogProtocolMessage", "Max", "Min", "SetVersionstampedKey", "SetVersionstampedValue", "ByteMin", "ByteMax", "MinV2", "AndV2", "SetIfAbsent", "CompareAndSet" };
 
 struct MutationRef { 
 	static const int OVERHEAD_BYTES = 12; //12 is the size of Header in MutationList entries
-	enum Type : uint8_t { SetValue=0, ClearRange, AddValue, DebugKeyRange, DebugKey, NoOp, And, Or, Xor, AppendIfFits, AvailableForReuse, Reserved_For_LogProtocolMessage /* See fdbserver/LogProtocolMessage.h */, Max, Min, SetVersionstampedKey, SetVersionstampedValue, ByteMin, ByteMax, MinV2, AndV2, MAX_ATOMIC_OP };
+	enum Type : uint8_t { SetValue=0, ClearRange, AddValue, DebugKeyRange, DebugKey, NoOp, And, Or, Xor, AppendIfFits, AvailableForReuse, Reserved_For_LogProtocolMessage /* See fdbserver/LogProtocolMessage.h */, Max, Min, SetVersionstampedKey, SetVersionstampedValue, ByteMin, ByteMax, MinV2, AndV2, SetIfAbsent, CompareAndSet, MAX_ATOMIC_OP };
 	// This is stored this way for serialization purposes.
 	uint8_t type;
 	StringRef param1, param2;
@@ -55,7 +55,7 @@ struct MutationRef {
 
 	// These masks define which mutation types have particular properties (they are used to implement isSingleKeyMutation() etc)
 	enum { 
-		ATOMIC_MASK = (1 << AddValue) | (1 << And) | (1 << Or) | (1 << Xor) | (1 << AppendIfFits) | (1 << Max) | (1 << Min) | (1 << SetVersionstampedKey) | (1 << SetVersionstampedValue) | (1 << ByteMin) | (1 << ByteMax) | (1 << MinV2) | (1 << AndV2),
+		ATOMIC_MASK = (1 << AddValue) | (1 << And) | (1 << Or) | (1 << Xor) | (1 << AppendIfFits) | (1 << Max) | (1 << Min) | (1 << SetVersionstampedKey) | (1 << SetVersionstampedValue) | (1 << ByteMin) | (1 << ByteMax) | (1 << MinV2) | (1 << AndV2) | (1 << SetIfAbsent) | (1 << CompareAndSet),
 		SINGLE_KEY_MASK = ATOMIC_MASK | (1<<SetValue),
 		NON_ASSOCIATIVE_MASK = (1 << AddValue) | (1 << Or) | (1 << Xor) | (1 << Max) | (1 << Min) | (1 << SetVersionstampedKey) | (1 << SetVersionstampedValue) | (1 << MinV2)
 	};
@@ -118,6 +118,21 @@ struct CommitTransactionRef {
 	size_t expectedSize() const {
 		return read_conflict_ranges.expectedSize() + write_conflict_ranges.expectedSize() + mutations.expectedSize();
 	}
+
+	// Replaces the read and the write conflict ranges each by their union, in ascending order.  If either still has more
+	// than maxRanges ranges and maxRanges is not 0, the gaps between its closest ranges (those whose keys share the
+	// longest prefixes) are added to it until it has maxRanges.  The transaction then conflicts with at least everything
+	// it did before, so this trades false conflicts for cheaper conflict resolution.
+	void compactConflictRanges( Arena& arena, int maxRanges );
+
+	// Encodes the transaction into arena with each distinct key written once, prefix compressed in sorted order, and the
+	// conflict ranges and mutations referring to keys by their position.  If the encoding is at least compressMinBytes long
+	// it is also compressed, in which case uncompressedSize is set to its original length (and otherwise to 0).
+	StringRef pack( Arena& arena, int compressMinBytes, int compressionLevel, int32_t& uncompressedSize ) const;
+
+	// Decodes a transaction encoded by pack().  Keys are allocated in arena and values refer into packed or into arena.
+	// Throws internal_error() if packed is not a valid encoding.
+	static CommitTransactionRef unpack( Arena& arena, StringRef packed, int32_t uncompressedSize );
 };
 
 bool debugMutation( const char* context, Version version, MutationRef const& m );
@@ -527,15 +527,53 @@ namespace dbBackup {
 		Future<Void> execute(Database cx, Reference<TaskBucket> tb, Reference<FutureBucket> fb, Reference<Task> task) { return _execute(cx, tb, fb, task); };
 		Future<Void> finish(Reference<ReadYourWritesTransaction> tr, Reference<TaskBucket> tb, Reference<FutureBucket> fb, Reference<Task> task) { return _finish(tr, tb, fb, task); };
 
+		// Writes one batch of source log mutations into the destination's apply log keyspace.  Batches cover disjoint
+		// versions and are only applied once the whole log range has been copied, so they can be committed in any order.
+		ACTOR static Future<Void> commitMutations(Database cx, Reference<Task> task, std::vector<Standalone<RangeResultRef>> mutations, FlowLock* commitLock) {
+			state FlowLock::Releaser releaser(*commitLock, 1);
+			state Transaction tr(cx);
+
+			loop{
+				try {
+					tr.setOption(FDBTransactionOptions::LOCK_AWARE);
+					tr.options.customTransactionSizeLimit = 2 * CLIENT_KNOBS->TRANSACTION_SIZE_LIMIT;
+					Void _ = wait(checkDatabaseLock(&tr, BinaryReader::fromStringRef<UID>(task->params[BackupAgentBase::keyConfigLogUid], Unversioned())));
+					state int64_t bytesSet = 0;
+
+					bool first = true;
+					for(auto m : mutations) {
+						for(auto kv : m) {
+							if(first) {
+								tr.addReadConflictRange(singleKeyRange(kv.key));
+								first = false;
+							}
+							tr.set(kv.key.removePrefix(backupLogKeys.begin).removePrefix(task->params[BackupAgentBase::destUid]).withPrefix(task->params[BackupAgentBase::keyConfigLogUid]).withPrefix(applyLogKeys.begin), kv.value);
+							bytesSet += kv.expectedSize() - backupLogKeys.begin.expectedSize() + applyLogKeys.begin.expectedSize();
+						}
+					}
+
+					Void _ = wait(tr.commit());
+					Params.bytesWritten().set(task, Params.bytesWritten().getOrDefault(task) + bytesSet);
+					return Void();
+				}
+				catch (Error &e) {
+					Void _ = wait(tr.onError(e));
+				}
+			}
+		}
+
 		ACTOR static Future<Void> dumpData(Database cx, Reference<Task> task, PromiseStream<RCGroup> results, FlowLock* lock, Reference<TaskBucket> tb) {
 			state bool endOfStream = false;
 			state Subspace conf = Subspace(databaseBackupPrefixRange.begin).get(BackupAgentBase::keyConfig).get(task->params[BackupAgentBase::keyConfigLogUid]);
 
 			state std::vector<Standalone<RangeResultRef>> nextMutations;
 			state int64_t nextMutationSize = 0;
+			state FlowLock commitLock(CLIENT_KNOBS->BACKUP_LOG_WRITE_PARALLELISM);
+			state std::vector<Future<Void>> commits;
 			loop{
 				try {
 					if (endOfStream && !nextMutationSize) {
+						Void _ = wait(waitForAll(commits));
 						return Void();
 					}
 
@@ -573,35 +611,17 @@ namespace dbBackup {
 						}
 					}
 
-					state Transaction tr(cx);
-
-					loop{
-						try {
-							tr.setOption(FDBTransactionOptions::LOCK_AWARE);
-							tr.options.customTransactionSizeLimit = 2 * CLIENT_KNOBS->TRANSACTION_SIZE_LIMIT;
-							Void _ = wait(checkDatabaseLock(&tr, BinaryReader::fromStringRef<UID>(task->params[BackupAgentBase::keyConfigLogUid], Unversioned())));
-							state int64_t bytesSet = 0;
-
-							bool first = true;
-							for(auto m : mutations) {
-								for(auto kv : m) {
-									if(first) {
-										tr.addReadConflictRange(singleKeyRange(kv.key));
-										first = false;
-									}
-									tr.set(kv.key.removePrefix(backupLogKeys.begin).removePrefix(task->params[BackupAgentBase::destUid]).withPrefix(task->params[BackupAgentBase::keyConfigLogUid]).withPrefix(applyLogKeys.begin), kv.value);
-									bytesSet += kv.expectedSize() - backupLogKeys.begin.expectedSize() + applyLogKeys.begin.expectedSize();
-								}
-							}
-
-							Void _ = wait(tr.commit());
-							Params.bytesWritten().set(task, Params.bytesWritten().getOrDefault(task) + bytesSet);
-							break;
-						}
-						catch (Error &e) {
-							Void _ = wait(tr.onError(e));
+					// Keep reading the next batch while up to BACKUP_LOG_WRITE_PARALLELISM earlier ones are committing
+					Void _ = wait(commitLock.take());
+					for(int i = 0; i < commits.size(); ++i) {
+						if(commits[i].isReady()) {
+							commits[i].get();  // Throws if the commit failed
+							commits[i] = commits.back();
+							commits.pop_back();
+							--i;
 						}
 					}
+					commits.push_back(commitMutations(cx, task, mutations, &commitLock));
 				}
 				catch (Error &e) {
 					if (e.code() == error_code_actor_cancelled || e.code() == error_code_backup_error)
@@ -44,6 +44,29 @@ private:
 	LocationInfo( DatabaseContext* cx, vector<StorageServerInterface> const& shards, LocalityData const& clientLocality ) : cx(cx), MultiInterface( shards, clientLocality ) {}
 };
 
+// An entry of the location cache.  lastUsed lets eviction prefer the ranges that have gone longest without a lookup.
+struct CachedLocation {
+	Reference<LocationInfo> locations;
+	double lastUsed;
+
+	CachedLocation() : lastUsed(0) {}
+	CachedLocation( Reference<LocationInfo> const& locations, double lastUsed ) : locations(locations), lastUsed(lastUsed) {}
+
+	bool operator == ( CachedLocation const& r ) const { return locations == r.locations && lastUsed == r.lastUsed; }
+	bool operator != ( CachedLocation const& r ) const { return !(*this == r); }
+};
+
+// The watches of a database on a key with the same value, which share one watch on the storage server and count once
+// towards the database's limit on watches.  It is held by the actors of the watches, which keep the database alive.
+struct WatchMetadata : public ReferenceCounted<WatchMetadata>, NonCopyable {
+	DatabaseContext* cx;
+	std::pair<Key, Optional<Value>> keyValue;
+	Future<Void> watchFuture;	// The shared watch, once the transaction of one of the watches has committed
+
+	WatchMetadata( DatabaseContext* cx, std::pair<Key, Optional<Value>> const& keyValue ) : cx(cx), keyValue(keyValue) {}
+	~WatchMetadata();
+};
+
 class ProxyInfo : public MultiInterface<MasterProxyInterface> {
 public:
 	ProxyInfo( vector<MasterProxyInterface> const& proxies, LocalityData const& clientLocality ) : MultiInterface( proxies, clientLocality, ALWAYS_FRESH ) {}
@@ -66,14 +89,23 @@ public:
 	Reference<LocationInfo> setCachedLocation( const KeyRangeRef&, const vector<struct StorageServerInterface>& );
 	void invalidateCache( const KeyRef&, bool isBackward = false );
 	void invalidateCache( const KeyRangeRef& );
+	void evictCachedLocation();
+
+	// Loads the locations of keys into the cache in the background, and again after each change of proxies
+	void prefetchLocations( KeyRange const& keys );
 
 	Reference<ProxyInfo> getMasterProxies();
 	Future<Reference<ProxyInfo>> getMasterProxiesFuture();
+	// The proxies to send GetReadVersionRequests to: the cluster's GRV proxies if it has any, else getMasterProxies()
+	Reference<ProxyInfo> getGrvProxies();
 	Future<Void> onMasterProxiesChanged();
 
 	// Update the watch counter for the database
 	void addWatch();
 	void removeWatch();
+
+	// Returns the entry for watches on key with value, adding one (and counting a watch) if there is none
+	Reference<WatchMetadata> getWatchMetadata( Key const& key, Optional<Value> const& value );
 	
 	void setOption( FDBDatabaseOptions::Option option, Optional<StringRef> value );
 
@@ -101,6 +133,7 @@ public:
 	AsyncTrigger masterProxiesChangeTrigger;
 	Future<Void> monitorMasterProxiesInfoChange;
 	Reference<ProxyInfo> masterProxies;
+	Reference<ProxyInfo> grvProxies;
 	UID masterProxiesLastChange;
 	LocalityData clientLocality;
 	QueueModel queueModel;
@@ -111,7 +144,42 @@ public:
 		PromiseStream< std::pair< Promise<GetReadVersionReply>, Optional<UID> > > stream;
 		Future<Void> actor;
 	};
-	std::map<uint32_t, VersionBatcher> versionBatcher;
+	std::map<std::pair<uint32_t, Key>, VersionBatcher> versionBatcher;  // By flags and tag
+
+	// Storage metrics wait batching
+	struct MetricsBatcher {
+		PromiseStream< WaitMetricsRequest > stream;
+		Future<Void> actor;
+	};
+	std::map<UID, MetricsBatcher> metricsBatcher;  // By the token of the storage server's waitMetricsBatch endpoint
+
+	// The newest read version received from the proxies, which transactions that set max_read_version_staleness reuse
+	Version cachedReadVersion;
+	double cachedReadVersionTime;  // When the request that returned cachedReadVersion was sent
+	bool cachedReadVersionLocked;
+	Future<Void> cachedReadVersionRefresh;
+	void updateCachedReadVersion( GetReadVersionReply const& rep, double requestTime );
+
+	// Set by read_version_lag, so that the storage servers of a remote region, which lag those of the primary, can serve
+	// this client's reads when it is in that region
+	Version readVersionLag;
+	Version laggedReadVersion( Version v ) const { return std::max<Version>( v - readVersionLag, 0 ); }
+
+	// Values read under the prefixes set by read_cache_prefix, which are shared by the transactions on this database.
+	// The key equal to each prefix is its stamp: a transaction that writes under the prefix must also set the stamp to a
+	// value it has never had, e.g. with SetVersionstampedValue.  A transaction reads the stamp once, at its read version,
+	// and then uses the cached values only if they were read with the same stamp, since no key under the prefix can
+	// have changed between their version and its own.
+	struct ReadCache {
+		Optional<Value> stamp;
+		std::map<Key, Optional<Value>> values;
+	};
+	std::map<Key, ReadCache> readCaches;  // By prefix
+	int64_t readCacheHits;
+	int64_t readCacheMisses;
+
+	// Returns the read_cache_prefix that key is cached under, if any.  The stamp itself is not cached.
+	Optional<Key> readCachePrefix( KeyRef const& key ) const;
 
 	// Client status updater
 	struct ClientStatusUpdater {
@@ -123,7 +191,12 @@ public:
 
 	// Cache of location information
 	int locationCacheSize;
-	CoalescedKeyRangeMap< Reference<LocationInfo> > locationCache;
+	CoalescedKeyRangeMap< CachedLocation > locationCache;
+	int64_t locationCacheHits;
+	int64_t locationCacheMisses;
+	int64_t locationCacheEvictions;
+	std::vector<KeyRange> locationPrefetchRanges;
+	Future<Void> locationPrefetcher;
 
 	std::map< std::vector<UID>, LocationInfo* > ssid_locationInfo;
 
@@ -132,6 +205,7 @@ public:
 	Standalone<StringRef> dbId;
 
 	int64_t transactionReadVersions;
+	int64_t transactionCachedReadVersions;
 	int64_t transactionLogicalReads;
 	int64_t transactionPhysicalReads;
 	int64_t transactionCommittedMutations;
@@ -144,8 +218,9 @@ public:
 	int64_t transactionsMaybeCommitted; 
 	ContinuousSample<double> latencies, readLatencies, commitLatencies, GRVLatencies, mutationsPerCommit, bytesPerCommit;
 
-	int outstandingWatches;
+	int outstandingWatches;	// Of distinct keys and values
 	int maxOutstandingWatches;
+	std::map<std::pair<Key, Optional<Value>>, WatchMetadata*> watchMap;
 
 	Future<Void> logger;
 
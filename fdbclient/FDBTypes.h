@@ -421,15 +421,16 @@ static inline KeyRangeWith<Val> keyRangeWith( const KeyRangeRef& range, const Va
 }
 
 struct GetRangeLimits {
-	enum { ROW_LIMIT_UNLIMITED = -1, BYTE_LIMIT_UNLIMITED = -1 };
+	enum { ROW_LIMIT_UNLIMITED = -1, BYTE_LIMIT_UNLIMITED = -1, VALUE_BYTES_UNLIMITED = -1 };
 
 	int rows;
 	int minRows;
 	int bytes;
+	int valueBytes;  // If not VALUE_BYTES_UNLIMITED, only the first valueBytes bytes of each value are read, so 0 reads only keys
 
-	GetRangeLimits() : rows( ROW_LIMIT_UNLIMITED ), minRows(1), bytes( BYTE_LIMIT_UNLIMITED ) {}
-	explicit GetRangeLimits( int rowLimit ) : rows( rowLimit ), minRows(1), bytes( BYTE_LIMIT_UNLIMITED ) {}
-	GetRangeLimits( int rowLimit, int byteLimit ) : rows( rowLimit ), minRows(1), bytes( byteLimit ) {}
+	GetRangeLimits() : rows( ROW_LIMIT_UNLIMITED ), minRows(1), bytes( BYTE_LIMIT_UNLIMITED ), valueBytes( VALUE_BYTES_UNLIMITED ) {}
+	explicit GetRangeLimits( int rowLimit ) : rows( rowLimit ), minRows(1), bytes( BYTE_LIMIT_UNLIMITED ), valueBytes( VALUE_BYTES_UNLIMITED ) {}
+	GetRangeLimits( int rowLimit, int byteLimit ) : rows( rowLimit ), minRows(1), bytes( byteLimit ), valueBytes( VALUE_BYTES_UNLIMITED ) {}
 
 	void decrement( VectorRef<KeyValueRef> const& data );
 	void decrement( KeyValueRef const& data );
@@ -442,10 +443,15 @@ struct GetRangeLimits {
 
 	bool hasByteLimit();
 	bool hasRowLimit();
+	bool hasValueLimit() const { return valueBytes != VALUE_BYTES_UNLIMITED; }
+
+	// Cuts each value in data to the first valueBytes bytes
+	void truncateValues( VectorRef<KeyValueRef>& data ) const;
 
 	bool hasSatisfiedMinRows();
 	bool isValid() { return (rows >= 0 || rows == ROW_LIMIT_UNLIMITED)
 							&& (bytes >= 0 || bytes == BYTE_LIMIT_UNLIMITED)
+							&& (valueBytes >= 0 || valueBytes == VALUE_BYTES_UNLIMITED)
 							&& minRows >= 0 && (minRows <= rows || rows == ROW_LIMIT_UNLIMITED); }
 };
 
@@ -474,6 +480,7 @@ struct KeyValueStoreType {
 		SSD_BTREE_V1,
 		MEMORY,
 		SSD_BTREE_V2,
+		SSD_LSM,
 		END
 	};
 
@@ -492,6 +499,7 @@ struct KeyValueStoreType {
 			case SSD_BTREE_V1: return "ssd-1";
 			case SSD_BTREE_V2: return "ssd-2";
 			case MEMORY: return "memory";
+			case SSD_LSM: return "ssd-lsm";
 			default: return "unknown";
 		}
 	}
@@ -30,6 +30,9 @@
 #include "fdbrpc/IAsyncFile.h"
 #include "flow/genericactors.actor.h"
 #include "flow/Hash3.h"
+#include "fdbrpc/crc32c.h"
+#include "fdbrpc/zlib/zlib.h"
+#include "flow/UnitTest.h"
 #include <numeric>
 #include <boost/algorithm/string/split.hpp>
 #include <boost/algorithm/string/classification.hpp>
@@ -439,40 +442,151 @@ namespace fileBackup {
 	//   if the next KV pair wouldn't fit within the block after the value
 	//   then the space after the final key to the next 1MB boundary would
 	//   just be padding anyway.
+	//
+	// Compressed files (range version 1002, log version 2002) have the same blocks at the same offsets, but after its
+	// version each block holds a BackupBlockCompressor block whose data is what would follow the version in an
+	// uncompressed block, so a block can hold more than blockSize bytes of keys and values.
+	//
+	// Writers of compressed files buffer the current block, so finish() must be called after the last write.
+
+	// Builds the blocks of compressed backup files.  The data of a block is deflated as it is added, with a sync flush
+	// whenever the data not yet deflated might not fit, so that whether more data fits is always known exactly.  After
+	// the version, a block is its uncompressed length, compressed length and the CRC32C of the compressed bytes (each a
+	// big endian uint32), the compressed bytes and then 0xFF padding up to the block size.
+	struct BackupBlockCompressor : ReferenceCounted<BackupBlockCompressor>, NonCopyable {
+		enum { HEADER_BYTES = 4 * sizeof(uint32_t), MAX_EXPANSION = 8 };
+
+		BackupBlockCompressor(int blockSize, int level) : blockSize(blockSize), inputBytes(0), started(false) {
+			memset( &stream, 0, sizeof(stream) );
+			if (deflateInit( &stream, level ) != Z_OK)
+				throw internal_error();
+			out = std::string(blockSize, '\xff');
+		}
+		~BackupBlockCompressor() { deflateEnd( &stream ); }
+
+		void start() {
+			if (started && deflateReset( &stream ) != Z_OK)
+				throw internal_error();
+			started = true;
+			pending.clear();
+			inputBytes = 0;
+			memset( &out[0], 0xFF, out.size() );
+			stream.next_out = (Bytef*)&out[HEADER_BYTES];
+			stream.avail_out = blockSize - HEADER_BYTES;
+		}
+
+		// The most that deflating bytes and then finishing the stream can add to the output.  This is more than zlib's
+		// own bound (as deflateBound() exceeds the input by only a few bytes per 16KB) so that it also covers a sync flush.
+		static int maxDeflatedSize( int bytes ) { return bytes + (bytes >> 10) + 64; }
+
+		// Returns whether bytes more bytes of data fit in the block
+		bool fits( int bytes ) {
+			if (inputBytes + pending.size() + bytes > (int64_t)blockSize * MAX_EXPANSION)
+				return false;
+			if (maxDeflatedSize( pending.size() + bytes ) <= stream.avail_out)
+				return true;
+			if (pending.empty())
+				return false;
+			deflatePending( Z_SYNC_FLUSH );
+			return maxDeflatedSize( bytes ) <= stream.avail_out;
+		}
+
+		// Adds data, which must fit
+		void append( const uint8_t* data, int len ) { pending.append( (const char*)data, len ); }
+		void appendStringRefWithLen( StringRef s ) {
+			uint32_t lenBuf = bigEndian32( (uint32_t)s.size() );
+			append( (const uint8_t*)&lenBuf, sizeof(lenBuf) );
+			append( s.begin(), s.size() );
+		}
+
+		// Returns the finished block, which stays valid until start() is next called.  If pad is false the block ends
+		// after its compressed bytes, as the last block of a file does.
+		StringRef finish( uint32_t version, bool pad ) {
+			deflatePending( Z_FINISH );
+			int compressedBytes = stream.total_out;
+			uint32_t header[4] = { version, bigEndian32( (uint32_t)inputBytes ), bigEndian32( (uint32_t)compressedBytes ),
+				bigEndian32( crc32c_append( 0, (const uint8_t*)&out[HEADER_BYTES], compressedBytes ) ) };
+			memcpy( &out[0], header, sizeof(header) );
+			TEST( pad && inputBytes > blockSize ); // Compressed backup block holds more than its size
+			return StringRef( (const uint8_t*)out.data(), pad ? blockSize : HEADER_BYTES + compressedBytes );
+		}
+
+	private:
+		void deflatePending( int flush ) {
+			stream.next_in = (Bytef*)pending.data();
+			stream.avail_in = pending.size();
+			int r = deflate( &stream, flush );
+			if (stream.avail_in != 0 || (flush == Z_FINISH ? r != Z_STREAM_END : r != Z_OK))
+				throw internal_error();
+			inputBytes += pending.size();
+			pending.clear();
+		}
+
+		z_stream stream;
+		int blockSize;
+		int64_t inputBytes;
+		bool started;
+		std::string pending;
+		std::string out;
+	};
+
 	struct RangeFileWriter {
-		RangeFileWriter(Reference<IBackupFile> file = Reference<IBackupFile>(), int blockSize = 0) : file(file), blockSize(blockSize), blockEnd(0), fileVersion(1001) {}
+		RangeFileWriter(Reference<IBackupFile> file = Reference<IBackupFile>(), int blockSize = 0, bool compress = false) : file(file), blockSize(blockSize), blockEnd(0), fileVersion(compress ? 1002 : 1001) {
+			if(compress)
+				block = Reference<BackupBlockCompressor>(new BackupBlockCompressor(blockSize, CLIENT_KNOBS->BACKUP_COMPRESSION_LEVEL));
+		}
 
 		// Handles the first block and internal blocks.  Ends current block if needed.
 		ACTOR static Future<Void> newBlock(RangeFileWriter *self, int bytesNeeded) {
-			// Write padding to finish current block if needed
-			int bytesLeft = self->blockEnd - self->file->size();
-			if(bytesLeft > 0) {
-				Void _ = wait(self->file->append((uint8_t *)paddingFFs.data(), bytesLeft));
+			if(self->block) {
+				if(self->blockEnd > 0)
+					Void _ = wait(self->file->append(self->block->finish(self->fileVersion, true).begin(), self->blockSize));
+				self->block->start();
+			} else {
+				// Write padding to finish current block if needed
+				int bytesLeft = self->blockEnd - self->file->size();
+				if(bytesLeft > 0) {
+					Void _ = wait(self->file->append((uint8_t *)paddingFFs.data(), bytesLeft));
+				}
+
+				// write Header
+				Void _ = wait(self->file->append((uint8_t *)&self->fileVersion, sizeof(self->fileVersion)));
 			}
 
 			// Set new blockEnd
 			self->blockEnd += self->blockSize;
 
-			// write Header
-			Void _ = wait(self->file->append((uint8_t *)&self->fileVersion, sizeof(self->fileVersion)));
-
 			// If this is NOT the first block then write duplicate stuff needed from last block
 			if(self->blockEnd > self->blockSize) {
-				Void _ = wait(self->file->appendStringRefWithLen(self->lastKey));
-				Void _ = wait(self->file->appendStringRefWithLen(self->lastKey));
-				Void _ = wait(self->file->appendStringRefWithLen(self->lastValue));
+				Void _ = wait(self->appendStringRefWithLen(self->lastKey));
+				Void _ = wait(self->appendStringRefWithLen(self->lastKey));
+				Void _ = wait(self->appendStringRefWithLen(self->lastValue));
 			}
 
 			// There must now be room in the current block for bytesNeeded or the block size is too small
-			if(self->file->size() + bytesNeeded > self->blockEnd)
+			if(!self->fits(bytesNeeded))
 				throw backup_bad_block_size();
 
 			return Void();
 		}
 
+		bool fits(int bytesNeeded) {
+			if(block)
+				return blockEnd > 0 && block->fits(bytesNeeded);
+			return file->size() + bytesNeeded <= blockEnd;
+		}
+
+		Future<Void> appendStringRefWithLen(Key s) {
+			if(block) {
+				block->appendStringRefWithLen(s);
+				return Void();
+			}
+			return file->appendStringRefWithLen(s);
+		}
+
 		// Ends the current block if necessary based on bytesNeeded.
 		Future<Void> newBlockIfNeeded(int bytesNeeded) {
-			if(file->size() + bytesNeeded > blockEnd)
+			if(!fits(bytesNeeded))
 				return newBlock(this, bytesNeeded);
 			return Void();
 		}
@@ -481,8 +595,8 @@ namespace fileBackup {
 		ACTOR static Future<Void> writeKV_impl(RangeFileWriter *self, Key k, Value v) {
 			int toWrite = sizeof(int32_t) + k.size() + sizeof(int32_t) + v.size();
 			Void _ = wait(self->newBlockIfNeeded(toWrite));
-			Void _ = wait(self->file->appendStringRefWithLen(k));
-			Void _ = wait(self->file->appendStringRefWithLen(v));
+			Void _ = wait(self->appendStringRefWithLen(k));
+			Void _ = wait(self->appendStringRefWithLen(v));
 			self->lastKey = k;
 			self->lastValue = v;
 			return Void();
@@ -494,12 +608,21 @@ namespace fileBackup {
 		ACTOR static Future<Void> writeKey_impl(RangeFileWriter *self, Key k) {
 			int toWrite = sizeof(uint32_t) + k.size();
 			Void _ = wait(self->newBlockIfNeeded(toWrite));
-			Void _ = wait(self->file->appendStringRefWithLen(k));
+			Void _ = wait(self->appendStringRefWithLen(k));
 			return Void();
 		}
 
 		Future<Void> writeKey(Key k) { return writeKey_impl(this, k); }
 
+		// Writes the last block of a compressed file
+		Future<Void> finish() {
+			if(block && blockEnd > 0) {
+				StringRef last = block->finish(fileVersion, false);
+				return file->append(last.begin(), last.size());
+			}
+			return Void();
+		}
+
 		Reference<IBackupFile> file;
 		int blockSize;
 
@@ -508,6 +631,7 @@ namespace fileBackup {
 		uint32_t fileVersion;
 		Key lastKey;
 		Key lastValue;
+		Reference<BackupBlockCompressor> block;
 	};
 
 	// Helper class for reading restore data from a buffer and throwing the right errors.
@@ -546,6 +670,33 @@ namespace fileBackup {
 		Error failure_error;
 	};
 
+	// Checks and uncompresses the rest of a compressed block, which reader has read the version of.  The result is
+	// allocated in arena.
+	static StringRef uncompressBackupBlock( Arena& arena, StringRefReader& reader, int blockLen ) {
+		uint32_t uncompressedBytes = reader.consumeNetworkUInt32();
+		uint32_t compressedBytes = reader.consumeNetworkUInt32();
+		uint32_t checksum = reader.consumeNetworkUInt32();
+		const uint8_t* compressed = reader.consume(compressedBytes);
+		if(crc32c_append(0, compressed, compressedBytes) != checksum || uncompressedBytes > (int64_t)blockLen * BackupBlockCompressor::MAX_EXPANSION)
+			throw restore_corrupted_data();
+
+		uint8_t* data = new (arena) uint8_t[uncompressedBytes];
+		z_stream stream;
+		memset( &stream, 0, sizeof(stream) );
+		if (inflateInit( &stream ) != Z_OK)
+			throw internal_error();
+		stream.next_in = (Bytef*)compressed;
+		stream.avail_in = compressedBytes;
+		stream.next_out = data;
+		stream.avail_out = uncompressedBytes;
+		int r = inflate( &stream, Z_FINISH );
+		bool complete = r == Z_STREAM_END && stream.total_out == uncompressedBytes;
+		inflateEnd( &stream );
+		if (!complete)
+			throw restore_corrupted_data();
+		return StringRef(data, uncompressedBytes);
+	}
+
 	ACTOR Future<Standalone<VectorRef<KeyValueRef>>> decodeRangeFileBlock(Reference<IAsyncFile> file, int64_t offset, int len) {
 		state Standalone<StringRef> buf = makeString(len);
 		int rLen = wait(file->read(mutateString(buf), len, offset));
@@ -556,41 +707,50 @@ namespace fileBackup {
 		state StringRefReader reader(buf, restore_corrupted_data());
 
 		try {
-			// Read header, currently only decoding version 1001
-			if(reader.consume<int32_t>() != 1001)
+			// Read header, decoding version 1001 or its compressed form 1002
+			StringRefReader *data = &reader;
+			StringRefReader uncompressed;
+			int32_t version = reader.consume<int32_t>();
+			if(version == 1002) {
+				uncompressed = StringRefReader(uncompressBackupBlock(results.arena(), reader, len), restore_corrupted_data());
+				data = &uncompressed;
+			} else if(version != 1001) {
 				throw restore_unsupported_file_version();
+			}
 
 			// Read begin key, if this fails then block was invalid.
-			uint32_t kLen = reader.consumeNetworkUInt32();
-			const uint8_t *k = reader.consume(kLen);
+			uint32_t kLen = data->consumeNetworkUInt32();
+			const uint8_t *k = data->consume(kLen);
 			results.push_back(results.arena(), KeyValueRef(KeyRef(k, kLen), ValueRef()));
 
 			// Read kv pairs and end key
 			while(1) {
 				// Read a key.
-				kLen = reader.consumeNetworkUInt32();
-				k = reader.consume(kLen);
+				kLen = data->consumeNetworkUInt32();
+				k = data->consume(kLen);
 
 				// If eof reached or first value len byte is 0xFF then a valid block end was reached.
-				if(reader.eof() || *reader.rptr == 0xFF) {
+				if(data->eof() || *data->rptr == 0xFF) {
 					results.push_back(results.arena(), KeyValueRef(KeyRef(k, kLen), ValueRef()));
 					break;
 				}
 
 				// Read a value, which must exist or the block is invalid
-				uint32_t vLen = reader.consumeNetworkUInt32();
-				const uint8_t *v = reader.consume(vLen);
+				uint32_t vLen = data->consumeNetworkUInt32();
+				const uint8_t *v = data->consume(vLen);
 				results.push_back(results.arena(), KeyValueRef(KeyRef(k, kLen), ValueRef(v, vLen)));
 
 				// If eof reached or first byte of next key len is 0xFF then a valid block end was reached.
-				if(reader.eof() || *reader.rptr == 0xFF)
+				if(data->eof() || *data->rptr == 0xFF)
 					break;
 			}
 
-			// Make sure any remaining bytes in the block are 0xFF
+			// Make sure any remaining bytes in the block are 0xFF, and that all of the uncompressed data was read
 			for(auto b : reader.remainder())
 				if(b != 0xFF)
 					throw restore_corrupted_data_padding();
+			if(!data->eof() && data != &reader)
+				throw restore_corrupted_data();
 
 			return results;
 
@@ -612,12 +772,29 @@ namespace fileBackup {
 	struct LogFileWriter {
 		static const std::string &FFs;
 
-		LogFileWriter(Reference<IBackupFile> file = Reference<IBackupFile>(), int blockSize = 0) : file(file), blockSize(blockSize), blockEnd(0), fileVersion(2001) {}
+		LogFileWriter(Reference<IBackupFile> file = Reference<IBackupFile>(), int blockSize = 0, bool compress = false) : file(file), blockSize(blockSize), blockEnd(0), fileVersion(compress ? 2002 : 2001) {
+			if(compress)
+				block = Reference<BackupBlockCompressor>(new BackupBlockCompressor(blockSize, CLIENT_KNOBS->BACKUP_COMPRESSION_LEVEL));
+		}
 
 		// Start a new block if needed, then write the key and value
 		ACTOR static Future<Void> writeKV_impl(LogFileWriter *self, Key k, Value v) {
 			// If key and value do not fit in this block, end it and start a new one
-			int toWrite = sizeof(int32_t) + k.size() + sizeof(int32_t) + v.size();
+			state int toWrite = sizeof(int32_t) + k.size() + sizeof(int32_t) + v.size();
+			if(self->block) {
+				if(self->blockEnd == 0 || !self->block->fits(toWrite)) {
+					if(self->blockEnd > 0)
+						Void _ = wait(self->file->append(self->block->finish(self->fileVersion, true).begin(), self->blockSize));
+					self->blockEnd += self->blockSize;
+					self->block->start();
+					if(!self->block->fits(toWrite))
+						throw backup_bad_block_size();
+				}
+				self->block->appendStringRefWithLen(k);
+				self->block->appendStringRefWithLen(v);
+				return Void();
+			}
+
 			if(self->file->size() + toWrite > self->blockEnd) {
 				// Write padding if needed
 				int bytesLeft = self->blockEnd - self->file->size();
@@ -644,12 +821,22 @@ namespace fileBackup {
 
 		Future<Void> writeKV(Key k, Value v) { return writeKV_impl(this, k, v); }
 
+		// Writes the last block of a compressed file
+		Future<Void> finish() {
+			if(block && blockEnd > 0) {
+				StringRef last = block->finish(fileVersion, false);
+				return file->append(last.begin(), last.size());
+			}
+			return Void();
+		}
+
 		Reference<IBackupFile> file;
 		int blockSize;
 
 	private:
 		int64_t blockEnd;
 		uint32_t fileVersion;
+		Reference<BackupBlockCompressor> block;
 	};
 
 	ACTOR Future<Standalone<VectorRef<KeyValueRef>>> decodeLogFileBlock(Reference<IAsyncFile> file, int64_t offset, int len) {
@@ -662,29 +849,38 @@ namespace fileBackup {
 		state StringRefReader reader(buf, restore_corrupted_data());
 
 		try {
-			// Read header, currently only decoding version 2001
-			if(reader.consume<int32_t>() != 2001)
+			// Read header, decoding version 2001 or its compressed form 2002
+			StringRefReader *data = &reader;
+			StringRefReader uncompressed;
+			int32_t version = reader.consume<int32_t>();
+			if(version == 2002) {
+				uncompressed = StringRefReader(uncompressBackupBlock(results.arena(), reader, len), restore_corrupted_data());
+				data = &uncompressed;
+			} else if(version != 2001) {
 				throw restore_unsupported_file_version();
+			}
 
 			// Read k/v pairs.  Block ends either at end of last value exactly or with 0xFF as first key len byte.
 			while(1) {
 				// If eof reached or first key len bytes is 0xFF then end of block was reached.
-				if(reader.eof() || *reader.rptr == 0xFF)
+				if(data->eof() || *data->rptr == 0xFF)
 					break;
 
 				// Read key and value.  If anything throws then there is a problem.
-				uint32_t kLen = reader.consumeNetworkUInt32();
-				const uint8_t *k = reader.consume(kLen);
-				uint32_t vLen = reader.consumeNetworkUInt32();
-				const uint8_t *v = reader.consume(vLen);
+				uint32_t kLen = data->consumeNetworkUInt32();
+				const uint8_t *k = data->consume(kLen);
+				uint32_t vLen = data->consumeNetworkUInt32();
+				const uint8_t *v = data->consume(vLen);
 
 				results.push_back(results.arena(), KeyValueRef(KeyRef(k, kLen), ValueRef(v, vLen)));
 			}
 
-			// Make sure any remaining bytes in the block are 0xFF
+			// Make sure any remaining bytes in the block are 0xFF, and that all of the uncompressed data was read
 			for(auto b : reader.remainder())
 				if(b != 0xFF)
 					throw restore_corrupted_data_padding();
+			if(!data->eof() && data != &reader)
+				throw restore_corrupted_data();
 
 			return results;
 
@@ -895,13 +1091,7 @@ namespace fileBackup {
 		Future<Void> execute(Database cx, Reference<TaskBucket> tb, Reference<FutureBucket> fb, Reference<Task> task) { return _execute(cx, tb, fb, task); };
 		Future<Void> finish(Reference<ReadYourWritesTransaction> tr, Reference<TaskBucket> tb, Reference<FutureBucket> fb, Reference<Task> task) { return _finish(tr, tb, fb, task); };
 
-		// Finish (which flushes/syncs) the file, and then in a single transaction, make some range backup progress durable.  
-		// This means:
-		//  - increment the backup config's range bytes written
-		//  - update the range file map
-		//  - update the task begin key
-		//  - save/extend the task with the new params
-		// Returns whether or not the caller should continue executing the task.
+		// Finish (which flushes/syncs) the file, and then record it with recordRangeFile().
 		ACTOR static Future<bool> finishRangeFile(Reference<IBackupFile> file, Database cx, Reference<Task> task, Reference<TaskBucket> taskBucket, KeyRange range, Version version) {
 			Void _ = wait(file->finish());
 
@@ -909,6 +1099,17 @@ namespace fileBackup {
 			if(range.empty())
 				return false;
 
+			bool usedFile = wait(recordRangeFile(cx, task, taskBucket, range, version, file->getFileName(), file->size()));
+			return usedFile;
+		}
+
+		// In a single transaction, make the range backup progress of a finished file durable.  This means:
+		//  - increment the backup config's range bytes written
+		//  - update the range file map
+		//  - update the task begin key
+		//  - save/extend the task with the new params
+		// Returns whether the file was added to the range file map.
+		ACTOR static Future<bool> recordRangeFile(Database cx, Reference<Task> task, Reference<TaskBucket> taskBucket, KeyRange range, Version version, std::string fileName, int64_t fileSize) {
 			state Reference<ReadYourWritesTransaction> tr(new ReadYourWritesTransaction(cx));
 			state BackupConfig backup(task);
 			state bool usedFile = false;
@@ -931,12 +1132,12 @@ namespace fileBackup {
 					state Version newTimeout = wait(taskBucket->extendTimeout(tr, task, true));
 
 					// Update the range bytes written in the backup config
-					backup.rangeBytesWritten().atomicOp(tr, file->size(), MutationRef::AddValue);
+					backup.rangeBytesWritten().atomicOp(tr, fileSize, MutationRef::AddValue);
 
 					// See if there is already a file for this key which has an earlier begin, update the map if not.
 					Optional<BackupConfig::RangeSlice> s = wait(backup.snapshotRangeFileMap().get(tr, range.end));
 					if(!s.present() || s.get().begin >= range.begin) {
-						backup.snapshotRangeFileMap().set(tr, range.end, {range.begin, version, file->getFileName(), file->size()});
+						backup.snapshotRangeFileMap().set(tr, range.end, {range.begin, version, fileName, fileSize});
 						usedFile = true;
 					}
 
@@ -951,6 +1152,80 @@ namespace fileBackup {
 			return usedFile;
 		}
 
+		// Has a storage server holding [beginKey, endKey), which must be within one shard, write it to bc as range files
+		// rather than reading it through this agent.  Each file is recorded as it is written, so if the export fails (for
+		// example because the shard moved or the server predates exporting) the caller can go on from the task's begin key.
+		// Returns whether the whole range was exported.
+		ACTOR static Future<bool> exportRangeFromStorageServer(Database cx, Reference<Task> task, Reference<TaskBucket> taskBucket, Reference<IBackupContainer> bc, Key beginKey, Key endKey) {
+			state Reference<ReadYourWritesTransaction> tr(new ReadYourWritesTransaction(cx));
+			state BackupConfig backup(task);
+
+			while(beginKey != endKey) {
+				state ExportBackupRangeRequest req;
+				state StorageServerInterface ssi;
+				loop {
+					try {
+						tr->setOption(FDBTransactionOptions::ACCESS_SYSTEM_KEYS);
+						tr->setOption(FDBTransactionOptions::LOCK_AWARE);
+						Version readVersion = wait(tr->getReadVersion());
+						req.version = readVersion;
+
+						state Key shardKey = beginKey.withPrefix(keyServersPrefix);
+						Standalone<RangeResultRef> shard = wait(tr->getRange(lastLessOrEqual(shardKey), firstGreaterThan(shardKey), 1));
+						vector<UID> src, dest;
+						if(shard.size())
+							decodeKeyServersValue(shard[0].value, src, dest);
+						if(src.empty())
+							return false;
+
+						Optional<Value> server = wait(tr->get(serverListKeyFor(g_random->randomChoice(src))));
+						if(!server.present())
+							return false;
+						ssi = decodeServerListValue(server.get());
+						break;
+					} catch(Error &e) {
+						Void _ = wait(tr->onError(e));
+					}
+				}
+				tr->reset();
+
+				if(!ssi.exportBackupRange.getEndpoint().isValid()) {
+					TEST(true); // Backup range not exported by an old storage server
+					return false;
+				}
+
+				req.keys = KeyRangeRef(req.arena, KeyRangeRef(beginKey, endKey));
+				req.containerURL = bc->getURL();
+				req.blockSize = BUGGIFY ? g_random->randomInt(250e3, 4e6) : CLIENT_KNOBS->BACKUP_RANGEFILE_BLOCK_SIZE;
+				state ErrorOr<ExportBackupRangeReply> rep = wait(errorOr(timeoutError(ssi.exportBackupRange.getReply(req), CLIENT_KNOBS->BACKUP_EXPORT_TIMEOUT)));
+				if(rep.isError()) {
+					TEST(true); // Backup range export failed
+					TraceEvent(SevWarn, "FileBackupRangeExportFailed")
+						.error(rep.getError())
+						.detail("BackupUID", backup.getUid())
+						.detail("Server", ssi.id())
+						.detail("BeginKey", beginKey.printable())
+						.detail("EndKey", endKey.printable())
+						.suppressFor(60, true);
+					return false;
+				}
+
+				state Key nextKey = rep.get().end;
+				bool usedFile = wait(recordRangeFile(cx, task, taskBucket, KeyRangeRef(beginKey, nextKey), req.version, rep.get().fileName, rep.get().fileSize));
+				TraceEvent("FileBackupExportedRangeFile")
+					.detail("BackupUID", backup.getUid())
+					.detail("Server", ssi.id())
+					.detail("Size", rep.get().fileSize)
+					.detail("ReadVersion", req.version)
+					.detail("BeginKey", beginKey.printable())
+					.detail("EndKey", nextKey.printable())
+					.detail("AddedFileToMap", usedFile)
+					.suppressFor(60, true);
+				beginKey = nextKey;
+			}
+			return true;
+		}
+
 		ACTOR static Future<Key> addTask(Reference<ReadYourWritesTransaction> tr, Reference<TaskBucket> taskBucket, Reference<Task> parentTask, int priority, Key begin, Key end, TaskCompletionKey completionKey, Reference<TaskFuture> waitFor = Reference<TaskFuture>(), Version scheduledVersion = invalidVersion) {
 			Key key = wait(addBackupTask(BackupRangeTaskFunc::name,
 										 BackupRangeTaskFunc::version,
@@ -995,6 +1270,20 @@ namespace fileBackup {
 				return Void();
 			}
 
+			if (CLIENT_KNOBS->BACKUP_EXPORT_FROM_STORAGE_SERVERS) {
+				Reference<IBackupContainer> exportContainer = wait(BackupConfig(task).backupContainer().getD(cx));
+				if(!exportContainer)
+					return Void();
+				bool exported = wait(exportRangeFromStorageServer(cx, task, taskBucket, exportContainer, beginKey, endKey));
+				if(exported)
+					return Void();
+
+				// Read whatever was not exported
+				beginKey = Params.beginKey().get(task);
+				if(beginKey == endKey)
+					return Void();
+			}
+
 			// Read everything from beginKey to endKey, write it to an output file, run the output file processor, and
 			// then set on_done. If we are still writing after X seconds, end the output file and insert a new backup_range
 			// task for the remainder.
@@ -1038,6 +1327,7 @@ namespace fileBackup {
 						TEST(outVersion != invalidVersion); // Backup range task wrote multiple versions
 						state Key nextKey = done ? endKey : keyAfter(lastKey);
 						Void _ = wait(rangeFile.writeKey(nextKey));
+						Void _ = wait(rangeFile.finish());
 
 						bool usedFile = wait(finishRangeFile(outFile, cx, task, taskBucket, KeyRangeRef(beginKey, nextKey), outVersion));
 						TraceEvent("FileBackupWroteRangeFile")
@@ -1065,7 +1355,7 @@ namespace fileBackup {
 					outFile = f;
 
 					// Initialize range file writer and write begin key
-					rangeFile = RangeFileWriter(outFile, blockSize);
+					rangeFile = RangeFileWriter(outFile, blockSize, CLIENT_KNOBS->BACKUP_COMPRESS_FILES);
 					Void _ = wait(rangeFile.writeKey(beginKey));
 				}
 
@@ -1695,7 +1985,7 @@ namespace fileBackup {
 			// Block size must be at least large enough for 1 max size key, 1 max size value, and overhead, so conservatively 125k.
 			state int blockSize = BUGGIFY ? g_random->randomInt(125e3, 4e6) : CLIENT_KNOBS->BACKUP_LOGFILE_BLOCK_SIZE;
 			state Reference<IBackupFile> outFile = wait(bc->writeLogFile(beginVersion, endVersion, blockSize));
-			state LogFileWriter logFile(outFile, blockSize);
+			state LogFileWriter logFile(outFile, blockSize, CLIENT_KNOBS->BACKUP_COMPRESS_FILES);
 			state size_t idx;
 
 			state PromiseStream<RangeResultWithVersion> results;
@@ -1740,6 +2030,7 @@ namespace fileBackup {
 			// Make sure this task is still alive, if it's not then the data read above could be incomplete.
 			Void _ = wait(taskBucket->keepRunning(cx, task));
 
+			Void _ = wait(logFile.finish());
 			Void _ = wait(outFile->finish());
 
 			TraceEvent("FileBackupWroteLogFile")
@@ -2093,6 +2384,7 @@ namespace fileBackup {
 			}
 
 			std::vector<std::string> files;
+			std::vector<int64_t> fileSizes;
 			state Version maxVer = 0;
 			state Version minVer = std::numeric_limits<Version>::max();
 			state int64_t totalBytes = 0;
@@ -2107,6 +2399,7 @@ namespace fileBackup {
 
 					// Add file to final file list
 					files.push_back(r.fileName);
+					fileSizes.push_back(r.fileSize);
 
 					// Update version range seen
 					if(r.version < minVer)
@@ -2129,7 +2422,7 @@ namespace fileBackup {
 			}
 
 			Params.endVersion().set(task, maxVer);
-			Void _ = wait(bc->writeKeyspaceSnapshotFile(files, totalBytes));
+			Void _ = wait(bc->writeKeyspaceSnapshotFile(files, totalBytes, fileSizes));
 
 			TraceEvent(SevInfo, "FileBackupWroteSnapshotManifest")
 				.detail("BackupUID", config.getUid())
@@ -2444,11 +2737,61 @@ namespace fileBackup {
 			}
 			fileRange = KeyRangeRef(std::max(fileRange.begin, restoreRange.get().begin).removePrefix(removePrefix.get()).withPrefix(addPrefix.get()),fileEnd);
 
-			state int start = 0;
-			state int end = data.size();
+			// Split the block into runs which each lie within one shard of the restored keys, so that each commit goes to
+			// one storage team, and commit the runs in parallel.  The runs are disjoint and their transactions have no
+			// conflict ranges of their own, so they cannot conflict with each other.
+			tr->reset();
+			state Standalone<VectorRef<KeyRef>> shardBoundaries;
+			loop {
+				try {
+					Standalone<VectorRef<KeyRef>> keys = wait(getBlockOfShards(tr, fileRange.begin, fileRange.end, CLIENT_KNOBS->BACKUP_SHARD_TASK_LIMIT));
+					shardBoundaries = keys;
+					break;
+				} catch(Error &e) {
+					Void _ = wait(tr->onError(e));
+				}
+			}
+
+			state Reference<FlowLock> runLock(new FlowLock(CLIENT_KNOBS->RESTORE_WRITE_TX_PARALLELISM));
+			state std::vector<Future<Void>> runs;
+			state int runStart = 0;
+			state int runEnd;
+			state Key runBegin = fileRange.begin;
+			state int boundary = 0;
+			while(runStart < data.size()) {
+				runEnd = runStart + 1;
+				while(boundary < shardBoundaries.size() && shardBoundaries[boundary] <= data[runStart].key.removePrefix(removePrefix.get()).withPrefix(addPrefix.get()))
+					++boundary;
+				while(runEnd < data.size() && (boundary == shardBoundaries.size() || data[runEnd].key.removePrefix(removePrefix.get()).withPrefix(addPrefix.get()) < shardBoundaries[boundary]))
+					++runEnd;
+
+				state Key runEndKey = runEnd == data.size() ? fileRange.end : data[runEnd].key.removePrefix(removePrefix.get()).withPrefix(addPrefix.get());
+				Void _ = wait(runLock->take());
+				runs.push_back(restoreRun(cx, taskBucket, task, restore, rangeFile, readOffset, readLen, originalFileRange, data, runStart, runEnd, KeyRangeRef(runBegin, runEndKey), addPrefix.get(), removePrefix.get(), runLock));
+				runStart = runEnd;
+				runBegin = runEndKey;
+			}
+			TEST(runs.size() > 1); // Restore range block split into runs
+
+			// An empty block still clears its range
+			if(data.empty()) {
+				Void _ = wait(runLock->take());
+				runs.push_back(restoreRun(cx, taskBucket, task, restore, rangeFile, readOffset, readLen, originalFileRange, data, 0, 0, fileRange, addPrefix.get(), removePrefix.get(), runLock));
+			}
+
+			Void _ = wait(waitForAll(runs));
+			return Void();
+		}
+
+		// Commits data[start, end), clearing runRange, which it covers, in transactions of about RESTORE_WRITE_TX_SIZE.  The
+		// caller keeps data alive and has taken a permit from lock, which the run releases when it is done.
+		ACTOR static Future<Void> restoreRun(Database cx, Reference<TaskBucket> taskBucket, Reference<Task> task, RestoreConfig restore, RestoreFile rangeFile, int64_t readOffset, int64_t readLen, KeyRange originalFileRange,
+											VectorRef<KeyValueRef> data, int start, int end, KeyRange runRange, Key addPrefix, Key removePrefix, Reference<FlowLock> lock) {
+			state FlowLock::Releaser releaser(*lock);
+			state Reference<ReadYourWritesTransaction> tr( new ReadYourWritesTransaction(cx) );
+			state int runStart = start;
 			state int dataSizeLimit = BUGGIFY ? g_random->randomInt(256 * 1024, 10e6) : CLIENT_KNOBS->RESTORE_WRITE_TX_SIZE;
 
-			tr->reset();
 			loop {
 				try {
 					tr->setOption(FDBTransactionOptions::ACCESS_SYSTEM_KEYS);
@@ -2465,16 +2808,18 @@ namespace fileBackup {
 					}
 
 					// Clear the range we are about to set.
-					// If start == 0 then use fileBegin for the start of the range, else data[start]
-					// If iend == end then use fileEnd for the end of the range, else data[iend]
-					state KeyRange trRange = KeyRangeRef((start == 0 ) ? fileRange.begin : data[start].key.removePrefix(removePrefix.get()).withPrefix(addPrefix.get())
-													   , (iend == end) ? fileRange.end   : data[iend ].key.removePrefix(removePrefix.get()).withPrefix(addPrefix.get()));
+					// If start == runStart then use the run's begin for the start of the range, else data[start]
+					// If iend == end then use the run's end for the end of the range, else data[iend]
+					state KeyRange trRange = KeyRangeRef((start == runStart) ? runRange.begin : data[start].key.removePrefix(removePrefix).withPrefix(addPrefix)
+													   , (iend == end) ? runRange.end   : data[iend ].key.removePrefix(removePrefix).withPrefix(addPrefix));
 
+					// The restored range is locked and nothing reads it, so neither the clear nor the sets need conflict ranges
+					tr->setOption(FDBTransactionOptions::NEXT_WRITE_NO_WRITE_CONFLICT_RANGE);
 					tr->clear(trRange);
 
 					for(; i < iend; ++i) {
 						tr->setOption(FDBTransactionOptions::NEXT_WRITE_NO_WRITE_CONFLICT_RANGE);
-						tr->set(data[i].key.removePrefix(removePrefix.get()).withPrefix(addPrefix.get()), data[i].value);
+						tr->set(data[i].key.removePrefix(removePrefix).withPrefix(addPrefix), data[i].value);
 					}
 
 					// Add to bytes written count
@@ -2503,7 +2848,6 @@ namespace fileBackup {
 						.detail("DataSize", data.size())
 						.detail("Bytes", txBytes)
 						.detail("OriginalFileRange", printable(originalFileRange))
-						.detail("TaskInstance", (uint64_t)this)
 						.suppressFor(60, true);
 
 					// Commit succeeded, so advance starting point
@@ -3279,6 +3623,21 @@ namespace fileBackup {
 	REGISTER_TASKFUNC(StartFullRestoreTaskFunc);
 }
 
+ACTOR Future<Reference<IBackupFile>> writeBackupRangeFile(Reference<IBackupContainer> bc, Version version, int blockSize, KeyRange keys, Standalone<VectorRef<KeyValueRef>> data) {
+	state Reference<IBackupFile> file = wait(bc->writeRangeFile(version, blockSize));
+	state fileBackup::RangeFileWriter rangeFile(file, blockSize, CLIENT_KNOBS->BACKUP_COMPRESS_FILES);
+	state int i = 0;
+
+	Void _ = wait(rangeFile.writeKey(keys.begin));
+	for(; i < data.size(); ++i) {
+		Void _ = wait(rangeFile.writeKV(data[i].key, data[i].value));
+	}
+	Void _ = wait(rangeFile.writeKey(keys.end));
+	Void _ = wait(rangeFile.finish());
+	Void _ = wait(file->finish());
+	return file;
+}
+
 struct LogInfo : public ReferenceCounted<LogInfo> {
 	std::string fileName;
 	Reference<IAsyncFile> logFile;
@@ -3998,3 +4357,36 @@ Future<int> FileBackupAgent::waitBackup(Database cx, std::string tagName, bool s
 	return FileBackupAgentImpl::waitBackup(this, cx, tagName, stopWhenDone);
 }
 
+
+TEST_CASE("fdbclient/FileBackupAgent/compressedBlock") {
+	int blockSize = g_random->randomInt(1000, 100000);
+	Reference<fileBackup::BackupBlockCompressor> block(new fileBackup::BackupBlockCompressor(blockSize, g_random->randomInt(1, 10)));
+
+	for(int b = 0; b < 3; b++) {
+		block->start();
+		std::string expected;
+		loop {
+			std::string s(g_random->randomInt(0, 200), 0);
+			bool compressible = g_random->random01() < 0.8;
+			for(auto& c : s)
+				c = compressible ? 'a' + g_random->randomInt(0, 4) : g_random->randomInt(0, 256);
+			if(!block->fits(s.size()))
+				break;
+			block->append((const uint8_t*)s.data(), s.size());
+			expected += s;
+		}
+
+		bool pad = g_random->coinflip();
+		StringRef encoded = block->finish(1002, pad);
+		ASSERT(encoded.size() <= blockSize && (!pad || encoded.size() == blockSize));
+
+		fileBackup::StringRefReader reader(encoded, restore_corrupted_data());
+		ASSERT(reader.consume<int32_t>() == 1002);
+		Arena arena;
+		ASSERT(fileBackup::uncompressBackupBlock(arena, reader, blockSize) == StringRef(expected));
+		for(auto c : reader.remainder())
+			ASSERT(c == 0xFF);
+	}
+
+	return Void();
+}
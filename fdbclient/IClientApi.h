@@ -47,10 +47,14 @@ public:
 	virtual ThreadFuture<Standalone<VectorRef<const char*>>> getAddressesForKey(const KeyRef& key) = 0;
 	virtual ThreadFuture<Standalone<StringRef>> getVersionstamp() = 0;
 
+	// Reads all of the given keys with one future.  The result holds the keys that are present, in the order requested.
+	virtual ThreadFuture<Standalone<RangeResultRef>> getMulti(const VectorRef<KeyRef>& keys, bool snapshot=false) = 0;
+
 	virtual void addReadConflictRange(const KeyRangeRef& keys) = 0;
 
 	virtual void atomicOp(const KeyRef& key, const ValueRef& value, uint32_t operationType) = 0;
 	virtual void set(const KeyRef& key, const ValueRef& value) = 0;
+	virtual void setMulti(const VectorRef<KeyValueRef>& kvs) = 0;
 	virtual void clear(const KeyRef& begin, const KeyRef& end) = 0;
 	virtual void clear(const KeyRangeRef& range) = 0;
 	virtual void clear(const KeyRef& key) = 0;
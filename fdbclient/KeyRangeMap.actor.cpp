@@ -23,6 +23,7 @@
 #include "CommitTransaction.h"
 #include "FDBTypes.h"
 #include "ReadYourWrites.h"
+#include "flow/UnitTest.h"
 
 void KeyRangeActorMap::getRangesAffectedByInsertion( const KeyRangeRef& keys, vector< KeyRange >& affectedRanges ) {
 	auto s = map.rangeContaining( keys.begin );
@@ -215,3 +216,24 @@ ACTOR Future<Void> krmSetRangeCoalescing( Transaction *tr, Key mapPrefix, KeyRan
 
 	return Void();
 }
+
+TEST_CASE("fdbclient/KeyRangeMap/assign") {
+	KeyRangeMap<int> map(-1);
+	map.insert( KeyRangeRef(LiteralStringRef("x"), LiteralStringRef("y")), 5 );
+
+	std::vector<MapPair<Key,int>> begins;
+	for(int i = 0; i < 100; i++)
+		begins.push_back( MapPair<Key,int>( i ? Key(format("%03d", i)) : Key(), i ) );
+	map.assign( std::move(begins) );
+
+	ASSERT( map.size() == 100 );
+	ASSERT( map[LiteralStringRef("")] == 0 && map[LiteralStringRef("0015")] == 1 && map[LiteralStringRef("099")] == 99 );
+	ASSERT( map[LiteralStringRef("x")] == 99 );  // The old ranges are gone
+	ASSERT( map.rangeContaining(LiteralStringRef("05")).range() == KeyRangeRef(LiteralStringRef("049"), LiteralStringRef("050")) );
+	ASSERT( map.lastItem().end() == allKeys.end );
+
+	map.insert( KeyRangeRef(LiteralStringRef("010"), LiteralStringRef("020")), -2 );
+	ASSERT( map.size() == 91 && map[LiteralStringRef("015")] == -2 && map[LiteralStringRef("020")] == 20 );
+
+	return Void();
+}
@@ -43,6 +43,7 @@ ClientKnobs::ClientKnobs(bool randomize) {
 	// wrong_shard_server sometimes comes from the only nonfailed server, so we need to avoid a fast spin
 
 	init( WRONG_SHARD_SERVER_DELAY,                .01 ); if( randomize && BUGGIFY ) WRONG_SHARD_SERVER_DELAY = g_random->random01(); // FLOW_KNOBS->PREVENT_FAST_SPIN_DELAY; // SOMEDAY: This delay can limit performance of retrieving data when the cache is mostly wrong (e.g. dumping the database after a test)
+	init( WRONG_SHARD_SERVER_RELOCATE,               1 ); if( randomize && BUGGIFY ) WRONG_SHARD_SERVER_RELOCATE = 0;
 	init( FUTURE_VERSION_RETRY_DELAY,              .01 ); if( randomize && BUGGIFY ) FUTURE_VERSION_RETRY_DELAY = g_random->random01();// FLOW_KNOBS->PREVENT_FAST_SPIN_DELAY;
 	init( REPLY_BYTE_LIMIT,                      80000 );
 	init( DEFAULT_BACKOFF,                         .01 ); if( randomize && BUGGIFY ) DEFAULT_BACKOFF = g_random->random01();
@@ -57,15 +58,28 @@ ClientKnobs::ClientKnobs(bool randomize) {
 
 	init( MAX_BATCH_SIZE,                           20 ); if( randomize && BUGGIFY ) MAX_BATCH_SIZE = 1; // Note that SERVER_KNOBS->START_TRANSACTION_MAX_BUDGET_SIZE is set to match this value
 	init( GRV_BATCH_TIMEOUT,                     0.005 ); if( randomize && BUGGIFY ) GRV_BATCH_TIMEOUT = 0.1;
+	init( MAX_TRANSACTION_TAG_LENGTH,               16 );
+	init( COMMIT_PACKING,                            1 ); if( randomize && BUGGIFY ) COMMIT_PACKING = 0;
+	init( COMMIT_COMPRESSION_MIN_BYTES,            1e4 ); if( randomize && BUGGIFY ) COMMIT_COMPRESSION_MIN_BYTES = g_random->coinflip() ? 1 : 1e9;
+	init( COMMIT_COMPRESSION_LEVEL,                  1 );
 
 	init( LOCATION_CACHE_EVICTION_SIZE,         100000 );
 	init( LOCATION_CACHE_EVICTION_SIZE_SIM,         10 ); if( randomize && BUGGIFY ) LOCATION_CACHE_EVICTION_SIZE_SIM = 3;
+	init( LOCATION_CACHE_EVICTION_SAMPLES,           5 ); if( randomize && BUGGIFY ) LOCATION_CACHE_EVICTION_SAMPLES = 1;
+	init( READ_CACHE_MAX_ENTRIES,               10000 ); if( randomize && BUGGIFY ) READ_CACHE_MAX_ENTRIES = 2;
+	init( CLIENT_INFO_CACHE_FILE,                  "" );
 
 	init( GET_RANGE_SHARD_LIMIT,                     2 );
 	init( WARM_RANGE_SHARD_LIMIT,                  100 );
+	init( GET_VALUES_BATCH_LIMIT,                  500 ); if( randomize && BUGGIFY ) GET_VALUES_BATCH_LIMIT = 2;
+	init( RANGE_STREAM_WINDOW,                       3 ); if( randomize && BUGGIFY ) RANGE_STREAM_WINDOW = 1;
+	init( RANGE_PREFETCH_SHARD_LIMIT,                4 ); if( randomize && BUGGIFY ) RANGE_PREFETCH_SHARD_LIMIT = g_random->randomInt(1, 4);
+	init( RANGE_PREFETCH_BYTES,                    1e6 ); if( randomize && BUGGIFY ) RANGE_PREFETCH_BYTES = 2e5;
 	init( STORAGE_METRICS_SHARD_LIMIT,             100 ); if( randomize && BUGGIFY ) STORAGE_METRICS_SHARD_LIMIT = 3;
 	init( STORAGE_METRICS_UNFAIR_SPLIT_LIMIT,  2.0/3.0 );
 	init( STORAGE_METRICS_TOO_MANY_SHARDS_DELAY,  15.0 );
+	init( STORAGE_METRICS_BATCHING,                  1 ); if( randomize && BUGGIFY ) STORAGE_METRICS_BATCHING = 0;
+	init( STORAGE_METRICS_BATCH_DELAY,            0.01 ); if( randomize && BUGGIFY ) STORAGE_METRICS_BATCH_DELAY = g_random->coinflip() ? 0.0 : 0.5;
 
 	//KeyRangeMap
 	init( KRM_GET_RANGE_LIMIT,                     1e5 ); if( randomize && BUGGIFY ) KRM_GET_RANGE_LIMIT = 10;
@@ -92,6 +106,8 @@ ClientKnobs::ClientKnobs(bool randomize) {
 	init( TASKBUCKET_CHECK_ACTIVE_AMOUNT,           10 );
 	init( TASKBUCKET_TIMEOUT_VERSIONS,     60*CORE_VERSIONSPERSECOND ); if( randomize && BUGGIFY ) TASKBUCKET_TIMEOUT_VERSIONS = 30*CORE_VERSIONSPERSECOND;
 	init( TASKBUCKET_MAX_TASK_KEYS,               1000 ); if( randomize && BUGGIFY ) TASKBUCKET_MAX_TASK_KEYS = 20;
+	init( TASKBUCKET_PARTITIONS,                    16 ); if( randomize && BUGGIFY ) TASKBUCKET_PARTITIONS = g_random->coinflip() ? 1 : 65536;
+	init( TASKBUCKET_IDLE_POLL_MULTIPLIER,        10.0 ); if( randomize && BUGGIFY ) TASKBUCKET_IDLE_POLL_MULTIPLIER = 1.0;
 
 	//Backup
 	init( BACKUP_CONCURRENT_DELETES,               100 );
@@ -106,6 +122,7 @@ ClientKnobs::ClientKnobs(bool randomize) {
 	init( BACKUP_AGGREGATE_POLL_RATE_UPDATE_INTERVAL, 60);
 	init( BACKUP_AGGREGATE_POLL_RATE,              2.0 ); // polls per second target for all agents on the cluster
 	init( BACKUP_LOG_WRITE_BATCH_MAX_SIZE,         1e6 ); //Must be much smaller than TRANSACTION_SIZE_LIMIT
+	init( BACKUP_LOG_WRITE_PARALLELISM,              3 ); if( randomize && BUGGIFY ) BACKUP_LOG_WRITE_PARALLELISM = 1;
 	init( BACKUP_LOG_ATOMIC_OPS_SIZE,			  1000 );
 	init( BACKUP_OPERATION_COST_OVERHEAD,		    50 );
 	init( BACKUP_MAX_LOG_RANGES,                    21 ); if( randomize && BUGGIFY ) BACKUP_MAX_LOG_RANGES = 4;
@@ -119,11 +136,16 @@ ClientKnobs::ClientKnobs(bool randomize) {
 	init( BACKUP_TASKS_PER_AGENT,                   20 );
 	init( SIM_BACKUP_TASKS_PER_AGENT,               10 );
 	init( BACKUP_RANGEFILE_BLOCK_SIZE,      1024 * 1024);
+	init( BACKUP_EXPORT_FROM_STORAGE_SERVERS,        0 ); if( randomize && BUGGIFY ) BACKUP_EXPORT_FROM_STORAGE_SERVERS = 1;
+	init( BACKUP_EXPORT_TIMEOUT,                  60.0 ); if( randomize && BUGGIFY ) BACKUP_EXPORT_TIMEOUT = 1.0;
 	init( BACKUP_LOGFILE_BLOCK_SIZE,        1024 * 1024);
+	init( BACKUP_COMPRESS_FILES,                     0 ); if( randomize && BUGGIFY ) BACKUP_COMPRESS_FILES = 1;
+	init( BACKUP_COMPRESSION_LEVEL,                  1 ); if( randomize && BUGGIFY ) BACKUP_COMPRESSION_LEVEL = g_random->randomInt(1, 10);
 	init( BACKUP_DISPATCH_ADDTASK_SIZE,             50 );
 	init( RESTORE_DISPATCH_ADDTASK_SIZE,           150 );
 	init( RESTORE_DISPATCH_BATCH_SIZE,           30000 ); if( randomize && BUGGIFY ) RESTORE_DISPATCH_BATCH_SIZE = 1;
 	init( RESTORE_WRITE_TX_SIZE,            256 * 1024 );
+	init( RESTORE_WRITE_TX_PARALLELISM,              4 ); if( randomize && BUGGIFY ) RESTORE_WRITE_TX_PARALLELISM = 1;
 	init( APPLY_MAX_LOCK_BYTES,                    1e9 );
 	init( APPLY_MIN_LOCK_BYTES,                   11e6 ); //Must be bigger than TRANSACTION_SIZE_LIMIT
 	init( APPLY_BLOCK_SIZE,     LOG_RANGE_BLOCK_SIZE/5 );
@@ -141,6 +163,9 @@ ClientKnobs::ClientKnobs(bool randomize) {
 
 	init( IS_ACCEPTABLE_DELAY,                     1.5 );
 
+	//ReadYourWrites
+	init( RYW_POINT_READ_BYPASS,                     1 ); if( randomize && BUGGIFY ) RYW_POINT_READ_BYPASS = 0;
+
 	init( HTTP_READ_SIZE,                     128*1024 );
 	init( HTTP_SEND_SIZE,                      32*1024 );
 	init( HTTP_VERBOSE_LEVEL,                        0 );
@@ -156,6 +181,8 @@ ClientKnobs::ClientKnobs(bool randomize) {
 
 	init( BLOBSTORE_CONCURRENT_WRITES_PER_FILE,      5 );
 	init( BLOBSTORE_CONCURRENT_READS_PER_FILE,       3 );
+	init( BLOBSTORE_INITIAL_CONCURRENCY_PER_FILE,    2 ); if( randomize && BUGGIFY ) BLOBSTORE_INITIAL_CONCURRENCY_PER_FILE = g_random->randomInt(1, 6);
+	init( BLOBSTORE_CONCURRENCY_MIN_GAIN,          0.1 );
 	init( BLOBSTORE_READ_BLOCK_SIZE,       1024 * 1024 );
 	init( BLOBSTORE_READ_AHEAD_BLOCKS,               0 );
 	init( BLOBSTORE_READ_CACHE_BLOCKS_PER_FILE,      2 );
@@ -176,6 +203,11 @@ ClientKnobs::ClientKnobs(bool randomize) {
 	}
 	init(CSI_STATUS_DELAY,						  10.0  );
 
+	// TDMetrics
+	init( METRICS_FLUSH_INTERVAL,                   1.0 );
+	init( METRICS_FLUSH_MAX_INTERVAL,              60.0 ); if( randomize && BUGGIFY ) METRICS_FLUSH_MAX_INTERVAL = 2.0;
+	init( METRICS_FLUSH_BUSY_FRACTION,              0.1 );
+
 	init( CONSISTENCY_CHECK_RATE_LIMIT,            50e6 );
 	init( CONSISTENCY_CHECK_RATE_WINDOW,            1.0 );
 }
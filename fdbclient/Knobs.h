@@ -41,6 +41,7 @@ public:
 
 	// wrong_shard_server sometimes comes from the only nonfailed server, so we need to avoid a fast spin
 	double WRONG_SHARD_SERVER_DELAY; // SOMEDAY: This delay can limit performance of retrieving data when the cache is mostly wrong (e.g. dumping the database after a test)
+	int WRONG_SHARD_SERVER_RELOCATE; // If nonzero, look the shard up again right away and only delay if its servers are unchanged
 	double FUTURE_VERSION_RETRY_DELAY;
 	int REPLY_BYTE_LIMIT;
 	double DEFAULT_BACKOFF;
@@ -55,16 +56,29 @@ public:
 
 	int MAX_BATCH_SIZE;
 	double GRV_BATCH_TIMEOUT;
+	int MAX_TRANSACTION_TAG_LENGTH;
+	int COMMIT_PACKING; // If nonzero, commit requests are sent with each key written once (see CommitTransactionRef::pack)
+	int COMMIT_COMPRESSION_MIN_BYTES; // Packed commit requests at least this large are also compressed
+	int COMMIT_COMPRESSION_LEVEL;
 
 	// When locationCache in DatabaseContext gets to be this size, items will be evicted
 	int LOCATION_CACHE_EVICTION_SIZE;
 	int LOCATION_CACHE_EVICTION_SIZE_SIM;
+	int LOCATION_CACHE_EVICTION_SAMPLES; // Cached ranges compared by last use to choose each one evicted
+	int READ_CACHE_MAX_ENTRIES; // Values kept for each prefix set with the read_cache_prefix database option
+	std::string CLIENT_INFO_CACHE_FILE; // If set, the proxies last learned of are kept in this file, and used by the next client of the same cluster until the cluster controller answers
 
 	int GET_RANGE_SHARD_LIMIT;
 	int WARM_RANGE_SHARD_LIMIT;
+	int GET_VALUES_BATCH_LIMIT;
+	int RANGE_STREAM_WINDOW;
+	int RANGE_PREFETCH_SHARD_LIMIT; // Shards read concurrently by a large unlimited-row range read
+	int RANGE_PREFETCH_BYTES; // Byte budget for a WANT_ALL range read and its concurrent shard requests
 	int STORAGE_METRICS_SHARD_LIMIT;
 	double STORAGE_METRICS_UNFAIR_SPLIT_LIMIT;
 	double STORAGE_METRICS_TOO_MANY_SHARDS_DELAY;
+	int STORAGE_METRICS_BATCHING; // If nonzero, a client's waits for the metrics of single-shard ranges share one subscription per storage server
+	double STORAGE_METRICS_BATCH_DELAY; // Time to gather changes to a subscription before sending them
 
 	//KeyRangeMap
 	int KRM_GET_RANGE_LIMIT;
@@ -79,6 +93,9 @@ public:
 
 	double IS_ACCEPTABLE_DELAY;
 
+	//ReadYourWrites
+	int RYW_POINT_READ_BYPASS; // Point reads before any write or other read skip the snapshot cache
+
 
 	// Core
 	int64_t CORE_VERSIONSPERSECOND;  // This is defined within the server but used for knobs based on server value
@@ -94,6 +111,8 @@ public:
 	int TASKBUCKET_CHECK_ACTIVE_AMOUNT;
 	int TASKBUCKET_TIMEOUT_VERSIONS;
 	int TASKBUCKET_MAX_TASK_KEYS;
+	int TASKBUCKET_PARTITIONS;
+	double TASKBUCKET_IDLE_POLL_MULTIPLIER;
 
 	// Backup
 	int BACKUP_CONCURRENT_DELETES;
@@ -108,6 +127,7 @@ public:
 	double BACKUP_AGGREGATE_POLL_RATE;
 	double BACKUP_AGGREGATE_POLL_RATE_UPDATE_INTERVAL;
 	int BACKUP_LOG_WRITE_BATCH_MAX_SIZE;
+	int BACKUP_LOG_WRITE_PARALLELISM; // DR log batches of one log range being committed at once
 	int BACKUP_LOG_ATOMIC_OPS_SIZE;
 	int BACKUP_MAX_LOG_RANGES;
 	int BACKUP_SIM_COPY_LOG_RANGES;
@@ -121,11 +141,16 @@ public:
 	int CLEAR_LOG_RANGE_COUNT;
 	int SIM_BACKUP_TASKS_PER_AGENT;
 	int BACKUP_RANGEFILE_BLOCK_SIZE;
+	int BACKUP_EXPORT_FROM_STORAGE_SERVERS; // If nonzero, storage servers write snapshot range files themselves, which requires them to be able to reach the backup container
+	double BACKUP_EXPORT_TIMEOUT;
 	int BACKUP_LOGFILE_BLOCK_SIZE;
+	int BACKUP_COMPRESS_FILES; // If nonzero, new range and log files are written in the compressed format, which older versions cannot restore
+	int BACKUP_COMPRESSION_LEVEL;
 	int BACKUP_DISPATCH_ADDTASK_SIZE;
 	int RESTORE_DISPATCH_ADDTASK_SIZE;
 	int RESTORE_DISPATCH_BATCH_SIZE;
 	int RESTORE_WRITE_TX_SIZE;
+	int RESTORE_WRITE_TX_PARALLELISM; // Transactions of one range file block committed at once
 	int APPLY_MAX_LOCK_BYTES;
 	int APPLY_MIN_LOCK_BYTES;
 	int APPLY_BLOCK_SIZE;
@@ -145,6 +170,11 @@ public:
 	int64_t CSI_SIZE_LIMIT;
 	double CSI_STATUS_DELAY;
 
+	// TDMetrics
+	double METRICS_FLUSH_INTERVAL;
+	double METRICS_FLUSH_MAX_INTERVAL;
+	double METRICS_FLUSH_BUSY_FRACTION; // The flush interval is stretched so that flushing takes at most this fraction of it
+
 	int HTTP_SEND_SIZE;
 	int HTTP_READ_SIZE;
 	int HTTP_VERBOSE_LEVEL;
@@ -161,6 +191,8 @@ public:
 	int BLOBSTORE_CONCURRENT_LISTS;
 	int BLOBSTORE_CONCURRENT_WRITES_PER_FILE;
 	int BLOBSTORE_CONCURRENT_READS_PER_FILE;
+	int BLOBSTORE_INITIAL_CONCURRENCY_PER_FILE;
+	double BLOBSTORE_CONCURRENCY_MIN_GAIN;
 	int BLOBSTORE_READ_BLOCK_SIZE;
 	int BLOBSTORE_READ_AHEAD_BLOCKS;
 	int BLOBSTORE_READ_CACHE_BLOCKS_PER_FILE;
@@ -65,7 +65,7 @@ std::map<std::string, std::string> configForToken( std::string const& mode ) {
 		std::string key = mode.substr(0, pos);
 		std::string value = mode.substr(pos+1);
 
-		if( (key == "logs" || key == "proxies" || key == "resolvers" || key == "remote_logs" || key == "satellite_logs" || key == "log_routers") && isInteger(value) ) {
+		if( (key == "logs" || key == "proxies" || key == "grv_proxies" || key == "resolvers" || key == "remote_logs" || key == "satellite_logs" || key == "log_routers") && isInteger(value) ) {
 			out[p+key] = value;
 		}
 
@@ -81,18 +81,24 @@ std::map<std::string, std::string> configForToken( std::string const& mode ) {
 		return out;
 	}
 
+	Optional<KeyValueStoreType> logType;
 	Optional<KeyValueStoreType> storeType;
 	if (mode == "ssd-1") {
-		storeType= KeyValueStoreType::SSD_BTREE_V1;
+		logType = storeType= KeyValueStoreType::SSD_BTREE_V1;
 	} else if (mode == "ssd" || mode == "ssd-2") {
-		storeType = KeyValueStoreType::SSD_BTREE_V2;
+		logType = storeType = KeyValueStoreType::SSD_BTREE_V2;
 	} else if (mode == "memory") {
-		storeType= KeyValueStoreType::MEMORY;
+		logType = storeType= KeyValueStoreType::MEMORY;
+	} else if (mode == "ssd-lsm") {
+		// Transaction logs are a queue, so only storage servers use the LSM engine
+		logType = KeyValueStoreType::SSD_BTREE_V2;
+		storeType = KeyValueStoreType::SSD_LSM;
 	}
 	// Add any new store types to fdbserver/workloads/ConfigureDatabase, too
 
 	if (storeType.present()) {
-		out[p+"log_engine"] = out[p+"storage_engine"] = format("%d", storeType.get());
+		out[p+"log_engine"] = format("%d", logType.get());
+		out[p+"storage_engine"] = format("%d", storeType.get());
 		return out;
 	}
 
@@ -1167,6 +1173,72 @@ ACTOR Future<Void> waitForExcludedServers( Database cx, vector<AddressExclusion>
 	}
 }
 
+typedef std::map<std::pair<Key, Key>, std::pair<double, double>> HotRangeMap;
+
+static void mergeHotRanges( HotRangeMap& merged, VectorRef<HotRangeRef> const& ranges, bool sum ) {
+	for(auto& r : ranges) {
+		auto& m = merged[ std::make_pair( Key(r.range.begin), Key(r.range.end) ) ];
+		if( sum ) {
+			m.first += r.bytesPerSecond;
+			m.second += r.errorBytesPerSecond;
+		} else if( r.bytesPerSecond > m.first ) {
+			m = std::make_pair( r.bytesPerSecond, r.errorBytesPerSecond );
+		}
+	}
+}
+
+static void hottestRanges( Arena& arena, VectorRef<HotRangeRef>& out, HotRangeMap const& merged, int limit ) {
+	std::vector<HotRangeMap::const_iterator> ranges;
+	for(auto r = merged.begin(); r != merged.end(); ++r)
+		ranges.push_back( r );
+	std::sort( ranges.begin(), ranges.end(), []( HotRangeMap::const_iterator a, HotRangeMap::const_iterator b ) { return a->second.first > b->second.first; } );
+	for(int i = 0; i < ranges.size() && i < limit; i++)
+		out.push_back_deep( arena, HotRangeRef( KeyRangeRef( ranges[i]->first.first, ranges[i]->first.second ), ranges[i]->second.first, ranges[i]->second.second ) );
+}
+
+ACTOR Future<GetHotRangesReply> getClusterHotRanges( Database cx, int limit ) {
+	state Transaction tr(cx);
+	state vector<StorageServerInterface> servers;
+	loop {
+		try {
+			tr.setOption( FDBTransactionOptions::READ_SYSTEM_KEYS );
+			tr.setOption( FDBTransactionOptions::LOCK_AWARE );
+			Standalone<RangeResultRef> serverList = wait( tr.getRange( serverListKeys, CLIENT_KNOBS->TOO_MANY ) );
+			ASSERT( !serverList.more && serverList.size() < CLIENT_KNOBS->TOO_MANY );
+			for(auto& s : serverList) {
+				StorageServerInterface ssi = decodeServerListValue( s.value );
+				// Servers of an older version have no getHotRanges endpoint
+				if( ssi.getHotRanges.getEndpoint().isValid() )
+					servers.push_back( ssi );
+			}
+			break;
+		} catch (Error& e) {
+			Void _ = wait( tr.onError(e) );
+		}
+	}
+
+	state vector<Future<ErrorOr<GetHotRangesReply>>> replies;
+	for(auto& ssi : servers)
+		replies.push_back( ssi.getHotRanges.tryGetReply( GetHotRangesRequest( limit ) ) );
+	Void _ = wait( waitForAll( replies ) );
+
+	HotRangeMap reads, writes;
+	GetHotRangesReply result;
+	for(int i = 0; i < replies.size(); i++) {
+		if( replies[i].get().isError() ) {
+			TraceEvent(SevWarn, "GetHotRangesFailed").error(replies[i].get().getError()).detail("Server", servers[i].id());
+			continue;
+		}
+		GetHotRangesReply const& reply = replies[i].get().get();
+		mergeHotRanges( reads, reply.reads, true );
+		mergeHotRanges( writes, reply.writes, false );
+		result.seconds = std::max( result.seconds, reply.seconds );
+	}
+	hottestRanges( result.arena, result.reads, reads, limit );
+	hottestRanges( result.arena, result.writes, writes, limit );
+	return result;
+}
+
 ACTOR Future<Void> timeKeeperSetDisable(Database cx) {
 	loop {
 		state Transaction tr(cx);
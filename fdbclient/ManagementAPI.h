@@ -159,4 +159,8 @@ Future<int> setDDMode( Database const& cx, int const& mode );
 
 // Gets the cluster connection string
 Future<std::vector<NetworkAddress>> getCoordinators( Database const& cx );
+
+// Gets at most limit of the hottest ranges read and written across all storage servers.  The read rate of a range is the
+// sum over the servers that sampled it, and the write rate the greatest, since every replica of a range applies its writes.
+Future<GetHotRangesReply> getClusterHotRanges( Database const& cx, int const& limit );
 #endif
\ No newline at end of file
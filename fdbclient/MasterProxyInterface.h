@@ -87,14 +87,33 @@ struct CommitTransactionRequest {
 	ReplyPromise<CommitID> reply;
 	uint32_t flags;
 	Optional<UID> debugID;
+	StringRef packedTransaction;  // If not empty, transaction is sent in this form (see CommitTransactionRef::pack)
+	int32_t packedUncompressedSize;
 
-	CommitTransactionRequest() : flags(0) {}
+	CommitTransactionRequest() : flags(0), packedUncompressedSize(0) {}
+
+	// Must be called again if transaction is changed afterward
+	void packTransaction( int compressMinBytes, int compressionLevel ) {
+		packedTransaction = transaction.pack( arena, compressMinBytes, compressionLevel, packedUncompressedSize );
+	}
 
 	template <class Ar> 
 	void serialize(Ar& ar) { 
-		ar & transaction & reply & arena & flags & debugID;
+		if( ar.protocolVersion() >= 0x0FDB00A560060001LL ) {
+			ar & reply & arena & flags & debugID & packedTransaction & packedUncompressedSize;
+			if( !packedTransaction.size() ) {
+				ar & transaction;
+			} else if( ar.isDeserializing ) {
+				transaction = CommitTransactionRef::unpack( arena, packedTransaction, packedUncompressedSize );
+				packedTransaction = StringRef();
+				packedUncompressedSize = 0;
+			}
+		} else {
+			ar & transaction & reply & arena & flags & debugID;
+		}
 	}
 };
+PREALLOCATED_SERIALIZABLE( CommitTransactionRequest );
 
 static inline int getBytes( CommitTransactionRequest const& r ) { 
 	// SOMEDAY: Optimize
@@ -127,16 +146,18 @@ struct GetReadVersionRequest {
 	};
 	enum { 
 		FLAG_CAUSAL_READ_RISKY = 1,
+		FLAG_USE_GOSSIPED_VERSION = 2,  // Answer from the proxy's last view of the other proxies' committed versions, if it is recent
 		FLAG_PRIORITY_MASK = PRIORITY_SYSTEM_IMMEDIATE,
 	};
 
 	uint32_t transactionCount;
 	uint32_t flags;
 	Optional<UID> debugID;
+	Key tag;  // Empty unless the transactions were tagged, in which case the proxies may limit the rate at which they start
 	ReplyPromise<GetReadVersionReply> reply;
 
 	GetReadVersionRequest() : transactionCount( 1 ), flags( PRIORITY_DEFAULT ) {}
-	GetReadVersionRequest( uint32_t transactionCount, uint32_t flags, Optional<UID> debugID = Optional<UID>() ) : transactionCount( transactionCount ), flags( flags ), debugID( debugID ) {}
+	GetReadVersionRequest( uint32_t transactionCount, uint32_t flags, Optional<UID> debugID = Optional<UID>(), Key tag = Key() ) : transactionCount( transactionCount ), flags( flags ), debugID( debugID ), tag( tag ) {}
 	
 	int priority() const { return flags & FLAG_PRIORITY_MASK; }
 	bool operator < (GetReadVersionRequest const& rhs) const { return priority() < rhs.priority(); }
@@ -144,6 +165,9 @@ struct GetReadVersionRequest {
 	template <class Ar> 
 	void serialize(Ar& ar) { 
 		ar & transactionCount & flags & debugID & reply;
+		if( ar.protocolVersion() >= 0x0FDB00A560060001LL ) {
+			ar & tag;
+		}
 	}
 };
 
@@ -195,6 +195,7 @@ ACTOR Future<Void> dumpMetrics(Database cx, MetricsConfig *config, TDMetricColle
 	ASSERT(collection != nullptr);
 	mk.prefix = StringRef(mk.arena(), config->space.key());
 	mk.address = StringRef(mk.arena(), collection->address);
+	state double flushInterval = CLIENT_KNOBS->METRICS_FLUSH_INTERVAL;
 
 	loop {
 		batch.clear();
@@ -204,6 +205,9 @@ ACTOR Future<Void> dumpMetrics(Database cx, MetricsConfig *config, TDMetricColle
 			collection->rollTimes.pop_front();
 		}
 
+		// Bring the metrics recorded on other threads up to date before flushing them
+		collection->publishThreadMetrics();
+
 		// Are any metrics enabled?
 		state bool enabled = false;
 		
@@ -221,7 +225,11 @@ ACTOR Future<Void> dumpMetrics(Database cx, MetricsConfig *config, TDMetricColle
 			collection->currentTimeBytes = 0;
 		}
 
+		// All of the flush is done at batch priority, so that when Ratekeeper holds back batch work the flushes take longer
+		// and the interval between them grows in proportion, each carrying more data, rather than adding to the load
+		state double flushStart = now();
 		state ReadYourWritesTransaction cbtr(cx);
+		cbtr.setOption(FDBTransactionOptions::PRIORITY_BATCH);
 		state MetricDB mdb(&cbtr);
 		
 		state std::map<int, Future<Void>> results;
@@ -254,19 +262,20 @@ ACTOR Future<Void> dumpMetrics(Database cx, MetricsConfig *config, TDMetricColle
 		}
 
 		// If there are more rolltimes then next dump is now, otherwise if no metrics are enabled then it is
-		// whenever the next metric is enabled but if there are metrics enabled then it is in 1 second.
+		// whenever the next metric is enabled but if there are metrics enabled then it is after the flush interval.
 		state Future<Void> nextDump;
 		if(collection->rollTimes.size() > 0)
 			nextDump = Void();
 		else {
 			nextDump = collection->metricEnabled.onTrigger();
 			if(enabled)
-				nextDump = nextDump || delay(1.0);
+				nextDump = nextDump || delay(flushInterval);
 		}
 
 		state Transaction tr( cx );
 		loop {
 			tr.setOption(FDBTransactionOptions::ACCESS_SYSTEM_KEYS);
+			tr.setOption(FDBTransactionOptions::PRIORITY_BATCH);
 			try {
 				for(auto &i : batch.inserts) {
 					//fprintf(stderr, "%s: dump insert: %s\n", collection->address.toString().c_str(), printable(allInsertions[i].key).c_str());
@@ -289,6 +298,11 @@ ACTOR Future<Void> dumpMetrics(Database cx, MetricsConfig *config, TDMetricColle
 				Void _ = wait(  tr.onError( e ) );
 			}
 		}
+
+		double busyInterval = (now() - flushStart) / CLIENT_KNOBS->METRICS_FLUSH_BUSY_FRACTION;
+		flushInterval = std::min(CLIENT_KNOBS->METRICS_FLUSH_MAX_INTERVAL, std::max(CLIENT_KNOBS->METRICS_FLUSH_INTERVAL, busyInterval));
+		if(flushInterval > CLIENT_KNOBS->METRICS_FLUSH_INTERVAL)
+			TraceEvent("TDMetricsFlushDelayed").detail("FlushTime", now() - flushStart).detail("NextInterval", flushInterval).suppressFor(60.0);
 		Void _ = wait( nextDump );
 	}
 }
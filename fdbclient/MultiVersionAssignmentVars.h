@@ -121,6 +121,10 @@ private:
 
 template<class T>
 ThreadFuture<T> abortableFuture(ThreadFuture<T> f, ThreadFuture<Void> abortSignal) {
+	// A future that is already set would be passed straight through, unless the signal has already fired
+	if(f.isReady() && !abortSignal.isReady()) {
+		return f;
+	}
 	return ThreadFuture<T>(new AbortableSingleAssignmentVar<T>(f, abortSignal));
 }
 
@@ -89,9 +89,16 @@ ThreadFuture<Standalone<RangeResultRef>> DLTransaction::getRange(const KeySelect
 }
 
 ThreadFuture<Standalone<RangeResultRef>> DLTransaction::getRange(const KeySelectorRef& begin, const KeySelectorRef& end, GetRangeLimits limits, bool snapshot, bool reverse) {
-	FdbCApi::FDBFuture *f = api->transactionGetRange(tr, begin.getKey().begin(), begin.getKey().size(), begin.orEqual, begin.offset, end.getKey().begin(), end.getKey().size(), end.orEqual, end.offset,
-														limits.rows, limits.bytes, FDBStreamingModes::EXACT, 0, snapshot, reverse);
-	return toThreadFuture<Standalone<RangeResultRef>>(api, f, [](FdbCApi::FDBFuture *f, FdbCApi *api) {
+	FdbCApi::FDBFuture *f;
+	if(limits.hasValueLimit() && api->transactionGetRangeValuePrefix) {
+		f = api->transactionGetRangeValuePrefix(tr, begin.getKey().begin(), begin.getKey().size(), begin.orEqual, begin.offset, end.getKey().begin(), end.getKey().size(), end.orEqual, end.offset,
+												limits.rows, limits.bytes, FDBStreamingModes::EXACT, 0, snapshot, reverse, limits.valueBytes);
+	}
+	else {
+		f = api->transactionGetRange(tr, begin.getKey().begin(), begin.getKey().size(), begin.orEqual, begin.offset, end.getKey().begin(), end.getKey().size(), end.orEqual, end.offset,
+										limits.rows, limits.bytes, FDBStreamingModes::EXACT, 0, snapshot, reverse);
+	}
+	return toThreadFuture<Standalone<RangeResultRef>>(api, f, [limits](FdbCApi::FDBFuture *f, FdbCApi *api) {
 		const FdbCApi::FDBKeyValue *kvs;
 		int count;
 		FdbCApi::fdb_bool_t more;
@@ -99,7 +106,11 @@ ThreadFuture<Standalone<RangeResultRef>> DLTransaction::getRange(const KeySelect
 		ASSERT(!error);
 
 		// The memory for this is stored in the FDBFuture and is released when the future gets destroyed
-		return Standalone<RangeResultRef>(RangeResultRef(VectorRef<KeyValueRef>((KeyValueRef*)kvs, count), more), Arena());
+		Standalone<RangeResultRef> result(RangeResultRef(VectorRef<KeyValueRef>((KeyValueRef*)kvs, count), more), Arena());
+
+		// A client library without fdb_transaction_get_range_value_prefix() returns whole values
+		limits.truncateValues(result);
+		return result;
 	});
 }
 
@@ -143,6 +154,32 @@ ThreadFuture<Standalone<StringRef>> DLTransaction::getVersionstamp() {
 	});
 }
 
+ThreadFuture<Standalone<RangeResultRef>> DLTransaction::getMulti(const VectorRef<KeyRef>& keys, bool snapshot) {
+	if(!api->transactionGetMulti) {
+		return unsupported_operation();
+	}
+
+	std::vector<uint8_t> packedKeys;
+	std::vector<int> keyLengths;
+	for(auto& k : keys) {
+		packedKeys.insert(packedKeys.end(), k.begin(), k.end());
+		keyLengths.push_back(k.size());
+	}
+
+	FdbCApi::FDBFuture *f = api->transactionGetMulti(tr, packedKeys.data(), keyLengths.data(), keys.size(), snapshot);
+
+	return toThreadFuture<Standalone<RangeResultRef>>(api, f, [](FdbCApi::FDBFuture *f, FdbCApi *api) {
+		const FdbCApi::FDBKeyValue *kvs;
+		int count;
+		FdbCApi::fdb_bool_t more;
+		FdbCApi::fdb_error_t error = api->futureGetKeyValueArray(f, &kvs, &count, &more);
+		ASSERT(!error);
+
+		// The memory for this is stored in the FDBFuture and is released when the future gets destroyed
+		return Standalone<RangeResultRef>(RangeResultRef(VectorRef<KeyValueRef>((KeyValueRef*)kvs, count), more), Arena());
+	});
+}
+
 void DLTransaction::addReadConflictRange(const KeyRangeRef& keys) {
 	throwIfError(api->transactionAddConflictRange(tr, keys.begin.begin(), keys.begin.size(), keys.end.begin(), keys.end.size(), FDBConflictRangeTypes::READ));
 }
@@ -155,6 +192,26 @@ void DLTransaction::set(const KeyRef& key, const ValueRef& value) {
 	api->transactionSet(tr, key.begin(), key.size(), value.begin(), value.size());
 }
 
+void DLTransaction::setMulti(const VectorRef<KeyValueRef>& kvs) {
+	if(!api->transactionSetMulti) {
+		for(auto& kv : kvs) {
+			set(kv.key, kv.value);
+		}
+		return;
+	}
+
+	std::vector<uint8_t> packedKeys, packedValues;
+	std::vector<int> keyLengths, valueLengths;
+	for(auto& kv : kvs) {
+		packedKeys.insert(packedKeys.end(), kv.key.begin(), kv.key.end());
+		keyLengths.push_back(kv.key.size());
+		packedValues.insert(packedValues.end(), kv.value.begin(), kv.value.end());
+		valueLengths.push_back(kv.value.size());
+	}
+
+	api->transactionSetMulti(tr, packedKeys.data(), keyLengths.data(), packedValues.data(), valueLengths.data(), kvs.size());
+}
+
 void DLTransaction::clear(const KeyRef& begin, const KeyRef& end) {
 	api->transactionClearRange(tr, begin.begin(), begin.size(), end.begin(), end.size());
 }
@@ -283,7 +340,10 @@ void DLApi::init() {
 	loadClientFunction(&api->transactionGetAddressesForKey, lib, fdbCPath, "fdb_transaction_get_addresses_for_key");
 	loadClientFunction(&api->transactionGetRange, lib, fdbCPath, "fdb_transaction_get_range");
 	loadClientFunction(&api->transactionGetVersionstamp, lib, fdbCPath, "fdb_transaction_get_versionstamp", headerVersion >= 410);
+	loadClientFunction(&api->transactionGetMulti, lib, fdbCPath, "fdb_transaction_get_multi", false);
+	loadClientFunction(&api->transactionGetRangeValuePrefix, lib, fdbCPath, "fdb_transaction_get_range_value_prefix", false);
 	loadClientFunction(&api->transactionSet, lib, fdbCPath, "fdb_transaction_set");
+	loadClientFunction(&api->transactionSetMulti, lib, fdbCPath, "fdb_transaction_set_multi", false);
 	loadClientFunction(&api->transactionClear, lib, fdbCPath, "fdb_transaction_clear");
 	loadClientFunction(&api->transactionClearRange, lib, fdbCPath, "fdb_transaction_clear_range");
 	loadClientFunction(&api->transactionAtomicOp, lib, fdbCPath, "fdb_transaction_atomic_op");
@@ -355,6 +415,157 @@ ThreadFuture<Reference<ICluster>> DLApi::createCluster(const char *clusterFilePa
 	});
 }
 
+// Returns the values of all of futures, in order, or the first error among them
+template<class T>
+ThreadFuture<std::vector<T>> collectThreadFutures(std::vector<ThreadFuture<T>> futures, std::vector<T> values = std::vector<T>()) {
+	if(values.size() == futures.size()) {
+		return values;
+	}
+
+	return flatMapThreadFuture<T, std::vector<T>>(futures[values.size()], [futures, values](ErrorOr<T> value) mutable {
+		if(value.isError()) {
+			return ErrorOr<ThreadFuture<std::vector<T>>>(value.getError());
+		}
+		values.push_back(value.get());
+		return ErrorOr<ThreadFuture<std::vector<T>>>(collectThreadFutures(futures, values));
+	});
+}
+
+// MultiThreadDatabase
+Reference<ITransaction> MultiThreadDatabase::createTransaction() {
+	return dbs[ uint32_t(interlockedIncrement(&nextDb)) % dbs.size() ]->createTransaction();
+}
+
+void MultiThreadDatabase::setOption(FDBDatabaseOptions::Option option, Optional<StringRef> value) {
+	for(auto db : dbs) {
+		db->setOption(option, value);
+	}
+}
+
+// MultiThreadCluster
+ThreadFuture<Reference<IDatabase>> MultiThreadCluster::createDatabase(Standalone<StringRef> dbName) {
+	std::vector<ThreadFuture<Reference<IDatabase>>> dbs;
+	for(auto cluster : clusters) {
+		dbs.push_back(cluster->createDatabase(dbName));
+	}
+
+	return mapThreadFuture<std::vector<Reference<IDatabase>>, Reference<IDatabase>>(collectThreadFutures(dbs), [](ErrorOr<std::vector<Reference<IDatabase>>> dbs) {
+		if(dbs.isError()) {
+			return ErrorOr<Reference<IDatabase>>(dbs.getError());
+		}
+		return ErrorOr<Reference<IDatabase>>(Reference<IDatabase>(new MultiThreadDatabase(dbs.get())));
+	});
+}
+
+void MultiThreadCluster::setOption(FDBClusterOptions::Option option, Optional<StringRef> value) {
+	for(auto cluster : clusters) {
+		cluster->setOption(option, value);
+	}
+}
+
+// MultiThreadApi
+void MultiThreadApi::selectApiVersion(int apiVersion) {
+	// A library loaded from the same path again would share its globals, including the network, with the first copy, so
+	// each further copy is loaded from a file of its own
+	std::string tmpDir;
+#ifdef _WIN32
+	if(!platform::getEnvironmentVar("TEMP", tmpDir))
+#else
+	if(!platform::getEnvironmentVar("TMPDIR", tmpDir))
+#endif
+		tmpDir = "/tmp";
+
+	std::vector<std::string> copies;
+	while(apis.size() < threads) {
+		std::string copy = joinPath(tmpDir, format("fdb-client-%08x-%d-%s", platform::getRandomSeed(), (int)apis.size(), basename(libPath).c_str()));
+		TraceEvent("CopyingExternalClient").detail("LibraryPath", libPath).detail("CopyPath", copy);
+		writeFile(copy, readFileBytes(libPath, std::numeric_limits<int>::max()));
+		copies.push_back(copy);
+		apis.push_back(new DLApi(copy));
+	}
+
+	for(auto api : apis) {
+		api->selectApiVersion(apiVersion);
+	}
+
+#ifndef _WIN32
+	// The copies stay loaded, so their files are no longer needed
+	for(auto copy : copies) {
+		deleteFile(copy);
+	}
+#endif
+}
+
+const char* MultiThreadApi::getClientVersion() {
+	return apis[0]->getClientVersion();
+}
+
+void MultiThreadApi::setNetworkOption(FDBNetworkOptions::Option option, Optional<StringRef> value) {
+	for(auto api : apis) {
+		api->setNetworkOption(option, value);
+	}
+}
+
+void MultiThreadApi::setupNetwork() {
+	for(auto api : apis) {
+		api->setupNetwork();
+	}
+}
+
+THREAD_FUNC_RETURN runApiNetworkThread(void *param) {
+	try {
+		((IClientApi*)param)->runNetwork();
+	}
+	catch(Error &e) {
+		TraceEvent(SevError, "RunNetworkError").error(e);
+	}
+
+	THREAD_RETURN;
+}
+
+void MultiThreadApi::runNetwork() {
+	std::vector<THREAD_HANDLE> handles;
+	for(int i = 1; i < apis.size(); i++) {
+		handles.push_back(g_network->startThread(&runApiNetworkThread, apis[i]));
+	}
+
+	Error *runErr = NULL;
+	try {
+		apis[0]->runNetwork();
+	}
+	catch(Error &e) {
+		runErr = &e;
+	}
+
+	for(auto h : handles) {
+		waitThread(h);
+	}
+
+	if(runErr != NULL) {
+		throw *runErr;
+	}
+}
+
+void MultiThreadApi::stopNetwork() {
+	for(auto api : apis) {
+		api->stopNetwork();
+	}
+}
+
+ThreadFuture<Reference<ICluster>> MultiThreadApi::createCluster(const char *clusterFilePath) {
+	std::vector<ThreadFuture<Reference<ICluster>>> clusters;
+	for(auto api : apis) {
+		clusters.push_back(api->createCluster(clusterFilePath));
+	}
+
+	return mapThreadFuture<std::vector<Reference<ICluster>>, Reference<ICluster>>(collectThreadFutures(clusters), [](ErrorOr<std::vector<Reference<ICluster>>> clusters) {
+		if(clusters.isError()) {
+			return ErrorOr<Reference<ICluster>>(clusters.getError());
+		}
+		return ErrorOr<Reference<ICluster>>(Reference<ICluster>(new MultiThreadCluster(clusters.get())));
+	});
+}
+
 // MultiVersionTransaction
 MultiVersionTransaction::MultiVersionTransaction(Reference<MultiVersionDatabase> db) : db(db) {
 	updateTransaction();
@@ -445,6 +656,12 @@ ThreadFuture<Standalone<StringRef>> MultiVersionTransaction::getVersionstamp() {
 	return abortableFuture(f, tr.onChange);
 }
 
+ThreadFuture<Standalone<RangeResultRef>> MultiVersionTransaction::getMulti(const VectorRef<KeyRef>& keys, bool snapshot) {
+	auto tr = getTransaction();
+	auto f = tr.transaction ? tr.transaction->getMulti(keys, snapshot) : ThreadFuture<Standalone<RangeResultRef>>(Never());
+	return abortableFuture(f, tr.onChange);
+}
+
 ThreadFuture<Standalone<VectorRef<const char*>>> MultiVersionTransaction::getAddressesForKey(const KeyRef& key) {
 	auto tr = getTransaction();
 	auto f = tr.transaction ? tr.transaction->getAddressesForKey(key) : ThreadFuture<Standalone<VectorRef<const char*>>>(Never());
@@ -472,6 +689,13 @@ void MultiVersionTransaction::set(const KeyRef& key, const ValueRef& value) {
 	}
 }
 
+void MultiVersionTransaction::setMulti(const VectorRef<KeyValueRef>& kvs) {
+	auto tr = getTransaction();
+	if(tr.transaction) {
+		tr.transaction->setMulti(kvs);
+	}
+}
+
 void MultiVersionTransaction::clear(const KeyRef& begin, const KeyRef& end) {
 	auto tr = getTransaction();
 	if(tr.transaction) {
@@ -558,6 +782,15 @@ Reference<IDatabase> MultiVersionDatabase::debugCreateFromExistingDatabase(Refer
 }
 
 Reference<ITransaction> MultiVersionDatabase::createTransaction() {
+	// With only one client to connect with, a database that has been created is never replaced, so its transactions
+	// are handed out directly rather than through a MultiVersionTransaction that could switch them to another client
+	if(dbState->cluster->clusterState->singleClient) {
+		auto currentDb = dbState->dbVar->get();
+		if(currentDb.value) {
+			return currentDb.value->createTransaction();
+		}
+	}
+
 	return Reference<ITransaction>(new MultiVersionTransaction(Reference<MultiVersionDatabase>::addRef(this)));
 }
 
@@ -682,6 +915,7 @@ MultiVersionCluster::MultiVersionCluster(MultiVersionApi *api, std::string clust
 		clusterState->addConnection(client, clusterFilePath);
 	});
 
+	clusterState->singleClient = clusterState->clients.size() == 1;
 	clusterState->startConnections();
 }
 
@@ -1005,6 +1239,15 @@ void MultiVersionApi::disableLocalClient() {
 	localClientDisabled = true;
 }
 
+void MultiVersionApi::setClientThreadsPerVersion(int threads) {
+	MutexHolder holder(lock);
+	if(networkStartSetup) {
+		throw invalid_option();
+	}
+
+	threadsPerVersion = threads;
+}
+
 void MultiVersionApi::setSupportedClientVersions(Standalone<StringRef> versions) {
 	MutexHolder holder(lock);
 	ASSERT(networkSetup);
@@ -1050,6 +1293,10 @@ void MultiVersionApi::setNetworkOptionInternal(FDBNetworkOptions::Option option,
 		validateOption(value, false, true);
 		disableLocalClient();
 	}
+	else if(option == FDBNetworkOptions::CLIENT_THREADS_PER_VERSION) {
+		validateOption(value, true, false, false);
+		setClientThreadsPerVersion(extractIntOption(value, 1, 1024));
+	}
 	else if(option == FDBNetworkOptions::SUPPORTED_CLIENT_VERSIONS) {
 		ASSERT(value.present());
 		setSupportedClientVersions(value.get());
@@ -1106,8 +1353,14 @@ void MultiVersionApi::setupNetwork() {
 	localClient->loadProtocolVersion();
 
 	if(!bypassMultiClientApi) {
+		if(threadsPerVersion > 1) {
+			for(auto it : externalClients) {
+				it.second->api = new MultiThreadApi(it.second->api, it.second->libPath, threadsPerVersion);
+			}
+		}
+
 		runOnExternalClients([this](Reference<ClientInfo> client) {
-			TraceEvent("InitializingExternalClient").detail("LibraryPath", client->libPath);
+			TraceEvent("InitializingExternalClient").detail("LibraryPath", client->libPath).detail("Threads", threadsPerVersion);
 			client->api->selectApiVersion(apiVersion);
 			client->loadProtocolVersion();
 		});
@@ -1369,7 +1622,7 @@ void MultiVersionApi::loadEnvironmentVariableNetworkOptions() {
 	envOptionsLoaded = true;
 }
 
-MultiVersionApi::MultiVersionApi() : bypassMultiClientApi(false), networkStartSetup(false), networkSetup(false), callbackOnMainThread(true), externalClient(false), localClientDisabled(false), apiVersion(0), envOptionsLoaded(false) {}
+MultiVersionApi::MultiVersionApi() : bypassMultiClientApi(false), networkStartSetup(false), networkSetup(false), callbackOnMainThread(true), externalClient(false), localClientDisabled(false), apiVersion(0), threadsPerVersion(1), envOptionsLoaded(false) {}
 
 MultiVersionApi* MultiVersionApi::api = new MultiVersionApi();
 
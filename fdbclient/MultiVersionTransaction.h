@@ -81,8 +81,13 @@ struct FdbCApi : public ThreadSafeReferenceCounted<FdbCApi> {
 										uint8_t const *endKeyName, int endKeyNameLength, fdb_bool_t endOrEqual, int endOffset, int limit, int targetBytes,
 										FDBStreamingModes::Option mode, int iteration, fdb_bool_t snapshot, fdb_bool_t reverse);
 	FDBFuture* (*transactionGetVersionstamp)(FDBTransaction* tr);
+	FDBFuture* (*transactionGetMulti)(FDBTransaction *tr, uint8_t const *keys, int const *keyLengths, int keyCount, fdb_bool_t snapshot);
+	FDBFuture* (*transactionGetRangeValuePrefix)(FDBTransaction *tr, uint8_t const *beginKeyName, int beginKeyNameLength, fdb_bool_t beginOrEqual, int beginOffset,
+										uint8_t const *endKeyName, int endKeyNameLength, fdb_bool_t endOrEqual, int endOffset, int limit, int targetBytes,
+										FDBStreamingModes::Option mode, int iteration, fdb_bool_t snapshot, fdb_bool_t reverse, int valuePrefixLength);
 
 	void (*transactionSet)(FDBTransaction *tr, uint8_t const *keyName, int keyNameLength, uint8_t const *value, int valueLength);
+	void (*transactionSetMulti)(FDBTransaction *tr, uint8_t const *keys, int const *keyLengths, uint8_t const *values, int const *valueLengths, int count);
 	void (*transactionClear)(FDBTransaction *tr, uint8_t const *keyName, int keyNameLength);
 	void (*transactionClearRange)(FDBTransaction *tr, uint8_t const *beginKeyName, int beginKeyNameLength, uint8_t const *endKeyName, int endKeyNameLength);
 	void (*transactionAtomicOp)(FDBTransaction *tr, uint8_t const *keyName, int keyNameLength, uint8_t const *param, int paramLength, FDBMutationTypes::Option operationType);
@@ -128,11 +133,13 @@ public:
 	ThreadFuture<Standalone<RangeResultRef>> getRange( const KeyRangeRef& keys, GetRangeLimits limits, bool snapshot=false, bool reverse=false);
 	ThreadFuture<Standalone<VectorRef<const char*>>> getAddressesForKey(const KeyRef& key);
 	ThreadFuture<Standalone<StringRef>> getVersionstamp();
+	ThreadFuture<Standalone<RangeResultRef>> getMulti(const VectorRef<KeyRef>& keys, bool snapshot=false);
  
 	void addReadConflictRange(const KeyRangeRef& keys);
 
 	void atomicOp(const KeyRef& key, const ValueRef& value, uint32_t operationType);
 	void set(const KeyRef& key, const ValueRef& value);
+	void setMulti(const VectorRef<KeyValueRef>& kvs);
 	void clear(const KeyRef& begin, const KeyRef& end);
 	void clear(const KeyRangeRef& range);
 	void clear(const KeyRef& key);
@@ -212,6 +219,57 @@ private:
 	void init();
 };
 
+// Several copies of one client library, each loaded separately and running its own network thread.  Clusters and
+// databases are created through every copy, and transactions are handed to the copies in turn.
+class MultiThreadApi : public IClientApi {
+public:
+	MultiThreadApi(IClientApi *api, std::string libPath, int threads) : libPath(libPath), threads(threads) { apis.push_back(api); }
+
+	void selectApiVersion(int apiVersion);
+	const char* getClientVersion();
+
+	void setNetworkOption(FDBNetworkOptions::Option option, Optional<StringRef> value = Optional<StringRef>());
+	void setupNetwork();
+	void runNetwork();
+	void stopNetwork();
+
+	ThreadFuture<Reference<ICluster>> createCluster(const char *clusterFilePath);
+
+private:
+	const std::string libPath;
+	const int threads;
+	std::vector<IClientApi*> apis;
+};
+
+class MultiThreadDatabase : public IDatabase, ThreadSafeReferenceCounted<MultiThreadDatabase> {
+public:
+	MultiThreadDatabase(std::vector<Reference<IDatabase>> dbs) : dbs(dbs), nextDb(0) {}
+
+	Reference<ITransaction> createTransaction();
+	void setOption(FDBDatabaseOptions::Option option, Optional<StringRef> value = Optional<StringRef>());
+
+	void addref() { ThreadSafeReferenceCounted<MultiThreadDatabase>::addref(); }
+	void delref() { ThreadSafeReferenceCounted<MultiThreadDatabase>::delref(); }
+
+private:
+	const std::vector<Reference<IDatabase>> dbs;
+	volatile int32_t nextDb;
+};
+
+class MultiThreadCluster : public ICluster, ThreadSafeReferenceCounted<MultiThreadCluster> {
+public:
+	MultiThreadCluster(std::vector<Reference<ICluster>> clusters) : clusters(clusters) {}
+
+	ThreadFuture<Reference<IDatabase>> createDatabase(Standalone<StringRef> dbName);
+	void setOption(FDBClusterOptions::Option option, Optional<StringRef> value = Optional<StringRef>());
+
+	void addref() { ThreadSafeReferenceCounted<MultiThreadCluster>::addref(); }
+	void delref() { ThreadSafeReferenceCounted<MultiThreadCluster>::delref(); }
+
+private:
+	const std::vector<Reference<ICluster>> clusters;
+};
+
 class MultiVersionDatabase;
 
 class MultiVersionTransaction : public ITransaction, ThreadSafeReferenceCounted<MultiVersionTransaction> {
@@ -230,11 +288,13 @@ public:
 	ThreadFuture<Standalone<RangeResultRef>> getRange( const KeyRangeRef& keys, GetRangeLimits limits, bool snapshot=false, bool reverse=false);
 	ThreadFuture<Standalone<VectorRef<const char*>>> getAddressesForKey(const KeyRef& key);
 	ThreadFuture<Standalone<StringRef>> getVersionstamp();
+	ThreadFuture<Standalone<RangeResultRef>> getMulti(const VectorRef<KeyRef>& keys, bool snapshot=false);
  
 	void addReadConflictRange(const KeyRangeRef& keys);
 
 	void atomicOp(const KeyRef& key, const ValueRef& value, uint32_t operationType);
 	void set(const KeyRef& key, const ValueRef& value);
+	void setMulti(const VectorRef<KeyValueRef>& kvs);
 	void clear(const KeyRef& begin, const KeyRef& end);
 	void clear(const KeyRangeRef& range);
 	void clear(const KeyRef& key);
@@ -372,7 +432,7 @@ private:
 	};
 
 	struct ClusterState : ThreadSafeReferenceCounted<ClusterState> {
-		ClusterState() : clusterVar(new ThreadSafeAsyncVar<Reference<ICluster>>(Reference<ICluster>(NULL))), currentClientIndex(-1) {}
+		ClusterState() : clusterVar(new ThreadSafeAsyncVar<Reference<ICluster>>(Reference<ICluster>(NULL))), currentClientIndex(-1), singleClient(false) {}
 
 		void stateChanged();
 		void addConnection(Reference<ClientInfo> client, std::string clusterFilePath);
@@ -384,6 +444,10 @@ private:
 
 		int currentClientIndex;
 		std::vector<Reference<ClientInfo>> clients;
+
+		// Set when the cluster was created with only one client to connect with, so that it never switches clients once
+		// connected. Fixed before the cluster is handed out, and so safe to read from any thread.
+		bool singleClient;
 		std::vector<Reference<Connector>> connectionAttempts;
 
 		std::vector<std::pair<FDBClusterOptions::Option, Optional<Standalone<StringRef>>>> options;
@@ -426,6 +490,7 @@ private:
 	void addExternalLibrary(std::string path);
 	void addExternalLibraryDirectory(std::string path);
 	void disableLocalClient();
+	void setClientThreadsPerVersion(int threads);
 	void setSupportedClientVersions(Standalone<StringRef> versions);
 
 	void setNetworkOptionInternal(FDBNetworkOptions::Option option, Optional<StringRef> value);
@@ -438,6 +503,7 @@ private:
 	volatile bool bypassMultiClientApi;
 	volatile bool externalClient;
 	int apiVersion;
+	int threadsPerVersion;
 
 	Mutex lock;
 	std::vector<std::pair<FDBNetworkOptions::Option, Optional<Standalone<StringRef>>>> options;
@@ -40,6 +40,8 @@
 #include "flow/Knobs.h"
 #include "fdbclient/Knobs.h"
 #include "fdbrpc/Net2FileSystem.h"
+#include "fdbrpc/TraceBlockCodec.h"
+#include "flow/Hash3.h"
 
 #include <iterator>
 
@@ -207,8 +209,11 @@ ACTOR Future<Void> databaseLogger( DatabaseContext *cx ) {
 		Void _ = wait( delay( CLIENT_KNOBS->SYSTEM_MONITOR_INTERVAL, cx->taskID ) );
 		TraceEvent("TransactionMetrics")
 			.detail("ReadVersions", cx->transactionReadVersions)
+			.detail("CachedReadVersions", cx->transactionCachedReadVersions)
 			.detail("LogicalUncachedReads", cx->transactionLogicalReads)
 			.detail("PhysicalReadRequests", cx->transactionPhysicalReads)
+			.detail("ReadCacheHits", cx->readCacheHits)
+			.detail("ReadCacheMisses", cx->readCacheMisses)
 			.detail("CommittedMutations", cx->transactionCommittedMutations)
 			.detail("CommittedMutationBytes", cx->transactionCommittedMutationBytes)
 			.detail("CommitStarted", cx->transactionsCommitStarted)
@@ -236,7 +241,11 @@ ACTOR Future<Void> databaseLogger( DatabaseContext *cx ) {
 			.detail("MaxMutationsPerCommit", cx->mutationsPerCommit.max())
 			.detail("MeanBytesPerCommit", cx->bytesPerCommit.mean())
 			.detail("MedianBytesPerCommit", cx->bytesPerCommit.median())
-			.detail("MaxBytesPerCommit", cx->bytesPerCommit.max());
+			.detail("MaxBytesPerCommit", cx->bytesPerCommit.max())
+			.detail("LocationCacheHits", cx->locationCacheHits)
+			.detail("LocationCacheMisses", cx->locationCacheMisses)
+			.detail("LocationCacheEvictions", cx->locationCacheEvictions)
+			.detail("LocationCacheEntries", cx->locationCache.size());
 		cx->latencies.clear();
 		cx->readLatencies.clear();
 		cx->GRVLatencies.clear();
@@ -465,8 +474,10 @@ DatabaseContext::DatabaseContext(
 	Standalone<StringRef> dbName, Standalone<StringRef> dbId,
 	int taskID, LocalityData clientLocality, bool enableLocalityLoadBalance, bool lockAware )
   : clientInfo(clientInfo), masterProxiesChangeTrigger(), cluster(cluster), clientInfoMonitor(clientInfoMonitor), dbName(dbName), dbId(dbId),
-	transactionReadVersions(0), transactionLogicalReads(0), transactionPhysicalReads(0), transactionCommittedMutations(0), transactionCommittedMutationBytes(0), transactionsCommitStarted(0), 
+	transactionReadVersions(0), transactionCachedReadVersions(0), transactionLogicalReads(0), transactionPhysicalReads(0), transactionCommittedMutations(0), transactionCommittedMutationBytes(0), transactionsCommitStarted(0), 
 	transactionsCommitCompleted(0), transactionsTooOld(0), transactionsFutureVersions(0), transactionsNotCommitted(0), transactionsMaybeCommitted(0), taskID(taskID),
+	locationCacheHits(0), locationCacheMisses(0), locationCacheEvictions(0), readCacheHits(0), readCacheMisses(0),
+	cachedReadVersion(0), cachedReadVersionTime(0), cachedReadVersionLocked(false), readVersionLag(0),
 	outstandingWatches(0), maxOutstandingWatches(CLIENT_KNOBS->DEFAULT_MAX_OUTSTANDING_WATCHES), clientLocality(clientLocality), enableLocalityLoadBalance(enableLocalityLoadBalance), lockAware(lockAware),
 	latencies(1000), readLatencies(1000), commitLatencies(1000), GRVLatencies(1000), mutationsPerCommit(1000), bytesPerCommit(1000) 
 {
@@ -482,6 +493,65 @@ DatabaseContext::DatabaseContext(
 	clientStatusUpdater.actor = clientStatusUpdateActor(this);
 }
 
+static const int MAX_CLIENT_INFO_CACHE_BYTES = 1<<20;
+
+// The file is one line: the protocol version and a hash, in hex, then the connection string and ClientDBInfo serialized
+// at that version, also in hex (atomicReplace() writes text)
+static void writeCachedClientInfo( ClusterConnectionString const& connectionString, ClientDBInfo const& info ) {
+	BinaryWriter wr( AssumeVersion(currentProtocolVersion) );
+	wr << connectionString.toString() << info;
+	std::string contents = format( "%llx %x ", (unsigned long long)currentProtocolVersion, hashlittle( wr.getData(), wr.getLength(), 0 ) );
+	static const char* digits = "0123456789abcdef";
+	const uint8_t* data = (const uint8_t*)wr.getData();
+	for(int i = 0; i < wr.getLength(); i++) {
+		contents += digits[data[i] >> 4];
+		contents += digits[data[i] & 15];
+	}
+	contents += "\n";
+
+	try {
+		atomicReplace( CLIENT_KNOBS->CLIENT_INFO_CACHE_FILE, contents );
+	} catch( Error& e ) {
+		TraceEvent(SevWarn, "ClientInfoCacheWriteError").detail("Filename", CLIENT_KNOBS->CLIENT_INFO_CACHE_FILE).error(e);
+	}
+}
+
+// The ClientDBInfo last written by a client of this version for the cluster of connectionString, if any
+static Optional<ClientDBInfo> readCachedClientInfo( ClusterConnectionString const& connectionString ) {
+	std::string const& filename = CLIENT_KNOBS->CLIENT_INFO_CACHE_FILE;
+	if( !fileExists( filename ) )
+		return Optional<ClientDBInfo>();
+
+	try {
+		std::string contents = readFileBytes( filename, MAX_CLIENT_INFO_CACHE_BYTES );
+		unsigned long long version;
+		unsigned hash;
+		int offset = 0;
+		if( sscanf( contents.c_str(), "%llx %x %n", &version, &hash, &offset ) != 2 || !offset || version != currentProtocolVersion )
+			return Optional<ClientDBInfo>();
+
+		std::string serialized;
+		int i = offset;
+		for(; i + 1 < contents.size() && isxdigit((unsigned char)contents[i]) && isxdigit((unsigned char)contents[i+1]); i += 2)
+			serialized += char( (unhex(contents[i]) << 4) + unhex(contents[i+1]) );
+		if( contents.find_first_not_of( "\r\n", i ) != std::string::npos || hashlittle( serialized.data(), serialized.size(), 0 ) != hash ) {
+			TraceEvent(SevWarn, "ClientInfoCacheCorrupt").detail("Filename", filename);
+			return Optional<ClientDBInfo>();
+		}
+
+		BinaryReader reader( serialized, AssumeVersion(currentProtocolVersion) );
+		std::string cachedConnectionString;
+		ClientDBInfo info;
+		reader >> cachedConnectionString >> info;
+		if( cachedConnectionString != connectionString.toString() || info.proxies.empty() )
+			return Optional<ClientDBInfo>();
+		return info;
+	} catch( Error& e ) {
+		TraceEvent(SevWarn, "ClientInfoCacheReadError").detail("Filename", filename).error(e);
+		return Optional<ClientDBInfo>();
+	}
+}
+
 ACTOR static Future<Void> monitorClientInfo( Reference<AsyncVar<Optional<ClusterInterface>>> clusterInterface, Standalone<StringRef> dbName,
 	Reference<ClusterConnectionFile> ccf, Reference<AsyncVar<ClientDBInfo>> outInfo ) 
 {
@@ -506,6 +576,8 @@ ACTOR static Future<Void> monitorClientInfo( Reference<AsyncVar<Optional<Cluster
 			choose {
 				when( ClientDBInfo ni = wait( clusterInterface->get().present() ? brokenPromiseToNever( clusterInterface->get().get().openDatabase.getReply( req ) ) : Never() ) ) {
 					TraceEvent("ClientInfoChange").detail("ChangeID", ni.id);
+					if( ccf && !CLIENT_KNOBS->CLIENT_INFO_CACHE_FILE.empty() && ni.id != outInfo->get().id && !ni.proxies.empty() )
+						writeCachedClientInfo( ccf->getConnectionString(), ni );
 					outInfo->set(ni);
 				}
 				when( Void _ = wait( clusterInterface->onChange() ) ) {
@@ -531,7 +603,21 @@ Future< Database > DatabaseContext::createDatabase( Reference<AsyncVar<Optional<
 	}
 	else {
 		Reference<AsyncVar<ClientDBInfo>> info( new AsyncVar<ClientDBInfo> );
-		Future<Void> monitor = monitorClientInfo( clusterInterface, dbName, cluster ? cluster->getConnectionFile() : Reference<ClusterConnectionFile>(), info );
+		Reference<ClusterConnectionFile> ccf = cluster ? cluster->getConnectionFile() : Reference<ClusterConnectionFile>();
+
+		// Until the cluster controller is found, use the proxies that the last client of this cluster knew of.  They
+		// are most likely still the proxies, and if not, requests to them fail as they would during a recovery.
+		// monitorClientInfo() asks for anything newer than them, so they are replaced as soon as the cluster
+		// controller answers.
+		if( ccf && !CLIENT_KNOBS->CLIENT_INFO_CACHE_FILE.empty() ) {
+			Optional<ClientDBInfo> cached = readCachedClientInfo( ccf->getConnectionString() );
+			if( cached.present() ) {
+				TraceEvent("ClientInfoCacheUsed").detail("ChangeID", cached.get().id).detail("Proxies", cached.get().proxies.size());
+				info->set( cached.get() );
+			}
+		}
+
+		Future<Void> monitor = monitorClientInfo( clusterInterface, dbName, ccf, info );
 
 		return std::move( Database( new DatabaseContext( info, cluster, monitor, dbName, LiteralStringRef(""), TaskDefaultEndpoint, clientLocality, true, false ) ) );
 	}
@@ -543,21 +629,23 @@ Database DatabaseContext::create( Reference<AsyncVar<ClientDBInfo>> info, Future
 
 DatabaseContext::~DatabaseContext() {
 	monitorMasterProxiesInfoChange.cancel();
+	locationPrefetcher.cancel();
+	cachedReadVersionRefresh.cancel();
 	for(auto it = ssid_locationInfo.begin(); it != ssid_locationInfo.end(); it = ssid_locationInfo.erase(it))
 		it->second->notifyContextDestroyed();
 	ASSERT_ABORT( ssid_locationInfo.empty() );
-	locationCache.insert( allKeys, Reference<LocationInfo>() );
+	locationCache.insert( allKeys, CachedLocation() );
 }
 
 pair<KeyRange,Reference<LocationInfo>> DatabaseContext::getCachedLocation( const KeyRef& key, bool isBackward ) {
-	if( isBackward ) {
-		auto range = locationCache.rangeContainingKeyBefore(key);
-		return std::make_pair(range->range(), range->value());
-	}
-	else {
-		auto range = locationCache.rangeContaining(key);
-		return std::make_pair(range->range(), range->value());
+	auto range = isBackward ? locationCache.rangeContainingKeyBefore(key) : locationCache.rangeContaining(key);
+	if( range->value().locations ) {
+		++locationCacheHits;
+		range->value().lastUsed = now();
+	} else {
+		++locationCacheMisses;
 	}
+	return std::make_pair(range->range(), range->value().locations);
 }
 
 bool DatabaseContext::getCachedLocations( const KeyRangeRef& range, vector<std::pair<KeyRange,Reference<LocationInfo>>>& result, int limit, bool reverse ) {
@@ -569,12 +657,14 @@ bool DatabaseContext::getCachedLocations( const KeyRangeRef& range, vector<std::
 
 	loop {
 		auto r = reverse ? end : begin;
-		if (!r->value()){
+		if (!r->value().locations){
 			TEST(result.size()); // had some but not all cached locations
 			result.clear();
+			++locationCacheMisses;
 			return false;
 		}
-		result.push_back( make_pair(r->range() & range, r->value()) );
+		r->value().lastUsed = now();
+		result.push_back( make_pair(r->range() & range, r->value().locations) );
 		if(result.size() == limit)
 			break;
 
@@ -587,6 +677,7 @@ bool DatabaseContext::getCachedLocations( const KeyRangeRef& range, vector<std::
 			++begin;
 	}
 
+	++locationCacheHits;
 	return true;
 }
 
@@ -596,25 +687,41 @@ Reference<LocationInfo> DatabaseContext::setCachedLocation( const KeyRangeRef& k
 	while( locationCache.size() > locationCacheSize && attempts < maxEvictionAttempts) {
 		TEST( true ); // NativeAPI storage server locationCache entry evicted
 		attempts++;
-		auto r = locationCache.randomRange();
-		Key begin = r.begin(), end = r.end();  // insert invalidates r, so can't be passed a mere reference into it
-		locationCache.insert( KeyRangeRef(begin, end), Reference<LocationInfo>() );
+		evictCachedLocation();
 	}
-	locationCache.insert( keys, loc );
+	locationCache.insert( keys, CachedLocation( loc, now() ) );
 	return std::move(loc);
 }
 
+// Evicts the least recently used of a random sample of the cached ranges, which approximates evicting the least recently
+// used range of the whole cache without keeping the ranges in order of use.
+void DatabaseContext::evictCachedLocation() {
+	Optional<KeyRange> oldest;
+	double oldestUsed = 0;
+	for( int i = 0; i < CLIENT_KNOBS->LOCATION_CACHE_EVICTION_SAMPLES; i++ ) {
+		auto r = locationCache.randomRange();
+		if( r.value().locations && ( !oldest.present() || r.value().lastUsed < oldestUsed ) ) {
+			oldest = KeyRange( r.range() );  // insert invalidates r, so can't be passed a mere reference into it
+			oldestUsed = r.value().lastUsed;
+		}
+	}
+	if( oldest.present() ) {
+		++locationCacheEvictions;
+		locationCache.insert( oldest.get(), CachedLocation() );
+	}
+}
+
 void DatabaseContext::invalidateCache( const KeyRef& key, bool isBackward ) {
 	if( isBackward )
-		locationCache.rangeContainingKeyBefore(key)->value() = Reference<LocationInfo>();
+		locationCache.rangeContainingKeyBefore(key)->value() = CachedLocation();
 	else
-		locationCache.rangeContaining(key)->value() = Reference<LocationInfo>();
+		locationCache.rangeContaining(key)->value() = CachedLocation();
 }
 
 void DatabaseContext::invalidateCache( const KeyRangeRef& keys ) {
 	auto rs = locationCache.intersectingRanges(keys);
 	Key begin = rs.begin().begin(), end = rs.end().begin();  // insert invalidates rs, so can't be passed a mere reference into it
-	locationCache.insert( KeyRangeRef(begin, end), Reference<LocationInfo>() );
+	locationCache.insert( KeyRangeRef(begin, end), CachedLocation() );
 }
 
 Future<Void> DatabaseContext::onMasterProxiesChanged() {
@@ -652,8 +759,20 @@ void DatabaseContext::setOption( FDBDatabaseOptions::Option option, Optional<Str
 			clientLocality = LocalityData( clientLocality.processId(), value.present() ? Standalone<StringRef>(value.get()) : Optional<Standalone<StringRef>>(), clientLocality.machineId(), clientLocality.dcId() );
 			if( clientInfo->get().proxies.size() )
 				masterProxies = Reference<ProxyInfo>( new ProxyInfo( clientInfo->get().proxies, clientLocality ));
+			if( clientInfo->get().grvProxies.size() )
+				grvProxies = Reference<ProxyInfo>( new ProxyInfo( clientInfo->get().grvProxies, clientLocality ));
 			ssid_locationInfo.clear();
-			locationCache.insert( allKeys, Reference<LocationInfo>() );
+			locationCache.insert( allKeys, CachedLocation() );
+			break;
+		case FDBDatabaseOptions::LOCATION_CACHE_PREFETCH:
+			validateOptionValue(value, true);
+			prefetchLocations( value.get().size() ? prefixRange(value.get()) & normalKeys : normalKeys );
+			break;
+		case FDBDatabaseOptions::READ_CACHE_PREFIX:
+			validateOptionValue(value, true);
+			if( !value.get().size() || value.get().startsWith(systemKeys.begin) )
+				throw invalid_option_value();
+			readCaches[value.get()];
 			break;
 		case FDBDatabaseOptions::MAX_WATCHES:
 			maxOutstandingWatches = (int)extractIntOption(value, 0, CLIENT_KNOBS->ABSOLUTE_MAX_WATCHES);
@@ -662,8 +781,13 @@ void DatabaseContext::setOption( FDBDatabaseOptions::Option option, Optional<Str
 			clientLocality = LocalityData(clientLocality.processId(), clientLocality.zoneId(), clientLocality.machineId(), value.present() ? Standalone<StringRef>(value.get()) : Optional<Standalone<StringRef>>());
 			if( clientInfo->get().proxies.size() )
 				masterProxies = Reference<ProxyInfo>( new ProxyInfo( clientInfo->get().proxies, clientLocality ));
+			if( clientInfo->get().grvProxies.size() )
+				grvProxies = Reference<ProxyInfo>( new ProxyInfo( clientInfo->get().grvProxies, clientLocality ));
 			ssid_locationInfo.clear();
-			locationCache.insert( allKeys, Reference<LocationInfo>() );
+			locationCache.insert( allKeys, CachedLocation() );
+			break;
+		case FDBDatabaseOptions::READ_VERSION_LAG:
+			readVersionLag = extractIntOption(value, 0, 2500) * CLIENT_KNOBS->CORE_VERSIONSPERSECOND / 1000;
 			break;
 	}
 }
@@ -680,6 +804,23 @@ void DatabaseContext::removeWatch() {
 	ASSERT(outstandingWatches >= 0);
 }
 
+Reference<WatchMetadata> DatabaseContext::getWatchMetadata( Key const& key, Optional<Value> const& value ) {
+	auto kv = std::make_pair( key, value );
+	auto it = watchMap.find( kv );
+	if( it != watchMap.end() )
+		return Reference<WatchMetadata>::addRef( it->second );
+
+	addWatch();
+	WatchMetadata* metadata = new WatchMetadata( this, kv );
+	watchMap[kv] = metadata;
+	return Reference<WatchMetadata>( metadata );
+}
+
+WatchMetadata::~WatchMetadata() {
+	cx->watchMap.erase( keyValue );
+	cx->removeWatch();
+}
+
 extern uint32_t determinePublicIPAutomatically( ClusterConnectionString const& ccs );
 
 Cluster::Cluster( Reference<ClusterConnectionFile> connFile, int apiVersion )
@@ -694,6 +835,7 @@ Cluster::Cluster( Reference<ClusterConnectionFile> connFile, int apiVersion )
 		initTraceEventMetrics();
 
 		auto publicIP = determinePublicIPAutomatically( connFile->getConnectionString() );
+		setTraceBlockCodec( zlibTraceBlockCodec() );
 		openTraceFile(NetworkAddress(publicIP, ::getpid()), networkOptions.traceRollSize, networkOptions.traceMaxLogsSize, networkOptions.traceDirectory.get(), "trace", networkOptions.traceLogGroup);
 
 		TraceEvent("ClientStart")
@@ -883,12 +1025,32 @@ Reference<ProxyInfo> DatabaseContext::getMasterProxies() {
 	if (masterProxiesLastChange != clientInfo->get().id) {
 		masterProxiesLastChange = clientInfo->get().id;
 		masterProxies.clear();
+		grvProxies.clear();
 		if( clientInfo->get().proxies.size() )
 			masterProxies = Reference<ProxyInfo>( new ProxyInfo( clientInfo->get().proxies, clientLocality ));
+		if( clientInfo->get().grvProxies.size() )
+			grvProxies = Reference<ProxyInfo>( new ProxyInfo( clientInfo->get().grvProxies, clientLocality ));
 	}
 	return masterProxies;
 }
 
+Optional<Key> DatabaseContext::readCachePrefix( KeyRef const& key ) const {
+	// The longest prefix applies, so that a stamp under another prefix is never cached
+	Optional<Key> prefix;
+	for( auto& c : readCaches ) {
+		if( key.startsWith( c.first ) && ( !prefix.present() || c.first.size() > prefix.get().size() ) )
+			prefix = c.first;
+	}
+	if( prefix.present() && prefix.get() == key )
+		return Optional<Key>();
+	return prefix;
+}
+
+Reference<ProxyInfo> DatabaseContext::getGrvProxies() {
+	Reference<ProxyInfo> proxies = getMasterProxies();
+	return grvProxies ? grvProxies : proxies;
+}
+
 //Actor which will wait until the ProxyInfo returned by the DatabaseContext cx is not NULL
 ACTOR Future<Reference<ProxyInfo>> getMasterProxiesFuture(DatabaseContext *cx) {
 	loop{
@@ -947,6 +1109,13 @@ bool GetRangeLimits::hasSatisfiedMinRows() {
 	return hasByteLimit() && minRows == 0;
 }
 
+void GetRangeLimits::truncateValues( VectorRef<KeyValueRef>& data ) const {
+	if( hasValueLimit() )
+		for( auto& kv : data )
+			if( kv.value.size() > valueBytes )
+				kv.value = kv.value.substr( 0, valueBytes );
+}
+
 
 AddressExclusion AddressExclusion::parse( StringRef const& key ) {
 	//Must not change: serialized to the database!
@@ -1081,6 +1250,23 @@ ACTOR Future< pair<KeyRange,Reference<LocationInfo>> > getKeyLocation( Database
 	}
 }
 
+// Called when the servers in location could not serve key.  Instead of always waiting WRONG_SHARD_SERVER_DELAY before the
+// caller looks the shard up again, looks it up right away, so that a read following a finished data move costs one
+// proxy request.  Only if the proxies still report the same servers (because the move is not yet visible to them, or the
+// failed server is the only one left) does it wait, to avoid a fast spin.
+ACTOR Future<Void> relocateAfterWrongShard( Database cx, Key key, Reference<LocationInfo> location, TransactionInfo info, bool isBackward = false ) {
+	cx->invalidateCache( key, isBackward );
+	if( CLIENT_KNOBS->WRONG_SHARD_SERVER_RELOCATE ) {
+		pair<KeyRange, Reference<LocationInfo>> ssi = wait( getKeyLocation( cx, key, info, isBackward ) );
+		if( ssi.second != location ) {
+			TEST( true ); // Shard location changed after wrong_shard_server
+			return Void();
+		}
+	}
+	Void _ = wait(delay(CLIENT_KNOBS->WRONG_SHARD_SERVER_DELAY, info.taskID));
+	return Void();
+}
+
 ACTOR Future< vector< pair<KeyRange,Reference<LocationInfo>> > > getKeyRangeLocations( Database cx, KeyRange keys, int limit, bool reverse, TransactionInfo info ) {
 	if( info.debugID.present() )
 		g_traceBatch.addEvent("TransactionDebug", info.debugID.get().first(), "NativeAPI.getKeyLocations.Before");
@@ -1143,6 +1329,55 @@ Future<Void> Transaction::warmRange(Database cx, KeyRange keys) {
 	return warmRange_impl(this, cx, keys);
 }
 
+ACTOR Future< Standalone<VectorRef<KeyRef>> > getShardBoundaries( Database cx, KeyRange keys, TransactionInfo info ) {
+	state Standalone<VectorRef<KeyRef>> boundaries;
+	boundaries.push_back_deep( boundaries.arena(), keys.begin );
+	loop {
+		vector<pair<KeyRange, Reference<LocationInfo>>> locations = wait(getKeyRangeLocations(cx, keys, CLIENT_KNOBS->WARM_RANGE_SHARD_LIMIT, false, info));
+		for(auto& l : locations)
+			boundaries.push_back_deep( boundaries.arena(), l.first.end );
+		if(locations.size() == 0 || locations[locations.size()-1].first.end >= keys.end)
+			break;
+
+		keys = KeyRangeRef(locations[locations.size()-1].first.end, keys.end);
+	}
+	if( boundaries.back() != keys.end )
+		boundaries.push_back_deep( boundaries.arena(), keys.end );
+	return boundaries;
+}
+
+Future< Standalone<VectorRef<KeyRef>> > Transaction::getShardBoundaries( KeyRange const& keys ) {
+	return ::getShardBoundaries( cx, keys, info );
+}
+
+ACTOR static Future<Void> locationPrefetchActor( DatabaseContext* cx ) {
+	state Transaction tr;
+	state int i;
+
+	loop {
+		try {
+			// tr holds a reference to cx, so it is destroyed before waiting for the proxies to change to let the actor be
+			// cleaned up if the database is destroyed by the user in the meantime.
+			tr = Transaction(Database(Reference<DatabaseContext>::addRef(cx)));
+			for(i = 0; i < cx->locationPrefetchRanges.size(); i++) {
+				Void _ = wait( tr.warmRange( tr.getDatabase(), cx->locationPrefetchRanges[i] ) );
+			}
+			TraceEvent("LocationCachePrefetched").detail("Ranges", cx->locationPrefetchRanges.size()).detail("Entries", cx->locationCache.size());
+		} catch( Error &e ) {
+			if( e.code() == error_code_actor_cancelled )
+				throw;
+			TraceEvent(SevWarn, "LocationCachePrefetchError").error(e);
+		}
+		tr = Transaction();
+		Void _ = wait( cx->onMasterProxiesChanged() );
+	}
+}
+
+void DatabaseContext::prefetchLocations( KeyRange const& keys ) {
+	locationPrefetchRanges.push_back( keys );
+	locationPrefetcher = locationPrefetchActor( this );
+}
+
 ACTOR Future<Optional<Value>> getValue( Future<Version> version, Key key, Database cx, TransactionInfo info, Reference<TransactionLogInfo> trLogInfo )
 {
 	state Version ver = wait( version );
@@ -1206,8 +1441,7 @@ ACTOR Future<Optional<Value>> getValue( Future<Version> version, Key key, Databa
 			}
 			if (e.code() == error_code_wrong_shard_server || e.code() == error_code_all_alternatives_failed ||
 				(e.code() == error_code_transaction_too_old && ver == latestVersion) ) {
-				cx->invalidateCache( key );
-				Void _ = wait(delay(CLIENT_KNOBS->WRONG_SHARD_SERVER_DELAY, info.taskID));
+				Void _ = wait( relocateAfterWrongShard( cx, key, ssi.second, info ) );
 			} else {
 				if (trLogInfo)
 					trLogInfo->addLog(FdbClientLogEvents::EventGetError(startTimeD, static_cast<int>(e.code()), key));
@@ -1217,6 +1451,148 @@ ACTOR Future<Optional<Value>> getValue( Future<Version> version, Key key, Databa
 	}
 }
 
+// Reads keys, which are all in shards on the storage team location, with one request.  If the team cannot serve the
+// request (because the shards have moved or an interface predates getValues) the keys are read individually instead.
+ACTOR Future<vector<Optional<Value>>> getValuesFromTeam( Version ver, vector<Key> keys, Reference<LocationInfo> location, Database cx, TransactionInfo info, Reference<TransactionLogInfo> trLogInfo )
+{
+	state bool supported = true;
+	for(int i = 0; i < location->size(); i++)
+		if( !location->get(i, &StorageServerInterface::getValues).getEndpoint().isValid() )
+			supported = false;
+
+	if( supported ) {
+		state bool wrongShard = false;
+		try {
+			GetValuesRequest req;
+			for(auto& k : keys)
+				req.keys.push_back_deep( req.arena, k );
+			req.version = ver;
+
+			++cx->getValueSubmitted;
+			++cx->transactionPhysicalReads;
+			state uint64_t startTime = timer_int();
+			state double startTimeD = now();
+			GetValuesReply reply = wait( loadBalance( location, &StorageServerInterface::getValues, req, TaskDefaultPromiseEndpoint, false, cx->enableLocalityLoadBalance ? &cx->queueModel : NULL ) );
+			cx->readLatencies.addSample(now() - startTimeD);
+			cx->getValueCompleted->latency = timer_int() - startTime;
+			cx->getValueCompleted->log();
+
+			ASSERT( reply.values.size() == keys.size() );
+			vector<Optional<Value>> results;
+			results.reserve( keys.size() );
+			for(auto& v : reply.values)
+				results.push_back( v.present() ? Optional<Value>( Value(v.get(), reply.arena) ) : Optional<Value>() );
+			return results;
+		} catch (Error& e) {
+			if (e.code() == error_code_wrong_shard_server || e.code() == error_code_all_alternatives_failed ||
+				(e.code() == error_code_transaction_too_old && ver == latestVersion) ) {
+				for(auto& k : keys)
+					cx->invalidateCache( k );
+				wrongShard = true;
+			} else {
+				throw e;
+			}
+		}
+		if( wrongShard )
+			Void _ = wait(delay(CLIENT_KNOBS->WRONG_SHARD_SERVER_DELAY, info.taskID));
+	}
+
+	state vector<Future<Optional<Value>>> values;
+	for(auto& k : keys)
+		values.push_back( getValue( ver, k, cx, info, trLogInfo ) );
+	vector<Optional<Value>> results = wait( getAll( values ) );
+	return results;
+}
+
+// Reads keys with one request for each storage team that holds some of them (at most GET_VALUES_BATCH_LIMIT keys each)
+ACTOR Future<vector<Optional<Value>>> getValues( Future<Version> version, vector<Key> keys, Database cx, TransactionInfo info, Reference<TransactionLogInfo> trLogInfo )
+{
+	state Version ver = wait( version );
+	validateVersion(ver);
+
+	state vector<int> order;
+	for(int k = 0; k < keys.size(); k++)
+		if( keys[k].size() <= (keys[k].startsWith(systemKeys.begin) ? CLIENT_KNOBS->SYSTEM_KEY_SIZE_LIMIT : CLIENT_KNOBS->KEY_SIZE_LIMIT) )
+			order.push_back(k);
+	vector<Key> const& sortKeys = keys;
+	std::sort( order.begin(), order.end(), [&sortKeys](int a, int b) { return sortKeys[a] < sortKeys[b]; } );
+
+	// Group the keys by storage team; since they are sorted, consecutive keys usually share a location
+	state vector<Reference<LocationInfo>> teams;
+	state vector<vector<int>> batches;
+	state std::map<LocationInfo*, int> openBatch;
+	state pair<KeyRange, Reference<LocationInfo>> ssi;
+	state int o = 0;
+	for(; o < order.size(); o++) {
+		state Key key = keys[ order[o] ];
+		if( !ssi.second || !ssi.first.contains(key) ) {
+			ssi = getCachedKeyLocation(cx, key, &StorageServerInterface::getValue);
+			if (!ssi.second) {
+				pair<KeyRange, Reference<LocationInfo>> ssi2 = wait( getKeyLocation( cx, key, info ) );
+				ssi = std::move(ssi2);
+			}
+		}
+		auto b = openBatch.find( ssi.second.getPtr() );
+		if( b == openBatch.end() || batches[b->second].size() >= CLIENT_KNOBS->GET_VALUES_BATCH_LIMIT ) {
+			openBatch[ ssi.second.getPtr() ] = batches.size();
+			teams.push_back( ssi.second );
+			batches.push_back( vector<int>() );
+			b = openBatch.find( ssi.second.getPtr() );
+		}
+		batches[b->second].push_back( order[o] );
+	}
+
+	state vector<Future<vector<Optional<Value>>>> replies;
+	for(int b = 0; b < batches.size(); b++) {
+		vector<Key> batchKeys;
+		for(int k : batches[b])
+			batchKeys.push_back( keys[k] );
+		replies.push_back( getValuesFromTeam( ver, batchKeys, teams[b], cx, info, trLogInfo ) );
+	}
+	Void _ = wait( waitForAll( replies ) );
+
+	vector<Optional<Value>> results( keys.size() );
+	for(int b = 0; b < batches.size(); b++)
+		for(int k = 0; k < batches[b].size(); k++)
+			results[ batches[b][k] ] = replies[b].get()[k];
+	return results;
+}
+
+// Reads key, which is under the read_cache_prefix prefix, from the database's read cache if the prefix's stamp at the
+// transaction's read version is the one the cached value was read with
+ACTOR Future<Optional<Value>> getCachedValue( Future<Version> version, Key key, Key prefix, Future<Optional<Value>> stampFuture, Database cx, TransactionInfo info, Reference<TransactionLogInfo> trLogInfo )
+{
+	state Optional<Value> stamp = wait( stampFuture );
+	{
+		auto& cache = cx->readCaches[prefix];
+		if( cache.stamp != stamp ) {
+			// Transactions at older read versions may also see an older stamp, and start the cache over in the same way
+			TEST( true ); // Read cache prefix changed
+			cache.stamp = stamp;
+			cache.values.clear();
+		}
+		auto v = cache.values.find( key );
+		if( v != cache.values.end() ) {
+			++cx->readCacheHits;
+			return v->second;
+		}
+	}
+
+	++cx->readCacheMisses;
+	Optional<Value> value = wait( getValue( version, key, cx, info, trLogInfo ) );
+	auto& cache = cx->readCaches[prefix];
+	if( cache.stamp == stamp ) {
+		if( cache.values.size() >= CLIENT_KNOBS->READ_CACHE_MAX_ENTRIES ) {
+			TEST( true ); // Read cache full
+			auto evict = cache.values.upper_bound( key );
+			cache.values.erase( evict != cache.values.end() ? evict : cache.values.begin() );
+		}
+		if( cache.values.size() < CLIENT_KNOBS->READ_CACHE_MAX_ENTRIES )
+			cache.values[key] = value;
+	}
+	return value;
+}
+
 ACTOR Future<Key> getKey( Database cx, KeySelector k, Future<Version> version, TransactionInfo info ) {
 	Version ver = wait(version);
 
@@ -1252,9 +1628,7 @@ ACTOR Future<Key> getKey( Database cx, KeySelector k, Future<Version> version, T
 			}
 		} catch (Error& e) {
 			if (e.code() == error_code_wrong_shard_server || e.code() == error_code_all_alternatives_failed) {
-				cx->invalidateCache(k.getKey(), k.isBackward());
-
-				Void _ = wait(delay(CLIENT_KNOBS->WRONG_SHARD_SERVER_DELAY, info.taskID));
+				Void _ = wait( relocateAfterWrongShard( cx, k.getKey(), ssi.second, info, k.isBackward() ) );
 			} else {
 				if(e.code() != error_code_actor_cancelled) {
 					TraceEvent(SevInfo, "getKeyError")
@@ -1273,7 +1647,7 @@ ACTOR Future<Version> waitForCommittedVersion( Database cx, Version version ) {
 		loop {
 			choose {
 				when ( Void _ = wait( cx->onMasterProxiesChanged() ) ) {}
-				when ( GetReadVersionReply v = wait( loadBalance( cx->getMasterProxies(), &MasterProxyInterface::getConsistentReadVersion, GetReadVersionRequest( 0, GetReadVersionRequest::PRIORITY_SYSTEM_IMMEDIATE ), cx->taskID ) ) ) {
+				when ( GetReadVersionReply v = wait( loadBalance( cx->getGrvProxies(), &MasterProxyInterface::getConsistentReadVersion, GetReadVersionRequest( 0, GetReadVersionRequest::PRIORITY_SYSTEM_IMMEDIATE ), cx->taskID ) ) ) {
 					if (v.version >= version)
 						return v.version;
 					// SOMEDAY: Do the wait on the server side, possibly use less expensive source of committed version (causal consistency is not needed for this purpose)
@@ -1287,7 +1661,7 @@ ACTOR Future<Version> waitForCommittedVersion( Database cx, Version version ) {
 	}
 }
 
-Future<Void> readVersionBatcher( DatabaseContext* const& cx, FutureStream< std::pair< Promise<GetReadVersionReply>, Optional<UID> > > const& versionStream, uint32_t const& flags );
+Future<Void> readVersionBatcher( DatabaseContext* const& cx, FutureStream< std::pair< Promise<GetReadVersionReply>, Optional<UID> > > const& versionStream, uint32_t const& flags, Key const& tag );
 
 ACTOR Future< Void > watchValue( Future<Version> version, Key key, Optional<Value> value, Database cx, int readVersionFlags, TransactionInfo info )
 {
@@ -1326,8 +1700,7 @@ ACTOR Future< Void > watchValue( Future<Version> version, Key key, Optional<Valu
 			ver = v;
 		} catch (Error& e) {
 			if (e.code() == error_code_wrong_shard_server || e.code() == error_code_all_alternatives_failed) {
-				cx->invalidateCache( key );
-				Void _ = wait(delay(CLIENT_KNOBS->WRONG_SHARD_SERVER_DELAY, info.taskID));
+				Void _ = wait( relocateAfterWrongShard( cx, key, ssi.second, info ) );
 			} else if( e.code() == error_code_watch_cancelled ) {
 				TEST( true ); // Too many watches on the storage server, poll for changes instead
 				Void _ = wait(delay(CLIENT_KNOBS->WATCH_POLLING_TIME, info.taskID));
@@ -1343,6 +1716,23 @@ ACTOR Future< Void > watchValue( Future<Version> version, Key key, Optional<Valu
 	}
 }
 
+// Watches key for a change from value like watchValue(), but shares the storage server watch of another transaction's
+// watch on the same key and value that has not fired yet.  The shared watch may be from an earlier or later version,
+// which can only matter if the value changes and changes back, when a watch may or may not fire anyway.
+Future<Void> sharedWatchValue( Future<Version> version, Key key, Optional<Value> value, Database cx, int readVersionFlags, TransactionInfo info ) {
+	auto it = cx->watchMap.find( std::make_pair( key, value ) );
+	if( it == cx->watchMap.end() )
+		return watchValue( version, key, value, cx, readVersionFlags, info );  // The watch was cancelled
+
+	WatchMetadata* metadata = it->second;
+	if( metadata->watchFuture.isValid() && !metadata->watchFuture.isReady() ) {
+		TEST( true ); // Watch shares the storage server watch of another transaction
+		return metadata->watchFuture;
+	}
+	metadata->watchFuture = watchValue( version, key, value, cx, readVersionFlags, info );
+	return metadata->watchFuture;
+}
+
 void transformRangeLimits(GetRangeLimits limits, bool reverse, GetKeyValuesRequest &req) {
 	if(limits.bytes != 0) {
 		if(!limits.hasRowLimit())
@@ -1362,6 +1752,7 @@ void transformRangeLimits(GetRangeLimits limits, bool reverse, GetKeyValuesReque
 		req.limitBytes = CLIENT_KNOBS->REPLY_BYTE_LIMIT;
 		req.limit = reverse ? -limits.minRows : limits.minRows;
 	}
+	req.maxValueLength = limits.valueBytes;
 }
 
 ACTOR Future<Standalone<RangeResultRef>> getExactRange( Database cx, Version version,
@@ -1600,6 +1991,74 @@ void getRangeFinished(Reference<TransactionLogInfo> trLogInfo, double startTime,
 	}
 }
 
+// The number of shards a range read may fetch concurrently, given its limits. Only reads without a row limit whose
+// byte limit exceeds a single reply can use more than one.
+int rangePrefetchWindow( GetRangeLimits limits ) {
+	if( limits.hasRowLimit() )
+		return 1;
+	int budget = limits.hasByteLimit() ? std::min( limits.bytes, CLIENT_KNOBS->RANGE_PREFETCH_BYTES ) : CLIENT_KNOBS->RANGE_PREFETCH_BYTES;
+	return std::max( 1, std::min( CLIENT_KNOBS->RANGE_PREFETCH_SHARD_LIMIT, budget / CLIENT_KNOBS->REPLY_BYTE_LIMIT ) );
+}
+
+// Reads keys by keeping requests to the next several shards in flight at once, and assembles the replies in key order
+// (descending if reverse). Each shard is read with getExactRange, which handles shard movement on its own.
+ACTOR Future<Standalone<RangeResultRef>> getRangeParallel( Database cx, Version version, KeyRange keys, GetRangeLimits limits,
+	bool reverse, TransactionInfo info )
+{
+	state Standalone<RangeResultRef> output;
+	state std::deque<std::pair<KeyRange, Future<Standalone<RangeResultRef>>>> fetches;
+	state KeyRange unfetched = keys;
+	state int window = rangePrefetchWindow( limits );
+	state GetRangeLimits shardLimits( GetRangeLimits::ROW_LIMIT_UNLIMITED, CLIENT_KNOBS->REPLY_BYTE_LIMIT );
+
+	TEST(true); // Parallel range prefetch
+	loop {
+		while( fetches.size() < window && !unfetched.empty() ) {
+			state vector< pair<KeyRange, Reference<LocationInfo>> > locations = getCachedKeyRangeLocations( cx, unfetched, window - fetches.size(), reverse, &StorageServerInterface::getKeyValues );
+			if( !locations.size() ) {
+				vector< pair<KeyRange, Reference<LocationInfo>> > _locations = wait( getKeyRangeLocations( cx, unfetched, window - fetches.size(), reverse, info ) );
+				locations = std::move(_locations);
+			}
+
+			for( auto& location : locations ) {
+				KeyRange range = location.first & unfetched;
+				if( range.empty() )
+					continue;
+				fetches.push_back( std::make_pair( range, getExactRange( cx, version, range, shardLimits, reverse, info ) ) );
+				unfetched = reverse ? KeyRange( KeyRangeRef( unfetched.begin, range.begin ) ) : KeyRange( KeyRangeRef( range.end, unfetched.end ) );
+				if( unfetched.empty() )
+					break;
+			}
+		}
+
+		if( fetches.empty() ) {
+			output.more = false;
+			return output;
+		}
+
+		state KeyRange range = fetches.front().first;
+		Standalone<RangeResultRef> rep = wait( fetches.front().second );
+		fetches.pop_front();
+
+		output.arena().dependsOn( rep.arena() );
+		output.append( output.arena(), rep.begin(), rep.size() );
+		limits.decrement( rep );
+
+		if( rep.more ) {
+			// Everything behind this shard is already in flight, so continue reading the rest of it ahead of them
+			ASSERT( rep.size() );
+			KeyRange rest = reverse ? KeyRange( KeyRangeRef( range.begin, rep.end()[-1].key ) ) : KeyRange( KeyRangeRef( keyAfter( rep.end()[-1].key ), range.end ) );
+			if( !rest.empty() )
+				fetches.push_front( std::make_pair( rest, getExactRange( cx, version, rest, shardLimits, reverse, info ) ) );
+		}
+
+		if( limits.isReached() ) {
+			output.more = !fetches.empty() || !unfetched.empty();
+			return output;
+		}
+	}
+}
+
 ACTOR Future<Standalone<RangeResultRef>> getRange( Database cx, Reference<TransactionLogInfo> trLogInfo, Future<Version> fVersion,
 	KeySelector begin, KeySelector end, GetRangeLimits limits, Promise<std::pair<Key, Key>> conflictRange, bool snapshot, bool reverse, 
 	TransactionInfo info )
@@ -1625,6 +2084,17 @@ ACTOR Future<Standalone<RangeResultRef>> getRange( Database cx, Reference<Transa
 		ASSERT( !limits.isReached() );
 		ASSERT( (!limits.hasRowLimit() || limits.rows >= limits.minRows) && limits.minRows >= 0 );
 
+		if( readVersion != latestVersion && begin.isFirstGreaterOrEqual() && end.isFirstGreaterOrEqual() && begin.getKey() < end.getKey() &&
+			end.getKey() <= allKeys.end && rangePrefetchWindow( limits ) > 1 )
+		{
+			Standalone<RangeResultRef> result = wait( getRangeParallel( cx, readVersion, KeyRangeRef( begin.getKey(), end.getKey() ), limits, reverse, info ) );
+			bool readToBegin = output.readToBegin;
+			output = result;
+			output.readToBegin = readToBegin;
+			getRangeFinished(trLogInfo, startTime, originalBegin, originalEnd, snapshot, conflictRange, reverse, output);
+			return output;
+		}
+
 		loop {
 			if( end.getKey() == allKeys.begin && (end.offset < 1 || end.isFirstGreaterOrEqual()) ) {
 				getRangeFinished(trLogInfo, startTime, originalBegin, originalEnd, snapshot, conflictRange, reverse, output);
@@ -1779,15 +2249,14 @@ ACTOR Future<Standalone<RangeResultRef>> getRange( Database cx, Reference<Transa
 				if (e.code() == error_code_wrong_shard_server || e.code() == error_code_all_alternatives_failed ||
 					(e.code() == error_code_transaction_too_old && readVersion == latestVersion))
 				{
-					cx->invalidateCache( reverse ? end.getKey() : begin.getKey(), reverse ? (end-1).isBackward() : begin.isBackward() );
-
 					if (e.code() == error_code_wrong_shard_server) {
+						cx->invalidateCache( reverse ? end.getKey() : begin.getKey(), reverse ? (end-1).isBackward() : begin.isBackward() );
 						Standalone<RangeResultRef> result = wait( getRangeFallback(cx, version, originalBegin, originalEnd, originalLimits, reverse, info ) );
 						getRangeFinished(trLogInfo, startTime, originalBegin, originalEnd, snapshot, conflictRange, reverse, result);
 						return result;
 					}
 
-					Void _ = wait(delay(CLIENT_KNOBS->WRONG_SHARD_SERVER_DELAY, info.taskID));
+					Void _ = wait( relocateAfterWrongShard( cx, reverse ? end.getKey() : begin.getKey(), beginServer.second, info, reverse ? (end-1).isBackward() : begin.isBackward() ) );
 				} else {
 					if (trLogInfo)
 						trLogInfo->addLog(FdbClientLogEvents::EventGetRangeError(startTime, static_cast<int>(e.code()), begin.getKey(), end.getKey()));
@@ -1830,10 +2299,12 @@ void Transaction::operator=(Transaction&& r) noexcept(true) {
 	cx = std::move(r.cx);
 	tr = std::move(r.tr);
 	readVersion = std::move(r.readVersion);
+	readCacheStamps = std::move(r.readCacheStamps);
 	extraConflictRanges = std::move(r.extraConflictRanges);
 	commitResult = std::move(r.commitResult);
 	committing = std::move(r.committing);
 	options = std::move(r.options);
+	tag = std::move(r.tag);
 	info = r.info;
 	backoff = r.backoff;
 	numErrors = r.numErrors;
@@ -1876,9 +2347,34 @@ Future<Optional<Value>> Transaction::get( const Key& key, bool snapshot ) {
 	if( !snapshot )
 		tr.transaction.read_conflict_ranges.push_back(tr.arena, singleKeyRange(key, tr.arena));
 
+	if( cx->readCaches.size() ) {
+		Optional<Key> prefix = cx->readCachePrefix( key );
+		if( prefix.present() ) {
+			auto stamp = readCacheStamps.find( prefix.get() );
+			if( stamp == readCacheStamps.end() )
+				stamp = readCacheStamps.insert( std::make_pair( prefix.get(), getValue( ver, prefix.get(), cx, info, trLogInfo ) ) ).first;
+			return getCachedValue( ver, key, prefix.get(), stamp->second, cx, info, trLogInfo );
+		}
+	}
+
 	return getValue( ver, key, cx, info, trLogInfo );
 }
 
+Future<vector<Optional<Value>>> Transaction::getMulti( vector<Key> const& keys, bool snapshot ) {
+	cx->transactionLogicalReads += keys.size();
+
+	auto ver = getReadVersion();
+
+	if( !snapshot ) {
+		for(auto& key : keys) {
+			if(key.size() <= (key.startsWith(systemKeys.begin) ? CLIENT_KNOBS->SYSTEM_KEY_SIZE_LIMIT : CLIENT_KNOBS->KEY_SIZE_LIMIT))
+				tr.transaction.read_conflict_ranges.push_back(tr.arena, singleKeyRange(key, tr.arena));
+		}
+	}
+
+	return getValues( ver, keys, cx, info, trLogInfo );
+}
+
 void Watch::setWatch(Future<Void> watchFuture) {
 	this->watchFuture = watchFuture;
 
@@ -1888,29 +2384,23 @@ void Watch::setWatch(Future<Void> watchFuture) {
 
 //FIXME: This seems pretty horrible. Now a Database can't die until all of its watches do...
 ACTOR Future<Void> watch( Reference<Watch> watch, Database cx, Transaction *self ) {
-	cx->addWatch();
-	try {
-		self->watches.push_back(watch);
+	// Counts towards the watches of the database unless another watch has the same key and value
+	state Reference<WatchMetadata> metadata = cx->getWatchMetadata( watch->key, watch->value );
+	self->watches.push_back(watch);
 
-		choose {
-			// RYOW write to value that is being watched (if applicable)
-			// Errors
-			when(Void _ = wait(watch->onChangeTrigger.getFuture())) { }
+	choose {
+		// RYOW write to value that is being watched (if applicable)
+		// Errors
+		when(Void _ = wait(watch->onChangeTrigger.getFuture())) { }
 
-			// NativeAPI finished commit and updated watchFuture
-			when(Void _ = wait(watch->onSetWatchTrigger.getFuture())) {
+		// NativeAPI finished commit and updated watchFuture
+		when(Void _ = wait(watch->onSetWatchTrigger.getFuture())) {
 
-				// NativeAPI watchValue future finishes or errors
-				Void _ = wait(watch->watchFuture);
-			}
+			// NativeAPI watchValue future finishes or errors
+			Void _ = wait(watch->watchFuture);
 		}
 	}
-	catch(Error &e) {
-		cx->removeWatch();
-		throw;
-	}
 
-	cx->removeWatch();
 	return Void();
 }
 
@@ -2032,6 +2522,156 @@ Future< Standalone<RangeResultRef> > Transaction::getRange(
 	return getRange( begin, end, GetRangeLimits( limit ), snapshot, reverse );
 }
 
+// Reads keys one shard at a time with GetKeyValuesStreamRequests, keeping RANGE_STREAM_WINDOW batches of each shard
+// requested so that the storage server reads ahead of the results being sent to the client.  Ends results with
+// end_of_stream.  If a storage team cannot serve a stream the remaining keys are read with getRange instead.
+ACTOR Future<Void> getRangeStream( PromiseStream<Standalone<RangeResultRef>> results, Database cx, Reference<TransactionLogInfo> trLogInfo, Future<Version> fVersion, KeyRange keys, TransactionInfo info )
+{
+	state Version version;
+	try {
+		Version _version = wait( fVersion );
+		version = _version;
+		validateVersion(version);
+
+		loop {
+			if( keys.empty() ) {
+				results.sendError( end_of_stream() );
+				return Void();
+			}
+
+			state pair<KeyRange, Reference<LocationInfo>> shard;
+			vector<pair<KeyRange, Reference<LocationInfo>>> locations = wait( getKeyRangeLocations( cx, keys, 1, false, info ) );
+			shard = locations[0];
+
+			// Streams are served by a single storage server; prefer one of the closest
+			state int server = g_random->randomInt( 0, std::max( shard.second->countBest(), 1 ) );
+			state RequestStream<GetKeyValuesStreamRequest> stream = shard.second->get( server, &StorageServerInterface::getKeyValuesStream );
+			if( !stream.getEndpoint().isValid() ) {
+				TEST(true); // Range stream from a storage server which does not support it
+				Standalone<RangeResultRef> rest = wait( getRange( cx, trLogInfo, version, firstGreaterOrEqual(keys.begin), firstGreaterOrEqual(keys.end), GetRangeLimits(), Promise<std::pair<Key, Key>>(), true, false, info ) );
+				if( rest.size() )
+					results.send( rest );
+				results.sendError( end_of_stream() );
+				return Void();
+			}
+
+			state UID streamID = g_random->randomUniqueID();
+			state int sequence = 0;
+			state Deque<Future<ErrorOr<GetKeyValuesReply>>> batches;
+			state bool retry = false;
+			++cx->transactionPhysicalReads;
+			try {
+				loop {
+					while( batches.size() < CLIENT_KNOBS->RANGE_STREAM_WINDOW ) {
+						GetKeyValuesStreamRequest req;
+						req.streamID = streamID;
+						req.sequence = sequence++;
+						req.keys = KeyRangeRef( req.arena, shard.first );
+						req.version = version;
+						req.limit = CLIENT_KNOBS->REPLY_BYTE_LIMIT;
+						req.limitBytes = CLIENT_KNOBS->REPLY_BYTE_LIMIT;
+						req.debugID = info.debugID;
+						batches.push_back( stream.getReplyUnlessFailedFor( req, 0, 0 ) );
+					}
+
+					ErrorOr<GetKeyValuesReply> rep = wait( batches.front() );
+					batches.pop_front();
+					if( rep.isError() )
+						throw rep.getError();
+
+					GetKeyValuesReply const& r = rep.get();
+					if( r.data.size() ) {
+						keys = KeyRangeRef( keyAfter( r.data.end()[-1].key ), keys.end );
+						results.send( Standalone<RangeResultRef>( RangeResultRef( r.data, r.more ), r.arena ) );
+					}
+					if( !r.more )
+						break;
+				}
+				keys = KeyRangeRef( shard.first.end, keys.end );
+			} catch( Error& e ) {
+				// timed_out means that the storage server forgot the stream; restart from the last key received
+				if( e.code() == error_code_wrong_shard_server || e.code() == error_code_request_maybe_delivered ||
+					e.code() == error_code_timed_out || (e.code() == error_code_transaction_too_old && version == latestVersion) ) {
+					cx->invalidateCache( keys.begin );
+					retry = true;
+				} else {
+					throw;
+				}
+			}
+			batches.clear();
+			if( retry )
+				Void _ = wait( delay( CLIENT_KNOBS->WRONG_SHARD_SERVER_DELAY, info.taskID ) );
+		}
+	} catch( Error& e ) {
+		if( e.code() == error_code_actor_cancelled )
+			throw;
+		results.sendError( e );
+		return Void();
+	}
+}
+
+// Aggregates keys one shard at a time with GetRangeAggregateRequests.  The shards of storage servers which cannot
+// aggregate are read with getRange and aggregated here instead.
+ACTOR Future<GetRangeAggregateReply> getRangeAggregate( Database cx, Reference<TransactionLogInfo> trLogInfo, Future<Version> fVersion, KeyRange keys, TransactionInfo info )
+{
+	state Version version = wait( fVersion );
+	validateVersion(version);
+
+	state GetRangeAggregateReply total;
+	total.end = keys.end;
+	loop {
+		if( keys.empty() )
+			return total;
+
+		state pair<KeyRange, Reference<LocationInfo>> shard;
+		vector<pair<KeyRange, Reference<LocationInfo>>> locations = wait( getKeyRangeLocations( cx, keys, 1, false, info ) );
+		shard = locations[0];
+
+		if( !shard.second->get( 0, &StorageServerInterface::getRangeAggregate ).getEndpoint().isValid() ) {
+			TEST(true); // Range aggregate from a storage server which does not support it
+			Standalone<RangeResultRef> rest = wait( getRange( cx, trLogInfo, version, firstGreaterOrEqual(shard.first.begin), firstGreaterOrEqual(shard.first.end), GetRangeLimits(), Promise<std::pair<Key, Key>>(), true, false, info ) );
+			for( auto& kv : rest )
+				total.add( kv );
+			keys = KeyRangeRef( shard.first.end, keys.end );
+			continue;
+		}
+
+		try {
+			++cx->transactionPhysicalReads;
+			GetRangeAggregateReply rep = wait( loadBalance( shard.second, &StorageServerInterface::getRangeAggregate, GetRangeAggregateRequest( shard.first, version ), TaskDefaultPromiseEndpoint, false, cx->enableLocalityLoadBalance ? &cx->queueModel : NULL ) );
+			total.add( rep );
+			keys = KeyRangeRef( rep.end, keys.end );
+		} catch( Error& e ) {
+			if( e.code() == error_code_wrong_shard_server || e.code() == error_code_all_alternatives_failed ) {
+				cx->invalidateCache( keys.begin );
+				Void _ = wait( delay( CLIENT_KNOBS->WRONG_SHARD_SERVER_DELAY, info.taskID ) );
+			} else {
+				throw;
+			}
+		}
+	}
+}
+
+Future<GetRangeAggregateReply> Transaction::getRangeAggregate( KeyRange const& keys, bool snapshot ) {
+	++cx->transactionLogicalReads;
+
+	KeyRange r = keys & allKeys;
+	if( !snapshot && !keys.empty() )
+		addReadConflictRange( keys );
+
+	return ::getRangeAggregate( cx, trLogInfo, getReadVersion(), r, info );
+}
+
+Future<Void> Transaction::getRangeStream( PromiseStream<Standalone<RangeResultRef>> const& results, KeyRange const& keys, bool snapshot ) {
+	++cx->transactionLogicalReads;
+
+	KeyRange r = keys & allKeys;
+	if( !snapshot && !keys.empty() )
+		addReadConflictRange( keys );
+
+	return ::getRangeStream( results, cx, trLogInfo, getReadVersion(), r, info );
+}
+
 void Transaction::addReadConflictRange( KeyRangeRef const& keys ) {
 	ASSERT( !keys.empty() );
 
@@ -2178,6 +2818,7 @@ double Transaction::getBackoff() {
 void Transaction::reset() {
 	tr = CommitTransactionRequest();
 	readVersion = Future<Version>();
+	readCacheStamps.clear();
 	extraConflictRanges.clear();
 	versionstampPromise = Promise<Standalone<StringRef>>();
 	commitResult = Promise<Void>();
@@ -2350,7 +2991,7 @@ void Transaction::setupWatches() {
 		Future<Version> watchVersion = getCommittedVersion() > 0 ? getCommittedVersion() : getReadVersion();
 
 		for(int i = 0; i < watches.size(); ++i)
-			watches[i]->setWatch(watchValue( watchVersion, watches[i]->key, watches[i]->value, cx, options.getReadVersionFlags, info ));
+			watches[i]->setWatch(sharedWatchValue( watchVersion, watches[i]->key, watches[i]->value, cx, options.getReadVersionFlags, info ));
 
 		watches.clear();
 	}
@@ -2369,6 +3010,8 @@ ACTOR static Future<Void> tryCommit( Database cx, Reference<TransactionLogInfo>
 	try {
 		Version v = wait( readVersion );
 		req.transaction.read_snapshot = v;
+		if( CLIENT_KNOBS->COMMIT_PACKING )
+			req.packTransaction( CLIENT_KNOBS->COMMIT_COMPRESSION_MIN_BYTES, CLIENT_KNOBS->COMMIT_COMPRESSION_LEVEL );
 
 		startTime = now();
 		state Optional<UID> commitID = Optional<UID>();
@@ -2478,6 +3121,12 @@ Future<Void> Transaction::commitMutations() {
 		cx->mutationsPerCommit.addSample(tr.transaction.mutations.size());
 		cx->bytesPerCommit.addSample(tr.transaction.mutations.expectedSize());
 
+		if( options.compactConflictRanges ) {
+			int conflictRanges = tr.transaction.read_conflict_ranges.size() + tr.transaction.write_conflict_ranges.size();
+			tr.transaction.compactConflictRanges( tr.arena, options.maxConflictRanges );
+			TEST( tr.transaction.read_conflict_ranges.size() + tr.transaction.write_conflict_ranges.size() < conflictRanges ); // Conflict ranges compacted before commit
+		}
+
 		size_t transactionSize = tr.transaction.mutations.expectedSize() + tr.transaction.read_conflict_ranges.expectedSize() + tr.transaction.write_conflict_ranges.expectedSize();
 		if (transactionSize > (uint64_t)FLOW_KNOBS->PACKET_WARNING) {
 			TraceEvent(!g_network->isSimulated() ? SevWarnAlways : SevWarn, "LargeTransaction")
@@ -2593,6 +3242,12 @@ void Transaction::setOption( FDBTransactionOptions::Option option, Optional<Stri
 			options.getReadVersionFlags |= GetReadVersionRequest::FLAG_CAUSAL_READ_RISKY;
 			break;
 
+		case FDBTransactionOptions::CAUSAL_READ_GOSSIPED:
+			validateOptionValue(value, false);
+			// Proxies that do not know FLAG_USE_GOSSIPED_VERSION still treat the request as causal read risky
+			options.getReadVersionFlags |= GetReadVersionRequest::FLAG_CAUSAL_READ_RISKY | GetReadVersionRequest::FLAG_USE_GOSSIPED_VERSION;
+			break;
+
 		case FDBTransactionOptions::PRIORITY_SYSTEM_IMMEDIATE:
 			validateOptionValue(value, false);
 			setPriority(GetReadVersionRequest::PRIORITY_SYSTEM_IMMEDIATE);
@@ -2669,20 +3324,39 @@ void Transaction::setOption( FDBTransactionOptions::Option option, Optional<Stri
 			options.firstInBatch = true;
 			break;
 
+		case FDBTransactionOptions::TAG:
+			validateOptionValue(value, true);
+			if(value.get().size() > CLIENT_KNOBS->MAX_TRANSACTION_TAG_LENGTH) {
+				throw invalid_option_value();
+			}
+			tag = value.get();
+			break;
+
+		case FDBTransactionOptions::COMPACT_CONFLICT_RANGES:
+			validateOptionValue(value, true);
+			options.maxConflictRanges = extractIntOption(value, 0, std::numeric_limits<int>::max());
+			options.compactConflictRanges = true;
+			break;
+
+		case FDBTransactionOptions::MAX_READ_VERSION_STALENESS:
+			validateOptionValue(value, true);
+			options.maxReadVersionStaleness = extractIntOption(value, 0, 5000) / 1000.0;
+			break;
+
 		default:
 			break;
 	}
 }
 
-ACTOR Future<GetReadVersionReply> getConsistentReadVersion( DatabaseContext *cx, uint32_t transactionCount, uint32_t flags, Optional<UID> debugID ) {
+ACTOR Future<GetReadVersionReply> getConsistentReadVersion( DatabaseContext *cx, uint32_t transactionCount, uint32_t flags, Optional<UID> debugID, Key tag ) {
 	try {
 		if( debugID.present() )
 			g_traceBatch.addEvent("TransactionDebug", debugID.get().first(), "NativeAPI.getConsistentReadVersion.Before");
 		loop {
-			state GetReadVersionRequest req( transactionCount, flags, debugID );
+			state GetReadVersionRequest req( transactionCount, flags, debugID, tag );
 			choose {
 				when ( Void _ = wait( cx->onMasterProxiesChanged() ) ) {}
-				when ( GetReadVersionReply v = wait( loadBalance( cx->getMasterProxies(), &MasterProxyInterface::getConsistentReadVersion, req, cx->taskID ) ) ) {
+				when ( GetReadVersionReply v = wait( loadBalance( cx->getGrvProxies(), &MasterProxyInterface::getConsistentReadVersion, req, cx->taskID ) ) ) {
 					if( debugID.present() )
 						g_traceBatch.addEvent("TransactionDebug", debugID.get().first(), "NativeAPI.getConsistentReadVersion.After");
 					ASSERT( v.version > 0 );
@@ -2697,7 +3371,7 @@ ACTOR Future<GetReadVersionReply> getConsistentReadVersion( DatabaseContext *cx,
 	}
 }
 
-ACTOR Future<Void> readVersionBatcher( DatabaseContext *cx, FutureStream< std::pair< Promise<GetReadVersionReply>, Optional<UID> > > versionStream, uint32_t flags ) {
+ACTOR Future<Void> readVersionBatcher( DatabaseContext *cx, FutureStream< std::pair< Promise<GetReadVersionReply>, Optional<UID> > > versionStream, uint32_t flags, Key tag ) {
 	state std::vector< Promise<GetReadVersionReply> > requests;
 	state PromiseStream< Future<Void> > addActor;
 	state Future<Void> collection = actorCollection( addActor.getFuture() );
@@ -2747,7 +3421,7 @@ ACTOR Future<Void> readVersionBatcher( DatabaseContext *cx, FutureStream< std::p
 
 			Future<Void> batch =
 				broadcast(
-					getConsistentReadVersion(cx, count, flags, std::move(debugID)),
+					getConsistentReadVersion(cx, count, flags, std::move(debugID), tag),
 					std::vector< Promise<GetReadVersionReply> >(std::move(requests)));
 			debugID = Optional<UID>();
 			requests = std::vector< Promise<GetReadVersionReply> >();
@@ -2757,8 +3431,30 @@ ACTOR Future<Void> readVersionBatcher( DatabaseContext *cx, FutureStream< std::p
 	}
 }
 
+void DatabaseContext::updateCachedReadVersion( GetReadVersionReply const& rep, double requestTime ) {
+	if( rep.version >= cachedReadVersion ) {
+		cachedReadVersion = rep.version;
+		cachedReadVersionTime = std::max( cachedReadVersionTime, requestTime );
+		cachedReadVersionLocked = rep.locked;
+	}
+}
+
+// Requests a read version only to bring the cached one up to date, so that transactions using it do not have to wait
+// for a new one once it becomes too old
+ACTOR Future<Void> refreshCachedReadVersion( DatabaseContext* cx, Future<GetReadVersionReply> f, double startTime ) {
+	try {
+		GetReadVersionReply rep = wait(f);
+		cx->updateCachedReadVersion( rep, startTime );
+	} catch( Error& e ) {
+		if( e.code() == error_code_actor_cancelled )
+			throw;
+	}
+	return Void();
+}
+
 ACTOR Future<Version> extractReadVersion(DatabaseContext* cx, Reference<TransactionLogInfo> trLogInfo, Future<GetReadVersionReply> f, bool lockAware, double startTime) {
 	GetReadVersionReply rep = wait(f);
+	cx->updateCachedReadVersion( rep, startTime );
 	double latency = now() - startTime;
 	cx->GRVLatencies.addSample(latency);
 	if (trLogInfo)
@@ -2766,16 +3462,29 @@ ACTOR Future<Version> extractReadVersion(DatabaseContext* cx, Reference<Transact
 	if(rep.locked && !lockAware)
 		throw database_locked();
 
-	return rep.version;
+	return cx->laggedReadVersion(rep.version);
 }
 
 Future<Version> Transaction::getReadVersion(uint32_t flags) {
 	cx->transactionReadVersions++;
 	flags |= options.getReadVersionFlags;
 
-	auto& batcher = cx->versionBatcher[ flags ];
+	auto& batcher = cx->versionBatcher[ std::make_pair( flags, tag ) ];
 	if (!batcher.actor.isValid()) {
-		batcher.actor = readVersionBatcher( cx.getPtr(), batcher.stream.getFuture(), flags );
+		batcher.actor = readVersionBatcher( cx.getPtr(), batcher.stream.getFuture(), flags, tag );
+	}
+	if (!readVersion.isValid() && options.maxReadVersionStaleness > 0 && cx->cachedReadVersion > 0 && (options.lockAware || !cx->cachedReadVersionLocked)) {
+		double age = now() - cx->cachedReadVersionTime;
+		if( age <= options.maxReadVersionStaleness ) {
+			if( age > options.maxReadVersionStaleness / 2 && !( cx->cachedReadVersionRefresh.isValid() && !cx->cachedReadVersionRefresh.isReady() ) ) {
+				Promise<GetReadVersionReply> p;
+				batcher.stream.send( std::make_pair( p, Optional<UID>() ) );
+				cx->cachedReadVersionRefresh = refreshCachedReadVersion( cx.getPtr(), p.getFuture(), now() );
+			}
+			cx->transactionCachedReadVersions++;
+			startTime = now();
+			readVersion = cx->laggedReadVersion(cx->cachedReadVersion);
+		}
 	}
 	if (!readVersion.isValid()) {
 		Promise<GetReadVersionReply> p;
@@ -2786,6 +3495,12 @@ Future<Version> Transaction::getReadVersion(uint32_t flags) {
 	return readVersion;
 }
 
+// Keeps a retry from reusing the cached read version that this transaction conflicted at or that has become too old
+void Transaction::invalidateCachedReadVersion() {
+	if( readVersion.isReady() && !readVersion.isError() && readVersion.get() == cx->laggedReadVersion(cx->cachedReadVersion) )
+		cx->cachedReadVersionTime = -std::numeric_limits<double>::infinity();
+}
+
 Future<Standalone<StringRef>> Transaction::getVersionstamp() {
 	if(committing.isValid()) {
 		return transaction_invalid_version();
@@ -2802,8 +3517,10 @@ Future<Void> Transaction::onError( Error const& e ) {
 		e.code() == error_code_commit_unknown_result ||
 		e.code() == error_code_database_locked)
 	{
-		if(e.code() == error_code_not_committed)
+		if(e.code() == error_code_not_committed) {
 			cx->transactionsNotCommitted++;
+			invalidateCachedReadVersion();
+		}
 		if(e.code() == error_code_commit_unknown_result)
 			cx->transactionsMaybeCommitted++;
 
@@ -2814,8 +3531,10 @@ Future<Void> Transaction::onError( Error const& e ) {
 	if (e.code() == error_code_transaction_too_old ||
 		e.code() == error_code_future_version)
 	{
-		if( e.code() == error_code_transaction_too_old )
+		if( e.code() == error_code_transaction_too_old ) {
 			cx->transactionsTooOld++;
+			invalidateCachedReadVersion();
+		}
 		else if( e.code() == error_code_future_version )
 			cx->transactionsFutureVersions++;
 
@@ -2891,6 +3610,161 @@ ACTOR Future< StorageMetrics > waitStorageMetricsMultipleLocations(
 	}
 }
 
+ACTOR static Future<Void> forwardMetricsBatchReply( Future<WaitMetricsBatchReply> reply, PromiseStream<ErrorOr<WaitMetricsBatchReply>> replies ) {
+	try {
+		WaitMetricsBatchReply r = wait( reply );
+		replies.send( r );
+	} catch( Error& e ) {
+		if( e.code() == error_code_actor_cancelled )
+			throw;
+		replies.send( ErrorOr<WaitMetricsBatchReply>( e ) );
+	}
+	return Void();
+}
+
+// Sends the waits for the metrics of shards of one storage server as one subscription (see WaitMetricsBatchRequest),
+// so that the server keeps one outstanding request for them rather than one for each.  The changes to the subscription
+// made within STORAGE_METRICS_BATCH_DELAY are sent together, and supersede the outstanding request.
+ACTOR Future<Void> metricsBatcher( RequestStream<WaitMetricsBatchRequest> waitMetricsBatch, FutureStream<WaitMetricsRequest> requests ) {
+	state UID subscription = g_random->randomUniqueID();
+	state Endpoint endpoint = waitMetricsBatch.getEndpoint();
+	state std::map<int64_t, WaitMetricsRequest> waits;
+	state int64_t nextId = 0;
+	state bool replace = true;	// The server may not know the subscription, so the next request has to send all waits
+	state std::vector<int64_t> added, removed;	// Since the last request
+	state Future<Void> send = Never();
+	state bool sendScheduled = false;
+	state int outstanding = 0;
+	state double lastSweep = now();
+	state PromiseStream<ErrorOr<WaitMetricsBatchReply>> replies;
+	state ActorCollection forwarders(false);
+	state Future<Void> failureChange = IFailureMonitor::failureMonitor().onStateChanged( endpoint );
+
+	loop {
+		state bool failed = false;
+		choose {
+			when( WaitMetricsRequest req = waitNext( requests ) ) {
+				if( IFailureMonitor::failureMonitor().getState( endpoint ).isFailed() ) {
+					req.reply.sendError( all_alternatives_failed() );
+				} else {
+					int64_t id = nextId++;
+					waits[id] = req;
+					added.push_back( id );
+				}
+			}
+			when( Void _ = wait( send ) ) {
+				sendScheduled = false;
+				send = Never();
+
+				// Stop waiting for the shards whose waiters have gone, e.g. because their trackers were replaced
+				if( now() - lastSweep >= 1.0 ) {
+					for(auto w = waits.begin(); w != waits.end(); ) {
+						if( !w->second.reply.getFutureReferenceCount() ) {
+							removed.push_back( w->first );
+							waits.erase( w++ );
+						} else
+							++w;
+					}
+					lastSweep = now();
+				}
+
+				WaitMetricsBatchRequest req;
+				req.subscription = subscription;
+				req.replace = replace;
+				if( replace ) {
+					for(auto& w : waits)
+						req.add.push_back( req.arena, MetricsWaitRef( w.first, w.second.keys, w.second.min, w.second.max ) );
+				} else {
+					for(auto id : added) {
+						auto w = waits.find( id );
+						if( w != waits.end() )
+							req.add.push_back( req.arena, MetricsWaitRef( id, w->second.keys, w->second.min, w->second.max ) );
+					}
+					req.remove = std::move( removed );
+				}
+				replace = false;
+				added.clear();
+				removed.clear();
+
+				++outstanding;
+				forwarders.add( forwardMetricsBatchReply( waitMetricsBatch.getReply( req, TaskDataDistribution ), replies ) );
+			}
+			when( ErrorOr<WaitMetricsBatchReply> reply = waitNext( replies.getFuture() ) ) {
+				--outstanding;
+				if( reply.isError() ) {
+					TEST( true ); // Storage metrics subscription request failed
+					failed = true;
+				} else if( reply.get().lost ) {
+					TEST( true ); // Storage metrics subscription lost
+					replace = true;
+				} else {
+					for(auto& c : reply.get().changed) {
+						auto w = waits.find( c.first );
+						if( w != waits.end() ) {
+							w->second.reply.send( c.second );
+							waits.erase( w );
+						}
+					}
+					for(auto id : reply.get().notReadable) {
+						auto w = waits.find( id );
+						if( w != waits.end() ) {
+							w->second.reply.sendError( wrong_shard_server() );
+							waits.erase( w );
+						}
+					}
+				}
+			}
+			when( Void _ = wait( failureChange ) ) {
+				failureChange = IFailureMonitor::failureMonitor().onStateChanged( endpoint );
+				failed = IFailureMonitor::failureMonitor().getState( endpoint ).isFailed();
+			}
+			when( Void _ = wait( forwarders.getResult() ) ) {}
+		}
+
+		if( failed ) {
+			// The waiters retry, choosing another of their shard's servers while this one is failed
+			for(auto& w : waits)
+				w.second.reply.sendError( all_alternatives_failed() );
+			waits.clear();
+			added.clear();
+			removed.clear();
+			replace = true;
+		}
+
+		// Send the new waits, and keep a request outstanding for as long as there are waits
+		if( !sendScheduled && waits.size() && ( added.size() || replace || !outstanding ) ) {
+			send = delay( CLIENT_KNOBS->STORAGE_METRICS_BATCH_DELAY, TaskDataDistribution );
+			sendScheduled = true;
+		}
+	}
+}
+
+// Waits for the metrics of a single-shard range through the metrics subscription of one of the shard's servers
+Future<StorageMetrics> waitBatchedStorageMetrics( DatabaseContext* cx, KeyRange const& keys, Reference<LocationInfo> const& location, StorageMetrics const& min, StorageMetrics const& max ) {
+	// The shards of a team are spread over its servers, and each keeps to the same server while it is available
+	int start = hashlittle( keys.begin.begin(), keys.begin.size(), 0 ) % location->size();
+	bool anyBatching = false;
+	for(int i = 0; i < location->size(); i++) {
+		RequestStream<WaitMetricsBatchRequest> const& waitMetricsBatch = location->get( (start + i) % location->size(), &StorageServerInterface::waitMetricsBatch );
+		Endpoint const& endpoint = waitMetricsBatch.getEndpoint();
+		if( !endpoint.isValid() )
+			continue;
+		anyBatching = true;
+		if( IFailureMonitor::failureMonitor().getState( endpoint ).isFailed() )
+			continue;
+
+		auto& batcher = cx->metricsBatcher[ endpoint.token ];
+		if( !batcher.actor.isValid() )
+			batcher.actor = metricsBatcher( waitMetricsBatch, batcher.stream.getFuture() );
+		WaitMetricsRequest req( keys, min, max );
+		batcher.stream.send( req );
+		return req.reply.getFuture();
+	}
+	if( anyBatching )
+		return all_alternatives_failed();
+	return loadBalance( location, &StorageServerInterface::waitMetrics, WaitMetricsRequest( keys, min, max ), TaskDataDistribution );
+}
+
 ACTOR Future< StorageMetrics > waitStorageMetrics(
 	Database cx,
 	KeyRange keys,
@@ -2923,6 +3797,10 @@ ACTOR Future< StorageMetrics > waitStorageMetrics(
 				if (locations.size() > 1) {
 					StorageMetrics x = wait( waitStorageMetricsMultipleLocations( locations, min, max, permittedError ) );
 					return x;
+				} else if (CLIENT_KNOBS->STORAGE_METRICS_BATCHING && min.allLessOrEqual( max )) {
+					// A reversed range asks for an immediate report, which is not worth a trip through the subscription
+					StorageMetrics x = wait( waitBatchedStorageMetrics( cx.getPtr(), keys, locations[0].second, min, max ) );
+					return x;
 				} else {
 					WaitMetricsRequest req( keys, min, max );
 					StorageMetrics x = wait( loadBalance( locations[0].second, &StorageServerInterface::waitMetrics, req, TaskDataDistribution ) );
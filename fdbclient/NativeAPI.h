@@ -142,8 +142,10 @@ struct StorageMetrics;
 
 struct TransactionOptions {
 	double maxBackoff;
+	double maxReadVersionStaleness;
 	uint32_t getReadVersionFlags;
 	uint32_t customTransactionSizeLimit;
+	uint32_t maxConflictRanges;
 	bool checkWritesEnabled : 1;
 	bool causalWriteRisky : 1;
 	bool commitOnFirstProxy : 1;
@@ -151,6 +153,7 @@ struct TransactionOptions {
 	bool lockAware : 1;
 	bool readOnly : 1;
 	bool firstInBatch : 1;
+	bool compactConflictRanges : 1;
 
 	TransactionOptions() {
 		reset();
@@ -233,10 +236,18 @@ public:
 	Future<Version> getReadVersion() { return getReadVersion(0); }
 
 	Future< Optional<Value> > get( const Key& key, bool snapshot = false );
+	// Reads all of keys at the transaction's read version, with one request per storage team
+	Future< vector<Optional<Value>> > getMulti( vector<Key> const& keys, bool snapshot = false );
 	Future< Void > watch( Reference<Watch> watch );
 	Future< Key > getKey( const KeySelector& key, bool snapshot = false );
 	//Future< Optional<KeyValue> > get( const KeySelectorRef& key );
 	Future< Standalone<RangeResultRef> > getRange( const KeySelector& begin, const KeySelector& end, int limit, bool snapshot = false, bool reverse = false );
+	// Sends all of the key-value pairs in keys, in order, to results in batches and then ends results with end_of_stream
+	//   (or an error, which should be passed to onError()).  The returned future must be held while reading results.
+	Future< Void > getRangeStream( PromiseStream<Standalone<RangeResultRef>> const& results, KeyRange const& keys, bool snapshot = false );
+	// Returns the number of keys in keys, their total size and the sum of their values (see GetRangeAggregateReply), which
+	// the storage servers compute without sending the range to the client.  Its end is that of keys.
+	Future< GetRangeAggregateReply > getRangeAggregate( KeyRange const& keys, bool snapshot = false );
 	Future< Standalone<RangeResultRef> > getRange( const KeySelector& begin, const KeySelector& end, GetRangeLimits limits, bool snapshot = false, bool reverse = false );
 	Future< Standalone<RangeResultRef> > getRange( const KeyRange& keys, int limit, bool snapshot = false, bool reverse = false ) { 
 		return getRange( KeySelector( firstGreaterOrEqual(keys.begin), keys.arena() ), 
@@ -255,6 +266,9 @@ public:
 	void makeSelfConflicting();
 
 	Future< Void > warmRange( Database cx, KeyRange keys );
+	// Returns keys.begin, the boundaries of the shards within keys, and keys.end, so that work on a range can be divided
+	// among the storage servers which hold it
+	Future< Standalone<VectorRef<KeyRef>> > getShardBoundaries( KeyRange const& keys );
 
 	Future< StorageMetrics > waitStorageMetrics( KeyRange const& keys, StorageMetrics const& min, StorageMetrics const& max, StorageMetrics const& permittedError, int shardLimit );
 	Future< StorageMetrics > getStorageMetrics( KeyRange const& keys, int shardLimit );
@@ -304,11 +318,13 @@ public:
 	}
 	static Reference<TransactionLogInfo> createTrLogInfoProbabilistically(const Database& cx);
 	TransactionOptions options;
+	Key tag;  // Set by the tag option, and kept when the transaction is reset
 	double startTime;
 	Reference<TransactionLogInfo> trLogInfo;
 private:
 	Future<Version> getReadVersion(uint32_t flags);
 	void setPriority(uint32_t priorityFlag);
+	void invalidateCachedReadVersion();
 
 	Database cx;
 
@@ -316,6 +332,7 @@ private:
 	Version committedVersion;
 	CommitTransactionRequest tr;
 	Future<Version> readVersion;
+	std::map<Key, Future<Optional<Value>>> readCacheStamps;  // By read_cache_prefix, at readVersion
 	vector<Future<std::pair<Key, Key>>> extraConflictRanges;
 	Promise<Void> commitResult;
 	Future<Void> committing;
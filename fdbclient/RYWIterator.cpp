@@ -541,6 +541,39 @@ TEST_CASE("fdbclient/WriteMap/addValue") {
 	return Void();
 }
 
+TEST_CASE("fdbclient/WriteMap/pendingSets") {
+	Arena arena = Arena();
+	WriteMap writes = WriteMap(&arena);
+
+	// Sets made out of key order and repeated, of which the last to each key should be seen
+	std::map<KeyRef, std::pair<ValueRef, bool>> expected;
+	for (int i = 0; i < 1000; i++) {
+		KeyRef key = StringRef(arena, format("key%03d", g_random->randomInt(0, 100)));
+		ValueRef value = StringRef(arena, format("%d", i));
+		bool addConflict = g_random->random01() < 0.5;
+		writes.mutate(key, MutationRef::SetValue, value, addConflict);
+		expected[key] = std::make_pair(value, expected[key].second || addConflict);
+	}
+	ASSERT(!writes.empty());
+
+	WriteMap::iterator it(&writes);
+	it.skip(allKeys.begin);
+	auto e = expected.begin();
+	for (; it.beginKey() < allKeys.end; ++it) {
+		if (it.is_operation()) {
+			ASSERT(e != expected.end());
+			ASSERT(it.beginKey().cmp(e->first) == 0);
+			ASSERT(it.op().size() == 1 && it.op().top().type == MutationRef::SetValue);
+			ASSERT(it.op().top().value.get() == e->second.first);
+			ASSERT(it.is_conflict_range() == e->second.second);
+			++e;
+		}
+	}
+	ASSERT(e == expected.end());
+
+	return Void();
+}
+
 TEST_CASE("fdbclient/WriteMap/random") {
 	Arena arena = Arena();
 	WriteMap writes = WriteMap(&arena);
@@ -272,7 +272,22 @@ public:
 	template <class Req> static inline Future<typename Req::Result> readWithConflictRange( ReadYourWritesTransaction* ryw, Req const& req, bool snapshot ) {
 		if (ryw->options.readYourWritesDisabled) {
 			return readWithConflictRangeThrough(ryw, req, snapshot);
-		} else if (snapshot && ryw->options.snapshotRywEnabled <= 0) {
+		}
+		ryw->onlyPointReads = false;
+		if (snapshot && ryw->options.snapshotRywEnabled <= 0) {
+			return readWithConflictRangeSnapshot(ryw, req);
+		}
+		return readWithConflictRangeRYW(ryw, req, snapshot);
+	}
+	static inline Future<Optional<Value>> readWithConflictRange( ReadYourWritesTransaction* ryw, GetValueReq const& req, bool snapshot ) {
+		// Until the transaction writes something or reads anything but single keys there is nothing in the write map for a
+		// point read to see, so it can go directly to the underlying transaction, which records the read conflict range
+		// itself, without filling the snapshot cache or the read conflict map.
+		if (ryw->options.readYourWritesDisabled || (ryw->onlyPointReads && ryw->writes.empty() && CLIENT_KNOBS->RYW_POINT_READ_BYPASS)) {
+			return readWithConflictRangeThrough(ryw, req, snapshot);
+		}
+		ryw->onlyPointReads = false;
+		if (snapshot && ryw->options.snapshotRywEnabled <= 0) {
 			return readWithConflictRangeSnapshot(ryw, req);
 		}
 		return readWithConflictRangeRYW(ryw, req, snapshot);
@@ -1100,7 +1115,7 @@ public:
 	}
 };
 
-ReadYourWritesTransaction::ReadYourWritesTransaction( Database const& cx ) : cache(&arena), writes(&arena), tr(cx), retries(0), creationTime(now()), commitStarted(false), options(tr) {}
+ReadYourWritesTransaction::ReadYourWritesTransaction( Database const& cx ) : cache(&arena), writes(&arena), tr(cx), retries(0), creationTime(now()), commitStarted(false), onlyPointReads(true), options(tr) {}
 
 ACTOR Future<Void> timebomb(double totalSeconds, Promise<Void> resetPromise) {
 	if(totalSeconds == 0.0) {
@@ -1279,6 +1294,30 @@ Future< Standalone<RangeResultRef> > ReadYourWritesTransaction::getRange(
 		return Standalone<RangeResultRef>();
 	}
 
+	// The snapshot cache holds whole values, so a read of only part of each value cannot fill it.  Before the transaction
+	// writes anything there is nothing for the read to see but the database, so it goes directly to the underlying
+	// transaction, which records its read conflict range itself; after that whole values are read and then cut.
+	if( limits.hasValueLimit() && !options.readYourWritesDisabled ) {
+		if( writes.empty() ) {
+			TEST(true); // RYW value prefix range read bypasses the snapshot cache
+			Future< Standalone<RangeResultRef> > result = reverse
+				? RYWImpl::readWithConflictRangeThrough( this, RYWImpl::GetRangeReq<true>(begin, end, limits), snapshot )
+				: RYWImpl::readWithConflictRangeThrough( this, RYWImpl::GetRangeReq<false>(begin, end, limits), snapshot );
+			reading.add( success( result ) );
+			return result;
+		}
+
+		TEST(true); // RYW value prefix range read after a write
+		GetRangeLimits wholeValues = limits;
+		wholeValues.valueBytes = GetRangeLimits::VALUE_BYTES_UNLIMITED;
+		Future< Standalone<RangeResultRef> > result = map( getRange( begin, end, wholeValues, snapshot, reverse ), [limits]( Standalone<RangeResultRef> r ) {
+			limits.truncateValues( r );
+			return r;
+		} );
+		reading.add( success( result ) );
+		return result;
+	}
+
 	Future< Standalone<RangeResultRef> > result = reverse 
 		? RYWImpl::readWithConflictRange( this, RYWImpl::GetRangeReq<true>(begin, end, limits), snapshot )
 		: RYWImpl::readWithConflictRange( this, RYWImpl::GetRangeReq<false>(begin, end, limits), snapshot );
@@ -1412,7 +1451,11 @@ void ReadYourWritesTransaction::writeRangeToNativeTransaction( KeyRangeRef const
 			for( int i = 0; i < op.size(); ++i) {
 				switch(op[i].type) {
 					case MutationRef::SetValue:
-						tr.set( it.beginKey().assertRef(), op[i].value.get(), false );
+						// A conditional operation on a key cleared by this transaction can leave it absent
+						if( op[i].value.present() )
+							tr.set( it.beginKey().assertRef(), op[i].value.get(), false );
+						else
+							tr.clear( singleKeyRange( it.beginKey().assertRef(), arena ), false );
 						break;
 					case MutationRef::AddValue:
 					case MutationRef::AppendIfFits:
@@ -1427,6 +1470,8 @@ void ReadYourWritesTransaction::writeRangeToNativeTransaction( KeyRangeRef const
 					case MutationRef::ByteMax:
 					case MutationRef::MinV2:
 					case MutationRef::AndV2:
+					case MutationRef::SetIfAbsent:
+					case MutationRef::CompareAndSet:
 						tr.atomicOp( it.beginKey().assertRef(), op[i].value.get(), op[i].type, false );
 						break;
 					default:
@@ -1497,6 +1542,10 @@ void ReadYourWritesTransaction::atomicOp( const KeyRef& key, const ValueRef& ope
 
 	if (operationType == MutationRef::SetVersionstampedValue && operand.size() < 10)
 		throw client_invalid_operation();
+
+	ValueRef compareValue, setValue;
+	if (operationType == MutationRef::CompareAndSet && !decodeCompareAndSetOperand(operand, compareValue, setValue))
+		throw client_invalid_operation();
 		
 	if (tr.apiVersionAtLeast(510)) {
 		if (operationType == MutationRef::Min)
@@ -1780,6 +1829,7 @@ void ReadYourWritesTransaction::operator=(ReadYourWritesTransaction&& r) noexcep
 	timeoutActor = r.timeoutActor;
 	creationTime = r.creationTime;
 	commitStarted = r.commitStarted;
+	onlyPointReads = r.onlyPointReads;
 	options = r.options;
 	transactionDebugInfo = r.transactionDebugInfo;
 	cache.arena = &arena;
@@ -1797,6 +1847,7 @@ ReadYourWritesTransaction::ReadYourWritesTransaction(ReadYourWritesTransaction&&
 	timeoutActor( std::move(r.timeoutActor) ),
 	resetPromise( std::move(r.resetPromise) ),
 	commitStarted( r.commitStarted ),
+	onlyPointReads( r.onlyPointReads ),
 	options( r.options ),
 	transactionDebugInfo( r.transactionDebugInfo )
 {
@@ -1824,6 +1875,7 @@ void ReadYourWritesTransaction::resetRyow() {
 	watchMap.clear();
 	reading = AndFuture();
 	commitStarted = false;
+	onlyPointReads = true;
 
 	deferred_error = Error();
 
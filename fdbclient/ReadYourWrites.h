@@ -149,6 +149,7 @@ private:
 	Future<Void> timeoutActor;
 	double creationTime;
 	bool commitStarted;
+	bool onlyPointReads;  // Nothing has been read except single keys that bypassed the snapshot cache
 
 	Reference<TransactionDebugInfo> transactionDebugInfo;
 
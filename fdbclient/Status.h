@@ -22,6 +22,7 @@
 #define FDBCLIENT_STATUS_H
 
 #include "../fdbrpc/JSONDoc.h"
+#include "../fdbrpc/JSONReader.h"
 
 struct StatusObject : json_spirit::mObject {
 	typedef json_spirit::mObject Map;
@@ -39,7 +40,7 @@ void load(Ar& ar, StatusObject& statusObj) {
 	value.resize(length);
 	ar.serializeBytes( &value[0], (int)value.length() );
 	json_spirit::mValue mv;
-	json_spirit::read_string( value, mv );
+	readJSON( value, mv );
 	statusObj = StatusObject(mv.get_obj());
 
 	ASSERT( ar.protocolVersion() != 0 );
@@ -82,6 +83,22 @@ template <> inline bool JSONDoc::get<JSONDoc>(const std::string path, StatusObje
 	return r;
 }
 
+// The subtrees of status at the given paths, at the same paths.  Paths that status does not have are left out.
+static StatusObject selectStatusFields(StatusObject const& status, std::vector<std::string> const& paths) {
+	StatusObjectReader reader(status);
+	StatusObject selected;
+	JSONDoc writer(selected);
+	for(auto& path : paths) {
+		try {
+			if(reader.has(path))
+				writer.create(path) = reader.last();
+		} catch(std::exception&) {
+			// A part of the path other than the last is not an object
+		}
+	}
+	return selected;
+}
+
 // Takes an object by reference so make usage look clean and avoid the client doing object["messages"] which will create the key.
 static bool findMessagesByName(StatusObjectReader object, std::set<std::string> to_find) {
 
@@ -27,6 +27,7 @@
 #include "Status.h"
 #include "json_spirit/json_spirit_writer_template.h"
 #include "fdbrpc/genericactors.actor.h"
+#include "flow/UnitTest.h"
 
 uint64_t JSONDoc::expires_reference_version = std::numeric_limits<uint64_t>::max();
 
@@ -333,8 +334,9 @@ ACTOR Future<StatusObject> clientStatusFetcher(Reference<ClusterConnectionFile>
 }
 
 // Cluster section of json output
-ACTOR Future<Optional<StatusObject>> clusterStatusFetcher(ClusterInterface cI, StatusArray *messages) {
+ACTOR Future<Optional<StatusObject>> clusterStatusFetcher(ClusterInterface cI, std::vector<std::string> clusterFields, StatusArray *messages) {
 	state StatusRequest req;
+	req.statusFields = clusterFields;
 	state Future<Void> clusterTimeout = delay(30.0);
 	state Optional<StatusObject> oStatusObj;
 
@@ -422,7 +424,7 @@ StatusObject getClientDatabaseStatus(StatusObjectReader client, StatusObjectRead
 	return databaseStatus;
 }
 
-ACTOR Future<StatusObject> statusFetcherImpl( Reference<ClusterConnectionFile> f ) {
+ACTOR Future<StatusObject> statusFetcherImpl( Reference<ClusterConnectionFile> f, std::vector<std::string> clusterFields ) {
 	if (!g_network) throw network_not_setup();
 
 	state StatusObject statusObj;
@@ -464,7 +466,7 @@ ACTOR Future<StatusObject> statusFetcherImpl( Reference<ClusterConnectionFile> f
 
 			loop{
 				if (clusterInterface->get().present()) {
-					Optional<StatusObject> _statusObjCluster = wait(clusterStatusFetcher(clusterInterface->get().get(), &clientMessages));
+					Optional<StatusObject> _statusObjCluster = wait(clusterStatusFetcher(clusterInterface->get().get(), clusterFields, &clientMessages));
 					if (_statusObjCluster.present()){
 						statusObjCluster = _statusObjCluster.get();
 						// TODO: this is a temporary fix, getting the number of available coordinators should move to the server side
@@ -503,12 +505,17 @@ ACTOR Future<StatusObject> statusFetcherImpl( Reference<ClusterConnectionFile> f
 	// Put clientMessages into Client section.
 	statusObjClient["messages"] = clientMessages;
 
-	// Create database_status section, place into statusObjClient
-	statusObjClient["database_status"] = getClientDatabaseStatus(statusObjClient, statusObjCluster);
+	// Create database_status section, place into statusObjClient.  It is derived from parts of the cluster section that
+	// a partial one may not have.
+	if(clusterFields.empty())
+		statusObjClient["database_status"] = getClientDatabaseStatus(statusObjClient, statusObjCluster);
 
 	// Put finalized client section into final document.  Cluster section was created above if it was possible.
 	statusObj["client"] = statusObjClient;
 
+	if(clusterFields.size())
+		return statusObj;
+
 	// Make sure that if a document is being returned at all it has a cluster.layers._valid path.
 	JSONDoc doc(statusObj);  // doc will modify statusObj with a convenient interface
 	auto &layers_valid = doc.create("cluster.layers._valid");
@@ -518,6 +525,22 @@ ACTOR Future<StatusObject> statusFetcherImpl( Reference<ClusterConnectionFile> f
 	return statusObj;
 }
 
-Future<StatusObject> StatusClient::statusFetcher( Reference<ClusterConnectionFile> clusterFile ) {
-	return statusFetcherImpl(clusterFile);
+Future<StatusObject> StatusClient::statusFetcher( Reference<ClusterConnectionFile> clusterFile, std::vector<std::string> const& clusterFields ) {
+	return statusFetcherImpl(clusterFile, clusterFields);
+}
+
+TEST_CASE("fdbclient/StatusClient/readJSON") {
+	std::string text = "{\"a\":{\"b\":[1,-2,3.5,\"x\",true,null,{}],\"big\":18446744073709551615,\"neg\":-9223372036854775808},"
+		"\"c\":\"\\u00e9\\n\",\"d\":{\"e\":0.1,\"f\":[]}}";
+	json_spirit::mValue expected, value;
+	ASSERT( json_spirit::read_string(text, expected) && readJSON(text, value) );
+	ASSERT( json_spirit::write_string(value) == json_spirit::write_string(expected) );
+
+	// Only json_spirit reads \x escapes
+	ASSERT( readJSON( "[\"\\x41\"]", value ) && value.get_array()[0].get_str() == "A" );
+
+	StatusObject selected = selectStatusFields( StatusObject(expected.get_obj()), { "a.big", "d", "missing", "c.x" } );
+	ASSERT( json_spirit::write_string(json_spirit::mValue(selected)) == "{\"a\":{\"big\":18446744073709551615},\"d\":{\"e\":0.1,\"f\":[]}}" );
+
+	return Void();
 }
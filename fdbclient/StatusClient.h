@@ -27,7 +27,9 @@
 class StatusClient {
 public:
 	enum StatusLevel { MINIMAL = 0, NORMAL = 1, DETAILED = 2, JSON = 3 };
-	static Future<StatusObject> statusFetcher(Reference<ClusterConnectionFile> clusterFile);
+	// With clusterFields, the cluster section has only the parts at those paths (e.g. "qos" or "data.moving_data"),
+	// which the cluster controller selects before replying, and the client section has no database_status.
+	static Future<StatusObject> statusFetcher(Reference<ClusterConnectionFile> clusterFile, std::vector<std::string> const& clusterFields = std::vector<std::string>());
 };
 
 #endif
\ No newline at end of file
@@ -23,6 +23,7 @@
 #pragma once
 
 #include "FDBTypes.h"
+#include "CommitTransaction.h"
 #include "fdbrpc/Locality.h"
 #include "fdbrpc/QueueModel.h"
 #include "fdbrpc/fdbrpc.h"
@@ -42,11 +43,15 @@ struct StorageServerInterface {
 
 	RequestStream<ReplyPromise<Version>> getVersion;
 	RequestStream<struct GetValueRequest> getValue;
+	RequestStream<struct GetValuesRequest> getValues;  // Not valid if the interface was serialized by a version without it
 	RequestStream<struct GetKeyRequest> getKey;
 
 	// Throws a wrong_shard_server if the keys in the request or result depend on data outside this server OR if a large selector offset prevents
 	// all data from being read in one range read
 	RequestStream<struct GetKeyValuesRequest> getKeyValues;
+	// Reads a range within one shard as a sequence of batches which the server reads ahead of the client's requests.
+	//   Not valid if the interface was serialized by a version without it.
+	RequestStream<struct GetKeyValuesStreamRequest> getKeyValuesStream;
 
 	RequestStream<struct GetShardStateRequest> getShardState;
 	RequestStream<struct WaitMetricsRequest> waitMetrics;
@@ -57,6 +62,19 @@ struct StorageServerInterface {
 
 	RequestStream<ReplyPromise<KeyValueStoreType>> getKeyValueStoreType;
 	RequestStream<struct WatchValueRequest> watchValue;
+	// Writes a range within one shard to a backup container.  Not valid if the interface was serialized by a version without it.
+	RequestStream<struct ExportBackupRangeRequest> exportBackupRange;
+	// Returns the mutations to a range after a version.  Not valid if the interface was serialized by a version without it.
+	RequestStream<struct ChangeFeedRequest> changeFeed;
+	// Counts and sums a range without returning it.  Not valid if the interface was serialized by a version without it.
+	RequestStream<struct GetRangeAggregateRequest> getRangeAggregate;
+	// Returns the ranges the server has seen the most reads and writes of lately.  Not valid if the interface was serialized by a version without it.
+	RequestStream<struct GetHotRangesRequest> getHotRanges;
+	// Digests a range in chunks without returning it.  Not valid if the interface was serialized by a version without it.
+	RequestStream<struct GetRangeDigestRequest> getRangeDigest;
+	// Waits for the metrics of any of many ranges to leave their bounds, for one subscriber.  Not valid if the interface
+	//   was serialized by a version without it.
+	RequestStream<struct WaitMetricsBatchRequest> waitMetricsBatch;
 
 	explicit StorageServerInterface(UID uid) : uniqueID( uid ) {}
 	StorageServerInterface() : uniqueID( g_random->randomUniqueID() ) {}
@@ -72,13 +90,31 @@ struct StorageServerInterface {
 
 		if( ar.protocolVersion() >= 0x0FDB00A200090001LL )
 			ar & watchValue;
+		if( ar.protocolVersion() >= 0x0FDB00A560020001LL ) {
+			ar & getValues & getKeyValuesStream;
+		} else if( ar.isDeserializing ) {
+			getValues = RequestStream<struct GetValuesRequest>( Endpoint() );
+			getKeyValuesStream = RequestStream<struct GetKeyValuesStreamRequest>( Endpoint() );
+		}
+		if( ar.protocolVersion() >= 0x0FDB00A560060001LL ) {
+			ar & exportBackupRange & changeFeed & getRangeAggregate & getHotRanges & getRangeDigest & waitMetricsBatch;
+		} else if( ar.isDeserializing ) {
+			exportBackupRange = RequestStream<struct ExportBackupRangeRequest>( Endpoint() );
+			changeFeed = RequestStream<struct ChangeFeedRequest>( Endpoint() );
+			getRangeAggregate = RequestStream<struct GetRangeAggregateRequest>( Endpoint() );
+			getHotRanges = RequestStream<struct GetHotRangesRequest>( Endpoint() );
+			getRangeDigest = RequestStream<struct GetRangeDigestRequest>( Endpoint() );
+			waitMetricsBatch = RequestStream<struct WaitMetricsBatchRequest>( Endpoint() );
+		}
 	}
 	bool operator == (StorageServerInterface const& s) const { return uniqueID == s.uniqueID; }
 	bool operator < (StorageServerInterface const& s) const { return uniqueID < s.uniqueID; }
 	void initEndpoints() {
 		getValue.getEndpoint( TaskLoadBalancedEndpoint );
+		getValues.getEndpoint( TaskLoadBalancedEndpoint );
 		getKey.getEndpoint( TaskLoadBalancedEndpoint );
 		getKeyValues.getEndpoint( TaskLoadBalancedEndpoint );
+		getRangeAggregate.getEndpoint( TaskLoadBalancedEndpoint );
 	}
 };
 
@@ -120,6 +156,36 @@ struct GetValueRequest {
 		ar & key & version & debugID & reply;
 	}
 };
+PREALLOCATED_SERIALIZABLE( GetValueRequest );
+
+struct GetValuesReply : public LoadBalancedReply {
+	Arena arena;
+	VectorRef<Optional<ValueRef>> values;  // values[i] is the value of GetValuesRequest::keys[i]
+
+	template <class Ar>
+	void serialize( Ar& ar ) {
+		ar & *(LoadBalancedReply*)this & values & arena;
+	}
+};
+PREALLOCATED_SERIALIZABLE( GetValuesReply );
+
+// Reads several keys at the same version; all of the keys must be in shards on this server
+struct GetValuesRequest {
+	Arena arena;
+	VectorRef<KeyRef> keys;
+	Version version;
+	Optional<UID> debugID;
+	ReplyPromise<GetValuesReply> reply;
+
+	GetValuesRequest() {}
+	GetValuesRequest(VectorRef<KeyRef> const& keys, Version ver, Optional<UID> debugID) : keys(arena, keys), version(ver), debugID(debugID) {}
+
+	template <class Ar>
+	void serialize( Ar& ar ) {
+		ar & keys & version & debugID & reply & arena;
+	}
+};
+PREALLOCATED_SERIALIZABLE( GetValuesRequest );
 
 struct WatchValueRequest {
 	Key key;
@@ -145,23 +211,296 @@ struct GetKeyValuesReply : public LoadBalancedReply {
 
 	template <class Ar>
 	void serialize( Ar& ar ) {
-		ar & *(LoadBalancedReply*)this & data & version & more & arena;
+		if( ar.protocolVersion() >= 0x0FDB00A560030001LL ) {
+			ar & *(LoadBalancedReply*)this & version & more & arena;
+			serializeFrontCoded( ar );
+		} else {
+			ar & *(LoadBalancedReply*)this & data & version & more & arena;
+		}
+	}
+
+private:
+	// Keys in a range are mostly neighbours sharing a long tuple encoded prefix, so each key is sent as the length of the
+	// prefix it shares with the key before it followed by the rest of the key.  Keys are rebuilt in full when the reply
+	// is read, so data stays an ordinary VectorRef<KeyValueRef>; a key that shares nothing still points into the message.
+	template <class Ar>
+	void serializeFrontCoded( Ar& ar ) {
+		int count = data.size();
+		ar & count;
+		if( ar.isDeserializing )
+			data.resize( arena, count );
+		KeyRef prev;
+		for(int i = 0; i < count; i++) {
+			uint16_t shared = 0;
+			KeyRef suffix;
+			if( !ar.isDeserializing ) {
+				int maxShared = std::min<int>( std::min( prev.size(), data[i].key.size() ), std::numeric_limits<uint16_t>::max() );
+				while( shared < maxShared && prev[shared] == data[i].key[shared] )
+					shared++;
+				suffix = data[i].key.substr( shared );
+			}
+			ar & shared & suffix & data[i].value;
+			if( ar.isDeserializing ) {
+				ASSERT( shared <= prev.size() );
+				if( shared ) {
+					uint8_t* key = new (arena) uint8_t[ shared + suffix.size() ];
+					memcpy( key, prev.begin(), shared );
+					memcpy( key + shared, suffix.begin(), suffix.size() );
+					data[i].key = KeyRef( key, shared + suffix.size() );
+				} else {
+					data[i].key = suffix;
+				}
+			}
+			prev = data[i].key;
+		}
 	}
 };
+PREALLOCATED_SERIALIZABLE( GetKeyValuesReply );
 
 struct GetKeyValuesRequest {
 	Arena arena;
 	KeySelectorRef begin, end;
 	Version version;		// or latestVersion
 	int limit, limitBytes;
+	int maxValueLength;		// If >= 0, only the first maxValueLength bytes of each value are returned
 	Optional<UID> debugID;
 	ReplyPromise<GetKeyValuesReply> reply;
 
-	GetKeyValuesRequest() {}
+	GetKeyValuesRequest() : maxValueLength(-1) {}
 //	GetKeyValuesRequest(const KeySelectorRef& begin, const KeySelectorRef& end, Version version, int limit, int limitBytes, Optional<UID> debugID) : begin(begin), end(end), version(version), limit(limit), limitBytes(limitBytes) {}
 	template <class Ar>
 	void serialize( Ar& ar ) {
 		ar & begin & end & version & limit & limitBytes & debugID & reply & arena;
+		if( ar.protocolVersion() >= 0x0FDB00A560060001LL ) {
+			ar & maxValueLength;
+		}
+	}
+};
+
+// Requests batch number sequence of the stream streamID.  Batch 0 starts the stream, and later batches continue after
+// the last key of the previous batch.  The client keeps several batches requested, and the server reads each batch as
+// soon as it is requested and the previous batch has been read.  Every batch has the same keys, version and limits;
+// the stream is over when a batch has !more.
+struct GetKeyValuesStreamRequest {
+	Arena arena;
+	UID streamID;
+	int sequence;
+	KeyRangeRef keys;		// must be within one shard
+	Version version;
+	int limit, limitBytes;	// per batch
+	Optional<UID> debugID;
+	ReplyPromise<GetKeyValuesReply> reply;
+
+	GetKeyValuesStreamRequest() : sequence(0) {}
+	template <class Ar>
+	void serialize( Ar& ar ) {
+		ar & streamID & sequence & keys & version & limit & limitBytes & debugID & reply & arena;
+	}
+};
+
+struct ExportBackupRangeReply {
+	std::string fileName;
+	int64_t fileSize;
+	Key end;		// The file holds [keys.begin, end), which is less than keys if they did not fit in one file or one shard
+
+	ExportBackupRangeReply() : fileSize(0) {}
+	template <class Ar>
+	void serialize( Ar& ar ) {
+		ar & fileName & fileSize & end;
+	}
+};
+
+// Asks a storage server to write the key values in keys as of version to the backup container at containerURL as a range
+// file, so that a backup snapshot does not have to read the data through a backup agent.  keys must begin in a shard
+// which the server can read.
+struct ExportBackupRangeRequest {
+	Arena arena;
+	KeyRangeRef keys;
+	Version version;
+	std::string containerURL;
+	int blockSize;
+	ReplyPromise<ExportBackupRangeReply> reply;
+
+	ExportBackupRangeRequest() : version(invalidVersion), blockSize(0) {}
+	template <class Ar>
+	void serialize( Ar& ar ) {
+		ar & keys & version & containerURL & blockSize & reply & arena;
+	}
+};
+
+struct GetRangeAggregateReply : public LoadBalancedReply {
+	int64_t count;		// Of keys
+	int64_t bytes;		// Of keys and values
+	int64_t sum;		// Of the values as little endian 64 bit integers, with shorter values extended with zero bytes and longer ones truncated, as add does
+	Key end;			// The aggregates are of [keys.begin, end), which is less than keys if it was too much to read at once
+
+	GetRangeAggregateReply() : count(0), bytes(0), sum(0) {}
+	void add( KeyValueRef const& kv ) {
+		uint64_t value = 0;
+		memcpy( &value, kv.value.begin(), std::min<int>( kv.value.size(), sizeof(value) ) );
+		++count;
+		bytes += kv.key.size() + kv.value.size();
+		sum += (int64_t)littleEndian64( value );
+	}
+	void add( GetRangeAggregateReply const& r ) {
+		count += r.count;
+		bytes += r.bytes;
+		sum += r.sum;
+	}
+
+	template <class Ar>
+	void serialize( Ar& ar ) {
+		ar & *(LoadBalancedReply*)this & count & bytes & sum & end;
+	}
+};
+
+// Asks a storage server for the number of keys in keys at version, their size and the sum of their values, so that
+// aggregating a range does not have to send all of it to the client.  keys must begin in a shard which the server can read.
+struct GetRangeAggregateRequest {
+	Arena arena;
+	KeyRangeRef keys;
+	Version version;
+	ReplyPromise<GetRangeAggregateReply> reply;
+
+	GetRangeAggregateRequest() : version(invalidVersion) {}
+	GetRangeAggregateRequest( KeyRangeRef const& keys, Version version ) : keys( arena, keys ), version(version) {}
+	template <class Ar>
+	void serialize( Ar& ar ) {
+		ar & keys & version & reply & arena;
+	}
+};
+
+// The digest of the key values in a chunk of a range, which begins where the previous chunk ended
+struct RangeDigestRef {
+	KeyRef end;
+	uint64_t digest;
+	int count;			// Of keys
+	int64_t bytes;		// Of keys and values
+
+	RangeDigestRef() : digest(0), count(0), bytes(0) {}
+	RangeDigestRef( Arena& to, RangeDigestRef const& from ) : end(to, from.end), digest(from.digest), count(from.count), bytes(from.bytes) {}
+	int expectedSize() const { return end.expectedSize(); }
+	bool operator == ( RangeDigestRef const& r ) const { return end == r.end && digest == r.digest && count == r.count && bytes == r.bytes; }
+	bool operator != ( RangeDigestRef const& r ) const { return !(*this == r); }
+
+	template <class Ar>
+	void serialize( Ar& ar ) {
+		ar & end & digest & count & bytes;
+	}
+};
+
+struct GetRangeDigestReply : public LoadBalancedReply {
+	Arena arena;
+	VectorRef<RangeDigestRef> chunks;	// Cover [keys.begin, chunks.back().end), which is less than keys if it was too much to read at once
+
+	template <class Ar>
+	void serialize( Ar& ar ) {
+		ar & *(LoadBalancedReply*)this & chunks & arena;
+	}
+};
+
+// Asks a storage server for digests of the key values in keys at version, so that replicas can be compared without sending
+// their data.  A chunk ends after a key whose hash is a multiple of chunkKeys, or once it holds chunkBytes, so that the
+// chunks of replicas which differ in a few keys still line up before and after them.  keys must begin in a shard which the
+// server can read.
+struct GetRangeDigestRequest {
+	Arena arena;
+	KeyRangeRef keys;
+	Version version;
+	int chunkKeys, chunkBytes;
+	ReplyPromise<GetRangeDigestReply> reply;
+
+	GetRangeDigestRequest() : version(invalidVersion), chunkKeys(0), chunkBytes(0) {}
+	GetRangeDigestRequest( KeyRangeRef const& keys, Version version, int chunkKeys, int chunkBytes ) : keys( arena, keys ), version(version), chunkKeys(chunkKeys), chunkBytes(chunkBytes) {}
+	template <class Ar>
+	void serialize( Ar& ar ) {
+		ar & keys & version & chunkKeys & chunkBytes & reply & arena;
+	}
+};
+
+// A range which a storage server has seen many bytes read from or written to, as estimated by sampling
+struct HotRangeRef {
+	KeyRangeRef range;
+	double bytesPerSecond;		// May be more than the true rate by up to errorBytesPerSecond
+	double errorBytesPerSecond;
+
+	HotRangeRef() : bytesPerSecond(0), errorBytesPerSecond(0) {}
+	HotRangeRef( KeyRangeRef const& range, double bytesPerSecond, double errorBytesPerSecond ) : range(range), bytesPerSecond(bytesPerSecond), errorBytesPerSecond(errorBytesPerSecond) {}
+	HotRangeRef( Arena& to, HotRangeRef const& from ) : range(to, from.range), bytesPerSecond(from.bytesPerSecond), errorBytesPerSecond(from.errorBytesPerSecond) {}
+	int expectedSize() const { return range.expectedSize(); }
+
+	template <class Ar>
+	void serialize( Ar& ar ) {
+		ar & range & bytesPerSecond & errorBytesPerSecond;
+	}
+};
+
+struct GetHotRangesReply {
+	Arena arena;
+	VectorRef<HotRangeRef> reads, writes;	// Hottest first.  A point read or write is of the range [key, keyAfter(key))
+	double seconds;		// The read rates are averages over this long, which may differ a little for the write rates
+
+	GetHotRangesReply() : seconds(0) {}
+	template <class Ar>
+	void serialize( Ar& ar ) {
+		ar & reads & writes & seconds & arena;
+	}
+};
+
+// Asks a storage server for at most limit of the hottest ranges it has read and written over the last HOT_RANGE_WINDOW
+struct GetHotRangesRequest {
+	int limit;
+	ReplyPromise<GetHotRangesReply> reply;
+
+	GetHotRangesRequest() : limit(0) {}
+	explicit GetHotRangesRequest( int limit ) : limit(limit) {}
+	template <class Ar>
+	void serialize( Ar& ar ) {
+		ar & limit & reply;
+	}
+};
+
+struct VersionedMutationRef {
+	Version version;
+	MutationRef mutation;
+
+	VersionedMutationRef() : version(invalidVersion) {}
+	VersionedMutationRef( Arena& to, Version version, MutationRef const& mutation ) : version(version), mutation( to, mutation ) {}
+	VersionedMutationRef( Arena& to, VersionedMutationRef const& from ) : version(from.version), mutation( to, from.mutation ) {}
+	int expectedSize() const { return mutation.expectedSize(); }
+
+	template <class Ar>
+	void serialize( Ar& ar ) {
+		ar & version & mutation;
+	}
+};
+
+struct ChangeFeedReply {
+	Arena arena;
+	VectorRef<VersionedMutationRef> mutations;	// In version order, with clears limited to the requested range
+	Version version;	// Every mutation to the range at a version in (begin, version] has been returned
+
+	ChangeFeedReply() : version(invalidVersion) {}
+	template <class Ar>
+	void serialize( Ar& ar ) {
+		ar & mutations & version & arena;
+	}
+};
+
+// Asks a storage server for the mutations to range at versions after begin, so that a client can follow the changes to a
+// range by asking again from the version of each reply.  If there are none yet, the reply waits for them for a while.
+// range must be within one shard which the server can read, and begin must be within the MVCC window and no earlier
+// than when the server began reading the shard, or the request fails with transaction_too_old.
+struct ChangeFeedRequest {
+	Arena arena;
+	KeyRangeRef range;
+	Version begin;
+	ReplyPromise<ChangeFeedReply> reply;
+
+	ChangeFeedRequest() : begin(invalidVersion) {}
+	template <class Ar>
+	void serialize( Ar& ar ) {
+		ar & range & begin & reply & arena;
 	}
 };
 
@@ -215,35 +554,45 @@ struct StorageMetrics {
 	int64_t bytes;				// total storage
 	int64_t bytesPerKSecond;	// network bandwidth (average over 10s)
 	int64_t iosPerKSecond;
+	int64_t bytesReadPerKSecond;	// bytes read by clients
 
 	static const int64_t infinity = 1LL<<60;
 
-	StorageMetrics() : bytes(0), bytesPerKSecond(0), iosPerKSecond(0) {}
+	StorageMetrics() : bytes(0), bytesPerKSecond(0), iosPerKSecond(0), bytesReadPerKSecond(0) {}
 
 	bool allLessOrEqual( const StorageMetrics& rhs ) const {
-		return bytes <= rhs.bytes && bytesPerKSecond <= rhs.bytesPerKSecond && iosPerKSecond <= rhs.iosPerKSecond;
+		return bytes <= rhs.bytes && bytesPerKSecond <= rhs.bytesPerKSecond && iosPerKSecond <= rhs.iosPerKSecond &&
+			bytesReadPerKSecond <= rhs.bytesReadPerKSecond;
 	}
 	void operator += ( const StorageMetrics& rhs ) {
 		bytes += rhs.bytes;
 		bytesPerKSecond += rhs.bytesPerKSecond;
 		iosPerKSecond += rhs.iosPerKSecond;
+		bytesReadPerKSecond += rhs.bytesReadPerKSecond;
 	}
 	void operator -= ( const StorageMetrics& rhs ) {
 		bytes -= rhs.bytes;
 		bytesPerKSecond -= rhs.bytesPerKSecond;
 		iosPerKSecond -= rhs.iosPerKSecond;
+		bytesReadPerKSecond -= rhs.bytesReadPerKSecond;
 	}
 	template <class F>
 	void operator *= ( F f ) {
 		bytes *= f;
 		bytesPerKSecond *= f;
 		iosPerKSecond *= f;
+		bytesReadPerKSecond *= f;
 	}
-	bool allZero() const { return !bytes && !bytesPerKSecond && !iosPerKSecond; }
+	bool allZero() const { return !bytes && !bytesPerKSecond && !iosPerKSecond && !bytesReadPerKSecond; }
 
 	template <class Ar>
 	void serialize( Ar& ar ) {
 		ar & bytes & bytesPerKSecond & iosPerKSecond;
+		if( ar.protocolVersion() >= 0x0FDB00A560040001LL ) {
+			ar & bytesReadPerKSecond;
+		} else if( ar.isDeserializing ) {
+			bytesReadPerKSecond = 0;
+		}
 	}
 
 	void negate() { operator*=(-1.0); }
@@ -253,11 +602,12 @@ struct StorageMetrics {
 	template <class F> StorageMetrics operator * ( F f ) const { StorageMetrics x(*this); x*=f; return x; }
 
 	bool operator == ( StorageMetrics const& rhs ) const {
-		return bytes == rhs.bytes && bytesPerKSecond == rhs.bytesPerKSecond && iosPerKSecond == rhs.iosPerKSecond;
+		return bytes == rhs.bytes && bytesPerKSecond == rhs.bytesPerKSecond && iosPerKSecond == rhs.iosPerKSecond &&
+			bytesReadPerKSecond == rhs.bytesReadPerKSecond;
 	}
 
 	std::string toString() const {
-		return format("Bytes: %lld, BPerKSec: %lld, iosPerKSec: %lld", bytes, bytesPerKSecond, iosPerKSecond);
+		return format("Bytes: %lld, BPerKSec: %lld, iosPerKSec: %lld, BReadPerKSec: %lld", bytes, bytesPerKSecond, iosPerKSecond, bytesReadPerKSecond);
 	}
 };
 
@@ -281,6 +631,56 @@ struct WaitMetricsRequest {
 	}
 };
 
+// One wait of a WaitMetricsBatchRequest: like a WaitMetricsRequest, identified within its subscription by id
+struct MetricsWaitRef {
+	int64_t id;
+	KeyRangeRef keys;
+	StorageMetrics min, max;
+
+	MetricsWaitRef() : id(0) {}
+	MetricsWaitRef( int64_t id, KeyRangeRef const& keys, StorageMetrics const& min, StorageMetrics const& max ) : id(id), keys(keys), min(min), max(max) {}
+	MetricsWaitRef( Arena& a, MetricsWaitRef const& copyFrom ) : id(copyFrom.id), keys(a, copyFrom.keys), min(copyFrom.min), max(copyFrom.max) {}
+
+	int expectedSize() const { return keys.expectedSize(); }
+
+	template <class Ar>
+	void serialize( Ar& ar ) {
+		ar & id & keys & min & max;
+	}
+};
+
+struct WaitMetricsBatchReply {
+	std::vector<std::pair<int64_t, StorageMetrics>> changed;	// The waits whose metrics left their bounds or timed out
+	std::vector<int64_t> notReadable;	// The waits whose keys the server no longer has (wrong_shard_server)
+	bool lost;	// The server does not know the subscription, and none of its waits: the next request has to replace them
+
+	WaitMetricsBatchReply() : lost(false) {}
+
+	template <class Ar>
+	void serialize( Ar& ar ) {
+		ar & changed & notReadable & lost;
+	}
+};
+
+struct WaitMetricsBatchRequest {
+	// The storage server keeps the waits of a subscription between its requests.  A request adds and removes waits (or
+	// with replace, starts over with just its own), and returns once any of the subscription's waits is answered, which
+	// also removes it.  A later request for the subscription makes the server return from an outstanding one at once.
+	Arena arena;
+	UID subscription;
+	bool replace;
+	VectorRef<MetricsWaitRef> add;
+	std::vector<int64_t> remove;
+	ReplyPromise<WaitMetricsBatchReply> reply;
+
+	WaitMetricsBatchRequest() : replace(false) {}
+
+	template <class Ar>
+	void serialize( Ar& ar ) {
+		ar & subscription & replace & add & remove & reply & arena;
+	}
+};
+
 struct SplitMetricsReply {
 	Standalone<VectorRef<KeyRef>> splits;
 	StorageMetrics used;
@@ -346,10 +746,20 @@ struct StorageQueuingMetricsReply {
 	StorageBytes storageBytes;
 	double readReplyRate; // for status
 	Version v; // current storage server version
+	Version durableVersion;
+	double cpuUsage;  // CPU seconds per second used by the storage server process
+
+	StorageQueuingMetricsReply() : durableVersion(invalidVersion), cpuUsage(0) {}
 
 	template <class Ar>
 	void serialize(Ar& ar) {
 		ar & localTime & instanceID & bytesDurable & bytesInput & readReplyRate & v & storageBytes;
+		if( ar.protocolVersion() >= 0x0FDB00A560050001LL ) {
+			ar & durableVersion & cpuUsage;
+		} else if( ar.isDeserializing ) {
+			durableVersion = invalidVersion;
+			cpuUsage = 0;
+		}
 	}
 };
 
@@ -129,13 +129,23 @@ unsigned int Task::getPriority() const {
 
 class TaskBucketImpl {
 public:
+	// Returns a random task UID within the partition of the UID space that this TaskBucket prefers
+	static Standalone<StringRef> randomUIDInPartition(Reference<TaskBucket> taskBucket) {
+		// UIDs are 32 lowercase hex digits, so the first 4 of them choose the partition
+		int partitions = std::min(std::max(CLIENT_KNOBS->TASKBUCKET_PARTITIONS, 1), 65536);
+		int partition = taskBucket->partition % partitions;
+		int prefix = g_random->randomInt(partition * 65536 / partitions, (partition + 1) * 65536 / partitions);
+		return StringRef(format("%04x", prefix) + g_random->randomUniqueID().toString().substr(4));
+	}
+
 	ACTOR static Future<Optional<Key>> getTaskKey(Reference<ReadYourWritesTransaction> tr, Reference<TaskBucket> taskBucket, int priority = 0) {
-		Standalone<StringRef> uid = StringRef(g_random->randomUniqueID().toString());
+		Standalone<StringRef> uid = randomUIDInPartition(taskBucket);
 
 		// Get keyspace for the specified priority level
 		state Subspace space = taskBucket->getAvailableSpace(priority);
 
-		// Get a task key that is <= a random UID task key, if successful then return it
+		// Get a task key that is <= a random UID task key in this bucket's partition, if successful then return it.  This
+		// finds a task from a lower partition if there is none below the UID in our own.
 		Key k = wait(tr->getKey(lastLessOrEqual(space.pack(uid)), true));
 		if(space.contains(k))
 			return Optional<Key>(k);
@@ -409,6 +419,38 @@ public:
 		return true;
 	}
 
+	// Returns when the bucket's task count changes, which it does whenever a task is added or finished, or after a long
+	// fallback poll interval since tasks whose scheduled version has arrived or whose timeout has expired become available
+	// without changing the count.  Once the watch fires, waits a random part of pollDelay so that the agents waiting on
+	// the same watch do not all look for the new task at once.
+	ACTOR static Future<Void> watchForTasks(Database cx, Reference<TaskBucket> taskBucket, double pollDelay) {
+		state Future<Void> fallback = delay(pollDelay * CLIENT_KNOBS->TASKBUCKET_IDLE_POLL_MULTIPLIER * (0.9 + g_random->random01() / 5));
+		state Reference<ReadYourWritesTransaction> tr(new ReadYourWritesTransaction(cx));
+		try {
+			taskBucket->setOptions(tr);
+			state Future<Void> watchTaskCountFuture = taskBucket->watchTaskCount(tr);
+			Void _ = wait(tr->commit());
+			choose {
+				when(Void _ = wait(watchTaskCountFuture)) {
+					Void _ = wait(delay(pollDelay * g_random->random01()));
+					return Void();
+				}
+				when(Void _ = wait(fallback)) {
+					return Void();
+				}
+			}
+		}
+		catch (Error &e) {
+			if(e.code() == error_code_actor_cancelled)
+				throw;
+			// Without the watch, just poll
+			TEST(true); // TaskBucket watch for new tasks failed
+		}
+
+		Void _ = wait(fallback);
+		return Void();
+	}
+
 	ACTOR static Future<Void> dispatch(Database cx, Reference<TaskBucket> taskBucket, Reference<FutureBucket> futureBucket, double *pollDelay, int maxConcurrentTasks) {
 		state std::vector<Future<bool>> tasks(maxConcurrentTasks);
 		for(auto &f : tasks)
@@ -422,6 +464,7 @@ public:
 
 		state std::vector<Future<Reference<Task>>> getTasks;
 		state unsigned int getBatchSize = 1;
+		state Future<Void> tasksChanged;
 
 		loop {
 			// Start running tasks while slots are available and we keep finding work to do
@@ -456,10 +499,14 @@ public:
 					getBatchSize = std::min<unsigned int>(getBatchSize * 2, maxConcurrentTasks);
 			}
 			
-			// Wait for a task to be done.  Also, if we have any slots available then stop waiting after pollDelay at the latest.
+			// Wait for a task to be done.  Also, if we have any slots available then stop waiting once there may be a new task
+			// available.  The watch is kept across waits that end because one of our own tasks finished.
 			Future<Void> w = ready(waitForAny(tasks));
-			if(!availableSlots.empty())
-				w = w || delay(*pollDelay * (0.9 + g_random->random01() / 5));   // Jittered by 20 %, so +/- 10%
+			if(!availableSlots.empty()) {
+				if(!tasksChanged.isValid() || tasksChanged.isReady())
+					tasksChanged = watchForTasks(cx, taskBucket, *pollDelay);
+				w = w || tasksChanged;
+			}
 			Void _ = wait(w);
 
 			// Check all of the task slots, any that are finished should be replaced with Never() and their slots added back to availableSlots
@@ -773,6 +820,7 @@ TaskBucket::TaskBucket(const Subspace& subspace, bool sysAccess, bool priorityBa
 	, system_access(sysAccess)
 	, priority_batch(priorityBatch)
 	, lock_aware(lockAware)
+	, partition(g_random->randomInt(0, 65536))
 {
 }
 
@@ -249,6 +249,11 @@ private:
 	bool system_access;
 	bool priority_batch;
 	bool lock_aware;
+
+	// Task UIDs are random, so the available spaces are divided into TASKBUCKET_PARTITIONS equal ranges of UIDs without
+	// changing how they are stored.  Each TaskBucket instance looks for tasks in its own range first, so concurrent
+	// agents mostly try to claim different tasks.
+	int partition;
 };
 
 class TaskFuture;
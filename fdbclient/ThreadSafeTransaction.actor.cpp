@@ -186,6 +186,32 @@ ThreadFuture< Standalone<RangeResultRef> > ThreadSafeTransaction::getRange( cons
 		} );
 }
 
+ACTOR static Future< Standalone<RangeResultRef> > getMulti( ReadYourWritesTransaction* tr, Standalone<VectorRef<KeyRef>> keys, bool snapshot ) {
+	state std::vector<Future<Optional<Value>>> values;
+	for(auto& k : keys)
+		values.push_back(tr->get(k, snapshot));
+
+	Void _ = wait(waitForAll(values));
+
+	Standalone<RangeResultRef> result;
+	for(int i = 0; i < keys.size(); i++) {
+		if(values[i].get().present())
+			result.push_back_deep(result.arena(), KeyValueRef(keys[i], values[i].get().get()));
+	}
+	return result;
+}
+
+ThreadFuture< Standalone<RangeResultRef> > ThreadSafeTransaction::getMulti( const VectorRef<KeyRef>& keys, bool snapshot ) {
+	Standalone<VectorRef<KeyRef>> k;
+	k.append_deep(k.arena(), keys.begin(), keys.size());
+
+	ReadYourWritesTransaction *tr = this->tr;
+	return onMainThread( [tr, k, snapshot]() -> Future< Standalone<RangeResultRef> > {
+			tr->checkDeferredError();
+			return ::getMulti(tr, k, snapshot);
+		} );
+}
+
 ThreadFuture<Standalone<VectorRef<const char*>>> ThreadSafeTransaction::getAddressesForKey( const KeyRef& key ) {
 	Key k = key;
 
@@ -224,6 +250,17 @@ void ThreadSafeTransaction::set( const KeyRef& key, const ValueRef& value ) {
 	onMainThreadVoid( [tr, k, v](){ tr->set(k, v); }, &tr->deferred_error );
 }
 
+void ThreadSafeTransaction::setMulti( const VectorRef<KeyValueRef>& kvs ) {
+	Standalone<VectorRef<KeyValueRef>> m;
+	m.append_deep(m.arena(), kvs.begin(), kvs.size());
+
+	ReadYourWritesTransaction *tr = this->tr;
+	onMainThreadVoid( [tr, m](){
+		for(auto& kv : m)
+			tr->set(kv.key, kv.value);
+	}, &tr->deferred_error );
+}
+
 void ThreadSafeTransaction::clear( const KeyRangeRef& range ) {
 	KeyRange r = range;
 
@@ -91,12 +91,14 @@ public:
 	}
 
 	ThreadFuture<Standalone<VectorRef<const char*>>> getAddressesForKey(const KeyRef& key);
+	ThreadFuture< Standalone<RangeResultRef> > getMulti( const VectorRef<KeyRef>& keys, bool snapshot = false );
 
 	void addReadConflictRange( const KeyRangeRef& keys );
 	void makeSelfConflicting();
 
 	void atomicOp( const KeyRef& key, const ValueRef& value, uint32_t operationType );
 	void set( const KeyRef& key, const ValueRef& value );
+	void setMulti( const VectorRef<KeyValueRef>& kvs );
 	void clear( const KeyRef& begin, const KeyRef& end);
 	void clear( const KeyRangeRef& range );
 	void clear( const KeyRef& key );
@@ -19,6 +19,88 @@
  */
 
 #include "Tuple.h"
+#include "flow/UnitTest.h"
+#include <math.h>
+
+static const uint8_t FLOAT_CODE = 0x20;
+static const uint8_t DOUBLE_CODE = 0x21;
+
+static Tuple::ElementType elementType(uint8_t code) {
+	if(code == '\x00') {
+		return Tuple::NULL_TYPE;
+	}
+	else if(code == '\x01') {
+		return Tuple::BYTES;
+	}
+	else if(code == '\x02') {
+		return Tuple::UTF8;
+	}
+	else if(code >= '\x0c' && code <= '\x1c') {
+		return Tuple::INT;
+	}
+	else if(code == FLOAT_CODE) {
+		return Tuple::FLOAT;
+	}
+	else if(code == DOUBLE_CODE) {
+		return Tuple::DOUBLE;
+	}
+	else {
+		throw invalid_tuple_data_type();
+	}
+}
+
+// The number of bytes in the big endian representation of magnitude, without leading zeros
+static int magnitudeBytes(uint64_t magnitude) {
+	if(!magnitude) {
+		return 0;
+	}
+#ifdef _WIN32
+	unsigned long i;
+	_BitScanReverse64(&i, magnitude);
+	return i / 8 + 1;
+#else
+	return (63 - __builtin_clzll(magnitude)) / 8 + 1;
+#endif
+}
+
+// p points at the type code of an INT element, followed by its bytes
+static int64_t decodeInt(const uint8_t* p) {
+	int len = int(p[0]) - 0x14;
+	bool neg = len < 0;
+	if(neg) {
+		len = -len;
+	}
+
+	uint64_t swap;
+	memset(&swap, neg ? 0xff : 0, 8 - len);
+	memcpy(((uint8_t*)&swap) + 8 - len, p + 1, len);
+	swap = bigEndian64(swap);
+
+	// A negative value is stored as the ones' complement of its magnitude
+	return neg ? int64_t(-(~swap)) : int64_t(swap);
+}
+
+// Floating point values are stored big endian with the sign bit flipped, or with all bits flipped if negative, so that
+// they sort in numeric order
+static float decodeFloat(const uint8_t* p) {
+	uint32_t bits;
+	memcpy(&bits, p + 1, sizeof(bits));
+	bits = bigEndian32(bits);
+	bits = (bits >> 31) ? bits ^ 0x80000000 : ~bits;
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+static double decodeDouble(const uint8_t* p) {
+	uint64_t bits;
+	memcpy(&bits, p + 1, sizeof(bits));
+	bits = bigEndian64(bits);
+	bits = (bits >> 63) ? bits ^ 0x8000000000000000ULL : ~bits;
+	double value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
 
 static size_t find_string_terminator(const StringRef data, size_t offset) {
 	size_t i = offset;
@@ -45,6 +127,12 @@ Tuple::Tuple(StringRef const& str) {
 		else if(data[i] == '\x00') {
 			i += 1;
 		}
+		else if(data[i] == FLOAT_CODE) {
+			i += 1 + sizeof(float);
+		}
+		else if(data[i] == DOUBLE_CODE) {
+			i += 1 + sizeof(double);
+		}
 		else {
 			throw invalid_tuple_data_type();
 		}
@@ -65,50 +153,20 @@ Tuple& Tuple::append(Tuple const& tuple) {
 	return *this;
 }
 
-Tuple& Tuple::append(StringRef const& str, bool utf8) {
+uint8_t* Tuple::appendSpace(int bytes) {
 	offsets.push_back(data.size());
+	int size = data.size();
+	data.resize(data.arena(), size + bytes);
+	return data.begin() + size;
+}
 
-	const uint8_t utfChar = uint8_t(utf8 ? '\x02' : '\x01');
-	data.append(data.arena(), &utfChar, 1);
-
-	size_t lastPos = 0;
-	for(size_t pos = 0; pos < str.size(); ++pos) {
-		if(str[pos] == '\x00') {
-			data.append(data.arena(), str.begin() + lastPos, pos - lastPos);
-			data.push_back(data.arena(), (uint8_t)'\x00');
-			data.push_back(data.arena(), (uint8_t)'\xff');
-			lastPos = pos + 1;
-		}
-	}
-
-	data.append(data.arena(), str.begin() + lastPos, str.size() - lastPos);
-	data.push_back(data.arena(), (uint8_t)'\x00');
-
+Tuple& Tuple::append(StringRef const& str, bool utf8) {
+	TupleWriter::write(appendSpace(TupleWriter::sizeOf(str)), str, utf8);
 	return *this;
 }
 
 Tuple& Tuple::append( int64_t value ) {
-	uint64_t swap = value;
-	bool neg = false;
-
-	offsets.push_back( data.size() );
-
-	if ( value < 0 ) {
-		value = ~(-value);
-		neg = true;
-	}
-
-	swap = bigEndian64(value);
-
-	for ( int i = 0; i < 8; i++ ) {
-		if ( ((uint8_t*)&swap)[i] != (neg ? 255 : 0) ) {
-			data.push_back( data.arena(), (uint8_t)(20 + (8-i) * (neg ? -1 : 1)) );
-			data.append( data.arena(), ((const uint8_t *)&swap) + i, 8 - i );
-			return *this;
-		}
-	}
-
-	data.push_back( data.arena(), (uint8_t)'\x14' );
+	TupleWriter::write(appendSpace(TupleWriter::sizeOf(value)), value);
 	return *this;
 }
 
@@ -118,28 +176,22 @@ Tuple& Tuple::appendNull() {
 	return *this;
 }
 
+Tuple& Tuple::appendFloat(float value) {
+	TupleWriter::write(appendSpace(TupleWriter::sizeOfFloat()), value);
+	return *this;
+}
+
+Tuple& Tuple::appendDouble(double value) {
+	TupleWriter::write(appendSpace(TupleWriter::sizeOfDouble()), value);
+	return *this;
+}
+
 Tuple::ElementType Tuple::getType(size_t index) const {
 	if(index >= offsets.size()) {
 		throw invalid_tuple_index();
 	}
 
-	uint8_t code = data[offsets[index]];
-
-	if(code == '\x00') {
-		return ElementType::NULL_TYPE;
-	}
-	else if(code == '\x01') {
-		return ElementType::BYTES;
-	}
-	else if(code == '\x02') {
-		return ElementType::UTF8;
-	}
-	else if(code >= '\x0c' && code <= '\x1c') {
-		return ElementType::INT;
-	}
-	else {
-		throw invalid_tuple_data_type();
-	}
+	return elementType(data[offsets[index]]);
 }
 
 Standalone<StringRef> Tuple::getString(size_t index) const {
@@ -188,32 +240,35 @@ int64_t Tuple::getInt(size_t index) const {
 		throw invalid_tuple_index();
 	}
 
-	int64_t swap;
-	bool neg = false;
-
 	ASSERT(offsets[index] < data.size());
 	uint8_t code = data[offsets[index]];
 	if(code < '\x0c' || code > '\x1c') {
 		throw invalid_tuple_data_type();
 	}
 
-	int8_t len = code - '\x14';
+	return decodeInt(data.begin() + offsets[index]);
+}
 
-	if ( len < 0 ) {
-		len = -len;
-		neg = true;
+float Tuple::getFloat(size_t index) const {
+	if(index >= offsets.size()) {
+		throw invalid_tuple_index();
+	}
+	if(data[offsets[index]] != FLOAT_CODE || offsets[index] + TupleWriter::sizeOfFloat() > data.size()) {
+		throw invalid_tuple_data_type();
 	}
 
-	memset( &swap, neg ? '\xff' : 0, 8 - len );
-	memcpy( ((uint8_t*)&swap) + 8 - len, data.begin() + offsets[index] + 1, len );
-
-	swap = bigEndian64( swap );
+	return decodeFloat(data.begin() + offsets[index]);
+}
 
-	if ( neg ) {
-		swap = -(~swap);
+double Tuple::getDouble(size_t index) const {
+	if(index >= offsets.size()) {
+		throw invalid_tuple_index();
+	}
+	if(data[offsets[index]] != DOUBLE_CODE || offsets[index] + TupleWriter::sizeOfDouble() > data.size()) {
+		throw invalid_tuple_data_type();
 	}
 
-	return swap;
+	return decodeDouble(data.begin() + offsets[index]);
 }
 
 KeyRange Tuple::range(Tuple const& tuple) const {
@@ -244,3 +299,334 @@ Tuple Tuple::subTuple(size_t start, size_t end) const {
 	size_t endPos = end < offsets.size() ? offsets[end] : data.size();
 	return Tuple(StringRef(data.begin() + offsets[start], endPos - offsets[start]));
 }
+
+TupleWriter::TupleWriter( Arena& arena, int elementBytes, StringRef const& prefix ) {
+	begin = new (arena) uint8_t[prefix.size() + elementBytes];
+	memcpy(begin, prefix.begin(), prefix.size());
+	out = begin + prefix.size();
+	end = out + elementBytes;
+}
+
+int TupleWriter::sizeOf( int64_t value ) {
+	return 1 + magnitudeBytes(value < 0 ? -uint64_t(value) : uint64_t(value));
+}
+
+int TupleWriter::sizeOf( StringRef const& str ) {
+	// Each null is escaped as \x00\xff, and the string is terminated with a null
+	int size = 2 + str.size();
+	const uint8_t* p = str.begin();
+	while(const uint8_t* null = (const uint8_t*)memchr(p, 0, str.end() - p)) {
+		size++;
+		p = null + 1;
+	}
+	return size;
+}
+
+StringRef TupleWriter::finish() const {
+	ASSERT(out == end);
+	return StringRef(begin, end - begin);
+}
+
+uint8_t* TupleWriter::write( uint8_t* out, int64_t value ) {
+	bool neg = value < 0;
+	uint64_t magnitude = neg ? -uint64_t(value) : uint64_t(value);
+	int len = magnitudeBytes(magnitude);
+
+	*out++ = uint8_t(0x14 + (neg ? -len : len));
+	uint64_t swap = bigEndian64(neg ? ~magnitude : magnitude);
+	memcpy(out, ((const uint8_t*)&swap) + 8 - len, len);
+	return out + len;
+}
+
+uint8_t* TupleWriter::write( uint8_t* out, StringRef const& str, bool utf8 ) {
+	*out++ = uint8_t(utf8 ? '\x02' : '\x01');
+
+	const uint8_t* p = str.begin();
+	while(const uint8_t* null = (const uint8_t*)memchr(p, 0, str.end() - p)) {
+		memcpy(out, p, null + 1 - p);
+		out += null + 1 - p;
+		*out++ = 0xff;
+		p = null + 1;
+	}
+	memcpy(out, p, str.end() - p);
+	out += str.end() - p;
+
+	*out++ = 0x00;
+	return out;
+}
+
+uint8_t* TupleWriter::write( uint8_t* out, float value ) {
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	bits = bigEndian32((bits >> 31) ? ~bits : bits ^ 0x80000000);
+
+	*out++ = FLOAT_CODE;
+	memcpy(out, &bits, sizeof(bits));
+	return out + sizeof(bits);
+}
+
+uint8_t* TupleWriter::write( uint8_t* out, double value ) {
+	uint64_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	bits = bigEndian64((bits >> 63) ? ~bits : bits ^ 0x8000000000000000ULL);
+
+	*out++ = DOUBLE_CODE;
+	memcpy(out, &bits, sizeof(bits));
+	return out + sizeof(bits);
+}
+
+uint8_t TupleReader::code() const {
+	if(done()) {
+		throw invalid_tuple_index();
+	}
+	return data[pos];
+}
+
+Tuple::ElementType TupleReader::type() const {
+	return elementType(code());
+}
+
+int TupleReader::stringEnd() const {
+	int i = pos + 1;
+	loop {
+		const uint8_t* null = (const uint8_t*)memchr(data.begin() + i, 0, data.size() - i);
+		if(!null) {
+			throw invalid_tuple_data_type();
+		}
+		i = null - data.begin();
+		if(i + 1 < data.size() && data[i+1] == 0xff) {
+			i += 2;
+		} else {
+			return i;
+		}
+	}
+}
+
+int64_t TupleReader::readInt() {
+	uint8_t c = code();
+	if(c < '\x0c' || c > '\x1c' || pos + 1 + abs(int(c) - 0x14) > data.size()) {
+		throw invalid_tuple_data_type();
+	}
+	int64_t value = decodeInt(data.begin() + pos);
+	pos += 1 + abs(int(c) - 0x14);
+	return value;
+}
+
+StringRef TupleReader::readString( Arena& arena ) {
+	uint8_t c = code();
+	if(c != '\x01' && c != '\x02') {
+		throw invalid_tuple_data_type();
+	}
+	int e = stringEnd();
+	StringRef escaped = data.substr(pos + 1, e - pos - 1);
+	pos = e + 1;
+
+	if(!memchr(escaped.begin(), 0, escaped.size())) {
+		return escaped;
+	}
+
+	uint8_t* unescaped = new (arena) uint8_t[escaped.size()];
+	int size = 0;
+	for(int i = 0; i < escaped.size(); i++) {
+		unescaped[size++] = escaped[i];
+		if(escaped[i] == '\x00') {
+			i++;
+		}
+	}
+	return StringRef(unescaped, size);
+}
+
+float TupleReader::readFloat() {
+	if(code() != FLOAT_CODE || pos + TupleWriter::sizeOfFloat() > data.size()) {
+		throw invalid_tuple_data_type();
+	}
+	float value = decodeFloat(data.begin() + pos);
+	pos += TupleWriter::sizeOfFloat();
+	return value;
+}
+
+double TupleReader::readDouble() {
+	if(code() != DOUBLE_CODE || pos + TupleWriter::sizeOfDouble() > data.size()) {
+		throw invalid_tuple_data_type();
+	}
+	double value = decodeDouble(data.begin() + pos);
+	pos += TupleWriter::sizeOfDouble();
+	return value;
+}
+
+void TupleReader::readNull() {
+	if(code() != '\x00') {
+		throw invalid_tuple_data_type();
+	}
+	pos++;
+}
+
+void TupleReader::skip() {
+	switch(type()) {
+	case Tuple::NULL_TYPE:
+		pos++;
+		break;
+	case Tuple::INT:
+		readInt();
+		break;
+	case Tuple::BYTES:
+	case Tuple::UTF8:
+		pos = stringEnd() + 1;
+		break;
+	case Tuple::FLOAT:
+		readFloat();
+		break;
+	case Tuple::DOUBLE:
+		readDouble();
+		break;
+	}
+}
+
+TEST_CASE("fdbclient/Tuple/writer") {
+	for(int test = 0; test < 1000; test++) {
+		Tuple t;
+		std::vector<int64_t> ints;
+		std::vector<Standalone<StringRef>> strings;
+		std::vector<double> doubles;
+		std::vector<int> types;
+		int size = 0;
+		for(int i = g_random->randomInt(0, 10); i > 0; i--) {
+			int type = g_random->randomInt(0, 4);
+			types.push_back(type);
+			if(type == 0) {
+				int64_t value = g_random->randomInt64(0, std::numeric_limits<int64_t>::max()) >> g_random->randomInt(0, 64);
+				if(g_random->coinflip()) {
+					value = g_random->coinflip() ? -value : ~value;
+				}
+				ints.push_back(value);
+				t.append(value);
+				size += TupleWriter::sizeOf(value);
+			} else if(type == 1) {
+				std::string str = g_random->randomAlphaNumeric(g_random->randomInt(0, 10));
+				for(auto& c : str) {
+					if(g_random->random01() < 0.2) {
+						c = g_random->coinflip() ? '\x00' : '\xff';
+					}
+				}
+				strings.push_back(StringRef(str));
+				t.append(strings.back());
+				size += TupleWriter::sizeOf(strings.back());
+			} else if(type == 2) {
+				doubles.push_back((g_random->random01() - 0.5) * pow(10, g_random->randomInt(-300, 300)));
+				t.appendDouble(doubles.back());
+				size += TupleWriter::sizeOfDouble();
+			} else {
+				t.appendNull();
+				size += TupleWriter::sizeOfNull();
+			}
+		}
+
+		Arena arena;
+		TupleWriter w(arena, size, LiteralStringRef("prefix"));
+		int nextInt = 0, nextString = 0, nextDouble = 0;
+		for(int type : types) {
+			if(type == 0) {
+				w.append(ints[nextInt++]);
+			} else if(type == 1) {
+				w.append(strings[nextString++]);
+			} else if(type == 2) {
+				w.appendDouble(doubles[nextDouble++]);
+			} else {
+				w.appendNull();
+			}
+		}
+		StringRef packed = w.finish();
+		ASSERT(packed == t.pack().withPrefix(LiteralStringRef("prefix")));
+
+		TupleReader r(packed.removePrefix(LiteralStringRef("prefix")));
+		Tuple unpacked = Tuple::unpack(t.pack());
+		ASSERT(unpacked.size() == types.size());
+		nextInt = nextString = nextDouble = 0;
+		for(int i = 0; i < types.size(); i++) {
+			ASSERT(r.type() == unpacked.getType(i));
+			if(types[i] == 0) {
+				ASSERT(unpacked.getInt(i) == ints[nextInt]);
+				if(g_random->coinflip()) {
+					ASSERT(r.readInt() == ints[nextInt]);
+				} else {
+					r.skip();
+				}
+				nextInt++;
+			} else if(types[i] == 1) {
+				ASSERT(unpacked.getString(i) == strings[nextString]);
+				ASSERT(r.readString(arena) == strings[nextString]);
+				nextString++;
+			} else if(types[i] == 2) {
+				ASSERT(unpacked.getDouble(i) == doubles[nextDouble]);
+				ASSERT(r.readDouble() == doubles[nextDouble]);
+				nextDouble++;
+			} else {
+				r.readNull();
+			}
+		}
+		ASSERT(r.done());
+	}
+
+	// Encoded integers and doubles sort in numeric order
+	int64_t ints[] = { std::numeric_limits<int64_t>::min(), -(1LL<<40), -256, -255, -1, 0, 1, 255, 256, 1LL<<40, std::numeric_limits<int64_t>::max() };
+	double doubles[] = { -std::numeric_limits<double>::infinity(), -1e300, -1.5, -0.0, 0.0, 1e-300, 2.5, 1e300, std::numeric_limits<double>::infinity() };
+	for(int i = 1; i < sizeof(ints) / sizeof(ints[0]); i++) {
+		ASSERT(Tuple().append(ints[i-1]).pack() < Tuple().append(ints[i]).pack());
+		ASSERT(Tuple::unpack(Tuple().append(ints[i]).pack()).getInt(0) == ints[i]);
+	}
+	for(int i = 1; i < sizeof(doubles) / sizeof(doubles[0]); i++) {
+		ASSERT(Tuple().appendDouble(doubles[i-1]).pack() < Tuple().appendDouble(doubles[i]).pack());
+	}
+	ASSERT(Tuple().appendFloat(-0.25f).pack() < Tuple().appendFloat(0.25f).pack());
+	ASSERT(Tuple::unpack(Tuple().appendFloat(-0.25f).pack()).getFloat(0) == -0.25f);
+
+	return Void();
+}
+
+TEST_CASE("fdbclient/perf/Tuple") {
+	const int keys = 1000000;
+	Standalone<StringRef> prefix = LiteralStringRef("\x15\x2a\x01zone\x00");
+	Standalone<StringRef> name = LiteralStringRef("some/object/name");
+	int64_t sink = 0;
+
+	double start = timer();
+	for(int i = 0; i < keys; i++) {
+		Tuple t;
+		t.append(i).append(name).append(int64_t(i) << 20);
+		sink += t.pack().withPrefix(prefix).size();
+	}
+	double tupleTime = timer() - start;
+
+	start = timer();
+	for(int i = 0; i < keys; i++) {
+		Arena arena;
+		TupleWriter w(arena, TupleWriter::sizeOf(i) + TupleWriter::sizeOf(name) + TupleWriter::sizeOf(int64_t(i) << 20), prefix);
+		sink += w.append(i).append(name).append(int64_t(i) << 20).finish().size();
+	}
+	double writerTime = timer() - start;
+
+	Tuple tuple;
+	tuple.append(12345).append(name).append(int64_t(12345) << 20);
+	StringRef packed = tuple.pack();
+	start = timer();
+	for(int i = 0; i < keys; i++) {
+		Tuple t = Tuple::unpack(packed);
+		sink += t.getInt(0) + t.getString(1).size() + t.getInt(2);
+	}
+	double unpackTime = timer() - start;
+
+	start = timer();
+	for(int i = 0; i < keys; i++) {
+		Arena arena;
+		TupleReader r(packed);
+		sink += r.readInt();
+		sink += r.readString(arena).size();
+		sink += r.readInt();
+	}
+	double readerTime = timer() - start;
+
+	printf("Tuple keys: pack %.0f ns, TupleWriter %.0f ns, unpack %.0f ns, TupleReader %.0f ns (%lld)\n",
+		tupleTime / keys * 1e9, writerTime / keys * 1e9, unpackTime / keys * 1e9, readerTime / keys * 1e9, (long long)(sink & 1));
+
+	return Void();
+}
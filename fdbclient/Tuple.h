@@ -35,6 +35,8 @@ struct Tuple {
 	Tuple& append(StringRef const& str, bool utf8=false);
 	Tuple& append(int64_t);
 	Tuple& appendNull();
+	Tuple& appendFloat(float);
+	Tuple& appendDouble(double);
 
 	StringRef pack() const { return StringRef(data.begin(), data.size()); }
 
@@ -43,7 +45,7 @@ struct Tuple {
 		return append(t);
 	}
 
-	enum ElementType { NULL_TYPE, INT, BYTES, UTF8 };
+	enum ElementType { NULL_TYPE, INT, BYTES, UTF8, FLOAT, DOUBLE };
 
 	// this is number of elements, not length of data
 	size_t size() const { return offsets.size(); }
@@ -51,6 +53,8 @@ struct Tuple {
 	ElementType getType(size_t index) const;
 	Standalone<StringRef> getString(size_t index) const;
 	int64_t getInt(size_t index) const;
+	float getFloat(size_t index) const;
+	double getDouble(size_t index) const;
 
 	KeyRange range(Tuple const& tuple = Tuple()) const;
 
@@ -60,6 +64,69 @@ private:
 	Tuple(const StringRef& data);
 	Standalone<VectorRef<uint8_t>> data;
 	std::vector<size_t> offsets;
+
+	uint8_t* appendSpace(int bytes);
+};
+
+// Packs tuple elements straight into one allocation in an arena, with no intermediate Tuple.  The caller passes the
+// total encoded size of the elements, from the sizeOf functions, and appends exactly those elements:
+//   TupleWriter w( arena, TupleWriter::sizeOf(id) + TupleWriter::sizeOf(name), prefix );
+//   KeyRef key = w.append(id).append(name).finish();
+// The encoding is the same as Tuple's.
+struct TupleWriter {
+	TupleWriter( Arena& arena, int elementBytes, StringRef const& prefix = StringRef() );
+
+	static int sizeOf( int64_t value );
+	static int sizeOf( StringRef const& str );  // A BYTES or UTF8 element
+	static int sizeOfNull() { return 1; }
+	static int sizeOfFloat() { return 1 + sizeof(float); }
+	static int sizeOfDouble() { return 1 + sizeof(double); }
+
+	TupleWriter& append( int64_t value ) { out = write( out, value ); return *this; }
+	TupleWriter& append( StringRef const& str, bool utf8 = false ) { out = write( out, str, utf8 ); return *this; }
+	TupleWriter& appendNull() { *out++ = 0x00; return *this; }
+	TupleWriter& appendFloat( float value ) { out = write( out, value ); return *this; }
+	TupleWriter& appendDouble( double value ) { out = write( out, value ); return *this; }
+
+	// The prefix and the elements, which must have filled exactly elementBytes
+	StringRef finish() const;
+
+	// Each writes one element at out, which must have room for its sizeOf(), and returns the end of what it wrote
+	static uint8_t* write( uint8_t* out, int64_t value );
+	static uint8_t* write( uint8_t* out, StringRef const& str, bool utf8 );
+	static uint8_t* write( uint8_t* out, float value );
+	static uint8_t* write( uint8_t* out, double value );
+
+private:
+	uint8_t* begin;
+	uint8_t* out;
+	uint8_t* end;
+};
+
+// Reads the elements of a packed tuple in place, in order, without copying it.  A string is returned as a view of the
+// packed data unless it has embedded nulls, whose escapes have to be removed in a copy.
+struct TupleReader {
+	explicit TupleReader( StringRef const& packed ) : data(packed), pos(0) {}
+
+	bool done() const { return pos == data.size(); }
+	Tuple::ElementType type() const;  // Of the next element
+
+	int64_t readInt();
+	StringRef readString( Arena& arena );  // A BYTES or UTF8 element; arena is used only for strings with nulls
+	float readFloat();
+	double readDouble();
+	void readNull();
+	void skip();
+
+	// The offset of the next element in the packed data
+	int position() const { return pos; }
+
+private:
+	StringRef data;
+	int pos;
+
+	uint8_t code() const;
+	int stringEnd() const;  // The offset of the terminator of the string element at pos
 };
 
 #endif /* FDBCLIENT_TUPLE_H */
@@ -29,20 +29,48 @@
 
 #include "flow/flow.h"
 
+// Releases the nodes of toFree, which must no longer be reachable from any version that can be read, a bounded number
+// at a time.  A node that is still referenced elsewhere (including from later in toFree) just loses the reference;
+// otherwise its children are queued before it is destroyed, so destroying a node never frees a whole subtree at once.
 ACTOR template <class Tree>
 Future<Void> deferredCleanupActor( std::vector<Tree> toFree, int taskID = 7000 ) {
 	state int freeCount = 0;
+	state int freedSinceYield = 0;
+	state int maxFreedPerYield = 0;
+	state int yields = 0;
+	state int nodeBytes = 0;
 	while (!toFree.empty()) {
 		Tree a = std::move( toFree.back() );
 		toFree.pop_back();
 
+		if (!a || !a->isSoleOwner())
+			continue;
+
 		for(int c=0; c<3; c++) {
-			if (a->pointer[c] && a->pointer[c]->isSoleOwner())
+			if (a->pointer[c])
 				toFree.push_back( std::move(a->pointer[c]) );
 		}
+		nodeBytes = sizeof(*a);
+		++freedSinceYield;
+
+		if(++freeCount % 100 == 0) {
+			Future<Void> y = yield(taskID);
+			if (!y.isReady()) {
+				maxFreedPerYield = std::max(maxFreedPerYield, freedSinceYield);
+				freedSinceYield = 0;
+				++yields;
+			}
+			Void _ = wait( y );
+		}
+	}
 
-		if(++freeCount % 100 == 0)
-			Void _ = wait( yield(taskID) );
+	if (yields) {
+		maxFreedPerYield = std::max(maxFreedPerYield, freedSinceYield);
+		TraceEvent("VersionedMapDeferredCleanup").suppressFor(1.0)
+			.detail("NodesFreed", freeCount)
+			.detail("BytesFreed", (int64_t)freeCount * nodeBytes)
+			.detail("Yields", yields)
+			.detail("MaxBytesPerYield", (int64_t)maxFreedPerYield * nodeBytes);
 	}
 
 	return Void();
@@ -206,11 +206,17 @@ namespace PTreeImpl {
 		return f.back()->data;
 	}
 
-	// Modifies p to point to a PTree with x inserted
+	// Modifies p to point to a PTree with x inserted, replacing any element equal to x
 	template<class T>
 	void insert(Reference<PTree<T>>& p, Version at, const T& x) {
 		if (!p){
 			p = Reference<PTree<T>>(new PTree<T>(x, at));
+		} else if (!(x < p->data) && !(p->data < x)) {
+			// The replacement keeps the priority of the node it replaces, so the shape of the tree does not change
+			Reference<PTree<T>> r( new PTree<T>( p->priority, x, p->left(at), p->right(at), at ) );
+			if (p->lastUpdateVersion == at)
+				p->pointer[2].clear();  // As in update(), the aux pointer of a node replaced at its own version is never used again
+			p = r;
 		} else {
 			bool direction = !(x < p->data);
 			Reference<PTree<T>> child = p->child(direction, at);
@@ -514,11 +520,13 @@ public:
 		ASSERT( newOldestVersion <= latestVersion );
 		roots[newOldestVersion] = getRoot(newOldestVersion);
 
+		// Every forgotten root goes to the cleanup, including ones that share a tree with a neighbouring version, since
+		// dropping the last of those references here would free the whole tree without yielding
 		vector<Tree> toFree;
 		auto newBegin = roots.lower_bound(newOldestVersion);
 		for(auto root = roots.begin(); root != roots.end() && root != newBegin; ++root) {
-			if(root->second && root->second->isSoleOwner())
-				toFree.push_back(root->second);
+			if(root->second)
+				toFree.push_back(std::move(root->second));
 		}
 
 		roots.erase(roots.begin(), newBegin);
@@ -541,7 +549,6 @@ public:
 		insert( k, t, latestVersion );
 	}
 	void insert(const K& k, const T& t, Version insertAt) {
-		if (PTreeImpl::contains( *latestRoot, latestVersion, k )) PTreeImpl::remove( *latestRoot, latestVersion, k ); // FIXME: Make PTreeImpl::insert do this automatically  (see also WriteMap.h FIXME)
 		PTreeImpl::insert( *latestRoot, latestVersion, MapPair<K,std::pair<T,Version>>(k,std::make_pair(t,insertAt)) );
 	}
 	void erase(const K& begin, const K& end) {
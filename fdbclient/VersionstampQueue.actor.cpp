@@ -0,0 +1,112 @@
+/*
+ * VersionstampQueue.actor.cpp
+ *
+ * This source file is part of the FoundationDB open source project
+ *
+ * Copyright 2013-2018 Apple Inc. and the FoundationDB project authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "flow/actorcompiler.h"
+#include "VersionstampQueue.h"
+
+VersionstampQueue::VersionstampQueue( Key prefix, int shards ) : prefix(prefix), shards(shards) {
+	ASSERT( shards >= 1 && shards <= MAX_SHARDS );
+	ASSERT( prefix.size() + 1 <= std::numeric_limits<int16_t>::max() - POSITION_BYTES );
+}
+
+Key VersionstampQueue::shardPrefix( int shard ) const {
+	Key result = makeString( prefix.size() + 1 );
+	uint8_t* data = mutateString( result );
+	memcpy( data, prefix.begin(), prefix.size() );
+	data[prefix.size()] = shard;
+	return result;
+}
+
+void VersionstampQueue::push( Transaction* tr, VectorRef<ValueRef> const& values ) const {
+	ASSERT( values.size() <= std::numeric_limits<uint16_t>::max() + 1 );
+	Key shard = shardPrefix( g_random->randomInt(0, shards) );
+
+	// The key is followed by the little endian offset of the versionstamp, which the proxy fills in and removes
+	int16_t stampOffset = littleEndian16( int16_t(shard.size()) );
+	for(int i = 0; i < values.size(); i++) {
+		Key key = makeString( shard.size() + POSITION_BYTES + sizeof(stampOffset) );
+		uint8_t* data = mutateString( key );
+		memcpy( data, shard.begin(), shard.size() );
+		memset( data + shard.size(), 0, 10 );
+		uint16_t index = bigEndian16( uint16_t(i) );
+		memcpy( data + shard.size() + 10, &index, sizeof(index) );
+		memcpy( data + shard.size() + POSITION_BYTES, &stampOffset, sizeof(stampOffset) );
+		tr->atomicOp( key, values[i], MutationRef::SetVersionstampedKey );
+	}
+}
+
+ACTOR static Future<Standalone<RangeResultRef>> readQueue( Transaction* tr, std::vector<Key> shardPrefixes, Key after, int limit ) {
+	state std::vector<Future<Standalone<RangeResultRef>>> reads;
+	for(auto& shard : shardPrefixes) {
+		Key begin = after.size() ? keyAfter( after.withPrefix(shard) ) : shard;
+		reads.push_back( tr->getRange( KeyRangeRef(begin, strinc(shard)), limit, true ) );
+	}
+	Void _ = wait( waitForAll(reads) );
+
+	// A shard read that stopped short only covers the positions up to its last one, so items past the earliest such
+	// position may still be missing from other shards and are left for the next read
+	Optional<KeyRef> bound;
+	for(int s = 0; s < reads.size(); s++) {
+		Standalone<RangeResultRef> const& r = reads[s].get();
+		if( r.more && r.size() ) {
+			KeyRef last = r.end()[-1].key.removePrefix( shardPrefixes[s] );
+			if( !bound.present() || last < bound.get() )
+				bound = last;
+		}
+	}
+
+	Standalone<RangeResultRef> result;
+	bool truncated = false;
+	for(int s = 0; s < reads.size(); s++) {
+		Standalone<RangeResultRef> const& r = reads[s].get();
+		result.arena().dependsOn( r.arena() );
+		for(auto& kv : r) {
+			KeyRef position = kv.key.removePrefix( shardPrefixes[s] );
+			if( bound.present() && bound.get() < position ) {
+				truncated = true;
+				break;
+			}
+			result.push_back( result.arena(), KeyValueRef(position, kv.value) );
+		}
+		truncated = truncated || r.more;
+	}
+
+	std::sort( result.begin(), result.end(), KeyValueRef::OrderByKey() );
+	if( result.size() > limit ) {
+		result.resize( result.arena(), limit );
+		truncated = true;
+	}
+	result.more = truncated;
+	return result;
+}
+
+Future<Standalone<RangeResultRef>> VersionstampQueue::read( Transaction* tr, Key const& after, int limit ) const {
+	std::vector<Key> shardPrefixes;
+	for(int s = 0; s < shards; s++)
+		shardPrefixes.push_back( shardPrefix(s) );
+	return readQueue( tr, shardPrefixes, after, limit );
+}
+
+void VersionstampQueue::pop( Transaction* tr, KeyRef const& through ) const {
+	for(int s = 0; s < shards; s++) {
+		Key shard = shardPrefix(s);
+		tr->clear( KeyRangeRef( shard, keyAfter( through.withPrefix(shard) ) ) );
+	}
+}
@@ -0,0 +1,63 @@
+/*
+ * VersionstampQueue.h
+ *
+ * This source file is part of the FoundationDB open source project
+ *
+ * Copyright 2013-2018 Apple Inc. and the FoundationDB project authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FDBCLIENT_VERSIONSTAMPQUEUE_H
+#define FDBCLIENT_VERSIONSTAMPQUEUE_H
+#pragma once
+
+#include "NativeAPI.h"
+
+// A queue whose items are ordered by the versionstamps of the transactions that pushed them.  A push writes with
+// SetVersionstampedKey and reads nothing, so pushes never conflict with each other.  To keep them from all appending
+// at the tail of one key range, and so one storage team, the queue is split into shards by a byte after its prefix:
+// each push goes to a random shard, data distribution is free to place the shards on different teams, and read()
+// merges them back into versionstamp order.
+//
+// An item is stored at prefix + shard + position, where its position is the 10 byte versionstamp followed by its
+// 2 byte big endian index among the values of its push.  Positions of later commits sort after those of earlier ones,
+// so a reader resumes from the last position it returned.  read() is a snapshot read: consumers that must not both
+// take an item have to coordinate in some other way, e.g. by conflicting on a key holding their cursor.
+class VersionstampQueue {
+public:
+	enum { POSITION_BYTES = 12, MAX_SHARDS = 256 };
+
+	VersionstampQueue( Key prefix, int shards );
+
+	// Appends values to the queue, in order, when tr commits
+	void push( Transaction* tr, VectorRef<ValueRef> const& values ) const;
+
+	// Returns up to limit items, in queue order, whose positions come after `after` (empty for the front of the queue).
+	// Each item's key is its position.  more is set if there may be further items.
+	Future<Standalone<RangeResultRef>> read( Transaction* tr, Key const& after, int limit ) const;
+
+	// Removes the items up to and including the one at position `through`
+	void pop( Transaction* tr, KeyRef const& through ) const;
+
+	// The keys holding the queue
+	KeyRange range() const { return prefixRange(prefix); }
+
+private:
+	Key prefix;
+	int shards;
+
+	Key shardPrefix( int shard ) const;
+};
+
+#endif
@@ -128,58 +128,23 @@ public:
 		PTreeImpl::insert( writes, ver, WriteMapEntry( afterAllKeys, OperationStack(), false, false, false, false, false ) );
 	}
 
-	WriteMap(WriteMap&& r) noexcept(true) : writeMapEmpty(r.writeMapEmpty), writes(std::move(r.writes)), ver(r.ver), scratch_iterator(std::move(r.scratch_iterator)), arena(r.arena) {}
-	WriteMap& operator=(WriteMap&& r) noexcept(true) { writeMapEmpty = r.writeMapEmpty; writes = std::move(r.writes); ver = r.ver; scratch_iterator = std::move(r.scratch_iterator); arena = r.arena; return *this; }
+	WriteMap(WriteMap&& r) noexcept(true) : writeMapEmpty(r.writeMapEmpty), writes(std::move(r.writes)), ver(r.ver), pendingSets(std::move(r.pendingSets)), scratch_iterator(std::move(r.scratch_iterator)), arena(r.arena) {}
+	WriteMap& operator=(WriteMap&& r) noexcept(true) { writeMapEmpty = r.writeMapEmpty; writes = std::move(r.writes); ver = r.ver; pendingSets = std::move(r.pendingSets); scratch_iterator = std::move(r.scratch_iterator); arena = r.arena; return *this; }
 
 	//a write with addConflict false on top of an existing write with a conflict range will not remove the conflict
 	void mutate( KeyRef key, MutationRef::Type operation, ValueRef param, bool addConflict ) {
 		writeMapEmpty = false;
-		auto& it = scratch_iterator;
-		it.reset(writes, ver);
-		it.skip( key );
-		
-		bool is_cleared = it.entry().following_keys_cleared;
-		bool following_conflict = it.entry().following_keys_conflict;
-		bool is_conflict = addConflict || it.is_conflict_range();
-		bool following_unreadable = it.entry().following_keys_unreadable;
-		bool is_unreadable = it.is_unreadable() || operation == MutationRef::SetVersionstampedValue || operation == MutationRef::SetVersionstampedKey;
-		bool is_dependent = operation != MutationRef::SetValue && operation != MutationRef::SetVersionstampedValue && operation != MutationRef::SetVersionstampedKey;
-
-		if (it.entry().key != key) {
-			if( it.is_cleared_range() && is_dependent ) {
-				it.tree.clear();
-				OperationStack op( RYWMutation( Optional<StringRef>(), MutationRef::SetValue ) );
-				coalesceOver(op, RYWMutation(param, operation), *arena);
-				PTreeImpl::insert( writes, ver, WriteMapEntry( key, std::move(op), true, following_conflict, is_conflict, following_unreadable, is_unreadable ) );
-			} else {
-				it.tree.clear();
-				PTreeImpl::insert( writes, ver, WriteMapEntry( key, OperationStack( RYWMutation( param, operation ) ), is_cleared, following_conflict, is_conflict, following_unreadable, is_unreadable ) );
-			}
-		} else {
-			if( !it.is_unreadable() && operation == MutationRef::SetValue ) {
-				it.tree.clear();
-				PTreeImpl::remove( writes, ver, key );
-				PTreeImpl::insert( writes, ver, WriteMapEntry( key, OperationStack( RYWMutation( param, operation ) ), is_cleared, following_conflict, is_conflict, following_unreadable, is_unreadable ) );
-			} else {
-				WriteMapEntry e( it.entry() );
-				e.is_conflict = is_conflict;
-				e.is_unreadable = is_unreadable;
-				if (e.stack.size() == 0 && it.is_cleared_range() && is_dependent)  {
-					e.stack.push(RYWMutation(Optional<StringRef>(), MutationRef::SetValue));
-					coalesceOver(e.stack, RYWMutation(param, operation), *arena);
-				} else if( !is_unreadable && e.stack.size() > 0 )
-					coalesceOver( e.stack, RYWMutation( param, operation ), *arena );
-				else
-					e.stack.push( RYWMutation( param, operation ) );
-				
-				it.tree.clear();
-				PTreeImpl::remove( writes, ver, e.key ); // FIXME: Make PTreeImpl::insert do this automatically (see also VersionedMap.h FIXME)
-				PTreeImpl::insert( writes, ver, std::move(e) );
-			}
+		if( operation == MutationRef::SetValue ) {
+			pendingSets.push_back( PendingSet( key, param, addConflict ) );
+			return;
 		}
+
+		applyPendingSets();
+		applyMutation( key, operation, param, addConflict );
 	}
 
 	void clear( KeyRangeRef keys, bool addConflict ) {
+		applyPendingSets();
 		writeMapEmpty = false;
 		if( !addConflict ) {
 			clearNoConflict( keys );
@@ -216,6 +181,7 @@ public:
 	}
 
 	void addUnmodifiedAndUnreadableRange( KeyRangeRef keys ) {
+		applyPendingSets();
 		auto& it = scratch_iterator;
 		it.reset(writes, ver);
 		it.skip( keys.begin );
@@ -246,18 +212,15 @@ public:
 	}
 
 	void addConflictRange( KeyRangeRef keys ) {
+		applyPendingSets();
 		writeMapEmpty = false;
 		auto& it = scratch_iterator;
 		it.reset(writes, ver);
 		it.skip( keys.begin );
 
-		std::vector<ExtStringRef> removals;
-		std::vector<WriteMapEntry> insertions;
+		std::vector<WriteMapEntry> insertions;  // Each replaces any entry with the same key
 		
 		if( !it.entry().following_keys_conflict || !it.entry().is_conflict ) {
-			if( it.keyAtBegin() && it.beginKey() == keys.begin ) {
-				removals.push_back( keys.begin );
-			}
 			insertions.push_back( WriteMapEntry( keys.begin, it.is_operation() ? OperationStack( it.op() ) : OperationStack(), it.entry().following_keys_cleared, true, true, it.entry().following_keys_unreadable, it.entry().is_unreadable ) );
 		}
 
@@ -267,7 +230,6 @@ public:
 				WriteMapEntry e( it.entry() );
 				e.following_keys_conflict = true;
 				e.is_conflict = true;
-				removals.push_back( e.key );
 				insertions.push_back( std::move(e) );
 			}
 		}
@@ -286,11 +248,7 @@ public:
 
 		it.tree.clear();
 
-		//SOMEDAY: optimize this code by having a PTree removal/insertion that takes and returns an iterator
-		for( int i = 0; i < removals.size(); i++ ) {
-			PTreeImpl::remove( writes, ver, removals[i] ); // FIXME: Make PTreeImpl::insert do this automatically (see also VersionedMap.h FIXME)
-		}
-
+		//SOMEDAY: optimize this code by having a PTree insertion that takes and returns an iterator
 		for( int i = 0; i < insertions.size(); i++ ) {
 			PTreeImpl::insert( writes, ver, std::move(insertions[i]) );
 		}
@@ -301,7 +259,7 @@ public:
 		// Modified keys may be dependent (need to be collapsed with a snapshot value) or independent (value is known regardless of the snapshot value)
 		// Every key will belong to exactly one segment.  The first segment begins at "" and the last segment ends at \xff\xff.
 
-		explicit iterator( WriteMap* map ) : tree(map->writes), at( map->ver ), offset(false) { ++map->ver; }
+		explicit iterator( WriteMap* map ) : tree(map->appliedWrites()), at( map->ver ), offset(false) { ++map->ver; }
 			// Creates an iterator which is conceptually before the beginning of map (you may essentially only call skip() or ++ on it)
 			// This iterator also represents a snapshot (will be unaffected by future writes)
 
@@ -495,12 +453,31 @@ public:
 				throw operation_failed();
 			}
 		}
+		else if (newEntry.type == MutationRef::SetIfAbsent) {
+			switch (existingEntry.type) {
+			case MutationRef::SetValue:
+				return RYWMutation(doSetIfAbsent(existingEntry.value, newEntry.value.get(), arena), MutationRef::SetValue);
+			case MutationRef::SetIfAbsent:
+				return existingEntry;
+			default:
+				throw operation_failed();
+			}
+		}
+		else if (newEntry.type == MutationRef::CompareAndSet) {
+			// The result of one compare_and_set is not one over an unknown value, so CompareAndSets are not coalesced
+			switch (existingEntry.type) {
+			case MutationRef::SetValue:
+				return RYWMutation(doCompareAndSet(existingEntry.value, newEntry.value.get(), arena), MutationRef::SetValue);
+			default:
+				throw operation_failed();
+			}
+		}
 		else throw operation_failed();
 	}
 		
 	static void coalesceOver(OperationStack& stack, RYWMutation newEntry, Arena& arena) {
 		RYWMutation existingEntry = stack.top();
-		if (existingEntry.type == newEntry.type) {
+		if (existingEntry.type == newEntry.type && newEntry.type != MutationRef::CompareAndSet) {
 			if (isNonAssociativeOp(existingEntry.type) && existingEntry.value.present() && existingEntry.value.get().size() != newEntry.value.get().size()) {
 				stack.push(newEntry);
 			}
@@ -536,8 +513,85 @@ private:
 	bool writeMapEmpty;
 	Tree writes;
 	Version ver;  // an internal version number for the tree - no connection to database versions!  Currently this is incremented after reads, so that consecutive writes have the same version and those separated by reads have different versions.
+
+	// Sets are not applied to the tree as they are made, but collected here until the next operation that needs the tree,
+	// and then applied in key order.  The order of the keys is then the order of the tree, so a transaction with many
+	// sets, such as a bulk load, inserts them with the tree's nodes in cache rather than descending to a random key each
+	// time.  Sets to distinct keys give the same result in any order, and sets to the same key stay in the order they
+	// were made.
+	struct PendingSet {
+		KeyRef key;
+		ValueRef value;
+		bool addConflict;
+
+		PendingSet( KeyRef key, ValueRef value, bool addConflict ) : key(key), value(value), addConflict(addConflict) {}
+		bool operator < ( PendingSet const& r ) const { return key < r.key; }
+	};
+	std::vector<PendingSet> pendingSets;
+
 	iterator scratch_iterator;   // Avoid unnecessary memory allocation in write operations
 
+	void applyPendingSets() {
+		if( pendingSets.empty() )
+			return;
+
+		std::vector<PendingSet> sets;
+		std::swap( sets, pendingSets );
+		std::stable_sort( sets.begin(), sets.end() );
+		for( auto& s : sets )
+			applyMutation( s.key, MutationRef::SetValue, s.value, s.addConflict );
+	}
+
+	Tree const& appliedWrites() {
+		applyPendingSets();
+		return writes;
+	}
+
+	void applyMutation( KeyRef key, MutationRef::Type operation, ValueRef param, bool addConflict ) {
+		auto& it = scratch_iterator;
+		it.reset(writes, ver);
+		it.skip( key );
+		
+		bool is_cleared = it.entry().following_keys_cleared;
+		bool following_conflict = it.entry().following_keys_conflict;
+		bool is_conflict = addConflict || it.is_conflict_range();
+		bool following_unreadable = it.entry().following_keys_unreadable;
+		bool is_unreadable = it.is_unreadable() || operation == MutationRef::SetVersionstampedValue || operation == MutationRef::SetVersionstampedKey;
+		bool is_dependent = operation != MutationRef::SetValue && operation != MutationRef::SetVersionstampedValue && operation != MutationRef::SetVersionstampedKey;
+
+		if (it.entry().key != key) {
+			if( it.is_cleared_range() && is_dependent ) {
+				it.tree.clear();
+				OperationStack op( RYWMutation( Optional<StringRef>(), MutationRef::SetValue ) );
+				coalesceOver(op, RYWMutation(param, operation), *arena);
+				PTreeImpl::insert( writes, ver, WriteMapEntry( key, std::move(op), true, following_conflict, is_conflict, following_unreadable, is_unreadable ) );
+			} else {
+				it.tree.clear();
+				PTreeImpl::insert( writes, ver, WriteMapEntry( key, OperationStack( RYWMutation( param, operation ) ), is_cleared, following_conflict, is_conflict, following_unreadable, is_unreadable ) );
+			}
+		} else {
+			if( !it.is_unreadable() && operation == MutationRef::SetValue ) {
+				it.tree.clear();
+				PTreeImpl::insert( writes, ver, WriteMapEntry( key, OperationStack( RYWMutation( param, operation ) ), is_cleared, following_conflict, is_conflict, following_unreadable, is_unreadable ) );
+			} else {
+				WriteMapEntry e( it.entry() );
+				e.is_conflict = is_conflict;
+				e.is_unreadable = is_unreadable;
+				if (e.stack.size() == 0 && it.is_cleared_range() && is_dependent)  {
+					e.stack.push(RYWMutation(Optional<StringRef>(), MutationRef::SetValue));
+					coalesceOver(e.stack, RYWMutation(param, operation), *arena);
+				} else if( !is_unreadable && e.stack.size() > 0 )
+					coalesceOver( e.stack, RYWMutation( param, operation ), *arena );
+				else
+					e.stack.push( RYWMutation( param, operation ) );
+				
+				it.tree.clear();
+				PTreeImpl::insert( writes, ver, std::move(e) );
+			}
+		}
+	}
+
+
 	void dump() {
 		iterator it( this );
 		it.skip(allKeys.begin);
@@ -57,6 +57,7 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <sys/socket.h>
 
 #include <syslog.h>
 
@@ -187,6 +188,30 @@ const char* get_value_multi(const CSimpleIni& ini, const char* key, ...) {
 	return ret;
 }
 
+// The NUMA nodes the host has online, or none if it cannot tell
+std::vector<int> online_numa_nodes() {
+	std::vector<int> nodes;
+#if defined(__linux__)
+	FILE* f = fopen("/sys/devices/system/node/online", "r");
+	if (!f)
+		return nodes;
+	char buf[4096];
+	if (fgets(buf, sizeof(buf), f)) {
+		char* save = NULL;
+		for (char* range = strtok_r(buf, ",\n", &save); range; range = strtok_r(NULL, ",\n", &save)) {
+			int first, last;
+			int n = sscanf(range, "%d-%d", &first, &last);
+			if (n == 1)
+				last = first;
+			for (int i = first; n >= 1 && i <= last; i++)
+				nodes.push_back(i);
+		}
+	}
+	fclose(f);
+#endif
+	return nodes;
+}
+
 double timer() {
 #if defined(__linux__)
 	struct timespec ts;
@@ -282,12 +307,13 @@ public:
 	const char *delete_envvars;
 	bool deconfigured;
 	bool kill_on_configuration_change;
+	bool standby;
 
 	// one pair for each of stdout and stderr
 	int pipes[2][2];
 
 	Command() : argv(NULL) { }
-	Command(const CSimpleIni& ini, std::string _section, uint64_t id, fdb_fd_set fds, int* maxfd) : section(_section), argv(NULL), fork_retry_time(-1), quiet(false), delete_envvars(NULL), fds(fds), deconfigured(false), kill_on_configuration_change(true) {
+	Command(const CSimpleIni& ini, std::string _section, uint64_t id, fdb_fd_set fds, int* maxfd) : section(_section), argv(NULL), fork_retry_time(-1), quiet(false), delete_envvars(NULL), fds(fds), deconfigured(false), kill_on_configuration_change(true), standby(false) {
 		char _ssection[strlen(section.c_str()) + 22];
 		snprintf(_ssection, strlen(section.c_str()) + 22, "%s.%llu", section.c_str(), id);
 		ssection = _ssection;
@@ -385,6 +411,10 @@ public:
 			kill_on_configuration_change = false;
 		}
 
+		const char* sb = get_value_multi(ini, "standby", ssection.c_str(), section.c_str(), "general", NULL);
+		if (sb && !strcmp(sb, "true"))
+			standby = true;
+
 		const char* binary = get_value_multi(ini, "command", ssection.c_str(), section.c_str(), "general", NULL);
 		if (!binary) {
 			log_msg(SevError, "Unable to resolve command for %s\n", ssection.c_str());
@@ -398,7 +428,7 @@ public:
 		for (auto i : keys) {
 			if (!strcmp(i.pItem, "command") || !strcmp(i.pItem, "restart_delay") || !strcmp(i.pItem, "initial_restart_delay") || !strcmp(i.pItem, "restart_backoff") ||
 				!strcmp(i.pItem, "restart_delay_reset_interval") || !strcmp(i.pItem, "disable_lifecycle_logging") || !strcmp(i.pItem, "delete_envvars") ||
-				!strcmp(i.pItem, "kill_on_configuration_change"))
+				!strcmp(i.pItem, "kill_on_configuration_change") || !strcmp(i.pItem, "standby"))
 			{
 				continue;
 			}
@@ -410,6 +440,14 @@ public:
 			while ((pos = opt.find("$ID", pos)) != opt.npos)
 				opt.replace(pos, 3, id_s, strlen(id_s));
 
+			if (!strcmp(i.pItem, "numa_node") && opt == "auto") {
+				// Consecutive IDs alternate between the nodes
+				std::vector<int> nodes = online_numa_nodes();
+				if (nodes.size() < 2)
+					continue;
+				opt = std::to_string(nodes[id % nodes.size()]);
+			}
+
 			const char *flagName = i.pItem + 5;
 			if(strncmp("flag_", i.pItem, 5) == 0 && strlen(flagName) > 0) {
 				if(opt == "true")
@@ -449,6 +487,7 @@ public:
 		restart_delay_reset_interval = other.restart_delay_reset_interval;
 		deconfigured = other.deconfigured;
 		kill_on_configuration_change = other.kill_on_configuration_change;
+		standby = other.standby;
 
 		current_restart_delay = std::min<double>(max_restart_delay, current_restart_delay);
 		current_restart_delay = std::max<double>(initial_restart_delay, current_restart_delay);
@@ -481,6 +520,15 @@ std::unordered_map<uint64_t, Command*> id_command;
 std::unordered_map<pid_t, uint64_t> pid_id;
 std::unordered_map<uint64_t, pid_t> id_pid;
 
+// A standby is a second copy of a process's command that initializes and then waits, reading the socket whose other
+// end is kept here, until it is told to take the place of the process after that exits
+struct Standby {
+	pid_t pid;
+	int fd;
+};
+std::unordered_map<uint64_t, Standby> id_standby;
+std::unordered_map<pid_t, uint64_t> standby_pid_id;
+
 enum { OPT_CONFFILE, OPT_LOCKFILE, OPT_LOGGROUP, OPT_DAEMONIZE, OPT_HELP };
 
 CSimpleOpt::SOption g_rgOptions[] = {
@@ -494,23 +542,29 @@ CSimpleOpt::SOption g_rgOptions[] = {
 	SO_END_OF_OPTIONS
 };
 
-void start_process(Command* cmd, uint64_t id, uid_t uid, gid_t gid, int delay, sigset_t* mask) {
+/* Returns the new process's pid, or -1 if none was started. With standby_fd, the process is started as a standby
+   holding that descriptor and is not recorded as the live process for id. */
+pid_t start_process(Command* cmd, uint64_t id, uid_t uid, gid_t gid, int delay, sigset_t* mask, int standby_fd = -1) {
 	if (!cmd->argv)
-		return;
+		return -1;
 
 	pid_t pid = fork();
 
-	if (pid < 0) { /* fork error */
+	if (pid < 0 && standby_fd >= 0) {
+		log_err("fork", errno, "Unable to fork standby %s process for %s", cmd->argv[0], cmd->ssection.c_str());
+		return -1;
+	} else if (pid < 0) { /* fork error */
 		cmd->last_start = timer();
 		int fork_delay = cmd->get_and_update_current_restart_delay();
 		cmd->fork_retry_time = cmd->last_start + fork_delay;
 		log_err("fork", errno, "Unable to fork new %s process, restarting %s in %d seconds", cmd->argv[0], cmd->ssection.c_str(), fork_delay);
-		return;
+		return -1;
 	} else if (pid == 0) { /* we are the child */
 		/* remove signal handlers from parent */
 		signal(SIGHUP, SIG_DFL);
 		signal(SIGINT, SIG_DFL);
 		signal(SIGTERM, SIG_DFL);
+		signal(SIGPIPE, SIG_DFL);
 
 		/* All output in this block should be to stdout (for SevInfo messages) or stderr (for SevError messages) */
 		/* Using log_msg() or log_err() from the child will cause the logs to be written incorrectly */
@@ -569,19 +623,111 @@ void start_process(Command* cmd, uint64_t id, uid_t uid, gid_t gid, int delay, s
 			exit(0);
 #endif
 
+		const char** argv = cmd->argv;
+		if (standby_fd >= 0) {
+			/* the standby keeps its end of the socket across exec, and is told where it is */
+			fcntl(standby_fd, F_SETFD, 0);
+
+			int argc = 0;
+			while (cmd->argv[argc])
+				argc++;
+			char fd_arg[32];
+			snprintf(fd_arg, sizeof(fd_arg), "--standby_fd=%d", standby_fd);
+
+			argv = new const char* [argc + 2];
+			std::copy(cmd->argv, cmd->argv + argc, argv);
+			argv[argc] = fd_arg;
+			argv[argc + 1] = NULL;
+		}
+
 		if (!cmd->quiet) {
-			fprintf(stdout, "Launching %s (%d) for %s\n", cmd->argv[0], getpid(), cmd->ssection.c_str());
+			fprintf(stdout, "Launching %s (%d) for %s%s\n", cmd->argv[0], getpid(), cmd->ssection.c_str(), standby_fd >= 0 ? " as a standby" : "");
 			fflush(stdout);
 		}
-		execv(cmd->argv[0], (char* const*)cmd->argv);
+		execv(argv[0], (char* const*)argv);
 		fprintf(stderr, "Unable to launch %s for %s\n", cmd->argv[0], cmd->ssection.c_str());
 		_exit(0);
 	}
 
+	if (standby_fd >= 0)
+		return pid;
+
 	cmd->last_start = timer() + delay;
 	cmd->fork_retry_time = -1;
 	pid_id[pid] = id;
 	id_pid[id] = pid;
+	return pid;
+}
+
+void start_standby(Command* cmd, uint64_t id, uid_t uid, gid_t gid, int delay, sigset_t* mask) {
+	if (!cmd->standby || id_standby.count(id))
+		return;
+
+	int fds[2];
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+		log_err("socketpair", errno, "Unable to create standby socket for %s", cmd->ssection.c_str());
+		return;
+	}
+	/* no other child inherits either end; the standby clears the flag on its own end */
+	fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+	fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+
+	pid_t pid = start_process(cmd, id, uid, gid, delay, mask, fds[1]);
+	close(fds[1]);
+	if (pid < 0) {
+		close(fds[0]);
+		return;
+	}
+
+	id_standby[id] = Standby{ pid, fds[0] };
+	standby_pid_id[pid] = id;
+}
+
+void kill_standby(uint64_t id) {
+	auto itr = id_standby.find(id);
+	if (itr == id_standby.end())
+		return;
+	Standby standby = itr->second;
+
+	log_msg(SevInfo, "Killing standby process %d\n", standby.pid);
+
+	/* closing the socket is enough to make a waiting standby exit, but it may not have reached the wait yet */
+	close(standby.fd);
+	kill(standby.pid, SIGTERM);
+	waitpid(standby.pid, NULL, 0);
+
+	standby_pid_id.erase(standby.pid);
+	id_standby.erase(itr);
+}
+
+/* Makes the standby for id the live process, if there is one, and returns whether it did */
+bool promote_standby(Command* cmd, uint64_t id) {
+	auto itr = id_standby.find(id);
+	if (itr == id_standby.end())
+		return false;
+	Standby standby = itr->second;
+	id_standby.erase(itr);
+	standby_pid_id.erase(standby.pid);
+
+	char c = 1;
+	ssize_t written;
+	while ((written = write(standby.fd, &c, 1)) < 0 && errno == EINTR) {}
+	close(standby.fd);
+
+	if (written != 1) {
+		/* the standby has gone away, or is about to */
+		log_err("write", errno, "Unable to promote standby process %d for %s", standby.pid, cmd->ssection.c_str());
+		kill(standby.pid, SIGTERM);
+		waitpid(standby.pid, NULL, 0);
+		return false;
+	}
+
+	log_msg(SevInfo, "Promoted standby process %d for %s\n", standby.pid, cmd->ssection.c_str());
+	cmd->last_start = timer();
+	cmd->fork_retry_time = -1;
+	pid_id[standby.pid] = id;
+	id_pid[id] = standby.pid;
+	return true;
 }
 
 volatile int exit_signal = 0;
@@ -636,6 +782,8 @@ bool argv_equal(const char** a1, const char** a2)
 }
 
 void kill_process(uint64_t id) {
+	kill_standby(id);
+
 	pid_t pid = id_pid[id];
 
 	log_msg(SevInfo, "Killing process %d\n", pid);
@@ -695,6 +843,9 @@ void load_conf(const char* confpath, uid_t &uid, gid_t &gid, sigset_t* mask, fdb
 			for (auto i : id_pid) {
 				if(id_command[i.first]->kill_on_configuration_change) {
 					kill_ids.push_back(i.first);
+				} else {
+					/* replaced below, under the new user and group */
+					kill_standby(i.first);
 				}
 			}
 			for (auto i : kill_ids) {
@@ -710,6 +861,7 @@ void load_conf(const char* confpath, uid_t &uid, gid_t &gid, sigset_t* mask, fdb
 
 	std::list<uint64_t> kill_ids;
 	std::list<std::pair<uint64_t, Command*>> start_ids;
+	std::list<uint64_t> standby_ids;
 
 	for (auto i : id_pid) {
 		if (!loadedConf || ini.GetSectionSize(id_command[i.first]->ssection.c_str()) == -1) {
@@ -717,6 +869,7 @@ void load_conf(const char* confpath, uid_t &uid, gid_t &gid, sigset_t* mask, fdb
 			log_msg(SevInfo, "Deconfigured %s\n", id_command[i.first]->ssection.c_str());
 
 			id_command[i.first]->deconfigured = true;
+			kill_standby(i.first);
 
 			if(id_command[i.first]->kill_on_configuration_change) {
 				kill_ids.push_back(i.first);
@@ -735,11 +888,18 @@ void load_conf(const char* confpath, uid_t &uid, gid_t &gid, sigset_t* mask, fdb
 				if(id_command[i.first]->kill_on_configuration_change) {
 					kill_ids.push_back(i.first);
 					start_ids.push_back(std::make_pair(i.first, cmd));
+				} else {
+					/* a standby still running the old configuration would pick it back up on promotion */
+					kill_standby(i.first);
+					standby_ids.push_back(i.first);
 				}
 			} else {
 				log_msg(SevInfo, "Updated configuration for %s\n", id_command[i.first]->ssection.c_str());
 				id_command[i.first]->update(*cmd);
 				delete cmd;
+				if (!id_command[i.first]->standby)
+					kill_standby(i.first);
+				standby_ids.push_back(i.first);
 			}
 		}
 	}
@@ -749,8 +909,12 @@ void load_conf(const char* confpath, uid_t &uid, gid_t &gid, sigset_t* mask, fdb
 
 	for (auto i : start_ids) {
 		start_process(i.second, i.first, uid, gid, 0, mask);
+		start_standby(i.second, i.first, uid, gid, 0, mask);
 	}
 
+	for (auto i : standby_ids)
+		start_standby(id_command[i], i, uid, gid, 0, mask);
+
 	/* We've handled deconfigured sections, now look for newly
 	   configured sections */
 	if(loadedConf) {
@@ -782,6 +946,7 @@ void load_conf(const char* confpath, uid_t &uid, gid_t &gid, sigset_t* mask, fdb
 						if(cmd->fork_retry_time <= timer()) {
 							log_msg(SevInfo, "Starting %s\n", i.pItem);
 							start_process(cmd, id, uid, gid, 0, mask);
+							start_standby(cmd, id, uid, gid, 0, mask);
 						}
 					}
 				}
@@ -1176,6 +1341,8 @@ int main(int argc, char** argv) {
 
 #ifdef __linux__
 	signal(SIGCHLD, child_handler);
+	/* a write to a standby that has just exited must fail rather than kill us */
+	signal(SIGPIPE, SIG_IGN);
 #endif
 
 	uid_t uid = 0;
@@ -1466,6 +1633,18 @@ int main(int argc, char** argv) {
 					break;
 				}
 
+				auto standby = standby_pid_id.find(pid);
+				if (standby != standby_pid_id.end()) {
+					/* a standby that exits on its own is replaced after its live process next restarts */
+					uint64_t id = standby->second;
+					close(id_standby[id].fd);
+					id_standby.erase(id);
+					standby_pid_id.erase(standby);
+					if (!id_command[id]->quiet)
+						log_process_msg(SevWarn, id_command[id]->ssection.c_str(), "Standby process %d exited\n", pid);
+					continue;
+				}
+
 				uint64_t id = pid_id[pid];
 				Command* cmd = id_command[id];
 
@@ -1478,17 +1657,28 @@ int main(int argc, char** argv) {
 				}
 				else {
 					int delay = cmd->get_and_update_current_restart_delay();
+					bool promoted = promote_standby(cmd, id);
+
+					char restart[64];
+					if (promoted)
+						snprintf(restart, sizeof(restart), "promoted standby process %d", id_pid[id]);
+					else
+						snprintf(restart, sizeof(restart), "restarting in %d seconds", delay);
+
 					if (!cmd->quiet) {
 						if (WIFEXITED(child_status)) {
 							Severity priority = (WEXITSTATUS(child_status) == 0) ? SevWarn : SevError;
-							log_process_msg(priority, cmd->ssection.c_str(), "Process %d exited %d, restarting in %d seconds\n", pid, WEXITSTATUS(child_status), delay);
+							log_process_msg(priority, cmd->ssection.c_str(), "Process %d exited %d, %s\n", pid, WEXITSTATUS(child_status), restart);
 						} else if (WIFSIGNALED(child_status))
-							log_process_msg(SevWarn, cmd->ssection.c_str(), "Process %d terminated by signal %d, restarting in %d seconds\n", pid, WTERMSIG(child_status), delay);
+							log_process_msg(SevWarn, cmd->ssection.c_str(), "Process %d terminated by signal %d, %s\n", pid, WTERMSIG(child_status), restart);
 						else
-							log_process_msg(SevWarnAlways, cmd->ssection.c_str(), "Process %d exited for unknown reason, restarting in %d seconds\n", pid, delay);
+							log_process_msg(SevWarnAlways, cmd->ssection.c_str(), "Process %d exited for unknown reason, %s\n", pid, restart);
 					}
 
-					start_process(cmd, id, uid, gid, delay, &normal_mask);
+					/* the backoff applies to the replacement standby instead, so a crash loop still slows down */
+					if (!promoted)
+						start_process(cmd, id, uid, gid, delay, &normal_mask);
+					start_standby(cmd, id, uid, gid, delay, &normal_mask);
 				}
 			}
 			child_exited = false;
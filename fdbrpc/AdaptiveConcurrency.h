@@ -0,0 +1,76 @@
+/*
+ * AdaptiveConcurrency.h
+ *
+ * This source file is part of the FoundationDB open source project
+ *
+ * Copyright 2013-2018 Apple Inc. and the FoundationDB project authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FDBRPC_ADAPTIVECONCURRENCY_H
+#define FDBRPC_ADAPTIVECONCURRENCY_H
+#pragma once
+
+#include "flow/flow.h"
+#include "flow/genericactors.actor.h"
+
+// A FlowLock for a stream of similar transfers whose number of permits starts low and grows toward a maximum for as long
+// as each increase pays for itself.  Each finished transfer is reported with its size.  Once as many transfers as there
+// are permits have finished, the throughput of that window is compared with the throughput of the previous one, and the
+// lock gets one more permit if it improved by at least minGain.  The first increase that does not pay off ends the growth,
+// since throughput has then plateaued at whatever else (bandwidth, the remote side, or the producer) is the bottleneck.
+class AdaptiveConcurrency : NonCopyable {
+public:
+	AdaptiveConcurrency( int initial, int maxLimit, double minGain )
+	  : maxLimit(std::max(maxLimit, 1)), limit(std::min(std::max(initial, 1), std::max(maxLimit, 1))), lock(limit), minGain(minGain),
+		windowStart(now()), windowBytes(0), windowCount(0), lastThroughput(0) {}
+
+	FlowLock& getLock() { return lock; }
+	int getLimit() const { return limit; }
+
+	void finished( int64_t bytes ) {
+		if(limit >= maxLimit)
+			return;
+
+		windowBytes += bytes;
+		if(++windowCount < limit)
+			return;
+
+		double throughput = windowBytes / std::max(now() - windowStart, 1e-6);
+		if(throughput >= lastThroughput * (1 + minGain)) {
+			lastThroughput = throughput;
+			lock.setPermits(++limit);
+		}
+		else {
+			maxLimit = limit;
+		}
+
+		windowStart = now();
+		windowBytes = 0;
+		windowCount = 0;
+	}
+
+private:
+	int maxLimit;
+	int limit;
+	FlowLock lock;
+	double minGain;
+
+	double windowStart;
+	int64_t windowBytes;
+	int windowCount;
+	double lastThroughput;
+};
+
+#endif
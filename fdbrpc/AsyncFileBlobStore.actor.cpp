@@ -78,4 +78,38 @@ TEST_CASE("backup/throttling") {
 	return Void();
 }
 
+ACTOR Future<Void> adaptiveTransfers(AdaptiveConcurrency *concurrency, FlowLock *bottleneck, int *remaining) {
+	loop {
+		Void _ = wait(concurrency->getLock().take());
+		state FlowLock::Releaser releaser(concurrency->getLock(), 1);
+		if(*remaining == 0)
+			return Void();
+		--*remaining;
 
+		Void _ = wait(bottleneck->take());
+		state FlowLock::Releaser bottleneckReleaser(*bottleneck, 1);
+		Void _ = wait(delay(0.01));
+		bottleneckReleaser.release();
+
+		concurrency->finished(1e6);
+		releaser.release();
+	}
+}
+
+TEST_CASE("backup/adaptiveConcurrency") {
+	// Transfers take a fixed time each and 3 can be in progress before the bottleneck is reached, so the limit should
+	// grow past 3 but stop at the first increase that makes no difference.
+	state AdaptiveConcurrency concurrency(1, 10, 0.1);
+	state FlowLock bottleneck(3);
+	state int remaining = 200;
+
+	std::vector<Future<Void>> transfers;
+	for(int i = 0; i < 10; ++i)
+		transfers.push_back(adaptiveTransfers(&concurrency, &bottleneck, &remaining));
+	Void _ = wait(waitForAll(transfers));
+
+	printf("Adaptive concurrency limit: %d\n", concurrency.getLimit());
+	ASSERT(concurrency.getLimit() >= 3 && concurrency.getLimit() <= 5);
+
+	return Void();
+}
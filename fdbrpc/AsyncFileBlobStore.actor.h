@@ -35,6 +35,7 @@
 #include "flow/Net2Packet.h"
 #include "IRateControl.h"
 #include "BlobStore.h"
+#include "AdaptiveConcurrency.h"
 #include "md5/md5.h"
 #include "libb64/encode.h"
 
@@ -51,7 +52,9 @@ ACTOR template<typename T> static Future<T> joinErrorGroup(Future<T> f, Promise<
 // This class represents a write-only file that lives in an S3-style blob store.  It writes using the REST API,
 // using multi-part upload and beginning to transfer each part as soon as it is large enough.
 // All write operations file operations must be sequential and contiguous.
-// Limits on part sizes, upload speed, and concurrent uploads are taken from the BlobStoreEndpoint being used.
+// Limits on part sizes, upload speed, and concurrent uploads are taken from the BlobStoreEndpoint being used.  Each file
+// starts with initial_concurrency_per_file uploads in flight and allows more, up to concurrent_writes_per_file, while
+// doing so increases its upload throughput.
 class AsyncFileBlobStoreWrite : public IAsyncFile, public ReferenceCounted<AsyncFileBlobStoreWrite> {
 public:
 	virtual void addref() { ReferenceCounted<AsyncFileBlobStoreWrite>::addref(); }
@@ -132,6 +135,7 @@ public:
 		p->finalizeMD5();
 		std::string upload_id = wait(f->getUploadID());
 		std::string etag = wait(f->m_bstore->uploadPart(f->m_bucket, f->m_object, upload_id, p->number, &p->content, p->length, p->md5string));
+		f->m_concurrentUploads.finished(p->length);
 		return etag;
 	}
 
@@ -212,7 +216,7 @@ private:
 	Future<Void> m_finished;
 	std::vector<Reference<Part>> m_parts;
 	Promise<Void> m_error;
-	FlowLock m_concurrentUploads;
+	AdaptiveConcurrency m_concurrentUploads;
 
 	// End the current part and start uploading it, but also wait for a part to finish if too many are in transit.
 	ACTOR static Future<Void> endCurrentPart(AsyncFileBlobStoreWrite *f, bool startNew = false) {
@@ -220,11 +224,11 @@ private:
 			return Void();
 
 		// Wait for an upload slot to be available
-		Void _ = wait(f->m_concurrentUploads.take());
+		Void _ = wait(f->m_concurrentUploads.getLock().take());
 
 		// Do the upload, and if it fails forward errors to m_error and also stop if anything else sends an error to m_error
 		// Also, hold a releaser for the concurrent upload slot while all that is going on.
-		f->m_parts.back()->etag = holdWhile(std::shared_ptr<FlowLock::Releaser>(new FlowLock::Releaser(f->m_concurrentUploads, 1)),
+		f->m_parts.back()->etag = holdWhile(std::shared_ptr<FlowLock::Releaser>(new FlowLock::Releaser(f->m_concurrentUploads.getLock(), 1)),
 									joinErrorGroup(doPartUpload(f, f->m_parts.back().getPtr()), f->m_error)
 								  );
 
@@ -243,7 +247,8 @@ private:
 
 public:
 	AsyncFileBlobStoreWrite(Reference<BlobStoreEndpoint> bstore, std::string bucket, std::string object)
-		: m_bstore(bstore), m_bucket(bucket), m_object(object), m_cursor(0), m_concurrentUploads(bstore->knobs.concurrent_writes_per_file) {
+		: m_bstore(bstore), m_bucket(bucket), m_object(object), m_cursor(0), 
+		  m_concurrentUploads(bstore->knobs.initial_concurrency_per_file, bstore->knobs.concurrent_writes_per_file, CLIENT_KNOBS->BLOBSTORE_CONCURRENCY_MIN_GAIN) {
 
 		// Add first part
 		m_parts.push_back(Reference<Part>(new Part(1)));
@@ -19,12 +19,13 @@
  */
 
 #include "AsyncFileCached.actor.h"
+#include "flow/UnitTest.h"
 
-//Page caches used in non-simulated environments
-Optional<Reference<EvictablePageCache>> pc4k, pc64k;
+//Page caches used in non-simulated environments, by page size
+static std::map<int, Reference<EvictablePageCache>> pageCaches;
 
 //The simulator needs to store separate page caches for each machine
-static std::map<NetworkAddress, std::pair<Reference<EvictablePageCache>, Reference<EvictablePageCache>>> simulatorPageCaches;
+static std::map<NetworkAddress, std::map<int, Reference<EvictablePageCache>>> simulatorPageCaches;
 
 EvictablePage::~EvictablePage() {
 	if (data) {
@@ -33,11 +34,7 @@ EvictablePage::~EvictablePage() {
 		else
 			aligned_free(data);
 	}
-	if (index > -1) {
-		pageCache->pages[index] = pageCache->pages.back();
-		pageCache->pages[index]->index = index;
-		pageCache->pages.pop_back();
-	}
+	pageCache->remove(this);
 }
 
 std::map< std::string, OpenFileInfo > AsyncFileCached::openFiles;
@@ -46,31 +43,38 @@ void AsyncFileCached::remove_page( AFCPage* page ) {
 	pages.erase( page->pageOffset );
 }
 
-Future<Reference<IAsyncFile>> AsyncFileCached::open_impl( std::string filename, int flags, int mode ) {
-	Reference<EvictablePageCache> pageCache;
-
-	//In a simulated environment, each machine needs its own caches
-	if(g_network->isSimulated()) {
-		auto cacheItr = simulatorPageCaches.find(g_network->getLocalAddress());
-		if(cacheItr == simulatorPageCaches.end()) {
-			int64_t pageCacheSize4k = (BUGGIFY) ? FLOW_KNOBS->BUGGIFY_SIM_PAGE_CACHE_4K : FLOW_KNOBS->SIM_PAGE_CACHE_4K;
-			int64_t pageCacheSize64k = (BUGGIFY) ? FLOW_KNOBS->BUGGIFY_SIM_PAGE_CACHE_64K : FLOW_KNOBS->SIM_PAGE_CACHE_64K;
-			auto caches = std::make_pair(Reference<EvictablePageCache>(new EvictablePageCache(4096, pageCacheSize4k)), Reference<EvictablePageCache>(new EvictablePageCache(65536, pageCacheSize64k)));
-			simulatorPageCaches[g_network->getLocalAddress()] = caches;
-			pageCache = (flags & IAsyncFile::OPEN_LARGE_PAGES) ? caches.second : caches.first;
+// Files opened with OPEN_LARGE_PAGES share a cache of 64K pages, and the others a cache of pages of the size their
+// flags ask for, 4K by default.  Each of the smaller page sizes has a cache as large as the 4K one, so a process
+// normally sticks to one of them for its data files.
+static Reference<EvictablePageCache> getPageCache( std::map<int, Reference<EvictablePageCache>>& caches, int pageSize ) {
+	auto& cache = caches[pageSize];
+	if(!cache) {
+		int64_t cacheSize;
+		if(g_network->isSimulated()) {
+			if(pageSize == 65536)
+				cacheSize = (BUGGIFY) ? FLOW_KNOBS->BUGGIFY_SIM_PAGE_CACHE_64K : FLOW_KNOBS->SIM_PAGE_CACHE_64K;
+			else
+				cacheSize = (BUGGIFY) ? FLOW_KNOBS->BUGGIFY_SIM_PAGE_CACHE_4K : FLOW_KNOBS->SIM_PAGE_CACHE_4K;
 		}
 		else
-			pageCache = (flags & IAsyncFile::OPEN_LARGE_PAGES) ? cacheItr->second.second : cacheItr->second.first;
-	}
-	else {
-		if(flags & IAsyncFile::OPEN_LARGE_PAGES) {
-			if(!pc64k.present()) pc64k = Reference<EvictablePageCache>(new EvictablePageCache(65536, FLOW_KNOBS->PAGE_CACHE_64K));
-			pageCache = pc64k.get();
-		} else {
-			if(!pc4k.present()) pc4k = Reference<EvictablePageCache>(new EvictablePageCache(4096, FLOW_KNOBS->PAGE_CACHE_4K));
-			pageCache = pc4k.get();
-		}
+			cacheSize = pageSize == 65536 ? FLOW_KNOBS->PAGE_CACHE_64K : FLOW_KNOBS->PAGE_CACHE_4K;
+		cache = Reference<EvictablePageCache>(new EvictablePageCache(pageSize, cacheSize));
 	}
+	return cache;
+}
+
+static int pageSizeForFlags( int flags ) {
+	if(flags & IAsyncFile::OPEN_LARGE_PAGES) return 65536;
+	if(flags & IAsyncFile::OPEN_32K_PAGES) return 32768;
+	if(flags & IAsyncFile::OPEN_16K_PAGES) return 16384;
+	if(flags & IAsyncFile::OPEN_8K_PAGES) return 8192;
+	return 4096;
+}
+
+Future<Reference<IAsyncFile>> AsyncFileCached::open_impl( std::string filename, int flags, int mode ) {
+	//In a simulated environment, each machine needs its own caches
+	auto& caches = g_network->isSimulated() ? simulatorPageCaches[g_network->getLocalAddress()] : pageCaches;
+	Reference<EvictablePageCache> pageCache = getPageCache(caches, pageSizeForFlags(flags));
 
 	return open_impl(filename, flags, mode, pageCache);
 }
@@ -95,8 +99,14 @@ Future<Void> AsyncFileCached::read_write_impl( AsyncFileCached* self, void* data
 		++self->countCacheFinds;
 		auto p = self->pages.find( pageOffset );
 		if ( p == self->pages.end() ) {
+			++self->countFileCacheMisses;
+			++self->countCacheMisses;
 			AFCPage* page = new AFCPage( self, pageOffset );
 			p = self->pages.insert( std::make_pair(pageOffset, page) ).first;
+		} else {
+			++self->countFileCacheHits;
+			++self->countCacheHits;
+			p->second->touch();
 		}
 
 		int bytesInPage = std::min(self->pageCache->pageSize - offsetInPage, remaining);
@@ -131,14 +141,46 @@ Future<Void> AsyncFileCached::readZeroCopy( void** data, int* length, int64_t of
 
 	auto p = pages.find( offset );
 	if ( p == pages.end() ) {
+		++countFileCacheMisses;
+		++countCacheMisses;
 		AFCPage* page = new AFCPage( this, offset );
 		p = pages.insert( std::make_pair(offset, page) ).first;
+	} else {
+		++countFileCacheHits;
+		++countCacheHits;
+		p->second->touch();
 	}
 
 	*data = p->second->data;
 
-	return p->second->readZeroCopy();
+	Future<Void> f = p->second->readZeroCopy();
+	readAhead( offset, *length );
+	return f;
+}
+
+void AsyncFileCached::readAhead( int64_t offset, int length ) {
+	int64_t bytes = sequentialReads.read( offset, length );
+	if (!bytes)
+		return;
+
+	// Pages past prevLength have nothing to read.  The pages read ahead for the previous reads of the stream are cached
+	// already, so look for missing pages from the end of the range back to the first cached one.
+	int pageSize = pageCache->pageSize;
+	int64_t firstPage = (offset + length + pageSize - 1) / pageSize * pageSize;
+	int64_t endPage = (std::min( offset + length + bytes, prevLength ) + pageSize - 1) / pageSize * pageSize;
+	int64_t pageOffset = endPage;
+	while (pageOffset > firstPage && !pages.count( pageOffset - pageSize ))
+		pageOffset -= pageSize;
+
+	for(; pageOffset < endPage; pageOffset += pageSize) {
+		AFCPage* page = new AFCPage( this, pageOffset );
+		pages.insert( std::make_pair(pageOffset, page) );
+		page->readAhead();
+		++countFileCachePagesReadAhead;
+		++countCachePagesReadAhead;
+	}
 }
+
 void AsyncFileCached::releaseZeroCopy( void* data, int length, int64_t offset ) {
 	ASSERT( length == pageCache->pageSize && !(offset & (pageCache->pageSize-1)) && offset + length <= this->length);
 	auto p = pages.find( offset );
@@ -205,9 +247,18 @@ Future<Void> AsyncFileCached::flush() {
 
 	std::vector<Future<Void>> unflushed;
 
+	// Dirty pages that can be written right away are written in runs of adjacent pages, with a write per run, after the
+	// other flushable pages have been flushed one at a time
+	std::vector<AFCPage*> runnable;
+
 	int debug_count = flushable.size();
 	for(int i=0; i<flushable.size(); ) {
 		auto p = flushable[i];
+		if (p->canFlushInRun()) {
+			runnable.push_back( p );
+			i++;
+			continue;
+		}
 		auto f = p->flush();
 		if (!f.isReady() || f.isError()) unflushed.push_back( f );
 		ASSERT( (i<flushable.size() && flushable[i] == p) != f.isReady() );
@@ -215,6 +266,23 @@ Future<Void> AsyncFileCached::flush() {
 	}
 	ASSERT( flushable.size() <= debug_count );
 
+	std::sort( runnable.begin(), runnable.end(), []( AFCPage* a, AFCPage* b ) { return a->pageOffset < b->pageOffset; } );
+	int maxRunPages = std::max( 1, FLOW_KNOBS->PAGE_CACHE_FLUSH_WRITE_SIZE / pageCache->pageSize );
+	std::vector<AFCPage*> run;
+	for(int i = 0; i < runnable.size(); i++) {
+		run.push_back( runnable[i] );
+		if (i+1 < runnable.size() && runnable[i+1]->pageOffset == runnable[i]->pageOffset + pageCache->pageSize && run.size() < maxRunPages)
+			continue;
+
+		auto f = run.size() == 1 ? run[0]->flush() : AFCPage::flushRun( run );
+		if (!f.isReady() || f.isError()) unflushed.push_back( f );
+		if (run.size() > 1) {
+			countFileCachePageWritesCoalesced += run.size();
+			countCachePageWritesCoalesced += run.size();
+		}
+		run.clear();
+	}
+
 	return waitForAll(unflushed);
 }
 
@@ -231,9 +299,81 @@ Future<Void> AsyncFileCached::quiesce() {
 }
 
 AsyncFileCached::~AsyncFileCached() {
+	TraceEvent("AsyncFileCachedClose").detail("Filename", filename)
+		.detail("CacheHits", countFileCacheHits->getValue()).detail("CacheMisses", countFileCacheMisses->getValue());
+
 	while ( !pages.empty() ) {
 		auto ok = pages.begin()->second->evict();
 		ASSERT_ABORT( ok );
 	}
 	openFiles.erase( filename );
 }
+
+struct TestEvictablePage : EvictablePage, FastAllocated<TestEvictablePage> {
+	std::set<int>* resident;
+	int id;
+
+	TestEvictablePage( Reference<EvictablePageCache> pageCache, std::set<int>* resident, int id ) : EvictablePage(pageCache), resident(resident), id(id) {
+		resident->insert(id);
+		pageCache->allocate(this);
+	}
+
+	virtual bool evict() {
+		resident->erase(id);
+		delete this;
+		return true;
+	}
+};
+
+TEST_CASE("fdbrpc/AsyncFileCached/2QScanResistance") {
+	state int cachePages = 100;
+	state Reference<EvictablePageCache> cache( new EvictablePageCache(4096, 4096 * cachePages, "2q") );
+	state std::set<int> resident;
+	state std::map<int, TestEvictablePage*> hot;
+
+	// Build a hot set that is accessed repeatedly
+	for(int i = 0; i < cachePages / 2; i++)
+		hot[i] = new TestEvictablePage(cache, &resident, i);
+	for(auto& p : hot)
+		cache->touch(p.second);
+
+	// A long scan of pages touched exactly once should only cycle through the probationary queue
+	for(int i = 0; i < cachePages * 10; i++)
+		new TestEvictablePage(cache, &resident, cachePages + i);
+
+	for(auto& p : hot)
+		ASSERT( resident.count(p.first) );
+	ASSERT( cache->pages.size() <= cachePages );
+
+	while(!cache->pages.empty())
+		cache->pages.back()->evict();
+	ASSERT( resident.empty() );
+
+	return Void();
+}
+
+TEST_CASE("fdbrpc/SequentialReadDetector") {
+	SequentialReadDetector detector(4096, 65536, 2);
+
+	// Random reads never read ahead
+	for(int i = 0; i < 100; i++)
+		ASSERT( detector.read(g_random->randomInt(1, 1000) * 1000000LL, 4096) == 0 );
+
+	// A sequential stream ramps up to the maximum, and keeps it while another stream is interleaved with it
+	int64_t expected[] = { 0, 0, 4096, 8192, 16384, 32768, 65536, 65536 };
+	for(int i = 0; i < 8; i++) {
+		ASSERT( detector.read(i * 4096LL, 4096) == expected[i] );
+		ASSERT( detector.read(1e9 + i * 8192LL, 8192) == expected[i] );
+	}
+
+	// Small gaps and overlaps continue a stream, but a jump starts over
+	ASSERT( detector.read(8 * 4096 + 100, 4096) == 65536 );
+	ASSERT( detector.read(9 * 4096, 4096) == 65536 );
+	ASSERT( detector.read(1e8, 4096) == 0 );
+
+	// The new stream replaced the least recently used one
+	ASSERT( detector.read(1e9 + 8 * 8192LL, 8192) == 0 );
+	ASSERT( detector.read(10 * 4096, 4096) == 0 );
+
+	return Void();
+}
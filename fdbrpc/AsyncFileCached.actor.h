@@ -32,21 +32,43 @@
 #include "flow/Knobs.h"
 #include "flow/TDMetric.actor.h"
 #include "flow/network.h"
+#include "flow/genericactors.actor.h"
+#include "SequentialReadDetector.h"
 
 struct EvictablePage {
 	void* data;
 	int index;
 	class Reference<struct EvictablePageCache> pageCache;
 
+	// Intrusive links for the 2Q eviction policy; queue is which EvictablePageCache::Queue the page is on
+	EvictablePage* prev;
+	EvictablePage* next;
+	int queue;
+
 	virtual bool evict() = 0; // true if page was evicted, false if it isn't immediately evictable (but will be evicted regardless if possible)
 
-	EvictablePage(Reference<EvictablePageCache> pageCache) : data(0), index(-1), pageCache(pageCache) {}
+	EvictablePage(Reference<EvictablePageCache> pageCache) : data(0), index(-1), pageCache(pageCache), prev(0), next(0), queue(-1) {}
 	virtual ~EvictablePage();
 };
 
 struct EvictablePageCache : ReferenceCounted<EvictablePageCache> {
-	EvictablePageCache() : pageSize(0), maxPages(0) {}
-	explicit EvictablePageCache(int pageSize, int64_t maxSize) : pageSize(pageSize), maxPages(maxSize / pageSize) {}
+	enum EvictionPolicy { RANDOM, TWO_Q };
+
+	// Pages enter the probationary queue and are promoted to the protected queue on their second access, so that a
+	// single sequential scan can only displace the probationary fraction of the cache
+	enum Queue { PROBATIONARY, PROTECTED, QUEUE_COUNT };
+
+	EvictablePageCache() : pageSize(0), maxPages(0), policy(RANDOM) { initQueues(); }
+	explicit EvictablePageCache(int pageSize, int64_t maxSize, std::string const& policyName = FLOW_KNOBS->PAGE_CACHE_EVICTION_POLICY)
+		: pageSize(pageSize), maxPages(maxSize / pageSize), policy(parsePolicy(policyName)) { initQueues(); }
+
+	static EvictionPolicy parsePolicy(std::string const& name) {
+		if (name == "2q")
+			return TWO_Q;
+		if (name != "random")
+			TraceEvent(SevWarnAlways, "UnknownPageCacheEvictionPolicy").detail("Policy", name);
+		return RANDOM;
+	}
 
 	void allocate(EvictablePage* page) {
 		try_evict();
@@ -54,10 +76,35 @@ struct EvictablePageCache : ReferenceCounted<EvictablePageCache> {
 		page->data = pageSize == 4096 ? FastAllocator<4096>::allocate() : aligned_alloc(4096,pageSize);
 		page->index = pages.size();
 		pages.push_back(page);
+		if (policy == TWO_Q)
+			pushBack(page, PROBATIONARY);
+	}
+
+	// Called when an already cached page is accessed again
+	void touch(EvictablePage* page) {
+		if (policy == TWO_Q && page->queue != -1) {
+			unlink(page);
+			pushBack(page, PROTECTED);
+		}
+	}
+
+	void remove(EvictablePage* page) {
+		if (page->queue != -1)
+			unlink(page);
+		if (page->index > -1) {
+			pages[page->index] = pages.back();
+			pages[page->index]->index = page->index;
+			pages.pop_back();
+			page->index = -1;
+		}
 	}
 
 	void try_evict() {
 		if (pages.size() >= (uint64_t)maxPages && !pages.empty()) {
+			if (policy == TWO_Q) {
+				try_evict_2q();
+				return;
+			}
 			for (int i = 0; i < FLOW_KNOBS->MAX_EVICT_ATTEMPTS; i++) { // If we don't manage to evict anything, just go ahead and exceed the cache limit
 				int toEvict = g_random->randomInt(0, pages.size());
 				if (pages[toEvict]->evict())
@@ -69,6 +116,58 @@ struct EvictablePageCache : ReferenceCounted<EvictablePageCache> {
 	std::vector<EvictablePage*> pages;
 	int pageSize;
 	int64_t maxPages;
+	EvictionPolicy policy;
+
+private:
+	EvictablePage* head[QUEUE_COUNT]; // Least recently used end
+	EvictablePage* tail[QUEUE_COUNT];
+	int64_t queueSize[QUEUE_COUNT];
+
+	void initQueues() {
+		for (int q = 0; q < QUEUE_COUNT; q++) {
+			head[q] = tail[q] = 0;
+			queueSize[q] = 0;
+		}
+	}
+
+	void pushBack(EvictablePage* page, int q) {
+		page->queue = q;
+		page->prev = tail[q];
+		page->next = 0;
+		if (tail[q]) tail[q]->next = page;
+		else head[q] = page;
+		tail[q] = page;
+		++queueSize[q];
+	}
+
+	void unlink(EvictablePage* page) {
+		int q = page->queue;
+		if (page->prev) page->prev->next = page->next;
+		else head[q] = page->next;
+		if (page->next) page->next->prev = page->prev;
+		else tail[q] = page->prev;
+		page->prev = page->next = 0;
+		page->queue = -1;
+		--queueSize[q];
+	}
+
+	// Evict from the probationary queue while it holds more than its share of the cache, otherwise from the least
+	// recently used end of the protected queue.  Pages that can't be evicted right now are skipped.
+	void try_evict_2q() {
+		int first = queueSize[PROBATIONARY] > maxPages * FLOW_KNOBS->PAGE_CACHE_PROBATIONARY_FRACTION || !head[PROTECTED] ? PROBATIONARY : PROTECTED;
+		int attempts = 0;
+		for (int q = first; attempts < FLOW_KNOBS->MAX_EVICT_ATTEMPTS; q = PROBATIONARY + PROTECTED - q) {
+			EvictablePage* page = head[q];
+			while (page && attempts < FLOW_KNOBS->MAX_EVICT_ATTEMPTS) {
+				EvictablePage* next = page->next;
+				++attempts;
+				if (page->evict())
+					return;
+				page = next;
+			}
+			if (q != first) break;
+		}
+	}
 };
 
 struct OpenFileInfo : NonCopyable {
@@ -112,6 +211,7 @@ public:
 			ASSERT(length >= 0);
 		}
 		auto f = read_write_impl(this, data, length, offset, false);
+		readAhead(offset, length);
 		if( f.isReady() && !f.isError() ) return length;
 		++countFileCacheReadsBlocked;
 		++countCacheReadsBlocked;
@@ -194,6 +294,10 @@ private:
 	Int64MetricHandle countFileCacheWritesBlocked;
 	Int64MetricHandle countFileCachePageReadsMerged;
 	Int64MetricHandle countFileCacheReadBytes;
+	Int64MetricHandle countFileCacheHits;
+	Int64MetricHandle countFileCacheMisses;
+	Int64MetricHandle countFileCachePagesReadAhead;
+	Int64MetricHandle countFileCachePageWritesCoalesced;
 
 	Int64MetricHandle countCacheFinds;
 	Int64MetricHandle countCacheReads;
@@ -202,9 +306,20 @@ private:
 	Int64MetricHandle countCacheWritesBlocked;
 	Int64MetricHandle countCachePageReadsMerged;
 	Int64MetricHandle countCacheReadBytes;
+	Int64MetricHandle countCacheHits;
+	Int64MetricHandle countCacheMisses;
+	Int64MetricHandle countCachePagesReadAhead;
+	Int64MetricHandle countCachePageWritesCoalesced;
+
+	// Reads that continue a sequential stream of reads start reading the pages after them into the cache
+	SequentialReadDetector sequentialReads;
+
+	FlowLock flushLock;  // Limits the writes of dirty pages in flight
 
 	AsyncFileCached( Reference<IAsyncFile> uncached, const std::string& filename, int64_t length, Reference<EvictablePageCache> pageCache ) 
-		: uncached(uncached), filename(filename), length(length), prevLength(length), pageCache(pageCache) {
+		: uncached(uncached), filename(filename), length(length), prevLength(length), pageCache(pageCache),
+		  sequentialReads(FLOW_KNOBS->PAGE_CACHE_READ_AHEAD_MIN, std::min<int64_t>(FLOW_KNOBS->PAGE_CACHE_READ_AHEAD_MAX, pageCache->maxPages / 16 * pageCache->pageSize)),
+		  flushLock(FLOW_KNOBS->PAGE_CACHE_FLUSH_CONCURRENCY) {
 		if( !g_network->isSimulated() ) {
 			countFileCacheWrites.init(         LiteralStringRef("AsyncFile.CountFileCacheWrites"), filename);
 			countFileCacheReads.init(          LiteralStringRef("AsyncFile.CountFileCacheReads"), filename);
@@ -213,6 +328,10 @@ private:
 			countFileCachePageReadsMerged.init(LiteralStringRef("AsyncFile.CountFileCachePageReadsMerged"), filename);
 			countFileCacheFinds.init(          LiteralStringRef("AsyncFile.CountFileCacheFinds"), filename);
 			countFileCacheReadBytes.init(      LiteralStringRef("AsyncFile.CountFileCacheReadBytes"), filename);
+			countFileCacheHits.init(           LiteralStringRef("AsyncFile.CountFileCacheHits"), filename);
+			countFileCacheMisses.init(         LiteralStringRef("AsyncFile.CountFileCacheMisses"), filename);
+			countFileCachePagesReadAhead.init( LiteralStringRef("AsyncFile.CountFileCachePagesReadAhead"), filename);
+			countFileCachePageWritesCoalesced.init(LiteralStringRef("AsyncFile.CountFileCachePageWritesCoalesced"), filename);
 
 			countCacheWrites.init(         LiteralStringRef("AsyncFile.CountCacheWrites"));
 			countCacheReads.init(          LiteralStringRef("AsyncFile.CountCacheReads"));
@@ -221,6 +340,10 @@ private:
 			countCachePageReadsMerged.init(LiteralStringRef("AsyncFile.CountCachePageReadsMerged"));
 			countCacheFinds.init(          LiteralStringRef("AsyncFile.CountCacheFinds"));
 			countCacheReadBytes.init(      LiteralStringRef("AsyncFile.CountCacheReadBytes"));
+			countCacheHits.init(           LiteralStringRef("AsyncFile.CountCacheHits"));
+			countCacheMisses.init(         LiteralStringRef("AsyncFile.CountCacheMisses"));
+			countCachePagesReadAhead.init( LiteralStringRef("AsyncFile.CountCachePagesReadAhead"));
+			countCachePageWritesCoalesced.init(LiteralStringRef("AsyncFile.CountCachePageWritesCoalesced"));
 
 		}
 	}
@@ -261,6 +384,9 @@ private:
 
 	static Future<Void> read_write_impl( AsyncFileCached* self, void* data, int length, int64_t offset, bool writing );
 
+	// Reports a read to sequentialReads and starts reading into the cache the pages it says to read ahead
+	void readAhead( int64_t offset, int length );
+
 	static Future<Void> truncate_impl( AsyncFileCached* self, int64_t size );
 
 	void remove_page( AFCPage* page );
@@ -343,6 +469,22 @@ struct AFCPage : public EvictablePage, public FastAllocated<AFCPage> {
 		return notReading;
 	}
 
+	// Starts reading the page into the cache for a read that is expected to come.  Until then the page does not count as
+	// having been accessed.
+	void readAhead() {
+		readAheadUntouched = true;
+		if (!valid && notReading.isReady())
+			notReading = readThrough( this );
+	}
+
+	// Called when the page is found in the cache by a read or write
+	void touch() {
+		if (readAheadUntouched)
+			readAheadUntouched = false;
+		else
+			pageCache->touch( this );
+	}
+
 	ACTOR static Future<Void> waitAndRead( AFCPage* self, void* data, int length, int offset ) {
 		Void _ = wait( self->notReading );
 		memcpy( data, static_cast<uint8_t const*>(self->data) + offset, length );
@@ -382,6 +524,9 @@ struct AFCPage : public EvictablePage, public FastAllocated<AFCPage> {
 					memset( static_cast<uint8_t *>(self->data) + self->owner->length - self->pageOffset, 0, self->pageCache->pageSize - (self->owner->length - self->pageOffset) );
 				}
 
+				Void _ = wait( self->owner->flushLock.take() );
+				state FlowLock::Releaser releaser( self->owner->flushLock );
+
 				auto f = self->owner->uncached->write( self->data, self->pageCache->pageSize, self->pageOffset );
 
 				Void _ = wait( f );
@@ -416,6 +561,70 @@ struct AFCPage : public EvictablePage, public FastAllocated<AFCPage> {
 		return writing.getFuture();
 	}
 
+	// True if the page is dirty and can be written along with others by flushRun()
+	bool canFlushInRun() const {
+		return dirty && valid && notReading.isReady() && notFlushing.isReady();
+	}
+
+	// Flushes, with a single write, a run of pages whose offsets are adjacent and for which canFlushInRun() is true
+	static Future<Void> flushRun( std::vector<AFCPage*> const& run ) {
+		Promise<Void> writing;
+		Future<Void> written = writeThroughRun( run, writing );
+		for(auto p : run) {
+			p->notFlushing = written;
+			p->clearDirty();
+		}
+		return writing.getFuture();
+	}
+
+	ACTOR static Future<Void> writeThroughRun( std::vector<AFCPage*> run, Promise<Void> writing ) {
+		state AsyncFileCached* owner = run[0]->owner;
+		state int pageSize = run[0]->pageCache->pageSize;
+		state int64_t offset = run[0]->pageOffset;
+		state int length = run.size() * pageSize;
+		state uint8_t* buffer = NULL;
+		state FlowLock::Releaser releaser;
+
+		for(auto p : run) {
+			++p->writeThroughCount;
+			p->updateFlushableIndex();
+		}
+
+		try {
+			Void _ = wait( owner->flushLock.take() );
+			releaser = FlowLock::Releaser( owner->flushLock );
+
+			buffer = (uint8_t*)aligned_alloc( 4096, length );
+			for(int i = 0; i < run.size(); i++)
+				memcpy( buffer + i * pageSize, run[i]->data, pageSize );
+			int64_t validLength = std::max<int64_t>( 0, owner->length - offset );
+			if (validLength < length)
+				memset( buffer + validLength, 0, length - validLength );
+
+			Void _ = wait( owner->uncached->write( buffer, length, offset ) );
+		}
+		catch(Error& e) {
+			if (buffer) aligned_free( buffer );
+			for(auto p : run) {
+				--p->writeThroughCount;
+				p->setDirty();
+			}
+			writing.sendError(e);
+			throw;
+		}
+		aligned_free( buffer );
+		for(auto p : run) {
+			--p->writeThroughCount;
+			p->updateFlushableIndex();
+		}
+
+		writing.send(Void());
+
+		owner->pageCache->try_evict();
+
+		return Void();
+	}
+
 	Future<Void> quiesce() {
 		if (dirty) flush();
 
@@ -444,7 +653,7 @@ struct AFCPage : public EvictablePage, public FastAllocated<AFCPage> {
 		return Void();
 	}
 
-	AFCPage( AsyncFileCached* owner, int64_t offset ) : EvictablePage(owner->pageCache), owner(owner), pageOffset(offset), dirty(false), valid(false), truncated(false), notReading(Void()), notFlushing(Void()), zeroCopyRefCount(0), flushableIndex(-1), writeThroughCount(0) {
+	AFCPage( AsyncFileCached* owner, int64_t offset ) : EvictablePage(owner->pageCache), owner(owner), pageOffset(offset), dirty(false), valid(false), truncated(false), notReading(Void()), notFlushing(Void()), zeroCopyRefCount(0), flushableIndex(-1), writeThroughCount(0), readAheadUntouched(false) {
 		pageCache->allocate(this);
 	}
 
@@ -491,6 +700,7 @@ struct AFCPage : public EvictablePage, public FastAllocated<AFCPage> {
 	int writeThroughCount;  // number of writeThrough actors that are in progress (potentially writing or waiting to write)
 	int flushableIndex;  // index in owner->flushable[]
 	int zeroCopyRefCount;  // references held by "zero-copy" reads
+	bool readAheadUntouched;  // true if the page was read ahead and has not been accessed since
 };
 
 #endif
@@ -0,0 +1,654 @@
+/*
+ * AsyncFileIOUring.actor.h
+ *
+ * This source file is part of the FoundationDB open source project
+ *
+ * Copyright 2013-2018 Apple Inc. and the FoundationDB project authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+#ifdef __linux__
+
+// When actually compiled (NO_INTELLISENSE), include the generated version of this file.  In intellisense use the source version.
+#if defined(NO_INTELLISENSE) && !defined(FLOW_ASYNCFILEIOURING_ACTOR_G_H)
+	#define FLOW_ASYNCFILEIOURING_ACTOR_G_H
+	#include "AsyncFileIOUring.actor.g.h"
+#elif !defined(FLOW_ASYNCFILEIOURING_ACTOR_H)
+	#define FLOW_ASYNCFILEIOURING_ACTOR_H
+
+#include "IAsyncFile.h"
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include "fdbrpc/linux_iouring.h"
+#include "fdbrpc/IOClassQueue.h"
+#include "flow/Knobs.h"
+#include "flow/UnitTest.h"
+#include "flow/genericactors.actor.h"
+
+// An alternative to AsyncFileKAIO for unbuffered files, enabled with the USE_IO_URING knob.  Requests are queued by
+// priority as in AsyncFileKAIO and submitted in batches from the run loop through a single io_uring_enter() call.
+// Unlike KAIO, fdatasync is submitted to the ring as well, so sync() does not need a trip through the EIO thread pool.
+// Completions are signalled through the same eventfd that AsyncFileKAIO uses.
+class AsyncFileIOUring : public IAsyncFile, public ReferenceCounted<AsyncFileIOUring> {
+public:
+	static Future<Reference<IAsyncFile>> open( std::string filename, int flags, int mode, void* ignore ) {
+		ASSERT( flags & OPEN_UNBUFFERED );
+		ASSERT( isEnabled() );
+
+		if (flags & OPEN_LOCK)
+			mode |= 02000;  // Enable mandatory locking for this file if it is supported by the filesystem
+
+		std::string open_filename = filename;
+		if (flags & OPEN_ATOMIC_WRITE_AND_CREATE) {
+			ASSERT( (flags & OPEN_CREATE) && (flags & OPEN_READWRITE) && !(flags & OPEN_EXCLUSIVE) );
+			open_filename = filename + ".part";
+		}
+
+		int fd = ::open( open_filename.c_str(), openFlags(flags) | O_DIRECT, mode );
+		if (fd<0) {
+			Error e = errno==ENOENT ? file_not_found() : io_error();
+			TraceEvent("AsyncFileIOUringOpenFailed").detail("Filename", filename).detailf("Flags", "%x", flags)
+				.detailf("OSFlags", "%x", openFlags(flags) | O_DIRECT).detailf("mode", "0%o", mode).error(e).GetLastError();
+			return e;
+		} else {
+			TraceEvent("AsyncFileIOUringOpen")
+				.detail("Filename", filename)
+				.detail("Flags", flags)
+				.detail("mode", mode)
+				.detail("fd", fd);
+		}
+
+		Reference<AsyncFileIOUring> r(new AsyncFileIOUring( fd, flags, filename ));
+
+		if (flags & OPEN_LOCK) {
+			// Acquire a "write" lock for the entire file
+			flock lockDesc;
+			lockDesc.l_type = F_WRLCK;
+			lockDesc.l_whence = SEEK_SET;
+			lockDesc.l_start = 0;
+			lockDesc.l_len = 0;
+			lockDesc.l_pid = 0;
+			if (fcntl(fd, F_SETLK, &lockDesc) == -1) {
+				TraceEvent(SevError, "UnableToLockFile").detail("filename", filename).GetLastError();
+				return io_error();
+			}
+		}
+
+		struct stat buf;
+		if (fstat( fd, &buf )) {
+			TraceEvent("AsyncFileIOUringFStatError").detail("fd",fd).detail("filename", filename).GetLastError();
+			return io_error();
+		}
+
+		r->lastFileSize = r->nextFileSize = buf.st_size;
+		return Reference<IAsyncFile>(std::move(r));
+	}
+
+	// Returns false, leaving io_uring disabled, if the ring cannot be created (e.g. on kernels older than 5.1).
+	//   The caller should then use AsyncFileKAIO.
+	static bool init( Reference<IEventFD> ev, double ioTimeout ) {
+		linux_io_uring_params params;
+		memset( &params, 0, sizeof(params) );
+		int ringFd = io_uring_setup( FLOW_KNOBS->MAX_OUTSTANDING, &params );
+		if (ringFd < 0) {
+			TraceEvent(SevWarnAlways, "IOUringSetupFailed").GetLastError();
+			return false;
+		}
+
+		size_t sqRingSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+		size_t cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(linux_io_uring_cqe);
+		size_t sqesSize = params.sq_entries * sizeof(linux_io_uring_sqe);
+		uint8_t* sqRing = (uint8_t*)mmap( NULL, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IOURING_OFF_SQ_RING );
+		uint8_t* cqRing = (uint8_t*)mmap( NULL, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IOURING_OFF_CQ_RING );
+		void* sqes = mmap( NULL, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IOURING_OFF_SQES );
+		int evfd = ev->getFD();
+		if (sqRing == MAP_FAILED || cqRing == MAP_FAILED || sqes == MAP_FAILED || io_uring_register( ringFd, IOURING_REGISTER_EVENTFD, &evfd, 1 ) < 0) {
+			TraceEvent(SevWarnAlways, "IOUringInitFailed").GetLastError();
+			if (sqRing != MAP_FAILED) munmap( sqRing, sqRingSize );
+			if (cqRing != MAP_FAILED) munmap( cqRing, cqRingSize );
+			if (sqes != MAP_FAILED) munmap( sqes, sqesSize );
+			close( ringFd );
+			return false;
+		}
+
+		ctx.sqHead = (uint32_t*)(sqRing + params.sq_off.head);
+		ctx.sqTail = (uint32_t*)(sqRing + params.sq_off.tail);
+		ctx.sqMask = *(uint32_t*)(sqRing + params.sq_off.ring_mask);
+		ctx.sqArray = (uint32_t*)(sqRing + params.sq_off.array);
+		ctx.sqes = (linux_io_uring_sqe*)sqes;
+		ctx.cqHead = (uint32_t*)(cqRing + params.cq_off.head);
+		ctx.cqTail = (uint32_t*)(cqRing + params.cq_off.tail);
+		ctx.cqMask = *(uint32_t*)(cqRing + params.cq_off.ring_mask);
+		ctx.cqes = (linux_io_uring_cqe*)(cqRing + params.cq_off.cqes);
+		// Every outstanding request holds a submission queue entry until the kernel consumes it, and the completion
+		//   queue (at least as large) then can't overflow
+		ctx.maxOutstanding = std::min<int>( FLOW_KNOBS->MAX_OUTSTANDING, params.sq_entries );
+		ctx.evfd = evfd;
+		ctx.ringFd = ringFd;
+
+		if( !g_network->isSimulated() ) {
+			ctx.countSubmit.init(LiteralStringRef("AsyncFile.CountIOUringSubmit"));
+			ctx.countCollect.init(LiteralStringRef("AsyncFile.CountIOUringCollect"));
+			ctx.submitMetric.init(LiteralStringRef("AsyncFile.Submit"));
+			ctx.countPreSubmitTruncate.init(LiteralStringRef("AsyncFile.CountPreIOUringSubmitTruncate"));
+			ctx.preSubmitTruncateBytes.init(LiteralStringRef("AsyncFile.PreIOUringSubmitTruncateBytes"));
+			ctx.queue.initMetrics();
+		}
+
+		setTimeout(ioTimeout);
+		poll(ev);
+
+		g_network->setGlobal(INetwork::enRunCycleFunc, (flowGlobalType) &AsyncFileIOUring::launch);
+		TraceEvent("IOUringInitialized").detail("SubmitQueueEntries", params.sq_entries).detail("CompletionQueueEntries", params.cq_entries);
+		return true;
+	}
+
+	static bool isEnabled() { return ctx.ringFd >= 0; }
+	static void setTimeout(double ioTimeout) { ctx.setIOTimeout(ioTimeout); }
+
+	virtual void addref() { ReferenceCounted<AsyncFileIOUring>::addref(); }
+	virtual void delref() { ReferenceCounted<AsyncFileIOUring>::delref(); }
+
+	virtual Future<int> read( void* data, int length, int64_t offset ) {
+		++countFileLogicalReads;
+		++countLogicalReads;
+
+		if(failed) {
+			return io_timeout();
+		}
+
+		IOBlock *io = new IOBlock(IOURING_OP_READV, fd);
+		io->setBuffer( data, length );
+		io->offset = offset;
+
+		enqueue(io);
+		return io->result.getFuture();
+	}
+	virtual Future<Void> write( void const* data, int length, int64_t offset ) {
+		++countFileLogicalWrites;
+		++countLogicalWrites;
+
+		if(failed) {
+			return io_timeout();
+		}
+
+		IOBlock *io = new IOBlock(IOURING_OP_WRITEV, fd);
+		io->setBuffer( (void*)data, length );
+		io->offset = offset;
+
+		nextFileSize = std::max( nextFileSize, offset+length );
+
+		enqueue(io);
+		return success(io->result.getFuture());
+	}
+#ifndef FALLOC_FL_ZERO_RANGE
+#define FALLOC_FL_ZERO_RANGE 0x10
+#endif
+	virtual Future<Void> zeroRange( int64_t offset, int64_t length ) override {
+		bool success = false;
+		if (ctx.fallocateZeroSupported) {
+			int rc = fallocate( fd, FALLOC_FL_ZERO_RANGE, offset, length );
+			if (rc == EOPNOTSUPP) {
+				ctx.fallocateZeroSupported = false;
+			}
+			if (rc == 0) {
+				success = true;
+			}
+		}
+		return success ? Void() : IAsyncFile::zeroRange(offset, length);
+	}
+	virtual Future<Void> truncate( int64_t size ) {
+		++countFileLogicalWrites;
+		++countLogicalWrites;
+
+		if(failed) {
+			return io_timeout();
+		}
+
+		int result = -1;
+		bool completed = false;
+		if( ctx.fallocateSupported && size >= lastFileSize ) {
+			result = fallocate( fd, 0, 0, size);
+			if (result != 0) {
+				int fallocateErrCode = errno;
+				TraceEvent("AsyncFileIOUringAllocateError").detail("fd",fd).detail("filename", filename).GetLastError();
+				if ( fallocateErrCode == EOPNOTSUPP ) {
+					// Mark fallocate as unsupported. Try again with truncate.
+					ctx.fallocateSupported = false;
+				} else {
+					return io_error();
+				}
+			} else {
+				completed = true;
+			}
+		}
+		if ( !completed )
+			result = ftruncate(fd, size);
+
+		if(result != 0) {
+			TraceEvent("AsyncFileIOUringTruncateError").detail("fd",fd).detail("filename", filename).GetLastError();
+			return io_error();
+		}
+
+		lastFileSize = nextFileSize = size;
+
+		return Void();
+	}
+
+	ACTOR static Future<Void> throwErrorIfFailed( Reference<AsyncFileIOUring> self, Future<Void> sync ) {
+		Void _ = wait( sync );
+		if(self->failed) {
+			throw io_timeout();
+		}
+		return Void();
+	}
+
+	virtual Future<Void> sync() {
+		++countFileLogicalWrites;
+		++countLogicalWrites;
+
+		if(failed) {
+			return io_timeout();
+		}
+
+		IOBlock *io = new IOBlock(IOURING_OP_FSYNC, fd);
+		io->syncFlags = IOURING_FSYNC_DATASYNC;
+		enqueue(io);
+		Future<Void> fsync = throwErrorIfFailed(Reference<AsyncFileIOUring>::addRef(this), success(io->result.getFuture()));
+
+		if (flags & OPEN_ATOMIC_WRITE_AND_CREATE) {
+			flags &= ~OPEN_ATOMIC_WRITE_AND_CREATE;
+
+			return AsyncFileEIO::waitAndAtomicRename( fsync, filename+".part", filename );
+		}
+
+		return fsync;
+	}
+	virtual Future<int64_t> size() { return nextFileSize; }
+	virtual int64_t debugFD() {
+		return fd;
+	}
+	virtual std::string getFilename() {
+		return filename;
+	}
+	~AsyncFileIOUring() {
+		close(fd);
+	}
+
+	static void launch() {
+		if (ctx.queue.size() && ctx.outstanding < ctx.maxOutstanding - FLOW_KNOBS->MIN_SUBMIT) {
+			ctx.submitMetric = true;
+
+			double begin = timer_monotonic();
+			if (!ctx.outstanding) ctx.ioStallBegin = begin;
+
+			int n = std::min<size_t>(ctx.maxOutstanding - ctx.outstanding, ctx.queue.size());
+			uint32_t tail = *ctx.sqTail;  // Only we write the tail
+			for(int i=0; i<n; i++) {
+				auto io = ctx.queue.pop( ctx.maxOutstanding );
+				if (!io) {
+					// Only requests that must leave the remaining slots to foreground requests are queued
+					n = i;
+					break;
+				}
+				io->startTime = now();
+
+				if(ctx.ioTimeout > 0) {
+					ctx.appendToRequestList(io);
+				}
+
+				if (io->owner->lastFileSize != io->owner->nextFileSize) {
+					++ctx.countPreSubmitTruncate;
+					int64_t truncateSize = io->owner->nextFileSize - io->owner->lastFileSize;
+					ASSERT(truncateSize > 0);
+					ctx.preSubmitTruncateBytes += truncateSize;
+					io->owner->truncate(io->owner->nextFileSize);
+				}
+
+				uint32_t index = tail & ctx.sqMask;
+				io->prepare( &ctx.sqes[index] );
+				ctx.sqArray[index] = index;
+				tail++;
+			}
+			__atomic_store_n( ctx.sqTail, tail, __ATOMIC_RELEASE );
+			ctx.outstanding += n;
+			ctx.unsubmitted += n;
+
+			submit();
+
+			ctx.submitMetric = false;
+
+			double elapsed = timer_monotonic() - begin;
+			g_network->networkMetrics.secSquaredSubmit += elapsed*elapsed/2;
+
+			if(elapsed > FLOW_KNOBS->SLOW_LOOP_CUTOFF && g_nondeterministic_random->random01() < elapsed) {
+				TraceEvent("SlowIOUringLaunch").detail("SubmitTime", elapsed).detail("Submitted", n).detail("Unsubmitted", ctx.unsubmitted);
+			}
+		} else if (ctx.unsubmitted) {
+			submit();
+		}
+	}
+
+	bool failed;
+private:
+	int fd, flags;
+	int64_t lastFileSize, nextFileSize;
+	std::string filename;
+	Int64MetricHandle countFileLogicalWrites;
+	Int64MetricHandle countFileLogicalReads;
+	Int64MetricHandle countFileReadBytes;
+	Int64MetricHandle countFileWriteBytes;
+	Int64MetricHandle fileReadMicros;  // Total time from queueing to completion of the file's reads
+	Int64MetricHandle fileWriteMicros;
+
+	Int64MetricHandle countLogicalWrites;
+	Int64MetricHandle countLogicalReads;
+
+	struct IOBlock : FastAllocated<IOBlock> {
+		uint8_t opcode;
+		int fd;
+		struct iovec iov;
+		int64_t offset;
+		uint32_t syncFlags;
+		Promise<int> result;
+		Reference<AsyncFileIOUring> owner;
+		int64_t prio;
+		IOClass ioClass;
+		IOBlock *prev;
+		IOBlock *next;
+		double startTime;
+		double enqueueTime;
+
+		struct indirect_order_by_priority { bool operator () ( IOBlock* a, IOBlock* b ) { return a->prio < b->prio; } };
+
+		IOBlock(uint8_t opcode, int fd) : opcode(opcode), fd(fd), offset(0), syncFlags(0), ioClass(IOClassForeground), prev(nullptr), next(nullptr), startTime(0), enqueueTime(0) {
+			iov.iov_base = nullptr;
+			iov.iov_len = 0;
+		}
+
+		void setBuffer( void* data, int length ) {
+			iov.iov_base = data;
+			iov.iov_len = length;
+		}
+
+		void prepare( linux_io_uring_sqe* sqe ) {
+			memset( sqe, 0, sizeof(*sqe) );
+			sqe->opcode = opcode;
+			sqe->fd = fd;
+			if (opcode == IOURING_OP_FSYNC) {
+				sqe->op_flags = syncFlags;
+			} else {
+				sqe->off = offset;
+				sqe->addr = (uint64_t)&iov;
+				sqe->len = 1;
+			}
+			sqe->user_data = (uint64_t)this;
+		}
+
+		int getTask() const { return (prio>>32)+1; }
+		int64_t ioBytes() const { return iov.iov_len; }
+
+		ACTOR static void deliver( Promise<int> result, bool failed, int r, int task ) {
+			Void _ = wait( delay(0, task) );
+			if (failed) result.sendError(io_timeout());
+			else if (r < 0) result.sendError(io_error());
+			else result.send(r);
+		}
+
+		void setResult( int r ) {
+			if (r >= 0 && (opcode == IOURING_OP_READV || opcode == IOURING_OP_WRITEV)) {
+				bool isRead = opcode == IOURING_OP_READV;
+				(isRead ? owner->countFileReadBytes : owner->countFileWriteBytes) += r;
+				(isRead ? owner->fileReadMicros : owner->fileWriteMicros) += int64_t( (now() - enqueueTime) * 1e6 );
+			}
+			if (r<0) {
+				struct stat fst;
+				fstat( fd, &fst );
+
+				errno = -r;
+				TraceEvent("AsyncFileIOUringIOError").GetLastError().detail("fd", fd).detail("op", opcode).detail("nbytes", iov.iov_len).detail("offset", offset).detail("ptr", int64_t(iov.iov_base))
+					.detail("Size", fst.st_size).detail("filename", owner->filename);
+			}
+			deliver( result, owner->failed, r, getTask() );
+			delete this;
+		}
+
+		void timeout(bool warnOnly) {
+			TraceEvent(SevWarnAlways, "AsyncFileIOUringTimeout").detail("fd", fd).detail("op", opcode).detail("nbytes", iov.iov_len).detail("offset", offset).detail("ptr", int64_t(iov.iov_base))
+				.detail("filename", owner->filename);
+			g_network->setGlobal(INetwork::enASIOTimedOut, (flowGlobalType)true);
+
+			if(!warnOnly)
+				owner->failed = true;
+		}
+	};
+
+	struct Context {
+		int ringFd;
+		int evfd;
+		uint32_t *sqHead, *sqTail, *sqArray;
+		uint32_t sqMask;
+		linux_io_uring_sqe* sqes;
+		uint32_t *cqHead, *cqTail;
+		uint32_t cqMask;
+		linux_io_uring_cqe* cqes;
+
+		int maxOutstanding;
+		int outstanding;		// Requests in the submission queue or in flight
+		int unsubmitted;		// Requests in the submission queue which io_uring_enter() has not yet accepted
+		double ioStallBegin;
+		bool fallocateSupported;
+		bool fallocateZeroSupported;
+		IOClassQueue<IOBlock> queue;
+		Int64MetricHandle countSubmit;
+		Int64MetricHandle countCollect;
+		Int64MetricHandle submitMetric;
+
+		double ioTimeout;
+		bool timeoutWarnOnly;
+		IOBlock *submittedRequestList;
+
+		Int64MetricHandle countPreSubmitTruncate;
+		Int64MetricHandle preSubmitTruncateBytes;
+
+		uint32_t opsIssued;
+		Context() : ringFd(-1), evfd(-1), sqHead(nullptr), sqTail(nullptr), sqArray(nullptr), sqMask(0), sqes(nullptr), cqHead(nullptr), cqTail(nullptr), cqMask(0), cqes(nullptr),
+			maxOutstanding(0), outstanding(0), unsubmitted(0), ioStallBegin(0), fallocateSupported(true), fallocateZeroSupported(true), submittedRequestList(nullptr), opsIssued(0) {
+			setIOTimeout(0);
+		}
+
+		void setIOTimeout(double timeout) {
+			ioTimeout = fabs(timeout);
+			timeoutWarnOnly = timeout < 0;
+		}
+
+		void appendToRequestList(IOBlock *io) {
+			ASSERT(!io->next && !io->prev);
+
+			if(submittedRequestList) {
+				io->prev = submittedRequestList->prev;
+				io->prev->next = io;
+
+				submittedRequestList->prev = io;
+				io->next = submittedRequestList;
+			}
+			else {
+				submittedRequestList = io;
+				io->next = io->prev = io;
+			}
+		}
+
+		void removeFromRequestList(IOBlock *io) {
+			if(io->next == nullptr) {
+				ASSERT(io->prev == nullptr);
+				return;
+			}
+
+			ASSERT(io->prev != nullptr);
+
+			if(io == io->next) {
+				ASSERT(io == submittedRequestList && io == io->prev);
+				submittedRequestList = nullptr;
+			}
+			else {
+				io->next->prev = io->prev;
+				io->prev->next = io->next;
+
+				if(submittedRequestList == io) {
+					submittedRequestList = io->next;
+				}
+			}
+
+			io->next = io->prev = nullptr;
+		}
+	};
+	static Context ctx;
+
+	explicit AsyncFileIOUring(int fd, int flags, std::string const& filename) : fd(fd), flags(flags), filename(filename), failed(false) {
+		if( !g_network->isSimulated() ) {
+			countFileLogicalWrites.init(LiteralStringRef("AsyncFile.CountFileLogicalWrites"), filename);
+			countFileLogicalReads.init( LiteralStringRef("AsyncFile.CountFileLogicalReads"), filename);
+			countFileReadBytes.init(LiteralStringRef("AsyncFile.CountFileReadBytes"), filename);
+			countFileWriteBytes.init(LiteralStringRef("AsyncFile.CountFileWriteBytes"), filename);
+			fileReadMicros.init(LiteralStringRef("AsyncFile.FileReadMicros"), filename);
+			fileWriteMicros.init(LiteralStringRef("AsyncFile.FileWriteMicros"), filename);
+			countLogicalWrites.init(LiteralStringRef("AsyncFile.CountLogicalWrites"));
+			countLogicalReads.init( LiteralStringRef("AsyncFile.CountLogicalReads"));
+		}
+	}
+
+	void enqueue( IOBlock* io ) {
+		ASSERT( io->opcode == IOURING_OP_FSYNC || (int64_t(io->iov.iov_base) % 4096 == 0 && io->offset % 4096 == 0 && io->iov.iov_len % 4096 == 0) );
+
+		io->prio = (int64_t(g_network->getCurrentTask())<<32) - (++ctx.opsIssued);
+		io->ioClass = ioClassForTask(g_network->getCurrentTask());
+		io->owner = Reference<AsyncFileIOUring>::addRef(this);
+
+		ctx.queue.push(io);
+	}
+
+	// Hands everything in the submission queue to the kernel, or as much of it as the kernel will take right now
+	static void submit() {
+		int rc;
+		loop {
+			rc = io_uring_enter( ctx.ringFd, ctx.unsubmitted, 0, 0 );
+			if (rc>=0 || errno!=EINTR) break;
+		}
+		++ctx.countSubmit;
+		if (rc<0) {
+			if (errno == EAGAIN || errno == EBUSY)
+				return;  // The remaining entries stay in the submission queue and are retried on the next run loop iteration
+			TraceEvent(SevError, "IOUringSubmitError").GetLastError();
+			throw io_error();
+		}
+		ctx.unsubmitted -= rc;
+	}
+
+	static int openFlags(int flags) {
+		int oflags = 0;
+		ASSERT( bool(flags & OPEN_READONLY) != bool(flags & OPEN_READWRITE) );  // readonly xor readwrite
+		if( flags & OPEN_EXCLUSIVE ) oflags |= O_EXCL;
+		if( flags & OPEN_CREATE )    oflags |= O_CREAT;
+		if( flags & OPEN_READONLY )  oflags |= O_RDONLY;
+		if( flags & OPEN_READWRITE ) oflags |= O_RDWR;
+		if( flags & OPEN_ATOMIC_WRITE_AND_CREATE ) oflags |= O_TRUNC;
+		return oflags;
+	}
+
+	ACTOR static void poll( Reference<IEventFD> ev ) {
+		loop {
+			int64_t evfd_count = wait( ev->read() );
+
+			Void _ = wait(delay(0, TaskDiskIOComplete));
+
+			uint32_t head = *ctx.cqHead;  // Only we write the head
+			uint32_t tail = __atomic_load_n( ctx.cqTail, __ATOMIC_ACQUIRE );
+			int n = tail - head;
+
+			++ctx.countCollect;
+			if (n) {
+				double t = timer_monotonic();
+				double elapsed = t - ctx.ioStallBegin;
+				ctx.ioStallBegin = t;
+				g_network->networkMetrics.secSquaredDiskStall += elapsed*elapsed/2;
+			}
+
+			ctx.outstanding -= n;
+
+			if(ctx.ioTimeout > 0) {
+				double currentTime = now();
+				while(ctx.submittedRequestList && currentTime - ctx.submittedRequestList->startTime > ctx.ioTimeout) {
+					ctx.submittedRequestList->timeout(ctx.timeoutWarnOnly);
+					ctx.removeFromRequestList(ctx.submittedRequestList);
+				}
+			}
+
+			for(; head != tail; head++) {
+				linux_io_uring_cqe* cqe = &ctx.cqes[ head & ctx.cqMask ];
+				IOBlock* iob = (IOBlock*)cqe->user_data;
+
+				if(ctx.ioTimeout > 0) {
+					ctx.removeFromRequestList(iob);
+				}
+
+				ctx.queue.complete(iob);
+				iob->setResult( cqe->res );
+			}
+			__atomic_store_n( ctx.cqHead, tail, __ATOMIC_RELEASE );
+		}
+	}
+};
+
+TEST_CASE("fdbrpc/AsyncFileIOUring/ReadWriteSync") {
+	// This test does nothing in simulation, which uses its own file system, or on kernels without io_uring
+	if(!g_network->isSimulated() && AsyncFileIOUring::isEnabled()) {
+		state Reference<IAsyncFile> f = wait(AsyncFileIOUring::open("/tmp/__IOURING_TEST_FILE__", IAsyncFile::OPEN_UNBUFFERED | IAsyncFile::OPEN_READWRITE | IAsyncFile::OPEN_CREATE, 0666, nullptr));
+		state uint8_t* writeBuf = (uint8_t*)FastAllocator<4096>::allocate();
+		state uint8_t* readBuf = (uint8_t*)FastAllocator<4096>::allocate();
+		state int page = 0;
+		state int pages = 64;
+
+		for(page = 0; page < pages; page++) {
+			memset( writeBuf, page, 4096 );
+			Void _ = wait( f->write( writeBuf, 4096, page*4096 ) );
+		}
+		Void _ = wait( f->sync() );
+		int64_t size = wait( f->size() );
+		ASSERT( size == pages*4096 );
+
+		for(page = 0; page < pages; page++) {
+			int r = wait( f->read( readBuf, 4096, page*4096 ) );
+			ASSERT( r == 4096 );
+			for(int i=0; i<4096; i++)
+				ASSERT( readBuf[i] == uint8_t(page) );
+		}
+
+		FastAllocator<4096>::release(writeBuf);
+		FastAllocator<4096>::release(readBuf);
+		f = Reference<IAsyncFile>();
+		Void _ = wait(IAsyncFileSystem::filesystem()->deleteFile("/tmp/__IOURING_TEST_FILE__", true));
+	}
+
+	return Void();
+}
+
+AsyncFileIOUring::Context AsyncFileIOUring::ctx;
+
+#endif
+#endif
@@ -34,10 +34,11 @@
 #include <sys/eventfd.h>
 #include <sys/syscall.h>
 #include "fdbrpc/linux_kaio.h"
+#include "fdbrpc/IOClassQueue.h"
 #include "flow/Knobs.h"
 #include "flow/UnitTest.h"
 #include <stdio.h>
-#include "flow/Hash3.h"
+#include "Checksum.h"
 #include "flow/genericactors.actor.h"
 
 // Set this to true to enable detailed KAIO request logging, which currently is written to a hardcoded location /data/v7/fdb/
@@ -159,6 +160,7 @@ public:
 			ctx.countPreSubmitTruncate.init(LiteralStringRef("AsyncFile.CountPreAIOSubmitTruncate"));
 			ctx.preSubmitTruncateBytes.init(LiteralStringRef("AsyncFile.PreAIOSubmitTruncateBytes"));
 			ctx.slowAioSubmitMetric.init(LiteralStringRef("AsyncFile.SlowAIOSubmit"));
+			ctx.queue.initMetrics();
 		}
 		
 		int rc = io_setup( FLOW_KNOBS->MAX_OUTSTANDING, &ctx.iocx );
@@ -360,11 +362,15 @@ public:
 			int64_t largestTruncate = 0;
 
 			for(int i=0; i<n; i++) {
-				auto io = ctx.queue.top();
+				auto io = ctx.queue.pop( FLOW_KNOBS->MAX_OUTSTANDING );
+				if (!io) {
+					// Only requests that must leave the remaining slots to foreground requests are queued
+					n = i;
+					break;
+				}
 
 				KAIOLogBlockEvent(io, OpLogEntry::LAUNCH);
 
-				ctx.queue.pop();
 				toStart[i] = io;
 				io->startTime = now();
 
@@ -381,6 +387,11 @@ public:
 					io->owner->truncate(io->owner->nextFileSize);
 				}
 			}
+			if (!n) {
+				ctx.submitMetric = false;
+				return;
+			}
+
 			double truncateComplete = timer_monotonic();
 			int rc = io_submit( ctx.iocx, n, (linux_iocb**)toStart );
 			double end = timer_monotonic();
@@ -417,6 +428,7 @@ public:
 				} else {
 					KAIOLogBlockEvent(toStart[0], OpLogEntry::COMPLETE, errno ? -errno : -1000000);
 					// Other errors are assumed to represent failure to issue the first I/O in the list
+					ctx.queue.complete(toStart[0]);
 					toStart[0]->setResult( errno ? -errno : -1000000 );
 					rc = 1;
 				}
@@ -425,7 +437,7 @@ public:
 			// Any unsubmitted I/Os need to be requeued
 			for(int i=rc; i<n; i++) {
 				KAIOLogBlockEvent(toStart[i], OpLogEntry::REQUEUE);
-				ctx.queue.push(toStart[i]);
+				ctx.queue.requeue(toStart[i]);
 			}
 		}
 	}
@@ -437,6 +449,10 @@ private:
 	std::string filename;
 	Int64MetricHandle countFileLogicalWrites;
 	Int64MetricHandle countFileLogicalReads;
+	Int64MetricHandle countFileReadBytes;
+	Int64MetricHandle countFileWriteBytes;
+	Int64MetricHandle fileReadMicros;  // Total time from queueing to completion of the file's reads
+	Int64MetricHandle fileWriteMicros;
 
 	Int64MetricHandle countLogicalWrites;
 	Int64MetricHandle countLogicalReads;
@@ -445,16 +461,18 @@ private:
 		Promise<int> result;
 		Reference<AsyncFileKAIO> owner;
 		int64_t prio;
+		IOClass ioClass;
 		IOBlock *prev;
 		IOBlock *next;
 		double startTime;
+		double enqueueTime;
 #if KAIO_LOGGING
 		int32_t iolog_id;
 #endif
 
 		struct indirect_order_by_priority { bool operator () ( IOBlock* a, IOBlock* b ) { return a->prio < b->prio; } };
 
-		IOBlock(int op, int fd) : prev(nullptr), next(nullptr), startTime(0) {
+		IOBlock(int op, int fd) : ioClass(IOClassForeground), prev(nullptr), next(nullptr), startTime(0), enqueueTime(0) {
 			memset((linux_iocb*)this, 0, sizeof(linux_iocb));
 			aio_lio_opcode = op;
 			aio_fildes = fd;
@@ -464,6 +482,7 @@ private:
 		}
 
 		int getTask() const { return (prio>>32)+1; }
+		int64_t ioBytes() const { return nbytes; }
 
 		ACTOR static void deliver( Promise<int> result, bool failed, int r, int task ) {
 			Void _ = wait( delay(0, task) );
@@ -473,6 +492,11 @@ private:
 		}
 
 		void setResult( int r ) {
+			if (r >= 0 && (aio_lio_opcode == IO_CMD_PREAD || aio_lio_opcode == IO_CMD_PWRITE)) {
+				bool isRead = aio_lio_opcode == IO_CMD_PREAD;
+				(isRead ? owner->countFileReadBytes : owner->countFileWriteBytes) += r;
+				(isRead ? owner->fileReadMicros : owner->fileWriteMicros) += int64_t( (now() - enqueueTime) * 1e6 );
+			}
 			if (r<0) {
 				struct stat fst;
 				fstat( aio_fildes, &fst );
@@ -502,7 +526,7 @@ private:
 		double ioStallBegin;
 		bool fallocateSupported;
 		bool fallocateZeroSupported;
-		std::priority_queue<IOBlock*, std::vector<IOBlock*>, IOBlock::indirect_order_by_priority> queue;
+		IOClassQueue<IOBlock> queue;
 		Int64MetricHandle countAIOSubmit;
 		Int64MetricHandle countAIOCollect;
 		Int64MetricHandle submitMetric;
@@ -573,6 +597,10 @@ private:
 		if( !g_network->isSimulated() ) {
 			countFileLogicalWrites.init(LiteralStringRef("AsyncFile.CountFileLogicalWrites"), filename);
 			countFileLogicalReads.init( LiteralStringRef("AsyncFile.CountFileLogicalReads"), filename);
+			countFileReadBytes.init(LiteralStringRef("AsyncFile.CountFileReadBytes"), filename);
+			countFileWriteBytes.init(LiteralStringRef("AsyncFile.CountFileWriteBytes"), filename);
+			fileReadMicros.init(LiteralStringRef("AsyncFile.FileReadMicros"), filename);
+			fileWriteMicros.init(LiteralStringRef("AsyncFile.FileWriteMicros"), filename);
 			countLogicalWrites.init(LiteralStringRef("AsyncFile.CountLogicalWrites"));
 			countLogicalReads.init( LiteralStringRef("AsyncFile.CountLogicalReads"));
 		}
@@ -620,6 +648,7 @@ private:
 		io->eventfd = ctx.evfd;
 		io->prio = (int64_t(g_network->getCurrentTask())<<32) - (++ctx.opsIssued);
 		//io->prio = - (++ctx.opsIssued);
+		io->ioClass = ioClassForTask(g_network->getCurrentTask());
 		io->owner = Reference<AsyncFileKAIO>::addRef(owner);
 
 		ctx.queue.push(io);
@@ -685,6 +714,7 @@ private:
 					ctx.removeFromRequestList(iob);
 				}
 
+				ctx.queue.complete(iob);
 				iob->setResult( ev[i].result );
 			}
 		}
@@ -724,7 +754,7 @@ void AsyncFileKAIO::KAIOLogBlockEvent(FILE *logFile, IOBlock *ioblock, OpLogEntr
 
 		// Log a checksum for Writes up to the Complete stage or Reads starting from the Complete stage
 		if( (op == OpLogEntry::WRITE && stage <= OpLogEntry::COMPLETE) || (op == OpLogEntry::READ && stage >= OpLogEntry::COMPLETE) )
-			e.checksum = hashlittle(ioblock->buf, ioblock->nbytes, 0xab12fd93);
+			e.checksum = crc32c(ioblock->buf, ioblock->nbytes, 0xab12fd93);
 		else
 			e.checksum = 0;
 
@@ -828,6 +858,59 @@ TEST_CASE("fdbrpc/AsyncFileKAIO/RequestList") {
 	return Void();
 }
 
+struct IOClassQueueTestRequest {
+	IOClass ioClass;
+	int64_t prio;
+	double enqueueTime;
+	int64_t ioBytes() const { return 4096; }
+
+	struct indirect_order_by_priority { bool operator () ( IOClassQueueTestRequest* a, IOClassQueueTestRequest* b ) { return a->prio < b->prio; } };
+};
+
+TEST_CASE("fdbrpc/IOClassQueue/Shares") {
+	IOClassQueueTestRequest requests[2000];
+	IOClassQueue<IOClassQueueTestRequest> queue;
+	for(int i = 0; i < 2000; i++) {
+		requests[i].ioClass = i % 2 ? IOClassBackground : IOClassForeground;
+		requests[i].prio = -i;
+		queue.push( &requests[i] );
+	}
+
+	// Requests completed as soon as they are submitted share the bandwidth by weight, in order within their class
+	int foreground = 0;
+	int lastBackground = -1;
+	int total = FLOW_KNOBS->IO_FOREGROUND_WEIGHT + FLOW_KNOBS->IO_BACKGROUND_WEIGHT;
+	for(int i = 0; i < 10 * total; i++) {
+		IOClassQueueTestRequest* io = queue.pop( 64 );
+		ASSERT( io );
+		if( io->ioClass == IOClassForeground ) {
+			foreground++;
+		} else {
+			ASSERT( -io->prio > lastBackground );
+			lastBackground = -io->prio;
+		}
+		queue.complete( io );
+	}
+	ASSERT( abs(foreground - 10 * FLOW_KNOBS->IO_FOREGROUND_WEIGHT) <= 1 );
+
+	// Outstanding background requests leave the reserved slots to foreground ones
+	int background = 0;
+	loop {
+		IOClassQueueTestRequest* io = queue.pop( 64 );
+		ASSERT( io );
+		if( io->ioClass == IOClassForeground ) {
+			if( background >= std::max(64 - FLOW_KNOBS->IO_FOREGROUND_RESERVED_REQUESTS, 1) )
+				break;
+			queue.complete( io );
+		} else {
+			background++;
+		}
+	}
+	ASSERT( background == std::max(64 - FLOW_KNOBS->IO_FOREGROUND_RESERVED_REQUESTS, 1) );
+
+	return Void();
+}
+
 AsyncFileKAIO::Context AsyncFileKAIO::ctx;
 
 #endif 
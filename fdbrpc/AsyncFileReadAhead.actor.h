@@ -29,8 +29,14 @@
 
 #include "flow/flow.h"
 #include "IAsyncFile.h"
-
-// Read-only file type that wraps another file instance, reads in large blocks, and reads ahead of the actual range requested
+#include "AdaptiveConcurrency.h"
+#include "SequentialReadDetector.h"
+
+// Read-only file type that wraps another file instance, reads in large blocks, and reads ahead of the actual range requested.
+// Only reads that continue a sequential stream read ahead, starting with one block and doubling up to readAheadBlocks as
+// the stream goes on, so that random reads fetch only the blocks they need.  The number of concurrent block reads can start
+// below its maximum and grow while that improves read throughput, in which case reading ahead is limited to the blocks
+// that the current number of concurrent reads can keep in flight.
 class AsyncFileReadAheadCache : public IAsyncFile, public ReferenceCounted<AsyncFileReadAheadCache> {
 public:
 	virtual void addref() { ReferenceCounted<AsyncFileReadAheadCache>::addref(); }
@@ -45,18 +51,19 @@ public:
 
 	// Read from the underlying file to a CacheBlock
 	ACTOR static Future<Reference<CacheBlock>> readBlock(AsyncFileReadAheadCache *f, int length, int64_t offset) {
-		Void _ = wait(f->m_max_concurrent_reads.take());
+		Void _ = wait(f->m_concurrent_reads.getLock().take());
 
 		state Reference<CacheBlock> block(new CacheBlock(length));
 		try {
 			int len = wait(f->m_f->read(block->data, length, offset));
 			block->len = len;
 		} catch(Error &e) {
-			f->m_max_concurrent_reads.release(1);
+			f->m_concurrent_reads.getLock().release(1);
 			throw e;
 		}
 
-		f->m_max_concurrent_reads.release(1);
+		f->m_concurrent_reads.getLock().release(1);
+		f->m_concurrent_reads.finished(block->len);
 		return block;
 	}
 
@@ -83,7 +90,9 @@ public:
 
 		// Start blocks up to the read ahead size beyond the last needed block but don't go past the end of the file
 		state int lastBlockNumInFile = ((fileSize + f->m_block_size - 1) / f->m_block_size) - 1;
-		int lastBlockToStart = std::min<int>(lastBlockNum + f->m_read_ahead_blocks, lastBlockNumInFile);
+		int64_t readAheadBytes = f->m_sequential_reads.read(offset, length);
+		int readAheadBlocks = std::min<int64_t>((readAheadBytes + f->m_block_size - 1) / f->m_block_size, f->m_concurrent_reads.getLimit() - 1);
+		int lastBlockToStart = std::min<int>(lastBlockNum + std::max(readAheadBlocks, 0), lastBlockNumInFile);
 
 		for(blockNum = firstBlockNum; blockNum <= lastBlockToStart; ++blockNum) {
 			Future<Reference<CacheBlock>> fblock;
@@ -180,14 +189,20 @@ public:
 	int m_block_size;
 	int m_read_ahead_blocks;
 	int m_cache_block_limit;
-	FlowLock m_max_concurrent_reads;
+	AdaptiveConcurrency m_concurrent_reads;
+	SequentialReadDetector m_sequential_reads;
 
 	// Map block numbers to future
 	std::map<int, Future<Reference<CacheBlock>>> m_blocks;
 
-	AsyncFileReadAheadCache(Reference<IAsyncFile> f, int blockSize, int readAheadBlocks, int maxConcurrentReads, int cacheSizeBlocks)
-		: m_f(f), m_block_size(blockSize), m_read_ahead_blocks(readAheadBlocks), m_max_concurrent_reads(maxConcurrentReads),
-		  m_cache_block_limit(std::max<int>(1, cacheSizeBlocks)) {
+	// If initialConcurrentReads is not positive then maxConcurrentReads are allowed from the start.  The cache is always
+	// large enough to hold the blocks being read ahead, since evicting them would cancel their reads.
+	AsyncFileReadAheadCache(Reference<IAsyncFile> f, int blockSize, int readAheadBlocks, int maxConcurrentReads, int cacheSizeBlocks,
+							int initialConcurrentReads = 0, double concurrencyMinGain = 0)
+		: m_f(f), m_block_size(blockSize), m_read_ahead_blocks(readAheadBlocks),
+		  m_cache_block_limit(std::max<int>(std::max<int>(1, cacheSizeBlocks), readAheadBlocks + 1)),
+		  m_concurrent_reads(initialConcurrentReads > 0 ? initialConcurrentReads : maxConcurrentReads, maxConcurrentReads, concurrencyMinGain),
+		  m_sequential_reads(blockSize, (int64_t)blockSize * readAheadBlocks) {
 	}
 
 };
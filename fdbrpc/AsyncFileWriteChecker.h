@@ -19,6 +19,7 @@
  */
 
 #include "IAsyncFile.h"
+#include "Checksum.h"
 
 #if VALGRIND
 #include <memcheck.h>
@@ -116,7 +117,7 @@ private:
 		}
 
 		while(page < pageEnd) {
-			uint32_t checksum = hashlittle(start, checksumHistoryPageSize, 0xab12fd93);
+			uint32_t checksum = crc32c(start, checksumHistoryPageSize, 0xab12fd93);
 			WriteInfo &history = checksumHistory[page];
 			//printf("%d %d %u %u\n", write, page, checksum, history.checksum);
 
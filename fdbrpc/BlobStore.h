@@ -61,6 +61,7 @@ public:
 			concurrent_lists,
 			concurrent_reads_per_file,
 			concurrent_writes_per_file,
+			initial_concurrency_per_file,
 			read_block_size,
 			read_ahead_blocks,
 			read_cache_blocks_per_file,
@@ -83,6 +84,7 @@ public:
 				"concurrent_lists (or cl)              Max concurrent list operations that can be in progress at once.",
 				"concurrent_reads_per_file (or crps)   Max concurrent reads in progress for any one file.",
 				"concurrent_writes_per_file (or cwps)  Max concurrent uploads in progress for any one file.",
+				"initial_concurrency_per_file (or icpf) Concurrent reads or uploads to start each file with, raised toward the limits above while throughput improves.",
 				"read_block_size (or rbs)              Block size in bytes to be used for reads.",
 				"read_ahead_blocks (or rab)            Number of blocks to read ahead of requested offset.",
 				"read_cache_blocks_per_file (or rcb)   Size of the read cache for a file in blocks.",
@@ -0,0 +1,166 @@
+/*
+ * Checksum.cpp
+ *
+ * This source file is part of the FoundationDB open source project
+ *
+ * Copyright 2013-2018 Apple Inc. and the FoundationDB project authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Checksum.h"
+#include "flow/flow.h"
+#include "flow/Hash3.h"
+#include "flow/UnitTest.h"
+#include <string.h>
+
+// XXH64, as specified at https://github.com/Cyan4973/xxHash
+static const uint64_t XXH_PRIME64_1 = 0x9E3779B185EBCA87ULL;
+static const uint64_t XXH_PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+static const uint64_t XXH_PRIME64_3 = 0x165667B19E3779F9ULL;
+static const uint64_t XXH_PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+static const uint64_t XXH_PRIME64_5 = 0x27D4EB2F165667C5ULL;
+
+static inline uint64_t xxhRotl( uint64_t x, int r ) { return (x << r) | (x >> (64 - r)); }
+
+// Unaligned little endian loads
+static inline uint64_t xxhRead64( const uint8_t* p ) { uint64_t v; memcpy(&v, p, sizeof(v)); return v; }
+static inline uint32_t xxhRead32( const uint8_t* p ) { uint32_t v; memcpy(&v, p, sizeof(v)); return v; }
+
+static inline uint64_t xxhRound( uint64_t acc, uint64_t input ) {
+	acc += input * XXH_PRIME64_2;
+	acc = xxhRotl(acc, 31);
+	return acc * XXH_PRIME64_1;
+}
+
+static inline uint64_t xxhMergeRound( uint64_t acc, uint64_t val ) {
+	acc ^= xxhRound(0, val);
+	return acc * XXH_PRIME64_1 + XXH_PRIME64_4;
+}
+
+uint64_t xxhash64( const void* data, size_t length, uint64_t seed ) {
+	const uint8_t* p = (const uint8_t*)data;
+	const uint8_t* end = p + length;
+	uint64_t h;
+
+	if (length >= 32) {
+		const uint8_t* limit = end - 32;
+		uint64_t v1 = seed + XXH_PRIME64_1 + XXH_PRIME64_2;
+		uint64_t v2 = seed + XXH_PRIME64_2;
+		uint64_t v3 = seed;
+		uint64_t v4 = seed - XXH_PRIME64_1;
+		do {
+			v1 = xxhRound(v1, xxhRead64(p));
+			v2 = xxhRound(v2, xxhRead64(p+8));
+			v3 = xxhRound(v3, xxhRead64(p+16));
+			v4 = xxhRound(v4, xxhRead64(p+24));
+			p += 32;
+		} while (p <= limit);
+
+		h = xxhRotl(v1, 1) + xxhRotl(v2, 7) + xxhRotl(v3, 12) + xxhRotl(v4, 18);
+		h = xxhMergeRound(h, v1);
+		h = xxhMergeRound(h, v2);
+		h = xxhMergeRound(h, v3);
+		h = xxhMergeRound(h, v4);
+	} else {
+		h = seed + XXH_PRIME64_5;
+	}
+
+	h += (uint64_t)length;
+
+	for(; p + 8 <= end; p += 8) {
+		h ^= xxhRound(0, xxhRead64(p));
+		h = xxhRotl(h, 27) * XXH_PRIME64_1 + XXH_PRIME64_4;
+	}
+	if (p + 4 <= end) {
+		h ^= (uint64_t)xxhRead32(p) * XXH_PRIME64_1;
+		h = xxhRotl(h, 23) * XXH_PRIME64_2 + XXH_PRIME64_3;
+		p += 4;
+	}
+	for(; p < end; p++) {
+		h ^= (*p) * XXH_PRIME64_5;
+		h = xxhRotl(h, 11) * XXH_PRIME64_1;
+	}
+
+	h ^= h >> 33;
+	h *= XXH_PRIME64_2;
+	h ^= h >> 29;
+	h *= XXH_PRIME64_3;
+	h ^= h >> 32;
+	return h;
+}
+
+TEST_CASE("fdbrpc/Checksum/known") {
+	ASSERT( crc32c("123456789", 9) == 0xe3069283 );
+	ASSERT( crc32c_append_sw(0, (const uint8_t*)"123456789", 9) == 0xe3069283 );
+	ASSERT( crc32c("56789", 5, crc32c("1234", 4)) == 0xe3069283 );
+
+	ASSERT( xxhash64("", 0) == 0xef46db3751d8e999ULL );
+	ASSERT( xxhash64("Nobody inspects the spammish repetition", 39) == 0xfbcea83c8a378bf1ULL );
+	ASSERT( xxhash64("abc", 3) == 0x44bc2cf5ad770999ULL );
+
+	return Void();
+}
+
+TEST_CASE("fdbrpc/Checksum/crc32c") {
+	// Whichever instructions crc32c_append() uses must agree with the tables, at any alignment and length
+	std::vector<uint8_t> data(70000);
+	for(auto& b : data)
+		b = g_random->randomInt(0, 256);
+
+	for(int i = 0; i < 1000; i++) {
+		int offset = g_random->randomInt(0, 64);
+		int length = g_random->random01() < 0.5 ? g_random->randomInt(0, 100) : g_random->randomInt(0, data.size() - offset);
+		uint32_t seed = g_random->randomUInt32();
+		ASSERT( crc32c_append(seed, &data[offset], length) == crc32c_append_sw(seed, &data[offset], length) );
+	}
+
+	return Void();
+}
+
+TEST_CASE("fdbrpc/perf/Checksum") {
+	std::vector<uint8_t> page(4096);
+	for(auto& b : page)
+		b = g_random->randomInt(0, 256);
+	const int pages = 50000;
+	uint64_t sink = 0;
+
+	double start = timer();
+	for(int i = 0; i < pages; i++) {
+		uint32_t a = i, b = 0;
+		hashlittle2(&page[0], page.size(), &a, &b);
+		sink += a + b;
+	}
+	double hashlittle2Time = timer() - start;
+
+	start = timer();
+	for(int i = 0; i < pages; i++)
+		sink += crc32c(&page[0], page.size(), i);
+	double crcTime = timer() - start;
+
+	start = timer();
+	for(int i = 0; i < pages; i++)
+		sink += crc32c_append_sw(i, &page[0], page.size());
+	double crcSwTime = timer() - start;
+
+	start = timer();
+	for(int i = 0; i < pages; i++)
+		sink += xxhash64(&page[0], page.size(), i);
+	double xxhashTime = timer() - start;
+
+	double mb = pages * page.size() / 1e6;
+	printf("4KB pages: hashlittle2 %.0f MB/s, crc32c %.0f MB/s (tables %.0f MB/s), xxhash64 %.0f MB/s (%llu)\n",
+		mb / hashlittle2Time, mb / crcTime, mb / crcSwTime, mb / xxhashTime, (unsigned long long)(sink & 1));
+
+	return Void();
+}
@@ -0,0 +1,44 @@
+/*
+ * Checksum.h
+ *
+ * This source file is part of the FoundationDB open source project
+ *
+ * Copyright 2013-2018 Apple Inc. and the FoundationDB project authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FDBRPC_CHECKSUM_H
+#define FDBRPC_CHECKSUM_H
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "crc32c.h"
+
+// Checksums of pages and other data kept on disk or checked by the I/O layer.  Both are many times faster than the
+// hashlittle() and hashlittle2() hashes from flow/Hash3.h that were used for this first.
+//
+// crc32c() uses the SSE 4.2 instructions on x86, the CRC instructions on ARMv8, or tables if the processor has neither,
+// chosen when the process starts.  xxhash64() is XXH64, for when 32 bits are not enough; it is portable code that runs
+// at memory speed.
+//
+// Checksums that are stored on disk must stay readable by the versions that wrote the older kind, so the formats that
+// store them record which kind each one is, and SERVER_KNOBS->PAGE_CHECKSUM_FORMAT chooses the kind that is written.
+inline uint32_t crc32c( const void* data, size_t length, uint32_t crc = 0 ) {
+	return crc32c_append( crc, (const uint8_t*)data, length );
+}
+
+uint64_t xxhash64( const void* data, size_t length, uint64_t seed = 0 );
+
+#endif
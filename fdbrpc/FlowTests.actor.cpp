@@ -24,6 +24,8 @@
 #include "flow/UnitTest.h"
 #include "flow/DeterministicRandom.h"
 #include "flow/IThreadPool.h"
+#include "flow/ThreadHelper.actor.h"
+#include "flow/Net2Packet.h"
 #include "fdbrpc.h"
 #include "IAsyncFile.h"
 
@@ -354,6 +356,18 @@ TEST_CASE("flow/flow/quorum")
 		ps[i].send(i);
 	}
 	ASSERT(qs[ps.size()].isReady());
+
+	// Futures that are already ready are counted in order, whether or not any others are
+	vector<Future<int>> ready = { 1, 2, Future<int>(io_error()), 4 };
+	ASSERT( quorum(ready, 2).isReady() && !quorum(ready, 2).isError() );
+	ASSERT( quorum(ready, 3).isError() && quorum(ready, 3).getError().code() == error_code_io_error );
+
+	Promise<int> p;
+	vector<Future<int>> someReady = { p.getFuture(), 1, 2 };
+	ASSERT( quorum(someReady, 2).isReady() && !quorum(someReady, 3).isReady() );
+	Future<Void> q = quorum(someReady, 3);
+	p.send(0);
+	ASSERT( q.isReady() && !q.isError() );
 	return Void();
 }
 
@@ -666,6 +680,49 @@ TEST_CASE("flow/flow/yieldedFuture/random")
 }
 
 
+BENCHMARK_CASE("flow/Arena/allocate") {
+	for (int i = 0; i < iterations; i++) {
+		Arena arena;
+		for (int j = 0; j < 16; j++)
+			benchmarkSink(new (arena) uint8_t[64]);
+	}
+}
+
+BENCHMARK_CASE("flow/serialize/BinaryWriter") {
+	Standalone<StringRef> value = makeString(100);
+	memset(mutateString(value), 'v', value.size());
+	for (int i = 0; i < iterations; i++) {
+		BinaryWriter wr(IncludeVersion());
+		wr << i << value << int64_t(i);
+		benchmarkSink(wr.getLength());
+	}
+}
+
+BENCHMARK_CASE("flow/serialize/BinaryReader") {
+	Standalone<StringRef> value = makeString(100);
+	memset(mutateString(value), 'v', value.size());
+	BinaryWriter wr(IncludeVersion());
+	wr << int(1) << value << int64_t(2);
+	StringRef data = wr.toStringRef();
+	for (int i = 0; i < iterations; i++) {
+		BinaryReader rd(data, IncludeVersion());
+		int a;
+		Standalone<StringRef> b;
+		int64_t c;
+		rd >> a >> b >> c;
+		benchmarkSink(c);
+	}
+}
+
+BENCHMARK_CASE("flow/Promise/send") {
+	for (int i = 0; i < iterations; i++) {
+		Promise<int> p;
+		Future<int> f = p.getFuture();
+		p.send(i);
+		benchmarkSink(f.get());
+	}
+}
+
 TEST_CASE("flow/perf/yieldedFuture")
 {
 	double start;
@@ -700,6 +757,33 @@ TEST_CASE("flow/perf/yieldedFuture")
 	return Void();
 }
 
+ACTOR static Future<Void> delayZeroLoop( int n, int taskID ) {
+	state int i;
+	for(i = 0; i < n; i++)
+		Void _ = wait( delay(0, taskID) );
+	return Void();
+}
+
+TEST_CASE("flow/perf/run queue")
+{
+	// Measures how fast the network runs tasks that are ready immediately, spread over several priorities so that the run
+	// queue always holds tasks of more than one
+	state int N = 1000000;
+	state int actors = 100;
+	state std::vector<Future<Void>> loops;
+	state double start = timer();
+
+	{
+		int priorities[] = { TaskDefaultYield, TaskDefaultDelay, TaskDefaultEndpoint, TaskDefaultPromiseEndpoint, TaskLowPriority };
+		for(int i = 0; i < actors; i++)
+			loops.push_back( delayZeroLoop( N / actors, priorities[i % 5] ) );
+	}
+	Void _ = wait( waitForAll(loops) );
+	printf("delay(0) by %d actors at 5 priorities: %0.2f M tasks/sec\n", actors, N / 1e6 / (timer() - start));
+
+	return Void();
+}
+
 TEST_CASE("flow/flow/chooseTwoActor")
 {
 	ASSERT(expectActorCount(0));
@@ -1192,3 +1276,209 @@ TEST_CASE("fdbrpc/flow/wait_expression_after_cancel")
 	ASSERT( a == 1 );
 	return Void();
 }
+
+struct ThreadSafePromiseStreamTestSender {
+	Reference<ThreadSafePromiseStream<int>> stream;
+	int count;
+
+	THREAD_FUNC run( void* arg ) {
+		ThreadSafePromiseStreamTestSender* self = (ThreadSafePromiseStreamTestSender*)arg;
+		for(int i=0; i<self->count; i++)
+			self->stream->send( i );
+		self->stream->send( -1 );
+		// The last reference must be released on the network thread, which still holds one
+		self->stream = Reference<ThreadSafePromiseStream<int>>();
+		delete self;
+		THREAD_RETURN;
+	}
+};
+
+TEST_CASE("flow/flow/ThreadSafePromiseStream")
+{
+	state Reference<ThreadSafePromiseStream<int>> stream( new ThreadSafePromiseStream<int> );
+	state FutureStream<int> values = stream->getFuture();
+	state int next = 0;
+
+	ThreadSafePromiseStreamTestSender* sender = new ThreadSafePromiseStreamTestSender;
+	sender->stream = stream;
+	sender->count = 10000;
+	g_network->startThread( &ThreadSafePromiseStreamTestSender::run, sender );
+
+	loop {
+		int v = waitNext( values );
+		if (v < 0) break;
+		ASSERT( v == next++ );
+	}
+	ASSERT( next == 10000 );
+
+	// Sends from the network thread are delivered by a later task rather than synchronously
+	stream->send( 12 );
+	ASSERT( !values.isReady() );
+	int v = waitNext( values );
+	ASSERT( v == 12 );
+
+	return Void();
+}
+
+static std::string packetChainContents( PacketBuffer* pb ) {
+	std::string s;
+	for(; pb; pb = pb->nextPacketBuffer())
+		s.append( (const char*)pb->bytes_begin() + pb->bytes_sent, pb->bytes_written - pb->bytes_sent );
+	return s;
+}
+
+TEST_CASE("flow/flow/PacketWriter by reference")
+{
+	Arena arena;
+	StringRef small = LiteralStringRef("small");
+	StringRef large = makeString( 100000, arena );
+	for(int i = 0; i < large.size(); i++)
+		mutateString(large)[i] = (uint8_t)i;
+
+	BinaryWriter expected( AssumeVersion(currentProtocolVersion) );
+	expected << small << large << small;
+
+	UnsentPacketQueue unsent;
+	ReliablePacketList reliable;
+	PacketBuffer* pb = unsent.getWriteBuffer();
+	ReliablePacket* rp = new ReliablePacket;
+	PacketWriter wr( pb, rp, AssumeVersion(currentProtocolVersion) );
+	wr << small;
+	serializeByReference( wr, large, arena );
+	wr << small;
+	unsent.setWriteBuffer( wr.finish() );
+	reliable.insert( rp );
+
+	ASSERT( wr.size() == expected.getLength() );
+	ASSERT( packetChainContents( unsent.getUnsent() ) == expected.toStringRef().toString() );
+
+	bool sentByReference = false;
+	for(PacketBuffer* b = unsent.getUnsent(); b; b = b->nextPacketBuffer())
+		if (b->isByReference()) {
+			ASSERT( b->bytes_begin() == large.begin() );
+			sentByReference = true;
+		}
+	ASSERT( sentByReference );
+
+	// Resending after a reconnect copies reliable packets out of the by-reference buffers
+	unsent.discardAll();
+	PacketBuffer* first = new PacketBuffer;
+	reliable.compact( first, NULL );
+	ASSERT( packetChainContents( first ) == expected.toStringRef().toString() );
+	for(PacketBuffer* b = first; b; b = b->nextPacketBuffer())
+		ASSERT( !b->isByReference() );
+
+	reliable.discardAll();
+	while (first) {
+		PacketBuffer* n = first->nextPacketBuffer();
+		first->delref();
+		first = n;
+	}
+
+	return Void();
+}
+
+TEST_CASE("flow/flow/LargeBlockPool size classes")
+{
+	int prevClass = 0;
+	for(int size = 4097; size <= LargeBlockPool::MAX_POOLED_SIZE; size += g_random->randomInt(1, 1000)) {
+		int c = LargeBlockPool::getSizeClass(size);
+		int classSize = LargeBlockPool::getClassSize(c);
+		ASSERT( c >= prevClass && c < LargeBlockPool::CLASSES-1 );
+		ASSERT( classSize >= size && (size <= LargeBlockPool::MIN_SIZE || classSize - size < size / 4) );
+		ASSERT( c == 0 || LargeBlockPool::getClassSize(c-1) < size );
+		prevClass = c;
+	}
+	ASSERT( LargeBlockPool::getSizeClass(LargeBlockPool::MAX_POOLED_SIZE) == LargeBlockPool::CLASSES-2 );
+	ASSERT( LargeBlockPool::getSizeClass(LargeBlockPool::MAX_POOLED_SIZE+1) == LargeBlockPool::CLASSES-1 );
+
+	int c = LargeBlockPool::getSizeClass(20000);
+	int live = LargeBlockPool::getLiveBlocks(c);
+	void* a = LargeBlockPool::allocate(LargeBlockPool::getClassSize(c));
+	void* b = LargeBlockPool::allocate(LargeBlockPool::getClassSize(c));
+	ASSERT( LargeBlockPool::getLiveBlocks(c) == live + 2 && LargeBlockPool::getHighWaterBlocks(c) >= live + 2 );
+	LargeBlockPool::release(a, LargeBlockPool::getClassSize(c));
+	LargeBlockPool::release(b, LargeBlockPool::getClassSize(c));
+	ASSERT( LargeBlockPool::getLiveBlocks(c) == live );
+
+	return Void();
+}
+
+struct PreallocatedTestReply {
+	Arena arena;
+	VectorRef<StringRef> items;
+	Optional<int64_t> popped;
+	int64_t version;
+	bool more;
+
+	template <class Ar>
+	void serialize( Ar& ar ) {
+		ar & items & popped & version & more & arena;
+	}
+};
+PREALLOCATED_SERIALIZABLE( PreallocatedTestReply );
+
+static PreallocatedTestReply makePreallocatedTestReply( int items, int itemBytes ) {
+	PreallocatedTestReply r;
+	for(int i = 0; i < items; i++) {
+		StringRef s = makeString( g_random->randomInt(0, itemBytes), r.arena );
+		for(int j = 0; j < s.size(); j++)
+			mutateString(s)[j] = (uint8_t)g_random->randomInt(0, 256);
+		r.items.push_back( r.arena, s );
+	}
+	if (g_random->coinflip())
+		r.popped = g_random->randomInt64(0, 1e9);
+	r.version = g_random->randomInt64(0, 1e9);
+	r.more = g_random->coinflip();
+	return r;
+}
+
+TEST_CASE("flow/flow/preallocated serialization")
+{
+	for(int size = 1; size <= 100000; size *= 10) {
+		PreallocatedTestReply r = makePreallocatedTestReply( size, 20 );
+		BinaryWriter expected( AssumeVersion(currentProtocolVersion) );
+		expected << r;
+
+		SizeCounter counter( AssumeVersion(currentProtocolVersion) );
+		counter << r;
+		ASSERT( counter.getLength() == expected.getLength() );
+		ASSERT( BinaryWriter::toValue( r, AssumeVersion(currentProtocolVersion) ) == expected.toStringRef() );
+		BinaryWriter versioned( IncludeVersion() );
+		versioned << r;
+		ASSERT( BinaryWriter::toValue( r, IncludeVersion() ) == versioned.toStringRef() );
+
+		UnsentPacketQueue unsent;
+		PacketWriter wr( unsent.getWriteBuffer(), NULL, AssumeVersion(currentProtocolVersion) );
+		SerializeSource<PreallocatedTestReply>( r ).serializePacketWriter( wr );
+		unsent.setWriteBuffer( wr.finish() );
+		ASSERT( wr.size() == expected.getLength() );
+		ASSERT( packetChainContents( unsent.getUnsent() ) == expected.toStringRef().toString() );
+		unsent.discardAll();
+	}
+
+	// Compare against the checked BinaryWriter path for a point read sized message and a range read sized message
+	for(int items = 1; items <= 1000; items *= 1000) {
+		PreallocatedTestReply r = makePreallocatedTestReply( items, 100 );
+		int N = 1000000 / items;
+		int64_t total = 0;
+
+		double start = timer();
+		for(int i = 0; i < N; i++) {
+			BinaryWriter wr( AssumeVersion(currentProtocolVersion) );
+			wr << r;
+			total += Standalone<StringRef>( wr.toStringRef() ).size();
+		}
+		double checked = timer() - start;
+
+		start = timer();
+		for(int i = 0; i < N; i++)
+			total -= BinaryWriter::toValue( r, AssumeVersion(currentProtocolVersion) ).size();
+		double preallocated = timer() - start;
+
+		ASSERT( total == 0 );
+		printf("serialize %d items: checked %0.2f M/sec, preallocated %0.2f M/sec\n", items, N / 1e6 / checked, N / 1e6 / preallocated);
+	}
+
+	return Void();
+}
@@ -228,9 +228,13 @@ struct Peer : NonCopyable {
 	bool outgoingConnectionIdle;  // We don't actually have a connection open and aren't trying to open one because we don't have anything to send
 	double lastConnectTime;
 	double reconnectionDelay;
+	double lastDataPacketSentTime;  // When a packet other than a ping was last queued for the peer
+	int64_t bytesReceived;  // Counts everything read from connections to the peer, so the monitor can tell that one is alive
+	int outstandingReplies;  // Replies we are waiting for from the peer or still owe it; the connection isn't idle while there are any
 
 	explicit Peer( TransportData* transport, NetworkAddress const& destination, bool doConnect = true ) 
-		: transport(transport), destination(destination), outgoingConnectionIdle(!doConnect), lastConnectTime(0.0), reconnectionDelay(FLOW_KNOBS->INITIAL_RECONNECTION_TIME), compatible(true)
+		: transport(transport), destination(destination), outgoingConnectionIdle(!doConnect), lastConnectTime(0.0), reconnectionDelay(FLOW_KNOBS->INITIAL_RECONNECTION_TIME), compatible(true),
+		  lastDataPacketSentTime(now()), bytesReceived(0), outstandingReplies(0)
 	{
 		if(doConnect) {
 			connect = connectionKeeper(this);
@@ -303,22 +307,48 @@ struct Peer : NonCopyable {
 		}
 	}
 
+	// Only outgoing connections to a public address are closed for being idle, since only those can be opened again when
+	// there is something to send
+	bool isIdle() const {
+		return destination.isPublic() && unsent.empty() && reliable.empty() && !outstandingReplies &&
+			now() - lastDataPacketSentTime > FLOW_KNOBS->CONNECTION_MONITOR_IDLE_TIMEOUT;
+	}
+
 	ACTOR static Future<Void> connectionMonitor( Peer *peer ) {
 		state RequestStream< ReplyPromise<Void> > remotePing( Endpoint( peer->destination, WLTOKEN_PING_PACKET ) );
+		state int64_t lastBytesReceived = peer->bytesReceived;
 
 		loop {
 			Void _ = wait( delayJittered( FLOW_KNOBS->CONNECTION_MONITOR_LOOP_TIME ) );
 
-			// SOMEDAY: Stop monitoring and close the connection after a long period of inactivity with no reliable or onDisconnect requests outstanding
+			if (peer->isIdle()) {
+				TEST(true); // Closing an idle connection
+				TraceEvent("ConnectionIdle").detail("WithAddr", peer->destination).suppressFor(1.0);
+				throw connection_idle();
+			}
+
+			// Anything read from the peer shows that the connection is alive, so a ping is only needed when it has been quiet
+			if (peer->bytesReceived != lastBytesReceived) {
+				lastBytesReceived = peer->bytesReceived;
+				continue;
+			}
 
 			state ReplyPromise<Void> reply;
 			FlowTransport::transport().sendUnreliable( SerializeSource<ReplyPromise<Void>>(reply), remotePing.getEndpoint() );
 
 			choose {
-				when (Void _ = wait( delay( FLOW_KNOBS->CONNECTION_MONITOR_TIMEOUT ) )) { TraceEvent("ConnectionTimeout").detail("WithAddr", peer->destination); throw connection_failed(); }
+				when (Void _ = wait( delay( FLOW_KNOBS->CONNECTION_MONITOR_TIMEOUT ) )) {
+					// The reply may be queued behind a lot of other data, which is as good a sign of life
+					if (peer->bytesReceived == lastBytesReceived) {
+						TraceEvent("ConnectionTimeout").detail("WithAddr", peer->destination);
+						throw connection_failed();
+					}
+					TEST(true); // Ping timed out on a connection that is still receiving data
+				}
 				when (Void _ = wait( reply.getFuture() )) {}
 				when (Void _ = wait( peer->incompatibleDataRead.onTrigger())) {}
 			}
+			lastBytesReceived = peer->bytesReceived;
 		}
 	}
 
@@ -390,7 +420,7 @@ struct Peer : NonCopyable {
 					self->transport->countConnEstablished++;
 					Void _ = wait( connectionWriter( self, conn ) || reader || connectionMonitor(self) );
 				} catch (Error& e) {
-					 if (e.code() == error_code_connection_failed || e.code() == error_code_actor_cancelled || ( g_network->isSimulated() && e.code() == error_code_checksum_failed ))
+					 if (e.code() == error_code_connection_failed || e.code() == error_code_connection_idle || e.code() == error_code_actor_cancelled || ( g_network->isSimulated() && e.code() == error_code_checksum_failed ))
 						self->transport->countConnClosedWithoutError++;
 					else
 						self->transport->countConnClosedWithError++;
@@ -406,7 +436,7 @@ struct Peer : NonCopyable {
 				}
 				self->discardUnreliablePackets();
 				reader = Future<Void>();
-				bool ok = e.code() == error_code_connection_failed || e.code() == error_code_actor_cancelled || ( g_network->isSimulated() && e.code() == error_code_checksum_failed );
+				bool ok = e.code() == error_code_connection_failed || e.code() == error_code_connection_idle || e.code() == error_code_actor_cancelled || ( g_network->isSimulated() && e.code() == error_code_checksum_failed );
 
 				if(self->compatible) {
 					TraceEvent(ok ? SevInfo : SevWarnAlways, "ConnectionClosed", conn ? conn->getDebugID() : UID()).detail("PeerAddr", self->destination).error(e, true).suppressFor(1.0);
@@ -553,6 +583,16 @@ static void scanPackets( TransportData* transport, uint8_t*& unprocessed_begin,
 	}
 }
 
+// Returns the total size (including its length and checksum header) of the packet starting at begin, or 0 if the header
+// hasn't been received yet or the length is invalid (which scanPackets will report)
+static int getPendingPacketSize( TransportData* transport, const uint8_t* begin, const uint8_t* end, NetworkAddress const& peerAddress ) {
+	int headerSize = (transport->localAddress.isTLS() || peerAddress.isTLS()) ? sizeof(uint32_t) : sizeof(uint32_t) * 2;
+	if (end - begin < headerSize) return 0;
+	uint32_t packetLen = *(uint32_t*)begin;
+	if (packetLen > FLOW_KNOBS->PACKET_LIMIT) return 0;
+	return headerSize + packetLen;
+}
+
 ACTOR static Future<Void> connectionReader(
 		TransportData* transport,
 		Reference<IConnection> conn, 
@@ -579,10 +619,12 @@ ACTOR static Future<Void> connectionReader(
 		loop {
 			loop {
 				int readAllBytes = buffer_end - unprocessed_end;
-				if (readAllBytes < 4096) {
+				int pendingPacketBytes = expectConnectPacket ? 0 : getPendingPacketSize( transport, unprocessed_begin, unprocessed_end, peerAddress );
+				if (readAllBytes < 4096 || unprocessed_begin + pendingPacketBytes > buffer_end) {
 					Arena newArena;
 					int unproc_len = unprocessed_end - unprocessed_begin;
-					int len = std::max( 65536, unproc_len*2 );
+					// Size the buffer so that a large pending packet is received in place and never copied again
+					int len = std::max( 65536, std::max( unproc_len*2, pendingPacketBytes ) );
 					uint8_t* newBuffer = new (newArena) uint8_t[ len ];
 					memcpy( newBuffer, unprocessed_begin, unproc_len );
 					arena = newArena;
@@ -594,6 +636,7 @@ ACTOR static Future<Void> connectionReader(
 
 				int readBytes = conn->read( unprocessed_end, buffer_end );
 				if (!readBytes) break;
+				if (peer) peer->bytesReceived += readBytes;
 				state bool readWillBlock = readBytes != readAllBytes;
 				unprocessed_end += readBytes;
 			
@@ -852,6 +895,9 @@ static PacketID sendPacket( TransportData* self, ISerializeSource const& what, c
 			return (PacketID)NULL;
 		}
 
+		if (destination.token != WLTOKEN_PING_PACKET)
+			peer->lastDataPacketSentTime = now();
+
 		bool firstUnsent = peer->unsent.empty();
 
 		PacketBuffer* pb = peer->unsent.getWriteBuffer();
@@ -881,15 +927,15 @@ static PacketID sendPacket( TransportData* self, ISerializeSource const& what, c
 			// Find the correct place to start calculating checksum
 			uint32_t checksumUnprocessedLength = len;
 			prevBytesWritten += packetInfoSize;
-			if (prevBytesWritten >= PacketBuffer::DATA_SIZE) {
-				prevBytesWritten -= PacketBuffer::DATA_SIZE;
+			if (prevBytesWritten >= checksumPb->bytes_written) {
+				prevBytesWritten -= checksumPb->bytes_written;
 				checksumPb = checksumPb->nextPacketBuffer();
 			}
 
-			// Checksum calculation
+			// Checksum calculation; buffers may be by-reference or partially filled, so use each buffer's own length
 			while (checksumUnprocessedLength > 0) {
-				uint32_t processLength = std::min(checksumUnprocessedLength, (uint32_t)(PacketBuffer::DATA_SIZE - prevBytesWritten));
-				checksum = crc32c_append(checksum, checksumPb->data + prevBytesWritten, processLength);
+				uint32_t processLength = std::min(checksumUnprocessedLength, (uint32_t)(checksumPb->bytes_written - prevBytesWritten));
+				checksum = crc32c_append(checksum, checksumPb->bytes_begin() + prevBytesWritten, processLength);
 				checksumUnprocessedLength -= processLength;
 				checksumPb = checksumPb->nextPacketBuffer();
 				prevBytesWritten = 0;
@@ -948,6 +994,20 @@ void FlowTransport::sendUnreliable( ISerializeSource const& what, const Endpoint
 	sendPacket( self, what, destination, false );
 }
 
+void FlowTransport::addPeerReference( const Endpoint& endpoint ) {
+	if (!endpoint.address.isValid() || endpoint.address == self->localAddress) return;
+	auto peer = self->peers.find(endpoint.address);
+	if (peer != self->peers.end())
+		peer->second->outstandingReplies++;
+}
+
+void FlowTransport::removePeerReference( const Endpoint& endpoint ) {
+	if (!endpoint.address.isValid() || endpoint.address == self->localAddress) return;
+	auto peer = self->peers.find(endpoint.address);
+	if (peer != self->peers.end() && peer->second->outstandingReplies > 0)
+		peer->second->outstandingReplies--;
+}
+
 int FlowTransport::getEndpointCount() { 
 	return -1; 
 }
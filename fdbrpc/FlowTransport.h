@@ -104,6 +104,11 @@ public:
 
 	void sendUnreliable( ISerializeSource const& what, const Endpoint& destination );// { cancelReliable(sendReliable(what,destination)); }
 
+	void addPeerReference( const Endpoint& endpoint );
+	void removePeerReference( const Endpoint& endpoint );
+	// While a remote endpoint has references, the connection to its address is not closed for being idle.  Used for
+	// replies that are awaited from or owed to the process at the address; references to local endpoints are ignored.
+
 	int getEndpointCount();
 	// for tracing only
 
@@ -124,6 +129,13 @@ private:
 	void loadedEndpoint(Endpoint&);
 };
 
+// Holds a peer reference to endpoint for as long as it exists
+struct PeerReference : NonCopyable {
+	Endpoint endpoint;
+	explicit PeerReference( Endpoint const& endpoint ) : endpoint(endpoint) { FlowTransport::transport().addPeerReference(endpoint); }
+	~PeerReference() { FlowTransport::transport().removePeerReference(endpoint); }
+};
+
 inline bool Endpoint::isLocal() const { 
 	return address == FlowTransport::transport().getLocalAddress(); 
 }
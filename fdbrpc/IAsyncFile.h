@@ -47,7 +47,10 @@ public:
 		OPEN_ATOMIC_WRITE_AND_CREATE = 0x80000,  // A temporary file is opened, and on the first call to sync() it is atomically renamed to the given filename
 		OPEN_LARGE_PAGES = 0x100000, 
 		OPEN_NO_AIO = 0x200000,                   // Don't use AsyncFileKAIO or similar implementations that rely on filesystem support for AIO
-		OPEN_CACHED_READ_ONLY = 0x400000          // AsyncFileCached opens files read/write even if you specify read only
+		OPEN_CACHED_READ_ONLY = 0x400000,         // AsyncFileCached opens files read/write even if you specify read only
+		OPEN_8K_PAGES = 0x800000,                 // AsyncFileCached caches the file in pages of this size rather than 4K pages
+		OPEN_16K_PAGES = 0x1000000,
+		OPEN_32K_PAGES = 0x2000000
 	};  
 
 	virtual void addref() = 0;
@@ -0,0 +1,151 @@
+/*
+ * IOClassQueue.h
+ *
+ * This source file is part of the FoundationDB open source project
+ *
+ * Copyright 2013-2018 Apple Inc. and the FoundationDB project authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FDBRPC_IOCLASSQUEUE_H
+#define FDBRPC_IOCLASSQUEUE_H
+#pragma once
+
+#include <queue>
+#include "flow/flow.h"
+#include "flow/Knobs.h"
+#include "flow/TDMetric.actor.h"
+
+// The classes that unbuffered disk requests are scheduled in, by the task priority of the actor or coroutine that
+// issues them: reads and log writes (above TaskDiskWrite), storage engine commits (the SQLite writer runs at
+// TaskDiskWrite, and fetchKeys data reaches the disk through its commits), and background work such as SQLite spring
+// cleaning (TaskDiskBackground and below).
+enum IOClass { IOClassForeground, IOClassCommit, IOClassBackground, IOClassCount };
+
+inline IOClass ioClassForTask( int task ) {
+	return task > TaskDiskWrite ? IOClassForeground : task > TaskDiskBackground ? IOClassCommit : IOClassBackground;
+}
+
+// A weighted fair queue of the requests waiting to be submitted to the kernel.  Each class is charged the bytes of the
+// requests it submits divided by its weight (IO_*_WEIGHT), and the class charged least so far submits next, so that a
+// busy class gets its share of the bandwidth but cannot hold up the others.  Within a class requests keep the order of
+// their prio, as in a single priority queue.  Requests other than foreground ones together may not fill the last
+// IO_FOREGROUND_RESERVED_REQUESTS submission slots, so that reads are not queued behind them in the device.
+//
+// T must have `IOClass ioClass`, `int64_t prio`, `double enqueueTime` and `int64_t ioBytes() const`.
+template <class T>
+class IOClassQueue {
+public:
+	IOClassQueue() : queued(0), virtualTime(0) {}
+
+	void initMetrics() {
+		for(int c = 0; c < IOClassCount; c++) {
+			StringRef name( (const uint8_t*)className(c), strlen(className(c)) );
+			classes[c].countRequests.init(LiteralStringRef("AsyncFile.IOClassRequests"), name);
+			classes[c].countBytes.init(LiteralStringRef("AsyncFile.IOClassBytes"), name);
+			classes[c].queueMicros.init(LiteralStringRef("AsyncFile.IOClassQueueMicros"), name);
+			classes[c].latencyMicros.init(LiteralStringRef("AsyncFile.IOClassLatencyMicros"), name);
+		}
+	}
+
+	size_t size() const { return queued; }
+
+	void push( T* io ) {
+		io->enqueueTime = now();
+		insert( io );
+	}
+
+	// Returns the next request to submit, or nullptr if only requests which must leave the remaining ones of the
+	// maxOutstanding submission slots to foreground requests are queued
+	T* pop( int maxOutstanding ) {
+		bool reserved = backgroundOutstanding() >= std::max(maxOutstanding - FLOW_KNOBS->IO_FOREGROUND_RESERVED_REQUESTS, 1);
+		Class* next = nullptr;
+		for(int c = 0; c < IOClassCount; c++) {
+			Class& cls = classes[c];
+			if( cls.queue.size() && (c == IOClassForeground || !reserved) && (!next || cls.pass < next->pass) )
+				next = &cls;
+		}
+		if( !next )
+			return nullptr;
+
+		T* io = next->queue.top();
+		next->queue.pop();
+		--queued;
+		++next->outstanding;
+		virtualTime = next->pass;
+		next->pass += double( std::max<int64_t>(io->ioBytes(), 4096) ) / weight( io->ioClass );
+		next->queueMicros += int64_t( (now() - io->enqueueTime) * 1e6 );
+		return io;
+	}
+
+	// Puts back a request returned by pop() that could not be submitted
+	void requeue( T* io ) {
+		--classes[io->ioClass].outstanding;
+		insert( io );
+	}
+
+	// Records the completion of a request returned by pop()
+	void complete( T* io ) {
+		Class& cls = classes[io->ioClass];
+		--cls.outstanding;
+		++cls.countRequests;
+		cls.countBytes += io->ioBytes();
+		cls.latencyMicros += int64_t( (now() - io->enqueueTime) * 1e6 );
+	}
+
+	static const char* className( int c ) {
+		return c == IOClassForeground ? "Foreground" : c == IOClassCommit ? "Commit" : "Background";
+	}
+
+private:
+	struct Class {
+		std::priority_queue<T*, std::vector<T*>, typename T::indirect_order_by_priority> queue;
+		int outstanding;
+		double pass;  // Bytes charged to the class, over its weight
+
+		Int64MetricHandle countRequests;
+		Int64MetricHandle countBytes;
+		Int64MetricHandle queueMicros;  // Total time completed and submitted requests spent queued here
+		Int64MetricHandle latencyMicros;  // Total time from queueing to completion
+
+		Class() : outstanding(0), pass(0) {}
+	};
+	Class classes[IOClassCount];
+	size_t queued;
+	double virtualTime;  // The pass of the class that submitted last
+
+	int backgroundOutstanding() const {
+		int n = 0;
+		for(int c = 0; c < IOClassCount; c++)
+			if( c != IOClassForeground )
+				n += classes[c].outstanding;
+		return n;
+	}
+
+	static double weight( IOClass c ) {
+		int w = c == IOClassForeground ? FLOW_KNOBS->IO_FOREGROUND_WEIGHT : c == IOClassCommit ? FLOW_KNOBS->IO_COMMIT_WEIGHT : FLOW_KNOBS->IO_BACKGROUND_WEIGHT;
+		return std::max(w, 1);
+	}
+
+	void insert( T* io ) {
+		Class& cls = classes[io->ioClass];
+		// A class that was idle starts level with the others rather than with the credit of its idle time
+		if( cls.queue.empty() )
+			cls.pass = std::max( cls.pass, virtualTime );
+		cls.queue.push( io );
+		++queued;
+	}
+};
+
+#endif
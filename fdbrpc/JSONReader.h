@@ -0,0 +1,97 @@
+/*
+ * JSONReader.h
+ *
+ * This source file is part of the FoundationDB open source project
+ *
+ * Copyright 2013-2018 Apple Inc. and the FoundationDB project authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FDBRPC_JSONREADER_H
+#define FDBRPC_JSONREADER_H
+#pragma once
+
+#include "fdbclient/json_spirit/json_spirit_reader_template.h"
+#include "rapidjson/reader.h"
+
+// Builds a json_spirit value from the events of rapidjson's SAX reader.  Each object or array is inserted into its
+// parent when it begins and filled in place, so no part of the document is copied after it is parsed.
+struct JSONSpiritHandler : rapidjson::BaseReaderHandler<rapidjson::UTF8<>, JSONSpiritHandler> {
+	json_spirit::mValue& root;
+	std::vector<json_spirit::mValue*> open;  // The objects and arrays being filled, innermost last
+	std::string key;  // The key of the next member of the innermost object
+
+	explicit JSONSpiritHandler( json_spirit::mValue& root ) : root(root) {}
+
+	// rapidjson decodes \u escapes to UTF-8, while json_spirit reads each into one char of a std::string (and writes
+	// every char outside ASCII as one), so characters outside ASCII are narrowed back to one char each
+	static std::string narrow( const char* s, rapidjson::SizeType length ) {
+		std::string result( s, length );
+		if( std::find_if( result.begin(), result.end(), [](char c) { return c & 0x80; } ) == result.end() )
+			return result;
+		rapidjson::StringStream stream( result.c_str() );
+		std::string narrowed;
+		unsigned codepoint;
+		while( stream.Tell() < length && rapidjson::UTF8<>::Decode( stream, &codepoint ) )
+			narrowed.push_back( char(codepoint) );
+		return narrowed;
+	}
+
+	json_spirit::mValue* add( json_spirit::mValue const& v ) {
+		if( open.empty() ) {
+			root = v;
+			return &root;
+		}
+		json_spirit::mValue& parent = *open.back();
+		if( parent.type() == json_spirit::obj_type ) {
+			json_spirit::mValue& member = parent.get_obj()[key];
+			member = v;
+			return &member;
+		}
+		json_spirit::mArray& elements = parent.get_array();
+		elements.push_back( v );
+		return &elements.back();
+	}
+
+	bool Null() { add( json_spirit::mValue() ); return true; }
+	bool Bool( bool b ) { add( b ); return true; }
+	bool Int( int i ) { add( int64_t(i) ); return true; }
+	bool Uint( unsigned u ) { add( int64_t(u) ); return true; }
+	bool Int64( int64_t i ) { add( i ); return true; }
+	// As json_spirit does, only integers above the range of int64_t are read as unsigned
+	bool Uint64( uint64_t u ) { add( u <= uint64_t(std::numeric_limits<int64_t>::max()) ? json_spirit::mValue(int64_t(u)) : json_spirit::mValue(u) ); return true; }
+	bool Double( double d ) { add( d ); return true; }
+	bool String( const char* s, rapidjson::SizeType length, bool copy ) { add( narrow(s, length) ); return true; }
+	bool Key( const char* s, rapidjson::SizeType length, bool copy ) { key = narrow(s, length); return true; }
+	bool StartObject() { open.push_back( add( json_spirit::mObject() ) ); return true; }
+	bool EndObject( rapidjson::SizeType memberCount ) { open.pop_back(); return true; }
+	bool StartArray() { open.push_back( add( json_spirit::mArray() ) ); return true; }
+	bool EndArray( rapidjson::SizeType elementCount ) { open.pop_back(); return true; }
+};
+
+// Parses text into value like json_spirit::read_string(), but faster, and with doubles read exactly (json_spirit can
+// be off in the last bit).  Large documents such as status spend most of their parse in json_spirit's reader.
+// Text rapidjson does not accept, such as json_spirit's \x escapes, is parsed again with json_spirit.
+inline bool readJSON( std::string const& text, json_spirit::mValue& value ) {
+	JSONSpiritHandler handler( value );
+	rapidjson::Reader reader;
+	rapidjson::StringStream stream( text.c_str() );
+	if( !reader.Parse<rapidjson::kParseFullPrecisionFlag>( stream, handler ).IsError() )
+		return true;
+
+	value = json_spirit::mValue();
+	return json_spirit::read_string( text, value );
+}
+
+#endif
@@ -51,26 +51,32 @@ struct ModelHolder : NonCopyable, public ReferenceCounted<ModelHolder> {
 		}
 	}
 
-	void release(bool clean, bool futureVersion, double penalty, bool measureLatency = true) {
+	void release(bool clean, bool futureVersion, double penalty, int64_t queueDepth = -1, bool measureLatency = true) {
 		if(model && !released) {
 			released = true;
 			double latency = (clean || measureLatency) ? now() - startTime : 0.0;
-			model->endRequest(token, latency, penalty, delta, clean, futureVersion);
+			model->endRequest(token, latency, penalty, delta, clean, futureVersion, queueDepth);
 		}
 	}
 
 	~ModelHolder() { 
-		release(false, false, -1.0, false);
+		release(false, false, -1.0, -1, false);
 	}
 };
 
 struct LoadBalancedReply {
 	double penalty;
-	LoadBalancedReply() : penalty(1.0) {}
+	int64_t queueDepth;  // The number of requests the server was processing, or -1 if it did not say
+	LoadBalancedReply() : penalty(1.0), queueDepth(-1) {}
 
 	template <class Ar>
 	void serialize(Ar &ar) {
 		ar & penalty;
+		if( ar.protocolVersion() >= 0x0FDB00A560060001LL ) {
+			ar & queueDepth;
+		} else if( ar.isDeserializing ) {
+			queueDepth = -1;
+		}
 	}
 };
 
@@ -92,7 +98,7 @@ bool checkAndProcessResult(ErrorOr<T> result, Reference<ModelHolder> holder, boo
 		loadBalancedReply = getLoadBalancedReply(&result.get());
 	}
 
-	holder->release(receivedResponse, futureVersion, loadBalancedReply.present() ? loadBalancedReply.get().penalty : -1.0);
+	holder->release(receivedResponse, futureVersion, loadBalancedReply.present() ? loadBalancedReply.get().penalty : -1.0, loadBalancedReply.present() ? loadBalancedReply.get().queueDepth : -1);
 	
 	if(result.present()) {
 		return true;
@@ -181,7 +187,75 @@ Future< REPLY_TYPE(Request) > loadBalance(
 	if( nextAlt >= bestAlt )
 		nextAlt++;
 
-	if(model) {
+	if(model && FLOW_KNOBS->LOAD_BALANCE_TAIL_LATENCY) {
+		// Power of two choices on tail latency: of two usable alternatives picked at random from among the best ones, the
+		// request goes to the one expected to answer sooner and the other one gets any second request.  Sampling rather
+		// than taking the cheapest spreads the requests that are sent before the replies that would update the costs come
+		// back.  Without two usable best alternatives, the others are tried in order of cost, which for those in another
+		// datacenter is mostly their round trip time.
+		vector<int> best, rest;
+		for(int i=0; i<alternatives->size(); i++) {
+			RequestStream<Request> const* thisStream = &alternatives->get( i, channel );
+			if (!IFailureMonitor::failureMonitor().getState( thisStream->getEndpoint() ).failed && now() > model->getMeasurement(thisStream->getEndpoint().token.first()).failedUntil) {
+				if(i < alternatives->countBest()) {
+					best.push_back(i);
+				} else {
+					rest.push_back(i);
+				}
+			}
+		}
+
+		int a = -1;
+		int b = -1;
+		if(best.size() > 1) {
+			a = best[g_random->randomInt(0, best.size())];
+			b = best[g_random->randomInt(0, best.size() - 1)];
+			if(b == a) {
+				b = best.back();
+			}
+			if(model->getTailCost(alternatives->get( b, channel ).getEndpoint().token.first()) < model->getTailCost(alternatives->get( a, channel ).getEndpoint().token.first())) {
+				std::swap(a, b);
+			}
+		} else {
+			vector<std::pair<double, int>> byCost;
+			for(int i : rest) {
+				byCost.push_back( std::make_pair( model->getTailCost(alternatives->get( i, channel ).getEndpoint().token.first()), i ) );
+			}
+			std::sort( byCost.begin(), byCost.end() );
+			if(best.size()) {
+				a = best[0];
+				if(byCost.size()) {
+					b = byCost[0].second;
+				}
+			} else if(byCost.size()) {
+				a = byCost[0].second;
+				if(byCost.size() > 1) {
+					b = byCost[1].second;
+				}
+			}
+		}
+
+		if(a >= 0) {
+			bestAlt = a;
+			if(b >= 0) {
+				nextAlt = b;
+			} else {
+				nextAlt = g_random->randomInt(0, std::max(alternatives->size() - 1,1));
+				if( nextAlt >= bestAlt )
+					nextAlt++;
+			}
+
+			if(b >= 0) {
+				double bestTime = model->getMeasurement(alternatives->get( bestAlt, channel ).getEndpoint().token.first()).latency;
+				double nextTime = model->getMeasurement(alternatives->get( nextAlt, channel ).getEndpoint().token.first()).latency;
+				if(bestTime > FLOW_KNOBS->INSTANT_SECOND_REQUEST_MULTIPLIER*(model->secondMultiplier*(nextTime) + FLOW_KNOBS->BASE_SECOND_REQUEST_TIME)) {
+					secondDelay = Void();
+				} else {
+					secondDelay = delay( model->secondMultiplier*nextTime + FLOW_KNOBS->BASE_SECOND_REQUEST_TIME );
+				}
+			}
+		}
+	} else if(model) {
 		double bestMetric = 1e9;
 		double nextMetric = 1e9;
 		double bestTime = 1e9;
@@ -20,8 +20,9 @@
 
 #include "QueueModel.h"
 #include "LoadBalance.h"
+#include <cmath>
 
-void QueueModel::endRequest( uint64_t id, double latency, double penalty, double delta, bool clean, bool futureVersion ) {
+void QueueModel::endRequest( uint64_t id, double latency, double penalty, double delta, bool clean, bool futureVersion, int64_t queueDepth ) {
 	auto& d = data[id];
 	d.smoothOutstanding.addDelta(-delta);
 
@@ -31,6 +32,17 @@ void QueueModel::endRequest( uint64_t id, double latency, double penalty, double
 		d.latency = std::max(d.latency, latency);
 	}
 
+	// A request that failed took at least as long as it did, which only says something when that is longer than usual
+	if(latency > 0 && (clean || latency > d.smoothLatency)) {
+		double alpha = FLOW_KNOBS->QUEUE_MODEL_LATENCY_SMOOTHING;
+		d.latencyDeviation += std::min(2*alpha, 1.0) * (fabs(latency - d.smoothLatency) - d.latencyDeviation);
+		d.smoothLatency += alpha * (latency - d.smoothLatency);
+		d.measuredAt = now();
+	}
+	if(queueDepth >= 0) {
+		d.queueDepth = queueDepth;
+	}
+
 	if(futureVersion) {
 		if(now() > d.increaseBackoffTime) {
 			d.futureVersionBackoff = std::min( d.futureVersionBackoff * FLOW_KNOBS->FUTURE_VERSION_BACKOFF_GROWTH, FLOW_KNOBS->FUTURE_VERSION_MAX_BACKOFF );
@@ -54,9 +66,21 @@ QueueData& QueueModel::getMeasurement( uint64_t id ) {
 double QueueModel::addRequest( uint64_t id ) {
 	auto& d = data[id];
 	d.smoothOutstanding.addDelta(d.penalty);
+	if(now() - d.measuredAt > FLOW_KNOBS->QUEUE_MODEL_MEASUREMENT_EXPIRY) {
+		// This request refreshes the expired measurements, so others need not be sent here until it has had time to
+		d.measuredAt = now();
+	}
 	return d.penalty;
 }
 
+double QueueModel::getTailCost( uint64_t id ) {
+	auto& d = data[id];
+	if(now() - d.measuredAt > FLOW_KNOBS->QUEUE_MODEL_MEASUREMENT_EXPIRY) {
+		return 0;
+	}
+	return d.tailLatency() * (1 + d.smoothOutstanding.smoothTotal() + FLOW_KNOBS->QUEUE_MODEL_SERVER_QUEUE_WEIGHT * d.queueDepth);
+}
+
 Optional<LoadBalancedReply> getLoadBalancedReply(LoadBalancedReply *reply) {
 	return *reply;
 }
@@ -35,16 +35,30 @@ struct QueueData {
 	double failedUntil;
 	double futureVersionBackoff;
 	double increaseBackoffTime;
-	QueueData() : latency(0.001), penalty(1.0), smoothOutstanding(FLOW_KNOBS->QUEUE_MODEL_SMOOTHING_AMOUNT), failedUntil(0), futureVersionBackoff(FLOW_KNOBS->FUTURE_VERSION_INITIAL_BACKOFF), increaseBackoffTime(0) {}
+	double smoothLatency;		// Exponentially weighted average of the latencies of replies
+	double latencyDeviation;	// Exponentially weighted average of the distance of those latencies from smoothLatency
+	double queueDepth;			// The number of requests the server said it was processing in its last reply
+	double measuredAt;			// When a reply last updated the above, or a request was sent to refresh them once they expired
+	QueueData() : latency(0.001), penalty(1.0), smoothOutstanding(FLOW_KNOBS->QUEUE_MODEL_SMOOTHING_AMOUNT), failedUntil(0), futureVersionBackoff(FLOW_KNOBS->FUTURE_VERSION_INITIAL_BACKOFF), increaseBackoffTime(0),
+		smoothLatency(0.001), latencyDeviation(0), queueDepth(0), measuredAt(-1e9) {}
+
+	// An estimate of a high percentile of the latency of the next reply, in the manner of a TCP retransmission timeout
+	double tailLatency() const { return smoothLatency + FLOW_KNOBS->QUEUE_MODEL_TAIL_DEVIATIONS * latencyDeviation; }
 };
 
 typedef double TimeEstimate;
 
 class QueueModel {
 public:
-	void endRequest( uint64_t id, double latency, double penalty, double delta, bool clean, bool futureVersion );
+	void endRequest( uint64_t id, double latency, double penalty, double delta, bool clean, bool futureVersion, int64_t queueDepth );
 	QueueData& getMeasurement( uint64_t id );
 	double addRequest( uint64_t id );
+
+	// The cost by which loadBalance() chooses between alternatives when FLOW_KNOBS->LOAD_BALANCE_TAIL_LATENCY is set: the
+	// tail latency scaled by the work queued ahead of a new request.  Measurements older than
+	// QUEUE_MODEL_MEASUREMENT_EXPIRY cost nothing, so that a server which was avoided for being slow gets a request now
+	// and then to find out whether it still is.
+	double getTailCost( uint64_t id );
 	double secondMultiplier;
 	double secondBudget;
 	PromiseStream< Future<Void> > addActor;
@@ -154,6 +154,10 @@ public:
 
 	void insert( const Range& keys, const Val& value );
 
+	// Replaces the contents with one range beginning at the key of each of the given pairs, holding its value, in O(n).
+	// The keys must be increasing, the first must be Key() and the last must be before the end of the map.
+	void assign( std::vector<pair_type>&& begins );
+
 protected:
 	Map<Key,Val,pair_type,Metric> map;
 	const MetricFunc mf;
@@ -245,4 +249,21 @@ void RangeMap<Key,Val,Range,Metric,MetricFunc>::insert( const Range& keys, const
 	map.insert(beginPair, true, mf(beginPair));
 }
 
+template <class Key, class Val, class Range, class Metric, class MetricFunc>
+void RangeMap<Key,Val,Range,Metric,MetricFunc>::assign( std::vector<pair_type>&& begins ) {
+	ASSERT( begins.size() && begins[0].key == Key() );
+	pair_type endPair(map.lastItem()->key, Val());
+	ASSERT( begins.back().key < endPair.key );
+
+	std::vector<std::pair<pair_type, Metric>> items;
+	items.reserve( begins.size() + 1 );
+	for(auto& p : begins) {
+		Metric m = mf(p);
+		items.push_back( std::make_pair(std::move(p), m) );
+	}
+	Metric m = mf(endPair);
+	items.push_back( std::make_pair(std::move(endPair), m) );
+	map.build( std::move(items) );
+}
+
 #endif
\ No newline at end of file
@@ -136,6 +136,13 @@ bool PolicyOne::validate(
 	return ((solutionSet.size() > 0) && (fromServers->size() > 0));
 }
 
+int PolicyOne::additionalNeeded(
+	std::vector<LocalityEntry>	const&	solutionSet,
+	LocalitySetRef const&				fromServers ) const
+{
+	return ((solutionSet.size() > 0) && (fromServers->size() > 0)) ? 0 : 1;
+}
+
 PolicyAcross::PolicyAcross(int count, std::string const& attribKey, IRepPolicyRef const policy):
 	_count(count),_attribKey(attribKey),_policy(policy)
 {
@@ -215,6 +222,36 @@ bool PolicyAcross::validate(
 	return valid;
 }
 
+int PolicyAcross::additionalNeeded(
+		std::vector<LocalityEntry>	const&	solutionSet,
+		LocalitySetRef const&				fromServers ) const
+{
+	if (_count <= 0) return 0;
+
+	AttribKey	indexKey = fromServers->keyIndex(_attribKey);
+	auto			groupIndexKey = fromServers->getGroupKeyIndex(indexKey);
+	std::map<AttribValue, std::vector<LocalityEntry>>	groupMap;
+	for (auto& item : solutionSet) {
+		auto value = fromServers->getValueViaGroupKey(item, groupIndexKey);
+		if (value.present()) {
+			groupMap[value.get()].push_back(item);
+		}
+	}
+
+	// Each value has its own entries, so the cheapest values to satisfy, whether already in the solution or not, give
+	// the bound.  Entries without a value for the key can never help.
+	std::vector<int>	needed(_count, _policy->additionalNeeded(std::vector<LocalityEntry>(), fromServers));
+	for (auto& group : groupMap) {
+		needed.push_back(_policy->additionalNeeded(group.second, fromServers));
+	}
+	std::nth_element(needed.begin(), needed.begin() + _count - 1, needed.end());
+	int total = 0;
+	for (int i = 0; i < _count; i ++) {
+		total += needed[i];
+	}
+	return total;
+}
+
 bool PolicyAcross::selectReplicas(
 	LocalitySetRef	&						fromServers,
 	std::vector<LocalityEntry> const&		alsoServers,
@@ -389,6 +426,17 @@ bool PolicyAnd::validate(
 	return valid;
 }
 
+int PolicyAnd::additionalNeeded(
+	std::vector<LocalityEntry>	const&	solutionSet,
+	LocalitySetRef const&				fromServers ) const
+{
+	int neededMax = 0;
+	for (auto& policy : _policies) {
+		neededMax = std::max(neededMax, policy->additionalNeeded(solutionSet, fromServers));
+	}
+	return neededMax;
+}
+
 bool PolicyAnd::selectReplicas(
 	LocalitySetRef	&						fromServers,
 	std::vector<LocalityEntry> const&		alsoServers,
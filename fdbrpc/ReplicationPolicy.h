@@ -47,6 +47,13 @@ struct IReplicationPolicy : public ReferenceCounted<IReplicationPolicy> {
 			std::vector<LocalityEntry>	const&	solutionSet,
 			LocalitySetRef const&								fromServers ) const = 0;
 
+		// Returns a lower bound on the number of entries of fromServers that have to be added to solutionSet before it
+		// satisfies the policy, which is 0 exactly when validate() is true.  It takes time proportional to the size of
+		// solutionSet for each level of the policy, so a team can be checked as it is built, one member at a time.
+		virtual int additionalNeeded(
+			std::vector<LocalityEntry>	const&	solutionSet,
+			LocalitySetRef const&								fromServers ) const = 0;
+
 		bool operator == ( const IReplicationPolicy& r ) const { return info() == r.info(); }
 		bool operator != ( const IReplicationPolicy& r ) const { return info() != r.info(); }
 
@@ -68,6 +75,12 @@ struct IReplicationPolicy : public ReferenceCounted<IReplicationPolicy> {
 			std::vector<LocalityEntry>	const&	solutionSet,
 			std::vector<LocalityEntry> const&		alsoServers,
 			LocalitySetRef const&								fromServers );
+		// False if no team of teamSize entries that contains partialTeam can satisfy the policy
+		bool canComplete(
+			std::vector<LocalityEntry>	const&	partialTeam,
+			int																	teamSize,
+			LocalitySetRef const&								fromServers ) const
+		{ return additionalNeeded(partialTeam, fromServers) <= teamSize - (int)partialTeam.size(); }
 
 		// Returns a set of the attributes that this policy uses in selection and validation.
 		std::set<std::string> attributeKeys() const
@@ -106,6 +119,9 @@ struct PolicyOne : IReplicationPolicy, public ReferenceCounted<PolicyOne> {
 	virtual bool validate(
 		std::vector<LocalityEntry>	const&	solutionSet,
 		LocalitySetRef const&				fromServers ) const;
+	virtual int additionalNeeded(
+		std::vector<LocalityEntry>	const&	solutionSet,
+		LocalitySetRef const&				fromServers ) const;
 	virtual bool selectReplicas(
 		LocalitySetRef	&						fromServers,
 		std::vector<LocalityEntry> const&		alsoServers,
@@ -127,6 +143,9 @@ struct PolicyAcross : IReplicationPolicy, public ReferenceCounted<PolicyAcross>
 	virtual bool validate(
 		std::vector<LocalityEntry>	const&	solutionSet,
 		LocalitySetRef const&				fromServers ) const;
+	virtual int additionalNeeded(
+		std::vector<LocalityEntry>	const&	solutionSet,
+		LocalitySetRef const&				fromServers ) const;
 	virtual bool selectReplicas(
 		LocalitySetRef	&						fromServers,
 		std::vector<LocalityEntry> const&		alsoServers,
@@ -193,6 +212,9 @@ struct PolicyAnd : IReplicationPolicy, public ReferenceCounted<PolicyAnd> {
 	virtual bool validate(
 		std::vector<LocalityEntry>	const&	solutionSet,
 		LocalitySetRef const&				fromServers ) const;
+	virtual int additionalNeeded(
+		std::vector<LocalityEntry>	const&	solutionSet,
+		LocalitySetRef const&				fromServers ) const;
 
 	virtual bool selectReplicas(
 		LocalitySetRef	&						fromServers,
@@ -841,3 +841,77 @@ TEST_CASE("fdbrpc/Replication/test") {
 	ASSERT(testReplication() == 0);
 	return Void();
 }
+
+TEST_CASE("fdbrpc/Replication/additionalNeeded") {
+	std::vector<repTestType>	serverIndexes;
+	LocalitySetRef	testServers = createTestLocalityMap(serverIndexes, g_random->randomInt(1, 5), g_random->randomInt(1, 6), g_random->randomInt(1, 10), g_random->randomInt(1, 10), g_random->randomInt(0, 4), g_random->randomInt(1, 5));
+
+	for (auto& policy : getStaticPolicies()) {
+		for (int test = 0; test < 100; test ++) {
+			// Check every prefix of a random sequence of entries against every longer prefix that satisfies the policy
+			std::vector<LocalityEntry>	entries;
+			std::vector<int>	needed;
+			std::vector<bool>	valid;
+			int	length = g_random->randomInt(0, 13);
+			for (int i = 0; i <= length; i ++) {
+				needed.push_back(policy->additionalNeeded(entries, testServers));
+				valid.push_back(policy->validate(entries, testServers));
+				ASSERT((needed.back() == 0) == valid.back());
+				entries.push_back(testServers->random());
+			}
+			for (int i = 0; i <= length; i ++) {
+				for (int j = i; j <= length; j ++) {
+					if (valid[j]) ASSERT(needed[i] <= j - i);
+				}
+			}
+		}
+	}
+	return Void();
+}
+
+// Counts the teams of teamSize servers that satisfy the policy, extending a partial team only when canComplete allows it
+static int64_t countValidTeams(LocalitySetRef const& servers, IRepPolicyRef const& policy, int teamSize, bool prune, std::vector<LocalityEntry>& team, int next) {
+	if (team.size() == teamSize) {
+		return policy->validate(team, servers) ? 1 : 0;
+	}
+	int64_t	count = 0;
+	for (int i = next; i < servers->size(); i ++) {
+		team.push_back(servers->getEntry(i));
+		if (!prune || team.size() == teamSize || policy->canComplete(team, teamSize, servers)) {
+			count += countValidTeams(servers, policy, teamSize, prune, team, i + 1);
+		}
+		team.pop_back();
+	}
+	return count;
+}
+
+TEST_CASE("fdbrpc/perf/Replication/teamBuilding") {
+	// Machines of 8 storage servers each, spread over 3 data halls, building teams of 3 on different machines
+	LocalitySetRef	servers(new LocalityMap<int>());
+	std::vector<int>	ids(160);
+	for (int i = 0; i < ids.size(); i ++) {
+		ids[i] = i;
+		LocalityData	data;
+		data.set(LiteralStringRef("data_hall"), StringRef(format("dh%d", (i / 8) % 3)));
+		data.set(LiteralStringRef("zoneid"), StringRef(format("zone%d", i / 8)));
+		((LocalityMap<int>*) servers.getPtr())->add(data, &ids[i]);
+	}
+
+	std::vector<IRepPolicyRef>	policies = {
+		IRepPolicyRef(new PolicyAcross(3, "zoneid", IRepPolicyRef(new PolicyOne()))),
+		IRepPolicyRef(new PolicyAnd({ IRepPolicyRef(new PolicyAcross(3, "zoneid", IRepPolicyRef(new PolicyOne()))), IRepPolicyRef(new PolicyAcross(3, "data_hall", IRepPolicyRef(new PolicyOne()))) }))
+	};
+	for (auto& policy : policies) {
+		std::vector<LocalityEntry>	team;
+		double	start = timer();
+		int64_t	exhaustive = countValidTeams(servers, policy, 3, false, team, 0);
+		double	exhaustiveTime = timer() - start;
+		start = timer();
+		int64_t	pruned = countValidTeams(servers, policy, 3, true, team, 0);
+		double	prunedTime = timer() - start;
+		ASSERT(exhaustive == pruned);
+		printf("%s: %lld valid teams of %d servers, %.3f seconds validating every team, %.3f seconds pruning partial teams\n",
+			policy->info().c_str(), (long long)pruned, servers->size(), exhaustiveTime, prunedTime);
+	}
+	return Void();
+}
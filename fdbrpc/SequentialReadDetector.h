@@ -0,0 +1,84 @@
+/*
+ * SequentialReadDetector.h
+ *
+ * This source file is part of the FoundationDB open source project
+ *
+ * Copyright 2013-2018 Apple Inc. and the FoundationDB project authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FDBRPC_SEQUENTIALREADDETECTOR_H
+#define FDBRPC_SEQUENTIALREADDETECTOR_H
+#pragma once
+
+#include <vector>
+#include "flow/flow.h"
+
+// Follows the reads of a file to find the sequential streams among them and says how far past each read to read ahead.
+// A read continues a stream if it starts within its own length of where the stream's last read ended, so that small
+// gaps and overlaps are tolerated.  Once a stream has made SEQUENTIAL_READS such reads in a row, its read-ahead starts at
+// minReadAhead bytes and doubles with each further one up to maxReadAhead.  Any other read starts a new stream in place of
+// the least recently used one, with no read-ahead, so random reads never cause any and a stream that goes quiet loses
+// its read-ahead.  Up to maxStreams streams, such as concurrent scans of different parts of a file, are followed at once.
+class SequentialReadDetector {
+public:
+	enum { SEQUENTIAL_READS = 2 };
+
+	SequentialReadDetector( int64_t minReadAhead, int64_t maxReadAhead, int maxStreams = 4 )
+	  : minReadAhead(std::max<int64_t>(minReadAhead, 1)), maxReadAhead(maxReadAhead), maxStreams(std::max(maxStreams, 1)), clock(0) {}
+
+	// Reports a read of length bytes at offset, and returns the number of bytes after it to read ahead
+	int64_t read( int64_t offset, int length ) {
+		++clock;
+		if(maxReadAhead <= 0)
+			return 0;
+
+		Stream* lru = NULL;
+		for(auto& s : streams) {
+			if(offset >= s.end - length && offset <= s.end + length) {
+				s.end = std::max(s.end, offset + length);
+				s.lastUsed = clock;
+				if(++s.sequentialReads >= SEQUENTIAL_READS)
+					s.readAhead = std::min(maxReadAhead, s.readAhead ? s.readAhead * 2 : minReadAhead);
+				return s.readAhead;
+			}
+			if(!lru || s.lastUsed < lru->lastUsed)
+				lru = &s;
+		}
+
+		if(streams.size() < maxStreams) {
+			streams.push_back(Stream());
+			lru = &streams.back();
+		}
+		*lru = Stream(offset + length, clock);
+		return 0;
+	}
+
+private:
+	struct Stream {
+		int64_t end;  // Where the last read of the stream ended
+		int64_t readAhead;
+		int sequentialReads;
+		uint64_t lastUsed;
+
+		Stream( int64_t end = 0, uint64_t lastUsed = 0 ) : end(end), readAhead(0), sequentialReads(0), lastUsed(lastUsed) {}
+	};
+
+	int64_t minReadAhead, maxReadAhead;
+	int maxStreams;
+	uint64_t clock;
+	std::vector<Stream> streams;
+};
+
+#endif
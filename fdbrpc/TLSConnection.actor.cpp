@@ -32,14 +32,7 @@ static int send_func(void* ctx, const uint8_t* buf, int len) {
 	TLSConnection* conn = (TLSConnection*)ctx;
 
 	try {
-		SendBuffer sb;
-		sb.bytes_sent = 0;
-		sb.bytes_written = len;
-		sb.data = buf;
-		sb.next = 0;
-
-		int w = conn->conn->write( &sb );
-		return w;
+		return conn->send( buf, len );
 	} catch ( Error& e ) {
 		TraceEvent("TLSConnectionSendError", conn->getDebugID()).error(e);
 		return -1;
@@ -54,8 +47,7 @@ static int recv_func(void* ctx, uint8_t* buf, int len) {
 	TLSConnection* conn = (TLSConnection*)ctx;
 
 	try {
-		int r = conn->conn->read( buf, buf + len );
-		return r;
+		return conn->recv( buf, len );
 	} catch ( Error& e ) {
 		TraceEvent("TLSConnectionRecvError", conn->getDebugID()).error(e);
 		return -1;
@@ -65,9 +57,83 @@ static int recv_func(void* ctx, uint8_t* buf, int len) {
 	}
 }
 
+ACTOR static Future<Void> flushWhenWritable( TLSConnection* self ) {
+	while ( !self->flush() )
+		Void _ = wait( self->conn->onWritable() );
+	return Void();
+}
+
+int TLSConnection::recv( uint8_t* buf, int len ) {
+	if ( recvBegin == recvEnd ) {
+		// Large reads go straight to the plugin's buffer
+		if ( len >= RECV_BUFFER_SIZE )
+			return conn->read( buf, buf + len );
+
+		if ( !recvBuffer )
+			recvBuffer = new (recvArena) uint8_t[RECV_BUFFER_SIZE];
+		recvBegin = recvEnd = recvBuffer;
+		int r = conn->read( recvBuffer, recvBuffer + RECV_BUFFER_SIZE );
+		if ( !r ) {
+			recvArena = Arena();
+			recvBuffer = recvBegin = recvEnd = NULL;
+			return 0;
+		}
+		recvEnd += r;
+	}
+
+	int r = std::min<int>( len, recvEnd - recvBegin );
+	memcpy( buf, recvBegin, r );
+	recvBegin += r;
+	return r;
+}
+
+int TLSConnection::send( const uint8_t* buf, int len ) {
+	if ( sendEnd + len > SEND_BUFFER_SIZE && !flush() && sendEnd + len > SEND_BUFFER_SIZE ) {
+		// Let the plugin retry once some of what it has already written is sent
+		if ( !flushing.isValid() || flushing.isReady() )
+			flushing = flushWhenWritable( this );
+		return 0;
+	}
+	if ( len > SEND_BUFFER_SIZE ) {
+		// Nothing is buffered (or it would have been flushed above), so the record can be sent as it is
+		SendBuffer sb;
+		sb.bytes_sent = 0;
+		sb.bytes_written = len;
+		sb.data = buf;
+		sb.next = 0;
+		return conn->write( &sb );
+	}
+
+	if ( !sendBuffer )
+		sendBuffer = new (sendArena) uint8_t[SEND_BUFFER_SIZE];
+	memcpy( sendBuffer + sendEnd, buf, len );
+	sendEnd += len;
+	return len;
+}
+
+bool TLSConnection::flush() {
+	while ( sendBegin < sendEnd ) {
+		SendBuffer sb;
+		sb.bytes_sent = 0;
+		sb.bytes_written = sendEnd - sendBegin;
+		sb.data = sendBuffer + sendBegin;
+		sb.next = 0;
+		int w = conn->write( &sb );
+		if ( !w ) return false;
+		sendBegin += w;
+	}
+	sendArena = Arena();
+	sendBuffer = NULL;
+	sendBegin = sendEnd = 0;
+	return true;
+}
+
 ACTOR static Future<Void> handshake( TLSConnection* self ) {
+	state int r;
 	loop {
-		int r = self->session->handshake();
+		r = self->session->handshake();
+		while ( !self->flush() )
+			Void _ = wait( self->conn->onWritable() );
 		if ( r == ITLSSession::SUCCESS ) break;
 		if ( r == ITLSSession::FAILED ) {
 			TraceEvent("TLSConnectionHandshakeError", self->getDebugID());
@@ -83,7 +149,9 @@ ACTOR static Future<Void> handshake( TLSConnection* self ) {
 	return Void();
 }
 
-TLSConnection::TLSConnection( Reference<IConnection> const& conn, Reference<ITLSPolicy> const& policy, bool is_client ) : conn(conn), write_wants(0), read_wants(0), uid(conn->getDebugID()) {
+TLSConnection::TLSConnection( Reference<IConnection> const& conn, Reference<ITLSPolicy> const& policy, bool is_client )
+	: conn(conn), write_wants(0), read_wants(0), recvBuffer(NULL), recvBegin(NULL), recvEnd(NULL), sendBuffer(NULL), sendBegin(0), sendEnd(0), uid(conn->getDebugID())
+{
 	session = Reference<ITLSSession>( policy->create_session(is_client, send_func, this, recv_func, this, (void*)&uid) );
 	if ( !session ) {
 		// If session is NULL, we're trusting policy->create_session
@@ -136,18 +204,31 @@ int TLSConnection::write( SendBuffer const* buffer, int limit ) {
 	handshook.get();
 
 	write_wants = 0;
-	int toSend = std::min(limit, buffer->bytes_written - buffer->bytes_sent);
-	ASSERT(toSend);
-	int w = session->write( buffer->data + buffer->bytes_sent, toSend );
-	if ( w > 0 )
-		return w;
+	if ( !flush() ) {
+		write_wants = ITLSSession::WANT_WRITE;
+		return 0;
+	}
 
-	if ( w == ITLSSession::FAILED ) throw connection_failed();
+	// Encrypt as much of the chain as fits, so that its records go out in one write
+	int sent = 0;
+	for(; buffer && sent < limit; buffer = buffer->next) {
+		int toSend = std::min(limit - sent, buffer->bytes_written - buffer->bytes_sent);
+		if ( !toSend ) continue;
+		int w = session->write( buffer->data + buffer->bytes_sent, toSend );
+		if ( w <= 0 ) {
+			if ( w == ITLSSession::FAILED ) throw connection_failed();
+			ASSERT( w == ITLSSession::WANT_WRITE || w == ITLSSession::WANT_READ );
+			if ( !sent ) write_wants = w;
+			break;
+		}
+		sent += w;
+		if ( w < toSend ) break;
+	}
 
-	ASSERT( w == ITLSSession::WANT_WRITE || w == ITLSSession::WANT_READ );
+	if ( !flush() && ( !flushing.isValid() || flushing.isReady() ) )
+		flushing = flushWhenWritable( this );
 
-	write_wants = w;
-	return 0;
+	return sent;
 }
 
 ACTOR Future<Reference<IConnection>> wrap( Reference<ITLSPolicy> policy, bool is_client, Future<Reference<IConnection>> c ) {
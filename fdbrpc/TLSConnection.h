@@ -27,14 +27,29 @@
 
 #include "ITLSPlugin.h"
 
+// The plugin reads and writes the underlying connection a record (or a record header) at a time.  TLSConnection buffers
+// both directions, so that many records are received with one read of the underlying connection, and the records
+// produced by a write are sent together.
 struct TLSConnection : IConnection, ReferenceCounted<TLSConnection> {
+	enum { RECV_BUFFER_SIZE = 32768, SEND_BUFFER_SIZE = 65536 };
+
 	Reference<IConnection> conn;
 	Reference<ITLSSession> session;
 
 	Future<Void> handshook;
+	Future<Void> flushing;  // Sends what is left of sendBuffer once the underlying connection is writable
 
 	int write_wants, read_wants;
 
+	// Bytes read from conn that the plugin hasn't asked for yet.  The buffer is released when it runs dry.
+	Arena recvArena;
+	uint8_t *recvBuffer, *recvBegin, *recvEnd;
+
+	// Encrypted bytes the plugin has written that haven't been sent on conn yet
+	Arena sendArena;
+	uint8_t* sendBuffer;
+	int sendBegin, sendEnd;
+
 	UID uid;
 
 	virtual void addref() { ReferenceCounted<TLSConnection>::addref(); }
@@ -63,6 +78,10 @@ struct TLSConnection : IConnection, ReferenceCounted<TLSConnection> {
 	}
 
 	virtual UID getDebugID() { return uid; }
+
+	int recv( uint8_t* buf, int len );  // For the plugin's receive callback
+	int send( const uint8_t* buf, int len );  // For the plugin's send callback
+	bool flush();  // Returns true if nothing is left in sendBuffer
 };
 
 struct TLSListener : IListener, ReferenceCounted<TLSListener> {
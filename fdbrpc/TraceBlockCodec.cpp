@@ -0,0 +1,74 @@
+/*
+ * TraceBlockCodec.cpp
+ *
+ * This source file is part of the FoundationDB open source project
+ *
+ * Copyright 2013-2018 Apple Inc. and the FoundationDB project authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "TraceBlockCodec.h"
+#include "flow/flow.h"
+#include "flow/UnitTest.h"
+#include "zlib/zlib.h"
+
+namespace {
+
+struct ZlibTraceBlockCodec : ITraceBlockCodec {
+	virtual bool compress( const uint8_t* data, int length, std::string& out ) {
+		z_stream stream;
+		memset( &stream, 0, sizeof(stream) );
+		if (deflateInit( &stream, Z_DEFAULT_COMPRESSION ) != Z_OK)
+			return false;
+		out.resize( deflateBound( &stream, length ) );
+		stream.next_in = (Bytef*)data;
+		stream.avail_in = length;
+		stream.next_out = (Bytef*)&out[0];
+		stream.avail_out = out.size();
+		int r = deflate( &stream, Z_FINISH );
+		deflateEnd( &stream );
+		if (r != Z_STREAM_END || stream.total_out >= length)
+			return false;
+		out.resize( stream.total_out );
+		return true;
+	}
+
+	virtual std::string decompress( const uint8_t* data, int length, int rawLength ) {
+		if (rawLength < 0)
+			throw file_corrupt();
+		std::string out( rawLength, '\0' );
+		z_stream stream;
+		memset( &stream, 0, sizeof(stream) );
+		if (inflateInit( &stream ) != Z_OK)
+			throw file_corrupt();
+		stream.next_in = (Bytef*)data;
+		stream.avail_in = length;
+		stream.next_out = (Bytef*)&out[0];
+		stream.avail_out = rawLength;
+		int r = inflate( &stream, Z_FINISH );
+		bool complete = r == Z_STREAM_END && stream.total_out == rawLength;
+		inflateEnd( &stream );
+		if (!complete)
+			throw file_corrupt();
+		return out;
+	}
+};
+
+} // namespace
+
+ITraceBlockCodec* zlibTraceBlockCodec() {
+	static ZlibTraceBlockCodec codec;
+	return &codec;
+}
@@ -0,0 +1,31 @@
+/*
+ * TraceBlockCodec.h
+ *
+ * This source file is part of the FoundationDB open source project
+ *
+ * Copyright 2013-2018 Apple Inc. and the FoundationDB project authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef FDBRPC_TRACEBLOCKCODEC_H
+#define FDBRPC_TRACEBLOCKCODEC_H
+#pragma once
+
+#include "flow/Trace.h"
+
+// A codec that compresses the blocks of binary trace files with zlib, for setTraceBlockCodec()
+ITraceBlockCodec* zlibTraceBlockCodec();
+
+#endif
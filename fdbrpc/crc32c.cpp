@@ -29,14 +29,31 @@
 
 #define NOMINMAX
 
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define CRC32C_X86
 #include <nmmintrin.h>
+#elif defined(__aarch64__) && defined(__GNUC__)
+#define CRC32C_ARM64
+#ifdef __linux__
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+#endif
+
+/* 64 bit targets process the input eight bytes at a time */
+#if defined(__x86_64__) || defined(_M_X64) || defined(__aarch64__)
+#define CRC32C_64BIT
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <random>
 #include <algorithm>
 #include "Platform.h"
 #include "generated-constants.cpp"
+#ifdef CRC32C_X86
 #pragma GCC target("sse4.2")
+#endif
 
 static uint32_t append_trivial(uint32_t crc, const uint8_t * input, size_t length)
 {
@@ -91,14 +108,14 @@ static uint32_t append_adler_table(uint32_t crci, const uint8_t * input, size_t
 static uint32_t append_table(uint32_t crci, const uint8_t * input, size_t length)
 {
     const uint8_t * next = input;
-#ifdef _M_X64
+#ifdef CRC32C_64BIT
     uint64_t crc;
 #else
     uint32_t crc;
 #endif
 
     crc = crci ^ 0xffffffff;
-#ifdef _M_X64
+#ifdef CRC32C_64BIT
     while (length && ((uintptr_t)next & 7) != 0)
     {
         crc = table[0][(crc ^ *next++) & 0xff] ^ (crc >> 8);
@@ -162,6 +179,7 @@ static uint32_t append_table(uint32_t crci, const uint8_t * input, size_t length
     return (uint32_t)crc ^ 0xffffffff;
 }
 
+#ifdef CRC32C_X86
 /* Apply the zeros operator table to crc. */
 static inline uint32_t shift_crc(uint32_t shift_table[][256], uint32_t crc)
 {
@@ -176,7 +194,7 @@ static uint32_t append_hw(uint32_t crc, const uint8_t * buf, size_t len)
 {
     const uint8_t * next = buf;
     const uint8_t * end;
-#ifdef _M_X64
+#if defined(_M_X64) || defined(__x86_64__)
     uint64_t crc0, crc1, crc2;      /* need to be 64 bits for crc32q */
 #else
     uint32_t crc0, crc1, crc2;
@@ -194,7 +212,7 @@ static uint32_t append_hw(uint32_t crc, const uint8_t * buf, size_t len)
         --len;
     }
 
-#ifdef _M_X64
+#if defined(_M_X64) || defined(__x86_64__)
     /* compute the crc on sets of LONG_SHIFT*3 bytes, executing three independent crc
        instructions, each on LONG_SHIFT bytes -- this is optimized for the Nehalem,
        Westmere, Sandy Bridge, and Ivy Bridge architectures, which have a
@@ -312,12 +330,83 @@ static uint32_t append_hw(uint32_t crc, const uint8_t * buf, size_t len)
 }
 
 
-static bool hw_available = platform::isSse42Supported();
+#endif
+
+#ifdef CRC32C_ARM64
+/* The ARMv8 CRC instructions, in assembly so that the rest of the file can be built for processors without them */
+static inline uint32_t crc32cb_arm64(uint32_t crc, uint8_t v)
+{
+    __asm__(".arch_extension crc\n\tcrc32cb %w0, %w0, %w1" : "+r"(crc) : "r"(v));
+    return crc;
+}
+
+static inline uint32_t crc32cx_arm64(uint32_t crc, uint64_t v)
+{
+    __asm__(".arch_extension crc\n\tcrc32cx %w0, %w0, %x1" : "+r"(crc) : "r"(v));
+    return crc;
+}
+
+/* Compute CRC-32C using the ARMv8 CRC instructions. */
+static uint32_t append_arm64(uint32_t crc, const uint8_t * next, size_t len)
+{
+    uint32_t crc0 = crc ^ 0xffffffff;
+    while (len && ((uintptr_t)next & 7) != 0)
+    {
+        crc0 = crc32cb_arm64(crc0, *next);
+        ++next;
+        --len;
+    }
+    while (len >= 8)
+    {
+        crc0 = crc32cx_arm64(crc0, *reinterpret_cast<const uint64_t *>(next));
+        next += 8;
+        len -= 8;
+    }
+    while (len)
+    {
+        crc0 = crc32cb_arm64(crc0, *next);
+        ++next;
+        --len;
+    }
+    return crc0 ^ 0xffffffff;
+}
+
+static bool arm64_crc_supported()
+{
+#if defined(__APPLE__)
+    return true;  /* Every 64 bit ARM processor Apple has shipped has the CRC instructions */
+#elif defined(__linux__)
+    return (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0;
+#else
+    return false;
+#endif
+}
+#endif
+
+typedef uint32_t (*append_func)(uint32_t crc, const uint8_t * input, size_t length);
+
+/* Choose the fastest implementation that the processor supports */
+static append_func choose_append()
+{
+#if defined(CRC32C_X86)
+    if (platform::isSse42Supported())
+        return append_hw;
+#elif defined(CRC32C_ARM64)
+    if (arm64_crc_supported())
+        return append_arm64;
+#endif
+    return append_table;
+}
+
+/* Calls made during static initialization, before this is set, use the tables */
+static append_func append_impl = choose_append();
 
 extern "C" uint32_t crc32c_append(uint32_t crc, const uint8_t * input, size_t length)
 {
-    if (hw_available)
-        return append_hw(crc, input, length);
-    else
-        return append_table(crc, input, length);
+    return (append_impl ? append_impl : append_table)(crc, input, length);
+}
+
+extern "C" uint32_t crc32c_append_sw(uint32_t crc, const uint8_t * input, size_t length)
+{
+    return append_table(crc, input, length);
 }
@@ -31,11 +31,19 @@
     Computes CRC-32C using Castagnoli polynomial of 0x82f63b78.
     This polynomial is better at detecting errors than the more common CRC-32 polynomial.
     CRC-32C is implemented in hardware on newer Intel processors.
-    This function will use the hardware if available and fall back to fast software implementation.
+    This function will use the SSE 4.2 or ARMv8 CRC instructions if the processor has them and fall back to fast software implementation otherwise.
 */
 extern "C" uint32_t crc32c_append(
     uint32_t crc,               // initial CRC, typically 0, may be used to accumulate CRC from multiple buffers
     const uint8_t *input,       // data to be put through the CRC algorithm
     size_t length);             // length of the data in the input buffer
 
+/*
+    The same as crc32c_append(), but always in software.  For testing the hardware implementations against.
+*/
+extern "C" uint32_t crc32c_append_sw(
+    uint32_t crc,
+    const uint8_t *input,
+    size_t length);
+
 #endif
@@ -82,6 +82,7 @@ Future<T> timeoutWarning( Future<T> what, double time, PromiseStream<Void> outpu
 
 ACTOR template <class T>
 void networkSender( Future<T> input, Endpoint endpoint ) {
+	state PeerReference peerReference( endpoint );
 	try {
 		T value = wait( input );
 		FlowTransport::transport().sendUnreliable( SerializeBoolAnd<T>(true, value), endpoint );
@@ -148,6 +149,7 @@ ACTOR template <class T> Future<Void> broadcast( Future<T> input, std::vector<Re
 // Implements tryGetReply, getReplyUnlessFailedFor
 ACTOR template <class X>
 Future<ErrorOr<X>> waitValueOrSignal( Future<X> value, Future<Void> signal, Endpoint endpoint, ReplyPromise<X> holdme = ReplyPromise<X>() ) {
+	state PeerReference peerReference( endpoint );
 	loop {
 		try {
 			choose {
@@ -0,0 +1,89 @@
+/*
+ * linux_iouring.h
+ *
+ * This source file is part of the FoundationDB open source project
+ *
+ * Copyright 2013-2018 Apple Inc. and the FoundationDB project authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// io_uring system calls and ABI structures (see linux/io_uring.h).  Defined here rather than taken from the
+// kernel headers so that we build against older headers; io_uring_setup fails with ENOSYS on kernels without it.
+
+#ifndef __NR_io_uring_setup
+#define __NR_io_uring_setup 425
+#endif
+#ifndef __NR_io_uring_enter
+#define __NR_io_uring_enter 426
+#endif
+#ifndef __NR_io_uring_register
+#define __NR_io_uring_register 427
+#endif
+
+enum {
+	IOURING_OP_NOP = 0,
+	IOURING_OP_READV = 1,
+	IOURING_OP_WRITEV = 2,
+	IOURING_OP_FSYNC = 3
+};
+
+enum {
+	IOURING_FSYNC_DATASYNC = 1,
+	IOURING_ENTER_GETEVENTS = 1,
+	IOURING_REGISTER_EVENTFD = 4
+};
+
+static const uint64_t IOURING_OFF_SQ_RING = 0;
+static const uint64_t IOURING_OFF_CQ_RING = 0x8000000ULL;
+static const uint64_t IOURING_OFF_SQES = 0x10000000ULL;
+
+struct linux_io_uring_sqe {
+	uint8_t opcode;
+	uint8_t flags;
+	uint16_t ioprio;
+	int32_t fd;
+	uint64_t off;
+	uint64_t addr;
+	uint32_t len;
+	uint32_t op_flags;		// rw_flags, fsync_flags, ...
+	uint64_t user_data;
+	uint64_t pad[3];
+};
+
+struct linux_io_uring_cqe {
+	uint64_t user_data;
+	int32_t res;
+	uint32_t flags;
+};
+
+struct linux_io_sqring_offsets {
+	uint32_t head, tail, ring_mask, ring_entries, flags, dropped, array, resv1;
+	uint64_t resv2;
+};
+
+struct linux_io_cqring_offsets {
+	uint32_t head, tail, ring_mask, ring_entries, overflow, cqes, flags, resv1;
+	uint64_t resv2;
+};
+
+struct linux_io_uring_params {
+	uint32_t sq_entries, cq_entries, flags, sq_thread_cpu, sq_thread_idle, features, wq_fd, resv[3];
+	linux_io_sqring_offsets sq_off;
+	linux_io_cqring_offsets cq_off;
+};
+
+static int io_uring_setup(unsigned entries, linux_io_uring_params* p) { return syscall( __NR_io_uring_setup, entries, p ); }
+static int io_uring_enter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags) { return syscall( __NR_io_uring_enter, fd, toSubmit, minComplete, flags, NULL, 0 ); }
+static int io_uring_register(int fd, unsigned opcode, void* arg, unsigned nrArgs) { return syscall( __NR_io_uring_register, fd, opcode, arg, nrArgs ); }
@@ -163,6 +163,8 @@ private:
 	std::map< std::pair<uint32_t, uint32_t>, double > clogPairUntil;
 	std::map< std::pair<uint32_t, uint32_t>, double > clogPairLatency;
 	double halfLatency() {
+		if(FLOW_KNOBS->SIM_PERF_MODE)
+			return 0.5 * FLOW_KNOBS->SIM_PERF_NETWORK_LATENCY;
 		double a = g_random->random01();
 		const double pFast = 0.999;
 		if (a <= pFast) {
@@ -1512,32 +1514,51 @@ public:
 	struct Task {
 		int taskID;
 		double time;
+		int rank;  // Orders tasks due at the same time before stable does; lower ranks run first
 		uint64_t stable;
 		ProcessInfo* machine;
 		Promise<Void> action;
-		Task( double time, int taskID, uint64_t stable, ProcessInfo* machine, Promise<Void>&& action ) : time(time), taskID(taskID), stable(stable), machine(machine), action(std::move(action)) {}
-		Task( double time, int taskID, uint64_t stable, ProcessInfo* machine, Future<Void>& future ) : time(time), taskID(taskID), stable(stable), machine(machine) { future = action.getFuture(); }
-		Task(Task&& rhs) noexcept(true) : time(rhs.time), taskID(rhs.taskID), stable(rhs.stable), machine(rhs.machine), action(std::move(rhs.action)) {}
-		void operator= ( Task const& rhs ) { taskID = rhs.taskID; time = rhs.time; stable = rhs.stable; machine = rhs.machine; action = rhs.action; }
-		Task( Task const& rhs ) : taskID(rhs.taskID), time(rhs.time), stable(rhs.stable), machine(rhs.machine), action(rhs.action) {}
-		void operator= (Task&& rhs) noexcept(true) { time = rhs.time; taskID = rhs.taskID; stable = rhs.stable; machine = rhs.machine; action = std::move(rhs.action); }
+		Task( double time, int taskID, uint64_t stable, ProcessInfo* machine, Promise<Void>&& action ) : time(time), taskID(taskID), rank(0), stable(stable), machine(machine), action(std::move(action)) {}
+		Task( double time, int taskID, uint64_t stable, ProcessInfo* machine, Future<Void>& future ) : time(time), taskID(taskID), rank(0), stable(stable), machine(machine) { future = action.getFuture(); }
+		Task(Task&& rhs) noexcept(true) : time(rhs.time), taskID(rhs.taskID), rank(rhs.rank), stable(rhs.stable), machine(rhs.machine), action(std::move(rhs.action)) {}
+		void operator= ( Task const& rhs ) { taskID = rhs.taskID; time = rhs.time; rank = rhs.rank; stable = rhs.stable; machine = rhs.machine; action = rhs.action; }
+		Task( Task const& rhs ) : taskID(rhs.taskID), time(rhs.time), rank(rhs.rank), stable(rhs.stable), machine(rhs.machine), action(rhs.action) {}
+		void operator= (Task&& rhs) noexcept(true) { time = rhs.time; taskID = rhs.taskID; rank = rhs.rank; stable = rhs.stable; machine = rhs.machine; action = std::move(rhs.action); }
 
 		bool operator < (Task const& rhs) const {
 			// Ordering is reversed for priority_queue
 			if (time != rhs.time) return time > rhs.time;
+			if (rank != rhs.rank) return rank > rhs.rank;
 			return stable > rhs.stable;
 		}
 	};
 
+	// The simulated CPU time it takes to run a task of the given priority with SIM_PERF_MODE
+	static double taskCpuCost( int taskID ) {
+		return taskID >= TaskDiskIOComplete ? FLOW_KNOBS->SIM_PERF_IO_TASK_CPU_COST : FLOW_KNOBS->SIM_PERF_TASK_CPU_COST;
+	}
+
 	void execTask(struct Task& t) {
 		if (t.machine->failed) {
 			t.action.send(Never());
 		}
+		else if (FLOW_KNOBS->SIM_PERF_MODE && t.machine->cpuBusyUntil > t.time) {
+			// The process is still busy with an earlier task, so this one waits for it.  Of the tasks waiting for the
+			// process, the one with the highest priority runs next, as it would in Net2.
+			t.time = t.machine->cpuBusyUntil;
+			t.rank = -t.taskID;
+			mutex.enter();
+			tasks.push( std::move(t) );
+			mutex.leave();
+		}
 		else {
 			mutex.enter();
 			this->time = t.time;
 			mutex.leave();
 
+			if (FLOW_KNOBS->SIM_PERF_MODE)
+				t.machine->cpuBusyUntil = t.time + taskCpuCost(t.taskID);
+
 			this->currentProcess = t.machine;
 			try {
 				//auto before = getCPUTicks();
@@ -1613,6 +1634,11 @@ void startNewSimulator() {
 	ASSERT( !g_network );
 	g_network = g_pSimulator = new Sim2();
 	g_simulator.connectionFailuresDisableDuration = g_random->random01() < 0.5 ? 0 : 1e6;
+	if(FLOW_KNOBS->SIM_PERF_MODE) {
+		g_simulator.connectionFailuresDisableDuration = 1e6;
+		TraceEvent("SimPerfMode").detail("TaskCpuCost", FLOW_KNOBS->SIM_PERF_TASK_CPU_COST).detail("IOTaskCpuCost", FLOW_KNOBS->SIM_PERF_IO_TASK_CPU_COST)
+			.detail("NetworkLatency", FLOW_KNOBS->SIM_PERF_NETWORK_LATENCY).detail("DiskSyncLatency", FLOW_KNOBS->SIM_PERF_DISK_SYNC_LATENCY);
+	}
 }
 
 static double networkLatency() {
@@ -1657,12 +1683,16 @@ ACTOR void doReboot( ISimulator::ProcessInfo *p, ISimulator::KillType kt ) {
 
 //Simulates delays for performing operations on disk
 Future<Void> waitUntilDiskReady( Reference<DiskParameters> diskParameters, int64_t size, bool sync ) {
-	if(g_simulator.connectionFailuresDisableDuration > 1e4)
+	if(g_simulator.connectionFailuresDisableDuration > 1e4 && !FLOW_KNOBS->SIM_PERF_MODE)
 		return delay(0.0001);
 
 	if( diskParameters->nextOperation < now() ) diskParameters->nextOperation = now();
 	diskParameters->nextOperation += ( 1.0 / diskParameters->iops ) + ( size / diskParameters->bandwidth );
 
+	// Operations queue behind each other for the disk, and a sync then waits for the write cache to be flushed
+	if(FLOW_KNOBS->SIM_PERF_MODE)
+		return delayUntil( diskParameters->nextOperation + (sync ? FLOW_KNOBS->SIM_PERF_DISK_SYNC_LATENCY : 0) );
+
 	double randomLatency;
 	if(sync) {
 		randomLatency = .005 + g_random->random01() * (BUGGIFY ? 1.0 : .010);
@@ -58,6 +58,7 @@ public:
 		bool excluded;
 		bool cleared;
 		int64_t cpuTicks;
+		double cpuBusyUntil;  // With SIM_PERF_MODE, the time until which the process is busy running tasks
 		bool rebooting;
 		std::vector<flowGlobalType> globals;
 
@@ -69,7 +70,7 @@ public:
 		ProcessInfo(const char* name, LocalityData locality, ProcessClass startingClass, NetworkAddress address,
 					INetworkConnections *net, const char* dataFolder, const char* coordinationFolder )
 			: name(name), locality(locality), startingClass(startingClass), address(address), dataFolder(dataFolder),
-				network(net), coordinationFolder(coordinationFolder), failed(false), excluded(false), cpuTicks(0),
+				network(net), coordinationFolder(coordinationFolder), failed(false), excluded(false), cpuTicks(0), cpuBusyUntil(0),
 				rebooting(false), fault_injection_p1(0), fault_injection_p2(0),
 				fault_injection_r(0), machine(0), cleared(false) {}
 
@@ -0,0 +1,576 @@
+/*
+ * BlockedKeyValueMap.cpp
+ *
+ * This source file is part of the FoundationDB open source project
+ *
+ * Copyright 2013-2018 Apple Inc. and the FoundationDB project authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "BlockedKeyValueMap.h"
+#include "flow/UnitTest.h"
+#include <map>
+
+// An entry is three varints (the number of bytes the key shares with the key before it, the number of key bytes that
+// follow, and the size of the value) followed by the unshared key bytes and the value
+static void appendVarint( std::vector<uint8_t>& out, uint32_t v ) {
+	while( v >= 128 ) {
+		out.push_back( uint8_t(v | 128) );
+		v >>= 7;
+	}
+	out.push_back( uint8_t(v) );
+}
+
+static uint32_t readVarint( const uint8_t*& p ) {
+	uint32_t v = 0;
+	for(int shift = 0; ; shift += 7) {
+		uint8_t b = *p++;
+		v |= uint32_t(b & 127) << shift;
+		if( b < 128 )
+			return v;
+	}
+}
+
+BlockedKeyValueMap::iterator& BlockedKeyValueMap::iterator::operator=( iterator const& r ) {
+	leaf = r.leaf;
+	index = r.index;
+	offset = r.offset;
+	nextOffset = r.nextOffset;
+	key = r.key;
+	kv = KeyValueRef( KeyRef( (const uint8_t*)key.data(), key.size() ), r.kv.value );
+	return *this;
+}
+
+void BlockedKeyValueMap::iterator::decode() {
+	const uint8_t* p = &leaf->data[offset];
+	uint32_t shared = readVarint(p);
+	uint32_t unshared = readVarint(p);
+	uint32_t valueSize = readVarint(p);
+	key.resize( shared );
+	key.append( (const char*)p, unshared );
+	p += unshared;
+	kv = KeyValueRef( KeyRef( (const uint8_t*)key.data(), key.size() ), ValueRef( p, valueSize ) );
+	nextOffset = p + valueSize - &leaf->data[0];
+}
+
+void BlockedKeyValueMap::iterator::operator++() {
+	if( nextOffset == leaf->data.size() ) {
+		leaf = leaf->next;
+		index = 0;
+		offset = 0;
+		if( !leaf ) {
+			key.clear();
+			kv = KeyValueRef();
+			return;
+		}
+	} else {
+		++index;
+		offset = nextOffset;
+	}
+	decode();
+}
+
+// Starts writing in place of the entries of leaf from entry, at offset, which is in the group of the given restart.
+// Unless entry begins that group, lastKey must already hold the key of the entry before it.
+void BlockedKeyValueMap::Writer::start( Leaf* leaf, int restart, int entry, int offset ) {
+	base = offset;
+	count = entry;
+	written = restart < leaf->restarts.size() ? entry - leaf->restarts[restart].entry : 0;
+	firstRestart = written ? restart + 1 : restart;
+	out.clear();
+	restarts.clear();
+}
+
+void BlockedKeyValueMap::Writer::add( KeyRef key, ValueRef value ) {
+	int shared = 0;
+	if( written % RESTART_INTERVAL == 0 ) {
+		Restart r = { int(base + out.size()), count };
+		restarts.push_back( r );
+	} else {
+		int n = std::min<int>( key.size(), lastKey.size() );
+		while( shared < n && key[shared] == (uint8_t)lastKey[shared] )
+			++shared;
+	}
+	appendVarint( out, shared );
+	appendVarint( out, key.size() - shared );
+	appendVarint( out, value.size() );
+	out.insert( out.end(), key.begin() + shared, key.end() );
+	out.insert( out.end(), value.begin(), value.end() );
+	lastKey.resize( shared );
+	lastKey.append( (const char*)key.begin() + shared, key.size() - shared );
+	++count;
+	++written;
+}
+
+// Replaces the entries of leaf from the starting entry up to tailEntry, at tailOffset, with what has been written.
+// tailRestart is the first restart at or after tailEntry.
+void BlockedKeyValueMap::Writer::finish( Leaf* leaf, int tailOffset, int tailEntry, int tailRestart ) {
+	int offsetShift = base + out.size() - tailOffset;
+	int entryShift = count - tailEntry;
+
+	leaf->data.erase( leaf->data.begin() + base, leaf->data.begin() + tailOffset );
+	leaf->data.insert( leaf->data.begin() + base, out.begin(), out.end() );
+	for(int r = tailRestart; r < leaf->restarts.size(); r++) {
+		leaf->restarts[r].offset += offsetShift;
+		leaf->restarts[r].entry += entryShift;
+	}
+	leaf->restarts.erase( leaf->restarts.begin() + firstRestart, leaf->restarts.begin() + tailRestart );
+	leaf->restarts.insert( leaf->restarts.begin() + firstRestart, restarts.begin(), restarts.end() );
+	leaf->count += entryShift;
+}
+
+uint64_t BlockedKeyValueMap::leafBytes( Leaf* leaf ) {
+	return sizeof(Leaf) + IndexedSet<LeafRef, LeafMetric>::getElementBytes() + leaf->separator.expectedSize() +
+		leaf->data.capacity() + leaf->restarts.capacity() * sizeof(Restart);
+}
+
+KeyRef BlockedKeyValueMap::restartKey( Leaf* leaf, int restart ) {
+	const uint8_t* p = &leaf->data[ leaf->restarts[restart].offset ];
+	readVarint(p);  // A restart shares nothing with the key before it
+	uint32_t size = readVarint(p);
+	readVarint(p);
+	return KeyRef( p, size );
+}
+
+int BlockedKeyValueMap::findRestart( Leaf* leaf, KeyRef key ) {
+	int lo = 0, hi = leaf->restarts.size();
+	while( hi - lo > 1 ) {
+		int mid = (lo + hi) / 2;
+		if( restartKey(leaf, mid) <= key )
+			lo = mid;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+BlockedKeyValueMap::iterator BlockedKeyValueMap::atRestart( Leaf* leaf, int restart ) {
+	iterator i;
+	if( restart >= leaf->restarts.size() )
+		return i;
+	i.leaf = leaf;
+	i.index = leaf->restarts[restart].entry;
+	i.offset = leaf->restarts[restart].offset;
+	i.decode();
+	return i;
+}
+
+int BlockedKeyValueMap::restartAfter( Leaf* leaf, int entry ) {
+	return std::upper_bound( leaf->restarts.begin(), leaf->restarts.end(), entry,
+		[]( int entry, Restart const& r ) { return entry < r.entry; } ) - leaf->restarts.begin();
+}
+
+BlockedKeyValueMap::iterator BlockedKeyValueMap::at( Leaf* leaf, int entry ) {
+	iterator i = atRestart( leaf, std::max( restartAfter( leaf, entry ) - 1, 0 ) );
+	while( i.leaf == leaf && i.index < entry )
+		++i;
+	return i;
+}
+
+BlockedKeyValueMap::Leaf* BlockedKeyValueMap::findLeaf( KeyRef key ) const {
+	return index.lastLessOrEqual( key )->leaf;
+}
+
+BlockedKeyValueMap::iterator BlockedKeyValueMap::begin() const {
+	if( empty() )
+		return end();
+	return at( index.begin()->leaf, 0 );
+}
+
+BlockedKeyValueMap::iterator BlockedKeyValueMap::previous( iterator i ) const {
+	if( !i.leaf )
+		return empty() ? end() : at( lastLeaf(), lastLeaf()->count - 1 );
+	if( i.index > 0 )
+		return at( i.leaf, i.index - 1 );
+	if( !i.leaf->prev )
+		return end();
+	return at( i.leaf->prev, i.leaf->prev->count - 1 );
+}
+
+void BlockedKeyValueMap::clear() {
+	if( empty() )
+		return;
+	for(Leaf* leaf = index.begin()->leaf; leaf; ) {
+		Leaf* next = leaf->next;
+		delete leaf;
+		leaf = next;
+	}
+	index.clear();
+}
+
+BlockedKeyValueMap::iterator BlockedKeyValueMap::lower_bound( KeyRef key ) const {
+	if( empty() )
+		return end();
+	// The first key of the next leaf is at least its separator, which is greater than key
+	Leaf* leaf = findLeaf( key );
+	iterator i = atRestart( leaf, findRestart( leaf, key ) );
+	while( i.leaf == leaf && i->key < key )
+		++i;
+	return i;
+}
+
+BlockedKeyValueMap::iterator BlockedKeyValueMap::upper_bound( KeyRef key ) const {
+	if( empty() )
+		return end();
+	Leaf* leaf = findLeaf( key );
+	iterator i = atRestart( leaf, findRestart( leaf, key ) );
+	while( i.leaf == leaf && i->key <= key )
+		++i;
+	return i;
+}
+
+BlockedKeyValueMap::iterator BlockedKeyValueMap::find( KeyRef key ) const {
+	iterator i = lower_bound( key );
+	if( i.leaf && i->key != key )
+		return end();
+	return i;
+}
+
+uint64_t BlockedKeyValueMap::sumTo( iterator to ) const {
+	if( !to.leaf )
+		return index.sumTo( index.end() ).bytes;
+	return index.sumTo( index.find( KeyRef(to.leaf->separator) ) ).bytes + to.offset;
+}
+
+int64_t BlockedKeyValueMap::rank( iterator i ) const {
+	if( !i.leaf )
+		return index.sumTo( index.end() ).count;
+	return index.sumTo( index.find( KeyRef(i.leaf->separator) ) ).count + i.index;
+}
+
+BlockedKeyValueMap::iterator BlockedKeyValueMap::atRank( int64_t rank ) const {
+	if( rank < 0 )
+		return end();
+	auto l = index.index( EntryRank(rank) );
+	if( l == index.end() )
+		return end();
+	return at( l->leaf, rank - index.sumTo(l).count );
+}
+
+void BlockedKeyValueMap::addLeaf( Leaf* prev, Leaf* leaf ) {
+	if( prev ) {
+		leaf->prev = prev;
+		leaf->next = prev->next;
+		if( prev->next )
+			prev->next->prev = leaf;
+		prev->next = leaf;
+	}
+	updateIndex( leaf );
+}
+
+void BlockedKeyValueMap::removeLeaf( Leaf* leaf ) {
+	index.erase( KeyRef(leaf->separator) );
+	if( leaf->prev )
+		leaf->prev->next = leaf->next;
+	if( leaf->next ) {
+		leaf->next->prev = leaf->prev;
+		if( !leaf->prev ) {
+			// The new first leaf has to take the keys before its separator as well
+			index.erase( KeyRef(leaf->next->separator) );
+			leaf->next->separator = Key();
+			updateIndex( leaf->next );
+		}
+	}
+	delete leaf;
+}
+
+// Rewrites leaf from the first entry at or after from, adding the entries in [add, addEnd) and dropping the ones in
+// erased.  An entry depends only on the key before it, so once both are done the rest of the leaf is kept as it is,
+// joining the rest of its group to the group being written when the two fit in RESTART_INTERVAL.  Returns true if
+// every entry added sorts after every entry already in the leaf.
+bool BlockedKeyValueMap::rewrite( Leaf* leaf, KeyRef from, KeyRangeRef erased, const KeyValueRef* add, const KeyValueRef* addEnd ) {
+	int restart = findRestart( leaf, from );
+	iterator i = atRestart( leaf, restart );
+	writer.lastKey.clear();
+	while( i.leaf == leaf && i->key < from ) {
+		writer.lastKey = i.key;
+		++i;
+	}
+	int entry = i.leaf == leaf ? i.index : leaf->count;
+	writer.start( leaf, restart, entry, i.leaf == leaf ? i.offset : leaf->data.size() );
+
+	int nextRestart = restartAfter( leaf, entry - 1 );  // The first restart at or after i
+	bool follows = true;  // The last key written is the key the entry at i was encoded after
+	bool appended = true;
+	while( i.leaf == leaf || add != addEnd ) {
+		if( i.leaf == leaf ) {
+			bool isRestart = nextRestart < leaf->restarts.size() && leaf->restarts[nextRestart].entry == i.index;
+			if( add == addEnd && !( i->key < erased.end ) ) {
+				int open = writer.written % RESTART_INTERVAL;
+				int groupEnd = nextRestart + isRestart;
+				int rest = ( groupEnd < leaf->restarts.size() ? leaf->restarts[groupEnd].entry : leaf->count ) - i.index;
+				if( isRestart ? ( open == 0 || open + rest > RESTART_INTERVAL ) : ( follows && open && open + rest <= RESTART_INTERVAL ) )
+					break;
+			}
+			nextRestart += isRestart;
+		}
+		if( i.leaf == leaf && ( add == addEnd || i->key < add->key ) ) {
+			follows = !erased.contains( i->key );
+			if( follows )
+				writer.add( i->key, i->value );
+			++i;
+		} else {
+			if( i.leaf == leaf ) {
+				appended = false;
+				if( i->key == add->key )
+					++i;
+			}
+			if( add + 1 == addEnd || add[1].key != add->key ) {
+				writer.add( add->key, add->value );
+				follows = false;
+			}
+			++add;
+		}
+	}
+	if( i.leaf == leaf )
+		writer.finish( leaf, i.offset, i.index, nextRestart );
+	else
+		writer.finish( leaf, leaf->data.size(), leaf->count, leaf->restarts.size() );
+	updateIndex( leaf );
+	return appended;
+}
+
+void BlockedKeyValueMap::truncate( Leaf* leaf, int entry, int offset ) {
+	leaf->data.resize( offset );
+	while( !leaf->restarts.empty() && leaf->restarts.back().entry >= entry )
+		leaf->restarts.pop_back();
+	leaf->count = entry;
+	updateIndex( leaf );
+}
+
+// Moves the entries of leaf from entry on into a new leaf after it, and returns the new leaf.  Only the entries up to the
+// next restart are re-encoded; the bytes from there on are moved as they are.
+BlockedKeyValueMap::Leaf* BlockedKeyValueMap::moveTail( Leaf* leaf, int entry ) {
+	iterator i = at( leaf, entry );
+	int restart = restartAfter( leaf, entry );
+	int offset = restart < leaf->restarts.size() ? leaf->restarts[restart].offset : leaf->data.size();
+	Leaf* tail = new Leaf( i->key );
+	writer.lastKey.clear();
+	writer.start( tail, 0, 0, 0 );
+	for(iterator j = i; j.leaf == leaf && j.offset < offset; ++j)
+		writer.add( j->key, j->value );
+	writer.finish( tail, 0, 0, 0 );
+
+	int shift = tail->data.size() - offset;
+	tail->data.insert( tail->data.end(), leaf->data.begin() + offset, leaf->data.end() );
+	for(int r = restart; r < leaf->restarts.size(); r++) {
+		Restart moved = { leaf->restarts[r].offset + shift, leaf->restarts[r].entry - entry };
+		tail->restarts.push_back( moved );
+	}
+	tail->count = leaf->count - entry;
+	addLeaf( leaf, tail );
+	truncate( leaf, entry, i.offset );
+	return tail;
+}
+
+// Splits an oversized leaf.  After an append the old part is left full, since appends will continue in the new leaf;
+// otherwise the leaf is split in half.  Splits fall on restarts where possible.
+void BlockedKeyValueMap::split( Leaf* leaf, bool appended ) {
+	while( leaf->data.size() > LEAF_BYTES && leaf->count > 1 ) {
+		int target = appended ? LEAF_BYTES : leaf->data.size() / 2;
+		int entry;
+		if( leaf->restarts.size() > 1 ) {
+			int restart = std::upper_bound( leaf->restarts.begin(), leaf->restarts.end(), target,
+				[]( int target, Restart const& r ) { return target < r.offset; } ) - leaf->restarts.begin() - 1;
+			entry = leaf->restarts[ std::max( restart, 1 ) ].entry;
+		} else {
+			iterator i = at( leaf, 1 );
+			while( i.leaf == leaf && i.index < leaf->count - 1 && i.nextOffset <= target )
+				++i;
+			entry = i.index;
+		}
+		leaf = moveTail( leaf, entry );
+	}
+}
+
+// Folds leaf->next into leaf when either has shrunk below a quarter of LEAF_BYTES and together they fit in one leaf.
+// The first entry of a leaf is a restart, so the entries of next can be appended as they are.
+void BlockedKeyValueMap::mergeWithNext( Leaf* leaf ) {
+	Leaf* next = leaf->next;
+	if( !next || leaf->data.size() + next->data.size() > LEAF_BYTES ||
+		( leaf->data.size() >= LEAF_BYTES / 4 && next->data.size() >= LEAF_BYTES / 4 ) )
+		return;
+	int offset = leaf->data.size();
+	leaf->data.insert( leaf->data.end(), next->data.begin(), next->data.end() );
+	for(auto r : next->restarts) {
+		r.offset += offset;
+		r.entry += leaf->count;
+		leaf->restarts.push_back( r );
+	}
+	leaf->count += next->count;
+	removeLeaf( next );
+	updateIndex( leaf );
+}
+
+// Removes leaf if it is empty, and otherwise merges it with its neighbors if they are small.  Never removes leaf->prev.
+void BlockedKeyValueMap::compact( Leaf* leaf ) {
+	if( !leaf->count ) {
+		removeLeaf( leaf );
+		return;
+	}
+	Leaf* prev = leaf->prev;
+	mergeWithNext( leaf );
+	if( prev )
+		mergeWithNext( prev );
+}
+
+void BlockedKeyValueMap::insert( KeyValueRef kv ) {
+	if( empty() )
+		addLeaf( NULL, new Leaf( KeyRef() ) );
+	Leaf* leaf = findLeaf( kv.key );
+	split( leaf, rewrite( leaf, kv.key, KeyRangeRef(), &kv, &kv + 1 ) );
+}
+
+void BlockedKeyValueMap::insert( const std::vector<KeyValueRef>& sorted ) {
+	// Each leaf takes every key that sorts before the next leaf's separator, up to about a leaf's worth at a time so that
+	// a long run is written into a chain of new leaves rather than into one leaf that then has to be split many times
+	for(int begin = 0; begin < sorted.size(); ) {
+		if( empty() )
+			addLeaf( NULL, new Leaf( KeyRef() ) );
+		Leaf* leaf = findLeaf( sorted[begin].key );
+		int end = begin;
+		int64_t bytes = 0;
+		do {
+			bytes += sorted[end].expectedSize();
+			++end;
+		} while( end < sorted.size() && bytes < LEAF_BYTES && ( !leaf->next || sorted[end].key < leaf->next->separator ) );
+		split( leaf, rewrite( leaf, sorted[begin].key, KeyRangeRef(), &sorted[begin], &sorted[0] + end ) );
+		begin = end;
+	}
+}
+
+void BlockedKeyValueMap::erase( iterator begin, iterator end ) {
+	if( begin == end )
+		return;
+	Leaf* first = begin.leaf;
+	if( end.leaf == first ) {
+		rewrite( first, begin->key, KeyRangeRef( begin->key, end->key ), NULL, NULL );
+		compact( first );
+		return;
+	}
+
+	truncate( first, begin.index, begin.offset );
+	if( first->next != end.leaf ) {
+		auto removeEnd = end.leaf ? index.find( KeyRef(end.leaf->separator) ) : index.end();
+		index.erase( index.find( KeyRef(first->next->separator) ), removeEnd );
+		for(Leaf* leaf = first->next; leaf != end.leaf; ) {
+			Leaf* next = leaf->next;
+			delete leaf;
+			leaf = next;
+		}
+		first->next = end.leaf;
+		if( end.leaf )
+			end.leaf->prev = first;
+	}
+	if( end.leaf ) {
+		if( end.index > 0 )
+			rewrite( end.leaf, KeyRef(), KeyRangeRef( KeyRef(), end->key ), NULL, NULL );
+		compact( end.leaf );
+	}
+	compact( first );
+}
+
+TEST_CASE("fdbserver/BlockedKeyValueMap/random") {
+	BlockedKeyValueMap map;
+	std::map<std::string, std::string> expected;
+	std::vector<std::string> keys;
+	for(int i = 0; i < 2000; i++)
+		keys.push_back( format( "%s/%06d", i % 3 ? "prefix/shared/by/many/keys" : "p", g_random->randomInt(0, 1000000) ) );
+	auto randomKey = [&keys]() { return KeyRef( keys[ g_random->randomInt(0, keys.size()) ] ); };
+	auto randomValue = []() { return std::string( g_random->randomInt(0, g_random->random01() < 0.01 ? 10000 : 100), 'v' ); };
+
+	for(int op = 0; op < 20000; op++) {
+		int type = g_random->randomInt(0, 10);
+		if( type < 5 ) {
+			KeyRef key = randomKey();
+			std::string value = randomValue();
+			map.insert( KeyValueRef( key, StringRef(value) ) );
+			expected[ key.toString() ] = value;
+		} else if( type < 7 ) {
+			std::vector<std::string> values;
+			std::vector<KeyValueRef> sorted;
+			int count = g_random->randomInt(1, 200);
+			for(int i = 0; i < count; i++)
+				values.push_back( randomValue() );
+			for(int i = 0; i < count; i++)
+				sorted.push_back( KeyValueRef( randomKey(), StringRef(values[i]) ) );
+			std::stable_sort( sorted.begin(), sorted.end(), [](KeyValueRef const& a, KeyValueRef const& b) { return a.key < b.key; } );
+			map.insert( sorted );
+			for(auto& kv : sorted)
+				expected[ kv.key.toString() ] = kv.value.toString();
+		} else if( type < 8 ) {
+			KeyRef begin = randomKey(), end = randomKey();
+			if( end < begin )
+				std::swap( begin, end );
+			if( g_random->random01() < 0.01 ) {
+				map.erase( map.lower_bound(begin), map.end() );
+				expected.erase( expected.lower_bound( begin.toString() ), expected.end() );
+			} else {
+				map.erase( map.lower_bound(begin), map.lower_bound(end) );
+				expected.erase( expected.lower_bound( begin.toString() ), expected.lower_bound( end.toString() ) );
+			}
+		} else {
+			KeyRef key = randomKey();
+			auto i = map.lower_bound(key);
+			auto e = expected.lower_bound( key.toString() );
+			ASSERT( ( i == map.end() ) == ( e == expected.end() ) );
+			if( e != expected.end() )
+				ASSERT( i->key == StringRef(e->first) && i->value == StringRef(e->second) );
+
+			i = map.upper_bound(key);
+			e = expected.upper_bound( key.toString() );
+			ASSERT( ( i == map.end() ) == ( e == expected.end() ) );
+			if( e != expected.end() )
+				ASSERT( i->key == StringRef(e->first) );
+
+			i = map.previous(i);
+			ASSERT( ( i == map.end() ) == ( e == expected.begin() ) );
+			if( e != expected.begin() )
+				ASSERT( i->key == StringRef( std::prev(e)->first ) );
+
+			i = map.find(key);
+			e = expected.find( key.toString() );
+			ASSERT( ( i == map.end() ) == ( e == expected.end() ) );
+		}
+
+		if( op % 1000 == 0 || op == 19999 ) {
+			auto e = expected.begin();
+			uint64_t lastSum = 0;
+			int64_t r = 0;
+			for(auto i = map.begin(); i != map.end(); ++i, ++e, ++r) {
+				ASSERT( e != expected.end() && i->key == StringRef(e->first) && i->value == StringRef(e->second) );
+				uint64_t sum = map.sumTo(i);
+				ASSERT( sum >= lastSum );
+				lastSum = sum;
+				ASSERT( map.rank(i) == r );
+				if( g_random->random01() < 0.05 )
+					ASSERT( map.atRank(r) == i );
+			}
+			ASSERT( e == expected.end() );
+			ASSERT( map.sumTo( map.end() ) >= lastSum );
+			ASSERT( map.rank( map.end() ) == expected.size() && map.atRank( expected.size() ) == map.end() );
+
+			auto i = map.end();
+			for(auto r = expected.rbegin(); r != expected.rend(); ++r) {
+				i = map.previous(i);
+				ASSERT( i != map.end() && i->key == StringRef(r->first) );
+			}
+			ASSERT( map.previous(i) == map.end() );
+		}
+	}
+
+	map.erase( map.begin(), map.end() );
+	ASSERT( map.empty() && map.sumTo( map.end() ) == 0 );
+	return Void();
+}
@@ -0,0 +1,185 @@
+/*
+ * BlockedKeyValueMap.h
+ *
+ * This source file is part of the FoundationDB open source project
+ *
+ * Copyright 2013-2018 Apple Inc. and the FoundationDB project authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FDBSERVER_BLOCKEDKEYVALUEMAP_H
+#define FDBSERVER_BLOCKEDKEYVALUEMAP_H
+#pragma once
+
+#include "fdbclient/FDBTypes.h"
+#include "flow/IndexedSet.h"
+
+// An ordered map from keys to values that keeps its contents in blocks ("leaves") of about LEAF_BYTES each, rather than
+// in one tree node and one arena per key.  Within a leaf the entries are packed back to back and each key is stored
+// as the length of the prefix it shares with the key before it followed by the rest of the key.  At least every
+// RESTART_INTERVAL'th key is stored in full, so a lookup binary searches those keys and then decodes at most
+// RESTART_INTERVAL entries, and a modification re-encodes only the entries between two of them.  The leaves themselves
+// are kept in an IndexedSet keyed by a separator key and weighted by the memory each leaf uses and the number of entries
+// in it, which provides sumTo() and finding an entry by its position with one tree node per leaf.
+//
+// An iterator holds its own copy of the current key, which it rebuilds as it moves.  The key it exposes is valid until
+// the iterator moves and the value until the map is modified.  Any modification of the map invalidates all iterators.
+class BlockedKeyValueMap : NonCopyable {
+	struct Leaf;
+
+public:
+	enum { LEAF_BYTES = 4096, RESTART_INTERVAL = 16 };
+
+	class iterator {
+	public:
+		iterator() : leaf(NULL), index(0), offset(0), nextOffset(0) {}
+		iterator( iterator const& r ) { *this = r; }
+		iterator& operator=( iterator const& r );
+
+		const KeyValueRef& operator*() const { return kv; }
+		const KeyValueRef* operator->() const { return &kv; }
+		void operator++();
+		bool operator == ( iterator const& r ) const { return leaf == r.leaf && index == r.index; }
+		bool operator != ( iterator const& r ) const { return !(*this == r); }
+
+	private:
+		friend class BlockedKeyValueMap;
+
+		Leaf* leaf;  // NULL for end()
+		int index;  // Position of the entry in leaf
+		int offset;  // Byte offset of the entry in leaf->data
+		int nextOffset;  // Byte offset of the entry after it
+		std::string key;
+		KeyValueRef kv;
+
+		void decode();  // Decodes the entry at offset, which begins with a prefix of the key currently in key
+	};
+
+	BlockedKeyValueMap() {}
+	~BlockedKeyValueMap() { clear(); }
+
+	iterator begin() const;
+	iterator end() const { return iterator(); }
+	iterator previous( iterator i ) const;  // previous(end()) is the last entry, and previous(begin()) is end()
+	bool empty() const { return index.empty(); }
+	void clear();
+
+	iterator find( KeyRef key ) const;
+	iterator lower_bound( KeyRef key ) const;
+	iterator upper_bound( KeyRef key ) const;
+
+	// Sets kv.key to kv.value, replacing any value it already has.  The map keeps its own copy of both.
+	void insert( KeyValueRef kv );
+
+	// Sets each of the given keys, which must be in ascending order.  If a key repeats, the last of its values is kept.
+	void insert( const std::vector<KeyValueRef>& sorted );
+
+	// Removes the entries from begin up to but not including end
+	void erase( iterator begin, iterator end );
+
+	// Returns the memory used by the map before to, or by the whole map for sumTo(end())
+	uint64_t sumTo( iterator to ) const;
+
+	// Returns the number of entries before i, or in the whole map for rank(end())
+	int64_t rank( iterator i ) const;
+
+	// Returns the entry with rank(i) == rank, or end() if there are not that many entries.  Takes O(log n) time.
+	iterator atRank( int64_t rank ) const;
+
+private:
+	// An entry whose key is stored in full, and from which the entries up to the next restart can be decoded
+	struct Restart {
+		int offset;
+		int entry;
+	};
+
+	struct Leaf {
+		Key separator;  // The leaf's key in the index.  Every key in the leaf is at least this, and the first leaf's is empty.
+		std::vector<uint8_t> data;
+		std::vector<Restart> restarts;  // The first entry is always a restart, and restarts are at most RESTART_INTERVAL apart
+		int count;
+		Leaf *prev, *next;
+
+		explicit Leaf( KeyRef separator ) : separator(separator), count(0), prev(NULL), next(NULL) {}
+	};
+
+	struct LeafRef {
+		KeyRef separator;
+		Leaf* leaf;
+
+		LeafRef( Leaf* leaf ) : separator(leaf->separator), leaf(leaf) {}
+		bool operator < ( LeafRef const& r ) const { return separator < r.separator; }
+		friend bool operator < ( LeafRef const& l, KeyRef const& r ) { return l.separator < r; }
+		friend bool operator < ( KeyRef const& l, LeafRef const& r ) { return l < r.separator; }
+	};
+
+	// The weight of a leaf in the index.  The index orders sums by memory; EntryRank looks leaves up by entries.
+	struct LeafMetric {
+		uint64_t bytes;
+		int64_t count;
+
+		LeafMetric( uint64_t bytes = 0, int64_t count = 0 ) : bytes(bytes), count(count) {}
+		LeafMetric operator + ( LeafMetric const& r ) const { return LeafMetric( bytes + r.bytes, count + r.count ); }
+		LeafMetric operator - ( LeafMetric const& r ) const { return LeafMetric( bytes - r.bytes, count - r.count ); }
+		bool operator < ( LeafMetric const& r ) const { return bytes < r.bytes; }
+	};
+
+	struct EntryRank {
+		int64_t entries;
+
+		explicit EntryRank( int64_t entries = 0 ) : entries(entries) {}
+		EntryRank operator + ( LeafMetric const& r ) const { return EntryRank( entries + r.count ); }
+		EntryRank operator - ( LeafMetric const& r ) const { return EntryRank( entries - r.count ); }
+		bool operator < ( LeafMetric const& r ) const { return entries < r.count; }
+		bool operator < ( EntryRank const& r ) const { return entries < r.entries; }
+	};
+
+	// Encodes entries into a scratch buffer, which then replaces a run of the entries of a leaf.  The buffer is reused, so
+	// modifying a leaf allocates only when the leaf grows.
+	struct Writer {
+		std::vector<uint8_t> out;
+		std::vector<Restart> restarts;
+		std::string lastKey;
+		int base, firstRestart, count, written;
+
+		void start( Leaf* leaf, int restart, int entry, int offset );
+		void add( KeyRef key, ValueRef value );
+		void finish( Leaf* leaf, int tailOffset, int tailEntry, int tailRestart );
+	};
+
+	IndexedSet<LeafRef, LeafMetric> index;
+	Writer writer;
+
+	static uint64_t leafBytes( Leaf* leaf );
+	static KeyRef restartKey( Leaf* leaf, int restart );
+	static int findRestart( Leaf* leaf, KeyRef key );  // The last restart whose key is at most key, or 0
+	static int restartAfter( Leaf* leaf, int entry );  // The first restart after entry
+	static iterator atRestart( Leaf* leaf, int restart );
+	static iterator at( Leaf* leaf, int entry );
+	Leaf* findLeaf( KeyRef key ) const;
+	Leaf* lastLeaf() const { return index.lastItem()->leaf; }
+
+	void addLeaf( Leaf* prev, Leaf* leaf );  // Links leaf in after prev, or as the only leaf
+	void removeLeaf( Leaf* leaf );
+	void updateIndex( Leaf* leaf ) { index.insert( LeafRef(leaf), LeafMetric( leafBytes(leaf), leaf->count ) ); }
+
+	bool rewrite( Leaf* leaf, KeyRef from, KeyRangeRef erased, const KeyValueRef* add, const KeyValueRef* addEnd );
+	void truncate( Leaf* leaf, int entry, int offset );
+	void split( Leaf* leaf, bool appended );
+	Leaf* moveTail( Leaf* leaf, int entry );
+	void mergeWithNext( Leaf* leaf );
+	void compact( Leaf* leaf );
+};
+
+#endif
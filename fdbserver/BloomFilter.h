@@ -0,0 +1,80 @@
+/*
+ * BloomFilter.h
+ *
+ * This source file is part of the FoundationDB open source project
+ *
+ * Copyright 2013-2018 Apple Inc. and the FoundationDB project authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FDBSERVER_BLOOMFILTER_H
+#define FDBSERVER_BLOOMFILTER_H
+#pragma once
+
+#include "fdbclient/FDBTypes.h"
+#include "flow/Hash3.h"
+
+// A fixed size Bloom filter over keys.  mayContain() is true for every key that has been added, and for a fraction of
+// other keys that depends on bitsPerKey and on how many more keys have been added than the filter was sized for.
+// Keys are hashed once, and the probe positions are derived from the two halves of the hash.
+struct BloomFilter {
+	typedef std::pair<uint32_t, uint32_t> Hash;
+
+	BloomFilter() : words(1), bits(64), probes(1) {}
+	BloomFilter( int64_t expectedKeys, int bitsPerKey ) {
+		bits = std::max<int64_t>( expectedKeys * bitsPerKey, 64 );
+		probes = std::min( std::max( (int)(bitsPerKey * 0.69 + 0.5), 1 ), 30 );  // ln(2) probes per bit minimizes false positives
+		words.resize( (bits + 63) / 64 );
+	}
+
+	static Hash hash( KeyRef key ) {
+		uint32_t a = 0, b = 0;
+		hashlittle2( key.begin(), key.size(), &a, &b );
+		return Hash( a, b | 1 );
+	}
+
+	static int64_t memoryBytesFor( int64_t expectedKeys, int bitsPerKey ) {
+		return ( std::max<int64_t>( expectedKeys * bitsPerKey, 64 ) + 63 ) / 64 * sizeof(uint64_t);
+	}
+
+	void add( Hash h ) {
+		for(int i = 0; i < probes; i++) {
+			uint64_t bit = ( h.first + (uint64_t)i * h.second ) % bits;
+			words[ bit / 64 ] |= uint64_t(1) << ( bit % 64 );
+		}
+	}
+
+	bool mayContain( Hash h ) const {
+		for(int i = 0; i < probes; i++) {
+			uint64_t bit = ( h.first + (uint64_t)i * h.second ) % bits;
+			if( !( words[ bit / 64 ] & ( uint64_t(1) << ( bit % 64 ) ) ) )
+				return false;
+		}
+		return true;
+	}
+
+	int64_t memoryBytes() const { return words.size() * sizeof(uint64_t); }
+
+	template <class Ar>
+	void serialize( Ar& ar ) {
+		ar & words & bits & probes;
+	}
+
+private:
+	std::vector<uint64_t> words;
+	uint64_t bits;
+	int probes;
+};
+
+#endif
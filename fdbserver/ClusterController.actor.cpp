@@ -50,13 +50,14 @@ struct WorkerInfo : NonCopyable {
 	ProcessClass initialClass;
 	ProcessClass processClass;
 	ClusterControllerPriorityInfo priorityInfo;
+	HostCapacity capacity;
 
 	WorkerInfo() : gen(-1), reboots(0), priorityInfo(ProcessClass::UnsetFit, false, ClusterControllerPriorityInfo::FitnessUnknown) {}
 	WorkerInfo( Future<Void> watcher, ReplyPromise<RegisterWorkerReply> reply, Generation gen, WorkerInterface interf, ProcessClass initialClass, ProcessClass processClass, ClusterControllerPriorityInfo priorityInfo ) :
 		watcher(watcher), reply(reply), gen(gen), reboots(0), interf(interf), initialClass(initialClass), processClass(processClass), priorityInfo(priorityInfo) {}
 
 	WorkerInfo( WorkerInfo&& r ) noexcept(true) : watcher(std::move(r.watcher)), reply(std::move(r.reply)), gen(r.gen),
-		reboots(r.reboots), interf(std::move(r.interf)), initialClass(r.initialClass), processClass(r.processClass), priorityInfo(r.priorityInfo) {}
+		reboots(r.reboots), interf(std::move(r.interf)), initialClass(r.initialClass), processClass(r.processClass), priorityInfo(r.priorityInfo), capacity(r.capacity) {}
 	void operator=( WorkerInfo&& r ) noexcept(true) {
 		watcher = std::move(r.watcher);
 		reply = std::move(r.reply);
@@ -66,6 +67,7 @@ struct WorkerInfo : NonCopyable {
 		initialClass = r.initialClass;
 		processClass = r.processClass;
 		priorityInfo = r.priorityInfo;
+		capacity = r.capacity;
 	}
 };
 
@@ -93,6 +95,37 @@ public:
 		DatabaseConfiguration fullyRecoveredConfig;
 		Database db;
 
+		// The encoded members of the ServerDBInfos sent to workers, by id: the current one last, after up to
+		// SERVER_DB_INFO_HISTORY before it which workers may still have
+		std::deque<std::pair<UID, std::vector<Standalone<StringRef>>>> serverInfoEncodings;
+
+		// Returns the current ServerDBInfo, as the members that differ from those of knownID if that is still known.
+		// Each ServerDBInfo is encoded once, however many workers it is sent to.
+		ServerDBInfoUpdate getServerInfoUpdate( UID knownID ) {
+			ServerDBInfo const& info = serverInfo->get();
+			if( serverInfoEncodings.empty() || serverInfoEncodings.back().first != info.id ) {
+				serverInfoEncodings.push_back( std::make_pair( info.id, info.encodeFields() ) );
+				while( serverInfoEncodings.size() > SERVER_KNOBS->SERVER_DB_INFO_HISTORY + 1 )
+					serverInfoEncodings.pop_front();
+			}
+			std::vector<Standalone<StringRef>> const& current = serverInfoEncodings.back().second;
+
+			ServerDBInfoUpdate update;
+			update.id = info.id;
+			std::vector<Standalone<StringRef>> const* base = NULL;
+			for(auto& e : serverInfoEncodings) {
+				if( knownID.isValid() && e.first == knownID ) {
+					update.baseID = knownID;
+					base = &e.second;
+				}
+			}
+			for(int f = 0; f < current.size(); f++) {
+				if( !base || current[f] != (*base)[f] )
+					update.fields.push_back( std::make_pair( f, current[f] ) );
+			}
+			return update;
+		}
+
 		DBInfo() : masterRegistrationCount(0),
 			clientInfo( new AsyncVar<ClientDBInfo>( ClientDBInfo() ) ),
 			serverInfo( new AsyncVar<ServerDBInfo>( ServerDBInfo( LiteralStringRef("DB") ) ) ),
@@ -164,6 +197,41 @@ public:
 		return ( now() - startTime < 2 * FLOW_KNOBS->SERVER_REQUEST_INTERVAL ) || ( IFailureMonitor::failureMonitor().getState(worker.interf.storage.getEndpoint()).isAvailable() && ( !checkStable || worker.reboots < 2 ) );
 	}
 
+	// What a role depends on most of its host, as measured by the worker: syncing to disk for logs, and computing for
+	// everything else.  Zero if the worker did not measure it.
+	static double capacityCost( HostCapacity const& capacity, ProcessClass::ClusterRole role ) {
+		return role == ProcessClass::TLog ? capacity.diskSyncLatency : capacity.cpuProbeTime;
+	}
+
+	double medianCapacityCost( ProcessClass::ClusterRole role ) {
+		std::vector<double> costs;
+		for( auto& it : id_worker ) {
+			double cost = capacityCost( it.second.capacity, role );
+			if( cost > 0 )
+				costs.push_back( cost );
+		}
+		if( costs.empty() )
+			return 0;
+		std::nth_element( costs.begin(), costs.begin() + costs.size()/2, costs.end() );
+		return costs[costs.size()/2];
+	}
+
+	// Whether the worker's host measured more than SLOW_HOST_RATIO times slower than the median host at what the role
+	// needs.  Recruitment takes the other workers of the same fitness first, but does not treat a slow host as any less fit.
+	bool isSlowHost( WorkerInterface const& worker, ProcessClass::ClusterRole role, double medianCost ) {
+		auto it = id_worker.find( worker.locality.processId() );
+		if( medianCost <= 0 || it == id_worker.end() )
+			return false;
+		return capacityCost( it->second.capacity, role ) > SERVER_KNOBS->SLOW_HOST_RATIO * medianCost;
+	}
+
+	// Moves the workers of slow hosts to the back, keeping the order of the others
+	void preferFastHosts( vector<std::pair<WorkerInterface, ProcessClass>>& workers, ProcessClass::ClusterRole role, double medianCost ) {
+		if( medianCost <= 0 )
+			return;
+		std::stable_partition( workers.begin(), workers.end(), [&]( std::pair<WorkerInterface, ProcessClass> const& w ) { return !isSlowHost( w.first, role, medianCost ); } );
+	}
+
 	std::pair<WorkerInterface, ProcessClass> getStorageWorker( RecruitStorageRequest const& req ) {
 		std::set<Optional<Standalone<StringRef>>> excludedMachines( req.excludeMachines.begin(), req.excludeMachines.end() );
 		std::set<Optional<Standalone<StringRef>>> includeDCs( req.includeDCs.begin(), req.includeDCs.end() );
@@ -243,9 +311,11 @@ public:
 	}
 
 	std::vector<std::pair<WorkerInterface, ProcessClass>> getWorkersForTlogs( DatabaseConfiguration const& conf, int32_t tLogReplicationFactor, int32_t desired, IRepPolicyRef const& policy, std::map< Optional<Standalone<StringRef>>, int>& id_used, bool checkStable = false, std::set<Optional<Key>> dcIds = std::set<Optional<Key>>() ) {
-		std::map<ProcessClass::Fitness, vector<std::pair<WorkerInterface, ProcessClass>>> fitness_workers;
+		// The workers of slow hosts are tried after the others of the same fitness
+		std::map<std::pair<ProcessClass::Fitness, bool>, vector<std::pair<WorkerInterface, ProcessClass>>> fitness_workers;
 		std::vector<std::pair<WorkerInterface, ProcessClass>> results;
 		std::vector<LocalityData> unavailableLocals;
+		double medianCost = medianCapacityCost( ProcessClass::TLog );
 		LocalitySetRef logServerSet;
 		LocalityMap<std::pair<WorkerInterface, ProcessClass>>* logServerMap;
 		bool bCompleted = false;
@@ -256,7 +326,7 @@ public:
 		for( auto& it : id_worker ) {
 			auto fitness = it.second.processClass.machineClassFitness( ProcessClass::TLog );
 			if( workerAvailable(it.second, checkStable) && !conf.isExcludedServer(it.second.interf.address()) && fitness != ProcessClass::NeverAssign && (!dcIds.size() || dcIds.count(it.second.interf.locality.dcId())) ) {
-				fitness_workers[ fitness ].push_back(std::make_pair(it.second.interf, it.second.processClass));
+				fitness_workers[ std::make_pair(fitness, isSlowHost(it.second.interf, ProcessClass::TLog, medianCost)) ].push_back(std::make_pair(it.second.interf, it.second.processClass));
 			}
 			else {
 				unavailableLocals.push_back(it.second.interf.locality);
@@ -264,12 +334,11 @@ public:
 		}
 
 		results.reserve(results.size() + id_worker.size());
-		for (int fitness = ProcessClass::BestFit; fitness != ProcessClass::NeverAssign; fitness ++)
+		for (auto& fw : fitness_workers)
 		{
-			auto fitnessEnum = (ProcessClass::Fitness) fitness;
-			if (fitness_workers.find(fitnessEnum) == fitness_workers.end())
-				continue;
-			for (auto& worker : fitness_workers[(ProcessClass::Fitness) fitness] ) {
+			int fitness = fw.first.first;
+			TEST(fw.first.second); // Considering slow hosts for logs
+			for (auto& worker : fw.second ) {
 				logServerMap->add(worker.first.locality, &worker);
 			}
 			if (logServerSet->size() < tLogReplicationFactor) {
@@ -398,9 +467,11 @@ public:
 			}
 		}
 
+		double medianCost = medianCapacityCost( role );
 		for( auto& it : fitness_workers ) {
 			auto& w = it.second;
 			g_random->randomShuffle(w);
+			preferFastHosts( w, role, medianCost );
 			for( int i=0; i < w.size(); i++ ) {
 				id_used[w[i].first.locality.processId()]++;
 				return WorkerFitnessInfo(w[i], it.first.first, it.first.second);
@@ -424,9 +495,11 @@ public:
 			}
 		}
 
+		double medianCost = medianCapacityCost( role );
 		for( auto& it : fitness_workers ) {
 			auto& w = it.second;
 			g_random->randomShuffle(w);
+			preferFastHosts( w, role, medianCost );
 			for( int i=0; i < w.size(); i++ ) {
 				results.push_back(w[i]);
 				id_used[w[i].first.locality.processId()]++;
@@ -589,10 +662,14 @@ public:
 		proxies.push_back(first_proxy.worker);
 		resolvers.push_back(first_resolver.worker);
 
+		auto grvProxies = getWorkersForRoleInDatacenter( dcId, ProcessClass::Proxy, req.configuration.getDesiredGrvProxies(), req.configuration, id_used );
+
 		for(int i = 0; i < resolvers.size(); i++)
 			result.resolvers.push_back(resolvers[i].first);
 		for(int i = 0; i < proxies.size(); i++)
 			result.proxies.push_back(proxies[i].first);
+		for(int i = 0; i < grvProxies.size(); i++)
+			result.grvProxies.push_back(grvProxies[i].first);
 
 		auto logRouters = getWorkersForRoleInDatacenter( remoteDcId, ProcessClass::LogRouter, req.configuration.getDesiredLogRouters(), req.configuration, id_used );
 		result.logRouterCount = logRouters.size() ? logRouters.size() : 1;
@@ -601,6 +678,7 @@ public:
 			( RoleFitness(tlogs, ProcessClass::TLog) > RoleFitness(SERVER_KNOBS->EXPECTED_TLOG_FITNESS, req.configuration.getDesiredLogs()) ||
 			  ( region.satelliteTLogReplicationFactor > 0 && RoleFitness(satelliteLogs, ProcessClass::TLog) > RoleFitness(SERVER_KNOBS->EXPECTED_TLOG_FITNESS, req.configuration.getDesiredSatelliteLogs(dcId)) ) ||
 			  RoleFitness(proxies, ProcessClass::Proxy) > RoleFitness(SERVER_KNOBS->EXPECTED_PROXY_FITNESS, req.configuration.getDesiredProxies()) ||
+			  ( grvProxies.size() && RoleFitness(grvProxies, ProcessClass::Proxy) > RoleFitness(SERVER_KNOBS->EXPECTED_PROXY_FITNESS, req.configuration.getDesiredGrvProxies()) ) ||
 			  RoleFitness(resolvers, ProcessClass::Resolver) > RoleFitness(SERVER_KNOBS->EXPECTED_RESOLVER_FITNESS, req.configuration.getDesiredResolvers()) ) ) {
 			return operation_failed();
 		}
@@ -677,6 +755,7 @@ public:
 			RoleFitness bestFitness;
 			int numEquivalent = 1;
 			Optional<Key> bestDC;
+			std::vector<std::pair<WorkerInterface, ProcessClass>> grvProxies;
 
 			for(auto dcId : datacenters ) {
 				try {
@@ -700,6 +779,10 @@ public:
 							result.resolvers.push_back(resolvers[i].first);
 						for(int i = 0; i < proxies.size(); i++)
 							result.proxies.push_back(proxies[i].first);
+
+						grvProxies = getWorkersForRoleInDatacenter( dcId, ProcessClass::Proxy, req.configuration.getDesiredGrvProxies(), req.configuration, used );
+						for(int i = 0; i < grvProxies.size(); i++)
+							result.grvProxies.push_back(grvProxies[i].first);
 						break;
 					} else {
 						if(fitness < bestFitness) {
@@ -728,11 +811,13 @@ public:
 			TraceEvent("findWorkersForConfig").detail("replication", req.configuration.tLogReplicationFactor)
 				.detail("desiredLogs", req.configuration.getDesiredLogs()).detail("actualLogs", result.tLogs.size())
 				.detail("desiredProxies", req.configuration.getDesiredProxies()).detail("actualProxies", result.proxies.size())
+				.detail("desiredGrvProxies", req.configuration.getDesiredGrvProxies()).detail("actualGrvProxies", result.grvProxies.size())
 				.detail("desiredResolvers", req.configuration.getDesiredResolvers()).detail("actualResolvers", result.resolvers.size());
 
 			if( now() - startTime < SERVER_KNOBS->WAIT_FOR_GOOD_RECRUITMENT_DELAY &&
 				( RoleFitness(tlogs, ProcessClass::TLog) > RoleFitness(SERVER_KNOBS->EXPECTED_TLOG_FITNESS, req.configuration.getDesiredLogs()) ||
-				bestFitness > RoleFitness(std::min(SERVER_KNOBS->EXPECTED_PROXY_FITNESS, SERVER_KNOBS->EXPECTED_RESOLVER_FITNESS), std::max(SERVER_KNOBS->EXPECTED_PROXY_FITNESS, SERVER_KNOBS->EXPECTED_RESOLVER_FITNESS), req.configuration.getDesiredProxies()+req.configuration.getDesiredResolvers()) ) ) {
+				bestFitness > RoleFitness(std::min(SERVER_KNOBS->EXPECTED_PROXY_FITNESS, SERVER_KNOBS->EXPECTED_RESOLVER_FITNESS), std::max(SERVER_KNOBS->EXPECTED_PROXY_FITNESS, SERVER_KNOBS->EXPECTED_RESOLVER_FITNESS), req.configuration.getDesiredProxies()+req.configuration.getDesiredResolvers()) ||
+				( grvProxies.size() && RoleFitness(grvProxies, ProcessClass::Proxy) > RoleFitness(SERVER_KNOBS->EXPECTED_PROXY_FITNESS, req.configuration.getDesiredGrvProxies()) ) ) ) {
 				throw operation_failed();
 			}
 
@@ -834,6 +919,15 @@ public:
 			proxyClasses.push_back(proxyWorker->second.processClass);
 		}
 
+		// GRV proxies are not compared for fitness, but are moved off of excluded processes
+		for(auto& it : dbi.client.grvProxies ) {
+			auto proxyWorker = id_worker.find(it.locality.processId());
+			if ( proxyWorker == id_worker.end() )
+				return false;
+			if ( proxyWorker->second.priorityInfo.isExcluded )
+				return true;
+		}
+
 		// Get resolver classes
 		std::vector<ProcessClass> resolverClasses;
 		for(auto& it : dbi.resolvers ) {
@@ -1087,7 +1181,7 @@ ACTOR Future<Void> clusterGetServerInfo(
 	UID knownServerInfoID,
 	std::string issues,
 	std::vector<NetworkAddress> incompatiblePeers,
-	ReplyPromise<ServerDBInfo> reply)
+	ReplyPromise<ServerDBInfoUpdate> reply)
 {
 	state UID issueID;
 	addIssue( db->workersWithIssues, reply.getEndpoint().address, issues, issueID );
@@ -1104,7 +1198,9 @@ ACTOR Future<Void> clusterGetServerInfo(
 
 	removeIssue( db->workersWithIssues, reply.getEndpoint().address, issues, issueID );
 
-	reply.send( db->serverInfo->get() );
+	ServerDBInfoUpdate update = db->getServerInfoUpdate( knownServerInfoID );
+	TEST( update.baseID.isValid() ); // ServerDBInfo sent as an update
+	reply.send( update );
 	return Void();
 }
 
@@ -1134,6 +1230,10 @@ ACTOR Future<Void> clusterOpenDatabase(
 		}
 	}
 
+	// Every client waiting here wakes up at once when the client info changes.  Answering each of them at a low priority
+	// once the cluster controller has been busy for a while keeps a large fleet of clients from starving its other work.
+	Void _ = wait( yield( TaskDefaultYield ) );
+
 	removeIssue( db->clientsWithIssues, reply.getEndpoint().address, issues, issueID );
 	db->clientVersionMap.erase(reply.getEndpoint().address);
 	db->traceLogGroupMap.erase(reply.getEndpoint().address);
@@ -1292,122 +1392,178 @@ struct FailureStatusInfo {
 	}
 };
 
+// Returns the changes from reqVersion to currentVersion.  Everything is sent when the history no longer goes back to reqVersion,
+// and that reply is built once per version in snapshot and shared by every requester that needs it.
+static FailureMonitoringReply failureMonitoringReply( Version reqVersion, bool fromServer, Version currentVersion,
+		std::map<NetworkAddress, FailureStatusInfo> const& currentStatus, std::deque<SystemFailureStatus> const& statusHistory,
+		Standalone<VectorRef<SystemFailureStatus>>& snapshot, Version& snapshotVersion ) {
+	FailureMonitoringReply reply;
+	reply.failureInformationVersion = currentVersion;
+	if( fromServer ) {
+		reply.clientRequestIntervalMS = FLOW_KNOBS->SERVER_REQUEST_INTERVAL * 1000;
+		reply.considerServerFailedTimeoutMS = CLIENT_KNOBS->FAILURE_TIMEOUT_DELAY * 1000;
+	} else {
+		reply.clientRequestIntervalMS = FLOW_KNOBS->CLIENT_REQUEST_INTERVAL * 1000;
+		reply.considerServerFailedTimeoutMS = CLIENT_KNOBS->CLIENT_FAILURE_TIMEOUT_DELAY * 1000;
+	}
+
+	ASSERT( currentVersion >= (int64_t)statusHistory.size());
+
+	if (reqVersion < currentVersion - (int64_t)statusHistory.size() || reqVersion == 0) {
+		// Send everything
+		TEST(true); // failureDetectionServer sending all current data to requester
+		if (snapshotVersion != currentVersion) {
+			snapshot = Standalone<VectorRef<SystemFailureStatus>>();
+			snapshot.reserve( snapshot.arena(), currentStatus.size() );
+			for(auto it = currentStatus.begin(); it != currentStatus.end(); ++it)
+				snapshot.push_back( snapshot.arena(), SystemFailureStatus( it->first, it->second.status ) );
+			snapshotVersion = currentVersion;
+		} else {
+			TEST(true); // failureDetectionServer reusing the current data it already sent
+		}
+		reply.allOthersFailed = true;
+		reply.changes = snapshot;
+		reply.arena = snapshot.arena();
+	} else {
+		TEST(true); // failureDetectionServer sending delta-compressed data to requester
+		// Only the last change to each address matters to the requester
+		reply.allOthersFailed = false;
+		int begin = reqVersion - currentVersion + statusHistory.size();
+		std::map<NetworkAddress, int> lastChange;
+		for(int v = begin; v < statusHistory.size(); v++)
+			lastChange[ statusHistory[v].address ] = v;
+		for(int v = begin; v < statusHistory.size(); v++) {
+			if (lastChange[ statusHistory[v].address ] == v)
+				reply.changes.push_back( reply.arena, statusHistory[v] );
+		}
+	}
+	return reply;
+}
+
+// Sends the same reply to each of the given requesters, yielding so that a large number of them doesn't make a slow task
+ACTOR static void sendFailureMonitoringReplies( std::vector<ReplyPromise<FailureMonitoringReply>> replies, FailureMonitoringReply reply ) {
+	state int i;
+	for(i = 0; i < replies.size(); i++) {
+		replies[i].send( reply );
+		Void _ = wait( yield() );
+	}
+}
+
 //The failure monitor client relies on the fact that the failure detection server will not declare itself failed
 ACTOR Future<Void> failureDetectionServer( UID uniqueID, FutureStream< FailureMonitoringRequest > requests ) {
 	state Version currentVersion = 0;
 	state std::map<NetworkAddress, FailureStatusInfo> currentStatus;	// The status at currentVersion
 	state std::deque<SystemFailureStatus> statusHistory;	// The last change in statusHistory is from currentVersion-1 to currentVersion
+	state Standalone<VectorRef<SystemFailureStatus>> snapshot;	// currentStatus as of snapshotVersion
+	state Version snapshotVersion = -1;
+	state std::vector<ReplyPromise<FailureMonitoringReply>> waitingClients;	// Clients that are up to date as of waitingVersion, answered as soon as anything changes
+	state Version waitingVersion = 0;
+	state Future<Void> releaseWaitingClients = Never();
 	state Future<Void> periodically = Void();
 	state double lastT = 0;
 
-	loop choose {
-		when ( FailureMonitoringRequest req = waitNext( requests ) ) {
-			if ( req.senderStatus.present() ) {
-				// Update the status of requester, if necessary
-				auto& address = req.reply.getEndpoint().address;
-				auto& stat = currentStatus[ address ];
-				auto& newStat = req.senderStatus.get();
-
-				ASSERT( !newStat.failed || address != g_network->getLocalAddress() );
-
-				stat.insertRequest(now());
-				if (req.senderStatus != stat.status) {
-					TraceEvent("FailureDetectionStatus", uniqueID).detail("System", address).detail("Status", newStat.failed ? "Failed" : "OK").detail("Why", "Request");
-					statusHistory.push_back( SystemFailureStatus( address, newStat ) );
-					++currentVersion;
-
-					if (req.senderStatus == FailureStatus()){
-						// failureMonitorClient reports explicitly that it is failed
-						ASSERT(false); // This can't happen at the moment; if that changes, make this a TEST instead
-						currentStatus.erase(address);
-					} else {
-						TEST(true);
-						stat.status = newStat;
-					}
+	loop {
+		choose {
+			when ( FailureMonitoringRequest req = waitNext( requests ) ) {
+				if ( req.senderStatus.present() ) {
+					// Update the status of requester, if necessary
+					auto& address = req.reply.getEndpoint().address;
+					auto& stat = currentStatus[ address ];
+					auto& newStat = req.senderStatus.get();
+
+					ASSERT( !newStat.failed || address != g_network->getLocalAddress() );
+
+					stat.insertRequest(now());
+					if (req.senderStatus != stat.status) {
+						TraceEvent("FailureDetectionStatus", uniqueID).detail("System", address).detail("Status", newStat.failed ? "Failed" : "OK").detail("Why", "Request");
+						statusHistory.push_back( SystemFailureStatus( address, newStat ) );
+						++currentVersion;
+
+						if (req.senderStatus == FailureStatus()){
+							// failureMonitorClient reports explicitly that it is failed
+							ASSERT(false); // This can't happen at the moment; if that changes, make this a TEST instead
+							currentStatus.erase(address);
+						} else {
+							TEST(true);
+							stat.status = newStat;
+						}
 
-					while (statusHistory.size() > currentStatus.size())
-						statusHistory.pop_front();
+						while (statusHistory.size() > currentStatus.size())
+							statusHistory.pop_front();
+					}
 				}
-			}
 
-			// Return delta-compressed status changes to requester
-			Version reqVersion = req.failureInformationVersion;
-			if (reqVersion > currentVersion){
-				req.reply.sendError( future_version() );
-				ASSERT(false);
-			} else {
-				TEST(true); // failureDetectionServer sending failure data to requester
-				FailureMonitoringReply reply;
-				reply.failureInformationVersion = currentVersion;
-				if( req.senderStatus.present() ) {
-					reply.clientRequestIntervalMS = FLOW_KNOBS->SERVER_REQUEST_INTERVAL * 1000;
-					reply.considerServerFailedTimeoutMS = CLIENT_KNOBS->FAILURE_TIMEOUT_DELAY * 1000;
+				// Return delta-compressed status changes to requester
+				Version reqVersion = req.failureInformationVersion;
+				double holdTime = std::min( SERVER_KNOBS->FAILURE_DETECTION_CLIENT_HOLD_TIME, CLIENT_KNOBS->CLIENT_FAILURE_TIMEOUT_DELAY / 2 );
+				if (reqVersion > currentVersion){
+					req.reply.sendError( future_version() );
+					ASSERT(false);
+				} else if (!req.senderStatus.present() && reqVersion == currentVersion && reqVersion != 0 && holdTime > 0) {
+					// A client that is already up to date waits for the next change instead of polling for it, and is answered
+					// together with every other such client
+					TEST(true); // failureDetectionServer holding a client request until there are changes
+					if (waitingClients.empty()) {
+						waitingVersion = currentVersion;
+						releaseWaitingClients = delay( holdTime );
+					}
+					waitingClients.push_back( req.reply );
 				} else {
-					reply.clientRequestIntervalMS = FLOW_KNOBS->CLIENT_REQUEST_INTERVAL * 1000;
-					reply.considerServerFailedTimeoutMS = CLIENT_KNOBS->CLIENT_FAILURE_TIMEOUT_DELAY * 1000;
+					TEST(true); // failureDetectionServer sending failure data to requester
+					req.reply.send( failureMonitoringReply( reqVersion, req.senderStatus.present(), currentVersion, currentStatus, statusHistory, snapshot, snapshotVersion ) );
 				}
-
-				ASSERT( currentVersion >= (int64_t)statusHistory.size());
-
-				if (reqVersion < currentVersion - (int64_t)statusHistory.size() || reqVersion == 0) {
-					// Send everything
-					TEST(true); // failureDetectionServer sending all current data to requester
-					reply.allOthersFailed = true;
-					for(auto it = currentStatus.begin(); it != currentStatus.end(); ++it)
-						reply.changes.push_back( reply.arena, SystemFailureStatus( it->first, it->second.status ) );
-				} else {
-					TEST(true); // failureDetectionServer sending delta-compressed data to requester
-					// SOMEDAY: Send only the last change for a given address?
-					reply.allOthersFailed = false;
-					for(int v = reqVersion - currentVersion + statusHistory.size(); v < statusHistory.size(); v++) {
-						reply.changes.push_back( reply.arena, statusHistory[v] );
+			}
+			when ( Void _ = wait( releaseWaitingClients ) ) {}
+			when ( Void _ = wait( periodically ) ) {
+				periodically = delay( FLOW_KNOBS->SERVER_REQUEST_INTERVAL );
+				double t = now();
+				if (lastT != 0 && t - lastT > 1)
+					TraceEvent("LongDelayOnClusterController").detail("Duration", t - lastT);
+				lastT = t;
+
+				// Adapt to global unresponsiveness
+				vector<double> delays;
+				for(auto it=currentStatus.begin(); it!=currentStatus.end(); it++)
+					if (it->second.penultimateRequestTime) {
+						delays.push_back(it->second.latency(t));
+						TraceEvent("FDData", uniqueID).detail("S", it->first.toString()).detail("L", it->second.latency(t));
 					}
+				int pivot = std::max(0, (int)delays.size()-2);
+				double pivotDelay = 0;
+				if (delays.size()) {
+					std::nth_element(delays.begin(), delays.begin()+pivot, delays.end());
+					pivotDelay = *(delays.begin()+pivot);
 				}
-				req.reply.send( reply );
-			}
-		}
-		when ( Void _ = wait( periodically ) ) {
-			periodically = delay( FLOW_KNOBS->SERVER_REQUEST_INTERVAL );
-			double t = now();
-			if (lastT != 0 && t - lastT > 1)
-				TraceEvent("LongDelayOnClusterController").detail("Duration", t - lastT);
-			lastT = t;
-
-			// Adapt to global unresponsiveness
-			vector<double> delays;
-			for(auto it=currentStatus.begin(); it!=currentStatus.end(); it++)
-				if (it->second.penultimateRequestTime) {
-					delays.push_back(it->second.latency(t));
-					TraceEvent("FDData", uniqueID).detail("S", it->first.toString()).detail("L", it->second.latency(t));
-				}
-			int pivot = std::max(0, (int)delays.size()-2);
-			double pivotDelay = 0;
-			if (delays.size()) {
-				std::nth_element(delays.begin(), delays.begin()+pivot, delays.end());
-				pivotDelay = *(delays.begin()+pivot);
-			}
-			pivotDelay = std::max(0.0, pivotDelay - FLOW_KNOBS->SERVER_REQUEST_INTERVAL);
-
-			TraceEvent("FailureDetectionPoll", uniqueID).detail("PivotDelay", pivotDelay).detail("Clients", currentStatus.size());
-			//TraceEvent("FailureDetectionAcceptableDelay").detail("ms", acceptableDelay*1000);
-
-			for(auto it = currentStatus.begin(); it != currentStatus.end(); ) {
-				double delay = t - it->second.lastRequestTime;
-
-				if ( it->first != g_network->getLocalAddress() && ( delay > pivotDelay * 2 + FLOW_KNOBS->SERVER_REQUEST_INTERVAL + CLIENT_KNOBS->FAILURE_MIN_DELAY || delay > CLIENT_KNOBS->FAILURE_MAX_DELAY ) ) {
-					//printf("Failure Detection Server: Status of '%s' is now '%s' after %f sec\n", it->first.toString().c_str(), "Failed", now() - it->second.lastRequestTime);
-					TraceEvent("FailureDetectionStatus", uniqueID).detail("System", it->first).detail("Status","Failed").detail("Why", "Timeout").detail("LastRequestAge", delay)
-						.detail("PivotDelay", pivotDelay);
-					statusHistory.push_back( SystemFailureStatus( it->first, FailureStatus(true) ) );
-					++currentVersion;
-					it = currentStatus.erase(it);
-					while (statusHistory.size() > currentStatus.size())
-						statusHistory.pop_front();
-				} else {
-					++it;
+				pivotDelay = std::max(0.0, pivotDelay - FLOW_KNOBS->SERVER_REQUEST_INTERVAL);
+
+				TraceEvent("FailureDetectionPoll", uniqueID).detail("PivotDelay", pivotDelay).detail("Clients", currentStatus.size());
+				//TraceEvent("FailureDetectionAcceptableDelay").detail("ms", acceptableDelay*1000);
+
+				for(auto it = currentStatus.begin(); it != currentStatus.end(); ) {
+					double delay = t - it->second.lastRequestTime;
+
+					if ( it->first != g_network->getLocalAddress() && ( delay > pivotDelay * 2 + FLOW_KNOBS->SERVER_REQUEST_INTERVAL + CLIENT_KNOBS->FAILURE_MIN_DELAY || delay > CLIENT_KNOBS->FAILURE_MAX_DELAY ) ) {
+						//printf("Failure Detection Server: Status of '%s' is now '%s' after %f sec\n", it->first.toString().c_str(), "Failed", now() - it->second.lastRequestTime);
+						TraceEvent("FailureDetectionStatus", uniqueID).detail("System", it->first).detail("Status","Failed").detail("Why", "Timeout").detail("LastRequestAge", delay)
+							.detail("PivotDelay", pivotDelay);
+						statusHistory.push_back( SystemFailureStatus( it->first, FailureStatus(true) ) );
+						++currentVersion;
+						it = currentStatus.erase(it);
+						while (statusHistory.size() > currentStatus.size())
+							statusHistory.pop_front();
+					} else {
+						++it;
+					}
 				}
 			}
 		}
+
+		if (!waitingClients.empty() && (currentVersion != waitingVersion || releaseWaitingClients.isReady())) {
+			TEST(currentVersion != waitingVersion); // failureDetectionServer sending changes to waiting clients
+			sendFailureMonitoringReplies( waitingClients, failureMonitoringReply( waitingVersion, false, currentVersion, currentStatus, statusHistory, snapshot, snapshotVersion ) );
+			waitingClients.clear();
+			releaseWaitingClients = Never();
+		}
 	}
 }
 
@@ -1494,7 +1650,7 @@ void clusterRegisterMaster( ClusterControllerData* self, RegisterMasterRequest c
 	req.reply.send( Void() );
 
 	TraceEvent("MasterRegistrationReceived", self->id).detail("dbName", printable(req.dbName)).detail("MasterId", req.id).detail("Master", req.mi.toString()).detail("Tlogs", describe(req.logSystemConfig.tLogs)).detail("Resolvers", req.resolvers.size())
-		.detail("RecoveryState", req.recoveryState).detail("RegistrationCount", req.registrationCount).detail("Proxies", req.proxies.size()).detail("RecoveryCount", req.recoveryCount);
+		.detail("RecoveryState", req.recoveryState).detail("RegistrationCount", req.registrationCount).detail("Proxies", req.proxies.size()).detail("GrvProxies", req.grvProxies.size()).detail("RecoveryCount", req.recoveryCount);
 
 	//make sure the request comes from an active database
 	auto db = &self->db;
@@ -1536,11 +1692,12 @@ void clusterRegisterMaster( ClusterControllerData* self, RegisterMasterRequest c
 	}
 
 	// Construct the client information
-	if (db->clientInfo->get().proxies != req.proxies) {
+	if (db->clientInfo->get().proxies != req.proxies || db->clientInfo->get().grvProxies != req.grvProxies) {
 		isChanged = true;
 		ClientDBInfo clientInfo;
 		clientInfo.id = g_random->randomUniqueID();
 		clientInfo.proxies = req.proxies;
+		clientInfo.grvProxies = req.grvProxies;
 		clientInfo.clientTxnInfoSampleRate = db->clientInfo->get().clientTxnInfoSampleRate;
 		clientInfo.clientTxnInfoSizeLimit = db->clientInfo->get().clientTxnInfoSizeLimit;
 		db->clientInfo->set( clientInfo );
@@ -1613,6 +1770,7 @@ void registerWorker( RegisterWorkerRequest req, ClusterControllerData *self ) {
 
 	if( info == self->id_worker.end() ) {
 		self->id_worker[w.locality.processId()] = WorkerInfo( workerAvailabilityWatch( w, newProcessClass, self ), req.reply, req.generation, w, req.initialClass, newProcessClass, newPriorityInfo );
+		self->id_worker[w.locality.processId()].capacity = req.capacity;
 		checkOutstandingRequests( self );
 		return;
 	}
@@ -1626,6 +1784,7 @@ void registerWorker( RegisterWorkerRequest req, ClusterControllerData *self ) {
 		info->second.priorityInfo = newPriorityInfo;
 		info->second.initialClass = req.initialClass;
 		info->second.gen = req.generation;
+		info->second.capacity = req.capacity;
 
 		if(info->second.interf.id() != w.id()) {
 			info->second.interf = w;
@@ -1711,6 +1870,8 @@ ACTOR Future<Void> statusServer(FutureStream< StatusRequest> requests,
 	// Place to accumulate a batch of requests to respond to
 	state std::vector<StatusRequest> requests_batch;
 
+	state ProgramStartCache programStartCache;
+
 	loop {
 		try {
 			// Wait til first request is ready
@@ -1744,7 +1905,7 @@ ACTOR Future<Void> statusServer(FutureStream< StatusRequest> requests,
 				}
 			}
 
-			ErrorOr<StatusReply> result = wait(errorOr(clusterGetStatus(self->db.serverInfo, self->cx, workers, self->db.workersWithIssues, self->db.clientsWithIssues, self->db.clientVersionMap, self->db.traceLogGroupMap, coordinators, incompatibleConnections)));
+			ErrorOr<StatusReply> result = wait(errorOr(clusterGetStatus(self->db.serverInfo, self->cx, workers, self->db.workersWithIssues, self->db.clientsWithIssues, self->db.clientVersionMap, self->db.traceLogGroupMap, coordinators, incompatibleConnections, &programStartCache)));
 			if (result.isError() && result.getError().code() == error_code_actor_cancelled)
 				throw result.getError();
 
@@ -1755,6 +1916,8 @@ ACTOR Future<Void> statusServer(FutureStream< StatusRequest> requests,
 			{
 				if (result.isError())
 					requests_batch.back().reply.sendError(result.getError());
+				else if (requests_batch.back().statusFields.size())
+					requests_batch.back().reply.send(StatusReply(selectStatusFields(result.get().statusObj, requests_batch.back().statusFields)));
 				else
 					requests_batch.back().reply.send(result.get());
 				requests_batch.pop_back();
@@ -83,6 +83,7 @@ struct RecruitFromConfigurationReply {
 	vector<WorkerInterface> tLogs;
 	vector<WorkerInterface> satelliteTLogs;
 	vector<WorkerInterface> proxies;
+	vector<WorkerInterface> grvProxies;
 	vector<WorkerInterface> resolvers;
 	vector<WorkerInterface> storageServers;
 	int logRouterCount;
@@ -91,6 +92,9 @@ struct RecruitFromConfigurationReply {
 	template <class Ar>
 	void serialize( Ar& ar ) {
 		ar & tLogs & satelliteTLogs & proxies & resolvers & storageServers & dcId & logRouterCount;
+		if( ar.protocolVersion() >= 0x0FDB00A560060001LL ) {
+			ar & grvProxies;
+		}
 	}
 };
 
@@ -155,21 +159,42 @@ struct RegisterWorkerReply {
 	}
 };
 
+// How fast a worker measured its host to be, so that recruitment can prefer the faster hosts among workers of the same
+// fitness.  Zero means not measured.
+struct HostCapacity {
+	double diskSyncLatency;  // Mean seconds to write and sync a page in the worker's data folder
+	double cpuProbeTime;  // Seconds to run a fixed amount of computation
+
+	HostCapacity() : diskSyncLatency(0), cpuProbeTime(0) {}
+
+	bool operator == ( HostCapacity const& r ) const { return diskSyncLatency == r.diskSyncLatency && cpuProbeTime == r.cpuProbeTime; }
+	bool operator != ( HostCapacity const& r ) const { return !(*this == r); }
+
+	template <class Ar>
+	void serialize( Ar& ar ) {
+		ar & diskSyncLatency & cpuProbeTime;
+	}
+};
+
 struct RegisterWorkerRequest {
 	WorkerInterface wi;
 	ProcessClass initialClass;
 	ProcessClass processClass;
 	ClusterControllerPriorityInfo priorityInfo;
 	Generation generation;
+	HostCapacity capacity;
 	ReplyPromise<RegisterWorkerReply> reply;
 
 	RegisterWorkerRequest() : priorityInfo(ProcessClass::UnsetFit, false, ClusterControllerPriorityInfo::FitnessUnknown) {}
-	RegisterWorkerRequest(WorkerInterface wi, ProcessClass initialClass, ProcessClass processClass, ClusterControllerPriorityInfo priorityInfo, Generation generation) : 
-	wi(wi), initialClass(initialClass), processClass(processClass), priorityInfo(priorityInfo), generation(generation) {}
+	RegisterWorkerRequest(WorkerInterface wi, ProcessClass initialClass, ProcessClass processClass, ClusterControllerPriorityInfo priorityInfo, Generation generation, HostCapacity capacity = HostCapacity()) : 
+	wi(wi), initialClass(initialClass), processClass(processClass), priorityInfo(priorityInfo), generation(generation), capacity(capacity) {}
 
 	template <class Ar>
 	void serialize( Ar& ar ) {
 		ar & wi & initialClass & processClass & priorityInfo & generation & reply;
+		if( ar.protocolVersion() >= 0x0FDB00A560060001LL ) {
+			ar & capacity;
+		}
 	}
 };
 
@@ -194,6 +219,7 @@ struct RegisterMasterRequest {
 	LocalityData mi;
 	LogSystemConfig logSystemConfig;
 	vector<MasterProxyInterface> proxies;
+	vector<MasterProxyInterface> grvProxies;
 	vector<ResolverInterface> resolvers;
 	DBRecoveryCount recoveryCount;
 	int64_t registrationCount;
@@ -209,14 +235,19 @@ struct RegisterMasterRequest {
 	void serialize( Ar& ar ) {
 		ASSERT( ar.protocolVersion() >= 0x0FDB00A200040001LL );
 		ar & dbName & id & mi & logSystemConfig & proxies & resolvers & recoveryCount & registrationCount & configuration & priorCommittedLogServers & recoveryState & reply;
+		if( ar.protocolVersion() >= 0x0FDB00A560060001LL ) {
+			ar & grvProxies;
+		}
 	}
 };
 
 struct GetServerDBInfoRequest {
+	// Returns when the ServerDBInfo is no longer knownServerInfoID or after a timeout, with the members that changed if
+	// the cluster controller still has the known one
 	UID knownServerInfoID;
 	Standalone<StringRef> issues;
 	std::vector<NetworkAddress> incompatiblePeers;
-	ReplyPromise< struct ServerDBInfo > reply;
+	ReplyPromise< struct ServerDBInfoUpdate > reply;
 
 	template <class Ar>
 	void serialize(Ar& ar) {
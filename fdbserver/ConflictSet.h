@@ -25,9 +25,10 @@
 #include "fdbclient/CommitTransaction.h"
 
 struct ConflictSet;
-ConflictSet* newConflictSet();
+ConflictSet* newConflictSet( int threadCount = 0 );
 void clearConflictSet( ConflictSet*, Version );
 void destroyConflictSet(ConflictSet*);
+bool pruneConflictSet( ConflictSet*, int nodeCount, int* removed );
 
 struct ConflictBatch {
 	explicit ConflictBatch( ConflictSet* );
@@ -25,6 +25,7 @@
 #include "Knobs.h"
 #include "flow/UnitTest.h"
 #include "flow/IndexedSet.h"
+#include "flow/Stats.h"
 
 // This module implements coordinationServer() and the interfaces in CoordinationInterface.h
 
@@ -122,42 +123,96 @@ private:
 	}
 };
 
-ACTOR Future<Void> localGenerationReg( GenerationRegInterface interf, OnDemandStore* pstore ) {
+// Commits the changes to the store that localGenerationReg() has made since the previous batch, once that batch is
+// durable.  Changes made before *batchOpen is cleared are part of this batch, and later ones wait for the next.
+ACTOR static Future<Void> commitGenerationRegBatch( OnDemandStore* pstore, Future<Void> previous, bool* batchOpen, Counter* commits, LatencySample* commitLatency ) {
+	Void _ = wait( previous );
+	// Let requests that arrived together join the batch
+	Void _ = wait( delay( 0, TaskCoordination ) );
+	*batchOpen = false;
+	state double start = now();
+	Void _ = wait( (*pstore)->commit() );
+	++*commits;
+	commitLatency->addMeasurement( now() - start );
+	return Void();
+}
+
+ACTOR template <class T>
+Future<Void> replyWhenDurable( ReplyPromise<T> reply, T value, Future<Void> durable, double arrivalTime, LatencySample* latency ) {
+	Void _ = wait( durable );
+	reply.send( value );
+	latency->addMeasurement( now() - arrivalTime );
+	return Void();
+}
+
+// Requests are applied to the store one at a time, but their changes are group committed: a reply is only sent once
+// every change made until then, which it may depend on, is durable, and the changes made while one commit is
+// outstanding all go into the next.  So there is at most one commit in flight, however many requests are.
+ACTOR Future<Void> localGenerationReg( GenerationRegInterface interf, OnDemandStore* pstore, UID id ) {
 	state GenerationRegVal v;
 	state OnDemandStore& store = *pstore;
+	state CounterCollection cc( "GenerationReg", id.toString() );
+	state Counter reads( "Reads", cc );
+	state Counter writes( "Writes", cc );
+	state Counter commits( "Commits", cc );
+	state LatencySample readLatency( "ReadLatency", cc );
+	state LatencySample writeLatency( "WriteLatency", cc );
+	state LatencySample commitLatency( "CommitLatency", cc );
+	state Future<Void> logger = traceCounters( "GenerationRegMetrics", id, SERVER_KNOBS->WORKER_LOGGING_INTERVAL, &cc );
+	state Future<Void> durable = Void();  // Ready once every change made so far is durable
+	state bool batchOpen = false;  // Whether durable will include changes made now
+	state ActorCollection actors( false );
+
 	// SOMEDAY: concurrent access to different keys?
 	loop choose {
 		when ( GenerationRegReadRequest _req = waitNext( interf.read.getFuture() ) ) {
 			TraceEvent("GenerationRegReadRequest").detail("From", _req.reply.getEndpoint().address).detail("K", printable(_req.key));
 			state GenerationRegReadRequest req = _req;
+			state double readStart = now();
 			Optional<Value> rawV = wait( store->readValue( req.key ) );
 			v = rawV.present() ? BinaryReader::fromStringRef<GenerationRegVal>( rawV.get(), IncludeVersion() ) : GenerationRegVal();
 			TraceEvent("GenerationRegReadReply").detail("RVSize", rawV.present() ? rawV.get().size() : -1).detail("VWG", v.writeGen.generation);
+			++reads;
 			if (v.readGen < req.gen) {
 				v.readGen = req.gen;
 				store->set( KeyValueRef( req.key, BinaryWriter::toValue(v, IncludeVersion()) ) );
-				Void _ = wait(store->commit());
+				if (!batchOpen) {
+					batchOpen = true;
+					durable = commitGenerationRegBatch( pstore, durable, &batchOpen, &commits, &commitLatency );
+					actors.add( durable );
+				} else {
+					TEST(true);  // Generation register read joined a commit batch
+				}
 			}
-			req.reply.send( GenerationRegReadReply( v.val, v.writeGen, v.readGen ) );
+			actors.add( replyWhenDurable( req.reply, GenerationRegReadReply( v.val, v.writeGen, v.readGen ), durable, readStart, &readLatency ) );
 		}
 		when ( GenerationRegWriteRequest _wrq = waitNext( interf.write.getFuture() ) ) {
 			state GenerationRegWriteRequest wrq = _wrq;
+			state double writeStart = now();
 			Optional<Value> rawV = wait( store->readValue( wrq.kv.key ) );
 			v = rawV.present() ? BinaryReader::fromStringRef<GenerationRegVal>( rawV.get(), IncludeVersion() ) : GenerationRegVal();
+			++writes;
 			if (v.readGen <= wrq.gen && v.writeGen < wrq.gen) {
 				v.writeGen = wrq.gen;
 				v.val = wrq.kv.value;
 				store->set( KeyValueRef( wrq.kv.key, BinaryWriter::toValue(v, IncludeVersion()) ) );
-				Void _ = wait(store->commit());
+				if (!batchOpen) {
+					batchOpen = true;
+					durable = commitGenerationRegBatch( pstore, durable, &batchOpen, &commits, &commitLatency );
+					actors.add( durable );
+				} else {
+					TEST(true);  // Generation register write joined a commit batch
+				}
 				TraceEvent("GenerationRegWrote").detail("From", wrq.reply.getEndpoint().address).detail("Key", printable(wrq.kv.key))
 					.detail("reqGen", wrq.gen.generation).detail("Returning", v.writeGen.generation);
-				wrq.reply.send( v.writeGen );
+				actors.add( replyWhenDurable( wrq.reply, v.writeGen, durable, writeStart, &writeLatency ) );
 			} else {
 				TraceEvent("GenerationRegWriteFail").detail("From", wrq.reply.getEndpoint().address).detail("Key", printable(wrq.kv.key))
 					.detail("reqGen", wrq.gen.generation).detail("readGen", v.readGen.generation).detail("writeGen", v.writeGen.generation);
-				wrq.reply.send( std::max( v.readGen, v.writeGen ) );
+				actors.add( replyWhenDurable( wrq.reply, std::max( v.readGen, v.writeGen ), durable, writeStart, &writeLatency ) );
 			}
 		}
+		when ( Void _ = wait( actors.getResult() ) ) { ASSERT(false); throw internal_error(); }
 	}
 };
 
@@ -165,7 +220,7 @@ TEST_CASE("fdbserver/Coordination/localGenerationReg/simple") {
 	state GenerationRegInterface reg;
 	state OnDemandStore store("simfdb/unittests/", //< FIXME
 		g_random->randomUniqueID());
-	state Future<Void> actor = localGenerationReg(reg, &store);
+	state Future<Void> actor = localGenerationReg(reg, &store, g_random->randomUniqueID());
 	state Key the_key = g_random->randomAlphaNumeric( g_random->randomInt(0, 10) );
 
 	state UniqueGeneration firstGen(0, g_random->randomUniqueID());
@@ -197,6 +252,48 @@ TEST_CASE("fdbserver/Coordination/localGenerationReg/simple") {
 	return Void();
 }
 
+TEST_CASE("fdbserver/Coordination/localGenerationReg/batch") {
+	state GenerationRegInterface reg;
+	state OnDemandStore store("simfdb/unittests/", //< FIXME
+		g_random->randomUniqueID());
+	state Future<Void> actor = localGenerationReg(reg, &store, g_random->randomUniqueID());
+	state Key the_key = g_random->randomAlphaNumeric( g_random->randomInt(0, 10) );
+
+	// Concurrent writes of one key are committed together, and the one with the highest generation wins whatever the
+	// order they are applied in
+	state std::vector<Future<UniqueGeneration>> replies;
+	state UniqueGeneration highest;
+	state int i;
+	for(i = 0; i < 10; i++) {
+		UniqueGeneration gen(g_random->randomInt(1, 5), g_random->randomUniqueID());
+		if (highest < gen)
+			highest = gen;
+		replies.push_back( reg.write.getReply(GenerationRegWriteRequest(KeyValueRef(the_key, BinaryWriter::toValue(gen, Unversioned())), gen)) );
+	}
+	Void _ = wait( waitForAll(replies) );
+	for(i = 0; i < replies.size(); i++)
+		ASSERT( !(highest < replies[i].get()) );
+
+	GenerationRegReadReply r = wait(reg.read.getReply(GenerationRegReadRequest(the_key, UniqueGeneration())));
+	ASSERT(r.gen == highest);
+	ASSERT(r.value == BinaryWriter::toValue(highest, Unversioned()));
+
+	ASSERT(!actor.isReady());
+	return Void();
+}
+
+// Tells everyone waiting on a leader register about its new nominee.  After a mass restart of clients there can be many
+// thousands of them, so the replies are sent in batches with other work let in between, rather than all in one task.
+ACTOR Future<Void> notifyNominee( vector<ReplyPromise<Optional<LeaderInfo>>> notify, Optional<LeaderInfo> nominee ) {
+	state int i = 0;
+	for(; i < notify.size(); i++) {
+		if( i && i % SERVER_KNOBS->LEADER_NOTIFY_BATCH_SIZE == 0 )
+			Void _ = wait( yield( TaskCoordination ) );
+		notify[i].send( nominee );
+	}
+	return Void();
+}
+
 // This actor implements a *single* leader-election register (essentially, it ignores
 // the .key member of each request).  It returns any time the leader election is in the
 // default state, so that only active registers consume memory.
@@ -205,6 +302,7 @@ ACTOR Future<Void> leaderRegister(LeaderElectionRegInterface interf, Key key) {
 	state std::set<LeaderInfo> availableLeaders;
 	state Optional<LeaderInfo> currentNominee;
 	state vector<ReplyPromise<Optional<LeaderInfo>>> notify;
+	state ActorCollectionNoErrors notifiers;
 	state Future<Void> nextInterval = delay( 0 );
 	state double candidateDelay = SERVER_KNOBS->CANDIDATE_MIN_DELAY;
 	state int leaderIntervalCount = 0;
@@ -241,7 +339,7 @@ ACTOR Future<Void> leaderRegister(LeaderElectionRegInterface interf, Key key) {
 			return Void();
 		}
 		when ( Void _ = wait(nextInterval) ) {
-			if (!availableLeaders.size() && !availableCandidates.size() && !notify.size() &&
+			if (!availableLeaders.size() && !availableCandidates.size() && !notify.size() && !notifiers.size() &&
 				!currentNominee.present())
 			{
 				// Our state is back to the initial state, so we can safely stop this actor
@@ -261,9 +359,9 @@ ACTOR Future<Void> leaderRegister(LeaderElectionRegInterface interf, Key key) {
 
 				if ( currentNominee.present() != nextNominee.present() || (currentNominee.present() && currentNominee.get().leaderChangeRequired(nextNominee.get())) || !availableLeaders.size() ) {
 					TraceEvent("NominatingLeader").detail("Nominee", nextNominee.present() ? nextNominee.get().changeID : UID())
-						.detail("Changed", nextNominee != currentNominee).detail("Key", printable(key));
-					for(int i=0; i<notify.size(); i++)
-						notify[i].send( nextNominee );
+						.detail("Changed", nextNominee != currentNominee).detail("Key", printable(key)).detail("Waiting", notify.size());
+					TEST( notify.size() > SERVER_KNOBS->LEADER_NOTIFY_BATCH_SIZE ); // Leader register notifying in batches
+					notifiers.add( notifyNominee( std::move(notify), nextNominee ) );
 					notify.clear();
 					currentNominee = nextNominee;
 				} else if (currentNominee.present() && nextNominee.present() && currentNominee.get().equalInternalId(nextNominee.get())) {
@@ -419,7 +517,7 @@ ACTOR Future<Void> coordinationServer(std::string dataFolder) {
 	TraceEvent("CoordinationServer", myID).detail("myInterfaceAddr", myInterface.read.getEndpoint().address).detail("Folder", dataFolder);
 
 	try {
-		Void _ = wait( localGenerationReg(myInterface, &store) || leaderServer(myLeaderInterface, &store) || store.getError() );
+		Void _ = wait( localGenerationReg(myInterface, &store, myID) || leaderServer(myLeaderInterface, &store) || store.getError() );
 		throw internal_error();
 	} catch (Error& e) {
 		TraceEvent("CoordinationServerError", myID).error(e, true);
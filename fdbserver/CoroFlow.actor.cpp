@@ -26,10 +26,22 @@
 
 
 Coro *current_coro = 0, *main_coro = 0;
-Coro* swapCoro( Coro* n ) {
-	Coro* t = current_coro;
+
+// The time the network thread spends running the coroutines of a pool is added to its busy metric whenever it switches
+// away from one, so that this share of the network thread's CPU can be told apart from that of actors
+Int64MetricHandle* current_busy = 0;  // Of the running coroutine, or null on the main coroutine
+double current_since = 0;
+
+Coro* swapCoro( Coro* n, Int64MetricHandle* busy ) {
+	double t = timer_monotonic();
+	if( current_busy )
+		*current_busy += int64_t( (t - current_since) * 1e6 );
+	current_busy = busy;
+	current_since = t;
+
+	Coro* c = current_coro;
 	current_coro = n;
-	return t;
+	return c;
 }
 
 /*struct IThreadlike {
@@ -45,7 +57,9 @@ protected:
 
 
 struct Coroutine /*: IThreadlike*/ {
-	Coroutine() {
+	Int64MetricHandle* busy;
+
+	Coroutine() : busy(nullptr) {
 		coro = Coro_new();
 		if (coro == NULL)
 			platform::outOfMemory();
@@ -56,7 +70,7 @@ struct Coroutine /*: IThreadlike*/ {
 	}
 
 	void start() {
-		int result = Coro_startCoro_( swapCoro(coro), coro, this, &entry );
+		int result = Coro_startCoro_( swapCoro(coro, busy), coro, this, &entry );
 		if (result == ENOMEM) 
 			platform::outOfMemory();
 	}
@@ -80,7 +94,7 @@ protected:
 private:
 	void wrapRun() {
 		run();
-		Coro_switchTo_( swapCoro(main_coro), main_coro );
+		Coro_switchTo_( swapCoro(main_coro, nullptr), main_coro );
 		//block();
 	}
 
@@ -103,9 +117,12 @@ class WorkPool : public IThreadPool, public ReferenceCounted<WorkPool<Threadlike
 		std::vector<Worker*> idle, workers;
 		ActorCollection anyError, allStopped;
 		Future<Void> m_holdRefUntilStopped;
+		Int64MetricHandle busyMicros;
 
-		Pool() : anyError(false), allStopped(true) {
+		Pool( std::string const& name ) : anyError(false), allStopped(true) {
 			m_holdRefUntilStopped = holdRefUntilStopped(this);
+			if( !g_network->isSimulated() )
+				busyMicros.init( LiteralStringRef("CoroThreadPool.BusyMicros"), StringRef(name) );
 		}
 
 		~Pool() {
@@ -129,6 +146,7 @@ class WorkPool : public IThreadPool, public ReferenceCounted<WorkPool<Threadlike
 		ThreadReturnPromise<Void> error;
 
 		Worker( Pool* pool,  IThreadPoolReceiver* userData ) : pool(pool), userData(userData), stop(false) {
+			Threadlike::busy = &pool->busyMicros;
 		}
 
 		virtual void run() {
@@ -194,7 +212,7 @@ class WorkPool : public IThreadPool, public ReferenceCounted<WorkPool<Threadlike
 	}
 
 public:
-	WorkPool() : pool( new Pool ) {
+	explicit WorkPool( std::string const& name ) : pool( new Pool(name) ) {
 		m_stopOnError = stopOnError( this );
 	}
 
@@ -262,7 +280,7 @@ typedef WorkPool<Coroutine, ThreadUnsafeSpinLock, true> CoroPool;
 
 
 
-ACTOR void coroSwitcher( Future<Void> what, int taskID, Coro* coro ) {
+ACTOR void coroSwitcher( Future<Void> what, int taskID, Coro* coro, Int64MetricHandle* busy ) {
 	try {
 		state double t = now();
 		Void _ = wait(what);
@@ -270,7 +288,7 @@ ACTOR void coroSwitcher( Future<Void> what, int taskID, Coro* coro ) {
 		//	TraceEvent("NonzeroWaitDuringReboot").detail("TaskID", taskID).detail("Elapsed", now()-t).backtrace("Flow");
 	} catch (Error&) {}
 	Void _ = wait( delay(0, taskID) );
-	Coro_switchTo_( swapCoro(coro), coro );
+	Coro_switchTo_( swapCoro(coro, busy), coro );
 }
 
 
@@ -280,8 +298,8 @@ void CoroThreadPool::waitFor( Future<Void> what ) {
 	if (what.isReady()) return;
 	Coro* c = current_coro;
 	double t = now();
-	coroSwitcher( what, g_network->getCurrentTask(), current_coro );
-	Coro_switchTo_( swapCoro(main_coro), main_coro );
+	coroSwitcher( what, g_network->getCurrentTask(), current_coro, current_busy );
+	Coro_switchTo_( swapCoro(main_coro, nullptr), main_coro );
 	//if (g_network->isSimulated() && g_simulator.getCurrentProcess()->rebooting && now()!=t)
 	//	TraceEvent("NonzeroWaitDuringReboot").detail("TaskID", currentTaskID).detail("Elapsed", now()-t).backtrace("Coro");
 	ASSERT( what.isReady() );
@@ -301,6 +319,6 @@ void CoroThreadPool::init()
 }
 
 
-Reference<IThreadPool> CoroThreadPool::createThreadPool() {
-	return Reference<IThreadPool>( new CoroPool );
+Reference<IThreadPool> CoroThreadPool::createThreadPool( std::string const& name ) {
+	return Reference<IThreadPool>( new CoroPool(name) );
 }
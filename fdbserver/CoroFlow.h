@@ -33,7 +33,8 @@ public:
 	static void init();
 	static void waitFor( Future<Void> what );
 
-	static Reference<IThreadPool> createThreadPool();
+	// The time each pool's coroutines run on the network thread is published as CoroThreadPool.BusyMicros with its name
+	static Reference<IThreadPool> createThreadPool( std::string const& name = "Coroutine" );
 
 protected:
 	CoroThreadPool() {}
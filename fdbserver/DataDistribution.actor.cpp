@@ -43,6 +43,7 @@ struct TCServerInfo : public ReferenceCounted<TCServerInfo> {
 	Future<Void> tracker;
 	int64_t dataInFlightToServer;
 	ErrorOr<GetPhysicalMetricsReply> serverMetrics;
+	Optional<StorageQueuingMetricsReply> queuingMetrics;
 	Promise<std::pair<StorageServerInterface, ProcessClass>> interfaceChanged;
 	Future<std::pair<StorageServerInterface, ProcessClass>> onInterfaceChanged;
 	Promise<Void> removed;
@@ -90,6 +91,28 @@ ACTOR Future<Void> updateServerMetrics( TCServerInfo *server ) {
 	}
 }
 
+// Unlike the physical metrics, the queuing metrics only steer moves away from busy servers, so a server that does not
+// answer keeps its last reply rather than holding up polling
+ACTOR Future<Void> updateServerQueuingMetrics( TCServerInfo *server ) {
+	ErrorOr<StorageQueuingMetricsReply> rep = wait( timeout( server->lastKnownInterface.getQueuingMetrics.tryGetReply( StorageQueuingMetricsRequest(), TaskDataDistributionLaunch ),
+		SERVER_KNOBS->STORAGE_METRICS_POLLING_DELAY, ErrorOr<StorageQueuingMetricsReply>( timed_out() ) ) );
+	if( rep.present() )
+		server->queuingMetrics = rep.get();
+	return Void();
+}
+
+// How close a server is to falling behind, where 1 is about where Ratekeeper would start to throttle on it.  This is
+// the largest of its storage queue relative to TARGET_BYTES_PER_STORAGE_SERVER, its durability lag beyond the MVCC window
+// relative to that window, and its CPU usage relative to DD_SERVER_CPU_TARGET.
+double getServerLoad( StorageQueuingMetricsReply const& metrics ) {
+	double queue = double( metrics.bytesInput - metrics.bytesDurable ) / SERVER_KNOBS->TARGET_BYTES_PER_STORAGE_SERVER;
+	double lag = 0;
+	if( metrics.durableVersion != invalidVersion )
+		lag = double( std::max<Version>( metrics.v - metrics.durableVersion - SERVER_KNOBS->MAX_READ_TRANSACTION_LIFE_VERSIONS, 0 ) ) / SERVER_KNOBS->MAX_READ_TRANSACTION_LIFE_VERSIONS;
+	double cpu = metrics.cpuUsage / SERVER_KNOBS->DD_SERVER_CPU_TARGET;
+	return std::max( queue, std::max( lag, cpu ) );
+}
+
 ACTOR Future<Void> updateServerMetrics( Reference<TCServerInfo> server ) {
 	Void _ = wait( updateServerMetrics( server.getPtr() ) );
 	return Void();
@@ -192,6 +215,19 @@ public:
 		return getMinFreeSpaceRatio() > SERVER_KNOBS->MIN_FREE_SPACE_RATIO && getMinFreeSpace() > SERVER_KNOBS->MIN_FREE_SPACE;
 	}
 
+	// Scales the load of a team whose busiest server is more loaded than DD_SERVER_LOAD_THRESHOLD, so that moves choose
+	// other teams before they add fetches and writes to a server that is about to fall behind
+	virtual double getServerLoadMultiplier() {
+		double maxLoad = 0;
+		for(int i=0; i<servers.size(); i++)
+			if( servers[i]->queuingMetrics.present() )
+				maxLoad = std::max( maxLoad, getServerLoad( servers[i]->queuingMetrics.get() ) );
+
+		if( maxLoad <= SERVER_KNOBS->DD_SERVER_LOAD_THRESHOLD )
+			return 1.0;
+		return 1.0 + SERVER_KNOBS->DD_SERVER_LOAD_PENALTY * ( maxLoad - SERVER_KNOBS->DD_SERVER_LOAD_THRESHOLD );
+	}
+
 	virtual Future<Void> updatePhysicalMetrics() {
 		return doUpdatePhysicalMetrics( this );
 	}
@@ -483,6 +519,15 @@ Future<Void> storageServerTracker(
 
 Future<Void> teamTracker( struct DDTeamCollection* const& self, Reference<IDataDistributionTeam> const& team );
 
+// The load by which getTeam compares teams.  A team that is to receive data is also judged by how busy its servers are,
+// but a team that is to give data away is judged only by its bytes, because moving data off a team adds reads to it.
+int64_t getTeamCost( Reference<IDataDistributionTeam> const& team, GetTeamRequest const& req ) {
+	int64_t loadBytes = team->getLoadBytes(true, req.inflightPenalty);
+	if( req.preferLowerUtilization )
+		return loadBytes * team->getServerLoadMultiplier();
+	return loadBytes;
+}
+
 struct DDTeamCollection {
 	enum { REQUESTING_WORKER = 0, GETTING_WORKER = 1, GETTING_STORAGE = 2 };
 
@@ -654,7 +699,7 @@ struct DDTeamCollection {
 								}
 
 								if( (sharedMembers == teamList[j]->serverIDs.size()) || (!foundExact && req.wantsTrueBest) ) {
-									int64_t loadBytes = SOME_SHARED * teamList[j]->getLoadBytes(true, req.inflightPenalty);
+									int64_t loadBytes = SOME_SHARED * getTeamCost( teamList[j], req );
 									if( !bestOption.present() || ( req.preferLowerUtilization && loadBytes < bestLoadBytes ) || ( !req.preferLowerUtilization && loadBytes > bestLoadBytes ) ) {
 										bestLoadBytes = loadBytes;
 										bestOption = teamList[j];
@@ -687,7 +732,7 @@ struct DDTeamCollection {
 				ASSERT( !bestOption.present() );
 				for( int i = 0; i < self->teams.size(); i++ ) {
 					if( self->teams[i]->isHealthy() && (!req.preferLowerUtilization || self->teams[i]->hasHealthyFreeSpace()) ) {
-						int64_t loadBytes = NONE_SHARED * self->teams[i]->getLoadBytes(true, req.inflightPenalty);
+						int64_t loadBytes = NONE_SHARED * getTeamCost( self->teams[i], req );
 						if( !bestOption.present() || ( req.preferLowerUtilization && loadBytes < bestLoadBytes ) || ( !req.preferLowerUtilization && loadBytes > bestLoadBytes ) ) {
 							bestLoadBytes = loadBytes;
 							bestOption = self->teams[i];
@@ -712,7 +757,7 @@ struct DDTeamCollection {
 				}
 
 				for( int i = 0; i < randomTeams.size(); i++ ) {
-					int64_t loadBytes = randomTeams[i].first * randomTeams[i].second->getLoadBytes(true, req.inflightPenalty);
+					int64_t loadBytes = randomTeams[i].first * getTeamCost( randomTeams[i].second, req );
 					if( !bestOption.present() || ( req.preferLowerUtilization && loadBytes < bestLoadBytes ) || ( !req.preferLowerUtilization && loadBytes > bestLoadBytes ) ) {
 						bestLoadBytes = loadBytes;
 						bestOption = randomTeams[i].second;
@@ -857,14 +902,16 @@ struct DDTeamCollection {
 	}
 
 	bool teamExists( vector<UID> &team ) {
-		bool exists = false;
-		for (int i=0;i<teams.size();i++){
-			if (teams[i]->getServerIDs() == team) {
-				exists = true;
-				break;
-			}
+		if (team.empty()) return false;
+
+		// Any such team is one of the teams of its first member, of which there are far fewer than of all teams
+		auto info = server_info.find(team[0]);
+		if (info == server_info.end()) return false;
+		for (auto& t : info->second->teams) {
+			if (t->getServerIDs() == team)
+				return true;
 		}
-		return exists;
+		return false;
 	}
 
 	void addTeam( std::set<UID> const& team ) {
@@ -913,6 +960,11 @@ struct DDTeamCollection {
 		//loop through remaining potential team members, add one and recursively call function
 		for(; location < processes->size(); location++) {
 			history->push_back(processes->getEntry(location));
+			// Skip every team that starts with these members if the policy can't be satisfied by any of them
+			if(history->size() < self->configuration.storageTeamSize && !self->configuration.storagePolicy->canComplete(*history, self->configuration.storageTeamSize, processes)) {
+				history->pop_back();
+				continue;
+			}
 			state int depth = history->size();
 			Void _ = wait( self->addAllTeams( self, location + 1, history, processes, output, teamLimit, addedTeams ) );
 			ASSERT( history->size() == depth); // the "stack" should be unchanged by this call
@@ -1540,7 +1592,7 @@ ACTOR Future<Void> waitServerListChange( DDTeamCollection *self, Database cx, Fu
 ACTOR Future<Void> serverMetricsPolling( TCServerInfo *server) {
 	state double lastUpdate = now();
 	loop {
-		Void _ = wait( updateServerMetrics( server ) );
+		Void _ = wait( updateServerMetrics( server ) && updateServerQueuingMetrics( server ) );
 		Void _ = wait( delayUntil( lastUpdate + SERVER_KNOBS->STORAGE_METRICS_POLLING_DELAY + SERVER_KNOBS->STORAGE_METRICS_RANDOM_DELAY * g_random->random01(), TaskDataDistributionLaunch ) );
 		lastUpdate = now();
 	}
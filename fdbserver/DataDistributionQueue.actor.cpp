@@ -178,6 +178,14 @@ public:
 		});
 	}
 
+	virtual double getServerLoadMultiplier() {
+		double result = 1.0;
+		for (auto it = teams.begin(); it != teams.end(); it++) {
+			result = std::max(result, (*it)->getServerLoadMultiplier());
+		}
+		return result;
+	}
+
 	virtual Future<Void> updatePhysicalMetrics() {
 		vector<Future<Void>> futures;
 
@@ -337,7 +345,7 @@ struct DDQueueData {
 	Reference<ShardsAffectedByTeamFailure> shardsAffectedByTeamFailure;
 	PromiseStream<Promise<int64_t>> getAverageShardBytes;
 
-	FlowLock startMoveKeysParallelismLock;
+	StartMoveKeysQueue startMoveKeysQueue;
 	FlowLock finishMoveKeysParallelismLock;
 
 	int activeRelocations;
@@ -377,7 +385,7 @@ struct DDQueueData {
 			activeRelocations( 0 ), queuedRelocations( 0 ), bytesWritten ( 0 ), teamCollections( teamCollections ),
 			shardsAffectedByTeamFailure( sABTF ), getAverageShardBytes( getAverageShardBytes ), mi( mi ), lock( lock ),
 			cx( cx ), teamSize( teamSize ), durableStorageQuorumPerTeam( durableStorageQuorumPerTeam ), input( input ),
-			getShardMetrics( getShardMetrics ), startMoveKeysParallelismLock( SERVER_KNOBS->DD_MOVE_KEYS_PARALLELISM ),
+			getShardMetrics( getShardMetrics ), startMoveKeysQueue( SERVER_KNOBS->DD_MOVE_KEYS_PARALLELISM ),
 			finishMoveKeysParallelismLock( SERVER_KNOBS->DD_MOVE_KEYS_PARALLELISM ), lastLimited(lastLimited), suppressIntervals(0), lastInterval(0) {}
 
 	void validate() {
@@ -929,7 +937,7 @@ ACTOR Future<Void> dataDistributionRelocator( DDQueueData *self, RelocateData rd
 			state Future<Void> doMoveKeys = moveKeys(
 				self->cx, rd.keys, destination.getServerIDs(), healthyDestinations.getServerIDs(), self->lock,
 				durableStorageQuorum, dataMovementComplete,
-				&self->startMoveKeysParallelismLock,
+				&self->startMoveKeysQueue,
 				&self->finishMoveKeysParallelismLock,
 				relocateShardInterval.pairID );
 			state Future<Void> pollHealth = (!anyHealthy || signalledTransferComplete) ? Never() : delay( SERVER_KNOBS->HEALTH_POLL_TIME, TaskDataDistributionLaunch );
@@ -1030,6 +1038,12 @@ ACTOR Future<bool> rebalanceTeams( DDQueueData* self, int priority, Reference<ID
 	if( sourceBytes - destBytes <= 3 * std::max<int64_t>( SERVER_KNOBS->MIN_SHARD_BYTES, metrics.bytes ) || metrics.bytes == 0 )
 		return false;
 
+	// Rebalancing can wait, so it never adds work to a server that is close to falling behind
+	if( destTeam->getServerLoadMultiplier() > 1.0 ) {
+		TEST( true ); // Rebalance skipped a busy destination
+		return false;
+	}
+
 	//verify the shard is still in sabtf
 	std::vector<KeyRange> shards = self->shardsAffectedByTeamFailure->getShardsFor( ShardsAffectedByTeamFailure::Team( sourceTeam->getServerIDs(), primary ) );
 	for( int i = 0; i < shards.size(); i++ ) {
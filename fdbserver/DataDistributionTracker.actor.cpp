@@ -41,6 +41,13 @@ BandwidthStatus getBandwidthStatus( StorageMetrics const& metrics ) {
 	return BandwidthStatusNormal;
 }
 
+// A shard whose read bandwidth is too high for one team is split, so that its pieces can be moved to other teams.
+// Splitting adds no read capacity if every piece stays on the same team, so this relies on the relocations of the
+// split pieces to spread them.
+bool isReadHot( StorageMetrics const& metrics ) {
+	return metrics.bytesReadPerKSecond > SERVER_KNOBS->SHARD_MAX_BYTES_READ_PER_KSEC;
+}
+
 ACTOR Future<Void> updateMaxShardSize( Standalone<StringRef> dbName, Reference<AsyncVar<int64_t>> dbSizeEstimate, Reference<AsyncVar<Optional<int64_t>>> maxShardSize ) {
 	state int64_t lastDbSize = 0;
 	state int64_t granularity = g_network->isSimulated() ?
@@ -78,10 +85,12 @@ struct DataDistributionTracker {
 	Promise<Void> readyToStart;
 	Reference<AsyncVar<bool>> anyZeroHealthyTeams;
 
+	int64_t readHotShardSplits;  // Splits of shards that were read hot, since this tracker started
+
 	DataDistributionTracker(Database cx, UID masterId, Promise<Void> const& readyToStart, PromiseStream<RelocateShard> const& output, Reference<AsyncVar<bool>> anyZeroHealthyTeams)
 		: cx(cx), masterId( masterId ), dbSizeEstimate( new AsyncVar<int64_t>() ),
 			maxShardSize( new AsyncVar<Optional<int64_t>>() ),
-			sizeChanges(false), readyToStart(readyToStart), output( output ), anyZeroHealthyTeams(anyZeroHealthyTeams) {}
+			sizeChanges(false), readyToStart(readyToStart), output( output ), anyZeroHealthyTeams(anyZeroHealthyTeams), readHotShardSplits(0) {}
 
 	~DataDistributionTracker()
 	{
@@ -109,6 +118,7 @@ ShardSizeBounds getShardSizeBounds(KeyRangeRef shard, int64_t maxShardSize) {
 
 	bounds.max.bytesPerKSecond = bounds.max.infinity;
 	bounds.max.iosPerKSecond = bounds.max.infinity;
+	bounds.max.bytesReadPerKSecond = bounds.max.infinity;
 
 	//The first shard can have arbitrarily small size
 	if(shard.begin == allKeys.begin) {
@@ -119,11 +129,13 @@ ShardSizeBounds getShardSizeBounds(KeyRangeRef shard, int64_t maxShardSize) {
 
 	bounds.min.bytesPerKSecond = 0;
 	bounds.min.iosPerKSecond = 0;
+	bounds.min.bytesReadPerKSecond = 0;
 
 	//The permitted error is 1/3 of the general-case minimum bytes (even in the special case where this is the last shard)
 	bounds.permittedError.bytes = bounds.max.bytes / SERVER_KNOBS->SHARD_BYTES_RATIO / 3;
 	bounds.permittedError.bytesPerKSecond = bounds.permittedError.infinity;
 	bounds.permittedError.iosPerKSecond = bounds.permittedError.infinity;
+	bounds.permittedError.bytesReadPerKSecond = bounds.permittedError.infinity;
 
 	return bounds;
 }
@@ -176,6 +188,14 @@ ACTOR Future<Void> trackShardBytes(
 					} else
 						ASSERT( false );
 
+					if( isReadHot( shardSize->get().get() ) ) {
+						bounds.max.bytesReadPerKSecond = bounds.max.infinity;
+						bounds.min.bytesReadPerKSecond = SERVER_KNOBS->SHARD_MAX_BYTES_READ_PER_KSEC;
+					} else {
+						bounds.max.bytesReadPerKSecond = SERVER_KNOBS->SHARD_MAX_BYTES_READ_PER_KSEC;
+						bounds.min.bytesReadPerKSecond = 0;
+					}
+					bounds.permittedError.bytesReadPerKSecond = SERVER_KNOBS->SHARD_MAX_BYTES_READ_PER_KSEC / 4;
 				} else {
 					bounds.max.bytes = -1;
 					bounds.min.bytes = -1;
@@ -183,6 +203,9 @@ ACTOR Future<Void> trackShardBytes(
 					bounds.max.bytesPerKSecond = bounds.max.infinity;
 					bounds.min.bytesPerKSecond = 0;
 					bounds.permittedError.bytesPerKSecond = bounds.permittedError.infinity;
+					bounds.max.bytesReadPerKSecond = bounds.max.infinity;
+					bounds.min.bytesReadPerKSecond = 0;
+					bounds.permittedError.bytesReadPerKSecond = bounds.permittedError.infinity;
 				}
 
 				bounds.max.iosPerKSecond = bounds.max.infinity;
@@ -319,6 +342,7 @@ ACTOR Future<Void> shardSplitter(
 {
 	state StorageMetrics metrics = shardSize->get().get();
 	state BandwidthStatus bandwidthStatus = getBandwidthStatus( shardSize->get().get() );
+	state bool readHot = isReadHot( metrics ) && keys.begin < keyServersKeys.begin;
 
 	//Split
 	TEST(true);  // shard to be split
@@ -327,6 +351,7 @@ ACTOR Future<Void> shardSplitter(
 	splitMetrics.bytes = shardBounds.max.bytes / 2;
 	splitMetrics.bytesPerKSecond = keys.begin >= keyServersKeys.begin ? splitMetrics.infinity : SERVER_KNOBS->SHARD_SPLIT_BYTES_PER_KSEC;
 	splitMetrics.iosPerKSecond = splitMetrics.infinity;
+	splitMetrics.bytesReadPerKSecond = keys.begin >= keyServersKeys.begin ? splitMetrics.infinity : SERVER_KNOBS->SHARD_SPLIT_BYTES_READ_PER_KSEC;
 
 	state Standalone<VectorRef<KeyRef>> splitKeys = wait( getSplitKeys(self, keys, splitMetrics, metrics ) );
 	//fprintf(stderr, "split keys:\n");
@@ -347,7 +372,20 @@ ACTOR Future<Void> shardSplitter(
 			.detail("numShards", numShards);
 	}
 
+	if( readHot ) {
+		TraceEvent("RelocateShardReadHotSplit", self->masterId)
+			.detail("Begin", printable(keys.begin))
+			.detail("End", printable(keys.end))
+			.detail("TrackerID", trackerId)
+			.detail("MetricsBytes", metrics.bytes)
+			.detail("BytesReadPerKSec", metrics.bytesReadPerKSecond)
+			.detail("NumShards", numShards);
+	}
+
 	if( numShards > 1 ) {
+		if( readHot )
+			self->readHotShardSplits++;
+
 		int skipRange = g_random->randomInt(0, numShards);
 		// The queue can't deal with RelocateShard requests which split an existing shard into three pieces, so
 		// we have to send the unskipped ranges in this order (nibbling in from the edges of the old range)
@@ -430,6 +468,7 @@ Future<Void> shardMerger(
 		auto shardBounds = getShardSizeBounds( merged, maxShardSize );
 		if( endingStats.bytes >= shardBounds.min.bytes ||
 				getBandwidthStatus( endingStats ) != BandwidthStatusLow ||
+				endingStats.bytesReadPerKSecond > SERVER_KNOBS->SHARD_SPLIT_BYTES_READ_PER_KSEC ||
 				shardsMerged >= SERVER_KNOBS->DD_MERGE_LIMIT ) {
 			// The merged range is larger than the min bounds se we cannot continue merging in this direction.
 			//  This means that:
@@ -483,9 +522,9 @@ ACTOR Future<Void> shardEvaluator(
 	StorageMetrics const& stats = shardSize->get().get();
 
 	bool shouldSplit = stats.bytes > shardBounds.max.bytes ||
-							( getBandwidthStatus( stats ) == BandwidthStatusHigh && keys.begin < keyServersKeys.begin );
+							( ( getBandwidthStatus( stats ) == BandwidthStatusHigh || isReadHot( stats ) ) && keys.begin < keyServersKeys.begin );
 	bool shouldMerge = stats.bytes < shardBounds.min.bytes &&
-							getBandwidthStatus( stats ) == BandwidthStatusLow;
+							getBandwidthStatus( stats ) == BandwidthStatusLow && !isReadHot( stats );
 
 	// Every invocation must set this or clear it
 	if(shouldMerge && !self->anyZeroHealthyTeams->get()) {
@@ -685,6 +724,7 @@ ACTOR Future<Void> dataDistributionTracker(
 				TraceEvent("DDTrackerStats", self.masterId)
 					.detail("Shards", self.shards.size())
 					.detail("TotalSizeBytes", self.dbSizeEstimate->get())
+					.detail("ReadHotShardSplits", self.readHotShardSplits)
 					.trackLatest( format("%s/DDTrackerStats", printable(cx->dbName).c_str() ).c_str() );
 
 				loggingTrigger = delay(SERVER_KNOBS->DATA_DISTRIBUTION_LOGGING_INTERVAL);
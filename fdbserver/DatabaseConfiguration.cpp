@@ -37,7 +37,7 @@ void DatabaseConfiguration::resetInternal() {
 	regions.clear();
 	tLogPolicy = storagePolicy = remoteTLogPolicy = IRepPolicyRef();
 
-	remoteDesiredTLogCount = desiredLogRouterCount = -1;
+	remoteDesiredTLogCount = desiredLogRouterCount = grvProxyCount = -1;
 	remoteTLogReplicationFactor = 0;
 }
 
@@ -142,6 +142,7 @@ bool DatabaseConfiguration::isValid() const {
 		durableStorageQuorum >= 1 &&
 		storageTeamSize >= 1 &&
 		getDesiredProxies() >= 1 &&
+		getDesiredGrvProxies() >= 0 &&
 		getDesiredLogs() >= 1 &&
 		getDesiredResolvers() >= 1 &&
 		durableStorageQuorum <= storageTeamSize &&
@@ -225,6 +226,8 @@ StatusObject DatabaseConfiguration::toJSON(bool noPolicies) const {
 			result["storage_engine"] = "ssd-2";
 		} else if( tLogDataStoreType == KeyValueStoreType::MEMORY && storageServerStoreType == KeyValueStoreType::MEMORY ) {
 			result["storage_engine"] = "memory";
+		} else if( tLogDataStoreType == KeyValueStoreType::SSD_BTREE_V2 && storageServerStoreType == KeyValueStoreType::SSD_LSM ) {
+			result["storage_engine"] = "ssd-lsm";
 		}
 
 		if( remoteTLogReplicationFactor == 0 ) {
@@ -291,6 +294,9 @@ StatusObject DatabaseConfiguration::toJSON(bool noPolicies) const {
 		if( masterProxyCount != -1 ) {
 			result["proxies"] = masterProxyCount;
 		}
+		if( grvProxyCount != -1 ) {
+			result["grv_proxies"] = grvProxyCount;
+		}
 		if( resolverCount != -1 ) {
 			result["resolvers"] = resolverCount;
 		}
@@ -324,6 +330,7 @@ bool DatabaseConfiguration::setInternal(KeyRef key, ValueRef value) {
 
 	if (ck == LiteralStringRef("initialized")) initialized = true;
 	else if (ck == LiteralStringRef("proxies")) parse(&masterProxyCount, value);
+	else if (ck == LiteralStringRef("grv_proxies")) parse(&grvProxyCount, value);
 	else if (ck == LiteralStringRef("resolvers")) parse(&resolverCount, value);
 	else if (ck == LiteralStringRef("logs")) parse(&desiredTLogCount, value);
 	else if (ck == LiteralStringRef("log_replicas")) parse(&tLogReplicationFactor, value);
@@ -142,6 +142,9 @@ struct DatabaseConfiguration {
 	int32_t masterProxyCount;
 	int32_t autoMasterProxyCount;
 
+	// GRV Proxies, which answer GetReadVersionRequests in place of the master proxies if there are any
+	int32_t grvProxyCount;
+
 	// Resolvers
 	int32_t resolverCount;
 	int32_t autoResolverCount;
@@ -174,6 +177,7 @@ struct DatabaseConfiguration {
 	std::set<AddressExclusion> getExcludedServers() const;
 
 	int32_t getDesiredProxies() const { if(masterProxyCount == -1) return autoMasterProxyCount; return masterProxyCount; }
+	int32_t getDesiredGrvProxies() const { if(grvProxyCount == -1) return 0; return grvProxyCount; }
 	int32_t getDesiredResolvers() const { if(resolverCount == -1) return autoResolverCount; return resolverCount; }
 	int32_t getDesiredLogs() const { if(desiredTLogCount == -1) return autoDesiredTLogCount; return desiredTLogCount; }
 	int32_t getDesiredRemoteLogs() const { if(remoteDesiredTLogCount == -1) return autoDesiredTLogCount; return remoteDesiredTLogCount; }
@@ -21,6 +21,7 @@
 #include "flow/actorcompiler.h"
 #include "IDiskQueue.h"
 #include "fdbrpc/IAsyncFile.h"
+#include "fdbrpc/Checksum.h"
 #include "Knobs.h"
 #include "fdbrpc/simulator.h"
 
@@ -113,8 +114,8 @@ class RawDiskQueue_TwoFiles {
 public:
 	RawDiskQueue_TwoFiles( std::string basename, UID dbgid, int64_t fileSizeWarningLimit )
 		: basename(basename), onError(delayed(error.getFuture())), onStopped(stopped.getFuture()),
-		readingFile(-1), readingPage(-1), writingPos(-1), dbgid(dbgid),
-		dbg_file0BeginSeq(0), fileExtensionBytes(10<<20), readingBuffer( dbgid ),
+		readingFile(-1), readingPage(-1), readAheadChunkSize(1<<16), writingPos(-1), dbgid(dbgid),
+		dbg_file0BeginSeq(0), fileExtensionBytes(SERVER_KNOBS->DISK_QUEUE_FILE_EXTENSION_BYTES), readingBuffer( dbgid ),
 		readyToPush(Void()), fileSizeWarningLimit(fileSizeWarningLimit), lastCommit(Void()), isFirstCommit(true)
 	{
 		if(BUGGIFY)
@@ -124,8 +125,8 @@ public:
 		stallCount.init(LiteralStringRef("RawDiskQueue.StallCount"));
 	}
 
-	Future<Void> pushAndCommit( StringRef pageData, StringBuffer* pageMem, uint64_t poppedPages ) {
-		return pushAndCommit( this, pageData, pageMem, poppedPages );
+	Future<Void> pushAndCommit( StringRef pageData, StringBuffer* pageMem, uint64_t poppedPages, int64_t pageSeq ) {
+		return pushAndCommit( this, pageData, pageMem, poppedPages, pageSeq );
 	}
 
 	void stall() {
@@ -139,11 +140,14 @@ public:
 		TraceEvent("RDQSetStart", dbgid).detail("f",file).detail("p",page).detail("file0name", files[0].dbgFilename);
 		readingFile = file;
 		readingPage = page;
+		readAhead.clear();
+		readAheadChunkSize = 1<<16;
 	}
 
 	Future<Void> setPoppedPage( int file, int64_t page, int64_t debugSeq ) { return setPoppedPage(this, file, page, debugSeq); }
 
 	Future<Standalone<StringRef>> readNextPage() { return readNextPage(this); }
+	Future<Standalone<StringRef>> readPages( int64_t seq, int pageCount ) { return readPages(this, seq, pageCount); }
 	Future<Void> truncateBeforeLastReadPage() { return truncateBeforeLastReadPage(this); }
 
 	Future<Void> getError() { return onError; }
@@ -167,10 +171,11 @@ public:
 		Reference<IAsyncFile> f;
 		int64_t size; // always a multiple of _PAGE_SIZE, even if the physical file isn't for some reason
 		int64_t popped;
+		int64_t beginSeq; // the sequence number of the page at the beginning of the file, or -1 if it isn't known
 		std::string dbgFilename;
 		Reference<SyncQueue> syncQueue;
 
-		File() : size(-1), popped(-1) {}
+		File() : size(-1), popped(-1), beginSeq(-1) {}
 
 		void setFile(Reference<IAsyncFile> f) {
 			this->f = f;
@@ -197,6 +202,17 @@ public:
 	int readingFile;  // i if the next page after readingBuffer should be read from files[i], 2 if recovery is complete
 	int64_t readingPage;  // Page within readingFile that is the next page after readingBuffer
 
+	struct ReadAheadChunk {
+		int file;
+		int64_t page;
+		int pages;
+		Future<Standalone<StringRef>> data;
+
+		ReadAheadChunk( int file, int64_t page, int pages, Future<Standalone<StringRef>> data ) : file(file), page(page), pages(pages), data(data) {}
+	};
+	std::deque<ReadAheadChunk> readAhead;  // Reads of the pages after readingBuffer, in order, which are issued ahead of readNextPage()
+	int readAheadChunkSize;  // The size of the next read issued ahead, which doubles with each read up to 1MB
+
 	int64_t writingPos;  // Position within files[1] that will be next written
 
 	int64_t fileExtensionBytes;
@@ -217,8 +233,8 @@ public:
 
 	Future<Void> truncateFile(int file, int64_t pos) { return truncateFile(this, file, pos); }
 
-	Future<Void> push(StringRef pageData, vector<Reference<SyncQueue>>& toSync) {
-		// Write the given data to the queue files, swapping or extending them if necessary.
+	Future<Void> push(StringRef pageData, int64_t pageSeq, vector<Reference<SyncQueue>>& toSync) {
+		// Write the given data, which begins with the page numbered pageSeq, to the queue files, swapping or extending them if necessary.
 		// Don't do any syncs, but push the modified file(s) onto toSync.
 		ASSERT( readingFile == 2 );
 		ASSERT( pageData.size() % _PAGE_SIZE == 0 );
@@ -238,6 +254,7 @@ public:
 						.detail("writingPos", writingPos).detail("writingBytes", p);*/
 					waitfor.push_back( files[1].f->write( pageData.begin(), p, writingPos ) );
 					pageData = pageData.substr( p );
+					pageSeq += p;
 				}
 
 				dbg_file0BeginSeq += files[0].size;
@@ -246,10 +263,15 @@ public:
 				writingPos = 0;
 			} else {
 				// Extend files[1] to accomodate the new write and about 10MB or 2x current size for future writes.
+				// A file is extended straight to DISK_QUEUE_FILE_PREALLOCATE_BYTES the first time, and since files are zeroed rather than
+				// shrunk when they are popped, the two files are then reused in turn without further changes to their size.
 				/*TraceEvent("RDQExtend", this->dbgid).detail("File1name", files[1].dbgFilename).detail("File1size", files[1].size)
 					.detail("extensionBytes", fileExtensionBytes);*/
 				int64_t minExtension = pageData.size() + writingPos - files[1].size;
 				files[1].size += std::min(std::max(fileExtensionBytes, minExtension), files[0].size+files[1].size+minExtension);
+				int64_t preallocateBytes = SERVER_KNOBS->DISK_QUEUE_FILE_PREALLOCATE_BYTES / _PAGE_SIZE * _PAGE_SIZE;
+				TEST( files[1].size < preallocateBytes ); // Disk queue file preallocated
+				files[1].size = std::max( files[1].size, preallocateBytes );
 				waitfor.push_back( files[1].f->truncate( files[1].size ) );
 
 				if(fileSizeWarningLimit > 0 && files[1].size > fileSizeWarningLimit) {
@@ -261,6 +283,7 @@ public:
 		/*TraceEvent("RDQWrite", this->dbgid).detail("File1name", files[1].dbgFilename).detail("File1size", files[1].size)
 			.detail("writingPos", writingPos).detail("writingBytes", pageData.size());*/
 		files[1].size = std::max( files[1].size, writingPos + pageData.size() );
+		files[1].beginSeq = pageSeq - writingPos;
 		toSync.push_back( files[1].syncQueue );
 		waitfor.push_back( files[1].f->write( pageData.begin(), pageData.size(), writingPos ) );
 		writingPos += pageData.size();
@@ -268,7 +291,7 @@ public:
 		return waitForAll(waitfor);
 	}
 
-	ACTOR static UNCANCELLABLE Future<Void> pushAndCommit(RawDiskQueue_TwoFiles* self, StringRef pageData, StringBuffer* pageMem, uint64_t poppedPages) {
+	ACTOR static UNCANCELLABLE Future<Void> pushAndCommit(RawDiskQueue_TwoFiles* self, StringRef pageData, StringBuffer* pageMem, uint64_t poppedPages, int64_t pageSeq) {
 		state Promise<Void> pushing, committed;
 		state Promise<Void> errorPromise = self->error;
 		state std::string filename = self->files[0].dbgFilename;
@@ -292,7 +315,7 @@ public:
 
 			TEST( pageData.size() > sizeof(Page) ); // push more than one page of data
 
-			Future<Void> pushed = self->push( pageData, syncFiles );
+			Future<Void> pushed = self->push( pageData, pageSeq, syncFiles );
 			pushing.send(Void());
 			ASSERT( syncFiles.size() >= 1 && syncFiles.size() <= 2 );
 			TEST(2==syncFiles.size());  // push spans both files
@@ -539,29 +562,44 @@ public:
 		}
 	}
 
-	Future<int> fillReadingBuffer() {
-		// If we're right at the end of a file...
-		if ( readingPage*sizeof(Page) >= (size_t)files[readingFile].size ) {
-			readingFile++;
-			readingPage = 0;
-			if (readingFile>=2) {
-				// Recovery complete
-				readingBuffer.clear();
-				writingPos = files[1].size;
-				return 0;
-			}
+	void issueReadAhead() {
+		// Keep up to DISK_QUEUE_RECOVERY_READ_AHEAD reads in flight, continuing from the last one or from the end of readingBuffer.
+		// Recovery reads the queue sequentially but often stops after a few pages, so the reads start at 64KB and double to
+		// 1MB as it goes on, instead of reading megabytes past the end of a short queue.
+		int file = readingFile;
+		int64_t page = readingPage;
+		if (readAhead.size()) {
+			file = readAhead.back().file;
+			page = readAhead.back().page + readAhead.back().pages;
 		}
 
-		// Read up to 1MB into readingBuffer
-		int len = std::min<int64_t>( (files[readingFile].size/sizeof(Page) - readingPage)*sizeof(Page), BUGGIFY_WITH_PROB(1.0) ? sizeof(Page)*g_random->randomInt(1,4) : (1<<20) );
-		readingBuffer.clear();
-		readingBuffer.alignReserve( sizeof(Page), len );
-		void* p = readingBuffer.append(len);
+		while ( readAhead.size() < SERVER_KNOBS->DISK_QUEUE_RECOVERY_READ_AHEAD ) {
+			// If we're right at the end of a file...
+			if ( page*sizeof(Page) >= (size_t)files[file].size ) {
+				file++;
+				page = 0;
+				if (file>=2) break;
+				continue;
+			}
+
+			int len = std::min<int64_t>( (files[file].size/sizeof(Page) - page)*sizeof(Page), BUGGIFY_WITH_PROB(1.0) ? sizeof(Page)*g_random->randomInt(1,4) : readAheadChunkSize );
+			readAheadChunkSize = std::min( readAheadChunkSize * 2, 1<<20 );
+			readAhead.push_back( ReadAheadChunk( file, page, len / sizeof(Page), readChunk( this, file, page * sizeof(Page), len ) ) );
+			page += len / sizeof(Page);
+		}
+	}
 
-		auto pos = readingPage * sizeof(Page);
-		readingPage += len / sizeof(Page);
+	ACTOR static UNCANCELLABLE Future<Standalone<StringRef>> readChunk(RawDiskQueue_TwoFiles* self, int file, int64_t pos, int len) {
+		state TrackMe trackMe(self);
+		state StringBuffer buffer( self->dbgid );
+		state Reference<IAsyncFile> f = self->files[file].f;  // Stays valid even if the read is abandoned by truncateBeforeLastReadPage()
+		buffer.alignReserve( sizeof(Page), len );
+		void* p = buffer.append(len);
 		ASSERT( int64_t(p) % sizeof(Page) == 0 );
-		return files[readingFile].f->read( p, len, pos );
+
+		int read = wait( f->read( p, len, pos ) );
+		ASSERT( read == len );
+		return buffer.str;
 	}
 
 	ACTOR static UNCANCELLABLE Future<Standalone<StringRef>> readNextPage(RawDiskQueue_TwoFiles* self) {
@@ -576,12 +614,25 @@ public:
 				state Future<Void> f = Void();
 				//if (BUGGIFY) f = delay( g_random->random01() * 0.1 );
 
-				int read = wait( self->fillReadingBuffer() );
-				ASSERT( read == self->readingBuffer.size() );
+				self->issueReadAhead();
+				if (!self->readAhead.size()) {
+					// Recovery complete
+					self->readingFile = 2;
+					self->readingBuffer.clear();
+					self->writingPos = self->files[1].size;
+					return Standalone<StringRef>();
+				}
+
+				Standalone<StringRef> chunk = wait( self->readAhead.front().data );
+				self->readingFile = self->readAhead.front().file;
+				self->readingPage = self->readAhead.front().page + self->readAhead.front().pages;
+				self->readingBuffer.str = chunk;
+				self->readingBuffer.reserved = chunk.size();
+				self->readAhead.pop_front();
+				self->issueReadAhead();
 
 				Void _ = wait(f);
 			}
-			if (!self->readingBuffer.size()) return Standalone<StringRef>();
 
 			ASSERT( self->readingBuffer.size() >= sizeof(Page) );
 			Standalone<StringRef> result = self->readingBuffer.pop_front( sizeof(Page) );
@@ -594,6 +645,37 @@ public:
 		}
 	}
 
+	ACTOR static UNCANCELLABLE Future<Standalone<StringRef>> readPages(RawDiskQueue_TwoFiles* self, int64_t seq, int pageCount) {
+		// Reads the pages numbered seq and after from whichever files hold them.  Pages that neither file holds are left zeroed, so they fail the caller's checks.
+		state TrackMe trackMe(self);
+		state StringBuffer result( self->dbgid );
+
+		try {
+			ASSERT( seq % sizeof(Page) == 0 && pageCount > 0 );
+			state int64_t len = int64_t(pageCount) * sizeof(Page);
+			result.alignReserve( sizeof(Page), len );
+			uint8_t* buf = (uint8_t*)result.append( len );
+			memset( buf, 0, len );
+
+			state vector<Future<int>> reads;
+			for(int i=0; i<2; i++) {
+				File& file = self->files[i];
+				if( file.beginSeq < 0 || !file.f ) continue;
+				int64_t begin = std::max( seq, file.beginSeq );
+				int64_t end = std::min( seq + len, file.beginSeq + (i == 1 && self->readingFile == 2 ? self->writingPos : file.size) );
+				if( begin < end )
+					reads.push_back( file.f->read( buf + (begin - seq), end - begin, begin - file.beginSeq ) );
+			}
+			Void _ = wait( waitForAll(reads) );
+
+			return result.str;
+		} catch (Error& e) {
+			TraceEvent(SevError, "RDQ_rp_Error", self->dbgid).detail("file0name", self->files[0].dbgFilename).error(e, true);
+			if (!self->error.isSet()) self->error.sendError(e);
+			throw;
+		}
+	}
+
 	ACTOR static UNCANCELLABLE Future<Void> truncateFile(RawDiskQueue_TwoFiles* self, int file, int64_t pos) {
 		state TrackMe trackMe(self);
 		TraceEvent("DQTruncateFile", self->dbgid).detail("File", file).detail("Pos", pos).detail("File0Name", self->files[0].dbgFilename);
@@ -616,6 +698,7 @@ public:
 
 			self->readingFile = 2;
 			self->readingBuffer.clear();
+			self->readAhead.clear();
 			self->writingPos = pos;
 
 			while (file < 2) {
@@ -726,7 +809,7 @@ public:
 			.detail("RawFile0Name", rawQueue->files[0].dbgFilename);*/
 
 		lastCommittedSeq = backPage().endSeq();
-		auto f = rawQueue->pushAndCommit( pushed_page_buffer->ref(), pushed_page_buffer, poppedSeq/sizeof(Page) - lastPoppedSeq/sizeof(Page) );
+		auto f = rawQueue->pushAndCommit( pushed_page_buffer->ref(), pushed_page_buffer, poppedSeq/sizeof(Page) - lastPoppedSeq/sizeof(Page), ((Page*)pushed_page_buffer->ref().begin())->seq );
 		lastPoppedSeq = poppedSeq;
 		pushed_page_buffer = 0;
 		return f;
@@ -735,10 +818,30 @@ public:
 		rawQueue->stall();
 	}
 
-	virtual Future<Standalone<StringRef>> readNext( int bytes ) { return readNext(this, bytes); }
+	virtual Future<Standalone<StringRef>> readNext( int bytes ) {
+		// Most reads during recovery are small and lie within the page already read, so they are copied out here rather
+		// than by an actor.  The result is a copy so that it does not keep the whole read ahead chunk in memory.
+		if (readBufPage && !recovered && foundStart.isReady() && bytes >= 0 && bytes <= readBufPage->payloadSize - readBufPos) {
+			Standalone<StringRef> result = makeString( bytes );
+			memcpy( mutateString(result), readBufPage->payload + readBufPos, bytes );
+			readBufPos += bytes;
+			nextReadLocation += bytes;
+			return result;
+		}
+		return readNext(this, bytes);
+	}
 
 	virtual location getNextReadLocation() { return nextReadLocation; }
 
+	virtual Future<Void> initializeRecovery() {
+		if (!foundStart.isValid()) foundStart = initializeRecovery(this);
+		return success(foundStart);
+	}
+
+	virtual Future<Standalone<StringRef>> read( location from, location to ) { return read(this, from, to); }
+
+	virtual location getNextPushLocation() { return endLocation(); }
+
 	virtual Future<Void> getError() { return rawQueue->getError(); }
 	virtual Future<Void> onClosed() { return rawQueue->onClosed(); }
 	virtual void dispose() {
@@ -776,17 +879,21 @@ private:
 
 		int remainingCapacity() const { return maxPayload - payloadSize; }
 		uint64_t endSeq() const { return seq + sizeof(PageHeader) + payloadSize; }
-		void updateHash() {
-			// SOMEDAY: Better hash?
+		// The second half of the hash says how the first half was computed
+		enum { HASHLITTLE2 = 0xfdb, XXHASH64 = 0x1fdb };
+
+		UID computeHash( uint64_t kind ) const {
+			if (kind == XXHASH64)
+				return UID( xxhash64( &seq, sizeof(Page)-sizeof(hash), 0x12345678beefabcdULL ), XXHASH64 );
 			uint32_t part[2] = { 0x12345678, 0xbeefabcd };
 			hashlittle2( &seq, sizeof(Page)-sizeof(hash), &part[0], &part[1] );
-			hash = UID( (int64_t(part[0])<<32)+part[1], 0xfdb );
+			return UID( (int64_t(part[0])<<32)+part[1], HASHLITTLE2 );
+		}
+		void updateHash() {
+			hash = computeHash( SERVER_KNOBS->PAGE_CHECKSUM_FORMAT >= 1 ? XXHASH64 : HASHLITTLE2 );
 		}
-		bool checkHash() {
-			UID h = hash;
-			updateHash();
-			if (h != hash) { std::swap(h, hash); return false; }
-			return true;
+		bool checkHash() const {
+			return (hash.second() == HASHLITTLE2 || hash.second() == XXHASH64) && hash == computeHash( hash.second() );
 		}
 		void zeroPad() {
 			memset( payload+payloadSize, 0, maxPayload-payloadSize );
@@ -836,6 +943,16 @@ private:
 		nextReadLocation += len;
 	}
 
+	ACTOR static Future<bool> initializeRecovery( DiskQueue *self ) {
+		bool nonempty = wait( findStart(self) );
+		if (nonempty) {
+			self->readBufPos = self->nextReadLocation % sizeof(Page) - sizeof(PageHeader);
+			if (self->readBufPos < 0) { self->nextReadLocation -= self->readBufPos; self->readBufPos = 0; }
+			TraceEvent("DQRecStart", self->dbgid).detail("readBufPos", self->readBufPos).detail("nextReadLoc", self->nextReadLocation).detail("file0name", self->rawQueue->files[0].dbgFilename);
+		}
+		return nonempty;
+	}
+
 	ACTOR static Future<Standalone<StringRef>> readNext( DiskQueue *self, int bytes ) {
 		state StringBuffer result( self->dbgid );
 		ASSERT(bytes >= 0);
@@ -843,21 +960,17 @@ private:
 
 		ASSERT( !self->recovered );
 
-		if (self->nextReadLocation < 0) {
-			bool nonempty = wait( findStart(self) );
-			if (!nonempty) {
-				// The constructor has already put everything in the right state for an empty queue
-				self->recovered = true;
-				ASSERT( self->poppedSeq <= self->endLocation() );
+		if (!self->foundStart.isValid()) self->foundStart = initializeRecovery(self);
+		bool nonempty = wait( self->foundStart );
+		if (!nonempty) {
+			// The constructor has already put everything in the right state for an empty queue
+			self->recovered = true;
+			ASSERT( self->poppedSeq <= self->endLocation() );
 
-				//The next read location isn't necessarily the end of the last commit, but this is sufficient for helping us check an ASSERTion
-				self->lastCommittedSeq = self->nextReadLocation;
+			//The next read location isn't necessarily the end of the last commit, but this is sufficient for helping us check an ASSERTion
+			self->lastCommittedSeq = self->nextReadLocation;
 
-				return Standalone<StringRef>();
-			}
-			self->readBufPos = self->nextReadLocation % sizeof(Page) - sizeof(PageHeader);
-			if (self->readBufPos < 0) { self->nextReadLocation -= self->readBufPos; self->readBufPos = 0; }
-			TraceEvent("DQRecStart", self->dbgid).detail("readBufPos", self->readBufPos).detail("nextReadLoc", self->nextReadLocation).detail("file0name", self->rawQueue->files[0].dbgFilename);
+			return Standalone<StringRef>();
 		}
 
 		loop {
@@ -916,6 +1029,39 @@ private:
 		return result.str;
 	}
 
+	ACTOR static Future<Standalone<StringRef>> read( DiskQueue *self, location from, location to ) {
+		ASSERT( !from.hi && !to.hi && from < to );
+		ASSERT( to.lo <= self->lastCommittedSeq );
+
+		// A location is either the beginning of a page or an offset past the header of the page that holds it
+		state loc_t firstPageSeq = from.lo / sizeof(Page) * sizeof(Page);
+		state loc_t lastPageSeq = (to.lo - 1) / sizeof(Page) * sizeof(Page);
+		Standalone<StringRef> pages = wait( self->rawQueue->readPages( firstPageSeq, (lastPageSeq - firstPageSeq) / sizeof(Page) + 1 ) );
+
+		int beginOffset = from.lo % sizeof(Page) ? from.lo % sizeof(Page) - sizeof(PageHeader) : 0;
+		int endOffset = to.lo % sizeof(Page) ? to.lo % sizeof(Page) - sizeof(PageHeader) : Page::maxPayload;
+
+		// Strip the page headers in place; the payloads only ever move towards the front of the buffer
+		uint8_t* out = const_cast<uint8_t*>( pages.begin() );
+		for(Page* p = (Page*)pages.begin(); p != (Page*)pages.end(); ++p) {
+			loc_t seq = firstPageSeq + ((uint8_t*)p - pages.begin());
+			if( p->seq != (uint64_t)seq || !p->checkHash() ) {
+				TEST(true); // DiskQueue read of data no longer in the queue
+				TraceEvent(SevWarn, "DQReadInvalidPage", self->dbgid).detail("Seq", seq).detail("PageSeq", p->seq).detail("From", from).detail("To", to)
+					.detail("file0name", self->rawQueue->files[0].dbgFilename);
+				throw checksum_failed();
+			}
+			int begin = seq == firstPageSeq ? beginOffset : 0;
+			int end = std::min<int>( seq == lastPageSeq ? endOffset : Page::maxPayload, p->payloadSize );
+			if( end > begin ) {
+				memmove( out, p->payload + begin, end - begin );
+				out += end - begin;
+			}
+		}
+
+		return Standalone<StringRef>( StringRef( pages.begin(), out - pages.begin() ), pages.arena() );
+	}
+
 	ACTOR static Future<bool> findStart( DiskQueue* self ) {
 		Standalone<StringRef> epbuf = wait( self->rawQueue->readFirstAndLastPages( &comparePages ) );
 		ASSERT( epbuf.size() % sizeof(Page) == 0 );
@@ -931,6 +1077,12 @@ private:
 		Page* lastPage = (Page*)epbuf.end() - 1;
 		self->nextReadLocation = self->poppedSeq = lastPage->popped;
 
+		// readFirstAndLastPages() has put the files and their first pages in the same order
+		for(int i = 0; i < 2; i++) {
+			Page* firstPage = (Page*)epbuf.begin() + i;
+			self->rawQueue->files[i].beginSeq = firstPage->checkHash() ? firstPage->seq : -1;
+		}
+
 		/*
 		state std::auto_ptr<Page> testPage(new Page);
 		state int fileNum;
@@ -1021,6 +1173,7 @@ private:
 
 	// Recovery state
 	bool recovered;
+	Future<bool> foundStart;  // From initializeRecovery(); false if the queue is empty
 	loc_t nextReadLocation;
 	Arena readBufArena;
 	Page* readBufPage;
@@ -1048,6 +1201,12 @@ public:
 
 	virtual location getNextReadLocation() { return queue->getNextReadLocation(); }
 
+	virtual Future<Void> initializeRecovery() { return queue->initializeRecovery(); }
+
+	virtual Future<Standalone<StringRef>> read( location from, location to ) { return queue->read(from, to); }
+
+	virtual location getNextPushLocation() { return queue->getNextPushLocation(); }
+
 	virtual location push( StringRef contents ) {
 		pushed = queue->push(contents);
 		return pushed;
@@ -39,12 +39,19 @@ public:
 			if (hi>r.hi) return false;
 			return lo < r.lo;
 		}
+		bool operator == (location const& r) const { return hi == r.hi && lo == r.lo; }
 	};
 
 	// Before calling push or commit, the caller *must* perform recovery by calling readNext() until it returns less than the requested number of bytes.
 	// Thereafter it may not be called again.
 	virtual Future<Standalone<StringRef>> readNext( int bytes ) = 0;  // Return the next bytes in the queue (beginning, the first time called, with the first unpopped byte)
 	virtual location getNextReadLocation() = 0;    // Returns a location >= the location of all bytes previously returned by readNext(), and <= the location of all bytes subsequently returned
+	virtual Future<Void> initializeRecovery() = 0;  // May be called before the first readNext(), after which getNextReadLocation() is the location of the first byte it will return
+
+	// Returns the bytes between two locations returned by push(), getNextPushLocation() or getNextReadLocation(), which must have been committed and not popped.
+	// Throws checksum_failed() if the bytes are no longer in the queue.
+	virtual Future<Standalone<StringRef>> read( location from, location to ) = 0;
+	virtual location getNextPushLocation() = 0;  // Returns the location at which the contents of the next push() will begin
 
 	virtual location push( StringRef contents ) = 0;  // Appends the given bytes to the byte stream.  Returns a location token representing the *end* of the contents.
 	virtual void pop( location upTo ) = 0;            // Removes all bytes before the given location token from the byte stream.
@@ -23,6 +23,7 @@
 #pragma once
 
 #include "fdbclient/FDBTypes.h"
+#include "flow/genericactors.actor.h"
 
 class IClosable {
 public:
@@ -46,10 +47,35 @@ public:
 	// Like readValue(), but returns only the first maxLength bytes of the value if it is longer
 	virtual Future<Optional<Value>> readValuePrefix( KeyRef key, int maxLength, Optional<UID> debugID = Optional<UID>() ) = 0;
 
+	// Like readValuePrefix() for each (key, maxLength) pair in keys, which should be sorted by key.  Stores that can look
+	// up many keys more cheaply together than apart override this; the keys need not outlive the call.
+	virtual Future<std::vector<Optional<Value>>> readValues( std::vector<std::pair<KeyRef, int>> const& keys, Optional<UID> debugID = Optional<UID>() ) {
+		std::vector<Future<Optional<Value>>> values;
+		values.reserve( keys.size() );
+		for(auto& k : keys)
+			values.push_back( readValuePrefix( k.first, k.second, debugID ) );
+		return getAll( values );
+	}
+
 	// If rowLimit>=0, reads first rows sorted ascending, otherwise reads last rows sorted descending
 	// The total size of the returned value (less the last entry) will be less than byteLimit
 	virtual Future<Standalone<VectorRef<KeyValueRef>>> readRange( KeyRangeRef keys, int rowLimit = 1<<30, int byteLimit = 1<<30 ) = 0;
 
+	// Like readRange(), but returns only the first maxLength bytes of each value, so maxLength==0 reads only keys.  Stores
+	// that can avoid reading the rest of the values override this, and then only what is returned counts against byteLimit.
+	virtual Future<Standalone<VectorRef<KeyValueRef>>> readRangePrefix( KeyRangeRef keys, int maxLength, int rowLimit = 1<<30, int byteLimit = 1<<30 ) {
+		return map( readRange( keys, rowLimit, byteLimit ), [maxLength]( Standalone<VectorRef<KeyValueRef>> kvs ) {
+			for(auto& kv : kvs)
+				kv.value = kv.value.substr( 0, std::min( kv.value.size(), maxLength ) );
+			return kvs;
+		} );
+	}
+
+	// Returns the key of the entry offset entries after the first one in keys if offset>=0, or -offset-1 entries before the
+	// last one otherwise.  Returns nothing if keys has too few entries, or if the store cannot find the entry without
+	// reading the ones before it, in which case the caller should fall back to readRangePrefix().
+	virtual Future<Optional<Key>> readKeyAtOffset( KeyRangeRef keys, int offset ) { return Optional<Key>(); }
+
 	//Returns the amount of free and total space for this store, in bytes
 	virtual StorageBytes getStorageBytes() = 0;
 
@@ -77,7 +103,10 @@ protected:
 
 extern IKeyValueStore* keyValueStoreSQLite( std::string const& filename, UID logID, KeyValueStoreType storeType, bool checkChecksums=false, bool checkIntegrity=false );
 extern IKeyValueStore* keyValueStoreMemory( std::string const& basename, UID logID, int64_t memoryLimit );
-extern IKeyValueStore* keyValueStoreLogSystem( class IDiskQueue* queue, UID logID, int64_t memoryLimit, bool disableSnapshot );
+extern IKeyValueStore* keyValueStoreLSM( std::string const& filename, UID logID );
+// snapshotSpeedup is the number of bytes of snapshot logged for each byte of mutations committed.  Recovery reads the log back
+// to the start of the last complete snapshot, so a higher speedup shortens what it reads, at the cost of logging more.
+extern IKeyValueStore* keyValueStoreLogSystem( class IDiskQueue* queue, UID logID, int64_t memoryLimit, bool disableSnapshot, int snapshotSpeedup = 1 );
 
 inline IKeyValueStore* openKVStore( KeyValueStoreType storeType, std::string const& filename, UID logID, int64_t memoryLimit, bool checkChecksums=false, bool checkIntegrity=false ) {
 	switch( storeType ) {
@@ -87,6 +116,8 @@ inline IKeyValueStore* openKVStore( KeyValueStoreType storeType, std::string con
 		return keyValueStoreSQLite(filename, logID, KeyValueStoreType::SSD_BTREE_V2, checkChecksums, checkIntegrity);
 	case KeyValueStoreType::MEMORY:
 		return keyValueStoreMemory( filename, logID, memoryLimit );
+	case KeyValueStoreType::SSD_LSM:
+		return keyValueStoreLSM( filename, logID );
 	default:
 		UNREACHABLE();
 	}
@@ -0,0 +1,1028 @@
+/*
+ * KeyValueStoreLSM.actor.cpp
+ *
+ * This source file is part of the FoundationDB open source project
+ *
+ * Copyright 2013-2018 Apple Inc. and the FoundationDB project authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "flow/actorcompiler.h"
+#include "IKeyValueStore.h"
+#include "IDiskQueue.h"
+#include "BloomFilter.h"
+#include "Knobs.h"
+#include "flow/ActorCollection.h"
+#include "flow/Hash3.h"
+#include "fdbrpc/IAsyncFile.h"
+#include "fdbclient/CommitTransaction.h"
+
+// A log-structured merge tree.  Committed mutations are appended to a DiskQueue and applied to an in-memory memtable.
+// Once the memtable is large enough it is frozen and written out as an immutable sorted run: blocks of key/value pairs,
+// followed by an index of the blocks, the ranges the memtable cleared, and a Bloom filter over its keys.  Reads consult
+// the memtables and then the runs from newest to oldest, and a background actor merges adjacent runs so that there are
+// never many of them.
+//
+// The list of live runs is a manifest record in the same DiskQueue, so a flush becomes durable with one DiskQueue commit,
+// after which the mutations it wrote out are popped.  Files for runs that no manifest mentions are deleted on recovery.
+
+static const uint64_t LSM_RUN_MAGIC = 0x31304d534c424446ULL;  // "FDBLSM01"
+
+// Merges range into clears, a set of disjoint ranges kept as a map from begin to end
+static void addClearRange( std::map<Key, Key>& clears, KeyRangeRef range ) {
+	Key begin = range.begin;
+	Key end = range.end;
+	auto it = clears.upper_bound( begin );
+	if( it != clears.begin() ) {
+		auto prev = it;
+		--prev;
+		if( !(prev->second < begin) ) {
+			begin = prev->first;
+			it = prev;
+		}
+	}
+	while( it != clears.end() && !(end < it->first) ) {
+		if( end < it->second )
+			end = it->second;
+		clears.erase( it++ );
+	}
+	clears[begin] = end;
+}
+
+static bool clearsCover( std::map<Key, Key> const& clears, KeyRef key ) {
+	auto it = clears.upper_bound( key );
+	if( it == clears.begin() ) return false;
+	--it;
+	return key < it->second;
+}
+
+static bool clearsCover( VectorRef<KeyRangeRef> const& clears, KeyRef key ) {
+	auto it = std::upper_bound( clears.begin(), clears.end(), key, [](KeyRef const& k, KeyRangeRef const& r) { return k < r.begin; } );
+	return it != clears.begin() && key < (it-1)->end;
+}
+
+// The mutations committed since the last flush.  A key is present if it is in sets, and otherwise is absent if clears
+// covers it; if neither, older levels decide.
+struct LSMMemtable : ReferenceCounted<LSMMemtable>, NonCopyable {
+	static const int ENTRY_OVERHEAD = 64;  // Roughly the size of a map node
+
+	std::map<Key, Value> sets;
+	std::map<Key, Key> clears;
+	int64_t bytes;
+
+	LSMMemtable() : bytes(0) {}
+
+	void set( KeyValueRef kv ) {
+		sets[kv.key] = kv.value;
+		bytes += kv.expectedSize() + ENTRY_OVERHEAD;
+	}
+
+	void clear( KeyRangeRef range ) {
+		sets.erase( sets.lower_bound( range.begin ), sets.lower_bound( range.end ) );
+		addClearRange( clears, range );
+		bytes += range.expectedSize() + ENTRY_OVERHEAD;
+	}
+
+	// Returns true if this memtable decides whether key is present, setting value if it is
+	bool find( KeyRef key, Optional<Value>& value ) const {
+		auto it = sets.find( key );
+		if( it != sets.end() ) {
+			value = it->second;
+			return true;
+		}
+		if( clearsCover( clears, key ) ) {
+			value = Optional<Value>();
+			return true;
+		}
+		return false;
+	}
+
+	bool hides( KeyRef key ) const { return sets.count( key ) || clearsCover( clears, key ); }
+
+	// Copies the sets in range that a read limited to rowLimit rows and byteLimit bytes could return, in key order.  Sets
+	// hidden by the newer memtable are skipped, so that what is copied is exactly what the read can return.
+	Standalone<VectorRef<KeyValueRef>> snapshotSets( KeyRangeRef range, bool forward, int rowLimit, int byteLimit, LSMMemtable const* newer ) const {
+		Standalone<VectorRef<KeyValueRef>> result;
+		auto begin = sets.lower_bound( range.begin );
+		auto end = sets.lower_bound( range.end );
+		if( forward ) {
+			for(auto it = begin; it != end && rowLimit && byteLimit >= 0; ++it) {
+				if( newer && newer->hides( it->first ) ) continue;
+				byteLimit -= sizeof(KeyValueRef) + it->first.size() + it->second.size();
+				result.push_back_deep( result.arena(), KeyValueRef( it->first, it->second ) );
+				--rowLimit;
+			}
+		} else {
+			for(auto it = end; it != begin && rowLimit && byteLimit >= 0; ) {
+				--it;
+				if( newer && newer->hides( it->first ) ) continue;
+				byteLimit -= sizeof(KeyValueRef) + it->first.size() + it->second.size();
+				result.push_back_deep( result.arena(), KeyValueRef( it->first, it->second ) );
+				--rowLimit;
+			}
+			std::reverse( result.begin(), result.end() );
+		}
+		return result;
+	}
+
+	Standalone<VectorRef<KeyRangeRef>> snapshotClears( KeyRangeRef range ) const {
+		Standalone<VectorRef<KeyRangeRef>> result;
+		auto it = clears.upper_bound( range.begin );
+		if( it != clears.begin() ) --it;
+		for(; it != clears.end() && it->first < range.end; ++it) {
+			if( range.begin < it->second )
+				result.push_back_deep( result.arena(), KeyRangeRef( it->first, it->second ) );
+		}
+		return result;
+	}
+};
+
+struct LSMBlockInfo {
+	KeyRef firstKey, lastKey;
+	int64_t offset;
+	int size;
+	uint32_t checksum;
+
+	LSMBlockInfo() : offset(0), size(0), checksum(0) {}
+	LSMBlockInfo( Arena& a, LSMBlockInfo const& b ) : firstKey(a, b.firstKey), lastKey(a, b.lastKey), offset(b.offset), size(b.size), checksum(b.checksum) {}
+
+	int expectedSize() const { return firstKey.expectedSize() + lastKey.expectedSize(); }
+
+	template <class Ar>
+	void serialize( Ar& ar ) {
+		ar & firstKey & lastKey & offset & size & checksum;
+	}
+};
+
+// The last bytes of a run file, locating its metadata (block index, clears and Bloom filter)
+struct LSMRunTrailer {
+	int64_t metaOffset;
+	int32_t metaSize;
+	uint32_t metaChecksum;
+	uint64_t magic;
+};
+
+// An immutable sorted run.  Only the metadata is kept in memory; blocks are read from the file as needed.
+struct LSMRun : ReferenceCounted<LSMRun>, NonCopyable {
+	int64_t id;
+	std::string filename;
+	Reference<IAsyncFile> file;
+	int64_t fileBytes;
+	int64_t keyCount;
+	Arena arena;
+	VectorRef<LSMBlockInfo> blocks;
+	VectorRef<KeyRangeRef> clears;
+	BloomFilter filter;
+
+	LSMRun( int64_t id, std::string const& filename, Reference<IAsyncFile> const& file ) : id(id), filename(filename), file(file), fileBytes(0), keyCount(0) {}
+
+	// Returns the block that would contain key, or -1 if no block would
+	int findBlock( KeyRef key ) const {
+		auto it = std::lower_bound( blocks.begin(), blocks.end(), key, [](LSMBlockInfo const& b, KeyRef const& k) { return b.lastKey < k; } );
+		if( it == blocks.end() || key < it->firstKey ) return -1;
+		return it - blocks.begin();
+	}
+
+	bool mayContain( KeyRef key, BloomFilter::Hash hash ) const {
+		return filter.mayContain( hash ) && findBlock( key ) >= 0;
+	}
+
+	bool covers( KeyRef key ) const { return clearsCover( clears, key ); }
+
+	Future<Standalone<VectorRef<KeyValueRef>>> readBlock( int block ) {
+		return readBlock_impl( Reference<LSMRun>::addRef( this ), block );
+	}
+
+	ACTOR static Future<Standalone<VectorRef<KeyValueRef>>> readBlock_impl( Reference<LSMRun> self, int block ) {
+		state LSMBlockInfo info = self->blocks[block];
+		state Standalone<StringRef> buf = makeString( info.size );
+		int bytesRead = wait( self->file->read( mutateString( buf ), info.size, info.offset ) );
+		if( bytesRead != info.size || hashlittle( buf.begin(), buf.size(), 0 ) != info.checksum ) {
+			TraceEvent(SevError, "KVSLSMBlockChecksumFailed").detail("Filename", self->filename).detail("Offset", info.offset).detail("Size", info.size);
+			throw checksum_failed();
+		}
+		VectorRef<KeyValueRef> kvs;
+		ArenaReader reader( buf.arena(), buf, Unversioned() );
+		reader >> kvs;
+		return Standalone<VectorRef<KeyValueRef>>( kvs, reader.arena() );
+	}
+
+	ACTOR static Future<Reference<LSMRun>> open( std::string filename, int64_t id ) {
+		state Reference<IAsyncFile> file = wait( IAsyncFileSystem::filesystem()->open( filename, IAsyncFile::OPEN_NO_AIO | IAsyncFile::OPEN_UNCACHED | IAsyncFile::OPEN_READONLY, 0 ) );
+		state int64_t size = wait( file->size() );
+		state Standalone<StringRef> buf = makeString( sizeof(LSMRunTrailer) );
+		state LSMRunTrailer trailer;
+		if( size < (int64_t)sizeof(LSMRunTrailer) ) {
+			TraceEvent(SevError, "KVSLSMRunCorrupt").detail("Filename", filename).detail("FileSize", size);
+			throw file_corrupt();
+		}
+
+		int trailerRead = wait( file->read( mutateString( buf ), buf.size(), size - buf.size() ) );
+		memcpy( &trailer, buf.begin(), sizeof(trailer) );
+		if( trailerRead != buf.size() || trailer.magic != LSM_RUN_MAGIC || trailer.metaOffset + trailer.metaSize + (int64_t)sizeof(LSMRunTrailer) != size ) {
+			TraceEvent(SevError, "KVSLSMRunCorrupt").detail("Filename", filename).detail("FileSize", size);
+			throw file_corrupt();
+		}
+
+		buf = makeString( trailer.metaSize );
+		int metaRead = wait( file->read( mutateString( buf ), buf.size(), trailer.metaOffset ) );
+		if( metaRead != buf.size() || hashlittle( buf.begin(), buf.size(), 0 ) != trailer.metaChecksum ) {
+			TraceEvent(SevError, "KVSLSMRunChecksumFailed").detail("Filename", filename).detail("Offset", trailer.metaOffset);
+			throw checksum_failed();
+		}
+
+		Reference<LSMRun> run( new LSMRun( id, filename, file ) );
+		ArenaReader reader( buf.arena(), buf, IncludeVersion() );
+		reader >> run->blocks >> run->clears >> run->filter >> run->keyCount;
+		run->arena = reader.arena();
+		run->fileBytes = size;
+		return run;
+	}
+};
+
+// Writes a new run file from key/value pairs added in key order
+struct LSMRunWriter {
+	Reference<LSMRun> run;
+	Arena blockArena;
+	VectorRef<KeyValueRef> block;
+	int64_t blockBytes;
+	int64_t offset;
+
+	LSMRunWriter() : blockBytes(0), offset(0) {}
+
+	Future<Void> add( KeyValueRef kv ) {
+		block.push_back_deep( blockArena, kv );
+		blockBytes += kv.expectedSize() + 2 * sizeof(int);
+		run->filter.add( BloomFilter::hash( kv.key ) );
+		run->keyCount++;
+		if( blockBytes >= SERVER_KNOBS->LSM_BLOCK_BYTES )
+			return writeBlock();
+		return Void();
+	}
+
+	void addClear( KeyRangeRef range ) {
+		run->clears.push_back_deep( run->arena, range );
+	}
+
+	Future<Void> writeBlock() {
+		if( !block.size() )
+			return Void();
+
+		Standalone<StringRef> data = BinaryWriter::toValue( block, Unversioned() );
+		LSMBlockInfo info;
+		info.firstKey = block.front().key;
+		info.lastKey = block.back().key;
+		info.offset = offset;
+		info.size = data.size();
+		info.checksum = hashlittle( data.begin(), data.size(), 0 );
+		run->blocks.push_back_deep( run->arena, info );
+
+		Future<Void> written = writeBytes( run->file, data, offset );
+		offset += data.size();
+		block = VectorRef<KeyValueRef>();
+		blockArena = Arena();
+		blockBytes = 0;
+		return written;
+	}
+
+	ACTOR static Future<Void> writeBytes( Reference<IAsyncFile> file, Standalone<StringRef> data, int64_t offset ) {
+		Void _ = wait( file->write( data.begin(), data.size(), offset ) );
+		return Void();
+	}
+
+	ACTOR static Future<Void> open( LSMRunWriter* self, int64_t id, std::string filename, int64_t expectedKeys ) {
+		state Reference<IAsyncFile> file = wait( IAsyncFileSystem::filesystem()->open( filename,
+			IAsyncFile::OPEN_NO_AIO | IAsyncFile::OPEN_UNCACHED | IAsyncFile::OPEN_ATOMIC_WRITE_AND_CREATE | IAsyncFile::OPEN_CREATE | IAsyncFile::OPEN_READWRITE, 0600 ) );
+		self->run = Reference<LSMRun>( new LSMRun( id, filename, file ) );
+		self->run->filter = BloomFilter( expectedKeys, SERVER_KNOBS->LSM_BLOOM_BITS_PER_KEY );
+		return Void();
+	}
+
+	// Writes the metadata and makes the file durable under its final name
+	ACTOR static Future<Reference<LSMRun>> finish( LSMRunWriter* self ) {
+		state Standalone<StringRef> meta;
+		state Standalone<StringRef> trailerBytes;
+
+		Void _ = wait( self->writeBlock() );
+
+		BinaryWriter wr( IncludeVersion() );
+		wr << self->run->blocks << self->run->clears << self->run->filter << self->run->keyCount;
+		meta = Standalone<StringRef>( wr.toStringRef() );
+
+		LSMRunTrailer trailer;
+		trailer.metaOffset = self->offset;
+		trailer.metaSize = meta.size();
+		trailer.metaChecksum = hashlittle( meta.begin(), meta.size(), 0 );
+		trailer.magic = LSM_RUN_MAGIC;
+		trailerBytes = Standalone<StringRef>( StringRef( (const uint8_t*)&trailer, sizeof(trailer) ) );
+
+		Void _ = wait( writeBytes( self->run->file, meta, self->offset ) && writeBytes( self->run->file, trailerBytes, self->offset + meta.size() ) );
+		Void _ = wait( self->run->file->sync() );
+		self->run->fileBytes = self->offset + meta.size() + trailerBytes.size();
+		return self->run;
+	}
+};
+
+// Iterates in one direction over the sets within a range of one level of the tree: a snapshot of a memtable, or a run
+// whose blocks are read as they are reached.  clears are the level's clears, which hide the sets of older levels.
+struct LSMCursor {
+	Reference<LSMRun> run;
+	Standalone<VectorRef<KeyValueRef>> kvs;  // The memtable snapshot, or the current block of the run
+	Standalone<VectorRef<KeyRangeRef>> clears;
+	KeyRange range;
+	bool forward;
+	int block;
+	int index;
+
+	LSMCursor( Standalone<VectorRef<KeyValueRef>> const& kvs, Standalone<VectorRef<KeyRangeRef>> const& clears, KeyRangeRef range, bool forward )
+		: kvs(kvs), clears(clears), range(range), forward(forward), block(-1), index(-1) {}
+	LSMCursor( Reference<LSMRun> const& run, KeyRangeRef range, bool forward )
+		: run(run), clears(run->clears, run->arena), range(range), forward(forward), block(-1), index(-1) {}
+
+	bool valid() const { return index >= 0 && index < kvs.size(); }
+	KeyValueRef const& get() const { return kvs[index]; }
+
+	Future<Void> seek() {
+		if( !run ) {
+			index = forward ? 0 : kvs.size() - 1;
+			return Void();
+		}
+		VectorRef<LSMBlockInfo> const& blocks = run->blocks;
+		if( forward ) {
+			block = std::lower_bound( blocks.begin(), blocks.end(), range.begin, [](LSMBlockInfo const& b, KeyRef const& k) { return b.lastKey < k; } ) - blocks.begin();
+			if( block < blocks.size() && blocks[block].firstKey < range.end )
+				return loadBlock( this, true );
+		} else {
+			block = std::lower_bound( blocks.begin(), blocks.end(), range.end, [](LSMBlockInfo const& b, KeyRef const& k) { return b.firstKey < k; } ) - blocks.begin() - 1;
+			if( block >= 0 && !(blocks[block].lastKey < range.begin) )
+				return loadBlock( this, true );
+		}
+		return Void();
+	}
+
+	Future<Void> next() {
+		index += forward ? 1 : -1;
+		if( valid() ) {
+			checkRange();
+			return Void();
+		}
+		index = -1;
+		if( run ) {
+			block += forward ? 1 : -1;
+			if( block >= 0 && block < run->blocks.size() &&
+				( forward ? run->blocks[block].firstKey < range.end : !(run->blocks[block].lastKey < range.begin) ) )
+				return loadBlock( this, false );
+		}
+		return Void();
+	}
+
+	void checkRange() {
+		if( valid() && !range.contains( kvs[index].key ) )
+			index = -1;
+	}
+
+	ACTOR static Future<Void> loadBlock( LSMCursor* self, bool seeking ) {
+		Standalone<VectorRef<KeyValueRef>> kvs = wait( self->run->readBlock( self->block ) );
+		self->kvs = kvs;
+		if( seeking ) {
+			KeyRef key = self->forward ? self->range.begin : self->range.end;
+			self->index = std::lower_bound( kvs.begin(), kvs.end(), key, KeyValueRef::OrderByKey() ) - kvs.begin() - ( self->forward ? 0 : 1 );
+		} else {
+			self->index = self->forward ? 0 : kvs.size() - 1;
+		}
+		self->checkRange();
+		return Void();
+	}
+};
+
+// Returns the cursor whose current key comes first in the cursors' direction, preferring newer levels on ties
+static int nextCursor( std::vector<LSMCursor> const& cursors, bool forward ) {
+	int next = -1;
+	for(int c = 0; c < cursors.size(); c++) {
+		if( cursors[c].valid() && ( next < 0 || ( forward ? cursors[c].get().key < cursors[next].get().key : cursors[next].get().key < cursors[c].get().key ) ) )
+			next = c;
+	}
+	return next;
+}
+
+// A set at the given level is visible unless a newer level cleared it
+static bool isVisible( std::vector<LSMCursor> const& cursors, int level, KeyRef key ) {
+	for(int c = 0; c < level; c++) {
+		if( clearsCover( cursors[c].clears, key ) )
+			return false;
+	}
+	return true;
+}
+
+// Moves every cursor positioned at key past it
+static std::vector<Future<Void>> advanceCursors( std::vector<LSMCursor>& cursors, KeyRef key ) {
+	std::vector<Future<Void>> moves;
+	for(auto& c : cursors) {
+		if( c.valid() && c.get().key == key )
+			moves.push_back( c.next() );
+	}
+	return moves;
+}
+
+ACTOR static Future<Standalone<VectorRef<KeyValueRef>>> readRangeFromLevels( std::vector<LSMCursor> cursors, bool forward, int rowLimit, int byteLimit ) {
+	state Standalone<VectorRef<KeyValueRef>> result;
+	state Key key;
+	state std::vector<Future<Void>> moves;
+
+	for(auto& c : cursors)
+		moves.push_back( c.seek() );
+	Void _ = wait( waitForAll( moves ) );
+
+	loop {
+		int next = nextCursor( cursors, forward );
+		if( next < 0 || !rowLimit || byteLimit < 0 )
+			break;
+
+		KeyValueRef kv = cursors[next].get();
+		if( isVisible( cursors, next, kv.key ) ) {
+			byteLimit -= sizeof(KeyValueRef) + kv.key.size() + kv.value.size();
+			result.push_back_deep( result.arena(), kv );
+			--rowLimit;
+		}
+		key = kv.key;
+		moves = advanceCursors( cursors, key );
+		Void _ = wait( waitForAll( moves ) );
+	}
+	return result;
+}
+
+ACTOR static Future<Optional<Value>> readValueFromRuns( std::vector<Reference<LSMRun>> runs, Key key, int maxLength ) {
+	state BloomFilter::Hash hash = BloomFilter::hash( key );
+	state int r = 0;
+	for(; r < runs.size(); r++) {
+		if( runs[r]->mayContain( key, hash ) ) {
+			Standalone<VectorRef<KeyValueRef>> kvs = wait( runs[r]->readBlock( runs[r]->findBlock( key ) ) );
+			auto it = std::lower_bound( kvs.begin(), kvs.end(), key, KeyValueRef::OrderByKey() );
+			if( it != kvs.end() && it->key == key )
+				return Value( it->value.substr( 0, std::min( maxLength, it->value.size() ) ) );
+		}
+		if( runs[r]->covers( key ) )
+			return Optional<Value>();
+	}
+	return Optional<Value>();
+}
+
+struct LSMManifest {
+	int64_t nextRunId;
+	std::vector<int64_t> runIds;  // Newest first
+
+	LSMManifest() : nextRunId(0) {}
+
+	template <class Ar>
+	void serialize( Ar& ar ) {
+		ar & nextRunId & runIds;
+	}
+};
+
+class KeyValueStoreLSM : public IKeyValueStore, NonCopyable {
+public:
+	KeyValueStoreLSM( std::string const& filename, UID id );
+
+	// IClosable
+	virtual Future<Void> getError() { return log->getError() || background; }
+	virtual Future<Void> onClosed() { return stopped.getFuture(); }
+	virtual void dispose() { doClose( this, true ); }
+	virtual void close() { doClose( this, false ); }
+
+	// IKeyValueStore
+	virtual KeyValueStoreType getType() { return KeyValueStoreType::SSD_LSM; }
+
+	virtual StorageBytes getStorageBytes() {
+		int64_t free;
+		int64_t total;
+		g_network->getDiskBytes( parentDirectory( filename ), free, total );
+
+		int64_t used = log->getStorageBytes().used;
+		for(auto& r : runs)
+			used += r->fileBytes;
+		for(auto& r : obsoleteRuns)
+			used += r->fileBytes;
+
+		return StorageBytes( free, total, used, free );
+	}
+
+	virtual void set( KeyValueRef keyValue, const Arena* arena ) {
+		uncommitted.push_back_deep( uncommitted.arena(), MutationRef( MutationRef::SetValue, keyValue.key, keyValue.value ) );
+	}
+
+	virtual void clear( KeyRangeRef range, const Arena* arena ) {
+		uncommitted.push_back_deep( uncommitted.arena(), MutationRef( MutationRef::ClearRange, range.begin, range.end ) );
+	}
+
+	virtual Future<Void> commit( bool sequential ) {
+		if(recovering.isError()) throw recovering.getError();
+		if(!recovering.isReady())
+			return waitAndCommit(this, sequential);
+
+		//If there have been no mutations since the last commit, do nothing
+		if( !uncommitted.size() )
+			return Void();
+
+		for(auto& m : uncommitted) {
+			log_op( m.type == MutationRef::SetValue ? OpSet : OpClear, m.param1, m.param2 );
+		}
+		applyMutations( uncommitted );
+		uncommitted = Standalone<VectorRef<MutationRef>>();
+
+		IDiskQueue::location committedLocation = log_op( OpCommit, StringRef(), StringRef() );
+		Future<Void> c = log->commit();
+
+		if( active->bytes >= SERVER_KNOBS->LSM_MEMTABLE_BYTES ) {
+			if( flushing.isReady() ) {
+				frozen = active;
+				active = Reference<LSMMemtable>( new LSMMemtable );
+				flushing = flush( this, c, committedLocation );
+				addActor.send( flushing );
+			} else if( active->bytes >= 2 * SERVER_KNOBS->LSM_MEMTABLE_BYTES ) {
+				TEST( true );  // KeyValueStoreLSM commit waiting for memtable flush
+				return c && flushing;
+			}
+		}
+		return c;
+	}
+
+	virtual Future<Optional<Value>> readValue( KeyRef key, Optional<UID> debugID = Optional<UID>() ) {
+		return readValuePrefix( key, 1<<30, debugID );
+	}
+
+	virtual Future<Optional<Value>> readValuePrefix( KeyRef key, int maxLength, Optional<UID> debugID = Optional<UID>() ) {
+		if(recovering.isError()) throw recovering.getError();
+		if(!recovering.isReady()) return waitAndReadValuePrefix(this, key, maxLength);
+
+		Optional<Value> value;
+		if( active->find( key, value ) || ( frozen && frozen->find( key, value ) ) ) {
+			if( value.present() && maxLength < value.get().size() )
+				return Optional<Value>( Value( value.get().substr( 0, maxLength ), value.get().arena() ) );
+			return value;
+		}
+
+		BloomFilter::Hash hash = BloomFilter::hash( key );
+		for(int r = 0; r < runs.size(); r++) {
+			if( runs[r]->mayContain( key, hash ) )
+				return readValueFromRuns( std::vector<Reference<LSMRun>>( runs.begin() + r, runs.end() ), key, maxLength );
+			if( runs[r]->covers( key ) )
+				break;
+		}
+		return Optional<Value>();
+	}
+
+	// If rowLimit>=0, reads first rows sorted ascending, otherwise reads last rows sorted descending
+	// The total size of the returned value (less the last entry) will be less than byteLimit
+	virtual Future<Standalone<VectorRef<KeyValueRef>>> readRange( KeyRangeRef keys, int rowLimit = 1<<30, int byteLimit = 1<<30 ) {
+		if(recovering.isError()) throw recovering.getError();
+		if(!recovering.isReady()) return waitAndReadRange(this, keys, rowLimit, byteLimit);
+
+		bool forward = rowLimit >= 0;
+		int rows = forward ? rowLimit : -rowLimit;
+
+		// The memtables may change while the runs are read, so what the read needs of them is copied now
+		std::vector<LSMCursor> cursors;
+		cursors.push_back( LSMCursor( active->snapshotSets( keys, forward, rows, byteLimit, NULL ), active->snapshotClears( keys ), keys, forward ) );
+		if( frozen )
+			cursors.push_back( LSMCursor( frozen->snapshotSets( keys, forward, rows, byteLimit, active.getPtr() ), frozen->snapshotClears( keys ), keys, forward ) );
+		for(auto& r : runs)
+			cursors.push_back( LSMCursor( r, keys, forward ) );
+
+		return readRangeFromLevels( cursors, forward, rows, byteLimit );
+	}
+
+private:
+	enum OpType {
+		OpSet,
+		OpClear,
+		OpCommit,
+		OpRollback,
+		OpManifest
+	};
+
+	struct OpHeader {
+		int op;
+		int len1, len2;
+	};
+
+	std::string filename;
+	UID id;
+	IDiskQueue* log;
+
+	Standalone<VectorRef<MutationRef>> uncommitted;
+	Reference<LSMMemtable> active;
+	Reference<LSMMemtable> frozen;  // Being written out as the newest run
+	std::vector<Reference<LSMRun>> runs;  // Newest first
+	std::vector<Reference<LSMRun>> obsoleteRuns;  // Compacted away, to be deleted once no read is using them
+	int64_t nextRunId;
+
+	Future<Void> recovering;
+	Future<Void> flushing;
+	PromiseStream<Future<Void>> addActor;
+	Future<Void> background;
+	AsyncTrigger compactionNeeded;
+	AsyncTrigger compactionDone;
+	Promise<Void> stopped;
+
+	std::string runFilename( int64_t runId ) const {
+		return filename + format( "-run-%lld", (long long)runId );
+	}
+
+	IDiskQueue::location log_op( OpType op, StringRef v1, StringRef v2 ) {
+		OpHeader h = {(int)op, v1.size(), v2.size()};
+		log->push( StringRef((const uint8_t*)&h, sizeof(h)) );
+		log->push( v1 );
+		log->push( v2 );
+		return log->push( LiteralStringRef("\x01") );
+	}
+
+	// Records the current list of runs; it takes effect when the log next commits
+	void logManifest() {
+		LSMManifest manifest;
+		manifest.nextRunId = nextRunId;
+		for(auto& r : runs)
+			manifest.runIds.push_back( r->id );
+		log_op( OpManifest, BinaryWriter::toValue( manifest, IncludeVersion() ), StringRef() );
+	}
+
+	void applyMutations( VectorRef<MutationRef> const& mutations ) {
+		for(auto& m : mutations) {
+			if( m.type == MutationRef::SetValue )
+				active->set( KeyValueRef( m.param1, m.param2 ) );
+			else
+				active->clear( KeyRangeRef( m.param1, m.param2 ) );
+		}
+	}
+
+	ACTOR static Future<Void> recover( KeyValueStoreLSM* self ) {
+		state Standalone<VectorRef<MutationRef>> recoveryOps;  // Since the last OpCommit
+		state Optional<LSMManifest> manifest;
+		state int zeroFillSize = 0;
+		state int dbgMutationCount = 0;
+		state int dbgCommitCount = 0;
+		state double startt = now();
+		state OpHeader h;
+		state int r;
+
+		TraceEvent("KVSLSMRecoveryStarted", self->id).detail("Filename", self->filename);
+
+		loop {
+			Standalone<StringRef> data = wait( self->log->readNext( sizeof(OpHeader) ) );
+			if (data.size() != sizeof(OpHeader)) {
+				if (data.size()) {
+					TEST(true);  // zero fill partial header in KeyValueStoreLSM
+					memset(&h, 0, sizeof(OpHeader));
+					memcpy(&h, data.begin(), data.size());
+					zeroFillSize = sizeof(OpHeader)-data.size() + h.len1 + h.len2 + 1;
+				}
+				break;
+			}
+			h = *(OpHeader*)data.begin();
+			Standalone<StringRef> data = wait( self->log->readNext( h.len1 + h.len2+1 ) );
+			if (data.size() != h.len1 + h.len2 + 1) {
+				zeroFillSize = h.len1 + h.len2 + 1 - data.size();
+				break;
+			}
+
+			if (data[data.size()-1]) {
+				StringRef p1 = data.substr(0, h.len1);
+				StringRef p2 = data.substr(h.len1, h.len2);
+
+				if (h.op == OpSet) {
+					recoveryOps.push_back_deep( recoveryOps.arena(), MutationRef( MutationRef::SetValue, p1, p2 ) );
+					++dbgMutationCount;
+				} else if (h.op == OpClear) {
+					recoveryOps.push_back_deep( recoveryOps.arena(), MutationRef( MutationRef::ClearRange, p1, p2 ) );
+					++dbgMutationCount;
+				} else if (h.op == OpCommit) {
+					self->applyMutations( recoveryOps );
+					recoveryOps = Standalone<VectorRef<MutationRef>>();
+					++dbgCommitCount;
+				} else if (h.op == OpRollback) {
+					recoveryOps = Standalone<VectorRef<MutationRef>>();
+				} else if (h.op == OpManifest) {
+					manifest = BinaryReader::fromStringRef<LSMManifest>( p1, IncludeVersion() );
+				} else
+					ASSERT(false);
+			}
+
+			Void _ = wait( yield() );
+		}
+
+		if (zeroFillSize) {
+			TEST( true );  // Fixing a partial commit at the end of the KeyValueStoreLSM log
+			for(int i=0; i<zeroFillSize; i++)
+				self->log->push( StringRef((const uint8_t*)"",1) );
+		}
+		// Make sure that mutations left without an OpCommit are not applied by a later recovery
+		self->log_op( OpRollback, StringRef(), StringRef() );
+
+		if( manifest.present() ) {
+			self->nextRunId = manifest.get().nextRunId;
+			for(r = 0; r < manifest.get().runIds.size(); r++) {
+				Reference<LSMRun> run = wait( LSMRun::open( self->runFilename( manifest.get().runIds[r] ), manifest.get().runIds[r] ) );
+				self->runs.push_back( run );
+			}
+		}
+		Void _ = wait( deleteRunFiles( self, false ) );
+
+		TraceEvent("KVSLSMRecovered", self->id)
+			.detail("Runs", self->runs.size())
+			.detail("MemtableBytes", self->active->bytes)
+			.detail("Mutations", dbgMutationCount)
+			.detail("Commits", dbgCommitCount)
+			.detail("ZeroFillSize", zeroFillSize)
+			.detail("TimeTaken", now()-startt);
+
+		return Void();
+	}
+
+	// Deletes the run files that are not live, or all of them
+	ACTOR static Future<Void> deleteRunFiles( KeyValueStoreLSM* self, bool all ) {
+		state std::vector<std::string> files;
+		state int f = 0;
+
+		std::string directory = parentDirectory( self->filename );
+		std::string prefix = basename( self->filename ) + "-run-";
+		std::set<int64_t> live;
+		for(auto& r : self->runs)
+			live.insert( r->id );
+
+		for(auto& file : platform::listFiles( directory )) {
+			if( !StringRef( file ).startsWith( StringRef( prefix ) ) )
+				continue;
+			// Leftovers of interrupted writes do not parse as a run id
+			char* end;
+			int64_t runId = strtoll( file.c_str() + prefix.size(), &end, 10 );
+			if( *end == 0 && end != file.c_str() + prefix.size() ) {
+				self->nextRunId = std::max( self->nextRunId, runId + 1 );
+				if( !all && live.count( runId ) )
+					continue;
+			}
+			files.push_back( joinPath( directory, file ) );
+		}
+
+		for(; f < files.size(); f++) {
+			TraceEvent("KVSLSMDeleteRunFile", self->id).detail("Filename", files[f]);
+			Void _ = wait( IAsyncFileSystem::filesystem()->deleteFile( files[f], all ) );
+		}
+		return Void();
+	}
+
+	ACTOR static Future<Void> deleteObsoleteRuns( KeyValueStoreLSM* self ) {
+		state std::vector<std::string> files;
+		state int f = 0;
+
+		for(int r = 0; r < self->obsoleteRuns.size(); ) {
+			if( self->obsoleteRuns[r]->isSoleOwner() ) {
+				files.push_back( self->obsoleteRuns[r]->filename );
+				self->obsoleteRuns.erase( self->obsoleteRuns.begin() + r );
+			} else
+				r++;
+		}
+
+		for(; f < files.size(); f++)
+			Void _ = wait( IAsyncFileSystem::filesystem()->deleteFile( files[f], false ) );
+		return Void();
+	}
+
+	ACTOR static Future<Void> flush( KeyValueStoreLSM* self, Future<Void> logCommitted, IDiskQueue::location flushedLocation ) {
+		state Reference<LSMMemtable> memtable = self->frozen;
+		state std::map<Key, Value>::iterator it;
+		state LSMRunWriter writer;
+		state int64_t runId;
+		state int64_t bytesSinceYield = 0;
+		state double startTime = now();
+
+		while( self->runs.size() >= 2 * SERVER_KNOBS->LSM_MAX_RUNS ) {
+			TEST( true );  // KeyValueStoreLSM flush waiting for compaction
+			Void _ = wait( self->compactionDone.onTrigger() );
+		}
+
+		runId = self->nextRunId++;
+		Void _ = wait( LSMRunWriter::open( &writer, runId, self->runFilename( runId ), memtable->sets.size() ) );
+		for(it = memtable->sets.begin(); it != memtable->sets.end(); ++it) {
+			Void _ = wait( writer.add( KeyValueRef( it->first, it->second ) ) );
+			bytesSinceYield += it->first.size() + it->second.size();
+			if( bytesSinceYield >= SERVER_KNOBS->LSM_BYTES_PER_YIELD ) {
+				bytesSinceYield = 0;
+				Void _ = wait( yield() );
+			}
+		}
+		for(auto& c : memtable->clears)
+			writer.addClear( KeyRangeRef( c.first, c.second ) );
+		Reference<LSMRun> run = wait( LSMRunWriter::finish( &writer ) );
+
+		self->runs.insert( self->runs.begin(), run );
+		self->frozen.clear();
+		self->logManifest();
+
+		TraceEvent("KVSLSMFlushed", self->id)
+			.detail("Run", run->id)
+			.detail("Keys", run->keyCount)
+			.detail("Clears", run->clears.size())
+			.detail("FileBytes", run->fileBytes)
+			.detail("Runs", self->runs.size())
+			.detail("TimeTaken", now()-startTime);
+
+		// Once the manifest naming the new run is durable, the mutations it holds are no longer needed in the log
+		Void _ = wait( logCommitted && self->log->commit() );
+		self->log->pop( flushedLocation );
+		self->compactionNeeded.trigger();
+		return Void();
+	}
+
+	// Merges adjacent runs, newest first, into one.  Clears only need to be kept if there are older runs they could hide.
+	ACTOR static Future<Reference<LSMRun>> mergeRuns( KeyValueStoreLSM* self, std::vector<Reference<LSMRun>> inputs, bool dropClears ) {
+		state std::vector<LSMCursor> cursors;
+		state std::vector<Future<Void>> moves;
+		state LSMRunWriter writer;
+		state Key key;
+		state int64_t bytesSinceYield = 0;
+		state int64_t runId;
+
+		int64_t expectedKeys = 0;
+		Key lastKey;
+		for(auto& r : inputs) {
+			expectedKeys += r->keyCount;
+			if( r->blocks.size() && lastKey < r->blocks.back().lastKey )
+				lastKey = r->blocks.back().lastKey;
+		}
+		KeyRange everything = KeyRangeRef( KeyRef(), keyAfter( lastKey ) );
+		for(auto& r : inputs)
+			cursors.push_back( LSMCursor( r, everything, true ) );
+		// Seeks hold pointers into cursors, so they only start once it is fully built
+		for(auto& c : cursors)
+			moves.push_back( c.seek() );
+		runId = self->nextRunId++;
+		Void _ = wait( waitForAll( moves ) && LSMRunWriter::open( &writer, runId, self->runFilename( runId ), expectedKeys ) );
+
+		loop {
+			int next = nextCursor( cursors, true );
+			if( next < 0 )
+				break;
+
+			KeyValueRef kv = cursors[next].get();
+			key = kv.key;
+			if( isVisible( cursors, next, kv.key ) ) {
+				bytesSinceYield += kv.expectedSize();
+				Void _ = wait( writer.add( kv ) );
+			}
+			moves = advanceCursors( cursors, key );
+			Void _ = wait( waitForAll( moves ) );
+
+			if( bytesSinceYield >= SERVER_KNOBS->LSM_BYTES_PER_YIELD ) {
+				bytesSinceYield = 0;
+				Void _ = wait( yield() );
+			}
+		}
+
+		if( !dropClears ) {
+			std::map<Key, Key> clears;
+			for(auto& r : inputs) {
+				for(auto& c : r->clears)
+					addClearRange( clears, c );
+			}
+			for(auto& c : clears)
+				writer.addClear( KeyRangeRef( c.first, c.second ) );
+		}
+
+		Reference<LSMRun> run = wait( LSMRunWriter::finish( &writer ) );
+		return run;
+	}
+
+	ACTOR static Future<Void> compact( KeyValueStoreLSM* self ) {
+		state std::vector<Reference<LSMRun>> inputs;
+		state int fanIn;
+		state int best;
+		state int64_t bestBytes;
+		state bool dropClears;
+		state double startTime;
+
+		Void _ = wait( self->recovering );
+
+		loop {
+			while( self->runs.size() <= SERVER_KNOBS->LSM_MAX_RUNS ) {
+				choose {
+					when( Void _ = wait( self->compactionNeeded.onTrigger() ) ) {}
+					when( Void _ = wait( self->obsoleteRuns.size() ? delay( 1.0 ) : Future<Void>( Never() ) ) ) {}
+				}
+				Void _ = wait( deleteObsoleteRuns( self ) );
+			}
+
+			// Merge the adjacent runs with the least data between them, preferring older ones so clears can be dropped
+			fanIn = std::min<int>( std::max( SERVER_KNOBS->LSM_COMPACTION_FANIN, 2 ), self->runs.size() );
+			best = 0;
+			bestBytes = std::numeric_limits<int64_t>::max();
+			for(int w = 0; w + fanIn <= self->runs.size(); w++) {
+				int64_t bytes = 0;
+				for(int r = w; r < w + fanIn; r++)
+					bytes += self->runs[r]->fileBytes;
+				if( bytes <= bestBytes ) {
+					best = w;
+					bestBytes = bytes;
+				}
+			}
+			inputs = std::vector<Reference<LSMRun>>( self->runs.begin() + best, self->runs.begin() + best + fanIn );
+			dropClears = best + fanIn == self->runs.size();
+			startTime = now();
+
+			Reference<LSMRun> output = wait( mergeRuns( self, inputs, dropClears ) );
+
+			// Flushes may have added newer runs in the meantime, but the inputs are still adjacent
+			auto first = std::find( self->runs.begin(), self->runs.end(), inputs[0] );
+			ASSERT( first + fanIn <= self->runs.end() && *(first + fanIn - 1) == inputs.back() );
+			self->runs.insert( self->runs.erase( first, first + fanIn ), output );
+			self->logManifest();
+
+			TraceEvent("KVSLSMCompacted", self->id)
+				.detail("Run", output->id)
+				.detail("Inputs", fanIn)
+				.detail("InputBytes", bestBytes)
+				.detail("Keys", output->keyCount)
+				.detail("FileBytes", output->fileBytes)
+				.detail("DroppedClears", dropClears)
+				.detail("Runs", self->runs.size())
+				.detail("TimeTaken", now()-startTime);
+
+			Void _ = wait( self->log->commit() );
+			self->obsoleteRuns.insert( self->obsoleteRuns.end(), inputs.begin(), inputs.end() );
+			inputs.clear();
+			self->compactionDone.trigger();
+			Void _ = wait( deleteObsoleteRuns( self ) );
+		}
+	}
+
+	ACTOR static Future<Optional<Value>> waitAndReadValuePrefix( KeyValueStoreLSM* self, Key key, int maxLength ) {
+		Void _ = wait( self->recovering );
+		Optional<Value> value = wait( self->readValuePrefix(key, maxLength) );
+		return value;
+	}
+	ACTOR static Future<Standalone<VectorRef<KeyValueRef>>> waitAndReadRange( KeyValueStoreLSM* self, KeyRange keys, int rowLimit, int byteLimit ) {
+		Void _ = wait( self->recovering );
+		Standalone<VectorRef<KeyValueRef>> result = wait( self->readRange(keys, rowLimit, byteLimit) );
+		return result;
+	}
+	ACTOR static Future<Void> waitAndCommit( KeyValueStoreLSM* self, bool sequential ) {
+		Void _ = wait( self->recovering );
+		Void _ = wait( self->commit(sequential) );
+		return Void();
+	}
+
+	ACTOR static void doClose( KeyValueStoreLSM* self, bool deleteOnClose ) {
+		state Error error = success();
+		state Future<Void> logClosed = self->log->onClosed();
+		try {
+			TraceEvent("KVSLSMClose", self->id).detail("Del", deleteOnClose);
+			self->recovering.cancel();
+			self->flushing.cancel();
+			self->background.cancel();
+			self->runs.clear();
+			self->obsoleteRuns.clear();
+			self->frozen.clear();
+
+			if( deleteOnClose )
+				self->log->dispose();
+			else
+				self->log->close();
+			Void _ = wait( logClosed );
+
+			if( deleteOnClose ) {
+				Void _ = wait( deleteRunFiles( self, true ) );
+			}
+		} catch (Error& e) {
+			TraceEvent(SevError, "KVSLSMDoCloseError", self->id).error(e, true);
+			error = e;
+		}
+
+		TraceEvent("KVSLSMClosed", self->id);
+		if( error.code() != error_code_actor_cancelled ) {
+			self->stopped.send(Void());
+			delete self;
+		}
+	}
+};
+
+KeyValueStoreLSM::KeyValueStoreLSM( std::string const& filename, UID id )
+	: filename(filename), id(id), log( openDiskQueue( filename + "-log", id ) ), active( new LSMMemtable ), nextRunId(0), flushing( Void() )
+{
+	recovering = recover( this );
+	background = actorCollection( addActor.getFuture() );
+	addActor.send( compact( this ) );
+}
+
+IKeyValueStore* keyValueStoreLSM( std::string const& filename, UID logID ) {
+	TraceEvent("KVSLSMOpening", logID).detail("Filename", filename);
+	return new KeyValueStoreLSM( filename, logID );
+}
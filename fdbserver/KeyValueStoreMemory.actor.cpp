@@ -21,42 +21,18 @@
 #include "flow/actorcompiler.h"
 #include "IKeyValueStore.h"
 #include "IDiskQueue.h"
-#include "flow/IndexedSet.h"
+#include "BlockedKeyValueMap.h"
 #include "flow/ActorCollection.h"
 #include "fdbclient/Notified.h"
 #include "fdbclient/SystemData.h"
 
 #define OP_DISK_OVERHEAD (sizeof(OpHeader) + 1)
 
-//Stored in the IndexedSets that hold the database.
-//Each KeyValueMapPair is 32 bytes, excluding arena memory.
-//It is stored in an IndexedSet<KeyValueMapPair, uint64_t>::Node, for a total size of 72 bytes.
-struct KeyValueMapPair {
-	Arena arena; //8 Bytes (excluding arena memory)
-	KeyRef key; //12 Bytes
-	ValueRef value; //12 Bytes
-
-	void operator= ( KeyValueMapPair const& rhs ) { arena = rhs.arena; key = rhs.key; value = rhs.value; }
-	KeyValueMapPair( KeyValueMapPair const& rhs ) : arena(rhs.arena), key(rhs.key), value(rhs.value) {}
-
-	KeyValueMapPair(KeyRef key, ValueRef value) : arena(key.expectedSize() + value.expectedSize()), key(arena, key), value(arena, value) { }
-
-	bool operator<(KeyValueMapPair const& r) const { return key < r.key; }
-	bool operator==(KeyValueMapPair const& r) const { return key == r.key; }
-	bool operator!=(KeyValueMapPair const& r) const { return key != r.key; }
-};
-
-template <class CompatibleWithKey>
-bool operator<(KeyValueMapPair const& l, CompatibleWithKey const& r) { return l.key < r; }
-
-template <class CompatibleWithKey>
-bool operator<(CompatibleWithKey const& l, KeyValueMapPair const& r) { return l < r.key; }
-
 extern bool noUnseed;
 
 class KeyValueStoreMemory : public IKeyValueStore, NonCopyable {
 public:
-	KeyValueStoreMemory( IDiskQueue* log, UID id, int64_t memoryLimit, bool disableSnapshot );
+	KeyValueStoreMemory( IDiskQueue* log, UID id, int64_t memoryLimit, bool disableSnapshot, int snapshotSpeedup = 1 );
 
 	// IClosable
 	virtual Future<Void> getError() { return log->getError(); }
@@ -110,8 +86,7 @@ public:
 			return;
 
 		if(transactionIsLarge) {
-			KeyValueMapPair pair(keyValue.key, keyValue.value);
-			data.insert(pair, pair.arena.getSize() + data.getElementBytes());
+			data.insert(keyValue);
 		}
 		else {
 			queue.set(keyValue, arena);
@@ -160,7 +135,7 @@ public:
 			committedWriteBytes = notifiedCommittedWriteBytes.get();
 		}
 		else {
-			int64_t bytesWritten = commit_queue(queue, !disableSnapshot, sequential);
+			int64_t bytesWritten = commit_queue(queue, !disableSnapshot);
 			if(!disableSnapshot) {
 				committedWriteBytes += bytesWritten + OP_DISK_OVERHEAD; //OP_DISK_OVERHEAD is for the following log_op(OpCommit)
 			}
@@ -215,6 +190,30 @@ public:
 		}
 	}
 
+	virtual Future<std::vector<Optional<Value>>> readValues( std::vector<std::pair<KeyRef, int>> const& keys, Optional<UID> debugID = Optional<UID>() ) {
+		if(recovering.isError()) throw recovering.getError();
+		if (!recovering.isReady()) {
+			Standalone<VectorRef<KeyRef>> keyCopies;
+			std::vector<int> maxLengths;
+			for(auto& k : keys) {
+				keyCopies.push_back_deep( keyCopies.arena(), k.first );
+				maxLengths.push_back( k.second );
+			}
+			return waitAndReadValues(this, keyCopies, maxLengths);
+		}
+
+		std::vector<Optional<Value>> values;
+		values.reserve( keys.size() );
+		for(auto& k : keys) {
+			auto it = data.find(k.first);
+			if (it == data.end())
+				values.push_back( Optional<Value>() );
+			else
+				values.push_back( Value( it->value.substr(0, std::min(k.second, it->value.size())) ) );
+		}
+		return values;
+	}
+
 	// If rowLimit>=0, reads first rows sorted ascending, otherwise reads last rows sorted descending
 	// The total size of the returned value (less the last entry) will be less than byteLimit
 	virtual Future<Standalone<VectorRef<KeyValueRef>>> readRange( KeyRangeRef keys, int rowLimit = 1<<30, int byteLimit = 1<<30 ) {
@@ -243,6 +242,45 @@ public:
 		return result;
 	}
 
+	virtual Future<Standalone<VectorRef<KeyValueRef>>> readRangePrefix( KeyRangeRef keys, int maxLength, int rowLimit = 1<<30, int byteLimit = 1<<30 ) {
+		if(recovering.isError()) throw recovering.getError();
+		if (!recovering.isReady()) return IKeyValueStore::readRangePrefix(keys, maxLength, rowLimit, byteLimit);
+
+		Standalone<VectorRef<KeyValueRef>> result;
+		if (rowLimit >= 0) {
+			auto it = data.lower_bound(keys.begin);
+			while (it!=data.end() && it->key < keys.end && rowLimit && byteLimit>=0) {
+				ValueRef value = it->value.substr(0, std::min(it->value.size(), maxLength));
+				byteLimit -= sizeof(KeyValueRef) + it->key.size() + value.size();
+				result.push_back_deep( result.arena(), KeyValueRef(it->key, value) );
+				++it;
+				--rowLimit;
+			}
+		} else {
+			rowLimit = -rowLimit;
+			auto it = data.previous( data.lower_bound(keys.end) );
+			while (it!=data.end() && it->key >= keys.begin && rowLimit && byteLimit>=0) {
+				ValueRef value = it->value.substr(0, std::min(it->value.size(), maxLength));
+				byteLimit -= sizeof(KeyValueRef) + it->key.size() + value.size();
+				result.push_back_deep( result.arena(), KeyValueRef(it->key, value) );
+				it = data.previous(it);
+				--rowLimit;
+			}
+		}
+		return result;
+	}
+
+	// Finds the entry by its rank in data, without visiting the entries before it
+	virtual Future<Optional<Key>> readKeyAtOffset( KeyRangeRef keys, int offset ) {
+		if(recovering.isError()) throw recovering.getError();
+		if (!recovering.isReady()) return Optional<Key>();
+
+		int64_t r = offset >= 0 ? data.rank( data.lower_bound(keys.begin) ) + offset : data.rank( data.lower_bound(keys.end) ) + offset;
+		auto it = data.atRank(r);
+		if (it == data.end() || !keys.contains(it->key)) return Optional<Key>();
+		return Optional<Key>( Key(it->key) );
+	}
+
 	virtual void resyncLog() {
 		ASSERT( recovering.isReady() );
 		resetSnapshot = true;
@@ -334,7 +372,7 @@ private:
 
 	UID id;
 
-	IndexedSet< KeyValueMapPair, uint64_t > data;
+	BlockedKeyValueMap data;
 
 	OpQueue queue; // mutations not yet commit()ted
 	IDiskQueue *log;
@@ -353,11 +391,12 @@ private:
 
 	bool resetSnapshot; //Set to true after a fullSnapshot is performed.  This causes the regular snapshot mechanism to restart
 	bool disableSnapshot;
+	int snapshotSpeedup; //The snapshot logs this many bytes for each byte of mutations committed
 
 	int64_t memoryLimit; //The upper limit on the memory used by the store (excluding, possibly, some clear operations)
-	std::vector<std::pair<KeyValueMapPair, uint64_t>> dataSets;
+	std::vector<KeyValueRef> dataSets;
 
-	int64_t commit_queue(OpQueue &ops, bool log, bool sequential = false) {
+	int64_t commit_queue(OpQueue &ops, bool log) {
 		int64_t total = 0, count = 0;
 		IDiskQueue::location log_location = 0;
 
@@ -365,22 +404,26 @@ private:
 			++count;
 			total += o->p1.size() + o->p2.size() + OP_DISK_OVERHEAD;
 			if (o->op == OpSet) {
-				KeyValueMapPair pair(o->p1, o->p2);
-				if(sequential) {
-					dataSets.push_back(std::make_pair(pair, pair.arena.getSize() + data.getElementBytes()));
-				} else {
-					data.insert( pair, pair.arena.getSize() + data.getElementBytes() );
+				// Runs of ascending keys (such as the snapshot items read during recovery) are inserted together, which
+				// writes each leaf of the map once per run rather than once per key.  The map needs each run in order, so
+				// a run ends at the first key that does not sort after the one before it even in a sequential commit.
+				if(!dataSets.empty() && !(dataSets.back().key < o->p1)) {
+					data.insert(dataSets);
+					dataSets.clear();
 				}
+				dataSets.push_back(KeyValueRef(o->p1, o->p2));
 			}
 			else if (o->op == OpClear) {
-				if(sequential) {
+				// A clear that begins after the pending run cannot remove any of it, so the run goes on.  Recovery
+				// clears the gap before each snapshot item, and would otherwise insert the snapshot one key at a time.
+				if(!dataSets.empty() && !(dataSets.back().key < o->p1)) {
 					data.insert(dataSets);
 					dataSets.clear();
 				}
 				data.erase( data.lower_bound(o->p1), data.lower_bound(o->p2) );
 			}
 			else if (o->op == OpClearToEnd) {
-				if(sequential) {
+				if(!dataSets.empty() && !(dataSets.back().key < o->p1)) {
 					data.insert(dataSets);
 					dataSets.clear();
 				}
@@ -390,10 +433,8 @@ private:
 			if ( log )
 				log_location = log_op( o->op, o->p1, o->p2 );
 		}
-		if(sequential) {
-			data.insert(dataSets);
-			dataSets.clear();
-		}
+		data.insert(dataSets);
+		dataSets.clear();
 
 		bool ok = count < 1e6;
 		if( !ok ) {
@@ -577,7 +618,7 @@ private:
 	}
 
 	//Snapshots an entire data set
-	void fullSnapshot( IndexedSet< KeyValueMapPair, uint64_t> &snapshotData ) {
+	void fullSnapshot( BlockedKeyValueMap &snapshotData ) {
 		previousSnapshotEnd = log_op(OpSnapshotAbort, StringRef(), StringRef());
 
 		//Clear everything since we are about to write the whole database
@@ -612,7 +653,7 @@ private:
 		TraceEvent("KVSMemStartingSnapshot", self->id).detail("StartKey", printable(nextKey));
 
 		loop {
-			Void _ = wait( self->notifiedCommittedWriteBytes.whenAtLeast( snapshotTotalWrittenBytes + 1 ) );
+			Void _ = wait( self->notifiedCommittedWriteBytes.whenAtLeast( snapshotTotalWrittenBytes / self->snapshotSpeedup + 1 ) );
 
 			if(self->resetSnapshot) {
 				nextKey = Key();
@@ -623,7 +664,7 @@ private:
 			}
 
 			auto next = nextKeyAfter ? self->data.upper_bound(nextKey) : self->data.lower_bound(nextKey);
-			int diff = self->notifiedCommittedWriteBytes.get() - snapshotTotalWrittenBytes;
+			int diff = self->notifiedCommittedWriteBytes.get() - snapshotTotalWrittenBytes / self->snapshotSpeedup;
 			if( diff > lastDiff && diff > 5e7 )
 				TraceEvent(SevWarnAlways, "ManyWritesAtOnce", self->id)
 					.detail("CommittedWrites", self->notifiedCommittedWriteBytes.get())
@@ -654,13 +695,20 @@ private:
 
 				snapshotTotalWrittenBytes += OP_DISK_OVERHEAD;
 			} else {
-				self->log_op( OpSnapshotItem, next->key, next->value );
-				nextKey = next->key;
+				// Catch up with everything committed since the last wakeup in one pass, walking the set instead of seeking
+				// to each item.  Nothing waits in between, so the iterator stays valid.
+				auto last = next;
+				while( next != self->data.end() && (last == next || snapshotTotalWrittenBytes < self->notifiedCommittedWriteBytes.get() * self->snapshotSpeedup) ) {
+					self->log_op( OpSnapshotItem, next->key, next->value );
+					snapItems++;
+					uint64_t opBytes = next->key.size() + next->value.size() + OP_DISK_OVERHEAD;
+					snapshotBytes += opBytes;
+					snapshotTotalWrittenBytes += opBytes;
+					last = next;
+					++next;
+				}
+				nextKey = last->key;
 				nextKeyAfter = true;
-				snapItems++;
-				uint64_t opBytes = next->key.size() + next->value.size() + OP_DISK_OVERHEAD;
-				snapshotBytes += opBytes;
-				snapshotTotalWrittenBytes += opBytes;
 			}
 		}
 	}
@@ -673,6 +721,13 @@ private:
 		Void _ = wait( self->recovering );
 		return self->readValuePrefix(key, maxLength).get();
 	}
+	ACTOR static Future<std::vector<Optional<Value>>> waitAndReadValues( KeyValueStoreMemory* self, Standalone<VectorRef<KeyRef>> keys, std::vector<int> maxLengths ) {
+		Void _ = wait( self->recovering );
+		std::vector<std::pair<KeyRef, int>> keyLengths;
+		for(int i = 0; i < keys.size(); i++)
+			keyLengths.push_back( std::make_pair( keys[i], maxLengths[i] ) );
+		return self->readValues(keyLengths).get();
+	}
 	ACTOR static Future<Standalone<VectorRef<KeyValueRef>>> waitAndReadRange( KeyValueStoreMemory* self, KeyRange keys, int rowLimit, int byteLimit ) {
 		Void _ = wait( self->recovering );
 		return self->readRange(keys, rowLimit, byteLimit).get();
@@ -689,10 +744,10 @@ private:
 	}
 };
 
-KeyValueStoreMemory::KeyValueStoreMemory( IDiskQueue* log, UID id, int64_t memoryLimit, bool disableSnapshot )
+KeyValueStoreMemory::KeyValueStoreMemory( IDiskQueue* log, UID id, int64_t memoryLimit, bool disableSnapshot, int snapshotSpeedup )
 	: log(log), id(id), previousSnapshotEnd(-1), currentSnapshotEnd(-1),
 	  resetSnapshot(false), memoryLimit(memoryLimit), committedWriteBytes(0),
-	  committedDataSize(0), transactionSize(0), transactionIsLarge(false), disableSnapshot(disableSnapshot)
+	  committedDataSize(0), transactionSize(0), transactionIsLarge(false), disableSnapshot(disableSnapshot), snapshotSpeedup(std::max(snapshotSpeedup, 1))
 {
 	recovering = recover( this );
 	snapshotting = snapshot( this );
@@ -705,6 +760,6 @@ IKeyValueStore* keyValueStoreMemory( std::string const& basename, UID logID, int
 	return new KeyValueStoreMemory( log, logID, memoryLimit, false );
 }
 
-IKeyValueStore* keyValueStoreLogSystem( class IDiskQueue* queue, UID logID, int64_t memoryLimit, bool disableSnapshot ) {
-	return new KeyValueStoreMemory( queue, logID, memoryLimit, disableSnapshot );
+IKeyValueStore* keyValueStoreLogSystem( class IDiskQueue* queue, UID logID, int64_t memoryLimit, bool disableSnapshot, int snapshotSpeedup ) {
+	return new KeyValueStoreMemory( queue, logID, memoryLimit, disableSnapshot, snapshotSpeedup );
 }
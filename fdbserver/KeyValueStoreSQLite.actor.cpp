@@ -25,12 +25,14 @@
 #include "CoroFlow.h"
 #include "Knobs.h"
 #include "flow/Hash3.h"
+#include "fdbrpc/Checksum.h"
 
 extern "C" {
 #include "sqlite/sqliteInt.h"
 u32 sqlite3VdbeSerialGet(const unsigned char*, u32, Mem*);
 }
 #include "flow/ThreadPrimitives.h"
+#include "flow/ThreadMetric.h"
 #include "template_fdb.h"
 #include "fdbrpc/simulator.h"
 
@@ -41,6 +43,13 @@ u32 sqlite3VdbeSerialGet(const unsigned char*, u32, Mem*);
 
 void hexdump(FILE *fout, StringRef val);
 
+// Reader threads started by the SQLite stores of this process
+static int& processReaderThreads() {
+	static int readerThreads = 0;
+	static std::map<NetworkAddress, int> simulatorReaderThreads;
+	return g_network->isSimulated() ? simulatorReaderThreads[g_network->getLocalAddress()] : readerThreads;
+}
+
 /*#undef state
 #include <Windows.h>*/
 
@@ -57,11 +66,12 @@ struct SpringCleaningStats {
 	int64_t springCleaningCount;
 	int64_t lazyDeletePages;
 	int64_t vacuumedPages;
+	int64_t reclaimedBytes;  // Returned to the file system by vacuuming
 	double springCleaningTime;
 	double vacuumTime;
 	double lazyDeleteTime;
 
-	SpringCleaningStats() : springCleaningCount(0), lazyDeletePages(0), vacuumedPages(0), springCleaningTime(0.0), vacuumTime(0.0), lazyDeleteTime(0.0) {}
+	SpringCleaningStats() : springCleaningCount(0), lazyDeletePages(0), vacuumedPages(0), reclaimedBytes(0), springCleaningTime(0.0), vacuumTime(0.0), lazyDeleteTime(0.0) {}
 };
 
 struct PageChecksumCodec {
@@ -79,12 +89,33 @@ struct PageChecksumCodec {
 		std::string toString() { return format("0x%08x%08x", part1, part2); }
 	};
 
+	// A CRC-32C sum has this in part2.  A hashlittle2 sum has it there only by chance, so a sum that has it and
+	// doesn't match as a CRC-32C sum is also checked as a hashlittle2 sum.
+	enum { CRC32C_MARK = 0xc32c0001 };
+
+	static SumType hashlittle2Sum(Pgno pageNumber, const char *pData, int dataLen) {
+		SumType sum;
+		sum.part1 = pageNumber; //DO NOT CHANGE
+		sum.part2 = 0x5ca1ab1e;
+		hashlittle2(pData, dataLen, &sum.part1, &sum.part2);
+		return sum;
+	}
+
+	static SumType crc32cSum(Pgno pageNumber, const char *pData, int dataLen) {
+		SumType sum;
+		uint32_t pgno = pageNumber;
+		sum.part1 = crc32c(&pgno, sizeof(pgno), crc32c(pData, dataLen));
+		sum.part2 = CRC32C_MARK;
+		return sum;
+	}
+
 	// Calculates and then either stores or verifies a checksum.
 	// The checksum is read/stored at the end of the page buffer.
 	// Page size is passed in as pageLen because this->pageSize is not always appropriate.
 	// If write is true then the checksum is written into the page and true is returned.
 	// If write is false then the checksum is compared to the in-page sum and the return value
 	// is whether or not the checksums were equal.
+	// Pages are written with the kind of sum that SERVER_KNOBS->PAGE_CHECKSUM_FORMAT selects, and either kind is verified.
 	bool checksum(Pgno pageNumber, void *data, int pageLen, bool write) {
 		ASSERT(pageLen > sizeof(SumType));
 
@@ -93,14 +124,22 @@ struct PageChecksumCodec {
 		SumType sum;
 		SumType *pSumInPage = (SumType *)(pData + dataLen);
 
-		// Write sum directly to page or to sum variable based on mode
-		SumType *sumOut = write ? pSumInPage : &sum;
-		sumOut->part1 = pageNumber; //DO NOT CHANGE
-		sumOut->part2 = 0x5ca1ab1e;
-		hashlittle2(pData, dataLen, &sumOut->part1, &sumOut->part2);
+		if(write) {
+			*pSumInPage = SERVER_KNOBS->PAGE_CHECKSUM_FORMAT >= 1 ? crc32cSum(pageNumber, pData, dataLen) : hashlittle2Sum(pageNumber, pData, dataLen);
+			return true;
+		}
+
+		if(pSumInPage->part2 == CRC32C_MARK) {
+			sum = crc32cSum(pageNumber, pData, dataLen);
+			if(sum == *pSumInPage || hashlittle2Sum(pageNumber, pData, dataLen) == *pSumInPage)
+				return true;
+		}
+		else {
+			sum = hashlittle2Sum(pageNumber, pData, dataLen);
+		}
 
-		// Verify if not in write mode
-		if(!write && sum != *pSumInPage) {
+		// Verify
+		if(sum != *pSumInPage) {
 			if(!silent)
 				TraceEvent (SevError, "SQLitePageChecksumFailure")
 					.detail("CodecPageSize", pageSize)
@@ -173,6 +212,62 @@ struct PageChecksumCodec {
 	}
 };
 
+// Returns the contents of a new, empty database file with pages of pageSize bytes.  The templates in template_fdb.h
+// have 4096 byte pages, and each of their pages holds nothing but a header at its start, so for a larger page size
+// the headers are copied and given the new page size and cell content offsets, and the pages checksummed again.
+static std::string templateDatabase( int pageSize, bool page_checksums ) {
+	const char* base = page_checksums ? template_fdb_with_page_checksums : template_fdb_without_page_checksums;
+	if( pageSize == 4096 )
+		return std::string( base, sizeof(template_fdb_with_page_checksums) );
+
+	ASSERT( pageSize > 4096 && pageSize <= 32768 && !(pageSize & (pageSize - 1)) );
+	const int pages = sizeof(template_fdb_with_page_checksums) / 4096;
+	const int reserveSize = page_checksums ? sizeof(PageChecksumCodec::SumType) : 0;
+	std::string image( pages * pageSize, '\0' );
+	uint8_t* data = (uint8_t*)&image[0];
+
+	// The headers all end before the checksum that page 1 also has at the end of its first SQLITE_DEFAULT_PAGE_SIZE bytes
+	for(int p = 0; p < pages; p++)
+		memcpy( data + p * pageSize, base + p * 4096, SQLITE_DEFAULT_PAGE_SIZE - reserveSize );
+
+	// The page size is at offset 16 of the database header
+	data[16] = pageSize >> 8;
+	data[17] = pageSize & 0xff;
+
+	// Page 2 is the pointer map, and the others are empty btree leaves, whose cell content area starts at the end of the
+	// page's usable space.  Page 1's btree header follows the 100 byte database header.
+	const int usableSize = pageSize - reserveSize;
+	for(int p : { 0, 2, 3 }) {
+		uint8_t* header = data + p * pageSize + (p == 0 ? 100 : 0);
+		ASSERT( header[0] == 0x0a || header[0] == 0x0d );
+		header[5] = usableSize >> 8;
+		header[6] = usableSize & 0xff;
+	}
+
+	if( page_checksums ) {
+		PageChecksumCodec codec( "template" );
+		codec.pageSize = pageSize;
+		codec.reserveSize = reserveSize;
+		for(int p = 0; p < pages; p++)
+			PageChecksumCodec::codec( &codec, data + p * pageSize, p + 1, 6 );  // 6 is a database page write
+	}
+
+	return image;
+}
+
+// Reads a page into the page cache of the file ahead of SQLite.  An error is ignored, since SQLite sees it again if it
+// reads the page itself.
+ACTOR static Future<Void> prefetchPage( Reference<IAsyncFile> file, int64_t offset, int length ) {
+	state Standalone<StringRef> buffer = makeString( length );
+	try {
+		int _ = wait( file->read( mutateString(buffer), length, offset ) );
+	} catch( Error& e ) {
+		if( e.code() == error_code_actor_cancelled )
+			throw;
+	}
+	return Void();
+}
+
 struct SQLiteDB : NonCopyable {
 	std::string filename;
 	sqlite3* db;
@@ -182,7 +277,10 @@ struct SQLiteDB : NonCopyable {
 	Reference<IAsyncFile> dbFile, walFile;
 	bool page_checksums;
 	bool fragment_values;
+	int fragmentPrimaryPageUsable, fragmentOverflowPageUsable;  // The SQLITE_FRAGMENT_* knobs for this file's page size
 	PageChecksumCodec *pPagerCodec;  // we do NOT own this pointer, db does.
+	Deque<Future<Void>> prefetches;
+	std::deque<Pgno> recentPrefetches;  // The last pages prefetched, so that overlapping prefetches skip them
 
 	void beginTransaction(bool write) {
 		checkError("BtreeBeginTrans", sqlite3BtreeBeginTrans(btree, write));
@@ -197,7 +295,8 @@ struct SQLiteDB : NonCopyable {
 	void open(bool writable);
 	void createFromScratch();
 
-	SQLiteDB( std::string filename, bool page_checksums, bool fragment_values): filename(filename), db(NULL), btree(NULL), table(-1), freetable(-1), haveMutex(false), page_checksums(page_checksums), fragment_values(fragment_values) {}
+	SQLiteDB( std::string filename, bool page_checksums, bool fragment_values): filename(filename), db(NULL), btree(NULL), table(-1), freetable(-1), haveMutex(false), page_checksums(page_checksums), fragment_values(fragment_values),
+		fragmentPrimaryPageUsable(SERVER_KNOBS->SQLITE_FRAGMENT_PRIMARY_PAGE_USABLE), fragmentOverflowPageUsable(SERVER_KNOBS->SQLITE_FRAGMENT_OVERFLOW_PAGE_USABLE) {}
 
 	~SQLiteDB() {
 		if (db) {
@@ -221,6 +320,40 @@ struct SQLiteDB : NonCopyable {
 		}
 	}
 
+	int pageSize() {
+		return sqlite3BtreeGetPageSize(btree);
+	}
+
+	// Starts reading pages of the database file that a cursor is about to need.  This relies on the readers being
+	// coroutines on the network thread, since the reads are issued from here.
+	void prefetchPages( Pgno const* pages, int count ) {
+		while (prefetches.size() && prefetches.front().isReady())
+			prefetches.pop_front();
+		int size = pageSize();
+		int limit = std::max(SERVER_KNOBS->SQLITE_READ_PREFETCH_PAGES, 1);
+		for(int i = 0; i < count; i++) {
+			if (std::find(recentPrefetches.begin(), recentPrefetches.end(), pages[i]) != recentPrefetches.end())
+				continue;
+			recentPrefetches.push_back( pages[i] );
+			if (recentPrefetches.size() > 2 * limit)
+				recentPrefetches.pop_front();
+			// The oldest prefetches are given up on rather than letting them pile up behind a slow disk
+			if (prefetches.size() >= 4 * limit)
+				prefetches.pop_front();
+			prefetches.push_back( prefetchPage( dbFile, int64_t(pages[i] - 1) * size, size ) );
+		}
+	}
+
+	// The fragment knobs are for the page usable size in SQLITE_BTREE_PAGE_USABLE, so a file with larger pages fits
+	// more in both a primary and an overflow page.  SQLite's maximum local payload for the file's usable size is
+	// calculated as in SERVER_KNOBS->SQLITE_BTREE_CELL_MAX_LOCAL.
+	void initFragmentSizes() {
+		int usable = sqlite3BtreeGetPageSize(btree) - sqlite3BtreeGetReserve(btree);
+		int maxLocal = (usable - 12) * 64/255 - 23;
+		fragmentPrimaryPageUsable = SERVER_KNOBS->SQLITE_FRAGMENT_PRIMARY_PAGE_USABLE + maxLocal - SERVER_KNOBS->SQLITE_BTREE_CELL_MAX_LOCAL;
+		fragmentOverflowPageUsable = SERVER_KNOBS->SQLITE_FRAGMENT_OVERFLOW_PAGE_USABLE + usable - SERVER_KNOBS->SQLITE_BTREE_PAGE_USABLE;
+	}
+
 	void checkError( const char* context, int rc ) {
 		//if (g_random->random01() < .001) rc = SQLITE_INTERRUPT;
 		if (rc) {
@@ -636,10 +769,12 @@ struct RawCursor {
 	BtCursor *cursor;
 	KeyInfo keyInfo;
 	bool valid;
+	int prefetchPages;  // Read ahead of the cursor when it moves to another page; see Prefetching
+	Pgno page;  // The page the cursor was last seen in
 
 	operator bool() const { return valid; }
 
-	RawCursor( SQLiteDB& db, int table, bool write) : cursor(0), db(db), valid(false) {
+	RawCursor( SQLiteDB& db, int table, bool write) : cursor(0), db(db), valid(false), prefetchPages(0), page(0) {
 		keyInfo.db = db.db;
 		keyInfo.enc = db.db->aDb[0].pSchema->enc;
 		keyInfo.aColl[0] = db.db->pDfltColl;
@@ -677,11 +812,38 @@ struct RawCursor {
 		int empty=1;
 		db.checkError("BtreeNext", sqlite3BtreeNext(cursor, &empty));
 		valid = !empty;
+		if (prefetchPages) prefetch(false);
 	}
 	void movePrevious() {
 		int empty=1;
 		db.checkError("BtreePrevious", sqlite3BtreePrevious(cursor, &empty));
 		valid = !empty;
+		if (prefetchPages) prefetch(true);
+	}
+
+	// Range reads walk the leaves one at a time, and each leaf missing from the page cache would otherwise be a read
+	// of its own.  While a Prefetching is in scope, each time the cursor moves into another page, the leaves after it
+	// in its parent and the overflow pages of the rows after it on its leaf are read ahead of it.
+	struct Prefetching {
+		RawCursor& cur;
+		explicit Prefetching( RawCursor& cur ) : cur(cur) {
+			cur.prefetchPages = std::min(SERVER_KNOBS->SQLITE_READ_PREFETCH_PAGES, 64);
+			cur.page = 0;
+		}
+		~Prefetching() { cur.prefetchPages = 0; }
+	};
+
+	void prefetch( bool reverse ) {
+		Pgno current = sqlite3BtreeCursorPage(cursor);
+		if (current == page)
+			return;
+		page = current;
+		Pgno pages[64];
+		int count = sqlite3BtreeCursorNextPages(cursor, reverse, pages, prefetchPages);
+		if (count) {
+			TEST(true); // SQLite range read prefetching pages
+			db.prefetchPages( pages, count );
+		}
 	}
 	int size() {
 		int64_t size;
@@ -709,6 +871,18 @@ struct RawCursor {
 		db.checkError("BtreeKey", sqlite3BtreeKey(cursor, 0, s, d));
 		return KeyRef(d, s);
 	}
+	// Reads the header and key of the row, and its fragment index if any, followed by at most valuePrefixSize bytes of
+	// its value.  The header gives the size of the key, so the rest of a long value, and any overflow pages holding it,
+	// are not read.
+	ValueRef getEncodedRowKeyPrefix( Arena& arena, int valuePrefixSize ) {
+		uint8_t header[32];  // Large enough for the header varints of any row
+		db.checkError("BtreeKey", sqlite3BtreeKey(cursor, 0, std::min<int>(size(), sizeof(header)), header));
+		uint64_t h, keyCode;
+		const uint8_t* d = header;
+		d += sqlite3GetVarint( d, (u64*)&h );
+		sqlite3GetVarint( d, (u64*)&keyCode );
+		return getEncodedRowPrefix( arena, h + (keyCode-12)/2 + 4 + valuePrefixSize );
+	}
 	void insertFragment( KeyValueRef kv, uint32_t index, int seekResult ) {
 		Value v = encodeKVFragment(kv, index);
 		db.checkError("BtreeInsert", sqlite3BtreeInsert(cursor, v.begin(), v.size(), NULL, 0, 0, 0, seekResult));
@@ -730,8 +904,8 @@ struct RawCursor {
 				seekResult = moveTo(kv.key, true);
 			}
 
-			const int primaryPageUsable = SERVER_KNOBS->SQLITE_FRAGMENT_PRIMARY_PAGE_USABLE;
-			const int overflowPageUsable = SERVER_KNOBS->SQLITE_FRAGMENT_OVERFLOW_PAGE_USABLE;
+			const int primaryPageUsable = db.fragmentPrimaryPageUsable;
+			const int overflowPageUsable = db.fragmentOverflowPageUsable;
 
 			int fragments = 1;
 			int valuePerFragment = kv.value.size();
@@ -828,7 +1002,10 @@ struct RawCursor {
 			remove();
 		}
 	}
-	void fastClear( KeyRangeRef keys, bool& freeTableEmpty ) {
+	// Detaches every subtree that lies entirely within keys and queues its root on the freetable, so that the work done here
+	// depends on the height of the tree rather than on the amount of data cleared.  The queued pages are freed later by
+	// lazyDelete().  Returns the number of subtrees queued.
+	int fastClear( KeyRangeRef keys, bool& freeTableEmpty ) {
 		vector<int> clearBuffer( SERVER_KNOBS->CLEAR_BUFFER_SIZE );
 		clearBuffer[0] = 0;
 
@@ -858,6 +1035,7 @@ struct RawCursor {
 			ASSERT(pagesDeleted == 0);
 			freeTableEmpty = false;
 		}
+		return clearBuffer[0];
 	}
 	int lazyDelete( int desiredPages ) {
 		vector<int> clearBuffer( SERVER_KNOBS->CLEAR_BUFFER_SIZE );
@@ -1065,6 +1243,7 @@ struct RawCursor {
 		Standalone<VectorRef<KeyValueRef>> result;
 		int accumulatedBytes = 0;
 		ASSERT( byteLimit > 0 );
+		Prefetching prefetching( *this );
 		if(db.fragment_values) {
 			if(rowLimit >= 0) {
 				int r = moveTo(keys.begin);
@@ -1120,6 +1299,75 @@ struct RawCursor {
 		return result;
 	}
 
+	// Like getRange(), but returns only the first maxLength bytes of each value, and reads little more of each row than that.
+	// A fragmented value is read from its first fragment until maxLength bytes are found, and the cursor then seeks past
+	// the rest of its fragments.
+	Standalone<VectorRef<KeyValueRef>> getRangePrefix( KeyRangeRef keys, int maxLength, int rowLimit, int byteLimit ) {
+		Standalone<VectorRef<KeyValueRef>> result;
+		int accumulatedBytes = 0;
+		ASSERT( byteLimit > 0 && maxLength >= 0 );
+		Prefetching prefetching( *this );
+		bool forward = rowLimit >= 0;
+		int r = moveTo( forward ? keys.begin : keys.end );
+		if (forward ? r < 0 : r >= 0)
+			forward ? moveNext() : movePrevious();
+		while (this->valid && rowLimit && accumulatedBytes < byteLimit) {
+			uint32_t index;
+			KeyValueRef kv = getRowPrefix( result.arena(), maxLength, &index );
+			if (forward ? kv.key >= keys.end : kv.key < keys.begin) break;
+			if (index) {
+				kv.value = getFragmentedValuePrefix( result.arena(), kv.key, maxLength );
+				if (forward) {
+					Arena temp;
+					r = moveTo( keyAfter( kv.key, temp ) );
+					if (r < 0) moveNext();
+				} else {
+					r = moveTo( kv.key );
+					if (r >= 0) movePrevious();
+				}
+			} else {
+				forward ? moveNext() : movePrevious();
+			}
+			result.push_back( result.arena(), kv );
+			accumulatedBytes += sizeof(KeyValueRef) + kv.expectedSize();
+			forward ? --rowLimit : ++rowLimit;
+		}
+		return result;
+	}
+
+	// Decodes the key of the current row and at most maxLength bytes of its value.  *index is set to the fragment index of
+	// the row, which is 0 unless the value is fragmented.
+	KeyValueRef getRowPrefix( Arena& arena, int maxLength, uint32_t* index ) {
+		ValueRef encoded = getEncodedRowKeyPrefix( arena, maxLength );
+		KeyValueRef kv;
+		if (db.fragment_values) {
+			kv = decodeKVFragment( encoded, index, true ).get();
+		} else {
+			*index = 0;
+			kv = decodeKVPrefix( encoded, maxLength );
+		}
+		kv.value = kv.value.substr( 0, std::min( kv.value.size(), maxLength ) );
+		return kv;
+	}
+
+	// Reads the first maxLength bytes of the fragmented value of key from its fragments, leaving the cursor somewhere in them
+	ValueRef getFragmentedValuePrefix( Arena& arena, KeyRef key, int maxLength ) {
+		uint8_t* buf = new (arena) uint8_t[maxLength];
+		int length = 0;
+		int r = moveTo( key );
+		if (r < 0) moveNext();
+		while (this->valid && length < maxLength) {
+			uint32_t index;
+			Arena temp;
+			KeyValueRef fragment = getRowPrefix( temp, maxLength - length, &index );
+			if (fragment.key != key) break;
+			memcpy( buf + length, fragment.value.begin(), fragment.value.size() );
+			length += fragment.value.size();
+			moveNext();
+		}
+		return ValueRef( buf, length );
+	}
+
 	int moveTo( KeyRef key, bool ignore_fragment_mode = false ) {
 		UnpackedRecord r;
 		r.pKeyInfo = &keyInfo;
@@ -1149,6 +1397,8 @@ struct RawCursor {
 		int result;
 		db.checkError("BtreeMovetoUnpacked", sqlite3BtreeMovetoUnpacked(cursor, &r, 0, 0, &result));
 		valid = result >= 0 || !sqlite3BtreeEof(cursor);
+		// A seek reads its own pages, so read ahead only once a scan leaves the page it lands in
+		if (prefetchPages) page = sqlite3BtreeCursorPage(cursor);
 		return result;
 	}
 };
@@ -1180,6 +1430,36 @@ private:
 extern bool vfsAsyncIsOpen( std::string filename );
 
 // Returns number of pages which failed checksum.
+// The open flags that have AsyncFileCached cache a database file in pages of its page size, or 0 for 4096 byte pages
+// and any page size that new files are not created with
+static int pageSizeOpenFlags( int pageSize ) {
+	switch( pageSize ) {
+		case 8192: return IAsyncFile::OPEN_8K_PAGES;
+		case 16384: return IAsyncFile::OPEN_16K_PAGES;
+		case 32768: return IAsyncFile::OPEN_32K_PAGES;
+		default: return 0;
+	}
+}
+
+// Opens an existing database file.  If its header gives a page size larger than 4096 bytes, the file is closed and
+// opened again with the flags for that page size, so that SQLite can read its pages from the cache without copying.
+static ErrorOr<Reference<IAsyncFile>> openDatabaseFile( std::string const& path, int flags ) {
+	ErrorOr<Reference<IAsyncFile>> file = waitForAndGet( errorOr( IAsyncFileSystem::filesystem()->open( path, flags, 0 ) ) );
+	if (file.isError())
+		return file;
+
+	uint8_t header[100];
+	ErrorOr<int> headerBytes = waitForAndGet( errorOr( file.get()->read( header, sizeof(header), 0 ) ) );
+	if (headerBytes.isError())
+		return headerBytes.getError();
+	int pageFlags = headerBytes.get() == sizeof(header) ? pageSizeOpenFlags( (header[16] << 8) | header[17] ) : 0;
+	if (pageFlags) {
+		file.get().clear();
+		file = waitForAndGet( errorOr( IAsyncFileSystem::filesystem()->open( path, flags | pageFlags, 0 ) ) );
+	}
+	return file;
+}
+
 int SQLiteDB::checkAllPageChecksums() {
 	ASSERT( !haveMutex );
 	ASSERT( page_checksums );  // This should never be called on SQLite databases that do not have page checksums.
@@ -1194,7 +1474,7 @@ int SQLiteDB::checkAllPageChecksums() {
 
 	TraceEvent("SQLitePageChecksumScanBegin").detail("File", apath);
 
-	ErrorOr<Reference<IAsyncFile>> dbFile = waitForAndGet( errorOr( IAsyncFileSystem::filesystem()->open( apath, IAsyncFile::OPEN_READONLY | IAsyncFile::OPEN_LOCK, 0 ) ) );
+	ErrorOr<Reference<IAsyncFile>> dbFile = openDatabaseFile( apath, IAsyncFile::OPEN_READONLY | IAsyncFile::OPEN_LOCK );
 	ErrorOr<Reference<IAsyncFile>> walFile = waitForAndGet( errorOr( IAsyncFileSystem::filesystem()->open( walpath, IAsyncFile::OPEN_READONLY | IAsyncFile::OPEN_LOCK, 0 ) ) );
 
 	if (dbFile.isError()) throw dbFile.getError(); // If we've failed to open the file, throw an exception
@@ -1280,7 +1560,7 @@ void SQLiteDB::open(bool writable) {
 	// First try to open an existing file
 	std::string apath = abspath(filename);
 	std::string walpath = apath + "-wal";
-	ErrorOr<Reference<IAsyncFile>> dbFile = waitForAndGet( errorOr( IAsyncFileSystem::filesystem()->open( apath, IAsyncFile::OPEN_READWRITE | IAsyncFile::OPEN_LOCK, 0 ) ) );
+	ErrorOr<Reference<IAsyncFile>> dbFile = openDatabaseFile( apath, IAsyncFile::OPEN_READWRITE | IAsyncFile::OPEN_LOCK );
 	ErrorOr<Reference<IAsyncFile>> walFile = waitForAndGet( errorOr( IAsyncFileSystem::filesystem()->open( walpath, IAsyncFile::OPEN_READWRITE | IAsyncFile::OPEN_LOCK, 0 ) ) );
 
 	//TraceEvent("KVThreadInitStage").detail("Stage",15).detail("filename", apath).detail("writable", writable).detail("isErr", dbFile.isError());
@@ -1304,15 +1584,19 @@ void SQLiteDB::open(bool writable) {
 		{
 			// The file doesn't exist, try to create a new one
 			// Creating the WAL before the database ensures we will not try to open a database with no WAL
+			// The page size is chosen now and recorded in the file's header, so changing SQLITE_PAGE_SIZE affects only new files
+			int pageSize = SERVER_KNOBS->SQLITE_PAGE_SIZE;
+			if (pageSize != 4096 && !pageSizeOpenFlags(pageSize)) {
+				TraceEvent(SevWarnAlways, "SQLitePageSizeUnsupported").detail("Filename", apath).detail("PageSize", pageSize);
+				pageSize = 4096;
+			}
 			walFile = waitForAndGet( IAsyncFileSystem::filesystem()->open( walpath, IAsyncFile::OPEN_ATOMIC_WRITE_AND_CREATE | IAsyncFile::OPEN_CREATE | IAsyncFile::OPEN_READWRITE | IAsyncFile::OPEN_LOCK, 0600 ) );
 			waitFor( walFile.get()->sync() );
-			dbFile = waitForAndGet( IAsyncFileSystem::filesystem()->open( apath, IAsyncFile::OPEN_ATOMIC_WRITE_AND_CREATE | IAsyncFile::OPEN_CREATE | IAsyncFile::OPEN_READWRITE | IAsyncFile::OPEN_LOCK, 0600 ) );
-			if(page_checksums)
-				waitFor( dbFile.get()->write( template_fdb_with_page_checksums, sizeof(template_fdb_with_page_checksums), 0 ) );
-			else
-				waitFor( dbFile.get()->write( template_fdb_without_page_checksums, sizeof(template_fdb_without_page_checksums), 0 ) );
+			dbFile = waitForAndGet( IAsyncFileSystem::filesystem()->open( apath, IAsyncFile::OPEN_ATOMIC_WRITE_AND_CREATE | IAsyncFile::OPEN_CREATE | IAsyncFile::OPEN_READWRITE | IAsyncFile::OPEN_LOCK | pageSizeOpenFlags(pageSize), 0600 ) );
+			std::string image = templateDatabase( pageSize, page_checksums );
+			waitFor( dbFile.get()->write( image.data(), image.size(), 0 ) );
 			waitFor( dbFile.get()->sync() ); // renames filename.part to filename, fsyncs data and directory
-			TraceEvent("CreatedDBFile").detail("Filename", apath);
+			TraceEvent("CreatedDBFile").detail("Filename", apath).detail("PageSize", pageSize);
 		}
 	}
 	if (dbFile.isError()) throw dbFile.getError(); // If we've failed to open the file, throw an exception
@@ -1327,6 +1611,7 @@ void SQLiteDB::open(bool writable) {
 
 	btree = db->aDb[0].pBt;
 	initPagerCodec();
+	initFragmentSizes();
 
 	sqlite3_extended_result_codes(db, 1);
 
@@ -1426,39 +1711,52 @@ public:
 
 	virtual Future<Optional<Value>> readValue( KeyRef key, Optional<UID> debugID );
 	virtual Future<Optional<Value>> readValuePrefix( KeyRef key, int maxLength, Optional<UID> debugID );
+	virtual Future<std::vector<Optional<Value>>> readValues( std::vector<std::pair<KeyRef, int>> const& keys, Optional<UID> debugID );
 	virtual Future<Standalone<VectorRef<KeyValueRef>>> readRange( KeyRangeRef keys, int rowLimit = 1<<30, int byteLimit = 1<<30 );
+	virtual Future<Standalone<VectorRef<KeyValueRef>>> readRangePrefix( KeyRangeRef keys, int maxLength, int rowLimit = 1<<30, int byteLimit = 1<<30 );
 
 	KeyValueStoreSQLite(std::string const& filename, UID logID, KeyValueStoreType type, bool checkChecksums, bool checkIntegrity);
 	~KeyValueStoreSQLite();
 
-	Future<Void> doClean();
+	Future<Void> doClean( double timeBudget );
 	void startReadThreads();
+	void addReadThreads();
 
 private:
 	KeyValueStoreType type;
 	UID logID;
 	std::string filename;
+	// Both pools are coroutine pools (CoroThreadPool) running on the network thread, since SQLite is built without
+	// thread safety and does its I/O through VFSAsync.  Splitting a store into several B-trees with a writer each would
+	// therefore overlap more disk I/O but not use more cores; CPU-bound write throughput scales by running more
+	// fdbserver processes per host.
 	Reference<IThreadPool> readThreads, writeThread;
+	int readerThreads;  // Started so far, each with its own connection and readCursors[] entry
+	bool readersStarted;
 	Promise<Void> stopped;
 	Future<Void> cleaning, logging, starting, stopOnErr;
 
 	int64_t readsRequested, writesRequested;
 	ThreadSafeCounter readsComplete;
+	ThreadLatencyHistogram readLatency, commitLatency;
 	volatile int64_t writesComplete;
 	volatile SpringCleaningStats springCleaningStats;
+	double cleaningTimeBudget;  // Of each spring cleaning action, as set by cleanPeriodically()
 	volatile int64_t diskBytesUsed;
 	volatile int64_t freeListPages;
+	volatile int pageSize;  // Of the file, once the writer has opened it
 
 	vector< Reference<ReadCursor> > readCursors;
 
 	struct Reader : IThreadPoolReceiver {
 		SQLiteDB conn;
 		ThreadSafeCounter& counter;
+		ThreadLatencyHistogram& latency;
 		UID dbgid;
 		Reference<ReadCursor>* ppReadCursor;
 
-		explicit Reader( std::string const& filename, bool is_btree_v2, ThreadSafeCounter& counter, UID dbgid, Reference<ReadCursor>* ppReadCursor )
-			: conn( filename, is_btree_v2, is_btree_v2 ), counter(counter), dbgid(dbgid), ppReadCursor(ppReadCursor)
+		explicit Reader( std::string const& filename, bool is_btree_v2, ThreadSafeCounter& counter, ThreadLatencyHistogram& latency, UID dbgid, Reference<ReadCursor>* ppReadCursor )
+			: conn( filename, is_btree_v2, is_btree_v2 ), counter(counter), latency(latency), dbgid(dbgid), ppReadCursor(ppReadCursor)
 		{
 		}
 		~Reader() {
@@ -1486,11 +1784,12 @@ private:
 			virtual double getTimeEstimate() { return SERVER_KNOBS->READ_VALUE_TIME_ESTIMATE; }
 		};
 		void action( ReadValueAction& rv ) {
-			//double t = timer();
+			double begin = timer();
 			if (rv.debugID.present()) g_traceBatch.addEvent("GetValueDebug", rv.debugID.get().first(), "Reader.Before"); //.detail("TaskID", g_network->getCurrentTask());
 
 			rv.result.send( getCursor()->get().get(rv.key) );
 			++counter;
+			latency.record( timer() - begin );
 
 			if (rv.debugID.present()) g_traceBatch.addEvent("GetValueDebug", rv.debugID.get().first(), "Reader.After"); //.detail("TaskID", g_network->getCurrentTask());
 			//t = timer()-t;
@@ -1506,27 +1805,65 @@ private:
 			virtual double getTimeEstimate() { return SERVER_KNOBS->READ_VALUE_TIME_ESTIMATE; }
 		};
 		void action( ReadValuePrefixAction& rv ) {
-			//double t = timer();
+			double begin = timer();
 			if (rv.debugID.present()) g_traceBatch.addEvent("GetValuePrefixDebug", rv.debugID.get().first(), "Reader.Before"); //.detail("TaskID", g_network->getCurrentTask());
 
 			rv.result.send( getCursor()->get().getPrefix(rv.key, rv.maxLength) );
 			++counter;
+			latency.record( timer() - begin );
 
 			if (rv.debugID.present()) g_traceBatch.addEvent("GetValuePrefixDebug", rv.debugID.get().first(), "Reader.After"); //.detail("TaskID", g_network->getCurrentTask());
 			//t = timer()-t;
 			//if (t >= 1.0) TraceEvent("ReadValuePrefixActionSlow",dbgid).detail("Elapsed", t);
 		}
 
+		struct ReadValuesAction : TypedAction<Reader, ReadValuesAction>, FastAllocated<ReadValuesAction> {
+			Arena arena;
+			std::vector<std::pair<KeyRef, int>> keys;
+			Optional<UID> debugID;
+			ThreadReturnPromise<std::vector<Optional<Value>>> result;
+			template <class It>
+			ReadValuesAction(It begin, It end, Optional<UID> debugID) : debugID(debugID) {
+				keys.reserve(end - begin);
+				for(; begin != end; ++begin)
+					keys.push_back( std::make_pair( KeyRef(arena, begin->first), begin->second ) );
+			}
+			virtual double getTimeEstimate() { return SERVER_KNOBS->READ_VALUE_TIME_ESTIMATE * std::max<int>(keys.size(), 1); }
+		};
+		void action( ReadValuesAction& rv ) {
+			double begin = timer();
+			if (rv.debugID.present()) g_traceBatch.addEvent("GetValuesDebug", rv.debugID.get().first(), "Reader.Before");
+
+			// All of the keys are looked up with one cursor, in key order, so consecutive keys mostly find their pages
+			// already cached from the previous seek
+			Cursor& cursor = getCursor()->get();
+			std::vector<Optional<Value>> values;
+			values.reserve( rv.keys.size() );
+			for(auto& k : rv.keys)
+				values.push_back( cursor.getPrefix(k.first, k.second) );
+			rv.result.send( values );
+			++counter;
+			latency.record( timer() - begin );
+
+			if (rv.debugID.present()) g_traceBatch.addEvent("GetValuesDebug", rv.debugID.get().first(), "Reader.After");
+		}
+
 		struct ReadRangeAction : TypedAction<Reader, ReadRangeAction>, FastAllocated<ReadRangeAction> {
 			KeyRange keys;
 			int rowLimit, byteLimit;
+			int maxLength;  // Of the values returned, or -1 to return whole values
 			ThreadReturnPromise<Standalone<VectorRef<KeyValueRef>>> result;
-			ReadRangeAction(KeyRange keys, int rowLimit, int byteLimit) : keys(keys), rowLimit(rowLimit), byteLimit(byteLimit) {}
+			ReadRangeAction(KeyRange keys, int rowLimit, int byteLimit, int maxLength = -1) : keys(keys), rowLimit(rowLimit), byteLimit(byteLimit), maxLength(maxLength) {}
 			virtual double getTimeEstimate() { return SERVER_KNOBS->READ_RANGE_TIME_ESTIMATE; }
 		};
 		void action( ReadRangeAction& rr ) {
-			rr.result.send( getCursor()->get().getRange(rr.keys, rr.rowLimit, rr.byteLimit) );
+			double begin = timer();
+			if (rr.maxLength >= 0)
+				rr.result.send( getCursor()->get().getRangePrefix(rr.keys, rr.maxLength, rr.rowLimit, rr.byteLimit) );
+			else
+				rr.result.send( getCursor()->get().getRange(rr.keys, rr.rowLimit, rr.byteLimit) );
 			++counter;
+			latency.record( timer() - begin );
 		}
 	};
 
@@ -1537,22 +1874,26 @@ private:
 		int setsThisCommit;
 		bool freeTableEmpty; // true if we are sure the freetable (pages pending lazy deletion) is empty
 		volatile int64_t& writesComplete;
+		ThreadLatencyHistogram& commitLatency;
 		volatile SpringCleaningStats& springCleaningStats;
 		volatile int64_t& diskBytesUsed;
 		volatile int64_t& freeListPages;
+		volatile int& pageSize;
 		UID dbgid;
 		vector<Reference<ReadCursor>>& readThreads;
 		bool checkAllChecksumsOnOpen;
 		bool checkIntegrityOnOpen;
 
-		explicit Writer( std::string const& filename, bool isBtreeV2, bool checkAllChecksumsOnOpen, bool checkIntegrityOnOpen, volatile int64_t& writesComplete, volatile SpringCleaningStats& springCleaningStats, volatile int64_t& diskBytesUsed, volatile int64_t& freeListPages, UID dbgid, vector<Reference<ReadCursor>>* pReadThreads )
+		explicit Writer( std::string const& filename, bool isBtreeV2, bool checkAllChecksumsOnOpen, bool checkIntegrityOnOpen, volatile int64_t& writesComplete, ThreadLatencyHistogram& commitLatency, volatile SpringCleaningStats& springCleaningStats, volatile int64_t& diskBytesUsed, volatile int64_t& freeListPages, volatile int& pageSize, UID dbgid, vector<Reference<ReadCursor>>* pReadThreads )
 			: conn( filename, isBtreeV2, isBtreeV2 ),
 			  commits(), setsThisCommit(),
 			  freeTableEmpty(false),
 			  writesComplete(writesComplete),
+			  commitLatency(commitLatency),
 			  springCleaningStats(springCleaningStats),
 			  diskBytesUsed(diskBytesUsed),
 			  freeListPages(freeListPages),
+			  pageSize(pageSize),
 			  cursor(NULL),
 			  dbgid(dbgid),
 			  readThreads(*pReadThreads),
@@ -1576,6 +1917,7 @@ private:
 				}
 			}
 			conn.open(true);
+			pageSize = conn.pageSize();
 
 			//If a wal file fails during the commit process before finishing a checkpoint, then it is possible that our wal file will be non-empty
 			//when we reload it.  We execute a checkpoint here to remedy that situation.  This call must come before before creating a cursor because
@@ -1627,11 +1969,16 @@ private:
 		};
 		void action(ClearAction& a) {
 			double s = now();
-			cursor->fastClear(a.range, freeTableEmpty);
-			cursor->clear(a.range);  // TODO: at most one
+			int queuedSubtrees = cursor->fastClear(a.range, freeTableEmpty);
+			// fastClear() can only leave behind the first key of the range, when it is held in an interior page (and, with
+			// fragmented values, the other fragments of that key), so this removes at most one key
+			cursor->clear(a.range);
 			++writesComplete;
+			double elapsed = now()-s;
+			if (elapsed > 10.0*g_random->random01())
+				TraceEvent("KVClear10s_sample", dbgid).detail("Elapsed", elapsed).detail("QueuedSubtrees", queuedSubtrees);
 			if (g_network->isSimulated() && g_simulator.getCurrentProcess()->rebooting)
-				TraceEvent("ClearActionFinished", dbgid).detail("Elapsed", now()-s);
+				TraceEvent("ClearActionFinished", dbgid).detail("Elapsed", elapsed);
 		}
 
 		struct CommitAction : TypedAction<Writer, CommitAction>, FastAllocated<CommitAction> {
@@ -1661,6 +2008,7 @@ private:
 			cursor = new Cursor(conn, true);
 			checkFreePages();
 			++writesComplete;
+			commitLatency.record( t3-t1 );
 			if (t3-a.issuedTime > 10.0*g_random->random01())
 				TraceEvent("KVCommit10s_sample", dbgid).detail("Queued", t1-a.issuedTime).detail("Commit", t2-t1).detail("Checkpoint", t3-t2);
 
@@ -1704,12 +2052,18 @@ private:
 		}
 
 		struct SpringCleaningAction : TypedAction<Writer, SpringCleaningAction>, FastAllocated<SpringCleaningAction> {
+			double timeBudget;
 			ThreadReturnPromise<Void> result;
-			virtual double getTimeEstimate() { return SERVER_KNOBS->SPRING_CLEANING_TIME_ESTIMATE; }
+			explicit SpringCleaningAction( double timeBudget ) : timeBudget(timeBudget) {}
+			virtual double getTimeEstimate() { return timeBudget; }
 		};
 		void action(SpringCleaningAction& a) {
+			// Vacuuming and lazy deletion are scheduled as background disk I/O (see IOClassQueue), below commits and reads
+			int taskId = g_network->getCurrentTask();
+			g_network->setCurrentTask(TaskDiskBackground);
+
 			double s = now();
-			double end = now() + SERVER_KNOBS->SPRING_CLEANING_TIME_ESTIMATE;
+			double end = now() + a.timeBudget;
 
 			int lazyDeletePages = 0;
 			int vacuumedPages = 0;
@@ -1766,10 +2120,12 @@ private:
 			++springCleaningStats.springCleaningCount;
 			springCleaningStats.lazyDeletePages += lazyDeletePages;
 			springCleaningStats.vacuumedPages += vacuumedPages;
+			springCleaningStats.reclaimedBytes += (int64_t)vacuumedPages * pageSize;
 			springCleaningStats.springCleaningTime += now() - s;
 			springCleaningStats.vacuumTime += vacuumTime;
 			springCleaningStats.lazyDeleteTime += lazyDeleteTime;
 
+			g_network->setCurrentTask(taskId);
 			a.result.send(Void());
 			++writesComplete;
 			if (g_network->isSimulated() && g_simulator.getCurrentProcess()->rebooting)
@@ -1778,9 +2134,52 @@ private:
 	};
 
 
+	// Spring cleaning runs for cleaningTimeBudget every CLEANING_INTERVAL.  The budget is halved while the mean latency of
+	// reads is over SPRING_CLEANING_BACKOFF_READ_LATENCY, since cleaning then competes with foreground traffic, and doubled
+	// while the store is idle or its disk is nearly full and there are free pages to return.  Otherwise it returns to
+	// SPRING_CLEANING_TIME_ESTIMATE.
+	ACTOR static Future<Void> cleanPeriodically( KeyValueStoreSQLite* self ) {
+		state int64_t lastReads = 0;
+		state int64_t lastReadMicroseconds = 0;
+		loop {
+			Void _ = wait( delayJittered(SERVER_KNOBS->CLEANING_INTERVAL) );
+
+			int64_t reads = self->readLatency.getCount();
+			int64_t readMicroseconds = self->readLatency.getTotalMicroseconds();
+			double readLatency = reads > lastReads ? (readMicroseconds - lastReadMicroseconds) * 1e-6 / (reads - lastReads) : 0;
+			lastReads = reads;
+			lastReadMicroseconds = readMicroseconds;
+
+			bool idle = self->readsRequested == (int64_t)self->readsComplete && self->writesRequested == self->writesComplete &&
+				readLatency < SERVER_KNOBS->SPRING_CLEANING_BACKOFF_READ_LATENCY / 2;
+			StorageBytes storageBytes = self->getStorageBytes();
+			bool lowSpace = self->freeListPages && storageBytes.free < storageBytes.total * SERVER_KNOBS->SPRING_CLEANING_LOW_FREE_SPACE_RATIO;
+			bool busy = readLatency > SERVER_KNOBS->SPRING_CLEANING_BACKOFF_READ_LATENCY;
+
+			double budget = self->cleaningTimeBudget;
+			if( busy ) {
+				// A nearly full disk still gets the usual amount of cleaning
+				TEST( true ); // Spring cleaning backs off from slow reads
+				budget = std::max( budget / 2, lowSpace ? SERVER_KNOBS->SPRING_CLEANING_TIME_ESTIMATE : SERVER_KNOBS->SPRING_CLEANING_MIN_TIME_ESTIMATE );
+			} else if( idle || lowSpace ) {
+				TEST( lowSpace ); // Spring cleaning speeds up for low free space
+				TEST( idle ); // Spring cleaning speeds up while idle
+				budget = std::min( budget * 2, SERVER_KNOBS->SPRING_CLEANING_MAX_TIME_ESTIMATE );
+			} else if( budget > SERVER_KNOBS->SPRING_CLEANING_TIME_ESTIMATE ) {
+				budget = std::max( budget / 2, SERVER_KNOBS->SPRING_CLEANING_TIME_ESTIMATE );
+			} else {
+				budget = std::min( budget * 2, SERVER_KNOBS->SPRING_CLEANING_TIME_ESTIMATE );
+			}
+			self->cleaningTimeBudget = budget;
+
+			Void _ = wait( self->doClean( budget ) );
+		}
+	}
+
 	ACTOR static Future<Void> logPeriodically( KeyValueStoreSQLite* self ) {
 		state int64_t lastReadsComplete = 0;
 		state int64_t lastWritesComplete = 0;
+		state int64_t lastReclaimedBytes = 0;
 		loop {
 			Void _ = wait( delay(SERVER_KNOBS->DISK_METRIC_LOGGING_INTERVAL) );
 
@@ -1790,6 +2189,7 @@ private:
 				.detail("WriteOps", wc - lastWritesComplete)
 				.detail("ReadQueue", self->readsRequested - rc)
 				.detail("WriteQueue", self->writesRequested - wc)
+				.detail("ReaderThreads", self->readerThreads)
 				.detail("GlobalSQLiteMemoryHighWater", (int64_t)sqlite3_memory_highwater(1));
 
 			TraceEvent("SpringCleaningMetrics", self->logID)
@@ -1798,10 +2198,14 @@ private:
 				.detail("VacuumedPages", self->springCleaningStats.vacuumedPages)
 				.detail("SpringCleaningTime", self->springCleaningStats.springCleaningTime)
 				.detail("LazyDeleteTime", self->springCleaningStats.lazyDeleteTime)
-				.detail("VacuumTime", self->springCleaningStats.vacuumTime);
+				.detail("VacuumTime", self->springCleaningStats.vacuumTime)
+				.detail("ReclaimedBytesPerSecond", (self->springCleaningStats.reclaimedBytes - lastReclaimedBytes) / SERVER_KNOBS->DISK_METRIC_LOGGING_INTERVAL)
+				.detail("FreeListPages", self->freeListPages)
+				.detail("TimeBudget", self->cleaningTimeBudget);
 
 			lastReadsComplete = self->readsComplete;
 			lastWritesComplete = self->writesComplete;
+			lastReclaimedBytes = self->springCleaningStats.reclaimedBytes;
 		}
 	}
 
@@ -1839,6 +2243,7 @@ private:
 
 		TraceEvent("KVClosed", self->logID);
 		if( error.code() != error_code_actor_cancelled ) {
+			processReaderThreads() -= self->readerThreads;
 			self->stopped.send(Void());
 			delete self;
 		}
@@ -1848,13 +2253,6 @@ IKeyValueStore* keyValueStoreSQLite( std::string const& filename, UID logID, Key
 	return new KeyValueStoreSQLite(filename, logID, storeType, checkChecksums, checkIntegrity);
 }
 
-ACTOR Future<Void> cleanPeriodically( KeyValueStoreSQLite* self ) {
-	loop {
-		Void _ = wait( delayJittered(SERVER_KNOBS->CLEANING_INTERVAL) );
-		Void _ = wait( self->doClean() );
-	}
-}
-
 ACTOR static Future<Void> startReadThreadsWhen( KeyValueStoreSQLite* kv, Future<Void> onReady, UID id ) {
 	Void _ = wait(onReady);
 	kv->startReadThreads();
@@ -1868,9 +2266,11 @@ KeyValueStoreSQLite::KeyValueStoreSQLite(std::string const& filename, UID id, Ke
 	: type(storeType),
 	  filename(filename),
 	  logID(id),
-	  readThreads(CoroThreadPool::createThreadPool()),
-	  writeThread(CoroThreadPool::createThreadPool()),
-	  readsRequested(0), writesRequested(0), writesComplete(0), diskBytesUsed(0), freeListPages(0)
+	  readThreads(CoroThreadPool::createThreadPool("SQLiteReader")),
+	  writeThread(CoroThreadPool::createThreadPool("SQLiteWriter")),
+	  readerThreads(0), readersStarted(false),
+	  readsRequested(0), writesRequested(0), writesComplete(0), cleaningTimeBudget(SERVER_KNOBS->SPRING_CLEANING_TIME_ESTIMATE), diskBytesUsed(0), freeListPages(0), pageSize(4096),
+	  readLatency("SQLite.ReadLatency", StringRef(id.toString())), commitLatency("SQLite.CommitLatency", StringRef(id.toString()))
 {
 	stopOnErr = stopOnError(this);
 
@@ -1885,12 +2285,12 @@ KeyValueStoreSQLite::KeyValueStoreSQLite(std::string const& filename, UID id, Ke
 	//The DB file should not already be open
 	ASSERT(!vfsAsyncIsOpen(filename));
 
-	readCursors.resize(64); //< number of read threads
+	readCursors.resize(std::max(SERVER_KNOBS->SQLITE_READER_THREADS, 1)); //< most read threads; they are started by addReadThreads()
 
 	sqlite3_soft_heap_limit64( SERVER_KNOBS->SOFT_HEAP_LIMIT );  // SOMEDAY: Is this a performance issue?  Should we drop the cache sizes for individual threads?
 	int taskId = g_network->getCurrentTask();
 	g_network->setCurrentTask(TaskDiskWrite);
-	writeThread->addThread( new Writer(filename, type==KeyValueStoreType::SSD_BTREE_V2, checkChecksums, checkIntegrity, writesComplete, springCleaningStats, diskBytesUsed, freeListPages, id, &readCursors) );
+	writeThread->addThread( new Writer(filename, type==KeyValueStoreType::SSD_BTREE_V2, checkChecksums, checkIntegrity, writesComplete, commitLatency, springCleaningStats, diskBytesUsed, freeListPages, pageSize, id, &readCursors) );
 	g_network->setCurrentTask(taskId);
 	auto p = new Writer::InitAction();
 	auto f = p->result.getFuture();
@@ -1909,16 +2309,34 @@ StorageBytes KeyValueStoreSQLite::getStorageBytes() {
 
 	g_network->getDiskBytes(parentDirectory(filename), free, total);
 
-	return StorageBytes(free, total, diskBytesUsed, free + _PAGE_SIZE * freeListPages);
+	return StorageBytes(free, total, diskBytesUsed, free + (int64_t)pageSize * freeListPages);
 }
 
 void KeyValueStoreSQLite::startReadThreads() {
-	int nReadThreads = readCursors.size();
+	readersStarted = true;
+	addReadThreads();
+}
+
+// A store starts with one reader and adds more, up to SQLITE_READER_THREADS, while it has more reads queued than
+// readers.  Beyond its first reader a store draws on SQLITE_PROCESS_READER_THREADS, which all of the SQLite stores in
+// the process share, so the storage servers a worker hosts get readers (and the connections and coroutine stacks that
+// go with them) according to their load rather than a fixed number each.
+void KeyValueStoreSQLite::addReadThreads() {
+	if (!readersStarted) return;
+	int& processReaders = processReaderThreads();
+	int64_t queued = readsRequested - (int64_t)readsComplete;
+	if (readerThreads && (queued <= readerThreads || readerThreads >= readCursors.size() || processReaders >= SERVER_KNOBS->SQLITE_PROCESS_READER_THREADS))
+		return;
+
 	int taskId = g_network->getCurrentTask();
 	g_network->setCurrentTask(TaskDiskRead);
-	for(int i=0; i<nReadThreads; i++)
-		readThreads->addThread( new Reader(filename, type==KeyValueStoreType::SSD_BTREE_V2, readsComplete, logID, &readCursors[i]) );
+	do {
+		readThreads->addThread( new Reader(filename, type==KeyValueStoreType::SSD_BTREE_V2, readsComplete, readLatency, logID, &readCursors[readerThreads]) );
+		++readerThreads;
+		++processReaders;
+	} while (queued > readerThreads && readerThreads < readCursors.size() && processReaders < SERVER_KNOBS->SQLITE_PROCESS_READER_THREADS);
 	g_network->setCurrentTask(taskId);
+	TEST(readerThreads > 1); // SQLite store added a reader for its queued reads
 }
 
 void KeyValueStoreSQLite::set( KeyValueRef keyValue, const Arena* arena ) {
@@ -1941,6 +2359,7 @@ Future<Optional<Value>> KeyValueStoreSQLite::readValue( KeyRef key, Optional<UID
 	auto p = new Reader::ReadValueAction(key, debugID);
 	auto f = p->result.getFuture();
 	readThreads->post(p);
+	addReadThreads();
 	return f;
 }
 Future<Optional<Value>> KeyValueStoreSQLite::readValuePrefix( KeyRef key, int maxLength, Optional<UID> debugID ) {
@@ -1948,18 +2367,55 @@ Future<Optional<Value>> KeyValueStoreSQLite::readValuePrefix( KeyRef key, int ma
 	auto p = new Reader::ReadValuePrefixAction(key, maxLength, debugID);
 	auto f = p->result.getFuture();
 	readThreads->post(p);
+	addReadThreads();
 	return f;
 }
+ACTOR static Future<std::vector<Optional<Value>>> concatenateValues( std::vector<Future<std::vector<Optional<Value>>>> parts ) {
+	std::vector<std::vector<Optional<Value>>> results = wait( getAll(parts) );
+	state std::vector<Optional<Value>> values;
+	for(auto& r : results)
+		values.insert( values.end(), r.begin(), r.end() );
+	return values;
+}
+
+Future<std::vector<Optional<Value>>> KeyValueStoreSQLite::readValues( std::vector<std::pair<KeyRef, int>> const& keys, Optional<UID> debugID ) {
+	if (keys.empty()) return std::vector<Optional<Value>>();
+
+	// A batch is split into runs of consecutive keys that different readers look up at the same time, so that the
+	// page misses of one run do not hold up the others.  Each run still shares one cursor.
+	int perAction = std::max(SERVER_KNOBS->SQLITE_READ_VALUES_PER_ACTION, 1);
+	std::vector<Future<std::vector<Optional<Value>>>> parts;
+	for(int i = 0; i < keys.size(); i += perAction) {
+		++readsRequested;
+		auto p = new Reader::ReadValuesAction(keys.begin() + i, keys.begin() + std::min<int>(i + perAction, keys.size()), debugID);
+		parts.push_back( p->result.getFuture() );
+		readThreads->post(p);
+	}
+	addReadThreads();
+	if (parts.size() == 1)
+		return parts[0];
+	TEST(true); // readValues batch split among SQLite readers
+	return concatenateValues( parts );
+}
 Future<Standalone<VectorRef<KeyValueRef>>> KeyValueStoreSQLite::readRange( KeyRangeRef keys, int rowLimit, int byteLimit ) {
 	++readsRequested;
 	auto p = new Reader::ReadRangeAction(keys, rowLimit, byteLimit);
 	auto f = p->result.getFuture();
 	readThreads->post(p);
+	addReadThreads();
+	return f;
+}
+Future<Standalone<VectorRef<KeyValueRef>>> KeyValueStoreSQLite::readRangePrefix( KeyRangeRef keys, int maxLength, int rowLimit, int byteLimit ) {
+	++readsRequested;
+	auto p = new Reader::ReadRangeAction(keys, rowLimit, byteLimit, maxLength);
+	auto f = p->result.getFuture();
+	readThreads->post(p);
+	addReadThreads();
 	return f;
 }
-Future<Void> KeyValueStoreSQLite::doClean() {
+Future<Void> KeyValueStoreSQLite::doClean( double timeBudget ) {
 	++writesRequested;
-	auto p = new Writer::SpringCleaningAction;
+	auto p = new Writer::SpringCleaningAction( timeBudget );
 	auto f = p->result.getFuture();
 	writeThread->post(p);
 	return f;
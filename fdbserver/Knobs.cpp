@@ -28,6 +28,7 @@ ServerKnobs const* SERVER_KNOBS = new ServerKnobs();
 ServerKnobs::ServerKnobs(bool randomize, ClientKnobs* clientKnobs) {
 	// TLogs
 	init( TLOG_TIMEOUT,                                          0.4 ); //cannot buggify because of availability
+	init( TLOG_SLOW_COMMIT_WARNING_TIME,                         0.1 ); if( randomize && BUGGIFY ) TLOG_SLOW_COMMIT_WARNING_TIME = 0.0;
 	init( RECOVERY_TLOG_SMART_QUORUM_DELAY,                     0.25 ); if( randomize && BUGGIFY ) RECOVERY_TLOG_SMART_QUORUM_DELAY = 0.0; // smaller might be better for bug amplification
 	init( TLOG_STORAGE_MIN_UPDATE_INTERVAL,                      0.5 );
 	init( BUGGIFY_TLOG_STORAGE_MIN_UPDATE_INTERVAL,               30 );
@@ -45,14 +46,27 @@ ServerKnobs::ServerKnobs(bool randomize, ClientKnobs* clientKnobs) {
 	init( TLOG_PEEK_DELAY,                                   0.00005 );
 	init( LEGACY_TLOG_UPGRADE_ENTRIES_PER_VERSION,               100 );
 	init( VERSION_MESSAGES_OVERHEAD_FACTOR_1024THS,             1072 ); // Based on a naive interpretation of the gcc version of std::deque, we would expect this to be 16 bytes overhead per 512 bytes data. In practice, it seems to be 24 bytes overhead per 512.
-	init( VERSION_MESSAGES_ENTRY_BYTES_WITH_OVERHEAD, std::ceil(16.0 * VERSION_MESSAGES_OVERHEAD_FACTOR_1024THS / 1024) );
 	init( LOG_SYSTEM_PUSHED_DATA_BLOCK_SIZE,                     1e5 );
 	init( MAX_MESSAGE_SIZE,            std::max<int>(LOG_SYSTEM_PUSHED_DATA_BLOCK_SIZE, 1e5 + 2e4 + 1) + 8 ); // VALUE_SIZE_LIMIT + SYSTEM_KEY_SIZE_LIMIT + 9 bytes (4 bytes for length, 4 bytes for sequence number, and 1 byte for mutation type)
 	init( TLOG_MESSAGE_BLOCK_BYTES,                             10e6 );
 	init( TLOG_MESSAGE_BLOCK_OVERHEAD_FACTOR,      double(TLOG_MESSAGE_BLOCK_BYTES) / (TLOG_MESSAGE_BLOCK_BYTES - MAX_MESSAGE_SIZE) ); //1.0121466709838096006362758832473
 	init( PEEK_TRACKER_EXPIRATION_TIME,                          600 ); if( randomize && BUGGIFY ) PEEK_TRACKER_EXPIRATION_TIME = g_random->coinflip() ? 0.1 : 60;
 	init( PARALLEL_GET_MORE_REQUESTS,                             32 ); if( randomize && BUGGIFY ) PARALLEL_GET_MORE_REQUESTS = 2;
+	init( PARALLEL_GET_MORE_MAX_REQUESTS,                        128 ); if( randomize && BUGGIFY ) PARALLEL_GET_MORE_MAX_REQUESTS = 4;
+	init( PEEK_REPLY_COMPRESSION,                                  0 ); if( randomize && BUGGIFY ) PEEK_REPLY_COMPRESSION = 1;
+	init( PEEK_REPLY_COMPRESSION_LEVEL,                            1 );
+	init( PEEK_REPLY_COMPRESSION_MIN_BYTES,                     1000 ); if( randomize && BUGGIFY ) PEEK_REPLY_COMPRESSION_MIN_BYTES = 0;
+	init( TLOG_SPILL_REFERENCE,                                    0 ); if( randomize && BUGGIFY ) TLOG_SPILL_REFERENCE = 1;
+	init( TLOG_SPILL_REFERENCE_MAX_PEEK_BYTES,                   1e6 ); if( randomize && BUGGIFY ) TLOG_SPILL_REFERENCE_MAX_PEEK_BYTES = 20000;
+	init( TLOG_PEEK_CACHE_BYTES,                                10e6 ); if( randomize && BUGGIFY ) TLOG_PEEK_CACHE_BYTES = g_random->coinflip() ? 0 : 20000;
 	init( MAX_QUEUE_COMMIT_BYTES,                               15e6 ); if( randomize && BUGGIFY ) MAX_QUEUE_COMMIT_BYTES = 5000;
+	init( TLOG_GROUP_COMMIT_BYTES,                             100e3 ); if( randomize && BUGGIFY ) TLOG_GROUP_COMMIT_BYTES = g_random->coinflip() ? 0 : 1e6;
+	init( TLOG_GROUP_COMMIT_MAX_DELAY,                         0.001 ); if( randomize && BUGGIFY ) TLOG_GROUP_COMMIT_MAX_DELAY = 0.05;
+	init( TLOG_GROUP_COMMIT_LATENCY_FRACTION,                    0.5 );
+	init( DISK_QUEUE_FILE_EXTENSION_BYTES,                  10<<20 );
+	init( DISK_QUEUE_FILE_PREALLOCATE_BYTES,                       0 ); if( randomize && BUGGIFY ) DISK_QUEUE_FILE_PREALLOCATE_BYTES = 1<<20;
+	init( DISK_QUEUE_RECOVERY_READ_AHEAD,                          8 ); if( randomize && BUGGIFY ) DISK_QUEUE_RECOVERY_READ_AHEAD = 1;
+	init( PAGE_CHECKSUM_FORMAT,                                    0 ); if( randomize && BUGGIFY ) PAGE_CHECKSUM_FORMAT = 1;
 
 	// Versions
 	init( MAX_VERSIONS_IN_FLIGHT,                          100000000 );
@@ -79,6 +93,9 @@ ServerKnobs::ServerKnobs(bool randomize, ClientKnobs* clientKnobs) {
 	init( INFLIGHT_PENALTY_HEALTHY,                              1.0 );
 	init( INFLIGHT_PENALTY_UNHEALTHY,                           10.0 );
 	init( INFLIGHT_PENALTY_ONE_LEFT,                          1000.0 );
+	init( DD_SERVER_LOAD_THRESHOLD,                              0.5 ); if( randomize && BUGGIFY ) DD_SERVER_LOAD_THRESHOLD = 0.1;
+	init( DD_SERVER_LOAD_PENALTY,                               10.0 );
+	init( DD_SERVER_CPU_TARGET,                                  0.9 ); // Fraction of one core the storage server process may use before moves avoid it
 
 	// Data distribution
 	init( RETRY_RELOCATESHARD_DELAY,                             0.1 );
@@ -127,7 +144,23 @@ ServerKnobs::ServerKnobs(bool randomize, ClientKnobs* clientKnobs) {
 		If this value is too small relative to SHARD_MIN_BYTES_PER_KSEC immediate merging work will be generated.
 		*/
 
+	bool buggifySmallReadBandwidthSplit = randomize && BUGGIFY;
+	init( SHARD_MAX_BYTES_READ_PER_KSEC,           20LL*1000000*1000 ); if( buggifySmallReadBandwidthSplit ) SHARD_MAX_BYTES_READ_PER_KSEC = 100LL*1000*1000;
+	/* 20MB/sec * 1000sec/ksec
+		Shards with more than this read bandwidth will be split immediately, so that the pieces can be served by other teams.
+		A read hot shard otherwise keeps one team busy no matter how idle the rest of the cluster is.  Reads are cheaper to serve
+		than writes, so this is well above SHARD_MAX_BYTES_PER_KSEC.  Read bandwidth never prevents merging, except that a merge
+		stops before the merged shard would itself be read hot.
+		*/
+
+	init( SHARD_SPLIT_BYTES_READ_PER_KSEC,          5LL*1000000*1000 ); if( buggifySmallReadBandwidthSplit ) SHARD_SPLIT_BYTES_READ_PER_KSEC = 25LL*1000*1000;
+	/* 5MB/sec * 1000sec/ksec
+		When splitting a shard for its read bandwidth, it is split into pieces with less than this read bandwidth.
+		Obviously this should be less than half of SHARD_MAX_BYTES_READ_PER_KSEC.
+		*/
+
 	init( STORAGE_METRIC_TIMEOUT,                              600.0 ); if( randomize && BUGGIFY ) STORAGE_METRIC_TIMEOUT = g_random->coinflip() ? 10.0 : 60.0;
+	init( STORAGE_METRICS_BATCH_POLL_DELAY,                      0.5 ); if( randomize && BUGGIFY ) STORAGE_METRICS_BATCH_POLL_DELAY = 0.05;
 	init( METRIC_DELAY,                                          0.1 ); if( randomize && BUGGIFY ) METRIC_DELAY = 1.0;
 	init( ALL_DATA_REMOVED_DELAY,                                1.0 );
 	init( INITIAL_FAILURE_REACTION_DELAY,                       30.0 ); if( randomize && BUGGIFY ) INITIAL_FAILURE_REACTION_DELAY = 0.0;
@@ -149,6 +182,7 @@ ServerKnobs::ServerKnobs(bool randomize, ClientKnobs* clientKnobs) {
 	init( DD_SHARD_SIZE_GRANULARITY,                         5000000 );
 	init( DD_SHARD_SIZE_GRANULARITY_SIM,                      500000 ); if( randomize && BUGGIFY ) DD_SHARD_SIZE_GRANULARITY_SIM = 0;
 	init( DD_MOVE_KEYS_PARALLELISM,                               20 ); if( randomize && BUGGIFY ) DD_MOVE_KEYS_PARALLELISM = 1;
+	init( DD_MOVE_KEYS_COALESCE_LIMIT,                           100 ); if( randomize && BUGGIFY ) DD_MOVE_KEYS_COALESCE_LIMIT = g_random->randomInt(1, 4); // 1 starts every move by itself
 	init( DD_MERGE_LIMIT,                                       2000 ); if( randomize && BUGGIFY ) DD_MERGE_LIMIT = 2;
 	init( DD_SHARD_METRICS_TIMEOUT,                             60.0 ); if( randomize && BUGGIFY ) DD_SHARD_METRICS_TIMEOUT = 0.1;
 	init( DD_LOCATION_CACHE_SIZE,                            2000000 ); if( randomize && BUGGIFY ) DD_LOCATION_CACHE_SIZE = 3;
@@ -165,9 +199,14 @@ ServerKnobs::ServerKnobs(bool randomize, ClientKnobs* clientKnobs) {
 	init( CHECK_FREE_PAGE_AMOUNT,                                100 ); if( randomize && BUGGIFY ) CHECK_FREE_PAGE_AMOUNT = 5;
 	init( DISK_METRIC_LOGGING_INTERVAL,                          5.0 );
 	init( SOFT_HEAP_LIMIT,                                     300e6 );
+	init( SQLITE_READER_THREADS,                                  64 ); if( randomize && BUGGIFY ) SQLITE_READER_THREADS = g_random->randomInt(1, 5); // Most reads in flight per store; with the coroutine pool each reader yields on a page miss
+	init( SQLITE_PROCESS_READER_THREADS,                         256 ); if( randomize && BUGGIFY ) SQLITE_PROCESS_READER_THREADS = g_random->randomInt(1, 9); // Readers all of a process's stores may start beyond their first
+	init( SQLITE_READ_VALUES_PER_ACTION,                          32 ); if( randomize && BUGGIFY ) SQLITE_READ_VALUES_PER_ACTION = g_random->randomInt(1, 5); // Larger readValues() batches are split among the readers
+	init( SQLITE_READ_PREFETCH_PAGES,                              8 ); if( randomize && BUGGIFY ) SQLITE_READ_PREFETCH_PAGES = g_random->randomInt(0, 65); // Leaf and overflow pages read ahead of a range read, at most 64
 
 	init( SQLITE_PAGE_SCAN_ERROR_LIMIT,                        10000 );
-	init( SQLITE_BTREE_PAGE_USABLE,                          4096 - 8);  // pageSize - reserveSize for page checksum
+	init( SQLITE_PAGE_SIZE,                                     4096 ); if( randomize && BUGGIFY ) SQLITE_PAGE_SIZE = 4096 << g_random->randomInt(0, 4); // Of new data files: 4096, 8192, 16384 or 32768
+	init( SQLITE_BTREE_PAGE_USABLE,                          4096 - 8);  // pageSize - reserveSize for page checksum, of a 4096 byte page.  Files with larger pages adjust the fragment sizes below to theirs.
 
 	// Maximum and minimum cell payload bytes allowed on primary page as calculated in SQLite.
 	// These formulas are copied from SQLite, using its hardcoded constants, so if you are
@@ -194,6 +233,10 @@ ServerKnobs::ServerKnobs(bool randomize, ClientKnobs* clientKnobs) {
 	// KeyValueStoreSqlite spring cleaning
 	init( CLEANING_INTERVAL,                                     1.0 );
 	init( SPRING_CLEANING_TIME_ESTIMATE,                        .010 );
+	init( SPRING_CLEANING_MIN_TIME_ESTIMATE,                    .001 );
+	init( SPRING_CLEANING_MAX_TIME_ESTIMATE,                    .250 ); if( randomize && BUGGIFY ) SPRING_CLEANING_MAX_TIME_ESTIMATE = SPRING_CLEANING_TIME_ESTIMATE;
+	init( SPRING_CLEANING_BACKOFF_READ_LATENCY,                 .005 ); if( randomize && BUGGIFY ) SPRING_CLEANING_BACKOFF_READ_LATENCY = g_random->coinflip() ? 0 : 1e6; // Of the store's reads, on average since the last cleaning
+	init( SPRING_CLEANING_LOW_FREE_SPACE_RATIO,                  0.1 ); if( randomize && BUGGIFY ) SPRING_CLEANING_LOW_FREE_SPACE_RATIO = 1.0;
 	init( SPRING_CLEANING_VACUUMS_PER_LAZY_DELETE_PAGE,          0.0 ); if( randomize && BUGGIFY ) SPRING_CLEANING_VACUUMS_PER_LAZY_DELETE_PAGE = g_random->coinflip() ? 1e9 : g_random->random01() * 5;
 	init( SPRING_CLEANING_MIN_LAZY_DELETE_PAGES,                   0 ); if( randomize && BUGGIFY ) SPRING_CLEANING_MIN_LAZY_DELETE_PAGES = g_random->randomInt(1, 100);
 	init( SPRING_CLEANING_MAX_LAZY_DELETE_PAGES,                 1e9 ); if( randomize && BUGGIFY ) SPRING_CLEANING_MAX_LAZY_DELETE_PAGES = g_random->coinflip() ? 0 : g_random->randomInt(1, 1e4);
@@ -201,12 +244,21 @@ ServerKnobs::ServerKnobs(bool randomize, ClientKnobs* clientKnobs) {
 	init( SPRING_CLEANING_MIN_VACUUM_PAGES,                        1 ); if( randomize && BUGGIFY ) SPRING_CLEANING_MIN_VACUUM_PAGES = g_random->randomInt(0, 100);
 	init( SPRING_CLEANING_MAX_VACUUM_PAGES,                      1e9 ); if( randomize && BUGGIFY ) SPRING_CLEANING_MAX_VACUUM_PAGES = g_random->coinflip() ? 0 : g_random->randomInt(1, 1e4);
 
+	// KeyValueStoreLSM
+	init( LSM_MEMTABLE_BYTES,                                   64e6 ); if( randomize && BUGGIFY ) LSM_MEMTABLE_BYTES = g_random->randomInt(1000, 1e6);
+	init( LSM_BLOCK_BYTES,                                     16384 ); if( randomize && BUGGIFY ) LSM_BLOCK_BYTES = g_random->randomInt(1, 4096);
+	init( LSM_BLOOM_BITS_PER_KEY,                                 10 ); if( randomize && BUGGIFY ) LSM_BLOOM_BITS_PER_KEY = g_random->randomInt(1, 16);
+	init( LSM_MAX_RUNS,                                            8 ); if( randomize && BUGGIFY ) LSM_MAX_RUNS = g_random->randomInt(2, 5);
+	init( LSM_COMPACTION_FANIN,                                    4 ); if( randomize && BUGGIFY ) LSM_COMPACTION_FANIN = 2;
+	init( LSM_BYTES_PER_YIELD,                                  1e6 ); if( randomize && BUGGIFY ) LSM_BYTES_PER_YIELD = 1000;
+
 	// Leader election
 	bool longLeaderElection = randomize && BUGGIFY;
 	init( CANDIDATE_MIN_DELAY,                                  0.05 );
 	init( CANDIDATE_MAX_DELAY,                                   1.0 );
 	init( CANDIDATE_GROWTH_RATE,                                 1.2 );
 	init( POLLING_FREQUENCY,                                     1.0 ); if( longLeaderElection ) POLLING_FREQUENCY = 8.0;
+	init( LEADER_NOTIFY_BATCH_SIZE,                             1000 ); if( randomize && BUGGIFY ) LEADER_NOTIFY_BATCH_SIZE = 1; // Replies a coordinator sends about a new leader before yielding
 	init( HEARTBEAT_FREQUENCY,                                  0.25 ); if( longLeaderElection ) HEARTBEAT_FREQUENCY = 1.0;
 
 	// Master Proxy
@@ -217,6 +269,9 @@ ServerKnobs::ServerKnobs(bool randomize, ClientKnobs* clientKnobs) {
 	init( START_TRANSACTION_BATCH_QUEUE_CHECK_INTERVAL,        0.001 );
 	init( START_TRANSACTION_MAX_TRANSACTIONS_TO_START,         10000 );
 	init( START_TRANSACTION_MAX_BUDGET_SIZE,                      20 ); // Currently set to match CLIENT_KNOBS->MAX_BATCH_SIZE
+	init( START_TRANSACTION_TAG_BURST_SECONDS,                   0.1 ); // A throttled tag can start at most this many seconds worth of its rate at once
+	init( PROXY_VERSION_GOSSIP_INTERVAL,                       0.005 ); if( randomize && BUGGIFY ) PROXY_VERSION_GOSSIP_INTERVAL = 0.02;
+	init( PROXY_VERSION_GOSSIP_MAX_AGE,                         0.05 ); if( randomize && BUGGIFY ) PROXY_VERSION_GOSSIP_MAX_AGE = 0.001;
 
 	init( COMMIT_TRANSACTION_BATCH_INTERVAL_FROM_IDLE,         0.0005 ); if( randomize && BUGGIFY ) COMMIT_TRANSACTION_BATCH_INTERVAL_FROM_IDLE = 0.005;
 	init( COMMIT_TRANSACTION_BATCH_INTERVAL_MIN,                0.001 ); if( randomize && BUGGIFY ) COMMIT_TRANSACTION_BATCH_INTERVAL_MIN = 0.1;
@@ -231,8 +286,16 @@ ServerKnobs::ServerKnobs(bool randomize, ClientKnobs* clientKnobs) {
 	init( COMMIT_TRANSACTION_BATCH_BYTES_SCALE_BASE,           100000 );
 	init( COMMIT_TRANSACTION_BATCH_BYTES_SCALE_POWER,             0.0 );
 
+	// A positive target latency replaces the smoother above with a controller that aims the p99 commit latency at it
+	init( COMMIT_BATCH_TARGET_LATENCY,                            0.0 ); if( randomize && BUGGIFY ) COMMIT_BATCH_TARGET_LATENCY = g_random->random01() * 0.1;
+	init( COMMIT_BATCH_CONTROLLER_INTERVAL,                       1.0 ); if( randomize && BUGGIFY ) COMMIT_BATCH_CONTROLLER_INTERVAL = 0.1;
+	init( COMMIT_BATCH_CONTROLLER_HEADROOM_FRACTION,              0.5 );
+	init( COMMIT_BATCH_CONTROLLER_BYTES_MAX,                      1e6 );
+	init( SHARD_TAG_INDEX_MIN_REBUILD_LOOKUPS,                   1000 ); if( randomize && BUGGIFY ) SHARD_TAG_INDEX_MIN_REBUILD_LOOKUPS = 1;
+
 	init( TRANSACTION_BUDGET_TIME,							   0.050 ); if( randomize && BUGGIFY ) TRANSACTION_BUDGET_TIME = 0.0;
 	init( RESOLVER_COALESCE_TIME,                                1.0 );
+	init( COMMIT_DEBUG_SAMPLE_RATE,                              0.0 ); if( randomize && BUGGIFY ) COMMIT_DEBUG_SAMPLE_RATE = 0.01;
 	init( BUGGIFIED_ROW_LIMIT,                  APPLY_MUTATION_BYTES ); if( randomize && BUGGIFY ) BUGGIFIED_ROW_LIMIT = g_random->randomInt(3, 30);
 	init( PROXY_SPIN_DELAY,                                     0.01 );
 
@@ -245,12 +308,18 @@ ServerKnobs::ServerKnobs(bool randomize, ClientKnobs* clientKnobs) {
 	init( MIN_BALANCE_DIFFERENCE,                              10000 );
 	init( SECONDS_BEFORE_NO_FAILURE_DELAY,                  8 * 3600 );
 	init( MAX_TXS_SEND_MEMORY,                                   1e7 ); if( randomize && BUGGIFY ) MAX_TXS_SEND_MEMORY = 1e5;
+	init( TXS_SNAPSHOT_SPEEDUP,                                    4 ); if( randomize && BUGGIFY ) TXS_SNAPSHOT_SPEEDUP = g_random->randomInt(1, 11); // Bytes of snapshot the proxies log in the txnStateStore per byte of mutations; the master chooses it for all of the proxies of a generation
 
 	// Resolver
 	init( SAMPLE_OFFSET_PER_KEY,                                 100 );
 	init( SAMPLE_EXPIRATION_TIME,                                1.0 );
 	init( SAMPLE_POLL_TIME,                                      0.1 );
+	init( RESOLVER_COST_SMOOTHING_TIME,                          5.0 );
+	init( RESOLVER_MAX_COST_WEIGHT,                              8.0 ); if( randomize && BUGGIFY ) RESOLVER_MAX_COST_WEIGHT = 1.0; // 1.0 samples conflict ranges by key size alone
 	init( RESOLVER_STATE_MEMORY_LIMIT,                           1e6 );
+	init( RESOLVER_CONFLICT_SET_THREADS,                           0 ); // 0 or 1 resolves conflicts on the network thread
+	init( RESOLVER_PRUNE_NODES_PER_STEP,                        1000 ); if( randomize && BUGGIFY ) RESOLVER_PRUNE_NODES_PER_STEP = 10; // 0 prunes only after each batch
+	init( RESOLVER_PRUNE_INTERVAL,                               0.1 ); if( randomize && BUGGIFY ) RESOLVER_PRUNE_INTERVAL = 2.0;
 	init( LAST_LIMITED_RATIO,                                    0.6 );
 
 	//Cluster Controller
@@ -266,6 +335,8 @@ ServerKnobs::ServerKnobs(bool randomize, ClientKnobs* clientKnobs) {
 	init( WORKER_FAILURE_TIME,                                   1.0 ); if( randomize && BUGGIFY ) WORKER_FAILURE_TIME = 10.0;
 	init( CHECK_BETTER_MASTER_INTERVAL,                          1.0 ); if( randomize && BUGGIFY ) CHECK_BETTER_MASTER_INTERVAL = 0.001;
 	init( INCOMPATIBLE_PEERS_LOGGING_INTERVAL,                   600 ); if( randomize && BUGGIFY ) INCOMPATIBLE_PEERS_LOGGING_INTERVAL = 60.0;
+	init( FAILURE_DETECTION_CLIENT_HOLD_TIME,                    1.0 ); if( randomize && BUGGIFY ) FAILURE_DETECTION_CLIENT_HOLD_TIME = g_random->coinflip() ? 0.0 : 10.0; // Capped at half of CLIENT_FAILURE_TIMEOUT_DELAY; 0 makes clients poll
+	init( SERVER_DB_INFO_HISTORY,                                 20 ); if( randomize && BUGGIFY ) SERVER_DB_INFO_HISTORY = g_random->randomInt(0, 3);
 	init( EXPECTED_MASTER_FITNESS,             ProcessClass::GoodFit );
 	init( EXPECTED_TLOG_FITNESS,               ProcessClass::GoodFit );
 	init( EXPECTED_LOG_ROUTER_FITNESS,         ProcessClass::GoodFit );
@@ -296,6 +367,7 @@ ServerKnobs::ServerKnobs(bool randomize, ClientKnobs* clientKnobs) {
 	init( SMOOTHING_AMOUNT,                                      1.0 ); if( slowRateKeeper ) SMOOTHING_AMOUNT = 5.0;
 	init( SLOW_SMOOTHING_AMOUNT,                                10.0 ); if( slowRateKeeper ) SLOW_SMOOTHING_AMOUNT = 50.0;
 	init( METRIC_UPDATE_RATE,                                     .1 ); if( slowRateKeeper ) METRIC_UPDATE_RATE = 0.5;
+	init( TAG_THROTTLE_RATIO,                                    0.9 ); if( randomize && BUGGIFY ) TAG_THROTTLE_RATIO = 0.0; // Tags are throttled once the released transaction rate is above this fraction of the limit
 
 	bool smallStorageTarget = randomize && BUGGIFY;
 	init( TARGET_BYTES_PER_STORAGE_SERVER,                    1000e6 ); if( smallStorageTarget ) TARGET_BYTES_PER_STORAGE_SERVER = 1000e3;
@@ -313,6 +385,7 @@ ServerKnobs::ServerKnobs(bool randomize, ClientKnobs* clientKnobs) {
 
 	init( MAX_TL_SS_VERSION_DIFFERENCE,                         1e99 ); // if( randomize && BUGGIFY ) MAX_TL_SS_VERSION_DIFFERENCE = std::max(1.0, 0.25 * VERSIONS_PER_SECOND); // spring starts at half this value //FIXME: this knob causes ratekeeper to clamp on idle cluster in simulation that have a large number of logs
 	init( MAX_MACHINES_FALLING_BEHIND,                             1 );
+	init( STORAGE_QUEUE_PROJECTION_TIME,                         2.0 ); if( randomize && BUGGIFY ) STORAGE_QUEUE_PROJECTION_TIME = g_random->coinflip() ? 0.0 : 10.0; // Seconds ahead that a storage server's growing queue is projected; 0 throttles on its current queue alone
 
 	//Storage Metrics
 	init( STORAGE_METRICS_AVERAGE_INTERVAL,                    120.0 );
@@ -320,6 +393,8 @@ ServerKnobs::ServerKnobs(bool randomize, ClientKnobs* clientKnobs) {
 	init( SPLIT_JITTER_AMOUNT,                                  0.05 ); if( randomize && BUGGIFY ) SPLIT_JITTER_AMOUNT = 0.2;
 	init( IOPS_UNITS_PER_SAMPLE,                                10000 * 1000 / STORAGE_METRICS_AVERAGE_INTERVAL_PER_KSECONDS / 100 );
 	init( BANDWIDTH_UNITS_PER_SAMPLE,                           SHARD_MIN_BYTES_PER_KSEC / STORAGE_METRICS_AVERAGE_INTERVAL_PER_KSECONDS / 25 );
+	init( BYTES_READ_UNITS_PER_SAMPLE,                          SHARD_SPLIT_BYTES_READ_PER_KSEC / STORAGE_METRICS_AVERAGE_INTERVAL_PER_KSECONDS / 100 );
+	init( EMPTY_READ_PENALTY,                                     20 ); // The bytes a read of a missing key counts as, so that reads of missing keys can make a shard read hot
 
 	//Storage Server
 	init( STORAGE_LOGGING_DELAY,                                 5.0 );
@@ -329,16 +404,45 @@ ServerKnobs::ServerKnobs(bool randomize, ClientKnobs* clientKnobs) {
 	init( BUGGIFY_LIMIT_BYTES,                                  1000 );
 	init( FETCH_BLOCK_BYTES,                                     2e6 );
 	init( FETCH_KEYS_PARALLELISM_BYTES,                          5e6 ); if( randomize && BUGGIFY ) FETCH_KEYS_PARALLELISM_BYTES = 4e6;
+	init( FETCH_KEYS_USE_RANGE_STREAM,                             1 ); if( randomize && BUGGIFY ) FETCH_KEYS_USE_RANGE_STREAM = 0;
 	init( BUGGIFY_BLOCK_BYTES,                                 10000 );
 	init( STORAGE_HARD_LIMIT_BYTES,                           1500e6 ); if( randomize && BUGGIFY ) STORAGE_HARD_LIMIT_BYTES = 1500e3;
 	init( STORAGE_COMMIT_BYTES,                             10000000 ); if( randomize && BUGGIFY ) STORAGE_COMMIT_BYTES = 2000000;
 	init( STORAGE_COMMIT_INTERVAL,                               0.5 ); if( randomize && BUGGIFY ) STORAGE_COMMIT_INTERVAL = 2.0;
+	init( STORAGE_COMMIT_PIPELINED,                                1 ); if( randomize && BUGGIFY ) STORAGE_COMMIT_PIPELINED = 0;
 	init( UPDATE_SHARD_VERSION_INTERVAL,                        0.25 ); if( randomize && BUGGIFY ) UPDATE_SHARD_VERSION_INTERVAL = 1.0;
 	init( BYTE_SAMPLING_FACTOR,                                  250 ); //cannot buggify because of differences in restarting tests
 	init( BYTE_SAMPLING_OVERHEAD,                                100 );
 	init( MAX_STORAGE_SERVER_WATCH_BYTES,                      100e6 ); if( randomize && BUGGIFY ) MAX_STORAGE_SERVER_WATCH_BYTES = 10e3;
 	init( MAX_BYTE_SAMPLE_CLEAR_MAP_SIZE,                        1e9 ); if( randomize && BUGGIFY ) MAX_BYTE_SAMPLE_CLEAR_MAP_SIZE = 1e3;
 	init( LONG_BYTE_SAMPLE_RECOVERY_DELAY,                      60.0 );
+	init( BYTE_SAMPLE_RECOVERY_PARALLELISM,                        8 ); if( randomize && BUGGIFY ) BYTE_SAMPLE_RECOVERY_PARALLELISM = 1; // Range reads of the persisted byte sample in flight, so that recovering it leaves readers free for clients
+	init( BYTE_SAMPLE_FILTER_BITS_PER_KEY,                        10 ); if( randomize && BUGGIFY ) BYTE_SAMPLE_FILTER_BITS_PER_KEY = g_random->randomInt(0, 16);
+	init( BYTE_SAMPLE_FILTER_MIN_KEYS,                           1e4 ); if( randomize && BUGGIFY ) BYTE_SAMPLE_FILTER_MIN_KEYS = 10;
+	init( BYTE_SAMPLE_FILTER_SCAN_KEYS,                          1e4 ); if( randomize && BUGGIFY ) BYTE_SAMPLE_FILTER_SCAN_KEYS = 10;
+	init( STORAGE_HOT_KEY_CACHE_ENTRIES,                        1000 ); if( randomize && BUGGIFY ) STORAGE_HOT_KEY_CACHE_ENTRIES = g_random->randomInt(0, 10);
+	init( STORAGE_HOT_KEY_CACHE_MAX_VALUE_BYTES,                1000 ); if( randomize && BUGGIFY ) STORAGE_HOT_KEY_CACHE_MAX_VALUE_BYTES = 10;
+	init( STORAGE_EAGER_READS_FROM_MEMORY,                         1 ); if( randomize && BUGGIFY ) STORAGE_EAGER_READS_FROM_MEMORY = 0;
+	init( STORAGE_COMBINE_ATOMIC_ADDS,                             1 ); if( randomize && BUGGIFY ) STORAGE_COMBINE_ATOMIC_ADDS = 0;
+	init( STORAGE_KEY_FILTER_BITS_PER_KEY,                         0 ); if( randomize && BUGGIFY ) STORAGE_KEY_FILTER_BITS_PER_KEY = g_random->randomInt(1, 16);
+	init( STORAGE_KEY_FILTER_MEMORY_FRACTION,                    0.1 ); if( randomize && BUGGIFY ) STORAGE_KEY_FILTER_MEMORY_FRACTION = 0.001;
+	init( STORAGE_KEY_FILTER_CHECK_INTERVAL,                    10.0 ); if( randomize && BUGGIFY ) STORAGE_KEY_FILTER_CHECK_INTERVAL = 0.5;
+	init( STORAGE_KEY_FILTER_SCAN_BYTES,                         1e6 ); if( randomize && BUGGIFY ) STORAGE_KEY_FILTER_SCAN_BYTES = 1000;
+	init( STORAGE_KEY_FILTER_REBUILD_GROWTH,                     1.0 ); // Rebuild once this many times the keys it was built with have been added to a filter
+	init( STORAGE_VALUE_COMPRESSION,                               0 ); if( randomize && BUGGIFY ) STORAGE_VALUE_COMPRESSION = 1; // Only affects storage servers created while it is set
+	init( STORAGE_VALUE_COMPRESSION_MIN_BYTES,                   100 ); if( randomize && BUGGIFY ) STORAGE_VALUE_COMPRESSION_MIN_BYTES = 1;
+	init( STORAGE_VALUE_COMPRESSION_LEVEL,                         1 ); if( randomize && BUGGIFY ) STORAGE_VALUE_COMPRESSION_LEVEL = g_random->randomInt(1, 10);
+	init( RANGE_STREAM_IDLE_TIMEOUT,                            10.0 ); if( randomize && BUGGIFY ) RANGE_STREAM_IDLE_TIMEOUT = 0.5;
+	init( HOT_RANGE_SKETCH_SIZE,                                 100 ); if( randomize && BUGGIFY ) HOT_RANGE_SKETCH_SIZE = 2;
+	init( HOT_RANGE_SAMPLE_PROBABILITY,                         0.05 ); if( randomize && BUGGIFY ) HOT_RANGE_SAMPLE_PROBABILITY = 1.0; // The fraction of reads and writes that storage servers count toward their hot ranges
+	init( HOT_RANGE_WINDOW,                                     10.0 ); if( randomize && BUGGIFY ) HOT_RANGE_WINDOW = 1.0;
+	init( BACKUP_EXPORT_RANGE_BYTES,                             1e7 ); if( randomize && BUGGIFY ) BACKUP_EXPORT_RANGE_BYTES = 1e4; // Limits the size of each range file a storage server writes for a backup
+	init( BACKUP_EXPORT_PARALLELISM,                               2 );
+	init( CHANGE_FEED_POLL_TIME,                                 1.0 ); if( randomize && BUGGIFY ) CHANGE_FEED_POLL_TIME = 0.01; // How long a change feed request waits for mutations before replying with none
+	init( CHANGE_FEED_REPLY_BYTES,                               1e6 ); if( randomize && BUGGIFY ) CHANGE_FEED_REPLY_BYTES = 1;
+	init( RANGE_AGGREGATE_BYTES,                                 1e7 ); if( randomize && BUGGIFY ) RANGE_AGGREGATE_BYTES = 1e3; // Limits how much a storage server reads for one range aggregate request
+	init( RANGE_DIGEST_BYTES,                                    1e7 ); if( randomize && BUGGIFY ) RANGE_DIGEST_BYTES = 1e3; // Limits how much a storage server reads for one range digest request
+	init( FIND_KEY_SKIP_DISTANCE,                                100 ); if( randomize && BUGGIFY ) FIND_KEY_SKIP_DISTANCE = 1; // Key selectors with offsets at least this far ask the storage engine for the key by position
 
 	//Wait Failure
 	init( BUGGIFY_OUTSTANDING_WAIT_FAILURE_REQUESTS,               2 );
@@ -347,6 +451,15 @@ ServerKnobs::ServerKnobs(bool randomize, ClientKnobs* clientKnobs) {
 
 	//Worker
 	init( WORKER_LOGGING_INTERVAL,                               5.0 );
+	init( HOST_PROBE_SYNCS,                                       10 ); if( randomize && BUGGIFY ) HOST_PROBE_SYNCS = 0;
+	init( HOST_PROBE_CPU_ROUNDS,                               10000 );
+	init( SLOW_HOST_RATIO,                                       2.0 ); if( randomize && BUGGIFY ) SLOW_HOST_RATIO = 1.0;
+	init( COUNTER_EXPORT_DIRECTORY,                               "" ); // If set, each process writes its role counters to a Prometheus text file in this directory
+	init( COUNTER_EXPORT_INTERVAL,                               1.0 );
+	init( TRAFFIC_CAPTURE_DIRECTORY,                              "" ); // If set, proxies and storage servers write the commits and reads they receive to files in this directory
+	init( TRAFFIC_CAPTURE_MAX_BYTES,                          1000e6 );
+	init( TRAFFIC_CAPTURE_FLUSH_BYTES,                           1e6 ); if( randomize && BUGGIFY ) TRAFFIC_CAPTURE_FLUSH_BYTES = 1000;
+	init( TRAFFIC_CAPTURE_FLUSH_INTERVAL,                        1.0 );
 	init( INCOMPATIBLE_PEER_DELAY_BEFORE_LOGGING,                5.0 );
 
 	// Test harness
@@ -367,6 +480,15 @@ ServerKnobs::ServerKnobs(bool randomize, ClientKnobs* clientKnobs) {
 	init( TIME_KEEPER_DELAY,                                      10 );
 	init( TIME_KEEPER_MAX_ENTRIES,                              3600 * 24 * 30 * 6); if( randomize && BUGGIFY ) { TIME_KEEPER_MAX_ENTRIES = 2; }
 
+	// Network test (networktestclient)
+	init( NETWORK_TEST_CLIENT_COUNT,                              30 ); // Requests the client keeps outstanding
+	init( NETWORK_TEST_REQUEST_SIZE,                               1 );
+	init( NETWORK_TEST_REPLY_SIZE,                            600000 );
+	init( NETWORK_TEST_UNRELIABLE,                                 0 ); // Send requests with tryGetReply() rather than getReply()
+	init( NETWORK_TEST_STREAM,                                     0 ); // Send requests one way, with a reply only after every NETWORK_TEST_STREAM_WINDOW
+	init( NETWORK_TEST_STREAM_WINDOW,                             16 );
+	init( NETWORK_TEST_DURATION,                                   0 ); // Seconds, or 0 to run until killed
+
 	if(clientKnobs)
 		clientKnobs->IS_ACCEPTABLE_DELAY = clientKnobs->IS_ACCEPTABLE_DELAY*std::min(MAX_READ_TRANSACTION_LIFE_VERSIONS, MAX_WRITE_TRANSACTION_LIFE_VERSIONS)/(5.0*VERSIONS_PER_SECOND);
 }
@@ -33,6 +33,7 @@ class ServerKnobs : public Knobs {
 public:
 	// TLogs
 	double TLOG_TIMEOUT;  // tlog OR master proxy failure - master's reaction time
+	double TLOG_SLOW_COMMIT_WARNING_TIME;  // A tlog that takes longer than this to acknowledge a commit is reported
 	double RECOVERY_TLOG_SMART_QUORUM_DELAY;		// smaller might be better for bug amplification
 	double TLOG_STORAGE_MIN_UPDATE_INTERVAL;
 	double BUGGIFY_TLOG_STORAGE_MIN_UPDATE_INTERVAL;
@@ -50,14 +51,27 @@ public:
 	double TLOG_PEEK_DELAY;
 	int LEGACY_TLOG_UPGRADE_ENTRIES_PER_VERSION;
 	int VERSION_MESSAGES_OVERHEAD_FACTOR_1024THS; // Multiplicative factor to bound total space used to store a version message (measured in 1/1024ths, e.g. a value of 2048 yields a factor of 2).
-	int64_t VERSION_MESSAGES_ENTRY_BYTES_WITH_OVERHEAD;
 	double TLOG_MESSAGE_BLOCK_OVERHEAD_FACTOR;
 	int64_t TLOG_MESSAGE_BLOCK_BYTES;
 	int64_t MAX_MESSAGE_SIZE;
 	int LOG_SYSTEM_PUSHED_DATA_BLOCK_SIZE;
 	double PEEK_TRACKER_EXPIRATION_TIME;
 	int PARALLEL_GET_MORE_REQUESTS;
+	int PARALLEL_GET_MORE_MAX_REQUESTS;  // How far a peek cursor that is catching up may widen its window to cover the round trip
+	int PEEK_REPLY_COMPRESSION;  // If nonzero, peek cursors ask logs on other machines to compress their replies
+	int PEEK_REPLY_COMPRESSION_LEVEL;
+	int PEEK_REPLY_COMPRESSION_MIN_BYTES;
+	int TLOG_SPILL_REFERENCE;  // If nonzero, new logs spill by writing an index into the disk queue rather than copying the data
+	int64_t TLOG_SPILL_REFERENCE_MAX_PEEK_BYTES;
+	int64_t TLOG_PEEK_CACHE_BYTES;  // Bytes of recent peek replies made only of spilled data that each log keeps for identical peeks
 	int64_t MAX_QUEUE_COMMIT_BYTES;
+	int64_t TLOG_GROUP_COMMIT_BYTES;  // Queue commits smaller than this are held back to be grouped with later commits
+	double TLOG_GROUP_COMMIT_MAX_DELAY;
+	double TLOG_GROUP_COMMIT_LATENCY_FRACTION;  // of the average queue commit latency
+	int64_t DISK_QUEUE_FILE_EXTENSION_BYTES;
+	int64_t DISK_QUEUE_FILE_PREALLOCATE_BYTES;  // If nonzero, the size each disk queue file is given when it is first extended
+	int DISK_QUEUE_RECOVERY_READ_AHEAD;  // The number of reads of up to 1MB a recovering disk queue keeps in flight
+	int PAGE_CHECKSUM_FORMAT;  // 0 writes the hashlittle2 page checksums that every version reads, 1 writes CRC-32C in SQLite pages and XXH64 in disk queue pages
 
 	// Versions
 	int MAX_VERSIONS_IN_FLIGHT;
@@ -84,6 +98,9 @@ public:
 	double INFLIGHT_PENALTY_HEALTHY;
 	double INFLIGHT_PENALTY_UNHEALTHY;
 	double INFLIGHT_PENALTY_ONE_LEFT;
+	double DD_SERVER_LOAD_THRESHOLD;
+	double DD_SERVER_LOAD_PENALTY;
+	double DD_SERVER_CPU_TARGET;
 
 	// Data distribution
 	double RETRY_RELOCATESHARD_DELAY;
@@ -92,7 +109,10 @@ public:
 	int64_t SHARD_MAX_BYTES_PER_KSEC, // Shards with more than this bandwidth will be split immediately
 		SHARD_MIN_BYTES_PER_KSEC,     // Shards with more than this bandwidth will not be merged
 		SHARD_SPLIT_BYTES_PER_KSEC;   // When splitting a shard, it is split into pieces with less than this bandwidth
+	int64_t SHARD_MAX_BYTES_READ_PER_KSEC,  // Shards with more than this read bandwidth will be split immediately
+		SHARD_SPLIT_BYTES_READ_PER_KSEC;    // When splitting a shard for reads, it is split into pieces with less than this read bandwidth
 	double STORAGE_METRIC_TIMEOUT;
+	double STORAGE_METRICS_BATCH_POLL_DELAY; // How often a storage server checks the waits of a metrics subscription
 	double METRIC_DELAY;
 	double ALL_DATA_REMOVED_DELAY;
 	double INITIAL_FAILURE_REACTION_DELAY;
@@ -114,6 +134,7 @@ public:
 	int64_t DD_SHARD_SIZE_GRANULARITY;
 	int64_t DD_SHARD_SIZE_GRANULARITY_SIM;
 	int DD_MOVE_KEYS_PARALLELISM;
+	int DD_MOVE_KEYS_COALESCE_LIMIT;
 	int DD_MERGE_LIMIT;
 	double DD_SHARD_METRICS_TIMEOUT;
 	int64_t DD_LOCATION_CACHE_SIZE;
@@ -130,8 +151,13 @@ public:
 	int CHECK_FREE_PAGE_AMOUNT;
 	double DISK_METRIC_LOGGING_INTERVAL;
 	int64_t SOFT_HEAP_LIMIT;
+	int SQLITE_READER_THREADS;
+	int SQLITE_PROCESS_READER_THREADS;
+	int SQLITE_READ_VALUES_PER_ACTION;
+	int SQLITE_READ_PREFETCH_PAGES;
 
 	int SQLITE_PAGE_SCAN_ERROR_LIMIT;
+	int SQLITE_PAGE_SIZE;
 	int SQLITE_BTREE_PAGE_USABLE;
 	int SQLITE_BTREE_CELL_MAX_LOCAL;
 	int SQLITE_BTREE_CELL_MIN_LOCAL;
@@ -142,6 +168,10 @@ public:
 	// KeyValueStoreSqlite spring cleaning
 	double CLEANING_INTERVAL;
 	double SPRING_CLEANING_TIME_ESTIMATE;
+	double SPRING_CLEANING_MIN_TIME_ESTIMATE;
+	double SPRING_CLEANING_MAX_TIME_ESTIMATE;
+	double SPRING_CLEANING_BACKOFF_READ_LATENCY;
+	double SPRING_CLEANING_LOW_FREE_SPACE_RATIO;
 	double SPRING_CLEANING_VACUUMS_PER_LAZY_DELETE_PAGE;
 	int SPRING_CLEANING_MIN_LAZY_DELETE_PAGES;
 	int SPRING_CLEANING_MAX_LAZY_DELETE_PAGES;
@@ -149,11 +179,20 @@ public:
 	int SPRING_CLEANING_MIN_VACUUM_PAGES;
 	int SPRING_CLEANING_MAX_VACUUM_PAGES;
 
+	// KeyValueStoreLSM
+	int64_t LSM_MEMTABLE_BYTES;
+	int LSM_BLOCK_BYTES;
+	int LSM_BLOOM_BITS_PER_KEY;
+	int LSM_MAX_RUNS;
+	int LSM_COMPACTION_FANIN;
+	int64_t LSM_BYTES_PER_YIELD;
+
 	// Leader election
 	double CANDIDATE_MIN_DELAY;
 	double CANDIDATE_MAX_DELAY;
 	double CANDIDATE_GROWTH_RATE;
 	double POLLING_FREQUENCY;
+	int LEADER_NOTIFY_BATCH_SIZE;
 	double HEARTBEAT_FREQUENCY;
 
 	// Master Proxy
@@ -164,6 +203,9 @@ public:
 	double START_TRANSACTION_BATCH_QUEUE_CHECK_INTERVAL;
 	double START_TRANSACTION_MAX_TRANSACTIONS_TO_START;
 	double START_TRANSACTION_MAX_BUDGET_SIZE;
+	double START_TRANSACTION_TAG_BURST_SECONDS;
+	double PROXY_VERSION_GOSSIP_INTERVAL;
+	double PROXY_VERSION_GOSSIP_MAX_AGE;
 
 	double COMMIT_TRANSACTION_BATCH_INTERVAL_FROM_IDLE;
 	double COMMIT_TRANSACTION_BATCH_INTERVAL_MIN;
@@ -175,9 +217,15 @@ public:
 	int    COMMIT_TRANSACTION_BATCH_BYTES_MAX;
 	double COMMIT_TRANSACTION_BATCH_BYTES_SCALE_BASE;
 	double COMMIT_TRANSACTION_BATCH_BYTES_SCALE_POWER;
+	double COMMIT_BATCH_TARGET_LATENCY;
+	double COMMIT_BATCH_CONTROLLER_INTERVAL;
+	double COMMIT_BATCH_CONTROLLER_HEADROOM_FRACTION;
+	int    COMMIT_BATCH_CONTROLLER_BYTES_MAX;
+	int    SHARD_TAG_INDEX_MIN_REBUILD_LOOKUPS;
 
 	double TRANSACTION_BUDGET_TIME;
 	double RESOLVER_COALESCE_TIME;
+	double COMMIT_DEBUG_SAMPLE_RATE; // The fraction of commit batches that proxies trace as if a transaction in them had a debug ID
 	int BUGGIFIED_ROW_LIMIT;
 	double PROXY_SPIN_DELAY;
 
@@ -188,12 +236,18 @@ public:
 	int64_t MIN_BALANCE_DIFFERENCE;
 	double SECONDS_BEFORE_NO_FAILURE_DELAY;
 	int64_t MAX_TXS_SEND_MEMORY;
+	int TXS_SNAPSHOT_SPEEDUP;
 
 	// Resolver
 	int64_t SAMPLE_OFFSET_PER_KEY;
 	double SAMPLE_EXPIRATION_TIME;
 	double SAMPLE_POLL_TIME;
+	double RESOLVER_COST_SMOOTHING_TIME;
+	double RESOLVER_MAX_COST_WEIGHT;
 	int64_t RESOLVER_STATE_MEMORY_LIMIT;
+	int RESOLVER_CONFLICT_SET_THREADS;
+	int RESOLVER_PRUNE_NODES_PER_STEP;
+	double RESOLVER_PRUNE_INTERVAL;
 
 	//Cluster Controller
 	double MASTER_FAILURE_REACTION_TIME;
@@ -208,6 +262,8 @@ public:
 	double WORKER_FAILURE_TIME;
 	double CHECK_BETTER_MASTER_INTERVAL;
 	double INCOMPATIBLE_PEERS_LOGGING_INTERVAL;
+	double FAILURE_DETECTION_CLIENT_HOLD_TIME;
+	int SERVER_DB_INFO_HISTORY; // Earlier ServerDBInfos the cluster controller can send workers updates from
 
 	// Knobs used to select the best policy (via monte carlo)
 	int POLICY_RATING_TESTS;	// number of tests per policy (in order to compare)
@@ -239,6 +295,7 @@ public:
 	double SLOW_SMOOTHING_AMOUNT;
 	double METRIC_UPDATE_RATE;
 	double LAST_LIMITED_RATIO;
+	double TAG_THROTTLE_RATIO;
 
 	int64_t TARGET_BYTES_PER_STORAGE_SERVER;
 	double SPRING_BYTES_STORAGE_SERVER;
@@ -254,6 +311,7 @@ public:
 
 	double MAX_TL_SS_VERSION_DIFFERENCE; // spring starts at half this value
 	int MAX_MACHINES_FALLING_BEHIND;
+	double STORAGE_QUEUE_PROJECTION_TIME;
 
 	//Storage Metrics
 	double STORAGE_METRICS_AVERAGE_INTERVAL;
@@ -261,6 +319,8 @@ public:
 	double SPLIT_JITTER_AMOUNT;
 	int64_t IOPS_UNITS_PER_SAMPLE;
 	int64_t BANDWIDTH_UNITS_PER_SAMPLE;
+	int64_t BYTES_READ_UNITS_PER_SAMPLE;
+	int64_t EMPTY_READ_PENALTY;
 
 	//Storage Server
 	double STORAGE_LOGGING_DELAY;
@@ -270,16 +330,45 @@ public:
 	int BUGGIFY_LIMIT_BYTES;
 	int FETCH_BLOCK_BYTES;
 	int FETCH_KEYS_PARALLELISM_BYTES;
+	int FETCH_KEYS_USE_RANGE_STREAM;
 	int BUGGIFY_BLOCK_BYTES;
 	int64_t STORAGE_HARD_LIMIT_BYTES;
 	int STORAGE_COMMIT_BYTES;
 	double STORAGE_COMMIT_INTERVAL;
+	int STORAGE_COMMIT_PIPELINED;
 	double UPDATE_SHARD_VERSION_INTERVAL;
 	int BYTE_SAMPLING_FACTOR;
 	int BYTE_SAMPLING_OVERHEAD;
 	int MAX_STORAGE_SERVER_WATCH_BYTES;
 	int MAX_BYTE_SAMPLE_CLEAR_MAP_SIZE;
 	double LONG_BYTE_SAMPLE_RECOVERY_DELAY;
+	int BYTE_SAMPLE_RECOVERY_PARALLELISM;
+	int BYTE_SAMPLE_FILTER_BITS_PER_KEY;
+	int BYTE_SAMPLE_FILTER_MIN_KEYS;
+	int BYTE_SAMPLE_FILTER_SCAN_KEYS;
+	int STORAGE_HOT_KEY_CACHE_ENTRIES;
+	int STORAGE_HOT_KEY_CACHE_MAX_VALUE_BYTES;
+	int STORAGE_EAGER_READS_FROM_MEMORY;
+	int STORAGE_COMBINE_ATOMIC_ADDS;
+	int STORAGE_KEY_FILTER_BITS_PER_KEY;
+	double STORAGE_KEY_FILTER_MEMORY_FRACTION;
+	double STORAGE_KEY_FILTER_CHECK_INTERVAL;
+	int STORAGE_KEY_FILTER_SCAN_BYTES;
+	double STORAGE_KEY_FILTER_REBUILD_GROWTH;
+	int STORAGE_VALUE_COMPRESSION;
+	int STORAGE_VALUE_COMPRESSION_MIN_BYTES;
+	int STORAGE_VALUE_COMPRESSION_LEVEL;
+	double RANGE_STREAM_IDLE_TIMEOUT;
+	int HOT_RANGE_SKETCH_SIZE;
+	double HOT_RANGE_SAMPLE_PROBABILITY;
+	double HOT_RANGE_WINDOW;
+	int BACKUP_EXPORT_RANGE_BYTES;
+	int BACKUP_EXPORT_PARALLELISM;
+	double CHANGE_FEED_POLL_TIME;
+	int CHANGE_FEED_REPLY_BYTES;
+	int RANGE_AGGREGATE_BYTES;
+	int RANGE_DIGEST_BYTES;
+	int FIND_KEY_SKIP_DISTANCE;
 
 	//Wait Failure
 	int BUGGIFY_OUTSTANDING_WAIT_FAILURE_REQUESTS;
@@ -288,6 +377,15 @@ public:
 
 	//Worker
 	double WORKER_LOGGING_INTERVAL;
+	int HOST_PROBE_SYNCS;
+	int HOST_PROBE_CPU_ROUNDS;
+	double SLOW_HOST_RATIO;
+	std::string COUNTER_EXPORT_DIRECTORY;
+	double COUNTER_EXPORT_INTERVAL;
+	std::string TRAFFIC_CAPTURE_DIRECTORY;
+	int64_t TRAFFIC_CAPTURE_MAX_BYTES;
+	int TRAFFIC_CAPTURE_FLUSH_BYTES;
+	double TRAFFIC_CAPTURE_FLUSH_INTERVAL;
 	double INCOMPATIBLE_PEER_DELAY_BEFORE_LOGGING;
 
 	// Test harness
@@ -308,6 +406,15 @@ public:
 	int64_t TIME_KEEPER_DELAY;
 	int64_t TIME_KEEPER_MAX_ENTRIES;
 
+	// Network test
+	int NETWORK_TEST_CLIENT_COUNT;
+	int NETWORK_TEST_REQUEST_SIZE;
+	int NETWORK_TEST_REPLY_SIZE;
+	int NETWORK_TEST_UNRELIABLE;
+	int NETWORK_TEST_STREAM;
+	int NETWORK_TEST_STREAM_WINDOW;
+	double NETWORK_TEST_DURATION;
+
 	ServerKnobs(bool randomize = false, ClientKnobs* clientKnobs = NULL);
 };
 
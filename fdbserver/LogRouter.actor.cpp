@@ -82,6 +82,13 @@ struct LogRouterData {
 
 	std::vector<Reference<TagData>> tag_data; //we only store data for the remote tag locality
 
+	struct PeekTrackerData {
+		std::map<int, Promise<Version>> sequence_version;
+		double lastUpdate;
+	};
+
+	std::map<UID, PeekTrackerData> peekTracker;
+
 	Reference<TagData> getTagData(Tag tag) {
 		ASSERT(tag.locality == tagLocalityRemoteLog);
 		if(tag.id >= tag_data.size()) {
@@ -167,7 +174,7 @@ ACTOR Future<Void> pullAsyncData( LogRouterData *self, Tag tag ) {
 				when( Void _ = wait( dbInfoChange ) ) { //FIXME: does this actually happen?
 					if(r) tagPopped = std::max(tagPopped, r->popped());
 					if( self->logSystem->get() )
-						r = self->logSystem->get()->peekSingle( tagAt, tag );
+						r = self->logSystem->get()->peekSingle( tagAt, tag, vector<pair<Version,Tag>>(), true );
 					else
 						r = Reference<ILogSystem::IPeekCursor>();
 					dbInfoChange = self->logSystem->onChange();
@@ -256,8 +263,51 @@ Version poppedVersion( LogRouterData* self, Tag tag) {
 	return tagData->popped;
 }
 
+// Remote logs keep several peeks outstanding, each naming its place in the sequence; a peek begins where the one before it ended
+void sequencePeekReply( LogRouterData* self, TLogPeekRequest const& req, UID peekId, int sequence, TLogPeekReply const& reply ) {
+	if(req.sequence.present()) {
+		auto& trackerData = self->peekTracker[peekId];
+		trackerData.lastUpdate = now();
+		auto& sequenceData = trackerData.sequence_version[sequence+1];
+		if(sequenceData.isSet()) {
+			if(sequenceData.getFuture().get() != reply.end) {
+				TEST(true); //log router peek second attempt ended at a different version
+				req.reply.sendError(timed_out());
+				return;
+			}
+		} else {
+			sequenceData.send(reply.end);
+		}
+	}
+
+	req.reply.send( reply );
+}
+
 ACTOR Future<Void> logRouterPeekMessages( LogRouterData* self, TLogPeekRequest req ) {
 	state BinaryWriter messages(Unversioned());
+	state int sequence = -1;
+	state UID peekId;
+
+	if(req.sequence.present()) {
+		try {
+			peekId = req.sequence.get().first;
+			sequence = req.sequence.get().second;
+			if(sequence > 0) {
+				auto& trackerData = self->peekTracker[peekId];
+				trackerData.lastUpdate = now();
+				Version ver = wait(trackerData.sequence_version[sequence].getFuture());
+				req.begin = ver;
+				Void _ = wait(yield());
+			}
+		} catch( Error &e ) {
+			if(e.code() == error_code_timed_out) {
+				req.reply.sendError(timed_out());
+				return Void();
+			} else {
+				throw;
+			}
+		}
+	}
 
 	//TraceEvent("LogRouterPeek1", self->dbgid).detail("from", req.reply.getEndpoint().address).detail("ver", self->version.get()).detail("begin", req.begin);
 	if( req.returnIfBlocked && self->version.get() < req.begin ) {
@@ -279,7 +329,7 @@ ACTOR Future<Void> logRouterPeekMessages( LogRouterData* self, TLogPeekRequest r
 		rep.maxKnownVersion = self->version.get();
 		rep.popped = poppedVer;
 		rep.end = poppedVer;
-		req.reply.send( rep );
+		sequencePeekReply( self, req, peekId, sequence, rep );
 		return Void();
 	}
 
@@ -290,8 +340,10 @@ ACTOR Future<Void> logRouterPeekMessages( LogRouterData* self, TLogPeekRequest r
 	reply.maxKnownVersion = self->version.get();
 	reply.messages = messages.toStringRef();
 	reply.end = endVersion;
+	if( req.acceptCompressed && reply.messages.size() >= SERVER_KNOBS->PEEK_REPLY_COMPRESSION_MIN_BYTES )
+		reply.compress( SERVER_KNOBS->PEEK_REPLY_COMPRESSION_LEVEL );
 
-	req.reply.send( reply );
+	sequencePeekReply( self, req, peekId, sequence, reply );
 	//TraceEvent("LogRouterPeek4", self->dbgid);
 	return Void();
 }
@@ -324,6 +376,29 @@ ACTOR Future<Void> logRouterPop( LogRouterData* self, TLogPopRequest req ) {
 	return Void();
 }
 
+ACTOR Future<Void> cleanupPeekTrackers( LogRouterData* self ) {
+	loop {
+		double minTimeUntilExpiration = SERVER_KNOBS->PEEK_TRACKER_EXPIRATION_TIME;
+		auto it = self->peekTracker.begin();
+		while(it != self->peekTracker.end()) {
+			double timeUntilExpiration = it->second.lastUpdate + SERVER_KNOBS->PEEK_TRACKER_EXPIRATION_TIME - now();
+			if(timeUntilExpiration < 1.0e-6) {
+				for(auto seq : it->second.sequence_version) {
+					if(!seq.second.isSet()) {
+						seq.second.sendError(timed_out());
+					}
+				}
+				it = self->peekTracker.erase(it);
+			} else {
+				minTimeUntilExpiration = std::min(minTimeUntilExpiration, timeUntilExpiration);
+				++it;
+			}
+		}
+
+		Void _ = wait( delay(minTimeUntilExpiration) );
+	}
+}
+
 ACTOR Future<Void> logRouterCore(
 	TLogInterface interf,
 	Tag tag,
@@ -336,6 +411,7 @@ ACTOR Future<Void> logRouterCore(
 	state Future<Void> dbInfoChange = Void();
 
 	addActor.send( pullAsyncData(&logRouterData, tag) );
+	addActor.send( cleanupPeekTrackers(&logRouterData) );
 
 	loop choose {
 		when( Void _ = wait( dbInfoChange ) ) {
@@ -238,6 +238,10 @@ struct ILogSystem {
 		bool parallelGetMore;
 		int sequence;
 		Deque<Future<TLogPeekReply>> futureResults;
+		Deque<std::pair<double, int>> futureResultSent;  // When each of futureResults was requested, and how many requests were ahead of it
+		double lastResultTime;
+		double smoothedRoundTrip;  // Of requests answered while the log had more data, less the time they waited behind earlier requests
+		double smoothedResultInterval;  // Between those results
 		Future<Void> interfaceChanged;
 
 		ServerPeekCursor( Reference<AsyncVar<OptionalInterface<TLogInterface>>> const& interf, Tag tag, Version begin, Version end, bool returnIfBlocked, bool parallelGetMore );
@@ -285,6 +289,10 @@ struct ILogSystem {
 		}
 
 		virtual Version getMaxKnownVersion() { return results.maxKnownVersion; }
+
+		bool acceptCompressed();
+		int parallelGetMoreWindow();
+		void resetParallelGetMore();
 	};
 
 	struct MergedPeekCursor : IPeekCursor, ReferenceCounted<MergedPeekCursor> {
@@ -489,7 +497,7 @@ struct ILogSystem {
 		// If pop was previously or concurrently called with upTo > begin, the cursor may not return all such messages.  In that case cursor->popped() will
 		// be greater than begin to reflect that.
 
-	virtual Reference<IPeekCursor> peekSingle( Version begin, Tag tag, vector<pair<Version,Tag>> history = vector<pair<Version,Tag>>() ) = 0;
+	virtual Reference<IPeekCursor> peekSingle( Version begin, Tag tag, vector<pair<Version,Tag>> history = vector<pair<Version,Tag>>(), bool parallelGetMore = false ) = 0;
 		// Same contract as peek(), but blocks until the preferred log server(s) for the given tag are available (and is correspondingly less expensive)
 
 	virtual void pop( Version upTo, Tag tag ) = 0;
@@ -565,6 +573,19 @@ struct CompareFirst {
 	}
 };
 
+// Reads the header of the next message of a block written by LogPushData: the length of the rest of the message, its
+// subsequence and its tags, leaving rd at the mutation.  The tags are returned in place in the block.  The fields are
+// copied out of one bounds checked read instead of being deserialized one at a time, since TLogs and peek cursors do
+// this for every message.
+inline const Tag* readMessageHeader( ArenaReader& rd, int32_t& messageLength, uint32_t& sub, uint16_t& tagCount ) {
+	static_assert( sizeof(Tag) == sizeof(int8_t) + sizeof(uint16_t), "Tags are serialized packed" );
+	const uint8_t* header = (const uint8_t*)rd.readBytes( sizeof(messageLength) + sizeof(sub) + sizeof(tagCount) );
+	memcpy( &messageLength, header, sizeof(messageLength) );
+	memcpy( &sub, header + sizeof(messageLength), sizeof(sub) );
+	memcpy( &tagCount, header + sizeof(messageLength) + sizeof(sub), sizeof(tagCount) );
+	return (const Tag*)rd.readBytes( tagCount * sizeof(Tag) );
+}
+
 struct LogPushData : NonCopyable {
 	// Log subsequences have to start at 1 (the MergedPeekCursor relies on this to make sure we never have !hasMessage() in the middle of data for a version
 
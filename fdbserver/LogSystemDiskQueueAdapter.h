@@ -67,6 +67,9 @@ public:
 	// IDiskQueue interface
 	virtual Future<Standalone<StringRef>> readNext( int bytes );
 	virtual IDiskQueue::location getNextReadLocation();
+	virtual Future<Void> initializeRecovery() { return Void(); }
+	virtual Future<Standalone<StringRef>> read( IDiskQueue::location from, IDiskQueue::location to ) { ASSERT(false); throw internal_error(); }
+	virtual IDiskQueue::location getNextPushLocation() { ASSERT(false); throw internal_error(); }
 	virtual IDiskQueue::location push( StringRef contents );
 	virtual void pop( IDiskQueue::location upTo );
 	virtual Future<Void> commit();
@@ -22,15 +22,62 @@
 #include "fdbrpc/FailureMonitor.h"
 #include "Knobs.h"
 #include "fdbrpc/ReplicationUtils.h"
+#include "fdbrpc/zlib/zlib.h"
+
+void TLogPeekReply::compress( int level ) {
+	ASSERT( !uncompressedSize );
+	z_stream stream;
+	memset( &stream, 0, sizeof(stream) );
+	if (deflateInit( &stream, level ) != Z_OK)
+		throw internal_error();
+	int bound = deflateBound( &stream, messages.size() );
+	uint8_t* out = new (arena) uint8_t[ bound ];
+	stream.next_in = (Bytef*)messages.begin();
+	stream.avail_in = messages.size();
+	stream.next_out = out;
+	stream.avail_out = bound;
+	int r = deflate( &stream, Z_FINISH );
+	deflateEnd( &stream );
+	if (r != Z_STREAM_END)
+		throw internal_error();
+	TEST( stream.total_out < messages.size() ); // Peek reply compressed
+	if (stream.total_out < messages.size()) {
+		uncompressedSize = messages.size();
+		messages = StringRef( out, stream.total_out );
+	}
+}
+
+void TLogPeekReply::uncompress() {
+	if (!uncompressedSize)
+		return;
+	uint8_t* out = new (arena) uint8_t[ uncompressedSize ];
+	z_stream stream;
+	memset( &stream, 0, sizeof(stream) );
+	if (inflateInit( &stream ) != Z_OK)
+		throw internal_error();
+	stream.next_in = (Bytef*)messages.begin();
+	stream.avail_in = messages.size();
+	stream.next_out = out;
+	stream.avail_out = uncompressedSize;
+	int r = inflate( &stream, Z_FINISH );
+	bool complete = r == Z_STREAM_END && stream.total_out == uncompressedSize;
+	inflateEnd( &stream );
+	if (!complete)
+		throw internal_error();
+	messages = StringRef( out, uncompressedSize );
+	uncompressedSize = 0;
+}
 
 ILogSystem::ServerPeekCursor::ServerPeekCursor( Reference<AsyncVar<OptionalInterface<TLogInterface>>> const& interf, Tag tag, Version begin, Version end, bool returnIfBlocked, bool parallelGetMore )
-			: interf(interf), tag(tag), messageVersion(begin), end(end), hasMsg(false), rd(results.arena, results.messages, Unversioned()), randomID(g_random->randomUniqueID()), poppedVersion(0), returnIfBlocked(returnIfBlocked), sequence(0), parallelGetMore(parallelGetMore) {
+			: interf(interf), tag(tag), messageVersion(begin), end(end), hasMsg(false), rd(results.arena, results.messages, Unversioned()), randomID(g_random->randomUniqueID()), poppedVersion(0), returnIfBlocked(returnIfBlocked), sequence(0), parallelGetMore(parallelGetMore),
+			  lastResultTime(0), smoothedRoundTrip(0), smoothedResultInterval(0) {
 	this->results.maxKnownVersion = 0;
 	//TraceEvent("SPC_starting", randomID).detail("tag", tag.toString()).detail("begin", begin).detail("end", end).backtrace();
 }
 
 ILogSystem::ServerPeekCursor::ServerPeekCursor( TLogPeekReply const& results, LogMessageVersion const& messageVersion, LogMessageVersion const& end, int32_t messageLength, int32_t rawLength, bool hasMsg, Version poppedVersion, Tag tag )
-			: results(results), tag(tag), rd(results.arena, results.messages, Unversioned()), messageVersion(messageVersion), end(end), messageLength(messageLength), rawLength(rawLength), hasMsg(hasMsg), randomID(g_random->randomUniqueID()), poppedVersion(poppedVersion), returnIfBlocked(false), sequence(0), parallelGetMore(false)
+			: results(results), tag(tag), rd(results.arena, results.messages, Unversioned()), messageVersion(messageVersion), end(end), messageLength(messageLength), rawLength(rawLength), hasMsg(hasMsg), randomID(g_random->randomUniqueID()), poppedVersion(poppedVersion), returnIfBlocked(false), sequence(0), parallelGetMore(false),
+			  lastResultTime(0), smoothedRoundTrip(0), smoothedResultInterval(0)
 {
 	//TraceEvent("SPC_clone", randomID);
 	this->results.maxKnownVersion = 0;
@@ -88,11 +135,8 @@ void ILogSystem::ServerPeekCursor::nextMessage() {
 
 	uint16_t tagCount;
 	rd.checkpoint();
-	rd >> messageLength >> messageVersion.sub >> tagCount;
-	tags.resize(tagCount);
-	for(int i = 0; i < tagCount; i++) {
-		rd >> tags[i];
-	}
+	const Tag* messageTags = readMessageHeader(rd, messageLength, messageVersion.sub, tagCount);
+	tags.assign(messageTags, messageTags + tagCount);
 	rawLength = messageLength + sizeof(messageLength);
 	messageLength -= (sizeof(messageVersion.sub) + sizeof(tagCount) + tagCount*sizeof(Tag));
 	hasMsg = true;
@@ -130,6 +174,27 @@ void ILogSystem::ServerPeekCursor::advanceTo(LogMessageVersion n) {
 	}
 }
 
+bool ILogSystem::ServerPeekCursor::acceptCompressed() {
+	// Replies are only worth compressing when they cross the network
+	return SERVER_KNOBS->PEEK_REPLY_COMPRESSION && interf->get().present() && interf->get().interf().address().ip != g_network->getLocalAddress().ip;
+}
+
+int ILogSystem::ServerPeekCursor::parallelGetMoreWindow() {
+	// While catching up, keep enough requests outstanding to cover a round trip at the rate results arrive
+	if( smoothedResultInterval <= 0 )
+		return SERVER_KNOBS->PARALLEL_GET_MORE_REQUESTS;
+	double window = std::ceil( smoothedRoundTrip / smoothedResultInterval ) + 1;
+	return std::max<int>( SERVER_KNOBS->PARALLEL_GET_MORE_REQUESTS, std::min<double>( SERVER_KNOBS->PARALLEL_GET_MORE_MAX_REQUESTS, window ) );
+}
+
+void ILogSystem::ServerPeekCursor::resetParallelGetMore() {
+	randomID = g_random->randomUniqueID();
+	sequence = 0;
+	futureResults.clear();
+	futureResultSent.clear();
+	lastResultTime = 0;
+}
+
 ACTOR Future<Void> serverPeekParallelGetMore( ILogSystem::ServerPeekCursor* self, int taskID ) {
 	if( !self->interf || self->messageVersion >= self->end ) {
 		Void _ = wait( Future<Void>(Never()));
@@ -142,14 +207,28 @@ ACTOR Future<Void> serverPeekParallelGetMore( ILogSystem::ServerPeekCursor* self
 
 	loop {
 		try {
-			while(self->futureResults.size() < SERVER_KNOBS->PARALLEL_GET_MORE_REQUESTS && self->interf->get().present()) {
-				self->futureResults.push_back( brokenPromiseToNever( self->interf->get().interf().peekMessages.getReply(TLogPeekRequest(self->messageVersion.version,self->tag,self->returnIfBlocked, std::make_pair(self->randomID, self->sequence++)), taskID) ) );
+			while(self->futureResults.size() < self->parallelGetMoreWindow() && self->interf->get().present()) {
+				self->futureResultSent.push_back( std::make_pair( now(), (int)self->futureResults.size() ) );
+				self->futureResults.push_back( brokenPromiseToNever( self->interf->get().interf().peekMessages.getReply(TLogPeekRequest(self->messageVersion.version,self->tag,self->returnIfBlocked, std::make_pair(self->randomID, self->sequence++), self->acceptCompressed()), taskID) ) );
 			}
 
 			choose {
 				when( TLogPeekReply res = wait( self->interf->get().present() ? self->futureResults.front() : Never() ) ) {
+					std::pair<double, int> sent = self->futureResultSent.front();
 					self->futureResults.pop_front();
+					self->futureResultSent.pop_front();
+					if( res.end <= res.maxKnownVersion ) {
+						// The log had more data than it returned, so it answered this request as soon as the requests ahead of it
+						if( self->lastResultTime > 0 ) {
+							double interval = now() - self->lastResultTime;
+							self->smoothedResultInterval = self->smoothedResultInterval > 0 ? 0.9 * self->smoothedResultInterval + 0.1 * interval : interval;
+						}
+						double roundTrip = std::max( 0.0, now() - sent.first - sent.second * self->smoothedResultInterval );
+						self->smoothedRoundTrip = self->smoothedRoundTrip > 0 ? 0.9 * self->smoothedRoundTrip + 0.1 * roundTrip : roundTrip;
+					}
+					self->lastResultTime = now();
 					self->results = res;
+					self->results.uncompress();
 					if(res.popped.present())
 						self->poppedVersion = std::min( std::max(self->poppedVersion, res.popped.get()), self->end.version );
 					self->rd = ArenaReader( self->results.arena, self->results.messages, Unversioned() );
@@ -162,9 +241,7 @@ ACTOR Future<Void> serverPeekParallelGetMore( ILogSystem::ServerPeekCursor* self
 				}
 				when( Void _ = wait( self->interfaceChanged ) ) {
 					self->interfaceChanged = self->interf->onChange();
-					self->randomID = g_random->randomUniqueID();
-					self->sequence = 0;
-					self->futureResults.clear();
+					self->resetParallelGetMore();
 				}
 			}
 		} catch( Error &e ) {
@@ -174,9 +251,7 @@ ACTOR Future<Void> serverPeekParallelGetMore( ILogSystem::ServerPeekCursor* self
 			} else if(e.code() == error_code_timed_out) {
 				TraceEvent("PeekCursorTimedOut", self->randomID);
 				self->interfaceChanged = self->interf->onChange();
-				self->randomID = g_random->randomUniqueID();
-				self->sequence = 0;
-				self->futureResults.clear();
+				self->resetParallelGetMore();
 			} else {
 				throw e;
 			}
@@ -193,8 +268,9 @@ ACTOR Future<Void> serverPeekGetMore( ILogSystem::ServerPeekCursor* self, int ta
 		loop {
 			choose {
 				when( TLogPeekReply res = wait( self->interf->get().present() ?
-					brokenPromiseToNever( self->interf->get().interf().peekMessages.getReply(TLogPeekRequest(self->messageVersion.version,self->tag,self->returnIfBlocked), taskID) ) : Never() ) ) {
+					brokenPromiseToNever( self->interf->get().interf().peekMessages.getReply(TLogPeekRequest(self->messageVersion.version,self->tag,self->returnIfBlocked, Optional<std::pair<UID, int>>(), self->acceptCompressed()), taskID) ) : Never() ) ) {
 					self->results = res;
+					self->results.uncompress();
 					if(res.popped.present())
 						self->poppedVersion = std::min( std::max(self->poppedVersion, res.popped.get()), self->end.version );
 					self->rd = ArenaReader( self->results.arena, self->results.messages, Unversioned() );
@@ -54,24 +54,33 @@ struct MasterInterface {
 struct GetRateInfoRequest {
 	UID requesterID;
 	int64_t totalReleasedTransactions;
+	std::vector<std::pair<Key, int64_t>> tagReleasedTransactions;  // Transactions released for each tag since the last request
 	ReplyPromise<struct GetRateInfoReply> reply;
 
 	GetRateInfoRequest() {}
-	GetRateInfoRequest( UID const& requesterID, int64_t totalReleasedTransactions ) : requesterID(requesterID), totalReleasedTransactions(totalReleasedTransactions) {}
+	GetRateInfoRequest( UID const& requesterID, int64_t totalReleasedTransactions, std::vector<std::pair<Key, int64_t>> const& tagReleasedTransactions )
+		: requesterID(requesterID), totalReleasedTransactions(totalReleasedTransactions), tagReleasedTransactions(tagReleasedTransactions) {}
 
 	template <class Ar>
 	void serialize(Ar& ar) {
 		ar & requesterID & totalReleasedTransactions & reply;
+		if( ar.protocolVersion() >= 0x0FDB00A560060001LL ) {
+			ar & tagReleasedTransactions;
+		}
 	}
 };
 
 struct GetRateInfoReply {
 	double transactionRate;
 	double leaseDuration;
+	std::vector<std::pair<Key, double>> tagRates;  // The tags whose transactions this proxy should start no faster than the given rate
 
 	template <class Ar>
 	void serialize(Ar& ar) {
 		ar & transactionRate & leaseDuration;
+		if( ar.protocolVersion() >= 0x0FDB00A560060001LL ) {
+			ar & tagRates;
+		}
 	}
 };
 
@@ -36,6 +36,9 @@
 #include "fdbclient/Notified.h"
 #include "fdbclient/KeyRangeMap.h"
 #include "ConflictSet.h"
+#include "ShardTagIndex.h"
+#include "TrafficCapture.h"
+#include "flow/UnitTest.h"
 #include "flow/Stats.h"
 #include "ApplyMetadataMutation.h"
 #include "RecoveryState.h"
@@ -54,6 +57,11 @@ struct ProxyStats {
 	Counter mutationBytes;
 	Counter mutations;
 	Counter conflictRanges;
+	LatencySample grvLatency, commitLatency;
+	// The stages of commitLatency: waiting for the previous batch to start resolving, getting a commit version from the
+	// master, resolution, processing the resolved batch in order, pushing it to the TLogs (which includes their
+	// fsyncs), and replying
+	LatencySample commitQueueLatency, commitVersionLatency, commitResolutionLatency, commitProcessingLatency, commitLogPushLatency, commitReplyLatency;
 	Version lastCommitVersionAssigned;
 
 	Future<Void> logger;
@@ -62,7 +70,9 @@ struct ProxyStats {
 	  : cc("ProxyStats", id.toString()),
 		txnStartIn("txnStartIn", cc), txnStartOut("txnStartOut", cc), txnStartBatch("txnStartBatch", cc), txnSystemPriorityStartIn("txnSystemPriorityStartIn", cc), txnSystemPriorityStartOut("txnSystemPriorityStartOut", cc), txnBatchPriorityStartIn("txnBatchPriorityStartIn", cc), txnBatchPriorityStartOut("txnBatchPriorityStartOut", cc),
 		txnDefaultPriorityStartIn("txnDefaultPriorityStartIn", cc), txnDefaultPriorityStartOut("txnDefaultPriorityStartOut", cc), txnCommitIn("txnCommitIn", cc),	txnCommitVersionAssigned("txnCommitVersionAssigned", cc), txnCommitResolving("txnCommitResolving", cc), txnCommitResolved("txnCommitResolved", cc), txnCommitOut("txnCommitOut", cc),
-		txnCommitOutSuccess("txnCommitOutSuccess", cc), txnConflicts("txnConflicts", cc), commitBatchIn("commitBatchIn", cc), commitBatchOut("commitBatchOut", cc), mutationBytes("mutationBytes", cc), mutations("mutations", cc), conflictRanges("conflictRanges", cc), lastCommitVersionAssigned(0)
+		txnCommitOutSuccess("txnCommitOutSuccess", cc), txnConflicts("txnConflicts", cc), commitBatchIn("commitBatchIn", cc), commitBatchOut("commitBatchOut", cc), mutationBytes("mutationBytes", cc), mutations("mutations", cc), conflictRanges("conflictRanges", cc), grvLatency("GRVLatency", cc), commitLatency("CommitLatency", cc),
+		commitQueueLatency("CommitQueueLatency", cc), commitVersionLatency("CommitVersionLatency", cc), commitResolutionLatency("CommitResolutionLatency", cc), commitProcessingLatency("CommitProcessingLatency", cc),
+		commitLogPushLatency("CommitLogPushLatency", cc), commitReplyLatency("CommitReplyLatency", cc), lastCommitVersionAssigned(0)
 	{
 		specialCounter(cc, "lastAssignedCommitVersion", [this](){return this->lastCommitVersionAssigned;});
 		specialCounter(cc, "version", [pVersion](){return *pVersion; });
@@ -82,7 +92,15 @@ Future<Void> forwardValue(Promise<T> out, Future<T> in)
 
 int getBytes(Promise<Version> const& r) { return 0; }
 
-ACTOR Future<Void> getRate(UID myID, MasterInterface master, int64_t* inTransactionCount, double* outTransactionRate) {
+// The rate at which transactions with a tag that Ratekeeper has throttled may start, and the number that may start now
+struct TagThrottle {
+	double rate;
+	double budget;
+
+	TagThrottle() : rate(0), budget(0) {}
+};
+
+ACTOR Future<Void> getRate(UID myID, MasterInterface master, int64_t* inTransactionCount, double* outTransactionRate, std::map<Key, int64_t>* inTagTransactionCounts, std::map<Key, TagThrottle>* outTagThrottles) {
 	state Future<Void> nextRequestTimer = Void();
 	state Future<Void> leaseTimeout = Never();
 	state Future<GetRateInfoReply> reply;
@@ -91,12 +109,25 @@ ACTOR Future<Void> getRate(UID myID, MasterInterface master, int64_t* inTransact
 	loop choose{
 		when(Void _ = wait(nextRequestTimer)) {
 			nextRequestTimer = Never();
-			reply = brokenPromiseToNever(master.getRateInfo.getReply(GetRateInfoRequest(myID, *inTransactionCount)));
+			std::vector<std::pair<Key, int64_t>> tagCounts(inTagTransactionCounts->begin(), inTagTransactionCounts->end());
+			inTagTransactionCounts->clear();
+			reply = brokenPromiseToNever(master.getRateInfo.getReply(GetRateInfoRequest(myID, *inTransactionCount, tagCounts)));
 		}
 		when(GetRateInfoReply rep = wait(reply)) {
 			reply = Never();
 			*outTransactionRate = rep.transactionRate;
-			TraceEvent("MasterProxyRate", myID).detail("Rate", rep.transactionRate).detail("Lease", rep.leaseDuration).detail("ReleasedTransactions", *inTransactionCount - lastTC);
+
+			std::map<Key, TagThrottle> throttles;
+			for (auto& t : rep.tagRates) {
+				auto& throttle = throttles[t.first];
+				auto old = outTagThrottles->find(t.first);
+				if (old != outTagThrottles->end())
+					throttle.budget = old->second.budget;
+				throttle.rate = t.second;
+			}
+			std::swap(*outTagThrottles, throttles);
+
+			TraceEvent("MasterProxyRate", myID).detail("Rate", rep.transactionRate).detail("Lease", rep.leaseDuration).detail("ReleasedTransactions", *inTransactionCount - lastTC).detail("ThrottledTags", rep.tagRates.size());
 			lastTC = *inTransactionCount;
 			leaseTimeout = delay(rep.leaseDuration);
 			nextRequestTimer = delayJittered(rep.leaseDuration / 2);
@@ -109,8 +140,19 @@ ACTOR Future<Void> getRate(UID myID, MasterInterface master, int64_t* inTransact
 	}
 }
 
-ACTOR Future<Void> queueTransactionStartRequests(std::priority_queue< std::pair<GetReadVersionRequest, int64_t>,
-	std::vector< std::pair<GetReadVersionRequest, int64_t> > > *transactionQueue,
+struct QueuedReadVersionRequest {
+	GetReadVersionRequest req;
+	int64_t order;  // Decreasing, so that requests of the same priority are started in the order in which they arrived
+	double arrivalTime;
+
+	QueuedReadVersionRequest(GetReadVersionRequest const& req, int64_t order) : req(req), order(order), arrivalTime(now()) {}
+
+	bool operator < (QueuedReadVersionRequest const& rhs) const {
+		return req.priority() < rhs.req.priority() || (req.priority() == rhs.req.priority() && order < rhs.order);
+	}
+};
+
+ACTOR Future<Void> queueTransactionStartRequests(std::priority_queue< QueuedReadVersionRequest > *transactionQueue,
 	FutureStream<GetReadVersionRequest> readVersionRequests,
 	PromiseStream<Void> GRVTimer, double *lastGRVTime,
 	double *GRVBatchTime, FutureStream<double> replyTimes,
@@ -136,7 +178,7 @@ ACTOR Future<Void> queueTransactionStartRequests(std::priority_queue< std::pair<
 				forwardPromise(GRVTimer, delayJittered(*GRVBatchTime - (now() - *lastGRVTime), TaskProxyGRVTimer));
 			}
 
-			transactionQueue->push(std::make_pair(req, counter--));
+			transactionQueue->push(QueuedReadVersionRequest(req, counter--));
 		}
 		// dynamic batching monitors reply latencies
 		when(double reply_latency = waitNext(replyTimes)) {
@@ -165,6 +207,69 @@ DESCR struct SingleKeyMutation {
 	int64_t tag3;
 };
 
+// Chooses how long the commit batcher waits and how many bytes it collects before cutting a batch. Without a target
+// latency this is a smoother over whole-batch latency. With one, the p99 time batches spend on the resolvers and on the
+// TLogs is tracked separately, and a fraction of whatever the target leaves over is spent waiting to form larger batches.
+struct CommitBatchController {
+	double interval;
+	int batchBytes;
+	int minBatchBytes;
+
+	LatencyHistogram resolverLatency, logLatency, commitLatency;
+	int64_t bytesSinceUpdate;
+	double lastUpdate;
+
+	CommitBatchController() : interval(SERVER_KNOBS->COMMIT_TRANSACTION_BATCH_INTERVAL_MIN), batchBytes(SERVER_KNOBS->COMMIT_TRANSACTION_BATCH_BYTES_MIN), minBatchBytes(batchBytes),
+		bytesSinceUpdate(0), lastUpdate(now()) {}
+
+	void setMinBatchBytes( int bytes ) {
+		minBatchBytes = batchBytes = bytes;
+	}
+
+	void addBatch( double resolving, double logging, double total, int bytes ) {
+		if( SERVER_KNOBS->COMMIT_BATCH_TARGET_LATENCY <= 0 ) {
+			double target_latency = total * SERVER_KNOBS->COMMIT_TRANSACTION_BATCH_INTERVAL_LATENCY_FRACTION;
+			interval = std::max(SERVER_KNOBS->COMMIT_TRANSACTION_BATCH_INTERVAL_MIN,
+				std::min(SERVER_KNOBS->COMMIT_TRANSACTION_BATCH_INTERVAL_MAX,
+					target_latency * SERVER_KNOBS->COMMIT_TRANSACTION_BATCH_INTERVAL_SMOOTHER_ALPHA + interval * (1-SERVER_KNOBS->COMMIT_TRANSACTION_BATCH_INTERVAL_SMOOTHER_ALPHA)));
+			return;
+		}
+
+		resolverLatency.record( resolving );
+		logLatency.record( logging );
+		commitLatency.record( total + interval ); // A transaction can also wait up to one interval in the batcher
+		bytesSinceUpdate += bytes;
+
+		if( now() - lastUpdate >= SERVER_KNOBS->COMMIT_BATCH_CONTROLLER_INTERVAL )
+			update();
+	}
+
+	void update() {
+		double target = SERVER_KNOBS->COMMIT_BATCH_TARGET_LATENCY;
+		double headroom = target - resolverLatency.percentile(0.99) - logLatency.percentile(0.99);
+		double desired = headroom * SERVER_KNOBS->COMMIT_BATCH_CONTROLLER_HEADROOM_FRACTION;
+
+		if( commitLatency.percentile(0.99) > target ) {
+			// The tail is already over target, so back off at once rather than through the smoother
+			desired = std::min( desired, interval / 2 );
+		} else {
+			desired = desired * SERVER_KNOBS->COMMIT_TRANSACTION_BATCH_INTERVAL_SMOOTHER_ALPHA + interval * (1-SERVER_KNOBS->COMMIT_TRANSACTION_BATCH_INTERVAL_SMOOTHER_ALPHA);
+		}
+		interval = std::max(SERVER_KNOBS->COMMIT_TRANSACTION_BATCH_INTERVAL_MIN, std::min(SERVER_KNOBS->COMMIT_TRANSACTION_BATCH_INTERVAL_MAX, desired));
+
+		// Cut a batch once it holds about an interval's worth of the recent commit bytes, so that a burst is sent on as
+		// soon as it makes a full batch instead of waiting out the interval
+		double bytesPerInterval = bytesSinceUpdate * interval / (now() - lastUpdate);
+		batchBytes = (int)std::max<double>(minBatchBytes, std::min<double>(SERVER_KNOBS->COMMIT_BATCH_CONTROLLER_BYTES_MAX, bytesPerInterval));
+
+		resolverLatency.clear();
+		logLatency.clear();
+		commitLatency.clear();
+		bytesSinceUpdate = 0;
+		lastUpdate = now();
+	}
+};
+
 struct ProxyCommitData {
 	UID dbgid;
 	ProxyStats stats;
@@ -186,6 +291,9 @@ struct ProxyCommitData {
 	bool firstProxy;
 	double lastCoalesceTime;
 	bool locked;
+	Version gossipedCommittedVersion;  // The largest committedVersion of all the proxies when the last gossip round started
+	double gossipedVersionTime;  // When that round started
+	bool gossipWanted;  // Whether a request for a gossiped read version has arrived since then
 
 	int64_t localCommitBatchesStarted;
 	NotifiedVersion latestLocalCommitBatchResolving;
@@ -197,8 +305,11 @@ struct ProxyCommitData {
 	RequestStream<CommitTransactionRequest> commit;
 	Database cx;
 	EventMetricHandle<SingleKeyMutation> singleKeyMutationEvent;
+	Reference<TrafficCapture> capture;  // Set if commits are being captured for replay
 
 	std::map<UID, Reference<StorageInfo>> storageCache;
+	uint64_t keyInfoGeneration;  // Changes whenever metadata mutations may have changed keyInfo or storage server tags
+	ShardTagIndex shardTagIndex;
 
 	//The tag related to a storage server rarely change, so we keep a vector of tags for each key range to be slightly more CPU efficient.
 	//When a tag related to a storage server does change, we empty out all of these vectors to signify they must be repopulated.
@@ -219,13 +330,54 @@ struct ProxyCommitData {
 		return tags;
 	}
 
+	// Appends the tags of the storage servers responsible for a normal mutation
+	void appendTagsForMutation(MutationRef const& m, vector<Tag>& out) {
+		if (shardTagIndex.update(keyInfo, keyInfoGeneration)) {
+			if (isSingleKeyMutation((MutationRef::Type) m.type))
+				shardTagIndex.appendTags(m.param1, out);
+			else if (m.type == MutationRef::ClearRange)
+				shardTagIndex.appendTags(KeyRangeRef(m.param1, m.param2), out);
+			else
+				UNREACHABLE();
+		}
+		else if (isSingleKeyMutation((MutationRef::Type) m.type)) {
+			auto& tags = tagsForKey(m.param1);
+			out.insert(out.end(), tags.begin(), tags.end());
+		}
+		else if (m.type == MutationRef::ClearRange) {
+			int begin = out.size();
+			int rangeCount = 0;
+			for (auto r : keyInfo.intersectingRanges(KeyRangeRef(m.param1, m.param2))) {
+				auto& tags = r.value().tags;
+				if(!tags.size()) {
+					for( auto info : r.value().src_info ) {
+						tags.push_back(info->tag);
+					}
+					for( auto info : r.value().dest_info ) {
+						tags.push_back(info->tag);
+					}
+					uniquify(tags);
+				}
+				out.insert(out.end(), tags.begin(), tags.end());
+				rangeCount++;
+			}
+			if (rangeCount > 1) {
+				std::sort(out.begin() + begin, out.end());
+				out.resize(std::unique(out.begin() + begin, out.end()) - out.begin());
+			}
+		}
+		else
+			UNREACHABLE();
+	}
+
 	ProxyCommitData(UID dbgid, MasterInterface master, RequestStream<GetReadVersionRequest> getConsistentReadVersion, Version recoveryTransactionVersion, RequestStream<CommitTransactionRequest> commit, Reference<AsyncVar<ServerDBInfo>> db, bool firstProxy)
 		: dbgid(dbgid), stats(dbgid, &version, &committedVersion), master(master), 
 			logAdapter(NULL), txnStateStore(NULL),
 			committedVersion(recoveryTransactionVersion), version(0), 
 			lastVersionTime(0), commitVersionRequestNumber(1), mostRecentProcessedRequestNumber(0),
 			getConsistentReadVersion(getConsistentReadVersion), commit(commit), lastCoalesceTime(0),
-			localCommitBatchesStarted(0), locked(false), firstProxy(firstProxy),
+			localCommitBatchesStarted(0), locked(false), gossipedCommittedVersion(recoveryTransactionVersion), gossipedVersionTime(0), gossipWanted(false),
+			firstProxy(firstProxy), keyInfoGeneration(0),
 			cx(openDBOnServer(db, TaskDefaultEndpoint, true, true)), singleKeyMutationEvent(LiteralStringRef("SingleKeyMutation"))
 	{}
 };
@@ -235,8 +387,9 @@ struct ResolutionRequestBuilder {
 	vector<ResolveTransactionBatchRequest> requests;
 	vector<vector<int>> transactionResolverMap;
 	vector<CommitTransactionRef*> outTr;
+	bool hasMetadataMutations;
 
-	ResolutionRequestBuilder( ProxyCommitData* self, Version version, Version prevVersion, Version lastReceivedVersion) : self(self), requests(self->resolvers.size()) {
+	ResolutionRequestBuilder( ProxyCommitData* self, Version version, Version prevVersion, Version lastReceivedVersion) : self(self), requests(self->resolvers.size()), hasMetadataMutations(false) {
 		for(auto& req : requests) {
 			req.prevVersion = prevVersion;
 			req.version = version;
@@ -270,6 +423,7 @@ struct ResolutionRequestBuilder {
 			}
 			if (isMetadataMutation(m)) {
 				isTXNStateTransaction = true;
+				hasMetadataMutations = true;
 				getOutTransaction(0, trIn.read_snapshot).mutations.push_back(requests[0].arena, m);
 			}
 		}
@@ -314,7 +468,7 @@ struct ResolutionRequestBuilder {
 ACTOR Future<Void> commitBatch(
 	ProxyCommitData* self,
 	vector<CommitTransactionRequest> trs,
-	double *commitBatchTime)
+	CommitBatchController *batchController)
 {
 	state int64_t localBatchNumber = ++self->localCommitBatchesStarted;
 	state LogPushData toCommit(self->logSystem);
@@ -336,6 +490,11 @@ ACTOR Future<Void> commitBatch(
 		}
 	}
 
+	if(!debugID.present() && trs.size() && g_nondeterministic_random->random01() < SERVER_KNOBS->COMMIT_DEBUG_SAMPLE_RATE) {
+		// Trace a sample of the batches through the proxy and the TLogs as if one of their transactions had a debug ID
+		debugID = g_nondeterministic_random->randomUniqueID();
+	}
+
 	if(localBatchNumber == 2 && !debugID.present() && self->firstProxy && !g_network->isSimulated()) {
 		debugID = g_random->randomUniqueID();
 		TraceEvent("SecondCommitBatch", self->dbgid).detail("debugID", debugID.get());
@@ -353,12 +512,15 @@ ACTOR Future<Void> commitBatch(
 	TEST(self->latestLocalCommitBatchResolving.get() < localBatchNumber-1); // Queuing pre-resolution commit processing 
 	Void _ = wait(self->latestLocalCommitBatchResolving.whenAtLeast(localBatchNumber-1));
 	Void _ = wait(yield());
+	state double versionStart = now();
+	self->stats.commitQueueLatency.addMeasurement(versionStart - t1, trs.size());
 
 	if (debugID.present())
 		g_traceBatch.addEvent("CommitDebug", debugID.get().first(), "MasterProxyServer.commitBatch.GettingCommitVersion");
 
 	Future<GetCommitVersionReply> fVersionReply = waitNext(self->commitBatchVersions.getFuture());
 	GetCommitVersionReply versionReply = wait(fVersionReply);
+	self->stats.commitVersionLatency.addMeasurement(now() - versionStart, trs.size());
 	self->mostRecentProcessedRequestNumber = versionReply.requestNum;
 
 	self->stats.txnCommitVersionAssigned += trs.size();
@@ -401,12 +563,31 @@ ACTOR Future<Void> commitBatch(
 	}
 
 	state vector<vector<int>> transactionResolverMap = std::move( requests.transactionResolverMap );
+	state bool hasMetadataMutations = requests.hasMetadataMutations;
 
 	ASSERT(self->latestLocalCommitBatchResolving.get() == localBatchNumber-1);
 	self->latestLocalCommitBatchResolving.set(localBatchNumber);
 
+	// While the resolvers work, look up the tags of every mutation in the batch ahead of the ordered post-resolution phase.
+	// The lookups are only used if no metadata mutations (including ones in this batch) have been applied in the meantime.
+	state uint64_t speculativeTagsGeneration = self->keyInfoGeneration;
+	state vector<Tag> speculativeTags;
+	state vector<int> speculativeTagOffsets;  // Mutation i of the batch has tags speculativeTags[speculativeTagOffsets[i]] up to speculativeTags[speculativeTagOffsets[i+1]]
+	if (self->version && !hasMetadataMutations && !self->singleKeyMutationEvent->enabled) {
+		for (auto& tr : trs) {
+			for (auto& m : tr.transaction.mutations) {
+				speculativeTagOffsets.push_back(speculativeTags.size());
+				self->appendTagsForMutation(m, speculativeTags);
+			}
+		}
+		speculativeTagOffsets.push_back(speculativeTags.size());
+	}
+
 	/////// Phase 2: Resolution (waiting on the network; pipelined)
+	state double resolveStart = now();
 	state vector<ResolveTransactionBatchReply> resolution = wait( getAll(replies) );
+	state double resolveLatency = now() - resolveStart;
+	self->stats.commitResolutionLatency.addMeasurement(resolveLatency, trs.size());
 
 	if (debugID.present())
 		g_traceBatch.addEvent("CommitDebug", debugID.get().first(), "MasterProxyServer.commitBatch.AfterResolution");
@@ -445,6 +626,8 @@ ACTOR Future<Void> commitBatch(
 			bool committed = true;
 			for (int resolver = 0; resolver < resolution.size(); resolver++)
 				committed = committed && resolution[resolver].stateMutations[versionIndex][transactionIndex].committed;
+			if (committed && resolution[0].stateMutations[versionIndex][transactionIndex].mutations.size())
+				self->keyInfoGeneration++;
 			if (committed)
 				applyMetadataMutations( self->dbgid, arena, resolution[0].stateMutations[versionIndex][transactionIndex].mutations, self->txnStateStore, NULL, &forceRecovery, self->logSystem, 0, &self->vecBackupKeys, &self->keyInfo, self->firstProxy ? &self->uid_applyMutationsData : NULL, self->commit, self->cx, &self->committedVersion, &self->storageCache );
 			
@@ -502,6 +685,8 @@ ACTOR Future<Void> commitBatch(
 	}
 
 	// This first pass through committed transactions deals with "metadata" effects (modifications of txnStateStore, changes to storage servers' responsibilities)
+	if (hasMetadataMutations)
+		self->keyInfoGeneration++;
 	int t;
 	state int commitCount = 0;
 	for (t = 0; t < trs.size() && !forceRecovery; t++)
@@ -543,6 +728,10 @@ ACTOR Future<Void> commitBatch(
 	state Arena logRangeMutationsArena;
 	state uint32_t v = commitVersion / CLIENT_KNOBS->LOG_RANGE_BLOCK_SIZE;
 
+	bool useSpeculativeTags = speculativeTagOffsets.size() && speculativeTagsGeneration == self->keyInfoGeneration && !self->singleKeyMutationEvent->enabled;
+	TEST(speculativeTagOffsets.size() && !useSpeculativeTags); // Speculative tags invalidated by metadata mutations
+	int mutationIndex = 0;
+
 	for (int t = 0; t<trs.size(); t++) {
 
 		if (committed[t] == ConflictBatch::TransactionCommitted && (!locked || trs[t].isLockAware())) {
@@ -553,7 +742,16 @@ ACTOR Future<Void> commitBatch(
 				// Determine the set of tags (responsible storage servers) for the mutation, splitting it
 				// if necessary.  Serialize (splits of) the mutation into the message buffer and add the tags.
 
-				if (isSingleKeyMutation((MutationRef::Type) m.type)) {
+				if (useSpeculativeTags) {
+					int tagsEnd = speculativeTagOffsets[mutationIndex+1];
+					if (debugMutation("ProxyCommit", commitVersion, m))
+						TraceEvent("ProxyCommitTo", self->dbgid).detail("To", describe(vector<Tag>(speculativeTags.begin() + speculativeTagOffsets[mutationIndex], speculativeTags.begin() + tagsEnd))).detail("Mutation", m.toString()).detail("Version", commitVersion);
+					for (int i = speculativeTagOffsets[mutationIndex]; i < tagsEnd; i++)
+						toCommit.addTag(speculativeTags[i]);
+					toCommit.addTypedMessage(m);
+					mutationIndex++;
+				}
+				else if (isSingleKeyMutation((MutationRef::Type) m.type)) {
 					auto& tags = self->tagsForKey(m.param1);
 	
 					if(self->singleKeyMutationEvent->enabled) {
@@ -674,6 +872,9 @@ ACTOR Future<Void> commitBatch(
 				}
 			}
 		}
+		else {
+			mutationIndex += trs[t].transaction.mutations.size();
+		}
 	}
 
 	// Serialize and backup the mutations as a single mutation
@@ -798,7 +999,11 @@ ACTOR Future<Void> commitBatch(
 	}
 
 	/////// Phase 4: Logging (network bound; pipelined up to MAX_READ_TRANSACTION_LIFE_VERSIONS (limited by loop above))
+	state double logStart = now();
+	self->stats.commitProcessingLatency.addMeasurement(logStart - resolveStart - resolveLatency, trs.size());
 	Void _ = wait(loggingComplete);
+	state double logLatency = now() - logStart;
+	self->stats.commitLogPushLatency.addMeasurement(logLatency, trs.size());
 	Void _ = wait(yield());
 
 	/////// Phase 5: Replies (CPU bound; no particular order required, though ordered execution would be best for latency)	
@@ -841,6 +1046,8 @@ ACTOR Future<Void> commitBatch(
 
 	++self->stats.commitBatchOut;
 	self->stats.txnCommitOut += trs.size();
+	self->stats.commitLatency.addMeasurement(now() - t1, trs.size());  // From the start of the batch, not counting the time spent in the batcher
+	self->stats.commitReplyLatency.addMeasurement(now() - logStart - logLatency, trs.size());
 	self->stats.txnConflicts += trs.size() - commitCount;
 	self->stats.txnCommitOutSuccess += commitCount;
 
@@ -861,11 +1068,10 @@ ACTOR Future<Void> commitBatch(
 	}
 
 	// Dynamic batching for commits
-	double target_latency = (now() - t1) * SERVER_KNOBS->COMMIT_TRANSACTION_BATCH_INTERVAL_LATENCY_FRACTION;
-	*commitBatchTime = 
-		std::max(SERVER_KNOBS->COMMIT_TRANSACTION_BATCH_INTERVAL_MIN, 
-			std::min(SERVER_KNOBS->COMMIT_TRANSACTION_BATCH_INTERVAL_MAX, 
-				target_latency * SERVER_KNOBS->COMMIT_TRANSACTION_BATCH_INTERVAL_SMOOTHER_ALPHA + *commitBatchTime * (1-SERVER_KNOBS->COMMIT_TRANSACTION_BATCH_INTERVAL_SMOOTHER_ALPHA)));
+	int batchBytes = 0;
+	for (auto& tr : trs)
+		batchBytes += getBytes(tr);
+	batchController->addBatch(resolveLatency, logLatency, now() - t1, batchBytes);
 
 
 	return Void();
@@ -914,6 +1120,60 @@ ACTOR Future<GetReadVersionReply> getLiveCommittedVersion(ProxyCommitData* commi
 	return rep;
 }
 
+// While requests for gossiped read versions keep arriving, asks the other proxies for their committed versions every
+// PROXY_VERSION_GOSSIP_INTERVAL, so that those requests can be answered without waiting on the other proxies
+ACTOR Future<Void> gossipCommittedVersions(ProxyCommitData* commitData, vector<MasterProxyInterface>* otherProxies)
+{
+	state double roundStart;
+	state Version version;
+	loop {
+		Void _ = wait(delay(SERVER_KNOBS->PROXY_VERSION_GOSSIP_INTERVAL, TaskProxyGRVTimer));
+		if (!commitData->gossipWanted)
+			continue;
+
+		commitData->gossipWanted = false;
+		roundStart = now();
+		version = commitData->committedVersion.get();
+		vector<Future<GetReadVersionReply>> proxyVersions;
+		for (auto const& p : *otherProxies)
+			proxyVersions.push_back(brokenPromiseToNever(p.getRawCommittedVersion.getReply(GetRawCommittedVersionRequest(), TaskTLogConfirmRunningReply)));
+
+		vector<GetReadVersionReply> versions = wait(getAll(proxyVersions));
+		for (auto v : versions)
+			version = std::max(version, v.version);
+		commitData->gossipedCommittedVersion = std::max(commitData->gossipedCommittedVersion, version);
+		commitData->gossipedVersionTime = roundStart;
+	}
+}
+
+// Like getLiveCommittedVersion for FLAG_CAUSAL_READ_RISKY, except that the other proxies' committed versions come from the
+// last gossip round instead of being requested for this batch.  The version is committed, and it includes every
+// transaction that was reported committed before that round started.
+void replyWithGossipedVersion(ProxyCommitData* commitData, vector<ReplyPromise<GetReadVersionReply>>& replies, int transactionCount, int systemTransactionCount, int defaultPriTransactionCount, int batchPriTransactionCount)
+{
+	++commitData->stats.txnStartBatch;
+
+	GetReadVersionReply rep;
+	rep.version = std::max(commitData->committedVersion.get(), commitData->gossipedCommittedVersion);
+	rep.locked = commitData->locked;
+	for (auto& r : replies)
+		r.send(rep);
+
+	commitData->stats.txnStartOut += transactionCount;
+	commitData->stats.txnSystemPriorityStartOut += systemTransactionCount;
+	commitData->stats.txnDefaultPriorityStartOut += defaultPriTransactionCount;
+	commitData->stats.txnBatchPriorityStartOut += batchPriTransactionCount;
+}
+
+// Records, once the reply is ready, the time since each of the requests it answers arrived
+ACTOR Future<Void> recordLatencies(Future<GetReadVersionReply> reply, vector<double> arrivalTimes, LatencySample* latency)
+{
+	GetReadVersionReply _ = wait(reply);
+	for (double t : arrivalTimes)
+		latency->addMeasurement(now() - t);
+	return Void();
+}
+
 ACTOR Future<Void> fetchVersions(ProxyCommitData *commitData) {
 	loop {
 		Void _ = waitNext(commitData->commitBatchStartNotifications.getFuture());
@@ -927,7 +1187,8 @@ ACTOR static Future<Void> transactionStarter(
 	MasterInterface master,
 	Reference<AsyncVar<ServerDBInfo>> db,
 	PromiseStream<Future<Void>> addActor,
-	ProxyCommitData* commitData
+	ProxyCommitData* commitData,
+	bool grvProxy
 	)
 {
 	state double lastGRVTime = 0;
@@ -937,15 +1198,15 @@ ACTOR static Future<Void> transactionStarter(
 	state int64_t transactionCount = 0;
 	state double transactionBudget = 0;
 	state double transactionRate = 10;
-	state std::priority_queue<std::pair<GetReadVersionRequest, int64_t>, std::vector<std::pair<GetReadVersionRequest, int64_t>>> transactionQueue;
+	state std::priority_queue<QueuedReadVersionRequest> transactionQueue;
 	state vector<MasterProxyInterface> otherProxies;
+	state std::map<Key, int64_t> tagTransactionCounts;
+	state std::map<Key, TagThrottle> tagThrottles;
 
 	state PromiseStream<double> replyTimes;
-	addActor.send(getRate(proxy.id(), master, &transactionCount, &transactionRate));
-	addActor.send(queueTransactionStartRequests(&transactionQueue, proxy.getConsistentReadVersion.getFuture(), GRVTimer, &lastGRVTime, &GRVBatchTime, replyTimes.getFuture(), &commitData->stats));
 
-	// Get a list of the other proxies that go together with us
-	while (std::find(db->get().client.proxies.begin(), db->get().client.proxies.end(), proxy) == db->get().client.proxies.end())
+	// Get a list of the other proxies that go together with us.  For a GRV proxy, that is every commit proxy.
+	while (!std::count(db->get().client.proxies.begin(), db->get().client.proxies.end(), proxy) && !std::count(db->get().client.grvProxies.begin(), db->get().client.grvProxies.end(), proxy))
 		Void _ = wait(db->onChange());
 	for (MasterProxyInterface mp : db->get().client.proxies) {
 		if (mp != proxy)
@@ -954,6 +1215,18 @@ ACTOR static Future<Void> transactionStarter(
 
 	ASSERT(db->get().recoveryState >= RecoveryState::FULLY_RECOVERED);  // else potentially we could return uncommitted read versions (since self->committedVersion is only a committed version if this recovery succeeds)
 
+	if (!grvProxy && db->get().client.grvProxies.size()) {
+		// Clients get their read versions from the GRV proxies, and so does commitBatch when it is limited by the MVCC
+		// window.  Not asking Ratekeeper for a rate leaves all of it to the GRV proxies.
+		commitData->getConsistentReadVersion = g_random->randomChoice(db->get().client.grvProxies).getConsistentReadVersion;
+		TraceEvent("ProxyLeavingTxnStartsToGrvProxies", proxy.id()).detail("GrvProxies", db->get().client.grvProxies.size());
+		return Void();
+	}
+
+	addActor.send(getRate(proxy.id(), master, &transactionCount, &transactionRate, &tagTransactionCounts, &tagThrottles));
+	addActor.send(queueTransactionStartRequests(&transactionQueue, proxy.getConsistentReadVersion.getFuture(), GRVTimer, &lastGRVTime, &GRVBatchTime, replyTimes.getFuture(), &commitData->stats));
+	addActor.send(gossipCommittedVersions(commitData, &otherProxies));
+
 	TraceEvent("ProxyReadyForTxnStarts", proxy.id());
 
 	loop{
@@ -966,40 +1239,69 @@ ACTOR static Future<Void> transactionStarter(
 		if(elapsed == 0) elapsed = 1e-15; // resolve a possible indeterminant multiplication with infinite transaction rate
 		double nTransactionsToStart = std::min(transactionRate * elapsed, SERVER_KNOBS->START_TRANSACTION_MAX_TRANSACTIONS_TO_START) + transactionBudget;
 
-		int transactionsStarted[2] = {0,0};
-		int systemTransactionsStarted[2] = {0,0};
-		int defaultPriTransactionsStarted[2] = { 0, 0 };
-		int batchPriTransactionsStarted[2] = { 0, 0 };
+		int transactionsStarted[3] = {0,0,0};
+		int systemTransactionsStarted[3] = {0,0,0};
+		int defaultPriTransactionsStarted[3] = { 0, 0, 0 };
+		int batchPriTransactionsStarted[3] = { 0, 0, 0 };
 
-		vector<vector<ReplyPromise<GetReadVersionReply>>> start(2);  // start[0] is transactions starting with !(flags&CAUSAL_READ_RISKY), start[1] is transactions starting with flags&CAUSAL_READ_RISKY
+		vector<vector<ReplyPromise<GetReadVersionReply>>> start(3);  // start[0] is transactions starting with !(flags&CAUSAL_READ_RISKY), start[1] is transactions starting with flags&CAUSAL_READ_RISKY, start[2] is transactions answered with the gossiped version
+		vector<vector<double>> arrivalTimes(3);  // Of the requests in start, for the GRV latency
+		bool gossipedVersionUsable = now() - commitData->gossipedVersionTime <= SERVER_KNOBS->PROXY_VERSION_GOSSIP_MAX_AGE;
+
+		for (auto& t : tagThrottles)
+			t.second.budget = std::min(t.second.budget + t.second.rate * elapsed, std::max(t.second.rate * SERVER_KNOBS->START_TRANSACTION_TAG_BURST_SECONDS, 1.0));
+		vector<QueuedReadVersionRequest> throttled;  // Requests left in the queue because their tag is over its rate
 		Optional<UID> debugID;
 
 		double leftToStart = 0;
 		while (!transactionQueue.empty()) {
-			auto& req = transactionQueue.top().first;
+			auto& req = transactionQueue.top().req;
 			int tc = req.transactionCount;
-			leftToStart = nTransactionsToStart - transactionsStarted[0] - transactionsStarted[1];
+			leftToStart = nTransactionsToStart - transactionsStarted[0] - transactionsStarted[1] - transactionsStarted[2];
 
 			bool startNext = tc < leftToStart || req.priority() >= GetReadVersionRequest::PRIORITY_SYSTEM_IMMEDIATE || tc * g_random->random01() < leftToStart - std::max(0.0, transactionBudget);
 			if (!startNext) break;
 
+			if (req.tag.size()) {
+				auto throttle = tagThrottles.find(req.tag);
+				if (throttle != tagThrottles.end() && req.priority() < GetReadVersionRequest::PRIORITY_SYSTEM_IMMEDIATE) {
+					if (throttle->second.budget <= 0) {
+						throttled.push_back(transactionQueue.top());
+						transactionQueue.pop();
+						continue;
+					}
+					throttle->second.budget -= tc;
+				}
+				tagTransactionCounts[req.tag] += tc;
+			}
+
 			if (req.debugID.present()) {
 				if (!debugID.present()) debugID = g_nondeterministic_random->randomUniqueID();
 				g_traceBatch.addAttach("TransactionAttachID", req.debugID.get().first(), debugID.get().first());
 			}
-			start[req.flags & 1].push_back(std::move(req.reply));  static_assert(GetReadVersionRequest::FLAG_CAUSAL_READ_RISKY == 1, "Implementation dependent on flag value");
+			int kind = req.flags & 1;  static_assert(GetReadVersionRequest::FLAG_CAUSAL_READ_RISKY == 1, "Implementation dependent on flag value");
+			if (req.flags & GetReadVersionRequest::FLAG_USE_GOSSIPED_VERSION) {
+				// Until a recent gossip round has completed, such requests are treated as causal read risky
+				commitData->gossipWanted = true;
+				kind = gossipedVersionUsable ? 2 : 1;
+			}
+			start[kind].push_back(std::move(req.reply));
+			arrivalTimes[kind].push_back(transactionQueue.top().arrivalTime);
 
-			transactionsStarted[req.flags&1] += tc;
+			transactionsStarted[kind] += tc;
 			if (req.priority() >= GetReadVersionRequest::PRIORITY_SYSTEM_IMMEDIATE)
-				systemTransactionsStarted[req.flags & 1] += tc;
+				systemTransactionsStarted[kind] += tc;
 			else if (req.priority() >= GetReadVersionRequest::PRIORITY_DEFAULT)
-				defaultPriTransactionsStarted[req.flags & 1] += tc;
+				defaultPriTransactionsStarted[kind] += tc;
 			else
-				batchPriTransactionsStarted[req.flags & 1] += tc;
+				batchPriTransactionsStarted[kind] += tc;
 
 			transactionQueue.pop();
 		}
 
+		for (auto& r : throttled)
+			transactionQueue.push(std::move(r));
+
 		if (!transactionQueue.empty())
 			forwardPromise(GRVTimer, delayJittered(SERVER_KNOBS->START_TRANSACTION_BATCH_QUEUE_CHECK_INTERVAL, TaskProxyGRVTimer));
 
@@ -1021,15 +1323,22 @@ ACTOR static Future<Void> transactionStarter(
 			addActor.send(timeReply(GRVReply.getFuture(), replyTimes));
 		}
 
-		transactionCount += transactionsStarted[0] + transactionsStarted[1];
-		transactionBudget = std::max(std::min(nTransactionsToStart - transactionsStarted[0] - transactionsStarted[1], SERVER_KNOBS->START_TRANSACTION_MAX_BUDGET_SIZE), -SERVER_KNOBS->START_TRANSACTION_MAX_BUDGET_SIZE);
+		transactionCount += transactionsStarted[0] + transactionsStarted[1] + transactionsStarted[2];
+		transactionBudget = std::max(std::min(nTransactionsToStart - transactionsStarted[0] - transactionsStarted[1] - transactionsStarted[2], SERVER_KNOBS->START_TRANSACTION_MAX_BUDGET_SIZE), -SERVER_KNOBS->START_TRANSACTION_MAX_BUDGET_SIZE);
 		if (debugID.present())
 			g_traceBatch.addEvent("TransactionDebug", debugID.get().first(), "MasterProxyServer.masterProxyServerCore.Broadcast");
-		for (int i = 0; i<start.size(); i++) {
+		for (int i = 0; i<2; i++) {
 			if (start[i].size()) {
-				addActor.send(broadcast(getLiveCommittedVersion(commitData, i, &otherProxies, debugID, transactionsStarted[i], systemTransactionsStarted[i], defaultPriTransactionsStarted[i], batchPriTransactionsStarted[i]), start[i]));
+				Future<GetReadVersionReply> reply = getLiveCommittedVersion(commitData, i, &otherProxies, debugID, transactionsStarted[i], systemTransactionsStarted[i], defaultPriTransactionsStarted[i], batchPriTransactionsStarted[i]);
+				addActor.send(broadcast(reply, start[i]));
+				addActor.send(recordLatencies(reply, arrivalTimes[i], &commitData->stats.grvLatency));
 			}
 		}
+		if (start[2].size()) {
+			replyWithGossipedVersion(commitData, start[2], transactionsStarted[2], systemTransactionsStarted[2], defaultPriTransactionsStarted[2], batchPriTransactionsStarted[2]);
+			for (double t : arrivalTimes[2])
+				commitData->stats.grvLatency.addMeasurement(now() - t);
+		}
 	}
 }
 
@@ -1145,9 +1454,11 @@ ACTOR Future<Void> masterProxyServerCore(
 	Reference<AsyncVar<ServerDBInfo>> db,
 	LogEpoch epoch,
 	Version recoveryTransactionVersion,
-	bool firstProxy)
+	bool firstProxy,
+	int txsSnapshotSpeedup)
 {
 	state ProxyCommitData commitData(proxy.id(), master, proxy.getConsistentReadVersion, recoveryTransactionVersion, proxy.commit, db, firstProxy);
+	commitData.capture = TrafficCapture::open( "proxy", proxy.id() );
 
 	state Future<Sequence> sequenceFuture = (Sequence)0;
 	state PromiseStream< vector<CommitTransactionRequest> > batchedCommits;
@@ -1160,7 +1471,11 @@ ACTOR Future<Void> masterProxyServerCore(
 	state double lastCommit = 0;
 	state std::set<Sequence> txnSequences;
 	state Sequence maxSequence = std::numeric_limits<Sequence>::max();
-	state double commitBatchInterval = SERVER_KNOBS->COMMIT_TRANSACTION_BATCH_INTERVAL_MIN;
+	state CommitBatchController batchController;
+
+	CommitBatchController* controller = &batchController;
+	specialCounter(commitData.stats.cc, "commitBatchIntervalMicros", [controller](){ return int64_t(controller->interval * 1e6); });
+	specialCounter(commitData.stats.cc, "commitBatchBytes", [controller](){ return controller->batchBytes; });
 
 	addActor.send( fetchVersions(&commitData) );
 	addActor.send( waitFailureServer(proxy.waitFailure.getFuture()) );
@@ -1184,10 +1499,10 @@ ACTOR Future<Void> masterProxyServerCore(
 
 	commitData.logSystem = ILogSystem::fromServerDBInfo(proxy.id(), db->get());
 	commitData.logAdapter = new LogSystemDiskQueueAdapter(commitData.logSystem, txsTag, false);
-	commitData.txnStateStore = keyValueStoreLogSystem(commitData.logAdapter, proxy.id(), 2e9, true);
+	commitData.txnStateStore = keyValueStoreLogSystem(commitData.logAdapter, proxy.id(), 2e9, true, txsSnapshotSpeedup);
 	onError = onError || commitData.logSystem->onError();
 
-	addActor.send(transactionStarter(proxy, master, db, addActor, &commitData));
+	addActor.send(transactionStarter(proxy, master, db, addActor, &commitData, false));
 	addActor.send(readRequestServer(proxy, &commitData));
 
 	// wait for txnStateStore recovery
@@ -1197,16 +1512,21 @@ ACTOR Future<Void> masterProxyServerCore(
 		(int)std::min<double>(SERVER_KNOBS->COMMIT_TRANSACTION_BATCH_BYTES_MAX, 
 			std::max<double>(SERVER_KNOBS->COMMIT_TRANSACTION_BATCH_BYTES_MIN, 
 				SERVER_KNOBS->COMMIT_TRANSACTION_BATCH_BYTES_SCALE_BASE * pow(db->get().client.proxies.size(), SERVER_KNOBS->COMMIT_TRANSACTION_BATCH_BYTES_SCALE_POWER)));
-	commitBatcher = batcher(batchedCommits, proxy.commit.getFuture(), SERVER_KNOBS->COMMIT_TRANSACTION_BATCH_INTERVAL_FROM_IDLE, &commitBatchInterval, SERVER_KNOBS->MAX_COMMIT_BATCH_INTERVAL, SERVER_KNOBS->COMMIT_TRANSACTION_BATCH_COUNT_MAX, commitBatchByteLimit, CLIENT_KNOBS->TRANSACTION_SIZE_LIMIT, commitData.commitBatchStartNotifications, TaskProxyCommitBatcher, &commitData.stats.txnCommitIn);
+	batchController.setMinBatchBytes(commitBatchByteLimit);
+	commitBatcher = batcher(batchedCommits, proxy.commit.getFuture(), SERVER_KNOBS->COMMIT_TRANSACTION_BATCH_INTERVAL_FROM_IDLE, &batchController.interval, SERVER_KNOBS->MAX_COMMIT_BATCH_INTERVAL, SERVER_KNOBS->COMMIT_TRANSACTION_BATCH_COUNT_MAX, &batchController.batchBytes, CLIENT_KNOBS->TRANSACTION_SIZE_LIMIT, commitData.commitBatchStartNotifications, TaskProxyCommitBatcher, &commitData.stats.txnCommitIn);
 	loop choose{
 		when(Void _ = wait(onError)) {}
 		when(vector<CommitTransactionRequest> trs = waitNext(batchedCommits.getFuture())) {
 			//TraceEvent("MasterProxyCTR", proxy.id()).detail("CommitTransactions", trs.size()).detail("TransactionRate", transactionRate).detail("TransactionQueue", transactionQueue.size()).detail("ReleasedTransactionCount", transactionCount);
 			if (trs.size() || (db->get().recoveryState >= RecoveryState::FULLY_RECOVERED && now() - lastCommit >= SERVER_KNOBS->MAX_COMMIT_BATCH_INTERVAL)) {
 				lastCommit = now();
+				if (commitData.capture) {
+					for (auto& tr : trs)
+						commitData.capture->commit(tr.transaction);
+				}
 
 				if (trs.size() || lastCommitComplete.isReady()) {
-					lastCommitComplete = commitBatch(&commitData, trs, &commitBatchInterval);
+					lastCommitComplete = commitBatch(&commitData, trs, &batchController);
 					addActor.send(lastCommitComplete);
 				}
 			}
@@ -1234,6 +1554,7 @@ ACTOR Future<Void> masterProxyServerCore(
 
 				if(txnSequences.size() == maxSequence) {
 					state KeyRange txnKeys = allKeys;
+					state std::vector<MapPair<Key,ServerCacheInfo>> keyInfoData;
 					loop {
 						Void _ = wait(yield());
 						Standalone<VectorRef<KeyValueRef>> data = commitData.txnStateStore->readRange(txnKeys, SERVER_KNOBS->BUGGIFIED_ROW_LIMIT, SERVER_KNOBS->APPLY_MUTATION_BYTES).get();
@@ -1241,7 +1562,6 @@ ACTOR Future<Void> masterProxyServerCore(
 						((KeyRangeRef&)txnKeys) = KeyRangeRef( keyAfter(data.back().key, txnKeys.arena()), txnKeys.end );
 
 						Standalone<VectorRef<MutationRef>> mutations;
-						std::vector<std::pair<MapPair<Key,ServerCacheInfo>,int>> keyInfoData;
 						vector<UID> src, dest;
 						Reference<StorageInfo> storageInfo;
 						ServerCacheInfo info;
@@ -1282,21 +1602,25 @@ ACTOR Future<Void> masterProxyServerCore(
 										info.dest_info.push_back( storageInfo );
 									}
 									uniquify(info.tags);
-									keyInfoData.push_back( std::make_pair(MapPair<Key,ServerCacheInfo>(k, info), 1) );
+									keyInfoData.push_back( MapPair<Key,ServerCacheInfo>(k, info) );
 								}
 							} else {
 								mutations.push_back(mutations.arena(), MutationRef(MutationRef::SetValue, kv.key, kv.value));
 							}
 						}
-						
-						//insert keyTag data separately from metadata mutations so that we can do one bulk insert which avoids a lot of map lookups.
-						commitData.keyInfo.rawInsert(keyInfoData); 
 
 						Arena arena;
 						bool confChanges;
 						applyMetadataMutations(commitData.dbgid, arena, mutations, commitData.txnStateStore, NULL, &confChanges, Reference<ILogSystem>(), 0, &commitData.vecBackupKeys, &commitData.keyInfo, commitData.firstProxy ? &commitData.uid_applyMutationsData : NULL, commitData.commit, commitData.cx, &commitData.committedVersion, &commitData.storageCache, true);
 					}
 
+					// keyTag data is kept apart from the metadata mutations, which do not touch keyInfo in an initial
+					// commit, so that keyInfo can be built from all of the shard boundaries at once in linear time
+					if( keyInfoData.empty() || keyInfoData[0].key != allKeys.begin )
+						keyInfoData.insert( keyInfoData.begin(), MapPair<Key,ServerCacheInfo>(allKeys.begin, ServerCacheInfo()) );
+					commitData.keyInfo.assign( std::move(keyInfoData) );
+					commitData.keyInfoGeneration++;
+
 					auto lockedKey = commitData.txnStateStore->readValue(databaseLockedKey).get();
 					commitData.locked = lockedKey.present() && lockedKey.get().size();
 
@@ -1309,9 +1633,36 @@ ACTOR Future<Void> masterProxyServerCore(
 	}
 }
 
+// Answers GetReadVersionRequests in place of the commit proxies, which it asks for their committed versions.  Since it
+// commits nothing itself, its own committedVersion stays at 0, and every version it returns is one that a commit proxy
+// reported.
+ACTOR Future<Void> grvProxyServerCore(
+	MasterProxyInterface proxy,
+	MasterInterface master,
+	Reference<AsyncVar<ServerDBInfo>> db)
+{
+	state ProxyCommitData commitData(proxy.id(), master, proxy.getConsistentReadVersion, 0, proxy.commit, db, false);
+	state PromiseStream<Future<Void>> addActor;
+	state Future<Void> onError = actorCollection(addActor.getFuture());
+
+	addActor.send( waitFailureServer(proxy.waitFailure.getFuture()) );
+
+	while (!(db->get().master.id() == master.id() && db->get().recoveryState >= RecoveryState::RECOVERY_TRANSACTION))
+		Void _ = wait(db->onChange());
+
+	commitData.logSystem = ILogSystem::fromServerDBInfo(proxy.id(), db->get());
+	onError = onError || commitData.logSystem->onError();
+
+	addActor.send(transactionStarter(proxy, master, db, addActor, &commitData, true));
+
+	Void _ = wait(onError);
+	return Void();
+}
+
 ACTOR Future<Void> checkRemoved(Reference<AsyncVar<ServerDBInfo>> db, uint64_t recoveryCount, MasterProxyInterface myInterface) {
 	loop{
-		if (db->get().recoveryCount >= recoveryCount && !std::count(db->get().client.proxies.begin(), db->get().client.proxies.end(), myInterface))
+		if (db->get().recoveryCount >= recoveryCount && !std::count(db->get().client.proxies.begin(), db->get().client.proxies.end(), myInterface) &&
+			!std::count(db->get().client.grvProxies.begin(), db->get().client.grvProxies.end(), myInterface))
 		throw worker_removed();
 		Void _ = wait(db->onChange());
 	}
@@ -1323,7 +1674,8 @@ ACTOR Future<Void> masterProxyServer(
 	Reference<AsyncVar<ServerDBInfo>> db)
 {
 	try {
-		state Future<Void> core = masterProxyServerCore(proxy, req.master, db, req.recoveryCount, req.recoveryTransactionVersion, req.firstProxy);
+		state Future<Void> core = req.grvOnly ? grvProxyServerCore(proxy, req.master, db) :
+			masterProxyServerCore(proxy, req.master, db, req.recoveryCount, req.recoveryTransactionVersion, req.firstProxy, req.txsSnapshotSpeedup);
 		loop choose{
 			when(Void _ = wait(core)) { return Void(); }
 			when(Void _ = wait(checkRemoved(db, req.recoveryCount, proxy))) {}
@@ -1340,3 +1692,89 @@ ACTOR Future<Void> masterProxyServer(
 		throw;
 	}
 }
+
+static void appendTagsFromMap(KeyRangeMap<ServerCacheInfo>& keyInfo, KeyRangeRef range, vector<Tag>& out) {
+	std::set<Tag> allTags;
+	for (auto r : keyInfo.intersectingRanges(range)) {
+		for (auto info : r.value().src_info)
+			allTags.insert(info->tag);
+		for (auto info : r.value().dest_info)
+			allTags.insert(info->tag);
+	}
+	out.insert(out.end(), allTags.begin(), allTags.end());
+}
+
+TEST_CASE("fdbserver/MasterProxyServer/ShardTagIndex") {
+	state KeyRangeMap<ServerCacheInfo> keyInfo;
+	state int shards = 10000;
+	state vector<Reference<StorageInfo>> servers;
+	for (int s = 0; s < 100; s++) {
+		Reference<StorageInfo> info(new StorageInfo());
+		info->tag = Tag(0, s);
+		servers.push_back(info);
+	}
+	for (int i = 1; i < shards; i++) {
+		ServerCacheInfo info;
+		for (int r = 0; r < 3; r++)
+			info.src_info.push_back(servers[g_random->randomInt(0, servers.size())]);
+		if (g_random->random01() < 0.1)
+			info.dest_info.push_back(servers[g_random->randomInt(0, servers.size())]);
+		keyInfo.insert(KeyRangeRef(StringRef(format("%08d", i)), i+1 < shards ? StringRef(format("%08d", i+1)) : allKeys.end), info);
+	}
+
+	ShardTagIndex index;
+	index.rebuild(keyInfo, 1);
+	ASSERT(index.update(keyInfo, 1));
+	ASSERT(index.shardCount() == shards);
+
+	int lookups = 100000;
+	vector<Standalone<StringRef>> keys;
+	for (int i = 0; i < lookups; i++)
+		keys.push_back(StringRef(format("%08d", g_random->randomInt(0, shards + 1))));
+
+	// Point lookups and clears agree with the map
+	vector<Tag> expected, actual;
+	for (int i = 0; i < 1000; i++) {
+		KeyRef begin = keys[i], end = keys[i+1];
+		if (end < begin)
+			std::swap(begin, end);
+		KeyRangeRef range = begin == end ? singleKeyRange(begin, keys[i].arena()) : KeyRangeRef(begin, end);
+
+		expected.clear();
+		actual.clear();
+		appendTagsFromMap(keyInfo, singleKeyRange(range.begin, keys[i].arena()), expected);
+		index.appendTags(range.begin, actual);
+		std::sort(actual.begin(), actual.end());
+		ASSERT(actual == expected);
+
+		expected.clear();
+		actual.clear();
+		appendTagsFromMap(keyInfo, range, expected);
+		index.appendTags(range, actual);
+		ASSERT(actual == expected);
+	}
+
+	// A newer keyInfo generation is not served until enough lookups have missed
+	ASSERT(!index.update(keyInfo, 2));
+
+	double start = timer();
+	int64_t total = 0;
+	for (auto& key : keys) {
+		auto& r = keyInfo.rangeContaining(key).value();
+		total += r.src_info.size() + r.dest_info.size();
+	}
+	double mapTime = timer() - start;
+
+	start = timer();
+	for (auto& key : keys) {
+		actual.clear();
+		index.appendTags(key, actual);
+		total += actual.size();
+	}
+	double indexTime = timer() - start;
+
+	printf("ShardTagIndex: %d lookups over %d shards: KeyRangeMap %f us/lookup, index %f us/lookup (%lld)\n",
+		lookups, shards, mapTime * 1e6 / lookups, indexTime * 1e6 / lookups, (long long)total);
+
+	return Void();
+}
@@ -168,16 +168,22 @@ ACTOR Future<vector<vector<Optional<UID>>>> findReadWriteDestinations(Standalone
 // Set keyServers[keys].dest = servers
 // Set serverKeys[servers][keys] = active for each subrange of keys that the server did not already have, complete for each subrange that it already has
 // Set serverKeys[dest][keys] = "" for the dest servers of each existing shard in keys (unless that destination is a member of servers OR if the source list is sufficiently degraded)
-ACTOR Future<Void> startMoveKeys( Database occ, KeyRange keys, vector<UID> servers,
-								 MoveKeysLock lock, int durableStorageQuorum,
-								 FlowLock *startMoveKeysLock, UID relocationIntervalId ) {
+bool anyCancelled( std::vector<Reference<StartMoveKeysRequest>> const& requests ) {
+	for(auto& r : requests)
+		if( r->cancelled )
+			return true;
+	return false;
+}
+
+// Writes the start of the move of keys to servers.  keys may also cover the claimed moves of other relocations; if one of
+// them is cancelled before the last transaction, returns false without retrying, since a retry could overwrite a move
+// that replaced it.
+ACTOR Future<bool> startMoveKeysTransactions( Database occ, KeyRange keys, vector<UID> servers, MoveKeysLock lock,
+								 std::vector<Reference<StartMoveKeysRequest>> const* claimed, UID relocationIntervalId ) {
 	state TraceInterval interval("RelocateShard_StartMoveKeys");
 	//state TraceInterval waitInterval("");
 
-	Void _ = wait( startMoveKeysLock->take( TaskDataDistributionLaunch ) );
-	state FlowLock::Releaser releaser( *startMoveKeysLock );
-
-	TraceEvent(SevDebug, interval.begin(), relocationIntervalId);
+	TraceEvent(SevDebug, interval.begin(), relocationIntervalId).detail("CoalescedMoves", claimed->size());
 
 	try {
 		state Key begin = keys.begin;
@@ -198,6 +204,12 @@ ACTOR Future<Void> startMoveKeys( Database occ, KeyRange keys, vector<UID> serve
 				try {
 					retries++;
 
+					if( anyCancelled( *claimed ) ) {
+						TEST(true); // startMoveKeys gave up the moves it claimed because one was cancelled
+						TraceEvent(SevDebug, interval.end(), relocationIntervalId).detail("Batches", batches).detail("Shards", shards).detail("ClaimedMoveCancelled", true);
+						return false;
+					}
+
 					//Keep track of old dests that may need to have ranges removed from serverKeys
 					state std::set<UID> oldDests;
 
@@ -339,7 +351,105 @@ ACTOR Future<Void> startMoveKeys( Database occ, KeyRange keys, vector<UID> serve
 		throw;
 	}
 
-	return Void();
+	return true;
+}
+
+void claimStart( StartMoveKeysQueue* queue, std::map<Key, Reference<StartMoveKeysRequest>>::iterator it, std::vector<Reference<StartMoveKeysRequest>>& claimed ) {
+	it->second->claimed = true;
+	claimed.push_back( it->second );
+	queue->waiting.erase( it );
+}
+
+// Claims the waiting moves that extend keys on either side with a range going to the same servers, and returns the
+// range of keys those moves and this one cover together
+KeyRange claimAdjacentStarts( StartMoveKeysQueue* queue, KeyRange keys, vector<UID> const& servers, std::vector<Reference<StartMoveKeysRequest>>& claimed ) {
+	Key begin = keys.begin;
+	Key end = keys.end;
+	while( claimed.size() + 1 < SERVER_KNOBS->DD_MOVE_KEYS_COALESCE_LIMIT ) {
+		auto next = queue->waiting.find( end );
+		if( next == queue->waiting.end() || next->second->servers != servers )
+			break;
+		end = next->second->keys.end;
+		claimStart( queue, next, claimed );
+	}
+	while( claimed.size() + 1 < SERVER_KNOBS->DD_MOVE_KEYS_COALESCE_LIMIT ) {
+		auto prev = queue->waiting.lower_bound( begin );
+		if( prev == queue->waiting.begin() )
+			break;
+		--prev;
+		if( prev->second->keys.end != begin || prev->second->servers != servers )
+			break;
+		begin = prev->second->keys.begin;
+		claimStart( queue, prev, claimed );
+	}
+	return KeyRangeRef( begin, end );
+}
+
+void removeWaitingStart( StartMoveKeysQueue* queue, Reference<StartMoveKeysRequest> const& request ) {
+	auto it = queue->waiting.find( request->keys.begin );
+	if( it != queue->waiting.end() && it->second.getPtr() == request.getPtr() )
+		queue->waiting.erase( it );
+}
+
+// Starts moving keys to servers once a start permit is free, unless a move that got a permit first starts it along with
+// its own range
+ACTOR Future<Void> startMoveKeys( Database occ, KeyRange keys, vector<UID> servers,
+								 MoveKeysLock lock, int durableStorageQuorum,
+								 StartMoveKeysQueue *queue, UID relocationIntervalId ) {
+	state Reference<StartMoveKeysRequest> request( new StartMoveKeysRequest( keys, servers ) );
+	state std::vector<Reference<StartMoveKeysRequest>> claimed;
+	state FlowLock::Releaser releaser;
+
+	try {
+		loop {
+			request->started = Promise<Void>();
+			request->claimed = false;
+			if( SERVER_KNOBS->DD_MOVE_KEYS_COALESCE_LIMIT > 1 && !queue->waiting.count( keys.begin ) )
+				queue->waiting[ keys.begin ] = request;
+
+			state bool startedElsewhere = false;
+			choose {
+				when( ErrorOr<Void> started = wait( errorOr( request->started.getFuture() ) ) ) {
+					startedElsewhere = !started.isError();
+				}
+				when( Void _ = wait( queue->parallelismLock.take( TaskDataDistributionLaunch ) ) ) {
+					releaser = FlowLock::Releaser( queue->parallelismLock );
+					if( request->claimed ) {
+						// Claimed while this move was waiting for the permit, so the permit is not needed
+						releaser.release();
+						ErrorOr<Void> started = wait( errorOr( request->started.getFuture() ) );
+						startedElsewhere = !started.isError();
+					} else {
+						removeWaitingStart( queue, request );
+						KeyRange range = claimAdjacentStarts( queue, keys, servers, claimed );
+						TEST( claimed.size() ); // startMoveKeys started adjacent moves to the same servers together
+
+						bool done = wait( startMoveKeysTransactions( occ, range, servers, lock, &claimed, relocationIntervalId ) );
+						if( !done ) {
+							for(auto& r : claimed)
+								r->started.sendError( operation_cancelled() );
+							claimed.clear();
+							bool ownDone = wait( startMoveKeysTransactions( occ, keys, servers, lock, &claimed, relocationIntervalId ) );
+							ASSERT( ownDone );
+						}
+						for(auto& r : claimed)
+							r->started.send( Void() );
+						claimed.clear();
+						return Void();
+					}
+				}
+			}
+			if( startedElsewhere )
+				return Void();
+			// The move that claimed this one gave up, so wait for a permit again
+		}
+	} catch( Error& e ) {
+		request->cancelled = e.code() == error_code_actor_cancelled;
+		removeWaitingStart( queue, request );
+		for(auto& r : claimed)
+			r->started.sendError( operation_cancelled() );
+		throw;
+	}
 }
 
 ACTOR Future<Void> waitForShardReady( StorageServerInterface server, KeyRange keys, Version minVersion, GetShardStateRequest::waitMode mode){
@@ -826,13 +936,13 @@ ACTOR Future<Void> moveKeys(
 	MoveKeysLock lock,
 	int durableStorageQuorum,
 	Promise<Void> dataMovementComplete,
-	FlowLock *startMoveKeysParallelismLock,
+	StartMoveKeysQueue *startMoveKeysQueue,
 	FlowLock *finishMoveKeysParallelismLock,
 	UID relocationIntervalId)
 {
 	ASSERT( destinationTeam.size() );
 	std::sort( destinationTeam.begin(), destinationTeam.end() );
-	Void _ = wait( startMoveKeys( cx, keys, destinationTeam, lock, durableStorageQuorum, startMoveKeysParallelismLock, relocationIntervalId ) );
+	Void _ = wait( startMoveKeys( cx, keys, destinationTeam, lock, durableStorageQuorum, startMoveKeysQueue, relocationIntervalId ) );
 
 	state Future<Void> completionSignaller = checkFetchingState( cx, healthyDestinations, keys, dataMovementComplete, relocationIntervalId );
 
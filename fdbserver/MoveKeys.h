@@ -33,6 +33,25 @@ struct MoveKeysLock {
 	void serialize(Ar& ar) { ar & prevOwner & myOwner & prevWrite; }
 };
 
+struct StartMoveKeysRequest : ReferenceCounted<StartMoveKeysRequest> {
+	KeyRange keys;
+	vector<UID> servers;
+	Promise<Void> started;  // An error means the move that claimed this one gave up, and this one has to start itself
+	bool claimed, cancelled;
+
+	StartMoveKeysRequest( KeyRange const& keys, vector<UID> const& servers ) : keys(keys), servers(servers), claimed(false), cancelled(false) {}
+};
+
+// The moves that are waiting for one of a limited number of start permits.  A move that gets a permit also starts the
+// waiting moves of adjacent ranges to the same servers (up to DD_MOVE_KEYS_COALESCE_LIMIT moves), so that the keyServers
+// and serverKeys of a run of shards headed for one team are written by one series of transactions instead of one per shard.
+struct StartMoveKeysQueue : NonCopyable {
+	FlowLock parallelismLock;
+	std::map<Key, Reference<StartMoveKeysRequest>> waiting;  // By keys.begin, holding no permit and not claimed
+
+	explicit StartMoveKeysQueue( int parallelism ) : parallelismLock( parallelism ) {}
+};
+
 Future<MoveKeysLock> takeMoveKeysLock( Database const& cx, UID const& masterId );
 // Calling moveKeys, etc with the return value of this actor ensures that no movekeys, etc
 // has been executed by a different locker since takeMoveKeysLock().
@@ -58,7 +77,7 @@ Future<Void> moveKeys(
 	MoveKeysLock const& lock,
 	int const& durableStorageQuorum,
 	Promise<Void> const& dataMovementComplete,
-	FlowLock* const& startMoveKeysParallelismLock,
+	StartMoveKeysQueue* const& startMoveKeysQueue,
 	FlowLock* const& finishMoveKeysParallelismLock,
 	UID const& relocationIntervalId);  // for logging only
 // Eventually moves the given keys to the given destination team
@@ -27,6 +27,7 @@
 
 struct NetworkTestInterface {
 	RequestStream< struct NetworkTestRequest > test;
+	RequestStream< struct NetworkTestStreamRequest > stream;  // One way, for NETWORK_TEST_STREAM
 	NetworkTestInterface() {}
 	NetworkTestInterface( NetworkAddress remote );
 	NetworkTestInterface( INetwork* local );
@@ -44,6 +45,16 @@ struct NetworkTestRequest {
 	}
 };
 
+struct NetworkTestStreamRequest {
+	Value payload;
+	NetworkTestStreamRequest() {}
+	explicit NetworkTestStreamRequest( Value payload ) : payload(payload) {}
+	template <class Ar>
+	void serialize(Ar& ar) {
+		ar & payload;
+	}
+};
+
 struct NetworkTestReply {
 	Value value;
 	NetworkTestReply() {}
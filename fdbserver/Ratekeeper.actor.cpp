@@ -26,6 +26,7 @@
 #include "fdbrpc/Smoother.h"
 #include "ServerDBInfo.h"
 #include "fdbrpc/simulator.h"
+#include "flow/UnitTest.h"
 
 enum limitReason_t {
 	unlimited,  // TODO: rename to workload?
@@ -86,10 +87,12 @@ struct StorageQueueInfo {
 	Smoother smoothTotalSpace;
 	double readReplyRate;
 	limitReason_t limitReason;
+	double queueGrowthRate;  // Bytes per second by which input outpaces durability; negative while the queue drains
+	int64_t projectedQueue;  // The queue expected STORAGE_QUEUE_PROJECTION_TIME from now at queueGrowthRate, as updateRate() last computed it
 	StorageQueueInfo(UID id, LocalityData locality) : valid(false), id(id), locality(locality), smoothDurableBytes(SERVER_KNOBS->SMOOTHING_AMOUNT),
 		smoothInputBytes(SERVER_KNOBS->SMOOTHING_AMOUNT), verySmoothDurableBytes(SERVER_KNOBS->SLOW_SMOOTHING_AMOUNT),
 		smoothDurableVersion(1.), smoothLatestVersion(1.), smoothFreeSpace(SERVER_KNOBS->SMOOTHING_AMOUNT),
-		smoothTotalSpace(SERVER_KNOBS->SMOOTHING_AMOUNT), readReplyRate(0.0), limitReason(limitReason_t::unlimited)
+		smoothTotalSpace(SERVER_KNOBS->SMOOTHING_AMOUNT), readReplyRate(0.0), limitReason(limitReason_t::unlimited), queueGrowthRate(0), projectedQueue(0)
 	{
 		// FIXME: this is a tacky workaround for a potential unitialized use in trackStorageServerQueueInfo
 		lastReply.instanceID = -1;
@@ -118,6 +121,8 @@ struct Ratekeeper {
 	std::map<UID, std::pair<int64_t, double> > proxy_transactionCountAndTime;
 	Smoother smoothReleasedTransactions, smoothTotalDurableBytes;
 	double TPSLimit;
+	std::map<Key, Smoother> tagReleasedTransactions;
+	std::map<Key, double> tagLimits;  // The cluster wide rate limit of each throttled tag
 	Standalone<StringRef> dbName;
 	DatabaseConfiguration configuration;
 
@@ -250,6 +255,50 @@ ACTOR Future<Void> trackEachStorageServer(
 	}
 }
 
+bool compareTagRates( std::pair<Key, double> const& a, std::pair<Key, double> const& b ) { return a.second < b.second; }
+
+// Divides tpsLimit among the given tags and the untagged transactions as evenly as their rates allow (so that anything
+// starting less than an even share keeps its rate), and returns the tags with more than their share, each limited to it
+std::map<Key, double> computeTagLimits( double tpsLimit, double untaggedRate, std::vector<std::pair<Key, double>> rates ) {
+	rates.push_back( std::make_pair( Key(), untaggedRate ) );
+	std::sort( rates.begin(), rates.end(), compareTagRates );
+
+	std::map<Key, double> limits;
+	double remaining = tpsLimit;
+	for(int i = 0; i < rates.size(); i++) {
+		double share = remaining / (rates.size() - i);
+		if( rates[i].second > share ) {
+			for(; i < rates.size(); i++)
+				if( rates[i].first.size() )
+					limits[ rates[i].first ] = share;
+			break;
+		}
+		remaining -= rates[i].second;
+	}
+	return limits;
+}
+
+void updateTagLimits( Ratekeeper* self ) {
+	self->tagLimits.clear();
+
+	double releasedTPS = self->smoothReleasedTransactions.smoothRate();
+	double taggedTPS = 0;
+	std::vector<std::pair<Key, double>> rates;
+	for(auto t = self->tagReleasedTransactions.begin(); t != self->tagReleasedTransactions.end(); ) {
+		double rate = t->second.smoothRate();
+		if( rate < 0.01 ) {
+			t = self->tagReleasedTransactions.erase(t);  // The tag has been idle for a while
+			continue;
+		}
+		rates.push_back( std::make_pair( t->first, rate ) );
+		taggedTPS += rate;
+		++t;
+	}
+
+	if( rates.size() && releasedTPS > SERVER_KNOBS->TAG_THROTTLE_RATIO * self->TPSLimit )
+		self->tagLimits = computeTagLimits( self->TPSLimit, std::max( releasedTPS - taggedTPS, 0.0 ), rates );
+}
+
 void updateRate( Ratekeeper* self ) {
 	//double controlFactor = ;  // dt / eFoldingTime
 
@@ -268,6 +317,9 @@ void updateRate( Ratekeeper* self ) {
 	int64_t worstFreeSpaceStorageServer = std::numeric_limits<int64_t>::max();
 	int64_t worstStorageQueueStorageServer = 0;
 	int64_t limitingStorageQueueStorageServer = 0;
+	int64_t worstProjectedQueueStorageServer = 0;
+	int64_t limitingProjectedQueueStorageServer = 0;
+	double limitingQueueGrowthRateStorageServer = 0;
 
 	std::multimap<double, StorageQueueInfo*> storageTPSLimitReverseIndex;
 
@@ -297,7 +349,13 @@ void updateRate( Ratekeeper* self ) {
 
 		int64_t storageQueue = ss.lastReply.bytesInput - ss.smoothDurableBytes.smoothTotal();
 		worstStorageQueueStorageServer = std::max(worstStorageQueueStorageServer, storageQueue);
-		int64_t b = storageQueue - targetBytes;
+
+		// Throttle on where a growing queue is heading rather than where it is, so that a server falling behind is slowed
+		// before it passes its target instead of after.  A draining queue is not projected, so recovery is not anticipated.
+		ss.queueGrowthRate = ss.smoothInputBytes.smoothRate() - ss.smoothDurableBytes.smoothRate();
+		ss.projectedQueue = storageQueue + (int64_t)(std::max(0.0, ss.queueGrowthRate) * SERVER_KNOBS->STORAGE_QUEUE_PROJECTION_TIME);
+		worstProjectedQueueStorageServer = std::max(worstProjectedQueueStorageServer, ss.projectedQueue);
+		int64_t b = ss.projectedQueue - targetBytes;
 		double targetRateRatio = std::min(( b + springBytes ) / (double)springBytes, 2.0);
 
 		double inputRate = ss.smoothInputBytes.smoothRate();
@@ -347,17 +405,27 @@ void updateRate( Ratekeeper* self ) {
 		}
 	}
 
+	// The slowest machines are left out of the limit, since every shard they hold has other replicas to serve it while
+	// they catch up.  Which ones they are, and why they would have throttled the cluster, is traced for each of them.
 	std::set<Optional<Standalone<StringRef>>> ignoredMachines;
 	for(auto ss = storageTPSLimitReverseIndex.begin(); ss != storageTPSLimitReverseIndex.end() && ss->first < self->TPSLimit; ++ss) {
 		if(ignoredMachines.size() < std::min(self->configuration.storageTeamSize - 1, SERVER_KNOBS->MAX_MACHINES_FALLING_BEHIND)) {
 			ignoredMachines.insert(ss->second->locality.zoneId());
-			continue;
 		}
 		if(ignoredMachines.count(ss->second->locality.zoneId()) > 0) {
+			TraceEvent("RkStorageServerIgnored", ss->second->id).suppressFor(1.0)
+				.detail("TPSLimit", ss->first)
+				.detail("Reason", ss->second->limitReason)
+				.detail("Queue", ss->second->lastReply.bytesInput - ss->second->smoothDurableBytes.smoothTotal())
+				.detail("ProjectedQueue", ss->second->projectedQueue)
+				.detail("QueueGrowthRate", ss->second->queueGrowthRate)
+				.detailext("Zone", ss->second->locality.zoneId());
 			continue;
 		}
 
 		limitingStorageQueueStorageServer = ss->second->lastReply.bytesInput - ss->second->smoothDurableBytes.smoothTotal();
+		limitingProjectedQueueStorageServer = ss->second->projectedQueue;
+		limitingQueueGrowthRateStorageServer = ss->second->queueGrowthRate;
 		self->TPSLimit = ss->first;
 		limitReason = storageTPSLimitReverseIndex.begin()->second->limitReason;
 		reasonID = storageTPSLimitReverseIndex.begin()->second->id; // Although we aren't controlling based on the worst SS, we still report it as the limiting process
@@ -485,6 +553,8 @@ void updateRate( Ratekeeper* self ) {
 	self->tpsLimitMetric = std::min(self->TPSLimit, 1e6);
 	self->reasonMetric = limitReason;
 
+	updateTagLimits( self );
+
 	if( self->smoothReleasedTransactions.smoothRate() > SERVER_KNOBS->LAST_LIMITED_RATIO * self->TPSLimit ) {
 		(*self->lastLimited) = now();
 	}
@@ -498,12 +568,17 @@ void updateRate( Ratekeeper* self ) {
 			.detail("TPSBasis", actualTPS)
 			.detail("StorageServers", sscount)
 			.detail("Proxies", self->proxy_transactionCountAndTime.size())
+			.detail("Tags", self->tagReleasedTransactions.size())
+			.detail("ThrottledTags", self->tagLimits.size())
 			.detail("TLogs", tlcount)
 			.detail("ReadReplyRate", readReplyRateSum)
 			.detail("WorstFreeSpaceStorageServer", worstFreeSpaceStorageServer)
 			.detail("WorstFreeSpaceTLog", worstFreeSpaceTLog)
 			.detail("WorstStorageServerQueue", worstStorageQueueStorageServer)
 			.detail("LimitingStorageServerQueue", limitingStorageQueueStorageServer)
+			.detail("WorstStorageServerProjectedQueue", worstProjectedQueueStorageServer)
+			.detail("LimitingStorageServerProjectedQueue", limitingProjectedQueueStorageServer)
+			.detail("LimitingStorageServerQueueGrowthRate", limitingQueueGrowthRateStorageServer)
 			.detail("WorstTLogQueue", worstStorageQueueTLog)
 			.detail("TotalDiskUsageBytes", totalDiskUsageBytes)
 			.detail("WorstStorageServerVersionLag", worstVersionLag)
@@ -566,7 +641,12 @@ ACTOR Future<Void> rateKeeper(
 				p.first = req.totalReleasedTransactions;
 				p.second = now();
 
+				for(auto& t : req.tagReleasedTransactions)
+					self.tagReleasedTransactions.insert( std::make_pair( t.first, Smoother(SERVER_KNOBS->SMOOTHING_AMOUNT) ) ).first->second.addDelta( t.second );
+
 				reply.transactionRate = self.TPSLimit / self.proxy_transactionCountAndTime.size();
+				for(auto& t : self.tagLimits)
+					reply.tagRates.push_back( std::make_pair( t.first, t.second / self.proxy_transactionCountAndTime.size() ) );
 				reply.leaseDuration = SERVER_KNOBS->METRIC_UPDATE_RATE;
 				req.reply.send( reply );
 			}
@@ -583,3 +663,26 @@ ACTOR Future<Void> rateKeeper(
 	}
 	return Void();
 }
+
+TEST_CASE("fdbserver/Ratekeeper/computeTagLimits") {
+	std::vector<std::pair<Key, double>> rates;
+	rates.push_back( std::make_pair( LiteralStringRef("quiet"), 10.0 ) );
+	rates.push_back( std::make_pair( LiteralStringRef("noisy"), 900.0 ) );
+
+	// The untagged transactions and the quiet tag keep their rates, and the noisy tag gets what is left
+	std::map<Key, double> limits = computeTagLimits( 500, 100, rates );
+	ASSERT( limits.size() == 1 && limits[LiteralStringRef("noisy")] == 390 );
+
+	// Both tags start more than an even share, and so are each limited to it
+	limits = computeTagLimits( 300, 200, rates );
+	ASSERT( limits.size() == 1 && limits[LiteralStringRef("noisy")] == 145 );
+	rates[0].second = 400;
+	limits = computeTagLimits( 300, 200, rates );
+	ASSERT( limits.size() == 2 && limits[LiteralStringRef("quiet")] == 100 && limits[LiteralStringRef("noisy")] == 100 );
+
+	// Nothing is limited when there is room for everything
+	limits = computeTagLimits( 2000, 100, rates );
+	ASSERT( limits.empty() );
+
+	return Void();
+}
@@ -30,6 +30,7 @@
 #include "Orderer.actor.h"
 #include "ConflictSet.h"
 #include "StorageMetrics.h"
+#include "fdbrpc/Smoother.h"
 #include "fdbclient/SystemData.h"
 
 namespace {
@@ -44,7 +45,8 @@ struct ProxyRequestsInfo {
 namespace{
 struct Resolver : ReferenceCounted<Resolver> {
 	Resolver( UID dbgid, int proxyCount, int resolverCount )
-		: dbgid(dbgid), proxyCount(proxyCount), resolverCount(resolverCount), version(-1), conflictSet( newConflictSet() ), iopsSample( SERVER_KNOBS->IOPS_UNITS_PER_SAMPLE ), debugMinRecentStateVersion(0)
+		: dbgid(dbgid), proxyCount(proxyCount), resolverCount(resolverCount), version(-1), conflictSet( newConflictSet( g_network->isSimulated() ? 0 : SERVER_KNOBS->RESOLVER_CONFLICT_SET_THREADS ) ), iopsSample( SERVER_KNOBS->IOPS_UNITS_PER_SAMPLE ),
+		  smoothConflictTime( SERVER_KNOBS->RESOLVER_COST_SMOOTHING_TIME ), smoothConflictRanges( SERVER_KNOBS->RESOLVER_COST_SMOOTHING_TIME ), debugMinRecentStateVersion(0)
 	{
 	}
 	~Resolver() {
@@ -62,7 +64,25 @@ struct Resolver : ReferenceCounted<Resolver> {
 	AsyncTrigger checkNeededVersion;
 	std::map<NetworkAddress, ProxyRequestsInfo> proxyInfoMap;
 	ConflictSet *conflictSet;
-	TransientStorageMetricSample iopsSample;
+	TransientStorageMetricSample iopsSample;  // The cost of checking conflicts on each part of the key space, for resolutionBalancing()
+	Smoother smoothConflictTime, smoothConflictRanges;  // Recent time spent checking conflicts, and the conflict ranges checked in it
+
+	// The weight in iopsSample of the conflict ranges of a batch whose conflicts took conflictTime to check.  Ranges cost
+	// SAMPLE_OFFSET_PER_KEY plus their key size as before, scaled by how much more or less time the batch took per range
+	// than recent batches did, so parts of the key space whose batches are expensive to check (large or many overlapping
+	// ranges) weigh more without changing the units the master balances.
+	double conflictCostWeight( double conflictTime, int ranges ) {
+		if(!ranges)
+			return 1.0;
+		double recentRanges = smoothConflictRanges.smoothTotal();
+		double recentTime = smoothConflictTime.smoothTotal();
+		smoothConflictTime.addDelta( conflictTime );
+		smoothConflictRanges.addDelta( ranges );
+		if(recentRanges <= 0 || recentTime <= 0)
+			return 1.0;
+		double weight = ( conflictTime / ranges ) / ( recentTime / recentRanges );
+		return std::max( 1.0 / SERVER_KNOBS->RESOLVER_MAX_COST_WEIGHT, std::min( SERVER_KNOBS->RESOLVER_MAX_COST_WEIGHT, weight ) );
+	}
 
 	Version debugMinRecentStateVersion;
 };
@@ -142,16 +162,20 @@ ACTOR Future<Void> resolveBatch(
 		for(int t=0; t<req.transactions.size(); t++) {
 			conflictBatch.addTransaction( req.transactions[t] );
 			keys += req.transactions[t].write_conflict_ranges.size()*2 + req.transactions[t].read_conflict_ranges.size()*2;
-			
-			if(self->resolverCount > 1) {
+		}
+		conflictBatch.detectConflicts( req.version, req.version - SERVER_KNOBS->MAX_WRITE_TRANSACTION_LIFE_VERSIONS, commitList, &tooOldList);
+		double conflictTime = timer() - tstart;
+		g_counters.conflictTime += conflictTime;
+
+		if(self->resolverCount > 1) {
+			double weight = self->conflictCostWeight( conflictTime, keys/2 );
+			for(int t=0; t<req.transactions.size(); t++) {
 				for(auto it : req.transactions[t].write_conflict_ranges)
-					self->iopsSample.addAndExpire( it.begin, SERVER_KNOBS->SAMPLE_OFFSET_PER_KEY + it.begin.size(), expire );
+					self->iopsSample.addAndExpire( it.begin, int64_t( weight * (SERVER_KNOBS->SAMPLE_OFFSET_PER_KEY + it.begin.size()) ), expire );
 				for(auto it : req.transactions[t].read_conflict_ranges)
-					self->iopsSample.addAndExpire( it.begin, SERVER_KNOBS->SAMPLE_OFFSET_PER_KEY + it.begin.size(), expire );
+					self->iopsSample.addAndExpire( it.begin, int64_t( weight * (SERVER_KNOBS->SAMPLE_OFFSET_PER_KEY + it.begin.size()) ), expire );
 			}
 		}
-		conflictBatch.detectConflicts( req.version, req.version - SERVER_KNOBS->MAX_WRITE_TRANSACTION_LIFE_VERSIONS, commitList, &tooOldList);
-		g_counters.conflictTime += timer() - tstart;
 		++g_counters.conflictBatches;
 		g_counters.conflictTransactions += req.transactions.size();
 		g_counters.conflictKeys += keys;
@@ -259,6 +283,21 @@ ACTOR Future<Void> resolveBatch(
 	return Void();
 }
 
+// Removes the conflict history before the oldest version that can still be resolved, a few nodes at a time at low
+// priority, so that a backlog the pruning after each batch cannot keep up with is removed while the resolver is idle
+// rather than by the next batches.  Waits for the oldest version to advance once a whole pass has found nothing.
+ACTOR Future<Void> pruneVersionHistory( Reference<Resolver> self ) {
+	loop {
+		state int removed = 0;
+		state bool more = pruneConflictSet( self->conflictSet, SERVER_KNOBS->RESOLVER_PRUNE_NODES_PER_STEP, &removed );
+		TEST( removed > 0 );  // Resolver pruned version history in the background
+		if( more )
+			Void _ = wait( delay( 0, TaskLowPriority ) );
+		else
+			Void _ = wait( delay( SERVER_KNOBS->RESOLVER_PRUNE_INTERVAL, TaskLowPriority ) );
+	}
+}
+
 ACTOR Future<Void> resolverCore(
 	ResolverInterface resolver,
 	InitializeResolverRequest initReq)
@@ -267,6 +306,8 @@ ACTOR Future<Void> resolverCore(
 	state ActorCollection actors(false);
 	state Future<Void> doPollMetrics = self->resolverCount > 1 ? Void() : Future<Void>(Never());
 	actors.add( waitFailureServer(resolver.waitFailure.getFuture()) );
+	if( SERVER_KNOBS->RESOLVER_PRUNE_NODES_PER_STEP > 0 )
+		actors.add( pruneVersionHistory(self) );
 
 	TraceEvent("ResolverInit", resolver.id()).detail("RecoveryCount", initReq.recoveryCount);
 	loop choose {
@@ -285,6 +326,10 @@ ACTOR Future<Void> resolverCore(
 		when ( Void _ = wait( actors.getResult() ) ) {}
 		when (Void _ = wait(doPollMetrics) ) {
 			self->iopsSample.poll();
+			TraceEvent("ResolverConflictCost", self->dbgid).suppressFor(5.0)
+				.detail("ConflictTimePerSecond", self->smoothConflictTime.smoothRate())
+				.detail("RangesPerSecond", self->smoothConflictRanges.smoothRate())
+				.detail("Estimate", self->iopsSample.getEstimate(allKeys));
 			doPollMetrics = delay(SERVER_KNOBS->SAMPLE_POLL_TIME);
 		}
 	}
@@ -54,6 +54,67 @@ struct ServerDBInfo {
 	void serialize( Ar& ar ) {
 		ar & id & clusterInterface & client & master & resolvers & dbName & recoveryCount & masterLifetime & logSystemConfig & priorCommittedLogServers & recoveryState;
 	}
+
+	// The members other than id, in the order serialize() has them, so that an update need only carry those that changed
+	enum { FIELD_COUNT = 10 };
+	template <class Ar>
+	void serializeField( Ar& ar, int field ) {
+		switch( field ) {
+			case 0: ar & clusterInterface; break;
+			case 1: ar & client; break;
+			case 2: ar & master; break;
+			case 3: ar & resolvers; break;
+			case 4: ar & dbName; break;
+			case 5: ar & recoveryCount; break;
+			case 6: ar & masterLifetime; break;
+			case 7: ar & logSystemConfig; break;
+			case 8: ar & priorCommittedLogServers; break;
+			case 9: ar & recoveryState; break;
+			default: ASSERT( false );
+		}
+	}
+
+	// Each member of FIELD_COUNT serialized by itself
+	std::vector<Standalone<StringRef>> encodeFields() const {
+		std::vector<Standalone<StringRef>> fields;
+		for(int f = 0; f < FIELD_COUNT; f++) {
+			BinaryWriter wr( IncludeVersion() );
+			const_cast<ServerDBInfo*>(this)->serializeField( wr, f );
+			fields.push_back( wr.toStringRef() );
+		}
+		return fields;
+	}
+};
+
+// A ServerDBInfo, or the members of one that differ from those of an earlier one the worker has (see
+// GetServerDBInfoRequest).  During a recovery most changes are to a few small members, e.g. recoveryState, so updates
+// are then much smaller than the whole ServerDBInfo with its LogSystemConfig and ClientDBInfo.
+struct ServerDBInfoUpdate {
+	UID baseID;	// The id of the ServerDBInfo whose other members the update keeps, or UID() if it has all of them
+	UID id;
+	std::vector<std::pair<int, Standalone<StringRef>>> fields;	// Changed members, by ServerDBInfo::serializeField() index
+
+	ServerDBInfoUpdate() {}
+
+	// Applies the update to info, whose id has to be baseID unless the update has all members
+	void apply( ServerDBInfo& info ) const {
+		ASSERT( !baseID.isValid() || info.id == baseID );
+		if( !baseID.isValid() ) {
+			LocalityData locality = info.myLocality;
+			info = ServerDBInfo();
+			info.myLocality = locality;
+		}
+		for(auto& f : fields) {
+			BinaryReader rd( f.second, IncludeVersion() );
+			info.serializeField( rd, f.first );
+		}
+		info.id = id;
+	}
+
+	template <class Ar>
+	void serialize( Ar& ar ) {
+		ar & baseID & id & fields;
+	}
 };
 
 #endif
@@ -0,0 +1,105 @@
+/*
+ * ShardTagIndex.h
+ *
+ * This source file is part of the FoundationDB open source project
+ *
+ * Copyright 2013-2018 Apple Inc. and the FoundationDB project authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FDBSERVER_SHARDTAGINDEX_H
+#define FDBSERVER_SHARDTAGINDEX_H
+#pragma once
+
+#include "fdbclient/KeyRangeMap.h"
+#include "fdbclient/StorageServerInterface.h"
+#include "Knobs.h"
+
+// A read-optimized snapshot of the proxy's keyInfo map. Shard begin keys are kept in one sorted array and the tags of
+// every shard in one flat array, so finding the tags for a key is a binary search over contiguous memory rather than a
+// walk down the map's tree.
+//
+// The snapshot belongs to one generation of keyInfo. While keyInfo is newer, callers keep using the map, and the
+// snapshot is rebuilt only after the lookups it missed add up to about the size of the last snapshot. A stream of
+// metadata mutations therefore costs at most one lookup's worth of rebuild work per lookup.
+struct ShardTagIndex {
+	ShardTagIndex() : generation(0), valid(false), missedLookups(0) {}
+
+	// Returns true if the snapshot matches keyInfo at keyInfoGeneration, rebuilding it first if that has become worthwhile
+	bool update( KeyRangeMap<ServerCacheInfo>& keyInfo, uint64_t keyInfoGeneration ) {
+		if( valid && generation == keyInfoGeneration )
+			return true;
+		if( ++missedLookups < std::max<int64_t>( begins.size(), SERVER_KNOBS->SHARD_TAG_INDEX_MIN_REBUILD_LOOKUPS ) )
+			return false;
+		rebuild( keyInfo, keyInfoGeneration );
+		return true;
+	}
+
+	void rebuild( KeyRangeMap<ServerCacheInfo>& keyInfo, uint64_t keyInfoGeneration ) {
+		arena = Arena();
+		begins.clear();
+		tagOffsets.clear();
+		tags.clear();
+
+		for( auto r : keyInfo.ranges() ) {
+			auto& rangeTags = r.value().tags;
+			if( !rangeTags.size() ) {
+				for( auto info : r.value().src_info ) {
+					rangeTags.push_back( info->tag );
+				}
+				for( auto info : r.value().dest_info ) {
+					rangeTags.push_back( info->tag );
+				}
+				uniquify( rangeTags );
+			}
+			begins.push_back( KeyRef( arena, r.begin() ) );
+			tagOffsets.push_back( tags.size() );
+			tags.insert( tags.end(), rangeTags.begin(), rangeTags.end() );
+		}
+		tagOffsets.push_back( tags.size() );
+
+		generation = keyInfoGeneration;
+		valid = true;
+		missedLookups = 0;
+	}
+
+	void appendTags( KeyRef key, std::vector<Tag>& out ) const {
+		int shard = std::upper_bound( begins.begin(), begins.end(), key ) - begins.begin() - 1;
+		out.insert( out.end(), tags.begin() + tagOffsets[shard], tags.begin() + tagOffsets[shard+1] );
+	}
+
+	void appendTags( KeyRangeRef range, std::vector<Tag>& out ) const {
+		int first = std::upper_bound( begins.begin(), begins.end(), range.begin ) - begins.begin() - 1;
+		int last = std::lower_bound( begins.begin(), begins.end(), range.end ) - begins.begin() - 1;
+		int begin = out.size();
+		out.insert( out.end(), tags.begin() + tagOffsets[first], tags.begin() + tagOffsets[std::max(first, last)+1] );
+		if( last > first ) {
+			std::sort( out.begin() + begin, out.end() );
+			out.resize( std::unique( out.begin() + begin, out.end() ) - out.begin() );
+		}
+	}
+
+	int shardCount() const { return begins.size(); }
+
+private:
+	Arena arena;
+	std::vector<KeyRef> begins;
+	std::vector<int> tagOffsets;  // The tags of shard i are tags[tagOffsets[i]] up to tags[tagOffsets[i+1]]
+	std::vector<Tag> tags;
+	uint64_t generation;
+	bool valid;
+	int64_t missedLookups;
+};
+
+#endif
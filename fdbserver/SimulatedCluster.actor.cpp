@@ -701,6 +701,7 @@ void SimulationConfig::generateNormalConfig(int minimumReplication) {
 	datacenters = generateFearless ? 4 : g_random->randomInt( 1, 4 );
 	if (g_random->random01() < 0.25) db.desiredTLogCount = g_random->randomInt(1,7);
 	if (g_random->random01() < 0.25) db.masterProxyCount = g_random->randomInt(1,7);
+	if (g_random->random01() < 0.25) db.grvProxyCount = g_random->randomInt(1,4);
 	if (g_random->random01() < 0.25) db.resolverCount = g_random->randomInt(1,7);
 	if (g_random->random01() < 0.5) {
 		set_config("ssd");
@@ -25,11 +25,7 @@
 #include <numeric>
 #include <string>
 
-/*
-#ifdef __GNUG__
-#include <smmintrin.h>
-#endif
-*/
+#include <emmintrin.h>
 
 #include "flow/Platform.h"
 #include "fdbrpc/fdbrpc.h"
@@ -39,8 +35,6 @@
 #include "fdbclient/SystemData.h"
 #include "Knobs.h"
 
-#define PARALLEL_THREAD_COUNT 0	// FIXME: When >1, program execution (e.g. random numbers) is/was nondeterministic.  Why?
-
 using std::min;
 using std::max;
 using std::make_pair;
@@ -278,6 +272,63 @@ void sortPoints(vector<KeyInfo>& points){
 	//cout << endl << "Radix sort done" << endl;
 }
 
+static force_inline int countTrailingZeros( uint32_t x ) {
+#ifdef _WIN32
+	unsigned long index;
+	_BitScanForward(&index, x);
+	return index;
+#else
+	return __builtin_ctz(x);
+#endif
+}
+
+// The first 8 bytes of a key, zero padded and in big endian order, so that unequal prefixes order
+// the same way as the keys they came from
+static force_inline uint64_t keyPrefix( const uint8_t* key, int length ) {
+	uint64_t p = 0;
+	memcpy( &p, key, min(length, 8) );
+	return bigEndian64(p);
+}
+
+// Byte at a time comparison, kept as the reference for skipListCompareTest()
+static force_inline bool lessScalar( const uint8_t* a, int aLen, const uint8_t* b, int bLen ) {
+	int len = min(aLen, bLen);
+	for(int i=0; i<len; i++)
+		if (a[i] < b[i])
+			return true;
+		else if (a[i] > b[i])
+			return false;
+	return aLen < bLen;
+}
+
+// Compares 16 bytes at a time with SSE2, then 8 bytes at a time, then the remaining bytes one by one.
+//   Never reads past the end of either key.
+static force_inline bool lessVectorized( const uint8_t* a, int aLen, const uint8_t* b, int bLen ) {
+	int len = min(aLen, bLen);
+	int i = 0;
+	for(; i+16 <= len; i+=16) {
+		__m128i x = _mm_loadu_si128( (const __m128i*)(a+i) );
+		__m128i y = _mm_loadu_si128( (const __m128i*)(b+i) );
+		uint32_t differ = _mm_movemask_epi8( _mm_cmpeq_epi8(x, y) ) ^ 0xffff;
+		if (differ) {
+			int j = i + countTrailingZeros(differ);
+			return a[j] < b[j];
+		}
+	}
+	if (i+8 <= len) {
+		uint64_t x, y;
+		memcpy( &x, a+i, 8 );
+		memcpy( &y, b+i, 8 );
+		if (x != y)
+			return bigEndian64(x) < bigEndian64(y);
+		i += 8;
+	}
+	for(; i<len; i++)
+		if (a[i] != b[i])
+			return a[i] < b[i];
+	return aLen < bLen;
+}
+
 class SkipList : NonCopyable
 {
 private:
@@ -301,6 +352,7 @@ private:
 
 	/*
 	struct Node {
+		uint64_t storedPrefix;
 		int nPointers, valueLength;
 		Node *pointers[nPointers];
 		Version maxVersions[nPointers];
@@ -312,6 +364,7 @@ private:
 		int level() { return nPointers-1; }
 		uint8_t* value() { return end() + nPointers*(sizeof(Node*)+sizeof(Version)); }
 		int length() { return valueLength; }
+		uint64_t prefix() { return storedPrefix; }
 		Node* getNext(int i) { return *((Node**)end() + i); }
 		void setNext(int i, Node* n) { 
 			*((Node**)end() + i) = n; 
@@ -344,6 +397,7 @@ private:
 
 			n->valueLength = value.size();
 			memcpy(n->value(), value.begin(), value.size());
+			n->storedPrefix = keyPrefix(value.begin(), value.size());
 			return n;
 		}
 
@@ -372,22 +426,21 @@ private:
 	private:
 		int getNodeSize() { return sizeof(Node) + valueLength + nPointers*(sizeof(Node*)+sizeof(Version)); }
 		uint8_t* end() { return (uint8_t*)(this+1); }
+		uint64_t storedPrefix;		// keyPrefix(value()), kept inline so that most comparisons don't touch value()
 		int nPointers,
 			valueLength;
 	};
 
 	static force_inline bool less( const uint8_t* a, int aLen, const uint8_t* b, int bLen ) {
-		int len = min(aLen, bLen);
-		for(int i=0; i<len; i++)
-			if (a[i] < b[i])
-				return true;
-			else if (a[i] > b[i])
-				return false;
+		return lessVectorized( a, aLen, b, bLen );
+	}
 
-		/*int c = memcmp(a,b,min(aLen,bLen));
-		if (c<0) return true;
-		if (c>0) return false;*/
-		return aLen < bLen;
+	// Equivalent to less( n->value(), n->length(), value.begin(), value.size() ) where valuePrefix == keyPrefix( value )
+	static force_inline bool less( Node* n, const StringRef& value, uint64_t valuePrefix ) {
+		uint64_t p = n->prefix();
+		if (p != valuePrefix)
+			return p < valuePrefix;
+		return less( n->value(), n->length(), value.begin(), value.size() );
 	}
 
 	Node *header;
@@ -406,17 +459,23 @@ public:
 		Node* x;
 		Node *alreadyChecked;
 		StringRef value;
+		uint64_t valuePrefix;
 
-		Finger() : level(MaxLevels), x(NULL), alreadyChecked(NULL) {}
+		Finger() : level(MaxLevels), x(NULL), alreadyChecked(NULL), valuePrefix(0) {}
 
 		Finger( Node* header, const StringRef& ptr ) :
 			value(ptr), level(MaxLevels),
-			alreadyChecked(NULL), x(header)
+			alreadyChecked(NULL), x(header), valuePrefix(keyPrefix(ptr.begin(), ptr.size()))
 		{
 		}
 
-		void init(const StringRef& value, Node *header){
+		void setValue(const StringRef& value) {
 			this->value = value;
+			valuePrefix = keyPrefix(value.begin(), value.size());
+		}
+
+		void init(const StringRef& value, Node *header){
+			setValue(value);
 			x = header;
 			alreadyChecked = NULL;
 			level = MaxLevels;
@@ -439,7 +498,7 @@ public:
 		force_inline bool advance() {
 			Node* next = x->getNext(level-1);
 			
-			if (next == alreadyChecked || !less(next->value(), next->length(), value.begin(), value.size())) {
+			if (next == alreadyChecked || !less(next, value, valuePrefix)) {
 				alreadyChecked = next;
 				level--;
 				finger[level] = x;
@@ -591,10 +650,11 @@ public:
 		// vtune: 11 parts
 		results[0].init( values[0], header );
 		const StringRef& endValue = values[count-1];
+		uint64_t endPrefix = keyPrefix(endValue.begin(), endValue.size());
 		while ( results[0].level > 1 ) {
 			results[0].nextLevel();
 			Node* ac = results[0].alreadyChecked;
-			if (ac && less(ac->value(), ac->length(), endValue.begin(), endValue.size()))
+			if (ac && less(ac, endValue, endPrefix))
 				break;
 		}
 
@@ -609,7 +669,7 @@ public:
 			results[i].level = startLevel;
 			results[i].x = x;
 			results[i].alreadyChecked = NULL;
-			results[i].value = values[i];
+			results[i].setValue( values[i] );
 			for(int j=startLevel; j<MaxLevels; j++)
 				results[i].finger[j] = results[0].finger[j];
 		}
@@ -880,30 +940,44 @@ PAction action( F && f ) {
 	return new FAction( std::move(f) );
 };
 
+// Runs actions handed to it through *nextAction until it is given a null action.  Worker threads
+// have their own skfastrand() seed, so skip list node levels chosen on them differ from a single
+// threaded run, but conflict results do not.
 void workerThread( PAction* nextAction, Event* nextActionReady, int index, Event* whenFinished ) {
-	ASSERT(false);
-	/*
-	inThread<Void>( [nextAction,nextActionReady,index,whenFinished]()->Void {
-		g_seed = index*123; fastrand();
-		setAffinity( index );
-		while (true) {
-			try {
-				nextActionReady->block();   // auto-reset
-				Action* action = *nextAction;
-				*nextAction = 0;
-				if (!action) break;
-
-				(*action)();
-			} catch (Error& e) {
-				fprintf(stderr, "Error in worker thread: %s\n", e.what());
-			} catch (...) {
-				fprintf(stderr, "Error in worker thread: %s\n", unknown_error().what());
+	struct WorkerArgs {
+		PAction* nextAction;
+		Event* nextActionReady;
+		int index;
+		Event* whenFinished;
+
+		THREAD_FUNC run( void* arg ) {
+			WorkerArgs* self = (WorkerArgs*)arg;
+			g_seed = self->index*123; skfastrand();
+			while (true) {
+				try {
+					self->nextActionReady->block();   // auto-reset
+					Action* action = *self->nextAction;
+					*self->nextAction = 0;
+					if (!action) break;
+
+					(*action)();
+				} catch (Error& e) {
+					fprintf(stderr, "Error in worker thread: %s\n", e.what());
+				} catch (...) {
+					fprintf(stderr, "Error in worker thread: %s\n", unknown_error().what());
+				}
 			}
+			self->whenFinished->set();
+			delete self;
+			THREAD_RETURN;
 		}
-		//cout << "Worker thread finished" << endl;
-		whenFinished->set();
-		return Void();
-	});*/
+	};
+	WorkerArgs* args = new WorkerArgs;
+	args->nextAction = nextAction;
+	args->nextActionReady = nextActionReady;
+	args->index = index;
+	args->whenFinished = whenFinished;
+	startThread( &WorkerArgs::run, args );
 }
 
 StringRef setK( Arena& arena, int i ) {
@@ -924,16 +998,19 @@ StringRef setK( Arena& arena, int i ) {
 #include "ConflictSet.h"
 
 struct ConflictSet {
-	ConflictSet() : oldestVersion(0) {
-		static_assert(PARALLEL_THREAD_COUNT == 0, "workerThread() not implemented");
-		static_assert(PARALLEL_THREAD_COUNT == 0 || FASTALLOC_THREAD_SAFE, "Thread safe fast allocator required for multithreaded conflict set");
-		for (int i = 0; i < PARALLEL_THREAD_COUNT; i++) {
+	// With threadCount > 1, read conflict checks are spread over threadCount worker threads and the
+	// version history is partitioned by key range for the duration of each write merge, so that
+	// each worker inserts into its own SkipList.  The calling thread blocks until the workers finish.
+	explicit ConflictSet( int threadCount ) : oldestVersion(0), removedThisPass(0) {
+		static_assert(FASTALLOC_THREAD_SAFE, "Thread safe fast allocator required for multithreaded conflict set");
+		if (threadCount < 2) threadCount = 0;
+		for (int i = 0; i < threadCount; i++) {
 			worker_nextAction.push_back( NULL );
 			worker_ready.push_back( new Event );
 			worker_finished.push_back( new Event );
 		}
 		for(int t=0; t<worker_nextAction.size(); t++)
-			workerThread( &worker_nextAction[t], worker_ready[t], (t)*2, worker_finished[t] );
+			workerThread( &worker_nextAction[t], worker_ready[t], t, worker_finished[t] );
 	}
 	~ConflictSet() {
 		for(int i=0; i<worker_nextAction.size(); i++) {
@@ -943,17 +1020,24 @@ struct ConflictSet {
 		// Wait for workers to terminate; otherwise can get crashes at shutdown time
 		for(int i=0; i<worker_finished.size(); i++)
 			worker_finished[i]->block();
+		for(int i=0; i<worker_nextAction.size(); i++) {
+			delete worker_ready[i];
+			delete worker_finished[i];
+		}
 	}
 
+	int threadCount() const { return worker_nextAction.size(); }
+
 	SkipList versionHistory;
-	Key removalKey;
+	Key removalKey;  // Where the last removal of versions before oldestVersion stopped
 	Version oldestVersion;
+	int64_t removedThisPass;  // Nodes removed since removalKey last wrapped around to the beginning
 	vector<PAction> worker_nextAction;
 	vector<Event*> worker_ready;
 	vector<Event*> worker_finished;
 };
 
-ConflictSet* newConflictSet() { return new ConflictSet; }
+ConflictSet* newConflictSet( int threadCount ) { return new ConflictSet( threadCount ); }
 void clearConflictSet( ConflictSet* cs, Version v ) {
 	SkipList(v).swap( cs->versionHistory );
 }
@@ -961,6 +1045,22 @@ void destroyConflictSet(ConflictSet* cs) {
 	delete cs;
 }
 
+// Visits at most nodeCount nodes of the version history from removalKey, removing those entirely before oldestVersion.
+// Sets *removed to the number removed, and returns false once a whole pass over the history has removed nothing.
+bool pruneConflictSet( ConflictSet* cs, int nodeCount, int* removed ) {
+	SkipList::Finger finger;
+	int temp;
+	cs->versionHistory.find( &cs->removalKey, &finger, &temp, 1 );
+	*removed = cs->versionHistory.removeBefore( cs->oldestVersion, finger, nodeCount );
+	cs->removalKey = finger.getValue();
+	cs->removedThisPass += *removed;
+	if( cs->removalKey.size() )
+		return true;
+	bool more = cs->removedThisPass > 0;
+	cs->removedThisPass = 0;
+	return more;
+}
+
 ConflictBatch::ConflictBatch( ConflictSet* cs )
 	: cs(cs), transactionCount(0)
 {
@@ -1198,11 +1298,8 @@ void ConflictBatch::detectConflicts(Version now, Version newOldestVersion, vecto
 	t = timer();
 	if (newOldestVersion > cs->oldestVersion) {
 		cs->oldestVersion = newOldestVersion;
-		SkipList::Finger finger; 
-		int temp;
-		cs->versionHistory.find( &cs->removalKey, &finger, &temp, 1 );
-		cs->versionHistory.removeBefore( cs->oldestVersion, finger, combinedWriteConflictRanges.size()*3 + 10 );
-		cs->removalKey = finger.getValue();
+		int removed;
+		pruneConflictSet( cs, combinedWriteConflictRanges.size()*3 + 10, &removed );
 	}
 	g_removeBefore += timer()-t;
 }
@@ -1211,21 +1308,21 @@ void ConflictBatch::checkReadConflictRanges() {
 	if (!combinedReadConflictRanges.size()) 
 		return;
 
-	if (PARALLEL_THREAD_COUNT) {
-		Event done[PARALLEL_THREAD_COUNT?PARALLEL_THREAD_COUNT:1];
-		for(int t=0; t<PARALLEL_THREAD_COUNT; t++) {
+	// Reads only look at the version history, so the workers can share it without partitioning.  The only
+	//   shared write is setting transactionConflictStatus[t] to true, which any thread may do.
+	int threads = std::min<int>( cs->threadCount(), combinedReadConflictRanges.size() );
+	if (threads > 1) {
+		vector<Event> done( threads );
+		for(int t=0; t<threads; t++) {
 			cs->worker_nextAction[t] = action( [&,t] {
-#pragma GCC diagnostic push
-DISABLE_ZERO_DIVISION_FLAG
-				auto begin = &combinedReadConflictRanges[0] + t*combinedReadConflictRanges.size()/PARALLEL_THREAD_COUNT;
-				auto end = &combinedReadConflictRanges[0] + (t+1)*combinedReadConflictRanges.size()/PARALLEL_THREAD_COUNT;
-#pragma GCC diagnostic pop
+				auto begin = &combinedReadConflictRanges[0] + t*combinedReadConflictRanges.size()/threads;
+				auto end = &combinedReadConflictRanges[0] + (t+1)*combinedReadConflictRanges.size()/threads;
 				cs->versionHistory.detectConflicts( begin, end-begin, transactionConflictStatus );
 				done[t].set();
 			});
 			cs->worker_ready[t]->set();
 		}
-		for(int i=0; i<PARALLEL_THREAD_COUNT; i++)
+		for(int i=0; i<threads; i++)
 			done[i].block();
 	} else {
 		cs->versionHistory.detectConflicts( &combinedReadConflictRanges[0], combinedReadConflictRanges.size(), transactionConflictStatus );
@@ -1257,28 +1354,51 @@ void ConflictBatch::addConflictRanges(Version now, vector< pair<StringRef,String
 #endif
 }
 
+// Chooses indices into combinedWriteConflictRanges at which to split the version history, at most one per worker thread.
+//   A range may not start a partition if the previous range ends at its begin key, since the partition to the
+//   left would then insert an entry at the split key (see SkipList::partition).
+static vector<int> writePartitionBoundaries( const vector< pair<StringRef,StringRef> >& ranges, int threads ) {
+	vector<int> boundaries;
+	boundaries.push_back(0);
+	for(int s=1; s<threads; s++) {
+		int i = std::max<int>( s*ranges.size()/threads, boundaries.back()+1 );
+		while (i < ranges.size() && ranges[i-1].second == ranges[i].first)
+			i++;
+		if (i >= ranges.size())
+			break;
+		boundaries.push_back(i);
+	}
+	boundaries.push_back(ranges.size());
+	return boundaries;
+}
+
 void ConflictBatch::mergeWriteConflictRanges(Version now) {
 	if (!combinedWriteConflictRanges.size()) 
 		return;
 
-	if (PARALLEL_THREAD_COUNT) {
+	vector<int> boundaries;
+	if (cs->threadCount() > 1)
+		boundaries = writePartitionBoundaries( combinedWriteConflictRanges, cs->threadCount() );
+
+	if (boundaries.size() > 2) {
+		int partCount = boundaries.size()-1;
 		vector<SkipList> parts;
-		for (int i = 0; i < PARALLEL_THREAD_COUNT; i++)
+		for (int i = 0; i < partCount; i++)
 			parts.push_back(SkipList());
 
 		vector<StringRef> splits( parts.size()-1 );
 		for(int s=0; s<splits.size(); s++)
-			splits[s] = combinedWriteConflictRanges[ (s+1)*combinedWriteConflictRanges.size()/parts.size() ].first;
+			splits[s] = combinedWriteConflictRanges[ boundaries[s+1] ].first;
 
 		cs->versionHistory.partition( splits.size() ? &splits[0] : NULL, splits.size(), &parts[0] );
-		vector<double> tstart(PARALLEL_THREAD_COUNT), tend(PARALLEL_THREAD_COUNT);
-		Event done[PARALLEL_THREAD_COUNT ? PARALLEL_THREAD_COUNT : 1];
+		vector<double> tstart(partCount), tend(partCount);
+		vector<Event> done( partCount );
 		double before = timer();
 		for(int t=0; t<parts.size(); t++) {
 			cs->worker_nextAction[t] = action( [&,t] {
 				tstart[t] = timer();
-				auto begin = combinedWriteConflictRanges.begin() + (t*combinedWriteConflictRanges.size()/parts.size());
-				auto end = combinedWriteConflictRanges.begin() + ((t+1)*combinedWriteConflictRanges.size()/parts.size());
+				auto begin = combinedWriteConflictRanges.begin() + boundaries[t];
+				auto end = combinedWriteConflictRanges.begin() + boundaries[t+1];
 
 				addConflictRanges(now, begin, end, &parts[t]);
 
@@ -1288,7 +1408,7 @@ void ConflictBatch::mergeWriteConflictRanges(Version now) {
 			cs->worker_ready[t]->set();
 		}
 		double launch = timer();
-		for(int i=0; i<PARALLEL_THREAD_COUNT; i++)
+		for(int i=0; i<partCount; i++)
 			done[i].block();
 		double after = timer();
 
@@ -1409,9 +1529,55 @@ void miniConflictSetTest() {
 	printf("miniConflictSetTest complete\n");
 }
 
+// Checks lessVectorized() against lessScalar() and compares their speed on keys sharing prefixes of various lengths
+void skipListCompareTest() {
+	const int keyCount = 1<<12, compareCount = 20000000;
+	int sharedPrefixes[] = { 0, 4, 12, 40 };
+	for(int sharedPrefix : sharedPrefixes) {
+		Arena arena;
+		vector<StringRef> keys;
+		for(int i=0; i<keyCount; i++) {
+			int length = sharedPrefix + g_random->randomInt(0, 24);
+			uint8_t* k = new (arena) uint8_t[ length ];
+			memset( k, '.', sharedPrefix );
+			for(int c=sharedPrefix; c<length; c++)
+				k[c] = g_random->randomInt(0, 4);	// a small alphabet makes long common prefixes likely
+			keys.push_back( StringRef(k, length) );
+		}
+
+		int scalarTrue = 0, vectorTrue = 0;
+		double t = timer();
+		for(int i=0; i<compareCount; i++) {
+			const StringRef& a = keys[i & (keyCount-1)], &b = keys[(i*7+1) & (keyCount-1)];
+			scalarTrue += lessScalar( a.begin(), a.size(), b.begin(), b.size() );
+		}
+		double scalarTime = timer()-t;
+
+		t = timer();
+		for(int i=0; i<compareCount; i++) {
+			const StringRef& a = keys[i & (keyCount-1)], &b = keys[(i*7+1) & (keyCount-1)];
+			vectorTrue += lessVectorized( a.begin(), a.size(), b.begin(), b.size() );
+		}
+		double vectorTime = timer()-t;
+
+		for(int i=0; i<keyCount; i++)
+			for(int j=0; j<16; j++) {
+				const StringRef& a = keys[i], &b = keys[g_random->randomInt(0, keyCount)];
+				ASSERT( lessScalar( a.begin(), a.size(), b.begin(), b.size() ) == lessVectorized( a.begin(), a.size(), b.begin(), b.size() ) );
+				ASSERT( (keyPrefix( a.begin(), a.size() ) < keyPrefix( b.begin(), b.size() )) <= lessScalar( a.begin(), a.size(), b.begin(), b.size() ) );
+			}
+		ASSERT( scalarTrue == vectorTrue );
+
+		printf("Key compare, %2d byte shared prefix: scalar %0.1f Mcompares/sec, vectorized %0.1f Mcompares/sec\n",
+			sharedPrefix, compareCount/scalarTime/1e6, compareCount/vectorTime/1e6);
+	}
+}
+
 void skipListTest() {
 	printf("Skip list test\n");
 
+	skipListCompareTest();
+
 	//sse4Test();
 
 	//A test case that breaks the old operator<
@@ -1426,7 +1592,7 @@ void skipListTest() {
 
 	double start;
 
-	ConflictSet* cs = newConflictSet();
+	ConflictSet* cs = newConflictSet( SERVER_KNOBS->RESOLVER_CONFLICT_SET_THREADS );
 
 	Arena testDataArena;
 	VectorRef< VectorRef<KeyRangeRef> > testData;
@@ -1446,7 +1612,7 @@ void skipListTest() {
 		}
 	}
 	printf("Test data generated (%d)\n", g_random->randomInt(0,100000));
-	printf("  %d threads, %d batches, %d/batch\n", PARALLEL_THREAD_COUNT, testData.size(), testData[0].size());
+	printf("  %d threads, %d batches, %d/batch\n", cs->threadCount(), testData.size(), testData[0].size());
 
 	printf("Running\n");
 
@@ -1501,6 +1667,10 @@ void skipListTest() {
 	printf("                  %0.3f Mtransactions/sec\n", tcount/elapsed/1e6);
 	printf("                  %0.3f Mkeys/sec\n", cranges*2/elapsed/1e6);
 
+	elapsed = g_checkRead.getValue();
+	printf("Read checks only: %0.3f sec\n", elapsed);
+	printf("                  %0.3f Mconflict checks/sec\n", tcount*readCount/elapsed/1e6);
+
 	printf("Performance counters:\n");
 	for(int c=0; c<skc.size(); c++) {
 		printf("%20s: %s\n", skc[c]->getMetric().name().c_str(), skc[c]->getMetric().formatted().c_str());
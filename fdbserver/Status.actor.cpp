@@ -238,6 +238,45 @@ ACTOR static Future< Optional< std::pair<WorkerEvents, std::set<std::string>> >
 		throw;
 	}
 }
+// Like latestEventOnWorkers(workers, "ProgramStart"), but only asks the workers that are not in the cache
+ACTOR static Future< Optional< std::pair<WorkerEvents, std::set<std::string>> > > programStartOnWorkers(std::vector<std::pair<WorkerInterface, ProcessClass>> workers, ProgramStartCache* cache) {
+	state std::vector<std::pair<WorkerInterface, ProcessClass>> uncached;
+	state std::map<NetworkAddress, UID> workerIds;
+	for(auto& w : workers) {
+		workerIds[w.first.address()] = w.first.id();
+		auto it = cache->find(w.first.address());
+		if(it == cache->end() || it->second.first != w.first.id())
+			uncached.push_back(w);
+	}
+	TEST(uncached.size() < workers.size()); // Status used cached ProgramStart events
+
+	// Forget the workers that are gone or have been replaced
+	for(auto it = cache->begin(); it != cache->end(); ) {
+		auto w = workerIds.find(it->first);
+		if(w == workerIds.end() || w->second != it->second.first)
+			cache->erase(it++);
+		else
+			++it;
+	}
+
+	state std::pair<WorkerEvents, std::set<std::string>> val;
+	if(uncached.size()) {
+		Optional< std::pair<WorkerEvents, std::set<std::string>> > fetched = wait(latestEventOnWorkers(uncached, "ProgramStart"));
+		if(fetched.present()) {
+			val = fetched.get();
+			for(auto& e : val.first) {
+				if(e.second.size())
+					(*cache)[e.first] = std::make_pair(workerIds[e.first], e.second);
+			}
+		}
+	}
+
+	for(auto& c : *cache)
+		val.first[c.first] = c.second.second;
+
+	return val;
+}
+
 static Future< Optional< std::pair<WorkerEvents, std::set<std::string>> > > latestErrorOnWorkers(std::vector<std::pair<WorkerInterface, ProcessClass>> workers) {
 	return latestEventOnWorkers( workers, "" );
 }
@@ -279,6 +318,25 @@ static StatusObject parseCounter(std::string const& s) {
 	return makeCounter(hz, roughness, counter);
 }
 
+static StatusObject parseLatencyStatistics(std::string const& s) {
+	// Parse what LatencyHistogram::toString() in flow/Histogram.h formats
+	long long count = 0;
+	double min = 0, max = 0, mean = 0, median = 0, p90 = 0, p99 = 0, p999 = 0;
+	if (sscanf(s.c_str(), "%lld %lf %lf %lf %lf %lf %lf %lf", &count, &min, &max, &mean, &median, &p90, &p99, &p999) != 8)
+		throw attribute_not_found();
+
+	StatusObject out;
+	out["count"] = (int64_t)count;
+	out["min"] = min;
+	out["max"] = max;
+	out["mean"] = mean;
+	out["median"] = median;
+	out["p90"] = p90;
+	out["p99"] = p99;
+	out["p99.9"] = p999;
+	return out;
+}
+
 static StatusObject addCounters(StatusObject c1, StatusObject c2) {
 	// "add" the given counter objects.  Roughness is averaged weighted by rate.
 
@@ -534,6 +592,13 @@ struct RolesInfo {
 				obj["data_version_lag"] = std::max<Version>(0, maxTLogVersion - version);
 			}
 
+			obj["read_latency_statistics"] = parseLatencyStatistics(extractAttribute(metrics, "ReadLatency"));
+
+			StatusObject breakdown;
+			breakdown["queueing"] = parseLatencyStatistics(extractAttribute(metrics, "ReadQueueLatency"));
+			breakdown["version_wait"] = parseLatencyStatistics(extractAttribute(metrics, "ReadVersionWaitLatency"));
+			breakdown["engine_read"] = parseLatencyStatistics(extractAttribute(metrics, "ReadEngineLatency"));
+			obj["read_latency_breakdown"] = breakdown;
 		} catch (Error& e) {
 			if(e.code() != error_code_attribute_not_found)
 				throw e;
@@ -556,6 +621,31 @@ struct RolesInfo {
 			obj["input_bytes"] = parseCounter(extractAttribute(metrics, "bytesInput"));
 			obj["durable_bytes"] = parseCounter(extractAttribute(metrics, "bytesDurable"));
 			obj["data_version"] = parseInt64(extractAttribute(metrics, "version"));
+			obj["commit_latency_statistics"] = parseLatencyStatistics(extractAttribute(metrics, "CommitLatency"));
+		} catch (Error& e) {
+			if(e.code() != error_code_attribute_not_found)
+				throw e;
+		}
+		return roles.insert( make_pair(iface.address(), obj ))->second;
+	}
+	StatusObject& addRole(std::string const& role, MasterProxyInterface const& iface, Optional<std::string> const& metrics) {
+		StatusObject obj;
+		obj["id"] = iface.id().shortString();
+		obj["role"] = role;
+		try {
+			if(metrics.present()) {
+				obj["grv_latency_statistics"] = parseLatencyStatistics(extractAttribute(metrics.get(), "GRVLatency"));
+				obj["commit_latency_statistics"] = parseLatencyStatistics(extractAttribute(metrics.get(), "CommitLatency"));
+
+				StatusObject breakdown;
+				breakdown["queueing"] = parseLatencyStatistics(extractAttribute(metrics.get(), "CommitQueueLatency"));
+				breakdown["commit_version"] = parseLatencyStatistics(extractAttribute(metrics.get(), "CommitVersionLatency"));
+				breakdown["resolution"] = parseLatencyStatistics(extractAttribute(metrics.get(), "CommitResolutionLatency"));
+				breakdown["processing"] = parseLatencyStatistics(extractAttribute(metrics.get(), "CommitProcessingLatency"));
+				breakdown["log_push"] = parseLatencyStatistics(extractAttribute(metrics.get(), "CommitLogPushLatency"));
+				breakdown["reply"] = parseLatencyStatistics(extractAttribute(metrics.get(), "CommitReplyLatency"));
+				obj["commit_latency_breakdown"] = breakdown;
+			}
 		} catch (Error& e) {
 			if(e.code() != error_code_attribute_not_found)
 				throw e;
@@ -649,9 +739,19 @@ ACTOR static Future<StatusObject> processStatusFetcher(
 
 	state Reference<ProxyInfo> proxies = cx->getMasterProxies();
 	if (proxies) {
+		state std::vector<Future<Optional<std::string>>> proxyMetrics;
+		for(int p = 0; p < proxies->size(); p++) {
+			auto worker = getWorker(workers, proxies->getInterface(p).address());
+			if(worker.present())
+				proxyMetrics.push_back(latestEventOnWorker(worker.get().first, "ProxyMetrics"));
+			else
+				proxyMetrics.push_back(Optional<std::string>());
+		}
+		Void _ = wait(waitForAll(proxyMetrics));
+
 		state int proxyIndex;
 		for(proxyIndex = 0; proxyIndex < proxies->size(); proxyIndex++) {
-			roles.addRole( "proxy", proxies->getInterface(proxyIndex) );
+			roles.addRole( "proxy", proxies->getInterface(proxyIndex), proxyMetrics[proxyIndex].get() );
 			Void _ = wait(yield());
 		}
 	}
@@ -737,6 +837,23 @@ ACTOR static Future<StatusObject> processStatusFetcher(
 				if (elapsed > 0){
 					StatusObject cpuObj;
 					cpuObj["usage_cores"] = std::max(0.0, cpu_seconds / elapsed);
+
+					// The CPU of each role of the process's threads, such as the network thread and SQLite's coroutines
+					std::string threadRoles;
+					if (tryExtractAttribute(event, LiteralStringRef("ThreadRoles"), threadRoles) && threadRoles.size()) {
+						StatusObject threadsObj;
+						StringRef roles(threadRoles);
+						while (roles.size()) {
+							std::string role = roles.eat(",").toString();
+							std::string seconds;
+							if (tryExtractAttribute(event, StringRef("CPUSeconds" + role), seconds)) {
+								StatusObject roleObj;
+								roleObj["usage_cores"] = std::max(0.0, parseDouble(seconds) / elapsed);
+								threadsObj[role] = roleObj;
+							}
+						}
+						cpuObj["threads"] = threadsObj;
+					}
 					statusObj["cpu"] = cpuObj;
 
 					diskObj["busy"] = std::max(0.0, std::min((elapsed - diskIdleSeconds) / elapsed, 1.0));
@@ -1226,6 +1343,7 @@ ACTOR static Future<StatusObject> dataStatusFetcher(std::pair<WorkerInterface, P
 				statusObjData["total_kv_size_bytes"] = totalDBBytes;
 				int shards = parseInt(extractAttribute(dataStats, LiteralStringRef("Shards")));
 				statusObjData["partitions_count"] = shards;
+				statusObjData["read_hot_partition_splits"] = parseInt64(extractAttribute(dataStats, LiteralStringRef("ReadHotShardSplits")));
 			}
 
 		}
@@ -1307,8 +1425,15 @@ ACTOR static Future<StatusObject> workloadStatusFetcher(Reference<AsyncVar<struc
 		for (auto w : workers) {
 			workersMap[w.first.address()] = w;
 		}
-		for (auto &p : db->get().client.proxies) {
-			auto worker = getWorker(workersMap, p.address());
+		// GRV proxies report the started transactions, if the cluster has any.  A process reports only its latest
+		// ProxyMetrics, so each is asked once.
+		std::set<NetworkAddress> proxyAddresses;
+		for (auto &p : db->get().client.proxies)
+			proxyAddresses.insert(p.address());
+		for (auto &p : db->get().client.grvProxies)
+			proxyAddresses.insert(p.address());
+		for (auto &address : proxyAddresses) {
+			auto worker = getWorker(workersMap, address);
 			if (worker.present())
 				proxyStatFutures.push_back(timeoutError(worker.get().first.eventLogRequest.getReply(EventLogRequest(LiteralStringRef("ProxyMetrics"))), 1.0));
 			else
@@ -1317,6 +1442,7 @@ ACTOR static Future<StatusObject> workloadStatusFetcher(Reference<AsyncVar<struc
 		vector<Standalone<StringRef>> proxyStats = wait(getAll(proxyStatFutures));
 
 		StatusObject mutations=makeCounter(), mutationBytes=makeCounter(), txnConflicts=makeCounter(), txnStartOut=makeCounter(), txnCommitOutSuccess=makeCounter();
+		int64_t commitBatchIntervalMicros = 0, commitBatchBytes = 0;
 
 		for (auto &ps : proxyStats) {
 			mutations = addCounters( mutations, parseCounter(extractAttribute(ps, LiteralStringRef("mutations"))) );
@@ -1324,8 +1450,13 @@ ACTOR static Future<StatusObject> workloadStatusFetcher(Reference<AsyncVar<struc
 			txnConflicts = addCounters( txnConflicts, parseCounter(extractAttribute(ps, LiteralStringRef("txnConflicts"))) );
 			txnStartOut = addCounters( txnStartOut, parseCounter(extractAttribute(ps, LiteralStringRef("txnStartOut"))) );
 			txnCommitOutSuccess = addCounters( txnCommitOutSuccess, parseCounter(extractAttribute(ps, LiteralStringRef("txnCommitOutSuccess"))) );
+			commitBatchIntervalMicros = std::max( commitBatchIntervalMicros, parseInt64(extractAttribute(ps, LiteralStringRef("commitBatchIntervalMicros"))) );
+			commitBatchBytes = std::max( commitBatchBytes, parseInt64(extractAttribute(ps, LiteralStringRef("commitBatchBytes"))) );
 		}
 
+		(*qos)["max_commit_batch_interval_seconds"] = commitBatchIntervalMicros / 1e6;
+		(*qos)["max_commit_batch_bytes"] = commitBatchBytes;
+
 		operationsObj["writes"] = mutations;
 
 		StatusObject bytesObj;
@@ -1669,7 +1800,8 @@ ACTOR Future<StatusReply> clusterGetStatus(
 		ClientVersionMap clientVersionMap,
 		std::map<NetworkAddress, std::string> traceLogGroupMap,
 		ServerCoordinators coordinators,
-		std::vector<NetworkAddress> incompatibleConnections )
+		std::vector<NetworkAddress> incompatibleConnections,
+		ProgramStartCache* programStartCache )
 {
 	// since we no longer offer multi-database support, all databases must be named DB
 	state std::string dbName = "DB";
@@ -1696,7 +1828,7 @@ ACTOR Future<StatusReply> clusterGetStatus(
 		futures.push_back(latestEventOnWorkers(workers, "ProcessMetrics"));
 		futures.push_back(latestErrorOnWorkers(workers));
 		futures.push_back(latestEventOnWorkers(workers, "TraceFileOpenError"));
-		futures.push_back(latestEventOnWorkers(workers, "ProgramStart"));
+		futures.push_back(programStartOnWorkers(workers, programStartCache));
 
 		// Wait for all response pairs.
 		state std::vector< Optional <std::pair<WorkerEvents, std::set<std::string>>> > workerEventsVec = wait(getAll(futures));
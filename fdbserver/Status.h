@@ -29,9 +29,12 @@
 
 typedef std::map< NetworkAddress, std::pair<std::string,UID> > ProcessIssuesMap;
 typedef std::map< NetworkAddress, Standalone<VectorRef<ClientVersionRef>> > ClientVersionMap;
+// The ProgramStart event of each worker, with the id of the worker that logged it.  It does not change while the worker
+// runs, so the cluster controller keeps it across status requests and only asks workers it has not seen before.
+typedef std::map< NetworkAddress, std::pair<UID,std::string> > ProgramStartCache;
 
 std::string extractAttribute( std::string const& expanded, std::string const& attributeToExtract );
 Future<StatusReply> clusterGetStatus( Reference<AsyncVar<struct ServerDBInfo>> const& db, Database const& cx, vector<std::pair<WorkerInterface, ProcessClass>> const& workers,
-	ProcessIssuesMap const& workerIssues, ProcessIssuesMap const& clientIssues, ClientVersionMap const& clientVersionMap, std::map<NetworkAddress, std::string> const& traceLogGroupMap, ServerCoordinators const& coordinators, std::vector<NetworkAddress> const& incompatibleConnections );
+	ProcessIssuesMap const& workerIssues, ProcessIssuesMap const& clientIssues, ClientVersionMap const& clientVersionMap, std::map<NetworkAddress, std::string> const& traceLogGroupMap, ServerCoordinators const& coordinators, std::vector<NetworkAddress> const& incompatibleConnections, ProgramStartCache* const& programStartCache );
 
 #endif
@@ -180,13 +180,160 @@ private:
 	}
 };
 
+// Estimates the key ranges with the most weight added to them with the space saving algorithm of Metwally et al.,
+// "Efficient Computation of Frequent and Top-k Elements in Data Streams".  At most capacity ranges have counters.  A
+// range without one takes over the counter with the least weight, starting from that weight, which becomes its error.
+// So no estimate is less than the true weight or more than it by its error, and every range with more than
+// total/capacity of the weight has a counter.
+struct HotRangeSketch : NonCopyable {
+	explicit HotRangeSketch( int capacity ) : capacity(std::max(capacity, 1)), total(0) {}
+
+	void add( KeyRangeRef range, double weight ) {
+		total += weight;
+		auto it = counters.find( range );
+		if( it != counters.end() ) {
+			byWeight.erase( std::make_pair( it->second.weight, &it->first ) );
+			it->second.weight += weight;
+			byWeight.insert( std::make_pair( it->second.weight, &it->first ) );
+			return;
+		}
+
+		double error = 0;
+		if( counters.size() >= capacity ) {
+			auto least = byWeight.begin();
+			error = least->first;
+			counters.erase( counters.find( *least->second ) );
+			byWeight.erase( least );
+		}
+		Counter c;
+		KeyRangeRef copy( c.arena, range );
+		c.weight = weight + error;
+		c.error = error;
+		it = counters.insert( std::make_pair( copy, c ) ).first;
+		byWeight.insert( std::make_pair( c.weight, &it->first ) );
+	}
+
+	// Appends at most limit of the ranges with the most weight, heaviest first, with their weights divided by seconds
+	void getTop( Arena& arena, VectorRef<HotRangeRef>& out, int limit, double seconds ) const {
+		for(auto it = byWeight.rbegin(); it != byWeight.rend() && limit > 0; ++it, --limit) {
+			auto const& c = counters.find( *it->second )->second;
+			out.push_back_deep( arena, HotRangeRef( *it->second, c.weight / seconds, c.error / seconds ) );
+		}
+	}
+
+	double getTotal() const { return total; }
+	int size() const { return counters.size(); }
+
+	void clear() {
+		byWeight.clear();
+		counters.clear();
+		total = 0;
+	}
+
+	void swap( HotRangeSketch& other ) {
+		counters.swap( other.counters );
+		byWeight.swap( other.byWeight );
+		std::swap( capacity, other.capacity );
+		std::swap( total, other.total );
+	}
+
+private:
+	struct Counter {
+		Arena arena;  // Holds the range
+		double weight, error;
+	};
+	struct RangeLess {
+		bool operator()( KeyRangeRef const& a, KeyRangeRef const& b ) const { return a.begin < b.begin || (a.begin == b.begin && a.end < b.end); }
+	};
+
+	std::map<KeyRangeRef, Counter, RangeLess> counters;
+	std::set<std::pair<double, KeyRangeRef const*>> byWeight;  // Points to the keys of counters
+	int capacity;
+	double total;
+};
+
+TEST_CASE("fdbserver/HotRangeSketch/simple") {
+	HotRangeSketch s( 3 );
+	s.add( singleKeyRange( LiteralStringRef("a") ), 10 );
+	s.add( KeyRangeRef( LiteralStringRef("b"), LiteralStringRef("c") ), 5 );
+	s.add( singleKeyRange( LiteralStringRef("a") ), 10 );
+	s.add( singleKeyRange( LiteralStringRef("d") ), 1 );
+	// Takes over the counter of d, and so is estimated at 2 with an error of 1
+	s.add( singleKeyRange( LiteralStringRef("e") ), 1 );
+	ASSERT( s.size() == 3 && s.getTotal() == 27 );
+
+	Arena arena;
+	VectorRef<HotRangeRef> top;
+	s.getTop( arena, top, 10, 2.0 );
+	ASSERT( top.size() == 3 );
+	ASSERT( top[0].range == singleKeyRange( LiteralStringRef("a") ) && top[0].bytesPerSecond == 10 && top[0].errorBytesPerSecond == 0 );
+	ASSERT( top[1].range == KeyRangeRef( LiteralStringRef("b"), LiteralStringRef("c") ) && top[1].bytesPerSecond == 2.5 );
+	ASSERT( top[2].range == singleKeyRange( LiteralStringRef("e") ) && top[2].bytesPerSecond == 1 && top[2].errorBytesPerSecond == 0.5 );
+
+	// Every range heavier than total/capacity survives any number of light ranges
+	for(int i = 0; i < 1000; i++)
+		s.add( singleKeyRange( StringRef( format("f%d", i) ) ), 0.01 );
+	top = VectorRef<HotRangeRef>();
+	s.getTop( arena, top, 1, 1.0 );
+	ASSERT( top.size() == 1 && top[0].range == singleKeyRange( LiteralStringRef("a") ) );
+
+	return Void();
+}
+
+// Samples reads or writes into a HotRangeSketch for each window of HOT_RANGE_WINDOW seconds, and reports the ranges of
+// the last complete window, or of the current one if the last was not just before it.  One in
+// 1/HOT_RANGE_SAMPLE_PROBABILITY operations is counted, with its weight scaled up to match.
+struct HotRangeSampler : NonCopyable {
+	HotRangeSampler() : current(SERVER_KNOBS->HOT_RANGE_SKETCH_SIZE), previous(SERVER_KNOBS->HOT_RANGE_SKETCH_SIZE), windowStart(now()), previousSeconds(0) {}
+
+	// Whether to add() the next operation, so that the range need not be built for the ones that are not sampled
+	bool sample() const { return SERVER_KNOBS->HOT_RANGE_SAMPLE_PROBABILITY > 0 && g_random->random01() < SERVER_KNOBS->HOT_RANGE_SAMPLE_PROBABILITY; }
+
+	void add( KeyRangeRef range, double weight ) {
+		roll();
+		current.add( range, weight / SERVER_KNOBS->HOT_RANGE_SAMPLE_PROBABILITY );
+	}
+
+	// Sets seconds to the length of the window the ranges are for
+	void getTop( Arena& arena, VectorRef<HotRangeRef>& out, int limit, double& seconds ) {
+		roll();
+		if( previousSeconds > 0 ) {
+			seconds = previousSeconds;
+			previous.getTop( arena, out, limit, seconds );
+		} else {
+			seconds = std::max( now() - windowStart, 0.001 );
+			current.getTop( arena, out, limit, seconds );
+		}
+	}
+
+private:
+	HotRangeSketch current, previous;
+	double windowStart, previousSeconds;
+
+	void roll() {
+		double t = now();
+		if( t < windowStart + SERVER_KNOBS->HOT_RANGE_WINDOW )
+			return;
+		if( t < windowStart + 2 * SERVER_KNOBS->HOT_RANGE_WINDOW ) {
+			previous.swap( current );
+			previousSeconds = t - windowStart;
+		} else {
+			previousSeconds = 0;
+		}
+		current.clear();
+		windowStart = t;
+	}
+};
+
 struct StorageServerMetrics {
 	KeyRangeMap< vector< PromiseStream< StorageMetrics > > > waitMetricsMap;
 	StorageMetricSample byteSample;
 	TransientStorageMetricSample iopsSample, bandwidthSample;	// FIXME: iops and bandwidth calculations are not effectively tested, since they aren't currently used by data distribution
+	TransientStorageMetricSample bytesReadSample;
 
 	StorageServerMetrics()
-		: byteSample( 0 ), iopsSample( SERVER_KNOBS->IOPS_UNITS_PER_SAMPLE ), bandwidthSample( SERVER_KNOBS->BANDWIDTH_UNITS_PER_SAMPLE )
+		: byteSample( 0 ), iopsSample( SERVER_KNOBS->IOPS_UNITS_PER_SAMPLE ), bandwidthSample( SERVER_KNOBS->BANDWIDTH_UNITS_PER_SAMPLE ),
+		  bytesReadSample( SERVER_KNOBS->BYTES_READ_UNITS_PER_SAMPLE )
 	{
 	}
 
@@ -196,6 +343,7 @@ struct StorageServerMetrics {
 		result.bytes = byteSample.getEstimate( keys );
 		result.bytesPerKSecond = bandwidthSample.getEstimate( keys ) * SERVER_KNOBS->STORAGE_METRICS_AVERAGE_INTERVAL_PER_KSECONDS;
 		result.iosPerKSecond = iopsSample.getEstimate( keys ) * SERVER_KNOBS->STORAGE_METRICS_AVERAGE_INTERVAL_PER_KSECONDS;
+		result.bytesReadPerKSecond = bytesReadSample.getEstimate( keys ) * SERVER_KNOBS->STORAGE_METRICS_AVERAGE_INTERVAL_PER_KSECONDS;
 		return result;
 	}
 
@@ -205,6 +353,7 @@ struct StorageServerMetrics {
 		ASSERT (metrics.bytes == 0); // ShardNotifyMetrics
 		TEST (metrics.bytesPerKSecond != 0); // ShardNotifyMetrics
 		TEST (metrics.iosPerKSecond != 0); // ShardNotifyMetrics
+		TEST (metrics.bytesReadPerKSecond != 0); // ShardNotifyMetrics
 
 		double expire = now() + SERVER_KNOBS->STORAGE_METRICS_AVERAGE_INTERVAL;
 
@@ -214,6 +363,8 @@ struct StorageServerMetrics {
 			notifyMetrics.bytesPerKSecond = bandwidthSample.addAndExpire( key, metrics.bytesPerKSecond, expire ) * SERVER_KNOBS->STORAGE_METRICS_AVERAGE_INTERVAL_PER_KSECONDS;
 		if (metrics.iosPerKSecond)
 			notifyMetrics.iosPerKSecond = iopsSample.addAndExpire( key, metrics.iosPerKSecond, expire ) * SERVER_KNOBS->STORAGE_METRICS_AVERAGE_INTERVAL_PER_KSECONDS;
+		if (metrics.bytesReadPerKSecond)
+			notifyMetrics.bytesReadPerKSecond = bytesReadSample.addAndExpire( key, metrics.bytesReadPerKSecond, expire ) * SERVER_KNOBS->STORAGE_METRICS_AVERAGE_INTERVAL_PER_KSECONDS;
 		if (!notifyMetrics.allZero()) {
 			auto& v = waitMetricsMap[key];
 			for(int i=0; i<v.size(); i++) {
@@ -262,6 +413,7 @@ struct StorageServerMetrics {
 	void poll() {
 		{ StorageMetrics m; m.bytesPerKSecond = SERVER_KNOBS->STORAGE_METRICS_AVERAGE_INTERVAL_PER_KSECONDS; bandwidthSample.poll(waitMetricsMap, m); }
 		{ StorageMetrics m; m.iosPerKSecond = SERVER_KNOBS->STORAGE_METRICS_AVERAGE_INTERVAL_PER_KSECONDS; iopsSample.poll(waitMetricsMap, m); }
+		{ StorageMetrics m; m.bytesReadPerKSecond = SERVER_KNOBS->STORAGE_METRICS_AVERAGE_INTERVAL_PER_KSECONDS; bytesReadSample.poll(waitMetricsMap, m); }
 		// bytesSample doesn't need polling because we never call addExpire() on it
 	}
 
@@ -312,7 +464,7 @@ struct StorageServerMetrics {
 				if( remaining.bytes < 2*SERVER_KNOBS->MIN_SHARD_BYTES )
 					break;
 				KeyRef key = req.keys.end;
-				bool hasUsed = used.bytes != 0 || used.bytesPerKSecond != 0 || used.iosPerKSecond != 0;
+				bool hasUsed = used.bytes != 0 || used.bytesPerKSecond != 0 || used.iosPerKSecond != 0 || used.bytesReadPerKSecond != 0;
 				key = getSplitKey( remaining.bytes, estimated.bytes, req.limits.bytes, used.bytes, 
 					req.limits.infinity, req.isLastShard, byteSample, 1, lastKey, key, hasUsed );
 				if( used.bytes < SERVER_KNOBS->MIN_SHARD_BYTES )
@@ -321,6 +473,9 @@ struct StorageServerMetrics {
 					req.limits.infinity, req.isLastShard, iopsSample, SERVER_KNOBS->STORAGE_METRICS_AVERAGE_INTERVAL_PER_KSECONDS, lastKey, key, hasUsed );
 				key = getSplitKey( remaining.bytesPerKSecond, estimated.bytesPerKSecond, req.limits.bytesPerKSecond, used.bytesPerKSecond, 
 					req.limits.infinity, req.isLastShard, bandwidthSample, SERVER_KNOBS->STORAGE_METRICS_AVERAGE_INTERVAL_PER_KSECONDS, lastKey, key, hasUsed );
+				if( req.limits.bytesReadPerKSecond > 0 )
+					key = getSplitKey( remaining.bytesReadPerKSecond, estimated.bytesReadPerKSecond, req.limits.bytesReadPerKSecond, used.bytesReadPerKSecond,
+						req.limits.infinity, req.isLastShard, bytesReadSample, SERVER_KNOBS->STORAGE_METRICS_AVERAGE_INTERVAL_PER_KSECONDS, lastKey, key, hasUsed );
 				ASSERT( key != lastKey || hasUsed);
 				if( key == req.keys.end )
 					break;
@@ -357,10 +512,12 @@ struct StorageServerMetrics {
 		rep.free.bytes = sb.free;
 		rep.free.iosPerKSecond = 10e6;
 		rep.free.bytesPerKSecond = 100e9;
+		rep.free.bytesReadPerKSecond = 100e9;
 
 		rep.capacity.bytes = sb.total;
 		rep.capacity.iosPerKSecond = 10e6;
 		rep.capacity.bytesPerKSecond = 100e9;
+		rep.capacity.bytesReadPerKSecond = 100e9;
 
 		req.reply.send(rep);
 	}
@@ -140,12 +140,26 @@ struct TLogPeekReply {
 	Version end;
 	Optional<Version> popped;
 	Version maxKnownVersion;
+	int32_t uncompressedSize;  // If nonzero, messages is compressed with zlib and is this long once inflated
+
+	TLogPeekReply() : uncompressedSize(0) {}
+
+	// Compresses messages if that makes it smaller
+	void compress( int level );
+	// Inflates messages if it is compressed
+	void uncompress();
 
 	template <class Ar>
 	void serialize(Ar& ar) {
 		ar & arena & messages & end & popped & maxKnownVersion;
+		if( ar.protocolVersion() >= 0x0FDB00A560060001LL ) {
+			ar & uncompressedSize;
+		} else if( ar.isDeserializing ) {
+			uncompressedSize = 0;
+		}
 	}
 };
+PREALLOCATED_SERIALIZABLE( TLogPeekReply );
 
 struct TLogPeekRequest {
 	Arena arena;
@@ -153,14 +167,20 @@ struct TLogPeekRequest {
 	Tag tag;
 	bool returnIfBlocked;
 	Optional<std::pair<UID, int>> sequence;
+	bool acceptCompressed;  // The reply may be compressed
 	ReplyPromise<TLogPeekReply> reply;
 
-	TLogPeekRequest( Version begin, Tag tag, bool returnIfBlocked, Optional<std::pair<UID, int>> sequence = Optional<std::pair<UID, int>>() ) : begin(begin), tag(tag), returnIfBlocked(returnIfBlocked), sequence(sequence) {}
-	TLogPeekRequest() {}
+	TLogPeekRequest( Version begin, Tag tag, bool returnIfBlocked, Optional<std::pair<UID, int>> sequence = Optional<std::pair<UID, int>>(), bool acceptCompressed = false ) : begin(begin), tag(tag), returnIfBlocked(returnIfBlocked), sequence(sequence), acceptCompressed(acceptCompressed) {}
+	TLogPeekRequest() : acceptCompressed(false) {}
 
 	template <class Ar>
 	void serialize(Ar& ar) {
 		ar & arena & begin & tag & returnIfBlocked & sequence & reply;
+		if( ar.protocolVersion() >= 0x0FDB00A560060001LL ) {
+			ar & acceptCompressed;
+		} else if( ar.isDeserializing ) {
+			acceptCompressed = false;
+		}
 	}
 };
 
@@ -210,7 +230,9 @@ struct TLogCommitRequest {
 		: arena(a), prevVersion(prevVersion), version(version), knownCommittedVersion(knownCommittedVersion), messages(messages), debugID(debugID) {}
 	template <class Ar> 
 	void serialize( Ar& ar ) {
-		ar & prevVersion & version & knownCommittedVersion & messages & reply & arena & debugID;
+		ar & prevVersion & version & knownCommittedVersion;
+		serializeByReference( ar, messages, arena );
+		ar & reply & arena & debugID;
 	}
 };
 
@@ -36,6 +36,7 @@
 #include "fdbrpc/sim_validation.h"
 #include "ServerDBInfo.h"
 #include "LogSystem.h"
+#include "VersionMessageIndex.h"
 #include "WaitFailure.h"
 #include "RecoveryState.h"
 
@@ -116,19 +117,10 @@ public:
 	}
 
 	template <class T>
-	void push( T const& qe ) {
-		BinaryWriter wr( Unversioned() );  // outer framing is not versioned
-		wr << uint32_t(0);
-		IncludeVersion().write(wr);  // payload is versioned
-		wr << qe;
-		wr << uint8_t(1);
-		*(uint32_t*)wr.getData() = wr.getLength() - sizeof(uint32_t) - sizeof(uint8_t);
-		auto loc = queue->push( wr.toStringRef() );
-		//TraceEvent("TLogQueueVersionWritten", dbgid).detail("Size", wr.getLength() - sizeof(uint32_t) - sizeof(uint8_t)).detail("Loc", loc);
-		version_location[qe.version] = loc;
-	}
-	void pop( Version upTo ) {
-		// Keep only the given and all subsequent version numbers
+	void push( T const& qe, Reference<struct LogData> logData );
+
+	void pop( Version upTo, Optional<IDiskQueue::location> keepFrom = Optional<IDiskQueue::location>() ) {
+		// Keep only the given and all subsequent version numbers, and any bytes at or after keepFrom
 		// Find the first version >= upTo
 		auto v = version_location.lower_bound(upTo);
 		if (v == version_location.begin()) return;
@@ -140,7 +132,7 @@ public:
 			v.decrementNonEnd();
 		}
 
-		queue->pop( v->value );
+		queue->pop( keepFrom.present() && keepFrom.get() < v->value ? keepFrom.get() : v->value );
 		version_location.erase( version_location.begin(), v );  // ... and then we erase that previous version and all prior versions
 	}
 	Future<Void> commit() { return queue->commit(); }
@@ -204,13 +196,16 @@ private:
 
 // Immutable keys
 static const KeyValueRef persistFormat( LiteralStringRef( "Format" ), LiteralStringRef("FoundationDB/LogServer/2/4") );
-static const KeyRangeRef persistFormatReadableRange( LiteralStringRef("FoundationDB/LogServer/2/3"), LiteralStringRef("FoundationDB/LogServer/2/5") );
+static const KeyValueRef persistFormatSpillByReference( LiteralStringRef( "Format" ), LiteralStringRef("FoundationDB/LogServer/2/5") );  // Some log has spilled by reference
+static const KeyRangeRef persistFormatReadableRange( LiteralStringRef("FoundationDB/LogServer/2/3"), LiteralStringRef("FoundationDB/LogServer/2/6") );
 static const KeyRangeRef persistRecoveryCountKeys = KeyRangeRef( LiteralStringRef( "DbRecoveryCount/" ), LiteralStringRef( "DbRecoveryCount0" ) );
+static const KeyRangeRef persistSpillTypeKeys = KeyRangeRef( LiteralStringRef( "SpillType/" ), LiteralStringRef( "SpillType0" ) );
 
 // Updated on updatePersistentData()
 static const KeyRangeRef persistCurrentVersionKeys = KeyRangeRef( LiteralStringRef( "version/" ), LiteralStringRef( "version0" ) );
 static const KeyRangeRef persistUnrecoveredBeforeVersionKeys = KeyRangeRef( LiteralStringRef( "UnrecoveredBefore/" ), LiteralStringRef( "UnrecoveredBefore0" ) );
 static const KeyRange persistTagMessagesKeys = prefixRange(LiteralStringRef("TagMsg/"));
+static const KeyRange persistTagMessageRefsKeys = prefixRange(LiteralStringRef("TagMsgRef/"));
 static const KeyRange persistTagPoppedKeys = prefixRange(LiteralStringRef("TagPop/"));
 
 static Key persistTagMessagesKey( UID id, Tag tag, Version version ) {
@@ -222,6 +217,22 @@ static Key persistTagMessagesKey( UID id, Tag tag, Version version ) {
 	return wr.toStringRef();
 }
 
+// For a log that spills by reference, the value is the range of persistentQueue holding the queue entry of the version, and so the tag's messages
+static Key persistTagMessageRefsKey( UID id, Tag tag, Version version ) {
+	BinaryWriter wr( Unversioned() );
+	wr.serializeBytes(persistTagMessageRefsKeys.begin);
+	wr << id;
+	wr << tag;
+	wr << bigEndian64( version );
+	return wr.toStringRef();
+}
+
+static Value persistTagMessageRefsValue( IDiskQueue::location begin, IDiskQueue::location end ) {
+	BinaryWriter wr( Unversioned() );
+	wr << begin.hi << begin.lo << end.hi << end.lo;
+	return wr.toStringRef();
+}
+
 static Key persistTagPoppedKey( UID id, Tag tag ) {
 	BinaryWriter wr(Unversioned());
 	wr.serializeBytes( persistTagPoppedKeys.begin );
@@ -253,6 +264,17 @@ static Version decodeTagMessagesKey( StringRef key ) {
 	return bigEndian64( BinaryReader::fromStringRef<Version>( stripTagMessagesKey(key), Unversioned() ) );
 }
 
+static Version decodeTagMessageRefsKey( StringRef key ) {
+	return bigEndian64( BinaryReader::fromStringRef<Version>( key.substr( sizeof(UID) + sizeof(Tag) + persistTagMessageRefsKeys.begin.size() ), Unversioned() ) );
+}
+
+static std::pair<IDiskQueue::location, IDiskQueue::location> decodeTagMessageRefsValue( ValueRef value ) {
+	std::pair<IDiskQueue::location, IDiskQueue::location> range;
+	BinaryReader rd( value, Unversioned() );
+	rd >> range.first.hi >> range.first.lo >> range.second.hi >> range.second.lo;
+	return range;
+}
+
 struct TLogData : NonCopyable {
 	AsyncTrigger newLogData;
 	Deque<UID> queueOrder;
@@ -271,6 +293,7 @@ struct TLogData : NonCopyable {
 
 	NotifiedVersion queueCommitEnd;
 	Version queueCommitBegin;
+	double queueCommitLatency;  // A moving average of how long persistentQueue->commit() takes, which bounds how long commitQueue() holds back a small commit
 
 	int64_t instanceID;
 	int64_t bytesInput;
@@ -290,29 +313,32 @@ struct TLogData : NonCopyable {
 
 	PromiseStream<Future<Void>> sharedActors;
 	bool terminated;
+	bool spillsByReference;  // Some log here has spilled by reference, so persistentData is written in persistFormatSpillByReference
 
 	TLogData(UID dbgid, IKeyValueStore* persistentData, IDiskQueue * persistentQueue, Reference<AsyncVar<ServerDBInfo>> const& dbInfo)
 			: dbgid(dbgid), instanceID(g_random->randomUniqueID().first()),
 			  persistentData(persistentData), rawPersistentQueue(persistentQueue), persistentQueue(new TLogQueue(persistentQueue, dbgid)),
-			  dbInfo(dbInfo), queueCommitBegin(0), queueCommitEnd(0), prevVersion(0),
+			  dbInfo(dbInfo), queueCommitBegin(0), queueCommitEnd(0), queueCommitLatency(0), prevVersion(0),
 			  diskQueueCommitBytes(0), largeDiskQueueCommitBytes(false),
-			  bytesInput(0), bytesDurable(0), updatePersist(Void()), terminated(false)
+			  bytesInput(0), bytesDurable(0), updatePersist(Void()), terminated(false), spillsByReference(false)
 		{
 		}
 };
 
 struct LogData : NonCopyable, public ReferenceCounted<LogData> {
 	struct TagData : NonCopyable, public ReferenceCounted<TagData> {
-		std::deque<std::pair<Version, LengthPrefixedStringRef>> version_messages;
+		VersionMessageIndex version_messages;
 		bool nothing_persistent;				// true means tag is *known* to have no messages in persistentData.  false means nothing.
 		bool popped_recently;					// `popped` has changed since last updatePersistentData
 		Version popped;				// see popped version tracking contract below
 		bool update_version_sizes;
 		Tag tag;
+		Optional<IDiskQueue::location> poppedLocation;	// for a log that spills by reference, where in persistentQueue the first spilled version this tag hasn't popped begins, if there is one
+		bool requiresPoppedLocationUpdate;		// `popped` has changed since poppedLocation was found
 
-		TagData( Tag tag, Version popped, bool nothing_persistent, bool popped_recently ) : tag(tag), nothing_persistent(nothing_persistent), popped(popped), popped_recently(popped_recently), update_version_sizes(tag != txsTag) {}
+		TagData( Tag tag, Version popped, bool nothing_persistent, bool popped_recently ) : tag(tag), nothing_persistent(nothing_persistent), popped(popped), popped_recently(popped_recently), update_version_sizes(tag != txsTag), requiresPoppedLocationUpdate(false) {}
 
-		TagData(TagData&& r) noexcept(true) : version_messages(std::move(r.version_messages)), nothing_persistent(r.nothing_persistent), popped_recently(r.popped_recently), popped(r.popped), update_version_sizes(r.update_version_sizes), tag(r.tag) {}
+		TagData(TagData&& r) noexcept(true) : version_messages(std::move(r.version_messages)), nothing_persistent(r.nothing_persistent), popped_recently(r.popped_recently), popped(r.popped), update_version_sizes(r.update_version_sizes), tag(r.tag), poppedLocation(r.poppedLocation), requiresPoppedLocationUpdate(r.requiresPoppedLocationUpdate) {}
 		void operator= (TagData&& r) noexcept(true) {
 			version_messages = std::move(r.version_messages);
 			nothing_persistent = r.nothing_persistent;
@@ -320,6 +346,8 @@ struct LogData : NonCopyable, public ReferenceCounted<LogData> {
 			popped = r.popped;
 			update_version_sizes = r.update_version_sizes;
 			tag = r.tag;
+			poppedLocation = r.poppedLocation;
+			requiresPoppedLocationUpdate = r.requiresPoppedLocationUpdate;
 		}
 
 		// Erase messages not needed to update *from* versions >= before (thus, messages with toversion <= before)
@@ -327,11 +355,10 @@ struct LogData : NonCopyable, public ReferenceCounted<LogData> {
 			while(!self->version_messages.empty() && self->version_messages.front().first < before) {
 				Version version = self->version_messages.front().first;
 				std::pair<int, int> &sizes = tlogData->version_sizes[version];
-				int64_t messagesErased = 0;
+				int64_t indexBytes = self->version_messages.bytes();
 
 				while(!self->version_messages.empty() && self->version_messages.front().first == version) {
 					auto const& m = self->version_messages.front();
-					++messagesErased;
 
 					if(self->update_version_sizes) {
 						sizes.first -= m.second.expectedSize();
@@ -340,7 +367,7 @@ struct LogData : NonCopyable, public ReferenceCounted<LogData> {
 					self->version_messages.pop_front();
 				}
 
-				int64_t bytesErased = messagesErased * SERVER_KNOBS->VERSION_MESSAGES_ENTRY_BYTES_WITH_OVERHEAD;
+				int64_t bytesErased = indexBytes - self->version_messages.bytes();
 				tlogData->bytesDurable += bytesErased;
 				*gBytesErased += bytesErased;
 				Void _ = wait(yield(taskID));
@@ -402,9 +429,45 @@ struct LogData : NonCopyable, public ReferenceCounted<LogData> {
 
 	Map<Version, std::pair<int,int>> version_sizes;
 
+	// When spilling by reference, persistentData keeps only where in persistentQueue each spilled version is, and the queue keeps the messages
+	bool spillByReference;
+	Map<Version, std::pair<IDiskQueue::location, IDiskQueue::location>> versionLocation;  // The range of persistentQueue holding each version not yet spilled
+
+	// Recent peek replies made only of spilled data, keyed by tag and begin version.  Spilled versions do not change until
+	// they are popped, so storage servers catching up from the same place, or a peek that is retried, are answered without
+	// reading persistentData again.  The oldest replies are evicted once there are more than TLOG_PEEK_CACHE_BYTES of them.
+	struct PeekCacheEntry {
+		Standalone<StringRef> messages;
+		Version end;
+	};
+	std::map<std::pair<Tag, Version>, PeekCacheEntry> peekCache;
+	std::deque<std::pair<Tag, Version>> peekCacheOrder;
+	int64_t peekCacheBytes;
+	std::map<std::pair<Tag, Version>, Future<Void>> peekReads;  // Peeks reading spilled data, which an identical peek waits for
+
+	void addToPeekCache( std::pair<Tag, Version> const& key, StringRef messages, Version end ) {
+		if( messages.size() > SERVER_KNOBS->TLOG_PEEK_CACHE_BYTES || peekCache.count(key) )
+			return;
+		PeekCacheEntry& entry = peekCache[key];
+		entry.messages = messages;
+		entry.end = end;
+		peekCacheOrder.push_back(key);
+		peekCacheBytes += messages.size();
+		while( peekCacheBytes > SERVER_KNOBS->TLOG_PEEK_CACHE_BYTES ) {
+			auto it = peekCache.find(peekCacheOrder.front());
+			peekCacheBytes -= it->second.messages.size();
+			peekCache.erase(it);
+			peekCacheOrder.pop_front();
+		}
+	}
+
 	CounterCollection cc;
 	Counter bytesInput;
 	Counter bytesDurable;
+	Counter queueCommits;
+	Counter queueCommitBytes;  // Together with queueCommits, the bytes made durable per fsync of persistentQueue
+	Counter peekCacheHits;
+	LatencySample commitLatency;  // From the arrival of a commit request until the reply that it is durable
 
 	UID logId;
 	Version newPersistentDataVersion;
@@ -418,9 +481,10 @@ struct LogData : NonCopyable, public ReferenceCounted<LogData> {
 	Optional<Tag> remoteTag;
 
 	explicit LogData(TLogData* tLogData, TLogInterface interf, Optional<Tag> remoteTag) : tLogData(tLogData), knownCommittedVersion(0), logId(interf.id()),
-			cc("TLog", interf.id().toString()), bytesInput("bytesInput", cc), bytesDurable("bytesDurable", cc), remoteTag(remoteTag), logSystem(new AsyncVar<Reference<ILogSystem>>()),
+			cc("TLog", interf.id().toString()), bytesInput("bytesInput", cc), bytesDurable("bytesDurable", cc), queueCommits("queueCommits", cc), queueCommitBytes("queueCommitBytes", cc), peekCacheHits("peekCacheHits", cc), commitLatency("CommitLatency", cc), remoteTag(remoteTag), logSystem(new AsyncVar<Reference<ILogSystem>>()),
 			// These are initialized differently on init() or recovery
-			recoveryCount(), stopped(false), initialized(false), queueCommittingVersion(0), newPersistentDataVersion(invalidVersion), unrecoveredBefore(0)
+			recoveryCount(), stopped(false), initialized(false), queueCommittingVersion(0), newPersistentDataVersion(invalidVersion), unrecoveredBefore(0),
+			spillByReference(SERVER_KNOBS->TLOG_SPILL_REFERENCE), peekCacheBytes(0)
 	{
 		startRole(interf.id(), UID(), "TLog");
 
@@ -454,8 +518,11 @@ struct LogData : NonCopyable, public ReferenceCounted<LogData> {
 			tLogData->persistentData->clear( singleKeyRange(logIdKey.withPrefix(persistCurrentVersionKeys.begin)) );
 			tLogData->persistentData->clear( singleKeyRange(logIdKey.withPrefix(persistUnrecoveredBeforeVersionKeys.begin)) );
 			tLogData->persistentData->clear( singleKeyRange(logIdKey.withPrefix(persistRecoveryCountKeys.begin)) );
+			tLogData->persistentData->clear( singleKeyRange(logIdKey.withPrefix(persistSpillTypeKeys.begin)) );
 			Key msgKey = logIdKey.withPrefix(persistTagMessagesKeys.begin);
 			tLogData->persistentData->clear( KeyRangeRef( msgKey, strinc(msgKey) ) );
+			Key msgRefKey = logIdKey.withPrefix(persistTagMessageRefsKeys.begin);
+			tLogData->persistentData->clear( KeyRangeRef( msgRefKey, strinc(msgRefKey) ) );
 			Key poppedKey = logIdKey.withPrefix(persistTagPoppedKeys.begin);
 			tLogData->persistentData->clear( KeyRangeRef( poppedKey, strinc(poppedKey) ) );
 		}
@@ -464,6 +531,22 @@ struct LogData : NonCopyable, public ReferenceCounted<LogData> {
 	LogEpoch epoch() const { return recoveryCount; }
 };
 
+template <class T>
+void TLogQueue::push( T const& qe, Reference<LogData> logData ) {
+	BinaryWriter wr( Unversioned() );  // outer framing is not versioned
+	wr << uint32_t(0);
+	IncludeVersion().write(wr);  // payload is versioned
+	wr << qe;
+	wr << uint8_t(1);
+	*(uint32_t*)wr.getData() = wr.getLength() - sizeof(uint32_t) - sizeof(uint8_t);
+	auto begin = queue->getNextPushLocation();
+	auto loc = queue->push( wr.toStringRef() );
+	//TraceEvent("TLogQueueVersionWritten", dbgid).detail("Size", wr.getLength() - sizeof(uint32_t) - sizeof(uint8_t)).detail("Loc", loc);
+	version_location[qe.version] = loc;
+	if( logData->spillByReference )
+		logData->versionLocation[qe.version] = std::make_pair( begin, loc );
+}
+
 ACTOR Future<Void> tLogLock( TLogData* self, ReplyPromise< TLogLockResult > reply, Reference<LogData> logData ) {
 	state Version stopVersion = logData->version.get();
 
@@ -511,8 +594,65 @@ void updatePersistentPopped( TLogData* self, Reference<LogData> logData, Referen
 	self->persistentData->clear( KeyRangeRef(
 		persistTagMessagesKey( logData->logId, data->tag, Version(0) ),
 		persistTagMessagesKey( logData->logId, data->tag, data->popped ) ) );
-	if (data->popped > logData->persistentDataVersion)
+	if (logData->spillByReference) {
+		self->persistentData->clear( KeyRangeRef(
+			persistTagMessageRefsKey( logData->logId, data->tag, Version(0) ),
+			persistTagMessageRefsKey( logData->logId, data->tag, data->popped ) ) );
+		data->requiresPoppedLocationUpdate = true;
+	}
+	if (data->popped > logData->persistentDataVersion) {
 		data->nothing_persistent = true;
+		data->poppedLocation = Optional<IDiskQueue::location>();
+		data->requiresPoppedLocationUpdate = false;
+	}
+}
+
+// Finds where in persistentQueue the first spilled version that each recently popped tag still needs begins, from the durable state of persistentData
+ACTOR Future<Void> updatePoppedLocations( TLogData* self ) {
+	state std::vector<std::pair<Reference<LogData>, Reference<LogData::TagData>>> tags;
+	for(auto& it : self->id_data) {
+		if(!it.second->spillByReference) continue;
+		for(auto& locality : it.second->tag_data) {
+			for(auto& tagData : locality) {
+				if(tagData && tagData->requiresPoppedLocationUpdate)
+					tags.push_back( std::make_pair(it.second, tagData) );
+			}
+		}
+	}
+
+	state int i = 0;
+	for(; i < tags.size(); i++) {
+		state Reference<LogData> logData = tags[i].first;
+		state Reference<LogData::TagData> tagData = tags[i].second;
+		// A pop while we read sets this again, and the location found is then only conservative
+		tagData->requiresPoppedLocationUpdate = false;
+
+		Standalone<VectorRef<KeyValueRef>> kvs = wait( self->persistentData->readRange( KeyRangeRef(
+			persistTagMessageRefsKey( logData->logId, tagData->tag, tagData->popped ),
+			persistTagMessageRefsKey( logData->logId, tagData->tag, std::numeric_limits<Version>::max() ) ), 1 ) );
+
+		if (kvs.size())
+			tagData->poppedLocation = decodeTagMessageRefsValue(kvs[0].value).first;
+		else
+			tagData->poppedLocation = Optional<IDiskQueue::location>();
+	}
+
+	return Void();
+}
+
+// Returns the first location in persistentQueue that holds data some tag has spilled by reference and not popped
+Optional<IDiskQueue::location> minPoppedLocation( TLogData* self ) {
+	Optional<IDiskQueue::location> result;
+	for(auto& it : self->id_data) {
+		if(!it.second->spillByReference) continue;
+		for(auto& locality : it.second->tag_data) {
+			for(auto& tagData : locality) {
+				if(tagData && tagData->poppedLocation.present() && (!result.present() || tagData->poppedLocation.get() < result.get()))
+					result = tagData->poppedLocation;
+			}
+		}
+	}
+	return result;
 }
 
 ACTOR Future<Void> updatePersistentData( TLogData* self, Reference<LogData> logData, Version newPersistentDataVersion ) {
@@ -524,6 +664,9 @@ ACTOR Future<Void> updatePersistentData( TLogData* self, Reference<LogData> logD
 
 	//TraceEvent("updatePersistentData", self->dbgid).detail("seq", newPersistentDataSeq);
 
+	// Before any more versions are spilled, so that the durable state of persistentData is up to date for them
+	Void _ = wait( updatePoppedLocations(self) );
+
 	state bool anyData = false;
 
 	// For all existing tags
@@ -538,22 +681,34 @@ ACTOR Future<Void> updatePersistentData( TLogData* self, Reference<LogData> logD
 				// Clear recently popped versions from persistentData if necessary
 				updatePersistentPopped( self, logData, tagData );
 				// Transfer unpopped messages with version numbers less than newPersistentDataVersion to persistentData
-				state std::deque<std::pair<Version, LengthPrefixedStringRef>>::iterator msg = tagData->version_messages.begin();
+				state VersionMessageIndex::iterator msg = tagData->version_messages.begin();
 				while(msg != tagData->version_messages.end() && msg->first <= newPersistentDataVersion) {
 					currentVersion = msg->first;
 					anyData = true;
 					tagData->nothing_persistent = false;
-					BinaryWriter wr( Unversioned() );
 
-					for(; msg != tagData->version_messages.end() && msg->first == currentVersion; ++msg)
-						wr << msg->second.toStringRef();
+					if( logData->spillByReference ) {
+						auto loc = logData->versionLocation.find( currentVersion );
+						ASSERT( loc != logData->versionLocation.end() );
+						self->persistentData->set( KeyValueRef( persistTagMessageRefsKey( logData->logId, tagData->tag, currentVersion ), persistTagMessageRefsValue( loc->value.first, loc->value.second ) ) );
+						if( !tagData->poppedLocation.present() )
+							tagData->poppedLocation = loc->value.first;
+
+						while(msg != tagData->version_messages.end() && msg->first == currentVersion)
+							++msg;
+					} else {
+						BinaryWriter wr( Unversioned() );
+
+						for(; msg != tagData->version_messages.end() && msg->first == currentVersion; ++msg)
+							wr << msg->second.toStringRef();
 
-					self->persistentData->set( KeyValueRef( persistTagMessagesKey( logData->logId, tagData->tag, currentVersion ), wr.toStringRef() ) );
+						self->persistentData->set( KeyValueRef( persistTagMessagesKey( logData->logId, tagData->tag, currentVersion ), wr.toStringRef() ) );
+					}
 
 					Future<Void> f = yield(TaskUpdateStorage);
 					if(!f.isReady()) {
 						Void _ = wait(f);
-						msg = std::upper_bound(tagData->version_messages.begin(), tagData->version_messages.end(), std::make_pair(currentVersion, LengthPrefixedStringRef()), CompareFirst<std::pair<Version, LengthPrefixedStringRef>>());
+						msg = tagData->version_messages.upper_bound(currentVersion);
 					}
 				}
 
@@ -571,7 +726,9 @@ ACTOR Future<Void> updatePersistentData( TLogData* self, Reference<LogData> logD
 	// Now that the changes we made to persistentData are durable, erase the data we moved from memory and the queue, increase bytesDurable accordingly, and update persistentDataDurableVersion.
 
 	TEST(anyData);  // TLog moved data to persistentData
+	TEST(anyData && logData->spillByReference);  // TLog spilled data by reference
 	logData->persistentDataDurableVersion = newPersistentDataVersion;
+	logData->versionLocation.erase( logData->versionLocation.begin(), logData->versionLocation.upper_bound( newPersistentDataVersion ) );
 
 	for(tag_locality = 0; tag_locality < logData->tag_data.size(); tag_locality++) {
 		for(tag_id = 0; tag_id < logData->tag_data[tag_locality].size(); tag_id++) {
@@ -602,7 +759,7 @@ ACTOR Future<Void> updatePersistentData( TLogData* self, Reference<LogData> logD
 	ASSERT(self->bytesDurable <= self->bytesInput);
 
 	if( self->queueCommitEnd.get() > 0 )
-		self->persistentQueue->pop( newPersistentDataVersion+1 ); // SOMEDAY: this can cause a slow task (~0.5ms), presumably from erasing too many versions. Should we limit the number of versions cleared at a time?
+		self->persistentQueue->pop( newPersistentDataVersion+1, minPoppedLocation(self) ); // SOMEDAY: this can cause a slow task (~0.5ms), presumably from erasing too many versions. Should we limit the number of versions cleared at a time?
 
 	return Void();
 }
@@ -632,7 +789,7 @@ ACTOR Future<Void> updateStorage( TLogData* self ) {
 	if(logData->stopped) {
 		if (self->bytesInput - self->bytesDurable >= SERVER_KNOBS->TLOG_SPILL_THRESHOLD) {
 			while(logData->persistentDataDurableVersion != logData->version.get()) {
-				std::vector<std::pair<std::deque<std::pair<Version, LengthPrefixedStringRef>>::iterator, std::deque<std::pair<Version, LengthPrefixedStringRef>>::iterator>> iters;
+				std::vector<std::pair<VersionMessageIndex::iterator, VersionMessageIndex::iterator>> iters;
 
 				for(tag_locality = 0; tag_locality < logData->tag_data.size(); tag_locality++) {
 					for(tag_id = 0; tag_id < logData->tag_data[tag_locality].size(); tag_id++) {
@@ -700,7 +857,7 @@ ACTOR Future<Void> updateStorage( TLogData* self ) {
 				for(tag_id = 0; tag_id < logData->tag_data[tag_locality].size(); tag_id++) {
 					tagData = logData->tag_data[tag_locality][tag_id];
 					if(tagData) {
-						auto it = std::lower_bound(tagData->version_messages.begin(), tagData->version_messages.end(), std::make_pair(prevVersion, LengthPrefixedStringRef()), CompareFirst<std::pair<Version, LengthPrefixedStringRef>>());
+						auto it = tagData->version_messages.lower_bound(prevVersion);
 						for(; it != tagData->version_messages.end() && it->first < nextVersion; ++it) {
 							totalSize += it->second.expectedSize();
 						}
@@ -792,7 +949,8 @@ void commitMessages( Reference<LogData> self, Version version, const std::vector
 			}
 
 			if (version >= tagData->popped) {
-				tagData->version_messages.push_back(std::make_pair(version, LengthPrefixedStringRef((uint32_t*)(block.end() - msg.message.size()))));
+				int64_t indexBytes = tagData->version_messages.bytes();
+				tagData->version_messages.push_back(version, LengthPrefixedStringRef((uint32_t*)(block.end() - msg.message.size())));
 				if(tagData->version_messages.back().second.expectedSize() > SERVER_KNOBS->MAX_MESSAGE_SIZE) {
 					TraceEvent(SevWarnAlways, "LargeMessage").detail("Size", tagData->version_messages.back().second.expectedSize());
 				}
@@ -800,11 +958,8 @@ void commitMessages( Reference<LogData> self, Version version, const std::vector
 					expectedBytes += tagData->version_messages.back().second.expectedSize();
 				}
 
-				// The factor of VERSION_MESSAGES_OVERHEAD is intended to be an overestimate of the actual memory used to store this data in a std::deque.
-				// In practice, this number is probably something like 528/512 ~= 1.03, but this could vary based on the implementation.
-				// There will also be a fixed overhead per std::deque, but its size should be trivial relative to the size of the TLog
-				// queue and can be thought of as increasing the capacity of the queue slightly.
-				addedBytes += SERVER_KNOBS->VERSION_MESSAGES_ENTRY_BYTES_WITH_OVERHEAD;
+				// The index reports exactly what it allocated for the entry, which is nothing unless the entry began a new segment
+				addedBytes += tagData->version_messages.bytes() - indexBytes;
 			}
 		}
 		
@@ -829,11 +984,8 @@ void commitMessages( Reference<LogData> self, Version version, Arena arena, Stri
 	while(!rd.empty()) {
 		TagsAndMessage tagsAndMsg;
 		rd.checkpoint();
-		rd >> messageLength >> sub >> tagCount;
-		tagsAndMsg.tags.resize(tagCount);
-		for(int i = 0; i < tagCount; i++) {
-			rd >> tagsAndMsg.tags[i];
-		}
+		const Tag* tags = readMessageHeader(rd, messageLength, sub, tagCount);
+		tagsAndMsg.tags.assign(tags, tags + tagCount);
 		rawLength = messageLength + sizeof(messageLength);
 		rd.rewind();
 		tagsAndMsg.message = StringRef((uint8_t const*)rd.readBytes(rawLength), rawLength);
@@ -849,10 +1001,10 @@ Version poppedVersion( Reference<LogData> self, Tag tag) {
 	return tagData->popped;
 }
 
-std::deque<std::pair<Version, LengthPrefixedStringRef>> & get_version_messages( Reference<LogData> self, Tag tag ) {
+VersionMessageIndex & get_version_messages( Reference<LogData> self, Tag tag ) {
 	auto tagData = self->getTagData(tag);
 	if (!tagData) {
-		static std::deque<std::pair<Version, LengthPrefixedStringRef>> empty;
+		static VersionMessageIndex empty;
 		return empty;
 	}
 	return tagData->version_messages;
@@ -881,7 +1033,7 @@ void peekMessagesFromMemory( Reference<LogData> self, TLogPeekRequest const& req
 	//TraceEvent("tLogPeekMem", self->dbgid).detail("Tag", printable(req.tag1)).detail("pDS", self->persistentDataSequence).detail("pDDS", self->persistentDataDurableSequence).detail("Oldest", map1.empty() ? 0 : map1.begin()->key ).detail("OldestMsgCount", map1.empty() ? 0 : map1.begin()->value.size());
 
 	Version begin = std::max( req.begin, self->persistentDataDurableVersion+1 );
-	auto it = std::lower_bound(deque.begin(), deque.end(), std::make_pair(begin, LengthPrefixedStringRef()), CompareFirst<std::pair<Version, LengthPrefixedStringRef>>());
+	auto it = deque.lower_bound(begin);
 
 	Version currentVersion = -1;
 	for(; it != deque.end(); ++it) {
@@ -900,6 +1052,76 @@ void peekMessagesFromMemory( Reference<LogData> self, TLogPeekRequest const& req
 	}
 }
 
+// Appends the messages for tag in a queue entry read back from persistentQueue, as peekMessagesFromMemory() would
+void peekMessagesFromQueueEntry( TLogQueueEntryRef const& qe, Arena const& arena, Tag tag, BinaryWriter& messages ) {
+	ArenaReader rd( arena, qe.messages, Unversioned() );
+	int32_t messageLength, rawLength;
+	uint16_t tagCount;
+	uint32_t sub;
+	bool versionWritten = false;
+	while(!rd.empty()) {
+		rd.checkpoint();
+		const Tag* tags = readMessageHeader(rd, messageLength, sub, tagCount);
+		bool hasTag = std::find(tags, tags + tagCount, tag) != tags + tagCount;
+		rawLength = messageLength + sizeof(messageLength);
+		rd.rewind();
+		StringRef message( (uint8_t const*)rd.readBytes(rawLength), rawLength );
+
+		if(hasTag) {
+			if(!versionWritten) {
+				messages << int32_t(-1) << qe.version;
+				versionWritten = true;
+			}
+			messages.serializeBytes( message );
+		}
+	}
+}
+
+void replyPopped( TLogData* self, Reference<LogData> logData, TLogPeekRequest const& req, Version poppedVer, UID peekId, int sequence ) {
+	TLogPeekReply rep;
+	rep.maxKnownVersion = logData->version.get();
+	rep.popped = poppedVer;
+	rep.end = poppedVer;
+
+	if(req.sequence.present()) {
+		auto& trackerData = self->peekTracker[peekId];
+		trackerData.lastUpdate = now();
+		auto& sequenceData = trackerData.sequence_version[sequence+1];
+		if(sequenceData.isSet()) {
+			if(sequenceData.getFuture().get() != rep.end) {
+				TEST(true); //tlog peek second attempt ended at a different version
+				req.reply.sendError(timed_out());
+				return;
+			}
+		} else {
+			sequenceData.send(rep.end);
+		}
+	}
+
+	req.reply.send( rep );
+}
+
+// Marks a peek as reading spilled data, so that an identical peek can wait for it to leave its reply in the peek cache
+struct SpilledPeekRead : NonCopyable, ReferenceCounted<SpilledPeekRead> {
+	Reference<LogData> logData;
+	std::pair<Tag, Version> key;
+	Promise<Void> done;
+
+	SpilledPeekRead( Reference<LogData> const& logData, std::pair<Tag, Version> const& key ) : key(key) {
+		if( !logData->peekReads.count(key) ) {
+			this->logData = logData;
+			logData->peekReads[key] = done.getFuture();
+		}
+	}
+
+	~SpilledPeekRead() {
+		if( logData ) {
+			logData->peekReads.erase(key);
+			done.send(Void());
+		}
+	}
+};
+
 ACTOR Future<Void> tLogPeekMessages( TLogData* self, TLogPeekRequest req, Reference<LogData> logData ) {
 	state BinaryWriter messages(Unversioned());
 	state BinaryWriter messages2(Unversioned());
@@ -958,35 +1180,44 @@ ACTOR Future<Void> tLogPeekMessages( TLogData* self, TLogPeekRequest req, Refere
 
 	Version poppedVer = poppedVersion(logData, req.tag);
 	if(poppedVer > req.begin) {
-		TLogPeekReply rep;
-		rep.maxKnownVersion = logData->version.get();
-		rep.popped = poppedVer;
-		rep.end = poppedVer;
-
-		if(req.sequence.present()) {
-			auto& trackerData = self->peekTracker[peekId];
-			trackerData.lastUpdate = now();
-			auto& sequenceData = trackerData.sequence_version[sequence+1];
-			if(sequenceData.isSet()) {
-				if(sequenceData.getFuture().get() != rep.end) {
-					TEST(true); //tlog peek second attempt ended at a different version
-					req.reply.sendError(timed_out());
-					return Void();
-				}
-			} else {
-				sequenceData.send(rep.end);
-			}
-		}
-
-		req.reply.send( rep );
+		replyPopped( self, logData, req, poppedVer, peekId, sequence );
 		return Void();
 	}
 
 	state Version endVersion = logData->version.get() + 1;
+	state std::pair<Tag, Version> peekKey = std::make_pair( req.tag, req.begin );
+	state Reference<SpilledPeekRead> spilledRead;
+	state bool cached = false;
+
+	if( req.begin <= logData->persistentDataDurableVersion ) {
+		auto read = logData->peekReads.find( peekKey );
+		if( read != logData->peekReads.end() ) {
+			TEST(true); // TLog peek waits for an identical peek of spilled data
+			Void _ = wait( read->second );
+			Version newPopped = poppedVersion(logData, req.tag);
+			if(newPopped > req.begin) {
+				replyPopped( self, logData, req, newPopped, peekId, sequence );
+				return Void();
+			}
+		}
+
+		auto entry = logData->peekCache.find( peekKey );
+		if( entry != logData->peekCache.end() ) {
+			TEST(true); // TLog peek answered from the peek cache
+			++logData->peekCacheHits;
+			messages.serializeBytes( entry->second.messages );
+			endVersion = entry->second.end;
+			cached = true;
+		}
+	}
 
 	//grab messages from disk
 	//TraceEvent("tLogPeekMessages", self->dbgid).detail("reqBeginEpoch", req.begin.epoch).detail("reqBeginSeq", req.begin.sequence).detail("epoch", self->epoch()).detail("persistentDataSeq", self->persistentDataSequence).detail("Tag1", printable(req.tag1)).detail("Tag2", printable(req.tag2));
-	if( req.begin <= logData->persistentDataDurableVersion ) {
+	if( cached ) {
+		// The reply is the one given to an identical peek
+	} else if( req.begin <= logData->persistentDataDurableVersion ) {
+		spilledRead = Reference<SpilledPeekRead>( new SpilledPeekRead( logData, peekKey ) );
+
 		// Just in case the durable version changes while we are waiting for the read, we grab this data from memory.  We may or may not actually send it depending on
 		// whether we get enough data from disk.
 		// SOMEDAY: Only do this if an initial attempt to read from disk results in insufficient data and the required data is no longer in memory
@@ -994,10 +1225,11 @@ ACTOR Future<Void> tLogPeekMessages( TLogData* self, TLogPeekRequest req, Refere
 
 		peekMessagesFromMemory( logData, req, messages2, endVersion );
 
+		state Version persistentEnd = logData->persistentDataDurableVersion + 1;
 		Standalone<VectorRef<KeyValueRef>> kvs = wait(
 			self->persistentData->readRange(KeyRangeRef(
 				persistTagMessagesKey(logData->logId, req.tag, req.begin),
-				persistTagMessagesKey(logData->logId, req.tag, logData->persistentDataDurableVersion + 1)), SERVER_KNOBS->DESIRED_TOTAL_BYTES, SERVER_KNOBS->DESIRED_TOTAL_BYTES));
+				persistTagMessagesKey(logData->logId, req.tag, persistentEnd)), SERVER_KNOBS->DESIRED_TOTAL_BYTES, SERVER_KNOBS->DESIRED_TOTAL_BYTES));
 
 		//TraceEvent("TLogPeekResults", self->dbgid).detail("ForAddress", req.reply.getEndpoint().address).detail("Tag1Results", s1).detail("Tag2Results", s2).detail("Tag1ResultsLim", kv1.size()).detail("Tag2ResultsLim", kv2.size()).detail("Tag1ResultsLast", kv1.size() ? printable(kv1[0].key) : "").detail("Tag2ResultsLast", kv2.size() ? printable(kv2[0].key) : "").detail("Limited", limited).detail("NextEpoch", next_pos.epoch).detail("NextSeq", next_pos.sequence).detail("NowEpoch", self->epoch()).detail("NowSeq", self->sequence.getNextSequence());
 
@@ -1007,10 +1239,80 @@ ACTOR Future<Void> tLogPeekMessages( TLogData* self, TLogPeekRequest req, Refere
 			messages.serializeBytes(kv.value);
 		}
 
-		if (kvs.expectedSize() >= SERVER_KNOBS->DESIRED_TOTAL_BYTES)
+		if (kvs.expectedSize() >= SERVER_KNOBS->DESIRED_TOTAL_BYTES) {
 			endVersion = decodeTagMessagesKey(kvs.end()[-1].key) + 1;
-		else
+			logData->addToPeekCache( peekKey, messages.toStringRef(), endVersion );
+		} else if (logData->spillByReference) {
+			// A log recovered from an old log system holds the versions it copied by value, and spills only later versions by reference
+			Version refsBegin = kvs.size() ? decodeTagMessagesKey(kvs.end()[-1].key) + 1 : req.begin;
+			Standalone<VectorRef<KeyValueRef>> refs = wait(
+				self->persistentData->readRange(KeyRangeRef(
+					persistTagMessageRefsKey(logData->logId, req.tag, refsBegin),
+					persistTagMessageRefsKey(logData->logId, req.tag, persistentEnd)), SERVER_KNOBS->DESIRED_TOTAL_BYTES, SERVER_KNOBS->DESIRED_TOTAL_BYTES));
+
+			// Read adjacent queue entries together, up to TLOG_SPILL_REFERENCE_MAX_PEEK_BYTES in all
+			state bool refsLimited = refs.expectedSize() >= SERVER_KNOBS->DESIRED_TOTAL_BYTES;
+			state Version lastRefVersion = invalidVersion;
+			state std::vector<Future<Standalone<StringRef>>> reads;
+			std::pair<IDiskQueue::location, IDiskQueue::location> range;
+			int64_t queueBytes = 0;
+			for(auto& ref : refs) {
+				if(queueBytes >= SERVER_KNOBS->TLOG_SPILL_REFERENCE_MAX_PEEK_BYTES) {
+					refsLimited = true;
+					break;
+				}
+				auto loc = decodeTagMessageRefsValue(ref.value);
+				queueBytes += loc.second.lo - loc.first.lo;
+				lastRefVersion = decodeTagMessageRefsKey(ref.key);
+				if(range.first < range.second && range.second == loc.first) {
+					range.second = loc.second;
+				} else {
+					if(range.first < range.second)
+						reads.push_back( self->rawPersistentQueue->read( range.first, range.second ) );
+					range = loc;
+				}
+			}
+			if(range.first < range.second)
+				reads.push_back( self->rawPersistentQueue->read( range.first, range.second ) );
+
+			ErrorOr<Void> readResult = wait( errorOr( waitForAll(reads) ) );
+			if(readResult.isError()) {
+				// The tag may have been popped, and the queue reused, while we waited
+				Version poppedVer = poppedVersion(logData, req.tag);
+				if(readResult.getError().code() != error_code_checksum_failed || poppedVer <= req.begin)
+					throw readResult.getError();
+				TEST(true); // TLog peek of data spilled by reference raced with a pop
+				replyPopped( self, logData, req, poppedVer, peekId, sequence );
+				return Void();
+			}
+
+			TEST(reads.size()); // TLog peeked data spilled by reference
+			for(auto& read : reads) {
+				StringRef entries = read.get();
+				while(entries.size()) {
+					// The framing written by TLogQueue::push()
+					uint32_t payloadSize = *(uint32_t*)entries.begin();
+					ASSERT( entries.size() >= sizeof(uint32_t) + payloadSize + sizeof(uint8_t) );
+					if(entries[sizeof(uint32_t) + payloadSize]) {
+						TLogQueueEntryRef qe;
+						ArenaReader rd( read.get().arena(), entries.substr(sizeof(uint32_t), payloadSize), IncludeVersion() );
+						rd >> qe;
+						if(qe.id == logData->logId && qe.version >= req.begin)
+							peekMessagesFromQueueEntry( qe, read.get().arena(), req.tag, messages );
+					}
+					entries = entries.substr( sizeof(uint32_t) + payloadSize + sizeof(uint8_t) );
+				}
+			}
+
+			if (refsLimited) {
+				endVersion = lastRefVersion + 1;
+				logData->addToPeekCache( peekKey, messages.toStringRef(), endVersion );
+			} else {
+				messages.serializeBytes( messages2.toStringRef() );
+			}
+		} else {
 			messages.serializeBytes( messages2.toStringRef() );
+		}
 	} else {
 		peekMessagesFromMemory( logData, req, messages, endVersion );
 		//TraceEvent("TLogPeekResults", self->dbgid).detail("ForAddress", req.reply.getEndpoint().address).detail("MessageBytes", messages.getLength()).detail("NextEpoch", next_pos.epoch).detail("NextSeq", next_pos.sequence).detail("NowSeq", self->sequence.getNextSequence());
@@ -1020,6 +1322,8 @@ ACTOR Future<Void> tLogPeekMessages( TLogData* self, TLogPeekRequest req, Refere
 	reply.maxKnownVersion = logData->version.get();
 	reply.messages = messages.toStringRef();
 	reply.end = endVersion;
+	if( req.acceptCompressed && reply.messages.size() >= SERVER_KNOBS->PEEK_REPLY_COMPRESSION_MIN_BYTES )
+		reply.compress( SERVER_KNOBS->PEEK_REPLY_COMPRESSION_LEVEL );
 
 	//TraceEvent("TlogPeek", self->dbgid).detail("logId", logData->logId).detail("endVer", reply.end).detail("msgBytes", reply.messages.expectedSize()).detail("ForAddress", req.reply.getEndpoint().address);
 
@@ -1046,6 +1350,8 @@ ACTOR Future<Void> doQueueCommit( TLogData* self, Reference<LogData> logData ) {
 	state Version ver = logData->version.get();
 	state Version commitNumber = self->queueCommitBegin+1;
 	self->queueCommitBegin = commitNumber;
+	state int64_t commitBytes = self->diskQueueCommitBytes;
+	state double commitStart = now();
 	logData->queueCommittingVersion = ver;
 
 	Future<Void> c = self->persistentQueue->commit();
@@ -1053,6 +1359,9 @@ ACTOR Future<Void> doQueueCommit( TLogData* self, Reference<LogData> logData ) {
 	self->largeDiskQueueCommitBytes.set(false);
 
 	Void _ = wait(c);
+	self->queueCommitLatency = 0.9 * self->queueCommitLatency + 0.1 * (now() - commitStart);
+	++logData->queueCommits;
+	logData->queueCommitBytes += commitBytes;
 	Void _ = wait(self->queueCommitEnd.whenAtLeast(commitNumber-1));
 
 	//Calling check_yield instead of yield to avoid a destruction ordering problem in simulation
@@ -1068,7 +1377,7 @@ ACTOR Future<Void> doQueueCommit( TLogData* self, Reference<LogData> logData ) {
 	if(logData->remoteTag.present() && logData->logSystem->get())
 		logData->logSystem->get()->pop(ver, logData->remoteTag.get());
 
-	TraceEvent("TLogCommitDurable", self->dbgid).detail("Version", ver);
+	TraceEvent("TLogCommitDurable", self->dbgid).detail("Version", ver).detail("Bytes", commitBytes);
 
 	return Void();
 }
@@ -1104,6 +1413,14 @@ ACTOR Future<Void> commitQueue( TLogData* self ) {
 					while( self->queueCommitBegin != self->queueCommitEnd.get() && !self->largeDiskQueueCommitBytes.get() ) {
 						Void _ = wait( self->queueCommitEnd.whenAtLeast(self->queueCommitBegin) || self->largeDiskQueueCommitBytes.onChange() );
 					}
+					// A small commit waits for a fraction of an fsync for more commits to join it, since the fsync costs about the same either way
+					if( self->diskQueueCommitBytes < SERVER_KNOBS->TLOG_GROUP_COMMIT_BYTES && !self->largeDiskQueueCommitBytes.get() && !logData->stopped ) {
+						double groupDelay = std::min( SERVER_KNOBS->TLOG_GROUP_COMMIT_MAX_DELAY, self->queueCommitLatency * SERVER_KNOBS->TLOG_GROUP_COMMIT_LATENCY_FRACTION );
+						if( groupDelay > 0 ) {
+							TEST(true); // TLog held back a small queue commit
+							Void _ = wait( delay(groupDelay) || self->largeDiskQueueCommitBytes.onChange() );
+						}
+					}
 					self->sharedActors.send(doQueueCommit(self, logData));
 				}
 				when(Void _ = wait(self->newLogData.onTrigger())) {}
@@ -1117,6 +1434,7 @@ ACTOR Future<Void> tLogCommit(
 		TLogCommitRequest req,
 		Reference<LogData> logData,
 		PromiseStream<Void> warningCollectorInput ) {
+	state double startTime = now();
 	state Optional<UID> tlogDebugID;
 	if(req.debugID.present())
 	{
@@ -1152,7 +1470,7 @@ ACTOR Future<Void> tLogCommit(
 		qe.knownCommittedVersion = req.knownCommittedVersion;
 		qe.messages = req.messages;
 		qe.id = logData->logId;
-		self->persistentQueue->push( qe );
+		self->persistentQueue->push( qe, logData );
 
 		self->diskQueueCommitBytes += qe.expectedSize();
 		if( self->diskQueueCommitBytes > SERVER_KNOBS->MAX_QUEUE_COMMIT_BYTES ) {
@@ -1179,6 +1497,7 @@ ACTOR Future<Void> tLogCommit(
 	if(req.debugID.present())
 		g_traceBatch.addEvent("CommitDebug", tlogDebugID.get().first(), "TLog.tLogCommit.After");
 
+	logData->commitLatency.addMeasurement( now() - startTime );
 	req.reply.send( Void() );
 	return Void();
 }
@@ -1186,8 +1505,11 @@ ACTOR Future<Void> tLogCommit(
 ACTOR Future<Void> initPersistentState( TLogData* self, Reference<LogData> logData, Version unrecoveredBefore ) {
 	// PERSIST: Initial setup of persistentData for a brand new tLog for a new database
 	IKeyValueStore *storage = self->persistentData;
-	storage->set( persistFormat );
+	if( logData->spillByReference )
+		self->spillsByReference = true;
+	storage->set( self->spillsByReference ? persistFormatSpillByReference : persistFormat );
 	storage->set( KeyValueRef( BinaryWriter::toValue(logData->logId,Unversioned()).withPrefix(persistCurrentVersionKeys.begin), BinaryWriter::toValue(logData->version.get(), Unversioned()) ) );
+	storage->set( KeyValueRef( BinaryWriter::toValue(logData->logId,Unversioned()).withPrefix(persistSpillTypeKeys.begin), BinaryWriter::toValue(logData->spillByReference, Unversioned()) ) );
 	storage->set( KeyValueRef( BinaryWriter::toValue(logData->logId,Unversioned()).withPrefix(persistUnrecoveredBeforeVersionKeys.begin), BinaryWriter::toValue(unrecoveredBefore, Unversioned()) ) );
 	storage->set( KeyValueRef( BinaryWriter::toValue(logData->logId,Unversioned()).withPrefix(persistRecoveryCountKeys.begin), BinaryWriter::toValue(logData->recoveryCount, Unversioned()) ) );
 
@@ -1405,8 +1727,9 @@ ACTOR Future<Void> pullAsyncData( TLogData* self, Reference<LogData> logData, Ta
 				}
 				when( Void _ = wait( dbInfoChange ) ) {
 					if(r) tagPopped = std::max(tagPopped, r->popped());
+					// Remote logs pull from the log routers across the WAN, so keep a window of peeks outstanding to hide the round trip
 					if( logData->logSystem->get() )
-						r = logData->logSystem->get()->peek( tagAt, tag );
+						r = logData->logSystem->get()->peek( tagAt, tag, tag.locality == tagLocalityRemoteLog );
 					else
 						r = Reference<ILogSystem::IPeekCursor>();
 					dbInfoChange = logData->logSystem->onChange();
@@ -1433,7 +1756,7 @@ ACTOR Future<Void> pullAsyncData( TLogData* self, Reference<LogData> logData, Ta
 					qe.knownCommittedVersion = 0;
 					qe.alternativeMessages = &messages;
 					qe.id = logData->logId;
-					self->persistentQueue->push( qe );
+					self->persistentQueue->push( qe, logData );
 
 					self->diskQueueCommitBytes += qe.expectedSize();
 					if( self->diskQueueCommitBytes > SERVER_KNOBS->MAX_QUEUE_COMMIT_BYTES ) {
@@ -1458,7 +1781,7 @@ ACTOR Future<Void> pullAsyncData( TLogData* self, Reference<LogData> logData, Ta
 						qe.knownCommittedVersion = 0;
 						qe.messages = StringRef();
 						qe.id = logData->logId;
-						self->persistentQueue->push( qe );
+						self->persistentQueue->push( qe, logData );
 
 						self->diskQueueCommitBytes += qe.expectedSize();
 						if( self->diskQueueCommitBytes > SERVER_KNOBS->MAX_QUEUE_COMMIT_BYTES ) {
@@ -1557,11 +1880,12 @@ ACTOR Future<Void> restorePersistentState( TLogData* self, LocalityData locality
 	state Future<Standalone<VectorRef<KeyValueRef>>> fVers = storage->readRange(persistCurrentVersionKeys);
 	state Future<Standalone<VectorRef<KeyValueRef>>> fUnrecoveredBefore = storage->readRange(persistUnrecoveredBeforeVersionKeys);
 	state Future<Standalone<VectorRef<KeyValueRef>>> fRecoverCounts = storage->readRange(persistRecoveryCountKeys);
+	state Future<Standalone<VectorRef<KeyValueRef>>> fSpillTypes = storage->readRange(persistSpillTypeKeys);
 
 	// FIXME: metadata in queue?
 
 	Void _ = wait( waitForAll( (vector<Future<Optional<Value>>>(), fFormat ) ) );
-	Void _ = wait( waitForAll( (vector<Future<Standalone<VectorRef<KeyValueRef>>>>(), fVers, fUnrecoveredBefore, fRecoverCounts) ) );
+	Void _ = wait( waitForAll( (vector<Future<Standalone<VectorRef<KeyValueRef>>>>(), fVers, fUnrecoveredBefore, fRecoverCounts, fSpillTypes) ) );
 
 	if (fFormat.get().present() && !persistFormatReadableRange.contains( fFormat.get().get() )) {
 		//FIXME: remove when we no longer need to test upgrades from 4.X releases
@@ -1601,11 +1925,19 @@ ACTOR Future<Void> restorePersistentState( TLogData* self, LocalityData locality
 
 	ASSERT(fVers.get().size() == fRecoverCounts.get().size());
 
+	self->spillsByReference = fFormat.get().get() == persistFormatSpillByReference.value;
+
 	state std::map<UID, Version> id_unrecoveredBefore;
 	for(auto it : fUnrecoveredBefore.get()) {
 		id_unrecoveredBefore[ BinaryReader::fromStringRef<UID>(it.key.removePrefix(persistUnrecoveredBeforeVersionKeys.begin), Unversioned())] = BinaryReader::fromStringRef<Version>( it.value, Unversioned() );
 	}
 
+	// Logs written before spilling by reference have no spill type, and spilled by value
+	state std::map<UID, bool> id_spillByReference;
+	for(auto it : fSpillTypes.get()) {
+		id_spillByReference[ BinaryReader::fromStringRef<UID>(it.key.removePrefix(persistSpillTypeKeys.begin), Unversioned())] = BinaryReader::fromStringRef<bool>( it.value, Unversioned() );
+	}
+
 	state int idx = 0;
 	state Promise<Void> registerWithMaster;
 	state std::map<UID, TLogInterface> id_interf;
@@ -1632,6 +1964,7 @@ ACTOR Future<Void> restorePersistentState( TLogData* self, LocalityData locality
 		id_interf[id1] = recruited;
 
 		logData->unrecoveredBefore = id_unrecoveredBefore[id1];
+		logData->spillByReference = id_spillByReference[id1];
 		Version ver = BinaryReader::fromStringRef<Version>( fVers.get()[idx].value, Unversioned() );
 		logData->persistentDataVersion = ver;
 		logData->persistentDataDurableVersion = ver;
@@ -1640,7 +1973,7 @@ ACTOR Future<Void> restorePersistentState( TLogData* self, LocalityData locality
 		logData->removed = rejoinMasters(self, recruited, logData->recoveryCount, registerWithMaster.getFuture(), logData->remoteTag.present());
 		removed.push_back(errorOr(logData->removed));
 
-		TraceEvent("TLogRestorePersistentStateVer", id1).detail("ver", ver);
+		TraceEvent("TLogRestorePersistentStateVer", id1).detail("ver", ver).detail("SpillByReference", logData->spillByReference);
 
 		// Restore popped keys.  Pop operations that took place after the last (committed) updatePersistentDataVersion might be lost, but
 		// that is fine because we will get the corresponding data back, too.
@@ -1657,11 +1990,15 @@ ACTOR Future<Void> restorePersistentState( TLogData* self, LocalityData locality
 				TraceEvent("TLogRestorePop", logData->logId).detail("Tag", tag.toString()).detail("To", popped);
 				auto tagData = logData->getTagData(tag);
 				ASSERT( !tagData );
-				logData->createTagData(tag, popped, false, false);
+				tagData = logData->createTagData(tag, popped, false, false);
+				tagData->requiresPoppedLocationUpdate = logData->spillByReference;
 			}
 		}
 	}
 
+	// So that the queue entries that are read can be found again by spilling by reference
+	Void _ = wait( self->rawPersistentQueue->initializeRecovery() );
+
 	state Future<Void> allRemoved = waitForAll(removed);
 	state Version lastVer = 0;
 	state UID lastId = UID(1,1); //initialized so it will not compare equal to a default UID
@@ -1674,6 +2011,7 @@ ACTOR Future<Void> restorePersistentState( TLogData* self, LocalityData locality
 				TEST(true); //all tlogs removed during queue recovery
 				throw worker_removed();
 			}
+			state IDiskQueue::location entryBegin = self->rawPersistentQueue->getNextReadLocation();
 			choose {
 				when( TLogQueueEntry qe = wait( self->persistentQueue->readNext() ) ) {
 					if(!self->queueOrder.size() || self->queueOrder.back() != qe.id) self->queueOrder.push_back(qe.id);
@@ -1696,6 +2034,8 @@ ACTOR Future<Void> restorePersistentState( TLogData* self, LocalityData locality
 					if(logData) {
 						logData->knownCommittedVersion = std::max(logData->knownCommittedVersion, qe.knownCommittedVersion);
 						if( qe.version > logData->version.get() ) {
+							if( logData->spillByReference )
+								logData->versionLocation[qe.version] = std::make_pair( entryBegin, self->rawPersistentQueue->getNextReadLocation() );
 							commitMessages(logData, qe.version, qe.arena(), qe.messages, self->bytesInput);
 							logData->version.set( qe.version );
 							logData->queueCommittedVersion.set( qe.version );
@@ -1773,8 +2113,9 @@ ACTOR Future<Void> recoverTagFromLogSystem( TLogData* self, Reference<LogData> l
 				}
 				when( Void _ = wait( dbInfoChange ) ) {
 					if(r) tagPopped = std::max(tagPopped, r->popped());
+					// The copy is bound by round trips to the old generation rather than by its disks, so keep a window of peeks outstanding
 					if( logSystem->get() )
-						r = logSystem->get()->peek( tagAt, tag );
+						r = logSystem->get()->peek( tagAt, tag, true );
 					else
 						r = Reference<ILogSystem::IPeekCursor>();
 					dbInfoChange = logSystem->onChange();
@@ -2143,3 +2484,100 @@ TEST_CASE( "fdbserver/tlogserver/VersionMessagesOverheadFactor" ) {
 
 	return Void();
 }
+
+TEST_CASE( "fdbserver/tlogserver/VersionMessageIndex" ) {
+	// Messages in two blocks, the second of them below the first in memory some of the time
+	std::vector<Standalone<VectorRef<uint8_t>>> blocks(2);
+	for(auto& b : blocks) {
+		b.resize(b.arena(), 1000);
+	}
+
+	VersionMessageIndex index;
+	std::deque<std::pair<Version, LengthPrefixedStringRef>> expected;
+	Version version = 1;
+	for(int i = 0; i < 10000; i++) {
+		if(expected.size() && g_random->random01() < 0.45) {
+			ASSERT(index.front().first == expected.front().first && index.front().second.getLengthPtr() == expected.front().second.getLengthPtr());
+			index.pop_front();
+			expected.pop_front();
+		} else {
+			int r = g_random->randomInt(0, 100);
+			version += r < 50 ? 0 : r < 99 ? g_random->randomInt(1, 100) : g_random->randomInt64(1, 10e9);
+			auto& b = blocks[g_random->randomInt(0, blocks.size())];
+			LengthPrefixedStringRef m( (uint32_t*)(b.begin() + g_random->randomInt(0, b.size() / 4) * 4) );
+			index.push_back(version, m);
+			expected.push_back(std::make_pair(version, m));
+		}
+		ASSERT(index.size() == expected.size());
+
+		if(g_random->random01() < 0.05) {
+			auto it = index.begin();
+			for(auto& e : expected) {
+				ASSERT(it != index.end() && it->first == e.first && it->second.getLengthPtr() == e.second.getLengthPtr());
+				++it;
+			}
+			ASSERT(it == index.end());
+		}
+
+		Version v = version - g_random->randomInt(-1, 200);
+		auto lower = index.lower_bound(v);
+		auto upper = index.upper_bound(v);
+		auto expectedLower = std::lower_bound(expected.begin(), expected.end(), std::make_pair(v, LengthPrefixedStringRef()), CompareFirst<std::pair<Version, LengthPrefixedStringRef>>());
+		auto expectedUpper = std::upper_bound(expected.begin(), expected.end(), std::make_pair(v, LengthPrefixedStringRef()), CompareFirst<std::pair<Version, LengthPrefixedStringRef>>());
+		ASSERT((lower == index.end()) == (expectedLower == expected.end()));
+		ASSERT((upper == index.end()) == (expectedUpper == expected.end()));
+		if(lower != index.end()) {
+			ASSERT(lower->first == expectedLower->first && lower->second.getLengthPtr() == expectedLower->second.getLengthPtr());
+		}
+		if(upper != index.end()) {
+			ASSERT(upper->first == expectedUpper->first && upper->second.getLengthPtr() == expectedUpper->second.getLengthPtr());
+		}
+	}
+
+	// Only the array of segment pointers is left once everything is popped, and a segment is accounted as it comes and goes
+	while(!expected.empty()) {
+		index.pop_front();
+		expected.pop_front();
+	}
+	ASSERT(index.empty() && index.begin() == index.end());
+	int64_t emptyBytes = index.bytes();
+	index.push_back(version, LengthPrefixedStringRef((uint32_t*)blocks[0].begin()));
+	ASSERT(index.bytes() == emptyBytes + 512);
+	index.pop_front();
+	ASSERT(index.bytes() == emptyBytes);
+
+	return Void();
+}
+
+TEST_CASE( "fdbserver/tlogserver/readMessageHeader" ) {
+	// Messages as LogPushData writes them, with random tags and lengths, read back as peekMessagesFromQueueEntry() does
+	BinaryWriter wr( Unversioned() );
+	std::vector<std::pair<uint32_t, std::vector<Tag>>> expected;
+	for(int i = 0; i < 100; i++) {
+		std::vector<Tag> tags;
+		int tagCount = g_random->randomInt(0, 5);
+		for(int t = 0; t < tagCount; t++)
+			tags.push_back( Tag(g_random->randomInt(-2, 3), g_random->randomInt(0, 65536)) );
+		std::string mutation( g_random->randomInt(0, 20), 'x' );
+		uint32_t sub = g_random->randomInt(1, 1000);
+		wr << uint32_t(mutation.size() + sizeof(sub) + sizeof(uint16_t) + sizeof(Tag)*tags.size()) << sub << uint16_t(tags.size());
+		for(auto& tag : tags)
+			wr << tag;
+		wr.serializeBytes( StringRef(mutation) );
+		expected.push_back( std::make_pair(sub, tags) );
+	}
+
+	Standalone<StringRef> messages = wr.toStringRef();
+	ArenaReader rd( messages.arena(), messages, Unversioned() );
+	for(auto& e : expected) {
+		int32_t messageLength;
+		uint32_t sub;
+		uint16_t tagCount;
+		const Tag* tags = readMessageHeader( rd, messageLength, sub, tagCount );
+		ASSERT( sub == e.first && std::vector<Tag>(tags, tags + tagCount) == e.second );
+		rd.readBytes( messageLength - sizeof(sub) - sizeof(tagCount) - tagCount*sizeof(Tag) );
+	}
+	ASSERT( rd.empty() );
+
+	return Void();
+}
@@ -30,9 +30,15 @@
 #include "fdbrpc/ReplicationUtils.h"
 #include "RecoveryState.h"
 
-ACTOR static Future<Void> reportTLogCommitErrors( Future<Void> commitReply, UID debugID ) {
+// A tlog that is slow to acknowledge holds up every commit for which it is needed to make the quorum of its log set, so
+// it is reported in order that it can be excluded before it becomes the p99 commit latency
+ACTOR static Future<Void> reportTLogCommitErrors( Future<Void> commitReply, UID debugID, UID tLogID, Version version ) {
+	state double sent = now();
 	try {
 		Void _ = wait(commitReply);
+		if( now() - sent > SERVER_KNOBS->TLOG_SLOW_COMMIT_WARNING_TIME ) {
+			TraceEvent(SevWarn, "MasterTLogCommitSlow", debugID).detail("TLog", tLogID).detail("Version", version).detail("Latency", now() - sent).suppressFor(1.0);
+		}
 		return Void();
 	} catch (Error& e) {
 		if (e.code() == error_code_broken_promise)
@@ -347,7 +353,7 @@ struct TagPartitionedLogSystem : ILogSystem, ReferenceCounted<TagPartitionedLogS
 					Future<Void> commitMessage = reportTLogCommitErrors(
 							it->logServers[loc]->get().interf().commit.getReply(
 								TLogCommitRequest( data.getArena(), prevVersion, version, knownCommittedVersion, data.getMessages(location), debugID ), TaskTLogCommitReply ),
-							getDebugID());
+							getDebugID(), it->logServers[loc]->get().id(), version);
 					actors.add(commitMessage);
 					tLogCommitResults.push_back(commitMessage);
 					location++;
@@ -375,7 +381,7 @@ struct TagPartitionedLogSystem : ILogSystem, ReferenceCounted<TagPartitionedLogS
 			if(bestSet == -1) {
 				return Reference<ILogSystem::ServerPeekCursor>( new ILogSystem::ServerPeekCursor( Reference<AsyncVar<OptionalInterface<TLogInterface>>>(), tag, begin, getPeekEnd(), false, false ) );
 			}
-			return Reference<ILogSystem::MergedPeekCursor>( new ILogSystem::MergedPeekCursor( tLogs[bestSet]->logRouters, -1, (int)tLogs[bestSet]->logRouters.size(), tag, begin, getPeekEnd(), false ) );
+			return Reference<ILogSystem::MergedPeekCursor>( new ILogSystem::MergedPeekCursor( tLogs[bestSet]->logRouters, -1, (int)tLogs[bestSet]->logRouters.size(), tag, begin, getPeekEnd(), parallelGetMore ) );
 		} else {
 			int bestSet = -1;
 			for(int t = 0; t < tLogs.size(); t++) {
@@ -410,7 +416,7 @@ struct TagPartitionedLogSystem : ILogSystem, ReferenceCounted<TagPartitionedLogS
 		}
 	}
 
-	virtual Reference<IPeekCursor> peekSingle( Version begin, Tag tag, vector<pair<Version,Tag>> history ) {
+	virtual Reference<IPeekCursor> peekSingle( Version begin, Tag tag, vector<pair<Version,Tag>> history, bool parallelGetMore ) {
 		int bestSet = -1;
 		for(int t = 0; t < tLogs.size(); t++) {
 			if(tLogs[t]->hasBestPolicy && (tLogs[t]->locality == tag.locality || tag.locality == tagLocalitySpecial || tLogs[t]->locality == tagLocalitySpecial || (tLogs[t]->isLocal && tag.locality == tagLocalityLogRouter))) {
@@ -427,14 +433,14 @@ struct TagPartitionedLogSystem : ILogSystem, ReferenceCounted<TagPartitionedLogS
 
 			return Reference<ILogSystem::ServerPeekCursor>( new ILogSystem::ServerPeekCursor( (tLogs.size() && bestSet >= 0 && tLogs[bestSet]->logServers.size()) ?
 				tLogs[bestSet]->logServers[tLogs[bestSet]->bestLocationFor( tag )] :
-				Reference<AsyncVar<OptionalInterface<TLogInterface>>>(), tag, begin, getPeekEnd(), false, false ) );
+				Reference<AsyncVar<OptionalInterface<TLogInterface>>>(), tag, begin, getPeekEnd(), false, parallelGetMore ) );
 		} else {
 			std::vector< Reference<ILogSystem::IPeekCursor> > cursors;
 			std::vector< LogMessageVersion > epochEnds;
 				
 			cursors.push_back( Reference<ILogSystem::ServerPeekCursor>( new ILogSystem::ServerPeekCursor( (tLogs.size() && bestSet >= 0 && tLogs[bestSet]->logServers.size()) ?
 				tLogs[bestSet]->logServers[tLogs[bestSet]->bestLocationFor( tag )] :
-				Reference<AsyncVar<OptionalInterface<TLogInterface>>>(), tag, begin, getPeekEnd(), false, false ) ) );
+				Reference<AsyncVar<OptionalInterface<TLogInterface>>>(), tag, begin, getPeekEnd(), false, parallelGetMore ) ) );
 
 			for(int i = 0; i < history.size(); i++) {
 				bestSet = -1;
@@ -447,7 +453,7 @@ struct TagPartitionedLogSystem : ILogSystem, ReferenceCounted<TagPartitionedLogS
 					
 				cursors.push_back( Reference<ILogSystem::ServerPeekCursor>( new ILogSystem::ServerPeekCursor( (tLogs.size() && bestSet >= 0 && tLogs[bestSet]->logServers.size()) ?
 					tLogs[bestSet]->logServers[tLogs[bestSet]->bestLocationFor( history[i].second )] :
-					Reference<AsyncVar<OptionalInterface<TLogInterface>>>(), history[i].second, i+1 == history.size() ? begin : std::max(history[i+1].first, begin), history[i].first, false, false ) ) );
+					Reference<AsyncVar<OptionalInterface<TLogInterface>>>(), history[i].second, i+1 == history.size() ? begin : std::max(history[i+1].first, begin), history[i].first, false, parallelGetMore ) ) );
 				epochEnds.push_back(LogMessageVersion(history[i].first));
 			}
 
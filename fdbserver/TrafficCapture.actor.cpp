@@ -0,0 +1,167 @@
+/*
+ * TrafficCapture.actor.cpp
+ *
+ * This source file is part of the FoundationDB open source project
+ *
+ * Copyright 2013-2018 Apple Inc. and the FoundationDB project authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "flow/actorcompiler.h"
+#include "TrafficCapture.h"
+#include "Knobs.h"
+#include "fdbrpc/IAsyncFile.h"
+#include "flow/Platform.h"
+#include "flow/UnitTest.h"
+
+static void appendTrafficRecord( std::string& out, TrafficRecord const& r ) {
+	BinaryWriter wr( AssumeVersion(currentProtocolVersion) );
+	wr << r;
+	int32_t length = wr.getLength();
+	out.append( (const char*)&length, sizeof(length) );
+	out.append( (const char*)wr.getData(), length );
+}
+
+static std::string trafficCaptureHeader() {
+	BinaryWriter wr( IncludeVersion() );
+	return wr.toStringRef().toString();
+}
+
+ACTOR static Future<Void> writeTrafficCapture( TrafficCapture* self ) {
+	state Reference<IAsyncFile> file;
+	state int64_t offset = 0;
+	state std::string data;
+	try {
+		Reference<IAsyncFile> f = wait( IAsyncFileSystem::filesystem()->open( self->filename, IAsyncFile::OPEN_NO_AIO | IAsyncFile::OPEN_CREATE | IAsyncFile::OPEN_READWRITE, 0644 ) );
+		file = f;
+		Void _ = wait( file->truncate( 0 ) );
+		loop {
+			if( self->buffer.empty() ) {
+				if( self->stopped )
+					return Void();
+				Void _ = wait( self->flushNeeded.onTrigger() || delay( SERVER_KNOBS->TRAFFIC_CAPTURE_FLUSH_INTERVAL ) );
+				continue;
+			}
+			data.clear();
+			std::swap( data, self->buffer );
+			Void _ = wait( file->write( data.data(), data.size(), offset ) );
+			offset += data.size();
+		}
+	} catch( Error& e ) {
+		if( e.code() == error_code_actor_cancelled )
+			throw;
+		TraceEvent(SevWarnAlways, "TrafficCaptureError").error(e).detail("Filename", self->filename);
+		self->stopped = true;
+		self->buffer = std::string();
+	}
+	return Void();
+}
+
+Reference<TrafficCapture> TrafficCapture::open( std::string const& role, UID id ) {
+	if( SERVER_KNOBS->TRAFFIC_CAPTURE_DIRECTORY.empty() )
+		return Reference<TrafficCapture>();
+	platform::createDirectory( SERVER_KNOBS->TRAFFIC_CAPTURE_DIRECTORY );
+	std::string filename = joinPath( SERVER_KNOBS->TRAFFIC_CAPTURE_DIRECTORY, role + "." + id.toString() + ".capture" );
+	TraceEvent("TrafficCaptureStart", id).detail("Role", role).detail("Filename", filename);
+	return Reference<TrafficCapture>( new TrafficCapture( filename ) );
+}
+
+TrafficCapture::TrafficCapture( std::string const& filename ) : filename(filename), buffer(trafficCaptureHeader()), stopped(false) {
+	captured = buffer.size();
+	writer = writeTrafficCapture( this );
+}
+
+void TrafficCapture::append( TrafficRecord& r ) {
+	if( stopped )
+		return;
+	r.time = now();
+	int before = buffer.size();
+	appendTrafficRecord( buffer, r );
+	captured += buffer.size() - before;
+	if( captured > SERVER_KNOBS->TRAFFIC_CAPTURE_MAX_BYTES ) {
+		TraceEvent(SevWarnAlways, "TrafficCaptureFull").detail("Filename", filename).detail("Bytes", captured);
+		buffer.resize( before );
+		stopped = true;
+		flushNeeded.trigger();
+	} else if( buffer.size() >= SERVER_KNOBS->TRAFFIC_CAPTURE_FLUSH_BYTES && before < SERVER_KNOBS->TRAFFIC_CAPTURE_FLUSH_BYTES ) {
+		flushNeeded.trigger();
+	}
+}
+
+Standalone<VectorRef<TrafficRecord>> readTrafficCapture( Standalone<StringRef> const& contents ) {
+	Standalone<VectorRef<TrafficRecord>> records;
+	records.arena().dependsOn( contents.arena() );
+	if( contents.size() < sizeof(uint64_t) )
+		return records;
+
+	ArenaReader header( records.arena(), contents.substr( 0, sizeof(uint64_t) ), IncludeVersion() );
+	uint64_t version = header.protocolVersion();
+	int offset = sizeof(uint64_t);
+	int32_t length;
+	while( offset + sizeof(length) <= contents.size() ) {
+		memcpy( &length, contents.begin() + offset, sizeof(length) );
+		offset += sizeof(length);
+		if( length < 0 || length > contents.size() - offset )
+			break;
+		ArenaReader rd( records.arena(), contents.substr( offset, length ), AssumeVersion(version) );
+		TrafficRecord r;
+		rd >> r;
+		records.push_back( records.arena(), r );
+		offset += length;
+	}
+	return records;
+}
+
+TEST_CASE("fdbserver/TrafficCapture/read") {
+	Arena arena;
+	std::string contents = trafficCaptureHeader();
+
+	TrafficRecord commit;
+	commit.time = 1.5;
+	commit.type = TrafficRecord::COMMIT;
+	commit.commit.read_snapshot = 7;
+	commit.commit.mutations.push_back( arena, MutationRef( MutationRef::SetValue, LiteralStringRef("a"), LiteralStringRef("1") ) );
+	commit.commit.write_conflict_ranges.push_back( arena, singleKeyRange( LiteralStringRef("a"), arena ) );
+	appendTrafficRecord( contents, commit );
+
+	TrafficRecord get;
+	get.time = 2.5;
+	get.type = TrafficRecord::GET_VALUE;
+	get.key = LiteralStringRef("b");
+	appendTrafficRecord( contents, get );
+
+	TrafficRecord range;
+	range.time = 3.5;
+	range.type = TrafficRecord::GET_KEY_VALUES;
+	range.begin = firstGreaterOrEqual( LiteralStringRef("c") );
+	range.end = firstGreaterOrEqual( LiteralStringRef("d") );
+	range.limit = -10;
+	range.limitBytes = 1000;
+	appendTrafficRecord( contents, range );
+
+	Standalone<VectorRef<TrafficRecord>> records = readTrafficCapture( Standalone<StringRef>( StringRef( contents ) ) );
+	ASSERT( records.size() == 3 );
+	ASSERT( records[0].type == TrafficRecord::COMMIT && records[0].time == 1.5 && records[0].commit.read_snapshot == 7 );
+	ASSERT( records[0].commit.mutations.size() == 1 && records[0].commit.mutations[0].param2 == LiteralStringRef("1") );
+	ASSERT( records[0].commit.write_conflict_ranges.size() == 1 && records[0].commit.read_conflict_ranges.size() == 0 );
+	ASSERT( records[1].type == TrafficRecord::GET_VALUE && records[1].key == LiteralStringRef("b") );
+	ASSERT( records[2].type == TrafficRecord::GET_KEY_VALUES && records[2].begin == range.begin && records[2].end == range.end );
+	ASSERT( records[2].limit == -10 && records[2].limitBytes == 1000 );
+
+	// A record cut short is dropped
+	records = readTrafficCapture( Standalone<StringRef>( StringRef( contents ).substr( 0, contents.size() - 1 ) ) );
+	ASSERT( records.size() == 2 );
+
+	return Void();
+}
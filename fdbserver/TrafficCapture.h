@@ -0,0 +1,107 @@
+/*
+ * TrafficCapture.h
+ *
+ * This source file is part of the FoundationDB open source project
+ *
+ * Copyright 2013-2018 Apple Inc. and the FoundationDB project authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FDBSERVER_TRAFFICCAPTURE_H
+#define FDBSERVER_TRAFFICCAPTURE_H
+#pragma once
+
+#include "fdbclient/FDBTypes.h"
+#include "fdbclient/CommitTransaction.h"
+#include "flow/genericactors.actor.h"
+
+// One request received by a proxy or a storage server, as written to a capture file and read back by the TrafficReplay
+// workload.  Only what is needed to issue the request again is kept: the read version, debug ID and reply endpoint of
+// the original are not.
+struct TrafficRecord {
+	enum Type : uint8_t { COMMIT = 1, GET_VALUE = 2, GET_KEY_VALUES = 3 };
+
+	double time;  // now() on the process that received the request
+	uint8_t type;
+	CommitTransactionRef commit;  // COMMIT
+	KeyRef key;  // GET_VALUE
+	KeySelectorRef begin, end;  // GET_KEY_VALUES
+	int limit, limitBytes;  // GET_KEY_VALUES; a negative limit reads the range in reverse
+
+	TrafficRecord() : time(0), type(0), limit(0), limitBytes(0) {}
+
+	template <class Ar>
+	void serialize( Ar& ar ) {
+		ar & time & type;
+		if( type == COMMIT )
+			ar & commit;
+		else if( type == GET_VALUE )
+			ar & key;
+		else if( type == GET_KEY_VALUES )
+			ar & begin & end & limit & limitBytes;
+	}
+};
+
+// Writes the requests a role receives to <TRAFFIC_CAPTURE_DIRECTORY>/<role>.<id>.capture.  A capture file is the
+// protocol version followed by length prefixed TrafficRecords.  Records are buffered in memory and appended to the file
+// every TRAFFIC_CAPTURE_FLUSH_INTERVAL seconds, or sooner once TRAFFIC_CAPTURE_FLUSH_BYTES of them are waiting, so the
+// last buffer is lost if the role stops.  Capture stops for good once TRAFFIC_CAPTURE_MAX_BYTES have been captured or
+// a write fails.
+struct TrafficCapture : ReferenceCounted<TrafficCapture>, NonCopyable {
+	// Returns an invalid reference unless TRAFFIC_CAPTURE_DIRECTORY is set
+	static Reference<TrafficCapture> open( std::string const& role, UID id );
+
+	void commit( CommitTransactionRef const& tr ) {
+		TrafficRecord r;
+		r.type = TrafficRecord::COMMIT;
+		r.commit = tr;
+		append( r );
+	}
+
+	void getValue( KeyRef const& key ) {
+		TrafficRecord r;
+		r.type = TrafficRecord::GET_VALUE;
+		r.key = key;
+		append( r );
+	}
+
+	void getKeyValues( KeySelectorRef const& begin, KeySelectorRef const& end, int limit, int limitBytes ) {
+		TrafficRecord r;
+		r.type = TrafficRecord::GET_KEY_VALUES;
+		r.begin = begin;
+		r.end = end;
+		r.limit = limit;
+		r.limitBytes = limitBytes;
+		append( r );
+	}
+
+	explicit TrafficCapture( std::string const& filename );
+
+	std::string filename;
+	std::string buffer;  // Records not yet handed to the writer
+	int64_t captured;  // Bytes of the file so far, including buffer
+	bool stopped;
+	AsyncTrigger flushNeeded;
+	Future<Void> writer;
+
+private:
+	void append( TrafficRecord& r );
+};
+
+// Returns the records of a capture file, which point into its contents.  A truncated last record, as left by a process
+// that died while writing it, is ignored.  Throws incompatible_protocol_version if the file was written by a version
+// that this one cannot read.
+Standalone<VectorRef<TrafficRecord>> readTrafficCapture( Standalone<StringRef> const& contents );
+
+#endif
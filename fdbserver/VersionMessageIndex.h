@@ -0,0 +1,196 @@
+/*
+ * VersionMessageIndex.h
+ *
+ * This source file is part of the FoundationDB open source project
+ *
+ * Copyright 2013-2018 Apple Inc. and the FoundationDB project authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FDBSERVER_VERSIONMESSAGEINDEX_H
+#define FDBSERVER_VERSIONMESSAGEINDEX_H
+#pragma once
+
+#include "LogSystem.h"
+#include "flow/Deque.h"
+#include "flow/FastAlloc.h"
+
+// The (version, message) pairs a TLog holds in memory for one tag, in nondecreasing version order, with the messages
+// themselves living in the TLog's message blocks.  Entries are packed into fixed size segments, each of which stores its
+// versions as 32 bit deltas from the first and its messages as 32 bit offsets from the first, so an entry costs 8 bytes
+// rather than the 16 of a std::pair<Version, LengthPrefixedStringRef> (plus the allocator's slack).  A segment is ended
+// early when an entry does not fit its deltas, e.g. one in a message block allocated below the segment's first.
+// bytes() is exactly the heap memory used, so the TLog can account for it without a fudge factor.
+// Like std::deque, push_back() and pop_front() invalidate iterators.
+class VersionMessageIndex : NonCopyable {
+	struct Segment : FastAllocated<Segment> {
+		enum { CAPACITY = 60 };
+
+		Version firstVersion;
+		uint8_t* base;
+		uint16_t begin, end;  // The live entries are [begin, end)
+		uint32_t versionDelta[CAPACITY];
+		uint32_t offset[CAPACITY];
+
+		Segment( Version firstVersion, uint8_t* base ) : firstVersion(firstVersion), base(base), begin(0), end(0) {}
+
+		Version version( int i ) const { return firstVersion + versionDelta[i]; }
+		LengthPrefixedStringRef message( int i ) const { return LengthPrefixedStringRef( (uint32_t*)(base + offset[i]) ); }
+
+		bool canAppend( Version v, uint8_t const* p ) const {
+			return end < CAPACITY && p >= base && uint64_t(p - base) <= std::numeric_limits<uint32_t>::max() &&
+				uint64_t(v - firstVersion) <= std::numeric_limits<uint32_t>::max();
+		}
+	};
+
+	enum { SEGMENT_BYTES = 512 };  // What FastAllocated<Segment> takes for each
+	static_assert( sizeof(Segment) <= SEGMENT_BYTES, "VersionMessageIndex::Segment does not fit its allocation" );
+
+public:
+	typedef std::pair<Version, LengthPrefixedStringRef> value_type;
+
+	class iterator {
+	public:
+		struct pointer {
+			value_type value;
+			value_type const* operator->() const { return &value; }
+		};
+
+		iterator() : index(NULL), segment(0), entry(0) {}
+
+		value_type operator*() const {
+			Segment const* s = index->segments[segment];
+			return value_type( s->version(entry), s->message(entry) );
+		}
+		pointer operator->() const {
+			pointer p = { **this };
+			return p;
+		}
+
+		iterator& operator++() {
+			if( ++entry == index->segments[segment]->end ) {
+				++segment;
+				entry = segment < index->segments.size() ? index->segments[segment]->begin : 0;
+			}
+			return *this;
+		}
+
+		bool operator==( iterator const& r ) const { return segment == r.segment && entry == r.entry; }
+		bool operator!=( iterator const& r ) const { return !(*this == r); }
+
+	private:
+		friend class VersionMessageIndex;
+		iterator( VersionMessageIndex const* index, int segment, int entry ) : index(index), segment(segment), entry(entry) {}
+
+		VersionMessageIndex const* index;
+		int segment;
+		int entry;
+	};
+
+	VersionMessageIndex() : count(0) {}
+	VersionMessageIndex( VersionMessageIndex&& r ) noexcept(true) : segments(std::move(r.segments)), count(r.count) { r.count = 0; }
+	void operator=( VersionMessageIndex&& r ) noexcept(true) {
+		clear();
+		segments = std::move(r.segments);
+		count = r.count;
+		r.count = 0;
+	}
+	~VersionMessageIndex() { clear(); }
+
+	bool empty() const { return !count; }
+	size_t size() const { return count; }
+
+	value_type front() const { return *begin(); }
+	value_type back() const {
+		Segment const* s = segments.back();
+		return value_type( s->version(s->end-1), s->message(s->end-1) );
+	}
+
+	// version must be at least that of back()
+	void push_back( Version version, LengthPrefixedStringRef message ) {
+		uint8_t* p = (uint8_t*)message.getLengthPtr();
+		if( segments.empty() || !segments.back()->canAppend( version, p ) )
+			segments.push_back( new Segment( version, p ) );
+		Segment* s = segments.back();
+		s->versionDelta[s->end] = version - s->firstVersion;
+		s->offset[s->end] = p - s->base;
+		s->end++;
+		count++;
+	}
+
+	void pop_front() {
+		ASSERT( count );
+		Segment* s = segments.front();
+		if( ++s->begin == s->end ) {
+			delete s;
+			segments.pop_front();
+		}
+		count--;
+	}
+
+	iterator begin() const { return segments.empty() ? end() : iterator( this, 0, segments.front()->begin ); }
+	iterator end() const { return iterator( this, segments.size(), 0 ); }
+
+	// The first entry with a version >= v
+	iterator lower_bound( Version v ) const { return bound( v, false ); }
+	// The first entry with a version > v
+	iterator upper_bound( Version v ) const { return bound( v, true ); }
+
+	// Heap memory used by the index, not counting the messages
+	int64_t bytes() const {
+		return int64_t(segments.size()) * SEGMENT_BYTES + int64_t(segments.capacity()) * sizeof(Segment*);
+	}
+
+private:
+	Deque<Segment*> segments;
+	size_t count;
+
+	static bool before( Version entryVersion, Version v, bool orEqual ) { return orEqual ? entryVersion <= v : entryVersion < v; }
+
+	iterator bound( Version v, bool orEqual ) const {
+		// The first segment whose last entry is not before v holds the bound; segments are never empty
+		int lo = 0, hi = segments.size();
+		while( lo < hi ) {
+			int mid = lo + (hi - lo) / 2;
+			Segment const* s = segments[mid];
+			if( before( s->version(s->end-1), v, orEqual ) )
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		if( lo == segments.size() )
+			return end();
+
+		Segment const* s = segments[lo];
+		int first = s->begin, last = s->end-1;
+		while( first < last ) {
+			int mid = first + (last - first) / 2;
+			if( before( s->version(mid), v, orEqual ) )
+				first = mid + 1;
+			else
+				last = mid;
+		}
+		return iterator( this, lo, first );
+	}
+
+	void clear() {
+		while( !segments.empty() ) {
+			delete segments.front();
+			segments.pop_front();
+		}
+		count = 0;
+	}
+};
+
+#endif
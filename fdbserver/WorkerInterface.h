@@ -116,11 +116,18 @@ struct InitializeMasterProxyRequest {
 	uint64_t recoveryCount;
 	Version recoveryTransactionVersion;
 	bool firstProxy;
+	int txsSnapshotSpeedup;  // Must be the same for every proxy, since they all log the same txnStateStore snapshot
+	bool grvOnly;  // Recruits a GRV proxy, which only answers GetReadVersionRequests
 	ReplyPromise<MasterProxyInterface> reply;
 
+	InitializeMasterProxyRequest() : txsSnapshotSpeedup(1), grvOnly(false) {}
+
 	template <class Ar>
 	void serialize(Ar& ar) {
 		ar & master & recoveryCount & recoveryTransactionVersion & firstProxy & reply;
+		if( ar.protocolVersion() >= 0x0FDB00A560060001LL ) {
+			ar & txsSnapshotSpeedup & grvOnly;
+		}
 	}
 };
 
@@ -54,6 +54,7 @@
 #include "fdbrpc/TLSConnection.h"
 #include "fdbrpc/Net2FileSystem.h"
 #include "fdbrpc/Platform.h"
+#include "fdbrpc/TraceBlockCodec.h"
 #include "CoroFlow.h"
 #include "flow/SignalSafeUnwind.h"
 
@@ -76,7 +77,7 @@
 
 enum {
 	OPT_CONNFILE, OPT_SEEDCONNFILE, OPT_SEEDCONNSTRING, OPT_ROLE, OPT_LISTEN, OPT_PUBLICADDR, OPT_DATAFOLDER, OPT_LOGFOLDER, OPT_PARENTPID, OPT_NEWCONSOLE, OPT_NOBOX, OPT_TESTFILE, OPT_RESTARTING, OPT_RANDOMSEED, OPT_KEY, OPT_MEMLIMIT, OPT_STORAGEMEMLIMIT, OPT_MACHINEID, OPT_DCID, OPT_MACHINE_CLASS, OPT_BUGGIFY, OPT_VERSION, OPT_CRASHONERROR, OPT_HELP, OPT_NETWORKIMPL, OPT_NOBUFSTDOUT, OPT_BUFSTDOUTERR, OPT_TRACECLOCK, OPT_NUMTESTERS, OPT_DEVHELP, OPT_ROLLSIZE, OPT_MAXLOGS, OPT_MAXLOGSSIZE, OPT_KNOB, OPT_TESTSERVERS, OPT_TEST_ON_SERVERS, OPT_METRICSCONNFILE, OPT_METRICSPREFIX,
-	OPT_LOGGROUP, OPT_LOCALITY, OPT_IO_TRUST_SECONDS, OPT_IO_TRUST_WARN_ONLY, OPT_FILESYSTEM, OPT_KVFILE };
+	OPT_LOGGROUP, OPT_LOCALITY, OPT_IO_TRUST_SECONDS, OPT_IO_TRUST_WARN_ONLY, OPT_FILESYSTEM, OPT_KVFILE, OPT_TRACEFILE, OPT_NUMANODE, OPT_STANDBYFD };
 
 CSimpleOpt::SOption g_rgOptions[] = {
 	{ OPT_CONNFILE,             "-C",                          SO_REQ_SEP },
@@ -91,6 +92,10 @@ CSimpleOpt::SOption g_rgOptions[] = {
 	{ OPT_LISTEN,               "--listen_address",            SO_REQ_SEP },
 #ifdef __linux__
 	{ OPT_FILESYSTEM,           "--data_filesystem",           SO_REQ_SEP },
+	{ OPT_NUMANODE,             "--numa_node",                 SO_REQ_SEP },
+#endif
+#ifndef _WIN32
+	{ OPT_STANDBYFD,            "--standby_fd",                SO_REQ_SEP },
 #endif
 	{ OPT_DATAFOLDER,           "-d",                          SO_REQ_SEP },
 	{ OPT_DATAFOLDER,           "--datadir",                   SO_REQ_SEP },
@@ -109,6 +114,7 @@ CSimpleOpt::SOption g_rgOptions[] = {
 	{ OPT_NOBOX,                "--no_dialog",                 SO_NONE },
 #endif
 	{ OPT_KVFILE,               "--kvfile",                    SO_REQ_SEP },
+	{ OPT_TRACEFILE,            "--tracefile",                 SO_REQ_SEP },
 	{ OPT_TESTFILE,             "-f",                          SO_REQ_SEP },
 	{ OPT_TESTFILE,             "--testfile",                  SO_REQ_SEP },
 	{ OPT_RESTARTING,           "-R",                          SO_NONE },
@@ -169,7 +175,6 @@ extern uint32_t determinePublicIPAutomatically( ClusterConnectionString const& c
 extern const char* getHGVersion();
 
 extern IRandom* trace_random;
-extern void flushTraceFileVoid();
 
 extern bool noUnseed;
 extern const int MAX_CLUSTER_FILE_BYTES;
@@ -549,6 +554,9 @@ void skipListTest();
 Future<Void> startSystemMonitor(std::string dataFolder, Optional<Standalone<StringRef>> zoneId, Optional<Standalone<StringRef>> machineId) {
 	initializeSystemMonitorMachineState(SystemMonitorMachineState(dataFolder, zoneId, machineId, g_network->getLocalAddress().ip));
 
+	if (FLOW_KNOBS->FASTALLOC_RECLAIM_INTERVAL > 0 && !g_network->isSimulated())
+		startFastAllocatorReclamation( FLOW_KNOBS->FASTALLOC_RECLAIM_INTERVAL );
+
 	systemMonitor();
 	return recurring( &systemMonitor, 5.0, TaskFlushTrace );
 }
@@ -605,6 +613,15 @@ static void printUsage( const char *name, bool devhelp ) {
 		   "                 mounted at the specified PATH. This checks that the device at PATH\n"
 		   "                 is currently mounted and that any data files get written to the\n"
 		   "                 same device.\n");
+	printf("  --numa_node NODE\n"
+		   "                 Run this process's threads on the CPUs of NUMA node NODE and\n"
+		   "                 allocate its memory from that node where possible.\n");
+#endif
+#ifndef _WIN32
+	printf("  --standby_fd FD\n"
+		   "                 Start as a standby: initialize, then wait until a byte can be\n"
+		   "                 read from descriptor FD before listening. Exits if FD is closed\n"
+		   "                 first. Set by fdbmonitor for sections with `standby = true'.\n");
 #endif
 	printf("  -d PATH, --datadir PATH\n"
 		   "                 Store data files in the given folder (must be unique for each\n");
@@ -634,7 +651,8 @@ static void printUsage( const char *name, bool devhelp ) {
 		printf("  -r ROLE, --role ROLE\n"
 			   "                 Server role (valid options are fdbd, test, multitest,\n");
 		printf("                 simulation, networktestclient, networktestserver,\n");
-		printf("                 consistencycheck, kvfileintegritycheck, kvfilegeneratesums). The default is `fdbd'.\n");
+		printf("                 consistencycheck, kvfileintegritycheck, kvfilegeneratesums,\n");
+		printf("                 tracetoxml). The default is `fdbd'.\n");
 #ifdef _WIN32
 		printf("  -n, --newconsole\n"
 			   "                 Create a new console.\n");
@@ -654,6 +672,8 @@ static void printUsage( const char *name, bool devhelp ) {
 			   "                 Memory limit. The default value is 8GiB. When specified\n"
 			   "                 without a unit, MiB is assumed.\n");
 		printf("  --kvfile FILE  Input file (SQLite database file) for use by the 'kvfilegeneratesums' and 'kvfileintegritycheck' roles.\n");
+		printf("  --tracefile FILE\n"
+			   "                 Binary trace file to convert to XML with the 'tracetoxml' role.\n");
 		printf("  -M SIZE, --storage_memory SIZE\n"
 			   "                 Maximum amount of memory used for storage. The default\n"
 			   "                 value is 1GiB. When specified without a unit, MB is\n"
@@ -836,7 +856,8 @@ int main(int argc, char* argv[]) {
 			NetworkTestServer,
 			KVFileIntegrityCheck,
 			KVFileGenerateIOLogChecksums,
-			ConsistencyCheck
+			ConsistencyCheck,
+			TraceToXml
 		};
 		std::string fileSystemPath = "", dataFolder, connFile = "", seedConnFile = "", seedConnString = "", logFolder = ".", metricsConnFile = "", metricsPrefix = "";
 		std::string logGroup = "default";
@@ -845,12 +866,15 @@ int main(int argc, char* argv[]) {
 
 		const char *testFile = "tests/default.txt";
 		std::string kvFile;
+		std::string traceFile;
 		std::string publicAddressStr, listenAddressStr = "public";
 		std::string testServersStr;
 		NetworkAddress publicAddress, listenAddress;
 		const char *targetKey = NULL;
 		uint64_t memLimit = 8LL << 30;
 		uint64_t storageMemLimit = 1LL << 30;
+		int numaNode = -1;
+		int standbyFd = -1;
 		bool buggifyEnabled = false, machineIdOverride = false, restarting = false;
 		Optional<Standalone<StringRef>> zoneId;
 		Optional<Standalone<StringRef>> dcId;
@@ -969,6 +993,7 @@ int main(int argc, char* argv[]) {
 					else if (!strcmp(sRole, "kvfileintegritycheck")) role = KVFileIntegrityCheck;
 					else if (!strcmp(sRole, "kvfilegeneratesums")) role = KVFileGenerateIOLogChecksums;
 					else if (!strcmp(sRole, "consistencycheck")) role = ConsistencyCheck;
+					else if (!strcmp(sRole, "tracetoxml")) role = TraceToXml;
 					else {
 						fprintf(stderr, "ERROR: Unknown role `%s'\n", sRole);
 						printHelpTeaser(argv[0]);
@@ -994,10 +1019,32 @@ int main(int argc, char* argv[]) {
 					seedConnString = args.OptionArg();
 					break;
 	#ifdef __linux__
+				case OPT_NUMANODE: {
+					char* end;
+					numaNode = strtol(args.OptionArg(), &end, 10);
+					if (*end || numaNode < 0) {
+						fprintf(stderr, "ERROR: Could not parse NUMA node from `%s'\n", args.OptionArg());
+						printHelpTeaser(argv[0]);
+						flushAndExit(FDB_EXIT_ERROR);
+					}
+					break;
+				}
 				case OPT_FILESYSTEM: {
 					fileSystemPath = args.OptionArg();
 					break;
 				}
+	#endif
+	#ifndef _WIN32
+				case OPT_STANDBYFD: {
+					char* end;
+					standbyFd = strtol(args.OptionArg(), &end, 10);
+					if (*end || standbyFd < 0) {
+						fprintf(stderr, "ERROR: Could not parse standby descriptor from `%s'\n", args.OptionArg());
+						printHelpTeaser(argv[0]);
+						flushAndExit(FDB_EXIT_ERROR);
+					}
+					break;
+				}
 	#endif
 				case OPT_DATAFOLDER:
 					dataFolder = args.OptionArg();
@@ -1101,6 +1148,9 @@ int main(int argc, char* argv[]) {
 				case OPT_KVFILE:
 					kvFile = args.OptionArg();
 					break;
+				case OPT_TRACEFILE:
+					traceFile = args.OptionArg();
+					break;
 				case OPT_RESTARTING:
 					restarting = true;
 					break;
@@ -1234,7 +1284,7 @@ int main(int argc, char* argv[]) {
 		bool autoPublicAddress = StringRef(publicAddressStr).startsWith(LiteralStringRef("auto:"));
 
 		Reference<ClusterConnectionFile> connectionFile;
-		if ( (role != Simulation && role != CreateTemplateDatabase && role != KVFileIntegrityCheck && role != KVFileGenerateIOLogChecksums) || autoPublicAddress ) {
+		if ( (role != Simulation && role != CreateTemplateDatabase && role != KVFileIntegrityCheck && role != KVFileGenerateIOLogChecksums && role != TraceToXml) || autoPublicAddress ) {
 
 				if (seedSpecified && !fileExists(connFile)){
 					std::string connectionString = seedConnString.length() ? seedConnString : "";
@@ -1428,6 +1478,25 @@ int main(int argc, char* argv[]) {
 			flushAndExit(FDB_EXIT_ERROR);
 		}
 
+		setTraceBlockCodec( zlibTraceBlockCodec() );
+
+		if (role == TraceToXml) {
+			if (!traceFile.size()) {
+				fprintf(stderr, "ERROR: please specify --tracefile\n");
+				printHelpTeaser(argv[0]);
+				flushAndExit(FDB_EXIT_ERROR);
+			}
+			std::string xmlFile = StringRef(traceFile).endsWith(LiteralStringRef(".bin")) ? traceFile.substr(0, traceFile.size() - 4) + ".xml" : traceFile + ".xml";
+			try {
+				writeFile( xmlFile, binaryTraceToXml( readFileBytes( traceFile, std::numeric_limits<int>::max() ) ) );
+			} catch (Error& e) {
+				fprintf(stderr, "ERROR: could not convert `%s' to `%s' (%s)\n", traceFile.c_str(), xmlFile.c_str(), e.what());
+				flushAndExit(FDB_EXIT_ERROR);
+			}
+			printf("Wrote `%s'\n", xmlFile.c_str());
+			flushAndExit(FDB_EXIT_SUCCESS);
+		}
+
 		Future<Void> listenError;
 
 		// Interpret legacy "maxLogs" option in the most sensible and unsurprising way we can while eliminating its code path
@@ -1449,6 +1518,12 @@ int main(int argc, char* argv[]) {
 			}
 		}
 
+		// Before the trace and network threads are started, so that they inherit the node
+		if (numaNode >= 0 && !setNumaNode(numaNode)) {
+			fprintf(stderr, "ERROR: Could not run on NUMA node %d\n", numaNode);
+			flushAndExit(FDB_EXIT_ERROR);
+		}
+
 		// Initialize the thread pool
 		CoroThreadPool::init();
 		// Ordinarily, this is done when the network is run. However, network thread should be set before TraceEvents are logged. This thread will eventually run the network, so call it now.
@@ -1474,6 +1549,23 @@ int main(int argc, char* argv[]) {
 			if (tlsOptions->get_policy())
 				tlsOptions->register_network();
 
+#ifndef _WIN32
+			// A standby has done everything that does not need the address or the data folder, and waits for the
+			// process it replaces to exit and give them up
+			if (standbyFd >= 0) {
+				TraceEvent("StandbyWaiting").detail("Fd", standbyFd);
+				char c;
+				ssize_t n;
+				while ((n = read(standbyFd, &c, 1)) < 0 && errno == EINTR) {}
+				close(standbyFd);
+				if (n != 1) {
+					TraceEvent("StandbyReleased").detail("Result", n);
+					flushAndExit(FDB_EXIT_SUCCESS);
+				}
+				TraceEvent("StandbyPromoted");
+			}
+#endif
+
 			if (role == FDBD || role == NetworkTestServer) {
 				try {
 					listenError = FlowTransport::transport().bind(publicAddress, listenAddress);
@@ -1518,6 +1610,7 @@ int main(int argc, char* argv[]) {
 			.detail("CommandLine", commandLine)
 			.detail("BuggifyEnabled", buggifyEnabled)
 			.detail("MemoryLimit", memLimit)
+			.detail("NumaNode", numaNode)
 			.trackLatest("ProgramStart");
 
 		// Test for TraceEvent length limits
@@ -44,6 +44,7 @@
 #include "IKeyValueStore.h"
 #include "ApplyMetadataMutation.h"
 #include "RecoveryState.h"
+#include "flow/Stats.h"
 
 using std::vector;
 using std::min;
@@ -195,6 +196,7 @@ struct MasterData : NonCopyable, ReferenceCounted<MasterData> {
 	}
 
 	vector< MasterProxyInterface > proxies;
+	vector< MasterProxyInterface > grvProxies;
 	vector< MasterProxyInterface > provisionalProxies;
 	vector< ResolverInterface > resolvers;
 
@@ -219,6 +221,34 @@ struct MasterData : NonCopyable, ReferenceCounted<MasterData> {
 
 	PromiseStream<Future<Void>> addActor;
 
+	CounterCollection cc;
+	Counter getCommitVersionRequests;
+	Counter getCommitVersionQueued;  // Requests that arrived before the proxy's previous one was answered
+	LatencySample getCommitVersionQueueLatency;  // How long those waited for it
+	Future<Void> logger;
+
+	double recoveryStartTime;
+	int recoveryStatus;  // The RecoveryStatus last reported in a MasterRecoveryState event, or -1
+	double recoveryStatusStart;
+	std::vector<std::pair<int, double>> recoveryStatusDurations;  // The seconds spent in each status reported before it, in order
+
+	// Records that recovery has reached the given status, and returns the seconds it spent in the previous one
+	double nextRecoveryStatus( int status ) {
+		double duration = recoveryStatus >= 0 ? now() - recoveryStatusStart : 0;
+		if(recoveryStatus >= 0)
+			recoveryStatusDurations.push_back( std::make_pair(recoveryStatus, duration) );
+		recoveryStatus = status;
+		recoveryStatusStart = now();
+		return duration;
+	}
+
+	std::string describeRecoveryStatusDurations() const {
+		std::string s;
+		for(auto& d : recoveryStatusDurations)
+			s += format("%s%s=%.6f", s.size() ? " " : "", RecoveryStatus::names[d.first], d.second);
+		return s;
+	}
+
 	MasterData(
 		Reference<AsyncVar<ServerDBInfo>> const& dbInfo,
 		MasterInterface const& myInterface,
@@ -246,8 +276,17 @@ struct MasterData : NonCopyable, ReferenceCounted<MasterData> {
 		  memoryLimit(2e9),
 		  cstateUpdated(false),
 		  addActor(addActor),
-		  hasConfiguration(false)
+		  hasConfiguration(false),
+		  cc("Master", dbgid.toString()),
+		  getCommitVersionRequests("getCommitVersionRequests", cc),
+		  getCommitVersionQueued("getCommitVersionQueued", cc),
+		  getCommitVersionQueueLatency("GetCommitVersionQueueLatency", cc),
+		  recoveryStartTime(now()),
+		  recoveryStatus(-1),
+		  recoveryStatusStart(0)
 	{
+		specialCounter(cc, "version", [this](){ return this->version; });
+		specialCounter(cc, "proxies", [this](){ return int64_t(this->proxies.size()); });
 	}
 	~MasterData() { if(txnStateStore) txnStateStore->close(); }
 };
@@ -260,6 +299,7 @@ ACTOR Future<Void> newProxies( Reference<MasterData> self, RecruitFromConfigurat
 		req.recoveryCount = self->cstate.myDBState.recoveryCount + 1;
 		req.recoveryTransactionVersion = self->recoveryTransactionVersion;
 		req.firstProxy = i == 0;
+		req.txsSnapshotSpeedup = SERVER_KNOBS->TXS_SNAPSHOT_SPEEDUP;
 		TraceEvent("ProxyReplies",self->dbgid).detail("workerID", recr.proxies[i].id());
 		initializationReplies.push_back( transformErrors( throwErrorOr( recr.proxies[i].masterProxy.getReplyUnlessFailedFor( req, SERVER_KNOBS->TLOG_TIMEOUT, SERVER_KNOBS->MASTER_FAILURE_SLOPE_DURING_RECOVERY ) ), master_recovery_failed() ) );
 	}
@@ -271,6 +311,25 @@ ACTOR Future<Void> newProxies( Reference<MasterData> self, RecruitFromConfigurat
 	return Void();
 }
 
+ACTOR Future<Void> newGrvProxies( Reference<MasterData> self, RecruitFromConfigurationReply recr ) {
+	vector<Future<MasterProxyInterface>> initializationReplies;
+	for( int i = 0; i < recr.grvProxies.size(); i++ ) {
+		InitializeMasterProxyRequest req;
+		req.master = self->myInterface;
+		req.recoveryCount = self->cstate.myDBState.recoveryCount + 1;
+		req.recoveryTransactionVersion = self->recoveryTransactionVersion;
+		req.firstProxy = false;
+		req.grvOnly = true;
+		TraceEvent("GrvProxyReplies",self->dbgid).detail("workerID", recr.grvProxies[i].id());
+		initializationReplies.push_back( transformErrors( throwErrorOr( recr.grvProxies[i].masterProxy.getReplyUnlessFailedFor( req, SERVER_KNOBS->TLOG_TIMEOUT, SERVER_KNOBS->MASTER_FAILURE_SLOPE_DURING_RECOVERY ) ), master_recovery_failed() ) );
+	}
+
+	vector<MasterProxyInterface> newRecruits = wait( getAll( initializationReplies ) );
+	self->grvProxies = newRecruits;
+
+	return Void();
+}
+
 ACTOR Future<Void> newResolvers( Reference<MasterData> self, RecruitFromConfigurationReply recr ) {
 	vector<Future<ResolverInterface>> initializationReplies;
 	for( int i = 0; i < recr.resolvers.size(); i++ ) {
@@ -429,13 +488,14 @@ ACTOR Future<Void> updateLogsValue( Reference<MasterData> self, Database cx ) {
 	}
 }
 
-Future<Void> sendMasterRegistration( MasterData* self, LogSystemConfig const& logSystemConfig, vector<MasterProxyInterface> proxies, vector<ResolverInterface> resolvers, DBRecoveryCount recoveryCount, vector<UID> priorCommittedLogServers ) {
+Future<Void> sendMasterRegistration( MasterData* self, LogSystemConfig const& logSystemConfig, vector<MasterProxyInterface> proxies, vector<MasterProxyInterface> grvProxies, vector<ResolverInterface> resolvers, DBRecoveryCount recoveryCount, vector<UID> priorCommittedLogServers ) {
 	RegisterMasterRequest masterReq;
 	masterReq.dbName = self->dbName;
 	masterReq.id = self->myInterface.id();
 	masterReq.mi = self->myInterface.locality;
 	masterReq.logSystemConfig = logSystemConfig;
 	masterReq.proxies = proxies;
+	masterReq.grvProxies = grvProxies;
 	masterReq.resolvers = resolvers;
 	masterReq.recoveryCount = recoveryCount;
 	if(self->hasConfiguration) masterReq.configuration = self->configuration;
@@ -459,10 +519,10 @@ ACTOR Future<Void> updateRegistration( Reference<MasterData> self, Reference<ILo
 		TraceEvent("MasterUpdateRegistration", self->dbgid).detail("RecoveryCount", self->cstate.myDBState.recoveryCount).detail("logs", describe(logSystem->getLogSystemConfig().tLogs));
 
 		if (!self->cstateUpdated.get()) {
-			Void _ = wait(sendMasterRegistration(self.getPtr(), logSystem->getLogSystemConfig(), self->provisionalProxies, self->resolvers, self->cstate.myDBState.recoveryCount, self->cstate.prevDBState.getPriorCommittedLogServers() ));
+			Void _ = wait(sendMasterRegistration(self.getPtr(), logSystem->getLogSystemConfig(), self->provisionalProxies, vector<MasterProxyInterface>(), self->resolvers, self->cstate.myDBState.recoveryCount, self->cstate.prevDBState.getPriorCommittedLogServers() ));
 		} else {
 			updateLogsKey = updateLogsValue(self, cx);
-			Void _ = wait( sendMasterRegistration( self.getPtr(), logSystem->getLogSystemConfig(), self->proxies, self->resolvers, self->cstate.myDBState.recoveryCount, vector<UID>() ) );
+			Void _ = wait( sendMasterRegistration( self.getPtr(), logSystem->getLogSystemConfig(), self->proxies, self->grvProxies, self->resolvers, self->cstate.myDBState.recoveryCount, vector<UID>() ) );
 		}
 	}
 }
@@ -531,12 +591,14 @@ ACTOR Future<Void> recruitEverything( Reference<MasterData> self, vector<Storage
 		TraceEvent("MasterRecoveryState", self->dbgid)
 			.detail("StatusCode", status)
 			.detail("Status", RecoveryStatus::names[status])
+			.detail("PrevStatusDuration", self->nextRecoveryStatus(status))
 			.trackLatest("MasterRecoveryState");
 		return Never();
 	} else
 		TraceEvent("MasterRecoveryState", self->dbgid)
 			.detail("StatusCode", RecoveryStatus::recruiting_transaction_servers)
 			.detail("Status", RecoveryStatus::names[RecoveryStatus::recruiting_transaction_servers])
+			.detail("PrevStatusDuration", self->nextRecoveryStatus(RecoveryStatus::recruiting_transaction_servers))
 			.detail("RequiredTLogs", self->configuration.tLogReplicationFactor)
 			.detail("DesiredTLogs", self->configuration.getDesiredLogs())
 			.detail("RequiredProxies", 1)
@@ -562,7 +624,9 @@ ACTOR Future<Void> recruitEverything( Reference<MasterData> self, vector<Storage
 	TraceEvent("MasterRecoveryState", self->dbgid)
 		.detail("StatusCode", RecoveryStatus::initializing_transaction_servers)
 		.detail("Status", RecoveryStatus::names[RecoveryStatus::initializing_transaction_servers])
+		.detail("PrevStatusDuration", self->nextRecoveryStatus(RecoveryStatus::initializing_transaction_servers))
 		.detail("Proxies", recruits.proxies.size())
+		.detail("GrvProxies", recruits.grvProxies.size())
 		.detail("TLogs", recruits.tLogs.size())
 		.detail("Resolvers", recruits.resolvers.size())
 		.trackLatest("MasterRecoveryState");
@@ -570,7 +634,7 @@ ACTOR Future<Void> recruitEverything( Reference<MasterData> self, vector<Storage
 	// Actually, newSeedServers does both the recruiting and initialization of the seed servers; so if this is a brand new database we are sort of lying that we are
 	// past the recruitment phase.  In a perfect world we would split that up so that the recruitment part happens above (in parallel with recruiting the transaction servers?).
 	Void _ = wait( newSeedServers( self, recruits, seedServers ) );
-	Void _ = wait( newProxies( self, recruits ) && newResolvers( self, recruits ) && newTLogServers( self, recruits, oldLogSystem, initialConfChanges ) );
+	Void _ = wait( newProxies( self, recruits ) && newGrvProxies( self, recruits ) && newResolvers( self, recruits ) && newTLogServers( self, recruits, oldLogSystem, initialConfChanges ) );
 	return Void();
 }
 
@@ -702,17 +766,21 @@ ACTOR Future<Void> discardCommit(IKeyValueStore* store, LogSystemDiskQueueAdapte
 	return Void();
 }
 
-ACTOR Future<Void> recoverFrom( Reference<MasterData> self, Reference<ILogSystem> oldLogSystem, vector<StorageServerInterface>* seedServers, vector<Standalone<CommitTransactionRef>>* initialConfChanges ) {
+ACTOR Future<Void> recoverFrom( Reference<MasterData> self, Reference<ILogSystem> oldLogSystem, vector<StorageServerInterface>* seedServers, vector<Standalone<CommitTransactionRef>>* initialConfChanges, Future<Void> cstateLocked ) {
 	TraceEvent("MasterRecoveryState", self->dbgid)
 		.detail("StatusCode", RecoveryStatus::reading_transaction_system_state)
 		.detail("Status", RecoveryStatus::names[RecoveryStatus::reading_transaction_system_state])
+		.detail("PrevStatusDuration", self->nextRecoveryStatus(RecoveryStatus::reading_transaction_system_state))
 		.trackLatest("MasterRecoveryState");
 	self->hasConfiguration = false;
 
 	if(BUGGIFY)
 		Void _ = wait( delay(10.0) );
 
+	// Reading the transaction state only peeks the old TLogs, so it overlaps writing our generation to the coordinated state,
+	// but nothing may be recruited for the new generation until that write succeeds
 	Void _ = wait( readTransactionSystemState( self, oldLogSystem ) );
+	Void _ = wait( cstateLocked );
 	for (auto& itr : *initialConfChanges) {
 		for(auto& m : itr.mutations) {
 			self->configuration.applyMutation( m );
@@ -769,8 +837,14 @@ ACTOR Future<Void> getVersion(Reference<MasterData> self, GetCommitVersionReques
 		return Void();
 	}
 
-	TEST(proxyItr->second.latestRequestNum.get() < req.requestNum - 1); // Commit version request queued up
-	Void _ = wait(proxyItr->second.latestRequestNum.whenAtLeast(req.requestNum-1));
+	++self->getCommitVersionRequests;
+	if(proxyItr->second.latestRequestNum.get() < req.requestNum - 1) {
+		TEST(true); // Commit version request queued up
+		++self->getCommitVersionQueued;
+		state double queuedAt = now();
+		Void _ = wait(proxyItr->second.latestRequestNum.whenAtLeast(req.requestNum-1));
+		self->getCommitVersionQueueLatency.addMeasurement(now() - queuedAt);
+	}
 
 	auto itr = proxyItr->second.replies.find(req.requestNum);
 	if (itr != proxyItr->second.replies.end()) {
@@ -833,6 +907,8 @@ ACTOR Future<Void> provideVersions(Reference<MasterData> self) {
 	for (auto& p : self->proxies)
 		self->lastProxyVersionReplies[p.id()] = ProxyVersionReplies();
 
+	self->logger = traceCounters("MasterMetrics", self->dbgid, SERVER_KNOBS->WORKER_LOGGING_INTERVAL, &self->cc, "MasterMetrics");
+
 	loop {
 		choose {
 			when(GetCommitVersionRequest req = waitNext(self->myInterface.getCommitVersion.getFuture())) {
@@ -1024,6 +1100,7 @@ ACTOR Future<Void> trackTlogRecovery( Reference<MasterData> self, Reference<Asyn
 			TraceEvent("MasterRecoveryState", self->dbgid)
 			.detail("StatusCode", RecoveryStatus::remote_recovered)
 			.detail("Status", RecoveryStatus::names[RecoveryStatus::remote_recovered])
+			.detail("PrevStatusDuration", self->nextRecoveryStatus(RecoveryStatus::remote_recovered))
 			.trackLatest(format("%s/MasterRecoveryState", printable(self->dbName).c_str() ).c_str());
 			self->logSystem->coreStateWritten(newState);
 		}
@@ -1074,9 +1151,24 @@ ACTOR Future<Void> configurationMonitor( Reference<MasterData> self ) {
 	}
 }
 
+// Writes the next generation to the coordinated state, after which the master may register and recruit
+ACTOR Future<Void> lockCoordinatedState( Reference<MasterData> self, DBCoreState newState ) {
+	Void _ = wait( self->cstate.write(newState) );
+	self->recoveryState = RecoveryState::RECRUITING;
+	return Void();
+}
+
+ACTOR Future<Void> updateRegistrationAfter( Reference<MasterData> self, Reference<ILogSystem> logSystem, Future<Void> ready ) {
+	Void _ = wait( ready );
+	state Future<Void> reg = updateRegistration(self, logSystem);
+	self->registrationTrigger.trigger();
+	Void _ = wait( reg );
+	return Void();
+}
+
 ACTOR Future<Void> masterCore( Reference<MasterData> self ) {
 	state TraceInterval recoveryInterval("MasterRecovery");
-	state double recoverStartTime = now();
+	self->recoveryStartTime = now();
 
 	self->addActor.send( waitFailureServer(self->myInterface.waitFailure.getFuture()) );
 
@@ -1086,6 +1178,7 @@ ACTOR Future<Void> masterCore( Reference<MasterData> self ) {
 	TraceEvent("MasterRecoveryState", self->dbgid)
 		.detail("StatusCode", RecoveryStatus::reading_coordinated_state)
 		.detail("Status", RecoveryStatus::names[RecoveryStatus::reading_coordinated_state])
+		.detail("PrevStatusDuration", self->nextRecoveryStatus(RecoveryStatus::reading_coordinated_state))
 		.trackLatest("MasterRecoveryState");
 
 	Void _ = wait( self->cstate.read() );
@@ -1094,6 +1187,7 @@ ACTOR Future<Void> masterCore( Reference<MasterData> self ) {
 	TraceEvent("MasterRecoveryState", self->dbgid)
 		.detail("StatusCode", RecoveryStatus::locking_coordinated_state)
 		.detail("Status", RecoveryStatus::names[RecoveryStatus::locking_coordinated_state])
+		.detail("PrevStatusDuration", self->nextRecoveryStatus(RecoveryStatus::locking_coordinated_state))
 		.detail("TLogs", self->cstate.prevDBState.tLogs.size())
 		.detail("MyRecoveryCount", self->cstate.prevDBState.recoveryCount+2)
 		.trackLatest("MasterRecoveryState");
@@ -1103,9 +1197,8 @@ ACTOR Future<Void> masterCore( Reference<MasterData> self ) {
 
 	DBCoreState newState = self->cstate.myDBState;
 	newState.recoveryCount++;
-	Void _ = wait( self->cstate.write(newState) || recoverAndEndEpoch );
-
-	self->recoveryState = RecoveryState::RECRUITING;
+	state Future<Void> cstateLocked = lockCoordinatedState(self, newState);
+	self->addActor.send( cstateLocked );
 
 	state vector<StorageServerInterface> seedServers;
 	state vector<Standalone<CommitTransactionRef>> initialConfChanges;
@@ -1115,11 +1208,10 @@ ACTOR Future<Void> masterCore( Reference<MasterData> self ) {
 		Reference<ILogSystem> oldLogSystem = oldLogSystems->get();
 		if(oldLogSystem) logChanges = triggerUpdates(self, oldLogSystem);
 
-		state Future<Void> reg = oldLogSystem ? updateRegistration(self, oldLogSystem) : Never();
-		self->registrationTrigger.trigger();
+		state Future<Void> reg = oldLogSystem ? updateRegistrationAfter(self, oldLogSystem, cstateLocked) : Never();
 
 		choose {
-			when (Void _ = wait( oldLogSystem ? recoverFrom(self, oldLogSystem, &seedServers, &initialConfChanges) : Never() )) { reg.cancel(); break; }
+			when (Void _ = wait( oldLogSystem ? recoverFrom(self, oldLogSystem, &seedServers, &initialConfChanges, cstateLocked) : Never() )) { reg.cancel(); break; }
 			when (Void _ = wait( oldLogSystems->onChange() )) {}
 			when (Void _ = wait( reg )) { throw internal_error(); }
 			when (Void _ = wait( recoverAndEndEpoch )) {}
@@ -1129,12 +1221,14 @@ ACTOR Future<Void> masterCore( Reference<MasterData> self ) {
 	recoverAndEndEpoch.cancel();
 
 	ASSERT( self->proxies.size() <= self->configuration.getDesiredProxies() );
+	ASSERT( self->grvProxies.size() <= self->configuration.getDesiredGrvProxies() );
 	ASSERT( self->resolvers.size() <= self->configuration.getDesiredResolvers() );
 
 	self->recoveryState = RecoveryState::RECOVERY_TRANSACTION;
 	TraceEvent("MasterRecoveryState", self->dbgid)
 		.detail("StatusCode", RecoveryStatus::recovery_transaction)
 		.detail("Status", RecoveryStatus::names[RecoveryStatus::recovery_transaction])
+		.detail("PrevStatusDuration", self->nextRecoveryStatus(RecoveryStatus::recovery_transaction))
 		.trackLatest("MasterRecoveryState");
 
 	// Recovery transaction
@@ -1187,6 +1281,8 @@ ACTOR Future<Void> masterCore( Reference<MasterData> self ) {
 	state Future<Void> tlogFailure = self->logSystem->onError();
 	state Future<Void> resolverFailure = waitResolverFailure( self->resolvers );
 	state Future<Void> proxyFailure = waitProxyFailure( self->proxies );
+	if( self->grvProxies.size() )
+		proxyFailure = proxyFailure || waitProxyFailure( self->grvProxies );
 	state Future<Void> providingVersions = provideVersions(self);
 
 	self->addActor.send( reportErrors(updateRegistration(self, self->logSystem), "updateRegistration", self->dbgid) );
@@ -1209,6 +1305,7 @@ ACTOR Future<Void> masterCore( Reference<MasterData> self ) {
 	TraceEvent("MasterRecoveryState", self->dbgid)
 		.detail("StatusCode", RecoveryStatus::writing_coordinated_state)
 		.detail("Status", RecoveryStatus::names[RecoveryStatus::writing_coordinated_state])
+		.detail("PrevStatusDuration", self->nextRecoveryStatus(RecoveryStatus::writing_coordinated_state))
 		.detail("TLogList", self->logSystem->describe())
 		.trackLatest("MasterRecoveryState");
 
@@ -1238,19 +1335,21 @@ ACTOR Future<Void> masterCore( Reference<MasterData> self ) {
 	TraceEvent(recoveryInterval.end(), self->dbgid).detail("RecoveryTransactionVersion", self->recoveryTransactionVersion);
 
 	self->recoveryState = RecoveryState::FULLY_RECOVERED;
-	double recoveryDuration = now() - recoverStartTime;
-
-	TraceEvent((recoveryDuration > 4 && !g_network->isSimulated()) ? SevWarnAlways : SevInfo, "MasterRecoveryDuration", self->dbgid)
-		.detail("recoveryDuration", recoveryDuration)
-		.trackLatest("MasterRecoveryDuration");
+	double recoveryDuration = now() - self->recoveryStartTime;
 
 	TraceEvent("MasterRecoveryState", self->dbgid)
 		.detail("StatusCode", RecoveryStatus::fully_recovered)
 		.detail("Status", RecoveryStatus::names[RecoveryStatus::fully_recovered])
+		.detail("PrevStatusDuration", self->nextRecoveryStatus(RecoveryStatus::fully_recovered))
 		.detail("storeType", self->configuration.storageServerStoreType)
 		.detail("recoveryDuration", recoveryDuration)
 		.trackLatest("MasterRecoveryState");
 
+	TraceEvent((recoveryDuration > 4 && !g_network->isSimulated()) ? SevWarnAlways : SevInfo, "MasterRecoveryDuration", self->dbgid)
+		.detail("recoveryDuration", recoveryDuration)
+		.detail("StatusDurations", self->describeRecoveryStatusDurations())
+		.trackLatest("MasterRecoveryDuration");
+
 	// Now that the master is recovered we can start auxiliary services that happen to run here
 	{
 		PromiseStream< std::pair<UID, Optional<StorageServerInterface>> > ddStorageServerChanges;
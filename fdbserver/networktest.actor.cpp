@@ -20,17 +20,20 @@
 
 #include "flow/actorcompiler.h"
 #include "NetworkTest.h"
+#include "Knobs.h"
 
 UID WLTOKEN_NETWORKTEST( -1, 2 );
+UID WLTOKEN_NETWORKTEST_STREAM( -1, 8 );
 
 NetworkTestInterface::NetworkTestInterface( NetworkAddress remote )
-	: test( Endpoint(remote, WLTOKEN_NETWORKTEST) )
+	: test( Endpoint(remote, WLTOKEN_NETWORKTEST) ), stream( Endpoint(remote, WLTOKEN_NETWORKTEST_STREAM) )
 {
 }
 
 NetworkTestInterface::NetworkTestInterface( INetwork* local )
 {
 	test.makeWellKnownEndpoint( WLTOKEN_NETWORKTEST, TaskDefaultEndpoint );
+	stream.makeWellKnownEndpoint( WLTOKEN_NETWORKTEST_STREAM, TaskDefaultEndpoint );
 }
 
 ACTOR Future<Void> networkTestServer() {
@@ -38,41 +41,120 @@ ACTOR Future<Void> networkTestServer() {
 	state Future<Void> logging = delay( 1.0 );
 	state double lastTime = now();
 	state int sent = 0;
+	state int streamed = 0;
+	state int64_t bytesIn = 0;
+	state int64_t bytesOut = 0;
+	state Value replyValue;  // Kept from one request to the next while the reply size stays the same
 
 	loop {
 		choose {
 			when( NetworkTestRequest req = waitNext( interf.test.getFuture() ) ) {
-				req.reply.send( NetworkTestReply( Value( std::string( req.replySize, '.' ) ) ) );
+				if( replyValue.size() != req.replySize )
+					replyValue = Value( std::string( req.replySize, '.' ) );
+				req.reply.send( NetworkTestReply( replyValue ) );
 				sent++;
+				bytesIn += req.key.size();
+				bytesOut += req.replySize;
+			}
+			when( NetworkTestStreamRequest req = waitNext( interf.stream.getFuture() ) ) {
+				streamed++;
+				bytesIn += req.payload.size();
 			}
 			when( Void _ = wait( logging ) ) {
-				auto spd = sent / (now() - lastTime);
-				fprintf( stderr, "responses per second: %f (%f us)\n", spd, 1e6/spd );
+				double elapsed = now() - lastTime;
+				auto spd = sent / elapsed;
+				fprintf( stderr, "responses per second: %f (%f us), streamed messages per second: %f, MB/s in: %f, MB/s out: %f\n",
+					spd, 1e6/spd, streamed / elapsed, bytesIn / elapsed / 1e6, bytesOut / elapsed / 1e6 );
 				lastTime = now();
-				sent = 0;
+				sent = streamed = 0;
+				bytesIn = bytesOut = 0;
 				logging = delay( 1.0 );
 			}
 		}
 	}
 }
 
-ACTOR Future<Void> testClient( std::vector<NetworkTestInterface> interfs, int* sent ) {
-	state double lastTime = now();
+struct NetworkTestStats {
+	int64_t requests, failures, bytesSent, bytesReceived;
+	std::vector<double> latencies;  // Seconds, of each request, or in stream mode of each window
+
+	NetworkTestStats() : requests(0), failures(0), bytesSent(0), bytesReceived(0) {}
+
+	void add( double latency, int64_t sent, int64_t received, int count = 1 ) {
+		requests += count;
+		bytesSent += sent;
+		bytesReceived += received;
+		latencies.push_back( latency );
+	}
+
+	void operator+=( NetworkTestStats const& r ) {
+		requests += r.requests;
+		failures += r.failures;
+		bytesSent += r.bytesSent;
+		bytesReceived += r.bytesReceived;
+		latencies.insert( latencies.end(), r.latencies.begin(), r.latencies.end() );
+	}
+
+	// In microseconds; sorts latencies
+	double percentile( double p ) {
+		if( latencies.empty() )
+			return 0;
+		std::sort( latencies.begin(), latencies.end() );
+		return latencies[ std::min<size_t>( latencies.size() * p, latencies.size() - 1 ) ] * 1e6;
+	}
+};
+
+ACTOR Future<Void> testClient( std::vector<NetworkTestInterface> interfs, NetworkTestStats* stats ) {
+	state Key key( std::string( SERVER_KNOBS->NETWORK_TEST_REQUEST_SIZE, '.' ) );
+	state uint32_t replySize = SERVER_KNOBS->NETWORK_TEST_REPLY_SIZE;
 
 	loop {
-		NetworkTestReply rep = wait(  retryBrokenPromise(interfs[g_random->randomInt(0, interfs.size())].test, NetworkTestRequest( LiteralStringRef("."), 600000 ) ) );
-		(*sent)++;
+		state NetworkTestInterface interf = interfs[g_random->randomInt(0, interfs.size())];
+		state double start = timer();
+		if( SERVER_KNOBS->NETWORK_TEST_UNRELIABLE ) {
+			ErrorOr<NetworkTestReply> rep = wait( interf.test.tryGetReply( NetworkTestRequest( key, replySize ) ) );
+			if( rep.isError() ) {
+				stats->failures++;
+				Void _ = wait( delay( FLOW_KNOBS->PREVENT_FAST_SPIN_DELAY ) );
+			} else {
+				stats->add( timer() - start, key.size(), rep.get().value.size() );
+			}
+		} else {
+			NetworkTestReply rep = wait( retryBrokenPromise( interf.test, NetworkTestRequest( key, replySize ) ) );
+			stats->add( timer() - start, key.size(), rep.value.size() );
+		}
 	}
 }
 
-ACTOR Future<Void> logger( int* sent ) {
+// Sends NETWORK_TEST_STREAM_WINDOW one way messages at a time, each serialized into a chain of PacketBuffers as other
+// large messages are, and then a request whose reply shows that they all arrived, since a connection delivers in order
+ACTOR Future<Void> testStreamClient( NetworkTestInterface interf, NetworkTestStats* stats ) {
+	state Value payload( std::string( SERVER_KNOBS->NETWORK_TEST_REQUEST_SIZE, '.' ) );
+	state int window = std::max( SERVER_KNOBS->NETWORK_TEST_STREAM_WINDOW, 1 );
+
+	loop {
+		state double start = timer();
+		for(int i = 0; i < window; i++)
+			interf.stream.send( NetworkTestStreamRequest( payload ) );
+		NetworkTestReply rep = wait( retryBrokenPromise( interf.test, NetworkTestRequest( Key(), 0 ) ) );
+		stats->add( timer() - start, (int64_t)window * payload.size(), 0, window );
+	}
+}
+
+static void printStats( const char* prefix, NetworkTestStats& stats, double elapsed ) {
+	fprintf( stderr, "%s: messages per second: %f, failed: %lld, MB/s sent: %f, MB/s received: %f, latency us p50: %.1f p90: %.1f p99: %.1f max: %.1f\n",
+		prefix, stats.requests / elapsed, (long long)stats.failures, stats.bytesSent / elapsed / 1e6, stats.bytesReceived / elapsed / 1e6,
+		stats.percentile(0.5), stats.percentile(0.9), stats.percentile(0.99), stats.percentile(1.0) );
+}
+
+ACTOR Future<Void> logger( NetworkTestStats* stats, NetworkTestStats* total ) {
 	state double lastTime = now();
 	loop {
 		Void _ = wait( delay(1.0) );
-		auto spd = *sent / (now() - lastTime);
-		fprintf( stderr, "messages per second: %f\n", spd);
+		printStats( "interval", *stats, now() - lastTime );
 		lastTime = now();
-		*sent = 0;
+		*total += *stats;
+		*stats = NetworkTestStats();
 	}
 }
 
@@ -143,17 +225,43 @@ ACTOR Future<Void> networkTestClient( std:: string testServers ) {
 
 	state std::vector<NetworkTestInterface> interfs;
 	state std::vector<NetworkAddress> servers = NetworkAddress::parseList(testServers);
-	state int sent = 0;
+	state NetworkTestStats stats;
+	state NetworkTestStats total;
+	state double startTime = now();
+	bool tls = false;
 
 	for( int i = 0; i < servers.size(); i++ ) {
 		interfs.push_back( NetworkTestInterface( servers[i] ) );
+		tls = tls || servers[i].isTLS();
 	}
 
+	// TLS is chosen by the addresses (ADDRESS:PORT:tls) and the usual TLS options, as it is for a cluster
+	fprintf( stderr, "network test: %d %s clients, request size %d, reply size %d, %s, %s\n", SERVER_KNOBS->NETWORK_TEST_CLIENT_COUNT,
+		SERVER_KNOBS->NETWORK_TEST_STREAM ? format("streaming (window %d)", SERVER_KNOBS->NETWORK_TEST_STREAM_WINDOW).c_str() : "request-reply",
+		SERVER_KNOBS->NETWORK_TEST_REQUEST_SIZE, SERVER_KNOBS->NETWORK_TEST_STREAM ? 0 : SERVER_KNOBS->NETWORK_TEST_REPLY_SIZE,
+		SERVER_KNOBS->NETWORK_TEST_UNRELIABLE ? "unreliable" : "reliable", tls ? "TLS" : "no TLS" );
+
 	state std::vector<Future<Void>> clients;
-	for( int i = 0; i < 30; i++ )
-		clients.push_back( testClient( interfs, &sent ) );
-	clients.push_back( logger( &sent ) );
+	for( int i = 0; i < SERVER_KNOBS->NETWORK_TEST_CLIENT_COUNT; i++ ) {
+		if( SERVER_KNOBS->NETWORK_TEST_STREAM )
+			clients.push_back( testStreamClient( interfs[i % interfs.size()], &stats ) );
+		else
+			clients.push_back( testClient( interfs, &stats ) );
+	}
+	clients.push_back( logger( &stats, &total ) );
 
-	Void _ = wait( waitForAll( clients ) );
+	if( SERVER_KNOBS->NETWORK_TEST_DURATION <= 0 ) {
+		Void _ = wait( waitForAll( clients ) );
+		return Void();
+	}
+
+	Void _ = wait( delay( SERVER_KNOBS->NETWORK_TEST_DURATION ) || waitForAll( clients ) );
+	clients.clear();
+	total += stats;
+	printStats( "total", total, now() - startTime );
+	printf( "{\"requests\": %lld, \"failures\": %lld, \"seconds\": %.3f, \"bytes_sent\": %lld, \"bytes_received\": %lld, "
+		"\"latency_us\": {\"p50\": %.1f, \"p90\": %.1f, \"p99\": %.1f, \"p999\": %.1f, \"max\": %.1f}}\n",
+		(long long)total.requests, (long long)total.failures, now() - startTime, (long long)total.bytesSent, (long long)total.bytesReceived,
+		total.percentile(0.5), total.percentile(0.9), total.percentile(0.99), total.percentile(0.999), total.percentile(1.0) );
 	return Void();
-}
\ No newline at end of file
+}
@@ -19,47 +19,45 @@
  */
 
 #include "fdbclient/NativeAPI.h"
+#include "fdbclient/VersionstampQueue.h"
 
 /*
  * ///////////////
  * General FDB data model of Pub/Sub model
  * Feeds, Inboxes, Messages
  *
- * Message - publisher (feed), data
+ * Message - publisher (feed), position, data
  *
- * Inbox - message cache, dirty list, list of subscribed-to feeds
+ * Feed - a VersionstampQueue of messages, list of subscribed inboxes
  *
- * Feed - messages, list of inboxes to notify
- *
- * Structures for scalability: global list of dispatching feeds, feeds to consider
- *  dirty for all operation
+ * Inbox - for each subscribed-to feed, a cursor: the position of the last message read from it
  *
  * ///////////////
  * Basic Processes: post message, list messages
  *
  * Post (in one transaction):
- *  1. Add message to list of message in feed history
- *  2. For each Inbox of list of watching inboxes
- *    a. remove Inbox from list of watchers
- *    b. mark self as 'dirty' in the Inbox's dirty list
+ *  1. Check that the feed exists
+ *  2. Push the message onto the feed's queue, at the versionstamp of the transaction
+ *  Nothing of the subscribers is read or written, so a post costs the same for any number of them, and posts
+ *  do not conflict with each other or with readers.
+ *
+ * List messages in Inbox (in one transaction), up to n messages:
+ *  1. Read the cursors of the inbox
+ *  2. Read up to n messages after its cursor from every feed, all at once
+ *  3. Merge them by position, which is commit order across all feeds, and return the first n
  *
- * List recent message in Inbox (in one transaction), up to n messages:
- *  1. For each dirty Feed, update cache with latest message
- *  2. Triage list by getting latest m messages from top m feeds
- *    note: these messages can be cached in memory on the server, and on paging
- *     operations reused, so long as step 1 is repeated, IF there is no message deletion.
+ * Acknowledge messages (in one transaction): move each feed's cursor to the last listed message of that feed
  *
  * ////////////////
  * Assumptions:
- *  1. Subscriptions are "retroactive".  If a subscription is in place, the messages
- *    from that feed will start to appear in the listing of that inboxes messages
- *    and appear in historical lists as well.  This could lead to odd behaviour
- *    if paging through the contents of an inbox while a new subscrption was added
+ *  1. Subscriptions are "retroactive".  A new subscription's cursor is at the beginning of the feed, so all of
+ *    the feed's messages appear in the listing of the inbox.
+ *  2. A post retried after commit_unknown_result may appear twice.
  */
 
 typedef uint64_t Feed;
 typedef uint64_t Inbox;
-typedef uint64_t MessageId;
+typedef Key MessageId;  // The position of the message in its feed's queue; empty before the first message
 
 class Message {
 public:
@@ -83,13 +81,18 @@ public:
 
 	Future<bool> createSubcription(Feed feed, Inbox inbox);
 
+	// Returns an empty MessageId if there is no such feed
 	Future<MessageId> postMessage(Feed feed, Standalone<StringRef> data);
 
-	Future<std::vector<Message>> listFeedMessages(Feed feed, int count, MessageId cursor = 0);
+	// Up to count messages of the feed, after cursor
+	Future<std::vector<Message>> listFeedMessages(Feed feed, int count, MessageId cursor = MessageId());
 
-	Future<std::vector<Message>> listInboxMessages(Inbox inbox, int count, MessageId cursor = 0);
+	// Up to count messages of all of the inbox's feeds after its cursors, in commit order
+	Future<std::vector<Message>> listInboxMessages(Inbox inbox, int count);
+
+	// Moves the inbox's cursors past messages, returned by listInboxMessages(), so that they are not listed again
+	Future<Void> acknowledgeInboxMessages(Inbox inbox, std::vector<Message> messages);
 
 private:
 	Database cx;
 };
-
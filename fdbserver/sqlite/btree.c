@@ -4857,6 +4857,63 @@ SQLITE_PRIVATE int sqlite3BtreePrevious(BtCursor *pCur, int *pRes){
   return rc;
 }
 
+/*
+** Return the number of the page that the cursor points into, or 0 if
+** the cursor does not point to an entry.
+*/
+SQLITE_PRIVATE Pgno sqlite3BtreeCursorPage(BtCursor *pCur){
+  if( pCur->eState!=CURSOR_VALID ) return 0;
+  return pCur->apPage[pCur->iPage]->pgno;
+}
+
+/*
+** Write to aPgno the numbers of up to nMax pages that the cursor will
+** read next as it moves forward, or backward if reverse is true, and
+** return how many were written.  These are the first overflow pages of
+** the cells after the current one on its leaf page, followed by the
+** leaf pages after the current one in its parent page.  Nothing is read,
+** so the caller can read the pages ahead of the cursor.  No pages are
+** returned unless the cursor points into a leaf page.
+*/
+SQLITE_PRIVATE int sqlite3BtreeCursorNextPages(BtCursor *pCur, int reverse, Pgno *aPgno, int nMax){
+  MemPage *pPage;
+  MemPage *pParent;
+  CellInfo info;
+  int step = reverse ? -1 : 1;
+  int i, idx;
+  int n = 0;
+
+  if( pCur->eState!=CURSOR_VALID ) return 0;
+  pPage = pCur->apPage[pCur->iPage];
+  if( !pPage->leaf || pPage->nOverflow ) return 0;
+  for(i=pCur->aiIdx[pCur->iPage]+step; n<nMax && i>=0 && i<pPage->nCell; i+=step){
+    btreeParseCellPtr(pPage, findCell(pPage, i), &info);
+    if( info.iOverflow ){
+      aPgno[n++] = get4byte(&info.pCell[info.iOverflow]);
+    }
+  }
+
+  /* The cursor is in the child to the left of cell idx of its parent, or
+  ** in the right child if idx is nCell. */
+  if( pCur->iPage==0 ) return n;
+  pParent = pCur->apPage[pCur->iPage-1];
+  idx = pCur->aiIdx[pCur->iPage-1];
+  if( pParent->nOverflow ) return n;
+  if( reverse ){
+    for(i=idx-1; n<nMax && i>=0; i--){
+      aPgno[n++] = get4byte(findCell(pParent, i));
+    }
+  }else{
+    for(i=idx+1; n<nMax && i<pParent->nCell; i++){
+      aPgno[n++] = get4byte(findCell(pParent, i));
+    }
+    if( n<nMax && idx<pParent->nCell ){
+      aPgno[n++] = get4byte(&pParent->aData[pParent->hdrOffset+8]);
+    }
+  }
+  return n;
+}
+
 /*
 ** Allocate a new page from the database file.
 **
@@ -165,6 +165,8 @@ int sqlite3BtreeLast(BtCursor*, int *pRes);
 int sqlite3BtreeNext(BtCursor*, int *pRes);
 int sqlite3BtreeEof(BtCursor*);
 int sqlite3BtreePrevious(BtCursor*, int *pRes);
+Pgno sqlite3BtreeCursorPage(BtCursor*);
+int sqlite3BtreeCursorNextPages(BtCursor*, int reverse, Pgno *aPgno, int nMax);
 int sqlite3BtreeKeySize(BtCursor*, i64 *pSize);
 int sqlite3BtreeKey(BtCursor*, u32 offset, u32 amt, void*);
 const void *sqlite3BtreeKeyFetch(BtCursor*, int *pAmt);
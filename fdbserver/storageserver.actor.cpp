@@ -32,6 +32,7 @@
 #include "fdbclient/Notified.h"
 #include "fdbclient/MasterProxyInterface.h"
 #include "fdbclient/DatabaseContext.h"
+#include "fdbclient/BackupAgent.h"
 #include "WorkerInterface.h"
 #include "TLogInterface.h"
 #include "MoveKeys.h"
@@ -48,6 +49,11 @@
 #include "RecoveryState.h"
 #include "LogProtocolMessage.h"
 #include "flow/TDMetric.actor.h"
+#include "BloomFilter.h"
+#include "TrafficCapture.h"
+#include "flow/UnitTest.h"
+#include "fdbrpc/zlib/zlib.h"
+#include "fdbrpc/Checksum.h"
 
 using std::make_pair;
 
@@ -142,8 +148,70 @@ struct ShardInfo : ReferenceCounted<ShardInfo>, NonCopyable {
 	}
 };
 
+// When value compression is enabled for a storage server, the value of every data key in its storage engine starts
+// with one of these
+enum StoredValueEncoding { STORED_VALUE_RAW = 0, STORED_VALUE_ZLIB = 1 };
+
+// Returns value encoded for storage, compressed with zlib if it is large enough and compressing it saves space
+ValueRef encodeStoredValue( Arena& arena, ValueRef value ) {
+	if (value.size() >= SERVER_KNOBS->STORAGE_VALUE_COMPRESSION_MIN_BYTES) {
+		z_stream stream;
+		memset( &stream, 0, sizeof(stream) );
+		if (deflateInit( &stream, SERVER_KNOBS->STORAGE_VALUE_COMPRESSION_LEVEL ) != Z_OK)
+			throw internal_error();
+		int bound = deflateBound( &stream, value.size() );
+		uint8_t* out = new (arena) uint8_t[ 5 + bound ];
+		out[0] = STORED_VALUE_ZLIB;
+		uint32_t size = value.size();
+		memcpy( out + 1, &size, sizeof(size) );
+		stream.next_in = (Bytef*)value.begin();
+		stream.avail_in = value.size();
+		stream.next_out = out + 5;
+		stream.avail_out = bound;
+		int r = deflate( &stream, Z_FINISH );
+		int encodedSize = 5 + stream.total_out;
+		deflateEnd( &stream );
+		if (r != Z_STREAM_END)
+			throw internal_error();
+		if (encodedSize < value.size() + 1)
+			return ValueRef( out, encodedSize );
+	}
+
+	uint8_t* out = new (arena) uint8_t[ value.size() + 1 ];
+	out[0] = STORED_VALUE_RAW;
+	memcpy( out + 1, value.begin(), value.size() );
+	return ValueRef( out, value.size() + 1 );
+}
+
+// Returns the value that encodeStoredValue() encoded as stored.  A raw value refers to the memory of stored, while a
+// compressed one is inflated into arena.
+ValueRef decodeStoredValue( Arena& arena, ValueRef stored ) {
+	if (stored.size() && stored[0] == STORED_VALUE_RAW)
+		return stored.substr(1);
+	if (stored.size() < 5 || stored[0] != STORED_VALUE_ZLIB)
+		throw file_corrupt();
+
+	uint32_t size;
+	memcpy( &size, stored.begin() + 1, sizeof(size) );
+	uint8_t* out = new (arena) uint8_t[ size ];
+	z_stream stream;
+	memset( &stream, 0, sizeof(stream) );
+	if (inflateInit( &stream ) != Z_OK)
+		throw internal_error();
+	stream.next_in = (Bytef*)stored.begin() + 5;
+	stream.avail_in = stored.size() - 5;
+	stream.next_out = out;
+	stream.avail_out = size;
+	int r = inflate( &stream, Z_FINISH );
+	bool complete = r == Z_STREAM_END && stream.total_out == size;
+	inflateEnd( &stream );
+	if (!complete)
+		throw file_corrupt();
+	return ValueRef( out, size );
+}
+
 struct StorageServerDisk {
-	explicit StorageServerDisk( struct StorageServer* data, IKeyValueStore* storage ) : data(data), storage(storage) {}
+	explicit StorageServerDisk( struct StorageServer* data, IKeyValueStore* storage ) : data(data), storage(storage), compressValues(false) {}
 
 	void makeNewStorageServerDurable();
 	bool makeVersionMutationsDurable( Version& prevStorageVersion, Version newStorageVersion, int64_t& bytesLeft );
@@ -160,9 +228,42 @@ struct StorageServerDisk {
 
 	// SOMEDAY: Put readNextKeyInclusive in IKeyValueStore
 	Future<Key> readNextKeyInclusive( KeyRef key ) { return readFirstKey(storage, KeyRangeRef(key, allKeys.end)); }
-	Future<Optional<Value>> readValue( KeyRef key, Optional<UID> debugID = Optional<UID>() ) { return storage->readValue(key, debugID); }
-	Future<Optional<Value>> readValuePrefix( KeyRef key, int maxLength, Optional<UID> debugID = Optional<UID>() ) { return storage->readValuePrefix(key, maxLength, debugID); }
-	Future<Standalone<VectorRef<KeyValueRef>>> readRange( KeyRangeRef keys, int rowLimit = 1<<30, int byteLimit = 1<<30 ) { return storage->readRange(keys, rowLimit, byteLimit); }
+	Future<Optional<Value>> readValue( KeyRef key, Optional<UID> debugID = Optional<UID>() ) {
+		if (!compressValues) return storage->readValue(key, debugID);
+		return decodeValue( storage->readValue(key, debugID), std::numeric_limits<int>::max() );
+	}
+	Future<Optional<Value>> readValuePrefix( KeyRef key, int maxLength, Optional<UID> debugID = Optional<UID>() ) {
+		if (!compressValues) return storage->readValuePrefix(key, maxLength, debugID);
+		// A prefix of a compressed value cannot be inflated, so the whole value is read
+		return decodeValue( storage->readValue(key, debugID), maxLength );
+	}
+	Future<std::vector<Optional<Value>>> readValues( std::vector<std::pair<KeyRef, int>> const& keys ) {
+		if (!compressValues) return storage->readValues(keys);
+		// Stored values are at most one byte longer than the values they encode
+		std::vector<std::pair<KeyRef, int>> storedKeys;
+		storedKeys.reserve( keys.size() );
+		std::vector<int> maxLengths;
+		maxLengths.reserve( keys.size() );
+		for(auto& k : keys) {
+			storedKeys.push_back( std::make_pair( k.first, CLIENT_KNOBS->VALUE_SIZE_LIMIT + 1 ) );
+			maxLengths.push_back( k.second );
+		}
+		return decodeValues( storage->readValues(storedKeys), maxLengths );
+	}
+	Future<Standalone<VectorRef<KeyValueRef>>> readRange( KeyRangeRef keys, int rowLimit = 1<<30, int byteLimit = 1<<30 ) {
+		if (!compressValues) return storage->readRange(keys, rowLimit, byteLimit);
+		return decodeRange( storage->readRange(keys, rowLimit, byteLimit), std::numeric_limits<int>::max() );
+	}
+	Future<Standalone<VectorRef<KeyValueRef>>> readRangePrefix( KeyRangeRef keys, int maxLength, int rowLimit = 1<<30, int byteLimit = 1<<30 ) {
+		if (!compressValues || !maxLength) return storage->readRangePrefix(keys, maxLength, rowLimit, byteLimit);
+		// As for readValuePrefix(), whole values are read
+		return decodeRange( storage->readRange(keys, rowLimit, byteLimit), maxLength );
+	}
+	Future<Optional<Key>> readKeyAtOffset( KeyRangeRef keys, int offset ) { return storage->readKeyAtOffset(keys, offset); }
+
+	// Once enabled, the value of every data key is stored as encoded by encodeStoredValue()
+	void enableValueCompression() { compressValues = true; }
+	bool valueCompressionEnabled() const { return compressValues; }
 
 	KeyValueStoreType getKeyValueStoreType() { return storage->getType(); }
 	StorageBytes getStorageBytes() { return storage->getStorageBytes(); }
@@ -170,8 +271,41 @@ struct StorageServerDisk {
 private:
 	struct StorageServer* data;
 	IKeyValueStore* storage;
+	bool compressValues;
 
 	void writeMutations( MutationListRef mutations, Version debugVersion, const char* debugContext );
+	void set( KeyValueRef kv );
+
+	ACTOR static Future<Optional<Value>> decodeValue( Future<Optional<Value>> stored, int maxLength ) {
+		Optional<Value> v = wait( stored );
+		if (!v.present()) return v;
+		Value value = v.get();
+		ValueRef decoded = decodeStoredValue( value.arena(), value );
+		return Value( decoded.substr( 0, std::min( decoded.size(), maxLength ) ), value.arena() );
+	}
+
+	ACTOR static Future<std::vector<Optional<Value>>> decodeValues( Future<std::vector<Optional<Value>>> stored, std::vector<int> maxLengths ) {
+		std::vector<Optional<Value>> _values = wait( stored );
+		std::vector<Optional<Value>> values = _values;
+		for(int i = 0; i < values.size(); i++) {
+			if (values[i].present()) {
+				Value& value = values[i].get();
+				ValueRef decoded = decodeStoredValue( value.arena(), value );
+				value = Value( decoded.substr( 0, std::min( decoded.size(), maxLengths[i] ) ), value.arena() );
+			}
+		}
+		return values;
+	}
+
+	ACTOR static Future<Standalone<VectorRef<KeyValueRef>>> decodeRange( Future<Standalone<VectorRef<KeyValueRef>>> stored, int maxLength ) {
+		Standalone<VectorRef<KeyValueRef>> _kvs = wait( stored );
+		Standalone<VectorRef<KeyValueRef>> kvs = _kvs;
+		for(auto& kv : kvs) {
+			ValueRef decoded = decodeStoredValue( kvs.arena(), kv.value );
+			kv.value = decoded.substr( 0, std::min( decoded.size(), maxLength ) );
+		}
+		return kvs;
+	}
 
 	ACTOR static Future<Key> readFirstKey( IKeyValueStore* storage, KeyRangeRef range ) {
 		Standalone<VectorRef<KeyValueRef>> r = wait( storage->readRange( range, 1 ) );
@@ -180,6 +314,152 @@ private:
 	}
 };
 
+// Caches the values (or absence) of recently read keys as they are in the storage engine, so that repeated point reads
+// of keys outside the MVCC window are answered without a read from the storage engine.  Every write to the storage
+// engine goes through StorageServerDisk, which invalidates the affected entries.  Entries are evicted with the clock
+// algorithm, so keys which are read again while they are cached stay in the cache.
+struct HotKeyCache {
+	HotKeyCache() : generation(0) {}
+
+	// Returns the cached value of key, or an absent Optional if key is not cached
+	Optional<Optional<Value>> get( KeyRef key ) {
+		auto it = entries.find( key );
+		if (it == entries.end())
+			return Optional<Optional<Value>>();
+		it->second.referenced = true;
+		return it->second.value;
+	}
+
+	// Caches value as the value of key, unless the storage engine has been written since getGeneration() returned
+	// readGeneration (in which case value might already be out of date)
+	void insert( KeyRef key, Optional<Value> const& value, uint64_t readGeneration ) {
+		if (readGeneration != generation || SERVER_KNOBS->STORAGE_HOT_KEY_CACHE_ENTRIES <= 0 ||
+			(value.present() && value.get().size() > SERVER_KNOBS->STORAGE_HOT_KEY_CACHE_MAX_VALUE_BYTES))
+			return;
+		while (size() >= SERVER_KNOBS->STORAGE_HOT_KEY_CACHE_ENTRIES)
+			evictOne();
+		entries[ key ] = Entry( value );
+	}
+
+	void invalidate( KeyRef key ) {
+		++generation;
+		entries.erase( key );
+	}
+
+	void invalidate( KeyRangeRef keys ) {
+		++generation;
+		entries.erase( entries.lower_bound(keys.begin), entries.lower_bound(keys.end) );
+	}
+
+	uint64_t getGeneration() const { return generation; }
+	int size() const { return entries.size(); }
+
+private:
+	struct Entry {
+		Optional<Value> value;
+		bool referenced;
+
+		Entry() : referenced(false) {}
+		explicit Entry( Optional<Value> const& value ) : value(value), referenced(false) {}
+	};
+
+	std::map<Key, Entry> entries;
+	Key clockHand;
+	uint64_t generation;
+
+	void evictOne() {
+		auto it = entries.lower_bound( clockHand );
+		while (true) {
+			if (it == entries.end())
+				it = entries.begin();
+			if (!it->second.referenced)
+				break;
+			it->second.referenced = false;
+			++it;
+		}
+		auto next = it;
+		++next;
+		clockHand = next == entries.end() ? Key() : next->first;
+		entries.erase( it );
+	}
+};
+
+// A Bloom filter over the keys in the storage engine within the ranges of keyFilters that refer to it, so that point reads
+// of missing keys can be answered without reading the storage engine.  Every key written to the storage engine after the
+// filter is created is added to it, and buildKeyFilter() adds the keys that were already there before the filter becomes
+// ready, so a ready filter never excludes a key that is stored.  Cleared keys stay in the filter, which is rebuilt once
+// enough keys have been added to it that its false positive rate has grown.
+struct ShardKeyFilter : ReferenceCounted<ShardKeyFilter>, NonCopyable {
+	Optional<BloomFilter> filter;				// Present once the filter is ready
+	std::vector<BloomFilter::Hash> pending;		// The keys found or written while the filter is being built
+	int64_t builtKeys, addedKeys;
+	int64_t* totalBytes;
+
+	explicit ShardKeyFilter( int64_t* totalBytes ) : builtKeys(0), addedKeys(0), totalBytes(totalBytes) {}
+	~ShardKeyFilter() {
+		if (filter.present())
+			*totalBytes -= filter.get().memoryBytes();
+	}
+
+	void add( KeyRef key ) {
+		BloomFilter::Hash h = BloomFilter::hash( key );
+		if (filter.present()) {
+			filter.get().add( h );
+			++addedKeys;
+		} else {
+			pending.push_back( h );
+		}
+	}
+
+	bool excludes( KeyRef key ) const {
+		return filter.present() && !filter.get().mayContain( BloomFilter::hash( key ) );
+	}
+
+	bool isReady() const { return filter.present(); }
+	bool needsRebuild() const { return addedKeys > std::max<int64_t>( builtKeys, 1000 ) * SERVER_KNOBS->STORAGE_KEY_FILTER_REBUILD_GROWTH; }
+
+	void finish( int bitsPerKey ) {
+		filter = BloomFilter( pending.size(), bitsPerKey );
+		for(auto& h : pending)
+			filter.get().add( h );
+		builtKeys = pending.size();
+		*totalBytes += filter.get().memoryBytes();
+		std::vector<BloomFilter::Hash>().swap( pending );
+	}
+};
+
+// The server side state of a GetKeyValuesStreamRequest stream
+struct KeyValuesStream : ReferenceCounted<KeyValuesStream> {
+	KeyRange keys;
+	Version version;
+	int limit, limitBytes;
+	uint64_t changeCounter;
+	Key position;							// Where the next batch to be read begins
+	int nextSequence;						// The next batch to be read
+	Future<GetKeyValuesReply> lastBatch;	// The read of batch nextSequence-1
+	std::map<int, Future<GetKeyValuesReply>> batches;	// Batches which have been read or are being read but which have not been requested yet
+	double lastActive;
+
+	KeyValuesStream( GetKeyValuesStreamRequest const& req, Version version, uint64_t changeCounter )
+		: keys(req.keys), version(version), limit(req.limit), limitBytes(req.limitBytes), changeCounter(changeCounter),
+		  position(keys.begin), nextSequence(0), lastActive(now()) {}
+};
+
+// The server side state of a WaitMetricsBatchRequest subscription: the waits that have not been answered yet
+struct MetricsSubscription : ReferenceCounted<MetricsSubscription> {
+	struct Wait {
+		KeyRange keys;
+		StorageMetrics min, max;
+		double timeout;
+	};
+	std::map<int64_t, Wait> waits;
+	Promise<Void> superseded;	// Sent when a later request for the subscription arrives
+	int outstanding;	// Requests not yet answered
+	double lastActive;
+
+	MetricsSubscription() : outstanding(0), lastActive(now()) {}
+};
+
 struct UpdateEagerReadInfo {
 	vector<KeyRef> keyBegin;
 	vector<Key> keyEnd; // these are for ClearRange
@@ -196,7 +476,7 @@ struct UpdateEagerReadInfo {
 		// SOMEDAY: Theoretically we can avoid a read if there is an earlier overlapping ClearRange
 		if (m.type == MutationRef::ClearRange && !m.param2.startsWith(systemKeys.end))
 			keyBegin.push_back( m.param2 );
-		else if ((m.type == MutationRef::AppendIfFits) || (m.type == MutationRef::ByteMin) || (m.type == MutationRef::ByteMax))
+		else if ((m.type == MutationRef::AppendIfFits) || (m.type == MutationRef::ByteMin) || (m.type == MutationRef::ByteMax) || (m.type == MutationRef::SetIfAbsent) || (m.type == MutationRef::CompareAndSet))
 			keys.push_back(pair<KeyRef, int>(m.param1, CLIENT_KNOBS->VALUE_SIZE_LIMIT));
 		else if (isAtomicOp((MutationRef::Type) m.type))
 			keys.push_back(pair<KeyRef, int>(m.param1, m.param2.size()));
@@ -335,6 +615,10 @@ public:
 
 	CoalescedKeyRangeMap< Version > newestDirtyVersion; // Similar to newestAvailableVersion, but includes (only) keys that were only partly available (due to cancelled fetchKeys)
 
+	// changeFeedStartVersion[k] is the version from which the mutations to k are in mutationLog one version at a time, rather
+	// than having arrived all at once by fetching k
+	CoalescedKeyRangeMap< Version > changeFeedStartVersion;
+
 	// The following are in rough order from newest to oldest
 	Version lastTLogVersion, lastVersionWithData, restoredVersion;
 	NotifiedVersion version;
@@ -351,12 +635,22 @@ public:
 	Key sk;
 	Reference<AsyncVar<ServerDBInfo>> db;
 	Database cx;
+	Reference<TrafficCapture> capture;  // Set if reads are being captured for replay
 
 	StorageServerMetrics metrics;
 	CoalescedKeyRangeMap<bool, int64_t, KeyBytesMetric<int64_t>> byteSampleClears;
 	AsyncVar<bool> byteSampleClearsTooLarge;
 	Future<Void> byteSampleRecovery;
 
+	// A Bloom filter over the keys in the byte sample, so that byteSampleApplySet() need not search the sample for the
+	// keys that are neither sampled now nor were before, which are most of them.  Keys erased from the sample stay in the
+	// filter, which maintainByteSampleFilter() replaces once as many keys have been added as it was sized for.  While it
+	// does, the keys added meanwhile are also kept in byteSampleFilterPending for the new filter.
+	BloomFilter byteSampleFilter;
+	int64_t byteSampleFilterCapacity, byteSampleFilterKeys;
+	Optional<std::vector<BloomFilter::Hash>> byteSampleFilterPending;
+	AsyncVar<bool> byteSampleFilterFull;
+
 	AsyncMap<Key,bool> watches;
 	int64_t watchBytes;
 	AsyncVar<bool> noRecentUpdates;
@@ -364,6 +658,14 @@ public:
 
 	Int64MetricHandle readQueueSizeMetric;
 
+	HotKeyCache hotKeyCache;
+	HotRangeSampler hotReads, hotWrites;  // Bytes read and written, for finding hot spots
+	std::map<UID, Reference<KeyValuesStream>> keyValuesStreams;
+	std::map<UID, Reference<MetricsSubscription>> metricsSubscriptions;
+
+	int64_t keyFilterBytes;
+	KeyRangeMap<Reference<ShardKeyFilter>> keyFilters;
+
 	std::string folder;
 
 	// defined only during splitMutations()/addMutation()
@@ -371,6 +673,7 @@ public:
 
 	FlowLock durableVersionLock;
 	FlowLock fetchKeysParallelismLock;
+	FlowLock exportBackupRangeLock;
 	vector< Promise<FetchInjectionInfo*> > readyFetchKeys;
 
 	int64_t instanceID;
@@ -380,6 +683,7 @@ public:
 	bool shuttingDown;
 
 	Smoother readReplyRate; //FIXME: very similar to counters.finishedQueries, new fast load balancing smoother
+	TimerSmoother processCPUSeconds;  // For the CPU usage reported to data distribution
 
 	bool behind;
 
@@ -395,17 +699,34 @@ public:
 
 	struct Counters {
 		CounterCollection cc;
-		Counter allQueries, getKeyQueries, getValueQueries, getRangeQueries, finishedQueries, rowsQueried, bytesQueried;
+		Counter allQueries, getKeyQueries, getValueQueries, getValuesQueries, getValuesKeys, getRangeQueries, getRangeStreamBatches, finishedQueries, rowsQueried, bytesQueried;
 		Counter bytesInput, bytesDurable, bytesFetched,
 			mutationBytes;  // Like bytesInput but without MVCC accounting
 		Counter updateBatches, updateVersions;
 		Counter loops;
+		Counter hotKeyCacheHits, hotKeyCacheMisses;
+		Counter eagerReads, eagerReadsFromMemory;
+		Counter keyFilterNegatives;
+		Counter eBrakeWaits;
+		Counter atomicAddsCombined;
+		Counter backupRangesExported, backupBytesExported;
+		Counter changeFeedQueries, changeFeedMutations;
+		Counter getRangeAggregateQueries;
+		Counter getRangeDigestQueries;
+		Counter findKeySkips;
+		LatencySample readLatency;  // Of getValue requests that are answered
+		// The stages of readLatency: waiting to run at TaskDefaultEndpoint, waiting for the requested version, and reading
+		// from the storage engine, which only the reads that miss the in-memory versions and the hot key cache do
+		LatencySample readQueueLatency, readVersionWaitLatency, readEngineLatency;
 
 		Counters(StorageServer* self)
 			: cc("StorageServer", self->thisServerID.toString()),
 			getKeyQueries("getKeyQueries", cc),
 			getValueQueries("getValueQueries",cc),
+			getValuesQueries("getValuesQueries", cc),
+			getValuesKeys("getValuesKeys", cc),
 			getRangeQueries("getRangeQueries", cc),
+			getRangeStreamBatches("getRangeStreamBatches", cc),
 			allQueries("QueryQueue", cc),
 			finishedQueries("finishedQueries", cc),
 			rowsQueried("rowsQueried", cc),
@@ -416,7 +737,25 @@ public:
 			mutationBytes("mutationBytes", cc),
 			updateBatches("updateBatches", cc),
 			updateVersions("updateVersions", cc),
-			loops("loops", cc)
+			loops("loops", cc),
+			hotKeyCacheHits("hotKeyCacheHits", cc),
+			hotKeyCacheMisses("hotKeyCacheMisses", cc),
+			eagerReads("eagerReads", cc),
+			eagerReadsFromMemory("eagerReadsFromMemory", cc),
+			keyFilterNegatives("keyFilterNegatives", cc),
+			eBrakeWaits("eBrakeWaits", cc),
+			atomicAddsCombined("atomicAddsCombined", cc),
+			backupRangesExported("backupRangesExported", cc),
+			backupBytesExported("backupBytesExported", cc),
+			changeFeedQueries("changeFeedQueries", cc),
+			changeFeedMutations("changeFeedMutations", cc),
+			getRangeAggregateQueries("getRangeAggregateQueries", cc),
+			getRangeDigestQueries("getRangeDigestQueries", cc),
+			findKeySkips("findKeySkips", cc),
+			readLatency("ReadLatency", cc),
+			readQueueLatency("ReadQueueLatency", cc),
+			readVersionWaitLatency("ReadVersionWaitLatency", cc),
+			readEngineLatency("ReadEngineLatency", cc)
 		{
 			specialCounter(cc, "lastTLogVersion", [self](){return self->lastTLogVersion; });
 			specialCounter(cc, "version", [self](){return self->version.get(); });
@@ -429,6 +768,10 @@ public:
 
 			specialCounter(cc, "QueryQueueMax", [self](){return self->getAndResetMaxQueryQueueSize(); });
 
+			specialCounter(cc, "hotKeyCacheEntries", [self](){return self->hotKeyCache.size(); });
+			specialCounter(cc, "getRangeStreams", [self](){return self->keyValuesStreams.size(); });
+			specialCounter(cc, "keyFilterBytes", [self](){return self->keyFilterBytes; });
+
 			specialCounter(cc, "bytesStored", [self](){return self->metrics.byteSample.getEstimate(allKeys); });
 
 			specialCounter(cc, "kvstoreBytesUsed", [self](){ return self->storage.getStorageBytes().used; });
@@ -445,11 +788,13 @@ public:
 			updateEagerReads(0),
 			shardChangeCounter(0),
 			fetchKeysParallelismLock(SERVER_KNOBS->FETCH_KEYS_PARALLELISM_BYTES),
-			shuttingDown(false), readReplyRate(SERVER_KNOBS->STORAGE_LOGGING_DELAY / 2.0),
-			debug_inApplyUpdate(false), debug_lastValidateTime(0), watchBytes(0),
+			exportBackupRangeLock(SERVER_KNOBS->BACKUP_EXPORT_PARALLELISM),
+			shuttingDown(false), readReplyRate(SERVER_KNOBS->STORAGE_LOGGING_DELAY / 2.0), processCPUSeconds(SERVER_KNOBS->STORAGE_LOGGING_DELAY / 2.0),
+			debug_inApplyUpdate(false), debug_lastValidateTime(0), watchBytes(0), keyFilterBytes(0),
 			logProtocol(0), counters(this), tag(invalidTag), maxQueryQueue(0), thisServerID(ssi.id()),
 			readQueueSizeMetric(LiteralStringRef("StorageServer.ReadQueueSize")),
-			behind(false), byteSampleClears(false, LiteralStringRef("\xff\xff\xff")), noRecentUpdates(false), lastUpdate(now())
+			behind(false), byteSampleClears(false, LiteralStringRef("\xff\xff\xff")), byteSampleFilterCapacity(0), byteSampleFilterKeys(0),
+			byteSampleFilterFull(false), noRecentUpdates(false), lastUpdate(now())
 	{
 		version.initMetric(LiteralStringRef("StorageServer.Version"), counters.cc.id);
 		oldestVersion.initMetric(LiteralStringRef("StorageServer.OldestVersion"), counters.cc.id);
@@ -460,6 +805,9 @@ public:
 		newestDirtyVersion.insert(allKeys, invalidVersion);
 		addShard( ShardInfo::newNotAssigned( allKeys ) );
 
+		if (!g_network->isSimulated())
+			processCPUSeconds.reset( getProcessorTimeProcess() );
+
 		cx = openDBOnServer(db, TaskDefaultEndpoint, false, true);
 	}
 	//~StorageServer() { fclose(log); }
@@ -500,6 +848,35 @@ public:
 		return true;
 	}
 
+	void addKeyToFilter( KeyRef key ) {
+		auto& filter = keyFilters[key];
+		if (filter)
+			filter->add( key );
+	}
+
+	// True if key is certainly not in the storage engine
+	bool keyFilterExcludes( KeyRef key ) {
+		auto& filter = keyFilters[key];
+		return filter && filter->excludes( key );
+	}
+
+	// Must be called for each key added to the byte sample
+	void addToByteSampleFilter( KeyRef key ) {
+		if (SERVER_KNOBS->BYTE_SAMPLE_FILTER_BITS_PER_KEY <= 0)
+			return;
+		BloomFilter::Hash h = BloomFilter::hash( key );
+		byteSampleFilter.add( h );
+		if (byteSampleFilterPending.present())
+			byteSampleFilterPending.get().push_back( h );
+		if (++byteSampleFilterKeys > byteSampleFilterCapacity)
+			byteSampleFilterFull.set( true );
+	}
+
+	// False if key is certainly not in the byte sample
+	bool byteSampleMayContain( KeyRef key ) const {
+		return byteSampleFilterCapacity == 0 || byteSampleFilterKeys > byteSampleFilterCapacity || byteSampleFilter.mayContain( BloomFilter::hash( key ) );
+	}
+
 	void checkChangeCounter( uint64_t oldShardChangeCounter, KeyRef const& key ) {
 		if (oldShardChangeCounter != shardChangeCounter &&
 			shards[key]->changeCounter > oldShardChangeCounter)
@@ -527,6 +904,11 @@ public:
 	double getPenalty() {
 		 return std::max(1.0, (queueSize() - (SERVER_KNOBS->TARGET_BYTES_PER_STORAGE_SERVER - 2*SERVER_KNOBS->SPRING_BYTES_STORAGE_SERVER)) / SERVER_KNOBS->SPRING_BYTES_STORAGE_SERVER);
 	}
+
+	// The number of reads being served, which replies report so that clients can steer around a server with a long queue
+	int64_t readQueueDepth() {
+		return counters.allQueries.getValue() - counters.finishedQueries.getValue();
+	}
 };
 
 // If and only if key:=value is in (storage+versionedData),    // NOT ACTUALLY: and key < allKeys.end,
@@ -688,12 +1070,15 @@ ACTOR Future<Void> getValueQ( StorageServer* data, GetValueRequest req ) {
 		data->maxQueryQueue = std::max<int>( data->maxQueryQueue, data->counters.allQueries.getValue() - data->counters.finishedQueries.getValue());
 
 		Void _ = wait( delay(0, TaskDefaultEndpoint) );
+		state double versionWaitStart = timer();
+		data->counters.readQueueLatency.addMeasurement(versionWaitStart - startTime);
 
 		if( req.debugID.present() )
 			g_traceBatch.addEvent("GetValueDebug", req.debugID.get().first(), "getValueQ.DoRead"); //.detail("TaskID", g_network->getCurrentTask());
 
 		state Optional<Value> v;
 		state Version version = wait( waitForVersion( data, req.version ) );
+		data->counters.readVersionWaitLatency.addMeasurement(timer() - versionWaitStart);
 		if( req.debugID.present() )
 			g_traceBatch.addEvent("GetValueDebug", req.debugID.get().first(), "getValueQ.AfterVersion"); //.detail("TaskID", g_network->getCurrentTask());
 
@@ -710,19 +1095,34 @@ ACTOR Future<Void> getValueQ( StorageServer* data, GetValueRequest req ) {
 			v = (Value)i->getValue();
 			path = 1;
 		} else if (!i || !i->isClearTo() || i->getEndKey() <= req.key) {
-			path = 2;
-			Optional<Value> vv = wait( data->storage.readValue( req.key, req.debugID ) );
-			// Validate that while we were reading the data we didn't lose the version or shard
-			if (version < data->storageVersion()) {
-				TEST(true); // transaction_too_old after readValue
-				throw transaction_too_old();
+			Optional<Optional<Value>> cached = data->hotKeyCache.get( req.key );
+			if (data->keyFilterExcludes( req.key )) {
+				++data->counters.keyFilterNegatives;
+				path = 4;
+			} else if (cached.present()) {
+				++data->counters.hotKeyCacheHits;
+				v = cached.get();
+				path = 3;
+			} else {
+				++data->counters.hotKeyCacheMisses;
+				path = 2;
+				state uint64_t cacheGeneration = data->hotKeyCache.getGeneration();
+				state double engineReadStart = timer();
+				Optional<Value> vv = wait( data->storage.readValue( req.key, req.debugID ) );
+				data->counters.readEngineLatency.addMeasurement(timer() - engineReadStart);
+				// Validate that while we were reading the data we didn't lose the version or shard
+				if (version < data->storageVersion()) {
+					TEST(true); // transaction_too_old after readValue
+					throw transaction_too_old();
+				}
+				data->checkChangeCounter(changeCounter, req.key);
+				data->hotKeyCache.insert( req.key, vv, cacheGeneration );
+				v = vv;
 			}
-			data->checkChangeCounter(changeCounter, req.key);
-			v = vv;
 		}
 
 		debugMutation("ShardGetValue", version, MutationRef(MutationRef::DebugKey, req.key, v.present()?v.get():LiteralStringRef("<null>")));
-		debugMutation("ShardGetPath", version, MutationRef(MutationRef::DebugKey, req.key, path==0?LiteralStringRef("0"):path==1?LiteralStringRef("1"):LiteralStringRef("2")));
+		debugMutation("ShardGetPath", version, MutationRef(MutationRef::DebugKey, req.key, path==0?LiteralStringRef("0"):path==1?LiteralStringRef("1"):path==2?LiteralStringRef("2"):path==3?LiteralStringRef("3"):LiteralStringRef("4")));
 
 		/*
 		StorageMetrics m;
@@ -730,6 +1130,11 @@ ACTOR Future<Void> getValueQ( StorageServer* data, GetValueRequest req ) {
 		m.iosPerKSecond = 1;
 		data->metrics.notify(req.key, m);
 		*/
+		StorageMetrics metrics;
+		metrics.bytesReadPerKSecond = std::max<int64_t>( req.key.size() + (v.present() ? v.get().size() : 0), SERVER_KNOBS->EMPTY_READ_PENALTY );
+		data->metrics.notify(req.key, metrics);
+		if( data->hotReads.sample() )
+			data->hotReads.add( singleKeyRange(req.key), metrics.bytesReadPerKSecond );
 
 		data->readReplyRate.addDelta(1);
 
@@ -743,6 +1148,8 @@ ACTOR Future<Void> getValueQ( StorageServer* data, GetValueRequest req ) {
 
 		GetValueReply reply(v);
 		reply.penalty = data->getPenalty();
+		reply.queueDepth = data->readQueueDepth();
+		data->counters.readLatency.addMeasurement(timer() - startTime);
 		req.reply.send(reply);
 	} catch (Error& e) {
 		if (e.code() == error_code_internal_error || e.code() == error_code_actor_cancelled) throw;
@@ -755,6 +1162,98 @@ ACTOR Future<Void> getValueQ( StorageServer* data, GetValueRequest req ) {
 	return Void();
 };
 
+ACTOR Future<Void> getValuesQ( StorageServer* data, GetValuesRequest req ) {
+	try {
+		++data->counters.getValuesQueries;
+		++data->counters.allQueries;
+		data->counters.getValuesKeys += req.keys.size();
+		++data->readQueueSizeMetric;
+		data->maxQueryQueue = std::max<int>( data->maxQueryQueue, data->counters.allQueries.getValue() - data->counters.finishedQueries.getValue());
+
+		Void _ = wait( delay(0, TaskDefaultEndpoint) );
+
+		if( req.debugID.present() )
+			g_traceBatch.addEvent("GetValueDebug", req.debugID.get().first(), "getValuesQ.DoRead");
+
+		state Version version = wait( waitForVersion( data, req.version ) );
+		state uint64_t changeCounter = data->shardChangeCounter;
+		state GetValuesReply reply;
+		state std::vector<int> storageReads;
+		state std::vector<Future<Optional<Value>>> storageValues;
+		state uint64_t cacheGeneration = data->hotKeyCache.getGeneration();
+
+		reply.values.resize( reply.arena, req.keys.size() );
+		for(int k = 0; k < req.keys.size(); k++) {
+			KeyRef key = req.keys[k];
+			if (!data->shards[key]->isReadable())
+				throw wrong_shard_server();
+
+			auto i = data->data().at(version).lastLessOrEqual(key);
+			if (i && i->isValue() && i.key() == key) {
+				reply.values[k] = ValueRef( reply.arena, i->getValue() );
+			} else if (!i || !i->isClearTo() || i->getEndKey() <= key) {
+				Optional<Optional<Value>> cached = data->hotKeyCache.get( key );
+				if (data->keyFilterExcludes( key )) {
+					++data->counters.keyFilterNegatives;
+				} else if (cached.present()) {
+					++data->counters.hotKeyCacheHits;
+					if (cached.get().present())
+						reply.values[k] = ValueRef( reply.arena, cached.get().get() );
+				} else {
+					++data->counters.hotKeyCacheMisses;
+					storageReads.push_back( k );
+					storageValues.push_back( data->storage.readValue( key, req.debugID ) );
+				}
+			}
+		}
+
+		if (storageValues.size()) {
+			std::vector<Optional<Value>> values = wait( getAll( storageValues ) );
+			// Validate that while we were reading the data we didn't lose the version or any of the shards
+			if (version < data->storageVersion()) {
+				TEST(true); // transaction_too_old after readValue in getValuesQ
+				throw transaction_too_old();
+			}
+			for(int r = 0; r < storageReads.size(); r++) {
+				KeyRef key = req.keys[ storageReads[r] ];
+				data->checkChangeCounter( changeCounter, key );
+				data->hotKeyCache.insert( key, values[r], cacheGeneration );
+				if (values[r].present())
+					reply.values[ storageReads[r] ] = ValueRef( reply.arena, values[r].get() );
+			}
+		}
+
+		for(int k = 0; k < reply.values.size(); k++) {
+			auto& v = reply.values[k];
+			if (v.present()) {
+				++data->counters.rowsQueried;
+				data->counters.bytesQueried += v.get().size();
+			}
+			StorageMetrics metrics;
+			metrics.bytesReadPerKSecond = std::max<int64_t>( req.keys[k].size() + (v.present() ? v.get().size() : 0), SERVER_KNOBS->EMPTY_READ_PENALTY );
+			data->metrics.notify(req.keys[k], metrics);
+			if( data->hotReads.sample() )
+				data->hotReads.add( singleKeyRange(req.keys[k]), metrics.bytesReadPerKSecond );
+		}
+		data->readReplyRate.addDelta(1);
+
+		if( req.debugID.present() )
+			g_traceBatch.addEvent("GetValueDebug", req.debugID.get().first(), "getValuesQ.AfterRead");
+
+		reply.penalty = data->getPenalty();
+		reply.queueDepth = data->readQueueDepth();
+		req.reply.send(reply);
+	} catch (Error& e) {
+		if (e.code() == error_code_internal_error || e.code() == error_code_actor_cancelled) throw;
+		req.reply.sendError(e);
+	}
+
+	++data->counters.finishedQueries;
+	--data->readQueueSizeMetric;
+
+	return Void();
+}
+
 ACTOR Future<Void> watchValue_impl( StorageServer* data, WatchValueRequest req ) {
 	try {
 		if( req.debugID.present() )
@@ -872,11 +1371,16 @@ ACTOR Future<Void> getShardStateQ( StorageServer* data, GetShardStateRequest req
 	return Void();
 }
 
+static ValueRef valuePrefix( ValueRef value, int maxLength ) {
+	return maxLength >= 0 && maxLength < value.size() ? value.substr(0, maxLength) : value;
+}
+
 void merge( Arena& arena, VectorRef<KeyValueRef>& output, VectorRef<KeyValueRef> const& base,
 	        StorageServer::VersionedData::iterator& start, StorageServer::VersionedData::iterator const& end,
-			int versionedDataCount, int limit, bool stopAtEndOfBase, int limitBytes = 1<<30 )
+			int versionedDataCount, int limit, bool stopAtEndOfBase, int limitBytes = 1<<30, int maxValueLength = -1 )
 // Combines data from base (at an older version) with sets from newer versions in [start, end) and appends the first (up to) |limit| rows to output
 // If limit<0, base and output are in descending order, and start->key()>end->key(), but start is still inclusive and end is exclusive
+// If maxValueLength>=0, the values of the sets are cut to that length, as those of base already are
 {
 	if (limit==0) return;
 	int originalLimit = abs(limit) + output.size();
@@ -890,7 +1394,7 @@ void merge( Arena& arena, VectorRef<KeyValueRef>& output, VectorRef<KeyValueRef>
 		if (forward ? baseStart->key < start.key() : baseStart->key > start.key())
 			output.push_back_deep( arena, *baseStart++ );
 		else {
-			output.push_back_deep( arena, KeyValueRef(start.key(), start->getValue()) );
+			output.push_back_deep( arena, KeyValueRef(start.key(), valuePrefix(start->getValue(), maxValueLength)) );
 			if (baseStart->key == start.key()) ++baseStart;
 			if (forward) ++start; else --start;
 		}
@@ -902,7 +1406,7 @@ void merge( Arena& arena, VectorRef<KeyValueRef>& output, VectorRef<KeyValueRef>
 	}
 	if( !stopAtEndOfBase ) {
 		while (start!=end && --limit>=0 && accumulatedBytes < limitBytes) {
-			output.push_back_deep( arena, KeyValueRef(start.key(), start->getValue()) );
+			output.push_back_deep( arena, KeyValueRef(start.key(), valuePrefix(start->getValue(), maxValueLength)) );
 			accumulatedBytes += sizeof(KeyValueRef) + output.end()[-1].expectedSize();
 			if (forward) ++start; else --start;
 		}
@@ -913,7 +1417,8 @@ void merge( Arena& arena, VectorRef<KeyValueRef>& output, VectorRef<KeyValueRef>
 // readRange reads up to |limit| rows from the given range and version, combining data->storage and data->versionedData.
 // If limit>=0, it returns the first rows in the range (sorted ascending), otherwise the last rows (sorted descending).
 // readRange has O(|result|) + O(log |data|) cost
-ACTOR Future<GetKeyValuesReply> readRange( StorageServer* data, Version version, KeyRange range, int limit, int* pLimitBytes ) {
+// If maxValueLength>=0, only that many bytes of each value are read and returned, and only those count against *pLimitBytes
+ACTOR Future<GetKeyValuesReply> readRange( StorageServer* data, Version version, KeyRange range, int limit, int* pLimitBytes, int maxValueLength = -1 ) {
 	state GetKeyValuesReply result;
 	state StorageServer::VersionedData::ViewAtVersion view = data->data().at(version);
 	state StorageServer::VersionedData::iterator vStart = view.end();
@@ -971,7 +1476,8 @@ ACTOR Future<GetKeyValuesReply> readRange( StorageServer* data, Version version,
 
 			// Read the data on disk up to vEnd (or the end of the range)
 			readEnd = vEnd ? std::min( vEnd.key(), range.end ) : range.end;
-			Standalone<VectorRef<KeyValueRef>> atStorageVersion = wait(
+			Standalone<VectorRef<KeyValueRef>> atStorageVersion = wait( maxValueLength >= 0 ?
+					data->storage.readRangePrefix( KeyRangeRef(readBegin, readEnd), maxValueLength, limit, *pLimitBytes ) :
 					data->storage.readRange( KeyRangeRef(readBegin, readEnd), limit, *pLimitBytes ) );
 
 			/*if (track) {
@@ -987,7 +1493,7 @@ ACTOR Future<GetKeyValuesReply> readRange( StorageServer* data, Version version,
 
 			// merge the sets in [vStart,vEnd) with the sets on disk, stopping at the last key from disk if there is 'more'
 			int prevSize = result.data.size();
-			merge( result.arena, result.data, atStorageVersion, vStart, vEnd, vCount, limit, more, *pLimitBytes );
+			merge( result.arena, result.data, atStorageVersion, vStart, vEnd, vCount, limit, more, *pLimitBytes, maxValueLength );
 			limit -= result.data.size() - prevSize;
 
 			for (auto i = &result.data[prevSize]; i != result.data.end(); i++)
@@ -1071,11 +1577,13 @@ ACTOR Future<GetKeyValuesReply> readRange( StorageServer* data, Version version,
 			if (vEnd)
 				readBegin = std::max( readBegin, vEnd->isClearTo() ? vEnd->getEndKey() : vEnd.key() );
 
-			Standalone<VectorRef<KeyValueRef>> atStorageVersion = wait( data->storage.readRange( KeyRangeRef(readBegin, readEnd), limit ) );
+			Standalone<VectorRef<KeyValueRef>> atStorageVersion = wait( maxValueLength >= 0 ?
+					data->storage.readRangePrefix( KeyRangeRef(readBegin, readEnd), maxValueLength, limit ) :
+					data->storage.readRange( KeyRangeRef(readBegin, readEnd), limit ) );
 			if (data->storageVersion() > version) throw transaction_too_old();
 
 			int prevSize = result.data.size();
-			merge( result.arena, result.data, atStorageVersion, vStart, vEnd, vCount, limit, false, *pLimitBytes );
+			merge( result.arena, result.data, atStorageVersion, vStart, vEnd, vCount, limit, false, *pLimitBytes, maxValueLength );
 			limit += result.data.size() - prevSize;
 
 			for (auto i = &result.data[prevSize]; i != result.data.end(); i++)
@@ -1101,6 +1609,26 @@ bool selectorInRange( KeySelectorRef const& sel, KeyRangeRef const& range ) {
 	return sel.getKey() >= range.begin && (sel.isBackward() ? sel.getKey() <= range.end : sel.getKey() < range.end);
 }
 
+// Returns the key offset entries into range at version, counted as by IKeyValueStore::readKeyAtOffset(), if data->storage
+// can find it by its position and nothing written in the versions it does not have yet lies between the start of the
+// count and that key.  Otherwise returns nothing, and the key has to be found by reading the range.
+ACTOR Future<Optional<Key>> findKeyByPosition( StorageServer* data, Version version, KeyRange range, int offset ) {
+	state StorageServer::VersionedData::ViewAtVersion view = data->data().at(version);
+	Optional<Key> key = wait( data->storage.readKeyAtOffset( range, offset ) );
+	if (data->storageVersion() > version) throw transaction_too_old();
+	if (!key.present())
+		return key;
+
+	KeyRange span = offset >= 0 ? KeyRange(KeyRangeRef(range.begin, keyAfter(key.get()))) : KeyRange(KeyRangeRef(key.get(), range.end));
+	auto v = view.lastLessOrEqual(span.begin);
+	if (v && v->isClearTo() && v->getEndKey() > span.begin)
+		return Optional<Key>();
+	v = view.lower_bound(span.begin);
+	if (v && v.key() < span.end)
+		return Optional<Key>();
+	return key;
+}
+
 ACTOR Future<Key> findKey( StorageServer* data, KeySelectorRef sel, Version version, KeyRange range, int* pOffset)
 // Attempts to find the key indicated by sel in the data at version, within range.
 // Precondition: selectorInRange(sel, range)
@@ -1119,6 +1647,17 @@ ACTOR Future<Key> findKey( StorageServer* data, KeySelectorRef sel, Version vers
 	state bool skipEqualKey = sel.orEqual == forward;
 	state int distance = forward ? sel.offset : 1-sel.offset;
 
+	if (distance >= SERVER_KNOBS->FIND_KEY_SKIP_DISTANCE) {
+		Optional<Key> skipKey = wait( findKeyByPosition( data, version, forward ? KeyRangeRef(skipEqualKey ? keyAfter(sel.getKey()) : sel.getKey(), range.end) :
+			KeyRangeRef(range.begin, skipEqualKey ? sel.getKey() : keyAfter(sel.getKey())), forward ? distance-1 : -distance ) );
+		if (skipKey.present()) {
+			TEST(true); // Key selector resolved by position in the storage engine
+			++data->counters.findKeySkips;
+			*pOffset = 0;
+			return skipKey.get();
+		}
+	}
+
 	//Don't limit the number of bytes if this is a trivial key selector (there will be at most two items returned from the read range in this case)
 	state int maxBytes;
 	if (sel.offset <= 1 && sel.offset >= 0)
@@ -1126,14 +1665,14 @@ ACTOR Future<Key> findKey( StorageServer* data, KeySelectorRef sel, Version vers
 	else
 		maxBytes = BUGGIFY ? SERVER_KNOBS->BUGGIFY_LIMIT_BYTES : SERVER_KNOBS->STORAGE_LIMIT_BYTES;
 
-	state GetKeyValuesReply rep = wait( readRange( data, version, forward ? KeyRangeRef(sel.getKey(), range.end) : KeyRangeRef(range.begin, keyAfter(sel.getKey())), (distance + skipEqualKey)*sign, &maxBytes ) );
+	state GetKeyValuesReply rep = wait( readRange( data, version, forward ? KeyRangeRef(sel.getKey(), range.end) : KeyRangeRef(range.begin, keyAfter(sel.getKey())), (distance + skipEqualKey)*sign, &maxBytes, 0 ) );
 	state bool more = rep.more && rep.data.size() != distance + skipEqualKey;
 
 	//If we get only one result in the reverse direction as a result of the data being too large, we could get stuck in a loop
 	if(more && !forward && rep.data.size() == 1) {
 		TEST(true); //Reverse key selector returned only one result in range read
 		maxBytes = std::numeric_limits<int>::max();
-		GetKeyValuesReply rep2 = wait( readRange( data, version, KeyRangeRef(range.begin, keyAfter(sel.getKey())), -2, &maxBytes ) );
+		GetKeyValuesReply rep2 = wait( readRange( data, version, KeyRangeRef(range.begin, keyAfter(sel.getKey())), -2, &maxBytes, 0 ) );
 		rep = rep2;
 		more = rep.more && rep.data.size() != distance + skipEqualKey;
 		ASSERT(rep.data.size() == 2 || !more);
@@ -1177,6 +1716,31 @@ KeyRange getShardKeyRange( StorageServer* data, const KeySelectorRef& sel )
 	return i->range();
 }
 
+// Samples the bytes a range read returned, so that data distribution can split read hot shards.  A read that returns
+// nothing still costs the storage server a seek, which is charged to the key it started at.  The hot range sampler
+// counts the read as one of the range it returned.
+void notifyBytesRead( StorageServer* data, VectorRef<KeyValueRef> const& rows, KeyRef begin ) {
+	StorageMetrics metrics;
+	if (!rows.size()) {
+		metrics.bytesReadPerKSecond = SERVER_KNOBS->EMPTY_READ_PENALTY;
+		data->metrics.notify(begin, metrics);
+		if( data->hotReads.sample() )
+			data->hotReads.add( singleKeyRange(begin), metrics.bytesReadPerKSecond );
+		return;
+	}
+	int64_t total = 0;
+	for(auto& kv : rows) {
+		metrics.bytesReadPerKSecond = std::max<int64_t>( kv.expectedSize(), SERVER_KNOBS->EMPTY_READ_PENALTY );
+		data->metrics.notify(kv.key, metrics);
+		total += metrics.bytesReadPerKSecond;
+	}
+	if( data->hotReads.sample() ) {
+		KeyRef first = std::min( rows[0].key, rows.back().key );  // Reverse reads return rows in descending order
+		KeyRef last = std::max( rows[0].key, rows.back().key );
+		data->hotReads.add( KeyRangeRef( first, keyAfter(last) ), total );
+	}
+}
+
 ACTOR Future<Void> getKeyValues( StorageServer* data, GetKeyValuesRequest req )
 // Throws a wrong_shard_server if the keys in the request or result depend on data outside this server OR if a large selector offset prevents
 // all data from being read in one range read
@@ -1240,40 +1804,402 @@ ACTOR Future<Void> getKeyValues( StorageServer* data, GetKeyValuesRequest req )
 			none.version = version;
 			none.more = false;
 			none.penalty = data->getPenalty();
+			none.queueDepth = data->readQueueDepth();
+
+			data->checkChangeCounter( changeCounter, KeyRangeRef( std::min<KeyRef>(req.begin.getKey(), req.end.getKey()), std::max<KeyRef>(req.begin.getKey(), req.end.getKey()) ) );
+			data->readReplyRate.addDelta(1);
+			req.reply.send( none );
+		} else {
+			state int remainingLimitBytes = req.limitBytes;
+
+			GetKeyValuesReply _r = wait( readRange(data, version, KeyRangeRef(begin, end), req.limit, &remainingLimitBytes, req.maxValueLength) );
+			GetKeyValuesReply r = _r;
+
+			if( req.debugID.present() )
+				g_traceBatch.addEvent("TransactionDebug", req.debugID.get().first(), "storageserver.getKeyValues.AfterReadRange");
+				//.detail("begin",printable(begin)).detail("end",printable(end)).detail("sizeOf",r.data.size());
+			data->checkChangeCounter( changeCounter, KeyRangeRef( std::min<KeyRef>(begin, std::min<KeyRef>(req.begin.getKey(), req.end.getKey())), std::max<KeyRef>(end, std::max<KeyRef>(req.begin.getKey(), req.end.getKey())) ) );
+			if (EXPENSIVE_VALIDATION) {
+				for (int i = 0; i < r.data.size(); i++)
+					ASSERT(r.data[i].key >= begin && r.data[i].key < end);
+				ASSERT(r.data.size() <= std::abs(req.limit));
+			}
+
+			/*for( int i = 0; i < r.data.size(); i++ ) {
+				StorageMetrics m;
+				m.bytesPerKSecond = r.data[i].expectedSize();
+				m.iosPerKSecond = 1; //FIXME: this should be 1/r.data.size(), but we cannot do that because it is an int
+				data->metrics.notify(r.data[i].key, m);
+			}*/
+			notifyBytesRead( data, r.data, req.begin.getKey() );
+			data->readReplyRate.addDelta(1);
+
+			r.penalty = data->getPenalty();
+			r.queueDepth = data->readQueueDepth();
+			req.reply.send( r );
+
+			data->counters.rowsQueried += r.data.size();
+			data->counters.bytesQueried += req.limitBytes - remainingLimitBytes;
+		}
+	} catch (Error& e) {
+		if (e.code() == error_code_internal_error || e.code() == error_code_actor_cancelled) throw;
+		req.reply.sendError(e);
+	}
+
+	++data->counters.finishedQueries;
+	--data->readQueueSizeMetric;
+
+	return Void();
+}
+
+ACTOR Future<GetKeyValuesReply> readKeyValuesStreamBatch( StorageServer* data, Reference<KeyValuesStream> stream, Future<GetKeyValuesReply> previous ) {
+	if (previous.isValid()) {
+		GetKeyValuesReply prev = wait( previous );
+		if (!prev.more) {
+			GetKeyValuesReply none;
+			none.version = stream->version;
+			none.more = false;
+			return none;
+		}
+	}
+	Void _ = wait( delay(0, TaskDefaultEndpoint) );
+
+	if (stream->version < data->oldestVersion.get())
+		throw transaction_too_old();
+
+	state KeyRange range = KeyRangeRef( stream->position, stream->keys.end );
+	state int remainingLimitBytes = stream->limitBytes;
+	GetKeyValuesReply r = wait( readRange( data, stream->version, range, stream->limit, &remainingLimitBytes ) );
+	data->checkChangeCounter( stream->changeCounter, range );
+
+	notifyBytesRead( data, r.data, range.begin );
+	if (r.data.size())
+		stream->position = keyAfter( r.data.end()[-1].key );
+	++data->counters.getRangeStreamBatches;
+	data->counters.rowsQueried += r.data.size();
+	data->counters.bytesQueried += stream->limitBytes - remainingLimitBytes;
+	return r;
+}
+
+ACTOR Future<Void> getKeyValuesStreamQ( StorageServer* data, GetKeyValuesStreamRequest req ) {
+	++data->counters.allQueries;
+	++data->readQueueSizeMetric;
+	data->maxQueryQueue = std::max<int>( data->maxQueryQueue, data->counters.allQueries.getValue() - data->counters.finishedQueries.getValue());
+
+	// Active load balancing runs at a very high priority (to obtain accurate queue lengths)
+	// so we need to downgrade here
+	Void _ = wait( delay(0, TaskDefaultEndpoint) );
+
+	try {
+		state Reference<KeyValuesStream> stream;
+		auto it = data->keyValuesStreams.find( req.streamID );
+		if (it != data->keyValuesStreams.end()) {
+			stream = it->second;
+		} else if (req.sequence == 0) {
+			++data->counters.getRangeQueries;
+			state Version version = wait( waitForVersion( data, req.version ) );
+			state uint64_t changeCounter = data->shardChangeCounter;
+			auto shard = data->shards.rangeContaining( req.keys.begin );
+			if (!shard->value()->isReadable() || req.keys.end > shard->range().end)
+				throw wrong_shard_server();
+
+			// Another request of this stream may have started it while we waited
+			auto it = data->keyValuesStreams.find( req.streamID );
+			if (it != data->keyValuesStreams.end()) {
+				stream = it->second;
+			} else {
+				stream = Reference<KeyValuesStream>( new KeyValuesStream( req, version, changeCounter ) );
+				data->keyValuesStreams[ req.streamID ] = stream;
+			}
+		} else {
+			// The stream has finished, failed or expired
+			throw timed_out();
+		}
+
+		stream->lastActive = now();
+		while (stream->nextSequence <= req.sequence) {
+			stream->lastBatch = readKeyValuesStreamBatch( data, stream, stream->lastBatch );
+			stream->batches[ stream->nextSequence++ ] = stream->lastBatch;
+		}
+		auto b = stream->batches.find( req.sequence );
+		if (b == stream->batches.end())
+			throw timed_out();  // This batch was already requested
+		state Future<GetKeyValuesReply> batch = b->second;
+		stream->batches.erase( b );
+
+		state GetKeyValuesReply r;
+		try {
+			GetKeyValuesReply _r = wait( batch );
+			r = _r;
+		} catch (Error& e) {
+			data->keyValuesStreams.erase( req.streamID );
+			throw;
+		}
+		if (!r.more)
+			data->keyValuesStreams.erase( req.streamID );
+
+		data->readReplyRate.addDelta(1);
+		r.penalty = data->getPenalty();
+		r.queueDepth = data->readQueueDepth();
+		req.reply.send( r );
+	} catch (Error& e) {
+		if (e.code() == error_code_internal_error || e.code() == error_code_actor_cancelled) throw;
+		req.reply.sendError(e);
+	}
+
+	++data->counters.finishedQueries;
+	--data->readQueueSizeMetric;
+
+	return Void();
+}
+
+ACTOR Future<Void> exportBackupRangeQ( StorageServer* data, ExportBackupRangeRequest req ) {
+	++data->counters.allQueries;
+	++data->readQueueSizeMetric;
+	data->maxQueryQueue = std::max<int>( data->maxQueryQueue, data->counters.allQueries.getValue() - data->counters.finishedQueries.getValue());
+
+	Void _ = wait( delay(0, TaskDefaultEndpoint) );
+
+	try {
+		Void _ = wait( data->exportBackupRangeLock.take() );
+		state FlowLock::Releaser holdingExportLock( data->exportBackupRangeLock );
+
+		state Version version = wait( waitForVersion( data, req.version ) );
+		state uint64_t changeCounter = data->shardChangeCounter;
+		auto shard = data->shards.rangeContaining( req.keys.begin );
+		if (!shard->value()->isReadable())
+			throw wrong_shard_server();
+
+		// Read everything before writing anything, so that writing the file can take longer than the MVCC window
+		state KeyRange keys = KeyRangeRef( req.keys.begin, std::min( req.keys.end, shard->range().end ) );
+		state int remainingLimitBytes = SERVER_KNOBS->BACKUP_EXPORT_RANGE_BYTES;
+		state GetKeyValuesReply r = wait( readRange( data, version, keys, std::numeric_limits<int>::max(), &remainingLimitBytes ) );
+		data->checkChangeCounter( changeCounter, keys );
+
+		state Key end = r.more ? keyAfter( r.data.end()[-1].key ) : keys.end;
+		TEST( end != req.keys.end ); // Backup range export stopped before the end of the request
+
+		Reference<IBackupContainer> bc = IBackupContainer::openContainer( req.containerURL );
+		Reference<IBackupFile> file = wait( writeBackupRangeFile( bc, version, req.blockSize, KeyRangeRef( keys.begin, end ), Standalone<VectorRef<KeyValueRef>>( r.data, r.arena ) ) );
+
+		ExportBackupRangeReply reply;
+		reply.fileName = file->getFileName();
+		reply.fileSize = file->size();
+		reply.end = end;
+		req.reply.send( reply );
+
+		++data->counters.backupRangesExported;
+		data->counters.backupBytesExported += SERVER_KNOBS->BACKUP_EXPORT_RANGE_BYTES - remainingLimitBytes;
+		data->counters.rowsQueried += r.data.size();
+		data->counters.bytesQueried += SERVER_KNOBS->BACKUP_EXPORT_RANGE_BYTES - remainingLimitBytes;
+	} catch (Error& e) {
+		if (e.code() == error_code_internal_error || e.code() == error_code_actor_cancelled) throw;
+		req.reply.sendError(e);
+	}
+
+	++data->counters.finishedQueries;
+	--data->readQueueSizeMetric;
+
+	return Void();
+}
+
+ACTOR Future<Void> getRangeAggregateQ( StorageServer* data, GetRangeAggregateRequest req ) {
+	++data->counters.getRangeAggregateQueries;
+	++data->counters.allQueries;
+	++data->readQueueSizeMetric;
+	data->maxQueryQueue = std::max<int>( data->maxQueryQueue, data->counters.allQueries.getValue() - data->counters.finishedQueries.getValue());
+
+	// Active load balancing runs at a very high priority (to obtain accurate queue lengths)
+	// so we need to downgrade here
+	Void _ = wait( delay(0, TaskDefaultEndpoint) );
+
+	try {
+		state Version version = wait( waitForVersion( data, req.version ) );
+		state uint64_t changeCounter = data->shardChangeCounter;
+		auto shard = data->shards.rangeContaining( req.keys.begin );
+		if (!shard->value()->isReadable())
+			throw wrong_shard_server();
+
+		// The values are read like those of a range read and dropped once they are counted
+		state KeyRange keys = KeyRangeRef( req.keys.begin, std::min( req.keys.end, shard->range().end ) );
+		state int remainingLimitBytes = SERVER_KNOBS->RANGE_AGGREGATE_BYTES;
+		GetKeyValuesReply r = wait( readRange( data, version, keys, std::numeric_limits<int>::max(), &remainingLimitBytes ) );
+		data->checkChangeCounter( changeCounter, keys );
+
+		GetRangeAggregateReply reply;
+		for(auto& kv : r.data)
+			reply.add( kv );
+		reply.end = r.more ? keyAfter( r.data.end()[-1].key ) : keys.end;
+		TEST( reply.end != req.keys.end ); // Range aggregate stopped before the end of the request
+		reply.penalty = data->getPenalty();
+		reply.queueDepth = data->readQueueDepth();
+		req.reply.send( reply );
+
+		data->counters.rowsQueried += reply.count;
+		data->counters.bytesQueried += reply.bytes;
+	} catch (Error& e) {
+		if (e.code() == error_code_internal_error || e.code() == error_code_actor_cancelled) throw;
+		req.reply.sendError(e);
+	}
+
+	++data->counters.finishedQueries;
+	--data->readQueueSizeMetric;
+
+	return Void();
+}
+
+// Appends to chunks the digests of data, which are the key values in keys, or the first of them if more.  The chunks of
+// equal data are equal, and a key whose hash is a multiple of chunkKeys ends a chunk whatever came before it, so the
+// chunks of data which differs in a few keys line up again after them unless chunkBytes cut one.  If more, the last
+// chunk is dropped unless it is the only one, since a longer read would have continued it.
+void digestRange( Arena& arena, VectorRef<RangeDigestRef>& chunks, KeyRangeRef keys, VectorRef<KeyValueRef> data, bool more, int chunkKeys, int chunkBytes ) {
+	RangeDigestRef chunk;
+	int firstChunk = chunks.size();
+	for(int i = 0; i < data.size(); i++) {
+		KeyValueRef const& kv = data[i];
+		uint64_t keyHash = xxhash64( kv.key.begin(), kv.key.size() );
+		chunk.digest = xxhash64( kv.value.begin(), kv.value.size(), chunk.digest * 31 + keyHash );
+		++chunk.count;
+		chunk.bytes += kv.key.size() + kv.value.size();
+		if( keyHash % std::max( chunkKeys, 1 ) == 0 || chunk.bytes >= chunkBytes ) {
+			chunk.end = keyAfter( kv.key, arena );
+			chunks.push_back( arena, chunk );
+			chunk = RangeDigestRef();
+		}
+	}
+	if( !more ) {
+		// The last chunk, even if empty, reaches the end of keys
+		if( chunk.count || chunks.size() == firstChunk ) {
+			chunk.end = keys.end;
+			chunks.push_back( arena, chunk );
+		} else {
+			chunks.back().end = keys.end;
+		}
+	} else if( chunks.size() == firstChunk && chunk.count ) {
+		chunk.end = keyAfter( data.end()[-1].key, arena );
+		chunks.push_back( arena, chunk );
+	}
+}
+
+ACTOR Future<Void> getRangeDigestQ( StorageServer* data, GetRangeDigestRequest req ) {
+	++data->counters.getRangeDigestQueries;
+	++data->counters.allQueries;
+	++data->readQueueSizeMetric;
+	data->maxQueryQueue = std::max<int>( data->maxQueryQueue, data->counters.allQueries.getValue() - data->counters.finishedQueries.getValue());
+
+	// Active load balancing runs at a very high priority (to obtain accurate queue lengths)
+	// so we need to downgrade here
+	Void _ = wait( delay(0, TaskDefaultEndpoint) );
+
+	try {
+		state Version version = wait( waitForVersion( data, req.version ) );
+		state uint64_t changeCounter = data->shardChangeCounter;
+		auto shard = data->shards.rangeContaining( req.keys.begin );
+		if (!shard->value()->isReadable())
+			throw wrong_shard_server();
+
+		// The values are read like those of a range read and dropped once they are digested
+		state KeyRange keys = KeyRangeRef( req.keys.begin, std::min( req.keys.end, shard->range().end ) );
+		state int remainingLimitBytes = SERVER_KNOBS->RANGE_DIGEST_BYTES;
+		GetKeyValuesReply r = wait( readRange( data, version, keys, std::numeric_limits<int>::max(), &remainingLimitBytes ) );
+		data->checkChangeCounter( changeCounter, keys );
+
+		GetRangeDigestReply reply;
+		digestRange( reply.arena, reply.chunks, keys, r.data, r.more, req.chunkKeys, req.chunkBytes );
+		TEST( reply.chunks.back().end != req.keys.end ); // Range digest stopped before the end of the request
+		reply.penalty = data->getPenalty();
+		reply.queueDepth = data->readQueueDepth();
+		req.reply.send( reply );
+
+		data->counters.rowsQueried += r.data.size();
+		data->counters.bytesQueried += SERVER_KNOBS->RANGE_DIGEST_BYTES - remainingLimitBytes;
+	} catch (Error& e) {
+		if (e.code() == error_code_internal_error || e.code() == error_code_actor_cancelled) throw;
+		req.reply.sendError(e);
+	}
+
+	++data->counters.finishedQueries;
+	--data->readQueueSizeMetric;
+
+	return Void();
+}
+
+// Appends to reply the mutations to range at versions in (begin, end] from the mutation log, and returns the version up to
+// which it has them all, which is less than end if they would not fit in limitBytes.  A version is never split.
+Version readChangeFeed( StorageServer* data, KeyRangeRef range, Version begin, Version end, int* limitBytes, ChangeFeedReply* reply ) {
+	auto const& mLog = data->getMutationLog();
+	for(auto u = mLog.upper_bound( begin ); u != mLog.end() && u->first <= end; ++u) {
+		int versionBytes = 0;
+		int firstMutation = reply->mutations.size();
+		for(auto& m : u->second.mutations) {
+			if (m.type == MutationRef::ClearRange) {
+				KeyRangeRef cleared = KeyRangeRef( m.param1, m.param2 ) & range;
+				if (cleared.empty()) continue;
+				reply->mutations.push_back( reply->arena, VersionedMutationRef( reply->arena, u->first, MutationRef( MutationRef::ClearRange, cleared.begin, cleared.end ) ) );
+			} else if (range.contains( m.param1 )) {
+				reply->mutations.push_back( reply->arena, VersionedMutationRef( reply->arena, u->first, m ) );
+			} else {
+				continue;
+			}
+			versionBytes += reply->mutations.back().expectedSize();
+		}
+		if (versionBytes > *limitBytes && firstMutation) {
+			// Leave this version for the next request
+			reply->mutations.resize( reply->arena, firstMutation );
+			return u->first - 1;
+		}
+		*limitBytes -= versionBytes;
+		if (*limitBytes <= 0)
+			return u->first;
+	}
+	return end;
+}
+
+ACTOR Future<Void> changeFeedQ( StorageServer* data, ChangeFeedRequest req ) {
+	++data->counters.changeFeedQueries;
+	++data->counters.allQueries;
+	++data->readQueueSizeMetric;
+	data->maxQueryQueue = std::max<int>( data->maxQueryQueue, data->counters.allQueries.getValue() - data->counters.finishedQueries.getValue());
 
-			data->checkChangeCounter( changeCounter, KeyRangeRef( std::min<KeyRef>(req.begin.getKey(), req.end.getKey()), std::max<KeyRef>(req.begin.getKey(), req.end.getKey()) ) );
-			data->readReplyRate.addDelta(1);
-			req.reply.send( none );
-		} else {
-			state int remainingLimitBytes = req.limitBytes;
+	Void _ = wait( delay(0, TaskDefaultEndpoint) );
 
-			GetKeyValuesReply _r = wait( readRange(data, version, KeyRangeRef(begin, end), req.limit, &remainingLimitBytes) );
-			GetKeyValuesReply r = _r;
+	try {
+		if (!allKeys.contains( req.range ))
+			throw wrong_shard_server();
 
-			if( req.debugID.present() )
-				g_traceBatch.addEvent("TransactionDebug", req.debugID.get().first(), "storageserver.getKeyValues.AfterReadRange");
-				//.detail("begin",printable(begin)).detail("end",printable(end)).detail("sizeOf",r.data.size());
-			data->checkChangeCounter( changeCounter, KeyRangeRef( std::min<KeyRef>(begin, std::min<KeyRef>(req.begin.getKey(), req.end.getKey())), std::max<KeyRef>(end, std::max<KeyRef>(req.begin.getKey(), req.end.getKey())) ) );
-			if (EXPENSIVE_VALIDATION) {
-				for (int i = 0; i < r.data.size(); i++)
-					ASSERT(r.data[i].key >= begin && r.data[i].key < end);
-				ASSERT(r.data.size() <= std::abs(req.limit));
-			}
+		state uint64_t changeCounter = data->shardChangeCounter;
+		auto shard = data->shards.rangeContaining( req.range.begin );
+		if (!shard->value()->isReadable() || !shard->range().contains( req.range ))
+			throw wrong_shard_server();
+		for(auto r : data->changeFeedStartVersion.intersectingRanges( req.range ))
+			if (req.begin < r.value())
+				throw transaction_too_old();
 
-			/*for( int i = 0; i < r.data.size(); i++ ) {
-				StorageMetrics m;
-				m.bytesPerKSecond = r.data[i].expectedSize();
-				m.iosPerKSecond = 1; //FIXME: this should be 1/r.data.size(), but we cannot do that because it is an int
-				data->metrics.notify(r.data[i].key, m);
-			}*/
-			data->readReplyRate.addDelta(1);
+		state double deadline = now() + SERVER_KNOBS->CHANGE_FEED_POLL_TIME;
+		state ChangeFeedReply reply;
+		state int remainingLimitBytes = SERVER_KNOBS->CHANGE_FEED_REPLY_BYTES;
+		state Version end = req.begin;
+		loop {
+			// The mutation log begins after durableVersion, and what we have read of it so far is in reply
+			if (end < data->oldestVersion.get() || end < data->durableVersion.get())
+				throw transaction_too_old();
+			data->checkChangeCounter( changeCounter, req.range );
 
-			r.penalty = data->getPenalty();
-			req.reply.send( r );
+			end = readChangeFeed( data, req.range, end, data->version.get(), &remainingLimitBytes, &reply );
+			if (reply.mutations.size() || now() >= deadline)
+				break;
 
-			data->counters.rowsQueried += r.data.size();
-			data->counters.bytesQueried += req.limitBytes - remainingLimitBytes;
+			choose {
+				when( Void _ = wait( data->version.whenAtLeast( end+1 ) ) ) {}
+				when( Void _ = wait( delayUntil( deadline ) ) ) {}
+			}
 		}
+
+		reply.version = end;
+		req.reply.send( reply );
+
+		data->counters.changeFeedMutations += reply.mutations.size();
+		data->counters.bytesQueried += SERVER_KNOBS->CHANGE_FEED_REPLY_BYTES - remainingLimitBytes;
 	} catch (Error& e) {
 		if (e.code() == error_code_internal_error || e.code() == error_code_actor_cancelled) throw;
 		req.reply.sendError(e);
@@ -1285,6 +2211,19 @@ ACTOR Future<Void> getKeyValues( StorageServer* data, GetKeyValuesRequest req )
 	return Void();
 }
 
+// Forgets streams which a client has stopped reading
+ACTOR Future<Void> expireKeyValuesStreams( StorageServer* data ) {
+	loop {
+		Void _ = wait( delay( SERVER_KNOBS->RANGE_STREAM_IDLE_TIMEOUT / 2 ) );
+		for(auto it = data->keyValuesStreams.begin(); it != data->keyValuesStreams.end(); ) {
+			if (now() - it->second->lastActive > SERVER_KNOBS->RANGE_STREAM_IDLE_TIMEOUT)
+				data->keyValuesStreams.erase( it++ );
+			else
+				++it;
+		}
+	}
+}
+
 ACTOR Future<Void> getKey( StorageServer* data, GetKeyRequest req ) {
 	++data->counters.getKeyQueries;
 	++data->counters.allQueries;
@@ -1318,6 +2257,7 @@ ACTOR Future<Void> getKey( StorageServer* data, GetKeyRequest req ) {
 
 		GetKeyReply reply(updated);
 		reply.penalty = data->getPenalty();
+		reply.queueDepth = data->readQueueDepth();
 		req.reply.send(reply);
 	}
 	catch (Error& e) {
@@ -1343,6 +2283,13 @@ void getQueuingMetrics( StorageServer* self, StorageQueuingMetricsRequest const&
 	reply.storageBytes = self->storage.getStorageBytes();
 
 	reply.v = self->version.get();
+	reply.durableVersion = self->durableVersion.get();
+
+	// The CPU time of a simulated process is that of the whole simulation and differs from run to run, so simulated
+	// servers report none rather than make data distribution nondeterministic
+	if (!g_network->isSimulated())
+		self->processCPUSeconds.setTotal( getProcessorTimeProcess() );
+	reply.cpuUsage = self->processCPUSeconds.smoothRate();
 	req.reply.send( reply );
 }
 
@@ -1351,8 +2298,28 @@ void getQueuingMetrics( StorageServer* self, StorageQueuingMetricsRequest const&
 /////////////////////////// Updates ////////////////////////////////
 #pragma region Updates
 
+// Drops the atomic op keys whose old values expandMutation() will take from versionedData, so that they are not read from
+// storage. An entry inserted after storageVersion() stays in the latest version until the batch has been applied, because
+// changeDurableVersion() cannot remove it while update() holds durableVersionLock. Batches with private mutations, which
+// can roll back or remove data, are left alone.
+void skipEagerReadsInMemory( StorageServer* data, UpdateEagerReadInfo* eager ) {
+	auto const& latest = data->data().atLatest();
+	Version storageVersion = data->storageVersion();
+	int kept = 0;
+	for(auto& k : eager->keys) {
+		auto it = latest.lastLessOrEqual(k.first);
+		bool inMemory = it != latest.end() && it.insertVersion() > storageVersion &&
+			( (it->isValue() && it.key() == k.first) || (it->isClearTo() && it->getEndKey() > k.first) );
+		if (!inMemory)
+			eager->keys[kept++] = k;
+	}
+	data->counters.eagerReadsFromMemory += eager->keys.size() - kept;
+	eager->keys.resize(kept);
+}
+
 ACTOR Future<Void> doEagerReads( StorageServer* data, UpdateEagerReadInfo* eager ) {
 	eager->finishKeyBegin();
+	data->counters.eagerReads += eager->keyBegin.size() + eager->keys.size();
 
 	vector<Future<Key>> keyEnd( eager->keyBegin.size() );
 	for(int i=0; i<keyEnd.size(); i++)
@@ -1360,11 +2327,7 @@ ACTOR Future<Void> doEagerReads( StorageServer* data, UpdateEagerReadInfo* eager
 
 	state Future<vector<Key>> futureKeyEnds = getAll(keyEnd);
 
-	vector<Future<Optional<Value>>> value( eager->keys.size() );
-	for(int i=0; i<value.size(); i++)
-		value[i] = data->storage.readValuePrefix( eager->keys[i].first, eager->keys[i].second );
-
-	state Future<vector<Optional<Value>>> futureValues = getAll(value);
+	state Future<vector<Optional<Value>>> futureValues = data->storage.readValues( eager->keys );
 	state vector<Key> keyEndVal = wait( futureKeyEnds );
 	vector<Optional<Value>> optionalValues = wait ( futureValues);
 
@@ -1514,6 +2477,17 @@ bool expandMutation( MutationRef& m, StorageServer::VersionedData const& data, U
 				oldVal = oldThing.get();
 		}
 
+		if (m.type == MutationRef::SetIfAbsent || m.type == MutationRef::CompareAndSet) {
+			Optional<ValueRef> newVal = m.type == MutationRef::SetIfAbsent ? doSetIfAbsent(oldVal, m.param2, ar) : doCompareAndSet(oldVal, m.param2, ar);
+			if (newVal == oldVal) {
+				TEST(true); // Conditional mutation not applied
+				return false;
+			}
+			m.param2 = newVal.get();
+			m.type = MutationRef::SetValue;
+			return true;
+		}
+
 		switch(m.type) {
 			case MutationRef::AddValue:
 				m.param2 = doLittleEndianAdd(oldVal, m.param2, ar);
@@ -1567,6 +2541,8 @@ void applyMutation( StorageServer *self, MutationRef const& m, Arena& arena, Sto
 	metrics.bytesPerKSecond = mvccStorageBytes( m ) / 2;
 	metrics.iosPerKSecond = 1;
 	self->metrics.notify(m.param1, metrics);
+	if( self->hotWrites.sample() )
+		self->hotWrites.add( m.type == MutationRef::ClearRange ? KeyRange( KeyRangeRef(m.param1, m.param2) ) : singleKeyRange(m.param1), mvccStorageBytes( m ) );
 
 	if (m.type == MutationRef::SetValue) {
 		auto prev = data.atLatest().lastLessOrEqual(m.param1);
@@ -1721,6 +2697,49 @@ ACTOR Future<Standalone<RangeResultRef>> tryGetRange( Database cx, Version versi
 	}
 }
 
+// Like tryGetRange, but reads the block with a range stream from one of the servers of the source team, which keeps
+// several replies in flight rather than waiting for each one before asking for the next
+ACTOR Future<Standalone<RangeResultRef>> tryGetRangeStream( Database cx, Version version, KeyRangeRef keys, int limitBytes, bool* isTooOld ) {
+	state Transaction tr( cx );
+	state PromiseStream<Standalone<RangeResultRef>> results;
+	state Future<Void> stream;
+	state Standalone<RangeResultRef> output;
+
+	if( *isTooOld )
+		throw transaction_too_old();
+
+	tr.setVersion( version );
+	stream = tr.getRangeStream( results, keys, true );
+
+	try {
+		loop {
+			Standalone<RangeResultRef> rep = waitNext( results.getFuture() );
+			output.arena().dependsOn( rep.arena() );
+			output.append( output.arena(), rep.begin(), rep.size() );
+			if( output.expectedSize() >= limitBytes ) {
+				output.more = true;
+				return output;
+			}
+		}
+	} catch( Error &e ) {
+		if( e.code() == error_code_end_of_stream ) {
+			output.more = false;
+			return output;
+		}
+		// Unlike a load balanced read, a stream does not move on to another replica when its server is behind
+		bool retryable = e.code() == error_code_transaction_too_old || e.code() == error_code_future_version || e.code() == error_code_process_behind;
+		if( retryable && e.code() == error_code_transaction_too_old )
+			*isTooOld = true;
+		if( retryable && output.size() ) {
+			output.more = true;
+			return output;
+		}
+		if( e.code() == error_code_process_behind )
+			throw future_version();
+		throw;
+	}
+}
+
 template <class T>
 void addMutation( T& target, Version version, MutationRef const& mutation ) {
 	target.addMutation( version, mutation );
@@ -1814,7 +2833,9 @@ ACTOR Future<Void> fetchKeys( StorageServer *data, AddingShard* shard ) {
 			try {
 				TEST(true);		// Fetching keys for transferred shard
 
-				state Standalone<RangeResultRef> this_block = wait( tryGetRange( data->cx, fetchVersion, keys, GetRangeLimits( CLIENT_KNOBS->ROW_LIMIT_UNLIMITED, fetchBlockBytes ), &isTooOld ) );
+				state Standalone<RangeResultRef> this_block = wait( SERVER_KNOBS->FETCH_KEYS_USE_RANGE_STREAM ?
+					tryGetRangeStream( data->cx, fetchVersion, keys, fetchBlockBytes, &isTooOld ) :
+					tryGetRange( data->cx, fetchVersion, keys, GetRangeLimits( CLIENT_KNOBS->ROW_LIMIT_UNLIMITED, fetchBlockBytes ), &isTooOld ) );
 
 				int expectedSize = (int)this_block.expectedSize() + (8-(int)sizeof(KeyValueRef))*this_block.size();
 
@@ -1972,6 +2993,7 @@ ACTOR Future<Void> fetchKeys( StorageServer *data, AddingShard* shard ) {
 
 		ASSERT( data->shards[shard->keys.begin]->assigned() && data->shards[shard->keys.begin]->keys == shard->keys );  // We aren't changing whether the shard is assigned
 		data->newestAvailableVersion.insert(shard->keys, latestVersion);
+		data->changeFeedStartVersion.insert(shard->keys, data->version.get());
 		shard->readWrite.send(Void());
 		data->addShard( ShardInfo::newReadWrite(shard->keys, data) );   // invalidates shard!
 		coalesceShards(data, keys);
@@ -2227,9 +3249,53 @@ bool containsRollback( VersionUpdateRef const& changes, Version& rollbackVersion
 
 class StorageUpdater {
 public:
-	StorageUpdater(Version fromVersion, Version newOldestVersion, Version restoredVersion) : fromVersion(fromVersion), newOldestVersion(newOldestVersion), currentVersion(fromVersion), restoredVersion(restoredVersion), processedStartKey(false) {}
+	StorageUpdater(Version fromVersion, Version newOldestVersion, Version restoredVersion) : fromVersion(fromVersion), newOldestVersion(newOldestVersion), currentVersion(fromVersion), restoredVersion(restoredVersion), processedStartKey(false), hasPendingAdd(false) {}
 
+	// Consecutive adds of the same size to the same key at the same version, as a counter gets from the transactions of a
+	// commit batch, are applied as one add of their sum, so that the key is read, written and versioned only once.  m must
+	// stay valid until the next call to applyMutation() or flush().
 	void applyMutation(StorageServer* data, MutationRef const& m, Version ver) {
+		if (hasPendingAdd) {
+			if (m.type == MutationRef::AddValue && ver == pendingAddVersion && m.param1 == pendingAdd.param1 && m.param2.size() == pendingAdd.param2.size()) {
+				pendingAdd.param2 = doLittleEndianAdd( pendingAdd.param2, m.param2, pendingAddArena );
+				++data->counters.atomicAddsCombined;
+				return;
+			}
+			flush(data);
+		}
+		if (m.type == MutationRef::AddValue && m.param2.size() && !m.param1.startsWith( systemKeys.end ) && SERVER_KNOBS->STORAGE_COMBINE_ATOMIC_ADDS) {
+			pendingAdd = m;
+			pendingAddVersion = ver;
+			hasPendingAdd = true;
+			return;
+		}
+		applyMutationNow(data, m, ver);
+	}
+
+	// Applies the add held back by applyMutation(), if any
+	void flush(StorageServer* data) {
+		if (hasPendingAdd) {
+			hasPendingAdd = false;
+			applyMutationNow(data, pendingAdd, pendingAddVersion);
+		}
+	}
+
+	Version newOldestVersion;
+	Version currentVersion;
+private:
+	Version fromVersion;
+	Version restoredVersion;
+
+	KeyRef startKey;
+	bool nowAssigned;
+	bool processedStartKey;
+
+	bool hasPendingAdd;
+	MutationRef pendingAdd;
+	Version pendingAddVersion;
+	Arena pendingAddArena;
+
+	void applyMutationNow(StorageServer* data, MutationRef const& m, Version ver) {
 		//TraceEvent("SSNewVersion", data->thisServerID).detail("VerWas", data->mutableData().latestVersion).detail("ChVer", ver);
 
 		if(currentVersion != ver) {
@@ -2253,16 +3319,6 @@ public:
 		if (data->otherError.getFuture().isReady()) data->otherError.getFuture().get();
 	}
 
-	Version newOldestVersion;
-	Version currentVersion;
-private:
-	Version fromVersion;
-	Version restoredVersion;
-
-	KeyRef startKey;
-	bool nowAssigned;
-	bool processedStartKey;
-
 	void applyPrivateData( StorageServer* data, MutationRef const& m ) {
 		TraceEvent(SevDebug, "SSPrivateMutation", data->thisServerID).detail("Mutation", m.toString());
 
@@ -2324,6 +3380,10 @@ ACTOR Future<Void> update( StorageServer* data, bool* pReceivedUpdate )
 	try {
 		// If we are disk bound and durableVersion is very old, we need to block updates or we could run out of memory
 		// This is often referred to as the storage server e-brake (emergency brake)
+		// While it is on, the versions we have not pulled stay in the TLogs, which spill them to disk and keep them readable
+		// for us, so the MVCC window we hold in memory is bounded by STORAGE_HARD_LIMIT_BYTES.  Reads at those versions get
+		// process_behind, which load balancing retries on another replica, and Ratekeeper ignores up to
+		// MAX_MACHINES_FALLING_BEHIND zones of lagging storage servers, so one slow disk costs read latency, not throughput.
 		state double waitStartT = 0;
 		while ( data->queueSize() >= SERVER_KNOBS->STORAGE_HARD_LIMIT_BYTES && data->durableVersion.get() < data->desiredOldestVersion.get() )
 		{
@@ -2335,6 +3395,7 @@ ACTOR Future<Void> update( StorageServer* data, bool* pReceivedUpdate )
 			}
 
 			data->behind = true;
+			++data->counters.eBrakeWaits;
 			Void _ = wait( delayJittered(.005, TaskTLogPeekReply) );
 		}
 
@@ -2371,6 +3432,7 @@ ACTOR Future<Void> update( StorageServer* data, bool* pReceivedUpdate )
 			bool epochEnd = false;
 			bool hasPrivateData = false;
 			bool firstMutation = true;
+			bool anyPrivateMutations = false;
 			bool dbgLastMessageWasProtocol = false;
 
 			Reference<ILogSystem::IPeekCursor> cloneCursor1 = cursor->cloneNoMore();
@@ -2391,8 +3453,11 @@ ACTOR Future<Void> update( StorageServer* data, bool* pReceivedUpdate )
 					MutationRef msg;
 					cloneReader >> msg;
 
-					if (firstMutation && msg.param1.startsWith(systemKeys.end))
-						hasPrivateData = true;
+					if (msg.param1.startsWith(systemKeys.end)) {
+						if (firstMutation)
+							hasPrivateData = true;
+						anyPrivateMutations = true;
+					}
 					firstMutation = false;
 
 					if (msg.param1 == lastEpochEndPrivateKey) {
@@ -2416,6 +3481,9 @@ ACTOR Future<Void> update( StorageServer* data, bool* pReceivedUpdate )
 			for(auto& c : fii.changes)
 				eager.addMutations(c.mutations);
 
+			if (SERVER_KNOBS->STORAGE_EAGER_READS_FROM_MEMORY && !anyPrivateMutations && !epochEnd)
+				skipEagerReadsInMemory( data, &eager );
+
 			Void _ = wait( doEagerReads( data, &eager ) );
 			if (data->shardChangeCounter == changeCounter) break;
 			TEST(true); // A fetchKeys completed while we were doing this, so eager might be outdated.  Read it again.
@@ -2479,6 +3547,7 @@ ACTOR Future<Void> update( StorageServer* data, bool* pReceivedUpdate )
 					TraceEvent(SevError, "DiscardingPeekedData", data->thisServerID).detail("Mutation", msg.toString()).detail("Version", cloneCursor2->version().toString());
 			}
 		}
+		updater.flush(data);
 
 		if(ver != invalidVersion) data->lastVersionWithData = ver;
 		ver = cloneCursor2->version().version - 1;
@@ -2533,10 +3602,41 @@ ACTOR Future<Void> update( StorageServer* data, bool* pReceivedUpdate )
 	}
 }
 
+// Finishes a commit of the storage engine which made newDurableVersion durable
+ACTOR Future<Void> updateDurableVersion( StorageServer* data, Version newDurableVersion ) {
+	debug_advanceMinCommittedVersion( data->thisServerID, newDurableVersion );
+
+	// Taking and releasing the durableVersionLock ensures that no eager reads both begin before the commit was effective and
+	// are applied after we change the durable version.
+	Void _ = wait( data->durableVersionLock.take() );
+	data->durableVersionLock.release();
+
+	Void _ = wait( delay(0, TaskUpdateStorage) );
+
+	data->popVersion( data->durableVersion.get() + 1 );
+
+	while (!changeDurableVersion( data, newDurableVersion )) {
+		Void _ = wait( yield(TaskUpdateStorage) );
+	}
+
+	TraceEvent("StorageServerDurable", data->thisServerID).detail("Version", newDurableVersion);
+	return Void();
+}
+
 ACTOR Future<Void> updateStorage(StorageServer* data) {
+	// When a batch fills STORAGE_COMMIT_BYTES, the next one is written to the engine while the batch's commit is in flight
+	// (STORAGE_COMMIT_PIPELINED), and is committed as soon as the first commit is durable.  The engine queues writes behind
+	// an outstanding commit, and storage may be ahead of durableVersion (see the invariants of versionedData), so a
+	// write-heavy server then waits only for its disk rather than for the disk and the writes to the engine in turn.
+	state Future<Void> durable;  // The commit in flight, which makes durableTarget durable
+	state Version durableTarget = invalidVersion;
+	state Future<Void> durableDelay = Void();
 	loop {
-		ASSERT( data->durableVersion.get() == data->storageVersion() );
-		Void _ = wait( data->desiredOldestVersion.whenAtLeast( data->storageVersion()+1 ) );
+		if (!durable.isValid()) {
+			ASSERT( data->durableVersion.get() == data->storageVersion() );
+			Void _ = wait( durableDelay );
+			Void _ = wait( data->desiredOldestVersion.whenAtLeast( data->storageVersion()+1 ) );
+		}
 		Void _ = wait( delay(0, TaskUpdateStorage) );
 
 		state Version startOldestVersion = data->storageVersion();
@@ -2557,33 +3657,31 @@ ACTOR Future<Void> updateStorage(StorageServer* data) {
 		if (startOldestVersion != newOldestVersion)
 			data->storage.makeVersionDurable( newOldestVersion );
 
+		// Commits are made one at a time, so that the durable version advances in order
+		if (durable.isValid()) {
+			Void _ = wait( durable );
+			durable = Future<Void>();
+			Void _ = wait( updateDurableVersion( data, durableTarget ) );
+			if (newOldestVersion == durableTarget) {
+				TEST(true);  // Nothing to write while a storage commit was in flight
+				continue;
+			}
+			TEST(true);  // Storage commit pipelined behind the previous one
+		}
+
 		debug_advanceMaxCommittedVersion( data->thisServerID, newOldestVersion );
-		state Future<Void> durable = data->storage.commit();
-		state Future<Void> durableDelay = Void();
+		durable = data->storage.commit();
+		durableTarget = newOldestVersion;
+		durableDelay = Void();
 
 		if (bytesLeft > 0)
 			durableDelay = delay(SERVER_KNOBS->STORAGE_COMMIT_INTERVAL);
 
-		Void _ = wait( durable );
-
-		debug_advanceMinCommittedVersion( data->thisServerID, newOldestVersion );
-
-		// Taking and releasing the durableVersionLock ensures that no eager reads both begin before the commit was effective and
-		// are applied after we change the durable version.
-		Void _ = wait( data->durableVersionLock.take() );
-		data->durableVersionLock.release();
-
-		Void _ = wait( delay(0, TaskUpdateStorage) );
-
-		data->popVersion( data->durableVersion.get() + 1 );
-
-		while (!changeDurableVersion( data, newOldestVersion )) {
-			Void _ = wait( yield(TaskUpdateStorage) );
+		if (bytesLeft > 0 || !SERVER_KNOBS->STORAGE_COMMIT_PIPELINED) {
+			Void _ = wait( durable );
+			durable = Future<Void>();
+			Void _ = wait( updateDurableVersion( data, durableTarget ) );
 		}
-
-		TraceEvent("StorageServerDurable", data->thisServerID).detail("Version", newOldestVersion);
-
-		Void _ = wait( durableDelay );
 	}
 }
 
@@ -2596,7 +3694,9 @@ ACTOR Future<Void> updateStorage(StorageServer* data) {
 
 // Immutable
 static const KeyValueRef persistFormat( LiteralStringRef( PERSIST_PREFIX "Format" ), LiteralStringRef("FoundationDB/StorageServer/1/4") );
-static const KeyRangeRef persistFormatReadableRange( LiteralStringRef("FoundationDB/StorageServer/1/2"), LiteralStringRef("FoundationDB/StorageServer/1/5") );
+// Stores created with value compression use a later format, so that versions which cannot decode their values refuse them
+static const KeyValueRef persistFormatCompressedValues( persistFormat.key, LiteralStringRef("FoundationDB/StorageServer/1/5") );
+static const KeyRangeRef persistFormatReadableRange( LiteralStringRef("FoundationDB/StorageServer/1/2"), LiteralStringRef("FoundationDB/StorageServer/1/6") );
 static const KeyRef persistID = LiteralStringRef( PERSIST_PREFIX "ID" );
 
 // (Potentially) change with the durable version or when fetchKeys completes
@@ -2609,7 +3709,12 @@ static const KeyRef persistLogProtocol = LiteralStringRef(PERSIST_PREFIX "LogPro
 // data keys are unmangled (but never start with PERSIST_PREFIX because they are always in allKeys)
 
 void StorageServerDisk::makeNewStorageServerDurable() {
-	storage->set( persistFormat );
+	if (SERVER_KNOBS->STORAGE_VALUE_COMPRESSION) {
+		storage->set( persistFormatCompressedValues );
+		enableValueCompression();
+	} else {
+		storage->set( persistFormat );
+	}
 	storage->set( KeyValueRef(persistID, BinaryWriter::toValue(data->thisServerID, Unversioned())) );
 	storage->set( KeyValueRef(persistVersion, BinaryWriter::toValue(data->version.get(), Unversioned())) );
 	storage->set( KeyValueRef(persistShardAssignedKeys.begin.toString(), LiteralStringRef("0")) );
@@ -2651,18 +3756,33 @@ void setAssignedStatus( StorageServer* self, KeyRangeRef keys, bool nowAssigned
 }
 
 void StorageServerDisk::clearRange( KeyRangeRef keys ) {
+	data->hotKeyCache.invalidate( keys );
 	storage->clear(keys);
 }
 
+void StorageServerDisk::set( KeyValueRef kv ) {
+	if (compressValues && !kv.key.startsWith( LiteralStringRef(PERSIST_PREFIX) )) {
+		Arena arena;
+		storage->set( KeyValueRef( kv.key, encodeStoredValue( arena, kv.value ) ) );
+	} else {
+		storage->set( kv );
+	}
+}
+
 void StorageServerDisk::writeKeyValue( KeyValueRef kv ) {
-	storage->set( kv );
+	data->hotKeyCache.invalidate( kv.key );
+	data->addKeyToFilter( kv.key );
+	set( kv );
 }
 
 void StorageServerDisk::writeMutation( MutationRef mutation ) {
 	// FIXME: debugMutation(debugContext, debugVersion, *m);
 	if (mutation.type == MutationRef::SetValue) {
-		storage->set( KeyValueRef(mutation.param1, mutation.param2) );
+		data->hotKeyCache.invalidate( mutation.param1 );
+		data->addKeyToFilter( mutation.param1 );
+		set( KeyValueRef(mutation.param1, mutation.param2) );
 	} else if (mutation.type == MutationRef::ClearRange) {
+		data->hotKeyCache.invalidate( KeyRangeRef(mutation.param1, mutation.param2) );
 		storage->clear( KeyRangeRef(mutation.param1, mutation.param2) );
 	} else
 		ASSERT(false);
@@ -2672,8 +3792,11 @@ void StorageServerDisk::writeMutations( MutationListRef mutations, Version debug
 	for(auto m = mutations.begin(); m; ++m) {
 		debugMutation(debugContext, debugVersion, *m);
 		if (m->type == MutationRef::SetValue) {
-			storage->set( KeyValueRef(m->param1, m->param2) );
+			data->hotKeyCache.invalidate( m->param1 );
+			data->addKeyToFilter( m->param1 );
+			set( KeyValueRef(m->param1, m->param2) );
 		} else if (m->type == MutationRef::ClearRange) {
+			data->hotKeyCache.invalidate( KeyRangeRef(m->param1, m->param2) );
 			storage->clear( KeyRangeRef(m->param1, m->param2) );
 		}
 	}
@@ -2716,6 +3839,7 @@ ACTOR Future<Void> applyByteSampleResult( StorageServer* data, KeyRange range, F
 		KeyRef key = bs[j].key.removePrefix(persistByteSampleKeys.begin);
 		if(!data->byteSampleClears.rangeContaining(key).value()) {
 			data->metrics.byteSample.sample.insert( key, BinaryReader::fromStringRef<int32_t>(bs[j].value, Unversioned()), false );
+			data->addToByteSampleFilter( key );
 		}
 	}
 	data->byteSampleClears.insert(range, true);
@@ -2724,9 +3848,19 @@ ACTOR Future<Void> applyByteSampleResult( StorageServer* data, KeyRange range, F
 	return Void();
 }
 
+ACTOR Future<Void> restoreByteSampleRange( StorageServer* data, IKeyValueStore* storage, KeyRange sampleRange, KeyRange range, Reference<FlowLock> readLock ) {
+	Void _ = wait( readLock->take() );
+	state FlowLock::Releaser releaser( *readLock );
+	Void _ = wait( applyByteSampleResult(data, range, storage->readRange( sampleRange )) );
+	return Void();
+}
+
 ACTOR Future<Void> restoreByteSample(StorageServer* data, IKeyValueStore* storage, Standalone<VectorRef<KeyValueRef>> bsSample) {
 	Void _ = wait( delay( BUGGIFY ? g_random->random01() * 2.0 : 0.0001 ) );
 
+	// The storage server serves reads while the byte sample is restored, so only a few of its chunks are read at a time
+	state Reference<FlowLock> readLock( new FlowLock( SERVER_KNOBS->BYTE_SAMPLE_RECOVERY_PARALLELISM ) );
+	state double start = now();
 	TraceEvent("RecoveredByteSampleSample", data->thisServerID).detail("Keys", bsSample.size()).detail("ReadBytes", bsSample.expectedSize());
 
 	size_t bytes_per_fetch = 0;
@@ -2744,17 +3878,17 @@ ACTOR Future<Void> restoreByteSample(StorageServer* data, IKeyValueStore* storag
 			accumulatedSize = 0;
 			Key realKey = it->key.removePrefix( prefix );
 			KeyRange sampleRange = KeyRangeRef( lastStart, realKey );
-			sampleRanges.push_back( applyByteSampleResult(data, sampleRange.removePrefix(persistByteSampleKeys.begin), storage->readRange( sampleRange )) );
+			sampleRanges.push_back( restoreByteSampleRange(data, storage, sampleRange, sampleRange.removePrefix(persistByteSampleKeys.begin), readLock) );
 			lastStart = realKey;
 		}
 		accumulatedSize += BinaryReader::fromStringRef<int32_t>(it->value, Unversioned());
 	}
 	// make sure that the last range goes all the way to the end of the byte sample
 	KeyRange sampleRange = KeyRangeRef( lastStart, LiteralStringRef( PERSIST_PREFIX "BS0" ));
-	sampleRanges.push_back( applyByteSampleResult(data, KeyRangeRef(lastStart.removePrefix(persistByteSampleKeys.begin), LiteralStringRef("\xff\xff\xff")), storage->readRange( sampleRange )) );
+	sampleRanges.push_back( restoreByteSampleRange(data, storage, sampleRange, KeyRangeRef(lastStart.removePrefix(persistByteSampleKeys.begin), LiteralStringRef("\xff\xff\xff")), readLock) );
 
 	Void _ = wait( waitForAll( sampleRanges ) );
-	TraceEvent("RecoveredByteSampleChunkedRead", data->thisServerID).detail("Ranges",sampleRanges.size());
+	TraceEvent("RecoveredByteSampleChunkedRead", data->thisServerID).detail("Ranges",sampleRanges.size()).detail("Duration", now() - start);
 
 	if( BUGGIFY )
 		Void _ = wait( delay( g_random->random01() * 10.0 ) );
@@ -2788,6 +3922,8 @@ ACTOR Future<bool> restoreDurableState( StorageServer* data, IKeyValueStore* sto
 		TraceEvent(SevError, "UnsupportedDBFormat").detail("Format", fFormat.get().get().toString()).detail("Expected", persistFormat.value.toString());
 		throw worker_recovery_failed();
 	}
+	if (fFormat.get().get() == persistFormatCompressedValues.value)
+		data->storage.enableValueCompression();
 	data->thisServerID = BinaryReader::fromStringRef<UID>(fID.get().get(), Unversioned());
 	data->sk = serverKeysPrefixFor( data->thisServerID ).withPrefix(systemKeys.begin);  // FFFF/serverKeys/[this server]/
 
@@ -2892,11 +4028,12 @@ void StorageServer::byteSampleApplySet( KeyValueRef kv, Version ver ) {
 	int64_t delta = 0;
 	const KeyRef key = kv.key;
 
-	auto old = byteSample.find(key);
+	auto old = byteSampleMayContain(key) ? byteSample.find(key) : byteSample.end();
 	if (old != byteSample.end()) delta = -byteSample.getMetric(old);
 	if (sampleInfo.inSample) {
 		delta += sampleInfo.sampledSize;
 		byteSample.insert( key, sampleInfo.sampledSize );
+		if (old == byteSample.end()) addToByteSampleFilter( key );
 		addMutationToMutationLogOrStorage( ver, MutationRef(MutationRef::SetValue, key.withPrefix(persistByteSampleKeys.begin), BinaryWriter::toValue( sampleInfo.sampledSize, Unversioned() )) );
 	} else {
 		bool any = old != byteSample.end();
@@ -3036,18 +4173,124 @@ Future<Void> StorageServerMetrics::waitMetrics(WaitMetricsRequest req, Future<Vo
 	return ::waitMetrics(this, req, delay);
 }
 
+// Answers the waits of a subscription, which may number in the thousands, by checking them every
+// STORAGE_METRICS_BATCH_POLL_DELAY rather than registering each in waitMetricsMap
+ACTOR Future<Void> waitMetricsBatch( StorageServer* self, WaitMetricsBatchRequest req ) {
+	state Reference<MetricsSubscription> sub;
+	auto it = self->metricsSubscriptions.find( req.subscription );
+	if (it != self->metricsSubscriptions.end()) {
+		sub = it->second;
+		if (req.replace)
+			sub->waits.clear();
+	} else if (req.replace) {
+		sub = Reference<MetricsSubscription>( new MetricsSubscription );
+		self->metricsSubscriptions[ req.subscription ] = sub;
+	} else {
+		TEST( true ); // waitMetricsBatch for a forgotten subscription
+		WaitMetricsBatchReply reply;
+		reply.lost = true;
+		req.reply.send( reply );
+		return Void();
+	}
+
+	sub->superseded.send( Void() );
+	sub->superseded = Promise<Void>();
+	state Future<Void> superseded = sub->superseded.getFuture();
+
+	for(auto id : req.remove)
+		sub->waits.erase( id );
+	for(auto& w : req.add) {
+		auto& entry = sub->waits[ w.id ];
+		entry.keys = w.keys;
+		entry.min = w.min;
+		entry.max = w.max;
+		entry.timeout = now() + SERVER_KNOBS->STORAGE_METRIC_TIMEOUT * (0.9 + 0.2 * g_random->random01());
+	}
+
+	++sub->outstanding;
+	state WaitMetricsBatchReply reply;
+	try {
+		Void _ = wait( self->byteSampleRecovery || superseded );
+		loop {
+			if (!self->byteSampleRecovery.isReady())
+				break;
+			for(auto w = sub->waits.begin(); w != sub->waits.end(); ) {
+				if (!self->isReadable( w->second.keys )) {
+					TEST( true ); // waitMetricsBatch wrong_shard_server()
+					reply.notReadable.push_back( w->first );
+					sub->waits.erase( w++ );
+					continue;
+				}
+				StorageMetrics metrics = self->metrics.getMetrics( w->second.keys );
+				if ( !w->second.min.allLessOrEqual( metrics ) || !metrics.allLessOrEqual( w->second.max ) || now() >= w->second.timeout ) {
+					reply.changed.push_back( std::make_pair( w->first, metrics ) );
+					sub->waits.erase( w++ );
+				} else
+					++w;
+			}
+			if (reply.changed.size() || reply.notReadable.size() || superseded.isReady())
+				break;
+			Void _ = wait( delay( SERVER_KNOBS->STORAGE_METRICS_BATCH_POLL_DELAY, TaskDataDistribution ) || superseded );
+		}
+	} catch (Error& e) {
+		--sub->outstanding;
+		throw;
+	}
+
+	TEST( superseded.isReady() ); // waitMetricsBatch superseded
+	--sub->outstanding;
+	sub->lastActive = now();
+	req.reply.send( reply );
+	return Void();
+}
+
+// Forgets subscriptions whose subscriber has stopped sending requests
+ACTOR Future<Void> expireMetricsSubscriptions( StorageServer* self ) {
+	loop {
+		Void _ = wait( delay( SERVER_KNOBS->STORAGE_METRIC_TIMEOUT / 2 ) );
+		for(auto it = self->metricsSubscriptions.begin(); it != self->metricsSubscriptions.end(); ) {
+			if (!it->second->outstanding && now() - it->second->lastActive > SERVER_KNOBS->STORAGE_METRIC_TIMEOUT)
+				self->metricsSubscriptions.erase( it++ );
+			else
+				++it;
+		}
+	}
+}
+
 #pragma endregion
 
 /////////////////////////////// Core //////////////////////////////////////
 #pragma region Core
 
+// Byte sample metrics requests that arrive while the byte sample is being restored are answered once it is, since the
+// partial sample would understate the size of shards that data distribution may then merge.
+ACTOR Future<Void> waitMetricsAfterByteSampleRecovery( StorageServer* self, WaitMetricsRequest req ) {
+	Void _ = wait( self->byteSampleRecovery );
+	if (!self->isReadable( req.keys )) {
+		req.reply.sendError(wrong_shard_server());
+		return Void();
+	}
+	Void _ = wait( self->metrics.waitMetrics( req, delayJittered( SERVER_KNOBS->STORAGE_METRIC_TIMEOUT ) ) );
+	return Void();
+}
+
+ACTOR Future<Void> splitMetricsAfterByteSampleRecovery( StorageServer* self, SplitMetricsRequest req ) {
+	Void _ = wait( self->byteSampleRecovery );
+	if (!self->isReadable( req.keys ))
+		req.reply.sendError(wrong_shard_server());
+	else
+		self->metrics.splitMetrics( req );
+	return Void();
+}
+
 ACTOR Future<Void> metricsCore( StorageServer* self, StorageServerInterface ssi ) {
 	state Future<Void> doPollMetrics = Void();
 	state ActorCollection actors(false);
 
-	Void _ = wait( self->byteSampleRecovery );
-
+	// The counters and physical metrics are served while the byte sample is restored.  Until then the load in physical
+	// metrics counts only the part of the sample restored so far, which data distribution's team choice tolerates.
 	actors.add(traceCounters("StorageMetrics", self->thisServerID, SERVER_KNOBS->STORAGE_LOGGING_DELAY, &self->counters.cc, self->thisServerID.toString() + "/StorageMetrics"));
+	actors.add(expireMetricsSubscriptions(self));
 
 	loop {
 		choose {
@@ -3055,14 +4298,22 @@ ACTOR Future<Void> metricsCore( StorageServer* self, StorageServerInterface ssi
 				if (!self->isReadable( req.keys )) {
 					TEST( true );	// waitMetrics immediate wrong_shard_server()
 					req.reply.sendError(wrong_shard_server());
+				} else if (!self->byteSampleRecovery.isReady()) {
+					TEST( true );	// waitMetrics during byte sample recovery
+					actors.add( waitMetricsAfterByteSampleRecovery( self, req ) );
 				} else {
 					actors.add( self->metrics.waitMetrics( req, delayJittered( SERVER_KNOBS->STORAGE_METRIC_TIMEOUT ) ) );
 				}
 			}
+			when (WaitMetricsBatchRequest req = waitNext(ssi.waitMetricsBatch.getFuture())) {
+				actors.add( waitMetricsBatch( self, req ) );
+			}
 			when (SplitMetricsRequest req = waitNext(ssi.splitMetrics.getFuture())) {
 				if (!self->isReadable( req.keys )) {
 					TEST( true );	// splitMetrics immediate wrong_shard_server()
 					req.reply.sendError(wrong_shard_server());
+				} else if (!self->byteSampleRecovery.isReady()) {
+					actors.add( splitMetricsAfterByteSampleRecovery( self, req ) );
 				} else {
 					self->metrics.splitMetrics( req );
 				}
@@ -3091,6 +4342,226 @@ ACTOR Future<Void> logLongByteSampleRecovery(Future<Void> recovery) {
 	return Void();
 }
 
+// Removes the key filters over range, or only the parts of only that are within range
+void dropKeyFilters( StorageServer* data, KeyRangeRef range, ShardKeyFilter* only = NULL ) {
+	vector<KeyRange> drop;
+	for(auto r : data->keyFilters.intersectingRanges(range))
+		if (r.value() && (!only || r.value().getPtr() == only))
+			drop.push_back( r.range() & range );
+	for(auto& r : drop)
+		data->keyFilters.insert( r, Reference<ShardKeyFilter>() );
+	if (drop.size())
+		data->keyFilters.coalesce( range );
+}
+
+ACTOR Future<Void> buildKeyFilter( StorageServer* data, KeyRange range ) {
+	state Reference<ShardKeyFilter> filter( new ShardKeyFilter( &data->keyFilterBytes ) );
+	state int bitsPerKey = SERVER_KNOBS->STORAGE_KEY_FILTER_BITS_PER_KEY;
+	state Key begin = range.begin;
+	state int commits = 0;
+
+	// From here on every key written to range is added to the filter.  The keys written before are all in the storage
+	// engine once the commit after the one that might be in progress is durable.
+	data->keyFilters.insert( range, filter );
+	for(; commits < 2; commits++)
+		Void _ = wait( data->durableVersion.whenAtLeast( data->durableVersion.get() + 1 ) );
+
+	loop {
+		Standalone<VectorRef<KeyValueRef>> kvs = wait( data->storage.readRange( KeyRangeRef(begin, range.end), 1<<30, SERVER_KNOBS->STORAGE_KEY_FILTER_SCAN_BYTES ) );
+		if (!kvs.size())
+			break;
+		for(auto& kv : kvs)
+			filter->pending.push_back( BloomFilter::hash( kv.key ) );
+		if (data->keyFilterBytes + BloomFilter::memoryBytesFor( filter->pending.size(), bitsPerKey ) >
+			SERVER_KNOBS->STORAGE_HARD_LIMIT_BYTES * SERVER_KNOBS->STORAGE_KEY_FILTER_MEMORY_FRACTION)
+		{
+			TraceEvent("KeyFilterMemoryLimit", data->thisServerID).detail("Begin", printable(range.begin)).detail("End", printable(range.end))
+				.detail("Keys", filter->pending.size()).detail("FilterBytes", data->keyFilterBytes);
+			dropKeyFilters( data, range, filter.getPtr() );
+			return Void();
+		}
+		begin = keyAfter( kvs.back().key );
+		Void _ = wait( delay( 0, TaskLowPriority ) );
+	}
+
+	filter->finish( bitsPerKey );
+	TraceEvent("KeyFilterBuilt", data->thisServerID).detail("Begin", printable(range.begin)).detail("End", printable(range.end))
+		.detail("Keys", filter->builtKeys).detail("Bytes", filter->filter.get().memoryBytes());
+	return Void();
+}
+
+// Builds a key filter for one readable shard at a time that has none (e.g. because it was just fetched, or the server
+// just started) or whose filter needs a rebuild, and drops the filters of shards that are no longer readable
+ACTOR Future<Void> maintainKeyFilters( StorageServer* data ) {
+	if (SERVER_KNOBS->STORAGE_KEY_FILTER_BITS_PER_KEY <= 0)
+		return Void();
+
+	loop {
+		Void _ = wait( delay( SERVER_KNOBS->STORAGE_KEY_FILTER_CHECK_INTERVAL, TaskLowPriority ) );
+
+		Optional<KeyRange> build;
+		vector<KeyRange> unreadable;
+		for(auto s : data->shards.ranges()) {
+			if (!s.value()->isReadable()) {
+				unreadable.push_back( s.range() );
+				continue;
+			}
+			if (build.present())
+				continue;
+			for(auto f : data->keyFilters.intersectingRanges( s.range() )) {
+				if (!f.value() || f.value()->needsRebuild()) {
+					build = s.range();
+					break;
+				}
+			}
+		}
+		for(auto& r : unreadable)
+			dropKeyFilters( data, r );
+
+		if (build.present() && data->keyFilterBytes < SERVER_KNOBS->STORAGE_HARD_LIMIT_BYTES * SERVER_KNOBS->STORAGE_KEY_FILTER_MEMORY_FRACTION)
+			Void _ = wait( buildKeyFilter( data, build.get() ) );
+	}
+}
+
+// Replaces the byte sample filter with one sized for the keys now in the sample whenever it fills up
+ACTOR Future<Void> maintainByteSampleFilter( StorageServer* data ) {
+	if (SERVER_KNOBS->BYTE_SAMPLE_FILTER_BITS_PER_KEY <= 0)
+		return Void();
+
+	loop {
+		state std::vector<BloomFilter::Hash> hashes;
+		state Key begin;
+		while (!data->byteSampleFilterFull.get())
+			Void _ = wait( data->byteSampleFilterFull.onChange() );
+
+		data->byteSampleFilterPending = std::vector<BloomFilter::Hash>();
+		loop {
+			auto& sample = data->metrics.byteSample.sample;
+			auto it = sample.lower_bound( begin );
+			for(int i = 0; it != sample.end() && i < SERVER_KNOBS->BYTE_SAMPLE_FILTER_SCAN_KEYS; ++it, ++i)
+				hashes.push_back( BloomFilter::hash( *it ) );
+			if (it == sample.end())
+				break;
+			begin = *it;
+			Void _ = wait( delay( 0, TaskLowPriority ) );
+		}
+
+		auto& pending = data->byteSampleFilterPending.get();
+		hashes.insert( hashes.end(), pending.begin(), pending.end() );
+		data->byteSampleFilterPending = Optional<std::vector<BloomFilter::Hash>>();
+
+		data->byteSampleFilterCapacity = 2 * std::max<int64_t>( hashes.size(), SERVER_KNOBS->BYTE_SAMPLE_FILTER_MIN_KEYS );
+		data->byteSampleFilterKeys = hashes.size();
+		data->byteSampleFilter = BloomFilter( data->byteSampleFilterCapacity, SERVER_KNOBS->BYTE_SAMPLE_FILTER_BITS_PER_KEY );
+		for(auto& h : hashes)
+			data->byteSampleFilter.add( h );
+		data->byteSampleFilterFull.set( false );
+
+		TraceEvent("ByteSampleFilterBuilt", data->thisServerID).detail("Keys", hashes.size()).detail("Bytes", data->byteSampleFilter.memoryBytes());
+	}
+}
+
+TEST_CASE("fdbserver/storageserver/BloomFilter") {
+	int keys = 10000;
+	int bitsPerKey = 10;
+	BloomFilter filter( keys, bitsPerKey );
+	ASSERT( filter.memoryBytes() == BloomFilter::memoryBytesFor( keys, bitsPerKey ) );
+	for(int i = 0; i < keys; i++)
+		filter.add( BloomFilter::hash( StringRef( format("key%08d", i) ) ) );
+	for(int i = 0; i < keys; i++)
+		ASSERT( filter.mayContain( BloomFilter::hash( StringRef( format("key%08d", i) ) ) ) );
+
+	int falsePositives = 0;
+	for(int i = 0; i < keys; i++)
+		if (filter.mayContain( BloomFilter::hash( StringRef( format("other%08d", i) ) ) ))
+			falsePositives++;
+	// 10 bits per key should give about 1% false positives
+	ASSERT( falsePositives < keys / 20 );
+	return Void();
+}
+
+TEST_CASE("fdbserver/storageserver/StoredValueEncoding") {
+	Arena arena;
+	std::string repetitive;
+	while (repetitive.size() < 10000)
+		repetitive += format("{\"id\": %d, \"name\": \"value\"}", (int)repetitive.size());
+	std::string random;
+	for(int i = 0; i < 1000; i++)
+		random += (char)g_random->randomInt(0, 256);
+
+	for(auto& v : { std::string(), std::string("x"), repetitive, random }) {
+		ValueRef value( (const uint8_t*)v.data(), v.size() );
+		ValueRef stored = encodeStoredValue( arena, value );
+		ASSERT( stored.size() <= value.size() + 1 );
+		ASSERT( decodeStoredValue( arena, stored ) == value );
+	}
+	ASSERT( encodeStoredValue( arena, StringRef(repetitive) ).size() < repetitive.size() / 2 );
+	return Void();
+}
+
+TEST_CASE("fdbserver/storageserver/FrontCodedReply") {
+	GetKeyValuesReply reply;
+	reply.version = 1;
+	reply.more = true;
+	for(int i = 0; i < 1000; i++) {
+		std::string key = i % 100 ? format("\x15\x02users\x01\x15%08d\x02name", i) : format("%d", i);
+		reply.data.push_back_deep( reply.arena, KeyValueRef( StringRef(key), StringRef(format("value%d", i)) ) );
+	}
+	reply.data.push_back_deep( reply.arena, KeyValueRef( StringRef(), StringRef() ) );
+
+	int lengths[2];
+	uint64_t protocolVersions[2] = { currentProtocolVersion, 0x0FDB00A560020001LL };
+	for(int v = 0; v < 2; v++) {
+		uint64_t protocolVersion = protocolVersions[v];
+		BinaryWriter wr( AssumeVersion(protocolVersion) );
+		wr << reply;
+		GetKeyValuesReply decoded;
+		BinaryReader rd( wr.toStringRef(), AssumeVersion(protocolVersion) );
+		rd >> decoded;
+		ASSERT( decoded.version == reply.version && decoded.more == reply.more );
+		ASSERT( decoded.data.size() == reply.data.size() );
+		for(int i = 0; i < reply.data.size(); i++)
+			ASSERT( decoded.data[i].key == reply.data[i].key && decoded.data[i].value == reply.data[i].value );
+		lengths[v] = wr.getLength();
+	}
+	ASSERT( lengths[0] < lengths[1] * 3 / 4 );
+	return Void();
+}
+
+TEST_CASE("fdbserver/storageserver/RangeDigest") {
+	Arena arena;
+	KeyRangeRef keys( LiteralStringRef("a"), LiteralStringRef("b") );
+	VectorRef<KeyValueRef> data, changed;
+	for(int i = 0; i < 1000; i++) {
+		KeyRef key = StringRef( arena, format("a%06d", i) );
+		data.push_back( arena, KeyValueRef( key, LiteralStringRef("value") ) );
+		changed.push_back( arena, KeyValueRef( key, i == 500 ? LiteralStringRef("other") : LiteralStringRef("value") ) );
+	}
+
+	VectorRef<RangeDigestRef> a, b, c;
+	digestRange( arena, a, keys, data, false, 10, 1e6 );
+	digestRange( arena, b, keys, changed, false, 10, 1e6 );
+	ASSERT( a.size() > 10 && a.size() == b.size() && a.back().end == keys.end );
+	int different = 0, count = 0;
+	for(int i = 0; i < a.size(); i++) {
+		ASSERT( a[i].end == b[i].end );
+		different += a[i] != b[i];
+		count += a[i].count;
+	}
+	ASSERT( different == 1 && count == data.size() );
+
+	// A read cut short ends at the last complete chunk, which matches that of the whole read
+	digestRange( arena, c, keys, VectorRef<KeyValueRef>( data.begin(), 600 ), true, 10, 1e6 );
+	ASSERT( c.size() && c.size() < a.size() && c.back().end <= data[600].key );
+	for(int i = 0; i < c.size(); i++)
+		ASSERT( c[i] == a[i] );
+
+	c = VectorRef<RangeDigestRef>();
+	digestRange( arena, c, keys, VectorRef<KeyValueRef>(), false, 10, 1e6 );
+	ASSERT( c.size() == 1 && c[0].count == 0 && c[0].end == keys.end );
+	return Void();
+}
+
 ACTOR Future<Void> storageServerCore( StorageServer* self, StorageServerInterface ssi )
 {
 	state Future<Void> doUpdate = Void();
@@ -3105,7 +4576,11 @@ ACTOR Future<Void> storageServerCore( StorageServer* self, StorageServerInterfac
 	actors.add(self->otherError.getFuture());
 	actors.add(metricsCore(self, ssi));
 	actors.add(logLongByteSampleRecovery(self->byteSampleRecovery));
+	actors.add(expireKeyValuesStreams(self));
+	actors.add(maintainKeyFilters(self));
+	actors.add(maintainByteSampleFilter(self));
 
+	self->capture = TrafficCapture::open( "storage", self->thisServerID );
 	self->coreStarted.send( Void() );
 
 	loop {
@@ -3148,23 +4623,61 @@ ACTOR Future<Void> storageServerCore( StorageServer* self, StorageServerInterfac
 				// Warning: This code is executed at extremely high priority (TaskLoadBalancedEndpoint), so downgrade before doing real work
 				if( req.debugID.present() )
 					g_traceBatch.addEvent("GetValueDebug", req.debugID.get().first(), "storageServer.recieved"); //.detail("TaskID", g_network->getCurrentTask());
+				if( self->capture )
+					self->capture->getValue( req.key );
 
 				if (SHORT_CIRCUT_ACTUAL_STORAGE && normalKeys.contains(req.key))
 					req.reply.send(GetValueReply());
 				else
 					actors.add( getValueQ( self, req ) );
 			}
+			when( GetValuesRequest req = waitNext(ssi.getValues.getFuture()) ) {
+				// Warning: This code is executed at extremely high priority (TaskLoadBalancedEndpoint), so downgrade before doing real work
+				if( req.debugID.present() )
+					g_traceBatch.addEvent("GetValueDebug", req.debugID.get().first(), "storageServer.recieved");
+				if( self->capture ) {
+					for( auto& key : req.keys )
+						self->capture->getValue( key );
+				}
+
+				actors.add( getValuesQ( self, req ) );
+			}
 			when( WatchValueRequest req = waitNext(ssi.watchValue.getFuture()) ) {
 				// TODO: fast load balancing?
 				// SOMEDAY: combine watches for the same key/value into a single watch
 				actors.add( watchValueQ( self, req ) );
 			}
+			when (GetKeyValuesStreamRequest req = waitNext(ssi.getKeyValuesStream.getFuture()) ) {
+				// Warning: This code is executed at extremely high priority (TaskLoadBalancedEndpoint), so downgrade before doing real work
+				actors.add( getKeyValuesStreamQ( self, req ) );
+			}
+			when (ExportBackupRangeRequest req = waitNext(ssi.exportBackupRange.getFuture()) ) {
+				actors.add( exportBackupRangeQ( self, req ) );
+			}
+			when (ChangeFeedRequest req = waitNext(ssi.changeFeed.getFuture()) ) {
+				actors.add( changeFeedQ( self, req ) );
+			}
+			when (GetRangeAggregateRequest req = waitNext(ssi.getRangeAggregate.getFuture()) ) {
+				actors.add( getRangeAggregateQ( self, req ) );
+			}
+			when (GetRangeDigestRequest req = waitNext(ssi.getRangeDigest.getFuture()) ) {
+				actors.add( getRangeDigestQ( self, req ) );
+			}
+			when (GetHotRangesRequest req = waitNext(ssi.getHotRanges.getFuture()) ) {
+				GetHotRangesReply reply;
+				double writeSeconds;
+				self->hotReads.getTop( reply.arena, reply.reads, req.limit, reply.seconds );
+				self->hotWrites.getTop( reply.arena, reply.writes, req.limit, writeSeconds );
+				req.reply.send( reply );
+			}
 			when (GetKeyRequest req = waitNext(ssi.getKey.getFuture())) {
 				// Warning: This code is executed at extremely high priority (TaskLoadBalancedEndpoint), so downgrade before doing real work
 				actors.add( getKey( self, req ) );
 			}
 			when (GetKeyValuesRequest req = waitNext(ssi.getKeyValues.getFuture()) ) {
 				// Warning: This code is executed at extremely high priority (TaskLoadBalancedEndpoint), so downgrade before doing real work
+				if( self->capture )
+					self->capture->getKeyValues( req.begin, req.end, req.limit, req.limitBytes );
 				actors.add( getKeyValues( self, req ) );
 			}
 			when (GetShardStateRequest req = waitNext(ssi.getShardState.getFuture()) ) {
@@ -36,6 +36,7 @@
 #include "fdbclient/FailureMonitorClient.h"
 #include "CoordinationInterface.h"
 #include "fdbclient/ManagementAPI.h"
+#include "fdbclient/json_spirit/json_spirit_writer_template.h"
 
 using namespace std;
 
@@ -756,6 +757,8 @@ ACTOR Future<Void> checkConsistency(Database cx, std::vector< TesterInterface >
 	options.push_back_deep(options.arena(), KeyValueRef(LiteralStringRef("performQuiescentChecks"), ValueRef(format("%s", LiteralStringRef(doQuiescentCheck ? "true" : "false").toString().c_str()))));
 	options.push_back_deep(options.arena(), KeyValueRef(LiteralStringRef("quiescentWaitTimeout"), ValueRef(format("%f", quiescentWaitTimeout))));
 	options.push_back_deep(options.arena(), KeyValueRef(LiteralStringRef("distributed"), LiteralStringRef("false")));
+	if(g_random->random01() < 0.25)
+		options.push_back_deep(options.arena(), KeyValueRef(LiteralStringRef("useDigests"), LiteralStringRef("true")));
 	spec.options.push_back_deep(spec.options.arena(), options);
 
 	state double start = now();
@@ -775,6 +778,43 @@ ACTOR Future<Void> checkConsistency(Database cx, std::vector< TesterInterface >
 	}
 }
 
+// Appends the results of a test to spec.resultsFile as one line of JSON, so that runs on different releases and hardware
+// can be compared.  Besides every metric by name, a record has the throughput and latency percentiles under fixed names
+// when the workload reports them under the names ReadWrite uses.  A change to the layout of a record must come with a
+// new schemaVersion.
+void writeTestResults( TestSpec const& spec, DistributedTestResults const& results, bool ok, int testerCount ) {
+	static const std::pair<const char*, const char*> standardMetrics[] = {
+		{ "transactionsPerSecond", "Transactions/sec" },
+		{ "operationsPerSecond", "Operations/sec" },
+		{ "p50LatencyMs", "Median Latency (ms, averaged)" },
+		{ "p99LatencyMs", "99% Latency (ms, averaged)" },
+		{ "p999LatencyMs", "99.9% Latency (ms, averaged)" } };
+
+	// JSON has no representation for infinities and NaNs, such as the rates of a test that ran for no time
+	json_spirit::mObject metrics;
+	for(auto& m : results.metrics)
+		if( std::isfinite( m.value() ) )
+			metrics[m.name()] = m.value();
+
+	json_spirit::mObject record;
+	record["schemaVersion"] = 1;
+	record["test"] = spec.title.toString();
+	record["passed"] = ok;
+	record["testers"] = testerCount;
+	for(auto& s : standardMetrics) {
+		auto m = metrics.find(s.second);
+		if(m != metrics.end())
+			record[s.first] = m->second;
+	}
+	record["metrics"] = metrics;
+
+	std::ofstream out( spec.resultsFile.c_str(), std::ios::app );
+	out << json_spirit::write_string( json_spirit::mValue(record), json_spirit::Output_options::none ) << std::endl;
+	if( !out ) {
+		TraceEvent(SevWarnAlways, "TestResultsNotWritten").detail("Workload", printable(spec.title)).detail("File", spec.resultsFile);
+	}
+}
+
 ACTOR Future<bool> runTest( Database cx, std::vector< TesterInterface > testers, 
 			StringRef database, TestSpec spec ) 
 {
@@ -833,6 +873,10 @@ ACTOR Future<bool> runTest( Database cx, std::vector< TesterInterface > testers,
 	if (ok) { passCount++; }
 	else { failCount++; }
 
+	if( spec.resultsFile.size() ) {
+		writeTestResults( spec, testResults, ok, testers.size() );
+	}
+
 	printf("%d test clients passed; %d test clients failed\n", testResults.successes, testResults.failures);
 
 	if( spec.useDB && spec.clearAfterTest ) {
@@ -961,6 +1005,9 @@ vector<TestSpec> readTests( ifstream& ifs ) {
 			TraceEvent("TestParserTest").detail("ParsedMinimumReplication", "");
 		} else if( attrib == "buggify" ) {
 			TraceEvent("TestParserTest").detail("ParsedBuggify", "");
+		} else if( attrib == "resultsFile" ) {
+			spec.resultsFile = value;
+			TraceEvent("TestParserTest").detail("ParsedResultsFile", spec.resultsFile);
 		} else if( attrib == "checkOnly" ) {
 			if(value == "true")
 				spec.phases = TestWorkload::CHECK;
@@ -1169,6 +1216,7 @@ ACTOR Future<Void> runTests( Reference<ClusterConnectionFile> connFile, test_typ
 		options.push_back_deep(options.arena(), KeyValueRef(LiteralStringRef("indefinite"), LiteralStringRef("true")));
 		options.push_back_deep(options.arena(), KeyValueRef(LiteralStringRef("rateLimit"), StringRef(rateLimit)));
 		options.push_back_deep(options.arena(), KeyValueRef(LiteralStringRef("shuffleShards"), LiteralStringRef("true")));
+		options.push_back_deep(options.arena(), KeyValueRef(LiteralStringRef("useDigests"), LiteralStringRef("true")));
 		spec.options.push_back_deep(spec.options.arena(), options);
 		testSpecs.push_back(spec);
 	} else {
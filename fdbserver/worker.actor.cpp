@@ -22,6 +22,8 @@
 #include "flow/ActorCollection.h"
 #include "flow/SystemMonitor.h"
 #include "flow/TDMetric.actor.h"
+#include "flow/Stats.h"
+#include "flow/Hash3.h"
 #include "fdbrpc/simulator.h"
 #include "fdbclient/NativeAPI.h"
 #include "fdbclient/MetricLogger.h"
@@ -30,6 +32,7 @@
 #include "WaitFailure.h"
 #include "TesterInterface.h"  // for poisson()
 #include "IDiskQueue.h"
+#include "fdbrpc/IAsyncFile.h"
 #include "fdbclient/DatabaseContext.h"
 #include "ClusterRecruitmentInterface.h"
 #include "ServerDBInfo.h"
@@ -180,6 +183,7 @@ StringRef fileLogQueuePrefix = LiteralStringRef("logqueue-");
 std::pair<KeyValueStoreType, std::string> bTreeV1Suffix  = std::make_pair( KeyValueStoreType::SSD_BTREE_V1, ".fdb" );
 std::pair<KeyValueStoreType, std::string> bTreeV2Suffix = std::make_pair(KeyValueStoreType::SSD_BTREE_V2,   ".sqlite");
 std::pair<KeyValueStoreType, std::string> memorySuffix = std::make_pair( KeyValueStoreType::MEMORY,         "-0.fdq" );
+std::pair<KeyValueStoreType, std::string> lsmSuffix = std::make_pair( KeyValueStoreType::SSD_LSM,           ".lsm-log0.fdq" );
 
 std::string validationFilename = "_validate";
 
@@ -190,6 +194,8 @@ std::string filenameFromSample( KeyValueStoreType storeType, std::string folder,
 		return joinPath(folder, sample_filename);
 	else if( storeType == KeyValueStoreType::MEMORY )
 		return joinPath( folder, sample_filename.substr(0, sample_filename.size() - 5) );
+	else if( storeType == KeyValueStoreType::SSD_LSM )
+		return joinPath( folder, sample_filename.substr(0, sample_filename.size() - 9) );
 
 	UNREACHABLE();
 }
@@ -201,6 +207,8 @@ std::string filenameFromId( KeyValueStoreType storeType, std::string folder, std
 		return joinPath(folder, prefix + id.toString() + ".sqlite");
 	else if( storeType == KeyValueStoreType::MEMORY )
 		return joinPath( folder, prefix + id.toString() + "-" );
+	else if( storeType == KeyValueStoreType::SSD_LSM )
+		return joinPath( folder, prefix + id.toString() + ".lsm" );
 
 	UNREACHABLE();
 }
@@ -247,26 +255,69 @@ std::vector< DiskStore > getDiskStores( std::string folder ) {
 	result.insert( result.end(), result1.begin(), result1.end() );
 	auto result2 = getDiskStores( folder, memorySuffix.second, memorySuffix.first );
 	result.insert( result.end(), result2.begin(), result2.end() );
+	auto result3 = getDiskStores( folder, lsmSuffix.second, lsmSuffix.first );
+	result.insert( result.end(), result3.begin(), result3.end() );
 	return result;
 }
 
-ACTOR Future<Void> registrationClient( Reference<AsyncVar<Optional<ClusterControllerFullInterface>>> ccInterface, WorkerInterface interf, Reference<AsyncVar<ClusterControllerPriorityInfo>> asyncPriorityInfo, ProcessClass initialClass) {
+ACTOR Future<Void> registrationClient( Reference<AsyncVar<Optional<ClusterControllerFullInterface>>> ccInterface, WorkerInterface interf, Reference<AsyncVar<ClusterControllerPriorityInfo>> asyncPriorityInfo, ProcessClass initialClass, Reference<AsyncVar<HostCapacity>> capacity) {
 	// Keeps the cluster controller (as it may be re-elected) informed that this worker exists
 	// The cluster controller uses waitFailureClient to find out if we die, and returns from registrationReply (requiring us to re-register)
 	state Generation requestGeneration = 0;
 	state ProcessClass processClass = initialClass;
 	loop {
-		Future<RegisterWorkerReply> registrationReply = ccInterface->get().present() ? brokenPromiseToNever( ccInterface->get().get().registerWorker.getReply( RegisterWorkerRequest(interf, initialClass, processClass, asyncPriorityInfo->get(), requestGeneration++) ) ) : Never();
+		Future<RegisterWorkerReply> registrationReply = ccInterface->get().present() ? brokenPromiseToNever( ccInterface->get().get().registerWorker.getReply( RegisterWorkerRequest(interf, initialClass, processClass, asyncPriorityInfo->get(), requestGeneration++, capacity->get()) ) ) : Never();
 		choose {
 			when ( RegisterWorkerReply reply = wait( registrationReply )) {
 				processClass = reply.processClass;	
 				asyncPriorityInfo->set( reply.priorityInfo );
 			}
 			when ( Void _ = wait( ccInterface->onChange() )) { }
+			when ( Void _ = wait( capacity->onChange() )) { }
 		}
 	}
 }
 
+// Measures how fast this worker's host syncs to disk and computes, and reports it through capacity when done.  The
+// computation is not timed in simulation, where it takes no simulated time and timing it would not be deterministic.
+ACTOR Future<Void> probeHostCapacity( std::string folder, Reference<AsyncVar<HostCapacity>> capacity ) {
+	state HostCapacity result;
+	state std::string filename = joinPath( folder, "capacity-probe.tmp" );
+	state std::string page( 4096, 'x' );
+
+	if( !g_network->isSimulated() ) {
+		double cpuStart = timer();
+		uint32_t h = 0;
+		for( int i = 0; i < SERVER_KNOBS->HOST_PROBE_CPU_ROUNDS; i++ )
+			h = hashlittle( page.data(), page.size(), h );
+		result.cpuProbeTime = std::max( timer() - cpuStart, 1e-9 );
+		page[0] = (char)h;  // Keeps the computation from being optimized away
+	}
+
+	if( SERVER_KNOBS->HOST_PROBE_SYNCS > 0 ) {
+		try {
+			state Reference<IAsyncFile> f = wait( IAsyncFileSystem::filesystem()->open( filename, IAsyncFile::OPEN_CREATE | IAsyncFile::OPEN_READWRITE | IAsyncFile::OPEN_NO_AIO, 0600 ) );
+			state int i = 0;
+			state double start = now();
+			for(; i < SERVER_KNOBS->HOST_PROBE_SYNCS; i++) {
+				Void _ = wait( f->write( page.data(), page.size(), i * page.size() ) );
+				Void _ = wait( f->sync() );
+			}
+			result.diskSyncLatency = std::max( ( now() - start ) / SERVER_KNOBS->HOST_PROBE_SYNCS, 1e-9 );
+			f = Reference<IAsyncFile>();
+			Void _ = wait( IAsyncFileSystem::filesystem()->deleteFile( filename, false ) );
+		} catch( Error& e ) {
+			if( e.code() == error_code_actor_cancelled )
+				throw;
+			TraceEvent(SevWarnAlways, "HostCapacityProbeError").error(e).detail("Filename", filename);
+		}
+	}
+
+	TraceEvent("HostCapacity").detail("DiskSyncLatency", result.diskSyncLatency).detail("CpuProbeTime", result.cpuProbeTime);
+	capacity->set( result );
+	return Void();
+}
+
 #if defined(__linux__) && defined(USE_GPERFTOOLS)
 //A set of threads that should be profiled
 std::set<std::thread::id> profiledThreads;
@@ -329,6 +380,33 @@ void updateCpuProfiler(ProfilerRequest req) {
 	}
 }
 
+// Replies with the samples of the sampling profiler, or with those taken over req.duration seconds
+ACTOR Future<Void> sendProfileSamples(ProfileSamplesRequest req) {
+	state ProfileSamples before;
+	before.dropped = 0;
+	if (req.duration > 0) {
+		before = getProfileSamples();
+		Void _ = wait(delay(req.duration));
+	}
+	ProfileSamples after = getProfileSamples();
+
+	std::map<std::pair<const char*, int>, int64_t> counts;
+	for (auto const& c : after.counts)
+		counts[std::make_pair(c.actor, c.taskID)] += c.samples;
+	for (auto const& c : before.counts)
+		counts[std::make_pair(c.actor, c.taskID)] -= c.samples;
+
+	ProfileSamplesReply reply;
+	for (auto const& c : counts)
+		if (c.second > 0)
+			reply.entries.push_back(ProfileSampleEntry(c.first.first ? c.first.first : "", c.first.second, c.second));
+	std::sort(reply.entries.begin(), reply.entries.end(), [](ProfileSampleEntry const& a, ProfileSampleEntry const& b) { return a.samples > b.samples; });
+	reply.dropped = after.dropped - before.dropped;
+	reply.periodMicroseconds = after.periodMicroseconds;
+	req.reply.send(reply);
+	return Void();
+}
+
 ACTOR Future<Void> runProfiler(ProfilerRequest req) {
 	if (req.action == ProfilerRequest::Action::RUN) {
 		req.action = ProfilerRequest::Action::ENABLE;
@@ -464,10 +542,13 @@ ACTOR Future<Void> monitorServerDBInfo( Reference<AsyncVar<Optional<ClusterContr
 		}
 
 		choose {
-			when( ServerDBInfo ni = wait( ccInterface->get().present() ? brokenPromiseToNever( ccInterface->get().get().getServerDBInfo.getReply( req ) ) : Never() ) ) {
-				TraceEvent("GotServerDBInfoChange").detail("ChangeID", ni.id).detail("MasterID", ni.master.id());
-				ServerDBInfo localInfo = ni;
+			when( ServerDBInfoUpdate update = wait( ccInterface->get().present() ? brokenPromiseToNever( ccInterface->get().get().getServerDBInfo.getReply( req ) ) : Never() ) ) {
+				// The reply is to our request, so it can only update the ServerDBInfo we said we have
+				ASSERT( !update.baseID.isValid() || update.baseID == dbInfo->get().id );
+				ServerDBInfo localInfo = dbInfo->get();
+				update.apply( localInfo );
 				localInfo.myLocality = locality;
+				TraceEvent("GotServerDBInfoChange").detail("ChangeID", localInfo.id).detail("MasterID", localInfo.master.id()).detail("Members", update.fields.size());
 				dbInfo->set(localInfo);
 			}
 			when( Void _ = wait( ccInterface->onChange() ) ) {
@@ -478,6 +559,28 @@ ACTOR Future<Void> monitorServerDBInfo( Reference<AsyncVar<Optional<ClusterContr
 	}
 }
 
+// Rewrites the given file with exportedCountersText() periodically, for a Prometheus node exporter or any other scraper
+// reading text files to pick up, so that counters can be monitored at high resolution without going through status
+ACTOR Future<Void> exportCounters( std::string filename ) {
+	state std::string text;
+	state Reference<IAsyncFile> f;
+	loop {
+		Void _ = wait( delay( SERVER_KNOBS->COUNTER_EXPORT_INTERVAL ) );
+		text = exportedCountersText();
+		try {
+			Reference<IAsyncFile> _f = wait( IAsyncFileSystem::filesystem()->open( filename, IAsyncFile::OPEN_NO_AIO | IAsyncFile::OPEN_CREATE | IAsyncFile::OPEN_ATOMIC_WRITE_AND_CREATE | IAsyncFile::OPEN_READWRITE, 0644 ) );
+			f = _f;
+			Void _ = wait( f->write( text.data(), text.size(), 0 ) );
+			Void _ = wait( f->sync() );  // Replaces the old file with the new one
+		} catch( Error& e ) {
+			if( e.code() == error_code_actor_cancelled )
+				throw;
+			TraceEvent(SevWarnAlways, "CounterExportError").error(e).suppressFor(60.0).detail("Filename", filename);
+		}
+		f = Reference<IAsyncFile>();
+	}
+}
+
 ACTOR Future<Void> workerServer( Reference<ClusterConnectionFile> connFile, Reference<AsyncVar<Optional<ClusterControllerFullInterface>>> ccInterface, LocalityData localities,
 	Reference<AsyncVar<ClusterControllerPriorityInfo>> asyncPriorityInfo, ProcessClass initialClass, std::string folder, int64_t memoryLimit, std::string metricsConnFile, std::string metricsPrefix ) {
 	state PromiseStream< ErrorInfo > errors;
@@ -544,10 +647,20 @@ ACTOR Future<Void> workerServer( Reference<ClusterConnectionFile> connFile, Refe
 		}
 	}
 
+	// The samples of a simulated process would mix those of all of the simulated processes
+	if (!g_network->isSimulated())
+		startSamplingProfiler( g_network, FLOW_KNOBS->SAMPLING_PROFILER_PERIOD );
+
 	errorForwarders.add( loadedPonger( interf.debugPing.getFuture() ) );
 	errorForwarders.add( waitFailureServer( interf.waitFailure.getFuture() ) );
 	errorForwarders.add( monitorServerDBInfo( ccInterface, connFile, locality, dbInfo ) );
 	errorForwarders.add( testerServerCore( interf.testerInterface, connFile, dbInfo, locality ) );
+	if( SERVER_KNOBS->COUNTER_EXPORT_DIRECTORY.size() ) {
+		platform::createDirectory( SERVER_KNOBS->COUNTER_EXPORT_DIRECTORY );
+		std::string address = g_network->getLocalAddress().toString();
+		std::replace( address.begin(), address.end(), ':', '_' );
+		errorForwarders.add( exportCounters( joinPath( SERVER_KNOBS->COUNTER_EXPORT_DIRECTORY, "fdbserver." + address + ".prom" ) ) );
+	}
 
 	filesClosed.add(stopping.getFuture());
 
@@ -557,6 +670,7 @@ ACTOR Future<Void> workerServer( Reference<ClusterConnectionFile> connFile, Refe
 		auto recruited = interf;  //ghetto! don't we all love a good #define
 		DUMPTOKEN(recruited.clientInterface.reboot);
 		DUMPTOKEN(recruited.clientInterface.profiler);
+		DUMPTOKEN(recruited.clientInterface.profileSamples);
 		DUMPTOKEN(recruited.tLog);
 		DUMPTOKEN(recruited.master);
 		DUMPTOKEN(recruited.masterProxy);
@@ -594,10 +708,18 @@ ACTOR Future<Void> workerServer( Reference<ClusterConnectionFile> connFile, Refe
 
 				DUMPTOKEN(recruited.getVersion);
 				DUMPTOKEN(recruited.getValue);
+				DUMPTOKEN(recruited.getValues);
 				DUMPTOKEN(recruited.getKey);
 				DUMPTOKEN(recruited.getKeyValues);
+				DUMPTOKEN(recruited.getKeyValuesStream);
+				DUMPTOKEN(recruited.exportBackupRange);
+				DUMPTOKEN(recruited.changeFeed);
+				DUMPTOKEN(recruited.getRangeAggregate);
+				DUMPTOKEN(recruited.getHotRanges);
+				DUMPTOKEN(recruited.getRangeDigest);
 				DUMPTOKEN(recruited.getShardState);
 				DUMPTOKEN(recruited.waitMetrics);
+				DUMPTOKEN(recruited.waitMetricsBatch);
 				DUMPTOKEN(recruited.splitMetrics);
 				DUMPTOKEN(recruited.getPhysicalMetrics);
 				DUMPTOKEN(recruited.waitFailure);
@@ -643,7 +765,9 @@ ACTOR Future<Void> workerServer( Reference<ClusterConnectionFile> connFile, Refe
 		startRole( interf.id(), interf.id(), "Worker", details );
 
 		Void _ = wait(waitForAll(recoveries));
-		errorForwarders.add( registrationClient( ccInterface, interf, asyncPriorityInfo, initialClass ) );
+		state Reference<AsyncVar<HostCapacity>> capacity( new AsyncVar<HostCapacity>() );
+		errorForwarders.add( probeHostCapacity( folder, capacity ) );
+		errorForwarders.add( registrationClient( ccInterface, interf, asyncPriorityInfo, initialClass, capacity ) );
 
 		TraceEvent("RecoveriesComplete", interf.id());
 
@@ -690,6 +814,9 @@ ACTOR Future<Void> workerServer( Reference<ClusterConnectionFile> connFile, Refe
 					profilerReq.reply.sendError(e);
 				}
 			}
+			when( ProfileSamplesRequest req = waitNext(interf.clientInterface.profileSamples.getFuture()) ) {
+				errorForwarders.add( sendProfileSamples(req) );
+			}
 			when( RecruitMasterRequest req = waitNext(interf.master.getFuture()) ) {
 				MasterInterface recruited;
 				recruited.locality = locality;
@@ -743,10 +870,18 @@ ACTOR Future<Void> workerServer( Reference<ClusterConnectionFile> connFile, Refe
 
 					DUMPTOKEN(recruited.getVersion);
 					DUMPTOKEN(recruited.getValue);
+					DUMPTOKEN(recruited.getValues);
 					DUMPTOKEN(recruited.getKey);
 					DUMPTOKEN(recruited.getKeyValues);
+					DUMPTOKEN(recruited.getKeyValuesStream);
+					DUMPTOKEN(recruited.exportBackupRange);
+					DUMPTOKEN(recruited.changeFeed);
+					DUMPTOKEN(recruited.getRangeAggregate);
+					DUMPTOKEN(recruited.getHotRanges);
+					DUMPTOKEN(recruited.getRangeDigest);
 					DUMPTOKEN(recruited.getShardState);
 					DUMPTOKEN(recruited.waitMetrics);
+					DUMPTOKEN(recruited.waitMetricsBatch);
 					DUMPTOKEN(recruited.splitMetrics);
 					DUMPTOKEN(recruited.getPhysicalMetrics);
 					DUMPTOKEN(recruited.waitFailure);
@@ -776,7 +911,8 @@ ACTOR Future<Void> workerServer( Reference<ClusterConnectionFile> connFile, Refe
 
 				std::map<std::string, std::string> details;
 				details["ForMaster"] = req.master.id().shortString();
-				startRole( recruited.id(), interf.id(), "MasterProxyServer", details );
+				const char* proxyRole = req.grvOnly ? "GrvProxyServer" : "MasterProxyServer";
+				startRole( recruited.id(), interf.id(), proxyRole, details );
 
 				DUMPTOKEN(recruited.commit);
 				DUMPTOKEN(recruited.getConsistentReadVersion);
@@ -787,7 +923,7 @@ ACTOR Future<Void> workerServer( Reference<ClusterConnectionFile> connFile, Refe
 				DUMPTOKEN(recruited.txnState);
 
 				//printf("Recruited as masterProxyServer\n");
-				errorForwarders.add( zombie(recruited, forwardError( errors, "MasterProxyServer", recruited.id(),
+				errorForwarders.add( zombie(recruited, forwardError( errors, proxyRole, recruited.id(),
 						masterProxyServer( recruited, req, dbInfo ) ) ) );
 				req.reply.send(recruited);
 			}
@@ -862,6 +998,9 @@ ACTOR Future<Void> workerServer( Reference<ClusterConnectionFile> connFile, Refe
 						else if (d.storeType == KeyValueStoreType::SSD_BTREE_V2) {
 							included = fileExists(d.filename + ".sqlite-wal");
 						}
+						else if (d.storeType == KeyValueStoreType::SSD_LSM) {
+							included = fileExists(d.filename + "-log1.fdq");
+						}
 						else {
 							ASSERT(d.storeType == KeyValueStoreType::MEMORY);
 							included = fileExists(d.filename + "1.fdq");
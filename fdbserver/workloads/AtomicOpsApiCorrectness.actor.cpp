@@ -21,6 +21,7 @@
 #include "flow/actorcompiler.h"
 #include "fdbserver/TesterInterface.h"
 #include "fdbclient/ReadYourWrites.h"
+#include "fdbclient/Atomic.h"
 #include "fdbclient/RunTransaction.actor.h"
 #include "workloads.h"
 
@@ -57,7 +58,7 @@ public:
 
 	virtual Future<Void> start(Database const& cx) {
 		if (opType == -1)
-			opType = sharedRandomNumber % 8;
+			opType = sharedRandomNumber % 10;
 
 		switch (opType) {
 		case 0:
@@ -84,6 +85,12 @@ public:
 		case 7:
 			TEST(true); //Testing atomic Add
 			return testAdd(cx->clone(), this);
+		case 8:
+			TEST(true); //Testing atomic SetIfAbsent
+			return testSetIfAbsent(cx->clone(), this);
+		case 9:
+			TEST(true); //Testing atomic CompareAndSet
+			return testCompareAndSet(cx->clone(), this);
 		default:
 			ASSERT(false);
 		}
@@ -376,6 +383,78 @@ public:
 
 		return Void();
 	}
+
+	ACTOR Future<Void> testSetIfAbsent(Database cx, AtomicOpsApiCorrectnessWorkload* self) {
+		state Key key = self->getTestKey("test_key_set_if_absent_");
+
+		TraceEvent(SevInfo, "Running Atomic Op SET_IF_ABSENT Correctness Current Api Version");
+		Void _ = wait(self->testAtomicOpSetOnNonExistingKey(cx, self, MutationRef::SetIfAbsent, key));
+		Void _ = wait(self->testAtomicOpApi(cx, self, MutationRef::SetIfAbsent, key, [](uint64_t val1, uint64_t val2) { return val1; }));
+		Void _ = wait(self->testAtomicOpOnEmptyValue(cx, self, MutationRef::SetIfAbsent, key, [](Value v1, Value v2) -> Value { return v1; }));
+
+		return Void();
+	}
+
+	// Sets the key to initial (or clears it), applies compare_and_set operations to it in one transaction and then reads it
+	// in the same transaction or, if onStorageServer, in another one
+	ACTOR Future<Optional<Value>> runCompareAndSets(Database cx, Key key, Optional<Value> initial, std::vector<Value> operands, bool onStorageServer) {
+		loop{
+			try {
+				Void _ = wait(runRYWTransactionNoRetry(cx, [=](Reference<ReadYourWritesTransaction> tr) -> Future<Void> {
+					if (initial.present())
+						tr->set(key, initial.get());
+					else
+						tr->clear(key);
+					if (onStorageServer)
+						return Void();
+					for (auto& op : operands)
+						tr->atomicOp(key, op, MutationRef::CompareAndSet);
+					return success(tr->get(key));
+				}));
+				if (onStorageServer) {
+					Void _ = wait(runRYWTransactionNoRetry(cx, [=](Reference<ReadYourWritesTransaction> tr) -> Future<Void> {
+						for (auto& op : operands)
+							tr->atomicOp(key, op, MutationRef::CompareAndSet);
+						return Void();
+					}));
+				}
+				break;
+			}
+			catch (Error& e) {
+				TraceEvent(SevInfo, "AtomicOpApiThrow").detail("errCode", e.code());
+				Void _ = wait(delay(1));
+			}
+		}
+		Optional<Value> outputVal = wait(runRYWTransaction(cx, [=](Reference<ReadYourWritesTransaction> tr) -> Future<Optional<Value>> { return tr->get(key); }));
+		return outputVal;
+	}
+
+	ACTOR Future<Void> testCompareAndSet(Database cx, AtomicOpsApiCorrectnessWorkload* self) {
+		state Key key = self->getTestKey("test_key_compare_and_set_");
+		state Value val1 = LiteralStringRef("value1");
+		state Value val2 = LiteralStringRef("value2");
+		state Value val3 = LiteralStringRef("value3");
+		state int onStorageServer;
+
+		TraceEvent(SevInfo, "Running Atomic Op COMPARE_AND_SET Correctness Current Api Version");
+		for (onStorageServer = 0; onStorageServer < 2; onStorageServer++) {
+			// A matching comparison sets the value, and a later one against the old value then fails
+			Optional<Value> output = wait(self->runCompareAndSets(cx, key, val1, { encodeCompareAndSetOperand(val1, val2), encodeCompareAndSetOperand(val1, val3) }, onStorageServer));
+			if (output != Optional<Value>(val2)) {
+				TraceEvent(SevError, "AtomicOpCompareAndSetUnexpectedOutput").detail("OnStorageServer", onStorageServer).detail("Case", "Present").detail("ActualOutput", output.present() ? printable(output.get()) : "absent");
+				self->testFailed = true;
+			}
+
+			// Nothing compares equal to an absent value, not even an empty one
+			Optional<Value> output = wait(self->runCompareAndSets(cx, key, Optional<Value>(), { encodeCompareAndSetOperand(StringRef(), val2) }, onStorageServer));
+			if (output.present()) {
+				TraceEvent(SevError, "AtomicOpCompareAndSetUnexpectedOutput").detail("OnStorageServer", onStorageServer).detail("Case", "Absent").detail("ActualOutput", printable(output.get()));
+				self->testFailed = true;
+			}
+		}
+
+		return Void();
+	}
 };
 
 WorkloadFactory<AtomicOpsApiCorrectnessWorkload> AtomicOpsApiCorrectnessWorkloadFactory("AtomicOpsApiCorrectness");
@@ -26,7 +26,7 @@
 #include "fdbrpc/simulator.h"
 
 // "ssd" is an alias to the preferred type which skews the random distribution toward it but that's okay.
-static const char* storeTypes[] = { "ssd", "ssd-1", "ssd-2", "memory" };
+static const char* storeTypes[] = { "ssd", "ssd-1", "ssd-2", "ssd-lsm", "memory" };
 static const char* redundancies[] = { "single", "double", "triple" };
 
 struct ConfigureDatabaseWorkload : TestWorkload {
@@ -153,6 +153,7 @@ struct ConfigureDatabaseWorkload : TestWorkload {
 
 				if (g_random->random01() < 0.5) config += " logs=" + format("%d", randomRoleNumber());
 				if (g_random->random01() < 0.5) config += " proxies=" + format("%d", randomRoleNumber());
+				if (g_random->random01() < 0.5) config += " grv_proxies=" + format("%d", randomRoleNumber());
 				if (g_random->random01() < 0.5) config += " resolvers=" + format("%d", randomRoleNumber());
 
 				ConfigurationResult::Type _ = wait( changeConfig( cx, config ) );
@@ -62,6 +62,12 @@ struct ConsistencyCheckWorkload : TestWorkload
 	//Randomize shard order with each iteration if true
 	bool shuffleShards;
 
+	//If true, compare digests of the replicas' chunks of each shard and read only the chunks which differ in full.  The
+	//shard size estimates are not checked for the shards compared this way, since that needs every key value
+	bool useDigests;
+	int digestChunkKeys;
+	int digestChunkBytes;
+
 	bool success;
 
 	//Number of times this client has run its portion of the consistency check
@@ -80,6 +86,9 @@ struct ConsistencyCheckWorkload : TestWorkload
 		failureIsError = getOption(options, LiteralStringRef("failureIsError"), false);
 		rateLimit = getOption(options, LiteralStringRef("rateLimit"), 0);
 		shuffleShards = getOption(options, LiteralStringRef("shuffleShards"), false);
+		useDigests = getOption(options, LiteralStringRef("useDigests"), false);
+		digestChunkKeys = std::max(getOption(options, LiteralStringRef("digestChunkKeys"), 1000), 1);
+		digestChunkBytes = std::max(getOption(options, LiteralStringRef("digestChunkBytes"), 1000000), 1);
 		indefinite = getOption(options, LiteralStringRef("indefinite"), false);
 
 		success = true;
@@ -557,6 +566,36 @@ struct ConsistencyCheckWorkload : TestWorkload
 		}
 	}
 
+	//Returns the end of the chunks which all of the replies agree on, and adds their keys and bytes to shardKeys and shardBytes.
+	//If a chunk differs, sets mismatchEnd to the end of the range after them which has to be compared in full
+	static Key agreedDigestEnd(KeyRef begin, vector<GetRangeDigestReply> const& replies, Optional<Key>& mismatchEnd, int& shardKeys, int& shardBytes)
+	{
+		int minChunks = replies[0].chunks.size();
+		for(auto& r : replies)
+			minChunks = std::min(minChunks, r.chunks.size());
+
+		int i = 0;
+		for(; i < minChunks; i++)
+		{
+			bool agree = true;
+			for(auto& r : replies)
+				agree = agree && r.chunks[i] == replies[0].chunks[i];
+			if(!agree)
+				break;
+			shardKeys += replies[0].chunks[i].count;
+			shardBytes += replies[0].chunks[i].bytes;
+		}
+
+		if(i < minChunks)
+		{
+			Key end = replies[0].chunks[i].end;
+			for(auto& r : replies)
+				end = std::max(end, Key(r.chunks[i].end));
+			mismatchEnd = end;
+		}
+		return i ? Key(replies[0].chunks[i - 1].end) : Key(begin);
+	}
+
 	//Checks that the data in each shard is the same on each storage server that it resides on.  Also performs some sanity checks on the sizes of shards and storage servers.
 	//Returns false if there is a failure
 	ACTOR Future<bool> checkDataConsistency(Database cx, VectorRef<KeyValueRef> keyLocations, DatabaseConfiguration configuration, ConsistencyCheckWorkload *self)
@@ -690,6 +729,15 @@ struct ConsistencyCheckWorkload : TestWorkload
 
 				state KeySelector begin = firstGreaterOrEqual(range.begin);
 
+				//With digests, the shard is read in full only from begin to fullReadEnd when it is present
+				state bool digestMode = self->useDigests;
+				state bool usedDigests = false;
+				state Optional<Key> fullReadEnd;
+				state Version version;
+				for(auto& ssi : storageServerInterfaces)
+					if(!ssi.getRangeDigest.getEndpoint().isValid())
+						digestMode = false;
+
 				//Read a limited number of entries at a time, repeating until all keys in the shard have been read
 				loop
 				{
@@ -698,11 +746,73 @@ struct ConsistencyCheckWorkload : TestWorkload
 						lastSampleKey = lastStartSampleKey;
 
 						//Get the min version of the storage servers
-						Version version = wait(self->getVersion(cx, self));
+						Version minVersion = wait(self->getVersion(cx, self));
+						version = minVersion;
+
+						if(digestMode && !fullReadEnd.present())
+						{
+							state vector<Future<ErrorOr<GetRangeDigestReply>>> digestFutures;
+							digestFutures.clear();
+							for(auto& ssi : storageServerInterfaces)
+								digestFutures.push_back(ssi.getRangeDigest.getReplyUnlessFailedFor(GetRangeDigestRequest(KeyRangeRef(begin.getKey(), range.end), version, self->digestChunkKeys, self->digestChunkBytes), 2, 0));
+
+							Void _ = wait(waitForAll(digestFutures));
+
+							vector<GetRangeDigestReply> digests;
+							totalReadAmount = 0;
+							for(int k = 0; k < digestFutures.size(); k++)
+							{
+								if(digestFutures[k].get().present())
+								{
+									digests.push_back(digestFutures[k].get().get());
+									for(auto& chunk : digests.back().chunks)
+										totalReadAmount += chunk.bytes;
+								}
+								else if(!isRelocating)
+								{
+									TraceEvent("ConsistencyCheck_StorageServerUnavailable").detail("StorageServer", storageServers[k]).detail("ShardBegin", printable(range.begin)).detail("ShardEnd", printable(range.end))
+										.detail("Address", storageServerInterfaces[k].address()).detail("GetRangeDigestToken", storageServerInterfaces[k].getRangeDigest.getEndpoint().token).suppressFor(1.0);
+
+									//All shards should be available in quiscence
+									if(self->performQuiescentChecks)
+									{
+										self->testFailure("Storage server unavailable");
+										return false;
+									}
+								}
+							}
+							if(digests.empty())
+								break;
+
+							usedDigests = true;
+							Optional<Key> mismatchEnd;
+							Key agreedEnd = agreedDigestEnd(begin.getKey(), digests, mismatchEnd, shardKeys, shardBytes);
+							if(!mismatchEnd.present() && agreedEnd == begin.getKey())
+								mismatchEnd = Key(range.end);  //A reply had no chunks to compare, so read the rest of the shard in full
+							bytesReadInRange += totalReadAmount;
+							if(mismatchEnd.present())
+							{
+								TEST(true); // Consistency check found replicas with different digests
+								TraceEvent("ConsistencyCheck_DigestMismatch").detail("ShardBegin", printable(range.begin)).detail("ShardEnd", printable(range.end))
+									.detail("Begin", printable(agreedEnd)).detail("End", printable(mismatchEnd.get()));
+								fullReadEnd = mismatchEnd;
+							}
+							else if(agreedEnd == range.end)
+							{
+								break;
+							}
+							begin = firstGreaterOrEqual(agreedEnd);
+
+							if(self->rateLimit > 0)
+							{
+								Void _ = wait(rateLimiter->getAllowance(totalReadAmount));
+							}
+							continue;
+						}
 
 						state GetKeyValuesRequest req;
 						req.begin = begin;
-						req.end = firstGreaterOrEqual(range.end);
+						req.end = firstGreaterOrEqual(fullReadEnd.present() ? fullReadEnd.get() : range.end);
 						req.limit = 1e4;
 						req.limitBytes = CLIENT_KNOBS->REPLY_BYTE_LIMIT;
 						req.version = version;
@@ -903,6 +1013,12 @@ struct ConsistencyCheckWorkload : TestWorkload
 							ASSERT(begin.getKey() != allKeys.end);
 							lastStartSampleKey = lastSampleKey;
 						}
+						else if(firstValidServer >= 0 && fullReadEnd.present() && fullReadEnd.get() < range.end)
+						{
+							//Go back to comparing digests after the chunks which differed
+							begin = firstGreaterOrEqual(fullReadEnd.get());
+							fullReadEnd = Optional<Key>();
+						}
 						else
 							break;
 					}
@@ -916,7 +1032,8 @@ struct ConsistencyCheckWorkload : TestWorkload
 					}
 				}
 
-				canSplit = canSplit && sampledBytes - splitBytes >= shardBounds.min.bytes && sampledBytes > splitBytes;
+				//The byte sample of the keys compared by digest is not known, so the size estimates are only checked if there were none
+				canSplit = canSplit && !usedDigests && sampledBytes - splitBytes >= shardBounds.min.bytes && sampledBytes > splitBytes;
 
 				//Update the size of all storage servers containing this shard
 				//This is only done in a non-distributed consistency check; the distributed check uses shard size estimates
@@ -927,7 +1044,7 @@ struct ConsistencyCheckWorkload : TestWorkload
 				bool hasValidEstimate = estimatedBytes.size() > 0;
 
 				//If the storage servers' sampled estimate of shard size is different from ours
-				if(self->performQuiescentChecks)
+				if(self->performQuiescentChecks && !usedDigests)
 				{
 					for(int j = 0; j < estimatedBytes.size(); j++)
 					{
@@ -957,7 +1074,7 @@ struct ConsistencyCheckWorkload : TestWorkload
 				int estimateError = abs(shardBytes - sampledBytes);
 
 				//Only perform the check if there are sufficient keys to get a distribution that should resemble a normal distribution
-				if(sampledKeys > 30 && estimateError > failErrorNumStdDev * stdDev)
+				if(!usedDigests && sampledKeys > 30 && estimateError > failErrorNumStdDev * stdDev)
 				{
 					double numStdDev = estimateError / sqrt(shardVariance);
 					TraceEvent("ConsistencyCheck_InaccurateShardEstimate").detail("Min", shardBounds.min.bytes).detail("Max", shardBounds.max.bytes).detail("Estimate", sampledBytes)
@@ -99,8 +99,15 @@ struct KVTest {
 	Version lastCommit;
 	Version lastDurable;
 	Map<Key, IndexedSet<Version, NoMetric>> allSets;
+	Map<Key, IndexedSet<Version, NoMetric>> allClears;  // The versions at which each key in allSets was cleared
 	int nodeCount, keyBytes;
 	bool dispose;
+	int64_t bytesSet;  // The bytes of keys and values given to the store
+
+	enum KeyDistribution { UNIFORM, ZIPFIAN, SEQUENTIAL };
+	KeyDistribution keyDistribution;
+	int nextSequential;
+	double zipfTheta, zipfAlpha, zipfZetan, zipfEta;
 
 	explicit KVTest(int nodeCount, bool dispose, int keyBytes)
 		: store(NULL),
@@ -108,7 +115,11 @@ struct KVTest {
 		  startVersion( Version(time(NULL)) << 30 ),
 		  lastSet(startVersion), lastCommit(startVersion), lastDurable(startVersion),
 		  nodeCount(nodeCount),
-		  keyBytes(keyBytes)
+		  keyBytes(keyBytes),
+		  bytesSet(0),
+		  keyDistribution(UNIFORM),
+		  nextSequential(0),
+		  zipfTheta(0), zipfAlpha(0), zipfZetan(0), zipfEta(0)
 	{
 	}
 	~KVTest() {
@@ -130,10 +141,24 @@ struct KVTest {
 		if (s == allSets.end()) return startVersion;
 		auto& sets = s->value;
 		auto it = sets.lastLessOrEqual(version);
-		return it!=sets.end() ? *it : startVersion;
+		if (it == sets.end()) return startVersion;
+		auto c = allClears.find(key);
+		if (c != allClears.end()) {
+			auto cleared = c->value.lastLessOrEqual(version);
+			if (cleared != c->value.end() && *it < *cleared) return startVersion;
+		}
+		return *it;
+	}
+	// True if key was cleared at a version after version and no later than lastCommit
+	bool clearedAfter(KeyRef key, Version version) {
+		auto c = allClears.find(key);
+		if (c == allClears.end()) return false;
+		auto cleared = c->value.upper_bound(version);
+		return cleared != c->value.end() && *cleared <= lastCommit;
 	}
 	void set( KeyValueRef kv ) {
 		store->set(kv);
+		bytesSet += kv.expectedSize();
 		auto s = allSets.find(kv.key);
 		if (s == allSets.end()) {
 			allSets.insert( MapPair<Key,IndexedSet<Version, NoMetric>>(Key(kv.key), IndexedSet<Version, NoMetric>()) );
@@ -141,8 +166,42 @@ struct KVTest {
 		}
 		s->value.insert( lastSet, NoMetric() );
 	}
+	void clear( KeyRangeRef range ) {
+		store->clear(range);
+		for(auto s = allSets.lower_bound(range.begin); s != allSets.end() && s->key < range.end; ++s)
+			allClears[s->key].insert( lastSet, NoMetric() );
+	}
+
+	// Zipfian over the node indices with skew theta in (0,1), after Gray et al., "Quickly Generating Billion-Record
+	// Synthetic Databases".  Setting it up takes time linear in nodeCount.
+	void setZipfian(double theta) {
+		ASSERT( theta > 0 && theta < 1 );
+		keyDistribution = ZIPFIAN;
+		zipfTheta = theta;
+		zipfZetan = 0;
+		for(int i = 1; i <= nodeCount; i++)
+			zipfZetan += 1 / pow(double(i), theta);
+		zipfAlpha = 1 / (1 - theta);
+		zipfEta = (1 - pow(2.0 / nodeCount, 1 - theta)) / (1 - (1 + pow(0.5, theta)) / zipfZetan);
+	}
 
-	Key randomKey() { return makeKey( g_random->randomInt(0,nodeCount) ); }
+	int randomIndex() {
+		if (keyDistribution == SEQUENTIAL) {
+			int i = nextSequential;
+			nextSequential = (nextSequential + 1) % nodeCount;
+			return i;
+		}
+		if (keyDistribution == ZIPFIAN) {
+			double u = g_random->random01();
+			double uz = u * zipfZetan;
+			int64_t rank = uz < 1 ? 0 : uz < 1 + pow(0.5, zipfTheta) ? 1 : int64_t(nodeCount * pow(zipfEta*u - zipfEta + 1, zipfAlpha));
+			// Scatter the ranks over the key space, so that the hottest keys are not also the closest together
+			uint64_t h = uint64_t(std::min<int64_t>(rank, nodeCount-1)) * 0x9E3779B97F4A7C15ULL;
+			return (h ^ (h >> 32)) % nodeCount;
+		}
+		return g_random->randomInt(0,nodeCount);
+	}
+	Key randomKey() { return makeKey( randomIndex() ); }
 	Key makeKey(Version value) {
 		Key k;
 		((KeyRef&)k) = KeyRef( new (k.arena()) uint8_t[ keyBytes ], keyBytes );
@@ -164,7 +223,7 @@ ACTOR Future<Void> testKVRead( KVTest* test, Key key, Histogram<float>* latency,
 	if (v < test->startVersion) v = test->startVersion;  // ignore older data from the database
 
 	//ASSERT( s1 <= v || test->get(key, s1)==v );  // Plan A
-	ASSERT( s2 <= v || test->get(key, s2)==v );  // Causal consistency
+	ASSERT( s2 <= v || test->get(key, s2)==v || (!val.present() && test->clearedAfter(key, s2)) );  // Causal consistency
 	ASSERT( v <= test->lastCommit );  // read committed
 	//ASSERT( v <= test->lastSet );  // read uncommitted
 	return Void();
@@ -180,6 +239,14 @@ ACTOR Future<Void> testKVReadSaturation( KVTest* test, Histogram<float>* latency
 	}
 }
 
+ACTOR Future<Void> testKVScan( KVTest* test, Key begin, int rows, Histogram<float>* latency, PerfIntCounter* count ) {
+	state double start = timer();
+	Standalone<VectorRef<KeyValueRef>> kv = wait( test->store->readRange( KeyRangeRef(begin, LiteralStringRef("\xff\xff\xff\xff")), rows ) );
+	latency->addSample( timer() - start );
+	++*count;
+	return Void();
+}
+
 ACTOR Future<Void> testKVCommit( KVTest* test, Histogram<float>* latency, PerfIntCounter* count ) {
 	state Version v = test->lastSet;
 	test->lastCommit = v;
@@ -196,17 +263,25 @@ Future<Void> testKVStore( struct KVStoreTestWorkload *const& );
 struct KVStoreTestWorkload : TestWorkload {
 	bool enabled, saturation;
 	double testDuration, operationsPerSecond;
-	double commitFraction, setFraction;
-	int nodeCount, keyBytes, valueBytes;
+	double commitFraction, setFraction, scanFraction, clearFraction;
+	int nodeCount, keyBytes, valueBytes, minValueBytes, scanRows, clearRows;
 	bool doSetup, doClear, doCount;
 	std::string filename;
-	PerfIntCounter reads, sets, commits;
-	Histogram<float> readLatency, commitLatency;
-	double setupTook;
+	std::string keyDistribution;
+	double zipfianTheta;
+	PerfIntCounter reads, sets, commits, scans, clears;
+	Histogram<float> readLatency, commitLatency, scanLatency;
+	double setupTook, clearTook;
 	std::string storeType;
+	int64_t memoryBytes;
+
+	// Measures of the engine itself, taken over the whole run
+	double writeAmplification, cacheHitRate;
+	int64_t bytesUsed;
 
 	KVStoreTestWorkload( WorkloadContext const& wcx )
-		: TestWorkload(wcx), reads("Reads"), sets("Sets"), commits("Commits"), setupTook(0)
+		: TestWorkload(wcx), reads("Reads"), sets("Sets"), commits("Commits"), scans("Scans"), clears("Clears"), setupTook(0), clearTook(0),
+		  writeAmplification(-1), cacheHitRate(-1), bytesUsed(-1)
 	{
 		enabled = !clientId; // only do this on the "first" client
 		testDuration = getOption( options, LiteralStringRef("testDuration"), 10.0 );
@@ -216,12 +291,23 @@ struct KVStoreTestWorkload : TestWorkload {
 		nodeCount = getOption( options, LiteralStringRef("nodeCount"), 100000 );
 		keyBytes = getOption( options, LiteralStringRef("keyBytes"), 8 );
 		valueBytes = getOption( options, LiteralStringRef("valueBytes"), 8 );
+		minValueBytes = getOption( options, LiteralStringRef("minValueBytes"), valueBytes );
+		ASSERT( minValueBytes >= sizeof(Version) && minValueBytes <= valueBytes );
+		// Operations that are not commits, sets, scans or clears are reads
+		scanFraction = getOption( options, LiteralStringRef("scanFraction"), 0.0 );
+		scanRows = getOption( options, LiteralStringRef("scanRows"), 100 );
+		clearFraction = getOption( options, LiteralStringRef("clearFraction"), 0.0 );
+		clearRows = getOption( options, LiteralStringRef("clearRows"), 100 );
+		// "uniform", "zipfian" or "sequential"
+		keyDistribution = getOption( options, LiteralStringRef("keyDistribution"), LiteralStringRef("uniform") ).toString();
+		zipfianTheta = getOption( options, LiteralStringRef("zipfianTheta"), 0.99 );
 		doSetup = getOption( options, LiteralStringRef("setup"), false );
 		doClear = getOption( options, LiteralStringRef("clear"), false );
 		doCount = getOption( options, LiteralStringRef("count"), false );
 		filename = getOption( options, LiteralStringRef("filename"), Value() ).toString();
 		saturation = getOption( options, LiteralStringRef("saturation"), false );
 		storeType = getOption( options, LiteralStringRef("storeType"), LiteralStringRef("ssd") ).toString();
+		memoryBytes = getOption( options, LiteralStringRef("memoryBytes"), (int64_t)500e6 );
 	}
 	virtual std::string description() { return "KVStoreTest"; }
 	virtual Future<Void> setup( Database const& cx ) { return Void(); }
@@ -244,9 +330,22 @@ struct KVStoreTestWorkload : TestWorkload {
 		m.push_back(reads.getMetric());
 		m.push_back(sets.getMetric());
 		m.push_back(commits.getMetric());
+		m.push_back(scans.getMetric());
+		m.push_back(clears.getMetric());
 		metricsFromHistogram(m, "Read Latency (ms)", readLatency);
 		metricsFromHistogram(m, "Commit Latency (ms)", commitLatency);
+		if (scans.getValue()) metricsFromHistogram(m, "Scan Latency (ms)", scanLatency);
+		if (clearTook) m.push_back( PerfMetric("ClearTook", clearTook, false) );
+
+		if (writeAmplification >= 0) m.push_back( PerfMetric("Write Amplification", writeAmplification, false) );
+		if (cacheHitRate >= 0) m.push_back( PerfMetric("Cache Hit Rate", cacheHitRate, false) );
+		if (bytesUsed >= 0) m.push_back( PerfMetric("Disk Bytes Used", bytesUsed, false) );
+		// Above 1 the data does not fit in the page cache of the ssd engines, and reads must go to disk
+		m.push_back( PerfMetric("Working Set / Page Cache", nodeCount * (keyBytes + (minValueBytes+valueBytes)*0.5) / FLOW_KNOBS->PAGE_CACHE_4K, false) );
 	}
+
+	// The bytes of a value of random size between minValueBytes and valueBytes after the version that starts it
+	int randomExtraBytes() const { return g_random->randomInt(minValueBytes, valueBytes+1) - sizeof(Version); }
 };
 
 WorkloadFactory<KVStoreTestWorkload> KVStoreTestWorkloadFactory("KVStoreTest");
@@ -288,7 +387,9 @@ ACTOR Future<Void> testKVStoreMain( KVStoreTestWorkload* workload, KVTest* ptest
 		state Future<Void> lastCommit = Void();
 		state int i;
 		for(i=0; i<workload->nodeCount; i++) {
-			test.store->set( KeyValueRef( test.makeKey( i ), wr.toStringRef() ) );
+			KeyValueRef kv( test.makeKey( i ), wr.toStringRef().substr( 0, sizeof(Version) + workload->randomExtraBytes() ) );
+			test.store->set( kv );
+			test.bytesSet += kv.expectedSize();
 			if (!((i+1) % 10000) || i+1==workload->nodeCount) {
 				Void _ = wait( lastCommit );
 				lastCommit = test.store->commit();
@@ -309,7 +410,7 @@ ACTOR Future<Void> testKVStoreMain( KVStoreTestWorkload* workload, KVTest* ptest
 				{
 					++test.lastSet;
 					BinaryWriter wr(Unversioned()); wr << test.lastSet;
-					wr.serializeBytes(extraValue, extraBytes);
+					wr.serializeBytes(extraValue, workload->randomExtraBytes());
 					test.set( KeyValueRef( test.randomKey(), wr.toStringRef() ) );
 					++workload->sets;
 				}
@@ -338,9 +439,18 @@ ACTOR Future<Void> testKVStoreMain( KVStoreTestWorkload* workload, KVTest* ptest
 					// Set
 					++test.lastSet;
 					BinaryWriter wr(Unversioned()); wr << test.lastSet;
-					wr.serializeBytes(extraValue, extraBytes);
+					wr.serializeBytes(extraValue, workload->randomExtraBytes());
 					test.set( KeyValueRef( test.randomKey(), wr.toStringRef() ) );
 					++workload->sets;
+				} else if (op < workload->commitFraction+workload->setFraction+workload->scanFraction) {
+					// Scan
+					ac.add( testKVScan( &test, test.randomKey(), workload->scanRows, &workload->scanLatency, &workload->scans ) );
+				} else if (op < workload->commitFraction+workload->setFraction+workload->scanFraction+workload->clearFraction) {
+					// Clear
+					++test.lastSet;
+					int begin = test.randomIndex();
+					test.clear( KeyRangeRef( test.makeKey( begin ), test.makeKey( begin + workload->clearRows ) ) );
+					++workload->clears;
 				} else {
 					// Read
 					ac.add( testKVRead( &test, test.randomKey(), &workload->readLatency, &workload->reads ) );
@@ -358,7 +468,8 @@ ACTOR Future<Void> testKVStoreMain( KVStoreTestWorkload* workload, KVTest* ptest
 			test.store->clear( KeyRangeRef(  test.makeKey( i ),  test.makeKey( i + chunk ) ) );
 			Void _ = wait( test.store->commit() );
 		}
-		TraceEvent("KVStoreClear").detail("Took", timer() - t);
+		workload->clearTook = timer() - t;
+		TraceEvent("KVStoreClear").detail("Took", workload->clearTook);
 	}
 
 	return Void();
@@ -367,6 +478,12 @@ ACTOR Future<Void> testKVStoreMain( KVStoreTestWorkload* workload, KVTest* ptest
 ACTOR Future<Void> testKVStore(KVStoreTestWorkload* workload) {
 	state KVTest test( workload->nodeCount, !workload->filename.size(), workload->keyBytes );
 	state Error err;
+	state Int64MetricHandle cacheHits( LiteralStringRef("AsyncFile.CountCacheHits") );
+	state Int64MetricHandle cacheMisses( LiteralStringRef("AsyncFile.CountCacheMisses") );
+	state int64_t hitsBefore = cacheHits;
+	state int64_t missesBefore = cacheMisses;
+	state SystemStatisticsState* diskStats = NULL;
+	state std::string dataFolder;
 
 	//Void _ = wait( delay(1) );
 	TraceEvent("GO");
@@ -380,10 +497,25 @@ ACTOR Future<Void> testKVStore(KVStoreTestWorkload* workload) {
 	else if (workload->storeType == "ssd-2")
 		test.store = keyValueStoreSQLite( fn, id, KeyValueStoreType::SSD_BTREE_V2);
 	else if (workload->storeType == "memory")
-		test.store = keyValueStoreMemory( fn, id, 500e6 );
+		test.store = keyValueStoreMemory( fn, id, workload->memoryBytes );
+	else if (workload->storeType == "ssd-lsm")
+		test.store = keyValueStoreLSM( fn, id );
 	else
 		ASSERT(false);
 
+	if (workload->keyDistribution == "zipfian")
+		test.setZipfian( workload->zipfianTheta );
+	else if (workload->keyDistribution == "sequential")
+		test.keyDistribution = KVTest::SEQUENTIAL;
+	else
+		ASSERT( workload->keyDistribution == "uniform" );
+
+	// Disk statistics are for the whole device holding the store, so write amplification is only meaningful when
+	// nothing else is writing to it
+	dataFolder = parentDirectory( fn );
+	if (!g_network->isSimulated())
+		getSystemStatistics( dataFolder, 0, &diskStats );
+
 	state Future<Void> main = testKVStoreMain( workload, &test );
 	try {
 		choose {
@@ -395,6 +527,19 @@ ACTOR Future<Void> testKVStore(KVStoreTestWorkload* workload) {
 	}
 	main.cancel();
 
+	if (err.code() == invalid_error_code) {
+		workload->bytesUsed = test.store->getStorageBytes().used;
+		if (!g_network->isSimulated() && test.bytesSet) {
+			SystemStatistics disk = getSystemStatistics( dataFolder, 0, &diskStats );
+			workload->writeAmplification = disk.processDiskWriteSectors * 512 / test.bytesSet;
+		}
+		int64_t lookups = (cacheHits - hitsBefore) + (cacheMisses - missesBefore);
+		if (lookups)
+			workload->cacheHitRate = double(cacheHits - hitsBefore) / lookups;
+		TraceEvent("KVStoreEngine").detail("BytesSet", test.bytesSet).detail("BytesUsed", workload->bytesUsed)
+			.detail("WriteAmplification", workload->writeAmplification).detail("CacheHitRate", workload->cacheHitRate);
+	}
+
 	Future<Void> c = test.store->onClosed();
 	test.close();
 	Void _ = wait( c );
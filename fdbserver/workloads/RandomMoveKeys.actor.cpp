@@ -117,7 +117,7 @@ struct MoveKeysWorkload : TestWorkload {
 	ACTOR Future<Void> doMoveKeys(Database cx, MoveKeysWorkload *self, KeyRange keys, vector<StorageServerInterface> destinationTeam, 
 			MoveKeysLock lock, std::string dbName ) {
 		state TraceInterval relocateShardInterval("RelocateShard");
-		state FlowLock fl1(1);
+		state StartMoveKeysQueue startQueue(1);
 		state FlowLock fl2(1);
 		std::string desc;
 		for(int s=0; s<destinationTeam.size(); s++)
@@ -136,7 +136,7 @@ struct MoveKeysWorkload : TestWorkload {
 			state Promise<Void> signal;
 			Void _ = wait( moveKeys( cx, keys, destinationTeamIDs, destinationTeamIDs, lock, 
 										self->configuration.durableStorageQuorum, 
-										signal, &fl1, &fl2, relocateShardInterval.pairID ) );
+										signal, &startQueue, &fl2, relocateShardInterval.pairID ) );
 			TraceEvent(relocateShardInterval.end()).detail("Result","Success");
 			return Void();
 		} catch (Error& e) {
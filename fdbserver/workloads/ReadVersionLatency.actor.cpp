@@ -0,0 +1,107 @@
+/*
+ * ReadVersionLatency.actor.cpp
+ *
+ * This source file is part of the FoundationDB open source project
+ *
+ * Copyright 2013-2018 Apple Inc. and the FoundationDB project authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "flow/actorcompiler.h"
+#include "fdbrpc/ContinuousSample.h"
+#include "fdbclient/NativeAPI.h"
+#include "fdbserver/TesterInterface.h"
+#include "workloads.h"
+
+// Measures the latency of getting read versions with and without causal_read_risky and causal_read_gossiped, with the
+// same number of transactions starting in each mode at once
+struct ReadVersionLatencyWorkload : TestWorkload {
+	enum { MODE_DEFAULT, MODE_CAUSAL_READ_RISKY, MODE_CAUSAL_READ_GOSSIPED, MODE_COUNT };
+
+	double testDuration;
+	int actorsPerMode;
+	vector<Future<Void>> clients;
+	vector<ContinuousSample<double>> latencies;
+	vector<PerfIntCounter> transactions;
+	PerfIntCounter retries;
+
+	ReadVersionLatencyWorkload(WorkloadContext const& wcx)
+		: TestWorkload(wcx), retries("Retries")
+	{
+		testDuration = getOption( options, LiteralStringRef("testDuration"), 10.0 );
+		actorsPerMode = getOption( options, LiteralStringRef("actorsPerMode"), 20 );
+		for(int i = 0; i < MODE_COUNT; i++) {
+			latencies.push_back( ContinuousSample<double>(10000) );
+			transactions.push_back( PerfIntCounter( modeName(i) + " Transactions" ) );
+		}
+	}
+
+	static std::string modeName( int mode ) {
+		return mode == MODE_DEFAULT ? "Default" : mode == MODE_CAUSAL_READ_RISKY ? "CausalReadRisky" : "CausalReadGossiped";
+	}
+
+	virtual std::string description() { return "ReadVersionLatency"; }
+
+	virtual Future<Void> setup( Database const& cx ) {
+		return Void();
+	}
+
+	virtual Future<Void> start( Database const& cx ) {
+		for(int mode = 0; mode < MODE_COUNT; mode++)
+			for(int c = 0; c < actorsPerMode; c++)
+				clients.push_back( timeout( getReadVersions( cx, this, mode ), testDuration, Void() ) );
+		return waitForAll( clients );
+	}
+
+	ACTOR static Future<Void> getReadVersions( Database cx, ReadVersionLatencyWorkload* self, int mode ) {
+		loop {
+			state Transaction tr( cx );
+			state double start = now();
+			loop {
+				try {
+					if( mode == MODE_CAUSAL_READ_RISKY )
+						tr.setOption( FDBTransactionOptions::CAUSAL_READ_RISKY );
+					else if( mode == MODE_CAUSAL_READ_GOSSIPED )
+						tr.setOption( FDBTransactionOptions::CAUSAL_READ_GOSSIPED );
+					Version _ = wait( tr.getReadVersion() );
+					break;
+				} catch( Error &e ) {
+					Void _ = wait( tr.onError(e) );
+					++self->retries;
+				}
+			}
+			self->latencies[mode].addSample( now() - start );
+			++self->transactions[mode];
+		}
+	}
+
+	virtual Future<bool> check( Database const& cx ) {
+		clients.clear();
+		return true;
+	}
+
+	virtual void getMetrics( vector<PerfMetric>& m ) {
+		for(int mode = 0; mode < MODE_COUNT; mode++) {
+			std::string name = modeName(mode);
+			m.push_back( PerfMetric( name + " Transactions/sec", transactions[mode].getValue() / testDuration, false ) );
+			m.push_back( PerfMetric( name + " Mean GRV Latency (ms)", 1000 * latencies[mode].mean(), true ) );
+			m.push_back( PerfMetric( name + " Median GRV Latency (ms)", 1000 * latencies[mode].median(), true ) );
+			m.push_back( PerfMetric( name + " 90% GRV Latency (ms)", 1000 * latencies[mode].percentile(0.90), true ) );
+			m.push_back( PerfMetric( name + " 99% GRV Latency (ms)", 1000 * latencies[mode].percentile(0.99), true ) );
+		}
+		m.push_back( retries.getMetric() );
+	}
+};
+
+WorkloadFactory<ReadVersionLatencyWorkload> ReadVersionLatencyWorkloadFactory("ReadVersionLatency");
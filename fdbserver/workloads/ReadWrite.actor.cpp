@@ -28,6 +28,7 @@
 #include "fdbserver/ClusterRecruitmentInterface.h"
 #include "fdbclient/ReadYourWrites.h"
 #include "flow/TDMetric.actor.h"
+#include "flow/ActorCollection.h"
 
 #include <boost/lexical_cast.hpp>
 
@@ -96,6 +97,11 @@ struct ReadWriteWorkload : KVWorkload {
 	bool useRYW;
 	bool rampTransactionType;
 	bool rampUpConcurrency;
+	bool openLoop;
+	bool fixedArrivals;
+	int openLoopRateSteps;
+	int maxOutstanding;
+	double openLoopRate;
 
 	Int64MetricHandle totalReadsMetric;
 	Int64MetricHandle totalRetriesMetric;
@@ -107,6 +113,8 @@ struct ReadWriteWorkload : KVWorkload {
 	PerfIntCounter aTransactions, bTransactions, retries;
 	ContinuousSample<double> latencies, readLatencies, commitLatencies, GRVLatencies, fullReadLatencies;
 	double readLatencyTotal; int readLatencyCount;
+	ContinuousSample<double> stepLatencies;
+	int64_t stepTransactions;
 
 	vector<uint64_t> insertionCountsToMeasure;
 	vector<pair<uint64_t, double> > ratesAtKeyCounts;
@@ -119,7 +127,7 @@ struct ReadWriteWorkload : KVWorkload {
 		: KVWorkload(wcx),
 		latencies( sampleSize ), readLatencies( sampleSize ), fullReadLatencies( sampleSize ), 
 		commitLatencies( sampleSize ), GRVLatencies( sampleSize ), readLatencyTotal( 0 ), 
-		readLatencyCount(0), loadTime(0.0), dependentReads(false), adjacentReads(false), adjacentWrites(false),
+		readLatencyCount(0), stepLatencies( sampleSize ), stepTransactions(0), loadTime(0.0), dependentReads(false), adjacentReads(false), adjacentWrites(false),
 		clientBegin(0),	aTransactions("A Transactions"), bTransactions("B Transactions"), retries("Retries"),
 		totalReadsMetric(LiteralStringRef("RWWorkload.TotalReads")),
 		totalRetriesMetric(LiteralStringRef("RWWorkload.TotalRetries"))
@@ -175,7 +183,19 @@ struct ReadWriteWorkload : KVWorkload {
 		rampUpConcurrency = getOption(options, LiteralStringRef("rampUpConcurrency"), false);
 		doSetup = getOption(options, LiteralStringRef("setup"), true);
 
+		// openLoop starts transactions at transactionsPerSecond whether or not earlier ones have finished, with arrivals
+		// that are "poisson" or "fixed" in time.  With openLoopRateSteps > 1 the rate is stepped up to transactionsPerSecond
+		// over the test, and each step is reported on its own.
+		openLoop = getOption(options, LiteralStringRef("openLoop"), false);
+		Value arrivals = getOption(options, LiteralStringRef("arrivals"), LiteralStringRef("poisson"));
+		ASSERT( arrivals == LiteralStringRef("poisson") || arrivals == LiteralStringRef("fixed") );
+		fixedArrivals = arrivals == LiteralStringRef("fixed");
+		openLoopRateSteps = std::max(getOption(options, LiteralStringRef("openLoopRateSteps"), 1), 1);
+		maxOutstanding = std::max(getOption(options, LiteralStringRef("maxOutstandingTransactions"), actorCount), 1);
+		openLoopRate = transactionsPerSecond / openLoopRateSteps;
+
 		if (rampUpConcurrency) ASSERT( rampSweepCount == 2 );  // Implementation is hard coded to ramp up and down
+		if (openLoop) ASSERT( !rampUpConcurrency && !rampUpLoad );
 
 		// Validate that keyForIndex() is monotonic
 		for (int i = 0; i < 30; i++) {
@@ -268,6 +288,8 @@ struct ReadWriteWorkload : KVWorkload {
 			m.push_back(PerfMetric("Median Latency (ms, averaged)", 1000 * latencies.median(), true));
 			m.push_back(PerfMetric("90% Latency (ms, averaged)", 1000 * latencies.percentile(0.90), true));
 			m.push_back(PerfMetric("98% Latency (ms, averaged)", 1000 * latencies.percentile(0.98), true));
+			m.push_back(PerfMetric("99% Latency (ms, averaged)", 1000 * latencies.percentile(0.99), true));
+			m.push_back(PerfMetric("99.9% Latency (ms, averaged)", 1000 * latencies.percentile(0.999), true));
 			m.push_back(PerfMetric("Max Latency (ms, averaged)", 1000 * latencies.max(), true));
 
 			m.push_back(PerfMetric("Mean Row Read Latency (ms)", 1000 * readLatencies.mean(), true));
@@ -410,7 +432,12 @@ struct ReadWriteWorkload : KVWorkload {
 			return Void();
 		if (!self->dependentReads){
 			std::vector<Future<Void>> readers;
-			if (self->rangeReads) {
+			if (self->rangeReads && self->adjacentReads) {
+				// The adjacent keys are read as one range
+				self->totalReadsMetric += keys.size();
+				readers.push_back(logLatency(tr->getRange(KeyRangeRef(self->keyForIndex(keys.front()), self->keyForIndex(keys.back() + 1)), GetRangeLimits(keys.size())), &self->readLatencies, &self->readLatencyTotal, &self->readLatencyCount, self->readMetric, shouldRecord));
+			}
+			else if (self->rangeReads) {
 				for (int op = 0; op < keys.size(); op++) {
 					++self->totalReadsMetric;
 					readers.push_back(logLatency(tr->getRange(KeyRangeRef(self->keyForIndex(keys[op]), Key(strinc(self->keyForIndex(keys[op])))), GetRangeLimits(-1, 80000)), &self->readLatencies, &self->readLatencyTotal, &self->readLatencyCount, self->readMetric, shouldRecord));
@@ -472,18 +499,34 @@ struct ReadWriteWorkload : KVWorkload {
 			clients.push_back(tracePeriodically(self));
 
 		self->clientBegin = now();
-		for(int c = 0; c < self->actorCount; c++) {
-			Future<Void> worker;
+		Future<Void> sweep;
+		if(self->openLoop) {
+			sweep = openLoopSweep(self);
 			if (self->useRYW)
-				worker = self->randomReadWriteClient<ReadYourWritesTransaction>(cx, self, self->actorCount / self->transactionsPerSecond, c);
+				clients.push_back(self->openLoopClient<ReadYourWritesTransaction>(cx, self));
 			else
-				worker = self->randomReadWriteClient<Transaction>(cx, self, self->actorCount / self->transactionsPerSecond, c);
-			clients.push_back(worker);
+				clients.push_back(self->openLoopClient<Transaction>(cx, self));
+		}
+		else {
+			for(int c = 0; c < self->actorCount; c++) {
+				Future<Void> worker;
+				if (self->useRYW)
+					worker = self->randomReadWriteClient<ReadYourWritesTransaction>(cx, self, self->actorCount / self->transactionsPerSecond, c);
+				else
+					worker = self->randomReadWriteClient<Transaction>(cx, self, self->actorCount / self->transactionsPerSecond, c);
+				clients.push_back(worker);
+			}
 		}
 
 		if (!self->cancelWorkersAtDuration) self->clients = clients; // Don't cancel them until check()
 
-		Void _ = wait( self->cancelWorkersAtDuration ? timeout( waitForAll( clients ), self->testDuration, Void() ) : delay( self->testDuration ) );
+		if(self->openLoop) {
+			// The sweep takes testDuration, and ends the test only once it has recorded its last step
+			Void _ = wait( sweep || ( self->cancelWorkersAtDuration ? waitForAll( clients ) : Never() ) );
+		}
+		else {
+			Void _ = wait( self->cancelWorkersAtDuration ? timeout( waitForAll( clients ), self->testDuration, Void() ) : delay( self->testDuration ) );
+		}
 		return Void();
 	}
 
@@ -516,8 +559,6 @@ struct ReadWriteWorkload : KVWorkload {
 	Future<Void> randomReadWriteClient( Database cx, ReadWriteWorkload *self, double delay, int clientIndex ) {
 		state double startTime = now();
 		state double lastTime = now();
-		state double GRVStartTime;
-		state UID debugID;
 
 		if (self->rampUpConcurrency) {
 			Void _  = wait( ::delay( self->testDuration/2 * (double(clientIndex) / self->actorCount + double(self->clientId) / self->clientCount / self->actorCount) ) );
@@ -535,128 +576,194 @@ struct ReadWriteWorkload : KVWorkload {
 				}
 			}
 
-			if(!self->rampUpLoad || g_random->random01() < self->sweepAlpha(startTime))
-			{
-				state double tstart = now();
-				state bool aTransaction = g_random->random01() > (self->rampTransactionType ? self->sweepAlpha(startTime) : self->alpha);
-
-				state vector<int64_t> keys;
-				state vector<Value> values;
-				state vector<KeyRange> extra_ranges;
-				int reads = aTransaction ? self->readsPerTransactionA : self->readsPerTransactionB;
-				state int writes = aTransaction ? self->writesPerTransactionA : self->writesPerTransactionB;
-				state int extra_read_conflict_ranges = writes ? self->extraReadConflictRangesPerTransaction : 0;
-				state int extra_write_conflict_ranges = writes ? self->extraWriteConflictRangesPerTransaction : 0;
-				if(!self->adjacentReads) {
-					for(int op = 0; op < reads; op++)
-						keys.push_back(self->getRandomKey(self->nodeCount));
-				}
-				else {
-					int startKey = self->getRandomKey(self->nodeCount - reads);
-					for(int op = 0; op < reads; op++)
-						keys.push_back(startKey + op);
-				}
+			if(!self->rampUpLoad || g_random->random01() < self->sweepAlpha(startTime)) {
+				Void _ = wait( self->randomTransaction<Trans>( cx, self, now(), startTime ) );
+			}
+		}
+	}
+
+	// Runs a random transaction to completion, retrying it as needed, and records its latency from tstart
+	ACTOR template <class Trans>
+	Future<Void> randomTransaction( Database cx, ReadWriteWorkload *self, double tstart, double startTime ) {
+		state double GRVStartTime;
+		state UID debugID;
+		state bool aTransaction = g_random->random01() > (self->rampTransactionType ? self->sweepAlpha(startTime) : self->alpha);
+
+		state vector<int64_t> keys;
+		state vector<Value> values;
+		state vector<KeyRange> extra_ranges;
+		int reads = aTransaction ? self->readsPerTransactionA : self->readsPerTransactionB;
+		state int writes = aTransaction ? self->writesPerTransactionA : self->writesPerTransactionB;
+		state int extra_read_conflict_ranges = writes ? self->extraReadConflictRangesPerTransaction : 0;
+		state int extra_write_conflict_ranges = writes ? self->extraWriteConflictRangesPerTransaction : 0;
+		if(!self->adjacentReads) {
+			for(int op = 0; op < reads; op++)
+				keys.push_back(self->getRandomKey(self->nodeCount));
+		}
+		else {
+			int startKey = self->getRandomKey(self->nodeCount - reads);
+			for(int op = 0; op < reads; op++)
+				keys.push_back(startKey + op);
+		}
+
+		for (int op = 0; op<writes; op++)
+			values.push_back(self->randomValue());
+
+		for (int op = 0; op<extra_read_conflict_ranges + extra_write_conflict_ranges; op++)
+			extra_ranges.push_back(singleKeyRange( g_random->randomUniqueID().toString() ));
+
+		state Trans tr(cx);
+		if(tstart - self->clientBegin > self->debugTime && tstart - self->clientBegin <= self->debugTime + self->debugInterval) {
+			debugID = g_random->randomUniqueID();
+			tr.debugTransaction(debugID);
+			g_traceBatch.addEvent("TransactionDebug", debugID.first(), "ReadWrite.randomReadWriteClient.Before");
+		}
+		else {
+			debugID = UID();
+		}
+
+		self->transactionSuccessMetric->retries = 0;
+		self->transactionSuccessMetric->commitLatency = -1;
+
+		loop{
+			try {
+				GRVStartTime = now();
+				self->transactionFailureMetric->startLatency = -1;
+
+				Version v = wait(self->inconsistentReads ? getInconsistentReadVersion(cx) : tr.getReadVersion());
+				if(self->inconsistentReads) tr.setVersion(v);
+
+				double grvLatency = now() - GRVStartTime;
+				self->transactionSuccessMetric->startLatency = grvLatency * 1e9;
+				self->transactionFailureMetric->startLatency = grvLatency * 1e9;
+				if( self->shouldRecord() )
+					self->GRVLatencies.addSample(grvLatency);
+
+				state double readStart = now();
+				Void _ = wait(self->readOp(&tr, keys, self, self->shouldRecord()));
 
-				for (int op = 0; op<writes; op++)
-					values.push_back(self->randomValue());
+				double readLatency = now() - readStart;
+				if( self->shouldRecord() )
+					self->fullReadLatencies.addSample(readLatency);
 
-				for (int op = 0; op<extra_read_conflict_ranges + extra_write_conflict_ranges; op++)
-					extra_ranges.push_back(singleKeyRange( g_random->randomUniqueID().toString() ));
+				if(!writes)
+					break;
 
-				state Trans tr(cx);
-				if(tstart - self->clientBegin > self->debugTime && tstart - self->clientBegin <= self->debugTime + self->debugInterval) {
-					debugID = g_random->randomUniqueID();
-					tr.debugTransaction(debugID);
-					g_traceBatch.addEvent("TransactionDebug", debugID.first(), "ReadWrite.randomReadWriteClient.Before");
+				if (self->adjacentWrites) {
+					int64_t startKey = self->getRandomKey(self->nodeCount - writes);
+					for (int op = 0; op < writes; op++)
+						tr.set(self->keyForIndex(startKey+op, false), values[op]);
 				}
 				else {
-					debugID = UID();
+					for (int op = 0; op < writes; op++)
+						tr.set(self->keyForIndex(self->getRandomKey(self->nodeCount), false), values[op]);
 				}
+				for (int op = 0; op < extra_read_conflict_ranges; op++)
+					tr.addReadConflictRange(extra_ranges[op]);
+				for (int op = 0; op < extra_write_conflict_ranges; op++)
+					tr.addWriteConflictRange(extra_ranges[op + extra_read_conflict_ranges]);
 
-				self->transactionSuccessMetric->retries = 0;
-				self->transactionSuccessMetric->commitLatency = -1;
-
-				loop{
-					try {
-						GRVStartTime = now();
-						self->transactionFailureMetric->startLatency = -1;
-
-						Version v = wait(self->inconsistentReads ? getInconsistentReadVersion(cx) : tr.getReadVersion());
-						if(self->inconsistentReads) tr.setVersion(v);
-
-						double grvLatency = now() - GRVStartTime;
-						self->transactionSuccessMetric->startLatency = grvLatency * 1e9;
-						self->transactionFailureMetric->startLatency = grvLatency * 1e9;
-						if( self->shouldRecord() )
-							self->GRVLatencies.addSample(grvLatency);
-
-						state double readStart = now();
-						Void _ = wait(self->readOp(&tr, keys, self, self->shouldRecord()));
-
-						double readLatency = now() - readStart;
-						if( self->shouldRecord() )
-							self->fullReadLatencies.addSample(readLatency);
-
-						if(!writes)
-							break;
-
-						if (self->adjacentWrites) {
-							int64_t startKey = self->getRandomKey(self->nodeCount - writes);
-							for (int op = 0; op < writes; op++)
-								tr.set(self->keyForIndex(startKey+op, false), values[op]);
-						}
-						else {
-							for (int op = 0; op < writes; op++)
-								tr.set(self->keyForIndex(self->getRandomKey(self->nodeCount), false), values[op]);
-						}
-						for (int op = 0; op < extra_read_conflict_ranges; op++)
-							tr.addReadConflictRange(extra_ranges[op]);
-						for (int op = 0; op < extra_write_conflict_ranges; op++)
-							tr.addWriteConflictRange(extra_ranges[op + extra_read_conflict_ranges]);
-
-						state double commitStart = now();
-						Void _ = wait(tr.commit());
-
-						double commitLatency = now() - commitStart;
-						self->transactionSuccessMetric->commitLatency = commitLatency * 1e9;
-						if( self->shouldRecord() )
-							self->commitLatencies.addSample(commitLatency);
-
-						break;
-					}
-					catch(Error& e) {
-						self->transactionFailureMetric->errorCode = e.code();
-						self->transactionFailureMetric->log();
-
-						Void _ = wait(tr.onError(e));
-
-						++self->transactionSuccessMetric->retries;
-						++self->totalRetriesMetric;
-
-						if(self->shouldRecord())
-							++self->retries;
-					}
-				}
+				state double commitStart = now();
+				Void _ = wait(tr.commit());
 
-				if(debugID != UID())
-					g_traceBatch.addEvent("TransactionDebug", debugID.first(), "ReadWrite.randomReadWriteClient.After");
+				double commitLatency = now() - commitStart;
+				self->transactionSuccessMetric->commitLatency = commitLatency * 1e9;
+				if( self->shouldRecord() )
+					self->commitLatencies.addSample(commitLatency);
 
-				tr = Trans();
+				break;
+			}
+			catch(Error& e) {
+				self->transactionFailureMetric->errorCode = e.code();
+				self->transactionFailureMetric->log();
 
-				double transactionLatency = now() - tstart;
-				self->transactionSuccessMetric->totalLatency = transactionLatency * 1e9;
-				self->transactionSuccessMetric->log();
+				Void _ = wait(tr.onError(e));
 
-				if(self->shouldRecord()) {
-					if(aTransaction)
-						++self->aTransactions;
-					else
-						++self->bTransactions;
+				++self->transactionSuccessMetric->retries;
+				++self->totalRetriesMetric;
 
-					self->latencies.addSample(transactionLatency);
-				}
+				if(self->shouldRecord())
+					++self->retries;
 			}
 		}
+
+		if(debugID != UID())
+			g_traceBatch.addEvent("TransactionDebug", debugID.first(), "ReadWrite.randomReadWriteClient.After");
+
+		tr = Trans();
+
+		double transactionLatency = now() - tstart;
+		self->transactionSuccessMetric->totalLatency = transactionLatency * 1e9;
+		self->transactionSuccessMetric->log();
+
+		if(self->shouldRecord()) {
+			if(aTransaction)
+				++self->aTransactions;
+			else
+				++self->bTransactions;
+
+			self->latencies.addSample(transactionLatency);
+		}
+
+		if(self->openLoop) {
+			++self->stepTransactions;
+			self->stepLatencies.addSample(transactionLatency);
+		}
+		return Void();
+	}
+
+	ACTOR template <class Trans>
+	Future<Void> openLoopTransaction( Database cx, ReadWriteWorkload *self, Reference<FlowLock> outstanding, double arrivalTime, double startTime ) {
+		state FlowLock::Releaser releaser( *outstanding );
+		Void _ = wait( self->randomTransaction<Trans>( cx, self, arrivalTime, startTime ) );
+		return Void();
+	}
+
+	// Starts transactions as they arrive at openLoopRate, without waiting for earlier ones to finish, so that a slow
+	// database sees the same offered load rather than a load that backs off with it.  Each transaction's latency is
+	// measured from its arrival, so the time an arrival spends waiting for one of the maxOutstanding slots is counted
+	// instead of omitted.
+	ACTOR template <class Trans>
+	Future<Void> openLoopClient( Database cx, ReadWriteWorkload *self ) {
+		state double startTime = now();
+		state double lastTime = now();
+		state Reference<FlowLock> outstanding( new FlowLock( self->maxOutstanding ) );
+		state ActorCollection transactions( false );
+		state Future<Void> errors = transactions.getResult();
+
+		loop {
+			Void _ = wait( ( self->fixedArrivals ? uniform( &lastTime, 1.0 / self->openLoopRate ) : poisson( &lastTime, 1.0 / self->openLoopRate ) ) || errors );
+			TEST( outstanding->available() <= 0 ); // ReadWrite open loop client is at maxOutstanding
+			Void _ = wait( outstanding->take() || errors );
+			transactions.add( self->openLoopTransaction<Trans>( cx, self, outstanding, lastTime, startTime ) );
+		}
+	}
+
+	// Raises openLoopRate in openLoopRateSteps equal steps up to transactionsPerSecond over the test, and records the
+	// throughput and latency of each step so that one run gives the whole throughput/latency curve
+	ACTOR static Future<Void> openLoopSweep( ReadWriteWorkload *self ) {
+		state double start = now();
+		state double stepDuration = self->testDuration / self->openLoopRateSteps;
+		state int step = 0;
+		for(; step < self->openLoopRateSteps; step++) {
+			self->openLoopRate = self->transactionsPerSecond * (step + 1) / self->openLoopRateSteps;
+			self->stepTransactions = 0;
+			self->stepLatencies.clear();
+
+			Void _ = wait( delayUntil( start + (step + 1) * stepDuration ) );
+
+			std::string rs = format("R=%07.0ftps:", self->openLoopRate * self->clientCount);
+			self->periodicMetrics.push_back( PerfMetric( rs + "Offered Transactions/sec", self->openLoopRate, false ) );
+			self->periodicMetrics.push_back( PerfMetric( rs + "Transactions/sec", self->stepTransactions / stepDuration, false ) );
+			self->periodicMetrics.push_back( PerfMetric( rs + "Mean Latency (ms)", 1000 * self->stepLatencies.mean(), true ) );
+			self->periodicMetrics.push_back( PerfMetric( rs + "Median Latency (ms, averaged)", 1000 * self->stepLatencies.median(), true ) );
+			self->periodicMetrics.push_back( PerfMetric( rs + "99% Latency (ms, averaged)", 1000 * self->stepLatencies.percentile(0.99), true ) );
+			self->periodicMetrics.push_back( PerfMetric( rs + "99.9% Latency (ms, averaged)", 1000 * self->stepLatencies.percentile(0.999), true ) );
+
+			TraceEvent("RW_OpenLoopStep").detail("Step", step).detail("OfferedRate", self->openLoopRate).detail("Rate", self->stepTransactions / stepDuration)
+				.detail("Median", 1000 * self->stepLatencies.median()).detail("P99", 1000 * self->stepLatencies.percentile(0.99));
+		}
+		return Void();
 	}
 };
 
@@ -0,0 +1,209 @@
+/*
+ * ResolverBench.actor.cpp
+ *
+ * This source file is part of the FoundationDB open source project
+ *
+ * Copyright 2013-2018 Apple Inc. and the FoundationDB project authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "flow/actorcompiler.h"
+#include "fdbrpc/ContinuousSample.h"
+#include "fdbserver/TesterInterface.h"
+#include "fdbserver/WorkerInterface.h"
+#include "fdbserver/ServerDBInfo.h"
+#include "fdbserver/Knobs.h"
+#include "fdbserver/ResolverInterface.h"
+#include "fdbserver/ConflictSet.h"
+#include "workloads.h"
+#include <limits>
+
+// Runs a resolver in the tester and sends it a stream of synthetic transaction batches, the way a single proxy would,
+// to measure how fast it resolves them without the rest of a cluster.  The batches are generated before the clock
+// starts.  A conflictFraction of the transactions read a range written by a transaction of the previous batch at a
+// version before it, and so conflict unless that transaction did; the others read at the last resolved version, and
+// conflict only with earlier transactions of their own batch that wrote the same keys.
+struct ResolverBenchWorkload : TestWorkload {
+	bool enabled;
+	int batchCount, transactionsPerBatch, readRangesPerTransaction, writeRangesPerTransaction;
+	int rangeWidth, batchesInFlight, resolverCount;
+	int64_t keyCount;
+	double conflictFraction;
+	Version versionsPerBatch;
+
+	std::vector<Standalone<VectorRef<CommitTransactionRef>>> batches;
+	PerfIntCounter transactions, ranges, committed, conflicts, tooOld;
+	ContinuousSample<double> batchLatencies;
+	double elapsed;
+
+	ResolverBenchWorkload(WorkloadContext const& wcx)
+		: TestWorkload(wcx), transactions("Transactions"), ranges("Conflict Ranges"), committed("Committed"),
+		  conflicts("Conflicts"), tooOld("Too Old"), batchLatencies( 10000 ), elapsed(0)
+	{
+		enabled = !clientId; // only do this on the "first" client
+		batchCount = getOption( options, LiteralStringRef("batchCount"), 500 );
+		transactionsPerBatch = getOption( options, LiteralStringRef("transactionsPerBatch"), 500 );
+		readRangesPerTransaction = getOption( options, LiteralStringRef("readRangesPerTransaction"), 1 );
+		writeRangesPerTransaction = getOption( options, LiteralStringRef("writeRangesPerTransaction"), 1 );
+		// Ranges cover between 1 and rangeWidth of keyCount keys
+		rangeWidth = std::max( getOption( options, LiteralStringRef("rangeWidth"), 1 ), 1 );
+		keyCount = getOption( options, LiteralStringRef("keyCount"), (int64_t)20000000 );
+		conflictFraction = getOption( options, LiteralStringRef("conflictFraction"), 0.0 );
+		batchesInFlight = std::max( getOption( options, LiteralStringRef("batchesInFlight"), 1 ), 1 );
+		// With more than one resolver, the resolver also samples the cost of the ranges it checks
+		resolverCount = getOption( options, LiteralStringRef("resolverCount"), 1 );
+		versionsPerBatch = getOption( options, LiteralStringRef("versionsPerBatch"), (int64_t)10000 );
+		ASSERT( versionsPerBatch > 1 && versionsPerBatch * 2 < SERVER_KNOBS->MAX_WRITE_TRANSACTION_LIFE_VERSIONS );
+	}
+
+	virtual std::string description() { return "ResolverBench"; }
+
+	virtual Future<Void> setup( Database const& cx ) {
+		if (enabled)
+			generateBatches();
+		return Void();
+	}
+
+	virtual Future<Void> start( Database const& cx ) {
+		if (enabled)
+			return _start( this );
+		return Void();
+	}
+
+	virtual Future<bool> check( Database const& cx ) {
+		batches.clear();
+		return true;
+	}
+
+	virtual void getMetrics( vector<PerfMetric>& m ) {
+		if (!enabled)
+			return;
+		m.push_back( transactions.getMetric() );
+		m.push_back( ranges.getMetric() );
+		m.push_back( committed.getMetric() );
+		m.push_back( conflicts.getMetric() );
+		m.push_back( tooOld.getMetric() );
+		m.push_back( PerfMetric( "Measured Duration", elapsed, true ) );
+		if (elapsed > 0) {
+			m.push_back( PerfMetric( "Transactions/sec", transactions.getValue() / elapsed, false ) );
+			m.push_back( PerfMetric( "Conflict Ranges/sec", ranges.getValue() / elapsed, false ) );
+			m.push_back( PerfMetric( "Batches/sec", batchCount / elapsed, false ) );
+		}
+		if (transactions.getValue())
+			m.push_back( PerfMetric( "Conflict Rate", double(conflicts.getValue()) / transactions.getValue(), true ) );
+		m.push_back( PerfMetric( "Mean Batch Latency (ms)", 1000 * batchLatencies.mean(), true ) );
+		m.push_back( PerfMetric( "Median Batch Latency (ms, averaged)", 1000 * batchLatencies.median(), true ) );
+		m.push_back( PerfMetric( "99% Batch Latency (ms, averaged)", 1000 * batchLatencies.percentile(0.99), true ) );
+		m.push_back( PerfMetric( "Max Batch Latency (ms, averaged)", 1000 * batchLatencies.max(), true ) );
+	}
+
+	KeyRangeRef randomRange( Arena& arena ) {
+		int64_t begin = g_random->randomInt64( 0, keyCount );
+		int width = g_random->randomInt( 1, rangeWidth + 1 );
+		return KeyRangeRef( StringRef( arena, doubleToTestKey( begin ) ), StringRef( arena, doubleToTestKey( begin + width ) ) );
+	}
+
+	// Batch b has version (b+1)*versionsPerBatch and follows version b*versionsPerBatch
+	void generateBatches() {
+		batches.resize( batchCount );
+		for(int b = 0; b < batchCount; b++) {
+			Arena& arena = batches[b].arena();
+			Version prevVersion = b * versionsPerBatch;
+			for(int t = 0; t < transactionsPerBatch; t++) {
+				CommitTransactionRef tr;
+				tr.read_snapshot = prevVersion;
+				int reads = readRangesPerTransaction;
+				if (b && reads && g_random->random01() < conflictFraction) {
+					CommitTransactionRef const& writer = g_random->randomChoice( batches[b-1] );
+					if (writer.write_conflict_ranges.size()) {
+						tr.read_conflict_ranges.push_back( arena, KeyRangeRef( arena, writer.write_conflict_ranges[0] ) );
+						tr.read_snapshot = prevVersion - 1;
+						reads--;
+					}
+				}
+				for(int r = 0; r < reads; r++)
+					tr.read_conflict_ranges.push_back( arena, randomRange( arena ) );
+				for(int w = 0; w < writeRangesPerTransaction; w++)
+					tr.write_conflict_ranges.push_back( arena, randomRange( arena ) );
+				batches[b].push_back( arena, tr );
+			}
+		}
+	}
+
+	ACTOR static Future<Void> _start( ResolverBenchWorkload* self ) {
+		state ResolverInterface ri;
+		state Future<Void> resolverActor;
+		state Deque<std::pair<double, Future<ResolveTransactionBatchReply>>> replies;
+		state int sent = 0;
+		state int received = 0;
+		state double start;
+
+		ri.initEndpoints();
+		InitializeResolverRequest init;
+		init.recoveryCount = std::numeric_limits<DBRecoveryCount>::max();  // so that the resolver is never removed
+		init.proxyCount = 1;
+		init.resolverCount = self->resolverCount;
+		resolverActor = resolver( ri, init, self->dbInfo );
+
+		// The first batch comes from the master and has no transactions
+		ResolveTransactionBatchRequest first;
+		first.prevVersion = -1;
+		first.version = 0;
+		first.lastReceivedVersion = -1;
+		ResolveTransactionBatchReply _ = wait( ri.resolve.getReply( first ) );
+
+		start = timer();
+		while (received < self->batches.size()) {
+			while (sent < self->batches.size() && sent - received < self->batchesInFlight) {
+				ResolveTransactionBatchRequest req;
+				req.prevVersion = sent * self->versionsPerBatch;
+				req.version = (sent + 1) * self->versionsPerBatch;
+				req.lastReceivedVersion = received * self->versionsPerBatch;
+				req.transactions = self->batches[sent];
+				req.arena = self->batches[sent].arena();
+				replies.push_back( std::make_pair( timer(), ri.resolve.getReply( req ) ) );
+				sent++;
+			}
+
+			choose {
+				when( ResolveTransactionBatchReply reply = wait( replies.front().second ) ) {
+					self->batchLatencies.addSample( timer() - replies.front().first );
+					for(int t = 0; t < reply.committed.size(); t++) {
+						if (reply.committed[t] == ConflictBatch::TransactionCommitted)
+							++self->committed;
+						else if (reply.committed[t] == ConflictBatch::TransactionTooOld)
+							++self->tooOld;
+						else
+							++self->conflicts;
+						auto const& tr = self->batches[received][t];
+						self->ranges += tr.read_conflict_ranges.size() + tr.write_conflict_ranges.size();
+					}
+					self->transactions += reply.committed.size();
+					replies.pop_front();
+					received++;
+				}
+				when( Void _ = wait( resolverActor ) ) {
+					ASSERT( false );  // The resolver stopped before resolving every batch
+				}
+			}
+		}
+		self->elapsed = timer() - start;
+
+		TraceEvent("ResolverBenchDone").detail("Transactions", self->transactions.getValue()).detail("Elapsed", self->elapsed)
+			.detail("Conflicts", self->conflicts.getValue()).detail("TooOld", self->tooOld.getValue());
+		return Void();
+	}
+};
+
+WorkloadFactory<ResolverBenchWorkload> ResolverBenchWorkloadFactory("ResolverBench");
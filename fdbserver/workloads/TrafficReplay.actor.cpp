@@ -0,0 +1,200 @@
+/*
+ * TrafficReplay.actor.cpp
+ *
+ * This source file is part of the FoundationDB open source project
+ *
+ * Copyright 2013-2018 Apple Inc. and the FoundationDB project authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "flow/actorcompiler.h"
+#include "fdbrpc/ContinuousSample.h"
+#include "fdbclient/NativeAPI.h"
+#include "fdbserver/TesterInterface.h"
+#include "fdbserver/TrafficCapture.h"
+#include "flow/ActorCollection.h"
+#include "workloads.h"
+#include <limits>
+
+// Issues the requests in the capture files written by proxies and storage servers with TRAFFIC_CAPTURE_DIRECTORY set
+// (see TrafficCapture.h) against the database under test.  The records of all the files are merged in order of
+// capture time and dealt out to the clients in turn, and each is issued at its original offset from the first one
+// divided by speedup, or as soon as one of maxOutstanding slots is free if speedup is 0.  A captured commit is
+// committed again with its mutations and conflict ranges at a new read version, and is not retried if it conflicts,
+// since the capture holds each attempt of the client.  A captured read becomes a snapshot read of the same key or
+// selectors.  Requests on system keys, such as those of the cluster's own roles, are skipped.
+struct TrafficReplayWorkload : TestWorkload {
+	std::vector<std::string> captureFiles;
+	double speedup;
+	int maxOutstanding;
+
+	std::vector<Standalone<VectorRef<TrafficRecord>>> captures;
+	std::vector<TrafficRecord> records;  // This client's share, in order of capture time
+	double firstTime, lastTime;
+
+	PerfIntCounter commits, reads, rangeReads, conflicts, errors, skipped;
+	ContinuousSample<double> latencies;
+	double elapsed, maxLag;
+
+	TrafficReplayWorkload(WorkloadContext const& wcx)
+		: TestWorkload(wcx), firstTime(0), lastTime(0), commits("Commits"), reads("Reads"), rangeReads("Range Reads"),
+		  conflicts("Conflicts"), errors("Errors"), skipped("Skipped"), latencies( 10000 ), elapsed(0), maxLag(0)
+	{
+		captureFiles = getOption( options, LiteralStringRef("captureFiles"), std::vector<std::string>() );
+		speedup = getOption( options, LiteralStringRef("speedup"), 1.0 );
+		maxOutstanding = std::max( getOption( options, LiteralStringRef("maxOutstanding"), 1000 ), 1 );
+	}
+
+	virtual std::string description() { return "TrafficReplay"; }
+
+	virtual Future<Void> setup( Database const& cx ) {
+		std::vector<TrafficRecord> all;
+		for(auto& filename : captureFiles) {
+			std::string contents = readFileBytes( filename, std::numeric_limits<int>::max() );
+			captures.push_back( readTrafficCapture( Standalone<StringRef>( StringRef( contents ) ) ) );
+			all.insert( all.end(), captures.back().begin(), captures.back().end() );
+			TraceEvent("TrafficReplayFile").detail("Filename", filename).detail("Records", captures.back().size());
+		}
+		std::stable_sort( all.begin(), all.end(), []( TrafficRecord const& a, TrafficRecord const& b ) { return a.time < b.time; } );
+		if( all.size() ) {
+			firstTime = all.front().time;
+			lastTime = all.back().time;
+		}
+		for(int i = clientId; i < all.size(); i += clientCount)
+			records.push_back( all[i] );
+		return Void();
+	}
+
+	virtual Future<Void> start( Database const& cx ) {
+		return _start( cx, this );
+	}
+
+	virtual Future<bool> check( Database const& cx ) {
+		records.clear();
+		captures.clear();
+		return true;
+	}
+
+	virtual void getMetrics( vector<PerfMetric>& m ) {
+		m.push_back( commits.getMetric() );
+		m.push_back( reads.getMetric() );
+		m.push_back( rangeReads.getMetric() );
+		m.push_back( conflicts.getMetric() );
+		m.push_back( errors.getMetric() );
+		m.push_back( skipped.getMetric() );
+		m.push_back( PerfMetric( "Captured Duration", lastTime - firstTime, false ) );
+		m.push_back( PerfMetric( "Replay Duration", elapsed, false ) );
+		m.push_back( PerfMetric( "Max Schedule Lag", maxLag, true ) );
+		m.push_back( PerfMetric( "Mean Latency (ms)", 1000 * latencies.mean(), true ) );
+		m.push_back( PerfMetric( "Median Latency (ms, averaged)", 1000 * latencies.median(), true ) );
+		m.push_back( PerfMetric( "99% Latency (ms, averaged)", 1000 * latencies.percentile(0.99), true ) );
+		m.push_back( PerfMetric( "Max Latency (ms, averaged)", 1000 * latencies.max(), true ) );
+	}
+
+	static bool isSystemTraffic( TrafficRecord const& r ) {
+		if( r.type == TrafficRecord::GET_VALUE )
+			return r.key >= normalKeys.end;
+		if( r.type == TrafficRecord::GET_KEY_VALUES )
+			return r.begin.getKey() > normalKeys.end || r.end.getKey() > normalKeys.end;
+		for(auto& m : r.commit.mutations) {
+			if( m.param1 >= normalKeys.end || ( m.type == MutationRef::ClearRange && m.param2 > normalKeys.end ) )
+				return true;
+		}
+		for(auto& range : r.commit.read_conflict_ranges) {
+			if( range.end > normalKeys.end )
+				return true;
+		}
+		for(auto& range : r.commit.write_conflict_ranges) {
+			if( range.end > normalKeys.end )
+				return true;
+		}
+		return false;
+	}
+
+	ACTOR static Future<Void> replayRecord( Database cx, TrafficReplayWorkload* self, Reference<FlowLock> outstanding, TrafficRecord record, double scheduled ) {
+		state FlowLock::Releaser releaser( *outstanding );
+		state Transaction tr( cx );
+		try {
+			if( record.type == TrafficRecord::COMMIT ) {
+				for(auto& range : record.commit.read_conflict_ranges)
+					tr.addReadConflictRange( range );
+				for(auto& m : record.commit.mutations) {
+					if( m.type == MutationRef::SetValue )
+						tr.set( m.param1, m.param2, false );
+					else if( m.type == MutationRef::ClearRange )
+						tr.clear( KeyRangeRef( m.param1, m.param2 ), false );
+					else
+						tr.atomicOp( m.param1, m.param2, (MutationRef::Type)m.type, false );
+				}
+				for(auto& range : record.commit.write_conflict_ranges)
+					tr.addWriteConflictRange( range );
+				Void _ = wait( tr.commit() );
+				++self->commits;
+			} else if( record.type == TrafficRecord::GET_VALUE ) {
+				Optional<Value> _ = wait( tr.get( record.key, true ) );
+				++self->reads;
+			} else {
+				Standalone<RangeResultRef> _ = wait( tr.getRange( record.begin, record.end, GetRangeLimits( std::abs( record.limit ), record.limitBytes ), true, record.limit < 0 ) );
+				++self->rangeReads;
+			}
+			self->latencies.addSample( now() - scheduled );
+		} catch( Error& e ) {
+			if( e.code() == error_code_actor_cancelled )
+				throw;
+			if( e.code() == error_code_not_committed ) {
+				++self->conflicts;
+			} else {
+				TraceEvent(SevWarn, "TrafficReplayError").error(e).suppressFor(5.0);
+				++self->errors;
+			}
+		}
+		return Void();
+	}
+
+	ACTOR static Future<Void> _start( Database cx, TrafficReplayWorkload* self ) {
+		state double start = now();
+		state Reference<FlowLock> outstanding( new FlowLock( self->maxOutstanding ) );
+		state ActorCollection requests( false );
+		state Future<Void> requestErrors = requests.getResult();
+		state double scheduled = start;
+		state int i = 0;
+
+		for(; i < self->records.size(); i++) {
+			if( isSystemTraffic( self->records[i] ) ) {
+				++self->skipped;
+				continue;
+			}
+			if( self->speedup > 0 ) {
+				scheduled = start + ( self->records[i].time - self->firstTime ) / self->speedup;
+				Void _ = wait( delayUntil( scheduled ) || requestErrors );
+			} else {
+				scheduled = now();
+			}
+			TEST( outstanding->available() <= 0 ); // Traffic replay is at maxOutstanding
+			Void _ = wait( outstanding->take() || requestErrors );
+			self->maxLag = std::max( self->maxLag, now() - scheduled );
+			requests.add( replayRecord( cx, self, outstanding, self->records[i], scheduled ) );
+		}
+
+		// Wait for the requests still outstanding
+		Void _ = wait( outstanding->take( TaskDefaultYield, self->maxOutstanding ) || requestErrors );
+		self->elapsed = now() - start;
+
+		TraceEvent("TrafficReplayDone").detail("Records", self->records.size()).detail("Elapsed", self->elapsed).detail("MaxLag", self->maxLag)
+			.detail("Conflicts", self->conflicts.getValue()).detail("Errors", self->errors.getValue()).detail("Skipped", self->skipped.getValue());
+		return Void();
+	}
+};
+
+WorkloadFactory<TrafficReplayWorkload> TrafficReplayWorkloadFactory("TrafficReplay");
@@ -29,6 +29,9 @@ struct UnitTestWorkload : TestWorkload {
 	bool enabled;
 	std::string testPattern;
 	int testRunLimit;
+	bool runBenchmarks;  // Instead of test cases, the benchmarks matching testPattern
+	double benchmarkMinTime;
+	int benchmarkSamples;
 
 	PerfIntCounter testsAvailable, testsExecuted, testsFailed;
 	PerfDoubleCounter totalWallTime, totalSimTime;
@@ -39,6 +42,9 @@ struct UnitTestWorkload : TestWorkload {
 		enabled = !clientId; // only do this on the "first" client
 		testPattern = getOption(options, LiteralStringRef("testsMatching"), Value()).toString();
 		testRunLimit = getOption(options, LiteralStringRef("maxTestCases"), -1);
+		runBenchmarks = getOption(options, LiteralStringRef("runBenchmarks"), false);
+		benchmarkMinTime = getOption(options, LiteralStringRef("benchmarkMinTime"), 0.1);
+		benchmarkSamples = getOption(options, LiteralStringRef("benchmarkSamples"), 5);
 		forceLinkIndexedSetTests();
 		forceLinkDequeTests();
 		forceLinkFlowTests();
@@ -47,6 +53,8 @@ struct UnitTestWorkload : TestWorkload {
 	virtual std::string description() { return "UnitTests"; }
 	virtual Future<Void> setup(Database const& cx) { return Void(); }
 	virtual Future<Void> start(Database const& cx) {
+		if (enabled && runBenchmarks)
+			return runAllBenchmarks(this);
 		if (enabled)
 			return runUnitTests(this);
 		return Void();
@@ -109,6 +117,40 @@ struct UnitTestWorkload : TestWorkload {
 
 		return Void();
 	}
+
+	// Benchmarks run synchronously, one after another, and each prints its result as a line of JSON
+	ACTOR static Future<Void> runAllBenchmarks(UnitTestWorkload* self) {
+		state std::vector<Benchmark*> benchmarks;
+		for (auto b = g_benchmarks.benchmarks; b != NULL; b = b->next) {
+			if (StringRef(b->name).startsWith(self->testPattern))
+				benchmarks.push_back(b);
+		}
+		fprintf(stdout, "Found %zu benchmarks\n", benchmarks.size());
+		std::sort(benchmarks.begin(), benchmarks.end(), [](Benchmark* a, Benchmark* b) { return strcmp(a->name, b->name) < 0; });
+
+		state std::vector<Benchmark*>::iterator b;
+		for (b = benchmarks.begin(); b != benchmarks.end(); ++b) {
+			++self->testsAvailable;
+			double start_timer = timer();
+			BenchmarkResult result = runBenchmark(*b, self->benchmarkMinTime, self->benchmarkSamples);
+			++self->testsExecuted;
+			self->totalWallTime += timer() - start_timer;
+
+			fprintf(stdout, "%s\n", result.toJSON(*b).c_str());
+			TraceEvent("Benchmark")
+				.detail("Name", (*b)->name)
+				.detail("Iterations", result.iterations)
+				.detail("Samples", result.samples)
+				.detail("MinNanoseconds", result.minNanoseconds)
+				.detail("MedianNanoseconds", result.medianNanoseconds)
+				.detail("MedianCycles", result.medianCycles);
+
+			// Let the trace flush and the network run between benchmarks
+			Void _ = wait(yield());
+		}
+
+		return Void();
+	}
 };
 
 WorkloadFactory<UnitTestWorkload> UnitTestWorkloadFactory("UnitTests");
@@ -0,0 +1,211 @@
+/*
+ * VersionstampQueue.actor.cpp
+ *
+ * This source file is part of the FoundationDB open source project
+ *
+ * Copyright 2013-2018 Apple Inc. and the FoundationDB project authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "flow/actorcompiler.h"
+#include "fdbclient/NativeAPI.h"
+#include "fdbclient/VersionstampQueue.h"
+#include "fdbserver/TesterInterface.h"
+#include "workloads.h"
+
+// Pushes batches onto a VersionstampQueue from many actors while one consumer pops them, and checks that every
+// acknowledged push comes out exactly once, in commit order.  The consumer records what it pops under consumedPrefix
+// in the same transaction as the pop, so the check sees it even when that commit's result was unknown.
+struct VersionstampQueueWorkload : TestWorkload {
+	int actorCount, batchSize, readLimit;
+	double testDuration, consumeDelay;
+	VersionstampQueue queue;
+	Key consumedPrefix;
+
+	// For each pusher, the batches it saw commit and those whose commit it retried after commit_unknown_result
+	std::vector<int> acknowledged;
+	std::vector<std::set<int>> unknown;
+
+	vector<Future<Void>> clients;
+	PerfIntCounter pushes, pops, retries;
+
+	VersionstampQueueWorkload(WorkloadContext const& wcx)
+		: TestWorkload(wcx), queue( LiteralStringRef("vsq/queue/"), getOption( options, LiteralStringRef("shards"), 8 ) ),
+		consumedPrefix( LiteralStringRef("vsq/consumed/") ), pushes("Pushes"), pops("Pops"), retries("Retries")
+	{
+		testDuration = getOption( options, LiteralStringRef("testDuration"), 10.0 );
+		actorCount = getOption( options, LiteralStringRef("actorCount"), 20 );
+		batchSize = getOption( options, LiteralStringRef("batchSize"), 5 );
+		readLimit = getOption( options, LiteralStringRef("readLimit"), 100 );
+		consumeDelay = getOption( options, LiteralStringRef("consumeDelay"), 0.1 );
+		acknowledged.resize( actorCount, 0 );
+		unknown.resize( actorCount );
+	}
+
+	virtual std::string description() { return "VersionstampQueue"; }
+
+	virtual Future<Void> setup( Database const& cx ) { return Void(); }
+
+	virtual Future<Void> start( Database const& cx ) {
+		if( clientId != 0 )
+			return Void();
+		for(int c = 0; c < actorCount; c++)
+			clients.push_back( timeout( pusher( cx->clone(), this, c ), testDuration, Void() ) );
+		clients.push_back( timeout( consumer( cx->clone(), this ), testDuration, Void() ) );
+		return waitForAll( clients );
+	}
+
+	virtual Future<bool> check( Database const& cx ) {
+		if( clientId != 0 )
+			return true;
+		return _check( cx->clone(), this );
+	}
+
+	virtual void getMetrics( vector<PerfMetric>& m ) {
+		m.push_back( pushes.getMetric() );
+		m.push_back( pops.getMetric() );
+		m.push_back( retries.getMetric() );
+	}
+
+	static Value itemValue( int actor, int batch, int index ) {
+		return StringRef( format("%08x%08x%04x", actor, batch, index) );
+	}
+
+	ACTOR Future<Void> pusher( Database cx, VersionstampQueueWorkload* self, int actor ) {
+		state int batch = 0;
+		loop {
+			state Transaction tr(cx);
+			loop {
+				try {
+					Standalone<VectorRef<ValueRef>> values;
+					for(int i = 0; i < self->batchSize; i++)
+						values.push_back_deep( values.arena(), itemValue( actor, batch, i ) );
+					self->queue.push( &tr, values );
+					Void _ = wait( tr.commit() );
+					break;
+				} catch( Error& e ) {
+					if( e.code() == error_code_commit_unknown_result ) {
+						TEST(true); // VersionstampQueue push retried after an unknown result
+						self->unknown[actor].insert( batch );
+					}
+					++self->retries;
+					Void _ = wait( tr.onError(e) );
+				}
+			}
+			++self->pushes;
+			self->acknowledged[actor] = ++batch;
+			Void _ = wait( delay( g_random->random01() * 0.1 ) );
+		}
+	}
+
+	ACTOR Future<Void> consumer( Database cx, VersionstampQueueWorkload* self ) {
+		loop {
+			Void _ = wait( delay( g_random->random01() * self->consumeDelay ) );
+			state Transaction tr(cx);
+			loop {
+				try {
+					Standalone<RangeResultRef> items = wait( self->queue.read( &tr, Key(), self->readLimit ) );
+					if( items.size() ) {
+						for(auto& kv : items)
+							tr.set( kv.key.withPrefix( self->consumedPrefix ), kv.value );
+						self->queue.pop( &tr, items.end()[-1].key );
+						Void _ = wait( tr.commit() );
+						++self->pops;
+					}
+					break;
+				} catch( Error& e ) {
+					++self->retries;
+					Void _ = wait( tr.onError(e) );
+				}
+			}
+		}
+	}
+
+	// Everything consumed, then everything still queued, in queue order
+	ACTOR Future<Standalone<VectorRef<KeyValueRef>>> readAll( Database cx, VersionstampQueueWorkload* self ) {
+		state Standalone<VectorRef<KeyValueRef>> all;
+		state Transaction tr(cx);
+		loop {
+			try {
+				all = Standalone<VectorRef<KeyValueRef>>();
+				state Standalone<RangeResultRef> consumed = wait( tr.getRange( prefixRange( self->consumedPrefix ), CLIENT_KNOBS->TOO_MANY ) );
+				ASSERT( !consumed.more );
+				for(auto& kv : consumed)
+					all.push_back_deep( all.arena(), KeyValueRef( kv.key.removePrefix( self->consumedPrefix ), kv.value ) );
+
+				state Key after;
+				loop {
+					Standalone<RangeResultRef> items = wait( self->queue.read( &tr, after, self->readLimit ) );
+					for(auto& kv : items)
+						all.push_back_deep( all.arena(), kv );
+					if( !items.more )
+						break;
+					after = items.end()[-1].key;
+				}
+				return all;
+			} catch( Error& e ) {
+				Void _ = wait( tr.onError(e) );
+			}
+		}
+	}
+
+	ACTOR Future<bool> _check( Database cx, VersionstampQueueWorkload* self ) {
+		state Standalone<VectorRef<KeyValueRef>> all = wait( self->readAll( cx, self ) );
+
+		bool ok = true;
+		std::vector<std::pair<int,int>> last( self->actorCount, std::make_pair(-1, -1) );
+		std::vector<std::set<int>> seen( self->actorCount );
+		for(int i = 0; i < all.size(); i++) {
+			if( all[i].key.size() != VersionstampQueue::POSITION_BYTES || (i && !(all[i-1].key < all[i].key)) ) {
+				TraceEvent(SevError, "VersionstampQueueBadPosition").detail("Position", printable(all[i].key)).detail("Index", i);
+				ok = false;
+			}
+
+			int actor, batch, index;
+			std::string value = all[i].value.toString();
+			if( value.size() != 20 || sscanf( value.c_str(), "%8x%8x%4x", &actor, &batch, &index ) != 3 || actor >= self->actorCount ) {
+				TraceEvent(SevError, "VersionstampQueueBadItem").detail("Value", printable(all[i].value));
+				ok = false;
+				continue;
+			}
+
+			// A batch appears more than once only if its push was retried after it may already have committed
+			auto item = std::make_pair( batch, index );
+			bool repeat = batch == last[actor].first && item <= last[actor] && self->unknown[actor].count(batch);
+			if( !repeat && item <= last[actor] ) {
+				TraceEvent(SevError, "VersionstampQueueOutOfOrder").detail("Actor", actor).detail("Batch", batch)
+					.detail("Index", index).detail("LastBatch", last[actor].first).detail("LastIndex", last[actor].second);
+				ok = false;
+			}
+			if( !repeat )
+				last[actor] = item;
+			if( index == self->batchSize - 1 )
+				seen[actor].insert( batch );
+		}
+
+		for(int a = 0; a < self->actorCount; a++) {
+			for(int b = 0; b < self->acknowledged[a]; b++) {
+				if( !seen[a].count(b) ) {
+					TraceEvent(SevError, "VersionstampQueueLostPush").detail("Actor", a).detail("Batch", b);
+					ok = false;
+				}
+			}
+		}
+
+		TraceEvent("VersionstampQueueCheck").detail("Items", all.size()).detail("Pushes", self->pushes.getValue()).detail("Pops", self->pops.getValue());
+		return ok;
+	}
+};
+
+WorkloadFactory<VersionstampQueueWorkload> VersionstampQueueWorkloadFactory("VersionstampQueue");
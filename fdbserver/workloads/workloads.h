@@ -190,6 +190,7 @@ public:
 	bool runConsistencyCheck;
 	bool waitForQuiescenceBegin;
 	bool waitForQuiescenceEnd;
+	std::string resultsFile;  // If not empty, the results of the test are appended to this file as a line of JSON
 
 	bool simCheckRelocationDuration; //If set to true, then long duration relocations generate SevWarnAlways messages.  Once any workload sets this to true, it will be true for the duration of the program.  Can only be used in simulation.
 	double simConnectionFailuresDisableDuration;
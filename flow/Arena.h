@@ -231,10 +231,11 @@ struct ArenaBlock : NonCopyable, ThreadSafeReferenceCounted<ArenaBlock>
 				b->tinySize = b->tinyUsed = NOT_TINY;
 				b->bigUsed = sizeof(ArenaBlock);
 			} else {
+				reqSize = LargeBlockPool::roundUp( reqSize );
 				#ifdef ALLOC_INSTRUMENTATION
 					allocInstr[ "ArenaHugeKB" ].alloc( (reqSize+1023)>>10 );
 				#endif
-				b = (ArenaBlock*)new uint8_t[ reqSize ];
+				b = (ArenaBlock*)LargeBlockPool::allocate( reqSize );
 				b->tinySize = b->tinyUsed = NOT_TINY;
 				b->bigSize = reqSize;
 				b->bigUsed = sizeof(ArenaBlock);
@@ -273,7 +274,7 @@ struct ArenaBlock : NonCopyable, ThreadSafeReferenceCounted<ArenaBlock>
 				#ifdef ALLOC_INSTRUMENTATION
 					allocInstr[ "ArenaHugeKB" ].dealloc( (bigSize+1023)>>10 );
 				#endif
-				delete[] (uint8_t*)this;
+				LargeBlockPool::release( this, bigSize );
 			}
 		}
 	}
@@ -81,4 +81,37 @@ TEST_CASE("flow/Deque/max_size") {
 }
 
 
+TEST_CASE("flow/perf/Deque") {
+	// A queue that grows to n elements, is scanned by index and then has its oldest elements replaced, like the version
+	// queues of a tlog
+	for (int n : { 1000000, 10000000 }) {
+		Deque<std::pair<int64_t, int64_t>> q;
+		double start = timer();
+		for (int i = 0; i < n; i++)
+			q.push_back(std::make_pair(i, i));
+		double pushTime = timer() - start;
+
+		start = timer();
+		int64_t sum = 0;
+		for (int i = 0; i < q.size(); i++)
+			sum += q[i].second;
+		double scanTime = timer() - start;
+		ASSERT(sum == int64_t(n)*(n - 1) / 2);
+
+		// Each step retires the oldest element and appends a new one, so the queue keeps its size and wraps around
+		start = timer();
+		for (int i = n; i < 2*n; i++) {
+			sum -= q.front().second;
+			q.pop_front();
+			q.push_back(std::make_pair(i, i));
+		}
+		double churnTime = timer() - start;
+		ASSERT(sum == 0 && q.front().second == n && q.back().second == 2*n-1);
+
+		printf("Deque of %d elements: %0.1f M push_back/sec, %0.1f M scan/sec, %0.1f M pop_front+push_back/sec\n",
+			n, n / 1e6 / pushTime, n / 1e6 / scanTime, n / 1e6 / churnTime);
+	}
+	return Void();
+}
+
 void forceLinkDequeTests() {}
\ No newline at end of file
@@ -43,7 +43,7 @@ public:
 	// TODO: iterator construction, other constructors
 	Deque(Deque const& r) : arr(0), begin(0), end(r.size()), mask(r.mask) {
 		if(r.capacity() > 0)
-			arr = (T*)aligned_alloc(__alignof(T), capacity()*sizeof(T));
+			arr = allocate(capacity());
 		ASSERT(capacity() >= end || end == 0);
 		for(int i=0; i<end; i++)
 			new (&arr[i]) T(r[i]);
@@ -58,7 +58,7 @@ public:
 		end = r.size();
 		mask = r.mask;
 		if(r.capacity() > 0)
-			arr = (T*)aligned_alloc(__alignof(T), capacity()*sizeof(T));
+			arr = allocate(capacity());
 		ASSERT(capacity() >= end || end == 0);
 		for(int i=0; i<end; i++)
 			new (&arr[i]) T(r[i]);
@@ -154,6 +154,15 @@ private:
 	uint32_t begin, end, mask;
 
 	bool full() const { return end == begin + mask + 1; }
+
+	// The array starts on a cache line, so that with elements whose size is a power of two none of them straddles two
+	// lines and a scan from front() touches as few lines as it can
+	static T* allocate( size_t capacity ) {
+		const size_t alignment = __alignof(T) > 64 ? __alignof(T) : 64;
+		size_t bytes = (capacity*sizeof(T) + alignment - 1) / alignment * alignment;
+		return (T*)aligned_alloc(alignment, bytes);
+	}
+
 	void grow() {
 		// This doubles capacity (or makes it at least 8), and arbitrarily moves begin to be 0
 
@@ -161,7 +170,7 @@ private:
 		size_t newSize = mp1 * 2;
 		if (newSize > max_size()) throw std::bad_alloc();
 		//printf("Growing to %lld (%u-%u mask %u)\n", (long long)newSize, begin, end, mask);
-		T *newArr = (T*)aligned_alloc(__alignof(T), newSize*sizeof(T));   // SOMEDAY: FastAllocator, exception safety
+		T *newArr = allocate(newSize);   // SOMEDAY: FastAllocator, exception safety
 		for (int i = begin; i != end; i++) {
 			new (&newArr[i - begin]) T(std::move(arr[i&mask]));
 			arr[i&mask].~T();
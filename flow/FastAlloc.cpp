@@ -23,9 +23,11 @@
 #include "ThreadPrimitives.h"
 #include "Trace.h"
 #include "Error.h"
+#include "Knobs.h"
 
 #include <cstdint>
 #include <unordered_map>
+#include <algorithm>
 
 #ifdef WIN32
 #include <windows.h>
@@ -175,10 +177,15 @@ void recordDeallocation( void *ptr ) {
 template <int Size>
 struct FastAllocator<Size>::GlobalData {
 	CRITICAL_SECTION mutex;
-	std::vector<void*> magazines;   // These magazines are always exactly magazine_size ("full")
-	std::vector<std::pair<int, void*>> partial_magazines;  // Magazines that are not "full" and their counts.  Only created by releaseThreadMagazines().
+	std::vector<void*> magazines;   // These magazines are always exactly magazine_size ("full").  They are used from the back, so the front ones have been idle longest.
+	std::vector<std::pair<int, void*>> partial_magazines;  // Magazines that are not "full" and their counts.  Only created by releaseThreadMagazines() and reclaimUnusedMemory().
+	std::vector<void*> chunks;  // Every block of magazine_size items allocated from the system
+	std::vector<void*> reclaimed_chunks;  // Blocks with no allocated items whose memory has been returned to the OS
+	int lowWaterMagazines;  // The fewest full magazines there have been since the last call to reclaimUnusedMemory()
+	bool reclaimFailed;
 	long long memoryUsed;
-	GlobalData() : memoryUsed(0) { 
+	long long memoryReclaimed;
+	GlobalData() : lowWaterMagazines(0), reclaimFailed(false), memoryUsed(0), memoryReclaimed(0) { 
 		InitializeCriticalSection(&mutex);
 	}
 };
@@ -193,6 +200,11 @@ long long FastAllocator<Size>::getMemoryUnused() {
 	return globalData()->magazines.size() * magazine_size * Size;
 }
 
+template <int Size>
+long long FastAllocator<Size>::getMemoryReclaimed() {
+	return globalData()->memoryReclaimed;
+}
+
 static int64_t getSizeCode(int i) {
 	switch (i) {
 		case 16: return 1;
@@ -330,6 +342,7 @@ void FastAllocator<Size>::getMagazine() {
 	if (globalData()->magazines.size()) {
 		void* m = globalData()->magazines.back();
 		globalData()->magazines.pop_back();
+		globalData()->lowWaterMagazines = std::min<int>( globalData()->lowWaterMagazines, globalData()->magazines.size() );
 		LeaveCriticalSection(&globalData()->mutex);
 		threadData.freelist = m;
 		threadData.count = magazine_size;
@@ -341,6 +354,14 @@ void FastAllocator<Size>::getMagazine() {
 		threadData.freelist = p.second;
 		threadData.count = p.first;
 		return;
+	} else if (globalData()->reclaimed_chunks.size()) {
+		// Reuse a block whose pages were returned to the OS; touching them again maps in zeroed pages
+		void** block = (void**)globalData()->reclaimed_chunks.back();
+		globalData()->reclaimed_chunks.pop_back();
+		globalData()->memoryReclaimed -= magazine_size*Size;
+		LeaveCriticalSection(&globalData()->mutex);
+		initMagazine( block );
+		return;
 	}
 	globalData()->memoryUsed += magazine_size*Size;
 	LeaveCriticalSection(&globalData()->mutex);
@@ -366,6 +387,15 @@ void FastAllocator<Size>::getMagazine() {
 	block = (void **)::allocate(magazine_size * Size, true);
 #endif
 
+	EnterCriticalSection(&globalData()->mutex);
+	globalData()->chunks.push_back(block);
+	LeaveCriticalSection(&globalData()->mutex);
+
+	initMagazine( block );
+}
+
+template <int Size>
+void FastAllocator<Size>::initMagazine(void** block) {
 	//void** block = new void*[ magazine_size * PSize ];
 	for(int i=0; i<magazine_size-1; i++) {
 		block[i*PSize+1] = block[i*PSize] = &block[(i+1)*PSize];
@@ -377,6 +407,90 @@ void FastAllocator<Size>::getMagazine() {
 	threadData.freelist = block;
 	threadData.count = magazine_size;
 }
+
+template <int Size>
+void FastAllocator<Size>::reclaimUnusedMemory() {
+#if defined(__linux__) && !FAST_ALLOCATOR_DEBUG && !VALGRIND
+	GlobalData* g = globalData();
+
+	// Take the magazines which have stayed in the global list since the last call; other threads can keep using the rest
+	std::vector<void*> idle, chunks;
+	EnterCriticalSection(&g->mutex);
+	int idleCount = g->reclaimFailed ? 0 : std::min<int>( g->lowWaterMagazines, g->magazines.size() );
+	if (idleCount) {
+		idle.assign( g->magazines.begin(), g->magazines.begin() + idleCount );
+		g->magazines.erase( g->magazines.begin(), g->magazines.begin() + idleCount );
+		chunks = g->chunks;
+	}
+	g->lowWaterMagazines = g->magazines.size();
+	LeaveCriticalSection(&g->mutex);
+
+	if (!idleCount) return;
+
+	// Count the free items in each block.  Items in magazines held by threads or in partial magazines aren't counted, so a
+	// block is only found to be completely free if all of its items are in idle magazines.
+	std::sort( chunks.begin(), chunks.end() );
+	std::vector<int> freeCount( chunks.size() );
+	auto chunkIndex = [&chunks](void* p) { return int(std::upper_bound( chunks.begin(), chunks.end(), p ) - chunks.begin()) - 1; };
+	for(void* m : idle) {
+		void* p = m;
+		for(int i = 0; i < magazine_size; i++, p = *(void**)p)
+			freeCount[ chunkIndex(p) ]++;
+	}
+
+	std::vector<bool> isFree( chunks.size() );
+	for(int c = 0; c < chunks.size(); c++)
+		isFree[c] = freeCount[c] == magazine_size;
+
+	// Rebuild full magazines from the items in the remaining blocks.  This has to happen before any memory is released,
+	// because released items no longer hold their links.
+	std::vector<void*> rebuilt;
+	void* current = 0;
+	int currentCount = 0;
+	for(void* m : idle) {
+		void* p = m;
+		for(int i = 0; i < magazine_size; i++) {
+			void* next = *(void**)p;
+			if (!isFree[ chunkIndex(p) ]) {
+				*(void**)p = current;
+				current = p;
+				if (++currentCount == magazine_size) {
+					rebuilt.push_back(current);
+					current = 0;
+					currentCount = 0;
+				}
+			}
+			p = next;
+		}
+	}
+
+	std::vector<void*> reclaimed;
+	bool failed = false;
+	for(int c = 0; c < chunks.size(); c++) {
+		if (!isFree[c]) continue;
+		if (!failed && madvise( chunks[c], magazine_size*Size, MADV_DONTNEED ) == 0) {
+			reclaimed.push_back( chunks[c] );
+		} else {
+			// e.g. blocks in huge pages can't be partially released; the block becomes an ordinary full magazine again
+			failed = true;
+			void** block = (void**)chunks[c];
+			for(int i=0; i<magazine_size-1; i++)
+				block[i*PSize] = &block[(i+1)*PSize];
+			block[(magazine_size-1)*PSize] = 0;
+			rebuilt.push_back( block );
+		}
+	}
+
+	EnterCriticalSection(&g->mutex);
+	g->magazines.insert( g->magazines.begin(), rebuilt.begin(), rebuilt.end() );
+	if (current) g->partial_magazines.push_back( std::make_pair(currentCount, current) );
+	g->reclaimed_chunks.insert( g->reclaimed_chunks.end(), reclaimed.begin(), reclaimed.end() );
+	g->memoryReclaimed += (long long)reclaimed.size() * magazine_size * Size;
+	g->lowWaterMagazines = std::min<int>( g->lowWaterMagazines + rebuilt.size(), g->magazines.size() );
+	g->reclaimFailed = failed;
+	LeaveCriticalSection(&g->mutex);
+#endif
+}
 template <int Size>
 void FastAllocator<Size>::releaseMagazine(void* mag) {
 	EnterCriticalSection(&globalData()->mutex);
@@ -398,7 +512,95 @@ void FastAllocator<Size>::releaseThreadMagazines() {
 	thr.freelist = 0;
 }
 
+struct LargeBlockThreadCache {
+	void* freelist[LargeBlockPool::CLASSES];  // Each cached block starts with a pointer to the next one
+	int64_t cachedBytes;
+};
+static thread_local LargeBlockThreadCache largeBlockThreadCache;
+
+static volatile int32_t largeBlocksLive[LargeBlockPool::CLASSES];
+static volatile int32_t largeBlocksHighWater[LargeBlockPool::CLASSES];
+static volatile int32_t largeBlocksCached[LargeBlockPool::CLASSES];
+static volatile int64_t largeBytesLive[LargeBlockPool::CLASSES];
+
+static int64_t largeBlockCacheLimit() {
+	return FLOW_KNOBS ? FLOW_KNOBS->ARENA_LARGE_BLOCK_CACHE_BYTES : 0;
+}
+
+int LargeBlockPool::getSizeClass( int size ) {
+	if (size > MAX_POOLED_SIZE) return CLASSES-1;
+	if (size <= MIN_SIZE) return 0;
+	int k = 13;  // 2^k < size <= 2^(k+1)
+	while ((2<<k) < size) k++;
+	return 1 + (k-13)*4 + (size - (1<<k) - 1) / (1<<(k-2));
+}
+
+int LargeBlockPool::getClassSize( int sizeClass ) {
+	if (sizeClass == 0) return MIN_SIZE;
+	if (sizeClass == CLASSES-1) return 0;
+	int k = 13 + (sizeClass-1) / 4;
+	return (1<<k) + ((sizeClass-1) % 4 + 1) * (1<<(k-2));
+}
+
+int LargeBlockPool::roundUp( int size ) {
+	if (size > MAX_POOLED_SIZE || largeBlockCacheLimit() <= 0) return size;
+	return getClassSize( getSizeClass(size) );
+}
+
+void* LargeBlockPool::allocate( int size ) {
+	int c = getSizeClass(size);
+	int32_t live = interlockedIncrement( &largeBlocksLive[c] );
+	for(int32_t hw = largeBlocksHighWater[c]; live > hw; hw = largeBlocksHighWater[c])
+		if (interlockedCompareExchange( &largeBlocksHighWater[c], live, hw ) == hw) break;
+	interlockedExchangeAdd64( &largeBytesLive[c], size );
+
+	LargeBlockThreadCache& cache = largeBlockThreadCache;
+	if (size == getClassSize(c) && cache.freelist[c]) {
+		void* p = cache.freelist[c];
+		cache.freelist[c] = *(void**)p;
+		cache.cachedBytes -= size;
+		interlockedDecrement( &largeBlocksCached[c] );
+		return p;
+	}
+	return new uint8_t[ size ];
+}
+
+void LargeBlockPool::release( void* ptr, int size ) {
+	int c = getSizeClass(size);
+	interlockedDecrement( &largeBlocksLive[c] );
+	interlockedExchangeAdd64( &largeBytesLive[c], -size );
+
+	LargeBlockThreadCache& cache = largeBlockThreadCache;
+	if (size == getClassSize(c) && cache.cachedBytes + size <= largeBlockCacheLimit()) {
+		*(void**)ptr = cache.freelist[c];
+		cache.freelist[c] = ptr;
+		cache.cachedBytes += size;
+		interlockedIncrement( &largeBlocksCached[c] );
+		return;
+	}
+	delete[] (uint8_t*)ptr;
+}
+
+void LargeBlockPool::releaseThreadCache() {
+	LargeBlockThreadCache& cache = largeBlockThreadCache;
+	for(int c = 0; c < CLASSES; c++) {
+		while (cache.freelist[c]) {
+			void* p = cache.freelist[c];
+			cache.freelist[c] = *(void**)p;
+			interlockedDecrement( &largeBlocksCached[c] );
+			delete[] (uint8_t*)p;
+		}
+	}
+	cache.cachedBytes = 0;
+}
+
+int LargeBlockPool::getLiveBlocks( int sizeClass ) { return largeBlocksLive[sizeClass]; }
+int LargeBlockPool::getHighWaterBlocks( int sizeClass ) { return largeBlocksHighWater[sizeClass]; }
+int LargeBlockPool::getCachedBlocks( int sizeClass ) { return largeBlocksCached[sizeClass]; }
+int64_t LargeBlockPool::getLiveBytes( int sizeClass ) { return largeBytesLive[sizeClass]; }
+
 void releaseAllThreadMagazines() {
+	LargeBlockPool::releaseThreadCache();
 	FastAllocator<16>::releaseThreadMagazines();
 	FastAllocator<32>::releaseThreadMagazines();
 	FastAllocator<64>::releaseThreadMagazines();
@@ -410,6 +612,46 @@ void releaseAllThreadMagazines() {
 	FastAllocator<4096>::releaseThreadMagazines();
 }
 
+int64_t getTotalUnusedAllocatedMemory() {
+	return FastAllocator<16>::getMemoryUnused() + FastAllocator<32>::getMemoryUnused() + FastAllocator<64>::getMemoryUnused() +
+		FastAllocator<128>::getMemoryUnused() + FastAllocator<256>::getMemoryUnused() + FastAllocator<512>::getMemoryUnused() +
+		FastAllocator<1024>::getMemoryUnused() + FastAllocator<2048>::getMemoryUnused() + FastAllocator<4096>::getMemoryUnused();
+}
+
+int64_t getTotalReclaimedMemory() {
+	return FastAllocator<16>::getMemoryReclaimed() + FastAllocator<32>::getMemoryReclaimed() + FastAllocator<64>::getMemoryReclaimed() +
+		FastAllocator<128>::getMemoryReclaimed() + FastAllocator<256>::getMemoryReclaimed() + FastAllocator<512>::getMemoryReclaimed() +
+		FastAllocator<1024>::getMemoryReclaimed() + FastAllocator<2048>::getMemoryReclaimed() + FastAllocator<4096>::getMemoryReclaimed();
+}
+
+void reclaimUnusedFastAllocatorMemory() {
+	FastAllocator<16>::reclaimUnusedMemory();
+	FastAllocator<32>::reclaimUnusedMemory();
+	FastAllocator<64>::reclaimUnusedMemory();
+	FastAllocator<128>::reclaimUnusedMemory();
+	FastAllocator<256>::reclaimUnusedMemory();
+	FastAllocator<512>::reclaimUnusedMemory();
+	FastAllocator<1024>::reclaimUnusedMemory();
+	FastAllocator<2048>::reclaimUnusedMemory();
+	FastAllocator<4096>::reclaimUnusedMemory();
+}
+
+static double reclamationInterval;
+
+THREAD_FUNC fastAllocatorReclamationThread( void* ) {
+	while (true) {
+		threadSleep( reclamationInterval );
+		reclaimUnusedFastAllocatorMemory();
+	}
+	THREAD_RETURN;
+}
+
+void startFastAllocatorReclamation( double interval ) {
+	ASSERT( interval > 0 && reclamationInterval == 0 );
+	reclamationInterval = interval;
+	startThread( &fastAllocatorReclamationThread, NULL );
+}
+
 template class FastAllocator<16>;
 template class FastAllocator<32>;
 template class FastAllocator<64>;
@@ -108,6 +108,10 @@ public:
 
 	static long long getMemoryUsed();
 	static long long getMemoryUnused();
+	static long long getMemoryReclaimed();  // Memory from getMemoryUsed() that has been returned to the OS until it is needed again
+
+	// Returns to the OS the memory of each block of items which have all been in idle global magazines since the previous call
+	static void reclaimUnusedMemory();
 
 	static void releaseThreadMagazines();
 
@@ -145,10 +149,38 @@ private:
 
 	FastAllocator();  // not implemented
 	static void getMagazine();   // sets threadData.freelist and threadData.count
+	static void initMagazine(void** block);  // links the items of a block into threadData.freelist
 	static void releaseMagazine(void*);
 };
 
+// Allocates the ArenaBlocks that are too large for a FastAllocator.  Sizes up to MAX_POOLED_SIZE are grouped into size
+// classes, four per power of two.  When FLOW_KNOBS->ARENA_LARGE_BLOCK_CACHE_BYTES is positive, roundUp() rounds sizes to
+// their class and released blocks are kept in a per-thread cache of at most that many bytes for reuse.  Live and high
+// water block counts are kept for every class (the last class counts all larger blocks) whether or not caching is enabled.
+class LargeBlockPool {
+public:
+	enum { MIN_SIZE = 8192, MAX_POOLED_SIZE = 1<<20, CLASSES = 30 };
+
+	static int roundUp( int size );
+	static void* allocate( int size );
+	static void release( void* ptr, int size );
+	static void releaseThreadCache();
+
+	static int getSizeClass( int size );
+	static int getClassSize( int sizeClass );  // 0 for the last class, which isn't pooled
+	static int getLiveBlocks( int sizeClass );
+	static int getHighWaterBlocks( int sizeClass );
+	static int getCachedBlocks( int sizeClass );
+	static int64_t getLiveBytes( int sizeClass );
+};
+
 void releaseAllThreadMagazines();
+int64_t getTotalUnusedAllocatedMemory();  // Allocated from the OS, but free in global FastAllocator magazines
+int64_t getTotalReclaimedMemory();
+void reclaimUnusedFastAllocatorMemory();
+// Starts a thread which calls reclaimUnusedFastAllocatorMemory() every interval seconds, so that memory left free after a
+// burst of allocations only stays resident for between one and two intervals
+void startFastAllocatorReclamation( double interval );
 void setFastAllocatorThreadInitFunction( void (*)() );  // The given function will be called at least once in each thread that allocates from a FastAllocator.  Currently just one such function is tracked.
 
 template<int X>
@@ -0,0 +1,69 @@
+/*
+ * Histogram.cpp
+ *
+ * This source file is part of the FoundationDB open source project
+ *
+ * Copyright 2013-2018 Apple Inc. and the FoundationDB project authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "Histogram.h"
+#include "UnitTest.h"
+
+TEST_CASE("flow/Histogram/buckets") {
+	// Buckets are contiguous, and each value is within 1/SUB of the bucket it is counted in
+	for(int b = 0; b < LatencyHistogram::BUCKETS; b++) {
+		uint64_t lo = LatencyHistogram::lowerBound(b), width = LatencyHistogram::bucketWidth(b);
+		ASSERT( LatencyHistogram::bucketOf(lo) == b && LatencyHistogram::bucketOf(lo + width - 1) == b );
+		if (b+1 < LatencyHistogram::BUCKETS)
+			ASSERT( LatencyHistogram::lowerBound(b+1) == lo + width );
+		ASSERT( width == 1 || width * LatencyHistogram::SUB <= lo );
+	}
+	return Void();
+}
+
+TEST_CASE("flow/Histogram/percentile") {
+	// Compares percentiles against the exact ones of a sorted sample spanning several orders of magnitude
+	std::vector<double> values;
+	LatencyHistogram all, parts[2];
+	for(int i = 0; i < 20000; i++) {
+		double v = pow( 10.0, g_random->random01() * 6 - 5 );
+		values.push_back(v);
+		all.record(v);
+		parts[i&1].record(v);
+	}
+	std::sort( values.begin(), values.end() );
+
+	LatencyHistogram merged;
+	merged.merge(parts[0]);
+	merged.merge(parts[1]);
+
+	double ps[] = { 0.001, 0.25, 0.5, 0.9, 0.99, 0.999, 1 };
+	for(double p : ps) {
+		double exact = values[ std::max<int>( 0, int(ceil(p * values.size())) - 1 ) ];
+		double estimate = all.percentile(p);
+		ASSERT( fabs(estimate - exact) <= exact / LatencyHistogram::SUB + 1e-6 );
+		ASSERT( merged.percentile(p) == estimate );
+	}
+	ASSERT( all.count() == values.size() && merged.count() == all.count() );
+	ASSERT( fabs( all.min() - values.front() ) < 1e-6 && fabs( all.max() - values.back() ) < 1e-6 );
+	ASSERT( merged.min() == all.min() && merged.max() == all.max() && merged.mean() == all.mean() );
+
+	all.clear();
+	ASSERT( all.count() == 0 && all.percentile(0.99) == 0 && all.max() == 0 );
+	all.record(1e9);
+	ASSERT( all.count() == 1 && all.percentile(0.5) == all.max() );
+	return Void();
+}
@@ -0,0 +1,128 @@
+/*
+ * Histogram.h
+ *
+ * This source file is part of the FoundationDB open source project
+ *
+ * Copyright 2013-2018 Apple Inc. and the FoundationDB project authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef FLOW_HISTOGRAM_H
+#define FLOW_HISTOGRAM_H
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include "Arena.h"
+#ifdef _WIN32
+#include <intrin.h>
+#endif
+
+// A histogram of latencies in fixed memory, with log-linear buckets in the manner of an HDR histogram.  Latencies are
+// counted in microseconds.  Those below 2*SUB are counted exactly, and each further power of two is divided into SUB
+// buckets of equal width, so any latency is known to within 1/SUB of its value.  Latencies of 2^MAX_BITS microseconds
+// (about 38 hours) or more are counted in the last bucket.  Histograms of the same kind can be merged without loss,
+// which makes them suitable for adding up the latencies of several processes.
+class LatencyHistogram {
+public:
+	enum { SUB_BITS = 4, SUB = 1<<SUB_BITS, MAX_BITS = 37, BUCKETS = (MAX_BITS - SUB_BITS + 1) * SUB };
+
+	LatencyHistogram() { clear(); }
+
+	void record( double seconds, int64_t count = 1 ) {
+		uint64_t us = seconds > 0 ? uint64_t( std::min( seconds * 1e6 + 0.5, double(MAX_VALUE) ) ) : 0;
+		counts[bucketOf(us)] += count;
+		total += count;
+		sum += us * count;
+		minValue = std::min( minValue, us );
+		maxValue = std::max( maxValue, us );
+	}
+
+	void merge( LatencyHistogram const& other ) {
+		if (!other.total)
+			return;
+		for(int b = 0; b < BUCKETS; b++)
+			counts[b] += other.counts[b];
+		total += other.total;
+		sum += other.sum;
+		minValue = std::min( minValue, other.minValue );
+		maxValue = std::max( maxValue, other.maxValue );
+	}
+
+	void clear() {
+		std::fill( counts, counts + BUCKETS, 0 );
+		total = 0;
+		sum = 0;
+		minValue = MAX_VALUE;
+		maxValue = 0;
+	}
+
+	int64_t count() const { return total; }
+	double min() const { return total ? minValue / 1e6 : 0; }
+	double max() const { return maxValue / 1e6; }
+	double mean() const { return total ? double(sum) / total / 1e6 : 0; }
+
+	// The latency, in seconds, below or at which a fraction p of the recorded latencies fall.  Within a bucket it is the
+	// middle of the bucket, and it is never outside of the smallest and largest latencies recorded.
+	double percentile( double p ) const {
+		if (!total)
+			return 0;
+		int64_t rank = std::max<int64_t>( 1, std::min<int64_t>( total, int64_t( ceil( p * total ) ) ) );
+		int b = 0;
+		for(int64_t seen = counts[0]; seen < rank; seen += counts[++b]);
+		uint64_t v = lowerBound(b) + (bucketWidth(b) - 1) / 2;
+		return std::max( minValue, std::min( maxValue, v ) ) / 1e6;
+	}
+
+	// The format that traceCounters() uses: the count, then the minimum, maximum, mean, median, 90th, 99th and 99.9th
+	// percentile latencies in seconds
+	std::string toString() const {
+		return format( "%lld %g %g %g %g %g %g %g", (long long)count(), min(), max(), mean(), percentile(0.5), percentile(0.9), percentile(0.99), percentile(0.999) );
+	}
+
+	static int bucketOf( uint64_t us ) {
+		if (us < 2*SUB)
+			return us;
+		int shift = highestBit(us) - SUB_BITS;
+		return SUB*shift + int(us >> shift);
+	}
+	static uint64_t lowerBound( int b ) {
+		if (b < 2*SUB)
+			return b;
+		int shift = b/SUB - 1;
+		return uint64_t(b - shift*SUB) << shift;
+	}
+	static uint64_t bucketWidth( int b ) { return b < 2*SUB ? 1 : uint64_t(1) << (b/SUB - 1); }
+
+private:
+	static const uint64_t MAX_VALUE = (uint64_t(1) << MAX_BITS) - 1;
+
+	int64_t counts[BUCKETS];
+	int64_t total;
+	uint64_t sum, minValue, maxValue;
+
+	static int highestBit( uint64_t x ) {
+#ifdef _WIN32
+		unsigned long i;
+		_BitScanReverse64(&i, x);
+		return i;
+#else
+		return 63 - __builtin_clzll(x);
+#endif
+	}
+};
+
+#endif
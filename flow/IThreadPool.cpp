@@ -19,8 +19,11 @@
  */
 
 #include "IThreadPool.h"
+#include "Knobs.h"
+#include "UnitTest.h"
 
 #include <algorithm>
+#include <atomic>
 #define BOOST_SYSTEM_NO_LIB
 #define BOOST_DATE_TIME_NO_LIB
 #define BOOST_REGEX_NO_LIB
@@ -103,9 +106,265 @@ public:
 };
 
 
+thread_local IThreadPoolReceiver* ThreadPool::Thread::threadUserObject;
+
+// A pool in which each thread has its own queue of actions.  post() from outside of the pool spreads actions over the
+// queues in turn, and an action posted by an action goes to the queue of the thread running it.  A thread runs the
+// actions of its own queue first; when it is empty it takes the oldest action of another thread's queue, unless the pool
+// pins actions to the thread whose queue they were put in.  With no work to do, threads sleep until post() wakes one.
+class WorkStealingThreadPool : public IThreadPool, public ReferenceCounted<WorkStealingThreadPool> {
+	enum { MAX_THREADS = 256 };
+
+	struct Thread {
+		WorkStealingThreadPool *pool;
+		IThreadPoolReceiver* userObject;
+		int index;
+		ThreadSpinLock queueLock;
+		Deque<PThreadAction> queue;
+		std::atomic<int> queued;
+		Event wake, stopped;
+		explicit Thread(WorkStealingThreadPool *pool, IThreadPoolReceiver *userObject, int index) : pool(pool), userObject(userObject), index(index), queued(0) {}
+		~Thread() { ASSERT_ABORT(!userObject); }
+
+		void push( PThreadAction action ) {
+			queueLock.enter();
+			queue.push_back(action);
+			queued++;
+			queueLock.leave();
+		}
+		PThreadAction pop() {
+			if (!queued.load())
+				return NULL;
+			PThreadAction action = NULL;
+			queueLock.enter();
+			if (!queue.empty()) {
+				action = queue.front();
+				queue.pop_front();
+				queued--;
+			}
+			queueLock.leave();
+			return action;
+		}
+
+		void run() {
+			deprioritizeThread();
+
+			currentThread = this;
+			try {
+				userObject->init();
+				while (!pool->mode) {
+					PThreadAction action = pool->next(this);
+					if (action)
+						(*action)(userObject);
+					else
+						pool->sleep(this);
+				}
+			} catch (Error& e) {
+				TraceEvent(SevError, "ThreadPoolError").error(e);
+			}
+			delete userObject; userObject = 0;
+			stopped.set();
+		}
+	};
+	static thread_local Thread* currentThread;
+	THREAD_FUNC start( void* p ) {
+		((Thread*)p)->run();
+		THREAD_RETURN;
+	}
+
+	Thread* threads[MAX_THREADS];
+	std::atomic<int> threadCount;
+	std::atomic<int> pending;  // Actions in all of the queues
+	std::atomic<unsigned> nextQueue;
+	ThreadSpinLock idleLock;
+	std::vector<Thread*> idle;
+	std::atomic<int> idleCount;
+	bool stealing;
+	enum Mode { Run=0, Shutdown=2 };
+	volatile int mode;
+
+	PThreadAction next( Thread* t ) {
+		PThreadAction action = t->pop();
+		if (!action && stealing && pending.load()) {
+			int n = threadCount.load();
+			for(int i = 1; i < n && !action; i++)
+				action = threads[ (t->index + i) % n ]->pop();
+		}
+		if (action)
+			pending--;
+		return action;
+	}
+
+	void sleep( Thread* t ) {
+		idleLock.enter();
+		if (mode) {
+			idleLock.leave();
+			return;
+		}
+		idle.push_back(t);
+		idleCount++;
+		// A post() that went unseen by next() sees this thread in idle, or its action is seen here
+		if (stealing ? pending.load() : t->queued.load()) {
+			idle.pop_back();
+			idleCount--;
+			idleLock.leave();
+			return;
+		}
+		idleLock.leave();
+		t->wake.block();
+	}
+
+	void wakeFor( Thread* target ) {
+		if (!idleCount.load())
+			return;
+		Thread* t = NULL;
+		idleLock.enter();
+		if (stealing ? !idle.empty() : std::find(idle.begin(), idle.end(), target) != idle.end()) {
+			t = stealing ? idle.back() : target;
+			idle.erase( std::find(idle.begin(), idle.end(), t) );
+			idleCount--;
+		}
+		idleLock.leave();
+		if (t)
+			t->wake.set();
+	}
+
+public:
+	explicit WorkStealingThreadPool( bool stealing ) : threadCount(0), pending(0), nextQueue(0), idleCount(0), stealing(stealing), mode(Run) {}
+	~WorkStealingThreadPool() {}
+	Future<Void> stop() {
+		if (mode == Shutdown) return Void();
+		ReferenceCounted<WorkStealingThreadPool>::addref();
+		idleLock.enter();
+		mode = Shutdown;
+		std::vector<Thread*> sleeping;
+		std::swap( sleeping, idle );
+		idleCount = 0;
+		idleLock.leave();
+		for(auto t : sleeping)
+			t->wake.set();
+
+		int n = threadCount.load();
+		for(int i=0; i<n; i++)
+			threads[i]->stopped.block();
+		for(int i=0; i<n; i++) {
+			for(int a=0; a<threads[i]->queue.size(); a++)
+				threads[i]->queue[a]->cancel();
+			delete threads[i];
+		}
+		ReferenceCounted<WorkStealingThreadPool>::delref();
+		return Void();
+	}
+	virtual Future<Void> getError() { return Never(); }  // FIXME
+	virtual void addref() { ReferenceCounted<WorkStealingThreadPool>::addref(); }
+	virtual void delref() { if (ReferenceCounted<WorkStealingThreadPool>::delref_no_destroy()) stop(); }
+	void addThread( IThreadPoolReceiver* userData ) {
+		int n = threadCount.load();
+		ASSERT( n < MAX_THREADS );
+		threads[n] = new Thread(this, userData, n);
+		threadCount++;
+		startThread(start, threads[n]);
+	}
+	void post( PThreadAction action ) {
+		Thread* t = currentThread && currentThread->pool == this ? currentThread : NULL;
+		if (!t) {
+			int n = threadCount.load();
+			ASSERT( n );
+			t = threads[ nextQueue++ % n ];
+		}
+		t->push(action);
+		pending++;
+		wakeFor(t);
+	}
+};
+
+thread_local WorkStealingThreadPool::Thread* WorkStealingThreadPool::currentThread;
+
+Reference<IThreadPool> createWorkStealingThreadPool( bool pinned ) {
+	return Reference<IThreadPool>( new WorkStealingThreadPool( !pinned ) );
+}
+
 Reference<IThreadPool>	createGenericThreadPool()
 {
+	if (FLOW_KNOBS->GENERIC_THREAD_POOL == "stealing")
+		return createWorkStealingThreadPool( false );
+	if (FLOW_KNOBS->GENERIC_THREAD_POOL == "pinned")
+		return createWorkStealingThreadPool( true );
 	return Reference<IThreadPool>( new ThreadPool );
 }
 
-thread_local IThreadPoolReceiver* ThreadPool::Thread::threadUserObject;
+namespace {
+
+struct CountingReceiver : IThreadPoolReceiver {
+	std::atomic<int64_t>* remaining;
+	Event* done;
+	int64_t ran;
+	int64_t* ranOut;
+	CountingReceiver( std::atomic<int64_t>* remaining, Event* done, int64_t* ranOut ) : remaining(remaining), done(done), ran(0), ranOut(ranOut) {}
+	~CountingReceiver() { *ranOut = ran; }
+	virtual void init() {}
+
+	struct CountAction : TypedAction<CountingReceiver, CountAction> {
+		IThreadPool* pool;
+		int children;  // The actions this one posts before it counts itself
+		CountAction( IThreadPool* pool, int children ) : pool(pool), children(children) {}
+		virtual double getTimeEstimate() { return 0; }
+	};
+	void action( CountAction& a ) {
+		for(int i = 0; i < a.children; i++)
+			a.pool->post( new CountAction( a.pool, 0 ) );
+		ran++;
+		if (--*remaining == 0)
+			done->set();
+	}
+};
+
+// Runs actions actions, a tenth of them posted by other actions, on a pool of the given number of threads and returns
+// the number that each thread ran.  Also prints the rate at which they ran.
+std::vector<int64_t> runCountingActions( Reference<IThreadPool> pool, const char* name, int threads, int actions ) {
+	std::atomic<int64_t> remaining( actions );
+	Event done;
+	std::vector<int64_t> ran( threads );
+	for(int i = 0; i < threads; i++)
+		pool->addThread( new CountingReceiver( &remaining, &done, &ran[i] ) );
+
+	double start = timer();
+	for(int i = 0; i < actions / 10; i++) {
+		pool->post( new CountingReceiver::CountAction( pool.getPtr(), 1 ) );
+		for(int j = 0; j < 8; j++)
+			pool->post( new CountingReceiver::CountAction( pool.getPtr(), 0 ) );
+	}
+	done.block();
+	double elapsed = timer() - start;
+	pool->stop();
+	printf("%s thread pool, %d threads: %0.2f M actions/sec\n", name, threads, actions / 1e6 / elapsed);
+	return ran;
+}
+
+}
+
+TEST_CASE("flow/IThreadPool/work stealing") {
+	// Every action runs exactly once, and in a pinned pool the actions are divided evenly among the threads
+	for(int pinned = 0; pinned < 2; pinned++) {
+		std::vector<int64_t> ran = runCountingActions( createWorkStealingThreadPool(pinned), pinned ? "Pinned" : "Work stealing", 4, 40000 );
+		int64_t total = 0;
+		for(auto r : ran) {
+			total += r;
+			if (pinned)
+				ASSERT( r == 40000 / 4 );
+		}
+		ASSERT( total == 40000 );
+	}
+	return Void();
+}
+
+TEST_CASE("flow/perf/thread pool") {
+	// Compares the throughput of trivial actions posted from one thread, as the network thread posts them
+	int actions = 1000000;
+	for(int threads = 1; threads <= 8; threads *= 2) {
+		runCountingActions( Reference<IThreadPool>( new ThreadPool ), "Shared queue", threads, actions );
+		runCountingActions( createWorkStealingThreadPool(false), "Work stealing", threads, actions );
+		runCountingActions( createWorkStealingThreadPool(true), "Pinned", threads, actions );
+	}
+	return Void();
+}
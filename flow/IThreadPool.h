@@ -103,7 +103,13 @@ private:
 	Promise<T> promise;
 };
 
+// Creates the implementation chosen by FLOW_KNOBS->GENERIC_THREAD_POOL
 Reference<IThreadPool>	createGenericThreadPool();
 
+// A pool with a queue of actions for each thread, so that threads don't contend for one queue.  Idle threads take actions
+// from the queues of the others unless pinned is true, in which case each action runs on the thread it was queued for:
+// the next in turn, or for an action posted by an action, the thread running it.
+Reference<IThreadPool>	createWorkStealingThreadPool( bool pinned = false );
+
 
 #endif
\ No newline at end of file
@@ -135,6 +135,35 @@ TEST_CASE("flow/IndexedSet/erase 400k of 1M") {
 	return Void();
 }
 
+TEST_CASE("flow/IndexedSet/build") {
+	for (int n = 0; n < 300; n++) {
+		IndexedSet<int, int> is;
+		is.insert(-1, 3);
+		std::vector<std::pair<int, int>> items;
+		for (int i = 0; i < n; i++)
+			items.push_back(std::make_pair(2*i, 3));
+		is.build(std::move(items));
+		is.testonly_assertBalanced();
+
+		int count = 0;
+		for (auto i : is) {
+			ASSERT(i == 2*count);
+			++count;
+		}
+		ASSERT(count == n && is.sumTo(is.end()) == 3*n);
+		if (n) ASSERT(*is.index(3*(n/2)) == 2*(n/2));
+
+		// The built tree stays balanced under later changes
+		for (int i = 0; i < n; i++) {
+			is.insert(2*i+1, 3);
+			if (i % 3 == 0) is.erase(2*i);
+		}
+		is.testonly_assertBalanced();
+	}
+
+	return Void();
+}
+
 /*TEST_CASE("flow/IndexedSet/performance") {
 	std::vector<int> x;
 	for (int i = 0; i<1000000; i++)
@@ -426,4 +455,90 @@ TEST_CASE("flow/IndexedSet/all numbers") {
 	return Void();
 }
 
-void forceLinkIndexedSetTests() {}
\ No newline at end of file
+void forceLinkIndexedSetTests() {}
+// An element as large as a key-value pair of KeyValueStoreMemory, whose nodes span two cache lines
+struct WideElement {
+	int key;
+	char padding[36];
+
+	WideElement( int key ) : key(key) {}
+	bool operator < ( WideElement const& r ) const { return key < r.key; }
+	bool operator < ( int r ) const { return key < r; }
+	bool operator == ( int r ) const { return key == r; }
+	friend bool operator < ( int l, WideElement const& r ) { return l < r.key; }
+};
+
+template <class T>
+static void benchmarkIndexedSet( const char* name, int n ) {
+	std::vector<int> keys;
+	for (int i = 0; i<n; i++)
+		keys.push_back(i * 2);
+	std::random_shuffle(keys.begin(), keys.end());
+
+	IndexedSet<T, int64_t> is;
+	double start = timer();
+	for (int k : keys)
+		is.insert(T(k), 1);
+	double insertTime = timer() - start;
+
+	std::random_shuffle(keys.begin(), keys.end());
+	start = timer();
+	int found = 0;
+	for (int k : keys)
+		found += is.find(k) != is.end();
+	double findTime = timer() - start;
+	ASSERT(found == n);
+
+	start = timer();
+	int64_t sum = 0;
+	for (int k : keys)
+		sum += is.sumTo(is.lower_bound(k + 1));
+	double sumToTime = timer() - start;
+	ASSERT(sum == int64_t(n)*(n + 1) / 2);
+
+	printf("%s, %d elements of %d node bytes: %0.2f M insert/sec, %0.2f M find/sec, %0.2f M lower_bound+sumTo/sec\n",
+		name, n, IndexedSet<T, int64_t>::getElementBytes(), n / 1e6 / insertTime, n / 1e6 / findTime, n / 1e6 / sumToTime);
+}
+
+TEST_CASE("flow/perf/IndexedSet") {
+	// Random inserts, finds and sums over sets too large for the caches.  Sets of 100M elements need about 7GB for the
+	// int nodes and more for the wide ones, so they are left out here.
+	for (int n : { 1000000, 10000000 }) {
+		benchmarkIndexedSet<int>("int", n);
+		benchmarkIndexedSet<WideElement>("40 byte element", n);
+	}
+	return Void();
+}
+
+// A set of a million even numbers, shared by the benchmarks below, which leave it as they found it
+static IndexedSet<int, int64_t>& benchmarkSet() {
+	static IndexedSet<int, int64_t>* set = nullptr;
+	if (!set) {
+		set = new IndexedSet<int, int64_t>;
+		for (int i = 0; i < 1000000; i++)
+			set->insert(i * 2, 1);
+	}
+	return *set;
+}
+
+BENCHMARK_CASE("flow/IndexedSet/find") {
+	IndexedSet<int, int64_t>& is = benchmarkSet();
+	int found = 0;
+	for (int i = 0; i < iterations; i++)
+		found += is.find(int((i * 2654435761u) % 2000000)) != is.end();
+	benchmarkSink(found);
+}
+
+BENCHMARK_CASE("flow/IndexedSet/insert and erase") {
+	IndexedSet<int, int64_t>& is = benchmarkSet();
+	for (int i = 0; i < iterations; i++)
+		is.erase(is.insert(int((i * 2654435761u) % 1000000) * 2 + 1, 1));
+}
+
+BENCHMARK_CASE("flow/IndexedSet/sumTo") {
+	IndexedSet<int, int64_t>& is = benchmarkSet();
+	int64_t sum = 0;
+	for (int i = 0; i < iterations; i++)
+		sum += is.sumTo(is.lower_bound(int((i * 2654435761u) % 2000000)));
+	benchmarkSink(sum);
+}
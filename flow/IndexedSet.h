@@ -66,7 +66,7 @@ private: // Forward-declare IndexedSet::Node because Clang is much stricter abou
 		// references so that we don't need to maintain the set of 2^arity lvalue and rvalue reference
 		// combinations, but still take advantage of move constructors when available (or required).
 		template <class T_, class Metric_>
-		Node(T_&& data, Metric_&& m, Node* parent=0) : data(std::forward<T_>(data)), total(std::forward<Metric_>(m)), parent(parent), balance(0) {
+		Node(T_&& data, Metric_&& m, Node* parent=0) : parent(parent), total(std::forward<Metric_>(m)), data(std::forward<T_>(data)), balance(0) {
 			child[0] = child[1] = NULL;
 		}
 		~Node(){
@@ -74,11 +74,14 @@ private: // Forward-declare IndexedSet::Node because Clang is much stricter abou
 			delete child[1];
 		}
 
-		T data;
-		signed char balance;	// right height - left height
-		Metric total;			// this + child[0] + child[1]
+		// FastAllocated nodes start on a cache line.  Searches read child and data, and sumTo() reads child, parent and
+		// total, so the pointers and the metric come first and data follows them, keeping its leading bytes (usually the
+		// key) in the first line of a node larger than one.  balance goes last so that it doesn't pad the fields between.
 		Node *child[2];			// left, right
 		Node *parent;
+		Metric total;			// this + child[0] + child[1]
+		T data;
+		signed char balance;	// right height - left height
 	};
 
 public:
@@ -117,6 +120,10 @@ public:
 	//   replaceExisting == true, it will be overwritten (and its metric will be replaced). returns the number of items inserted.
 	int insert(const std::vector<std::pair<T,Metric>>& data, bool replaceExisting = true);
 
+	// Replace the contents of the set with the items of data, which must be in increasing order, each with its metric.
+	//   The tree is built directly, in O(n) time rather than the O(n lg n) of inserting the items one by one.
+	void build(std::vector<std::pair<T,Metric>>&& data);
+
 	// Increase the metric for the given item by the given amount.  Inserts data into the set if it
 	//   doesn't exist. Returns the new sum.
 	template <class T_, class Metric_>
@@ -194,6 +201,7 @@ private:
 	Node *root;
 
 	Metric eraseHalf( Node* start, Node* end, int eraseDir, int& heightDelta, std::vector<Node*>& toFree );
+	static Node* buildSubtree( std::pair<T,Metric>* items, int count, Node* parent, int& height );
 	void erase( iterator begin, iterator end, std::vector<Node*>& toFree );
 
 	void replacePointer( Node* oldNode, Node* newNode ) {
@@ -287,6 +295,7 @@ public:
 	iterator insert( const Pair& p, bool replaceExisting = true, Metric m = Metric(1) ) { return set.insert(p, m, replaceExisting); }
 	iterator insert( Pair && p, bool replaceExisting = true, Metric m = Metric(1) ) { return set.insert(std::move(p), m, replaceExisting); }
 	int insert( const std::vector<std::pair<MapPair<Key,Value>, Metric>>& pairs, bool replaceExisting = true) { return set.insert(pairs, replaceExisting); }
+	void build( std::vector<std::pair<Pair, Metric>>&& pairs ) { set.build(std::move(pairs)); }
 	
 	template <class KeyCompatible>
 	void erase( KeyCompatible const& k ) { set.erase(k); }
@@ -776,6 +785,33 @@ int IndexedSet<T,Metric>::insert(const std::vector<std::pair<T,Metric>>& dataVec
 	return num_inserted;
 }
 
+template <class T, class Metric>
+void IndexedSet<T,Metric>::build(std::vector<std::pair<T,Metric>>&& data) {
+	clear();
+	int height;
+	root = buildSubtree(data.data(), data.size(), NULL, height);
+}
+
+template <class T, class Metric>
+typename IndexedSet<T,Metric>::Node* IndexedSet<T,Metric>::buildSubtree( std::pair<T,Metric>* items, int count, Node* parent, int& height ) {
+	// The middle item is the root, so the left subtree has as many items as the right or one more.  Subtrees of equal
+	// size come out with equal heights, hence the heights of the two sides differ by at most one.
+	if (!count) {
+		height = 0;
+		return NULL;
+	}
+	int mid = count / 2;
+	Node* n = new Node(std::move(items[mid].first), items[mid].second, parent);
+	int leftHeight, rightHeight;
+	n->child[0] = buildSubtree(items, mid, n, leftHeight);
+	n->child[1] = buildSubtree(items + mid + 1, count - mid - 1, n, rightHeight);
+	n->balance = rightHeight - leftHeight;
+	if (n->child[0]) n->total = n->total + n->child[0]->total;
+	if (n->child[1]) n->total = n->total + n->child[1]->total;
+	height = std::max(leftHeight, rightHeight) + 1;
+	return n;
+}
+
 template <class T, class Metric>
 Metric IndexedSet<T,Metric>::eraseHalf( Node* start, Node* end, int eraseDir, int& heightDelta, std::vector<Node*>& toFree ) {
 	// Removes all nodes between start (inclusive) and end (exclusive) from the set, where start is equal to end or one of its descendants
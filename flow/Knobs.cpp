@@ -47,9 +47,16 @@ FlowKnobs::FlowKnobs(bool randomize, bool isSimulated) {
 
 	init( RANDOMSEED_RETRY_LIMIT,                                4 );
 
+	//Arena
+	init( ARENA_LARGE_BLOCK_CACHE_BYTES,                         0 ); if( randomize && BUGGIFY ) ARENA_LARGE_BLOCK_CACHE_BYTES = 16<<20; // Per thread; 0 disables the large block cache
+
+	//FastAllocator
+	init( FASTALLOC_RECLAIM_INTERVAL,                            0 ); // Seconds between passes returning long-unused FastAllocator memory to the OS; 0 disables
+
 	//connectionMonitor
 	init( CONNECTION_MONITOR_LOOP_TIME,   isSimulated ? 0.75 : 1.0 ); if( randomize && BUGGIFY ) CONNECTION_MONITOR_LOOP_TIME = 6.0;
 	init( CONNECTION_MONITOR_TIMEOUT,     isSimulated ? 1.50 : 2.0 ); if( randomize && BUGGIFY ) CONNECTION_MONITOR_TIMEOUT = 6.0;
+	init( CONNECTION_MONITOR_IDLE_TIMEOUT,                   180.0 ); if( randomize && BUGGIFY ) CONNECTION_MONITOR_IDLE_TIMEOUT = 5.0;
 
 	//FlowTransport
 	init( CONNECTION_REJECTED_MESSAGE_DELAY,                   1.0 );
@@ -68,10 +75,21 @@ FlowKnobs::FlowKnobs(bool randomize, bool isSimulated) {
 	init( BUGGIFY_SIM_PAGE_CACHE_4K,                           1e6 );
 	init( BUGGIFY_SIM_PAGE_CACHE_64K,                          1e6 );
 	init( MAX_EVICT_ATTEMPTS,                                  100 ); if( randomize && BUGGIFY ) MAX_EVICT_ATTEMPTS = 2;
+	init( PAGE_CACHE_EVICTION_POLICY,                     "random" ); if( randomize && BUGGIFY ) PAGE_CACHE_EVICTION_POLICY = "2q"; // "random" or "2q"
+	init( PAGE_CACHE_PROBATIONARY_FRACTION,                   0.25 );
+	init( PAGE_CACHE_READ_AHEAD_MIN,                        64<<10 );
+	init( PAGE_CACHE_READ_AHEAD_MAX,                         1<<20 ); if( randomize && BUGGIFY ) PAGE_CACHE_READ_AHEAD_MAX = g_random->coinflip() ? 0 : 16<<10; // 0 disables reading ahead
+	init( PAGE_CACHE_FLUSH_WRITE_SIZE,                       1<<20 ); if( randomize && BUGGIFY ) PAGE_CACHE_FLUSH_WRITE_SIZE = 8192; // The largest write of adjacent dirty pages
+	init( PAGE_CACHE_FLUSH_CONCURRENCY,                         64 ); if( randomize && BUGGIFY ) PAGE_CACHE_FLUSH_CONCURRENCY = 1; // Per file
 
 	//AsyncFileKAIO
 	init( MAX_OUTSTANDING,                                      64 );
 	init( MIN_SUBMIT,                                           10 );
+	init( USE_IO_URING,                                          0 ); // Falls back to KAIO if the kernel does not support io_uring
+	init( IO_FOREGROUND_WEIGHT,                                 16 ); // Shares of disk bandwidth for each IOClass
+	init( IO_COMMIT_WEIGHT,                                      4 );
+	init( IO_BACKGROUND_WEIGHT,                                  1 );
+	init( IO_FOREGROUND_RESERVED_REQUESTS,                      16 ); // Of MAX_OUTSTANDING
 
 	init( PAGE_WRITE_CHECKSUM_HISTORY,                           0 ); if( randomize && BUGGIFY ) PAGE_WRITE_CHECKSUM_HISTORY = 10000000;
 
@@ -92,10 +110,13 @@ FlowKnobs::FlowKnobs(bool randomize, bool isSimulated) {
 	init( SLOW_LOOP_CUTOFF,                          15.0 / 1000.0 );
 	init( SLOW_LOOP_SAMPLING_RATE,                             0.1 );
 	init( TSC_YIELD_TIME,                                  1000000 );
+	init( GENERIC_THREAD_POOL,                              "asio" ); // "asio" for one queue shared by all threads, "stealing" or "pinned" for a queue per thread; see createWorkStealingThreadPool()
+	init( SAMPLING_PROFILER_PERIOD,                           20000 ); // Microseconds of network thread CPU time between samples of the always on profiler; 0 disables it
 
 	//Network
 	init( PACKET_LIMIT,                                  100LL<<20 );
 	init( PACKET_WARNING,                                  2LL<<20 );  // 2MB packet warning quietly allows for 1MB system messages
+	init( PACKET_SEND_BY_REFERENCE_BYTES,                    65536 ); if( randomize && BUGGIFY ) PACKET_SEND_BY_REFERENCE_BYTES = g_random->randomInt(1, 100);
 	init( TIME_OFFSET_LOGGING_INTERVAL,                       60.0 );
 
 	//Sim2
@@ -108,6 +129,11 @@ FlowKnobs::FlowKnobs(bool randomize, bool isSimulated) {
 	init( SLOW_NETWORK_LATENCY,                             100e-3 );
 	init( MAX_CLOGGING_LATENCY,                                  0 ); if( randomize && BUGGIFY ) MAX_CLOGGING_LATENCY =  0.1 * g_random->random01();
 	init( MAX_BUGGIFIED_DELAY,                                   0 ); if( randomize && BUGGIFY ) MAX_BUGGIFIED_DELAY =  0.2 * g_random->random01();
+	init( SIM_PERF_MODE,                                         0 ); // If set, simulated processes are charged for CPU and latencies are fixed, so that benchmarks give reproducible results
+	init( SIM_PERF_TASK_CPU_COST,                            20e-6 ); // Simulated CPU seconds charged for running a task
+	init( SIM_PERF_IO_TASK_CPU_COST,                          5e-6 ); // ... for a task at TaskDiskIOComplete priority or above, which only hands off I/O
+	init( SIM_PERF_NETWORK_LATENCY,                         200e-6 );
+	init( SIM_PERF_DISK_SYNC_LATENCY,                        0.002 );
 
 	//Tracefiles
 	init( ZERO_LENGTH_FILE_PAD,                                  1 );
@@ -119,6 +145,9 @@ FlowKnobs::FlowKnobs(bool randomize, bool isSimulated) {
 	init( TRACE_EVENT_METRIC_UNITS_PER_SAMPLE,				   500 );
 	init( TRACE_EVENT_THROTLLER_SAMPLE_EXPIRY,				   1800.0 ); // 30 mins
 	init( TRACE_EVENT_THROTTLER_MSG_LIMIT,					  20000 );
+	init( ACTOR_FRAME_STATS_TOP,                                 0 ); // The number of actors with the most frame allocations to trace with ProcessMetrics; 0 disables
+	init( TRACE_FORMAT,                                      "xml" ); // "xml" or "binary"; tools that read trace files, including those of simulation, expect XML
+	init( TRACE_BINARY_BLOCK_BYTES,                         1<<20 );
 
 	//TDMetrics
 	init( MAX_METRICS,                                         600 );
@@ -139,6 +168,11 @@ FlowKnobs::FlowKnobs(bool randomize, bool isSimulated) {
 	init( SECOND_REQUEST_MULTIPLIER_DECAY,                 0.00025 );
 	init( SECOND_REQUEST_BUDGET_GROWTH,                       0.05 );
 	init( SECOND_REQUEST_MAX_BUDGET,                         100.0 );
+	init( LOAD_BALANCE_TAIL_LATENCY,                             1 ); if( randomize && BUGGIFY ) LOAD_BALANCE_TAIL_LATENCY = 0;
+	init( QUEUE_MODEL_LATENCY_SMOOTHING,                     0.125 );
+	init( QUEUE_MODEL_TAIL_DEVIATIONS,                         4.0 );
+	init( QUEUE_MODEL_SERVER_QUEUE_WEIGHT,                     0.1 );
+	init( QUEUE_MODEL_MEASUREMENT_EXPIRY,                      1.0 ); if( randomize && BUGGIFY ) QUEUE_MODEL_MEASUREMENT_EXPIRY = 0.1;
 	init( ALTERNATIVES_FAILURE_RESET_TIME,                     5.0 );
 	init( ALTERNATIVES_FAILURE_MAX_DELAY,                      1.0 );
 	init( ALTERNATIVES_FAILURE_MIN_DELAY,                     0.05 );
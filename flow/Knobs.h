@@ -67,9 +67,16 @@ public:
 	double SLOWTASK_PROFILING_MAX_LOG_INTERVAL;
 	double SLOWTASK_PROFILING_LOG_BACKOFF;
 
+	//Arena
+	int64_t ARENA_LARGE_BLOCK_CACHE_BYTES;
+
+	//FastAllocator
+	double FASTALLOC_RECLAIM_INTERVAL;
+
 	//connectionMonitor
 	double CONNECTION_MONITOR_LOOP_TIME;
 	double CONNECTION_MONITOR_TIMEOUT;
+	double CONNECTION_MONITOR_IDLE_TIMEOUT;
 
 	//FlowTransport
 	double CONNECTION_REJECTED_MESSAGE_DELAY;
@@ -88,10 +95,21 @@ public:
 	int64_t BUGGIFY_SIM_PAGE_CACHE_4K;
 	int64_t BUGGIFY_SIM_PAGE_CACHE_64K;
 	int MAX_EVICT_ATTEMPTS;
+	std::string PAGE_CACHE_EVICTION_POLICY;
+	double PAGE_CACHE_PROBATIONARY_FRACTION;
+	int64_t PAGE_CACHE_READ_AHEAD_MIN;
+	int64_t PAGE_CACHE_READ_AHEAD_MAX;
+	int PAGE_CACHE_FLUSH_WRITE_SIZE;
+	int PAGE_CACHE_FLUSH_CONCURRENCY;
 
 	//AsyncFileKAIO
 	int MAX_OUTSTANDING;
 	int MIN_SUBMIT;
+	int USE_IO_URING;
+	int IO_FOREGROUND_WEIGHT;
+	int IO_COMMIT_WEIGHT;
+	int IO_BACKGROUND_WEIGHT;
+	int IO_FOREGROUND_RESERVED_REQUESTS;
 
 	int PAGE_WRITE_CHECKSUM_HISTORY;
 
@@ -112,11 +130,14 @@ public:
 	double SLOW_LOOP_CUTOFF;
 	double SLOW_LOOP_SAMPLING_RATE;
 	int64_t TSC_YIELD_TIME;
+	int SAMPLING_PROFILER_PERIOD;
+	std::string GENERIC_THREAD_POOL;
 	int64_t REACTOR_FLAGS;
 
 	//Network
 	int64_t PACKET_LIMIT;
 	int64_t PACKET_WARNING;  // 2MB packet warning quietly allows for 1MB system messages
+	int PACKET_SEND_BY_REFERENCE_BYTES;
 	double TIME_OFFSET_LOGGING_INTERVAL;
 
 	//Sim2
@@ -130,6 +151,11 @@ public:
 	double SLOW_NETWORK_LATENCY;
 	double MAX_CLOGGING_LATENCY;
 	double MAX_BUGGIFIED_DELAY;
+	int SIM_PERF_MODE;
+	double SIM_PERF_TASK_CPU_COST;
+	double SIM_PERF_IO_TASK_CPU_COST;
+	double SIM_PERF_NETWORK_LATENCY;
+	double SIM_PERF_DISK_SYNC_LATENCY;
 
 	//Tracefiles
 	int ZERO_LENGTH_FILE_PAD;
@@ -141,6 +167,9 @@ public:
 	int TRACE_EVENT_METRIC_UNITS_PER_SAMPLE;
 	int TRACE_EVENT_THROTLLER_SAMPLE_EXPIRY;
 	int TRACE_EVENT_THROTTLER_MSG_LIMIT;
+	int ACTOR_FRAME_STATS_TOP;
+	std::string TRACE_FORMAT;
+	int TRACE_BINARY_BLOCK_BYTES;
 
 	//TDMetrics
 	int64_t MAX_METRIC_SIZE;
@@ -161,6 +190,11 @@ public:
 	double SECOND_REQUEST_MULTIPLIER_DECAY;
 	double SECOND_REQUEST_BUDGET_GROWTH;
 	double SECOND_REQUEST_MAX_BUDGET;
+	int LOAD_BALANCE_TAIL_LATENCY;
+	double QUEUE_MODEL_LATENCY_SMOOTHING;
+	double QUEUE_MODEL_TAIL_DEVIATIONS;
+	double QUEUE_MODEL_SERVER_QUEUE_WEIGHT;
+	double QUEUE_MODEL_MEASUREMENT_EXPIRY;
 	double ALTERNATIVES_FAILURE_RESET_TIME;
 	double ALTERNATIVES_FAILURE_MAX_DELAY;
 	double ALTERNATIVES_FAILURE_MIN_DELAY;
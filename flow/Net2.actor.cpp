@@ -33,6 +33,8 @@
 
 #include "ActorCollection.h"
 #include "ThreadSafeQueue.h"
+#include "TimerWheel.h"
+#include "RunQueue.h"
 #include "ThreadHelper.actor.h"
 #include "TDMetric.actor.h"
 #include "AsioReactor.h"
@@ -51,7 +53,7 @@ using namespace boost::asio::ip;
 // These impact both communications and the deserialization of certain database and IKeyValueStore keys
 //                                                 xyzdev
 //                                                 vvvv
-uint64_t currentProtocolVersion        = 0x0FDB00A560010001LL;
+uint64_t currentProtocolVersion        = 0x0FDB00A560060001LL;
 uint64_t compatibleProtocolVersionMask = 0xffffffffffff0000LL;
 uint64_t minValidProtocolVersion       = 0x0FDB00A200060001LL;
 
@@ -105,11 +107,9 @@ public:
 };
 
 struct OrderedTask {
-	int64_t priority;
 	int taskID;
 	Task *task;
-	OrderedTask(int64_t priority, int taskID, Task* task) : priority(priority), taskID(taskID), task(task) {}
-	bool operator < (OrderedTask const& rhs) const { return priority < rhs.priority; }
+	OrderedTask(int taskID, Task* task) : taskID(taskID), task(task) {}
 };
 
 thread_local INetwork* thread_network = 0;
@@ -163,7 +163,6 @@ public:
 	int64_t tsc_begin, tsc_end;
 	double taskBegin;
 	int currentTaskID;
-	uint64_t tasksIssued;
 	TDMetricCollection tdmetrics;
 	double currentTime;
 	bool stopped;
@@ -175,22 +174,17 @@ public:
 	int lastMinTaskID;
 	double priorityTimer[NetworkMetrics::PRIORITY_BINS];
 
-	std::priority_queue<OrderedTask, std::vector<OrderedTask>> ready;
+	RunQueue<Task*> ready;
 	ThreadSafeQueue<OrderedTask> threadReady;
 
-	struct DelayedTask : OrderedTask {
-		double at;
-		DelayedTask(double at, int64_t priority, int taskID, Task* task) : at(at), OrderedTask(priority, taskID, task) {}
-		bool operator < (DelayedTask const& rhs) const { return at > rhs.at; } // Ordering is reversed for priority_queue
-	};
-	std::priority_queue<DelayedTask, std::vector<DelayedTask>> timers;
+	TimerWheel timers;
 
 	void checkForSlowTask(int64_t tscBegin, int64_t tscEnd, double duration, int64_t priority);
 	bool check_yield(int taskId, bool isRunLoop);
 	void processThreadReady();
 	void trackMinPriority( int minTaskID, double now );
 	void stopImmediately() {
-		stopped=true; decltype(ready) _1; ready.swap(_1); decltype(timers) _2; timers.swap(_2);
+		stopped=true; ready.clear(); timers.clear();
 	}
 
 	Future<Void> timeOffsetLogger;
@@ -206,6 +200,8 @@ public:
 	Int64MetricHandle countCantSleep;
 	Int64MetricHandle countWontSleep;
 	Int64MetricHandle countTimers;
+	Int64MetricHandle timerCount;
+	Int64MetricHandle timerWheelDepth;
 	Int64MetricHandle countTasks;
 	Int64MetricHandle countYields;
 	Int64MetricHandle countYieldBigStack;
@@ -307,7 +303,21 @@ public:
 		++g_net2->countReadProbes;
 		BindPromise p("N2_ReadProbeError", id);
 		auto f = p.getFuture();
+#ifdef WIN32
+		// asio waits for readiness (null_buffers) with select() in a thread of its own, which then posts to the
+		// completion port.  A zero byte overlapped receive completes on the port itself once there is data to read or
+		// the connection is closed, without that thread.
+		boost::asio::windows::overlapped_ptr op( socket.get_io_service(), std::move(p) );
+		WSABUF buffer = { 0, NULL };
+		DWORD flags = 0;
+		int error = WSARecv( socket.native_handle(), &buffer, 1, NULL, &flags, op.get(), NULL ) ? WSAGetLastError() : 0;
+		if (error && error != WSA_IO_PENDING)
+			op.complete( boost::system::error_code( error, boost::asio::error::get_system_category() ), 0 );
+		else
+			op.release();  // The completion is queued to the port even if the receive succeeded at once
+#else
 		socket.async_read_some( boost::asio::null_buffers(), std::move(p) );
+#endif
 		return f;
 	}
 
@@ -474,17 +484,45 @@ struct PromiseTask : public Task, public FastAllocated<PromiseTask> {
 	}
 };
 
+// The state of a delay(), which is both the task that fires it and the SAV of the future it returns.  When the last
+// reference to that future is dropped before the delay fires, cancel() takes it out of the timer wheel and frees it.
+struct TimerTask : SAV<Void>, Task, TimerWheelEntry, FastAllocated<TimerTask> {
+	using FastAllocated<TimerTask>::operator new;
+	using FastAllocated<TimerTask>::operator delete;
+
+	TimerWheel* wheel;
+	int taskID;
+
+	TimerTask( TimerWheel* wheel, double at, int taskID ) : SAV<Void>(1, 1), wheel(wheel), taskID(taskID) {
+		this->at = at;
+	}
+
+	virtual void operator()() {
+		sendAndDelPromiseRef(Void());
+	}
+
+	virtual void cancel() {
+		// If the delay has already been moved to the ready queue, it is freed when it runs
+		if (isLinked()) {
+			wheel->remove(this);
+			delPromiseRef();
+		}
+	}
+
+	virtual void destroy() { delete this; }
+};
+
 Net2::Net2(NetworkAddress localAddress, bool useThreadPool, bool useMetrics)
 	: useThreadPool(useThreadPool),
 	  network(this),
 	  reactor(this),
 	  tcpResolver(reactor.ios),
 	  stopped(false),
-	  tasksIssued(0),
 	  // Until run() is called, yield() will always yield
 	  tsc_begin(0), tsc_end(0), taskBegin(0), currentTaskID(TaskDefaultYield),
 	  lastMinTaskID(0),
-	  numYields(0)
+	  numYields(0),
+	  timers(timer_monotonic())
 {
 	TraceEvent("Net2Starting");
 
@@ -529,6 +567,8 @@ void Net2::initMetrics() {
 	countCantSleep.init(LiteralStringRef("Net2.CountCantSleep"));
 	countWontSleep.init(LiteralStringRef("Net2.CountWontSleep"));
 	countTimers.init(LiteralStringRef("Net2.CountTimers"));
+	timerCount.init(LiteralStringRef("Net2.TimerCount"));
+	timerWheelDepth.init(LiteralStringRef("Net2.TimerWheelDepth"));
 	countTasks.init(LiteralStringRef("Net2.CountTasks"));
 	countYields.init(LiteralStringRef("Net2.CountYields"));
 	countYieldBigStack.init(LiteralStringRef("Net2.CountYieldBigStack"));
@@ -585,7 +625,7 @@ void Net2::run() {
 		if (b) {
 			sleepTime = 1e99;
 			if (!timers.empty())
-				sleepTime = timers.top().at - timer_monotonic();  // + 500e-6?
+				sleepTime = timers.nextExpiration() - timer_monotonic();  // + 500e-6?
 		}
 
 		awakeMetric = false;
@@ -601,11 +641,13 @@ void Net2::run() {
 			TraceEvent("SomewhatSlowRunLoopTop").detail("Elapsed", now - nnow);
 
 		if (sleepTime) trackMinPriority( 0, now );
-		while (!timers.empty() && timers.top().at < now) {
+		timers.expire( now, [this]( TimerWheelEntry* e ) {
 			++countTimers;
-			ready.push( timers.top() );
-			timers.pop();
-		}
+			TimerTask* t = static_cast<TimerTask*>(e);
+			ready.push( t->taskID, t );
+		} );
+		timerCount = timers.size();
+		timerWheelDepth = timers.depth();
 
 		processThreadReady();
 
@@ -617,10 +659,10 @@ void Net2::run() {
 
 		while (!ready.empty()) {
 			++countTasks;
-			currentTaskID = ready.top().taskID;
+			currentTaskID = ready.topPriority();
 			priorityMetric = currentTaskID;
 			minTaskID = std::min(minTaskID, currentTaskID);
-			Task* task = ready.top().task;
+			Task* task = ready.front();
 			ready.pop();
 
 			try {
@@ -710,9 +752,8 @@ void Net2::processThreadReady() {
 	while (true) {
 		Optional<OrderedTask> t = threadReady.pop();
 		if (!t.present()) break;
-		t.get().priority -= ++tasksIssued;
 		ASSERT( t.get().task != 0 );
-		ready.push( t.get() );
+		ready.push( t.get().taskID, t.get().task );
 	}
 }
 
@@ -755,7 +796,7 @@ bool Net2::check_yield( int taskID, bool isRunLoop ) {
 	processThreadReady();
 
 	if (taskID == TaskDefaultYield) taskID = currentTaskID;
-	if (!ready.empty() && ready.top().priority > (int64_t(taskID)<<32))  {
+	if (ready.hasHigherPriority(taskID))  {
 		return true;
 	}
 
@@ -798,28 +839,26 @@ Future<class Void> Net2::yield( int taskID ) {
 Future<Void> Net2::delay( double seconds, int taskId ) {
 	if (seconds <= 0.) {
 		PromiseTask* t = new PromiseTask;
-		this->ready.push( OrderedTask( (int64_t(taskId)<<32)-(++tasksIssued), taskId, t) );
+		this->ready.push( taskId, t );
 		return t->promise.getFuture();
 	}
 	if (seconds >= 4e12)  // Intervals that overflow an int64_t in microseconds (more than 100,000 years) are treated as infinite
 		return Never();
 
-	double at = now() + seconds;
-	PromiseTask* t = new PromiseTask;
-	this->timers.push( DelayedTask( at, (int64_t(taskId)<<32)-(++tasksIssued), taskId, t ) );
-	return t->promise.getFuture();
+	TimerTask* t = new TimerTask( &timers, now() + seconds, taskId );
+	timers.insert(t);
+	return Future<Void>(t);
 }
 
 void Net2::onMainThread(Promise<Void>&& signal, int taskID) {
 	if (stopped) return;
 	PromiseTask* p = new PromiseTask( std::move(signal) );
-	int64_t priority = int64_t(taskID)<<32;
 
 	if ( thread_network == this )
 	{
-		this->ready.push( OrderedTask( priority-(++tasksIssued), taskID, p ) );
+		this->ready.push( taskID, p );
 	} else {
-		if (threadReady.push( OrderedTask( priority, taskID, p ) ))
+		if (threadReady.push( OrderedTask( taskID, p ) ))
 			reactor.wake();
 	}
 }
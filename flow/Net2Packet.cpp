@@ -19,6 +19,7 @@
  */
 
 #include "Net2Packet.h"
+#include "Knobs.h"
 
 void PacketWriter::init(PacketBuffer* buf, ReliablePacket* reliable) {
 	this->buffer = buf;
@@ -55,12 +56,17 @@ void PacketWriter::serializeBytesAcrossBoundary(const void* data, int bytes) {
 
 void PacketWriter::nextBuffer() {
 	ASSERT( buffer->bytes_written == PacketBuffer::DATA_SIZE );
-	length += PacketBuffer::DATA_SIZE;
-	buffer->next = new PacketBuffer;
-	buffer = buffer->nextPacketBuffer();
+	appendBuffer( new PacketBuffer );
+}
+
+void PacketWriter::appendBuffer( PacketBuffer* next ) {
+	length += buffer->bytes_written;
+	if (reliable)
+		reliable->end = buffer->bytes_written;
+	buffer->next = next;
+	buffer = next;
 
 	if (reliable) {
-		reliable->end = PacketBuffer::DATA_SIZE;
 		reliable->cont = new ReliablePacket;
 		reliable = reliable->cont;
 		reliable->buffer = buffer; buffer->addref();
@@ -68,6 +74,20 @@ void PacketWriter::nextBuffer() {
 	}
 }
 
+void PacketWriter::serializeBytesByReference( StringRef bytes, Arena const& arena ) {
+	if (bytes.size() < FLOW_KNOBS->PACKET_SEND_BY_REFERENCE_BYTES) {
+		serializeBytes( bytes );
+		return;
+	}
+	// Any space left in the current buffer is wasted; the rest of the packet continues in a new buffer after these bytes
+	appendBuffer( new PacketBuffer(bytes, arena) );
+	appendBuffer( new PacketBuffer );
+}
+
+bool PacketWriter::sendsByReference( int bytes ) {
+	return bytes >= FLOW_KNOBS->PACKET_SEND_BY_REFERENCE_BYTES;
+}
+
 void PacketWriter::writeAhead( int bytes, struct SplitBuffer* buf ) {
 	if (bytes <= PacketBuffer::DATA_SIZE - buffer->bytes_written) {
 		buf->begin = buffer->data + buffer->bytes_written;
@@ -176,7 +196,7 @@ PacketBuffer* ReliablePacketList::compact(PacketBuffer* into, PacketBuffer* end)
 				into = into->nextPacketBuffer();
 			}
 
-			uint8_t* data = &c->buffer->data[c->begin];
+			uint8_t const* data = c->buffer->bytes_begin() + c->begin;
 			int len = c->end-c->begin;
 
 			if (len > into->bytes_unwritten()) {
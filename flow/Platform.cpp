@@ -98,6 +98,8 @@
 #include <sys/resource.h>
 /* Needed for crash handler */
 #include <signal.h>
+/* Needed for setThreadName */
+#include <sys/prctl.h>
 #endif
 
 #ifdef __APPLE__
@@ -233,6 +235,57 @@ double getProcessorTimeProcess() {
 #endif
 }
 
+void setThreadName( std::string const& name ) {
+#ifdef __linux__
+	prctl( PR_SET_NAME, name.substr(0, 15).c_str(), 0, 0, 0 );
+#endif
+}
+
+std::vector<ThreadProcessorTime> getProcessorTimeThreads() {
+	std::vector<ThreadProcessorTime> threads;
+#ifdef __linux__
+	static const double ticksPerSecond = sysconf(_SC_CLK_TCK);
+	int64_t current = syscall(SYS_gettid);
+
+	DIR* dir = opendir("/proc/self/task");
+	if( !dir ) {
+		TraceEvent(SevWarnAlways, "GetThreadCPUTimeError").GetLastError();
+		return threads;
+	}
+	while( struct dirent* entry = readdir(dir) ) {
+		if( entry->d_name[0] == '.' )
+			continue;
+
+		// A thread that has exited since readdir() leaves nothing to read
+		std::ifstream statFile( format("/proc/self/task/%s/stat", entry->d_name) );
+		std::string line;
+		if( !std::getline( statFile, line ) )
+			continue;
+
+		// The name is in parentheses and may contain spaces, so the fields are counted from the last ')'.  utime and
+		// stime are the 14th and 15th fields, and the ones after the name start at the 3rd.
+		size_t open = line.find('('), close = line.rfind(')');
+		if( open == std::string::npos || close == std::string::npos || close < open )
+			continue;
+		std::istringstream fields( line.substr(close + 1) );
+		std::string field;
+		uint64_t ticks = 0;
+		for(int f = 3; f <= 15 && fields >> field; f++)
+			if( f >= 14 )
+				ticks += strtoull( field.c_str(), NULL, 10 );
+
+		ThreadProcessorTime t;
+		t.id = strtoll( entry->d_name, NULL, 10 );
+		t.name = line.substr( open + 1, close - open - 1 );
+		t.seconds = ticks / ticksPerSecond;
+		t.current = t.id == current;
+		threads.push_back( t );
+	}
+	closedir(dir);
+#endif
+	return threads;
+}
+
 uint64_t getResidentMemoryUsage() {
 #if defined(__linux__)
 	uint64_t rssize = 0;
@@ -1558,6 +1611,69 @@ void setAffinity(int proc) {
 #endif
 }
 
+// Parses a Linux CPU or node list such as "0-7,16-23" into the numbers it names
+std::vector<int> parseCpuList( std::string const& list ) {
+	std::vector<int> result;
+	std::stringstream ss(list);
+	std::string range;
+	while (std::getline(ss, range, ',')) {
+		int first, last;
+		if (sscanf(range.c_str(), "%d-%d", &first, &last) == 2) {
+			for(int i = first; i <= last; i++)
+				result.push_back(i);
+		} else if (sscanf(range.c_str(), "%d", &first) == 1) {
+			result.push_back(first);
+		}
+	}
+	return result;
+}
+
+#ifdef __linux__
+#define FDB_MPOL_PREFERRED 1  // MPOL_PREFERRED in linux/mempolicy.h; set_mempolicy() itself is only declared by libnuma
+#endif
+
+bool setNumaNode(int node) {
+#if defined(__linux__)
+	const int maxNodes = 1024;
+	if (node < 0 || node >= maxNodes)
+		return false;
+
+	std::string cpuList;
+	try {
+		cpuList = readFileBytes( format("/sys/devices/system/node/node%d/cpulist", node), 1<<16 );
+	} catch (Error& e) {
+		TraceEvent(SevWarnAlways, "NumaNodeUnknown").error(e).detail("Node", node);
+		return false;
+	}
+
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	int cpus = 0;
+	for(int cpu : parseCpuList(cpuList)) {
+		if (cpu >= 0 && cpu < CPU_SETSIZE) {
+			CPU_SET(cpu, &set);
+			cpus++;
+		}
+	}
+	if (!cpus || sched_setaffinity(0, sizeof(cpu_set_t), &set)) {
+		TraceEvent(SevWarnAlways, "NumaNodeAffinityFailed").GetLastError().detail("Node", node).detail("CPUs", cpuList);
+		return false;
+	}
+
+	// Memory is preferred from the node rather than bound to it, so that a full node spills to the others instead of
+	// failing allocations
+	unsigned long nodeMask[maxNodes / (8*sizeof(unsigned long))] = {};
+	nodeMask[node / (8*sizeof(unsigned long))] = 1UL << (node % (8*sizeof(unsigned long)));
+	if (syscall(SYS_set_mempolicy, FDB_MPOL_PREFERRED, nodeMask, (unsigned long)maxNodes + 1)) {
+		TraceEvent(SevWarnAlways, "NumaNodeMemoryPolicyFailed").GetLastError().detail("Node", node);
+		return false;
+	}
+	return true;
+#else
+	return false;
+#endif
+}
+
 
 namespace platform {
 
@@ -2592,6 +2708,7 @@ void* checkThread(void *arg) {
 #ifdef __linux__
 	pthread_t mainThread = *(pthread_t*)arg;
 	free(arg);
+	setThreadName("SlowTaskCheck");
 
 	double lastValue = net2liveness;
 	double lastSignal = 0;
@@ -2647,6 +2764,14 @@ void setupSlowTaskProfiler() {
 
 // UnitTest for getMemoryInfo
 #ifdef __linux__
+TEST_CASE("flow/Platform/parseCpuList") {
+	ASSERT( parseCpuList("") == std::vector<int>() );
+	ASSERT( parseCpuList("3\n") == std::vector<int>({3}) );
+	ASSERT( parseCpuList("0-2,8,10-11\n") == std::vector<int>({0, 1, 2, 8, 10, 11}) );
+
+	return Void();
+}
+
 TEST_CASE("flow/Platform/getMemoryInfo") {
 
 	printf("UnitTest flow/Platform/getMemoryInfo 1\n");
@@ -245,6 +245,21 @@ double getProcessorTimeThread();
 
 double getProcessorTimeProcess();
 
+// Names the calling thread, as shown by top -H and in /proc, with at most the first 15 characters of name.  Does nothing
+// on platforms other than Linux.
+void setThreadName( std::string const& name );
+
+struct ThreadProcessorTime {
+	int64_t id;
+	std::string name;
+	double seconds;
+	bool current;  // The calling thread
+};
+
+// The CPU time used so far by each thread of this process, with the name each thread has.  Empty on platforms other
+// than Linux.
+std::vector<ThreadProcessorTime> getProcessorTimeThreads();
+
 uint64_t getMemoryUsage();
 
 uint64_t getResidentMemoryUsage();
@@ -278,6 +293,13 @@ void *allocate(size_t length, bool allowLargePages);
 
 void setAffinity(int proc);
 
+std::vector<int> parseCpuList( std::string const& list );
+
+// Runs the calling thread, and every thread it starts afterwards, on the CPUs of the given NUMA node, and prefers that
+// node for the memory they allocate.  Call it before any other threads are started.  Returns false if the node does
+// not exist or the platform cannot do this.
+bool setNumaNode(int node);
+
 void threadSleep( double seconds );
 
 void threadYield();  // Attempt to yield to other processes or threads
@@ -20,6 +20,7 @@
 
 #include "flow/flow.h"
 #include "flow/network.h"
+#include "flow/Profiler.h"
 
 
 #ifdef __linux__
@@ -134,6 +135,10 @@ struct Profiler {
 	~Profiler() {
 		enableSignal(false);
 		timer_delete(periodic_timer);
+		// Discard a signal of the deleted timer that is still pending, and unblock SIGPROF again for the sampling profiler
+		timespec noWait = { 0, 0 };
+		while (sigtimedwait(&profilingSignals, NULL, &noWait) == SIGPROF) {}
+		enableSignal(true);
 	}
 
 	void signal_handler() {  // async signal safe!
@@ -286,9 +291,125 @@ void stopProfiling() {
 	}
 }
 
+struct SamplingProfiler {
+	enum { SLOTS = 4096, MAX_PROBES = 16 };
+
+	// An open addressed hash table of counts by actor and task priority, which only the signal handler modifies.  A slot
+	// is unused while its count is 0.
+	struct Slot {
+		ActorFrameStats* actor;
+		int taskID;
+		int64_t samples;
+	};
+	Slot slots[SLOTS];
+	int64_t dropped;
+	int period;
+	SignalClosure signalClosure;
+	sigset_t profilingSignals;
+	INetwork* network;
+	timer_t periodic_timer;
+	static SamplingProfiler* active_profiler;
+
+	SamplingProfiler(int period, INetwork* network) : dropped(0), period(period), signalClosure(signal_handler_for_closure, this), network(network) {
+		memset( slots, 0, sizeof(slots) );
+		sigemptyset( &profilingSignals );
+		sigaddset( &profilingSignals, SIGPROF );
+
+		struct sigaction act;
+		act.sa_sigaction = SignalClosure::signal_handler;
+		sigemptyset(&act.sa_mask);
+		act.sa_flags = SA_SIGINFO;
+		sigaction( SIGPROF, &act, NULL );
+
+		int64_t period_ns = period * 1000LL;
+		itimerspec tv;
+		tv.it_interval.tv_sec = period_ns / 1000000000;
+		tv.it_interval.tv_nsec = period_ns % 1000000000;
+		tv.it_value.tv_sec = 0;
+		tv.it_value.tv_nsec = g_nondeterministic_random->randomInt(1, std::min<int64_t>(period_ns, 999999999)+1);
+
+		sigevent sev;
+		sev.sigev_notify = SIGEV_THREAD_ID;
+		sev.sigev_signo = SIGPROF;
+		sev.sigev_value.sival_ptr = &signalClosure;
+		sev._sigev_un._tid = gettid();
+		timer_create( CLOCK_THREAD_CPUTIME_ID, &sev, &periodic_timer );
+		timer_settime( periodic_timer, 0, &tv, NULL );
+	}
+
+	void signal_handler() {  // async signal safe!
+		ActorFrameStats* actor = g_runningActor;
+		int taskID = network->getCurrentTask();
+		uint32_t hash = uint32_t(uintptr_t(actor) >> 4) ^ (uint32_t(taskID) * 2654435761U);
+		for(int i = 0; i < MAX_PROBES; i++) {
+			Slot& s = slots[ (hash + i) & (SLOTS-1) ];
+			if (!s.samples) {
+				s.actor = actor;
+				s.taskID = taskID;
+				s.samples = 1;
+				return;
+			}
+			if (s.actor == actor && s.taskID == taskID) {
+				s.samples++;
+				return;
+			}
+		}
+		dropped++;
+	}
+
+	static void signal_handler_for_closure(int, siginfo_t* si, void*, void* self) {  // async signal safe!
+		((SamplingProfiler*)self)->signal_handler();
+	}
+
+	ProfileSamples getSamples() {
+		ProfileSamples result;
+		// The signal handler runs on this thread, so blocking it is enough to read the table consistently
+		sigprocmask( SIG_BLOCK, &profilingSignals, NULL );
+		for(auto const& s : slots) {
+			if (s.samples) {
+				ProfileSampleCount c;
+				c.actor = s.actor ? s.actor->name : NULL;
+				c.taskID = s.taskID;
+				c.samples = s.samples;
+				result.counts.push_back(c);
+			}
+		}
+		result.dropped = dropped;
+		sigprocmask( SIG_UNBLOCK, &profilingSignals, NULL );
+		result.periodMicroseconds = period;
+		return result;
+	}
+};
+
+SamplingProfiler* SamplingProfiler::active_profiler = 0;
+
+void startSamplingProfiler(INetwork* network, int periodMicroseconds) {
+	if (!SamplingProfiler::active_profiler && periodMicroseconds > 0) {
+		SamplingProfiler::active_profiler = new SamplingProfiler( periodMicroseconds, network );
+		TraceEvent("SamplingProfilerStarted").detail("PeriodMicroseconds", periodMicroseconds);
+	}
+}
+
+ProfileSamples getProfileSamples() {
+	if (SamplingProfiler::active_profiler)
+		return SamplingProfiler::active_profiler->getSamples();
+	ProfileSamples none;
+	none.dropped = 0;
+	none.periodMicroseconds = 0;
+	return none;
+}
+
 #else
 
 void startProfiling(INetwork* network, Optional<int> period, Optional<StringRef> outputFile) {}
 void stopProfiling() {}
 
+void startSamplingProfiler(INetwork* network, int periodMicroseconds) {}
+ProfileSamples getProfileSamples() {
+	ProfileSamples none;
+	none.dropped = 0;
+	none.periodMicroseconds = 0;
+	return none;
+}
+
 #endif
@@ -29,4 +29,25 @@ class INetwork;
 void startProfiling(INetwork* network, Optional<int> period = {}, Optional<StringRef> outputFile = {});
 void stopProfiling();
 
+// The always on sampling profiler counts its samples of the network thread in memory, by the actor class whose callback
+// was running (see g_runningActor) and by the priority of the task, instead of writing stacks to a file.  It shares
+// SIGPROF with the profiler above.
+struct ProfileSampleCount {
+	const char* actor;  // NULL if the sample was taken outside of any actor callback
+	int taskID;
+	int64_t samples;
+};
+
+struct ProfileSamples {
+	std::vector<ProfileSampleCount> counts;
+	int64_t dropped;  // Samples not counted because the table of counts was full
+	int periodMicroseconds;  // Of network thread CPU time, or 0 if the sampling profiler isn't running
+};
+
+// Starts taking a sample every periodMicroseconds of the CPU time of the calling thread, which must be the network thread
+void startSamplingProfiler(INetwork* network, int periodMicroseconds);
+
+// All of the samples taken since the sampling profiler started.  Must be called from the network thread.
+ProfileSamples getProfileSamples();
+
 #endif  // _FDB_FLOW_PROFILER_H_
@@ -0,0 +1,61 @@
+/*
+ * RunQueue.cpp
+ *
+ * This source file is part of the FoundationDB open source project
+ *
+ * Copyright 2013-2018 Apple Inc. and the FoundationDB project authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "UnitTest.h"
+#include "RunQueue.h"
+#include <map>
+
+TEST_CASE("flow/RunQueue/order") {
+	// Checks the queue against a map ordered by descending priority and then by the order of pushes, with more distinct
+	// priorities than fit in one word of the bitmap
+	RunQueue<int> q;
+	std::map<std::pair<int, int>, int> expected;
+	int pushed = 0;
+
+	for(int i = 0; i < 20000; i++) {
+		if (expected.empty() || g_random->random01() < 0.55) {
+			int priority = g_random->random01() < 0.5 ? g_random->randomInt(0, 8) * 1000 : g_random->randomInt(0, 1000000);
+			q.push( priority, pushed );
+			expected[ std::make_pair(-priority, pushed) ] = pushed;
+			pushed++;
+		} else {
+			auto next = expected.begin();
+			ASSERT( q.topPriority() == -next->first.first && q.front() == next->second );
+			ASSERT( !q.hasHigherPriority( -next->first.first ) && q.hasHigherPriority( -next->first.first - 1 ) );
+			q.pop();
+			expected.erase(next);
+		}
+		ASSERT( q.size() == expected.size() );
+	}
+
+	q.clear();
+	ASSERT( q.empty() && !q.hasHigherPriority(-1) );
+	q.push( 5, 1 );
+	q.push( 7, 2 );
+	q.push( 5, 3 );
+	ASSERT( q.front() == 2 );
+	q.pop();
+	ASSERT( q.front() == 1 );
+	q.pop();
+	ASSERT( q.front() == 3 );
+	q.pop();
+	ASSERT( q.empty() );
+	return Void();
+}
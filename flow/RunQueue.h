@@ -0,0 +1,153 @@
+/*
+ * RunQueue.h
+ *
+ * This source file is part of the FoundationDB open source project
+ *
+ * Copyright 2013-2018 Apple Inc. and the FoundationDB project authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FLOW_RUNQUEUE_H
+#define FLOW_RUNQUEUE_H
+#pragma once
+
+#include <vector>
+#include "Arena.h"
+#include "Deque.h"
+#ifdef _WIN32
+#include <intrin.h>
+#endif
+
+// A queue of ready tasks, from which the task with the highest priority is taken first and tasks of equal priority are
+// taken in the order in which they were pushed.  Each distinct priority gets its own FIFO bucket the first time it is
+// used.  The buckets are kept in ascending order of priority, and a bitmap of the non-empty ones gives the highest of
+// them, so push(), pop() and topPriority() take constant time.  Adding a bucket renumbers the others, but there are only
+// as many buckets as there are distinct priorities, and a bucket is kept once created.
+template <class T>
+class RunQueue : NonCopyable {
+public:
+	RunQueue() : count(0), topBucket(-1), indexShift(0) { rebuildIndex(); }
+
+	void push( int priority, T const& t ) {
+		int b = findBucket(priority);
+		if (b < 0)
+			b = addBucket(priority);
+		buckets[b].tasks.push_back(t);
+		nonEmpty[b>>6] |= uint64_t(1) << (b&63);
+		if (b > topBucket)
+			topBucket = b;
+		count++;
+	}
+
+	bool empty() const { return !count; }
+	size_t size() const { return count; }
+
+	// The priority and the first task of the highest priority bucket that has any.  The queue must not be empty.
+	int topPriority() const { return buckets[topBucket].priority; }
+	T const& front() const { return buckets[topBucket].tasks.front(); }
+
+	void pop() {
+		ASSERT( count );
+		Deque<T>& tasks = buckets[topBucket].tasks;
+		tasks.pop_front();
+		count--;
+		if (tasks.empty()) {
+			nonEmpty[topBucket>>6] &= ~(uint64_t(1) << (topBucket&63));
+			topBucket = highestNonEmpty( topBucket>>6 );
+		}
+	}
+
+	// True if a task with a priority higher than the given one is queued
+	bool hasHigherPriority( int priority ) const { return count && topPriority() > priority; }
+
+	void clear() {
+		for(auto& b : buckets)
+			b.tasks.clear();
+		for(auto& w : nonEmpty)
+			w = 0;
+		count = 0;
+		topBucket = -1;
+	}
+
+private:
+	struct Bucket {
+		int priority;
+		Deque<T> tasks;
+
+		explicit Bucket( int priority ) : priority(priority) {}
+	};
+
+	std::vector<Bucket> buckets;  // In ascending order of priority
+	std::vector<uint64_t> nonEmpty;  // Bit i is set if buckets[i] is not empty
+	std::vector<int> index;  // Open addressed hash table from priority to bucket, or -1 for an unused slot
+	size_t count;
+	int topBucket;  // The highest bucket that is not empty, or -1
+	int indexShift;  // index has 2^(32-indexShift) slots
+
+	static int highestBit( uint64_t x ) {
+#ifdef _WIN32
+		unsigned long i;
+		_BitScanReverse64(&i, x);
+		return i;
+#else
+		return 63 - __builtin_clzll(x);
+#endif
+	}
+
+	int highestNonEmpty( int word ) const {
+		for(; word >= 0; word--)
+			if (nonEmpty[word])
+				return (word<<6) + highestBit(nonEmpty[word]);
+		return -1;
+	}
+
+	int slotOf( int priority ) const { return ( uint32_t(priority) * 2654435761U ) >> indexShift; }
+
+	int findBucket( int priority ) const {
+		for(int s = slotOf(priority); ; s = (s+1) & (index.size()-1)) {
+			int b = index[s];
+			if (b < 0 || buckets[b].priority == priority)
+				return b;
+		}
+	}
+
+	int addBucket( int priority ) {
+		int b = 0;
+		while (b < buckets.size() && buckets[b].priority < priority)
+			b++;
+		buckets.insert( buckets.begin() + b, Bucket(priority) );
+		rebuildIndex();
+		return b;
+	}
+
+	// Recomputes everything that depends on the position of the buckets
+	void rebuildIndex() {
+		indexShift = 28;
+		while ((size_t(1) << (32-indexShift)) < 2*buckets.size())
+			indexShift--;
+		index.assign( size_t(1) << (32-indexShift), -1 );
+		nonEmpty.assign( buckets.size()/64 + 1, 0 );
+		for(int b = 0; b < buckets.size(); b++) {
+			int s = slotOf( buckets[b].priority );
+			while (index[s] >= 0)
+				s = (s+1) & (index.size()-1);
+			index[s] = b;
+			if (!buckets[b].tasks.empty())
+				nonEmpty[b>>6] |= uint64_t(1) << (b&63);
+		}
+		topBucket = highestNonEmpty( nonEmpty.size()-1 );
+	}
+};
+
+#endif
@@ -19,6 +19,7 @@
  */
 
 #include "Stats.h"
+#include "UnitTest.h"
 
 Counter::Counter(std::string const& name, CounterCollection& collection)
 : name(name), interval_start(0), last_event(0), interval_sq_time(0), interval_start_value(0), interval_delta(0)
@@ -68,28 +69,119 @@ void Counter::clear() {
 	metric = 0;
 }
 
+// Metric names may only contain letters, digits and underscores
+static std::string metricName(std::string const& prefix, std::string const& name) {
+	std::string s = prefix + "_" + name;
+	for (char& c : s)
+		if (!isalnum((unsigned char)c))
+			c = '_';
+	return s;
+}
+
+std::string countersText(std::string const& traceEventName, UID const& traceEventID, CounterCollection const& counters) {
+	std::string text;
+	std::string prefix = "fdb_" + traceEventName;
+	std::string id = traceEventID.toString();
+	for (ICounter* c : counters.counters)
+		text += format("%s{id=\"%s\"} %lld\n", metricName(prefix, c->getName()).c_str(), id.c_str(), (long long)c->getValue());
+	for (LatencySample* l : counters.latencies) {
+		std::string name = metricName(prefix, l->getName());
+		for (double q : { 0.5, 0.9, 0.99, 0.999 })
+			text += format("%s{id=\"%s\",quantile=\"%g\"} %g\n", name.c_str(), id.c_str(), q, l->histogram.percentile(q));
+		text += format("%s_sum{id=\"%s\"} %g\n", name.c_str(), id.c_str(), l->histogram.mean() * l->histogram.count());
+		text += format("%s_count{id=\"%s\"} %lld\n", name.c_str(), id.c_str(), (long long)l->histogram.count());
+	}
+	return text;
+}
+
+struct ExportedCounters {
+	std::string traceEventName;
+	UID traceEventID;
+	CounterCollection* counters;
+
+	ExportedCounters(std::string const& traceEventName, UID traceEventID, CounterCollection* counters) : traceEventName(traceEventName), traceEventID(traceEventID), counters(counters) {}
+};
+
+// The collections being logged by traceCounters(), by the address of the process logging them, since a simulated cluster
+// runs all of its processes in one
+static std::map<NetworkAddress, std::vector<ExportedCounters>>& exportedCounters() {
+	static std::map<NetworkAddress, std::vector<ExportedCounters>> exported;
+	return exported;
+}
+
+static void stopExporting(NetworkAddress address, CounterCollection* counters) {
+	auto& exported = exportedCounters()[address];
+	for (auto it = exported.begin(); it != exported.end(); ++it) {
+		if (it->counters == counters) {
+			exported.erase(it);
+			break;
+		}
+	}
+	if (exported.empty())
+		exportedCounters().erase(address);
+}
+
+std::string exportedCountersText() {
+	std::string text;
+	auto it = exportedCounters().find(g_network->getLocalAddress());
+	if (it != exportedCounters().end())
+		for (auto& e : it->second)
+			text += countersText(e.traceEventName, e.traceEventID, *e.counters);
+	return text;
+}
+
 ACTOR Future<Void> traceCounters(std::string traceEventName, UID traceEventID, double interval, CounterCollection* counters, std::string trackLatestName) {
 	Void _ = wait(delay(0)); // Give an opportunity for all members used in special counters to be initialized
 
 	for (ICounter* c : counters->counters)
 		c->resetInterval();
+	for (LatencySample* l : counters->latencies)
+		l->histogram.clear();
 
 	state double last_interval = now();
+	state NetworkAddress address = g_network->getLocalAddress();
+	exportedCounters()[address].push_back(ExportedCounters(traceEventName, traceEventID, counters));
 
-	loop{
-		TraceEvent te(traceEventName.c_str(), traceEventID);
-		te.detail("Elapsed", now() - last_interval);
-		for (ICounter* c : counters->counters) {
-			if (c->hasRate() && c->hasRoughness())
-				te.detailf(c->getName().c_str(), "%g %g %lld", c->getRate(), c->getRoughness(), (long long)c->getValue());
-			else
-				te.detail(c->getName().c_str(), c->getValue());
-			c->resetInterval();
-		}
-		if (!trackLatestName.empty())
-			te.trackLatest(trackLatestName.c_str());
+	try {
+		loop{
+			TraceEvent te(traceEventName.c_str(), traceEventID);
+			te.detail("Elapsed", now() - last_interval);
+			for (ICounter* c : counters->counters) {
+				if (c->hasRate() && c->hasRoughness())
+					te.detailf(c->getName().c_str(), "%g %g %lld", c->getRate(), c->getRoughness(), (long long)c->getValue());
+				else
+					te.detail(c->getName().c_str(), c->getValue());
+				c->resetInterval();
+			}
+			for (LatencySample* l : counters->latencies) {
+				te.detail(l->getName().c_str(), l->histogram.toString());
+				l->histogram.clear();
+			}
+			if (!trackLatestName.empty())
+				te.trackLatest(trackLatestName.c_str());
 
-		last_interval = now();
-		Void _ = wait(delay(interval));
+			last_interval = now();
+			Void _ = wait(delay(interval));
+		}
+	} catch (Error&) {
+		stopExporting(address, counters);
+		throw;
 	}
-}
\ No newline at end of file
+}
+
+TEST_CASE("flow/Stats/countersText") {
+	CounterCollection cc("Test");
+	Counter requests("Requests", cc);
+	LatencySample latency("Request-Latency", cc);
+	requests += 3;
+	latency.addMeasurement(0.001);
+	latency.addMeasurement(0.003);
+
+	UID id(1, 2);
+	std::string text = countersText("TestMetrics", id, cc);
+	std::string label = "{id=\"" + id.toString() + "\"";
+	ASSERT( text.find("fdb_TestMetrics_Requests" + label + "} 3\n") != std::string::npos );
+	ASSERT( text.find("fdb_TestMetrics_Request_Latency" + label + ",quantile=\"0.5\"} ") != std::string::npos );
+	ASSERT( text.find("fdb_TestMetrics_Request_Latency_count" + label + "} 2\n") != std::string::npos );
+	return Void();
+}
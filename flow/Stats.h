@@ -35,6 +35,7 @@ MyCounters() : foo("foo", cc), bar("bar", cc), baz("baz", cc) {}
 
 #include "flow.h"
 #include "TDMetric.actor.h"
+#include "Histogram.h"
 
 struct ICounter {
 	// All counters have a name and value
@@ -55,6 +56,7 @@ struct ICounter {
 struct CounterCollection {
 	CounterCollection(std::string name, std::string id = std::string()) : name(name), id(id) {}
 	std::vector<struct ICounter*> counters, counters_to_remove;
+	std::vector<struct LatencySample*> latencies;
 	~CounterCollection() { for (auto c : counters_to_remove) c->remove(); }
 	std::string name;
 	std::string id;
@@ -87,6 +89,20 @@ private:
 	Int64MetricHandle metric;
 };
 
+// The latencies of some kind of operation.  traceCounters() logs their count and percentiles, as formatted by
+// LatencyHistogram::toString(), for each interval.
+struct LatencySample {
+	LatencySample(std::string const& name, CounterCollection& collection) : name(name) { collection.latencies.push_back(this); }
+
+	void addMeasurement(double seconds, int64_t count = 1) { histogram.record(seconds, count); }
+
+	std::string const& getName() const { return name; }
+
+	LatencyHistogram histogram;  // The latencies recorded since the start of the interval
+private:
+	std::string name;
+};
+
 template <class F>
 struct SpecialCounter : ICounter, FastAllocated<SpecialCounter<F>> {
 	SpecialCounter(CounterCollection& collection, std::string const& name, F && f) : name(name), f(f) { collection.counters.push_back(this); collection.counters_to_remove.push_back(this); }
@@ -110,4 +126,12 @@ static void specialCounter(CounterCollection& collection, std::string const& nam
 
 Future<Void> traceCounters(std::string const& traceEventName, UID const& traceEventID, double const& interval, CounterCollection* const& counters, std::string const& trackLatestName = std::string());
 
+// The current values of the given counters in the Prometheus text exposition format, one line per value.  Each counter
+// is exported as fdb_<traceEventName>_<name>{id="<traceEventID>"} with its total, and each latency sample as a summary
+// of the latencies recorded in the current interval of traceCounters().
+std::string countersText(std::string const& traceEventName, UID const& traceEventID, CounterCollection const& counters);
+
+// countersText() of every CounterCollection that traceCounters() is logging in this process
+std::string exportedCountersText();
+
 #endif
\ No newline at end of file
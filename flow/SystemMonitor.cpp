@@ -38,7 +38,66 @@ void initializeSystemMonitorMachineState(SystemMonitorMachineState machineState)
 
 void systemMonitor() {
 	static StatisticsState statState = StatisticsState();
-	customSystemMonitor("ProcessMetrics", &statState, true );
+	SystemStatistics stats = customSystemMonitor("ProcessMetrics", &statState, true );
+	if (FLOW_KNOBS->ACTOR_FRAME_STATS_TOP > 0 && stats.initialized && !DEBUG_DETERMINISM)
+		traceActorFrameStats( FLOW_KNOBS->ACTOR_FRAME_STATS_TOP, stats.elapsed );
+}
+
+// The values of the Int64Metrics with the given name, by id
+static std::map<std::string, int64_t> getInt64MetricsById( StringRef name ) {
+	std::map<std::string, int64_t> values;
+	TDMetricCollection* collection = TDMetricCollection::getTDMetrics();
+	if( !collection )
+		return values;
+
+	MetricNameRef first( Int64Metric::metricType, name, StringRef() );
+	for(auto m = collection->metricMap.lower_bound( first ); m != collection->metricMap.end() && m->key.type == first.type && m->key.name == name; ++m)
+		values[ m->key.id.toString() ] = m->value.castTo<Int64Metric>()->getValue();
+	return values;
+}
+
+void ThreadRoleData::update( double networkSeconds, std::map<std::string, double>& roleSeconds ) {
+	roleSeconds.clear();
+
+	// The network thread is not renamed, so threads which have its name are the ones that were not named either
+	std::vector<ThreadProcessorTime> threads = getProcessorTimeThreads();
+	std::string unnamed;
+	for(auto& t : threads)
+		if( t.current )
+			unnamed = t.name;
+
+	std::map<int64_t, double> seconds;
+	for(auto& t : threads) {
+		seconds[t.id] = t.seconds;
+		if( t.current )
+			continue;
+		auto last = threadSeconds.find( t.id );
+		double elapsed = t.seconds - (last != threadSeconds.end() ? last->second : 0.0);
+		bool named = t.name != unnamed && std::all_of( t.name.begin(), t.name.end(), [](char c){ return isalnum((unsigned char)c); } );
+		roleSeconds[ named ? t.name : "Other" ] += std::max( 0.0, elapsed );
+	}
+	threadSeconds.swap( seconds );
+
+	std::map<std::string, int64_t> micros = getInt64MetricsById( LiteralStringRef("CoroThreadPool.BusyMicros") );
+	for(auto& c : micros) {
+		double elapsed = (c.second - coroutineMicros[c.first]) / 1e6;
+		roleSeconds[c.first] += elapsed;
+		networkSeconds -= elapsed;
+	}
+	coroutineMicros.swap( micros );
+
+	roleSeconds["Network"] = std::max( 0.0, networkSeconds );
+}
+
+std::map<std::string, FileIOData> FileIOData::get() {
+	std::map<std::string, FileIOData> files;
+	for(auto& m : getInt64MetricsById( LiteralStringRef("AsyncFile.CountFileLogicalReads") )) files[m.first].reads = m.second;
+	for(auto& m : getInt64MetricsById( LiteralStringRef("AsyncFile.CountFileLogicalWrites") )) files[m.first].writes = m.second;
+	for(auto& m : getInt64MetricsById( LiteralStringRef("AsyncFile.CountFileReadBytes") )) files[m.first].readBytes = m.second;
+	for(auto& m : getInt64MetricsById( LiteralStringRef("AsyncFile.CountFileWriteBytes") )) files[m.first].writeBytes = m.second;
+	for(auto& m : getInt64MetricsById( LiteralStringRef("AsyncFile.FileReadMicros") )) files[m.first].readMicros = m.second;
+	for(auto& m : getInt64MetricsById( LiteralStringRef("AsyncFile.FileWriteMicros") )) files[m.first].writeMicros = m.second;
+	return files;
 }
 
 #define TRACEALLOCATOR( size ) TraceEvent("MemSample").detail("Count", FastAllocator<size>::getMemoryUnused()/size).detail("TotalSize", FastAllocator<size>::getMemoryUnused()).detail("SampleCount", 1).detail("Hash", "FastAllocatedUnused" #size ).detail("Bt", "na")
@@ -50,8 +109,34 @@ SystemStatistics customSystemMonitor(std::string eventName, StatisticsState *sta
 														&statState->systemState);
 	NetworkData netData;
 	netData.init();
+	std::map<std::string, double> roleSeconds;
+	statState->threadRoleState.update( currentStats.mainThreadCPUSeconds, roleSeconds );
+	std::map<std::string, FileIOData> fileIO = FileIOData::get();
 	if (!DEBUG_DETERMINISM && currentStats.initialized) {
 		{
+			FileIOData totalIO;
+			for(auto& f : fileIO) {
+				FileIOData last = statState->fileIOState[f.first];
+				FileIOData d;
+				d.reads = f.second.reads - last.reads;
+				d.writes = f.second.writes - last.writes;
+				d.readBytes = f.second.readBytes - last.readBytes;
+				d.writeBytes = f.second.writeBytes - last.writeBytes;
+				d.readMicros = f.second.readMicros - last.readMicros;
+				d.writeMicros = f.second.writeMicros - last.writeMicros;
+				if( d.reads || d.writes ) {
+					TraceEvent("FileIOMetrics").detail("Filename", f.first).detail("Elapsed", currentStats.elapsed)
+						.detail("Reads", d.reads).detail("Writes", d.writes).detail("ReadBytes", d.readBytes).detail("WriteBytes", d.writeBytes)
+						.detail("ReadLatency", d.reads ? d.readMicros / 1e6 / d.reads : 0.0).detail("WriteLatency", d.writes ? d.writeMicros / 1e6 / d.writes : 0.0);
+				}
+				totalIO.reads += d.reads;
+				totalIO.writes += d.writes;
+				totalIO.readBytes += d.readBytes;
+				totalIO.writeBytes += d.writeBytes;
+				totalIO.readMicros += d.readMicros;
+				totalIO.writeMicros += d.writeMicros;
+			}
+
 			TraceEvent e(eventName.c_str());
 			e
 				.detail("Elapsed", currentStats.elapsed)
@@ -91,8 +176,19 @@ SystemStatistics customSystemMonitor(std::string eventName, StatisticsState *sta
 				.detail("ConnectionsEstablished", (double) (netData.countConnEstablished - statState->networkState.countConnEstablished) / currentStats.elapsed)
 				.detail("ConnectionsClosed", ((netData.countConnClosedWithError - statState->networkState.countConnClosedWithError) + (netData.countConnClosedWithoutError - statState->networkState.countConnClosedWithoutError)) / currentStats.elapsed)
 				.detail("ConnectionErrors", (netData.countConnClosedWithError - statState->networkState.countConnClosedWithError) / currentStats.elapsed)
+				.detail("FileReadBytes", totalIO.readBytes)
+				.detail("FileWriteBytes", totalIO.writeBytes)
+				.detail("FileReadLatency", totalIO.reads ? totalIO.readMicros / 1e6 / totalIO.reads : 0.0)
+				.detail("FileWriteLatency", totalIO.writes ? totalIO.writeMicros / 1e6 / totalIO.writes : 0.0)
 				.trackLatest(eventName.c_str());
 
+			std::string roles;
+			for(auto& r : roleSeconds) {
+				e.detail(("CPUSeconds" + r.first).c_str(), r.second);
+				roles += (roles.size() ? "," : "") + r.first;
+			}
+			e.detail("ThreadRoles", roles);
+
 			TraceEvent("MemoryMetrics")
 				.DETAILALLOCATORMEMUSAGE(16)
 				.DETAILALLOCATORMEMUSAGE(32)
@@ -102,7 +198,22 @@ SystemStatistics customSystemMonitor(std::string eventName, StatisticsState *sta
 				.DETAILALLOCATORMEMUSAGE(512)
 				.DETAILALLOCATORMEMUSAGE(1024)
 				.DETAILALLOCATORMEMUSAGE(2048)
-				.DETAILALLOCATORMEMUSAGE(4096);
+				.DETAILALLOCATORMEMUSAGE(4096)
+				.detail("TotalUnusedAllocatedMemory", getTotalUnusedAllocatedMemory())
+				.detail("TotalReclaimedMemory", getTotalReclaimedMemory());
+
+			TraceEvent a("ArenaLargeBlockMetrics");
+			int64_t largeBlockBytes = 0;
+			for (int c = 0; c < LargeBlockPool::CLASSES; c++) {
+				largeBlockBytes += LargeBlockPool::getLiveBytes(c);
+				if (!LargeBlockPool::getHighWaterBlocks(c)) continue;
+				int size = LargeBlockPool::getClassSize(c);
+				std::string name = size ? format("%d", size) : "Huge";
+				a.detail(("Live" + name).c_str(), LargeBlockPool::getLiveBlocks(c))
+					.detail(("HighWater" + name).c_str(), LargeBlockPool::getHighWaterBlocks(c))
+					.detail(("Cached" + name).c_str(), LargeBlockPool::getCachedBlocks(c));
+			}
+			a.detail("LiveBytes", largeBlockBytes);
 
 			TraceEvent n("NetworkMetrics");
 			n
@@ -115,6 +226,8 @@ SystemStatistics customSystemMonitor(std::string eventName, StatisticsState *sta
 				.detail("N2_YieldBigStack", netData.countYieldBigStack - statState->networkState.countYieldBigStack)
 				.detail("N2_RunLoopIterations", netData.countRunLoop - statState->networkState.countRunLoop)
 				.detail("N2_TimersExecuted", netData.countTimers - statState->networkState.countTimers)
+				.detail("N2_Timers", netData.timerCount)
+				.detail("N2_TimerWheelDepth", netData.timerWheelDepth)
 				.detail("N2_TasksExecuted", netData.countTasks - statState->networkState.countTasks)
 				.detail("N2_ASIOEventsProcessed", netData.countASIOEvents - statState->networkState.countASIOEvents)
 				.detail("N2_ReadCalls", netData.countReads - statState->networkState.countReads)
@@ -257,5 +370,6 @@ SystemStatistics customSystemMonitor(std::string eventName, StatisticsState *sta
 #endif
 	statState->networkMetricsState = g_network->networkMetrics;
 	statState->networkState = netData;
+	statState->fileIOState = fileIO;
 	return currentStats;
 }
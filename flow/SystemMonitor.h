@@ -22,6 +22,7 @@
 #define FLOW_SYSTEM_MONITOR_H
 #pragma once
 
+#include <map>
 #include "Platform.h"
 #include "TDMetric.actor.h"
 
@@ -55,6 +56,8 @@ struct NetworkData {
 	int64_t countCantSleep;
 	int64_t countWontSleep;
 	int64_t countTimers;
+	int64_t timerCount;
+	int64_t timerWheelDepth;
 	int64_t countTasks;
 	int64_t countYields;
 	int64_t countYieldBigStack;
@@ -99,6 +102,8 @@ struct NetworkData {
 		countCantSleep = getValue(LiteralStringRef("Net2.CountCantSleep"));
 		countWontSleep = getValue(LiteralStringRef("Net2.CountWontSleep"));
 		countTimers = getValue(LiteralStringRef("Net2.CountTimers"));
+		timerCount = getValue(LiteralStringRef("Net2.TimerCount"));
+		timerWheelDepth = getValue(LiteralStringRef("Net2.TimerWheelDepth"));
 		countTasks = getValue(LiteralStringRef("Net2.CountTasks"));
 		countYields = getValue(LiteralStringRef("Net2.CountYields"));
 		countYieldBigStack = getValue(LiteralStringRef("Net2.CountYieldBigStack"));
@@ -123,10 +128,32 @@ struct NetworkData {
 	}
 };
 
+// The CPU time of each role of this process's threads: named threads (see setThreadName()), the coroutine pools that
+// run on the network thread (CoroThreadPool.BusyMicros), the rest of the network thread ("Network") and threads
+// without a name ("Other"), which together add up to the process's CPU time
+struct ThreadRoleData {
+	std::map<int64_t, double> threadSeconds;  // By thread id
+	std::map<std::string, int64_t> coroutineMicros;  // By pool name
+
+	// Sets roleSeconds to the CPU time of each role since the last call, given that of the calling network thread
+	void update( double networkSeconds, std::map<std::string, double>& roleSeconds );
+};
+
+// The I/O of each file opened by AsyncFileKAIO or AsyncFileIOUring, from their AsyncFile.*File* metrics
+struct FileIOData {
+	int64_t reads, writes, readBytes, writeBytes, readMicros, writeMicros;
+
+	FileIOData() : reads(0), writes(0), readBytes(0), writeBytes(0), readMicros(0), writeMicros(0) {}
+
+	static std::map<std::string, FileIOData> get();  // By filename
+};
+
 struct StatisticsState {
 	SystemStatisticsState *systemState;
 	NetworkData networkState;
 	NetworkMetrics networkMetricsState;
+	ThreadRoleData threadRoleState;
+	std::map<std::string, FileIOData> fileIOState;
 
 	StatisticsState() : systemState(NULL) {}
 };
@@ -35,6 +35,7 @@
 #include "genericactors.actor.h"
 #include "CompressedInt.h"
 #include <algorithm>
+#include <cmath>
 #include <functional>
 
 struct MetricNameRef {
@@ -163,6 +164,7 @@ MAKE_TYPENAME(Standalone<StringRef>, "String")
 #undef MAKE_TYPENAME
 
 struct BaseMetric;
+struct IThreadMetric;
 
 // The collection of metrics that exist for a single process, at a single address.
 class TDMetricCollection {
@@ -201,6 +203,11 @@ public:
 
 	void checkRoll(uint64_t t, int64_t usedBytes);
 	bool canLog(int level);
+
+	// Metrics recorded on other threads (see ThreadMetric.h), which publish what they have recorded to metrics of this
+	// collection when publishThreadMetrics() is called before each flush
+	std::set<IThreadMetric*> threadMetrics;
+	void publishThreadMetrics();
 };
 
 struct MetricData {
@@ -423,6 +430,27 @@ struct FieldValueBlockEncoding<Standalone<StringRef>> {
 	Standalone<StringRef> prev;
 };
 
+// Encoder for event times, which are often logged at a steady rate: writes the change from the previous delta, so that
+// evenly spaced times take a byte or two each rather than the several bytes of a delta in nanoseconds
+struct TimestampBlockEncoding {
+	TimestampBlockEncoding() : prev(0), prevDelta(0) {}
+	inline void write(BinaryWriter &w, int64_t v) {
+		int64_t delta = v - prev;
+		w << CompressedInt<int64_t>(delta - prevDelta);
+		prev = v;
+		prevDelta = delta;
+	}
+	int64_t read(BinaryReader &r) {
+		CompressedInt<int64_t> v;
+		r >> v;
+		prevDelta += v.value;
+		prev += prevDelta;
+		return prev;
+	}
+	int64_t prev;
+	int64_t prevDelta;
+};
+
 
 // Field level for value type of T using header type of Header.  Default header type is the default FieldHeader implementation for type T.
 template <class T, class Header = FieldHeader<T>, class Encoder = FieldValueBlockEncoding<T>>
@@ -448,6 +476,9 @@ struct FieldLevel {
 	    previousHeader(f.previousHeader), lastTimeRequiringHeaderPatch(f.lastTimeRequiringHeaderPatch) {
 	}
 
+	// The field type that the level's blocks are registered and stored under
+	static StringRef typeName() { return metricTypeName<T>(); }
+
 	// update Header, use Encoder to write T v
 	void log( T v, uint64_t t, bool& overflow, int64_t& bytes ) {
 		int lastLength = metrics.back().writer.getLength();
@@ -607,6 +638,15 @@ struct FieldLevel {
 	}
 };
 
+// Field level for the time field of event metrics.  Its blocks are encoded differently from those of other Int64 fields,
+// so they are stored under a type of their own.
+struct TimeFieldLevel : FieldLevel<int64_t, FieldHeader<int64_t>, TimestampBlockEncoding> {
+	TimeFieldLevel() {}
+	TimeFieldLevel(TimeFieldLevel &&f) : FieldLevel(std::move(f)) {}
+
+	static StringRef typeName() { return LiteralStringRef("Int64DoD"); }
+};
+
 // A field Description to be used for continuous metrics, whose field name and type should never be accessed
 struct NullDescriptor {
 	static StringRef name() { return StringRef(); }
@@ -628,7 +668,7 @@ struct EventField : public Descriptor {
 	EventField(Descriptor d = Descriptor()) : Descriptor(d) {
 	}
 
-	static StringRef typeName() { return metricTypeName<T>(); }
+	static StringRef typeName() { return FieldLevelType::typeName(); }
 
 	void init() {
 		if(levels.size() != FLOW_KNOBS->MAX_METRIC_LEVEL) {
@@ -762,7 +802,7 @@ struct BaseEventMetric : BaseMetric {
 
 template <class E>
 struct EventMetric : E, ReferenceCounted<EventMetric<E>>, MetricUtil<EventMetric<E>>, BaseEventMetric {
-	EventField<int64_t, TimeDescriptor> time;
+	EventField<int64_t, TimeDescriptor, TimeFieldLevel> time;
 	bool latestRecorded;
 	decltype( tuple_map( MakeEventField(), typename Descriptor<E>::fields() ) ) values;
 
@@ -991,7 +1031,7 @@ private:
 // A DynamicEventMetric is an EventMetric whose field set can be modified at runtime.
 struct DynamicEventMetric : ReferenceCounted<DynamicEventMetric>, MetricUtil<DynamicEventMetric>, BaseEventMetric {
 private:
-	EventField<int64_t, TimeDescriptor> time;
+	EventField<int64_t, TimeDescriptor, TimeFieldLevel> time;
 	bool latestRecorded;
 
 	// TODO:  A Standalone key type isn't ideal because on lookups a ref will be made Standalone just for the search
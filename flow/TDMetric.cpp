@@ -20,6 +20,7 @@
 
 #include "TDMetric.actor.h"
 #include "flow.h"
+#include "UnitTest.h"
 
 const StringRef BaseEventMetric::metricType = LiteralStringRef("Event");
 template<> const StringRef Int64Metric::metricType = LiteralStringRef("Int64");
@@ -224,3 +225,26 @@ void DynamicEventMetric::registerFields(MetricKeyRef const &mk, std::vector<Stan
 std::string MetricData::toString() {
 	return format("MetricData(addr=%p start=%llu appendStart=%llu rollTime=%llu writerLen=%d)", this, start, appendStart, rollTime, writer.getLength());
 }
+
+TEST_CASE("flow/TDMetric/TimestampBlockEncoding") {
+	// Times about a second apart round trip, and take less space than with the delta encoding of other Int64 fields
+	BinaryWriter dod(AssumeVersion(currentProtocolVersion)), delta(AssumeVersion(currentProtocolVersion));
+	TimestampBlockEncoding dodEncoding;
+	FieldValueBlockEncoding<int64_t> deltaEncoding;
+	std::vector<int64_t> times;
+	int64_t t = timer_int();
+	for(int i = 0; i < 1000; i++) {
+		t += 1000000000 + g_random->randomInt(-10000, 10000);
+		times.push_back(t);
+		dodEncoding.write(dod, t);
+		deltaEncoding.write(delta, t);
+	}
+	ASSERT( dod.getLength() < delta.getLength() );
+
+	BinaryReader r(dod.toStringRef(), AssumeVersion(currentProtocolVersion));
+	TimestampBlockEncoding decoding;
+	for(int64_t v : times)
+		ASSERT( decoding.read(r) == v );
+	ASSERT( r.empty() );
+	return Void();
+}
@@ -29,6 +29,7 @@
 		#define FLOW_THREADHELPER_ACTOR_H
 
 #include "flow/flow.h"
+#include "flow/ThreadSafeQueue.h"
 
 // template <class F>
 // void onMainThreadVoid( F f ) {
@@ -44,6 +45,50 @@ void onMainThreadVoid( F f, Error* err, int taskID = TaskDefaultOnMainThread ) {
 	g_network->onMainThread( std::move(signal), taskID );
 }
 
+// A stream of values which may be sent from any thread and are received by actors on the network thread
+// of the given INetwork.  Sends are queued in a ThreadSafeQueue, so a burst of sends which arrives while
+// the receiving network thread is busy costs a single onMainThread() wakeup rather than one per value.
+// Must be created on the receiving network thread, and the last reference must be released there.
+template <class T>
+class ThreadSafePromiseStream : public ThreadSafeReferenceCounted<ThreadSafePromiseStream<T>>, NonCopyable {
+public:
+	explicit ThreadSafePromiseStream( INetwork* net = g_network, int taskID = TaskDefaultOnMainThread ) : net(net), taskID(taskID) {
+		queue.canSleep();  // So that the first send() wakes the receiver
+	}
+
+	// Network thread only
+	FutureStream<T> getFuture() { return stream.getFuture(); }
+
+	// Any thread
+	void send( T const& value ) {
+		if (queue.push( value )) {
+			this->addref();
+			Promise<Void> signal;
+			deliverOnSignal( signal.getFuture(), this );
+			net->onMainThread( std::move(signal), taskID );
+		}
+	}
+
+private:
+	INetwork* net;
+	int taskID;
+	ThreadSafeQueue<T> queue;
+	PromiseStream<T> stream;
+
+	void deliver() {
+		while (true) {
+			for(Optional<T> v = queue.pop(); v.present(); v = queue.pop())
+				stream.send( v.get() );
+			if (queue.canSleep())
+				break;
+		}
+	}
+
+	static void deliverOnSignal( Future<Void> signal, ThreadSafePromiseStream* self ) {
+		doOnMainThreadVoid( signal, [self](){ self->deliver(); self->delref(); }, NULL );
+	}
+};
+
 struct ThreadCallback {
 	virtual bool canFire(int notMadeActive) = 0;
 	virtual void fire(const Void &unused, int& userParam) = 0;
@@ -578,9 +623,14 @@ ACTOR template <class F> void doOnMainThreadVoid( Future<Void> signal, F f, Erro
 	}
 }
 
+// The result of onMainThread().  Unlike ThreadSingleAssignmentVar itself, which has subclasses of other sizes, it can be
+// fast allocated, so that handing a call to the network thread allocates only from the thread local free lists.
+template <class T>
+class MainThreadSingleAssignmentVar : public ThreadSingleAssignmentVar<T>, public FastAllocated<MainThreadSingleAssignmentVar<T>> {};
+
 template <class F> ThreadFuture< decltype(fake<F>()().getValue()) > onMainThread( F f ) {
 	Promise<Void> signal;
-	auto returnValue = new ThreadSingleAssignmentVar< decltype(fake<F>()().getValue()) >();
+	auto returnValue = new MainThreadSingleAssignmentVar< decltype(fake<F>()().getValue()) >();
 	returnValue->addref(); // For the ThreadFuture we return
 	Future<Void> cancelFuture = doOnMainThread<decltype(fake<F>()().getValue()), F>( signal.getFuture(), f, returnValue );
 	returnValue->setCancel( std::move(cancelFuture) );
@@ -0,0 +1,105 @@
+/*
+ * ThreadMetric.cpp
+ *
+ * This source file is part of the FoundationDB open source project
+ *
+ * Copyright 2013-2018 Apple Inc. and the FoundationDB project authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "ThreadMetric.h"
+#include "UnitTest.h"
+
+static std::atomic<int> nextThreadMetricSlot(0);
+
+int threadMetricSlot() {
+	static thread_local int slot = -1;
+	if (slot < 0)
+		slot = nextThreadMetricSlot.fetch_add(1) % THREAD_METRIC_SLOTS;
+	return slot;
+}
+
+IThreadMetric::IThreadMetric() : collection(TDMetricCollection::getTDMetrics()) {
+	if (collection)
+		collection->threadMetrics.insert(this);
+}
+
+IThreadMetric::~IThreadMetric() {
+	if (collection)
+		collection->threadMetrics.erase(this);
+}
+
+void TDMetricCollection::publishThreadMetrics() {
+	for(auto m : threadMetrics)
+		m->publish();
+}
+
+ThreadLatencyHistogram::ThreadLatencyHistogram( std::string const& name, StringRef const& id )
+  : name(name), id(id), count(StringRef(name + ".Count"), id), totalMicroseconds(StringRef(name + ".TotalMicroseconds"), id) {
+	for(auto& b : bucketBound)
+		b = false;
+}
+
+int64_t ThreadLatencyHistogram::getCount() const {
+	int64_t total = 0;
+	for(int b = 0; b < BUCKETS; b++)
+		total += getCount(b);
+	return total;
+}
+
+void ThreadLatencyHistogram::publish() {
+	int64_t total = 0;
+	for(int b = 0; b < BUCKETS; b++) {
+		int64_t n = getCount(b);
+		total += n;
+		if (!n)
+			continue;
+		if (!bucketBound[b]) {
+			std::string bucketName = b < BUCKETS-1 ? format("%s.LT%lldus", name.c_str(), 1LL << b) : format("%s.GE%lldus", name.c_str(), 1LL << (b-1));
+			buckets[b].init( StringRef(bucketName), id, 0 );
+			bucketBound[b] = true;
+		}
+		buckets[b] = n;
+	}
+	count = total;
+	totalMicroseconds = getTotalMicroseconds();
+}
+
+THREAD_FUNC threadMetricTestThread( void* arg ) {
+	auto h = (ThreadLatencyHistogram*)arg;
+	for(int i = 0; i < 100000; i++)
+		h->record( (i % 4) * 1e-3 );
+	THREAD_RETURN;
+}
+
+TEST_CASE("flow/ThreadMetric/histogram") {
+	ThreadLatencyHistogram h("ThreadMetricTest");
+	h.record( 0 );
+	h.record( 1e-6 );
+	h.record( 3e-6 );
+	h.record( 1e3 );
+	ASSERT( h.getCount(0) == 1 && h.getCount(1) == 1 && h.getCount(2) == 1 && h.getCount(ThreadLatencyHistogram::BUCKETS-1) == 1 );
+	ASSERT( h.getTotalMicroseconds() == 1000000004LL );
+
+	// Threads record into shards of their own, and nothing is lost when they are summed
+	std::vector<THREAD_HANDLE> threads;
+	for(int t = 0; t < 4; t++)
+		threads.push_back( startThread( threadMetricTestThread, &h ) );
+	for(auto t : threads)
+		waitThread(t);
+	ASSERT( h.getCount() == 4 + 400000 );
+	ASSERT( h.getCount(0) == 1 + 100000 && h.getCount(10) == 100000 && h.getCount(11) == 100000 && h.getCount(12) == 100000 );
+	return Void();
+}
@@ -0,0 +1,132 @@
+/*
+ * ThreadMetric.h
+ *
+ * This source file is part of the FoundationDB open source project
+ *
+ * Copyright 2013-2018 Apple Inc. and the FoundationDB project authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef FLOW_THREADMETRIC_H
+#define FLOW_THREADMETRIC_H
+#pragma once
+
+#include <atomic>
+#include "TDMetric.actor.h"
+
+// The slot of the calling thread among THREAD_METRIC_SLOTS, which is assigned the first time the thread asks for it.
+// Threads beyond the first THREAD_METRIC_SLOTS share slots, which is still correct but no longer free of contention.
+enum { THREAD_METRIC_SLOTS = 32 };
+int threadMetricSlot();
+
+// Per thread shards of a fixed number of int64_t counters, which any thread can add to without taking a lock.  Each
+// thread adds to the shard of its own slot with relaxed atomic operations, so threads that have slots of their own
+// never write to the same cache line, and a reader sums the shards.
+template <int Counters>
+class ThreadCounterShards : NonCopyable {
+public:
+	ThreadCounterShards() {
+		for(auto& s : shards)
+			for(auto& c : s.counters)
+				c.store( 0, std::memory_order_relaxed );
+	}
+
+	void add( int counter, int64_t delta ) {
+		shards[ threadMetricSlot() ].counters[counter].fetch_add( delta, std::memory_order_relaxed );
+	}
+
+	int64_t sum( int counter ) const {
+		int64_t total = 0;
+		for(auto& s : shards)
+			total += s.counters[counter].load( std::memory_order_relaxed );
+		return total;
+	}
+
+	enum { SLOTS = THREAD_METRIC_SLOTS };
+
+private:
+	struct Shard {
+		std::atomic<int64_t> counters[Counters];
+		char padding[ 64 - Counters*sizeof(int64_t) % 64 ];
+	};
+	Shard shards[SLOTS];
+};
+
+// A metric which is recorded on other threads and published as TDMetrics on the network thread.  It is created and
+// destroyed on the network thread, and the metric logger publishes it before each flush of the metrics.
+struct IThreadMetric : NonCopyable {
+	IThreadMetric();
+	virtual ~IThreadMetric();
+
+	virtual void publish() = 0;
+
+private:
+	TDMetricCollection* collection;
+};
+
+// A count that any thread can add to, published as an Int64Metric
+class ThreadInt64Metric : public IThreadMetric {
+public:
+	explicit ThreadInt64Metric( StringRef const& name, StringRef const& id = StringRef() ) : metric(name, id) {}
+
+	void add( int64_t delta ) { shards.add( 0, delta ); }
+	int64_t getValue() const { return shards.sum(0); }
+
+	virtual void publish() { metric = getValue(); }
+
+private:
+	ThreadCounterShards<1> shards;
+	Int64MetricHandle metric;
+};
+
+// A histogram of latencies that any thread can record, with buckets whose bounds are powers of two microseconds.  It is
+// published as Int64Metrics of the number and total microseconds of the latencies recorded, and of the number that fell
+// in each bucket, named <name>.LT<bound>us, or <name>.GE<bound>us for the last bucket.  A bucket's metric is created
+// the first time a latency falls in it.
+class ThreadLatencyHistogram : public IThreadMetric {
+public:
+	// Bucket b < BUCKETS-1 counts latencies of at least 2^(b-1) and less than 2^b microseconds, and the last bucket the
+	// rest, which is everything from about 2 seconds on
+	enum { BUCKETS = 23 };
+
+	explicit ThreadLatencyHistogram( std::string const& name, StringRef const& id = StringRef() );
+
+	void record( double seconds ) {
+		uint64_t us = seconds > 0 ? uint64_t(seconds * 1e6) : 0;
+		int b = 0;
+		while (b < BUCKETS-1 && us >= uint64_t(1) << b)
+			b++;
+		shards.add( b, 1 );
+		shards.add( TOTAL_MICROSECONDS, us );
+	}
+
+	int64_t getCount( int bucket ) const { return shards.sum(bucket); }
+	int64_t getCount() const;
+	int64_t getTotalMicroseconds() const { return shards.sum(TOTAL_MICROSECONDS); }
+
+	virtual void publish();
+
+private:
+	enum { TOTAL_MICROSECONDS = BUCKETS };
+
+	std::string name;
+	Standalone<StringRef> id;
+	ThreadCounterShards<BUCKETS+1> shards;
+	Int64MetricHandle count, totalMicroseconds;
+	Int64MetricHandle buckets[BUCKETS];
+	bool bucketBound[BUCKETS];
+};
+
+#endif
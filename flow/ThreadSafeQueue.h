@@ -27,6 +27,10 @@ THIS SOFTWARE IS PROVIDED BY DMITRY VYUKOV "AS IS" AND ANY EXPRESS OR IMPLIED WA
 
 The views and conclusions contained in the software and documentation are those of the authors and should not be interpreted as representing official policies, either expressed or implied, of Dmitry Vyukov.*/
 
+#ifndef FLOW_THREADSAFEQUEUE_H
+#define FLOW_THREADSAFEQUEUE_H
+#pragma once
+
 template <class T>
 class ThreadSafeQueue : NonCopyable {
 	struct BaseNode {
@@ -93,7 +97,6 @@ public:
 	// If push() returns true, the consumer may be sleeping and should be woken
 	bool push( T const& data ) {
 		Node* n = new Node(data);
-		n->data = data;
 		return pushNode( n ) == &sleeping;
 	}
 
@@ -121,4 +124,6 @@ public:
 		delete n;
 		return Optional<T>( std::move(data) );
 	}
-};
\ No newline at end of file
+};
+
+#endif
@@ -0,0 +1,200 @@
+/*
+ * TimerWheel.cpp
+ *
+ * This source file is part of the FoundationDB open source project
+ *
+ * Copyright 2013-2018 Apple Inc. and the FoundationDB project authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "TimerWheel.h"
+#include "UnitTest.h"
+#include <map>
+
+TimerWheel::TimerWheel( double now ) : count(0), currentTick(tickOf(now)) {
+	for(int i = 0; i < LEVEL0_SLOTS; i++)
+		initSlot( &level0[i] );
+	for(int l = 0; l < LEVELS-1; l++)
+		for(int i = 0; i < LEVEL_SLOTS; i++)
+			initSlot( &levels[l][i] );
+	for(int l = 0; l < LEVELS; l++)
+		levelCount[l] = 0;
+}
+
+void TimerWheel::link( TimerWheelNode* slot, TimerWheelEntry* e, int level ) {
+	e->prev = slot->prev;
+	e->next = slot;
+	slot->prev->next = e;
+	slot->prev = e;
+	e->level = level;
+	levelCount[level]++;
+	count++;
+}
+
+void TimerWheel::unlink( TimerWheelEntry* e ) {
+	e->prev->next = e->next;
+	e->next->prev = e->prev;
+	e->prev = e->next = NULL;
+	levelCount[e->level]--;
+	count--;
+	e->level = -1;
+}
+
+void TimerWheel::insert( TimerWheelEntry* e ) {
+	ASSERT( !e->isLinked() );
+	int64_t tick = tickOf(e->at);
+	int64_t delta = tick - currentTick;
+	if (delta < LEVEL0_SLOTS) {
+		// An entry that is already due goes in the current slot, which is expired first
+		link( &level0[ (delta < 0 ? currentTick : tick) & (LEVEL0_SLOTS-1) ], e, 0 );
+		return;
+	}
+
+	const int64_t maxDelta = int64_t(1) << (LEVEL0_BITS + (LEVELS-1)*LEVEL_BITS);
+	if (delta >= maxDelta)
+		tick = currentTick + maxDelta - 1;
+
+	int level = 1;
+	while (level < LEVELS-1 && delta >= int64_t(1) << (LEVEL0_BITS + level*LEVEL_BITS))
+		level++;
+	int shift = LEVEL0_BITS + (level-1)*LEVEL_BITS;
+	link( &levels[level-1][ (tick >> shift) & (LEVEL_SLOTS-1) ], e, level );
+}
+
+void TimerWheel::remove( TimerWheelEntry* e ) {
+	ASSERT( e->isLinked() );
+	unlink(e);
+}
+
+void TimerWheel::cascade( int level, int index ) {
+	TimerWheelNode* slot = &levels[level-1][index];
+	if (slotEmpty(slot))
+		return;
+
+	// Detach the list first, since an entry can be relinked into this same slot
+	TimerWheelNode* n = slot->next;
+	slot->prev->next = NULL;
+	initSlot(slot);
+	while (n) {
+		TimerWheelEntry* e = static_cast<TimerWheelEntry*>(n);
+		n = n->next;
+		levelCount[e->level]--;
+		count--;
+		e->level = -1;
+		insert(e);
+	}
+}
+
+int64_t TimerWheel::nextCascadeTick() const {
+	// Slots of the lowest level in use start at a multiple of its span, where those of every lower level start as well,
+	// and so the lower levels, which are empty, can be skipped over
+	int level = 1;
+	while (level < LEVELS-1 && !levelCount[level])
+		level++;
+	int64_t span = int64_t(1) << (LEVEL0_BITS + (level-1)*LEVEL_BITS);
+	return (currentTick | (span-1)) + 1;
+}
+
+double TimerWheel::nextExpiration() const {
+	if (!count)
+		return 1e99;
+
+	double next = 1e99;
+	if (levelCount[0]) {
+		// Each slot of the first level holds the entries of a single tick, so the earliest expiration is in the first
+		// slot that has any entries
+		for(int i = 0; i < LEVEL0_SLOTS; i++) {
+			TimerWheelNode const* slot = &level0[ (currentTick + i) & (LEVEL0_SLOTS-1) ];
+			if (!slotEmpty(slot)) {
+				for(TimerWheelNode const* n = slot->next; n != slot; n = n->next)
+					next = std::min( next, static_cast<TimerWheelEntry const*>(n)->at );
+				break;
+			}
+		}
+	}
+	if (count > levelCount[0]) {
+		// Entries of the higher levels expire no earlier than the next time they are moved down
+		next = std::min( next, double(nextCascadeTick()) / TICKS_PER_SECOND );
+	}
+	return next;
+}
+
+void TimerWheel::clear() {
+	auto clearSlot = [this]( TimerWheelNode* slot ) {
+		while (!slotEmpty(slot))
+			unlink( static_cast<TimerWheelEntry*>(slot->next) );
+	};
+	for(int i = 0; i < LEVEL0_SLOTS; i++)
+		clearSlot( &level0[i] );
+	for(int l = 0; l < LEVELS-1; l++)
+		for(int i = 0; i < LEVEL_SLOTS; i++)
+			clearSlot( &levels[l][i] );
+}
+
+int TimerWheel::depth() const {
+	for(int l = LEVELS-1; l >= 0; l--)
+		if (levelCount[l])
+			return l+1;
+	return 0;
+}
+
+TEST_CASE("flow/TimerWheel/order") {
+	// Checks the wheel against a multimap of expiration times, with delays from under a tick to beyond the highest level
+	double now = 1000.0;
+	TimerWheel wheel(now);
+	std::vector<TimerWheelEntry> entries(2000);
+	std::multimap<double, TimerWheelEntry*> expected;
+
+	for(auto& e : entries) {
+		double r = g_random->random01();
+		double delay = r < 0.5 ? r * 0.5 : r < 0.9 ? r * 100 : r < 0.99 ? r * 1e5 : r * 1e8;
+		e.at = now + delay;
+		wheel.insert(&e);
+		expected.insert( std::make_pair(e.at, &e) );
+	}
+	ASSERT( wheel.size() == entries.size() && wheel.depth() == TimerWheel::LEVELS );
+
+	// Remove some entries before they expire
+	for(int i = 0; i < entries.size(); i += 7) {
+		wheel.remove(&entries[i]);
+		auto range = expected.equal_range(entries[i].at);
+		for(auto it = range.first; it != range.second; ++it)
+			if (it->second == &entries[i]) {
+				expected.erase(it);
+				break;
+			}
+	}
+	ASSERT( wheel.size() == expected.size() );
+
+	while (!expected.empty()) {
+		double next = wheel.nextExpiration();
+		ASSERT( next <= expected.begin()->first + 1e-9 );
+
+		// Advance either to the time nextExpiration() suggests or just past the earliest expiration
+		now = std::max( now, g_random->random01() < 0.5 ? next : expected.begin()->first ) + (g_random->random01() < 0.5 ? 1e-4 : g_random->random01());
+		int expired = 0;
+		wheel.expire( now, [&]( TimerWheelEntry* e ) {
+			ASSERT( e->at < now && !e->isLinked() );
+			expired++;
+		} );
+		while (!expected.empty() && expected.begin()->first < now) {
+			ASSERT( !expected.begin()->second->isLinked() );
+			expected.erase(expected.begin());
+			expired--;
+		}
+		ASSERT( expired == 0 && wheel.size() == expected.size() );
+	}
+	ASSERT( wheel.empty() && wheel.depth() == 0 && wheel.nextExpiration() == 1e99 );
+	return Void();
+}
@@ -0,0 +1,137 @@
+/*
+ * TimerWheel.h
+ *
+ * This source file is part of the FoundationDB open source project
+ *
+ * Copyright 2013-2018 Apple Inc. and the FoundationDB project authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FLOW_TIMERWHEEL_H
+#define FLOW_TIMERWHEEL_H
+#pragma once
+
+#include <algorithm>
+#include "Platform.h"
+#include "Arena.h"
+
+// An element of a TimerWheel.  The wheel links entries into its slots in place, so inserting and removing one allocates
+// nothing and an entry can be removed in constant time from wherever it is.
+struct TimerWheelNode {
+	TimerWheelNode *prev, *next;
+};
+
+struct TimerWheelEntry : TimerWheelNode {
+	double at;  // The time at which the entry expires
+	int level;  // The level of the wheel holding the entry, or -1 if it is not in a wheel
+
+	TimerWheelEntry() : at(0), level(-1) { prev = next = NULL; }
+	bool isLinked() const { return level >= 0; }
+};
+
+// A hierarchical timing wheel of entries ordered by expiration time.  Time is divided into ticks of 1/TICKS_PER_SECOND
+// seconds.  The first level has a slot for each of the next LEVEL0_SLOTS ticks, and each further level has LEVEL_SLOTS
+// slots, each spanning as many ticks as the whole level below it.  An entry is kept in the lowest level whose range
+// covers it; when the current tick reaches the start of a slot of a higher level, its entries are moved down.
+// Entries more than 2^32 ticks away are kept in the last slot of the highest level and moved down again later.
+//
+// insert() and remove() take constant time, and advancing the wheel costs a constant per tick plus the work of moving
+// each entry down at most once per level.
+class TimerWheel : NonCopyable {
+public:
+	enum { TICKS_PER_SECOND = 1000, LEVEL0_BITS = 8, LEVEL_BITS = 6, LEVELS = 5 };
+	enum { LEVEL0_SLOTS = 1<<LEVEL0_BITS, LEVEL_SLOTS = 1<<LEVEL_BITS };
+
+	explicit TimerWheel( double now );
+	~TimerWheel() { clear(); }
+
+	void insert( TimerWheelEntry* e );
+	void remove( TimerWheelEntry* e );
+
+	// Removes every entry with at < now and calls f on it.  f must not modify the wheel.
+	template <class F>
+	void expire( double now, F const& f );
+
+	// Returns a time no later than the expiration of any entry, at which expire() should next be called, or 1e99 if the
+	// wheel is empty.  It is the earliest expiration if that is within the current span of the first level.
+	double nextExpiration() const;
+
+	// Unlinks every entry without calling anything on it
+	void clear();
+
+	int size() const { return count; }
+	bool empty() const { return !count; }
+	int depth() const;  // The number of levels up to and including the highest one holding an entry
+
+private:
+	TimerWheelNode level0[LEVEL0_SLOTS];
+	TimerWheelNode levels[LEVELS-1][LEVEL_SLOTS];
+	int levelCount[LEVELS];
+	int count;
+	int64_t currentTick;  // Every entry whose tick is earlier than this has been expired
+
+	static int64_t tickOf( double at ) { return int64_t(at * TICKS_PER_SECOND); }
+	static void initSlot( TimerWheelNode* slot ) { slot->prev = slot->next = slot; }
+	static bool slotEmpty( TimerWheelNode const* slot ) { return slot->next == slot; }
+	void link( TimerWheelNode* slot, TimerWheelEntry* e, int level );
+	void unlink( TimerWheelEntry* e );
+	void cascade( int level, int index );  // Moves the entries of levels[level-1][index] to where they now belong
+	int64_t nextCascadeTick() const;  // The next tick at which entries of the higher levels move down
+
+	template <class F>
+	void expireSlot( TimerWheelNode* slot, double now, bool all, F const& f );
+};
+
+template <class F>
+void TimerWheel::expireSlot( TimerWheelNode* slot, double now, bool all, F const& f ) {
+	TimerWheelNode* n = slot->next;
+	while (n != slot) {
+		TimerWheelEntry* e = static_cast<TimerWheelEntry*>(n);
+		n = n->next;
+		if (all || e->at < now) {
+			unlink(e);
+			f(e);
+		}
+	}
+}
+
+template <class F>
+void TimerWheel::expire( double now, F const& f ) {
+	int64_t nowTick = tickOf(now);
+	while (currentTick < nowTick) {
+		if (!count) {
+			currentTick = nowTick;
+			break;
+		}
+		if (levelCount[0]) {
+			// Every entry of the current slot has a tick before nowTick and so expired before now
+			expireSlot( &level0[currentTick & (LEVEL0_SLOTS-1)], now, true, f );
+			++currentTick;
+		} else {
+			// Skip ahead to the next tick at which entries move down
+			currentTick = std::min( nowTick, nextCascadeTick() );
+		}
+		if (!(currentTick & (LEVEL0_SLOTS-1))) {
+			for(int level = 1; level < LEVELS; level++) {
+				int index = (currentTick >> (LEVEL0_BITS + (level-1)*LEVEL_BITS)) & (LEVEL_SLOTS-1);
+				cascade( level, index );
+				if (index) break;
+			}
+		}
+	}
+	// Entries in the slot of nowTick may expire after now
+	expireSlot( &level0[currentTick & (LEVEL0_SLOTS-1)], now, false, f );
+}
+
+#endif
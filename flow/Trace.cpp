@@ -37,6 +37,7 @@
 #include "EventTypes.actor.h"
 #include "TDMetric.actor.h"
 #include "MetricSample.h"
+#include "UnitTest.h"
 
 #include <fcntl.h>
 #if defined(__unixish__)
@@ -135,6 +136,280 @@ SuppressionMap suppressedEvents;
 static TransientThresholdMetricSample<Standalone<StringRef>> *traceEventThrottlerCache;
 static const char *TRACE_EVENT_THROTTLE_STARTING_TYPE = "TraceEventThrottle_";
 
+static ITraceBlockCodec* traceBlockCodec = NULL;
+
+void setTraceBlockCodec( ITraceBlockCodec* codec ) {
+	traceBlockCodec = codec;
+}
+
+// A binary trace file starts with BINARY_TRACE_MAGIC, followed by blocks of records.  Each block is a
+// BinaryTraceBlockHeader followed by storedLength bytes, which are the rawLength bytes of its records compressed by the
+// trace block codec if compressed is set.  A record is a varint count of fields followed by the key and value string of
+// each, or a count of zero followed by a string to copy to the XML as it is.  A string is a varint v, followed by v>>1
+// bytes if v is even; if v&3 == 1 it is the interned string numbered v>>2, and if v&3 == 3 it is the v>>2 bytes that
+// follow, which become the next interned string.  Each file interns strings anew, numbering them from 0.
+static const char BINARY_TRACE_MAGIC[8] = { 'F', 'D', 'B', 'T', 'R', 'C', '0', '1' };
+
+struct BinaryTraceBlockHeader {
+	uint32_t rawLength;
+	uint32_t storedLength;
+	uint32_t compressed;
+	uint32_t checksum;  // hashlittle() of the stored bytes
+};
+
+// Turns the XML text of trace events into the records of a binary trace file.  Field names, and the values of the few
+// fields that take only a handful of values, are interned.
+class BinaryTraceEncoder {
+public:
+	BinaryTraceEncoder() {}
+
+	void reset() { interned.clear(); }
+
+	void encode( StringRef xml, std::string& out ) {
+		fields.clear();
+		if (!parseEvent(xml)) {
+			writeVarint( out, 0 );
+			writeString( out, xml.toString(), false );
+			return;
+		}
+		writeVarint( out, fields.size() );
+		for(auto& f : fields) {
+			writeString( out, f.first, true );
+			writeString( out, f.second, internValueOf(f.first) );
+		}
+	}
+
+private:
+	enum { MAX_INTERNED = 1<<16 };
+	std::map<std::string, int> interned;
+	std::vector<std::pair<std::string, std::string>> fields;
+
+	static bool internValueOf( std::string const& key ) {
+		return key == "Severity" || key == "Type" || key == "Machine" || key == "logGroup" || key == "Roles" || key == "TrackLatestType";
+	}
+
+	static void writeVarint( std::string& out, uint64_t v ) {
+		while (v >= 0x80) {
+			out.push_back( char(v | 0x80) );
+			v >>= 7;
+		}
+		out.push_back( char(v) );
+	}
+
+	void writeString( std::string& out, std::string const& s, bool intern ) {
+		if (intern) {
+			auto it = interned.find(s);
+			if (it != interned.end()) {
+				writeVarint( out, (uint64_t(it->second) << 2) | 1 );
+				return;
+			}
+			if (interned.size() < MAX_INTERNED) {
+				int id = interned.size();
+				interned[s] = id;
+				writeVarint( out, (uint64_t(s.size()) << 2) | 3 );
+				out.append(s);
+				return;
+			}
+		}
+		writeVarint( out, uint64_t(s.size()) << 1 );
+		out.append(s);
+	}
+
+	// Parses <Event Key="Value" .../>, as written by TraceEvent and TraceBatch, into fields with unescaped values
+	bool parseEvent( StringRef xml ) {
+		const char* p = (const char*)xml.begin();
+		const char* end = (const char*)xml.end();
+		static const char prefix[] = "<Event";
+		if (xml.size() < sizeof(prefix)-1 || memcmp(p, prefix, sizeof(prefix)-1))
+			return false;
+		p += sizeof(prefix)-1;
+		while (true) {
+			while (p < end && *p == ' ') p++;
+			if (end - p >= 2 && p[0] == '/' && p[1] == '>') {
+				p += 2;
+				return end - p == 2 && p[0] == '\r' && p[1] == '\n';
+			}
+			const char* key = p;
+			while (p < end && *p != '=' && *p != ' ' && *p != '"') p++;
+			if (p == key || end - p < 2 || p[0] != '=' || p[1] != '"')
+				return false;
+			std::string k( key, p );
+			p += 2;
+			std::string v;
+			while (p < end && *p != '"') {
+				if (*p == '&') {
+					const char* e = (const char*)memchr( p, ';', end - p );
+					if (!e) return false;
+					StringRef entity( (const uint8_t*)p, e + 1 - p );
+					if (entity == LiteralStringRef("&amp;")) v.push_back('&');
+					else if (entity == LiteralStringRef("&quot;")) v.push_back('"');
+					else if (entity == LiteralStringRef("&lt;")) v.push_back('<');
+					else if (entity == LiteralStringRef("&gt;")) v.push_back('>');
+					else return false;
+					p = e + 1;
+				} else {
+					v.push_back(*p++);
+				}
+			}
+			if (p == end)
+				return false;
+			p++;
+			fields.push_back( std::make_pair(std::move(k), std::move(v)) );
+		}
+	}
+};
+
+static void appendBinaryTraceBlock( std::string& out, std::string const& records, ITraceBlockCodec* codec ) {
+	BinaryTraceBlockHeader h;
+	std::string compressed;
+	h.compressed = codec && codec->compress( (const uint8_t*)records.data(), records.size(), compressed );
+	std::string const& stored = h.compressed ? compressed : records;
+	h.rawLength = records.size();
+	h.storedLength = stored.size();
+	h.checksum = hashlittle( stored.data(), stored.size(), 0 );
+	out.append( (const char*)&h, sizeof(h) );
+	out.append( stored );
+}
+
+static void appendEscaped( std::string& out, std::string const& s ) {
+	for(char c : s) {
+		if (c == '&') out.append("&amp;");
+		else if (c == '"') out.append("&quot;");
+		else if (c == '<') out.append("&lt;");
+		else if (c == '>') out.append("&gt;");
+		else out.push_back(c);
+	}
+}
+
+struct BinaryTraceReader {
+	const uint8_t* p;
+	const uint8_t* end;
+
+	BinaryTraceReader( const uint8_t* p, const uint8_t* end ) : p(p), end(end) {}
+
+	uint64_t readVarint() {
+		uint64_t v = 0;
+		for(int shift = 0; ; shift += 7) {
+			if (p == end || shift > 63) throw file_corrupt();
+			uint8_t b = *p++;
+			v |= uint64_t(b & 0x7f) << shift;
+			if (!(b & 0x80)) return v;
+		}
+	}
+
+	std::string readBytes( uint64_t n ) {
+		if (n > end - p) throw file_corrupt();
+		std::string s( (const char*)p, n );
+		p += n;
+		return s;
+	}
+
+	std::string readString( std::vector<std::string>& interned ) {
+		uint64_t v = readVarint();
+		if (!(v & 1))
+			return readBytes( v >> 1 );
+		if (!(v & 2)) {
+			if ((v >> 2) >= interned.size()) throw file_corrupt();
+			return interned[v >> 2];
+		}
+		interned.push_back( readBytes( v >> 2 ) );
+		return interned.back();
+	}
+};
+
+std::string binaryTraceToXml( std::string const& contents ) {
+	const uint8_t* p = (const uint8_t*)contents.data();
+	const uint8_t* end = p + contents.size();
+	if (contents.size() < sizeof(BINARY_TRACE_MAGIC) || memcmp(p, BINARY_TRACE_MAGIC, sizeof(BINARY_TRACE_MAGIC)))
+		throw file_corrupt();
+	p += sizeof(BINARY_TRACE_MAGIC);
+
+	std::string xml = "<?xml version=\"1.0\"?>\r\n<Trace>\r\n";
+	std::vector<std::string> interned;
+	bool closed = false;
+	while (end - p >= sizeof(BinaryTraceBlockHeader)) {
+		BinaryTraceBlockHeader h;
+		memcpy( &h, p, sizeof(h) );
+		if (h.storedLength > end - p - sizeof(h))
+			break;
+		p += sizeof(h);
+		if (hashlittle( p, h.storedLength, 0 ) != h.checksum)
+			throw file_corrupt();
+
+		std::string decompressed;
+		const uint8_t* block = p;
+		if (h.compressed) {
+			if (!traceBlockCodec) throw file_corrupt();
+			decompressed = traceBlockCodec->decompress( p, h.storedLength, h.rawLength );
+			block = (const uint8_t*)decompressed.data();
+		} else if (h.rawLength != h.storedLength) {
+			throw file_corrupt();
+		}
+		p += h.storedLength;
+
+		BinaryTraceReader r( block, block + h.rawLength );
+		while (r.p != r.end) {
+			uint64_t fieldCount = r.readVarint();
+			if (!fieldCount) {
+				std::string raw = r.readString(interned);
+				closed = closed || raw.find("</Trace>") != raw.npos;
+				xml.append(raw);
+				continue;
+			}
+			xml.append("<Event");
+			for(uint64_t f = 0; f < fieldCount; f++) {
+				xml.push_back(' ');
+				xml.append( r.readString(interned) );
+				xml.append("=\"");
+				appendEscaped( xml, r.readString(interned) );
+				xml.push_back('"');
+			}
+			xml.append("/>\r\n");
+		}
+	}
+	if (!closed)
+		xml.append("</Trace>\r\n");
+	return xml;
+}
+
+TEST_CASE("flow/Trace/binary format") {
+	std::vector<std::string> events;
+	events.push_back( "<Event Severity=\"10\" Time=\"1.500000\" Type=\"A\" Machine=\"1.2.3.4:1\" Detail=\"&lt;&amp;&quot;&gt;\" logGroup=\"default\"/>\r\n" );
+	events.push_back( "<Event Severity=\"10\" Time=\"2.000000\" Type=\"A\" Machine=\"1.2.3.4:1\" Detail=\"\" logGroup=\"default\"/>\r\n" );
+	events.push_back( "<Event Severity=\"20\" Time=\"2.500000\" Type=\"B\" Machine=\"1.2.3.4:1\" Other=\"x y\" logGroup=\"default\"/>\r\n" );
+	events.push_back( "<Event Broken=\"&unknown;\"/>\r\n" );  // Not parsed, and so kept as it is
+	events.push_back( "</Trace>\r\n" );
+
+	BinaryTraceEncoder encoder;
+	std::string contents( BINARY_TRACE_MAGIC, sizeof(BINARY_TRACE_MAGIC) );
+	std::string expected = "<?xml version=\"1.0\"?>\r\n<Trace>\r\n";
+	for(int b = 0; b < 2; b++) {
+		std::string records;
+		for(auto& e : events) {
+			if (b == 0 && e == "</Trace>\r\n") continue;
+			encoder.encode( StringRef(e), records );
+			expected.append(e);
+		}
+		appendBinaryTraceBlock( contents, records, NULL );
+	}
+	ASSERT( binaryTraceToXml(contents) == expected );
+
+	// A block cut short is ignored, and the missing end of the trace is added back
+	int complete = contents.size();
+	std::string records;
+	encoder.encode( StringRef(events[0]), records );
+	appendBinaryTraceBlock( contents, records, NULL );
+	contents.resize( contents.size() - 1 );
+	ASSERT( binaryTraceToXml(contents) == expected );
+	contents.resize( complete - 2 );
+	std::string truncated = binaryTraceToXml(contents);
+	ASSERT( truncated.size() < expected.size() && StringRef(truncated).endsWith(LiteralStringRef("</Trace>\r\n")) );
+
+	// Interned field names take less space than the XML did
+	ASSERT( complete < expected.size() );
+	return Void();
+}
+
 
 struct TraceLog {
 	Standalone< VectorRef<StringRef> > buffer;
@@ -201,9 +476,13 @@ struct TraceLog {
 	Reference<BarrierList> barriers;
 
 	struct WriterThread : IThreadPoolReceiver {
-		WriterThread( std::string directory, std::string processName, uint32_t maxLogsSize, std::string basename, Reference<BarrierList> barriers ) : directory(directory), processName(processName), maxLogsSize(maxLogsSize), basename(basename), traceFileFD(0), index(0), barriers(barriers) {}
+		WriterThread( std::string directory, std::string processName, uint32_t maxLogsSize, std::string basename, Reference<BarrierList> barriers )
+		  : directory(directory), processName(processName), maxLogsSize(maxLogsSize), basename(basename), traceFileFD(0), index(0), barriers(barriers),
+			binary(FLOW_KNOBS->TRACE_FORMAT == "binary"), codec(traceBlockCodec) {}
 
-		virtual void init() {}
+		virtual void init() {
+			setThreadName("TraceWriter");
+		}
 
 		Reference<BarrierList> barriers;
 		int traceFileFD;
@@ -213,6 +492,12 @@ struct TraceLog {
 		std::string basename;
 		int index;
 
+		bool binary;
+		ITraceBlockCodec* codec;
+		BinaryTraceEncoder encoder;
+
+		const char* extension() const { return binary ? "bin" : "xml"; }
+
 		void lastError(int err) {
 			// Whenever we get a serious error writing a trace log, all flush barriers posted between the operation encountering
 			// the error and the occurrence of the error are unblocked, even though we haven't actually succeeded in flushing.
@@ -251,17 +536,18 @@ struct TraceLog {
 		};
 		void action( Open& o ) {
 			if (traceFileFD) {
-				writeReliable("</Trace>");
+				if (!binary)
+					writeReliable("</Trace>");
 				while ( __close(traceFileFD) ) threadSleep(0.1);
 			}
 
 			cleanupTraceFiles();
 
-			auto finalname = format("%s.%d.xml", basename.c_str(), ++index);
+			auto finalname = format("%s.%d.%s", basename.c_str(), ++index, extension());
 			while ( (traceFileFD = __open( finalname.c_str(), TRACEFILE_FLAGS, TRACEFILE_MODE )) == -1 ) {
 				lastError(errno);
 				if (errno == EEXIST)
-					finalname = format("%s.%d.xml", basename.c_str(), ++index);
+					finalname = format("%s.%d.%s", basename.c_str(), ++index, extension());
 				else {
 					fprintf(stderr, "ERROR: could not create trace log file `%s' (%d: %s)\n", finalname.c_str(), errno, strerror(errno));
 
@@ -278,7 +564,12 @@ struct TraceLog {
 			onMainThreadVoid([]{ latestEventCache.clear("TraceFileOpenError"); }, NULL);
 			lastError(0);
 
-			writeReliable( "<?xml version=\"1.0\"?>\r\n<Trace>\r\n" );
+			if (binary) {
+				writeReliable( (const uint8_t*)BINARY_TRACE_MAGIC, sizeof(BINARY_TRACE_MAGIC) );
+				encoder.reset();
+			} else {
+				writeReliable( "<?xml version=\"1.0\"?>\r\n<Trace>\r\n" );
+			}
 		}
 
 		struct Barrier : TypedAction<WriterThread, Barrier> {
@@ -296,8 +587,21 @@ struct TraceLog {
 		};
 		void action( WriteBuffer& a ) {
 			if ( traceFileFD ) {
-				for ( auto i = a.buffer.begin(); i != a.buffer.end(); ++i )
-					writeReliable( i->begin(), i->size() );
+				if (binary) {
+					std::string records;
+					for ( auto i = a.buffer.begin(); i != a.buffer.end(); ++i ) {
+						encoder.encode( *i, records );
+						if (records.size() >= FLOW_KNOBS->TRACE_BINARY_BLOCK_BYTES) {
+							writeBlock( records );
+							records.clear();
+						}
+					}
+					if (records.size())
+						writeBlock( records );
+				} else {
+					for ( auto i = a.buffer.begin(); i != a.buffer.end(); ++i )
+						writeReliable( i->begin(), i->size() );
+				}
 
 				if(FLOW_KNOBS->TRACE_FSYNC_ENABLED) {
 					__fsync( traceFileFD );
@@ -307,11 +611,19 @@ struct TraceLog {
 			}
 		}
 
+		void writeBlock( std::string const& records ) {
+			std::string block;
+			appendBinaryTraceBlock( block, records, codec );
+			writeReliable( (const uint8_t*)block.data(), block.size() );
+		}
+
 		void cleanupTraceFiles() {
 			// Setting maxLogsSize=0 disables trace file cleanup based on dir size
 			if(!g_network->isSimulated() && maxLogsSize > 0) {
 				try {
 					std::vector<std::string> existingFiles = platform::listFiles(directory, ".xml");
+					std::vector<std::string> binaryFiles = platform::listFiles(directory, ".bin");
+					existingFiles.insert(existingFiles.end(), binaryFiles.begin(), binaryFiles.end());
 					std::vector<std::string> existingTraceFiles;
 
 					for(auto f = existingFiles.begin(); f != existingFiles.end(); ++f)
@@ -366,9 +678,10 @@ struct TraceLog {
 	}
 
 	static void extractTraceFileNameInfo(std::string const& filename, std::string &root, int &index) {
-		int split = filename.find_last_of('.', filename.size() - 5);
+		int extension = filename.find_last_of('.');
+		int split = filename.find_last_of('.', extension - 1);
 		root = filename.substr(0, split);
-		if(sscanf(filename.substr(split + 1, filename.size() - split - 4).c_str(), "%d", &index) == EOF)
+		if(sscanf(filename.substr(split + 1, extension - split - 1).c_str(), "%d", &index) == EOF)
 			index = -1;
 	}
 
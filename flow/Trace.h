@@ -245,6 +245,23 @@ void initTraceEventMetrics();
 void closeTraceFile();
 bool traceFileIsOpen();
 
+// When FLOW_KNOBS->TRACE_FORMAT is "binary", trace files are written in a compact binary format instead of XML.  The
+// writer thread encodes the events, interning their field names, and writes them in blocks which it compresses with
+// the codec set here, if any.  Flow has no compression library of its own, so with no codec the blocks are stored as
+// they are.  The codec must be set before the trace file is opened, and must be safe to call from another thread.
+struct ITraceBlockCodec {
+	virtual ~ITraceBlockCodec() {}
+	// Sets out to the compressed form of the given bytes and returns true, or returns false to store them uncompressed
+	virtual bool compress( const uint8_t* data, int length, std::string& out ) = 0;
+	// Returns the rawLength bytes that compress() turned into the given ones, or throws file_corrupt()
+	virtual std::string decompress( const uint8_t* data, int length, int rawLength ) = 0;
+};
+void setTraceBlockCodec( ITraceBlockCodec* codec );
+
+// Converts the contents of a binary trace file to the XML trace file it stands for, using the codec set above to
+// decompress its blocks.  A truncated last block, as left by a process that died while writing it, is ignored.
+std::string binaryTraceToXml( std::string const& contents );
+
 enum trace_clock_t { TRACE_CLOCK_NOW, TRACE_CLOCK_REALTIME };
 extern trace_clock_t g_trace_clock;
 extern TraceBatch g_traceBatch;
@@ -27,3 +27,59 @@ UnitTest::UnitTest(const char* name, const char* file, int line, TestFunction fu
 {
 	g_unittests.tests = this;
 }
+
+BenchmarkCollection g_benchmarks = { NULL };
+
+Benchmark::Benchmark(const char* name, const char* file, int line, BenchmarkFunction func)
+	: name(name), file(file), line(line), func(func), next(g_benchmarks.benchmarks)
+{
+	g_benchmarks.benchmarks = this;
+}
+
+static void timeBenchmark( Benchmark const* benchmark, int iterations, double& seconds, uint64_t& cycles ) {
+	double start = timer_monotonic();
+	uint64_t startCycles = __rdtsc();
+	benchmark->func(iterations);
+	cycles = __rdtsc() - startCycles;
+	seconds = timer_monotonic() - start;
+}
+
+BenchmarkResult runBenchmark( Benchmark const* benchmark, double minSeconds, int samples ) {
+	ASSERT( samples > 0 );
+	double seconds;
+	uint64_t cycles;
+
+	BenchmarkResult result;
+	result.iterations = 1;
+	loop {
+		timeBenchmark( benchmark, result.iterations, seconds, cycles );
+		if( seconds >= minSeconds || result.iterations >= (1<<30) )
+			break;
+		result.iterations *= 2;
+	}
+	timeBenchmark( benchmark, result.iterations, seconds, cycles );
+
+	std::vector<double> sampleSeconds, sampleCycles;
+	for(int s = 0; s < samples; s++) {
+		timeBenchmark( benchmark, result.iterations, seconds, cycles );
+		sampleSeconds.push_back( seconds );
+		sampleCycles.push_back( cycles );
+	}
+	std::sort( sampleSeconds.begin(), sampleSeconds.end() );
+	std::sort( sampleCycles.begin(), sampleCycles.end() );
+
+	result.samples = samples;
+	result.minNanoseconds = sampleSeconds[0] * 1e9 / result.iterations;
+	result.medianNanoseconds = sampleSeconds[samples / 2] * 1e9 / result.iterations;
+	result.medianCycles = sampleCycles[samples / 2] / result.iterations;
+	return result;
+}
+
+std::string BenchmarkResult::toJSON( Benchmark const* benchmark ) const {
+	// Benchmark names are plain paths, but files have backslashes on Windows
+	std::string file = benchmark->file;
+	std::replace( file.begin(), file.end(), '\\', '/' );
+	return format( "{\"name\": \"%s\", \"file\": \"%s\", \"line\": %d, \"iterations\": %d, \"samples\": %d, "
+		"\"min_ns\": %.3f, \"median_ns\": %.3f, \"median_cycles\": %.1f}",
+		benchmark->name, file.c_str(), benchmark->line, iterations, samples, minNanoseconds, medianNanoseconds, medianCycles );
+}
@@ -41,6 +41,18 @@
  *
  * Our tools for actually executing tests are external to flow (and use g_unittests to find test cases).
  * See the `UnitTestWorkload` class.
+ *
+ * Benchmarks:
+ *
+ * BENCHMARK_CASE( "product/module/benchmark" ) {
+ *   for(int i = 0; i < iterations; i++)
+ *     benchmarkSink( something(i) );
+ * }
+ *
+ * The body is an ordinary function of `int iterations`, which it must repeat its work that many times.  The
+ * number of iterations is calibrated by runBenchmark() to take at least a given time, and benchmarkSink() keeps the
+ * compiler from dropping work whose result is unused.  Benchmarks are kept in g_benchmarks rather than g_unittests, so
+ * that they are only run when asked for (the UnitTests workload's runBenchmarks option).
 */
 
 #include "flow.h"
@@ -63,6 +75,49 @@ struct UnitTestCollection {
 
 extern UnitTestCollection g_unittests;
 
+struct Benchmark {
+	typedef void(*BenchmarkFunction)(int iterations);
+
+	const char* name;
+	const char* file;
+	int line;
+	BenchmarkFunction func;
+	Benchmark* next;
+
+	Benchmark(const char* name, const char* file, int line, BenchmarkFunction func);
+};
+
+struct BenchmarkCollection {
+	Benchmark* benchmarks;
+};
+
+extern BenchmarkCollection g_benchmarks;
+
+struct BenchmarkResult {
+	int iterations;  // Per sample
+	int samples;
+	double minNanoseconds, medianNanoseconds;  // Per iteration
+	double medianCycles;  // Per iteration, from the time stamp counter
+
+	std::string toJSON( Benchmark const* benchmark ) const;
+};
+
+// Doubles the iterations of benchmark, running each count once as warmup, until a run takes at least minSeconds, then
+// times samples runs of that many iterations
+BenchmarkResult runBenchmark( Benchmark const* benchmark, double minSeconds, int samples );
+
+// Makes it seem to the compiler that the value of x is used
+template <class T>
+inline void benchmarkSink( T const& x ) {
+#ifdef _MSC_VER
+	static const void* volatile sink;
+	sink = &x;
+	_ReadWriteBarrier();
+#else
+	asm volatile( "" : : "g"(&x) : "memory" );
+#endif
+}
+
 #define APPEND(a,b) a##b
 
 // FILE_UNIQUE_NAME(basename) expands to a name like basename456 if on line 456
@@ -74,6 +129,8 @@ extern UnitTestCollection g_unittests;
 	#define TEST_CASE( name ) \
 		static Future<Void> FILE_UNIQUE_NAME(disabled_testcase_func)()
 	#define ACTOR_TEST_CASE( actorname, name )
+	#define BENCHMARK_CASE( name ) \
+		static void FILE_UNIQUE_NAME(disabled_benchmark_func)(int iterations)
 
 #else
 
@@ -86,6 +143,11 @@ extern UnitTestCollection g_unittests;
 	#define ACTOR_TEST_CASE( actorname, name ) \
 		namespace { UnitTest APPEND(testcase_, actorname)(name, __FILE__, __LINE__, &actorname); }
 
+	#define BENCHMARK_CASE( name ) \
+		static void FILE_UNIQUE_NAME(benchmark_func)(int iterations); \
+		namespace { static Benchmark FILE_UNIQUE_NAME(benchmark)(name,__FILE__,__LINE__,&FILE_UNIQUE_NAME(benchmark_func)); }	\
+		static void FILE_UNIQUE_NAME(benchmark_func)(int iterations)
+
 #endif
 
 #endif
\ No newline at end of file
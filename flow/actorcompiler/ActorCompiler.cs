@@ -375,7 +375,7 @@ namespace actorcompiler
 
             string callback_base_classes = string.Join(", ", callbacks.Select(c=>string.Format("public {0}", c.type)));
             if (callback_base_classes != "") callback_base_classes += ", ";
-            writer.WriteLine("class {0} : public Actor<{2}>, {3}public FastAllocated<{1}>, public {4} {{",
+            writer.WriteLine("class {0} : public Actor<{2}>, {3}public ActorFrameAllocated<{1}>, public {4} {{",
                 className,
                 fullClassName,
                 actor.returnType == null ? "void" : actor.returnType,
@@ -383,8 +383,9 @@ namespace actorcompiler
                 fullStateClassName
                 );
             writer.WriteLine("public:");
-            writer.WriteLine("\tusing FastAllocated<{0}>::operator new;", fullClassName);
-            writer.WriteLine("\tusing FastAllocated<{0}>::operator delete;", fullClassName);
+            writer.WriteLine("\tusing ActorFrameAllocated<{0}>::operator new;", fullClassName);
+            writer.WriteLine("\tusing ActorFrameAllocated<{0}>::operator delete;", fullClassName);
+            writer.WriteLine("\tstatic const char* actorName() {{ return \"{0}{1}\"; }}", actor.nameSpace == null ? "" : actor.nameSpace + "::", actor.name);
             writer.WriteLine("\tvirtual void destroy() {{ ((Actor<{0}>*)this)->~Actor(); operator delete(this); }}", actor.returnType == null ? "void" : actor.returnType);
             foreach (var cb in callbacks)
                 writer.WriteLine("friend struct {0};", cb.type);
@@ -62,6 +62,7 @@ ERROR( database_locked, 1038, "Database is locked" )
 ERROR( cluster_version_changed, 1039, "The protocol version of the cluster has changed" )
 ERROR( external_client_already_loaded, 1040, "External client has already been loaded" )
 ERROR( lookup_failed, 1041, "DNS lookup failed" )
+ERROR( connection_idle, 1042, "Network connection closed because it was idle" )
 
 ERROR( broken_promise, 1100, "Broken promise" )
 ERROR( operation_cancelled, 1101, "Asynchronous operation cancelled" )
@@ -164,6 +165,7 @@ ERROR( directory_prefix_in_use, 2265, "Directory layer already has a conflicting
 ERROR( invalid_destination_directory, 2266, "Target directory is invalid" )
 ERROR( cannot_modify_root_directory, 2267, "Root directory cannot be modified" )
 ERROR( invalid_uuid_size, 2268, "UUID is not sixteen bytes");
+ERROR( invalid_column_block, 2269, "Compressed column block could not be decoded" )
 
 // 2300 - backup and restore errors
 ERROR( backup_error, 2300, "Backup error")
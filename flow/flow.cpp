@@ -20,6 +20,7 @@
 
 #include "flow.h"
 #include <stdarg.h>
+#include <atomic>
 
 INetwork *g_network = 0;
 IRandom *g_random = 0;
@@ -198,4 +199,41 @@ bool validationIsEnabled() {
 
 void enableBuggify( bool enabled ) {
 	buggifyActivated = enabled;
-}
\ No newline at end of file
+}
+static std::atomic<ActorFrameStats*> actorFrameStatsList;
+ActorFrameStats* g_runningActor = NULL;
+
+ActorFrameStats::ActorFrameStats( const char* name, int frameSize )
+	: name(name), frameSize(frameSize), live(0), allocations(0), lastAllocations(0)
+{
+	next = actorFrameStatsList.load();
+	while (!actorFrameStatsList.compare_exchange_weak(next, this)) {}
+}
+
+void traceActorFrameStats( int maxActors, double elapsed ) {
+	std::vector<ActorFrameStats*> actors;
+	for(ActorFrameStats* s = actorFrameStatsList.load(); s; s = s->next)
+		actors.push_back(s);
+	std::sort( actors.begin(), actors.end(), []( ActorFrameStats* a, ActorFrameStats* b ) {
+		return a->allocations - a->lastAllocations > b->allocations - b->lastAllocations;
+	} );
+
+	for(int i = 0; i < std::min<int>(maxActors, actors.size()); i++) {
+		ActorFrameStats* s = actors[i];
+		// The size of the FastAllocator blocks that hold the frames
+		int pooledSize = 64;
+		while (pooledSize < s->frameSize)
+			pooledSize *= 2;
+		TraceEvent("ActorFrameStats")
+			.detail("Actor", s->name)
+			.detail("Rank", i)
+			.detail("FrameSize", s->frameSize)
+			.detail("PooledSize", pooledSize)
+			.detail("Live", s->live)
+			.detail("LiveBytes", s->live * pooledSize)
+			.detail("Allocations", s->allocations)
+			.detail("AllocationsPerSec", elapsed > 0 ? (s->allocations - s->lastAllocations) / elapsed : 0);
+	}
+	for(auto s : actors)
+		s->lastAllocations = s->allocations;
+}
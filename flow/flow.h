@@ -924,12 +924,66 @@ struct Actor<void> {
 	//~Actor() { --actorCount; }
 };
 
+// Allocation counts of the frames of one actor, which ActorFrameAllocated keeps for each actor class.  The counts are not
+// synchronized, since the actors of a class all run on one thread.
+struct ActorFrameStats {
+	const char* name;
+	int frameSize;
+	int64_t live;
+	int64_t allocations;
+	int64_t lastAllocations;  // allocations as of the previous traceActorFrameStats()
+	ActorFrameStats* next;
+
+	ActorFrameStats( const char* name, int frameSize );  // Adds the new object to the list of all of them
+};
+
+// The actor class whose callback is running on the network thread, or NULL.  The sampling profiler attributes its samples
+// to it.  An actor that runs when it is first called, before it ever waits, is attributed to its caller.
+extern ActorFrameStats* g_runningActor;
+
+struct RunningActor {
+	ActorFrameStats* previous;
+	explicit RunningActor( ActorFrameStats* running ) : previous(g_runningActor) { g_runningActor = running; }
+	~RunningActor() { g_runningActor = previous; }
+};
+
+// Emits an ActorFrameStats event for each of the maxActors actors with the most frames allocated since the previous call,
+// elapsed seconds ago.  Only actors that have run at least once are known.
+void traceActorFrameStats( int maxActors, double elapsed );
+
+// The actor compiler allocates the frame of every actor through this, which is FastAllocated and counts the frames of
+// Object in its ActorFrameStats
+template <class Object>
+class ActorFrameAllocated : public FastAllocated<Object> {
+public:
+	static void* operator new(size_t s) {
+		ActorFrameStats& stats = frameStats();
+		stats.live++;
+		stats.allocations++;
+		return FastAllocated<Object>::operator new(s);
+	}
+
+	static void operator delete(void* s) {
+		frameStats().live--;
+		FastAllocated<Object>::operator delete(s);
+	}
+	static void* operator new( size_t, void* p ) { return p; }
+	static void operator delete( void*, void* ) { }
+
+	static ActorFrameStats& frameStats() {
+		static ActorFrameStats stats( Object::actorName(), sizeof(Object) );
+		return stats;
+	}
+};
+
 template <class ActorType, int CallbackNumber, class ValueType>
 struct ActorCallback : Callback<ValueType> {
 	virtual void fire(ValueType const& value) {
+		RunningActor running( &ActorType::frameStats() );
 		static_cast<ActorType*>(this)->a_callback_fire(this, value);
 	}
 	virtual void error(Error e) {
+		RunningActor running( &ActorType::frameStats() );
 		static_cast<ActorType*>(this)->a_callback_error(this, e);
 	}
 };
@@ -937,9 +991,11 @@ struct ActorCallback : Callback<ValueType> {
 template <class ActorType, int CallbackNumber, class ValueType>
 struct ActorSingleCallback : SingleCallback<ValueType> {
 	virtual void fire(ValueType const& value) {
+		RunningActor running( &ActorType::frameStats() );
 		static_cast<ActorType*>(this)->a_callback_fire(this, value);
 	}
 	virtual void error(Error e) {
+		RunningActor running( &ActorType::frameStats() );
 		static_cast<ActorType*>(this)->a_callback_error(this, e);
 	}
 };
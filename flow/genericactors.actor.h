@@ -828,21 +828,29 @@ template <class T>
 Future<Void> quorum(std::vector<Future<T>> const& results, int n) {
 	ASSERT(n >= 0 && n <= results.size());
 
-	int size = Quorum<T>::sizeFor(results.size());
-	Quorum<T>* q = new (allocateFast(size)) Quorum<T>(n, results.size());
+	// Futures that are already ready are counted first, in order.  If they decide the result nothing is allocated, and
+	// otherwise only the futures that are not ready get a callback.
+	int successes = 0;
+	int pending = 0;
+	if (!n) return Void();
+	for (auto & r : results) {
+		if (!r.isReady())
+			pending++;
+		else if (r.isError())
+			return r.getError();
+		else if (++successes == n)
+			return Void();
+	}
+
+	int size = Quorum<T>::sizeFor(pending);
+	Quorum<T>* q = new (allocateFast(size)) Quorum<T>(n - successes, pending);
 
 	QuorumCallback<T>* nextCallback = q->callbacks();
 	for (auto & r : results) {
-		if (r.isReady()) {
-			nextCallback->next = 0;
-			if (r.isError())
-				q->oneError(r.getError());
-			else
-				q->oneSuccess();
-		}
-		else
+		if (!r.isReady()) {
 			new (nextCallback) QuorumCallback<T>(r, q);
-		++nextCallback;
+			++nextCallback;
+		}
 	}
 	return Future<Void>(q);
 }
@@ -1185,12 +1193,18 @@ struct FlowLock : NonCopyable, public ReferenceCounted<FlowLock> {
 		return takeMoreActor(this, &amount);
 	}
 
+	// Changes the number of permits.  If it is lowered below the number currently held, take() waits until enough are released.
+	void setPermits( int newPermits ) {
+		permits = newPermits;
+		release(0);
+	}
+
 	int available() const { return permits - active; }
 	int activePermits() const { return active; }
 	int waiters() const { return takers.size(); }
 private:
 	std::list< std::pair< Promise<Void>, int > > takers;
-	const int permits;
+	int permits;
 	int active;
 	Promise<Void> broken_on_destruct;
 
@@ -1256,13 +1270,14 @@ Future<Void> yieldPromiseStream( FutureStream<T> input, PromiseStream<T> output,
 }
 
 
-struct YieldedFutureActor : SAV<Void>, ActorCallback<YieldedFutureActor, 1, Void>, FastAllocated<YieldedFutureActor> {
+struct YieldedFutureActor : SAV<Void>, ActorCallback<YieldedFutureActor, 1, Void>, ActorFrameAllocated<YieldedFutureActor> {
 	Error in_error_state;
 
 	typedef ActorCallback<YieldedFutureActor, 1, Void> CB1;
 
-	using FastAllocated<YieldedFutureActor>::operator new;
-	using FastAllocated<YieldedFutureActor>::operator delete;
+	using ActorFrameAllocated<YieldedFutureActor>::operator new;
+	using ActorFrameAllocated<YieldedFutureActor>::operator delete;
+	static const char* actorName() { return "YieldedFuture"; }
 
 	YieldedFutureActor(Future<Void> && f) : SAV<Void>(1, 1), in_error_state(Error::fromCode(UNSET_ERROR_CODE)) {
 		f.addYieldedCallbackAndClear(static_cast< ActorCallback< YieldedFutureActor, 1, Void >* >(this));
@@ -69,6 +69,7 @@ enum {
 	TaskDiskWrite = 3010,
 	TaskUpdateStorage = 3000,
 	TaskBatchCopy = 2900,
+	TaskDiskBackground = 2010,
 	TaskLowPriority = 2000,
 
 	TaskMinPriority = 1000
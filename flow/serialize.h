@@ -238,6 +238,68 @@ inline _Unversioned Unversioned() { return _Unversioned(); }
 
 static uint64_t size_limits[] = { 0ULL, 255ULL, 65535ULL, 16777215ULL, 4294967295ULL, 1099511627775ULL, 281474976710655ULL, 72057594037927935ULL, 18446744073709551615ULL };
 
+// A type marked PREALLOCATED_SERIALIZABLE is serialized in two passes by BinaryWriter::toValue and by PacketWriter (through
+// SerializeSource): a SizeCounter first computes its exact serialized size, and an UncheckedWriter then writes it into
+// memory of that size without bounds checking each field.  The bytes produced are identical to ar << t.  Only mark types
+// for which serializing the same value twice writes the same number of bytes.
+template <class T>
+struct is_preallocated_serializable { enum { value = 0 }; };
+
+#define PREALLOCATED_SERIALIZABLE( T ) template<> struct is_preallocated_serializable<T> { enum { value = 1 }; };
+
+// A writer which only counts the bytes that would be written
+class SizeCounter {
+public:
+	static const int isDeserializing = 0;
+	typedef SizeCounter WRITER;
+
+	template <class VersionOptions>
+	explicit SizeCounter( VersionOptions vo ) : size(0) { vo.write(*this); }
+
+	void serializeBytes( StringRef bytes ) { size += bytes.size(); }
+	void serializeBytes( const void* data, int bytes ) { size += bytes; }
+	template <class T>
+	void serializeBinaryItem( const T& t ) { size += sizeof(T); }
+	int getLength() const { return size; }
+
+	uint64_t protocolVersion() const { return m_protocolVersion; }
+	void setProtocolVersion(uint64_t pv) { m_protocolVersion = pv; }
+private:
+	int size;
+	uint64_t m_protocolVersion;
+};
+
+// A writer into memory which the caller has already sized (normally with a SizeCounter); nothing is bounds checked
+class UncheckedWriter {
+public:
+	static const int isDeserializing = 0;
+	typedef UncheckedWriter WRITER;
+
+	template <class VersionOptions>
+	UncheckedWriter( uint8_t* data, VersionOptions vo ) : begin(data), end(data) { vo.write(*this); }
+
+	void serializeBytes( StringRef bytes ) {
+		serializeBytes(bytes.begin(), bytes.size());
+	}
+	void serializeBytes( const void* data, int bytes ) {
+		valgrindCheck( data, bytes, "serializeBytes" );
+		memcpy(end, data, bytes);
+		end += bytes;
+	}
+	template <class T>
+	void serializeBinaryItem( const T& t ) {
+		*(T*)end = t;
+		end += sizeof(T);
+	}
+	int getLength() const { return end-begin; }
+
+	uint64_t protocolVersion() const { return m_protocolVersion; }
+	void setProtocolVersion(uint64_t pv) { m_protocolVersion = pv; }
+private:
+	uint8_t *begin, *end;
+	uint64_t m_protocolVersion;
+};
+
 class BinaryWriter : NonCopyable {
 public:
 	static const int isDeserializing = 0;
@@ -279,6 +341,15 @@ public:
 
 	template <class T, class VersionOptions>
 	static Standalone<StringRef> toValue( T const& t, VersionOptions vo ) {
+		if (is_preallocated_serializable<T>::value) {
+			SizeCounter counter(vo);
+			counter << t;
+			Standalone<StringRef> s = makeString( counter.getLength() );
+			UncheckedWriter wr( mutateString(s), vo );
+			wr << t;
+			ASSERT( wr.getLength() == s.size() );
+			return s;
+		}
 		BinaryWriter wr(vo);
 		wr << t;
 		return wr.toStringRef();
@@ -567,7 +638,8 @@ struct SendBuffer {
 
 struct PacketBuffer : SendBuffer, FastAllocated<PacketBuffer> {
 	int reference_count;
-	enum { DATA_SIZE = 4096 - 28 };
+	Arena external;  // Keeps the memory of a by-reference buffer alive
+	enum { DATA_SIZE = 4096 - 40 };
 	uint8_t data[ DATA_SIZE ];
 
 	PacketBuffer() : reference_count(1) {
@@ -576,10 +648,19 @@ struct PacketBuffer : SendBuffer, FastAllocated<PacketBuffer> {
 		((SendBuffer*)this)->data = data;
 		static_assert( sizeof(PacketBuffer) == 4096, "PacketBuffer size mismatch" );
 	}
+	// A buffer which sends the given bytes in place rather than from data[]; nothing more can be written to it
+	PacketBuffer( StringRef bytes, Arena const& arena ) : reference_count(1), external(arena) {
+		next = 0;
+		bytes_written = bytes.size();
+		bytes_sent = 0;
+		((SendBuffer*)this)->data = bytes.begin();
+	}
 	PacketBuffer* nextPacketBuffer() { return (PacketBuffer*)next; }
 	void addref() { ++reference_count; }
 	void delref() { if (!--reference_count) delete this; }
-	int bytes_unwritten() const { return DATA_SIZE-bytes_written; }
+	bool isByReference() const { return ((SendBuffer const*)this)->data != data; }
+	uint8_t const* bytes_begin() const { return ((SendBuffer const*)this)->data; }
+	int bytes_unwritten() const { return isByReference() ? 0 : DATA_SIZE-bytes_written; }
 };
 
 struct PacketWriter {
@@ -605,6 +686,8 @@ struct PacketWriter {
 		}
 	}
 	void serializeBytesAcrossBoundary(const void* data, int bytes);
+	// Large byte ranges are attached to the packet and sent from where they are instead of being copied; arena must own them
+	void serializeBytesByReference( StringRef bytes, Arena const& arena );
 	void writeAhead( int bytes, struct SplitBuffer* );
 	void nextBuffer();
 	PacketBuffer* finish();
@@ -622,12 +705,64 @@ struct PacketWriter {
 			serializeBytesAcrossBoundary(&t, sizeof(T));
 		}
 	}
+	// Serializes t exactly as *this << t would, but when t fits in the current buffer or is large enough to be sent by
+	//   reference it is sized first and then written into contiguous memory without per-field bounds checks
+	template <class T>
+	void serializePreallocated( T const& t ) {
+		SizeCounter counter( Unversioned() );
+		counter.setProtocolVersion( m_protocolVersion );
+		counter << t;
+		int bytes = counter.getLength();
+		if (bytes <= buffer->bytes_unwritten()) {
+			writeUnchecked( t, buffer->data + buffer->bytes_written, bytes );
+			buffer->bytes_written += bytes;
+		} else if (sendsByReference(bytes)) {
+			Arena arena;
+			uint8_t* data = new (arena) uint8_t[bytes];
+			writeUnchecked( t, data, bytes );
+			serializeBytesByReference( StringRef(data, bytes), arena );
+		} else {
+			*this << t;
+		}
+	}
 	uint64_t protocolVersion() const { return m_protocolVersion; }
 	void setProtocolVersion(uint64_t pv) { m_protocolVersion = pv; }
 private:
+	template <class T>
+	void writeUnchecked( T const& t, uint8_t* data, int bytes ) {
+		UncheckedWriter wr( data, Unversioned() );
+		wr.setProtocolVersion( m_protocolVersion );
+		wr << t;
+		ASSERT( wr.getLength() == bytes );
+	}
+	static bool sendsByReference( int bytes );
 	void init( PacketBuffer* buf, ReliablePacket* reliable );
+	void appendBuffer( PacketBuffer* next );
 };
 
+// Serializes s exactly as ar & s would.  When sending with a PacketWriter, a large s is sent by reference to the memory
+// owned by arena rather than copied into the packet.
+template <class Archive>
+inline void serializeByReference( Archive& ar, StringRef& s, Arena const& arena ) {
+	ar & s;
+}
+inline void serializeByReference( PacketWriter& ar, StringRef& s, Arena const& arena ) {
+	ar << (uint32_t)s.size();
+	ar.serializeBytesByReference( s, arena );
+}
+
+template <class Archive, class T>
+inline void serializePreallocated( Archive& ar, T const& t ) {
+	ar << t;
+}
+template <class T>
+inline void serializePreallocated( PacketWriter& ar, T const& t ) {
+	if (is_preallocated_serializable<T>::value)
+		ar.serializePreallocated( t );
+	else
+		ar << t;
+}
+
 struct ISerializeSource {
 	virtual void serializePacketWriter( PacketWriter& ) const = 0;
 	virtual void serializeBinaryWriter( BinaryWriter& ) const = 0;
@@ -643,7 +778,7 @@ template <class T>
 struct SerializeSource : MakeSerializeSource<SerializeSource<T>> {
 	T const& value;
 	SerializeSource(T const& value) : value(value) {}
-	template <class Ar> void serialize(Ar& ar) const { ar << value; }
+	template <class Ar> void serialize(Ar& ar) const { serializePreallocated( ar, value ); }
 };
 
 template <class T>
@@ -651,7 +786,7 @@ struct SerializeBoolAnd : MakeSerializeSource<SerializeBoolAnd<T>> {
 	bool b;
 	T const& value;
 	SerializeBoolAnd( bool b, T const& value ) : b(b), value(value) {}
-	template <class Ar> void serialize(Ar& ar) const { ar << b << value; }
+	template <class Ar> void serialize(Ar& ar) const { ar << b; serializePreallocated( ar, value ); }
 };
 
 struct SerializeSourceRaw : MakeSerializeSource<SerializeSourceRaw> {